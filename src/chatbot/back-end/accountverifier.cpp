@@ -25,6 +25,10 @@
 
 #include <QMutex>
 #include <QMutexLocker>
+#include <QTimer>
+#include <QCryptographicHash>
+
+#define SESSION_TIMEOUT     60000   // Milliseconds a verified chat session is kept
 
 namespace
 {
@@ -41,6 +45,11 @@ inline Lvk::BE::Roster toBERoster(const Lvk::CA::ContactInfoList &infoList)
     return roster;
 }
 
+inline QByteArray passwdHash(const QString &passwd)
+{
+    return QCryptographicHash::hash(passwd.toUtf8(), QCryptographicHash::Sha1);
+}
+
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -48,8 +57,14 @@ inline Lvk::BE::Roster toBERoster(const Lvk::CA::ContactInfoList &infoList)
 //--------------------------------------------------------------------------------------------------
 
 Lvk::BE::AccountVerifier::AccountVerifier()
-    : m_mutex(new QMutex(QMutex::Recursive)), m_chatbot(0)
+    : m_mutex(new QMutex(QMutex::Recursive)), m_chatbot(0), m_session(0),
+      m_sessionTimer(new QTimer(this))
 {
+    m_sessionTimer->setInterval(SESSION_TIMEOUT);
+    m_sessionTimer->setSingleShot(true);
+
+    connect(m_sessionTimer, SIGNAL(timeout()), SLOT(onSessionTimeout()));
+
     connect(&m_daAuth, SIGNAL(success(DAS::UserAuth::AuthInfo)),
             SLOT(onDASAuthOk(DAS::UserAuth::AuthInfo)));
 
@@ -64,6 +79,7 @@ Lvk::BE::AccountVerifier::~AccountVerifier()
     {
         QMutexLocker locker(m_mutex);
         delete m_chatbot;
+        delete m_session;
     }
 
     delete m_mutex;
@@ -98,6 +114,8 @@ void Lvk::BE::AccountVerifier::verify(BE::ChatType type, const QString &user, co
         clear(false);
     }
 
+    discardSession();
+
     m_type = type;
     m_user = user;
     m_passwd = passwd;
@@ -181,6 +199,16 @@ void Lvk::BE::AccountVerifier::onChatbotConnectionOk()
         info.chatUsername = m_chatUser;
         info.roster = toBERoster(m_chatbot->roster());
 
+        // Keep the chat session, so the application does not need to connect again
+        discardSession();
+        m_chatbot->disconnect(this);
+        m_session = m_chatbot;
+        m_sessionType = m_type;
+        m_sessionUser = m_chatUser;
+        m_sessionPasswd = passwdHash(m_passwd);
+        m_sessionTimer->start();
+        m_chatbot = 0;
+
         clear(true);
     }
 
@@ -200,4 +228,49 @@ void Lvk::BE::AccountVerifier::onChatbotConnectionError(int err)
     emit accountError(err, "");
 }
 
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::Chatbot * Lvk::BE::AccountVerifier::takeSession(BE::ChatType type,
+                                                         const QString &chatUser,
+                                                         const QString &passwd)
+{
+    QMutexLocker locker(m_mutex);
+
+    if (!m_session || !m_session->isConnected() || m_sessionType != type
+            || m_sessionUser != chatUser || m_sessionPasswd != passwdHash(passwd)) {
+        discardSession();
+        return 0;
+    }
+
+    CA::Chatbot *session = m_session;
+    m_session = 0;
+    m_sessionUser.clear();
+    m_sessionPasswd.clear();
+    m_sessionTimer->stop();
 
+    return session;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AccountVerifier::discardSession()
+{
+    QMutexLocker locker(m_mutex);
+
+    if (m_session) {
+        m_session->disconnectFromServer();
+        m_session->deleteLater();
+        m_session = 0;
+    }
+
+    m_sessionUser.clear();
+    m_sessionPasswd.clear();
+    m_sessionTimer->stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AccountVerifier::onSessionTimeout()
+{
+    discardSession();
+}
@@ -24,12 +24,14 @@
 
 #include <QObject>
 #include <QString>
+#include <QByteArray>
 
 #include "back-end/roster.h"
 #include "back-end/chattype.h"
 #include "da-server/userauth.h"
 
 class QMutex;
+class QTimer;
 
 namespace Lvk
 {
@@ -60,6 +62,9 @@ namespace BE
  * 2. Connect to the chat server to verify if user/password is OK.
  *
  * For ordinary versions we only perform step 2.
+ *
+ * The chat session opened in step 2 is not closed on success. It is kept for a minute so the
+ * application can take it with takeSession() instead of connecting to the chat server again.
  */
 class AccountVerifier : public QObject
 {
@@ -87,6 +92,19 @@ public:
      */
     void abort();
 
+    /**
+     * Returns the connected chatbot used to verify the account if it was verified with type
+     * \a type, chat username \a chatUser and password \a passwd. Otherwise; returns 0.
+     * The ownership of the chatbot is transferred to the caller. The chatbot has no AI and no
+     * history file set yet.
+     */
+    CA::Chatbot *takeSession(ChatType type, const QString &chatUser, const QString &passwd);
+
+    /**
+     * Disconnects and deletes the chat session kept after the last verification (if any)
+     */
+    void discardSession();
+
     /**
      * The AccountInfo provides a simple structure with account information
      */
@@ -117,6 +135,7 @@ private slots:
     void onDASAuthError(int code, const QString &msg);
     void onChatbotConnectionOk();
     void onChatbotConnectionError(int err);
+    void onSessionTimeout();
 
 private:
     AccountVerifier(const AccountVerifier&);
@@ -129,6 +148,11 @@ private:
     QString m_user;
     QString m_passwd;
     QString m_chatUser;
+    CA::Chatbot *m_session;         // Connected chatbot kept after a successful verification
+    ChatType m_sessionType;
+    QString m_sessionUser;
+    QByteArray m_sessionPasswd;     // SHA-1 of the password
+    QTimer *m_sessionTimer;
 
     void stepOne();
     void stepTwo();
@@ -22,13 +22,14 @@
 #include "back-end/aiadapter.h"
 #include "nlp-engine/engine.h"
 #include "chat-adapter/contactinfo.h"
-#include "common/random.h"
 #include "common/globalstrings.h"
+#include "common/trace.h"
+#include "common/profiler.h"
+#include "common/maintenancescheduler.h"
 
 #include <QDateTime>
-#include <QReadWriteLock>
-#include <QReadLocker>
-#include <QWriteLocker>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QtDebug>
 
 
@@ -53,7 +54,7 @@ QString getFromString(const Lvk::CA::ContactInfo &contact)
 //--------------------------------------------------------------------------------------------------
 
 Lvk::BE::AIAdapter::AIAdapter(const QString &id, Nlp::Engine *engine /*= 0*/)
-    : m_id(id), m_engine(engine), m_rwLock(new QReadWriteLock(QReadWriteLock::Recursive))
+    : m_id(id), m_config(new Config(engine)), m_writeMutex(new QMutex())
 {
 }
 
@@ -61,7 +62,7 @@ Lvk::BE::AIAdapter::AIAdapter(const QString &id, Nlp::Engine *engine /*= 0*/)
 
 Lvk::BE::AIAdapter::~AIAdapter()
 {
-    delete m_rwLock;
+    delete m_writeMutex;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -69,40 +70,44 @@ Lvk::BE::AIAdapter::~AIAdapter()
 Lvk::Cmn::Conversation::Entry Lvk::BE::AIAdapter::getEntry(const QString &input,
                                                            const CA::ContactInfo &contact)
 {
-    QWriteLocker locker(m_rwLock);
+    LVK_PROFILE("AIAdapter::getEntry");
 
-    if (m_engine) {
-        qDebug() << "AIAdapter: Getting response for input" << input
-                 << "and username" << contact.username;
+    Cmn::MaintenanceScheduler::Activity activity;
+
+    Cmn::Snapshot<Config>::Reader config(m_config);
+
+    if (config->engine) {
+        LVK_TRACE(BackEnd) << "AIAdapter: Getting response for input" << input
+                           << "and username" << contact.username;
 
         quint64 ruleId = 0;
-        Nlp::Engine::MatchList matches;
-        QString response = m_engine->getResponse(input, contact.username, matches);
-        bool matched = !response.isEmpty() && matches.size() > 0;
+        Nlp::Result result;
+        config->engine->getResponse(input, contact.username, result);
+        QString response = result.output;
+        bool matched = !response.isEmpty() && result.isValid();
 
 
         if (matched) {
-            qDebug() << "AIAdapter: Got response" << response;
+            LVK_TRACE(BackEnd) << "AIAdapter: Got response" << response;
 
-            if (matches.size() > 0) {
-                ruleId = matches.first().first;
-            } else {
-                qWarning() << "AIAdapter: Got response but empty match list";
-            }
+            ruleId = result.ruleId;
         } else {
-            if (m_evasives.size() > 0) {
-                response = m_evasives[Cmn::Random::getInt(0, m_evasives.size() - 1)];
-                qDebug() << "AIAdapter: No match. Using evasive" << response;
+            response = config->engine->getEvasive(contact.username);
+
+            if (!response.isEmpty()) {
+                LVK_TRACE(BackEnd) << "AIAdapter: No match. Using evasive" << response;
             } else {
-                response.clear();
-                qDebug() << "AIAdapter: No match and no evasives found";
+                LVK_TRACE(BackEnd) << "AIAdapter: No match and no evasives found";
             }
         }
 
         QDateTime dateTime = QDateTime::currentDateTime();
         QString from = getFromString(contact);
 
-        return Cmn::Conversation::Entry(dateTime, from, m_id, input, response, matched, ruleId);
+        Cmn::Conversation::Entry entry(dateTime, from, m_id, input, response, matched, ruleId);
+        entry.rulesVersion = matched ? result.rulesVersion : 0;
+
+        return entry;
     } else {
         qCritical("AIAdapter: No engine set");
 
@@ -112,20 +117,38 @@ Lvk::Cmn::Conversation::Entry Lvk::BE::AIAdapter::getEntry(const QString &input,
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::BE::AIAdapter::setNlpEngine(Nlp::Engine *engine)
+Lvk::Cmn::Conversation::Entry Lvk::BE::AIAdapter::getEvasiveEntry(const QString &input,
+                                                                  const CA::ContactInfo &contact)
 {
-    QWriteLocker locker(m_rwLock);
-    m_engine = engine;
+    Cmn::Snapshot<Config>::Reader config(m_config);
+
+    if (config->engine) {
+        QString response = config->engine->getEvasive(contact.username);
+
+        LVK_TRACE(BackEnd) << "AIAdapter: Using evasive" << response << "without matching";
+
+        return Cmn::Conversation::Entry(QDateTime::currentDateTime(), getFromString(contact),
+                                        m_id, input, response, false, 0);
+    } else {
+        qCritical("AIAdapter: No engine set");
+
+        return Cmn::Conversation::Entry();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::BE::AIAdapter::setEvasives(const QStringList &evasives)
+void Lvk::BE::AIAdapter::setNlpEngine(Nlp::Engine *engine)
 {
-    QWriteLocker locker(m_rwLock);
-    m_evasives = evasives;
+    QMutexLocker locker(m_writeMutex);
+
+    Config *config = new Config(*Cmn::Snapshot<Config>::Reader(m_config));
+    config->engine = engine;
+
+    m_config.publish(config);
 }
 
 
 
 
+
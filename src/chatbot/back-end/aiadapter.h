@@ -25,8 +25,9 @@
 #include <QString>
 #include <QStringList>
 #include "chat-adapter/chatbotai.h"
+#include "common/snapshot.h"
 
-class QReadWriteLock;
+class QMutex;
 
 namespace Lvk
 {
@@ -74,26 +75,32 @@ public:
      */
     virtual Cmn::Conversation::Entry getEntry(const QString &input,
                                               const CA::ContactInfo &contact);
+
     /**
-     * Sets the NLP engine that is used to get responses.
+     * \copydoc CA::ChatbotAI::getEvasiveEntry()
      */
-    void setNlpEngine(Nlp::Engine *engine);
-
+    virtual Cmn::Conversation::Entry getEvasiveEntry(const QString &input,
+                                                     const CA::ContactInfo &contact);
     /**
-     * Sets the list of evasives.
-     * Evasives are senteces used by the virtual user when there is no match in the NLP engine.
-     * If there is no match, an evasive is chosen and returned as response.
+     * Sets the NLP engine that is used to get responses. Messages already being processed
+     * keep using the previous engine, hence it must outlive them.
      */
-    void setEvasives(const QStringList &evasives);
+    void setNlpEngine(Nlp::Engine *engine);
 
 private:
     AIAdapter(AIAdapter&);
     AIAdapter& operator=(AIAdapter&);
 
+    struct Config
+    {
+        Config(Nlp::Engine *engine = 0) : engine(engine) { }
+
+        Nlp::Engine *engine;
+    };
+
     QString m_id;
-    Nlp::Engine *m_engine;
-    QStringList m_evasives;
-    QReadWriteLock *m_rwLock;
+    Cmn::Snapshot<Config> m_config;     // Read on every message, changes rarely
+    QMutex *m_writeMutex;               // Serializes setters
 };
 
 /// @}
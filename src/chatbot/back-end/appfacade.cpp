@@ -26,14 +26,24 @@
 #include "back-end/chatbotfactory.h"
 #include "back-end/filemetadata.h"
 #include "back-end/chatbottempfile.h"
+#include "back-end/httpendpoint.h"
 #include "nlp-engine/rule.h"
 #include "nlp-engine/enginefactory.h"
 #include "nlp-engine/sanitizerfactory.h"
 #include "nlp-engine/lemmatizerfactory.h"
 #include "nlp-engine/nlpproperties.h"
-#include "common/random.h"
+#include "nlp-engine/globaltools.h"
+#include "nlp-engine/sanitizer.h"
+#include "nlp-engine/word.h"
+#include "chat-adapter/xmppchatbot.h"
 #include "common/globalstrings.h"
 #include "common/crashhandler.h"
+#include "common/journal.h"
+#include "common/maintenancescheduler.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "common/startuptimeline.h"
+#include "common/taskscheduler.h"
 #include "stats/statsmanager.h"
 
 #ifdef DA_CONTEST
@@ -46,6 +56,11 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QTimer>
+#include <QtAlgorithms>
+
+#define RULES_COMMIT_DELAY      500     // Milliseconds without rule changes before committing
+#define ENTRY_BATCH_SIZE        64      // Max conversation entries handled per event loop pass
 
 
 //--------------------------------------------------------------------------------------------------
@@ -92,6 +107,108 @@ inline Lvk::Nlp::Rule toNlpRule(const Lvk::BE::Rule *rule)
 
 //--------------------------------------------------------------------------------------------------
 
+// Builds the rules of the NLP engine, from the snapshot if possible. Runs in a worker thread.
+// If the shared snapshots path is set, the snapshot there is named after the rules and config
+// instead of the chatbot, so every chatbot and process with the same rules uses one file.
+void buildEngine(Lvk::Nlp::Engine *engine, const QString &snapshotFilename,
+                 const QString &config)
+{
+    LVK_STARTUP_PHASE("nlp_build");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString filename = snapshotFilename;
+    QString sharedPath = Lvk::Cmn::SettingsSnapshot::current()
+            .stringValue(SETTING_NLP_SHARED_SNAPSHOTS_PATH);
+
+    if (!filename.isEmpty() && !sharedPath.isEmpty() && QDir().mkpath(sharedPath)) {
+        filename = QDir(sharedPath).filePath(engine->snapshotId(config) + ".snap");
+    }
+
+    if (filename.isEmpty()) {
+        engine->build();
+    } else if (!engine->loadSnapshot(filename, config)) {
+        qDebug("No valid NLP snapshot found, creating a new one");
+        engine->saveSnapshot(filename, config);
+    }
+
+    qDebug() << "NLP engine built in" << timer.elapsed() << "ms";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const int MAX_PREVIEW_CANDIDATES = 4;
+
+// Gets the best responses for a response preview. Runs in a worker thread. If *session is null
+// a new session is created, so rules changed since the last preview are compiled here.
+Lvk::BE::AppFacade::ResponseCandidateList previewResponses(Lvk::Nlp::Engine *engine,
+                                                           Lvk::Nlp::Engine **session,
+                                                           const QString &input,
+                                                           const QString &target)
+{
+    if (!*session) {
+        *session = engine->createSession();
+    }
+
+    Lvk::Nlp::ResultList results;
+    (*session)->getAllResponses(input, target, results);
+
+    Lvk::BE::AppFacade::ResponseCandidateList candidates;
+
+    for (int i = 0; i < results.size() && candidates.size() < MAX_PREVIEW_CANDIDATES; ++i) {
+        const Lvk::Nlp::Result &r = results[i];
+        candidates.append(Lvk::BE::AppFacade::ResponseCandidate(r.ruleId, r.inputIdx, r.score,
+                                                                r.output));
+    }
+
+    return candidates;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const double MIN_INPUT_SIMILARITY = 0.6;
+
+// Set of lemmas of the given words. Words without lemma are used as they are.
+inline QSet<QString> lemmaSet(const Lvk::Nlp::WordList &words)
+{
+    Lvk::Nlp::Sanitizer *postSanitizer = Lvk::Nlp::GlobalTools::instance()->postSanitizer();
+
+    QSet<QString> lemmas;
+
+    for (int i = 0; i < words.size(); ++i) {
+        const Lvk::Nlp::Word &w = words[i];
+        const QString &lemma = !w.lemma.isEmpty() ? w.lemma : w.normWord;
+        if (!lemma.isEmpty()) {
+            lemmas.insert(postSanitizer->sanitize(lemma.toLower()));
+        }
+    }
+
+    return lemmas;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Appends an OpenMetrics sample of metric name with labels, e.g. chat="gtalk"
+template<typename T>
+inline void appendSample(QByteArray &text, const char *name, const QByteArray &labels, T value)
+{
+    text += name;
+    if (!labels.isEmpty()) {
+        text += "{" + labels + "}";
+    }
+    text += " " + QByteArray::number(value) + "\n";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline const char *chatTypeLabel(int type)
+{
+    return type == Lvk::BE::FbChat ? "chat=\"facebook\"" : "chat=\"gtalk\"";
+}
+
+//--------------------------------------------------------------------------------------------------
+
 inline Lvk::CA::ContactInfoList toChatbotRoster(const Lvk::BE::Roster &roster)
 {
     Lvk::CA::ContactInfoList infoList;
@@ -101,6 +218,31 @@ inline Lvk::CA::ContactInfoList toChatbotRoster(const Lvk::BE::Roster &roster)
     return infoList;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+// Returns up to n messages received in conv, the most frequent first
+QStringList mostFrequentInputs(const Lvk::Cmn::Conversation &conv, int n)
+{
+    QHash<QString, int> freq;
+    foreach (const Lvk::Cmn::Conversation::Entry &entry, conv.entries()) {
+        if (!entry.msg.isEmpty()) {
+            ++freq[entry.msg];
+        }
+    }
+
+    QList< QPair<int, QString> > sorted;
+    for (QHash<QString, int>::const_iterator it = freq.constBegin(); it != freq.constEnd(); ++it) {
+        sorted.append(qMakePair(-it.value(), it.key()));
+    }
+    qSort(sorted);
+
+    QStringList inputs;
+    for (int i = 0; i < sorted.size() && i < n; ++i) {
+        inputs.append(sorted[i].second);
+    }
+    return inputs;
+}
+
 } // namespace
 
 
@@ -113,7 +255,17 @@ Lvk::BE::AppFacade::AppFacade(QObject *parent /*= 0*/)
       m_evasivesRule(0),
       m_nlpEngine(Nlp::EngineFactory().createEngine()),
       m_chatbot(0),
-      m_nlpOptions(0)
+      m_httpEndpoint(0),
+      m_previewSession(0),
+      m_previewSessionStale(false),
+      m_previewPending(false),
+      m_previewOutdated(false),
+      m_commitTimer(new QTimer(this)),
+      m_rulesChanged(false),
+      m_entriesScheduled(false),
+      m_firstReply(false),
+      m_nlpOptions(0),
+      m_analysisProfile(Nlp::AnalysisProfile::fromSettings(&m_autoAnalysisProfile))
 {
     init();
 }
@@ -125,7 +277,17 @@ Lvk::BE::AppFacade::AppFacade(Nlp::Engine *nlpEngine, QObject *parent /*= 0*/)
       m_evasivesRule(0),
       m_nlpEngine(nlpEngine),
       m_chatbot(0),
-      m_nlpOptions(0) // FIXME value?
+      m_httpEndpoint(0),
+      m_previewSession(0),
+      m_previewSessionStale(false),
+      m_previewPending(false),
+      m_previewOutdated(false),
+      m_commitTimer(new QTimer(this)),
+      m_rulesChanged(false),
+      m_entriesScheduled(false),
+      m_firstReply(false),
+      m_nlpOptions(0), // FIXME value?
+      m_analysisProfile(Nlp::AnalysisProfile::fromSettings(&m_autoAnalysisProfile))
 {
     init();
 }
@@ -136,6 +298,9 @@ void Lvk::BE::AppFacade::init()
 {
     m_rlogh.logAppLaunched();
 
+    // Scripts are analyzed with sessions of the NLP engine, so its trees are not built again
+    m_clueEngine.setEngine(m_nlpEngine);
+
     qRegisterMetaTypeStreamOperators<BE::RosterItem>("Lvk::BEk::RosterItem");
     qRegisterMetaTypeStreamOperators<BE::Roster>("Lvk::BEk::Roster");
 
@@ -143,6 +308,10 @@ void Lvk::BE::AppFacade::init()
             SIGNAL(scoreRemainingTime(int)),
             SIGNAL(scoreRemainingTime(int)));
 
+    connect(Stats::StatsManager::manager(),
+            SIGNAL(scoreChanged(Lvk::Stats::Score,Lvk::Stats::Score)),
+            SIGNAL(scoreChanged(Lvk::Stats::Score,Lvk::Stats::Score)));
+
     connect(&m_account,
             SIGNAL(accountOk(AccountVerifier::AccountInfo)),
             SLOT(onAccountOk(AccountVerifier::AccountInfo)));
@@ -151,9 +320,45 @@ void Lvk::BE::AppFacade::init()
             SIGNAL(accountError(int,QString)),
             SLOT(onAccountError(int,QString)));
 
+    connect(&m_nlpBuild, SIGNAL(finished()), SLOT(onNlpEngineBuilt()));
+    connect(&m_preview, SIGNAL(finished()), SLOT(onResponsePreviewFinished()));
+
+    m_commitTimer->setSingleShot(true);
+    m_commitTimer->setInterval(RULES_COMMIT_DELAY);
+    connect(m_commitTimer, SIGNAL(timeout()), SLOT(onCommitTimeout()));
+
+    m_loadTimer.invalidate();
+
     setNlpEngineOptions(defaultNlpOptions());
 
     setupChatbot();
+
+    setupHttpEndpoint();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::setupHttpEndpoint()
+{
+    quint16 port = Cmn::SettingsSnapshot::current().value(SETTING_HTTP_ENDPOINT_PORT).toUInt();
+
+    // Disabled by default
+    if (!port || !m_nlpEngine) {
+        return;
+    }
+
+    m_httpEndpoint = new HttpEndpoint(m_nlpEngine, this);
+
+    if (Cmn::SettingsSnapshot::current().value(SETTING_HTTP_ENDPOINT_METRICS).toBool()) {
+        m_httpEndpoint->setMetricsSource(this);
+    }
+
+    if (m_httpEndpoint->listen(port)) {
+        m_httpEndpoint->setEngineReady(isNlpEngineReady());
+    } else {
+        delete m_httpEndpoint;
+        m_httpEndpoint = 0;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -164,7 +369,9 @@ Lvk::BE::AppFacade::~AppFacade()
 
     close();
 
+    delete m_httpEndpoint; // Waits for lookups that use the engine
     delete m_chatbot;
+    m_clueEngine.clear();
     delete m_nlpEngine;
 }
 
@@ -197,6 +404,28 @@ QString Lvk::BE::AppFacade::getHistoryFilename()
     return getExtrasPath() + m_rules.chatbotId() + ".hist";
 }
 
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::BE::AppFacade::getNlpSnapshotFilename()
+{
+    return getExtrasPath() + m_rules.chatbotId() + ".snap";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::BE::AppFacade::getNlpSnapshotConfig() const
+{
+    // The snapshot depends on the NLP options and analysis profile used to compile rules.
+    // Snapshots of the full profile keep the config of previous versions.
+    QString config = QString::number(m_nlpOptions);
+
+    if ((m_nlpOptions & LemmatizeSentence) && !m_analysisProfile.isFull()) {
+        config += "|" + m_analysisProfile.toString();
+    }
+
+    return config;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Rules files
 //--------------------------------------------------------------------------------------------------
@@ -207,6 +436,8 @@ bool Lvk::BE::AppFacade::newFile(const QString &filename)
 
     close();
 
+    m_loadTimer.start();
+
     if (setDefaultRules() && setDefaultNlpOptions()) {
         created = m_rules.saveAs(filename);
     }
@@ -229,6 +460,8 @@ bool Lvk::BE::AppFacade::load(const QString &filename)
 
     close();
 
+    m_loadTimer.start();
+
     if (!filename.isEmpty()) {
         loaded = m_rules.load(filename);
     }
@@ -240,6 +473,7 @@ bool Lvk::BE::AppFacade::load(const QString &filename)
     } else {
         close();
         setupChatbot();
+        Cmn::StartupTimeline::finish();
     }
 
     return loaded;
@@ -325,6 +559,8 @@ bool Lvk::BE::AppFacade::generalSetup()
     setNlpEngineOptions(m_rules.metadata(FILE_METADATA_NLP_OPTIONS).toUInt());
     setupChatbot();
     refreshNlpEngine();
+    buildNlpEngine();
+    warmUpNlpEngine();
 
 #ifdef DA_CONTEST
     m_scriptMgr.setScriptFormat(Clue::XmlObfuscated);
@@ -341,6 +577,8 @@ bool Lvk::BE::AppFacade::generalSetup()
 
 bool Lvk::BE::AppFacade::save()
 {
+    commitRuleChanges();
+
     return m_rules.save();
 }
 
@@ -348,6 +586,8 @@ bool Lvk::BE::AppFacade::save()
 
 bool Lvk::BE::AppFacade::saveAs(const QString &filename)
 {
+    flushRuleChanges();
+
     bool saved = m_rules.saveAs(filename);
 
     if (saved) {
@@ -370,8 +610,20 @@ bool Lvk::BE::AppFacade::hasUnsavedChanges() const
 
 void Lvk::BE::AppFacade::close()
 {
+    // Changes are saved, but nobody is notified while closing
+    flushRuleChanges();
+
+    waitForNlpEngine();
+
+    cancelResponsePreview();
+    waitForResponsePreview();
+    delete m_previewSession;
+    m_previewSession = 0;
+    m_previewSessionStale = false;
+
 #ifdef DA_CONTEST
     m_scriptMgr.clear();
+    m_clueEngine.clear();
 #endif
 
     // If chatbot never saved
@@ -387,7 +639,15 @@ void Lvk::BE::AppFacade::close()
     }
 
     if (m_nlpEngine) {
+        // Log latency stats and memory of the chatbot being closed, then reset stats
+        m_rlogh.logNlpStats(m_nlpEngine->property(NLP_PROP_STATS).toMap());
+        m_nlpEngine->setProperty(NLP_PROP_STATS, QVariant());
+        m_rlogh.logNlpMemory(m_nlpEngine->property(NLP_PROP_MEMORY).toMap());
+        m_rlogh.logNlpShadow(m_nlpEngine->property(NLP_PROP_SHADOW_STATS).toMap());
+        m_nlpEngine->setProperty(NLP_PROP_SHADOW_STATS, QVariant());
+
         m_nlpEngine->clear();
+        m_nlpRules.clear();
     }
 
     if (m_chatbot) {
@@ -404,6 +664,9 @@ void Lvk::BE::AppFacade::close()
 
     Stats::StatsManager::manager()->setFilename("");
 
+    // Write chat history and corpus entries still pending
+    Cmn::Journal::journal()->drain();
+
     Cmn::CrashHandler::setUsername("");
 }
 
@@ -478,17 +741,27 @@ QString Lvk::BE::AppFacade::getResponse(const QString &input, const QString &tar
     QString response;
 
     if (m_nlpEngine) {
-        Nlp::Engine::MatchList nlpRulesMatched;
-        response = m_nlpEngine->getResponse(input, target, nlpRulesMatched);
+        Cmn::MaintenanceScheduler::Activity activity;
+
+        // Test conversations always use the latest rules, even if they are compiled in
+        // background
+        m_nlpEngine->build();
 
-        if (!nlpRulesMatched.isEmpty()) {
-            Nlp::RuleId ruleId = nlpRulesMatched.first().first;
-            int inputNumber = nlpRulesMatched.first().second;
-            matches.append(qMakePair(ruleId, inputNumber));
+        Nlp::Result result;
+        m_nlpEngine->getResponse(input, target, result);
+        response = result.output;
+
+        if (m_firstReply) {
+            m_firstReply = false;
+            if (m_loadTimer.isValid()) {
+                qDebug() << "First reply" << m_loadTimer.elapsed() << "ms after loading";
+            }
+        }
+
+        if (result.isValid()) {
+            matches.append(qMakePair(result.ruleId, result.inputIdx));
         } else {
-            QStringList evasives = getEvasives();
-            response = !evasives.isEmpty() ?
-                        evasives[Cmn::Random::getInt(0, evasives.size() - 1)] : "";
+            response = m_nlpEngine->getEvasive(target);
         }
     } else {
         qCritical("NLP engine not set");
@@ -499,6 +772,25 @@ QString Lvk::BE::AppFacade::getResponse(const QString &input, const QString &tar
 
 //--------------------------------------------------------------------------------------------------
 
+Lvk::Nlp::SearchExplain Lvk::BE::AppFacade::explainResponse(const QString &input,
+                                                           const QString &target) const
+{
+    Nlp::SearchExplain explain;
+
+    if (m_nlpEngine) {
+        Cmn::MaintenanceScheduler::Activity activity;
+
+        m_nlpEngine->build();
+        m_nlpEngine->explainResponse(input, target, explain);
+    } else {
+        qCritical("NLP engine not set");
+    }
+
+    return explain;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 quint64 Lvk::BE::AppFacade::getCurrentCategory(const QString &target) const
 {
     quint64 id = 0;
@@ -514,6 +806,7 @@ quint64 Lvk::BE::AppFacade::getCurrentCategory(const QString &target) const
 
 void Lvk::BE::AppFacade::refreshNlpEngine()
 {
+    LVK_STARTUP_PHASE("nlp_refresh");
 
     m_evasivesRule = 0;
     m_targets.clear();
@@ -521,11 +814,479 @@ void Lvk::BE::AppFacade::refreshNlpEngine()
     if (m_nlpEngine) {
         Nlp::RuleList nlpRules;
         buildNlpRulesOf(m_rules.rootRule(), nlpRules);
-        m_nlpEngine->setRules(nlpRules);
+        publishNlpRules(nlpRules);
         refreshEvasives();
+        m_previewSessionStale = true;
+
+        if (m_httpEndpoint) {
+            m_httpEndpoint->setEngineReady(isNlpEngineReady());
+        }
+    } else {
+        qCritical("NLP engine not set");
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::markRulesChanged()
+{
+    m_rulesChanged = true;
+    m_commitTimer->start(); // Restarts the delay if it is already active
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::AppFacade::commitRuleChanges()
+{
+    if (!m_rulesChanged) {
+        return true;
+    }
+
+    bool saved = flushRuleChanges();
+
+    emit rulesCommitted();
+
+    return saved;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::AppFacade::flushRuleChanges()
+{
+    if (!m_rulesChanged) {
+        return true;
+    }
+
+    m_rulesChanged = false;
+    m_commitTimer->stop();
+
+    refreshNlpEngine();
+
+    // Chatbots never saved are saved with saveAs()
+    return m_rules.filename().isEmpty() || m_rules.save();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::onCommitTimeout()
+{
+    if (!commitRuleChanges()) {
+        qCritical() << "AppFacade: Cannot save rule changes";
+    }
+}
+
+Lvk::Nlp::RuleIssueList Lvk::BE::AppFacade::lintRules()
+{
+    Nlp::RuleIssueList issues;
+
+    if (m_nlpEngine) {
+        refreshNlpEngine();
+        waitForNlpEngine();
+
+        m_nlpEngine->lintRules(issues);
+    } else {
+        qCritical("NLP engine not set");
+    }
+
+    return issues;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::RuleCostList Lvk::BE::AppFacade::profileRules()
+{
+    Nlp::RuleCostList costs;
+
+    if (m_nlpEngine) {
+        refreshNlpEngine();
+        waitForNlpEngine();
+
+        m_nlpEngine->profileRules(costs);
     } else {
         qCritical("NLP engine not set");
     }
+
+    return costs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::BE::AppFacade::nlpMemoryReport()
+{
+    QVariantMap report;
+
+    if (m_nlpEngine) {
+        waitForNlpEngine();
+
+        report = m_nlpEngine->property(NLP_PROP_MEMORY).toMap();
+    } else {
+        qCritical("NLP engine not set");
+    }
+
+    return report;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::BE::AppFacade::nlpStats() const
+{
+    return m_nlpEngine ? m_nlpEngine->property(NLP_PROP_STATS).toMap() : QVariantMap();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::BE::AppFacade::admissionStats() const
+{
+    const CA::XmppChatbot *chatbot = qobject_cast<const CA::XmppChatbot *>(m_chatbot);
+
+    return chatbot ? chatbot->admissionStats().toVariantMap() : QVariantMap();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::AppFacade::compileNlpSnapshot(const QString &filename)
+{
+    if (!m_nlpEngine) {
+        qCritical("NLP engine not set");
+        return false;
+    }
+
+    waitForNlpEngine();
+
+    // The engine may have been built from a snapshot, setting the same rules discards it
+    m_nlpEngine->setRules(m_nlpEngine->rules());
+
+    // Same config as buildNlpEngine(), otherwise the chatbot ignores the snapshot
+    return m_nlpEngine->saveSnapshot(filename, getNlpSnapshotConfig());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::BE::AppFacade::openMetrics() const
+{
+    QByteArray text;
+
+    text += "# TYPE lvk_chat_messages counter\n"
+            "# HELP lvk_chat_messages Chat messages received from contacts and replied.\n";
+    for (int t = FbChat; t <= GTalkChat; ++t) {
+        QByteArray chat = chatTypeLabel(t);
+        appendSample(text, "lvk_chat_messages_total", chat + ",direction=\"in\"",
+                     (int)m_chatCounters[t].received);
+        appendSample(text, "lvk_chat_messages_total", chat + ",direction=\"out\"",
+                     (int)m_chatCounters[t].replied);
+    }
+
+    text += "# TYPE lvk_chat_responses counter\n"
+            "# HELP lvk_chat_responses Responses of a rule and of the evasives rule.\n";
+    for (int t = FbChat; t <= GTalkChat; ++t) {
+        QByteArray chat = chatTypeLabel(t);
+        appendSample(text, "lvk_chat_responses_total", chat + ",kind=\"matched\"",
+                     (int)m_chatCounters[t].matched);
+        appendSample(text, "lvk_chat_responses_total", chat + ",kind=\"evasive\"",
+                     (int)m_chatCounters[t].evasive);
+    }
+
+    text += "# TYPE lvk_chat_connections counter\n"
+            "# HELP lvk_chat_connections Times the chatbot has connected.\n";
+    appendSample(text, "lvk_chat_connections_total", "", (int)m_connections);
+
+    text += "# TYPE lvk_conversation_pending_entries gauge\n"
+            "# HELP lvk_conversation_pending_entries Entries waiting for stats and UI.\n";
+    appendSample(text, "lvk_conversation_pending_entries", "", m_pendingEntries.size());
+
+    QVariantMap admission = admissionStats();
+
+    if (!admission.isEmpty()) {
+        const char *DECISIONS[] = { "accepted", "accepted", "rateLimited", "rate_limited",
+                                    "duplicates", "duplicate", "oversized", "oversized",
+                                    "shed", "shed" };
+
+        text += "# TYPE lvk_chat_admissions counter\n"
+                "# HELP lvk_chat_admissions Messages received by decision of the flood "
+                "protection.\n";
+        for (unsigned i = 0; i < sizeof(DECISIONS)/sizeof(DECISIONS[0]); i += 2) {
+            appendSample(text, "lvk_chat_admissions_total",
+                         QByteArray("decision=\"") + DECISIONS[i + 1] + "\"",
+                         admission[DECISIONS[i]].toInt());
+        }
+    }
+
+    // Engine stats are lock-free histograms and counters
+    QVariantMap stats = nlpStats();
+    QVariantMap cache = stats.take("cache").toMap();
+
+    if (!stats.isEmpty()) {
+        const char *QUANTILES[] = { "p50", "0.5", "p90", "0.9", "p99", "0.99" };
+
+        text += "# TYPE lvk_nlp_latency_seconds summary\n"
+                "# HELP lvk_nlp_latency_seconds Latency of each stage of the NLP engine.\n";
+        for (QVariantMap::const_iterator it = stats.constBegin(); it != stats.constEnd(); ++it) {
+            QVariantMap stage = it.value().toMap();
+            QByteArray label = "stage=\"" + it.key().toUtf8() + "\"";
+
+            for (unsigned i = 0; i < sizeof(QUANTILES)/sizeof(QUANTILES[0]); i += 2) {
+                appendSample(text, "lvk_nlp_latency_seconds",
+                             label + ",quantile=\"" + QUANTILES[i + 1] + "\"",
+                             stage[QUANTILES[i]].toLongLong()/1e6);
+            }
+            appendSample(text, "lvk_nlp_latency_seconds_count", label, stage["count"].toInt());
+        }
+    }
+
+    if (!cache.isEmpty()) {
+        text += "# TYPE lvk_nlp_cache_lookups counter\n"
+                "# HELP lvk_nlp_cache_lookups Lookups in the response cache of the NLP engine.\n";
+        appendSample(text, "lvk_nlp_cache_lookups_total", "result=\"hit\"",
+                     cache["hits"].toInt());
+        appendSample(text, "lvk_nlp_cache_lookups_total", "result=\"miss\"",
+                     cache["misses"].toInt());
+    }
+
+    // Only engines with a shadow engine have comparisons
+    QVariantMap shadow = m_nlpEngine ? m_nlpEngine->property(NLP_PROP_SHADOW_STATS).toMap()
+                                     : QVariantMap();
+
+    if (!shadow.isEmpty()) {
+        const char *OUTCOMES[] = { "match", "rule_mismatch", "output_mismatch", "dropped" };
+
+        text += "# TYPE lvk_nlp_shadow_comparisons counter\n"
+                "# HELP lvk_nlp_shadow_comparisons Replies compared with the shadow engine.\n";
+        for (unsigned i = 0; i < sizeof(OUTCOMES)/sizeof(OUTCOMES[0]); ++i) {
+            appendSample(text, "lvk_nlp_shadow_comparisons_total",
+                         QByteArray("outcome=\"") + OUTCOMES[i] + "\"",
+                         shadow[OUTCOMES[i]].toInt());
+        }
+
+        const char *ENGINES[] = { "primary", "shadow" };
+        const char *QUANTILES[] = { "p50", "0.5", "p90", "0.9", "p99", "0.99" };
+
+        text += "# TYPE lvk_nlp_shadow_latency_seconds summary\n"
+                "# HELP lvk_nlp_shadow_latency_seconds Latency of each engine on compared "
+                "replies.\n";
+        for (unsigned e = 0; e < sizeof(ENGINES)/sizeof(ENGINES[0]); ++e) {
+            QVariantMap latency = shadow[ENGINES[e]].toMap();
+            QByteArray label = QByteArray("engine=\"") + ENGINES[e] + "\"";
+
+            for (unsigned i = 0; i < sizeof(QUANTILES)/sizeof(QUANTILES[0]); i += 2) {
+                appendSample(text, "lvk_nlp_shadow_latency_seconds",
+                             label + ",quantile=\"" + QUANTILES[i + 1] + "\"",
+                             latency[QUANTILES[i]].toLongLong()/1e6);
+            }
+            appendSample(text, "lvk_nlp_shadow_latency_seconds_count", label,
+                         latency["count"].toInt());
+        }
+    }
+
+    text += "# EOF\n";
+
+    return text;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QList<QStringList> Lvk::BE::AppFacade::groupSimilarInputs(const QStringList &inputs)
+{
+    QList<Nlp::WordList> words;
+    Nlp::GlobalTools::instance()->lemmatizeBatch(inputs, words);
+
+    QList<QStringList> groups;
+    QList< QSet<QString> > groupLemmas;  // Lemmas of the first input of each group
+    QHash<QString, QList<int> > lemmaGroups; // Groups that contain each lemma
+
+    for (int i = 0; i < inputs.size(); ++i) {
+        QSet<QString> lemmas = lemmaSet(words.value(i));
+
+        // Count the lemmas shared with each group using the index of lemmas
+        QHash<int, int> shared;
+        foreach (const QString &lemma, lemmas) {
+            foreach (int g, lemmaGroups.value(lemma)) {
+                ++shared[g];
+            }
+        }
+
+        int best = -1;
+        double bestSimilarity = 0;
+
+        for (QHash<int, int>::const_iterator it = shared.constBegin();
+             it != shared.constEnd(); ++it) {
+            // Jaccard index
+            int unionSize = lemmas.size() + groupLemmas[it.key()].size() - it.value();
+            double similarity = (double)it.value()/unionSize;
+
+            if (similarity > bestSimilarity || (similarity == bestSimilarity && it.key() < best)) {
+                best = it.key();
+                bestSimilarity = similarity;
+            }
+        }
+
+        if (best != -1 && bestSimilarity >= MIN_INPUT_SIMILARITY) {
+            groups[best].append(inputs[i]);
+        } else {
+            foreach (const QString &lemma, lemmas) {
+                lemmaGroups[lemma].append(groups.size());
+            }
+            groups.append(QStringList() << inputs[i]);
+            groupLemmas.append(lemmas);
+        }
+    }
+
+    return groups;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::buildNlpEngine()
+{
+    if (!m_nlpEngine) {
+        return;
+    }
+
+    // Chatbots never saved do not have snapshots
+    QString filename = !m_rules.filename().isEmpty() ? getNlpSnapshotFilename() : QString();
+
+    QString config = getNlpSnapshotConfig();
+
+    waitForResponsePreview();
+    m_previewSessionStale = true;
+
+    if (m_httpEndpoint) {
+        m_httpEndpoint->setEngineReady(false);
+    }
+
+    m_firstReply = true;
+    m_nlpBuild.setFuture(Cmn::TaskScheduler::scheduler()->run(Cmn::TaskScheduler::Build,
+                                                              buildEngine, m_nlpEngine,
+                                                              filename, config));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::warmUpNlpEngine()
+{
+    int size = Cmn::SettingsSnapshot::current().intValue(SETTING_NLP_LEMMA_WARM_UP_SIZE);
+
+    if (size <= 0 || !m_nlpEngine || !m_chatbot) {
+        return;
+    }
+
+    // Inputs restored from the persistent lemma cache only cost a cache lookup
+    QStringList inputs = mostFrequentInputs(m_chatbot->chatHistory(), size);
+
+    if (!inputs.isEmpty()) {
+        m_nlpEngine->setProperty(NLP_PROP_WARM_UP, inputs);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::waitForNlpEngine()
+{
+    m_nlpBuild.waitForFinished();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::AppFacade::isNlpEngineReady() const
+{
+    return !m_nlpBuild.isRunning();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::onNlpEngineBuilt()
+{
+    if (m_loadTimer.isValid()) {
+        qDebug() << "NLP engine ready" << m_loadTimer.elapsed() << "ms after loading";
+    }
+
+    // The first engine built ends the startup
+    if (Cmn::StartupTimeline::finish()) {
+        m_rlogh.logStartupTimeline(Cmn::StartupTimeline::toVariantMap());
+    }
+
+    if (m_httpEndpoint) {
+        m_httpEndpoint->setEngineReady(true);
+    }
+
+    emit nlpEngineReady();
+
+    if (m_previewPending && !m_preview.isRunning()) {
+        startResponsePreview();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::requestResponsePreview(const QString &input, const QString &target)
+{
+    commitRuleChanges();
+
+    m_pendingPreviewInput = input;
+    m_pendingPreviewTarget = target;
+    m_previewPending = true;
+
+    if (m_preview.isRunning()) {
+        // A running lookup cannot be interrupted, its results are discarded when it finishes
+        m_previewOutdated = true;
+    } else if (isNlpEngineReady()) {
+        startResponsePreview();
+    }
+    // else onNlpEngineBuilt() starts the preview
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::cancelResponsePreview()
+{
+    m_previewPending = false;
+    m_previewOutdated = m_preview.isRunning();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::startResponsePreview()
+{
+    m_previewPending = false;
+    m_previewOutdated = false;
+
+    if (!m_nlpEngine) {
+        qCritical("NLP engine not set");
+        return;
+    }
+
+    if (m_previewSessionStale) {
+        delete m_previewSession;
+        m_previewSession = 0;
+        m_previewSessionStale = false;
+    }
+
+    m_previewInput = m_pendingPreviewInput;
+    m_previewTarget = m_pendingPreviewTarget;
+
+    m_preview.setFuture(Cmn::TaskScheduler::scheduler()->run(Cmn::TaskScheduler::Preview,
+                                                             previewResponses, m_nlpEngine,
+                                                             &m_previewSession, m_previewInput,
+                                                             m_previewTarget));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::waitForResponsePreview()
+{
+    m_preview.waitForFinished();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::onResponsePreviewFinished()
+{
+    if (!m_previewOutdated) {
+        emit responsePreviewReady(m_previewInput, m_previewTarget, m_preview.result());
+    }
+
+    if (m_previewPending) {
+        startResponsePreview();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -556,6 +1317,82 @@ void Lvk::BE::AppFacade::buildNlpRulesOf(const BE::Rule *parentRule, Nlp::RuleLi
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::BE::AppFacade::publishNlpRules(const Nlp::RuleList &nlpRules)
+{
+    QHash<Nlp::RuleId, Nlp::Rule> rules;
+    rules.reserve(nlpRules.size());
+
+    foreach (const Nlp::Rule &rule, nlpRules) {
+        rules.insert(rule.id(), rule);
+    }
+
+    // Rebuilding is cheaper than many incremental updates. If IDs are not unique the diff
+    // cannot be computed.
+    bool rebuild = m_nlpRules.isEmpty() || rules.size() != nlpRules.size();
+
+    // Rules compiled with another profile would not match inputs analyzed with the new one
+    if (m_autoAnalysisProfile && (m_nlpOptions & LemmatizeSentence)) {
+        Nlp::AnalysisProfile profile = Nlp::AnalysisProfile::fromRules(nlpRules);
+
+        if (profile != m_analysisProfile) {
+            qDebug() << "AppFacade: Analysis profile" << profile.toString();
+
+            m_analysisProfile = profile;
+            m_nlpEngine->setLemmatizer(Nlp::LemmatizerFactory().createLemmatizer(QString(),
+                                                                                 profile));
+            rebuild = true;
+        }
+    }
+
+    Nlp::RuleList added;
+    Nlp::RuleList changed;
+    QList<Nlp::RuleId> removed;
+
+    if (!rebuild) {
+        foreach (const Nlp::Rule &rule, nlpRules) {
+            QHash<Nlp::RuleId, Nlp::Rule>::const_iterator it = m_nlpRules.find(rule.id());
+
+            if (it == m_nlpRules.end()) {
+                added.append(rule);
+            } else if (*it != rule) {
+                changed.append(rule);
+            }
+        }
+
+        for (QHash<Nlp::RuleId, Nlp::Rule>::const_iterator it = m_nlpRules.begin();
+             it != m_nlpRules.end(); ++it) {
+            if (!rules.contains(it.key())) {
+                removed.append(it.key());
+            }
+        }
+
+        rebuild = added.size() + changed.size() + removed.size() > nlpRules.size()/2;
+    }
+
+    if (rebuild) {
+        qDebug() << "AppFacade: Publishing" << nlpRules.size() << "NLP rules";
+
+        m_nlpEngine->setRules(nlpRules);
+    } else {
+        qDebug() << "AppFacade: Publishing NLP rules diff" << added.size() << "added"
+                 << changed.size() << "changed" << removed.size() << "removed";
+
+        foreach (Nlp::RuleId id, removed) {
+            m_nlpEngine->removeRule(id);
+        }
+        foreach (const Nlp::Rule &rule, changed) {
+            m_nlpEngine->updateRule(rule);
+        }
+        foreach (const Nlp::Rule &rule, added) {
+            m_nlpEngine->addRule(rule);
+        }
+    }
+
+    m_nlpRules = rules;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::BE::AppFacade::storeTargets(const TargetList &targets)
 {
     foreach (const Target &t, targets) {
@@ -567,7 +1404,8 @@ void Lvk::BE::AppFacade::storeTargets(const TargetList &targets)
 
 void Lvk::BE::AppFacade::refreshEvasives()
 {
-    dynamic_cast<AIAdapter *>(m_chatbot->AI())->setEvasives(getEvasives());
+    // Evasives are compiled by the engine, chatbots get them through it
+    m_nlpEngine->setEvasives(getEvasives(), QString());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -578,6 +1416,9 @@ void Lvk::BE::AppFacade::setNlpEngineOptions(unsigned options)
         return;
     }
 
+    waitForNlpEngine();
+    waitForResponsePreview();
+
     if ((options & RemoveDupChars) && !(m_nlpOptions & RemoveDupChars)) {
         m_nlpEngine->setPreSanitizer(Nlp::SanitizerFactory().createPreSanitizer());
     }
@@ -586,7 +1427,8 @@ void Lvk::BE::AppFacade::setNlpEngineOptions(unsigned options)
     }
 
     if ((options & LemmatizeSentence) && !(m_nlpOptions & LemmatizeSentence)) {
-        m_nlpEngine->setLemmatizer(Nlp::LemmatizerFactory().createLemmatizer());
+        m_nlpEngine->setLemmatizer(Nlp::LemmatizerFactory().createLemmatizer(QString(),
+                                                                             m_analysisProfile));
     }
     if (!(options & LemmatizeSentence) && (m_nlpOptions & LemmatizeSentence)) {
         m_nlpEngine->setLemmatizer(0);
@@ -613,7 +1455,29 @@ void Lvk::BE::AppFacade::setNlpEngineOptions(unsigned options)
         m_nlpEngine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, false);
     }
 
+    if ((options & SplitSentences) && !(m_nlpOptions & SplitSentences)) {
+        m_nlpEngine->setProperty(NLP_PROP_SPLIT_SENTENCES, true);
+    }
+    if (!(options & SplitSentences) && (m_nlpOptions & SplitSentences)) {
+        m_nlpEngine->setProperty(NLP_PROP_SPLIT_SENTENCES, false);
+    }
+
+    // Without lemmatization nor post sanitization lemmas are equal to words, so comparing
+    // them is pointless
+    bool lemmaMatch = options & (LemmatizeSentence | SanitizePostLemma);
+    m_nlpEngine->setProperty(NLP_PROP_LEMMA_MATCH, lemmaMatch);
+
     m_nlpOptions = options;
+    m_previewSessionStale = true;
+
+    if (m_httpEndpoint) {
+        m_httpEndpoint->setEngineReady(isNlpEngineReady());
+    }
+
+#ifdef DA_CONTEST
+    // Options change how every line is matched, rules are analyzed again as if they were new
+    m_clueEngine.clear();
+#endif
 
     if (m_rules.metadata(FILE_METADATA_NLP_OPTIONS).toUInt() != options) {
         m_rules.setMetadata(FILE_METADATA_NLP_OPTIONS, options);
@@ -739,6 +1603,23 @@ void Lvk::BE::AppFacade::connectToChat(const QString &passwd)
 void Lvk::BE::AppFacade::connectToChat(Lvk::BE::ChatType type, const QString &user,
                                        const QString &passwd)
 {
+    // Reuse the session opened to verify the account, which is already authenticated and has
+    // the roster
+    CA::Chatbot *session = m_account.takeSession(type, user, passwd);
+
+    if (session) {
+        qDebug() << "AppFacade: Reusing verified chat session of" << user;
+
+        deleteCurrentChatbot();
+        m_currentChatbotType = type;
+        m_chatbot = session;
+        configureChatbot();
+
+        // Emit connected() asynchronously as if the chatbot had connected
+        QMetaObject::invokeMethod(this, "onConnected", Qt::QueuedConnection);
+        return;
+    }
+
     setupChatbot(type);
 
     m_chatbot->connectToServer(user, passwd);
@@ -781,19 +1662,29 @@ void Lvk::BE::AppFacade::setupChatbot(ChatType type)
     if (!m_chatbot) {
         m_currentChatbotType = type;
         m_chatbot = BE::ChatbotFactory().createChatbot(m_rules.chatbotId(), type);
-        m_chatbot->setAI(new AIAdapter(m_rules.chatbotId(), m_nlpEngine));
-        m_chatbot->setBlackListRoster(toChatbotRoster(blackRoster()));
-        m_chatbot->setHistoryFilename(getHistoryFilename());
+        configureChatbot();
+    }
+}
 
-        refreshEvasives();
+//--------------------------------------------------------------------------------------------------
 
-        // FIXME add method to remap Chatbot error codes to AppFacade error codes
-        connect(m_chatbot, SIGNAL(error(int)),     SIGNAL(connectionError(int)));
-        connect(m_chatbot, SIGNAL(connected()),    SLOT(onConnected()));
-        connect(m_chatbot, SIGNAL(disconnected()), SLOT(onDisconnected()));
-        connect(m_chatbot, SIGNAL(newConversationEntry(Cmn::Conversation::Entry)),
-                SLOT(onConversationEntry(Cmn::Conversation::Entry)));
-    }
+void Lvk::BE::AppFacade::configureChatbot()
+{
+    m_chatbot->setAI(new AIAdapter(m_rules.chatbotId(), m_nlpEngine));
+    m_chatbot->setBlackListRoster(toChatbotRoster(blackRoster()));
+    m_chatbot->setHistoryFilename(getHistoryFilename());
+
+    // FIXME add method to remap Chatbot error codes to AppFacade error codes
+    connect(m_chatbot, SIGNAL(error(int)),     SIGNAL(connectionError(int)));
+    connect(m_chatbot, SIGNAL(connected()),    SLOT(onConnected()));
+    connect(m_chatbot, SIGNAL(disconnected()), SLOT(onDisconnected()));
+    connect(m_chatbot, SIGNAL(newConversationEntry(Cmn::Conversation::Entry)),
+            SLOT(onConversationEntry(Cmn::Conversation::Entry)));
+    connect(m_chatbot, SIGNAL(contactAdded(CA::ContactInfo)),
+            SLOT(onContactAdded(CA::ContactInfo)));
+    connect(m_chatbot, SIGNAL(contactChanged(CA::ContactInfo)),
+            SLOT(onContactChanged(CA::ContactInfo)));
+    connect(m_chatbot, SIGNAL(contactRemoved(QString)), SIGNAL(rosterItemRemoved(QString)));
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -808,6 +1699,13 @@ void Lvk::BE::AppFacade::deleteCurrentChatbot()
 
 void Lvk::BE::AppFacade::onConnected()
 {
+    // Rule edits must not delay replies to contacts
+    if (m_nlpEngine) {
+        m_nlpEngine->setProperty(NLP_PROP_ASYNC_RELOAD, true);
+    }
+
+    m_connections.fetchAndAddRelaxed(1);
+
     Stats::StatsManager::manager()->startTicking();
     emit connected();
     m_rlogh.logChatbotConnected(true);
@@ -817,6 +1715,10 @@ void Lvk::BE::AppFacade::onConnected()
 
 void Lvk::BE::AppFacade::onDisconnected()
 {
+    if (m_nlpEngine) {
+        m_nlpEngine->setProperty(NLP_PROP_ASYNC_RELOAD, false);
+    }
+
     Stats::StatsManager::manager()->stopTicking();
     emit disconnected();
     m_rlogh.logChatbotConnected(false);
@@ -826,8 +1728,53 @@ void Lvk::BE::AppFacade::onDisconnected()
 
 void Lvk::BE::AppFacade::onConversationEntry(const Cmn::Conversation::Entry &entry)
 {
-    Stats::StatsManager::manager()->updateScoreWith(entry);
-    emit newConversationEntry(entry);
+    if (!entry.from.startsWith(OWN_MESSAGE_TOKEN)) {
+        ChatCounters &c = m_chatCounters[m_currentChatbotType == FbChat ? FbChat : GTalkChat];
+
+        c.received.fetchAndAddRelaxed(1);
+
+        if (!entry.response.isEmpty()) {
+            c.replied.fetchAndAddRelaxed(1);
+            (entry.match ? c.matched : c.evasive).fetchAndAddRelaxed(1);
+        }
+    }
+
+    m_pendingEntries.append(entry);
+
+    if (!m_entriesScheduled) {
+        m_entriesScheduled = true;
+        QTimer::singleShot(0, this, SLOT(onPendingEntries()));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Entries received in a burst go through the stats and then to the UI in batches. Strings
+// are implicitly shared, so entries are not copied along the way. If the event loop lags,
+// entries wait in the queue and each pass handles at most ENTRY_BATCH_SIZE of them, so input
+// events are processed between batches.
+void Lvk::BE::AppFacade::onPendingEntries()
+{
+    QList<Cmn::Conversation::Entry> batch;
+
+    if (m_pendingEntries.size() <= ENTRY_BATCH_SIZE) {
+        batch.swap(m_pendingEntries);
+    } else {
+        batch = m_pendingEntries.mid(0, ENTRY_BATCH_SIZE);
+        m_pendingEntries = m_pendingEntries.mid(ENTRY_BATCH_SIZE);
+    }
+
+    m_entriesScheduled = !m_pendingEntries.isEmpty();
+
+    if (m_entriesScheduled) {
+        QTimer::singleShot(0, this, SLOT(onPendingEntries()));
+    }
+
+    Stats::StatsManager::manager()->updateScoreWith(batch);
+
+    foreach (const Cmn::Conversation::Entry &entry, batch) {
+        emit newConversationEntry(entry);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -853,6 +1800,20 @@ Lvk::BE::Roster Lvk::BE::AppFacade::roster()
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::BE::AppFacade::onContactAdded(const CA::ContactInfo &info)
+{
+    emit rosterItemAdded(BE::RosterItem(info.username, info.fullname));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::AppFacade::onContactChanged(const CA::ContactInfo &info)
+{
+    emit rosterItemChanged(BE::RosterItem(info.username, info.fullname));
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::BE::AppFacade::setRoster(const BE::Roster &roster)
 {
     Stats::StatsManager::manager()->setMetric(Stats::RosterSize, roster.size());
@@ -889,6 +1850,14 @@ const Lvk::Cmn::Conversation & Lvk::BE::AppFacade::chatHistory()
 
 //--------------------------------------------------------------------------------------------------
 
+Lvk::Cmn::Conversation Lvk::BE::AppFacade::chatHistory(const QDateTime &from,
+                                                      const QDateTime &to)
+{
+    return m_chatbot->chatHistory(from, to);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::BE::AppFacade::clearChatHistory()
 {
     m_chatbot->clearHistory();
@@ -898,14 +1867,14 @@ void Lvk::BE::AppFacade::clearChatHistory()
 
 void Lvk::BE::AppFacade::clearChatHistory(const QDate &date, const QString &user)
 {
-    Cmn::Conversation conv;
-    foreach (const Cmn::Conversation::Entry &entry, m_chatbot->chatHistory().entries()) {
-        if (entry.from != user || entry.dateTime.date() != date) {
-            conv.append(entry);
-        }
-    }
+    m_chatbot->removeChatHistory(date, user);
+}
+
+//--------------------------------------------------------------------------------------------------
 
-    m_chatbot->setChatHistory(conv);
+QString Lvk::BE::AppFacade::chatHistoryFilename()
+{
+    return getHistoryFilename();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -914,7 +1883,7 @@ void Lvk::BE::AppFacade::clearChatHistory(const QDate &date, const QString &user
 
 Lvk::Stats::Score Lvk::BE::AppFacade::currentScore()
 {
-    // TODO improve performance, do not update all the time
+    // Only rules that have changed since the last call are scored again
     Stats::StatsManager::manager()->updateScoreWith(rootRule());
 
     return Stats::StatsManager::manager()->currentScore();
@@ -938,6 +1907,8 @@ int Lvk::BE::AppFacade::scoreRemainingTime() const
 
 QString Lvk::BE::AppFacade::getTempFileForUpload()
 {
+    commitRuleChanges();
+
     return BE::ChatbotTempFile().getTempFileForUpload(m_rules.filename());
 }
 
@@ -988,19 +1959,33 @@ Lvk::Clue::AnalyzedList Lvk::BE::AppFacade::analyzedScripts()
 {
     refreshNlpEngine();
 
-    Clue::ClueEngine engine;
-    engine.setCategoriesEnabled(m_nlpOptions & BE::AppFacade::PreferCurCategory);
-    engine.setRules(m_nlpEngine->rules());
-    engine.setEvasive(getEvasives().isEmpty() ? "" : getEvasives().first());
+    m_clueEngine.clear();
+    m_clueEngine.setCategoriesEnabled(m_nlpOptions & BE::AppFacade::PreferCurCategory);
+    m_clueEngine.setEvasive(getEvasives().isEmpty() ? "" : getEvasives().first());
 
     Clue::AnalyzedList ascripts;
-    engine.analyze(m_scriptMgr.scripts(), ascripts);
+    m_clueEngine.analyze(m_scriptMgr.scripts(), ascripts);
 
     return ascripts;
 }
 
 //--------------------------------------------------------------------------------------------------
 
+Lvk::Clue::LineIndexList Lvk::BE::AppFacade::updateAnalyzedScripts(Clue::AnalyzedList &ascripts)
+{
+    refreshNlpEngine();
+
+    m_clueEngine.setCategoriesEnabled(m_nlpOptions & BE::AppFacade::PreferCurCategory);
+    m_clueEngine.setEvasive(getEvasives().isEmpty() ? "" : getEvasives().first());
+
+    Clue::LineIndexList changed;
+    m_clueEngine.reanalyze(m_nlpEngine->rules(), ascripts, &changed);
+
+    return changed;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool Lvk::BE::AppFacade::importScript(const QString &scriptFile)
 {
     return m_scriptMgr.import(scriptFile);
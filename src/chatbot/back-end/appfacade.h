@@ -28,9 +28,18 @@
 #include <QPair>
 #include <QVariant>
 #include <QSet>
+#include <QHash>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QByteArray>
 
 #include "back-end/chatbotrulesfile.h"
 #include "nlp-engine/rule.h"
+#include "nlp-engine/ruleissue.h"
+#include "nlp-engine/rulecost.h"
+#include "nlp-engine/analysisprofile.h"
+#include "nlp-engine/searchexplain.h"
 #include "back-end/chattype.h"
 #include "back-end/roster.h"
 #include "back-end/target.h"
@@ -42,11 +51,14 @@
 # include "da-clue/character.h"
 # include "da-clue/scriptmanager.h"
 # include "da-clue/analyzedscript.h"
+# include "da-clue/clueengine.h"
 #endif
 
 #include "common/conversation.h"
+#include "chat-adapter/contactinfo.h"
 
 class QFile;
+class QTimer;
 
 namespace Lvk
 {
@@ -74,6 +86,7 @@ namespace BE
 
 class Rule;
 class AIAdapter;
+class HttpEndpoint;
 
 /// \ingroup Lvk
 /// \addtogroup BE
@@ -201,6 +214,51 @@ public:
      */
     QString getResponse(const QString &input, const QString &target, MatchList &matches) const;
 
+    /**
+     * Explains how the NLP engine gets the response for the given \a input and \a target,
+     * without changing its state. \see Nlp::Engine::explainResponse()
+     */
+    Nlp::SearchExplain explainResponse(const QString &input, const QString &target) const;
+
+    /**
+     * The ResponseCandidate struct provides a possible response for an input, the rule that
+     * produces it and its matching score.
+     *
+     * \see requestResponsePreview
+     */
+    struct ResponseCandidate
+    {
+        ResponseCandidate(quint64 ruleId = 0, int inputIdx = 0, float score = 0,
+                          const QString &output = "")
+            : ruleId(ruleId), inputIdx(inputIdx), score(score), output(output) { }
+
+        quint64 ruleId; ///< The ID of the rule
+        int inputIdx;   ///< The index of the rule input that has matched
+        float score;    ///< The matching score
+        QString output; ///< The response
+    };
+
+    /**
+     * Provides a list of response candidates sorted by priority.
+     */
+    typedef QList<ResponseCandidate> ResponseCandidateList;
+
+    /**
+     * Requests in background the best responses for the given \a input and \a target.
+     *
+     * When the responses are ready the signal responsePreviewReady() is emitted. Unlike
+     * getResponse(), previews do not change the current category of \a target.
+     * If a preview is still running, the request is queued and replaces any other request
+     * queued before. Results of requests outdated by a newer one are discarded.
+     */
+    void requestResponsePreview(const QString &input, const QString &target);
+
+    /**
+     * Cancels all pending preview requests. The results of the preview running, if any, are
+     * discarded.
+     */
+    void cancelResponsePreview();
+
     /**
      * Returns then current category in the NLP engine for \a target
      */
@@ -208,10 +266,94 @@ public:
 
     /**
      * Refreshes the NLP engine. Invoke this method if the root rule or any other child rule has
-     * been changed.
+     * been changed. Only the rules added, removed or changed since the last refresh are sent
+     * to the engine.
      */
     void refreshNlpEngine();
 
+    /**
+     * Marks the rules as changed. Invoke this method after each rule edit instead of
+     * refreshNlpEngine() and save(). Changes are committed once no further changes are marked
+     * for a short while, so a sequence of edits costs one refresh and one save.
+     *
+     * \see commitRuleChanges(), rulesCommitted()
+     */
+    void markRulesChanged();
+
+    /**
+     * Commits the rule changes marked so far, if any: refreshes the NLP engine and saves the
+     * changed rules if the file has a name. Emits \a rulesCommitted if there were changes.
+     * Returns false if the changes could not be saved. Otherwise; returns true.
+     */
+    bool commitRuleChanges();
+
+    /**
+     * Analyzes the rules of the current file and returns the rule inputs that never match or
+     * that are shadowed by inputs of other rules.
+     */
+    Nlp::RuleIssueList lintRules();
+
+    /**
+     * Compiles the rules of the current file again and returns the cost of each rule, the
+     * costliest first. \see Nlp::Engine::profileRules()
+     */
+    Nlp::RuleCostList profileRules();
+
+    /**
+     * Returns the memory report of the NLP engine once it is built.
+     * \see Nlp::Cb2Engine::property()
+     */
+    QVariantMap nlpMemoryReport();
+
+    /**
+     * Returns the latency stats of the NLP engine. \see Nlp::EngineStats::toVariantMap()
+     */
+    QVariantMap nlpStats() const;
+
+    /**
+     * Returns the amount of messages received by the chatbot that were accepted, dropped or
+     * answered with an evasive by its flood protection. If there is no chatbot, returns an
+     * empty map. \see CA::AdmissionControl::Stats::toVariantMap()
+     */
+    QVariantMap admissionStats() const;
+
+    /**
+     * Compiles the rules of the current file from scratch and writes the compiled NLP engine
+     * to the snapshot \a filename, with the NLP options of the file. A chatbot with the same
+     * ID loads the snapshot instead of compiling its rules if the file is copied to its extras
+     * path as "<chatbot ID>.snap". Returns true on success. Otherwise; returns false.
+     */
+    bool compileNlpSnapshot(const QString &filename);
+
+    /**
+     * Returns the metrics of the application in OpenMetrics text format: messages received
+     * and replied per chat type, matched and evasive responses, chat connections, conversation
+     * entries waiting to be delivered, messages of each decision of the flood protection,
+     * latency of each stage of the NLP engine, lookups in its response cache and, if the
+     * engine has a shadow engine, the outcome and latencies of the comparisons. Counters are
+     * read without locking. \see Nlp::ShadowEngine
+     */
+    QByteArray openMetrics() const;
+
+    /**
+     * Groups \a inputs by similarity. Two inputs are similar if they share most of their
+     * lemmas. Returns the groups in the order of their first input.
+     */
+    QList<QStringList> groupSimilarInputs(const QStringList &inputs);
+
+    /**
+     * Returns true if the NLP engine finished building the rules of the current file.
+     * Otherwise; returns false. Rules are built in background after loading a file and
+     * getResponse() waits until they are built.
+     */
+    bool isNlpEngineReady() const;
+
+    /**
+     * Waits until the NLP engine finished building the rules of the current file.
+     * \see isNlpEngineReady()
+     */
+    void waitForNlpEngine();
+
     /**
      * NLP Engine Options
      */
@@ -220,7 +362,8 @@ public:
         LemmatizeSentence = 0x02,    ///< Lemmatize sentences
         SanitizePostLemma = 0x04,    ///< Sanitize post lemmatization  -- DEPRECATED --
         ExactMatchSupport = 0x08,    ///< Enable exact match support
-        PreferCurCategory = 0x10     ///< Prefer rules on the current category
+        PreferCurCategory = 0x10,    ///< Prefer rules on the current category
+        SplitSentences    = 0x20     ///< Match each sentence of a message apart
     };
 
     /**
@@ -313,6 +456,8 @@ public:
      * in that case call disconnectFromChat().
      * Emits \a connected on success. Otherwise; emits \a connectionError.
      * If the connection ends prematurely, emits \a disconnected.
+     * If the account was verified recently with the same credentials, the chat session opened
+     * by verifyAccount() is used instead of connecting again.
      */
     void connectToChat(ChatType chatType, const QString &user, const QString &passwd);
 
@@ -348,11 +493,18 @@ public:
     void setBlackRoster(const Roster &roster);
 
     /**
-     * Returns the chat history of the current chatbot. Before calling this method you
+     * Returns the recent chat history of the current chatbot. Before calling this method you
      * must \a load() a chatbot file.
      */
     const Cmn::Conversation &chatHistory();
 
+    /**
+     * Returns the chat history of the current chatbot between \a from (inclusive) and \a to
+     * (exclusive). A null \a from or \a to means no lower or upper bound respectively.
+     * Before calling this method you must \a load() a chatbot file.
+     */
+    Cmn::Conversation chatHistory(const QDateTime &from, const QDateTime &to);
+
     /**
      * Clears the chat history of the current chatbot. All persisted data is also deleted.
      */
@@ -363,6 +515,12 @@ public:
      */
     void clearChatHistory(const QDate &date, const QString &user);
 
+    /**
+     * Returns the file of the chat history of the current chatbot. The file may not exist.
+     * \see CA::HistoryHelper::Reader
+     */
+    QString chatHistoryFilename();
+
     /**
      * Returns the current score for the chatbot
      */
@@ -417,6 +575,13 @@ public:
      */
     Clue::AnalyzedList analyzedScripts();
 
+    /**
+     * Updates \a ascripts, the list returned by analyzedScripts(), after changing rules.
+     * Only lines that could be affected by the rules changed are analyzed again.
+     * Returns the list of lines that have changed.
+     */
+    Clue::LineIndexList updateAnalyzedScripts(Clue::AnalyzedList &ascripts);
+
     /**
      * Imports a script from \a scriptFile.
      * Returns true on success. Otherwise; false.
@@ -439,6 +604,14 @@ public:
 
 signals:
 
+    /**
+     * This signal is emitted when the NLP engine finished building the rules of the current
+     * file.
+     *
+     * \see isNlpEngineReady()
+     */
+    void nlpEngineReady();
+
     /**
      * This signal is emitted after invoking verifyAccount() if the account was verified.
      */
@@ -469,6 +642,7 @@ signals:
     /**
      * This signal is emitted whenever the chatbot receives a chat message. \a entry
      * contains the received message, the chatbot response and other useful information.
+     * Entries are delivered in order, after the stats were updated with them.
      * \see Cmn::Conversation::Entry
      */
     void newConversationEntry(const Cmn::Conversation::Entry &entry);
@@ -479,28 +653,103 @@ signals:
      */
     void scoreRemainingTime(int secs);
 
+    /**
+     * This signal is emitted whenever the \a current or the \a best score of the chatbot
+     * changes.
+     */
+    void scoreChanged(const Lvk::Stats::Score &current, const Lvk::Stats::Score &best);
+
+    /**
+     * This signal is emitted when \a item is added to the roster while the chatbot is
+     * connected.
+     */
+    void rosterItemAdded(const BE::RosterItem &item);
+
+    /**
+     * This signal is emitted when the information of roster \a item has changed while the
+     * chatbot is connected.
+     */
+    void rosterItemChanged(const BE::RosterItem &item);
+
+    /**
+     * This signal is emitted when the roster item with \a username is removed while the chatbot
+     * is connected.
+     */
+    void rosterItemRemoved(const QString &username);
+
+    /**
+     * This signal is emitted after invoking requestResponsePreview() when the response
+     * \a candidates for \a input and \a target are ready. If there is no match \a candidates
+     * is empty.
+     */
+    void responsePreviewReady(const QString &input, const QString &target,
+                              const BE::AppFacade::ResponseCandidateList &candidates);
+
+    /**
+     * This signal is emitted when the rule changes marked with markRulesChanged() have been
+     * committed. Scores and coverage that depend on the rules should be updated here.
+     */
+    void rulesCommitted();
+
 private slots:
     void onConnected();
     void onDisconnected();
     void onConversationEntry(const Cmn::Conversation::Entry &entry);
+    void onPendingEntries();
     void onAccountOk(const AccountVerifier::AccountInfo &info);
     void onAccountError(int err, const QString &msg);
+    void onContactAdded(const CA::ContactInfo &info);
+    void onContactChanged(const CA::ContactInfo &info);
+    void onNlpEngineBuilt();
+    void onResponsePreviewFinished();
+    void onCommitTimeout();
 
 private:
     AppFacade(AppFacade&);
     AppFacade& operator=(AppFacade&);
 
+    struct ChatCounters
+    {
+        QAtomicInt received;    // Messages from contacts
+        QAtomicInt replied;     // Responses sent
+        QAtomicInt matched;     // Responses of a rule
+        QAtomicInt evasive;     // Responses of the evasives rule
+    };
+
     ChatbotRulesFile m_rules;
     Rule *m_evasivesRule;
     Nlp::Engine *m_nlpEngine;
     CA::Chatbot *m_chatbot;
+    HttpEndpoint *m_httpEndpoint;               // Null unless enabled in settings
     ChatType m_currentChatbotType;
     QSet<QString> m_targets;
+    QHash<Nlp::RuleId, Nlp::Rule> m_nlpRules;   // Rules published to the NLP engine
+    QFutureWatcher<void> m_nlpBuild;
+    QFutureWatcher<ResponseCandidateList> m_preview;
+    Nlp::Engine *m_previewSession;              // Keeps topics of previews apart from tests
+    bool m_previewSessionStale;
+    QString m_previewInput;
+    QString m_previewTarget;
+    QString m_pendingPreviewInput;
+    QString m_pendingPreviewTarget;
+    bool m_previewPending;
+    bool m_previewOutdated;
+    QElapsedTimer m_loadTimer;
+    QTimer *m_commitTimer;                      // Delays commits of rule changes
+    bool m_rulesChanged;                        // Rule changes not committed yet
+    QList<Cmn::Conversation::Entry> m_pendingEntries; // Entries not delivered yet
+    bool m_entriesScheduled;
+    ChatCounters m_chatCounters[2];             // Indexed by ChatType
+    QAtomicInt m_connections;                   // Times the chatbot has connected
+    mutable bool m_firstReply;
     unsigned m_nlpOptions;
+    Nlp::AnalysisProfile m_analysisProfile;     // Profile of the lemmatizer of the engine
+    bool m_autoAnalysisProfile;                 // Profile derived from the rules
     RlogHelper m_rlogh;
     AccountVerifier m_account;
 #ifdef DA_CONTEST
     Clue::ScriptManager m_scriptMgr;
+    Clue::ClueEngine m_clueEngine;
 #endif
 
     void init();
@@ -511,12 +760,22 @@ private:
     QString getExtrasPath();
     QString getStatsFilename();
     QString getHistoryFilename();
+    QString getNlpSnapshotFilename();
+    QString getNlpSnapshotConfig() const;
+    void buildNlpEngine();
+    void warmUpNlpEngine();
+    void startResponsePreview();
+    void waitForResponsePreview();
     void buildNlpRulesOf(const Rule* parentRule, Nlp::RuleList &nlpRules);
+    void publishNlpRules(const Nlp::RuleList &nlpRules);
     void storeTargets(const TargetList &targets);
     void refreshEvasives();
+    bool flushRuleChanges();
     QStringList getEvasives() const;
     void setupChatbot();
     void setupChatbot(ChatType type);
+    void configureChatbot();
+    void setupHttpEndpoint();
     void deleteCurrentChatbot();
     void setRoster(const Roster &roster);
     void updateStats();
@@ -4,26 +4,40 @@ isEmpty(PROJECT_PATH) {
     PROJECT_PATH = .
 }
 
+QT += network
+
 HEADERS += \
     $$PROJECT_PATH/back-end/appfacade.h \
     $$PROJECT_PATH/back-end/rule.h \
+    $$PROJECT_PATH/back-end/rulehistory.h \
     $$PROJECT_PATH/back-end/roster.h \
     $$PROJECT_PATH/back-end/target.h \
     $$PROJECT_PATH/back-end/chatbotrulesfile.h \
+    $$PROJECT_PATH/back-end/mappedfile.h \
     $$PROJECT_PATH/back-end/aiadapter.h \
     $$PROJECT_PATH/back-end/rloghelper.h \
     $$PROJECT_PATH/back-end/accountverifier.h \
     $$PROJECT_PATH/back-end/chattype.h \
     $$PROJECT_PATH/back-end/chatbotfactory.h \
+    $$PROJECT_PATH/back-end/chatbothost.h \
     $$PROJECT_PATH/back-end/chatbottempfile.h \
     $$PROJECT_PATH/back-end/filemetadata.h \
+    $$PROJECT_PATH/back-end/httpendpoint.h \
+    $$PROJECT_PATH/back-end/rulecompiler.h \
+    $$PROJECT_PATH/back-end/phraseminer.h \
 
 SOURCES += \
     $$PROJECT_PATH/back-end/appfacade.cpp \
     $$PROJECT_PATH/back-end/rule.cpp \
+    $$PROJECT_PATH/back-end/rulehistory.cpp \
     $$PROJECT_PATH/back-end/chatbotrulesfile.cpp \
+    $$PROJECT_PATH/back-end/mappedfile.cpp \
     $$PROJECT_PATH/back-end/aiadapter.cpp \
     $$PROJECT_PATH/back-end/rloghelper.cpp \
     $$PROJECT_PATH/back-end/accountverifier.cpp \
     $$PROJECT_PATH/back-end/chatbotfactory.cpp \
+    $$PROJECT_PATH/back-end/chatbothost.cpp \
     $$PROJECT_PATH/back-end/chatbottempfile.cpp \
+    $$PROJECT_PATH/back-end/httpendpoint.cpp \
+    $$PROJECT_PATH/back-end/rulecompiler.cpp \
+    $$PROJECT_PATH/back-end/phraseminer.cpp \
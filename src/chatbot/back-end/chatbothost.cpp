@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "back-end/chatbothost.h"
+#include "back-end/chatbotfactory.h"
+#include "back-end/aiadapter.h"
+#include "chat-adapter/chatbot.h"
+#include "nlp-engine/engine.h"
+
+#include <QtDebug>
+
+//--------------------------------------------------------------------------------------------------
+// ChatbotHost::Session
+//--------------------------------------------------------------------------------------------------
+
+struct Lvk::BE::ChatbotHost::Session
+{
+    Session(const QString &id) : id(id), chatbot(0), engine(0), ai(0) { }
+
+    ~Session()
+    {
+        if (chatbot && chatbot->isConnected()) {
+            chatbot->disconnectFromServer();
+        }
+
+        // The chatbot owns the AI and the AI uses the engine
+        delete chatbot;
+        delete engine;
+    }
+
+    QString id;
+    CA::Chatbot *chatbot;
+    Nlp::Engine *engine;
+    AIAdapter *ai;
+    ChatbotHost::SessionStats stats;
+};
+
+//--------------------------------------------------------------------------------------------------
+// ChatbotHost
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::ChatbotHost::ChatbotHost(QObject *parent /*= 0*/)
+    : QObject(parent)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::ChatbotHost::~ChatbotHost()
+{
+    foreach (const QString &id, m_sessions.keys()) {
+        removeSession(id);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::ChatbotHost::addSession(const QString &sessionId, ChatType type,
+                                      Nlp::Engine *rules, const QString &historyFilename)
+{
+    if (m_sessions.contains(sessionId)) {
+        qWarning() << "ChatbotHost: Session already exists" << sessionId;
+        return false;
+    }
+
+    if (!rules) {
+        qCritical() << "ChatbotHost: No rules engine for session" << sessionId;
+        return false;
+    }
+
+    CA::Chatbot *chatbot = BE::ChatbotFactory().createChatbot(sessionId, type);
+
+    if (!chatbot) {
+        return false;
+    }
+
+    Session *s = new Session(sessionId);
+    s->chatbot = chatbot;
+    s->engine = rules->createSession();
+    s->ai = new AIAdapter(sessionId, s->engine);
+
+    s->chatbot->setAI(s->ai);
+
+    if (!historyFilename.isEmpty()) {
+        s->chatbot->setHistoryFilename(historyFilename);
+    }
+
+    connect(chatbot, SIGNAL(error(int)),     SLOT(onError(int)));
+    connect(chatbot, SIGNAL(connected()),    SLOT(onConnected()));
+    connect(chatbot, SIGNAL(disconnected()), SLOT(onDisconnected()));
+    connect(chatbot, SIGNAL(newConversationEntry(Cmn::Conversation::Entry)),
+            SLOT(onConversationEntry(Cmn::Conversation::Entry)));
+
+    m_sessions.insert(sessionId, s);
+    m_chatbots.insert(chatbot, s);
+
+    qDebug() << "ChatbotHost: Added session" << sessionId << "Sessions:" << m_sessions.size();
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::removeSession(const QString &sessionId)
+{
+    Session *s = m_sessions.take(sessionId);
+
+    if (s) {
+        // Do not emit signals of a session that no longer exists
+        s->chatbot->disconnect(this);
+        m_chatbots.remove(s->chatbot);
+        delete s;
+
+        qDebug() << "ChatbotHost: Removed session" << sessionId;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::ChatbotHost::hasSession(const QString &sessionId) const
+{
+    return m_sessions.contains(sessionId);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QStringList Lvk::BE::ChatbotHost::sessions() const
+{
+    return m_sessions.keys();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::Chatbot * Lvk::BE::ChatbotHost::chatbot(const QString &sessionId) const
+{
+    Session *s = m_sessions.value(sessionId);
+
+    return s ? s->chatbot : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Engine * Lvk::BE::ChatbotHost::engine(const QString &sessionId) const
+{
+    Session *s = m_sessions.value(sessionId);
+
+    return s ? s->engine : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::setEvasives(const QString &sessionId, const QStringList &evasives)
+{
+    Session *s = m_sessions.value(sessionId);
+
+    if (s) {
+        s->engine->setEvasives(evasives, QString());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::connectToChat(const QString &sessionId, const QString &user,
+                                         const QString &passwd)
+{
+    Session *s = m_sessions.value(sessionId);
+
+    if (s) {
+        s->chatbot->connectToServer(user, passwd);
+    } else {
+        qWarning() << "ChatbotHost: Cannot connect unknown session" << sessionId;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::disconnectFromChat(const QString &sessionId)
+{
+    Session *s = m_sessions.value(sessionId);
+
+    if (s) {
+        s->chatbot->disconnectFromServer();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::ChatbotHost::SessionStats Lvk::BE::ChatbotHost::stats(const QString &sessionId) const
+{
+    Session *s = m_sessions.value(sessionId);
+
+    return s ? s->stats : SessionStats();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::ChatbotHost::Session * Lvk::BE::ChatbotHost::senderSession()
+{
+    return m_chatbots.value(sender());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::onConnected()
+{
+    Session *s = senderSession();
+
+    if (s) {
+        emit connected(s->id);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::onDisconnected()
+{
+    Session *s = senderSession();
+
+    if (s) {
+        emit disconnected(s->id);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::onError(int err)
+{
+    Session *s = senderSession();
+
+    if (s) {
+        emit connectionError(s->id, err);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotHost::onConversationEntry(const Cmn::Conversation::Entry &entry)
+{
+    Session *s = senderSession();
+
+    if (s) {
+        ++s->stats.entries;
+        if (entry.match) {
+            ++s->stats.matched;
+        }
+
+        emit newConversationEntry(s->id, entry);
+    }
+}
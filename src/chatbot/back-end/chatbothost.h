@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_BE_CHATBOTHOST_H
+#define LVK_BE_CHATBOTHOST_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+#include "back-end/chattype.h"
+#include "common/conversation.h"
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+    class Engine;
+}
+
+namespace CA
+{
+    class Chatbot;
+}
+
+namespace BE
+{
+
+/// \ingroup Lvk
+/// \addtogroup BE
+/// @{
+
+/**
+ * \brief The ChatbotHost class runs several chatbot sessions in the same process.
+ *
+ * Each session is a chat connection (i.e. a Facebook or Gtalk account) with its own NLP engine
+ * session, history and stats. Sessions created with the same rules engine share the compiled
+ * rules and the NLP tools, so each new session only needs memory for its own state.
+ *
+ * Sessions are identified by a string given by the caller, for instance the chatbot ID.
+ *
+ * \see Nlp::Engine::createSession()
+ */
+
+class ChatbotHost : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Session stats
+     */
+    struct SessionStats
+    {
+        SessionStats() : entries(0), matched(0) { }
+
+        unsigned entries;   ///< Conversation entries since the session was added
+        unsigned matched;   ///< Conversation entries that matched a rule
+    };
+
+    /**
+     * Constructs a ChatbotHost object with parent object \a parent.
+     */
+    ChatbotHost(QObject *parent = 0);
+
+    /**
+     * Destroys the object. All sessions are disconnected and removed.
+     */
+    ~ChatbotHost();
+
+    /**
+     * Adds session \a sessionId of type \a type. The session gets responses from a new session
+     * of the engine \a rules. The chat history is stored in \a historyFilename.
+     * The host does not own \a rules and it must outlive the session.
+     * Returns true on success. Otherwise; if the session already exists or the type is not
+     * valid, returns false.
+     */
+    bool addSession(const QString &sessionId, ChatType type, Nlp::Engine *rules,
+                    const QString &historyFilename = QString());
+
+    /**
+     * Disconnects and removes session \a sessionId. If there is no such session, this method
+     * does nothing.
+     */
+    void removeSession(const QString &sessionId);
+
+    /**
+     * Returns true if there is a session \a sessionId. Otherwise; returns false.
+     */
+    bool hasSession(const QString &sessionId) const;
+
+    /**
+     * Returns the list of sessions.
+     */
+    QStringList sessions() const;
+
+    /**
+     * Returns the chatbot of session \a sessionId or null if there is no such session.
+     */
+    CA::Chatbot *chatbot(const QString &sessionId) const;
+
+    /**
+     * Returns the NLP engine of session \a sessionId or null if there is no such session.
+     */
+    Nlp::Engine *engine(const QString &sessionId) const;
+
+    /**
+     * Sets the list of \a evasives of session \a sessionId.
+     */
+    void setEvasives(const QString &sessionId, const QStringList &evasives);
+
+    /**
+     * Connects session \a sessionId to the chat server with user \a user, and password
+     * \a passwd. Emits \a connected on success. Otherwise; emits \a connectionError.
+     */
+    void connectToChat(const QString &sessionId, const QString &user, const QString &passwd);
+
+    /**
+     * Disconnects session \a sessionId from the chat server.
+     */
+    void disconnectFromChat(const QString &sessionId);
+
+    /**
+     * Returns the stats of session \a sessionId.
+     */
+    SessionStats stats(const QString &sessionId) const;
+
+signals:
+
+    /**
+     * This signal is emitted when session \a sessionId is connected.
+     */
+    void connected(const QString &sessionId);
+
+    /**
+     * This signal is emitted when the connection of session \a sessionId has ended.
+     */
+    void disconnected(const QString &sessionId);
+
+    /**
+     * This signal is emitted if there was an error in the connection of session
+     * \a sessionId. \a err is one of CA::XmppChatbot::Error.
+     */
+    void connectionError(const QString &sessionId, int err);
+
+    /**
+     * This signal is emitted whenever session \a sessionId receives a chat message.
+     * \see Cmn::Conversation::Entry
+     */
+    void newConversationEntry(const QString &sessionId, const Cmn::Conversation::Entry &entry);
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onError(int err);
+    void onConversationEntry(const Cmn::Conversation::Entry &entry);
+
+private:
+    ChatbotHost(ChatbotHost&);
+    ChatbotHost& operator=(ChatbotHost&);
+
+    struct Session;
+
+    QHash<QString, Session *> m_sessions;
+    QHash<QObject *, Session *> m_chatbots;  // Sessions by chatbot
+
+    Session *senderSession();
+};
+
+/// @}
+
+} // namespace BE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_BE_CHATBOTHOST_H
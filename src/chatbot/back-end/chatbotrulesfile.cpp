@@ -20,18 +20,31 @@
  */
 
 #include "back-end/chatbotrulesfile.h"
+#include "common/startuptimeline.h"
+#include "back-end/mappedfile.h"
 
 #include <QUuid>
 #include <QFile>
+#include <QFileInfo>
 #include <QDataStream>
+#include <QBuffer>
+#include <QPair>
+#include <QSet>
 #include <QtDebug>
 #include <exception>
 
 #define CRF_MAGIC_NUMBER            (('c'<<0) | ('r'<<8) | ('f'<<16) | ('\0'<<24))
-#define CRF_FILE_FORMAT_VERSION     2
+#define CRF_FILE_FORMAT_VERSION     3
+#define CRF_INDEXED_FORMAT_VERSION  3       // First version with indexed rule records
+
+#define CRF_LOG_MAGIC_NUMBER        (('c'<<0) | ('r'<<8) | ('l'<<16) | ('\0'<<24))
+#define CRF_LOG_HEADER_SIZE         10      // magic (4), payload size (4), checksum (2)
+
+#define COPY_CHUNK_SIZE             (64*1024)
 
 #define CEF_MAGIC_NUMBER            (('c'<<0) | ('e'<<8) | ('f'<<16) | ('\0'<<24))
-#define CEF_FILE_FORMAT_VERSION     2
+#define CEF_FILE_FORMAT_VERSION     3
+#define CEF_INDEXED_FORMAT_VERSION  3       // First version with indexed rule records
 
 
 //--------------------------------------------------------------------------------------------------
@@ -57,6 +70,160 @@ inline QString newChatbotId()
     return id;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+// Fixed-size record of a rule in the indexed format. Offsets are from the beginning of the file.
+struct RuleRecord
+{
+    RuleRecord()
+        : id(0), nextCatId(0), type(0), childCount(0),
+          nameOffset(0), nameSize(0), bodyOffset(0), bodySize(0) { }
+
+    quint64 id;
+    quint64 nextCatId;
+    qint32 type;
+    qint32 childCount;
+    quint32 nameOffset;
+    quint32 nameSize;
+    quint32 bodyOffset;
+    quint32 bodySize;
+};
+
+const int RULE_RECORD_SIZE = 2*sizeof(quint64) + 6*sizeof(quint32);
+
+inline QDataStream &operator<<(QDataStream &stream, const RuleRecord &r)
+{
+    return stream << r.id << r.nextCatId << r.type << r.childCount
+                  << r.nameOffset << r.nameSize << r.bodyOffset << r.bodySize;
+}
+
+inline QDataStream &operator>>(QDataStream &stream, RuleRecord &r)
+{
+    return stream >> r.id >> r.nextCatId >> r.type >> r.childCount
+                  >> r.nameOffset >> r.nameSize >> r.bodyOffset >> r.bodySize;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the amount of rules in the subtree of rule, including rule
+quint64 countRules(const Lvk::BE::Rule *rule)
+{
+    quint64 count = 1;
+
+    foreach (const Lvk::BE::Rule *child, rule->children()) {
+        count += countRules(child);
+    }
+
+    return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Assigns consecutive IDs to the subtree of rule starting from id
+void assignRuleIds(Lvk::BE::Rule *rule, quint64 &id)
+{
+    rule->setId(id++);
+
+    foreach (Lvk::BE::Rule *child, rule->children()) {
+        assignRuleIds(child, id);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Writes the attributes of a rule to the change log
+inline void writeLogRecord(QDataStream &stream, const Lvk::BE::Rule *rule)
+{
+    stream << rule->id() << (qint32)rule->type() << rule->nextCategory()
+           << rule->name() << rule->target() << rule->input() << rule->output();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Writes one record per rule of the subtree of root in depth-first order and the region with
+// the encoded strings. The strings region starts at offset base of the file.
+void writeRuleRecords(const Lvk::BE::Rule *root, quint32 base, QByteArray &records,
+                      QByteArray &strings)
+{
+    QBuffer sbuffer(&strings);
+    sbuffer.open(QIODevice::WriteOnly);
+    QDataStream sstream(&sbuffer);
+    sstream.setVersion(QDataStream::Qt_4_7);
+
+    QDataStream rstream(&records, QIODevice::WriteOnly);
+    rstream.setVersion(QDataStream::Qt_4_7);
+
+    for (Lvk::BE::Rule::const_iterator it = root->begin(); it != root->end(); ++it) {
+        const Lvk::BE::Rule *rule = *it;
+
+        RuleRecord r;
+        r.id = rule->id();
+        r.nextCatId = rule->nextCategory();
+        r.type = rule->type();
+        r.childCount = rule->childCount();
+
+        r.nameOffset = base + sbuffer.pos();
+        sstream << rule->name();
+        r.nameSize = base + sbuffer.pos() - r.nameOffset;
+
+        r.bodyOffset = base + sbuffer.pos();
+        sstream << rule->target() << rule->input() << rule->output();
+        r.bodySize = base + sbuffer.pos() - r.bodyOffset;
+
+        rstream << r;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Reads ruleCount records in depth-first order, the first one is root. Strings are not read,
+// rules decode them on demand from mapped. On success end is the end of the records and
+// the strings they refer to.
+bool readRuleRecords(QDataStream &istream, quint32 ruleCount,
+                     const QSharedPointer<Lvk::BE::MappedFile> &mapped, Lvk::BE::Rule *root,
+                     qint64 &end)
+{
+    using Lvk::BE::Rule;
+
+    QList< QPair<Rule *, int> > parents;    // Rules with children left to read
+
+    end = istream.device()->pos() + (qint64)ruleCount*RULE_RECORD_SIZE;
+
+    for (quint32 i = 0; i < ruleCount; ++i) {
+        RuleRecord r;
+        istream >> r;
+
+        if (istream.status() != QDataStream::Ok
+                || (qint64)r.nameOffset + r.nameSize > mapped->size()
+                || (qint64)r.bodyOffset + r.bodySize > mapped->size()
+                || (i > 0 && parents.isEmpty())) {
+            return false;
+        }
+
+        Rule *rule = i == 0 ? root : new Rule();
+        rule->setId(r.id);
+        rule->setNextCategory(r.nextCatId);
+        rule->setType(static_cast<Rule::Type>(r.type));
+        rule->setEncodedStrings(mapped, r.nameOffset, r.nameSize, r.bodyOffset, r.bodySize);
+
+        end = qMax(end, qMax((qint64)r.nameOffset + r.nameSize,
+                             (qint64)r.bodyOffset + r.bodySize));
+
+        if (i > 0) {
+            parents.last().first->appendChild(rule);
+            if (--parents.last().second == 0) {
+                parents.removeLast();
+            }
+        }
+
+        if (r.childCount > 0) {
+            parents.append(qMakePair(rule, (int)r.childCount));
+        }
+    }
+
+    return parents.isEmpty();
+}
+
 } // namespace
 
 
@@ -68,8 +235,12 @@ Lvk::BE::ChatbotRulesFile::ChatbotRulesFile()
     : m_dirty(false),
       m_rootRule(new Rule()),
       m_nextRuleId(1),
-      m_chatbotId(newChatbotId())
+      m_chatbotId(newChatbotId()),
+      m_baseSize(0),
+      m_logSize(0),
+      m_canAppend(false)
 {
+    resetTracker();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -78,8 +249,12 @@ Lvk::BE::ChatbotRulesFile::ChatbotRulesFile(const QString &filename)
     : m_dirty(false),
       m_rootRule(new Rule()),
       m_nextRuleId(1),
-      m_chatbotId(nullChatbotId())
+      m_chatbotId(nullChatbotId()),
+      m_baseSize(0),
+      m_logSize(0),
+      m_canAppend(false)
 {
+    resetTracker();
     if (!load(filename)) {
         throw std::exception();
     }
@@ -89,6 +264,8 @@ Lvk::BE::ChatbotRulesFile::ChatbotRulesFile(const QString &filename)
 
 bool Lvk::BE::ChatbotRulesFile::load(const QString &filename)
 {
+    LVK_STARTUP_PHASE("rules_load");
+
     if (!m_filename.isEmpty()) {
         close();
     }
@@ -106,7 +283,7 @@ bool Lvk::BE::ChatbotRulesFile::load(const QString &filename)
     }
 
     if (success) {
-        setAsSaved();
+        resetTracker();
     } else {
         close();
     }
@@ -118,19 +295,154 @@ bool Lvk::BE::ChatbotRulesFile::load(const QString &filename)
 
 bool Lvk::BE::ChatbotRulesFile::save()
 {
-    bool success = false;
+    bool success = canAppendChanges() ? appendChanges() : writeAll();
+
+    if (success) {
+        setAsSaved();
+        m_tracker.clear();
+    }
+
+    return success;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::ChatbotRulesFile::writeAll()
+{
+    // Rules still reference the strings of the mapped file we are about to replace
+    for (Rule::iterator it = m_rootRule->begin(); it != m_rootRule->end(); ++it) {
+        (*it)->decode();
+    }
+
+    QString tmpFilename = m_filename + ".tmp";
+    QFile file(tmpFilename);
+
+    if (!file.open(QFile::WriteOnly)) {
+        qCritical() << "Cannot write rules file" << tmpFilename;
+        return false;
+    }
+
+    if (!write(file)) {
+        qCritical() << "Cannot write rules file" << tmpFilename;
+        file.close();
+        QFile::remove(tmpFilename);
+        return false;
+    }
+
+    file.close();
+
+    QFile::remove(m_filename);
+
+    if (!QFile::rename(tmpFilename, m_filename)) {
+        qCritical() << "Cannot rename" << tmpFilename << "to" << m_filename;
+        return false;
+    }
+
+    QSet<quint64> ids;
+    m_canAppend = true;
+
+    for (Rule::const_iterator it = m_rootRule->begin(); it != m_rootRule->end(); ++it) {
+        if (ids.contains((*it)->id())) {
+            m_canAppend = false;
+            break;
+        }
+        ids.insert((*it)->id());
+    }
+
+    m_baseSize = QFileInfo(m_filename).size();
+    m_logSize = 0;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::ChatbotRulesFile::canAppendChanges() const
+{
+    // Compact the file when the log is bigger than half of the indexed part
+    if (!m_canAppend || m_baseSize == 0 || m_logSize > m_baseSize/2) {
+        return false;
+    }
+
+    // Log records refer to rules by ID, so every rule involved must have a valid ID
+
+    foreach (const Rule *rule, m_tracker.changed()) {
+        if (rule->id() == 0 && rule != m_rootRule.get()) {
+            return false;
+        }
+    }
+
+    foreach (const Rule *rule, m_tracker.childrenChanged()) {
+        foreach (const Rule *child, rule->children()) {
+            if (child->id() == 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Each change log segment is a header followed by a payload with the file attributes, the
+// changed rules and the new list of children of each rule whose children changed.
+bool Lvk::BE::ChatbotRulesFile::appendChanges()
+{
+    QByteArray payload;
+    QDataStream pstream(&payload, QIODevice::WriteOnly);
+    pstream.setVersion(QDataStream::Qt_4_7);
+
+    pstream << m_chatbotId;
+    pstream << m_metadata;
+    pstream << m_nextRuleId;
+
+    pstream << (quint32)m_tracker.changed().size();
+
+    foreach (const Rule *rule, m_tracker.changed()) {
+        writeLogRecord(pstream, rule);
+    }
+
+    pstream << (quint32)m_tracker.childrenChanged().size();
+
+    foreach (const Rule *rule, m_tracker.childrenChanged()) {
+        QList<quint64> childIds;
+
+        foreach (const Rule *child, rule->children()) {
+            childIds.append(child->id());
+        }
+
+        pstream << rule->id() << childIds;
+    }
+
+    QByteArray header;
+    QDataStream hstream(&header, QIODevice::WriteOnly);
+    hstream.setVersion(QDataStream::Qt_4_7);
+
+    hstream << (quint32)CRF_LOG_MAGIC_NUMBER;
+    hstream << (quint32)payload.size();
+    hstream << qChecksum(payload.constData(), payload.size());
 
     QFile file(m_filename);
 
-    if (file.open(QFile::WriteOnly)) {
-        success = write(file);
+    // A partially written segment has an invalid checksum and it is ignored when loading
+    if (!file.open(QFile::WriteOnly | QFile::Append)) {
+        qCritical() << "Cannot append changes to rules file" << m_filename;
+        return false;
     }
 
-    if (success) {
-        setAsSaved();
+    qDebug() << "Appending" << payload.size() << "bytes to rules file" << m_filename;
+
+    if (file.write(header) != header.size() || file.write(payload) != payload.size()
+            || !file.flush()) {
+        qCritical() << "Cannot append changes to rules file" << m_filename;
+        m_canAppend = false;
+        return false;
     }
 
-    return success;
+    m_logSize += header.size() + payload.size();
+
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -146,11 +458,15 @@ bool Lvk::BE::ChatbotRulesFile::saveAs(const QString &filename)
 
     m_filename = filename;
 
+    bool canAppendBak = m_canAppend;
+    m_canAppend = false;
+
     bool success = save();
 
     if (!success) {
         m_filename = filenameBak;
         m_chatbotId = chatbotIdBak;
+        m_canAppend = canAppendBak;
     }
 
     return success;
@@ -160,17 +476,7 @@ bool Lvk::BE::ChatbotRulesFile::saveAs(const QString &filename)
 
 bool Lvk::BE::ChatbotRulesFile::hasUnsavedChanges() const
 {
-    if (m_dirty) {
-        return true;
-    }
-
-    for (Rule::iterator it = m_rootRule->begin(); it != m_rootRule->end(); ++it) {
-        if ((*it)->status() == Rule::Unsaved) {
-            return true;
-        }
-    }
-
-    return false;
+    return m_dirty || m_tracker.hasUnsavedChanges();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -178,10 +484,16 @@ bool Lvk::BE::ChatbotRulesFile::hasUnsavedChanges() const
 void Lvk::BE::ChatbotRulesFile::setAsSaved()
 {
     m_dirty = false;
+    m_tracker.setAsSaved();
+}
 
-    for (Rule::iterator it = m_rootRule->begin(); it != m_rootRule->end(); ++it) {
-        (*it)->setStatus(Rule::Saved);
-    }
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::ChatbotRulesFile::resetTracker()
+{
+    m_rootRule->setTracker(&m_tracker);
+    setAsSaved();
+    m_tracker.clear();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -195,7 +507,10 @@ void Lvk::BE::ChatbotRulesFile::close()
     m_filename = "";
     m_nextRuleId = 1;
     m_metadata.clear();
-    setAsSaved();
+    m_baseSize = 0;
+    m_logSize = 0;
+    m_canAppend = false;
+    resetTracker();
 
     qDebug() << "File closed!";
 }
@@ -232,6 +547,13 @@ bool Lvk::BE::ChatbotRulesFile::read(QFile &file)
     }
 
     m_rootRule = std::auto_ptr<Rule>(new Rule());
+    m_baseSize = 0;
+    m_logSize = 0;
+    m_canAppend = false;
+
+    if (version >= CRF_INDEXED_FORMAT_VERSION) {
+        return readIndexed(file, istream);
+    }
 
     istream >> m_chatbotId;
     istream >> *m_rootRule;
@@ -248,22 +570,242 @@ bool Lvk::BE::ChatbotRulesFile::read(QFile &file)
 
 //--------------------------------------------------------------------------------------------------
 
+// Records are stored in depth-first order, the first one is the root rule
+bool Lvk::BE::ChatbotRulesFile::readIndexed(QFile &file, QDataStream &istream)
+{
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 ruleCount = 0;
+
+    istream >> m_chatbotId;
+    istream >> m_metadata;
+    istream >> m_nextRuleId;
+    istream >> ruleCount;
+
+    if (istream.status() != QDataStream::Ok || ruleCount == 0) {
+        qCritical() << "Cannot read rules: Invalid file format in file" << file.fileName();
+        return false;
+    }
+
+    QSharedPointer<MappedFile> mapped(new MappedFile(file.fileName()));
+
+    if (!mapped->isValid()) {
+        qCritical() << "Cannot read rules: Cannot map file" << file.fileName();
+        return false;
+    }
+
+    qint64 baseEnd = 0;
+
+    if (!readRuleRecords(istream, ruleCount, mapped, m_rootRule.get(), baseEnd)) {
+        qCritical() << "Cannot read rules: Invalid file format in file" << file.fileName();
+        return false;
+    }
+
+    m_baseSize = baseEnd;
+
+    return readLog(file, baseEnd);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::ChatbotRulesFile::readLog(QFile &file, qint64 offset)
+{
+    QHash<quint64, Rule *> rules;
+
+    m_canAppend = true;
+
+    for (Rule::iterator it = m_rootRule->begin(); it != m_rootRule->end(); ++it) {
+        if (rules.contains((*it)->id())) {
+            m_canAppend = false;
+        }
+        rules.insert((*it)->id(), *it);
+    }
+
+    if (!file.seek(offset)) {
+        qCritical() << "Cannot read rules: Invalid file format in file" << file.fileName();
+        return false;
+    }
+
+    bool replayed = false;
+
+    while (!file.atEnd()) {
+        QByteArray header = file.read(CRF_LOG_HEADER_SIZE);
+        QDataStream hstream(header);
+        hstream.setVersion(QDataStream::Qt_4_7);
+
+        quint32 magicNumber = 0;
+        quint32 size = 0;
+        quint16 checksum = 0;
+        hstream >> magicNumber >> size >> checksum;
+
+        QByteArray payload;
+        if (hstream.status() == QDataStream::Ok && magicNumber == CRF_LOG_MAGIC_NUMBER) {
+            payload = file.read(size);
+        }
+
+        if (magicNumber != CRF_LOG_MAGIC_NUMBER || (quint32)payload.size() != size
+                || qChecksum(payload.constData(), payload.size()) != checksum) {
+            // Most likely the application exited while saving. The next save compacts the file.
+            qWarning() << "Ignoring incomplete change log in file" << file.fileName();
+            m_canAppend = false;
+            break;
+        }
+
+        if (!applyLog(payload, rules)) {
+            qCritical() << "Cannot read rules: Invalid change log in file" << file.fileName();
+            return false;
+        }
+
+        m_logSize += CRF_LOG_HEADER_SIZE + payload.size();
+        replayed = true;
+    }
+
+    if (!replayed) {
+        return true;
+    }
+
+    // Delete rules that are no longer in the tree
+
+    QSet<Rule *> reachable;
+
+    for (Rule::iterator it = m_rootRule->begin(); it != m_rootRule->end(); ++it) {
+        reachable.insert(*it);
+    }
+
+    QList<Rule *> detached;
+
+    foreach (Rule *rule, rules) {
+        if (!reachable.contains(rule)) {
+            // Deleting a rule also deletes its children
+            if (!rule->parent() || !rule->parent()->children().contains(rule)) {
+                detached.append(rule);
+            }
+        }
+    }
+
+    foreach (Rule *rule, detached) {
+        if (rule->parent()) {
+            rule->parent()->children().removeOne(rule);
+        }
+        delete rule;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::ChatbotRulesFile::applyLog(const QByteArray &payload,
+                                         QHash<quint64, Rule *> &rules)
+{
+    QDataStream pstream(payload);
+    pstream.setVersion(QDataStream::Qt_4_7);
+
+    pstream >> m_chatbotId;
+    pstream >> m_metadata;
+    pstream >> m_nextRuleId;
+
+    quint32 changedCount = 0;
+    pstream >> changedCount;
+
+    for (quint32 i = 0; i < changedCount && pstream.status() == QDataStream::Ok; ++i) {
+        quint64 id;
+        qint32 type;
+        quint64 nextCatId;
+        QString name;
+        TargetList target;
+        QStringList input;
+        QStringList output;
+
+        pstream >> id >> type >> nextCatId >> name >> target >> input >> output;
+
+        Rule *rule = rules.value(id);
+
+        if (!rule) {
+            rule = new Rule();
+            rule->setId(id);
+            rules.insert(id, rule);
+        }
+
+        rule->setType(static_cast<Rule::Type>(type));
+        rule->setNextCategory(nextCatId);
+        rule->setName(name);
+        rule->setTarget(target);
+        rule->setInput(input);
+        rule->setOutput(output);
+    }
+
+    quint32 parentCount = 0;
+    pstream >> parentCount;
+
+    for (quint32 i = 0; i < parentCount && pstream.status() == QDataStream::Ok; ++i) {
+        quint64 parentId;
+        QList<quint64> childIds;
+
+        pstream >> parentId >> childIds;
+
+        Rule *parent = rules.value(parentId);
+
+        if (!parent) {
+            return false;
+        }
+
+        // Removed children are deleted later if they are not appended to other rule
+        parent->children().clear();
+
+        foreach (quint64 childId, childIds) {
+            Rule *child = rules.value(childId);
+
+            if (!child || child == parent) {
+                return false;
+            }
+
+            if (child->parent() && child->parent() != parent) {
+                child->parent()->children().removeOne(child);
+            }
+
+            parent->appendChild(child);
+        }
+    }
+
+    return pstream.status() == QDataStream::Ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool Lvk::BE::ChatbotRulesFile::write(QFile &file)
 {
     qDebug() << "Writing rules file" << file.fileName();
 
-    QDataStream ostream(&file);
+    // Header
 
-    ostream.setVersion(QDataStream::Qt_4_7);
+    QByteArray header;
+    QDataStream hstream(&header, QIODevice::WriteOnly);
+    hstream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 ruleCount = 0;
+    for (Rule::const_iterator it = m_rootRule->begin(); it != m_rootRule->end(); ++it) {
+        ++ruleCount;
+    }
 
-    ostream << (quint32)CRF_MAGIC_NUMBER;
-    ostream << (quint32)CRF_FILE_FORMAT_VERSION;
-    ostream << m_chatbotId;
-    ostream << *m_rootRule;
-    ostream << m_metadata;
-    ostream << m_nextRuleId;
+    hstream << (quint32)CRF_MAGIC_NUMBER;
+    hstream << (quint32)CRF_FILE_FORMAT_VERSION;
+    hstream << m_chatbotId;
+    hstream << m_metadata;
+    hstream << m_nextRuleId;
+    hstream << ruleCount;
 
-    return true;
+    // Strings region. Strings are written after the records, so offsets start there.
+
+    QByteArray records;
+    QByteArray strings;
+
+    writeRuleRecords(m_rootRule.get(), header.size() + ruleCount*RULE_RECORD_SIZE, records,
+                     strings);
+
+    return file.write(header) == header.size()
+            && file.write(records) == records.size()
+            && file.write(strings) == strings.size();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -333,7 +875,38 @@ bool Lvk::BE::ChatbotRulesFile::importRules(BE::Rule *container, const QString &
         return false;
     }
 
-    istream >> *container;
+    if (version < CEF_INDEXED_FORMAT_VERSION) {
+        istream >> *container;
+
+        return true;
+    }
+
+    // Only the tree skeleton is read. Names are decoded when the tree is shown and targets,
+    // inputs and outputs when a rule is previewed or merged.
+
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 ruleCount = 0;
+    istream >> ruleCount;
+
+    if (istream.status() != QDataStream::Ok || ruleCount == 0) {
+        qCritical() << "Cannot import rules: Invalid file format in file" << inputFile;
+        return false;
+    }
+
+    QSharedPointer<MappedFile> mapped(new MappedFile(inputFile));
+
+    if (!mapped->isValid()) {
+        qCritical() << "Cannot import rules: Cannot map file" << inputFile;
+        return false;
+    }
+
+    qint64 end = 0;
+
+    if (!readRuleRecords(istream, ruleCount, mapped, container, end)) {
+        qCritical() << "Cannot import rules: Invalid file format in file" << inputFile;
+        return false;
+    }
 
     return true;
 }
@@ -355,9 +928,200 @@ bool Lvk::BE::ChatbotRulesFile::exportRules(const BE::Rule *container, const QSt
 
     ostream.setVersion(QDataStream::Qt_4_7);
 
+    quint32 ruleCount = 0;
+    for (Rule::const_iterator it = container->begin(); it != container->end(); ++it) {
+        ++ruleCount;
+    }
+
     ostream << (quint32)CEF_MAGIC_NUMBER;
     ostream << (quint32)CEF_FILE_FORMAT_VERSION;
-    ostream << *container;
+    ostream << ruleCount;
+
+    QByteArray records;
+    QByteArray strings;
+
+    writeRuleRecords(container, file.pos() + ruleCount*RULE_RECORD_SIZE, records, strings);
+
+    return ostream.status() == QDataStream::Ok
+            && file.write(records) == records.size()
+            && file.write(strings) == strings.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// The header and the metadata of each log segment are rewritten. Since the header size may
+// change, the offsets of the rule records are shifted. The strings and the log records are
+// copied in chunks.
+bool Lvk::BE::ChatbotRulesFile::copyWithMetadata(const QString &inputFile, QIODevice &output,
+                                                 const QHash<QString, QVariant> &metadata)
+{
+    qDebug() << "Copying rules file" << inputFile << "with new metadata";
+
+    QFile file(inputFile);
+
+    if (!file.open(QFile::ReadOnly)) {
+        qCritical() << "Cannot copy rules: Cannot open file" << inputFile;
+        return false;
+    }
+
+    QDataStream istream(&file);
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magicNumber = 0;
+    quint32 version = 0;
+    QString chatbotId;
+    FileMetadata fileMetadata;
+    quint64 nextRuleId = 0;
+    quint32 ruleCount = 0;
+
+    istream >> magicNumber >> version;
+
+    if (magicNumber != CRF_MAGIC_NUMBER || version < CRF_INDEXED_FORMAT_VERSION
+            || version > CRF_FILE_FORMAT_VERSION) {
+        qWarning() << "Cannot copy rules: Unsupported format in file" << inputFile;
+        return false;
+    }
+
+    istream >> chatbotId >> fileMetadata >> nextRuleId >> ruleCount;
+
+    if (istream.status() != QDataStream::Ok || ruleCount == 0) {
+        qCritical() << "Cannot copy rules: Invalid file format in file" << inputFile;
+        return false;
+    }
+
+    qint64 headerEnd = file.pos();
+    qint64 recordsEnd = headerEnd + (qint64)ruleCount*RULE_RECORD_SIZE;
+
+    // Header
+
+    foreach (const QString &key, metadata.keys()) {
+        fileMetadata[key] = metadata[key];
+    }
+
+    QByteArray header;
+    QDataStream hstream(&header, QIODevice::WriteOnly);
+    hstream.setVersion(QDataStream::Qt_4_7);
+
+    hstream << magicNumber << version << chatbotId << fileMetadata << nextRuleId << ruleCount;
+
+    qint64 shift = header.size() - headerEnd;
+
+    if (output.write(header) != header.size()) {
+        qCritical() << "Cannot copy rules: Cannot write output";
+        return false;
+    }
+
+    // Records
+
+    qint64 baseEnd = recordsEnd;
+
+    QByteArray records;
+    QDataStream rstream(&records, QIODevice::WriteOnly);
+    rstream.setVersion(QDataStream::Qt_4_7);
+
+    for (quint32 i = 0; i < ruleCount; ++i) {
+        RuleRecord r;
+        istream >> r;
+
+        if (istream.status() != QDataStream::Ok
+                || (qint64)r.nameOffset + r.nameSize > file.size()
+                || (qint64)r.bodyOffset + r.bodySize > file.size()
+                || (qint64)r.bodyOffset + r.bodySize + shift > 0xffffffffLL
+                || (qint64)r.nameOffset + r.nameSize + shift > 0xffffffffLL) {
+            qCritical() << "Cannot copy rules: Invalid file format in file" << inputFile;
+            return false;
+        }
+
+        baseEnd = qMax(baseEnd, qMax((qint64)r.nameOffset + r.nameSize,
+                                     (qint64)r.bodyOffset + r.bodySize));
+
+        r.nameOffset += shift;
+        r.bodyOffset += shift;
+
+        rstream << r;
+
+        if (records.size() >= COPY_CHUNK_SIZE || i + 1 == ruleCount) {
+            if (output.write(records) != records.size()) {
+                qCritical() << "Cannot copy rules: Cannot write output";
+                return false;
+            }
+            rstream.device()->seek(0);
+            records.clear();
+        }
+    }
+
+    // Strings
+
+    for (qint64 left = baseEnd - recordsEnd; left > 0; ) {
+        QByteArray chunk = file.read(qMin(left, (qint64)COPY_CHUNK_SIZE));
+
+        if (chunk.isEmpty() || output.write(chunk) != chunk.size()) {
+            qCritical() << "Cannot copy rules: Cannot copy strings from file" << inputFile;
+            return false;
+        }
+
+        left -= chunk.size();
+    }
+
+    // Change log. Incomplete segments are not copied.
+
+    while (!file.atEnd()) {
+        QDataStream lstream(&file);
+        lstream.setVersion(QDataStream::Qt_4_7);
+
+        quint32 logMagicNumber = 0;
+        quint32 size = 0;
+        quint16 checksum = 0;
+        lstream >> logMagicNumber >> size >> checksum;
+
+        QByteArray payload;
+        if (lstream.status() == QDataStream::Ok && logMagicNumber == CRF_LOG_MAGIC_NUMBER) {
+            payload = file.read(size);
+        }
+
+        if (logMagicNumber != CRF_LOG_MAGIC_NUMBER || (quint32)payload.size() != size
+                || qChecksum(payload.constData(), payload.size()) != checksum) {
+            qWarning() << "Ignoring incomplete change log in file" << inputFile;
+            break;
+        }
+
+        QDataStream pstream(payload);
+        pstream.setVersion(QDataStream::Qt_4_7);
+
+        QString logChatbotId;
+        FileMetadata logMetadata;
+        pstream >> logChatbotId >> logMetadata;
+
+        if (pstream.status() != QDataStream::Ok) {
+            qCritical() << "Cannot copy rules: Invalid change log in file" << inputFile;
+            return false;
+        }
+
+        foreach (const QString &key, metadata.keys()) {
+            logMetadata[key] = metadata[key];
+        }
+
+        QByteArray newPayload;
+        QDataStream npstream(&newPayload, QIODevice::WriteOnly);
+        npstream.setVersion(QDataStream::Qt_4_7);
+
+        npstream << logChatbotId << logMetadata;
+        newPayload.append(payload.mid(pstream.device()->pos()));
+
+        QByteArray logHeader;
+        QDataStream lhstream(&logHeader, QIODevice::WriteOnly);
+        lhstream.setVersion(QDataStream::Qt_4_7);
+
+        lhstream << (quint32)CRF_LOG_MAGIC_NUMBER;
+        lhstream << (quint32)newPayload.size();
+        lhstream << qChecksum(newPayload.constData(), newPayload.size());
+
+        if (output.write(logHeader) != logHeader.size()
+                || output.write(newPayload) != newPayload.size()) {
+            qCritical() << "Cannot copy rules: Cannot write output";
+            return false;
+        }
+    }
 
     return true;
 }
@@ -368,22 +1132,41 @@ bool Lvk::BE::ChatbotRulesFile::mergeRules(BE::Rule *container)
 {
     Lvk::BE::Rule *evasivesRule = findEvasivesRule();
 
-    foreach (Lvk::BE::Rule *rule, container->children()) {
-        rule->setId(0);
+    // Subtrees are re-parented, so they need new IDs. All IDs are reserved at once.
+
+    quint64 count = 0;
+
+    foreach (const Lvk::BE::Rule *rule, container->children()) {
+        if (rule->type() == Rule::ContainerRule
+                || (rule->type() == Rule::EvasiveRule && !evasivesRule)) {
+            count += countRules(rule);
+        }
+    }
+
+    quint64 id = reserveRuleIds(count);
+
+    int i = 0;
+
+    while (i < container->childCount()) {
+        Lvk::BE::Rule *rule = container->child(i);
 
         switch (rule->type()) {
         case Rule::ContainerRule:
-            m_rootRule->appendChild(new BE::Rule(*rule, true));
+            assignRuleIds(rule, id);
+            container->moveChildren(i, 1, m_rootRule.get());
             break;
         case Rule::EvasiveRule:
             if (evasivesRule) {
                 evasivesRule->output().append(rule->output());
+                ++i;
             } else {
-                m_rootRule->appendChild(new BE::Rule(*rule, true));
+                assignRuleIds(rule, id);
+                container->moveChildren(i, 1, m_rootRule.get());
             }
             break;
         case Rule::OrdinaryRule:
             qCritical("Merge of ordinary rules without container is not supported");
+            ++i;
             break;
         }
     }
@@ -425,4 +1208,15 @@ quint64 Lvk::BE::ChatbotRulesFile::nextRuleId()
     return m_nextRuleId++;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+quint64 Lvk::BE::ChatbotRulesFile::reserveRuleIds(quint64 count)
+{
+    quint64 first = m_nextRuleId;
+
+    m_nextRuleId += count;
+
+    return first;
+}
+
 
@@ -30,6 +30,8 @@
 #include <memory>
 
 class QFile;
+class QDataStream;
+class QIODevice;
 
 namespace Lvk
 {
@@ -47,6 +49,14 @@ namespace BE
 /**
  * \brief The ChatbotRulesFile class provides methods to load, save, import and export chatbot
  *         rules files.
+ *
+ * Since format version 3, rules are stored as fixed-size records followed by a region with
+ * the encoded strings. The file is memory mapped and rule strings are decoded the first time
+ * they are accessed. Files with older formats are read entirely when loaded.
+ *
+ * Changes are tracked with a RuleChangeTracker. When possible, save() appends only the
+ * changed rules to a log at the end of the file. The log is replayed when the file is loaded
+ * and it is compacted into a new file when it grows too much.
  */
 class ChatbotRulesFile
 {
@@ -126,7 +136,9 @@ public:
     bool importRules(const QString &inputFile);
 
     /**
-     * Imports rules from the filename \a inputFile into \a container.
+     * Imports rules from the filename \a inputFile into \a container. Since export format
+     * version 3, only the tree is read. Rule strings are decoded the first time they are
+     * accessed, hence rules that are never previewed nor merged are never decoded.
      * Returns true on success. Otherwise; false.
      */
     static bool importRules(BE::Rule *container, const QString &inputFile);
@@ -138,7 +150,17 @@ public:
     static bool exportRules(const Rule *container, const QString &outputFile);
 
     /**
-     * Merges rules in \a container with the current rules.
+     * Copies the rules file \a inputFile to \a output replacing the value of each key in
+     * \a metadata. Rules are copied as they are, without decoding them. Only files with the
+     * indexed format can be copied this way.
+     * Returns true on success. Otherwise; false.
+     */
+    static bool copyWithMetadata(const QString &inputFile, QIODevice &output,
+                                 const QHash<QString, QVariant> &metadata);
+
+    /**
+     * Merges rules in \a container with the current rules. Rules are moved from \a container
+     * instead of copied and they get new IDs.
      * Returns true on success. Otherwise; false.
      */
     bool mergeRules(Rule *container);
@@ -153,6 +175,11 @@ public:
      */
     quint64 nextRuleId();
 
+    /**
+     * Reserves \a count consecutive rule IDs and returns the first one.
+     */
+    quint64 reserveRuleIds(quint64 count);
+
 private:
     ChatbotRulesFile(ChatbotRulesFile&);
     ChatbotRulesFile& operator=(ChatbotRulesFile&);
@@ -162,12 +189,23 @@ private:
     QString m_filename;
     FileMetadata m_metadata;
     bool m_dirty;
+    RuleChangeTracker m_tracker;        // Must outlive the rules
     std::auto_ptr<Rule> m_rootRule;
     quint64 m_nextRuleId;
     QString m_chatbotId;
+    qint64 m_baseSize;                  // Size of the indexed part of the file
+    qint64 m_logSize;                   // Size of the change log after the indexed part
+    bool m_canAppend;
 
     bool read(QFile &file);
+    bool readIndexed(QFile &file, QDataStream &istream);
+    bool readLog(QFile &file, qint64 offset);
+    bool applyLog(const QByteArray &payload, QHash<quint64, Rule *> &rules);
     bool write(QFile &file);
+    bool writeAll();
+    bool canAppendChanges() const;
+    bool appendChanges();
+    void resetTracker();
     Rule *findEvasivesRule();
     bool loadDefaultRules();
 };
@@ -28,6 +28,7 @@
 #include <QVariant>
 #include <QDir>
 #include <QFile>
+#include <QTemporaryFile>
 
 
 //--------------------------------------------------------------------------------------------------
@@ -36,52 +37,64 @@
 
 QString Lvk::BE::ChatbotTempFile::getTempFileForUpload(const QString &origFilename)
 {
-    QString tmpFile;
+    QString tmpFilename;
 
     try {
         if (origFilename.isEmpty()) {
             throw QString("Empty chatbot rules filename");
         }
 
-        int retry = 0;
-        int MAX_RETRIES = 1000;
+        QTemporaryFile tmpFile(QDir::tempPath() + QDir::separator() + "chatbotXXXXXX");
+        tmpFile.setAutoRemove(false);
 
-        do {
-            tmpFile = QDir::tempPath() + QDir::separator() + "chatbot" + QString::number(retry);
+        if (!tmpFile.open()) {
+            throw QString("Cannot create temp file");
+        }
 
-            if (QFile::exists(tmpFile) && !QFile::remove(tmpFile)) {
-                qWarning() << "ChatbotTempFile: Cannot remove temp file" << tmpFile;
-            }
-        } while (!QFile::copy(origFilename, tmpFile) && ++retry < MAX_RETRIES);
+        tmpFilename = tmpFile.fileName();
 
-        if (retry >= MAX_RETRIES) {
-            throw QString("Retries exceded");
-        }
+        QHash<QString, QVariant> metadata = newMetadata();
 
-        BE::ChatbotRulesFile rules;
+        // Only the metadata is patched while the rules file is streamed to the temp file.
+        // Files with older formats are loaded and saved entirely.
+        if (!BE::ChatbotRulesFile::copyWithMetadata(origFilename, tmpFile, metadata)) {
+            tmpFile.close();
 
-        if (!rules.load(tmpFile)) {
-            throw QString("Cannot load temp rules file");
-        }
+            if (!tmpFile.remove() || !QFile::copy(origFilename, tmpFilename)) {
+                throw QString("Cannot copy rules file");
+            }
+
+            BE::ChatbotRulesFile rules;
 
-        setNewRoster(rules);
+            if (!rules.load(tmpFilename)) {
+                throw QString("Cannot load temp rules file");
+            }
 
-        if (!rules.save()) {
-            throw QString("Cannot save changes in temp rules file");
+            foreach (const QString &key, metadata.keys()) {
+                rules.setMetadata(key, metadata[key]);
+            }
+
+            if (!rules.save()) {
+                throw QString("Cannot save changes in temp rules file");
+            }
         }
 
     } catch (const QString &err) {
         qCritical() << "ChatbotTempFile: Cannot create temp file:" << err;
 
-        tmpFile.clear();
+        if (!tmpFilename.isEmpty()) {
+            QFile::remove(tmpFilename);
+        }
+
+        tmpFilename.clear();
     }
 
-    return tmpFile;
+    return tmpFilename;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::BE::ChatbotTempFile::setNewRoster(BE::ChatbotRulesFile &rules)
+QHash<QString, QVariant> Lvk::BE::ChatbotTempFile::newMetadata()
 {
     // Replace the full roster with only those contacts that have scored
 
@@ -92,6 +105,9 @@ void Lvk::BE::ChatbotTempFile::setNewRoster(BE::ChatbotRulesFile &rules)
         scoreRoster.append(BE::RosterItem(c, QString()));
     }
 
-    rules.setMetadata(FILE_METADATA_ROSTER,       QVariant::fromValue(scoreRoster));
-    rules.setMetadata(FILE_METADATA_BLACK_ROSTER, QVariant::fromValue(BE::Roster()));
+    QHash<QString, QVariant> metadata;
+    metadata[FILE_METADATA_ROSTER]       = QVariant::fromValue(scoreRoster);
+    metadata[FILE_METADATA_BLACK_ROSTER] = QVariant::fromValue(BE::Roster());
+
+    return metadata;
 }
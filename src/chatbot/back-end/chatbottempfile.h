@@ -23,6 +23,8 @@
 #define LVK_BE_CHATBOTTEMPFILE_H
 
 #include <QString>
+#include <QHash>
+#include <QVariant>
 
 namespace Lvk
 {
@@ -33,8 +35,6 @@ namespace Lvk
 namespace BE
 {
 
-class ChatbotRulesFile;
-
 /// \ingroup Lvk
 /// \addtogroup BE
 /// @{
@@ -45,6 +45,9 @@ class ChatbotRulesFile;
  *
  * "Without sensible data" means that clears the roster and keeps only those
  * contacts that have scored.
+ *
+ * The temp file has a unique name and it is not removed automatically. Callers must remove
+ * it once the upload has finished.
  */
 class ChatbotTempFile
 {
@@ -57,7 +60,7 @@ public:
     QString getTempFileForUpload(const QString &origFilename);
 
 private:
-    void setNewRoster(BE::ChatbotRulesFile &rules);
+    QHash<QString, QVariant> newMetadata();
 };
 
 /// @}
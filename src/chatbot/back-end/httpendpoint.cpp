@@ -0,0 +1,479 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "back-end/httpendpoint.h"
+#include "back-end/appfacade.h"
+#include "nlp-engine/engine.h"
+#include "nlp-engine/result.h"
+#include "nlp-engine/searchexplain.h"
+#include "common/json.h"
+#include "common/maintenancescheduler.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QStringList>
+#include <QtConcurrentRun>
+#include <QtDebug>
+
+#define MAX_HEADER_SIZE     8192        // Max size of the request line and headers in bytes
+#define MAX_BODY_SIZE       4194304     // Max size of a request body in bytes
+#define MAX_BATCH_SIZE      10000       // Max inputs per request
+#define DEFAULT_EXPLAIN_TOP 10          // Candidates of an explained input if "top" is not set
+
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const char *statusText(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Request Entity Too Large";
+    case 503: return "Service Unavailable";
+    default:  return "Internal Server Error";
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Gets the responses of a batch of requests as a JSON list. Runs in a worker thread.
+QByteArray getResponses(QSharedPointer<Lvk::Nlp::Engine> session,
+                        const QList<Lvk::Cmn::Json::Object> &requests)
+{
+    Lvk::Cmn::MaintenanceScheduler::Activity activity;
+    Lvk::Cmn::JsonWriter writer;
+
+    writer.beginArray();
+
+    for (int i = 0; i < requests.size(); ++i) {
+        QString input = requests[i].value("input").toString();
+        QString target = requests[i].value("target").toString();
+
+        Lvk::Nlp::Result r;
+        session->getResponse(input, target, r);
+
+        writer.beginObject();
+        writer.writeKey("matched");
+        writer.writeBool(r.isValid());
+        writer.writeKey("output");
+        writer.writeString(r.isValid() ? r.output : session->getEvasive(target));
+        writer.writeKey("ruleId");
+        writer.writeNumber(static_cast<qint64>(r.ruleId));
+        writer.writeKey("score");
+        writer.writeNumber(static_cast<double>(r.score));
+        writer.endObject();
+    }
+
+    writer.endArray();
+
+    return writer.toByteArray() + "\n";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Explains the response of a single request as a JSON object. Runs in a worker thread.
+QByteArray explainResponse(QSharedPointer<Lvk::Nlp::Engine> session,
+                           const Lvk::Cmn::Json::Object &request)
+{
+    Lvk::Cmn::MaintenanceScheduler::Activity activity;
+
+    QString input = request.value("input").toString();
+    QString target = request.value("target").toString();
+    int top = request.value("top", DEFAULT_EXPLAIN_TOP).toInt();
+
+    Lvk::Nlp::SearchExplain explain;
+    session->explainResponse(input, target, explain, qMax(top, 0));
+
+    Lvk::Cmn::JsonWriter writer;
+    writer.writeVariant(explain.toVariantMap());
+
+    return writer.toByteArray() + "\n";
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// HttpEndpoint::Connection
+//--------------------------------------------------------------------------------------------------
+
+struct Lvk::BE::HttpEndpoint::Connection
+{
+    Connection() : keepAlive(true), closed(false) { }
+
+    QByteArray buffer;                      // Bytes received and not processed yet
+    bool keepAlive;                         // Keep-alive of the request being processed
+    bool closed;                            // Socket disconnected while a lookup was running
+    QFutureWatcher<QByteArray> lookup;
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// HttpEndpoint
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::HttpEndpoint::HttpEndpoint(Nlp::Engine *engine, QObject *parent /*= 0*/)
+    : QObject(parent),
+      m_engine(engine),
+      m_engineReady(false),
+      m_metricsSource(0),
+      m_server(new QTcpServer(this))
+{
+    connect(m_server, SIGNAL(newConnection()), SLOT(onNewConnection()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::HttpEndpoint::~HttpEndpoint()
+{
+    close();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::HttpEndpoint::listen(quint16 port)
+{
+    // Only local services can get responses
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "HttpEndpoint: Cannot listen on port" << port << m_server->errorString();
+        return false;
+    }
+
+    qDebug() << "HttpEndpoint: Listening on port" << port;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::close()
+{
+    m_server->close();
+
+    foreach (QTcpSocket *socket, m_connections.keys()) {
+        m_connections.value(socket)->lookup.waitForFinished();
+        removeConnection(socket);
+        socket->abort();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::HttpEndpoint::isListening() const
+{
+    return m_server->isListening();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::BE::HttpEndpoint::errorString() const
+{
+    return m_server->errorString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::setEngineReady(bool ready)
+{
+    m_engineReady = ready;
+
+    // Running lookups keep their own reference to the session
+    m_session.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::setMetricsSource(const AppFacade *facade)
+{
+    m_metricsSource = facade;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        Connection *c = new Connection();
+        m_connections[socket] = c;
+        m_lookups[&c->lookup] = socket;
+
+        connect(&c->lookup, SIGNAL(finished()),     SLOT(onLookupFinished()));
+        connect(socket,     SIGNAL(readyRead()),    SLOT(onReadyRead()));
+        connect(socket,     SIGNAL(disconnected()), SLOT(onDisconnected()));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+
+    if (socket) {
+        processRequests(socket);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    Connection *c = m_connections.value(socket);
+
+    if (!c) {
+        return;
+    }
+
+    // The connection is removed when the running lookup finishes
+    if (c->lookup.isRunning()) {
+        c->closed = true;
+    } else {
+        removeConnection(socket);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::onLookupFinished()
+{
+    QTcpSocket *socket = m_lookups.value(static_cast<QFutureWatcher<QByteArray> *>(sender()));
+    Connection *c = m_connections.value(socket);
+
+    if (!c) {
+        return;
+    }
+
+    if (c->closed) {
+        removeConnection(socket);
+        return;
+    }
+
+    reply(socket, 200, c->lookup.result());
+
+    // Pipelined requests were not processed while the lookup was running
+    if (c->keepAlive) {
+        processRequests(socket);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::processRequests(QTcpSocket *socket)
+{
+    Connection *c = m_connections.value(socket);
+
+    if (!c || c->closed || c->lookup.isRunning() || !c->keepAlive) {
+        return;
+    }
+
+    c->buffer += socket->readAll();
+
+    forever {
+        int headerEnd = c->buffer.indexOf("\r\n\r\n");
+
+        if (headerEnd == -1) {
+            if (c->buffer.size() > MAX_HEADER_SIZE) {
+                c->keepAlive = false;
+                reply(socket, 400, "Header too large\n", "text/plain");
+            }
+            return;
+        }
+
+        QList<QByteArray> lines = c->buffer.left(headerEnd).split('\n');
+        QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+
+        if (requestLine.size() != 3) {
+            c->keepAlive = false;
+            reply(socket, 400, "Invalid request line\n", "text/plain");
+            return;
+        }
+
+        QByteArray method = requestLine[0];
+        QByteArray path = requestLine[1].split('?').first();
+        QByteArray version = requestLine[2];
+        QByteArray connection;
+        int contentLength = 0;
+        bool ok = true;
+
+        foreach (const QByteArray &line, lines) {
+            int colon = line.indexOf(':');
+            QByteArray name = line.left(colon).trimmed().toLower();
+            QByteArray value = line.mid(colon + 1).trimmed();
+
+            if (name == "content-length") {
+                contentLength = value.toInt(&ok);
+                ok = ok && contentLength >= 0;
+            } else if (name == "connection") {
+                connection = value.toLower();
+            }
+        }
+
+        if (!ok) {
+            c->keepAlive = false;
+            reply(socket, 400, "Invalid content length\n", "text/plain");
+            return;
+        }
+
+        if (contentLength > MAX_BODY_SIZE) {
+            c->keepAlive = false;
+            reply(socket, 413, "Body too large\n", "text/plain");
+            return;
+        }
+
+        int requestSize = headerEnd + 4 + contentLength;
+
+        if (c->buffer.size() < requestSize) {
+            return;
+        }
+
+        QByteArray body = c->buffer.mid(headerEnd + 4, contentLength);
+        c->buffer.remove(0, requestSize);
+
+        // HTTP/1.1 connections are persistent by default
+        c->keepAlive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+
+        if (path == "/health") {
+            if (method != "GET") {
+                reply(socket, 405, "Method not allowed\n", "text/plain");
+            } else if (!m_engineReady) {
+                reply(socket, 503, "loading\n", "text/plain");
+            } else {
+                reply(socket, 200, "ok\n", "text/plain");
+            }
+        } else if (path == "/metrics" && m_metricsSource) {
+            if (method != "GET") {
+                reply(socket, 405, "Method not allowed\n", "text/plain");
+            } else {
+                reply(socket, 200, m_metricsSource->openMetrics(),
+                      "application/openmetrics-text; version=1.0.0; charset=utf-8");
+            }
+        } else if (path == "/responses" || path == "/explain") {
+            if (method != "POST") {
+                reply(socket, 405, "Method not allowed\n", "text/plain");
+            } else if (!m_engineReady) {
+                reply(socket, 503, "NLP engine not ready\n", "text/plain");
+            } else {
+                startLookup(socket, body, path == "/explain");
+                return; // The remaining requests are processed when the lookup finishes
+            }
+        } else {
+            reply(socket, 404, "Not found\n", "text/plain");
+        }
+
+        if (!c->keepAlive) {
+            return;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::startLookup(QTcpSocket *socket, const QByteArray &body,
+                                        bool explain /*= false*/)
+{
+    QByteArray json = body.trimmed();
+    QList<Cmn::Json::Object> requests;
+    Cmn::Json parser(Cmn::Json::UnescapedStrings);
+    bool ok;
+
+    if (json.startsWith('[')) {
+        ok = parser.parseList(json, requests);
+    } else {
+        Cmn::Json::Object request;
+        ok = parser.parse(json, request);
+        requests.append(request);
+    }
+
+    if (!ok) {
+        reply(socket, 400, "Invalid JSON\n", "text/plain");
+        processRequests(socket);
+        return;
+    }
+
+    if (explain && requests.size() != 1) {
+        reply(socket, 400, "Explain requires a single input\n", "text/plain");
+        processRequests(socket);
+        return;
+    }
+
+    if (requests.size() > MAX_BATCH_SIZE) {
+        reply(socket, 413, "Too many inputs\n", "text/plain");
+        processRequests(socket);
+        return;
+    }
+
+    // Sessions share the compiled rules but keep their own topics and statistics
+    if (!m_session) {
+        m_session = QSharedPointer<Nlp::Engine>(m_engine->createSession());
+    }
+
+    Connection *c = m_connections.value(socket);
+
+    if (explain) {
+        c->lookup.setFuture(QtConcurrent::run(explainResponse, m_session, requests.first()));
+    } else {
+        c->lookup.setFuture(QtConcurrent::run(getResponses, m_session, requests));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::reply(QTcpSocket *socket, int status, const QByteArray &body,
+                                  const QByteArray &contentType /*= "application/json"*/)
+{
+    Connection *c = m_connections.value(socket);
+    bool keepAlive = c && c->keepAlive;
+
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " " + statusText(status)
+            + "\r\nContent-Type: " + contentType + "; charset=utf-8"
+            + "\r\nContent-Length: " + QByteArray::number(body.size())
+            + "\r\nConnection: " + (keepAlive ? "keep-alive" : "close")
+            + "\r\n\r\n" + body;
+
+    socket->write(response);
+
+    if (!keepAlive) {
+        socket->disconnectFromHost();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::HttpEndpoint::removeConnection(QTcpSocket *socket)
+{
+    Connection *c = m_connections.take(socket);
+
+    if (c) {
+        m_lookups.remove(&c->lookup);
+        delete c;
+    }
+
+    socket->deleteLater();
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_BE_HTTPENDPOINT_H
+#define LVK_BE_HTTPENDPOINT_H
+
+#include <QObject>
+#include <QHash>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+
+class QTcpServer;
+class QTcpSocket;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+    class Engine;
+}
+
+namespace BE
+{
+
+class AppFacade;
+
+/// \ingroup Lvk
+/// \addtogroup BE
+/// @{
+
+/**
+ * \brief The HttpEndpoint class provides a local HTTP/JSON endpoint to get responses from the
+ *        NLP engine.
+ *
+ * The endpoint only listens on the loopback interface. It supports HTTP/1.1 keep-alive and
+ * two requests:
+ *
+ * - <tt>GET /health</tt> replies "ok" if the engine is ready. Otherwise, replies with status 503.
+ * - <tt>POST /responses</tt> with a JSON list of objects with the form
+ *   <tt>{"input": "...", "target": "..."}</tt>. A single object is also accepted. Replies with
+ *   a list of objects <tt>{"matched": bool, "output": "...", "ruleId": n, "score": n}</tt> in
+ *   the same order. If an input has no match "matched" is false and "output" is an evasive.
+ * - <tt>POST /explain</tt> with a JSON object <tt>{"input": "...", "target": "...", "top": n}</tt>.
+ *   Replies with an object with what the search of the input did and the \c top candidates,
+ *   10 by default. See Nlp::SearchExplain::toVariantMap(). The state of the engine does not
+ *   change, so it is safe to use to diagnose slow or wrong responses in production.
+ * - <tt>GET /metrics</tt> replies the metrics of the application in OpenMetrics text format.
+ *   Only available once a metrics source is set. See setMetricsSource().
+ *
+ * Lookups run in a worker thread on a session of the engine, so they do not change the topics
+ * and the statistics of the chatbot. Requests of different connections run concurrently while
+ * requests of the same connection are answered in order.
+ *
+ * The engine must outlive the endpoint. Invoke setEngineReady() whenever the engine is built or
+ * its rules change.
+ */
+class HttpEndpoint : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Constructs an HttpEndpoint object for \a engine with parent object \a parent.
+     */
+    HttpEndpoint(Nlp::Engine *engine, QObject *parent = 0);
+
+    /**
+     * Destroys the object and waits for the running lookups.
+     */
+    ~HttpEndpoint();
+
+    /**
+     * Starts listening on localhost \a port. Returns true on success. Otherwise; returns false.
+     */
+    bool listen(quint16 port);
+
+    /**
+     * Stops listening and closes every connection.
+     */
+    void close();
+
+    /**
+     * Returns true if the endpoint is listening. Otherwise; returns false.
+     */
+    bool isListening() const;
+
+    /**
+     * Returns a human-readable description of the last error that occurred.
+     */
+    QString errorString() const;
+
+    /**
+     * Sets whether the engine is \a ready to get responses. While the engine is not ready
+     * requests are replied with status 503. Setting it as ready also discards the session
+     * used so far, so rules changed since then are used.
+     */
+    void setEngineReady(bool ready);
+
+    /**
+     * Sets \a facade as the source of the metrics replied to <tt>GET /metrics</tt>. If
+     * \a facade is 0, the request is replied with status 404. The facade must outlive the
+     * endpoint. \see AppFacade::openMetrics()
+     */
+    void setMetricsSource(const AppFacade *facade);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onLookupFinished();
+
+private:
+    HttpEndpoint(HttpEndpoint&);
+    HttpEndpoint& operator=(HttpEndpoint&);
+
+    struct Connection;
+
+    Nlp::Engine *m_engine;
+    QSharedPointer<Nlp::Engine> m_session;
+    bool m_engineReady;
+    const AppFacade *m_metricsSource;
+    QTcpServer *m_server;
+    QHash<QTcpSocket *, Connection *> m_connections;
+    QHash<QFutureWatcher<QByteArray> *, QTcpSocket *> m_lookups;
+
+    void processRequests(QTcpSocket *socket);
+    void startLookup(QTcpSocket *socket, const QByteArray &body, bool explain = false);
+    void reply(QTcpSocket *socket, int status, const QByteArray &body,
+               const QByteArray &contentType = "application/json");
+    void removeConnection(QTcpSocket *socket);
+};
+
+/// @}
+
+} // namespace BE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_BE_HTTPENDPOINT_H
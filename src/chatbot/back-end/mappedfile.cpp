@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "back-end/mappedfile.h"
+
+#include <QtDebug>
+
+//--------------------------------------------------------------------------------------------------
+// MappedFile
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::MappedFile::MappedFile(const QString &filename)
+    : m_file(filename), m_map(0), m_size(-1)
+{
+    if (!m_file.open(QFile::ReadOnly)) {
+        qCritical() << "MappedFile: Cannot open file" << filename;
+        return;
+    }
+
+    m_size = m_file.size();
+    m_map = m_size > 0 ? m_file.map(0, m_size) : 0;
+
+    if (!m_map) {
+        m_buffer = m_file.readAll();
+        m_size = m_buffer.size();
+        m_file.close();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::MappedFile::~MappedFile()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::MappedFile::isValid() const
+{
+    return m_size >= 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::BE::MappedFile::size() const
+{
+    return qMax(m_size, (qint64)0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::BE::MappedFile::bytes(quint32 offset, quint32 size) const
+{
+    if ((qint64)offset + size > this->size()) {
+        return QByteArray();
+    }
+
+    const char *data = m_map ? reinterpret_cast<const char *>(m_map) : m_buffer.constData();
+
+    return QByteArray::fromRawData(data + offset, size);
+}
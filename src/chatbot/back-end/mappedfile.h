@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_BE_MAPPEDFILE_H
+#define LVK_BE_MAPPEDFILE_H
+
+#include <QFile>
+#include <QByteArray>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace BE
+{
+
+/// \ingroup Lvk
+/// \addtogroup BE
+/// @{
+
+/**
+ * \brief The MappedFile class provides read-only access to a memory mapped file.
+ *
+ * If the file cannot be mapped, i.e. the file system does not support it, the file is read
+ * into memory.
+ */
+class MappedFile
+{
+public:
+
+    /**
+     * Constructs a MappedFile and maps \a filename.
+     */
+    MappedFile(const QString &filename);
+
+    /**
+     * Destroys the object and unmaps the file.
+     */
+    ~MappedFile();
+
+    /**
+     * Returns true if the file was mapped or read. Otherwise; returns false.
+     */
+    bool isValid() const;
+
+    /**
+     * Returns the file size.
+     */
+    qint64 size() const;
+
+    /**
+     * Returns \a size bytes starting at \a offset. The returned byte array does not copy the
+     * data, it is valid as long as the object exists. If the range is not within the file,
+     * returns an empty byte array.
+     */
+    QByteArray bytes(quint32 offset, quint32 size) const;
+
+private:
+    MappedFile(MappedFile&);
+    MappedFile& operator=(MappedFile&);
+
+    QFile m_file;
+    uchar *m_map;
+    QByteArray m_buffer;    // Used if the file cannot be mapped
+    qint64 m_size;
+};
+
+/// @}
+
+} // namespace BE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_BE_MAPPEDFILE_H
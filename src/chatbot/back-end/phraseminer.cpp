@@ -0,0 +1,506 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "back-end/phraseminer.h"
+#include "back-end/appfacade.h"
+#include "back-end/rule.h"
+#include "chat-adapter/chatcorpus.h"
+#include "chat-adapter/historyhelper.h"
+#include "nlp-engine/globaltools.h"
+#include "nlp-engine/sanitizer.h"
+#include "nlp-engine/word.h"
+#include "common/conversation.h"
+#include "common/csvrow.h"
+#include "common/json.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QVector>
+#include <QRegExp>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <iostream>
+
+#define BATCH_SIZE          1000    // Messages lemmatized and counted by each task
+#define SHARD_COUNT         64      // Shards of the phrase counts
+#define MIN_PHRASE_COUNT    2       // Phrases found in less messages are not reported
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct PhraseCount
+{
+    PhraseCount() : count(0) { }
+
+    int count;
+    QString text;
+};
+
+typedef QHash<QString, PhraseCount> PhraseCounts;    // lemmas -> count
+
+//--------------------------------------------------------------------------------------------------
+
+struct Shard
+{
+    QMutex mutex;
+    PhraseCounts counts;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool hasLetterOrNumber(const QString &str)
+{
+    for (int i = 0; i < str.size(); ++i) {
+        if (str[i].isLetterOrNumber()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Gets the lemmas of words, the keys of n-grams, and their original words. Words without lemma
+// are used as they are. Punctuation gets an empty lemma, so n-grams never span across it.
+void phraseTokens(const Lvk::Nlp::WordList &words, QStringList &lemmas, QStringList &forms)
+{
+    Lvk::Nlp::Sanitizer *postSanitizer = Lvk::Nlp::GlobalTools::instance()->postSanitizer();
+
+    lemmas.clear();
+    forms.clear();
+
+    for (int i = 0; i < words.size(); ++i) {
+        const Lvk::Nlp::Word &w = words[i];
+        const QString &lemma = !w.lemma.isEmpty() ? w.lemma : w.normWord;
+
+        if (hasLetterOrNumber(w.origWord)) {
+            lemmas.append(postSanitizer->sanitize(lemma.toLower()));
+        } else {
+            lemmas.append(QString());
+        }
+        forms.append(w.origWord);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the key of the n-gram of n lemmas at offset i, or a null string if it spans across
+// punctuation
+inline QString phraseKey(const QStringList &lemmas, int i, int n)
+{
+    QString key;
+
+    for (int j = i; j < i + n; ++j) {
+        if (lemmas[j].isEmpty()) {
+            return QString();
+        }
+        if (j > i) {
+            key += ' ';
+        }
+        key += lemmas[j];
+    }
+
+    return key;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Lemmatizes and counts the phrases of a batch of messages, then merges the counts into the
+// shards. Releases a slot of the semaphore once done.
+class CountTask : public QRunnable
+{
+public:
+    CountTask(const QStringList &messages, const QSet<QString> &covered, int minWords,
+              int maxWords, Shard *shards, QSemaphore *slots)
+        : m_messages(messages), m_covered(covered), m_minWords(minWords), m_maxWords(maxWords),
+          m_shards(shards), m_slots(slots)
+    { }
+
+    virtual void run()
+    {
+        QList<Lvk::Nlp::WordList> words;
+        Lvk::Nlp::GlobalTools::instance()->lemmatizeBatch(m_messages, words);
+
+        QVector<PhraseCounts> counts(SHARD_COUNT);
+        QStringList lemmas;
+        QStringList forms;
+        QSet<QString> seen;
+
+        foreach (const Lvk::Nlp::WordList &message, words) {
+            phraseTokens(message, lemmas, forms);
+            seen.clear();
+
+            for (int n = m_minWords; n <= m_maxWords; ++n) {
+                for (int i = 0; i + n <= lemmas.size(); ++i) {
+                    QString key = phraseKey(lemmas, i, n);
+
+                    if (key.isNull() || m_covered.contains(key) || seen.contains(key)) {
+                        continue;
+                    }
+
+                    seen.insert(key);
+
+                    PhraseCount &c = counts[qHash(key) % SHARD_COUNT][key];
+                    if (c.count++ == 0) {
+                        c.text = QStringList(forms.mid(i, n)).join(" ");
+                    }
+                }
+            }
+        }
+
+        for (int s = 0; s < SHARD_COUNT; ++s) {
+            if (counts[s].isEmpty()) {
+                continue;
+            }
+
+            QMutexLocker locker(&m_shards[s].mutex);
+
+            PhraseCounts &shard = m_shards[s].counts;
+
+            for (PhraseCounts::const_iterator it = counts[s].constBegin();
+                 it != counts[s].constEnd(); ++it) {
+                PhraseCount &c = shard[it.key()];
+                if (c.count == 0) {
+                    c.text = it.value().text;
+                }
+                c.count += it.value().count;
+            }
+        }
+
+        m_slots->release();
+    }
+
+private:
+    QStringList m_messages;
+    const QSet<QString> &m_covered;
+    int m_minWords;
+    int m_maxWords;
+    Shard *m_shards;
+    QSemaphore *m_slots;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Most frequent first. Ties are sorted by lemmas, so the output does not depend on the order
+// in which tasks finished.
+bool countsFirst(const Lvk::BE::PhraseMiner::Phrase &p1, const Lvk::BE::PhraseMiner::Phrase &p2)
+{
+    return p1.count > p2.count || (p1.count == p2.count && p1.lemmas < p2.lemmas);
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// PhraseMiner
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::PhraseMiner::PhraseMiner(QObject *parent)
+    : QObject(parent), m_appFacade(0), m_jobs(qMax(1, QThread::idealThreadCount())),
+      m_minWords(2), m_maxWords(4), m_top(100)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::PhraseMiner::~PhraseMiner()
+{
+    delete m_appFacade;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::PhraseMiner::setJobs(int jobs)
+{
+    m_jobs = qMax(1, jobs);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::PhraseMiner::setPhraseLength(int minWords, int maxWords)
+{
+    m_minWords = qMax(1, minWords);
+    m_maxWords = qMax(m_minWords, maxWords);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::PhraseMiner::setTopCount(int top)
+{
+    m_top = qMax(1, top);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::PhraseMiner::setReportFile(const QString &filename)
+{
+    m_reportFilename = filename;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::BE::PhraseMiner::exec(const QString &filename)
+{
+    if (!QFileInfo(filename).isFile()) {
+        printErr(tr("File %1 does not exist").arg(filename));
+        return 1;
+    }
+
+    if (!m_appFacade) {
+        m_appFacade = new BE::AppFacade();
+    }
+
+    if (!m_appFacade->load(filename)) {
+        printErr(tr("Cannot load file %1").arg(filename));
+        return 1;
+    }
+
+    // The lemmatizer is set up while rules are built
+    m_appFacade->waitForNlpEngine();
+
+    QStringList ruleInputs;
+    for (BE::Rule::iterator it = m_appFacade->rootRule()->begin();
+         it != m_appFacade->rootRule()->end(); ++it) {
+        ruleInputs += (*it)->input();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    PhraseList phrases = mine(ruleInputs, m_appFacade->chatHistoryFilename());
+
+    // Similar phrases are taught together
+    QStringList texts;
+    QHash<QString, int> textIndex;
+    for (int i = 0; i < phrases.size(); ++i) {
+        texts.append(phrases[i].text);
+        textIndex.insert(phrases[i].text, i);
+    }
+
+    QList<QStringList> groups = m_appFacade->groupSimilarInputs(texts);
+
+    for (int g = 0; g < groups.size(); ++g) {
+        foreach (const QString &text, groups[g]) {
+            phrases[textIndex.value(text)].group = g + 1;
+        }
+    }
+
+    printInfo(tr("Chatbot File: %1\nChatbot ID: %2\nMining time: %3 ms\n"
+                 "Uncovered phrases: %4  Groups: %5")
+              .arg(filename)
+              .arg(m_appFacade->chatbotId())
+              .arg(timer.elapsed())
+              .arg(phrases.size())
+              .arg(groups.size()));
+
+    foreach (const Phrase &p, phrases) {
+        printInfo(QString("%1\t%2\t%3").arg(p.count).arg(p.group).arg(p.text));
+    }
+
+    if (!m_reportFilename.isEmpty()) {
+        if (!writeReport(phrases)) {
+            printErr(tr("Cannot write file %1").arg(m_reportFilename));
+            return 1;
+        }
+
+        printInfo(tr("Report written to %1").arg(m_reportFilename));
+    }
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::PhraseMiner::PhraseList
+Lvk::BE::PhraseMiner::mine(const QStringList &ruleInputs, const QString &historyFilename) const
+{
+    QSet<QString> covered = coveredPhrases(ruleInputs);
+
+    Shard *shards = new Shard[SHARD_COUNT];
+
+    // Reading is much faster than lemmatizing. Bounding the batches in flight keeps memory
+    // usage low with big corpora.
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_jobs);
+    QSemaphore slots(2*m_jobs);
+
+    QStringList batch;
+
+    CA::ChatCorpus::Reader corpus;
+    CA::ChatCorpus::CorpusEntry corpusEntry;
+
+    CA::HistoryHelper::Reader history(historyFilename);
+    Cmn::Conversation::Entry historyEntry;
+
+    bool more = true;
+
+    while (more) {
+        if (corpus.next(corpusEntry)) {
+            batch.append(corpusEntry.message);
+        } else if (history.next(historyEntry)) {
+            if (!historyEntry.match) {
+                batch.append(historyEntry.msg);
+            }
+        } else {
+            more = false;
+        }
+
+        if (batch.size() == BATCH_SIZE || (!more && !batch.isEmpty())) {
+            slots.acquire();
+            pool.start(new CountTask(batch, covered, m_minWords, m_maxWords, shards, &slots));
+            batch.clear();
+        }
+    }
+
+    pool.waitForDone();
+
+    PhraseList phrases;
+
+    for (int s = 0; s < SHARD_COUNT; ++s) {
+        for (PhraseCounts::const_iterator it = shards[s].counts.constBegin();
+             it != shards[s].counts.constEnd(); ++it) {
+            if (it.value().count >= MIN_PHRASE_COUNT) {
+                Phrase p;
+                p.text = it.value().text;
+                p.lemmas = it.key();
+                p.count = it.value().count;
+                phrases.append(p);
+            }
+        }
+    }
+
+    delete[] shards;
+
+    int top = qMin(m_top, phrases.size());
+    std::partial_sort(phrases.begin(), phrases.begin() + top, phrases.end(), countsFirst);
+
+    return phrases.mid(0, top);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Wildcards and variables split rule inputs, phrases are covered by the words between them
+QSet<QString> Lvk::BE::PhraseMiner::coveredPhrases(const QStringList &ruleInputs) const
+{
+    QStringList segments;
+
+    foreach (const QString &input, ruleInputs) {
+        segments += input.split(QRegExp("\\*|\\[[^\\]]*\\]"), QString::SkipEmptyParts);
+    }
+
+    QList<Nlp::WordList> words;
+    Nlp::GlobalTools::instance()->lemmatizeBatch(segments, words);
+
+    QSet<QString> covered;
+    QStringList lemmas;
+    QStringList forms;
+
+    foreach (const Nlp::WordList &segment, words) {
+        phraseTokens(segment, lemmas, forms);
+
+        for (int n = m_minWords; n <= m_maxWords; ++n) {
+            for (int i = 0; i + n <= lemmas.size(); ++i) {
+                QString key = phraseKey(lemmas, i, n);
+
+                if (!key.isNull()) {
+                    covered.insert(key);
+                }
+            }
+        }
+    }
+
+    return covered;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::PhraseMiner::writeReport(const PhraseList &phrases)
+{
+    QFile report(m_reportFilename);
+
+    if (!report.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+
+    bool csv = m_reportFilename.endsWith(".csv", Qt::CaseInsensitive);
+
+    QByteArray data;
+
+    if (csv) {
+        Cmn::CsvRow header(QStringList() << "count" << "group" << "phrase" << "lemmas");
+        data += header.toString().toUtf8() + "\n";
+    }
+
+    foreach (const Phrase &p, phrases) {
+        if (csv) {
+            Cmn::CsvRow row;
+            row.append(QString::number(p.count));
+            row.append(QString::number(p.group));
+            row.append(p.text);
+            row.append(p.lemmas);
+            data += row.toString().toUtf8() + "\n";
+        } else {
+            Cmn::JsonWriter w;
+            w.beginObject();
+            w.writeKey("count");
+            w.writeNumber(static_cast<qint64>(p.count));
+            w.writeKey("group");
+            w.writeNumber(static_cast<qint64>(p.group));
+            w.writeKey("phrase");
+            w.writeString(p.text);
+            w.writeKey("lemmas");
+            w.writeString(p.lemmas);
+            w.endObject();
+            data += w.toByteArray() + "\n";
+        }
+    }
+
+    return report.write(data) == data.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::PhraseMiner::printErr(const QString &msg)
+{
+    std::cerr << (tr("ERROR: ") + msg).toUtf8().data() << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::PhraseMiner::printInfo(const QString &msg)
+{
+    std::cout << msg.toUtf8().data() << std::endl;
+}
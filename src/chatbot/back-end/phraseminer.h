@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef LVK_BE_PHRASEMINER_H
+#define LVK_BE_PHRASEMINER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSet>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace BE
+{
+
+class AppFacade;
+
+/// \ingroup Lvk
+/// \addtogroup BE
+/// @{
+
+/**
+ * \brief The PhraseMiner class provides a headless mode that finds the most frequent phrases
+ *        of user messages that the rules of a chatbot do not cover
+ *
+ * The miner streams the chat corpus, see CA::ChatCorpus, and the unmatched entries of the chat
+ * history of the chatbot. Messages are lemmatized in batches by a pool of threads with the
+ * lemmatizer of the NLP engine, and each batch counts its n-grams of lemmas. Counts are merged
+ * into a fixed amount of shards, each one with its own lock, so threads rarely wait for each
+ * other. Each phrase is counted once per message.
+ *
+ * N-grams that appear in some rule input are covered and they are not counted. The top
+ * phrases are grouped by similarity like the bulk teach workflow does, see
+ * AppFacade::groupSimilarInputs(), so each group can be taught as a single rule.
+ *
+ * Files are never loaded in memory and the amount of batches in flight is bounded, hence
+ * memory usage only depends on the amount of distinct phrases.
+ */
+class PhraseMiner : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * \brief The Phrase struct provides a phrase found by the miner
+     */
+    struct Phrase
+    {
+        Phrase() : count(0), group(0) { }
+
+        QString text;       ///< Phrase as written in one of the messages
+        QString lemmas;     ///< Lemmas of the phrase separated by spaces
+        int count;          ///< Amount of messages with the phrase
+        int group;          ///< Group of similar phrases, see AppFacade::groupSimilarInputs()
+    };
+
+    typedef QList<Phrase> PhraseList;
+
+    /**
+     * Creates a PhraseMiner object
+     */
+    PhraseMiner(QObject *parent = 0);
+
+    /**
+     * Destroys the object
+     */
+    ~PhraseMiner();
+
+    /**
+     * Sets the amount of threads that lemmatize and count messages. By default is the amount
+     * of processors.
+     */
+    void setJobs(int jobs);
+
+    /**
+     * Sets the minimum and maximum amount of words of phrases to \a minWords and \a maxWords.
+     * By default phrases have from 2 to 4 words.
+     */
+    void setPhraseLength(int minWords, int maxWords);
+
+    /**
+     * Sets the amount of phrases reported to \a top. By default is 100.
+     */
+    void setTopCount(int top);
+
+    /**
+     * Sets the report file to \a filename. If \a filename ends with ".csv" the report has one CSV
+     * row per phrase. Otherwise, it has one JSON object per line (JSON Lines). Each record has
+     * the phrase, its lemmas, count and group. By default there is no report.
+     */
+    void setReportFile(const QString &filename);
+
+    /**
+     * Finds the top phrases of the chatbot file \a filename, prints them and writes the report.
+     * Returns 0 if success or not zero if there was an error.
+     */
+    int exec(const QString &filename);
+
+    /**
+     * Returns the top phrases of the chat corpus and the unmatched entries of the history file
+     * \a historyFilename not covered by the rule inputs \a ruleInputs, sorted by count. Uses
+     * the lemmatizer of Nlp::GlobalTools.
+     */
+    PhraseList mine(const QStringList &ruleInputs, const QString &historyFilename) const;
+
+private:
+    PhraseMiner(const PhraseMiner&);
+    PhraseMiner & operator=(const PhraseMiner&);
+
+    BE::AppFacade *m_appFacade;
+    int m_jobs;
+    int m_minWords;
+    int m_maxWords;
+    int m_top;
+    QString m_reportFilename;
+
+    QSet<QString> coveredPhrases(const QStringList &ruleInputs) const;
+    bool writeReport(const PhraseList &phrases);
+    void printErr(const QString &msg);
+    void printInfo(const QString &msg);
+};
+
+/// @}
+
+} // namespace BE
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_BE_PHRASEMINER_H
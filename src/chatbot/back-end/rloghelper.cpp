@@ -21,6 +21,7 @@
 
 #include "rloghelper.h"
 #include "da-server/remoteloggerfactory.h"
+#include "da-server/aggregatingremotelogger.h"
 #include "da-server/remoteloggerkeys.h"
 #include "stats/score.h"
 #include "stats/statsmanager.h"
@@ -31,6 +32,21 @@
 #include <QtDebug>
 #include <QSysInfo>
 
+// Aggregated
+#define RLOG_MSG_APP_LAUNCHED       "App launched"
+#define RLOG_MSG_CONNECTED          "Chatbot connected"
+#define RLOG_MSG_DISCONNECTED       "Chatbot disconnected"
+#define RLOG_MSG_SCORE_UPDATE       "Score Update"
+
+// Sampled
+#define RLOG_MSG_GENERAL_METRICS    "General Metrics"
+#define RLOG_MSG_NLP_MEMORY         "NLP Memory"
+#define RLOG_MSG_NLP_SHADOW         "NLP Shadow"
+#define RLOG_MSG_APP_STARTUP        "App startup"
+
+// Raw
+#define RLOG_MSG_BEST_SCORE         "Score Metrics"
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -75,6 +91,33 @@ inline QString getOSType()
 #endif
 }
 
+//--------------------------------------------------------------------------------------------------
+
+Lvk::DAS::AggregatingRemoteLogger *createFastLogger()
+{
+    Lvk::Cmn::SettingsSnapshot settings = Lvk::Cmn::SettingsSnapshot::current();
+    int flushInterval = settings.value(SETTING_APP_STATS_FLUSH_INTERVAL).toInt();
+    double sampleRate = settings.value(SETTING_APP_STATS_SAMPLE_RATE).toDouble();
+
+    Lvk::DAS::AggregatingRemoteLogger *logger =
+            new Lvk::DAS::AggregatingRemoteLogger(Lvk::DAS::RemoteLoggerFactory()
+                                                  .createFastLogger(), flushInterval);
+
+    logger->setAggregated(RLOG_MSG_APP_LAUNCHED);
+    logger->setAggregated(RLOG_MSG_CONNECTED);
+    logger->setAggregated(RLOG_MSG_DISCONNECTED, QStringList() << RLOG_KEY_CONNECTION_DUR);
+    logger->setAggregated(RLOG_MSG_SCORE_UPDATE, QStringList()
+                          << RLOG_KEY_RULES_SCORE << RLOG_KEY_CONV_SCORE
+                          << RLOG_KEY_CONTACTS_SCORE << RLOG_KEY_TOTAL_SCORE);
+
+    logger->setSampled(RLOG_MSG_GENERAL_METRICS, sampleRate);
+    logger->setSampled(RLOG_MSG_NLP_MEMORY, sampleRate);
+    logger->setSampled(RLOG_MSG_NLP_SHADOW, sampleRate);
+    logger->setSampled(RLOG_MSG_APP_STARTUP, sampleRate);
+
+    return logger;
+}
+
 } // namespace
 
 //--------------------------------------------------------------------------------------------------
@@ -82,10 +125,11 @@ inline QString getOSType()
 //--------------------------------------------------------------------------------------------------
 
 Lvk::BE::RlogHelper::RlogHelper()
-    : m_fastLogger(DAS::RemoteLoggerFactory().createFastLogger()),
+    : m_fastLogger(createFastLogger()),
       m_secureLogger(DAS::RemoteLoggerFactory().createSecureLogger()),
-      m_statsEnabled(Cmn::Settings().value(SETTING_APP_SEND_STATS).toBool()),
-      m_appVersion(APP_VERSION_STR)
+      m_statsEnabled(Cmn::SettingsSnapshot::current().value(SETTING_APP_SEND_STATS).toBool()),
+      m_appVersion(APP_VERSION_STR),
+      m_bestTotalScore(-1)
 {
 }
 
@@ -101,6 +145,11 @@ Lvk::BE::RlogHelper::~RlogHelper()
 
 void Lvk::BE::RlogHelper::setUsername(const QString &username)
 {
+    // Aggregated events belong to the previous user
+    if (username != m_username) {
+        m_fastLogger->flush();
+    }
+
     m_username = username;
 }
 
@@ -108,6 +157,10 @@ void Lvk::BE::RlogHelper::setUsername(const QString &username)
 
 void Lvk::BE::RlogHelper::setChatbotId(const QString &chatbotId)
 {
+    if (chatbotId != m_chatbotId) {
+        m_fastLogger->flush();
+    }
+
     m_chatbotId = chatbotId;
 }
 
@@ -115,9 +168,12 @@ void Lvk::BE::RlogHelper::setChatbotId(const QString &chatbotId)
 
 void Lvk::BE::RlogHelper::clear()
 {
+    m_fastLogger->flush();
+
     m_username.clear();
     m_chatbotId.clear();
     m_connectionStart = QDateTime();
+    m_bestTotalScore = -1;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -127,7 +183,7 @@ bool Lvk::BE::RlogHelper::logAppLaunched()
     DAS::RemoteLogger::FieldList fields;
     fields.append(RLOG_KEY_OS_TYPE, getOSType());
 
-    return remoteLog("App launched", fields, false);
+    return remoteLog(RLOG_MSG_APP_LAUNCHED, fields, false);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -158,14 +214,14 @@ bool Lvk::BE::RlogHelper::logChatbotConnected(bool connected)
     DAS::RemoteLogger::FieldList fields;
 
     if (connected) {
-        msg = "Chatbot connected";
+        msg = RLOG_MSG_CONNECTED;
         m_connectionStart = QDateTime::currentDateTime();
     } else {
         if (m_connectionStart.isValid()) {
             uint duration = QDateTime::currentDateTime().toTime_t() - m_connectionStart.toTime_t();
             fields.append(RLOG_KEY_CONNECTION_DUR, QString::number(duration));
         }
-        msg = "Chatbot disconnected";
+        msg = RLOG_MSG_DISCONNECTED;
         m_connectionStart = QDateTime();
     }
 
@@ -179,7 +235,12 @@ bool Lvk::BE::RlogHelper::logAutoScore(const Stats::Score &s)
     DAS::RemoteLogger::FieldList fields;
     append(fields, s);
 
-    return remoteLog("Score Metrics", fields, false);
+    if (s.total > m_bestTotalScore) {
+        m_bestTotalScore = s.total;
+        return remoteLog(RLOG_MSG_BEST_SCORE, fields, false);
+    } else {
+        return remoteLog(RLOG_MSG_SCORE_UPDATE, fields, false);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -200,7 +261,92 @@ bool Lvk::BE::RlogHelper::logDefaultMetrics()
     fields.append(RLOG_KEY_BLACK_ROSTER_SIZE,   getMetric(Stats::BlackRosterSize));
     fields.append(RLOG_KEY_INTERVAL_COUNT,      getInvervalCount());
 
-    return remoteLog("General Metrics", fields, false);
+    return remoteLog(RLOG_MSG_GENERAL_METRICS, fields, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::RlogHelper::logNlpStats(const QVariantMap &stats)
+{
+    if (stats.isEmpty()) {
+        return true;
+    }
+
+    // Fields with the form nlp_<stage>_<metric>
+    DAS::RemoteLogger::FieldList fields;
+    for (QVariantMap::const_iterator it = stats.constBegin(); it != stats.constEnd(); ++it) {
+        QVariantMap stage = it.value().toMap();
+        for (QVariantMap::const_iterator jt = stage.constBegin(); jt != stage.constEnd(); ++jt) {
+            fields.append(QString(RLOG_KEY_NLP_STATS_PREFIX) + it.key() + "_" + jt.key(),
+                          jt.value().toString());
+        }
+    }
+
+    return remoteLog("NLP Stats", fields, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::RlogHelper::logNlpMemory(const QVariantMap &report)
+{
+    if (report.isEmpty()) {
+        return true;
+    }
+
+    // Fields with the form nlp_mem_<metric>
+    DAS::RemoteLogger::FieldList fields;
+    for (QVariantMap::const_iterator it = report.constBegin(); it != report.constEnd(); ++it) {
+        if (it.value().type() != QVariant::Map) {
+            fields.append(QString(RLOG_KEY_NLP_MEMORY_PREFIX) + it.key(), it.value().toString());
+        }
+    }
+
+    return remoteLog(RLOG_MSG_NLP_MEMORY, fields, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::RlogHelper::logNlpShadow(const QVariantMap &stats)
+{
+    if (stats.isEmpty()) {
+        return true;
+    }
+
+    // Fields with the form nlp_shadow_<outcome> and nlp_shadow_<engine>_<metric>
+    DAS::RemoteLogger::FieldList fields;
+    for (QVariantMap::const_iterator it = stats.constBegin(); it != stats.constEnd(); ++it) {
+        if (it.value().type() != QVariant::Map) {
+            fields.append(QString(RLOG_KEY_NLP_SHADOW_PREFIX) + it.key(), it.value().toString());
+            continue;
+        }
+
+        QVariantMap latency = it.value().toMap();
+        for (QVariantMap::const_iterator jt = latency.constBegin(); jt != latency.constEnd();
+             ++jt) {
+            fields.append(QString(RLOG_KEY_NLP_SHADOW_PREFIX) + it.key() + "_" + jt.key(),
+                          jt.value().toString());
+        }
+    }
+
+    return remoteLog(RLOG_MSG_NLP_SHADOW, fields, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::RlogHelper::logStartupTimeline(const QVariantMap &timeline)
+{
+    if (timeline.isEmpty()) {
+        return true;
+    }
+
+    // Fields with the form startup_<phase> in milliseconds
+    DAS::RemoteLogger::FieldList fields;
+    fields.append(RLOG_KEY_OS_TYPE, getOSType());
+    for (QVariantMap::const_iterator it = timeline.constBegin(); it != timeline.constEnd(); ++it) {
+        fields.append(QString(RLOG_KEY_STARTUP_PREFIX) + it.key(), it.value().toString());
+    }
+
+    return remoteLog(RLOG_MSG_APP_STARTUP, fields, false);
 }
 
 //--------------------------------------------------------------------------------------------------
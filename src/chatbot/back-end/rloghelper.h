@@ -26,6 +26,7 @@
 
 #include <QString>
 #include <QDateTime>
+#include <QVariantMap>
 
 namespace Lvk
 {
@@ -38,6 +39,11 @@ namespace Stats
 struct Score;
 }
 
+namespace DAS
+{
+class AggregatingRemoteLogger;
+}
+
 namespace BE
 {
 
@@ -47,6 +53,11 @@ namespace BE
 
 /**
  * \brief The RlogHelper class provides helper methods to log information in the remote server
+ *
+ * Frequent events such as connections, app launches and scores that are not a new best score
+ * are aggregated and logged periodically as a single message. Verbose events such as metrics
+ * and reports are sampled. Rare events are logged as they happen.
+ * \see DAS::AggregatingRemoteLogger
  */
 
 class RlogHelper
@@ -74,7 +85,7 @@ public:
     void setChatbotId(const QString &chatbotId);
 
     /**
-     * Clears the username and chatbot ID previusly set
+     * Clears the username and chatbot ID previusly set. Aggregated events are logged first.
      */
     void clear();
 
@@ -99,7 +110,7 @@ public:
     bool logChatbotConnected(bool connected);
 
     /**
-     * Log automatically triggered score \s
+     * Log automatically triggered score \s. Only new best scores are logged as they happen.
      */
     bool logAutoScore(const Stats::Score &s);
 
@@ -108,17 +119,40 @@ public:
      */
     bool logDefaultMetrics();
 
+    /**
+     * Log NLP engine latency \a stats. \see Nlp::EngineStats::toVariantMap()
+     */
+    bool logNlpStats(const QVariantMap &stats);
+
+    /**
+     * Log NLP engine memory \a report. Per-tree reports are not logged.
+     * \see Nlp::Cb2Engine::property()
+     */
+    bool logNlpMemory(const QVariantMap &report);
+
+    /**
+     * Log the comparisons with the shadow NLP engine in \a stats.
+     * \see Nlp::ShadowStats::toVariantMap()
+     */
+    bool logNlpShadow(const QVariantMap &stats);
+
+    /**
+     * Log the startup \a timeline. \see Cmn::StartupTimeline::toVariantMap()
+     */
+    bool logStartupTimeline(const QVariantMap &timeline);
+
 private:
     RlogHelper(const RlogHelper&);
     RlogHelper & operator=(const RlogHelper&);
 
-    DAS::RemoteLogger *m_fastLogger;
+    DAS::AggregatingRemoteLogger *m_fastLogger;
     DAS::RemoteLogger *m_secureLogger;
     bool m_statsEnabled;
     QString m_appVersion;
     QString m_username;
     QString m_chatbotId;
     QDateTime m_connectionStart;
+    double m_bestTotalScore;
 
     bool remoteLog(const QString &msg, const DAS::RemoteLogger::FieldList &fields, bool secure);
 };
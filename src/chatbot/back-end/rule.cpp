@@ -20,41 +20,94 @@
  */
 
 #include "back-end/rule.h"
+#include "back-end/mappedfile.h"
 
 #include <QtAlgorithms>
 #include <QIcon>
+#include <QDataStream>
+#include <QAtomicInt>
 #include <assert.h>
 
 #define LVK_BE_RULE_VERSION     4
 
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+QAtomicInt revisionCounter;
+
+// Revisions are unique among all rules
+inline quint32 nextRevision()
+{
+    return revisionCounter.fetchAndAddRelaxed(1) + 1;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Rule::Data
+//--------------------------------------------------------------------------------------------------
+
+// Rule strings, implicitly shared between copies of a rule. Strings read from a file may be
+// still encoded, in which case they are decoded in place the first time they are accessed.
+struct Lvk::BE::Rule::Data : public QSharedData
+{
+    Data(const QString &name = "", const QStringList &input = QStringList(),
+         const QStringList &output = QStringList())
+        : name(name), input(input), output(output), nameOffset(0), nameSize(0), bodyOffset(0),
+          bodySize(0), nameDecoded(true), bodyDecoded(true) { }
+
+    mutable QString name;
+    mutable QStringList input;
+    mutable QStringList output;
+    mutable TargetList target;
+    mutable QSharedPointer<MappedFile> file;
+    quint32 nameOffset;
+    quint32 nameSize;
+    quint32 bodyOffset;
+    quint32 bodySize;
+    mutable bool nameDecoded;
+    mutable bool bodyDecoded;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Rule
+//--------------------------------------------------------------------------------------------------
 
 Lvk::BE::Rule::Rule()
-    : m_name(""), m_input(), m_output(), m_parentItem(0), m_type(OrdinaryRule),
-      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0)
+    : m_data(new Data()), m_parentItem(0), m_row(0), m_type(OrdinaryRule),
+      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0),
+      m_tracker(0), m_revision(nextRevision())
 {
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::BE::Rule::Rule(const QString &name)
-    : m_name(name), m_input(), m_output(), m_parentItem(0), m_type(OrdinaryRule),
-      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0)
+    : m_data(new Data(name)), m_parentItem(0), m_row(0), m_type(OrdinaryRule),
+      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0),
+      m_tracker(0), m_revision(nextRevision())
 {
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::BE::Rule::Rule(const QString &name, Type type)
-    : m_name(name), m_input(), m_output(), m_parentItem(0), m_type(type),
-      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0)
+    : m_data(new Data(name)), m_parentItem(0), m_row(0), m_type(type),
+      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0),
+      m_tracker(0), m_revision(nextRevision())
 {
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::BE::Rule::Rule(const QString &name, const QStringList &input, const QStringList &ouput)
-    : m_name(name), m_input(input), m_output(ouput), m_parentItem(0), m_type(OrdinaryRule),
-      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0)
+    : m_data(new Data(name, input, ouput)), m_parentItem(0), m_row(0), m_type(OrdinaryRule),
+      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0),
+      m_tracker(0), m_revision(nextRevision())
 {
 }
 
@@ -62,17 +115,18 @@ Lvk::BE::Rule::Rule(const QString &name, const QStringList &input, const QString
 
 Lvk::BE::Rule::Rule(const QString &name, Type type, const QStringList &input,
                     const QStringList &ouput)
-    : m_name(name), m_input(input), m_output(ouput), m_parentItem(0), m_type(type),
-      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0)
+    : m_data(new Data(name, input, ouput)), m_parentItem(0), m_row(0), m_type(type),
+      m_enabled(false), m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0),
+      m_tracker(0), m_revision(nextRevision())
 {
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::BE::Rule::Rule(const Rule &other, bool deepCopy /*= false*/)
-    : m_name(other.m_name), m_input(other.m_input), m_output(other.m_output),
-      m_target(other.m_target), m_parentItem(0), m_type(other.m_type), m_enabled(other.m_enabled),
-      m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0)
+    : m_data(other.m_data), m_parentItem(0), m_row(0), m_type(other.m_type), m_enabled(other.m_enabled),
+      m_status(Unsaved), m_checkState(Qt::Unchecked), m_id(0), m_nextCatId(0),
+      m_tracker(0), m_revision(nextRevision())
 {
     if (deepCopy) {
         foreach (const Rule *rule, other.m_childItems) {
@@ -86,6 +140,10 @@ Lvk::BE::Rule::Rule(const Rule &other, bool deepCopy /*= false*/)
 Lvk::BE::Rule::~Rule()
 {
     qDeleteAll(m_childItems);
+
+    if (m_tracker) {
+        m_tracker->remove(this);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -110,13 +168,25 @@ Lvk::BE::Rule::~Rule()
 
 bool Lvk::BE::Rule::operator==(const Lvk::BE::Rule &other) const
 {
-    return m_type == other.m_type &&
-           m_name == other.m_name &&
-           m_target == other.m_target &&
-           m_nextCatId == other.m_nextCatId &&
-           m_input == other.m_input &&
-           m_output == other.m_output &&
-           m_id == other.m_id;
+    if (m_type != other.m_type || m_nextCatId != other.m_nextCatId || m_id != other.m_id) {
+        return false;
+    }
+
+    // Rules sharing strings do not have to decode them
+    if (m_data == other.m_data) {
+        return true;
+    }
+
+    decode();
+    other.decode();
+
+    const Data *d = m_data.constData();
+    const Data *o = other.m_data.constData();
+
+    return d->name == o->name &&
+           d->target == o->target &&
+           d->input == o->input &&
+           d->output == o->output;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -163,10 +233,12 @@ bool Lvk::BE::Rule::appendChild(Rule *item)
     assert(!m_childItems.contains(item));
 
     item->m_parentItem = this;
+    item->m_row = m_childItems.size();
 
     m_childItems.append(item);
 
-    m_status = Unsaved;
+    adopt(item);
+    markChildrenChanged();
 
     return true;
 }
@@ -183,9 +255,11 @@ bool Lvk::BE::Rule::insertChildren(int position, int count)
         Rule *rule = new Rule();
         rule->m_parentItem = this;
         m_childItems.insert(position, rule);
+        adopt(rule);
     }
 
-    m_status = Unsaved;
+    updateRows(position);
+    markChildrenChanged();
 
     return true;
 }
@@ -202,7 +276,8 @@ bool Lvk::BE::Rule::removeChildren(int position, int count)
         delete m_childItems.takeAt(position);
     }
 
-    m_status = Unsaved;
+    updateRows(position);
+    markChildrenChanged();
 
     return true;
 }
@@ -226,6 +301,11 @@ bool Lvk::BE::Rule::moveChildren(int position, int count, Lvk::BE::Rule *newPare
         newParent->appendChild(m_childItems.takeAt(position));
     }
 
+    if (count > 0) {
+        updateRows(position);
+        markChildrenChanged();
+    }
+
     return true;
 }
 
@@ -262,9 +342,7 @@ int Lvk::BE::Rule::childCount() const
 Lvk::BE::Rule * Lvk::BE::Rule::nextSibling()
 {
     if (m_parentItem != 0) {
-        // TODO consider not using indexOf to improve performance. Instead store the sibling number
-        //      as a class atribute
-        int i = m_parentItem->m_childItems.indexOf(const_cast<Rule *>(this));
+        int i = row();
 
         if (i + 1 <  m_parentItem->m_childItems.size()) {
             return m_parentItem->m_childItems[i + 1];
@@ -278,9 +356,7 @@ Lvk::BE::Rule * Lvk::BE::Rule::nextSibling()
 const Lvk::BE::Rule * Lvk::BE::Rule::nextSibling() const
 {
     if (m_parentItem) {
-        // TODO consider not using indexOf to improve performance. Instead store the sibling number
-        //      as a class atribute
-        int i = m_parentItem->m_childItems.indexOf(const_cast<Rule *>(this));
+        int i = row();
 
         if (i + 1 <  m_parentItem->m_childItems.size()) {
             return m_parentItem->m_childItems[i + 1];
@@ -291,14 +367,39 @@ const Lvk::BE::Rule * Lvk::BE::Rule::nextSibling() const
 
 //--------------------------------------------------------------------------------------------------
 
+int Lvk::BE::Rule::row() const
+{
+    if (!m_parentItem) {
+        return 0;
+    }
+
+    const QList<Rule *> &siblings = m_parentItem->m_childItems;
+
+    // If the list of siblings was modified through children(), positions are outdated
+    if (m_row < 0 || m_row >= siblings.size() || siblings[m_row] != this) {
+        m_parentItem->updateRows(0);
+    }
+
+    return m_row;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::updateRows(int from) const
+{
+    for (int i = from; i < m_childItems.size(); ++i) {
+        m_childItems[i]->m_row = i;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::BE::Rule::clear()
 {
-    m_name.clear();
-    m_input.clear();
-    m_output.clear();
-    m_target.clear();
+    m_data = new Data();
     m_childItems.clear();
-    m_status = Unsaved;
+    markChanged();
+    markChildrenChanged();
     m_checkState = Qt::Unchecked;
     m_nextCatId = 0;
 }
@@ -309,7 +410,7 @@ void Lvk::BE::Rule::setType(Rule::Type type)
 {
     if (m_type != type) {
         m_type = type;
-        m_status = Unsaved;
+        markChanged();
     }
 }
 
@@ -324,75 +425,93 @@ Lvk::BE::Rule::Type Lvk::BE::Rule::type() const
 
 Lvk::BE::TargetList &Lvk::BE::Rule::target()
 {
-    m_status = Unsaved;
+    decodeBody();
+
+    markChanged();
 
-    return m_target;
+    return m_data->target;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 const Lvk::BE::TargetList &Lvk::BE::Rule::target() const
 {
-    return m_target;
+    decodeBody();
+
+    return m_data.constData()->target;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::BE::Rule::setTarget(const TargetList &target)
 {
-    m_status = Unsaved;
+    decodeBody();
 
-    m_target = target;
+    markChanged();
+
+    m_data->target = target;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 QStringList &Lvk::BE::Rule::input()
 {
-    m_status = Unsaved;
+    decodeBody();
 
-    return m_input;
+    markChanged();
+
+    return m_data->input;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 const QStringList &Lvk::BE::Rule::input() const
 {
-    return m_input;
+    decodeBody();
+
+    return m_data.constData()->input;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::BE::Rule::setInput(const QStringList &input)
 {
-    m_status = Unsaved;
+    decodeBody();
 
-    m_input = input;
+    markChanged();
+
+    m_data->input = input;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 QStringList &Lvk::BE::Rule::output()
 {
-    m_status = Unsaved;
+    decodeBody();
+
+    markChanged();
 
-    return m_output;
+    return m_data->output;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 const QStringList &Lvk::BE::Rule::output() const
 {
-    return m_output;
+    decodeBody();
+
+    return m_data.constData()->output;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::BE::Rule::setOutput(const QStringList &output)
 {
-    m_status = Unsaved;
+    decodeBody();
+
+    markChanged();
 
-    m_output = output;
+    m_data->output = output;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -409,7 +528,7 @@ void Lvk::BE::Rule::setNextCategory(quint64 catId)
     if (m_nextCatId != catId) {
         m_nextCatId = catId;
 
-        m_status = Unsaved;
+        markChanged();
     }
 }
 
@@ -417,17 +536,21 @@ void Lvk::BE::Rule::setNextCategory(quint64 catId)
 
 const QString &Lvk::BE::Rule::name() const
 {
-    return m_name;
+    decodeName();
+
+    return m_data.constData()->name;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::BE::Rule::setName(const QString &name)
 {
-    if (m_name != name) {
-        m_name = name;
+    decodeName();
+
+    if (m_data.constData()->name != name) {
+        m_data->name = name;
 
-        m_status = Unsaved;
+        markChanged();
     }
 }
 
@@ -435,13 +558,17 @@ void Lvk::BE::Rule::setName(const QString &name)
 
 bool Lvk::BE::Rule::isComplete() const
 {
+    decode();
+
+    const Data *d = m_data.constData();
+
     switch (m_type) {
     case OrdinaryRule:
-        return m_input.size() > 0 && m_output.size() > 0;
+        return d->input.size() > 0 && d->output.size() > 0;
     case ContainerRule:
-        return m_name.size() > 0;
+        return d->name.size() > 0;
     case EvasiveRule:
-        return m_output.size() > 0;
+        return d->output.size() > 0;
     default:
         return false;
     }
@@ -451,7 +578,90 @@ bool Lvk::BE::Rule::isComplete() const
 
 bool Lvk::BE::Rule::isEmpty() const
 {
-    return m_name.isEmpty() && m_output.isEmpty() && m_input.isEmpty() && m_target.isEmpty();
+    decode();
+
+    const Data *d = m_data.constData();
+
+    return d->name.isEmpty() && d->output.isEmpty() && d->input.isEmpty() && d->target.isEmpty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::setEncodedStrings(const QSharedPointer<MappedFile> &file, quint32 nameOffset,
+                                      quint32 nameSize, quint32 bodyOffset, quint32 bodySize)
+{
+    m_data = new Data();
+
+    m_data->file = file;
+    m_data->nameOffset = nameOffset;
+    m_data->nameSize = nameSize;
+    m_data->bodyOffset = bodyOffset;
+    m_data->bodySize = bodySize;
+    m_data->nameDecoded = false;
+    m_data->bodyDecoded = false;
+
+    m_revision = nextRevision();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::decode() const
+{
+    decodeName();
+    decodeBody();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Decoding does not detach, all copies sharing the strings see them decoded
+void Lvk::BE::Rule::decodeName() const
+{
+    const Data *d = m_data.constData();
+
+    if (d->nameDecoded) {
+        return;
+    }
+
+    QDataStream stream(d->file->bytes(d->nameOffset, d->nameSize));
+    stream.setVersion(QDataStream::Qt_4_7);
+    stream >> d->name;
+
+    d->nameDecoded = true;
+
+    releaseFile();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::decodeBody() const
+{
+    const Data *d = m_data.constData();
+
+    if (d->bodyDecoded) {
+        return;
+    }
+
+    QDataStream stream(d->file->bytes(d->bodyOffset, d->bodySize));
+    stream.setVersion(QDataStream::Qt_4_7);
+    stream >> d->target;
+    stream >> d->input;
+    stream >> d->output;
+
+    d->bodyDecoded = true;
+
+    releaseFile();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Once all strings are decoded, the rule does not keep a reference to the file
+void Lvk::BE::Rule::releaseFile() const
+{
+    const Data *d = m_data.constData();
+
+    if (d->nameDecoded && d->bodyDecoded) {
+        d->file.clear();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -537,7 +747,7 @@ void Lvk::BE::Rule::setEnabled(bool enabled)
 {
     if (m_enabled != enabled) {
         m_enabled = enabled;
-        m_status = Unsaved;
+        markChanged();
     }
 }
 
@@ -553,6 +763,14 @@ Lvk::BE::Rule::Status Lvk::BE::Rule::status() const
 void Lvk::BE::Rule::setStatus(Status status)
 {
     m_status = status;
+
+    if (m_tracker) {
+        if (status == Saved) {
+            m_tracker->m_unsaved.remove(this);
+        } else {
+            m_tracker->m_unsaved.insert(this);
+        }
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -578,7 +796,163 @@ quint64 Lvk::BE::Rule::id() const
 
 //--------------------------------------------------------------------------------------------------
 
+quint32 Lvk::BE::Rule::revision() const
+{
+    return m_revision;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::BE::Rule::setId(quint64 id)
 {
-    m_id = id;
+    if (m_id != id) {
+        quint64 oldId = m_id;
+        m_id = id;
+
+        // Saved changes refer to rules by ID. Changing the ID does not change the status.
+        if (m_tracker) {
+            m_tracker->updateId(this, oldId);
+            m_tracker->m_changed.insert(this);
+
+            if (m_parentItem) {
+                m_tracker->m_childrenChanged.insert(m_parentItem);
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::setTracker(RuleChangeTracker *tracker)
+{
+    if (m_tracker == tracker) {
+        return;
+    }
+
+    if (m_tracker) {
+        m_tracker->remove(this);
+    }
+
+    m_tracker = tracker;
+
+    if (m_tracker) {
+        m_tracker->updateId(this, 0);
+
+        if (m_status == Unsaved) {
+            m_tracker->m_unsaved.insert(this);
+        }
+    }
+
+    foreach (Rule *child, m_childItems) {
+        child->setTracker(tracker);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::RuleChangeTracker * Lvk::BE::Rule::tracker() const
+{
+    return m_tracker;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::markChanged()
+{
+    m_status = Unsaved;
+    m_revision = nextRevision();
+
+    if (m_tracker) {
+        m_tracker->m_unsaved.insert(this);
+        m_tracker->m_changed.insert(this);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::markChildrenChanged()
+{
+    m_status = Unsaved;
+    m_revision = nextRevision();
+
+    if (m_tracker) {
+        m_tracker->m_unsaved.insert(this);
+        m_tracker->m_childrenChanged.insert(this);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::markSubtreeChanged()
+{
+    markChanged();
+    markChildrenChanged();
+
+    foreach (Rule *child, m_childItems) {
+        child->markSubtreeChanged();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::Rule::adopt(Rule *child)
+{
+    // Rules moved within the same tree keep their attributes, only the parents change
+    if (child->m_tracker != m_tracker) {
+        child->setTracker(m_tracker);
+
+        if (m_tracker) {
+            child->markSubtreeChanged();
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// RuleChangeTracker
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleChangeTracker::setAsSaved()
+{
+    // setStatus() removes the rule from m_unsaved
+    QSet<Rule *> unsaved = m_unsaved;
+
+    foreach (Rule *rule, unsaved) {
+        rule->setStatus(Rule::Saved);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleChangeTracker::clear()
+{
+    m_unsaved.clear();
+    m_changed.clear();
+    m_childrenChanged.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleChangeTracker::remove(Rule *rule)
+{
+    m_unsaved.remove(rule);
+    m_changed.remove(rule);
+    m_childrenChanged.remove(rule);
+
+    if (m_rules.value(rule->id()) == rule) {
+        m_rules.remove(rule->id());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleChangeTracker::updateId(Rule *rule, quint64 oldId)
+{
+    if (oldId && m_rules.value(oldId) == rule) {
+        m_rules.remove(oldId);
+    }
+
+    if (rule->id()) {
+        m_rules.insert(rule->id(), rule);
+    }
 }
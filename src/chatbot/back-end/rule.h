@@ -26,6 +26,10 @@
 #include <QString>
 #include <QStringList>
 #include <QVariant>
+#include <QSharedPointer>
+#include <QSharedDataPointer>
+#include <QSet>
+#include <QHash>
 
 #include "back-end/target.h"
 
@@ -38,6 +42,9 @@ namespace Lvk
 namespace BE
 {
 
+class MappedFile;
+class RuleChangeTracker;
+
 /// \ingroup Lvk
 /// \addtogroup BE
 /// @{
@@ -54,6 +61,16 @@ namespace BE
  *
  * Given a root rule it can be iterated using STL-like iterator classes Rule::iterator and
  * Rule::const_iterator
+ *
+ * Rules read from a file can keep their strings encoded until they are accessed.
+ * See setEncodedStrings().
+ *
+ * Strings are implicitly shared between a rule and its copies, and they are only copied when
+ * one of the copies is modified. Hence copying a rule, or a whole tree with deep copy, does
+ * not copy nor decode its strings.
+ *
+ * Changes made to a rules tree can be tracked with a RuleChangeTracker. See setTracker().
+ * The tracker also indexes the rules of the tree by ID.
  */
 class Rule
 {
@@ -247,6 +264,13 @@ public:
      */
     const Rule *nextSibling() const;
 
+    /**
+     * Returns the position of the rule in the list of children of its parent. If the rule has
+     * no parent, it returns 0. The position is cached, so this method takes constant time
+     * unless the list of children was modified directly through children().
+     */
+    int row() const;
+
 
 
     /**
@@ -400,11 +424,41 @@ public:
      */
     void setId(quint64 id);
 
+    /**
+     * Returns the rule revision. The revision changes every time the attributes or the list
+     * of children of the rule change. Two rules never have the same revision.
+     */
+    quint32 revision() const;
+
     /**
      * Clears the rule by setting all attribures to the default value.
      */
     void clear();
 
+    /**
+     * Sets the rule strings to be decoded on demand from \a file. The encoded name is
+     * \a nameSize bytes at \a nameOffset. The encoded target, input and output are
+     * \a bodySize bytes at \a bodyOffset. Current strings are discarded.
+     */
+    void setEncodedStrings(const QSharedPointer<MappedFile> &file, quint32 nameOffset,
+                           quint32 nameSize, quint32 bodyOffset, quint32 bodySize);
+
+    /**
+     * Decodes all strings that were not decoded yet. After calling this method the rule does
+     * not depend on the file it was read from.
+     */
+    void decode() const;
+
+    /**
+     * Sets \a tracker to this rule and all its children. Every rule appended later to the tree
+     * inherits the tracker. If \a tracker is 0, changes are no longer tracked.
+     */
+    void setTracker(RuleChangeTracker *tracker);
+
+    /**
+     * Returns the tracker of the rule. If there is no tracker, it returns 0.
+     */
+    RuleChangeTracker *tracker() const;
 
 
     /**
@@ -453,18 +507,96 @@ private:
     //Rule(const Rule &other);
     Rule& operator=(Rule &other);
 
+    struct Data;
+
     QList<Rule*> m_childItems;
-    QString m_name;
-    QStringList m_input;
-    QStringList m_output;
-    TargetList m_target;
+    QSharedDataPointer<Data> m_data;
     Rule *m_parentItem;
+    mutable int m_row;
     Type m_type;
     bool m_enabled;
     Status m_status;
     Qt::CheckState m_checkState;
     quint64 m_id;
     quint64 m_nextCatId;
+    RuleChangeTracker *m_tracker;
+    quint32 m_revision;
+
+    void decodeName() const;
+    void decodeBody() const;
+    void releaseFile() const;
+    void markChanged();
+    void markChildrenChanged();
+    void markSubtreeChanged();
+    void adopt(Rule *child);
+    void updateRows(int from) const;
+};
+
+/**
+ * \brief The RuleChangeTracker class keeps the set of rules changed since the last save.
+ *
+ * Rules notify the tracker when their attributes or their list of children change, so
+ * that finding which rules have to be saved does not require to iterate the whole tree.
+ * Deleted rules are removed from the tracker.
+ *
+ * Rules also notify the tracker when their ID changes, so that rules can be looked up by ID
+ * with rule() in constant time.
+ *
+ * \see Rule::setTracker()
+ */
+class RuleChangeTracker
+{
+public:
+
+    /**
+     * Constructs an empty tracker.
+     */
+    RuleChangeTracker() { }
+
+    /**
+     * Returns true if some rule has the status Rule::Unsaved. Otherwise; returns false.
+     */
+    bool hasUnsavedChanges() const { return !m_unsaved.isEmpty(); }
+
+    /**
+     * Returns the set of rules whose attributes changed.
+     */
+    const QSet<Rule *> &changed() const { return m_changed; }
+
+    /**
+     * Returns the set of rules whose list of children changed.
+     */
+    const QSet<Rule *> &childrenChanged() const { return m_childrenChanged; }
+
+    /**
+     * Returns the rule with the given \a id. If there is no such rule or \a id is 0,
+     * it returns 0.
+     */
+    Rule *rule(quint64 id) const { return id ? m_rules.value(id) : 0; }
+
+    /**
+     * Sets the status Rule::Saved to all unsaved rules. The sets of changed rules are kept.
+     */
+    void setAsSaved();
+
+    /**
+     * Forgets all changes. The rules are still indexed by ID.
+     */
+    void clear();
+
+private:
+    RuleChangeTracker(RuleChangeTracker&);
+    RuleChangeTracker& operator=(RuleChangeTracker&);
+
+    friend class Rule;
+
+    QSet<Rule *> m_unsaved;
+    QSet<Rule *> m_changed;
+    QSet<Rule *> m_childrenChanged;
+    QHash<quint64, Rule *> m_rules;
+
+    void remove(Rule *rule);
+    void updateId(Rule *rule, quint64 oldId);
 };
 
 /**
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "back-end/rulecompiler.h"
+#include "back-end/appfacade.h"
+#include "back-end/rule.h"
+#include "nlp-engine/ruleissue.h"
+#include "nlp-engine/rulecost.h"
+#include "common/json.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+QString issueTypeName(Lvk::Nlp::RuleIssue::Type type)
+{
+    switch (type) {
+    case Lvk::Nlp::RuleIssue::EmptyInput:
+        return "empty_input";
+    case Lvk::Nlp::RuleIssue::DuplicatedInput:
+        return "duplicated_input";
+    case Lvk::Nlp::RuleIssue::ShadowedByWildcard:
+        return "shadowed_by_wildcard";
+    }
+
+    return QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString ruleInput(const Lvk::BE::Rule *rule, int inputIdx)
+{
+    return rule ? rule->input().value(inputIdx) : QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void writeMap(Lvk::Cmn::JsonWriter &w, const QVariantMap &map)
+{
+    w.beginObject();
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+        w.writeKey(it.key());
+        w.writeNumber(it.value().toLongLong());
+    }
+    w.endObject();
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// RuleCompiler
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::RuleCompiler::RuleCompiler(QObject *parent)
+    : QObject(parent), m_appFacade(0), m_profileRules(false), m_profileTop(10)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::RuleCompiler::~RuleCompiler()
+{
+    delete m_appFacade;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleCompiler::setOutputFile(const QString &filename)
+{
+    m_outputFilename = filename;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleCompiler::setReportFile(const QString &filename)
+{
+    m_reportFilename = filename;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleCompiler::setProfileRules(bool enabled, int top /*= 10*/)
+{
+    m_profileRules = enabled;
+    m_profileTop = qMax(1, top);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::BE::RuleCompiler::exec(const QString &filename)
+{
+    if (!QFileInfo(filename).isFile()) {
+        printErr(tr("File %1 does not exist").arg(filename));
+        return 1;
+    }
+
+    if (!m_appFacade) {
+        m_appFacade = new BE::AppFacade();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!m_appFacade->load(filename)) {
+        printErr(tr("Cannot load file %1").arg(filename));
+        return 1;
+    }
+
+    m_appFacade->waitForNlpEngine();
+
+    qint64 loadMsecs = timer.elapsed();
+
+    QString chatbotId = m_appFacade->chatbotId();
+    QString output = m_outputFilename;
+
+    if (output.isEmpty()) {
+        output = QFileInfo(filename).dir().filePath(chatbotId + ".snap");
+    }
+
+    timer.restart();
+
+    if (!m_appFacade->compileNlpSnapshot(output)) {
+        printErr(tr("Cannot write snapshot %1").arg(output));
+        return 1;
+    }
+
+    qint64 compileMsecs = timer.elapsed();
+
+    QVariantMap memory = m_appFacade->nlpMemoryReport();
+    Nlp::RuleIssueList issues = m_appFacade->lintRules();
+
+    // Issues refer to rules by ID, inputs are shown as they were written
+    QHash<quint64, const BE::Rule *> rules;
+    for (BE::Rule::iterator it = m_appFacade->rootRule()->begin();
+         it != m_appFacade->rootRule()->end(); ++it) {
+        rules.insert((*it)->id(), *it);
+    }
+
+    printInfo(tr("Chatbot File: %1\nChatbot ID: %2\nSnapshot: %3 (%4 bytes)\n"
+                 "Load time: %5 ms\nCompile time: %6 ms\n"
+                 "Rules: %7  Nodes: %8 (words %9, wildcards %10, variables %11)  Issues: %12")
+              .arg(filename)
+              .arg(chatbotId)
+              .arg(output)
+              .arg(QFileInfo(output).size())
+              .arg(loadMsecs)
+              .arg(compileMsecs)
+              .arg(memory.value("rules").toInt())
+              .arg(memory.value("nodes").toInt())
+              .arg(memory.value("wordNodes").toInt())
+              .arg(memory.value("wildcardNodes").toInt())
+              .arg(memory.value("variableNodes").toInt())
+              .arg(issues.size()));
+
+    foreach (const Nlp::RuleIssue &issue, issues) {
+        printWarn(tr("Rule #%1: Input \"%2\" never matches (%3)")
+                  .arg(issue.ruleId)
+                  .arg(ruleInput(rules.value(issue.ruleId), issue.inputIdx))
+                  .arg(issueTypeName(issue.type)));
+    }
+
+    Nlp::RuleCostList costs;
+
+    if (m_profileRules) {
+        costs = m_appFacade->profileRules();
+
+        printInfo(tr("Costliest rules:"));
+
+        for (int i = 0; i < costs.size() && i < m_profileTop; ++i) {
+            const Nlp::RuleCost &c = costs[i];
+            const BE::Rule *rule = rules.value(c.ruleId);
+            printInfo(tr("  Rule #%1 \"%2\": Nodes: %3  Wildcard edges: %4  Outputs: %5  "
+                         "Lemmatize: %6 us  Build: %7 us")
+                      .arg(c.ruleId)
+                      .arg(rule ? rule->name() : QString())
+                      .arg(c.nodes)
+                      .arg(c.wildcardEdges)
+                      .arg(c.omapEntries)
+                      .arg(c.lemmatizeUsecs)
+                      .arg(c.buildUsecs));
+        }
+    }
+
+    if (m_reportFilename.isEmpty()) {
+        return 0;
+    }
+
+    Cmn::JsonWriter w;
+
+    w.beginObject();
+    w.writeKey("file");
+    w.writeString(filename);
+    w.writeKey("chatbot_id");
+    w.writeString(chatbotId);
+    w.writeKey("snapshot");
+    w.writeString(output);
+    w.writeKey("snapshot_bytes");
+    w.writeNumber(QFileInfo(output).size());
+    w.writeKey("load_msecs");
+    w.writeNumber(loadMsecs);
+    w.writeKey("compile_msecs");
+    w.writeNumber(compileMsecs);
+    w.writeKey("memory");
+    writeMap(w, memory);
+    w.writeKey("issues");
+    w.beginArray();
+    foreach (const Nlp::RuleIssue &issue, issues) {
+        w.beginObject();
+        w.writeKey("type");
+        w.writeString(issueTypeName(issue.type));
+        w.writeKey("rule");
+        w.writeNumber(static_cast<qint64>(issue.ruleId));
+        w.writeKey("input");
+        w.writeString(ruleInput(rules.value(issue.ruleId), issue.inputIdx));
+        w.writeKey("other_rule");
+        if (issue.otherRuleId) {
+            w.writeNumber(static_cast<qint64>(issue.otherRuleId));
+        } else {
+            w.writeNull();
+        }
+        w.writeKey("other_input");
+        if (issue.otherRuleId) {
+            w.writeString(ruleInput(rules.value(issue.otherRuleId), issue.otherInputIdx));
+        } else {
+            w.writeNull();
+        }
+        w.endObject();
+    }
+    w.endArray();
+    if (m_profileRules) {
+        w.writeKey("rule_costs");
+        w.beginArray();
+        foreach (const Nlp::RuleCost &c, costs) {
+            w.beginObject();
+            w.writeKey("rule");
+            w.writeNumber(static_cast<qint64>(c.ruleId));
+            w.writeKey("inputs");
+            w.writeNumber(static_cast<qint64>(c.inputs));
+            w.writeKey("words");
+            w.writeNumber(static_cast<qint64>(c.words));
+            w.writeKey("nodes");
+            w.writeNumber(static_cast<qint64>(c.nodes));
+            w.writeKey("omap_entries");
+            w.writeNumber(static_cast<qint64>(c.omapEntries));
+            w.writeKey("wildcard_edges");
+            w.writeNumber(static_cast<qint64>(c.wildcardEdges));
+            w.writeKey("lemmatize_usecs");
+            w.writeNumber(c.lemmatizeUsecs);
+            w.writeKey("build_usecs");
+            w.writeNumber(c.buildUsecs);
+            w.endObject();
+        }
+        w.endArray();
+    }
+    w.endObject();
+
+    QByteArray record = w.toByteArray() + "\n";
+
+    QFile report(m_reportFilename);
+
+    if (!report.open(QFile::WriteOnly | QFile::Truncate) || report.write(record) != record.size()) {
+        printErr(tr("Cannot write file %1").arg(m_reportFilename));
+        return 1;
+    }
+
+    printInfo(tr("Report written to %1").arg(m_reportFilename));
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleCompiler::printErr(const QString &msg)
+{
+    std::cerr << (tr("ERROR: ") + msg).toUtf8().data() << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleCompiler::printWarn(const QString &msg)
+{
+    std::cout << (tr("Warning: ") + msg).toUtf8().data() << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleCompiler::printInfo(const QString &msg)
+{
+    std::cout << msg.toUtf8().data() << std::endl;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_BE_RULECOMPILER_H
+#define LVK_BE_RULECOMPILER_H
+
+#include <QObject>
+#include <QString>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace BE
+{
+
+class AppFacade;
+
+/// \ingroup Lvk
+/// \addtogroup BE
+/// @{
+
+/**
+ * \brief The RuleCompiler class provides a headless mode that compiles the rules of a chatbot
+ *        file into an NLP engine snapshot
+ *
+ * Snapshots let chatbots skip compiling their rules, which runs the lemmatizer over every rule
+ * input. Chatbots compiled once, for instance in a CI job, can be deployed with their
+ * snapshot so hosts load it instead, see AppFacade::compileNlpSnapshot().
+ *
+ * Besides the snapshot, the compiler prints the compile time, the node counts of the compiled
+ * rules and the rule inputs that never match, and optionally writes them to a JSON report,
+ * see setReportFile(). If profiling is enabled, it also prints the rules that cost the most to
+ * compile, see setProfileRules().
+ */
+class RuleCompiler : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Creates a RuleCompiler object
+     */
+    RuleCompiler(QObject *parent = 0);
+
+    /**
+     * Destroys the object
+     */
+    ~RuleCompiler();
+
+    /**
+     * Sets the snapshot file to \a filename. By default, the snapshot is written next to the
+     * chatbot file as "<chatbot ID>.snap", the name chatbots look for in their extras path.
+     */
+    void setOutputFile(const QString &filename);
+
+    /**
+     * Sets the report file to \a filename. The report is a JSON object with the chatbot ID,
+     * the snapshot file and size, the load and compile times in milliseconds, the memory
+     * report of the compiled rules and the rule issues found. By default there is no report.
+     */
+    void setReportFile(const QString &filename);
+
+    /**
+     * Enables or disables profiling of rules. If \a enabled is true, the rules are compiled
+     * once more to record the cost of each rule, the \a top costliest rules are printed and
+     * the report includes the costs of all rules. By default profiling is disabled.
+     * \see AppFacade::profileRules()
+     */
+    void setProfileRules(bool enabled, int top = 10);
+
+    /**
+     * Compiles the chatbot file \a filename. Returns 0 if success or not zero if there was an
+     * error. Rule issues are warnings, they are not errors.
+     */
+    int exec(const QString &filename);
+
+private:
+    RuleCompiler(const RuleCompiler&);
+    RuleCompiler & operator=(const RuleCompiler&);
+
+    BE::AppFacade *m_appFacade;
+    QString m_outputFilename;
+    QString m_reportFilename;
+    bool m_profileRules;
+    int m_profileTop;
+
+    void printErr(const QString &msg);
+    void printWarn(const QString &msg);
+    void printInfo(const QString &msg);
+};
+
+/// @}
+
+} // namespace BE
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_BE_RULECOMPILER_H
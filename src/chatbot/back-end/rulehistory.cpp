@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "back-end/rulehistory.h"
+#include "back-end/rule.h"
+
+//--------------------------------------------------------------------------------------------------
+// RuleHistory::State
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::RuleHistory::State::State()
+    : ruleId(0), nextCategory(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::RuleHistory::State::State(const Rule &rule)
+    : ruleId(rule.id()), name(rule.name()), target(rule.target()), input(rule.input()),
+      output(rule.output()), nextCategory(rule.nextCategory())
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleHistory::State::applyTo(Rule *rule) const
+{
+    rule->setName(name);
+    rule->setTarget(target);
+    rule->setInput(input);
+    rule->setOutput(output);
+    rule->setNextCategory(nextCategory);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::RuleHistory::State::operator==(const State &other) const
+{
+    return ruleId == other.ruleId
+            && name == other.name
+            && target == other.target
+            && input == other.input
+            && output == other.output
+            && nextCategory == other.nextCategory;
+}
+
+//--------------------------------------------------------------------------------------------------
+// RuleHistory
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::RuleHistory::RuleHistory(int maxSteps /*= 256*/)
+    : m_next(0), m_maxSteps(qMax(1, maxSteps))
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleHistory::record(const State &before, const State &after)
+{
+    if (before == after || !after.ruleId) {
+        return;
+    }
+
+    // A new edit discards the steps that were undone
+    while (m_steps.size() > m_next) {
+        m_steps.removeLast();
+    }
+
+    Step step;
+    step.before = before;
+    step.after = after;
+    m_steps.append(step);
+
+    if (m_steps.size() > m_maxSteps) {
+        m_steps.removeFirst();
+    }
+
+    m_next = m_steps.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::RuleHistory::canUndo() const
+{
+    return m_next > 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::BE::RuleHistory::canRedo() const
+{
+    return m_next < m_steps.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::Rule *Lvk::BE::RuleHistory::undo(Rule *root)
+{
+    while (m_next > 0) {
+        const Step &step = m_steps[--m_next];
+
+        if (Rule *rule = findRule(root, step.before.ruleId)) {
+            step.before.applyTo(rule);
+            return rule;
+        }
+    }
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::Rule *Lvk::BE::RuleHistory::redo(Rule *root)
+{
+    while (m_next < m_steps.size()) {
+        const Step &step = m_steps[m_next++];
+
+        if (Rule *rule = findRule(root, step.after.ruleId)) {
+            step.after.applyTo(rule);
+            return rule;
+        }
+    }
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::BE::RuleHistory::clear()
+{
+    m_steps.clear();
+    m_next = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::BE::Rule *Lvk::BE::RuleHistory::findRule(Rule *root, quint64 ruleId)
+{
+    if (!root || !ruleId) {
+        return 0;
+    }
+
+    // The tracker indexes rules by ID, otherwise the tree is scanned
+    if (root->tracker()) {
+        return root->tracker()->rule(ruleId);
+    }
+
+    for (Rule::iterator it = root->begin(); it != root->end(); ++it) {
+        if ((*it)->id() == ruleId) {
+            return *it;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_BE_RULEHISTORY_H
+#define LVK_BE_RULEHISTORY_H
+
+#include "back-end/target.h"
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace BE
+{
+
+/// \ingroup Lvk
+/// \addtogroup BE
+/// @{
+
+class Rule;
+
+/**
+ * \brief The RuleHistory class provides multi-level undo and redo of rule edits
+ *
+ * Each step keeps the editable attributes of one rule before and after an edit: name, targets,
+ * inputs, outputs and next category. Strings and lists are implicitly shared with the rule,
+ * so a step costs a few pointers regardless of the size of the rules tree, and undoing or
+ * redoing a step only touches the edited rule. The file is never read again.
+ *
+ * Steps refer to rules by ID. Steps of rules that no longer exist are skipped.
+ *
+ * Adding, removing and moving rules are not recorded.
+ */
+class RuleHistory
+{
+public:
+
+    /**
+     * \brief The State class provides the editable attributes of a rule
+     */
+    class State
+    {
+    public:
+        /**
+         * Constructs a null state
+         */
+        State();
+
+        /**
+         * Constructs the state of \a rule
+         */
+        State(const Rule &rule);
+
+        /**
+         * Sets the state to \a rule.
+         */
+        void applyTo(Rule *rule) const;
+
+        /**
+         * Returns true if \a this and \a other have the same attributes. Otherwise; returns
+         * false.
+         */
+        bool operator==(const State &other) const;
+
+        quint64 ruleId;
+        QString name;
+        TargetList target;
+        QStringList input;
+        QStringList output;
+        quint64 nextCategory;
+    };
+
+    /**
+     * Constructs an empty history that keeps up to \a maxSteps steps.
+     */
+    RuleHistory(int maxSteps = 256);
+
+    /**
+     * Records an edit of a rule from \a before to \a after. Discards the steps that were
+     * undone. If the edit does not change the rule, this method does nothing.
+     */
+    void record(const State &before, const State &after);
+
+    /**
+     * Returns true if there is a step to undo. Otherwise; returns false.
+     */
+    bool canUndo() const;
+
+    /**
+     * Returns true if there is a step to redo. Otherwise; returns false.
+     */
+    bool canRedo() const;
+
+    /**
+     * Undoes the last step on the rules tree with root \a root. Returns the rule that has
+     * changed or 0 if there was nothing to undo.
+     */
+    Rule *undo(Rule *root);
+
+    /**
+     * Redoes the last undone step on the rules tree with root \a root. Returns the rule that
+     * has changed or 0 if there was nothing to redo.
+     */
+    Rule *redo(Rule *root);
+
+    /**
+     * Discards all steps.
+     */
+    void clear();
+
+private:
+    struct Step
+    {
+        State before;
+        State after;
+    };
+
+    QList<Step> m_steps;
+    int m_next;         // Index of the next step to redo, steps before it can be undone
+    int m_maxSteps;
+
+    static Rule *findRule(Rule *root, quint64 ruleId);
+};
+
+/// @}
+
+} // namespace BE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_BE_RULEHISTORY_H
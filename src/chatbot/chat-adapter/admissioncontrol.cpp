@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "chat-adapter/admissioncontrol.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#define DEFAULT_RATE            1.0     // Messages per second of each contact
+#define DEFAULT_BURST           10      // Messages of a contact at once
+#define DEFAULT_WINDOW          10000   // Milliseconds to drop duplicated messages
+#define DEFAULT_MAX_LENGTH      2000    // Characters
+#define MIN_PRUNE_SIZE          1024    // Contacts kept before forgetting idle ones
+
+//--------------------------------------------------------------------------------------------------
+// AdmissionControl::Stats
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::CA::AdmissionControl::Stats::toVariantMap() const
+{
+    QVariantMap map;
+    map["accepted"] = accepted;
+    map["rateLimited"] = rateLimited;
+    map["duplicates"] = duplicates;
+    map["oversized"] = oversized;
+    map["shed"] = shed;
+
+    return map;
+}
+
+//--------------------------------------------------------------------------------------------------
+// AdmissionControl
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::AdmissionControl::AdmissionControl()
+    : m_mutex(new QMutex()),
+      m_rate(DEFAULT_RATE),
+      m_burst(DEFAULT_BURST),
+      m_window(DEFAULT_WINDOW),
+      m_maxLength(DEFAULT_MAX_LENGTH),
+      m_shedThreshold(0),
+      m_pruneSize(MIN_PRUNE_SIZE)
+{
+    m_clock.start();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::AdmissionControl::~AdmissionControl()
+{
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::AdmissionControl::setRate(double rate, int burst)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_rate = rate;
+    m_burst = burst > 0 ? burst : 1;
+
+    for (QHash<QString, ContactState>::iterator it = m_contacts.begin();
+         it != m_contacts.end(); ++it) {
+        it->tokens = qMin(it->tokens, m_burst);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::AdmissionControl::setDuplicateWindow(int msecs)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_window = qMax(0, msecs);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::AdmissionControl::setMaxLength(int length)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_maxLength = qMax(0, length);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::AdmissionControl::setShedThreshold(int pending)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_shedThreshold = qMax(0, pending);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::AdmissionControl::Decision Lvk::CA::AdmissionControl::admit(const QString &contact,
+                                                                     const QString &body,
+                                                                     int pending)
+{
+    return admit(contact, body, pending, m_clock.elapsed());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::AdmissionControl::Decision Lvk::CA::AdmissionControl::admit(const QString &contact,
+                                                                     const QString &body,
+                                                                     int pending, qint64 now)
+{
+    QMutexLocker locker(m_mutex);
+
+    QHash<QString, ContactState>::iterator it = m_contacts.find(contact);
+
+    if (it == m_contacts.end()) {
+        if (m_contacts.size() >= m_pruneSize) {
+            prune(now);
+        }
+
+        ContactState state;
+        state.tokens = m_burst;
+        state.lastRefill = now;
+        state.lastHash = 0;
+        state.lastTime = -1;
+
+        it = m_contacts.insert(contact, state);
+    }
+
+    return decide(*it, body, pending, now);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::AdmissionControl::Decision Lvk::CA::AdmissionControl::decide(ContactState &state,
+                                                                      const QString &body,
+                                                                      int pending, qint64 now)
+{
+    if (m_rate > 0) {
+        state.tokens = qMin(m_burst, state.tokens + (now - state.lastRefill) * m_rate / 1000.0);
+        state.lastRefill = now;
+
+        if (state.tokens < 1.0) {
+            ++m_stats.rateLimited;
+            return Drop;
+        }
+        state.tokens -= 1.0;
+    }
+
+    // Floods are usually the same text pasted again, so the raw text is compared
+    uint hash = qHash(body);
+    bool duplicate = m_window > 0 && state.lastTime >= 0 && hash == state.lastHash
+            && now - state.lastTime < m_window;
+
+    state.lastHash = hash;
+    state.lastTime = now;
+
+    if (duplicate) {
+        ++m_stats.duplicates;
+        return Drop;
+    }
+
+    if (m_maxLength > 0 && body.size() > m_maxLength) {
+        ++m_stats.oversized;
+        return Degrade;
+    }
+
+    if (m_shedThreshold > 0 && pending >= m_shedThreshold) {
+        ++m_stats.shed;
+        return Degrade;
+    }
+
+    ++m_stats.accepted;
+    return Accept;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Forgets the contacts with a full bucket and an expired window. They would get the same
+// decisions than a new contact.
+void Lvk::CA::AdmissionControl::prune(qint64 now)
+{
+    QHash<QString, ContactState>::iterator it = m_contacts.begin();
+
+    while (it != m_contacts.end()) {
+        qint64 refill = m_rate > 0 ? (qint64)((m_burst - it->tokens) * 1000.0 / m_rate) : 0;
+        bool full = now - it->lastRefill >= refill;
+        bool expired = it->lastTime < 0 || now - it->lastTime >= m_window;
+
+        if (full && expired) {
+            it = m_contacts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Prune again once the contacts double, so the cost per message is constant
+    m_pruneSize = qMax(MIN_PRUNE_SIZE, 2 * m_contacts.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::AdmissionControl::contactCount() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_contacts.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::AdmissionControl::Stats Lvk::CA::AdmissionControl::stats() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::AdmissionControl::resetStats()
+{
+    QMutexLocker locker(m_mutex);
+
+    m_stats = Stats();
+}
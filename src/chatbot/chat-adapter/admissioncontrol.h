@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CA_ADMISSIONCONTROL_H
+#define LVK_CA_ADMISSIONCONTROL_H
+
+#include <QString>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace CA
+{
+
+/// \ingroup Lvk
+/// \addtogroup CA
+/// @{
+
+/**
+ * \brief The AdmissionControl class decides which received messages are matched before they
+ *        reach the AI.
+ *
+ * Checks are cheap and run in this order:
+ * - Each contact has a token bucket. Messages of a contact that exceeds its rate are dropped.
+ * - A message equal to the previous one of the same contact within the duplicate window is
+ *   dropped. Floods of the same message keep the window open.
+ * - Messages longer than the max length are answered with an evasive without matching them.
+ * - If the amount of messages waiting for a response reaches the shed threshold, messages are
+ *   answered with an evasive without matching them until the workers catch up.
+ *
+ * Dropped messages are neither answered nor written to the history. Contacts idle long enough
+ * to have a full bucket and an expired window are forgotten from time to time.
+ *
+ * AdmissionControl is thread-safe.
+ */
+class AdmissionControl
+{
+public:
+
+    /**
+     * Decisions for a received message
+     */
+    enum Decision {
+        Accept,         ///< Match the message
+        Degrade,        ///< Answer the message with an evasive without matching it
+        Drop            ///< Ignore the message
+    };
+
+    /**
+     * Amount of messages of each decision
+     */
+    struct Stats
+    {
+        Stats() : accepted(0), rateLimited(0), duplicates(0), oversized(0), shed(0) { }
+
+        unsigned accepted;      ///< Messages accepted
+        unsigned rateLimited;   ///< Messages dropped because their contact exceeded its rate
+        unsigned duplicates;    ///< Messages dropped because they repeat the previous one
+        unsigned oversized;     ///< Messages degraded because they are too long
+        unsigned shed;          ///< Messages degraded because of overload
+
+        /**
+         * Returns the stats as a map with the names of the fields as keys
+         */
+        QVariantMap toVariantMap() const;
+    };
+
+    /**
+     * Constructs an AdmissionControl object with the default limits
+     */
+    AdmissionControl();
+
+    /**
+     * Destroys the object
+     */
+    ~AdmissionControl();
+
+    /**
+     * Sets the \a rate in messages per second and the max \a burst of messages of each
+     * contact. If \a rate is zero or less, contacts are not rate limited.
+     */
+    void setRate(double rate, int burst);
+
+    /**
+     * Sets the window in milliseconds in which a message equal to the previous one of the
+     * same contact is dropped. Zero disables the check.
+     */
+    void setDuplicateWindow(int msecs);
+
+    /**
+     * Sets the max length in characters of messages matched. Zero means no limit.
+     */
+    void setMaxLength(int length);
+
+    /**
+     * Sets the amount of messages waiting for a response from which messages are degraded.
+     * Zero means no limit.
+     */
+    void setShedThreshold(int pending);
+
+    /**
+     * Returns the decision for message \a body of \a contact given that \a pending messages
+     * are waiting for a response, and updates the state of the contact and the stats.
+     */
+    Decision admit(const QString &contact, const QString &body, int pending);
+
+    /**
+     * \copydoc admit()
+     *
+     * \a now is the time in milliseconds of the message. It must not decrease between calls.
+     */
+    Decision admit(const QString &contact, const QString &body, int pending, qint64 now);
+
+    /**
+     * Returns the amount of contacts with state
+     */
+    int contactCount() const;
+
+    /**
+     * Returns the stats.
+     */
+    Stats stats() const;
+
+    /**
+     * Resets the stats.
+     */
+    void resetStats();
+
+private:
+    AdmissionControl(AdmissionControl&);
+    AdmissionControl& operator=(AdmissionControl&);
+
+    struct ContactState
+    {
+        double tokens;
+        qint64 lastRefill;      // msecs
+        uint lastHash;          // hash of the previous message
+        qint64 lastTime;        // msecs of the previous message
+    };
+
+    QMutex *m_mutex;
+    QElapsedTimer m_clock;
+    QHash<QString, ContactState> m_contacts;
+    double m_rate;
+    double m_burst;
+    int m_window;
+    int m_maxLength;
+    int m_shedThreshold;
+    int m_pruneSize;            // contacts from which idle ones are forgotten
+    Stats m_stats;
+
+    Decision decide(ContactState &state, const QString &body, int pending, qint64 now);
+    void prune(qint64 now);
+};
+
+/// @}
+
+} // namespace CA
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_CA_ADMISSIONCONTROL_H
@@ -15,6 +15,11 @@ HEADERS += \
     $$PROJECT_PATH/chat-adapter/fbchatbot.h \
     $$PROJECT_PATH/chat-adapter/gtalkchatbot.h \
     $$PROJECT_PATH/chat-adapter/contactinfo.h \
+    $$PROJECT_PATH/chat-adapter/contactscheduler.h \
+    $$PROJECT_PATH/chat-adapter/contactring.h \
+    $$PROJECT_PATH/chat-adapter/vcardcache.h \
+    $$PROJECT_PATH/chat-adapter/outboundqueue.h \
+    $$PROJECT_PATH/chat-adapter/admissioncontrol.h \
     $$PROJECT_PATH/chat-adapter/chatcorpus.h \
     $$PROJECT_PATH/chat-adapter/chatbotai.h \
     $$PROJECT_PATH/chat-adapter/fbownmessageextension.h \
@@ -22,6 +27,11 @@ HEADERS += \
 SOURCES += \
     $$PROJECT_PATH/chat-adapter/historyhelper.cpp \
     $$PROJECT_PATH/chat-adapter/xmppchatbot.cpp \
+    $$PROJECT_PATH/chat-adapter/contactscheduler.cpp \
+    $$PROJECT_PATH/chat-adapter/contactring.cpp \
+    $$PROJECT_PATH/chat-adapter/vcardcache.cpp \
+    $$PROJECT_PATH/chat-adapter/outboundqueue.cpp \
+    $$PROJECT_PATH/chat-adapter/admissioncontrol.cpp \
     $$PROJECT_PATH/chat-adapter/fbchatbot.cpp \
     $$PROJECT_PATH/chat-adapter/gtalkchatbot.cpp \
     $$PROJECT_PATH/chat-adapter/chatbot.cpp \
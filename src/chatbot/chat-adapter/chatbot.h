@@ -142,15 +142,26 @@ public:
     virtual QString historyFilename() const = 0;
 
     /**
-     * Returns the chat history of the chatbot
+     * Returns the recent chat history of the chatbot
      */
     virtual const Cmn::Conversation &chatHistory() const = 0;
 
+    /**
+     * Returns the chat history of the chatbot between \a from (inclusive) and \a to
+     * (exclusive). A null \a from or \a to means no lower or upper bound respectively.
+     */
+    virtual Cmn::Conversation chatHistory(const QDateTime &from, const QDateTime &to) const = 0;
+
     /**
      * Sets the chat history of the chatbot.
      */
     virtual void setChatHistory(const Cmn::Conversation &conv) = 0;
 
+    /**
+     * Removes the chat history with \a user in \a date.
+     */
+    virtual void removeChatHistory(const QDate &date, const QString &user) = 0;
+
     /**
      * Clears the chat history.
      */
@@ -178,6 +189,22 @@ signals:
      * This signal is emitted whenever the chatbot receives a chat message.
      */
     void newConversationEntry(const Cmn::Conversation::Entry &entry);
+
+    /**
+     * This signal is emitted when \a contact is added to the roster after the roster was
+     * received, i.e. after the signal connected() was emitted.
+     */
+    void contactAdded(const CA::ContactInfo &contact);
+
+    /**
+     * This signal is emitted when the information of \a contact has changed.
+     */
+    void contactChanged(const CA::ContactInfo &contact);
+
+    /**
+     * This signal is emitted when the contact with \a username is removed from the roster.
+     */
+    void contactRemoved(const QString &username);
 };
 
 /// @}
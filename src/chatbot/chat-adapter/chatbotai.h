@@ -59,6 +59,14 @@ public:
      */
     virtual Cmn::Conversation::Entry getEntry(const QString &input,
                                               const CA::ContactInfo &contact) = 0;
+
+    /**
+     * Returns a conversation entry with an evasive response for the given \a input and
+     * \a contact without matching the input, e.g. to answer quickly while overloaded. If there
+     * are no evasives, the response is empty.
+     */
+    virtual Cmn::Conversation::Entry getEvasiveEntry(const QString &input,
+                                                     const CA::ContactInfo &contact) = 0;
 };
 
 /// @}
@@ -24,8 +24,11 @@
 #include "common/globalstrings.h"
 #include "common/settings.h"
 #include "common/settingskeys.h"
+#include "common/journal.h"
+#include "common/taskscheduler.h"
 
 #include <QFile>
+#include <QFileInfo>
 #include <QDir>
 #include <QStringList>
 #include <QRegExp>
@@ -34,7 +37,13 @@
 #include <QDateTime>
 #include <QtDebug>
 
-#define CORPUS_FILE     "corpus.dat"
+#include <zlib.h>
+
+#define CORPUS_FILE             "corpus.dat"
+#define CORPUS_SEGMENT_PREFIX   "corpus-"
+#define CORPUS_SEGMENT_SUFFIX   ".dat"
+#define CORPUS_GZIP_SUFFIX      ".gz"
+#define CORPUS_SEGMENT_FORMAT   "yyyyMMdd-hhmmsszzz"
 
 //--------------------------------------------------------------------------------------------------
 // Helpers
@@ -48,6 +57,82 @@ QString sanitize(const QString &str)
     return str.simplified();
 }
 
+//--------------------------------------------------------------------------------------------------
+
+inline QString corpusPath()
+{
+    Lvk::Cmn::SettingsSnapshot settings = Lvk::Cmn::SettingsSnapshot::current();
+    return settings.value(SETTING_DATA_PATH).toString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Compresses the rotated segment \a filename into filename.gz and removes the uncompressed
+// segment. Invoked in a worker thread.
+bool compressSegment(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QFile::ReadOnly)) {
+        qWarning() << "ChatCorpus: Cannot open segment" << filename;
+        return false;
+    }
+
+    QString gzFilename = filename + CORPUS_GZIP_SUFFIX;
+    QString tmpFilename = gzFilename + ".tmp";
+
+    gzFile gz = gzopen(QFile::encodeName(tmpFilename).constData(), "wb");
+    if (!gz) {
+        qWarning() << "ChatCorpus: Cannot create compressed segment" << tmpFilename;
+        return false;
+    }
+
+    bool success = true;
+    char buf[64*1024];
+    qint64 len = 0;
+
+    while (success && (len = file.read(buf, sizeof(buf))) > 0) {
+        success = gzwrite(gz, buf, static_cast<unsigned>(len)) == len;
+    }
+
+    success = (gzclose(gz) == Z_OK) && success && len == 0;
+
+    file.close();
+
+    // Once the compressed segment is renamed, the uncompressed one is not needed anymore.
+    // If we crash in between, segments() prefers the compressed one.
+    if (success) {
+        QFile::remove(gzFilename);
+        success = QFile::rename(tmpFilename, gzFilename);
+    }
+
+    if (success) {
+        QFile::remove(filename);
+    } else {
+        qWarning() << "ChatCorpus: Cannot compress segment" << filename;
+        QFile::remove(tmpFilename);
+    }
+
+    return success;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool parseEntry(const QString &line, Lvk::CA::ChatCorpus::CorpusEntry &entry)
+{
+    Lvk::Cmn::CsvRow row(line);
+
+    if (row.size() != 4) {
+        return false;
+    }
+
+    entry.timestamp = QDateTime::fromString(row[0], STR_CHAT_CORPUS_DATE_TIME_FORMAT);
+    entry.thread    = row[1];
+    entry.username  = row[2];
+    entry.message   = row[3];
+
+    return true;
+}
+
 } // namespace
 
 
@@ -59,7 +144,11 @@ bool Lvk::CA::ChatCorpus::m_init = false;
 
 QFile Lvk::CA::ChatCorpus::m_corpusFile;
 
-QList<Lvk::CA::ChatCorpus::CorpusEntry> Lvk::CA::ChatCorpus::m_corpus;
+QDate Lvk::CA::ChatCorpus::m_segmentDate;
+
+qint64 Lvk::CA::ChatCorpus::m_segmentSize = 0;
+
+qint64 Lvk::CA::ChatCorpus::m_maxSegmentSize = 0;
 
 QMutex *Lvk::CA::ChatCorpus::m_mutex = new QMutex();
 
@@ -77,12 +166,24 @@ void Lvk::CA::ChatCorpus::init()
     if (!m_init) {
         QMutexLocker locker(m_mutex);
         if (!m_init) {
-            Cmn::Settings settings;
-            QString dataPath = settings.value(SETTING_DATA_PATH).toString();
-
-            m_corpusFile.setFileName(dataPath + QDir::separator() + CORPUS_FILE);
-
-            load();
+            Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+            m_maxSegmentSize = settings.value(SETTING_CORPUS_MAX_SIZE).toLongLong();
+
+            m_corpusFile.setFileName(corpusPath() + QDir::separator() + CORPUS_FILE);
+
+            QFileInfo info(m_corpusFile);
+            m_segmentSize = info.exists() ? info.size() : 0;
+            m_segmentDate = info.exists() ? info.lastModified().date() : QDate::currentDate();
+
+            // Segments rotated but not compressed, i.e. the application was closed while
+            // compressing
+            foreach (const QString &segment, segments()) {
+                if (segment.endsWith(CORPUS_SEGMENT_SUFFIX)
+                        && QFileInfo(segment).fileName() != CORPUS_FILE) {
+                    Cmn::TaskScheduler::scheduler()->run(Cmn::TaskScheduler::Background,
+                                                         compressSegment, segment);
+                }
+            }
 
             if (!m_corpusFile.open(QFile::Append)) {
                 qWarning() << QObject::tr("Warning: cannot open corpus file for writing");
@@ -112,65 +213,161 @@ void Lvk::CA::ChatCorpus::add(const CorpusEntry &entry)
 {
     QMutexLocker locker(m_mutex);
 
-    m_corpus.append(entry);
+    if (!m_corpusFile.isOpen()) {
+        return;
+    }
+
+    if (m_segmentSize > 0 && (entry.timestamp.date() != m_segmentDate
+                              || (m_maxSegmentSize > 0 && m_segmentSize >= m_maxSegmentSize))) {
+        rotate();
+    }
+
+    Cmn::CsvRow row;
+    row.append(entry.timestamp.toString(STR_CHAT_CORPUS_DATE_TIME_FORMAT));
+    row.append(sanitize(entry.thread));
+    row.append(sanitize(entry.username));
+    row.append(sanitize(entry.message));
+
+    QByteArray data = row.toString().toUtf8() + "\n";
+
+    Cmn::Journal::journal()->write(&m_corpusFile, data);
+
+    m_segmentSize += data.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// m_mutex must be locked
+void Lvk::CA::ChatCorpus::rotate()
+{
+    Cmn::Journal::journal()->flush(&m_corpusFile);
+    m_corpusFile.close();
+
+    QString segment = corpusPath() + QDir::separator() + CORPUS_SEGMENT_PREFIX
+            + QDateTime::currentDateTime().toString(CORPUS_SEGMENT_FORMAT) + CORPUS_SEGMENT_SUFFIX;
 
-    if (m_corpusFile.isOpen()) {
-        Cmn::CsvRow row;
-        row.append(entry.timestamp.toString(STR_CHAT_CORPUS_DATE_TIME_FORMAT));
-        row.append(sanitize(entry.thread));
-        row.append(sanitize(entry.username));
-        row.append(sanitize(entry.message));
+    if (QFile::rename(m_corpusFile.fileName(), segment)) {
+        Cmn::TaskScheduler::scheduler()->run(Cmn::TaskScheduler::Background, compressSegment,
+                                             segment);
+    } else {
+        qWarning() << "ChatCorpus: Cannot rotate corpus file" << m_corpusFile.fileName();
+    }
 
-        m_corpusFile.write(row.toString().toUtf8());
-        m_corpusFile.write("\n");
-        m_corpusFile.flush();
+    if (!m_corpusFile.open(QFile::Append)) {
+        qWarning() << QObject::tr("Warning: cannot open corpus file for writing");
     }
+
+    m_segmentSize = m_corpusFile.size();
+    m_segmentDate = QDate::currentDate();
 }
 
 //--------------------------------------------------------------------------------------------------
 
 QList<Lvk::CA::ChatCorpus::CorpusEntry> Lvk::CA::ChatCorpus::corpus()
 {
-    QMutexLocker locker(m_mutex);
-    return m_corpus;
+    QList<CorpusEntry> corpus;
+    CorpusEntry entry;
+
+    Reader reader;
+    while (reader.next(entry)) {
+        corpus.append(entry);
+    }
+
+    return corpus;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::CA::ChatCorpus::load()
+QStringList Lvk::CA::ChatCorpus::segments()
 {
-    if (!m_corpusFile.exists()) {
-        // Nothing to do
-        return;
+    QDir dir(corpusPath());
+
+    QStringList filters;
+    filters << (CORPUS_SEGMENT_PREFIX "*" CORPUS_SEGMENT_SUFFIX)
+            << (CORPUS_SEGMENT_PREFIX "*" CORPUS_SEGMENT_SUFFIX CORPUS_GZIP_SUFFIX);
+
+    // Timestamps in names sort segments chronologically
+    QStringList names = dir.entryList(filters, QDir::Files, QDir::Name);
+
+    QStringList segments;
+    foreach (const QString &name, names) {
+        // If compression was interrupted after renaming, skip the uncompressed copy
+        if (name.endsWith(CORPUS_SEGMENT_SUFFIX) && names.contains(name + CORPUS_GZIP_SUFFIX)) {
+            continue;
+        }
+        segments.append(dir.filePath(name));
     }
-    if (!m_corpusFile.open(QFile::ReadOnly)) {
-        qWarning() << QObject::tr("Warning: cannot open corpus file for reading");
-        return;
+
+    if (dir.exists(CORPUS_FILE)) {
+        segments.append(dir.filePath(CORPUS_FILE));
     }
 
-    char buf[10*1024];
-    qint64 len = 0;
-    QString line;
-    Cmn::CsvRow row;
+    return segments;
+}
 
-    do {
-        len = m_corpusFile.readLine(buf, sizeof(buf));
-        if (len > 0) {
-            line = QString::fromUtf8(buf);
-            row = Cmn::CsvRow(line);
+//--------------------------------------------------------------------------------------------------
+// ChatCorpus::Reader
+//--------------------------------------------------------------------------------------------------
 
-            if (row.size() == 4) {
-                CorpusEntry entry;
-                entry.timestamp = QDateTime::fromString(row[0], STR_CHAT_CORPUS_DATE_TIME_FORMAT);
-                entry.thread    = row[1];
-                entry.username  = row[2];
-                entry.message   = row[3];
+Lvk::CA::ChatCorpus::Reader::Reader()
+    : m_current(-1), m_file(0)
+{
+    init();
 
-                m_corpus.append(entry);
-            }
+    {
+        // Pending entries in the active segment
+        QMutexLocker locker(m_mutex);
+        Cmn::Journal::journal()->flush(&m_corpusFile);
+    }
+
+    m_segments = segments();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::ChatCorpus::Reader::~Reader()
+{
+    if (m_file) {
+        gzclose(m_file);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// gzread reads transparently segments that are not compressed
+bool Lvk::CA::ChatCorpus::Reader::openNext()
+{
+    if (m_file) {
+        gzclose(m_file);
+        m_file = 0;
+    }
+
+    while (!m_file && ++m_current < m_segments.size()) {
+        m_file = gzopen(QFile::encodeName(m_segments[m_current]).constData(), "rb");
+
+        if (!m_file) {
+            qWarning() << "ChatCorpus: Cannot open segment" << m_segments[m_current];
         }
-    } while (len != -1);
+    }
 
-    m_corpusFile.close();
+    return m_file != 0;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::ChatCorpus::Reader::next(CorpusEntry &entry)
+{
+    char buf[10*1024];
+
+    while (m_file || openNext()) {
+        if (gzgets(m_file, buf, sizeof(buf))) {
+            if (parseEntry(QString::fromUtf8(buf), entry)) {
+                return true;
+            }
+        } else {
+            openNext();
+        }
+    }
+
+    return false;
+}
@@ -25,11 +25,14 @@
 #include <QList>
 #include <QPair>
 #include <QString>
+#include <QStringList>
 #include <QFile>
 #include <QDateTime>
 
 class QMutex;
 
+struct gzFile_s;
+
 namespace Lvk
 {
 
@@ -53,7 +56,10 @@ namespace CA
  * Currently, only FbChatbot class uses ChatCorpus. FbChatbot can "hear" chat conversations
  * from the real user but GtalkChatbot does not.
  *
- * TODO explain log format
+ * Entries are not kept in memory. They are written in CSV format (timestamp, thread, username
+ * and message) by the write-behind journal to the active segment. Once the active segment
+ * reaches a max size (see SETTING_CORPUS_MAX_SIZE) or the day changes, it is rotated and
+ * compressed in background with gzip. Use ChatCorpus::Reader to stream all segments back.
  */
 
 class ChatCorpus
@@ -71,6 +77,42 @@ public:
         QString message;     ///< Message
     };
 
+    /**
+     * \brief The Reader class provides sequential access to all corpus segments.
+     *
+     * Segments are read from the oldest to the newest, the active segment is read last.
+     */
+    class Reader
+    {
+    public:
+
+        /**
+         * Constructs a Reader positioned at the first entry of the corpus.
+         */
+        Reader();
+
+        /**
+         * Destroys the object.
+         */
+        ~Reader();
+
+        /**
+         * Reads the next corpus entry into \a entry. Returns true on success. Otherwise;
+         * returns false if there are no more entries.
+         */
+        bool next(CorpusEntry &entry);
+
+    private:
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+
+        QStringList m_segments;
+        int m_current;
+        gzFile_s *m_file;
+
+        bool openNext();
+    };
+
     /**
      * Constructs a ChatCorpus object initialized with the default data file.
      */
@@ -88,21 +130,29 @@ public:
     void add(const QString &username, const QString &message, const QString &thread);
 
     /**
-     * Returns all the entries in the corpus.
+     * Returns all the entries in the corpus. Entries are read from disk, for big corpora use
+     * ChatCorpus::Reader instead.
      */
     QList<CorpusEntry> corpus();
 
+    /**
+     * Returns the filenames of all corpus segments sorted from oldest to newest.
+     */
+    static QStringList segments();
+
 private:
     ChatCorpus(const ChatCorpus&);
     ChatCorpus& operator=(const ChatCorpus&);
 
     static bool m_init;
     static QFile m_corpusFile;
-    static QList<CorpusEntry> m_corpus;
+    static QDate m_segmentDate;
+    static qint64 m_segmentSize;
+    static qint64 m_maxSegmentSize;
     static QMutex *m_mutex;
 
-    void init();
-    void load();
+    static void init();
+    static void rotate();
 };
 
 /// @}
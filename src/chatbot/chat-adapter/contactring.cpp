@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "chat-adapter/contactring.h"
+
+#include <QtAlgorithms>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// FNV-1a with a final mix, qHash() is not guaranteed to be the same in every process
+quint32 stableHash(const QByteArray &data)
+{
+    quint32 h = 2166136261u;
+
+    for (int i = 0; i < data.size(); ++i) {
+        h = (h ^ (uchar)data[i]) * 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// ContactRing
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::ContactRing::ContactRing(int shards /*= 1*/, int replicas /*= 64*/)
+    : m_shards(qMax(1, shards))
+{
+    replicas = qMax(1, replicas);
+
+    m_points.reserve(m_shards*replicas);
+
+    for (int s = 0; s < m_shards; ++s) {
+        for (int r = 0; r < replicas; ++r) {
+            Point p;
+            p.hash = stableHash(QString("shard%1-%2").arg(s).arg(r).toUtf8());
+            p.shard = s;
+            m_points.append(p);
+        }
+    }
+
+    qSort(m_points);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::ContactRing::shard(const QString &contact) const
+{
+    if (m_shards == 1) {
+        return 0;
+    }
+
+    Point key;
+    key.hash = stableHash(contact.toLower().toUtf8());
+    key.shard = 0;
+
+    QVector<Point>::const_iterator it = qLowerBound(m_points.constBegin(), m_points.constEnd(),
+                                                    key);
+
+    // The ring wraps around
+    if (it == m_points.constEnd()) {
+        it = m_points.constBegin();
+    }
+
+    return it->shard;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::ContactRing::shardCount() const
+{
+    return m_shards;
+}
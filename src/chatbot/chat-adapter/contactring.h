@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CA_CONTACTRING_H
+#define LVK_CA_CONTACTRING_H
+
+#include <QString>
+#include <QVector>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace CA
+{
+
+/// \ingroup Lvk
+/// \addtogroup CA
+/// @{
+
+/**
+ * \brief The ContactRing class assigns contacts to shards by consistent hashing.
+ *
+ * Each shard owns several points of a hash ring and a contact belongs to the shard of the
+ * first point that follows the hash of its bare JID. Adding or removing a shard only moves
+ * the contacts of the points that changed, about one in every shard count.
+ *
+ * The hash does not depend on the process or the platform, so every process that uses a ring
+ * with the same shard count assigns a contact to the same shard.
+ */
+class ContactRing
+{
+public:
+
+    /**
+     * Constructs a ring with \a shards shards and \a replicas points per shard.
+     */
+    explicit ContactRing(int shards = 1, int replicas = 64);
+
+    /**
+     * Returns the shard of \a contact, a number between 0 and shardCount() - 1. Contacts are
+     * case-insensitive.
+     */
+    int shard(const QString &contact) const;
+
+    /**
+     * Returns the amount of shards
+     */
+    int shardCount() const;
+
+private:
+    struct Point
+    {
+        quint32 hash;
+        int shard;
+
+        bool operator<(const Point &other) const { return hash < other.hash; }
+    };
+
+    QVector<Point> m_points;    // Sorted by hash
+    int m_shards;
+};
+
+/// @}
+
+} // namespace CA
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_CA_CONTACTRING_H
@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "chat-adapter/contactscheduler.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThread>
+#include <QQueue>
+
+//--------------------------------------------------------------------------------------------------
+// ContactScheduler::ContactQueue
+//--------------------------------------------------------------------------------------------------
+
+// The jobs of one contact. While the contact has jobs, it is either in one worker deque or
+// running in one worker, never both. This keeps the jobs of the contact in order.
+
+struct Lvk::CA::ContactScheduler::ContactQueue
+{
+    ContactQueue(const QString &key, int home) : key(key), home(home) { }
+
+    QString key;
+    int home;                   // Index of the home worker
+    QQueue<Job *> jobs;         // The head is the job running or next to run
+};
+
+//--------------------------------------------------------------------------------------------------
+// ContactScheduler::Worker
+//--------------------------------------------------------------------------------------------------
+
+class Lvk::CA::ContactScheduler::Worker : public QThread
+{
+public:
+    Worker(ContactScheduler *scheduler, int index)
+        : m_scheduler(scheduler), m_index(index) { }
+
+    QMutex dequeMutex;
+    QList<ContactQueue *> deque;
+
+protected:
+    void run()
+    {
+        forever {
+            {
+                QMutexLocker locker(m_scheduler->m_mutex);
+
+                while (m_scheduler->m_ready == 0 && !m_scheduler->m_stopped) {
+                    m_scheduler->m_workCond->wait(m_scheduler->m_mutex);
+                }
+
+                if (m_scheduler->m_stopped) {
+                    return;
+                }
+
+                // Reserve one contact. It's somewhere in the deques
+                --m_scheduler->m_ready;
+            }
+
+            ContactQueue *c = 0;
+
+            while (!(c = m_scheduler->pop(m_index))) {
+                // Another worker moved it while we were looking for it
+                QThread::yieldCurrentThread();
+            }
+
+            m_scheduler->runNext(c);
+        }
+    }
+
+private:
+    ContactScheduler *m_scheduler;
+    int m_index;
+};
+
+//--------------------------------------------------------------------------------------------------
+// ContactScheduler
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::ContactScheduler::ContactScheduler(int workers, int maxPending)
+    : m_mutex(new QMutex()),
+      m_workCond(new QWaitCondition()),
+      m_doneCond(new QWaitCondition()),
+      m_maxPending(maxPending),
+      m_pending(0),
+      m_ready(0),
+      m_stopped(false)
+{
+    if (workers <= 0) {
+        workers = qMax(1, QThread::idealThreadCount());
+    }
+
+    for (int i = 0; i < workers; ++i) {
+        m_workers.append(new Worker(this, i));
+    }
+
+    foreach (Worker *w, m_workers) {
+        w->start();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::ContactScheduler::~ContactScheduler()
+{
+    stop();
+
+    qDeleteAll(m_workers);
+
+    delete m_doneCond;
+    delete m_workCond;
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::ContactScheduler::schedule(const QString &contact, Job *job)
+{
+    QMutexLocker locker(m_mutex);
+
+    if (m_stopped || (m_maxPending > 0 && m_pending >= m_maxPending)) {
+        locker.unlock();
+        delete job;
+        return false;
+    }
+
+    ContactQueue *c = m_contacts.value(contact);
+
+    if (c) {
+        // Already in a deque or running. It's pushed again after its current job
+        c->jobs.enqueue(job);
+    } else {
+        c = new ContactQueue(contact, homeWorker(contact));
+        c->jobs.enqueue(job);
+        m_contacts.insert(contact, c);
+        push(c);
+    }
+
+    ++m_pending;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::ContactScheduler::pending() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_pending;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::ContactScheduler::workerCount() const
+{
+    return m_workers.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::ContactScheduler::waitForDone()
+{
+    QMutexLocker locker(m_mutex);
+
+    while (m_pending > 0 && !m_stopped) {
+        m_doneCond->wait(m_mutex);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::ContactScheduler::stop()
+{
+    m_mutex->lock();
+    m_stopped = true;
+    m_workCond->wakeAll();
+    m_doneCond->wakeAll();
+    m_mutex->unlock();
+
+    foreach (Worker *w, m_workers) {
+        w->wait();
+    }
+
+    // Workers have finished. Discard jobs that never ran
+    QMutexLocker locker(m_mutex);
+
+    foreach (ContactQueue *c, m_contacts) {
+        qDeleteAll(c->jobs);
+        delete c;
+    }
+    m_contacts.clear();
+
+    foreach (Worker *w, m_workers) {
+        w->deque.clear();
+    }
+
+    m_pending = 0;
+    m_ready = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// m_mutex must be locked
+void Lvk::CA::ContactScheduler::push(ContactQueue *c)
+{
+    Worker *w = m_workers[c->home];
+
+    w->dequeMutex.lock();
+    w->deque.append(c);
+    w->dequeMutex.unlock();
+
+    ++m_ready;
+    m_workCond->wakeOne();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Pops from the front of the deque of the worker. If empty, steals from the back of the deques
+// of the other workers
+Lvk::CA::ContactScheduler::ContactQueue * Lvk::CA::ContactScheduler::pop(int worker)
+{
+    int n = m_workers.size();
+
+    for (int i = 0; i < n; ++i) {
+        Worker *w = m_workers[(worker + i) % n];
+
+        QMutexLocker locker(&w->dequeMutex);
+
+        if (!w->deque.isEmpty()) {
+            return i == 0 ? w->deque.takeFirst() : w->deque.takeLast();
+        }
+    }
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Runs one job of the contact and puts the contact back at the end of its home deque if it
+// has more jobs
+void Lvk::CA::ContactScheduler::runNext(ContactQueue *c)
+{
+    Job *job = 0;
+
+    m_mutex->lock();
+    job = c->jobs.head();
+    m_mutex->unlock();
+
+    job->run();
+    delete job;
+
+    QMutexLocker locker(m_mutex);
+
+    c->jobs.dequeue();
+    --m_pending;
+
+    if (c->jobs.isEmpty()) {
+        m_contacts.remove(c->key);
+        delete c;
+    } else {
+        push(c);
+    }
+
+    if (m_pending == 0) {
+        m_doneCond->wakeAll();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::ContactScheduler::homeWorker(const QString &contact) const
+{
+    return qHash(contact) % m_workers.size();
+}
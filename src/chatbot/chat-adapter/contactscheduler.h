@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CA_CONTACTSCHEDULER_H
+#define LVK_CA_CONTACTSCHEDULER_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+
+class QMutex;
+class QWaitCondition;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace CA
+{
+
+/// \ingroup Lvk
+/// \addtogroup CA
+/// @{
+
+/**
+ * \brief The ContactScheduler class runs jobs in worker threads keeping the order of the jobs
+ *        of each contact.
+ *
+ * Jobs of the same contact run one at a time and in the same order they were scheduled. Jobs
+ * of different contacts run in parallel. Contacts are sharded by hash onto per-worker deques.
+ * A worker runs one job of a contact and puts the contact back at the end of its deque if it
+ * has more jobs, so a busy contact does not starve others. Idle workers steal contacts from
+ * other workers.
+ *
+ * ContactScheduler is thread-safe.
+ */
+class ContactScheduler
+{
+public:
+
+    /**
+     * The Job class provides the interface for jobs run by the ContactScheduler
+     */
+    class Job
+    {
+    public:
+        /**
+         * Destroys the object
+         */
+        virtual ~Job() { }
+
+        /**
+         * Runs the job in a worker thread
+         */
+        virtual void run() = 0;
+    };
+
+    /**
+     * Constructs a ContactScheduler with \a workers threads and at most \a maxPending jobs
+     * waiting to run or running. If \a workers is zero, the ideal thread count is used. If
+     * \a maxPending is zero, there is no limit.
+     */
+    explicit ContactScheduler(int workers = 0, int maxPending = 0);
+
+    /**
+     * Destroys the object. Pending jobs are discarded.
+     */
+    ~ContactScheduler();
+
+    /**
+     * Schedules \a job for \a contact and takes ownership of it. Returns true on success.
+     * Otherwise, if there are too many pending jobs or the scheduler is stopped, deletes
+     * \a job and returns false.
+     */
+    bool schedule(const QString &contact, Job *job);
+
+    /**
+     * Returns the amount of jobs waiting to run or running.
+     */
+    int pending() const;
+
+    /**
+     * Returns the amount of worker threads.
+     */
+    int workerCount() const;
+
+    /**
+     * Blocks until all scheduled jobs have finished.
+     */
+    void waitForDone();
+
+    /**
+     * Stops the workers. Running jobs are finished, the rest are discarded.
+     */
+    void stop();
+
+private:
+    ContactScheduler(ContactScheduler&);
+    ContactScheduler& operator=(ContactScheduler&);
+
+    class Worker;
+    struct ContactQueue;
+
+    QMutex *m_mutex;
+    QWaitCondition *m_workCond;
+    QWaitCondition *m_doneCond;
+    QHash<QString, ContactQueue *> m_contacts;
+    QList<Worker *> m_workers;
+    int m_maxPending;
+    int m_pending;
+    int m_ready;        // Contacts in the worker deques
+    bool m_stopped;
+
+    void push(ContactQueue *c);
+    ContactQueue *pop(int worker);
+    void runNext(ContactQueue *c);
+    int homeWorker(const QString &contact) const;
+};
+
+/// @}
+
+} // namespace CA
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_CA_CONTACTSCHEDULER_H
@@ -66,6 +66,7 @@ inline Lvk::Cmn::Conversation::Entry makeEntry(const QString &from, const QStrin
     entry.from = from;
     entry.msg = msg;
     entry.to = to;
+    entry.internParticipants();
 
     return entry;
 }
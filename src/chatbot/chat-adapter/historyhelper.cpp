@@ -22,14 +22,152 @@
 #include "chat-adapter/historyhelper.h"
 #include "common/conversationreader.h"
 #include "common/conversationwriter.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "common/profiler.h"
+#include "common/startuptimeline.h"
+#include "common/taskscheduler.h"
 
 #include <QFile>
+#include <QFileInfo>
+#include <QBuffer>
 #include <QDir>
+#include <QDate>
+#include <QDateTime>
+#include <QStringList>
 #include <QReadWriteLock>
 #include <QReadLocker>
 #include <QWriteLocker>
 #include <QtDebug>
 
+#define TOMBSTONES_FILE_SUFFIX      ".del"
+#define COMPACTION_THRESHOLD        16      // Tombstones that trigger a compaction
+#define COMPACTION_CHECK_INTERVAL   60      // In seconds
+#define ENTRY_OVERHEAD_BYTES        96      // Estimated size of an entry besides its strings
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+typedef QHash<QString, QDateTime> Tombstones;
+
+inline QString tombstoneKey(const QDate &date, const QString &user)
+{
+    return date.toString(Qt::ISODate) + "\t" + user;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool isRemoved(const Lvk::Cmn::Conversation::Entry &entry, const Tombstones &tombstones)
+{
+    QString key = tombstoneKey(entry.dateTime.date(), entry.from);
+    Tombstones::const_iterator it = tombstones.find(key);
+
+    return it != tombstones.constEnd() && entry.dateTime <= it.value();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void filter(Lvk::Cmn::Conversation &conv, const Tombstones &tombstones)
+{
+    if (tombstones.isEmpty()) {
+        return;
+    }
+
+    QList<Lvk::Cmn::Conversation::Entry> &entries = conv.entries();
+
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        if (isRemoved(entries[i], tombstones)) {
+            entries.removeAt(i);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Tombstones are stored one per line with the form <date>\t<user>\t<time of removal>
+inline QByteArray tombstoneLine(const QString &key, const QDateTime &removed)
+{
+    return (key + "\t" + removed.toString(Qt::ISODate) + "\n").toUtf8();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void appendTombstone(const QString &filename, const QString &key, const QDateTime &removed)
+{
+    QFile file(filename + TOMBSTONES_FILE_SUFFIX);
+
+    if (!file.open(QFile::Append) || file.write(tombstoneLine(key, removed)) == -1) {
+        qCritical() << "HistoryHelper: Cannot write tombstones file" << file.fileName();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void writeTombstones(const QString &filename, const Tombstones &tombstones)
+{
+    QFile file(filename + TOMBSTONES_FILE_SUFFIX);
+
+    if (tombstones.isEmpty()) {
+        file.remove();
+        return;
+    }
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCritical() << "HistoryHelper: Cannot write tombstones file" << file.fileName();
+        return;
+    }
+
+    for (Tombstones::const_iterator it = tombstones.constBegin(); it != tombstones.constEnd();
+         ++it) {
+        file.write(tombstoneLine(it.key(), it.value()));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Reads the tombstones file of the history file filename. If a date and user were removed
+// several times, the latest removal is kept.
+Tombstones readTombstones(const QString &filename)
+{
+    Tombstones tombstones;
+
+    QFile file(filename + TOMBSTONES_FILE_SUFFIX);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return tombstones;
+    }
+
+    while (!file.atEnd()) {
+        QStringList tokens = QString::fromUtf8(file.readLine()).trimmed().split("\t");
+
+        if (tokens.size() == 3) {
+            QDateTime removed = QDateTime::fromString(tokens[2], Qt::ISODate);
+            QDateTime &latest = tombstones[tokens[0] + "\t" + tokens[1]];
+
+            if (latest.isNull() || latest < removed) {
+                latest = removed;
+            }
+        }
+    }
+
+    return tombstones;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline qint64 entryBytes(const Lvk::Cmn::Conversation::Entry &entry)
+{
+    return ENTRY_OVERHEAD_BYTES + 2*(entry.from.size() + entry.to.size() + entry.msg.size()
+                                     + entry.response.size());
+}
+
+} // namespace
+
+
 //--------------------------------------------------------------------------------------------------
 // HistoryHelper
 //--------------------------------------------------------------------------------------------------
@@ -39,6 +177,12 @@ Lvk::CA::HistoryHelper::HistoryHelper()
       m_convWriter(new Cmn::ConversationWriter()),
       m_rwLock(new QReadWriteLock())
 {
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+    m_maxEntries = settings.value(SETTING_HISTORY_WINDOW_ENTRIES).toInt();
+    m_maxDays = settings.value(SETTING_HISTORY_WINDOW_DAYS).toInt();
+
+    Cmn::MemoryManager::manager()->add(this, "history", Cmn::MemoryManager::HistoryPriority);
+    Cmn::MaintenanceScheduler::scheduler()->add(this, "history", COMPACTION_CHECK_INTERVAL);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -48,35 +192,106 @@ Lvk::CA::HistoryHelper::HistoryHelper(const QString &filename)
       m_convWriter(new Cmn::ConversationWriter(m_filename)),
       m_rwLock(new QReadWriteLock())
 {
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+    m_maxEntries = settings.value(SETTING_HISTORY_WINDOW_ENTRIES).toInt();
+    m_maxDays = settings.value(SETTING_HISTORY_WINDOW_DAYS).toInt();
+
     load();
+
+    Cmn::MemoryManager::manager()->add(this, "history", Cmn::MemoryManager::HistoryPriority);
+    Cmn::MaintenanceScheduler::scheduler()->add(this, "history", COMPACTION_CHECK_INTERVAL);
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::CA::HistoryHelper::~HistoryHelper()
 {
+    Cmn::MemoryManager::manager()->remove(this);
+    Cmn::MaintenanceScheduler::scheduler()->remove(this);
+
+    waitForCompaction();
+
     delete m_rwLock;
     delete m_convWriter;
 }
 
 //--------------------------------------------------------------------------------------------------
 
+// Entries older than the window are skipped while reading, so they are never resident
 void Lvk::CA::HistoryHelper::load()
 {
+    LVK_STARTUP_PHASE("history_load");
+
+    m_conv.clear();
+
+    loadTombstones();
+
     if (QFile::exists(m_filename)) {
         Cmn::ConversationReader convReader(m_filename);
-        m_conv.clear();
-        if (!convReader.read(&m_conv)) {
+        if (!convReader.read(&m_conv, windowStart(), QDateTime())) {
             qWarning() << "HistoryHelper: Cannot read the conversation history from file"
                        << m_filename;
         }
     }
+
+    filter(m_conv, m_tombstones);
+
+    trim();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::HistoryHelper::loadTombstones()
+{
+    m_tombstones = readTombstones(m_filename);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QDateTime Lvk::CA::HistoryHelper::windowStart() const
+{
+    return m_maxDays > 0 ? QDateTime::currentDateTime().addDays(-m_maxDays) : QDateTime();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::HistoryHelper::trim()
+{
+    if (m_maxDays > 0) {
+        Cmn::Conversation::const_iterator it = m_conv.lowerBound(windowStart());
+        m_conv.removeFirst(it - m_conv.begin());
+    }
+
+    if (m_maxEntries > 0 && m_conv.size() > m_maxEntries) {
+        m_conv.removeFirst(m_conv.size() - m_maxEntries);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::HistoryHelper::setWindow(int maxEntries, int maxDays)
+{
+    QWriteLocker locker(m_rwLock);
+
+    bool grows = (maxEntries == 0 || (m_maxEntries > 0 && maxEntries > m_maxEntries))
+              || (maxDays == 0 || (m_maxDays > 0 && maxDays > m_maxDays));
+
+    m_maxEntries = maxEntries;
+    m_maxDays = maxDays;
+
+    if (grows) {
+        load();
+    } else {
+        trim();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::CA::HistoryHelper::setFilename(const QString &filename)
 {
+    waitForCompaction();
+
     QWriteLocker locker(m_rwLock);
 
     m_filename = filename;
@@ -100,10 +315,14 @@ QString Lvk::CA::HistoryHelper::filename() const
 
 void Lvk::CA::HistoryHelper::append(const Cmn::Conversation::Entry &entry)
 {
+    LVK_PROFILE("HistoryHelper::append");
+
     QWriteLocker locker(m_rwLock);
 
     m_conv.append(entry);
 
+    trim();
+
     if (!m_convWriter->write(entry)) {
         qCritical() << "HistoryHelper: Cannot write the conversation entry to file" << m_filename;
     }
@@ -120,14 +339,53 @@ const Lvk::Cmn::Conversation & Lvk::CA::HistoryHelper::history() const
 
 //--------------------------------------------------------------------------------------------------
 
+Lvk::Cmn::Conversation Lvk::CA::HistoryHelper::history(const QDateTime &from,
+                                                       const QDateTime &to) const
+{
+    QReadLocker locker(m_rwLock);
+
+    // Entries in memory are all the entries since the first one, so if the range starts after
+    // it we do not need to read the file
+    if (!from.isNull() && !m_conv.isEmpty() && m_conv.entries().first().dateTime < from) {
+        return m_conv.range(from, to);
+    }
+
+    Cmn::Conversation conv;
+
+    if (QFile::exists(m_filename)) {
+        Cmn::ConversationReader convReader(m_filename);
+        if (!convReader.read(&conv, from, to)) {
+            qWarning() << "HistoryHelper: Cannot read the conversation history from file"
+                       << m_filename;
+        }
+    }
+
+    filter(conv, m_tombstones);
+
+    return conv;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Conversation Lvk::CA::HistoryHelper::fullHistory() const
+{
+    return history(QDateTime(), QDateTime());
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::CA::HistoryHelper::setHistory(const Cmn::Conversation &conv)
 {
+    waitForCompaction();
+
     QWriteLocker locker(m_rwLock);
 
     resetHistoryLog();
 
     m_conv = conv;
 
+    trim();
+
     if (!m_convWriter->write(conv)) {
         qCritical() << "HistoryHelper: Cannot write the conversation to file" << m_filename;
     }
@@ -135,8 +393,157 @@ void Lvk::CA::HistoryHelper::setHistory(const Cmn::Conversation &conv)
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::CA::HistoryHelper::remove(const QDate &date, const QString &user)
+{
+    QWriteLocker locker(m_rwLock);
+
+    QString key = tombstoneKey(date, user);
+    QDateTime now = QDateTime::currentDateTime();
+
+    m_tombstones[key] = now;
+    appendTombstone(m_filename, key, now);
+
+    // Only recent entries are in memory, so this does not depend on the size of the history
+    Tombstones tombstone;
+    tombstone.insert(key, now);
+    filter(m_conv, tombstone);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::HistoryHelper::needsMaintenance() const
+{
+    QReadLocker locker(m_rwLock);
+
+    return m_tombstones.size() >= COMPACTION_THRESHOLD && !m_compaction.isRunning();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::HistoryHelper::runMaintenance()
+{
+    QWriteLocker locker(m_rwLock);
+
+    // Compaction is deferred while the chatbot is busy, so it does not compete with replies
+    if (m_tombstones.size() >= COMPACTION_THRESHOLD && !m_compaction.isRunning()) {
+        m_compaction = Cmn::TaskScheduler::scheduler()->run(Cmn::TaskScheduler::Background,
+                                                            this, &HistoryHelper::compact);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Rewrites the history file without the removed entries. Appends are not blocked while the file
+// is rewritten. Entries appended meanwhile are copied at the end of the new file.
+void Lvk::CA::HistoryHelper::compact()
+{
+    QString filename;
+    Tombstones tombstones;
+    qint64 end = 0;
+
+    {
+        QWriteLocker locker(m_rwLock);
+
+        // Destroying the writer flushes entries still in the journal
+        delete m_convWriter;
+        m_convWriter = new Cmn::ConversationWriter(m_filename);
+
+        filename = m_filename;
+        tombstones = m_tombstones;
+        end = QFileInfo(filename).size();
+    }
+
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return;
+    }
+
+    QBuffer *buffer = new QBuffer();
+    buffer->setData(file.read(end));
+    file.close();
+
+    Cmn::Conversation conv;
+
+    if (!Cmn::ConversationReader(buffer).read(&conv)) {
+        qWarning() << "HistoryHelper: Cannot compact history file" << filename;
+        return;
+    }
+
+    filter(conv, tombstones);
+
+    QString tmpFilename = filename + ".tmp";
+    QFile::remove(tmpFilename);
+
+    bool success = Cmn::ConversationWriter(tmpFilename).write(conv);
+
+    QWriteLocker locker(m_rwLock);
+
+    if (m_filename != filename) {
+        QFile::remove(tmpFilename);
+        return;
+    }
+
+    delete m_convWriter;
+
+    QFile tmpFile(tmpFilename);
+
+    if (success && tmpFile.open(QFile::Append) && file.open(QFile::ReadOnly) && file.seek(end)) {
+        QByteArray tail = file.readAll();
+        success = tmpFile.write(tail) == tail.size();
+    } else {
+        success = false;
+    }
+
+    tmpFile.close();
+    file.close();
+
+    if (success) {
+        QFile::remove(filename);
+        success = QFile::rename(tmpFilename, filename);
+    }
+
+    m_convWriter = new Cmn::ConversationWriter(m_filename);
+
+    if (!success) {
+        qCritical() << "HistoryHelper: Cannot compact history file" << filename;
+        QFile::remove(tmpFilename);
+        return;
+    }
+
+    // Removals made while compacting are kept
+    for (Tombstones::const_iterator it = tombstones.constBegin(); it != tombstones.constEnd();
+         ++it) {
+        if (m_tombstones.value(it.key()) == it.value()) {
+            m_tombstones.remove(it.key());
+        }
+    }
+
+    writeTombstones(m_filename, m_tombstones);
+
+    qDebug() << "HistoryHelper: Compacted" << filename;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::HistoryHelper::waitForCompaction()
+{
+    QFuture<void> compaction;
+
+    {
+        QReadLocker locker(m_rwLock);
+        compaction = m_compaction;
+    }
+
+    compaction.waitForFinished();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::CA::HistoryHelper::clear()
 {
+    waitForCompaction();
+
     QWriteLocker locker(m_rwLock);
 
     resetHistoryLog();
@@ -144,6 +551,46 @@ void Lvk::CA::HistoryHelper::clear()
 
 //--------------------------------------------------------------------------------------------------
 
+qint64 Lvk::CA::HistoryHelper::memoryUsage() const
+{
+    QReadLocker locker(m_rwLock);
+
+    qint64 bytes = 0;
+
+    foreach (const Cmn::Conversation::Entry &entry, m_conv.entries()) {
+        bytes += entryBytes(entry);
+    }
+
+    return bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::CA::HistoryHelper::releaseMemory(qint64 bytes)
+{
+    QWriteLocker locker(m_rwLock);
+
+    // Without a file, entries cannot be read again
+    if (m_filename.isEmpty()) {
+        return 0;
+    }
+
+    const QList<Cmn::Conversation::Entry> &entries = m_conv.entries();
+
+    qint64 released = 0;
+    int n = 0;
+
+    while (n < entries.size() && released < bytes) {
+        released += entryBytes(entries[n++]);
+    }
+
+    m_conv.removeFirst(n);
+
+    return released;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::CA::HistoryHelper::resetHistoryLog()
 {
     m_conv.clear();
@@ -152,6 +599,45 @@ void Lvk::CA::HistoryHelper::resetHistoryLog()
 
     QFile::remove(m_filename);
 
+    m_tombstones.clear();
+    writeTombstones(m_filename, m_tombstones);
+
     m_convWriter = new Cmn::ConversationWriter(m_filename);
 }
 
+
+//--------------------------------------------------------------------------------------------------
+// HistoryHelper::Reader
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::HistoryHelper::Reader::Reader(const QString &filename)
+    : m_reader(0), m_tombstones(readTombstones(filename))
+{
+    if (QFile::exists(filename)) {
+        m_reader = new Cmn::ConversationReader(filename);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::HistoryHelper::Reader::~Reader()
+{
+    delete m_reader;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::HistoryHelper::Reader::next(Cmn::Conversation::Entry &entry)
+{
+    if (!m_reader) {
+        return false;
+    }
+
+    while (m_reader->read(&entry)) {
+        if (!entry.isNull() && !isRemoved(entry, m_tombstones)) {
+            return true;
+        }
+    }
+
+    return false;
+}
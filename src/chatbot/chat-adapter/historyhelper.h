@@ -23,16 +23,23 @@
 #define LVK_CA_HISTORYHELPER_H
 
 #include <QString>
+#include <QHash>
+#include <QDateTime>
+#include <QFuture>
 #include "common/conversation.h"
+#include "common/memorymanager.h"
+#include "common/maintenancescheduler.h"
 
 class QFile;
 class QReadWriteLock;
+class QDate;
 
 namespace Lvk
 {
 
 namespace Cmn
 {
+    class ConversationReader;
     class ConversationWriter;
 }
 
@@ -53,12 +60,55 @@ namespace CA
  * Given a filename, the class loads the chat history. If the history does not
  * exits, it creates an empty one. All ChatHistory operations are persistent.
  *
+ * Only the most recent entries are kept in memory (see setWindow()). Older entries are read
+ * on demand from the file. Under memory pressure, the MemoryManager can drop the oldest entries
+ * in memory before they leave the window.
+ *
+ * Removing the entries of a contact in a given date with remove() does not rewrite the file.
+ * Instead, a tombstone is appended to a file next to the history and entries are filtered
+ * while reading. Once there are several tombstones, the MaintenanceScheduler compacts the history
+ * file in a background thread when the chatbot is idle.
+ *
  * This class is thread-safe.
  */
-class HistoryHelper
+class HistoryHelper : public Cmn::MemoryConsumer, public Cmn::MaintenanceTask
 {
 public:
 
+    /**
+     * \brief The Reader class provides sequential access to all entries of a history file
+     *        without loading it in memory.
+     *
+     * Entries removed with remove() are skipped, even if the file was not compacted yet.
+     */
+    class Reader
+    {
+    public:
+
+        /**
+         * Constructs a Reader positioned at the first entry of the history file \a filename.
+         */
+        Reader(const QString &filename);
+
+        /**
+         * Destroys the object.
+         */
+        ~Reader();
+
+        /**
+         * Reads the next entry into \a entry. Returns true on success. Otherwise; returns
+         * false if there are no more entries.
+         */
+        bool next(Cmn::Conversation::Entry &entry);
+
+    private:
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+
+        Cmn::ConversationReader *m_reader;       // Null if the file does not exist
+        QHash<QString, QDateTime> m_tombstones;
+    };
+
     /**
      * Constructs a HistoryHelper without filename.
      */
@@ -80,10 +130,36 @@ public:
     void append(const Cmn::Conversation::Entry &entry);
 
     /**
-     * Returns the full chat history for the current file.
+     * Returns the recent chat history kept in memory. See setWindow().
      */
     const Cmn::Conversation &history() const;
 
+    /**
+     * Returns the chat history between \a from (inclusive) and \a to (exclusive). A null
+     * \a from or \a to means no lower or upper bound respectively. If the range is within the
+     * recent history, entries are taken from memory. Otherwise; entries are streamed from the
+     * current file.
+     */
+    Cmn::Conversation history(const QDateTime &from, const QDateTime &to) const;
+
+    /**
+     * Returns the full chat history for the current file. Entries are read from the file.
+     */
+    Cmn::Conversation fullHistory() const;
+
+    /**
+     * Removes the entries from \a user in \a date received so far. Entries received later
+     * in the same date are kept.
+     */
+    void remove(const QDate &date, const QString &user);
+
+    /**
+     * Sets the max amount of recent entries kept in memory to \a maxEntries and the max age in
+     * days of the entries kept in memory to \a maxDays. Zero means no limit. By default, values
+     * are read from the application settings.
+     */
+    void setWindow(int maxEntries, int maxDays);
+
     /**
      * Sets \a conv as the chat history for the current file.
      */
@@ -105,16 +181,48 @@ public:
      */
     void clear();
 
+    /**
+     * \copydoc Cmn::MemoryConsumer::memoryUsage()
+     */
+    virtual qint64 memoryUsage() const;
+
+    /**
+     * \copydoc Cmn::MemoryConsumer::releaseMemory()
+     *
+     * The oldest entries in memory are dropped first. They can still be read from the file.
+     */
+    virtual qint64 releaseMemory(qint64 bytes);
+
+    /**
+     * Returns true if there are enough tombstones to compact the history file and it is not
+     * being compacted. Otherwise; returns false.
+     */
+    virtual bool needsMaintenance() const;
+
+    /**
+     * Starts compacting the history file in a background thread if needed.
+     */
+    virtual void runMaintenance();
+
 private:
     HistoryHelper(HistoryHelper&);
     HistoryHelper& operator=(const HistoryHelper&);
 
     QString m_filename;
-    Cmn::Conversation m_conv;
+    Cmn::Conversation m_conv;               // Recent history
+    int m_maxEntries;
+    int m_maxDays;
     Cmn::ConversationWriter *m_convWriter;
     QReadWriteLock *m_rwLock;
+    QHash<QString, QDateTime> m_tombstones;  // Date and user to the time of the removal
+    QFuture<void> m_compaction;
 
     void load();
+    void loadTombstones();
+    void compact();
+    void waitForCompaction();
+    void trim();
+    QDateTime windowStart() const;
     void resetHistoryLog();
 };
 
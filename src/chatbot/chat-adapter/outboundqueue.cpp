@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "chat-adapter/outboundqueue.h"
+
+#include "QXmppClient.h"
+#include "QXmppPacket.h"
+
+#include <QtDebug>
+
+#include <cmath>
+
+#define DEFAULT_RATE        5.0     // Stanzas per second
+#define DEFAULT_BURST       10      // Stanzas sent at once
+#define DEFAULT_MAX_SIZE    512     // Pending stanzas
+
+//--------------------------------------------------------------------------------------------------
+// OutboundQueue
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::OutboundQueue::OutboundQueue(QXmppClient *client, QObject *parent /*= 0*/)
+    : QObject(parent),
+      m_client(client),
+      m_rate(DEFAULT_RATE),
+      m_burst(DEFAULT_BURST),
+      m_tokens(DEFAULT_BURST),
+      m_lastRefill(0),
+      m_maxSize(DEFAULT_MAX_SIZE)
+{
+    m_clock.start();
+
+    m_timer.setSingleShot(true);
+
+    connect(&m_timer, SIGNAL(timeout()), SLOT(flush()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::OutboundQueue::~OutboundQueue()
+{
+    clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::OutboundQueue::setRate(double rate, int burst)
+{
+    refill();
+
+    m_rate = rate > 0 ? rate : DEFAULT_RATE;
+    m_burst = burst > 0 ? burst : 1;
+    m_tokens = qMin(m_tokens, m_burst);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::OutboundQueue::setMaxSize(int size)
+{
+    m_maxSize = size;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::OutboundQueue::enqueue(QXmppPacket *packet, Priority priority)
+{
+    if (m_maxSize > 0 && size() >= m_maxSize) {
+        // Make room dropping the oldest low priority stanza
+        if (priority == HighPriority && !m_queues[LowPriority].isEmpty()) {
+            delete m_queues[LowPriority].dequeue().packet;
+            ++m_stats.dropped;
+        } else {
+            qWarning() << "OutboundQueue: Queue full. Stanza dropped";
+            delete packet;
+            ++m_stats.dropped;
+            return false;
+        }
+    }
+
+    m_queues[priority].enqueue(Item(packet, m_clock.elapsed()));
+
+    // Stanzas queued in the same event loop turn are sent together
+    if (!m_timer.isActive()) {
+        m_timer.start(0);
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::OutboundQueue::size() const
+{
+    return m_queues[HighPriority].size() + m_queues[LowPriority].size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::OutboundQueue::clear()
+{
+    m_timer.stop();
+
+    for (int i = 0; i < 2; ++i) {
+        m_stats.dropped += m_queues[i].size();
+
+        while (!m_queues[i].isEmpty()) {
+            delete m_queues[i].dequeue().packet;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::CA::OutboundQueue::Stats & Lvk::CA::OutboundQueue::stats() const
+{
+    return m_stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::OutboundQueue::resetStats()
+{
+    m_stats = Stats();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::OutboundQueue::refill()
+{
+    qint64 now = m_clock.elapsed();
+
+    m_tokens = qMin(m_burst, m_tokens + (now - m_lastRefill) * m_rate / 1000.0);
+    m_lastRefill = now;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::OutboundQueue::flush()
+{
+    if (!m_client->isConnected()) {
+        return;
+    }
+
+    refill();
+
+    while (m_tokens >= 1.0 && size() > 0) {
+        QQueue<Item> &queue = !m_queues[HighPriority].isEmpty() ? m_queues[HighPriority]
+                                                                : m_queues[LowPriority];
+        Item item = queue.dequeue();
+
+        if (m_client->sendPacket(*item.packet)) {
+            qint64 latency = m_clock.elapsed() - item.queued;
+
+            ++m_stats.sent;
+            m_stats.totalLatency += latency;
+            m_stats.maxLatency = qMax(m_stats.maxLatency, latency);
+        } else {
+            ++m_stats.dropped;
+        }
+
+        delete item.packet;
+
+        m_tokens -= 1.0;
+    }
+
+    scheduleFlush();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// If there are pending stanzas, flush again when there is a new token
+void Lvk::CA::OutboundQueue::scheduleFlush()
+{
+    if (size() == 0 || m_timer.isActive()) {
+        return;
+    }
+
+    int msecs = (int)std::ceil((1.0 - m_tokens) * 1000.0 / m_rate);
+
+    m_timer.start(qMax(msecs, 1));
+
+    qDebug() << "OutboundQueue: Rate limited." << size() << "stanzas waiting";
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CA_OUTBOUNDQUEUE_H
+#define LVK_CA_OUTBOUNDQUEUE_H
+
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class QXmppClient;
+class QXmppPacket;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace CA
+{
+
+/// \ingroup Lvk
+/// \addtogroup CA
+/// @{
+
+/**
+ * \brief The OutboundQueue class provides a rate limited queue of outgoing XMPP stanzas.
+ *
+ * Chat servers like the Facebook XMPP gateway throttle bursts of stanzas and usually end up
+ * closing the connection. OutboundQueue limits the rate with a token bucket and sends high
+ * priority stanzas (i.e. chat replies) before low priority ones (i.e. vCard requests).
+ *
+ * Stanzas are not sent immediately. They are sent all together once control returns to the
+ * event loop, so the socket flushes them with a single write.
+ */
+class OutboundQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Stanza priorities
+     */
+    enum Priority {
+        HighPriority,       ///< Chat replies
+        LowPriority         ///< Presence and vCard traffic
+    };
+
+    /**
+     * Queue metrics
+     */
+    struct Stats
+    {
+        Stats() : sent(0), dropped(0), totalLatency(0), maxLatency(0) { }
+
+        unsigned sent;          ///< Stanzas sent
+        unsigned dropped;       ///< Stanzas dropped because the queue was full or cleared
+        qint64 totalLatency;    ///< Sum of milliseconds stanzas waited in the queue
+        qint64 maxLatency;      ///< Max milliseconds a stanza waited in the queue
+
+        /**
+         * Returns the average milliseconds sent stanzas waited in the queue
+         */
+        qint64 avgLatency() const { return sent > 0 ? totalLatency / sent : 0; }
+    };
+
+    /**
+     * Constructs an OutboundQueue that sends stanzas with \a client. The queue does not own
+     * the client.
+     */
+    OutboundQueue(QXmppClient *client, QObject *parent = 0);
+
+    /**
+     * Destroys the object. Pending stanzas are discarded.
+     */
+    ~OutboundQueue();
+
+    /**
+     * Sets the \a rate in stanzas per second and the max \a burst of stanzas sent at once.
+     */
+    void setRate(double rate, int burst);
+
+    /**
+     * Sets the max amount of pending stanzas. If the queue is full, low priority stanzas are
+     * dropped first.
+     */
+    void setMaxSize(int size);
+
+    /**
+     * Enqueues \a packet with \a priority and takes ownership of it. Returns true if the
+     * packet was queued. Otherwise; deletes \a packet and returns false.
+     */
+    bool enqueue(QXmppPacket *packet, Priority priority = HighPriority);
+
+    /**
+     * Returns the amount of pending stanzas.
+     */
+    int size() const;
+
+    /**
+     * Discards all pending stanzas.
+     */
+    void clear();
+
+    /**
+     * Returns the queue metrics.
+     */
+    const Stats &stats() const;
+
+    /**
+     * Resets the queue metrics.
+     */
+    void resetStats();
+
+public slots:
+
+    /**
+     * Sends as many pending stanzas as the rate allows. If the client is not connected, the
+     * stanzas are kept until flush() is invoked again. Usually there is no need to invoke
+     * this method since stanzas are flushed automatically once enqueued.
+     */
+    void flush();
+
+private:
+    OutboundQueue(OutboundQueue&);
+    OutboundQueue& operator=(OutboundQueue&);
+
+    struct Item
+    {
+        Item(QXmppPacket *packet = 0, qint64 queued = 0) : packet(packet), queued(queued) { }
+
+        QXmppPacket *packet;
+        qint64 queued;          // msecs since m_clock started
+    };
+
+    QXmppClient *m_client;
+    QQueue<Item> m_queues[2];   // One queue per priority
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    double m_rate;
+    double m_burst;
+    double m_tokens;
+    qint64 m_lastRefill;
+    int m_maxSize;
+    Stats m_stats;
+
+    void refill();
+    void scheduleFlush();
+};
+
+/// @}
+
+} // namespace CA
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_CA_OUTBOUNDQUEUE_H
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "chat-adapter/vcardcache.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QtDebug>
+
+#define VCARD_CACHE_MAGIC_NUMBER        (('v'<<0) | ('c'<<8) | ('c'<<16) | ('\0'<<24))
+#define VCARD_CACHE_FILE_FORMAT_VERSION 1
+
+#define VCARD_PHOTOS_DIR                "photos"
+
+//--------------------------------------------------------------------------------------------------
+// VCardCache
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::VCardCache::VCardCache()
+    : m_dirty(false)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::VCardCache::~VCardCache()
+{
+    save();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::VCardCache::setFilename(const QString &filename)
+{
+    if (filename == m_filename) {
+        return true;
+    }
+
+    save();
+
+    m_filename = filename;
+    m_entries.clear();
+    m_dirty = false;
+
+    return m_filename.isEmpty() || load();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const QString & Lvk::CA::VCardCache::filename() const
+{
+    return m_filename;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::VCardCache::contains(const QString &bareJid) const
+{
+    return m_entries.contains(bareJid);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::VCardCache::isValid(const QString &bareJid, const QByteArray &photoHash) const
+{
+    QHash<QString, Entry>::const_iterator it = m_entries.find(bareJid);
+
+    return it != m_entries.constEnd() && it->photoHash == photoHash;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::VCardCache::Entry Lvk::CA::VCardCache::entry(const QString &bareJid) const
+{
+    return m_entries.value(bareJid);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::VCardCache::insert(const QString &bareJid, const QString &fullName,
+                                 const QString &nickName, const QByteArray &photo)
+{
+    Entry entry;
+    entry.fullName = fullName;
+    entry.nickName = nickName;
+    entry.fetched = QDateTime::currentDateTime().toTime_t();
+
+    if (!photo.isEmpty()) {
+        entry.photoHash = QCryptographicHash::hash(photo, QCryptographicHash::Sha1);
+
+        // Photos are content-addressed, so there is nothing to write if the file exists
+        QString path = photoPath(entry.photoHash);
+
+        if (!path.isEmpty() && !QFile::exists(path)) {
+            QFile file(path);
+            if (!file.open(QFile::WriteOnly) || file.write(photo) != photo.size()) {
+                qWarning() << "VCardCache: Cannot write photo" << path;
+                file.remove();
+            }
+        }
+    }
+
+    m_entries[bareJid] = entry;
+    m_dirty = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::VCardCache::remove(const QString &bareJid)
+{
+    if (m_entries.remove(bareJid) > 0) {
+        m_dirty = true;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::CA::VCardCache::photoFilename(const QString &bareJid) const
+{
+    QByteArray photoHash = m_entries.value(bareJid).photoHash;
+
+    if (photoHash.isEmpty()) {
+        return QString();
+    }
+
+    QString path = photoPath(photoHash);
+
+    return QFile::exists(path) ? path : QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QStringList Lvk::CA::VCardCache::missing(const QStringList &bareJids, uint maxAge) const
+{
+    uint now = QDateTime::currentDateTime().toTime_t();
+
+    QStringList jids;
+
+    foreach (const QString &jid, bareJids) {
+        QHash<QString, Entry>::const_iterator it = m_entries.find(jid);
+
+        if (it == m_entries.constEnd() || (maxAge > 0 && now - it->fetched > maxAge)) {
+            jids.append(jid);
+        }
+    }
+
+    return jids;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::CA::VCardCache::size() const
+{
+    return m_entries.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::VCardCache::save()
+{
+    if (!m_dirty || m_filename.isEmpty()) {
+        return true;
+    }
+
+    // Write a temporary file first, so a crash never leaves a truncated cache
+    QString tmpFilename = m_filename + ".tmp";
+    QFile file(tmpFilename);
+
+    if (!file.open(QFile::WriteOnly)) {
+        qCritical() << "VCardCache: Cannot write" << tmpFilename;
+        return false;
+    }
+
+    QDataStream ostream(&file);
+
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << (quint32)VCARD_CACHE_MAGIC_NUMBER;
+    ostream << (quint32)VCARD_CACHE_FILE_FORMAT_VERSION;
+    ostream << (quint32)m_entries.size();
+
+    for (QHash<QString, Entry>::const_iterator it = m_entries.constBegin();
+         it != m_entries.constEnd(); ++it) {
+        ostream << it.key() << it->fullName << it->nickName << it->photoHash
+                << (quint32)it->fetched;
+    }
+
+    file.close();
+
+    if (ostream.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        qCritical() << "VCardCache: Cannot write" << tmpFilename;
+        QFile::remove(tmpFilename);
+        return false;
+    }
+
+    QFile::remove(m_filename);
+
+    if (!QFile::rename(tmpFilename, m_filename)) {
+        qCritical() << "VCardCache: Cannot rename" << tmpFilename << "to" << m_filename;
+        return false;
+    }
+
+    m_dirty = false;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::CA::VCardCache::load()
+{
+    QFile file(m_filename);
+
+    if (!file.exists()) {
+        return true;
+    }
+
+    if (!file.open(QFile::ReadOnly)) {
+        qWarning() << "VCardCache: Cannot read" << m_filename;
+        return false;
+    }
+
+    QDataStream istream(&file);
+
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 size = 0;
+
+    istream >> magic >> version >> size;
+
+    if (magic != VCARD_CACHE_MAGIC_NUMBER || version != VCARD_CACHE_FILE_FORMAT_VERSION) {
+        qWarning() << "VCardCache: Invalid or old cache file" << m_filename;
+        return false;
+    }
+
+    for (quint32 i = 0; i < size && istream.status() == QDataStream::Ok; ++i) {
+        QString jid;
+        Entry entry;
+        quint32 fetched = 0;
+
+        istream >> jid >> entry.fullName >> entry.nickName >> entry.photoHash >> fetched;
+
+        entry.fetched = fetched;
+        m_entries[jid] = entry;
+    }
+
+    if (istream.status() != QDataStream::Ok) {
+        qWarning() << "VCardCache: Corrupted cache file" << m_filename;
+        m_entries.clear();
+        return false;
+    }
+
+    qDebug() << "VCardCache: Loaded" << m_entries.size() << "vCards from" << m_filename;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::CA::VCardCache::photoPath(const QByteArray &photoHash) const
+{
+    if (m_filename.isEmpty()) {
+        return QString();
+    }
+
+    QString dir = QFileInfo(m_filename).absolutePath() + QDir::separator() + VCARD_PHOTOS_DIR;
+
+    QDir().mkpath(dir);
+
+    return dir + QDir::separator() + QString::fromAscii(photoHash.toHex());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::VCardCache::clear()
+{
+    if (!m_entries.isEmpty()) {
+        m_entries.clear();
+        m_dirty = true;
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CA_VCARDCACHE_H
+#define LVK_CA_VCARDCACHE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace CA
+{
+
+/// \ingroup Lvk
+/// \addtogroup CA
+/// @{
+
+/**
+ * \brief The VCardCache class provides a persistent cache of the vCards of chat contacts.
+ *
+ * Only the text fields used by the chatbot and the SHA1 hash of the photo are kept in memory.
+ * Photos are stored in the directory of the cache, one file per photo hash, so contacts with
+ * the same avatar share the file.
+ *
+ * Entries are validated with the photo hash advertised by contacts in their presence
+ * (XEP-0153). If it differs from the cached one, the entry must be fetched again.
+ *
+ * VCardCache is not thread-safe.
+ */
+class VCardCache
+{
+public:
+
+    /**
+     * Cache entry
+     */
+    struct Entry
+    {
+        Entry() : fetched(0) { }
+
+        QString fullName;       ///< Full name
+        QString nickName;       ///< Nickname
+        QByteArray photoHash;   ///< SHA1 of the photo or empty if there is no photo
+        uint fetched;           ///< Time when the vCard was received, in seconds since epoch
+
+        /**
+         * Returns true if the entry has never been fetched. Otherwise; returns false.
+         */
+        bool isNull() const { return fetched == 0; }
+    };
+
+    /**
+     * Constructs an empty VCardCache without filename.
+     */
+    VCardCache();
+
+    /**
+     * Destroys the object. Unsaved changes are saved.
+     */
+    ~VCardCache();
+
+    /**
+     * Saves the current cache if necessary and loads the cache stored in \a filename.
+     * An empty filename creates a cache that is not persisted.
+     * Returns true on success. Otherwise; returns false and the cache is empty.
+     */
+    bool setFilename(const QString &filename);
+
+    /**
+     * Returns the filename of the cache.
+     */
+    const QString &filename() const;
+
+    /**
+     * Returns true if there is an entry for \a bareJid. Otherwise; returns false.
+     */
+    bool contains(const QString &bareJid) const;
+
+    /**
+     * Returns true if there is an entry for \a bareJid and its photo hash is \a photoHash.
+     * Otherwise; returns false.
+     */
+    bool isValid(const QString &bareJid, const QByteArray &photoHash) const;
+
+    /**
+     * Returns the entry for \a bareJid or a null entry if there is no such entry.
+     */
+    Entry entry(const QString &bareJid) const;
+
+    /**
+     * Inserts or replaces the entry for \a bareJid. If \a photo is not empty, it is written to
+     * disk and only its hash is kept.
+     */
+    void insert(const QString &bareJid, const QString &fullName, const QString &nickName,
+                const QByteArray &photo = QByteArray());
+
+    /**
+     * Removes the entry for \a bareJid.
+     */
+    void remove(const QString &bareJid);
+
+    /**
+     * Returns the filename of the photo of \a bareJid or an empty string if there is no photo.
+     */
+    QString photoFilename(const QString &bareJid) const;
+
+    /**
+     * Returns the sublist of \a bareJids that are not in the cache. If \a maxAge is not zero,
+     * entries fetched more than \a maxAge seconds ago are also returned.
+     */
+    QStringList missing(const QStringList &bareJids, uint maxAge = 0) const;
+
+    /**
+     * Returns the number of entries.
+     */
+    int size() const;
+
+    /**
+     * Saves the cache if there are unsaved changes.
+     * Returns true on success. Otherwise; returns false.
+     */
+    bool save();
+
+    /**
+     * Clears the cache. Photo files are not removed.
+     */
+    void clear();
+
+private:
+    VCardCache(VCardCache&);
+    VCardCache& operator=(VCardCache&);
+
+    QString m_filename;
+    QHash<QString, Entry> m_entries;
+    bool m_dirty;
+
+    bool load();
+    QString photoPath(const QByteArray &photoHash) const;
+};
+
+/// @}
+
+} // namespace CA
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_CA_VCARDCACHE_H
@@ -30,18 +30,31 @@
 #include "QXmppVCardManager.h"
 #include "QXmppRosterManager.h"
 #include "QXmppVCardIq.h"
+#include "QXmppPresence.h"
 #include "QXmppMucManager.h"
+#include "QXmppReconnectionManager.h"
 
 #include <QDir>
 #include <QFileInfo>
 #include <QFile>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QThread>
 #include <QSslSocket>
 #include <QDateTime>
 
 #include <iostream>
 
+#define XMPP_MAX_PENDING_MESSAGES   256     // Backpressure. Newer messages are ignored
+#define XMPP_MAX_WORKERS            4       // Max threads used to get responses
+
+#define XMPP_VCARD_BATCH_SIZE       10      // vCards requested per batch
+#define XMPP_VCARD_BATCH_INTERVAL   2000    // Milliseconds between batches
+#define XMPP_VCARD_MAX_AGE          (7*24*3600) // Seconds before a cached vCard is fetched again
+#define XMPP_VCARD_CACHE_DIR        "vcards"
+
+#define XMPP_RESUME_TIMEOUT         60000   // Milliseconds to resume a session before giving up
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -71,6 +84,29 @@ inline QString normalizeDomain(const QString &domain)
 } // namespace
 
 
+//--------------------------------------------------------------------------------------------------
+// XmppChatbot::MatchJob
+//--------------------------------------------------------------------------------------------------
+
+// Gets the response of one message in a worker thread
+
+class Lvk::CA::XmppChatbot::MatchJob : public Lvk::CA::ContactScheduler::Job
+{
+public:
+    MatchJob(XmppChatbot *chatbot, const PendingMessage &pmsg)
+        : m_chatbot(chatbot), m_pmsg(pmsg) { }
+
+    void run()
+    {
+        m_chatbot->processMessage(m_pmsg);
+    }
+
+private:
+    XmppChatbot *m_chatbot;
+    PendingMessage m_pmsg;
+};
+
+
 //--------------------------------------------------------------------------------------------------
 // XmppChatbot
 //--------------------------------------------------------------------------------------------------
@@ -81,10 +117,34 @@ Lvk::CA::XmppChatbot::XmppChatbot(const QString &/*chatbotId*/, QObject *parent)
       m_ai(0),
       m_contactInfoMutex(new QMutex(QMutex::Recursive)),
       m_rosterMutex(new QMutex()),
-      m_aiMutex(new QMutex(QMutex::Recursive)),
+      m_queueMutex(new QMutex()),
+      m_scheduler(qBound(1, QThread::idealThreadCount(), XMPP_MAX_WORKERS),
+                  XMPP_MAX_PENDING_MESSAGES),
+      m_outbound(m_xmppClient),
       m_isConnected(false),
+      m_disconnecting(false),
+      m_resuming(false),
+      m_resumed(false),
       m_rosterHasChanged(false)
 {
+    m_vCardTimer.setInterval(XMPP_VCARD_BATCH_INTERVAL);
+
+    m_resumeTimer.setInterval(XMPP_RESUME_TIMEOUT);
+    m_resumeTimer.setSingleShot(true);
+
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+    m_outbound.setRate(settings.value(SETTING_XMPP_SEND_RATE).toDouble(),
+                       settings.value(SETTING_XMPP_SEND_BURST).toInt());
+
+    m_admission.setRate(settings.value(SETTING_XMPP_RECV_RATE).toDouble(),
+                        settings.intValue(SETTING_XMPP_RECV_BURST));
+    m_admission.setDuplicateWindow(settings.intValue(SETTING_XMPP_DUPLICATE_WINDOW));
+    m_admission.setMaxLength(settings.intValue(SETTING_XMPP_MAX_MESSAGE_LENGTH));
+    m_admission.setShedThreshold(settings.intValue(SETTING_XMPP_SHED_THRESHOLD));
+
+    m_ring = ContactRing(settings.intValue(SETTING_XMPP_SHARD_COUNT));
+    m_shard = qBound(0, settings.intValue(SETTING_XMPP_SHARD_INDEX), m_ring.shardCount() - 1);
+
     setupLogger();
     connectSignals();
 }
@@ -97,7 +157,11 @@ Lvk::CA::XmppChatbot::~XmppChatbot()
         m_isConnected = false;
     }
 
-    delete m_aiMutex;
+    // Pending messages are discarded
+    m_scheduler.stop();
+    m_outbound.clear();
+
+    delete m_queueMutex;
     delete m_rosterMutex;
     delete m_contactInfoMutex;
     delete m_xmppClient;
@@ -108,7 +172,7 @@ Lvk::CA::XmppChatbot::~XmppChatbot()
 
 void Lvk::CA::XmppChatbot::setupLogger()
 {
-    Cmn::Settings settings;
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
     QString logsPath = settings.value(SETTING_LOGS_PATH).toString();
     QString logFilename = logsPath + QDir::separator() + "./xmpp.log";
 
@@ -137,6 +201,13 @@ void Lvk::CA::XmppChatbot::connectSignals()
     connect(&m_xmppClient->vCardManager(), SIGNAL(vCardReceived(const QXmppVCardIq&)),
             this, SLOT(onVCardReceived(const QXmppVCardIq&)));
 
+    connect(m_xmppClient, SIGNAL(presenceReceived(const QXmppPresence&)),
+            this, SLOT(onPresenceReceived(const QXmppPresence&)));
+
+    connect(&m_vCardTimer, SIGNAL(timeout()), SLOT(requestVCardBatch()));
+
+    connect(&m_resumeTimer, SIGNAL(timeout()), SLOT(giveUpResume()));
+
     connect(m_xmppClient, SIGNAL(disconnected()), SLOT(onDisconnected()));
 
     connect(m_xmppClient, SIGNAL(error(QXmppClient::Error)),
@@ -150,14 +221,29 @@ void Lvk::CA::XmppChatbot::connectSignals()
 void Lvk::CA::XmppChatbot::connectToServer(const QString &user, const QString &passwd,
                                            const QString &domain)
 {
+    if (m_resuming) {
+        giveUpResume();
+    }
+
     m_user = normalizeUser(user);
     m_domain = normalizeDomain(domain);
 
+    {
+        QMutexLocker locker(m_contactInfoMutex);
+        m_vCards.setFilename(vCardCacheFilename());
+    }
+
     QXmppConfiguration conf;
     conf.setDomain(m_domain);
     conf.setUser(m_user);
     conf.setPassword(passwd);
     conf.setStreamSecurityMode(QXmppConfiguration::TLSRequired);
+
+    // Every shard needs its own session
+    if (m_ring.shardCount() > 1) {
+        conf.setResource(QString("LvkShard%1").arg(m_shard));
+    }
+
     m_xmppClient->connectToServer(conf);
 
 //    QString jid = m_user + "@" + m_domain;
@@ -169,6 +255,13 @@ void Lvk::CA::XmppChatbot::connectToServer(const QString &user, const QString &p
 
 void Lvk::CA::XmppChatbot::disconnectFromServer()
 {
+    if (m_resuming) {
+        giveUpResume();
+        return;
+    }
+
+    m_disconnecting = m_isConnected;
+
     m_xmppClient->disconnectFromServer();
 }
 
@@ -197,18 +290,15 @@ const QString & Lvk::CA::XmppChatbot::domain()
 
 void Lvk::CA::XmppChatbot::setAI(Lvk::CA::ChatbotAI *ai)
 {
-    QMutexLocker locker(m_aiMutex);
-
-    m_ai.reset(ai);
+    // The previous AI is deleted once no worker is using it
+    m_ai.publish(ai);
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::CA::ChatbotAI * Lvk::CA::XmppChatbot::AI()
 {
-    QMutexLocker locker(m_aiMutex);
-
-    return m_ai.get();
+    return Cmn::Snapshot<ChatbotAI>::Reader(m_ai).get();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -228,25 +318,23 @@ Lvk::CA::ContactInfoList Lvk::CA::XmppChatbot::roster() const
 
 void Lvk::CA::XmppChatbot::setBlackListRoster(const Lvk::CA::ContactInfoList &blackList)
 {
-    QMutexLocker locker(m_rosterMutex);
-
-    m_blackListRoster = blackList;
-
-    // Set for fast look-up
+    BlackList *newBlackList = new BlackList();
+    newBlackList->roster = blackList;
 
-    m_blackListSet.clear();
     foreach (const ContactInfo &info, blackList) {
-        m_blackListSet.insert(info.username);
+        newBlackList->usernames.insert(info.username);
     }
+
+    m_blackList.publish(newBlackList);
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::CA::ContactInfoList Lvk::CA::XmppChatbot::blackListRoster() const
 {
-    QMutexLocker locker(m_rosterMutex);
+    Cmn::Snapshot<BlackList>::Reader blackList(m_blackList);
 
-    return m_blackListRoster;
+    return blackList.get() ? blackList->roster : ContactInfoList();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -254,15 +342,21 @@ Lvk::CA::ContactInfoList Lvk::CA::XmppChatbot::blackListRoster() const
 
 bool Lvk::CA::XmppChatbot::isInBlackList(const QString &jid)
 {
-    QMutexLocker locker(m_rosterMutex);
+    Cmn::Snapshot<BlackList>::Reader blackList(m_blackList);
 
-    return m_blackListSet.contains(jid);
+    return blackList.get() && blackList->usernames.contains(jid);
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::CA::XmppChatbot::emitLocalError(QXmppClient::Error err)
 {
+    // Errors while resuming a session are not reported, QXmppReconnectionManager retries
+    if (m_resuming) {
+        qWarning() << "XmppChatbot: Error while resuming session" << err;
+        return;
+    }
+
     emit error(convertToLocalError(err));
 }
 
@@ -294,35 +388,40 @@ void Lvk::CA::XmppChatbot::onMessageReceived(const QXmppMessage& msg)
     }
 
     if (m_name.isEmpty()) {
-        m_name = getVCard(getBareJid(msg.to())).fullName();
+        m_name = getVCard(getBareJid(msg.to())).fullName;
     }
 
     QString bareJid = getBareJid(msg.from());
 
-    if (!isInBlackList(bareJid)) {
-        ContactInfo info = getContactInfo(bareJid);
-
-        Cmn::Conversation::Entry entry;
+    // Another shard answers this contact
+    if (m_ring.shard(bareJid) != m_shard) {
+        return;
+    }
 
-        {
-            QMutexLocker locker(m_aiMutex);
+    if (!isInBlackList(bareJid)) {
+        // Floods are dropped before they reach the AI, the history and the corpus
+        AdmissionControl::Decision decision = m_admission.admit(bareJid, msg.body(),
+                                                                m_scheduler.pending());
 
-            if (m_ai.get()) {
-               entry = m_ai->getEntry(msg.body(), info);
-            } else {
-                qCritical() << "XmppChatbot: No AI set";
-            }
+        if (decision == AdmissionControl::Drop) {
+            qDebug() << "XmppChatbot: Flood protection. Ignoring message from" << bareJid;
+            return;
         }
 
-        if (!entry.isNull()) {
-            if (!entry.response.isEmpty()) {
-                m_xmppClient->sendPacket(QXmppMessage("", msg.from(), entry.response));
-            }
-
-            m_history.append(entry);
-
-            emit newConversationEntry(entry);
+        PendingMessage pmsg;
+        pmsg.from = msg.from();
+        pmsg.body = msg.body();
+        pmsg.info = getContactInfo(bareJid);
+        pmsg.evasive = decision == AdmissionControl::Degrade;
+
+        // Jobs of the same contact run in order, one at a time
+        if (!m_scheduler.schedule(bareJid, new MatchJob(this, pmsg))) {
+            qWarning() << "XmppChatbot: Too many pending messages. Ignoring message from"
+                       << bareJid;
+            return;
         }
+
+        qDebug() << "XmppChatbot: Pending messages:" << m_scheduler.pending();
     } else {
         qDebug() << "XmppChatbot: Ignoring message" << msg.body() << "because user"
                  << bareJid << "is in black list";
@@ -336,29 +435,76 @@ Lvk::CA::ContactInfo Lvk::CA::XmppChatbot::getContactInfo(const QString &bareJid
 {
     QXmppRosterIq::Item item = m_xmppClient->rosterManager().getRosterEntry(bareJid);
 
-    return CA::ContactInfo(bareJid, item.name());
+    QString name = item.name();
+
+    // If the roster has no name, use the one in the vCard
+    if (name.isEmpty()) {
+        QMutexLocker locker(m_contactInfoMutex);
+        name = m_vCards.entry(bareJid).fullName;
+    }
+
+    return CA::ContactInfo(bareJid, name);
 }
 
 //--------------------------------------------------------------------------------------------------
 
-QXmppVCardIq Lvk::CA::XmppChatbot::getVCard(const QString &bareJid)
+Lvk::CA::VCardCache::Entry Lvk::CA::XmppChatbot::getVCard(const QString &bareJid)
 {
     QMutexLocker locker(m_contactInfoMutex);
 
-    QXmppVCardIq vCard;
+    return m_vCards.entry(bareJid);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::XmppChatbot::requestVCard(const QString &bareJid)
+{
+    // vCards must not delay chat replies
+    m_outbound.enqueue(new QXmppVCardIq(bareJid), OutboundQueue::LowPriority);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::XmppChatbot::enqueueVCard(const QString &bareJid)
+{
+    if (!m_vCardQueued.contains(bareJid)) {
+        m_vCardQueued.insert(bareJid);
+        m_vCardQueue.append(bareJid);
+    }
+
+    if (!m_vCardTimer.isActive()) {
+        m_vCardTimer.start();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Requests a few vCards at a time, so the server does not throttle us
+void Lvk::CA::XmppChatbot::requestVCardBatch()
+{
+    if (!m_isConnected || m_vCardQueue.isEmpty()) {
+        m_vCardTimer.stop();
+        return;
+    }
 
-    if (m_vCards.contains(bareJid)) {
-        vCard = m_vCards[bareJid];
+    for (int i = 0; i < XMPP_VCARD_BATCH_SIZE && !m_vCardQueue.isEmpty(); ++i) {
+        requestVCard(m_vCardQueue.takeFirst());
     }
 
-    return vCard;
+    qDebug() << "XmppChatbot: vCards waiting to be requested:" << m_vCardQueue.size();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::CA::XmppChatbot::requestVCard(const QString &bareJid)
+QString Lvk::CA::XmppChatbot::vCardCacheFilename() const
 {
-    m_xmppClient->vCardManager().requestVCard(bareJid);
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+    QString path = settings.value(SETTING_DATA_PATH).toString() + QDir::separator()
+            + XMPP_VCARD_CACHE_DIR;
+
+    QDir().mkpath(path);
+
+    return path + QDir::separator() + m_user + "@" + m_domain + ".cache";
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -367,8 +513,65 @@ void Lvk::CA::XmppChatbot::onVCardReceived(const QXmppVCardIq &vCard)
 {
     QString bareJid = getBareJid(vCard.from());
 
-    QMutexLocker locker(m_contactInfoMutex);
-    m_vCards[bareJid] = vCard;
+    m_vCardQueued.remove(bareJid);
+
+    {
+        QMutexLocker locker(m_contactInfoMutex);
+
+        // Only the photo hash is kept in memory, the photo is written to disk
+        m_vCards.insert(bareJid, vCard.fullName(), vCard.nickName(), vCard.photo());
+
+        if (m_vCardQueue.isEmpty()) {
+            m_vCards.save();
+        }
+    }
+
+    // Contacts without name in the roster get the name of the vCard
+    ContactInfo info;
+
+    {
+        QMutexLocker locker(m_rosterMutex);
+
+        QMap<QString, ContactInfo>::iterator it = m_rosterIndex.find(bareJid);
+
+        if (it != m_rosterIndex.end() && it->fullname.isEmpty() && !vCard.fullName().isEmpty()) {
+            it->fullname = vCard.fullName();
+            info = *it;
+            m_rosterHasChanged = true;
+        }
+    }
+
+    if (!info.isNull()) {
+        emit contactChanged(info);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// XEP-0153: Contacts advertise the hash of their photo. If it changed, the vCard changed.
+void Lvk::CA::XmppChatbot::onPresenceReceived(const QXmppPresence &presence)
+{
+    QXmppPresence::VCardUpdateType updateType = presence.vCardUpdateType();
+
+    if (updateType != QXmppPresence::VCardUpdateNoPhoto &&
+        updateType != QXmppPresence::VCardUpdateValidPhoto) {
+        return;
+    }
+
+    QString bareJid = getBareJid(presence.from());
+    QByteArray photoHash = updateType == QXmppPresence::VCardUpdateValidPhoto
+            ? presence.photoHash() : QByteArray();
+
+    bool valid = false;
+
+    {
+        QMutexLocker locker(m_contactInfoMutex);
+        valid = m_vCards.isValid(bareJid, photoHash);
+    }
+
+    if (!valid && !bareJid.isEmpty()) {
+        enqueueVCard(bareJid);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -379,6 +582,21 @@ void Lvk::CA::XmppChatbot::onConnected()
 
     m_connStartTime = QDateTime::currentDateTime().toTime_t();
 
+    if (m_resuming) {
+        qDebug() << "XmppChatbot: Session resumed";
+
+        m_resuming = false;
+        m_resumed = true;
+        m_resumeTimer.stop();
+
+        // Replies queued while the connection was down
+        m_outbound.flush();
+
+        if (!m_name.isEmpty()) {
+            return;
+        }
+    }
+
     requestVCard(""); // own vcard
 }
 
@@ -386,6 +604,16 @@ void Lvk::CA::XmppChatbot::onConnected()
 
 void Lvk::CA::XmppChatbot::onDisconnected()
 {
+    if (m_resuming) {
+        // A reconnection attempt failed. We keep trying until m_resumeTimer expires
+        return;
+    }
+
+    if (m_isConnected && !m_disconnecting) {
+        beginResume();
+        return;
+    }
+
     if (m_isConnected) {
         emit disconnected();
     } else {
@@ -399,28 +627,225 @@ void Lvk::CA::XmppChatbot::onDisconnected()
         }
     }
 
+    m_disconnecting = false;
+
+    resetSession();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// The connection was lost but the user did not request to disconnect. The roster, vCards and
+// pending replies are kept and the session is resumed as soon as we reconnect
+void Lvk::CA::XmppChatbot::beginResume()
+{
+    qWarning() << "XmppChatbot: Connection lost. Trying to resume session";
+
+    m_isConnected = false;
+    m_resuming = true;
+    m_resumed = false;
+
+    m_vCardTimer.stop();
+    m_resumeTimer.start();
+
+    if (!m_xmppClient->configuration().autoReconnectionEnabled() && m_netMgr.isOnline()) {
+        m_xmppClient->connectToServer(m_xmppClient->configuration());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::XmppChatbot::giveUpResume()
+{
+    if (!m_resuming) {
+        return;
+    }
+
+    qWarning() << "XmppChatbot: Could not resume session";
+
+    m_resuming = false;
+    m_resumeTimer.stop();
+
+    if (m_xmppClient->reconnectionManager()) {
+        m_xmppClient->reconnectionManager()->cancelReconnection();
+    }
+
+    emit disconnected();
+
+    resetSession();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::XmppChatbot::resetSession()
+{
     m_isConnected = false;
+    m_resumed = false;
     m_user.clear();
     m_domain.clear();
+
+    m_vCardTimer.stop();
+    m_vCardQueue.clear();
+    m_vCardQueued.clear();
+
+    m_outbound.clear();
+
+    QMutexLocker locker(m_contactInfoMutex);
+    m_vCards.save();
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::CA::XmppChatbot::onRosterReceived()
 {
+    if (m_resumed) {
+        m_resumed = false;
+        mergeResumedRoster();
+        return;
+    }
+
+    QStringList jids;
+
     {
         QMutexLocker locker(m_rosterMutex);
+
+        m_rosterIndex.clear();
+        foreach (const QString &jid, m_xmppClient->rosterManager().getRosterBareJids()) {
+            m_rosterIndex.insert(jid, getContactInfo(jid));
+        }
+
         rebuildLocalRoster();
+
+        jids = m_rosterIndex.keys();
     }
 
+    prefetchVCards(jids);
+
     emit connected();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::CA::XmppChatbot::onRosterChanged(const QString &/*bareJid*/)
+// After resuming a session the cached roster is still valid, so instead of rebuilding it we
+// only notify the contacts that changed while we were offline. connected() is not emitted
+// because disconnected() was not emitted either.
+void Lvk::CA::XmppChatbot::mergeResumedRoster()
+{
+    ContactInfoList added;
+    ContactInfoList changed;
+    QStringList removed;
+    QStringList jids;
+
+    {
+        QMutexLocker locker(m_rosterMutex);
+
+        QMap<QString, ContactInfo> index;
+        foreach (const QString &jid, m_xmppClient->rosterManager().getRosterBareJids()) {
+            ContactInfo info = getContactInfo(jid);
+
+            QMap<QString, ContactInfo>::const_iterator it = m_rosterIndex.find(jid);
+            if (it == m_rosterIndex.constEnd()) {
+                added.append(info);
+            } else if (it->fullname != info.fullname) {
+                changed.append(info);
+            }
+
+            index.insert(jid, info);
+        }
+
+        foreach (const QString &jid, m_rosterIndex.keys()) {
+            if (!index.contains(jid)) {
+                removed.append(jid);
+            }
+        }
+
+        if (!added.isEmpty() || !changed.isEmpty() || !removed.isEmpty()) {
+            m_rosterIndex = index;
+            m_rosterHasChanged = true;
+        }
+
+        jids = m_rosterIndex.keys();
+    }
+
+    prefetchVCards(jids);
+
+    foreach (const ContactInfo &info, added) {
+        emit contactAdded(info);
+    }
+    foreach (const ContactInfo &info, changed) {
+        emit contactChanged(info);
+    }
+    foreach (const QString &jid, removed) {
+        emit contactRemoved(jid);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::XmppChatbot::prefetchVCards(const QStringList &jids)
 {
-    m_rosterHasChanged = true;
+    // Prefetch in background the vCards that are not in the cache or are too old
+    QStringList missing;
+
+    {
+        QMutexLocker locker(m_contactInfoMutex);
+        missing = m_vCards.missing(jids, XMPP_VCARD_MAX_AGE);
+    }
+
+    foreach (const QString &jid, missing) {
+        enqueueVCard(jid);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Only the given contact is updated. The list returned by roster() is rebuilt from the index
+// the next time it's requested
+void Lvk::CA::XmppChatbot::onRosterChanged(const QString &bareJid)
+{
+    QXmppRosterIq::Item item = m_xmppClient->rosterManager().getRosterEntry(bareJid);
+
+    // Removed entries are not in the roster anymore, so we get an empty item
+    bool removed = item.bareJid().isEmpty();
+    ContactInfo info(bareJid, item.name());
+
+    enum { NoChange, Added, Changed, Removed } change = NoChange;
+
+    {
+        QMutexLocker locker(m_rosterMutex);
+
+        QMap<QString, ContactInfo>::iterator it = m_rosterIndex.find(bareJid);
+
+        if (removed) {
+            if (it != m_rosterIndex.end()) {
+                m_rosterIndex.erase(it);
+                change = Removed;
+            }
+        } else if (it == m_rosterIndex.end()) {
+            m_rosterIndex.insert(bareJid, info);
+            change = Added;
+        } else if (it->fullname != info.fullname) {
+            *it = info;
+            change = Changed;
+        }
+
+        if (change != NoChange) {
+            m_rosterHasChanged = true;
+        }
+    }
+
+    switch (change) {
+    case Added:
+        emit contactAdded(info);
+        break;
+    case Changed:
+        emit contactChanged(info);
+        break;
+    case Removed:
+        emit contactRemoved(bareJid);
+        break;
+    default:
+        break;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -434,12 +859,11 @@ bool Lvk::CA::XmppChatbot::tlsRequired() const
 
 //--------------------------------------------------------------------------------------------------
 
+// m_rosterMutex must be locked
 void Lvk::CA::XmppChatbot::rebuildLocalRoster() const
 {
-    m_roster.clear();
-    foreach (const QString &jid, m_xmppClient->rosterManager().getRosterBareJids()) {
-        m_roster.append(getContactInfo(jid));
-    }
+    m_roster = m_rosterIndex.values();
+    m_rosterHasChanged = false;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -451,6 +875,14 @@ const Lvk::Cmn::Conversation & Lvk::CA::XmppChatbot::chatHistory() const
 
 //--------------------------------------------------------------------------------------------------
 
+Lvk::Cmn::Conversation Lvk::CA::XmppChatbot::chatHistory(const QDateTime &from,
+                                                         const QDateTime &to) const
+{
+    return m_history.history(from, to);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::CA::XmppChatbot::setChatHistory(const Cmn::Conversation &conv)
 {
     m_history.setHistory(conv);
@@ -458,6 +890,13 @@ void Lvk::CA::XmppChatbot::setChatHistory(const Cmn::Conversation &conv)
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::CA::XmppChatbot::removeChatHistory(const QDate &date, const QString &user)
+{
+    m_history.remove(date, user);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::CA::XmppChatbot::clearHistory()
 {
     m_history.clear();
@@ -479,13 +918,100 @@ QString Lvk::CA::XmppChatbot::historyFilename() const
 
 //--------------------------------------------------------------------------------------------------
 
+int Lvk::CA::XmppChatbot::pendingMessages() const
+{
+    return m_scheduler.pending();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Invoked by worker threads
+void Lvk::CA::XmppChatbot::processMessage(const PendingMessage &pmsg)
+{
+    Cmn::Conversation::Entry entry;
+
+    {
+        Cmn::Snapshot<ChatbotAI>::Reader ai(m_ai);
+
+        if (ai.get()) {
+            entry = pmsg.evasive ? ai->getEvasiveEntry(pmsg.body, pmsg.info)
+                                 : ai->getEntry(pmsg.body, pmsg.info);
+        } else {
+            qCritical() << "XmppChatbot: No AI set";
+        }
+    }
+
+    if (entry.isNull()) {
+        return;
+    }
+
+    bool notify = false;
+
+    {
+        QMutexLocker locker(m_queueMutex);
+
+        Reply reply;
+        reply.to = pmsg.from;
+        reply.entry = entry;
+        m_replies.enqueue(reply);
+        notify = m_replies.size() == 1;
+    }
+
+    // Replies are sent by the thread of the XMPP client
+    if (notify) {
+        QMetaObject::invokeMethod(this, "sendReplies", Qt::QueuedConnection);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::CA::XmppChatbot::sendReplies()
+{
+    QQueue<Reply> replies;
+
+    {
+        QMutexLocker locker(m_queueMutex);
+        replies = m_replies;
+        m_replies.clear();
+    }
+
+    foreach (const Reply &reply, replies) {
+        if (!reply.entry.response.isEmpty()) {
+            m_outbound.enqueue(new QXmppMessage("", reply.to, reply.entry.response),
+                               OutboundQueue::HighPriority);
+        }
+
+        m_history.append(reply.entry);
+
+        emit newConversationEntry(reply.entry);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::OutboundQueue::Stats Lvk::CA::XmppChatbot::sendStats() const
+{
+    return m_outbound.stats();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::CA::AdmissionControl::Stats Lvk::CA::XmppChatbot::admissionStats() const
+{
+    return m_admission.stats();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::CA::XmppChatbot::onOnlineStateChanged(bool isOnline)
 {
-    // Detect internet disconnection
+    // Detect internet disconnection. The session is resumed once we are online again
     if (!isOnline) {
         if (m_isConnected) {
-            disconnectFromServer();
+            m_xmppClient->disconnectFromServer();
         }
+    } else if (m_resuming && !m_xmppClient->isConnected()) {
+        m_xmppClient->connectToServer(m_xmppClient->configuration());
     }
 }
 
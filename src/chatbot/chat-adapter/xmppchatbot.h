@@ -24,6 +24,10 @@
 
 #include <QObject>
 #include <QHash>
+#include <QMap>
+#include <QQueue>
+#include <QSet>
+#include <QTimer>
 #include <QNetworkConfigurationManager>
 #include <memory>
 
@@ -31,9 +35,17 @@
 #include "QXmppMessage.h"
 #include "QXmppRosterIq.h"
 #include "chat-adapter/chatbot.h"
+#include "chat-adapter/contactinfo.h"
+#include "chat-adapter/contactscheduler.h"
+#include "chat-adapter/contactring.h"
 #include "chat-adapter/historyhelper.h"
+#include "chat-adapter/vcardcache.h"
+#include "chat-adapter/outboundqueue.h"
+#include "chat-adapter/admissioncontrol.h"
+#include "common/snapshot.h"
 
 class QXmppVCardIq;
+class QXmppPresence;
 class QMutex;
 class QWaitCondition;
 
@@ -56,6 +68,20 @@ class ContactInfo;
  * \brief The XmppChatbot class provides a chatbot for XMPP chat servers.
  *
  * XMPP is also known as Jabber.
+ *
+ * Responses are computed by worker threads, so the event loop is never blocked by the AI.
+ * Messages of the same contact are answered in order. If too many messages are waiting for
+ * a response, new messages are ignored until the workers catch up. See pendingMessages().
+ *
+ * Before that, the AdmissionControl drops floods of each contact and answers oversized
+ * messages, and every message while overloaded, with an evasive without matching them. Its
+ * limits are read from the application settings. See admissionStats().
+ *
+ * Several processes can serve one account. Each process connects with its own resource and
+ * answers only the contacts that the ContactRing assigns to its shard, so a contact is always
+ * answered by the same process and in order. The shard count and index are read from the
+ * application settings. This requires a server that delivers messages sent to the bare JID
+ * to every resource with the same priority, as GTalk does.
  */
 
 class XmppChatbot : public Chatbot
@@ -151,16 +177,43 @@ public:
      */
     virtual const Cmn::Conversation &chatHistory() const;
 
+    /**
+     * \copydoc Chatbot::chatHistory(const QDateTime &, const QDateTime &) const
+     */
+    virtual Cmn::Conversation chatHistory(const QDateTime &from, const QDateTime &to) const;
+
     /**
      * \copydoc Chatbot::setChatHistory()
      */
     virtual void setChatHistory(const Cmn::Conversation &conv);
 
+    /**
+     * \copydoc Chatbot::removeChatHistory()
+     */
+    virtual void removeChatHistory(const QDate &date, const QString &user);
+
     /**
      * \copydoc Chatbot::clearHistory()
      */
     virtual void clearHistory();
 
+    /**
+     * Returns the amount of received messages waiting for a response.
+     */
+    int pendingMessages() const;
+
+    /**
+     * Returns the metrics of the outbound queue, i.e. stanzas sent, dropped and the time they
+     * waited to be sent.
+     */
+    OutboundQueue::Stats sendStats() const;
+
+    /**
+     * Returns the amount of received messages accepted, dropped and answered with an evasive
+     * by the admission control.
+     */
+    AdmissionControl::Stats admissionStats() const;
+
 signals:
 
     /**
@@ -185,6 +238,7 @@ protected slots:
     virtual void onVCardReceived(const QXmppVCardIq &);
     virtual void onRosterReceived();
     virtual void onRosterChanged(const QString &);
+    virtual void onPresenceReceived(const QXmppPresence &);
 
 protected:
     QXmppClient *m_xmppClient;
@@ -200,20 +254,58 @@ protected:
 private slots:
     void emitLocalError(QXmppClient::Error);
     void onOnlineStateChanged(bool isOnline);
+    void sendReplies();
+    void requestVCardBatch();
+    void giveUpResume();
 private:
     XmppChatbot(XmppChatbot&);
     XmppChatbot& operator=(XmppChatbot&);
 
-    std::auto_ptr<ChatbotAI> m_ai;
-    QHash<QString, QXmppVCardIq> m_vCards;
+    class MatchJob;
+
+    struct PendingMessage
+    {
+        QString from;
+        QString body;
+        ContactInfo info;
+        bool evasive;                       // Answer with an evasive without matching
+    };
+
+    struct Reply
+    {
+        QString to;
+        Cmn::Conversation::Entry entry;
+    };
+
+    struct BlackList
+    {
+        ContactInfoList roster;
+        QSet<QString> usernames;            // Set for fast look-up
+    };
+
+    Cmn::Snapshot<ChatbotAI> m_ai;
+    VCardCache m_vCards;
+    QStringList m_vCardQueue;               // vCards to prefetch
+    QSet<QString> m_vCardQueued;
+    QTimer m_vCardTimer;
     QMutex *m_contactInfoMutex;
     QMutex *m_rosterMutex;
-    QMutex *m_aiMutex;
+    QMutex *m_queueMutex;
+    QQueue<Reply> m_replies;
+    ContactScheduler m_scheduler;
+    OutboundQueue m_outbound;
+    AdmissionControl m_admission;
+    ContactRing m_ring;
+    int m_shard;                            // Shard of m_ring answered by this process
     bool m_isConnected;
-    bool m_rosterHasChanged;
+    bool m_disconnecting;                   // Disconnection requested by the user
+    bool m_resuming;                        // Connection lost, waiting to reconnect
+    bool m_resumed;                         // Reconnected, waiting for the roster
+    QTimer m_resumeTimer;
+    mutable bool m_rosterHasChanged;
+    QMap<QString, ContactInfo> m_rosterIndex;   // Contacts by bare JID
     mutable ContactInfoList m_roster;
-    ContactInfoList m_blackListRoster;
-    QSet<QString> m_blackListSet;
+    Cmn::Snapshot<BlackList> m_blackList;
     uint m_connStartTime;
     QNetworkConfigurationManager m_netMgr;
 
@@ -223,12 +315,21 @@ private:
 
     ContactInfo getContactInfo(const QString &bareJid) const;
 
-    QXmppVCardIq getVCard(const QString &bareJid);
+    void beginResume();
+    void resetSession();
+    void mergeResumedRoster();
+    void prefetchVCards(const QStringList &jids);
+
+    VCardCache::Entry getVCard(const QString &bareJid);
     void requestVCard(const QString &bareJid);
+    void enqueueVCard(const QString &bareJid);
+    QString vCardCacheFilename() const;
 
     Error convertToLocalError(QXmppClient::Error err);
 
     void rebuildLocalRoster() const;
+
+    void processMessage(const PendingMessage &pmsg);
 };
 
 /// @}
@@ -11,22 +11,43 @@ HEADERS += \
     $$PROJECT_PATH/common/settingskeys.h \
     $$PROJECT_PATH/common/csvdocument.h \
     $$PROJECT_PATH/common/csvrow.h \
+    $$PROJECT_PATH/common/csvparser.h \
     $$PROJECT_PATH/common/globalstrings.h \
     $$PROJECT_PATH/common/conversation.h \
     $$PROJECT_PATH/common/conversationwriter.h \
     $$PROJECT_PATH/common/conversationreader.h \
+    $$PROJECT_PATH/common/conversationlog.h \
     $$PROJECT_PATH/common/logger.h \
     $$PROJECT_PATH/common/json.h \
     $$PROJECT_PATH/common/crashhandler.h \
+    $$PROJECT_PATH/common/trace.h \
+    $$PROJECT_PATH/common/profiler.h \
+    $$PROJECT_PATH/common/startuptimeline.h \
+    $$PROJECT_PATH/common/journal.h \
+    $$PROJECT_PATH/common/snapshot.h \
+    $$PROJECT_PATH/common/memorymanager.h \
+    $$PROJECT_PATH/common/maintenancescheduler.h \
+    $$PROJECT_PATH/common/taskscheduler.h \
+    $$PROJECT_PATH/common/textsearch.h \
 
 SOURCES += \
     $$PROJECT_PATH/common/random.cpp \
     $$PROJECT_PATH/common/settings.cpp \
     $$PROJECT_PATH/common/csvdocument.cpp \
     $$PROJECT_PATH/common/csvrow.cpp \
+    $$PROJECT_PATH/common/csvparser.cpp \
     $$PROJECT_PATH/common/conversation.cpp \
     $$PROJECT_PATH/common/conversationwriter.cpp \
     $$PROJECT_PATH/common/conversationreader.cpp \
+    $$PROJECT_PATH/common/conversationlog.cpp \
     $$PROJECT_PATH/common/logger.cpp \
     $$PROJECT_PATH/common/json.cpp \
     $$PROJECT_PATH/common/crashhandler.cpp \
+    $$PROJECT_PATH/common/trace.cpp \
+    $$PROJECT_PATH/common/profiler.cpp \
+    $$PROJECT_PATH/common/startuptimeline.cpp \
+    $$PROJECT_PATH/common/journal.cpp \
+    $$PROJECT_PATH/common/memorymanager.cpp \
+    $$PROJECT_PATH/common/maintenancescheduler.cpp \
+    $$PROJECT_PATH/common/taskscheduler.cpp \
+    $$PROJECT_PATH/common/textsearch.cpp \
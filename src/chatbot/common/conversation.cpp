@@ -24,6 +24,52 @@
 
 #include <QStringList>
 #include <QRegExp>
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+inline bool entryBefore(const Lvk::Cmn::Conversation::Entry &entry, const QDateTime &dateTime)
+{
+    return entry.dateTime < dateTime;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Participants of all entries. Contacts are few compared to entries, so they are never removed.
+struct ParticipantPool
+{
+    QMutex mutex;
+    QSet<QString> participants;
+};
+
+Q_GLOBAL_STATIC(ParticipantPool, participantPool)
+
+//--------------------------------------------------------------------------------------------------
+
+void internParticipant(QString &participant, ParticipantPool *pool)
+{
+    if (participant.isEmpty()) {
+        return;
+    }
+
+    QSet<QString>::const_iterator it = pool->participants.constFind(participant);
+
+    if (it != pool->participants.constEnd()) {
+        participant = *it;
+    } else {
+        pool->participants.insert(participant);
+    }
+}
+
+} // namespace
 
 //--------------------------------------------------------------------------------------------------
 // Conversation::Entry
@@ -32,7 +78,7 @@
 #define DATE_TIME_LOG_FORMAT    "dd-MM-yyyy hh:mm:ss"
 
 Lvk::Cmn::Conversation::Entry::Entry()
-    : match(false), ruleId(0)
+    : match(false), ruleId(0), rulesVersion(0)
 {
 }
 
@@ -42,8 +88,9 @@ Lvk::Cmn::Conversation::Entry::Entry(const QDateTime &dateTime, const QString &f
                                     const QString &to, const QString &msg, const QString &response,
                                     bool match, quint64 ruleId /*= 0*/)
     : dateTime(dateTime), from(from), to(to), msg(msg), response(response), match(match),
-      ruleId(ruleId)
+      ruleId(ruleId), rulesVersion(0)
 {
+    internParticipants();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -70,6 +117,23 @@ void Lvk::Cmn::Conversation::Entry::clear()
     response.clear();
     match = false;
     ruleId = 0;
+    rulesVersion = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Conversation::Entry::internParticipants()
+{
+    ParticipantPool *pool = participantPool();
+
+    if (!pool) {
+        return; // Application is exiting
+    }
+
+    QMutexLocker locker(&pool->mutex);
+
+    internParticipant(from, pool);
+    internParticipant(to, pool);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -138,6 +202,54 @@ void Lvk::Cmn::Conversation::clear()
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::Cmn::Conversation::removeFirst(int n)
+{
+    n = qBound(0, n, m_entries.size());
+
+    m_entries.erase(m_entries.begin(), m_entries.begin() + n);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Conversation::const_iterator Lvk::Cmn::Conversation::begin() const
+{
+    return m_entries.constBegin();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Conversation::const_iterator Lvk::Cmn::Conversation::end() const
+{
+    return m_entries.constEnd();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Conversation::const_iterator
+Lvk::Cmn::Conversation::lowerBound(const QDateTime &dateTime) const
+{
+    return qLowerBound(m_entries.constBegin(), m_entries.constEnd(), dateTime, entryBefore);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Conversation Lvk::Cmn::Conversation::range(const QDateTime &from,
+                                                      const QDateTime &to) const
+{
+    Conversation conv;
+
+    const_iterator it = from.isNull() ? begin() : lowerBound(from);
+    const_iterator last = to.isNull() ? end() : lowerBound(to);
+
+    for (; it < last; ++it) {
+        conv.append(*it);
+    }
+
+    return conv;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool Lvk::Cmn::Conversation::operator==(const Lvk::Cmn::Conversation &other) const
 {
     return m_entries == other.m_entries;
@@ -84,6 +84,7 @@ public:
         QString response;   //! Response
         bool match;         //! True if there were match; false otherwise.
         quint64 ruleId;     //! If match, contains the rule ID of the matched rule
+        quint32 rulesVersion; //! If match, the version of the NLP rules. Not saved in files
 
         /**
          * An entry is null if all class attributes are null.
@@ -96,6 +97,14 @@ public:
          */
         void clear();
 
+        /**
+         * Makes \a from and \a to share their data with the equal participants of every other
+         * interned entry, so each participant is kept once in memory no matter how many
+         * entries refer to it. Entries read from files and entries constructed with
+         * participants are interned.
+         */
+        void internParticipants();
+
         /**
          * Returns true if this entry is equal to entry @param other; otherwise returns false.
          */
@@ -107,6 +116,8 @@ public:
         bool operator!=(const Entry &other) const;
     };
 
+    typedef QList<Entry>::const_iterator const_iterator;
+
     /**
      * Sets the given entries to the conversation.
      */
@@ -132,6 +143,34 @@ public:
      */
     void clear();
 
+    /**
+     * Removes the first \a n entries in the conversation.
+     */
+    void removeFirst(int n);
+
+    /**
+     * Returns an iterator pointing to the first entry in the conversation.
+     */
+    const_iterator begin() const;
+
+    /**
+     * Returns an iterator pointing to the imaginary entry after the last one.
+     */
+    const_iterator end() const;
+
+    /**
+     * Returns an iterator pointing to the first entry with date time greater or equal than
+     * \a dateTime. If there is no such entry, returns end(). Entries must be sorted by date time.
+     */
+    const_iterator lowerBound(const QDateTime &dateTime) const;
+
+    /**
+     * Returns the entries with date time between \a from (inclusive) and \a to (exclusive).
+     * A null \a from or \a to means no lower or upper bound respectively. Entries must be
+     * sorted by date time.
+     */
+    Conversation range(const QDateTime &from, const QDateTime &to) const;
+
     /**
      * Returns true if the conversation has no entries. Otherwise; returns false.
      */
@@ -172,7 +211,11 @@ inline QDataStream &operator<<(QDataStream &stream, const Conversation::Entry &e
  */
 inline QDataStream &operator>>(QDataStream &stream, Conversation::Entry &e)
 {
-    return stream >> e.dateTime >> e.from >> e.to >> e.msg >> e.response >> e.match >> e.ruleId;
+    stream >> e.dateTime >> e.from >> e.to >> e.msg >> e.response >> e.match >> e.ruleId;
+
+    e.internParticipants();
+
+    return stream;
 }
 
 /**
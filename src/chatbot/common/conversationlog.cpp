@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/conversationlog.h"
+#include "common/conversationreader.h"
+
+#include <QDataStream>
+#include <QByteArray>
+#include <QtEndian>
+#include <QtDebug>
+
+#define INDEX_FILE_EXT      ".idx"
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const quint32 LOG_MAGIC_NUMBER   = 0x4c564b6c;  // "LVKl"
+const quint32 INDEX_MAGIC_NUMBER = 0x4c564b69;  // "LVKi"
+const quint32 LOG_VERSION        = 1;
+const qint64  LOG_HEADER_SIZE    = 8;
+const qint64  NULL_TIMESTAMP     = Q_INT64_C(-9223372036854775807) - 1;
+const quint32 MAX_RECORD_SIZE    = 64*1024*1024;
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray makeRecord(const Lvk::Cmn::Conversation::Entry &entry)
+{
+    QByteArray payload;
+    QDataStream ostream(&payload, QIODevice::WriteOnly);
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    qint64 timestamp = entry.dateTime.isValid() ? entry.dateTime.toMSecsSinceEpoch()
+                                                : NULL_TIMESTAMP;
+
+    ostream << timestamp << entry.from << entry.to << entry.msg << entry.response << entry.match
+            << entry.ruleId;
+
+    uchar size[4];
+    qToBigEndian<quint32>(payload.size(), size);
+
+    return QByteArray(reinterpret_cast<const char *>(size), sizeof(size)) + payload;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool parseRecord(Lvk::Cmn::Conversation::Entry &entry, const QByteArray &payload)
+{
+    QDataStream istream(payload);
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    qint64 timestamp = NULL_TIMESTAMP;
+
+    istream >> timestamp >> entry.from >> entry.to >> entry.msg >> entry.response >> entry.match
+            >> entry.ruleId;
+
+    entry.dateTime = timestamp != NULL_TIMESTAMP ? QDateTime::fromMSecsSinceEpoch(timestamp)
+                                                 : QDateTime();
+
+    return istream.status() == QDataStream::Ok;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// ConversationLog
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::ConversationLog::ConversationLog(const QString &filename)
+    : m_file(filename),
+      m_indexFilename(filename + INDEX_FILE_EXT),
+      m_indexedSize(LOG_HEADER_SIZE),
+      m_dirty(false)
+{
+    qDebug() << "ConversationLog: Opening" << filename;
+
+    if (!open()) {
+        qCritical() << "ConversationLog: Cannot open" << filename;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::ConversationLog::~ConversationLog()
+{
+    flush();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::open()
+{
+    if (!m_file.open(QFile::ReadWrite)) {
+        return false;
+    }
+
+    QDataStream stream(&m_file);
+
+    if (m_file.size() == 0) {
+        stream << LOG_MAGIC_NUMBER << LOG_VERSION;
+        m_file.flush();
+        m_dirty = true;
+    } else {
+        quint32 magic = 0;
+        quint32 version = 0;
+        stream >> magic >> version;
+
+        if (magic != LOG_MAGIC_NUMBER || version != LOG_VERSION) {
+            qCritical() << "ConversationLog: Invalid file format" << m_file.fileName();
+            m_file.close();
+            return false;
+        }
+    }
+
+    if (!loadIndex()) {
+        m_index.clear();
+        m_indexedSize = LOG_HEADER_SIZE;
+        m_dirty = true;
+    }
+
+    return updateIndex();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::loadIndex()
+{
+    QFile indexFile(m_indexFilename);
+
+    if (!indexFile.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream istream(&indexFile);
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic = 0;
+    qint64 indexedSize = 0;
+    quint32 count = 0;
+
+    istream >> magic >> indexedSize >> count;
+
+    if (magic != INDEX_MAGIC_NUMBER || indexedSize < LOG_HEADER_SIZE
+            || indexedSize > m_file.size()) {
+        return false;
+    }
+
+    m_index.clear();
+
+    for (quint32 i = 0; i < count && istream.status() == QDataStream::Ok; ++i) {
+        DateContact key;
+        quint32 nranges = 0;
+
+        istream >> key.first >> key.second >> nranges;
+
+        QList<Range> &ranges = m_index[key];
+
+        for (quint32 j = 0; j < nranges && istream.status() == QDataStream::Ok; ++j) {
+            Range r;
+            istream >> r.begin >> r.end;
+            ranges.append(r);
+        }
+    }
+
+    m_indexedSize = indexedSize;
+
+    return istream.status() == QDataStream::Ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::updateIndex()
+{
+    // Index records appended after the index file was written
+
+    if (m_indexedSize == m_file.size()) {
+        return true;
+    }
+
+    if (!m_file.seek(m_indexedSize)) {
+        return false;
+    }
+
+    Conversation::Entry entry;
+    qint64 begin = m_indexedSize;
+
+    while (readRecord(entry)) {
+        qint64 end = m_file.pos();
+        addToIndex(entry, begin, end);
+        begin = end;
+    }
+
+    m_indexedSize = begin;
+    m_dirty = true;
+
+    if (m_indexedSize < m_file.size()) {
+        qWarning() << "ConversationLog: Discarding incomplete record in" << m_file.fileName();
+        return m_file.resize(m_indexedSize);
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::ConversationLog::addToIndex(const Conversation::Entry &entry, qint64 begin,
+                                           qint64 end)
+{
+    QList<Range> &ranges = m_index[DateContact(entry.dateTime.date(), entry.from)];
+
+    // Consecutive entries with the same key are merged in a single range
+    if (!ranges.isEmpty() && ranges.last().end == begin) {
+        ranges.last().end = end;
+    } else {
+        ranges.append(Range(begin, end));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::readRecord(Conversation::Entry &entry)
+{
+    uchar size[4];
+
+    if (m_file.read(reinterpret_cast<char *>(size), sizeof(size)) != sizeof(size)) {
+        return false;
+    }
+
+    quint32 payloadSize = qFromBigEndian<quint32>(size);
+
+    if (payloadSize > MAX_RECORD_SIZE) {
+        return false;
+    }
+
+    QByteArray payload = m_file.read(payloadSize);
+
+    return (quint32)payload.size() == payloadSize && parseRecord(entry, payload);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::append(const Conversation::Entry &entry)
+{
+    if (!m_file.isOpen() || !m_file.seek(m_indexedSize)) {
+        return false;
+    }
+
+    QByteArray record = makeRecord(entry);
+
+    if (m_file.write(record) != record.size() || !m_file.flush()) {
+        return false;
+    }
+
+    addToIndex(entry, m_indexedSize, m_indexedSize + record.size());
+
+    m_indexedSize += record.size();
+    m_dirty = true;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::read(Conversation *conv)
+{
+    if (!m_file.isOpen() || !m_file.seek(LOG_HEADER_SIZE)) {
+        return false;
+    }
+
+    conv->clear();
+
+    Conversation::Entry entry;
+
+    while (m_file.pos() < m_indexedSize) {
+        if (!readRecord(entry)) {
+            return false;
+        }
+        conv->append(entry);
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::read(Conversation *conv, const QDate &date,
+                                     const QString &contact)
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+
+    conv->clear();
+
+    Conversation::Entry entry;
+
+    foreach (const Range &r, m_index.value(DateContact(date, contact))) {
+        if (!m_file.seek(r.begin)) {
+            return false;
+        }
+
+        while (m_file.pos() < r.end) {
+            if (!readRecord(entry)) {
+                return false;
+            }
+            conv->append(entry);
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QList<Lvk::Cmn::ConversationLog::DateContact> Lvk::Cmn::ConversationLog::dateContacts() const
+{
+    return m_index.keys();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::flush()
+{
+    if (!m_file.isOpen() || !m_dirty) {
+        return true;
+    }
+
+    QFile indexFile(m_indexFilename);
+
+    if (!indexFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCritical() << "ConversationLog: Cannot write index file" << m_indexFilename;
+        return false;
+    }
+
+    QDataStream ostream(&indexFile);
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << INDEX_MAGIC_NUMBER << m_indexedSize << (quint32)m_index.size();
+
+    for (Index::const_iterator it = m_index.constBegin(); it != m_index.constEnd(); ++it) {
+        ostream << it.key().first << it.key().second << (quint32)it.value().size();
+
+        foreach (const Range &r, it.value()) {
+            ostream << r.begin << r.end;
+        }
+    }
+
+    m_dirty = ostream.status() != QDataStream::Ok;
+
+    return !m_dirty;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationLog::importCsv(const QString &csvFilename, const QString &filename)
+{
+    if (!QFile::exists(csvFilename)) {
+        return false;
+    }
+
+    ConversationReader reader(csvFilename);
+    ConversationLog log(filename);
+
+    if (!log.isOpen()) {
+        return false;
+    }
+
+    Conversation::Entry entry;
+
+    while (!reader.atEnd() && reader.read(&entry)) {
+        if (!entry.isNull() && !log.append(entry)) {
+            return false;
+        }
+    }
+
+    return log.flush();
+}
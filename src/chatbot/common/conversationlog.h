@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_CONVERSATIONLOG_H
+#define LVK_CMN_CONVERSATIONLOG_H
+
+#include "common/conversation.h"
+
+#include <QFile>
+#include <QMap>
+#include <QPair>
+#include <QList>
+#include <QDate>
+#include <QString>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The ConversationLog class provides an append-only binary log of chat conversations.
+ *
+ * Entries are stored as length-prefixed binary records with epoch timestamps, hence reading
+ * does not require parsing text or dates. A sidecar index file with extension ".idx" maps each
+ * (date, contact) pair to the offset ranges of its entries, so entries of a given date and
+ * contact can be read without scanning the whole log. The contact of an entry is the
+ * Conversation::Entry::from field.
+ *
+ * The index is written by flush() and when the object is destroyed. If the index is missing or
+ * outdated, the missing part is rebuilt from the log when the file is opened.
+ *
+ * To convert logs in the CSV format written by ConversationWriter see importCsv().
+ */
+
+class ConversationLog
+{
+public:
+
+    /**
+     * Date-contact pair used as index key
+     */
+    typedef QPair<QDate, QString> DateContact;
+
+    /**
+     * Constructs a ConversationLog object that reads from and appends to the file with the given
+     * name. If the file does not exist, it is created.
+     */
+    ConversationLog(const QString &filename);
+
+    /**
+     * Destructs the ConversationLog object and writes the index file.
+     */
+    ~ConversationLog();
+
+    /**
+     * Returns true if the log file was successfully opened. Otherwise; returns false.
+     */
+    bool isOpen() const;
+
+    /**
+     * Appends \a entry to the log. Returns true on success; otherwise, returns false.
+     */
+    bool append(const Conversation::Entry &entry);
+
+    /**
+     * Reads all the entries of the log. The given pointer must be initialized.
+     * Returns true on success; otherwise, returns false.
+     */
+    bool read(Conversation *conv);
+
+    /**
+     * Reads the entries of the log with the given \a date and \a contact using the index.
+     * The given pointer must be initialized. Returns true on success; otherwise, returns false.
+     */
+    bool read(Conversation *conv, const QDate &date, const QString &contact);
+
+    /**
+     * Returns the list of all (date, contact) pairs in the log, sorted by date and contact.
+     */
+    QList<DateContact> dateContacts() const;
+
+    /**
+     * Writes the index file. Returns true on success; otherwise, returns false.
+     */
+    bool flush();
+
+    /**
+     * Imports the CSV conversation in \a csvFilename and appends it to the log \a filename.
+     * Returns true on success; otherwise, returns false.
+     */
+    static bool importCsv(const QString &csvFilename, const QString &filename);
+
+private:
+    ConversationLog(const ConversationLog&);
+    ConversationLog& operator=(const ConversationLog&);
+
+    struct Range
+    {
+        Range(qint64 begin = 0, qint64 end = 0) : begin(begin), end(end) { }
+
+        qint64 begin;
+        qint64 end;
+    };
+
+    typedef QMap<DateContact, QList<Range> > Index;
+
+    QFile m_file;
+    QString m_indexFilename;
+    Index m_index;
+    qint64 m_indexedSize;
+    bool m_dirty;
+
+    bool open();
+    bool loadIndex();
+    bool updateIndex();
+    void addToIndex(const Conversation::Entry &entry, qint64 begin, qint64 end);
+    bool readRecord(Conversation::Entry &entry);
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CMN_CONVERSATIONLOG_H
@@ -0,0 +1,681 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/conversationparquetwriter.h"
+#include "common/version.h"
+
+#include <QIODevice>
+#include <QFile>
+#include <QStack>
+#include <QtDebug>
+
+#include <zlib.h>
+
+#define PARQUET_MAGIC               "PAR1"
+#define DEFAULT_ROW_GROUP_SIZE      65536
+#define MAX_BIT_PACKED_GROUPS       63      // Groups of 8 values per bit-packed run
+#define CREATED_BY                  APP_NAME " version " APP_VERSION_STR
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Parquet format constants. See parquet.thrift in the Apache Parquet format specification.
+
+enum ParquetType { PT_BOOLEAN = 0, PT_INT64 = 2, PT_BYTE_ARRAY = 6 };
+
+enum ConvertedType { CT_NONE = -1, CT_UTF8 = 0, CT_TIMESTAMP_MILLIS = 9, CT_UINT_64 = 14 };
+
+enum Encoding { ENC_PLAIN = 0, ENC_PLAIN_DICTIONARY = 2, ENC_RLE = 3 };
+
+enum PageType { PAGE_DATA = 0, PAGE_DICTIONARY = 2 };
+
+enum { CODEC_GZIP = 2, REPETITION_REQUIRED = 0 };
+
+//--------------------------------------------------------------------------------------------------
+
+struct ColumnSchema
+{
+    const char *name;
+    int type;
+    int convertedType;
+};
+
+enum Column { COL_DATE_TIME, COL_FROM, COL_TO, COL_MSG, COL_RESPONSE, COL_MATCH, COL_RULE_ID,
+              COLUMN_COUNT };
+
+// Same order as the CSV written by ConversationWriter
+const ColumnSchema COLUMNS[COLUMN_COUNT] = {
+    { "date_time", PT_INT64,      CT_TIMESTAMP_MILLIS },
+    { "from",      PT_BYTE_ARRAY, CT_UTF8 },
+    { "to",        PT_BYTE_ARRAY, CT_UTF8 },
+    { "msg",       PT_BYTE_ARRAY, CT_UTF8 },
+    { "response",  PT_BYTE_ARRAY, CT_UTF8 },
+    { "match",     PT_BOOLEAN,    CT_NONE },
+    { "rule_id",   PT_INT64,      CT_UINT_64 },
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Writes structs with the Thrift compact protocol, which is used by the Parquet metadata
+class ThriftWriter
+{
+public:
+    enum Type { T_I32 = 5, T_I64 = 6, T_BINARY = 8, T_LIST = 9, T_STRUCT = 12 };
+
+    ThriftWriter(QByteArray &out) : m_out(out), m_lastId(0) { }
+
+    void beginStruct()
+    {
+        m_ids.push(m_lastId);
+        m_lastId = 0;
+    }
+
+    void endStruct()
+    {
+        m_out.append('\0');
+        m_lastId = m_ids.pop();
+    }
+
+    void i32Field(int id, qint32 value) { fieldHeader(id, T_I32); varint(zigzag(value)); }
+
+    void i64Field(int id, qint64 value) { fieldHeader(id, T_I64); varint(zigzag(value)); }
+
+    void binaryField(int id, const QByteArray &value) { fieldHeader(id, T_BINARY); binary(value); }
+
+    void structField(int id) { fieldHeader(id, T_STRUCT); beginStruct(); }
+
+    void listField(int id, Type elemType, int size)
+    {
+        fieldHeader(id, T_LIST);
+
+        if (size < 15) {
+            m_out.append(static_cast<char>((size << 4) | elemType));
+        } else {
+            m_out.append(static_cast<char>(0xF0 | elemType));
+            varint(size);
+        }
+    }
+
+    // List elements
+    void i32(qint32 value) { varint(zigzag(value)); }
+
+    void binary(const QByteArray &value)
+    {
+        varint(value.size());
+        m_out.append(value);
+    }
+
+    void raw(const QByteArray &data) { m_out.append(data); }
+
+private:
+    QByteArray &m_out;
+    int m_lastId;
+    QStack<int> m_ids;
+
+    static quint64 zigzag(qint64 value)
+    {
+        return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+    }
+
+    void varint(quint64 value)
+    {
+        while (value >= 0x80) {
+            m_out.append(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        m_out.append(static_cast<char>(value));
+    }
+
+    void fieldHeader(int id, Type type)
+    {
+        int delta = id - m_lastId;
+
+        if (delta > 0 && delta <= 15) {
+            m_out.append(static_cast<char>((delta << 4) | type));
+        } else {
+            m_out.append(static_cast<char>(type));
+            varint(zigzag(id));
+        }
+
+        m_lastId = id;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+inline void appendInt32(QByteArray &out, quint32 value)
+{
+    for (int i = 0; i < 4; ++i) {
+        out.append(static_cast<char>((value >> (8*i)) & 0xFF));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void appendInt64(QByteArray &out, quint64 value)
+{
+    for (int i = 0; i < 8; ++i) {
+        out.append(static_cast<char>((value >> (8*i)) & 0xFF));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+template<class T>
+QByteArray plainInt64(const QVector<T> &values)
+{
+    QByteArray out;
+    out.reserve(values.size()*8);
+
+    foreach (T value, values) {
+        appendInt64(out, static_cast<quint64>(value));
+    }
+
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray plainBooleans(const QVector<bool> &values)
+{
+    QByteArray out((values.size() + 7)/8, '\0');
+    char *data = out.data();
+
+    for (int i = 0; i < values.size(); ++i) {
+        if (values[i]) {
+            data[i/8] |= static_cast<char>(1 << (i % 8));
+        }
+    }
+
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray plainStrings(const QList<QByteArray> &values)
+{
+    QByteArray out;
+
+    foreach (const QByteArray &value, values) {
+        appendInt32(out, value.size());
+        out.append(value);
+    }
+
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Dictionary indices with the RLE/bit-packing hybrid encoding. Only bit-packed runs are used.
+QByteArray dictionaryIndices(const QVector<quint32> &ids, int dictSize)
+{
+    int bitWidth = 1;
+    while (bitWidth < 32 && (static_cast<quint32>(dictSize - 1) >> bitWidth) != 0) {
+        ++bitWidth;
+    }
+
+    QByteArray out;
+    out.append(static_cast<char>(bitWidth));
+
+    const int RUN_SIZE = MAX_BIT_PACKED_GROUPS*8;
+
+    for (int runStart = 0; runStart < ids.size(); runStart += RUN_SIZE) {
+        int groups = (qMin(RUN_SIZE, ids.size() - runStart) + 7)/8;
+
+        out.append(static_cast<char>((groups << 1) | 1)); // Fits in one varint byte
+
+        quint64 acc = 0;
+        int bits = 0;
+
+        // The last group is padded with zeros
+        for (int i = runStart; i < runStart + groups*8; ++i) {
+            acc |= static_cast<quint64>(i < ids.size() ? ids[i] : 0) << bits;
+            bits += bitWidth;
+
+            while (bits >= 8) {
+                out.append(static_cast<char>(acc & 0xFF));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+    }
+
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool gzipCompress(const QByteArray &source, QByteArray &dest)
+{
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+
+    // 15 + 16: Max window size with gzip header and trailer
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    dest.resize(deflateBound(&strm, source.size()));
+
+    strm.next_in = (Bytef *)source.constData();
+    strm.avail_in = source.size();
+    strm.next_out = (Bytef *)dest.data();
+    strm.avail_out = dest.size();
+
+    int ret = deflate(&strm, Z_FINISH);
+
+    dest.resize(ret == Z_STREAM_END ? strm.total_out : 0);
+
+    deflateEnd(&strm);
+
+    return ret == Z_STREAM_END;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void appendColumnChunk(QByteArray &chunks, const ColumnSchema &schema, qint64 valueCount,
+                       qint64 uncompressedSize, qint64 compressedSize, qint64 dataPageOffset,
+                       qint64 dictPageOffset = -1)
+{
+    bool dictionary = dictPageOffset >= 0;
+
+    ThriftWriter t(chunks);
+
+    t.beginStruct();                                        // ColumnChunk
+    t.i64Field(2, dictionary ? dictPageOffset : dataPageOffset);
+    t.structField(3);                                       // ColumnMetaData
+    t.i32Field(1, schema.type);
+    t.listField(2, ThriftWriter::T_I32, 2);
+    t.i32(dictionary ? ENC_PLAIN_DICTIONARY : ENC_PLAIN);
+    t.i32(ENC_RLE);
+    t.listField(3, ThriftWriter::T_BINARY, 1);
+    t.binary(schema.name);
+    t.i32Field(4, CODEC_GZIP);
+    t.i64Field(5, valueCount);
+    t.i64Field(6, uncompressedSize);
+    t.i64Field(7, compressedSize);
+    t.i64Field(9, dataPageOffset);
+    if (dictionary) {
+        t.i64Field(11, dictPageOffset);
+    }
+    t.endStruct();
+    t.endStruct();
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// ConversationParquetWriter
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::ConversationParquetWriter::ConversationParquetWriter(QIODevice *device)
+    : m_device(device), m_init(false), m_closed(false), m_ok(true),
+      m_rowGroupSize(DEFAULT_ROW_GROUP_SIZE), m_offset(0), m_entryCount(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::ConversationParquetWriter::ConversationParquetWriter(const QString &filename)
+    : m_device(new QFile(filename)), m_init(false), m_closed(false), m_ok(true),
+      m_rowGroupSize(DEFAULT_ROW_GROUP_SIZE), m_offset(0), m_entryCount(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::ConversationParquetWriter::~ConversationParquetWriter()
+{
+    close();
+
+    delete m_device;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::ConversationParquetWriter::setRowGroupSize(int rows)
+{
+    m_rowGroupSize = qMax(1, rows);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::ConversationParquetWriter::rowGroupSize() const
+{
+    return m_rowGroupSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Cmn::ConversationParquetWriter::entryCount() const
+{
+    return m_entryCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::write(const Conversation &conv)
+{
+    foreach (const Conversation::Entry &entry, conv.entries()) {
+        if (!write(entry)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::write(const Conversation::Entry &entry)
+{
+    if (m_closed || !init()) {
+        return false;
+    }
+
+    if (entry.isNull()) {
+        return true;
+    }
+
+    m_dateTimes.append(entry.dateTime.toMSecsSinceEpoch());
+    m_from.append(entry.from);
+    m_to.append(entry.to);
+    m_msg.append(entry.msg);
+    m_response.append(entry.response);
+    m_matches.append(entry.match);
+    m_ruleIds.append(entry.ruleId);
+
+    ++m_entryCount;
+
+    if (m_dateTimes.size() >= m_rowGroupSize) {
+        return flushRowGroup();
+    }
+
+    return m_ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::close()
+{
+    if (m_closed) {
+        return m_ok;
+    }
+
+    if (!init() || !flushRowGroup()) {
+        m_closed = true;
+        return false;
+    }
+
+    m_closed = true;
+
+    QByteArray meta;
+    ThriftWriter t(meta);
+
+    t.beginStruct();                                        // FileMetaData
+    t.i32Field(1, 1);
+    t.listField(2, ThriftWriter::T_STRUCT, COLUMN_COUNT + 1);
+    t.beginStruct();                                        // Root SchemaElement
+    t.binaryField(4, "conversation");
+    t.i32Field(5, COLUMN_COUNT);
+    t.endStruct();
+    for (int i = 0; i < COLUMN_COUNT; ++i) {
+        t.beginStruct();                                    // Column SchemaElement
+        t.i32Field(1, COLUMNS[i].type);
+        t.i32Field(3, REPETITION_REQUIRED);
+        t.binaryField(4, COLUMNS[i].name);
+        if (COLUMNS[i].convertedType != CT_NONE) {
+            t.i32Field(6, COLUMNS[i].convertedType);
+        }
+        t.endStruct();
+    }
+    t.i64Field(3, m_entryCount);
+    t.listField(4, ThriftWriter::T_STRUCT, m_rowGroups.size());
+    foreach (const QByteArray &rowGroup, m_rowGroups) {
+        t.raw(rowGroup);
+    }
+    t.binaryField(6, CREATED_BY);
+    t.endStruct();
+
+    QByteArray footer;
+    appendInt32(footer, meta.size());
+    footer.append(PARQUET_MAGIC);
+
+    m_ok = writeRaw(meta) && writeRaw(footer);
+
+    m_device->close();
+
+    return m_ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::init()
+{
+    if (!m_init) {
+        if (!m_device) {
+            return false;
+        }
+
+        if (m_device->isOpen() || m_device->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            m_init = true;
+            m_ok = writeRaw(PARQUET_MAGIC);
+        } else {
+            qCritical() << "ConversationParquetWriter: Cannot open IO device with write"
+                           " permissions";
+        }
+    }
+
+    return m_init && m_ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::flushRowGroup()
+{
+    int rows = m_dateTimes.size();
+
+    if (rows == 0 || !m_ok) {
+        return m_ok;
+    }
+
+    QByteArray chunks;
+    qint64 totalSize = 0;
+
+    m_ok = writePlainColumn(chunks, COL_DATE_TIME, plainInt64(m_dateTimes), totalSize)
+        && writeDictColumn(chunks, COL_FROM, m_from, totalSize)
+        && writeDictColumn(chunks, COL_TO, m_to, totalSize)
+        && writeDictColumn(chunks, COL_MSG, m_msg, totalSize)
+        && writeDictColumn(chunks, COL_RESPONSE, m_response, totalSize)
+        && writePlainColumn(chunks, COL_MATCH, plainBooleans(m_matches), totalSize)
+        && writePlainColumn(chunks, COL_RULE_ID, plainInt64(m_ruleIds), totalSize);
+
+    if (m_ok) {
+        QByteArray rowGroup;
+        ThriftWriter t(rowGroup);
+
+        t.beginStruct();                                    // RowGroup
+        t.listField(1, ThriftWriter::T_STRUCT, COLUMN_COUNT);
+        t.raw(chunks);
+        t.i64Field(2, totalSize);
+        t.i64Field(3, rows);
+        t.endStruct();
+
+        m_rowGroups.append(rowGroup);
+    }
+
+    m_dateTimes.clear();
+    m_from.clear();
+    m_to.clear();
+    m_msg.clear();
+    m_response.clear();
+    m_matches.clear();
+    m_ruleIds.clear();
+
+    return m_ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::writePlainColumn(QByteArray &chunks, int column,
+                                                           const QByteArray &values,
+                                                           qint64 &totalSize)
+{
+    int rows = m_dateTimes.size();
+    qint64 dataOffset = m_offset;
+    qint64 uncompressedSize = 0;
+    qint64 compressedSize = 0;
+
+    if (!writePage(PAGE_DATA, ENC_PLAIN, rows, values, uncompressedSize, compressedSize)) {
+        return false;
+    }
+
+    appendColumnChunk(chunks, COLUMNS[column], rows, uncompressedSize, compressedSize,
+                      dataOffset);
+
+    totalSize += uncompressedSize;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::writeDictColumn(QByteArray &chunks, int column,
+                                                          const StringColumn &values,
+                                                          qint64 &totalSize)
+{
+    int rows = values.ids.size();
+    qint64 dictOffset = m_offset;
+    qint64 uncompressedSize = 0;
+    qint64 compressedSize = 0;
+
+    if (!writePage(PAGE_DICTIONARY, ENC_PLAIN_DICTIONARY, values.values.size(),
+                   plainStrings(values.values), uncompressedSize, compressedSize)) {
+        return false;
+    }
+
+    qint64 dataOffset = m_offset;
+
+    if (!writePage(PAGE_DATA, ENC_PLAIN_DICTIONARY, rows,
+                   dictionaryIndices(values.ids, values.values.size()), uncompressedSize,
+                   compressedSize)) {
+        return false;
+    }
+
+    appendColumnChunk(chunks, COLUMNS[column], rows, uncompressedSize, compressedSize,
+                      dataOffset, dictOffset);
+
+    totalSize += uncompressedSize;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::writePage(int pageType, int encoding, int valueCount,
+                                                    const QByteArray &values,
+                                                    qint64 &uncompressedSize,
+                                                    qint64 &compressedSize)
+{
+    QByteArray compressed;
+
+    if (!gzipCompress(values, compressed)) {
+        qCritical() << "ConversationParquetWriter: Cannot compress page";
+        return false;
+    }
+
+    QByteArray header;
+    ThriftWriter t(header);
+
+    t.beginStruct();                                        // PageHeader
+    t.i32Field(1, pageType);
+    t.i32Field(2, values.size());
+    t.i32Field(3, compressed.size());
+    if (pageType == PAGE_DICTIONARY) {
+        t.structField(7);                                   // DictionaryPageHeader
+        t.i32Field(1, valueCount);
+        t.i32Field(2, encoding);
+        t.endStruct();
+    } else {
+        t.structField(5);                                   // DataPageHeader
+        t.i32Field(1, valueCount);
+        t.i32Field(2, encoding);
+        t.i32Field(3, ENC_RLE);                             // Definition levels
+        t.i32Field(4, ENC_RLE);                             // Repetition levels
+        t.endStruct();
+    }
+    t.endStruct();
+
+    uncompressedSize += header.size() + values.size();
+    compressedSize += header.size() + compressed.size();
+
+    return writeRaw(header) && writeRaw(compressed);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationParquetWriter::writeRaw(const QByteArray &data)
+{
+    if (m_device->write(data) != data.size()) {
+        qCritical() << "ConversationParquetWriter: Cannot write to IO device";
+        return false;
+    }
+
+    m_offset += data.size();
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// ConversationParquetWriter::StringColumn
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::ConversationParquetWriter::StringColumn::append(const QString &str)
+{
+    QHash<QString, quint32>::const_iterator it = index.constFind(str);
+
+    if (it != index.constEnd()) {
+        ids.append(it.value());
+    } else {
+        quint32 id = values.size();
+        index.insert(str, id);
+        values.append(str.toUtf8());
+        ids.append(id);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::ConversationParquetWriter::StringColumn::clear()
+{
+    index.clear();
+    values.clear();
+    ids.clear();
+}
+
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_CONVERSATIONPARQUETWRITER_H
+#define LVK_CMN_CONVERSATIONPARQUETWRITER_H
+
+#include "common/conversation.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+class QIODevice;
+class QString;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The ConversationParquetWriter class writes chat conversations in Apache Parquet format
+ *        for offline analytics.
+ *
+ * Unlike ConversationWriter, which writes CSV rows, entries are written as typed columns:
+ * <tt>date_time</tt> (timestamp in milliseconds), <tt>from</tt>, <tt>to</tt>, <tt>msg</tt>,
+ * <tt>response</tt> (dictionary-encoded UTF-8 strings), <tt>match</tt> (boolean) and
+ * <tt>rule_id</tt> (unsigned 64-bit integer). Pages are compressed with gzip.
+ *
+ * Entries are buffered in row groups of rowGroupSize() entries, so memory usage does not depend
+ * on the amount of entries written. The file footer is written by close(). A file that was not
+ * closed cannot be read.
+ */
+
+class ConversationParquetWriter
+{
+public:
+
+    /**
+     * Constructs a ConversationParquetWriter object using the given device.
+     * After construction class owns the pointer.
+     */
+    ConversationParquetWriter(QIODevice *device);
+
+    /**
+     * Constructs a ConversationParquetWriter object that will write to a file with the given
+     * name. The file is truncated.
+     */
+    ConversationParquetWriter(const QString &filename);
+
+    /**
+     * Closes the device and destructs the ConversationParquetWriter object.
+     */
+    ~ConversationParquetWriter();
+
+    /**
+     * Sets the max amount of entries per row group to \a rows. By default 65536.
+     */
+    void setRowGroupSize(int rows);
+
+    /**
+     * Returns the max amount of entries per row group.
+     */
+    int rowGroupSize() const;
+
+    /**
+     * Writes the given conversation. Returns true on success; otherwise returns false.
+     */
+    bool write(const Conversation &conv);
+
+    /**
+     * Writes the given conversation entry. Returns true on success; otherwise returns false.
+     */
+    bool write(const Conversation::Entry &entry);
+
+    /**
+     * Writes the buffered entries and the file footer. Entries cannot be written after calling
+     * this method. Returns true on success; otherwise returns false.
+     */
+    bool close();
+
+    /**
+     * Returns the amount of entries written so far.
+     */
+    qint64 entryCount() const;
+
+private:
+    ConversationParquetWriter(const ConversationParquetWriter&);
+    ConversationParquetWriter& operator=(const ConversationParquetWriter&);
+
+    struct StringColumn
+    {
+        QHash<QString, quint32> index;
+        QList<QByteArray> values;       // Dictionary
+        QVector<quint32> ids;           // Dictionary index of each entry
+
+        void append(const QString &str);
+        void clear();
+    };
+
+    QIODevice *m_device;
+    bool m_init;
+    bool m_closed;
+    bool m_ok;
+    int m_rowGroupSize;
+    qint64 m_offset;
+    qint64 m_entryCount;
+    QVector<qint64> m_dateTimes;
+    StringColumn m_from;
+    StringColumn m_to;
+    StringColumn m_msg;
+    StringColumn m_response;
+    QVector<bool> m_matches;
+    QVector<quint64> m_ruleIds;
+    QList<QByteArray> m_rowGroups;      // Serialized row group metadata
+
+    bool init();
+    bool flushRowGroup();
+    bool writePlainColumn(QByteArray &chunks, int column, const QByteArray &values,
+                          qint64 &totalSize);
+    bool writeDictColumn(QByteArray &chunks, int column, const StringColumn &values,
+                         qint64 &totalSize);
+    bool writePage(int pageType, int encoding, int valueCount, const QByteArray &values,
+                   qint64 &uncompressedSize, qint64 &compressedSize);
+    bool writeRaw(const QByteArray &data);
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CMN_CONVERSATIONPARQUETWRITER_H
+
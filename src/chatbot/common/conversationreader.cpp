@@ -21,13 +21,15 @@
 
 #include "common/conversationreader.h"
 #include "common/csvrow.h"
-#include "common/csvdocument.h"
 #include "common/globalstrings.h"
 
 #include <QIODevice>
 #include <QFile>
+#include <QDateTime>
 #include <QtDebug>
 
+#define CHUNK_SIZE      (64*1024)
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -47,27 +49,13 @@ void makeEntry(Lvk::Cmn::Conversation::Entry & entry, const Lvk::Cmn::CsvRow & r
         entry.response = row[4];
         entry.match    = row[5] == STR_CSV_CONV_ENTRY_MATCH ? true : false;
         entry.ruleId   = row[6].toULong();
+
+        entry.internParticipants();
     } else {
         qWarning() << "ConversationReader: Invalid format in row" << row.toString();
     }
 }
 
-//--------------------------------------------------------------------------------------------------
-
-void makeConversation(Lvk::Cmn::Conversation & conv, const Lvk::Cmn::CsvDocument & doc)
-{
-    conv.clear();
-
-    Lvk::Cmn::Conversation::Entry entry;
-
-    foreach (const Lvk::Cmn::CsvRow &row, doc.rows()) {
-        makeEntry(entry, row);
-        if (!entry.isNull()) {
-            conv.append(entry);
-        }
-    }
-}
-
 } // namespace
 
 //--------------------------------------------------------------------------------------------------
@@ -75,14 +63,14 @@ void makeConversation(Lvk::Cmn::Conversation & conv, const Lvk::Cmn::CsvDocument
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Cmn::ConversationReader::ConversationReader()
-    : m_device(0)
+    : m_device(0), m_bufferPos(0)
 {
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Cmn::ConversationReader::ConversationReader(const QString &filename)
-    : m_device(new QFile(filename))
+    : m_device(new QFile(filename)), m_bufferPos(0)
 {
     qDebug() << "ConversationReader: Opening" << filename;
 
@@ -94,7 +82,7 @@ Lvk::Cmn::ConversationReader::ConversationReader(const QString &filename)
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Cmn::ConversationReader::ConversationReader(QIODevice *device)
-    : m_device(device)
+    : m_device(device), m_bufferPos(0)
 {
     if (!m_device->isOpen()) {
         if (!m_device->open(QIODevice::ReadOnly)) {
@@ -113,16 +101,40 @@ Lvk::Cmn::ConversationReader::~ConversationReader()
 //--------------------------------------------------------------------------------------------------
 
 bool Lvk::Cmn::ConversationReader::read(Lvk::Cmn::Conversation *conv)
+{
+    return read(conv, QDateTime(), QDateTime());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationReader::read(Lvk::Cmn::Conversation *conv, const QDateTime &from,
+                                        const QDateTime &to)
 {
     if (!m_device) {
         return false;
     }
 
-    // TODO use readLine()
-    QString data = QString::fromUtf8(m_device->readAll().constData());
+    conv->clear();
+
+    Conversation::Entry entry;
+    QByteArray row;
+
+    while (readRow(row)) {
+        if (row.isEmpty()) {
+            continue;
+        }
+
+        makeEntry(entry, Cmn::CsvRow(QString::fromUtf8(row.constData(), row.size())));
 
-    Cmn::CsvDocument doc(data);
-    makeConversation(*conv, doc);
+        if (entry.isNull() || (from.isValid() && entry.dateTime < from)) {
+            continue;
+        }
+        if (to.isValid() && entry.dateTime >= to) {
+            break;
+        }
+
+        conv->append(entry);
+    }
 
     return true;
 }
@@ -135,20 +147,46 @@ bool Lvk::Cmn::ConversationReader::read(Conversation::Entry *entry)
         return false;
     }
 
-    char buf[10*1024];
-    qint64 len = m_device->readLine(buf, sizeof(buf));
+    QByteArray row;
 
-    if (len != -1) {
-        Cmn::CsvRow row(QString::fromUtf8(buf));
-        makeEntry(*entry, row);
+    if (!readRow(row)) {
+        return false;
     }
 
-    return len != -1;
+    makeEntry(*entry, Cmn::CsvRow(QString::fromUtf8(row.constData(), row.size())));
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::ConversationReader::readRow(QByteArray &row)
+{
+    row.clear();
+
+    forever {
+        int eol = m_buffer.indexOf('\n', m_bufferPos);
+
+        if (eol != -1) {
+            row.append(m_buffer.constData() + m_bufferPos, eol - m_bufferPos);
+            m_bufferPos = eol + 1;
+            return true;
+        }
+
+        row.append(m_buffer.constData() + m_bufferPos, m_buffer.size() - m_bufferPos);
+
+        m_buffer = m_device->read(CHUNK_SIZE);
+        m_bufferPos = 0;
+
+        if (m_buffer.isEmpty()) {
+            return !row.isEmpty();
+        }
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
 bool Lvk::Cmn::ConversationReader::atEnd()
 {
-    return !m_device || m_device->atEnd();
+    return !m_device || (m_bufferPos >= m_buffer.size() && m_device->atEnd());
 }
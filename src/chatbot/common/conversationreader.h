@@ -24,8 +24,11 @@
 
 #include "common/conversation.h"
 
+#include <QByteArray>
+
 class QIODevice;
 class QString;
+class QDateTime;
 
 namespace Lvk
 {
@@ -44,6 +47,9 @@ namespace Cmn
  * \brief The ConversationReader class provides a format independent interface for reading
  *        chat conversations from files or other devices.
  *
+ * The device is read in fixed-size chunks, hence entries can be read one by one or within a
+ * time window without loading the whole device in memory.
+ *
  * To write a conversation see ConversationWriter class.
  */
 
@@ -78,6 +84,14 @@ public:
      */
     bool read(Conversation *conv);
 
+    /**
+     * Reads the entries of the chat conversation with date time between \a from (inclusive) and
+     * \a to (exclusive). A null \a from or \a to means no lower or upper bound respectively.
+     * The given pointer must be initialized. Entries must be sorted by date time.
+     * Returns true on success; otherwise, returns false.
+     */
+    bool read(Conversation *conv, const QDateTime &from, const QDateTime &to);
+
     /**
      * Reads the next conversation entry from the device. The given pointer must be initialized.
      * Returns true on success; otherwise, returns false.
@@ -95,6 +109,10 @@ private:
     ConversationReader& operator=(const ConversationReader&);
 
     QIODevice *m_device;
+    QByteArray m_buffer;
+    int m_bufferPos;
+
+    bool readRow(QByteArray &row);
 };
 
 /// @}
@@ -23,6 +23,7 @@
 #include "common/csvrow.h"
 #include "common/csvdocument.h"
 #include "common/globalstrings.h"
+#include "common/journal.h"
 
 #include <QIODevice>
 #include <QFile>
@@ -102,6 +103,10 @@ Lvk::Cmn::ConversationWriter::ConversationWriter(QIODevice *device)
 
 Lvk::Cmn::ConversationWriter::~ConversationWriter()
 {
+    if (m_device) {
+        Cmn::Journal::journal()->flush(m_device);
+    }
+
     delete m_device;
 }
 
@@ -116,6 +121,9 @@ bool Lvk::Cmn::ConversationWriter::write(const Lvk::Cmn::Conversation &conv)
     Cmn::CsvDocument doc;
     makeCsvDoc(doc, conv);
 
+    // Entries written before must not be reordered
+    Cmn::Journal::journal()->flush(m_device);
+
     return writeln(doc.toString().toUtf8()) && flush();
 }
 
@@ -130,7 +138,10 @@ bool Lvk::Cmn::ConversationWriter::write(const Conversation::Entry &entry)
     Cmn::CsvRow row;
     makeCsvRow(row, entry);
 
-    return writeln(row.toString().toUtf8()) && flush();
+    // Entries are written and flushed in batches by the journal
+    Cmn::Journal::journal()->write(m_device, row.toString().toUtf8() + "\n");
+
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -49,6 +49,9 @@ namespace Cmn
  * conversations to files or other devices. By default the device or file is opened in append mode.
  * To not use default append mode you must provide a device already opened with the desired flags.
  *
+ * Entries are written in batches through the Journal class. Whole conversations are written
+ * immediately.
+ *
  * To read a conversation see the ConversationReader class.
  */
 
@@ -23,6 +23,7 @@
 #include "common/settings.h"
 #include "common/settingskeys.h"
 #include "common/version.h"
+#include "common/logger.h"
 #include "da-server/remoteloggerfactory.h"
 
 #include <csignal>
@@ -65,7 +66,7 @@ QString Lvk::Cmn::CrashHandler::m_username = "";
 
 void Lvk::Cmn::CrashHandler::init()
 {
-    m_crashFilename = Cmn::Settings().value(SETTING_LOGS_PATH).toString() + "/crash.log";
+    m_crashFilename = Cmn::SettingsSnapshot::current().stringValue(SETTING_LOGS_PATH) + "/crash.log";
 
     checkForCrash();
 
@@ -77,6 +78,9 @@ void Lvk::Cmn::CrashHandler::init()
 
 void Lvk::Cmn::CrashHandler::handler(int sig)
 {
+    // Write pending log messages before anything else can fail
+    Cmn::Logger::flush();
+
     QFile file(m_crashFilename);
 
     if (file.open(QFile::WriteOnly)) {
@@ -20,6 +20,7 @@
  */
 
 #include "common/csvdocument.h"
+#include "common/csvparser.h"
 
 #include <QString>
 #include <QStringList>
@@ -39,6 +40,32 @@ void sanitize(QString &s)
     s.replace(EOL, " ");
 }
 
+//--------------------------------------------------------------------------------------------------
+
+// Appends each parsed row to the document
+class DocumentHandler : public Lvk::Cmn::CsvParser::Handler
+{
+public:
+    DocumentHandler(Lvk::Cmn::CsvDocument &doc)
+        : m_doc(doc) { }
+
+    virtual bool row(const QVector<QStringRef> &cells)
+    {
+        Lvk::Cmn::CsvRow row;
+
+        foreach (const QStringRef &cell, cells) {
+            row.append(cell.toString());
+        }
+
+        m_doc.append(row);
+
+        return true;
+    }
+
+private:
+    Lvk::Cmn::CsvDocument &m_doc;
+};
+
 } // namespace
 
 
@@ -67,11 +94,9 @@ void Lvk::Cmn::CsvDocument::parseString(const QString &csvStr)
         return;
     }
 
-    QStringList rows = csvStr.split(EOL, QString::SkipEmptyParts);
+    DocumentHandler handler(*this);
 
-    foreach (const QString &row, rows) {
-        append(row);
-    }
+    CsvParser::parse(csvStr, handler);
 }
 
 //--------------------------------------------------------------------------------------------------
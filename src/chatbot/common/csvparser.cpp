@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/csvparser.h"
+
+#include <QStringList>
+
+#define QUOTE   "\""
+#define COMMA   ","
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+//--------------------------------------------------------------------------------------------------
+
+void unescape(QString &s)
+{
+    if (s.size() >= 2 && s.startsWith(QUOTE) && s.endsWith(QUOTE)) {
+        s = s.mid(1, s.size() - 2);
+
+        s.replace(QUOTE QUOTE, QUOTE);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool hasStartQuote(QString &s)
+{
+    return s.startsWith(QUOTE);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool hasEndQuote(QString &s)
+{
+    return s.endsWith(QUOTE) && (!s.endsWith(QUOTE QUOTE) || s.size() == 2);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool isAllSpace(const QChar *begin, const QChar *end)
+{
+    for (const QChar *c = begin; c != end; ++c) {
+        if (!c->isSpace()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Parses a row as CsvRow did before, used for malformed quoted cells
+void parseRowFallback(const QString &row, QVector<QStringRef> &cells, QString &scratch)
+{
+    QStringList splitted = row.split(COMMA);
+
+    for (int i = 0; i < splitted.size(); ++i) {
+        QString cell = splitted[i];
+
+        // Check if we splitted up a scaped comma
+        if (hasStartQuote(cell) && !hasEndQuote(cell)) {
+            // Join cells until we find the end quote
+            while (i+1 < splitted.size() && !hasEndQuote(cell)) {
+                cell += COMMA;
+                cell += splitted[++i];
+            }
+        }
+
+        unescape(cell);
+
+        cells.append(QStringRef(&scratch, scratch.size(), cell.size()));
+        scratch.append(cell);
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// CsvParser
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::CsvParser::parseRow(const QString &str, int begin, int end,
+                                   QVector<QStringRef> &cells, QString &scratch)
+{
+    cells.clear();
+    scratch.truncate(0);
+
+    const QChar *data = str.unicode();
+
+    if (isAllSpace(data + begin, data + end)) {
+        return;
+    }
+
+    const QChar quote('"');
+    const QChar comma(',');
+
+    int i = begin;
+
+    forever {
+        if (i < end && data[i] == quote) {
+            // Quoted cell. Look for the end quote skipping escaped quotes
+            int start = i + 1;
+            int j = start;
+            bool escaped = false;
+
+            for (; j < end; ++j) {
+                if (data[j] == quote) {
+                    if (j + 1 < end && data[j + 1] == quote) {
+                        escaped = true;
+                        ++j;
+                    } else {
+                        break;
+                    }
+                }
+            }
+
+            if (j >= end || (j + 1 < end && data[j + 1] != comma)) {
+                cells.clear();
+                scratch.truncate(0);
+                parseRowFallback(str.mid(begin, end - begin), cells, scratch);
+                return;
+            }
+
+            if (escaped) {
+                int pos = scratch.size();
+                for (int k = start; k < j; ++k) {
+                    scratch.append(data[k]);
+                    if (data[k] == quote) {
+                        ++k;
+                    }
+                }
+                cells.append(QStringRef(&scratch, pos, scratch.size() - pos));
+            } else {
+                cells.append(QStringRef(&str, start, j - start));
+            }
+
+            i = j + 1;
+        } else {
+            int j = i;
+            while (j < end && data[j] != comma) {
+                ++j;
+            }
+
+            cells.append(QStringRef(&str, i, j - i));
+
+            i = j;
+        }
+
+        if (i >= end) {
+            break;
+        }
+
+        ++i; // skip comma
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::CsvParser::parse(const QString &str, Handler &handler)
+{
+    QVector<QStringRef> cells;
+    QString scratch;
+
+    int begin = 0;
+
+    while (begin < str.size()) {
+        int end = str.indexOf('\n', begin);
+        if (end == -1) {
+            end = str.size();
+        }
+
+        if (end > begin) {
+            parseRow(str, begin, end, cells, scratch);
+            if (!handler.row(cells)) {
+                break;
+            }
+        }
+
+        begin = end + 1;
+    }
+}
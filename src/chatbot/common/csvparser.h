@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_CSVPARSER_H
+#define LVK_CMN_CSVPARSER_H
+
+#include <QString>
+#include <QStringRef>
+#include <QVector>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The CsvParser class provides a single-pass CSV tokenizer.
+ *
+ * The CsvParser class walks the CSV string once. Cells are returned as references to the
+ * source string. Only cells with escaped quotes are copied, to a scratch string owned by the
+ * caller. Rows are separated with the new line '\n' and cells with the comma character ','.
+ *
+ * Rows with malformed quoted cells are parsed as CsvRow did before, i.e. splitting on commas
+ * and joining cells until the end quote is found.
+ *
+ * \see CsvRow, CsvDocument
+ */
+
+class CsvParser
+{
+public:
+
+    /**
+     * The Handler class provides an interface to receive rows while parsing a document.
+     */
+    class Handler
+    {
+    public:
+
+        /**
+         * Destroys the handler
+         */
+        virtual ~Handler() { }
+
+        /**
+         * Handles a new row with \a cells. References are only valid until this method returns.
+         * Returns true to continue parsing. Otherwise; returns false.
+         */
+        virtual bool row(const QVector<QStringRef> &cells) = 0;
+    };
+
+    /**
+     * Parses the row in the range [\a begin, \a end) of \a str. Cells are appended to \a cells,
+     * which is cleared first. \a scratch holds unescaped cells, hence it must outlive \a cells.
+     * If the row is empty or has only spaces, \a cells is empty.
+     */
+    static void parseRow(const QString &str, int begin, int end, QVector<QStringRef> &cells,
+                         QString &scratch);
+
+    /**
+     * Parses the document \a str and invokes \a handler for each row. Empty rows are skipped.
+     */
+    static void parse(const QString &str, Handler &handler);
+
+private:
+    CsvParser();
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_CMN_CSVPARSER_H
@@ -20,8 +20,10 @@
  */
 
 #include "common/csvrow.h"
+#include "common/csvparser.h"
 
 #include <QStringList>
+#include <QVector>
 
 #define QUOTE   "\""
 #define COMMA   ","
@@ -45,43 +47,6 @@ void escape(QString &s)
     }
 }
 
-//--------------------------------------------------------------------------------------------------
-
-void unescape(QString &s)
-{
-    if (s.size() >= 2 && s.startsWith(QUOTE) && s.endsWith(QUOTE)) {
-        s = s.mid(1, s.size() - 2);
-
-        s.replace(QUOTE QUOTE, QUOTE);
-    }
-}
-
-//--------------------------------------------------------------------------------------------------
-
-bool hasStartQuote(QString &s)
-{
-    return s.startsWith(QUOTE);
-}
-
-//--------------------------------------------------------------------------------------------------
-
-bool hasEndQuote(QString &s)
-{
-    return s.endsWith(QUOTE) && (!s.endsWith(QUOTE QUOTE) || s.size() == 2);
-}
-
-//--------------------------------------------------------------------------------------------------
-
-bool isAllSpace(const QString &s)
-{
-    for (int i = 0; i < s.size(); ++i) {
-        if (!s[i].isSpace()) {
-            return false;
-        }
-    }
-    return true;
-}
-
 } // namespace
 
 
@@ -124,26 +89,13 @@ void Lvk::Cmn::CsvRow::parseString(const QString &str)
 {
     clear();
 
-    if (isAllSpace(str)) {
-        return;
-    }
-
-    QStringList cells = str.split(COMMA);
+    QVector<QStringRef> cells;
+    QString scratch;
 
-    for (int i = 0; i < cells.size(); ++i) {
-        QString &cell = cells[i];
+    CsvParser::parseRow(str, 0, str.size(), cells, scratch);
 
-        // Check if we splitted up a scaped comma
-        if (hasStartQuote(cell) && !hasEndQuote(cell)) {
-            // Join cells until we find the end quote
-            while (i+1 < cells.size() && !hasEndQuote(cell)) {
-                cell += COMMA;
-                cell += cells[++i];
-            }
-        }
-
-        unescape(cell);
-        append(cell);
+    foreach (const QStringRef &cell, cells) {
+        append(cell.toString());
     }
 }
 
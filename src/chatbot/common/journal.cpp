@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/journal.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QCoreApplication>
+#include <QIODevice>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtDebug>
+
+#ifdef Q_OS_WIN
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
+#define SYNC_INTERVAL   1000    // In milliseconds
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+inline bool flushDevice(QIODevice *device, bool sync)
+{
+    // flush() is not part of QIODevice interface. We only flush if it's type QFile.
+
+    QFile *file = dynamic_cast<QFile *>(device);
+
+    if (!file) {
+        return true;
+    }
+
+    if (!file->flush()) {
+        return false;
+    }
+
+    if (sync) {
+#ifdef Q_OS_WIN
+        return _commit(file->handle()) == 0;
+#else
+        return ::fsync(file->handle()) == 0;
+#endif
+    }
+
+    return true;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Journal
+//--------------------------------------------------------------------------------------------------
+
+QAtomicPointer<Lvk::Cmn::Journal> Lvk::Cmn::Journal::m_journal;
+QMutex *                          Lvk::Cmn::Journal::m_jrnlMutex = new QMutex();
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Journal::Journal()
+    : m_mutex(new QMutex()),
+      m_pendingEntries(0),
+      m_timer(this)
+{
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+    m_maxDelay = settings.value(SETTING_JOURNAL_MAX_DELAY).toInt();
+    m_maxEntries = settings.value(SETTING_JOURNAL_MAX_ENTRIES).toInt();
+    m_syncPolicy = static_cast<SyncPolicy>(settings.value(SETTING_JOURNAL_SYNC_POLICY).toInt());
+
+    m_timer.setSingleShot(true);
+    m_firstPending.invalidate();
+    m_lastSync.start();
+
+    connect(&m_timer, SIGNAL(timeout()), SLOT(onTimeout()));
+
+    // The first caller can be a worker thread without event loop. The timer is a child, so it
+    // moves too.
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Journal::~Journal()
+{
+    drain();
+
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Journal * Lvk::Cmn::Journal::journal()
+{
+    Journal *journal = m_journal.fetchAndAddAcquire(0);
+
+    if (!journal) {
+        QMutexLocker locker(m_jrnlMutex);
+
+        journal = m_journal.fetchAndAddAcquire(0);
+
+        if (!journal) {
+            // Never deleted, writers may still use it while the application shuts down
+            journal = new Journal();
+            m_journal.fetchAndStoreRelease(journal);
+
+            qAddPostRoutine(shutdown);
+        }
+    }
+
+    return journal;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Called by the QCoreApplication destructor in the application thread
+void Lvk::Cmn::Journal::shutdown()
+{
+    Journal *journal = m_journal.fetchAndAddAcquire(0);
+
+    QMutexLocker locker(journal->m_mutex);
+
+    journal->m_timer.stop();
+    journal->m_maxDelay = 0;
+    journal->writeAllPending();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Journal::write(QIODevice *device, const QByteArray &data)
+{
+    QMutexLocker locker(m_mutex);
+
+    if (!m_pending.contains(device)) {
+        m_devices.append(device);
+    }
+
+    m_pending[device].append(data);
+
+    if (m_syncPolicy == EveryEntrySync || m_maxDelay <= 0 || ++m_pendingEntries >= m_maxEntries
+            || (m_firstPending.isValid() && m_firstPending.elapsed() >= m_maxDelay)) {
+        writeAllPending();
+    } else if (!m_firstPending.isValid()) {
+        m_firstPending.start();
+
+        // The timer must be started in the journal thread
+        QMetaObject::invokeMethod(this, "scheduleFlush", Qt::QueuedConnection);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Journal::flush(QIODevice *device)
+{
+    QMutexLocker locker(m_mutex);
+
+    return writePending(device, m_syncPolicy != NoSync);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Journal::drain()
+{
+    QMutexLocker locker(m_mutex);
+
+    return writeAllPending();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Journal::setMaxDelay(int msecs)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_maxDelay = msecs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Journal::setMaxEntries(int n)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_maxEntries = n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Journal::setSyncPolicy(SyncPolicy policy)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_syncPolicy = policy;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Journal::scheduleFlush()
+{
+    QMutexLocker locker(m_mutex);
+
+    if (m_firstPending.isValid() && !m_timer.isActive()) {
+        m_timer.start(qMax(0, m_maxDelay - (int)m_firstPending.elapsed()));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Journal::onTimeout()
+{
+    QMutexLocker locker(m_mutex);
+
+    writeAllPending();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Journal::writePending(QIODevice *device, bool sync)
+{
+    QHash<QIODevice *, QByteArray>::iterator it = m_pending.find(device);
+
+    if (it == m_pending.end()) {
+        return true;
+    }
+
+    bool success = device->write(*it) == it->size() && flushDevice(device, sync);
+
+    if (!success) {
+        qCritical() << "Journal: Cannot write pending data to device";
+    }
+
+    m_pending.erase(it);
+    m_devices.removeOne(device);
+
+    if (m_pending.isEmpty()) {
+        m_pendingEntries = 0;
+        m_firstPending.invalidate();
+    }
+
+    return success;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Journal::writeAllPending()
+{
+    bool sync = m_syncPolicy == EveryEntrySync
+            || (m_syncPolicy == IntervalSync && m_lastSync.elapsed() >= SYNC_INTERVAL);
+
+    bool success = true;
+
+    // Devices are written in the same order they were first used
+    while (!m_devices.isEmpty()) {
+        success &= writePending(m_devices.first(), sync);
+    }
+
+    if (sync) {
+        m_lastSync.restart();
+    }
+
+    return success;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_JOURNAL_H
+#define LVK_CMN_JOURNAL_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QAtomicPointer>
+
+class QIODevice;
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The Journal class provides a singleton write-behind journal for append-only files.
+ *
+ * Instead of writing and flushing each entry, writers append their serialized entries to the
+ * journal. Pending entries are written in a single batch after a maximum delay or when the
+ * maximum amount of pending entries is reached, whichever comes first. Files are synced to
+ * disk according to the sync policy.
+ *
+ * Writers must call flush() with their device before closing or destroying it. drain() writes
+ * all pending entries and must be called on shutdown.
+ *
+ * The journal lives in the thread of the application object, whose event loop runs the delayed
+ * writes. When the application object is destroyed, pending entries are written and later
+ * entries are written immediately.
+ *
+ * This class is thread-safe.
+ */
+class Journal : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Sync policies
+     */
+    enum SyncPolicy
+    {
+        NoSync,           ///< Data is flushed but not synced to disk
+        IntervalSync,     ///< Data is synced to disk at most once per second
+        EveryEntrySync    ///< Every entry is written and synced to disk immediately
+    };
+
+    /**
+     * Returns the singleton instance.
+     */
+    static Journal *journal();
+
+    /**
+     * Appends \a data to be written to \a device. \a device must be open.
+     */
+    void write(QIODevice *device, const QByteArray &data);
+
+    /**
+     * Writes all pending data of \a device. Returns true on success; otherwise, returns false.
+     */
+    bool flush(QIODevice *device);
+
+    /**
+     * Writes all pending data of all devices. Returns true on success; otherwise, returns false.
+     */
+    bool drain();
+
+    /**
+     * Sets the maximum delay in milliseconds before pending entries are written.
+     * If \a msecs is zero entries are written immediately.
+     */
+    void setMaxDelay(int msecs);
+
+    /**
+     * Sets the maximum amount of pending entries.
+     */
+    void setMaxEntries(int n);
+
+    /**
+     * Sets the sync policy.
+     */
+    void setSyncPolicy(SyncPolicy policy);
+
+private slots:
+    void scheduleFlush();
+    void onTimeout();
+
+private:
+    Journal();
+    ~Journal();
+    Journal(const Journal&);
+    Journal& operator=(const Journal&);
+
+    static void shutdown();
+
+    static QAtomicPointer<Journal> m_journal;
+    static QMutex *m_jrnlMutex;
+
+    QMutex *m_mutex;
+    QHash<QIODevice *, QByteArray> m_pending;
+    QList<QIODevice *> m_devices;
+    int m_pendingEntries;
+    int m_maxDelay;
+    int m_maxEntries;
+    SyncPolicy m_syncPolicy;
+    QElapsedTimer m_firstPending;
+    QElapsedTimer m_lastSync;
+    QTimer m_timer;
+
+    bool writePending(QIODevice *device, bool sync);
+    bool writeAllPending();
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CMN_JOURNAL_H
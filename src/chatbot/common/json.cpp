@@ -19,158 +19,1026 @@
  *
  */
 
-#include "json.h"
+#include "common/json.h"
 
+#include <QStringList>
 #include <QtDebug>
 
+#include <cstring>
+
+#define JSON_MAX_DEPTH      64      // Maximum nesting of objects and arrays
+
 //--------------------------------------------------------------------------------------------------
-// Json
+// Helpers
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Cmn::Json::parse(const QString &json, Json::Object &obj)
+namespace
+{
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool isDigit(char c)
 {
-    return parseObject(json, obj);
+    return c >= '0' && c <= '9';
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Cmn::Json::parseObject(const QString &json, Json::Object &obj)
+inline int hexValue(char c)
 {
-    QString parsed;
-    if (removeBraces(json, parsed)) {
-        return parseKeyValues(parsed, obj);
-    } else {
-        return false;
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
     }
+    return -1;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Cmn::Json::removeBraces(const QString &json, QString &parsed)
+// Returns the value of the 4 hex digits in s, or -1 if any of them is not a hex digit
+inline int hex4(const char *s)
 {
-    QString tmp = json.trimmed();
-    if (tmp.size() >= 2 && tmp[0] == '{' && tmp[tmp.size() - 1] == '}') {
-        parsed = tmp.mid(1, tmp.size() - 2);
-        return true;
-    } else {
-        return false;
+    int code = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        int v = hexValue(s[i]);
+        if (v == -1) {
+            return -1;
+        }
+        code = code*16 + v;
     }
+
+    return code;
 }
 
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// JsonReader
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Cmn::Json::parseKeyValues(const QString &keyvalues, Json::Object &obj)
+Lvk::Cmn::JsonReader::JsonReader(const QByteArray &data)
+    : m_data(data),
+      m_pos(0),
+      m_token(NoToken),
+      m_expected(ExpectValue),
+      m_start(0),
+      m_size(0),
+      m_escaped(false),
+      m_number(0),
+      m_bool(false)
 {
-    enum {
-        SearchingKey,
-        ParsingKey,
-        SearchingColon,
-        SearchingValue,
-        ParsingStringValue,
-        ParsingDoubleValue,
-        // TODO ParsingNestedObjectValue,
-        // TODO ParsingListValue,
-        SearchingComma
-    } stage = SearchingKey;
+}
 
-    QString key;
-    QString value;
-    QChar cc; // current char
-    QChar pc; // previous char
-    bool err = false;
+//--------------------------------------------------------------------------------------------------
 
-    for (int i = 0; i < keyvalues.size() && !err; ++i) {
-        cc = keyvalues[i];
-        pc = i > 0 ? keyvalues[i - 1] : '\0';
+Lvk::Cmn::JsonReader::TokenType Lvk::Cmn::JsonReader::readNext()
+{
+    if (m_token == Invalid || m_token == EndDocument) {
+        return m_token;
+    }
 
-        switch (stage) {
-        case SearchingKey:
-            if (cc.isSpace()) {
-                // nothing to do
-            } else if (cc == '"') {
-                stage = ParsingKey;
-            } else {
-                err = true;
-            }
+    skipSpaces();
+
+    if (m_pos == m_data.size()) {
+        return setToken(m_expected == ExpectEnd ? EndDocument : Invalid);
+    }
+
+    char c = m_data.constData()[m_pos];
+
+    switch (m_expected) {
+    case ExpectEnd:
+        return setToken(Invalid);
+
+    case ExpectKeyOrEnd:
+        if (c == '}') {
+            return endContainer('{', EndObject);
+        }
+        // fall through
+    case ExpectKey:
+        if (c != '"' || readString(Key) == Invalid) {
+            return setToken(Invalid);
+        }
+
+        skipSpaces();
+
+        if (m_pos == m_data.size() || m_data.constData()[m_pos] != ':') {
+            return setToken(Invalid);
+        }
+
+        ++m_pos;
+        m_expected = ExpectValue;
+        return m_token;
+
+    case ExpectValueOrEnd:
+        if (c == ']') {
+            return endContainer('[', EndArray);
+        }
+        // fall through
+    case ExpectValue:
+        return readValue();
+
+    case ExpectSeparator:
+        if (c == ',') {
+            ++m_pos;
+            m_expected = m_stack[m_stack.size() - 1] == '{' ? ExpectKey : ExpectValue;
+            return readNext();
+        } else if (c == '}') {
+            return endContainer('{', EndObject);
+        } else if (c == ']') {
+            return endContainer('[', EndArray);
+        }
+        return setToken(Invalid);
+    }
+
+    return setToken(Invalid);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::JsonReader::skipValue()
+{
+    if (m_token == Key) {
+        readNext();
+    }
+
+    if (m_token != BeginObject && m_token != BeginArray) {
+        return !hasError() && m_token != EndDocument;
+    }
+
+    int depth = m_stack.size();
+
+    for (;;) {
+        TokenType type = readNext();
+
+        if (type == Invalid || type == EndDocument) {
+            return false;
+        }
+        if ((type == EndObject || type == EndArray) && m_stack.size() < depth) {
+            return true;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Cmn::JsonReader::stringValue() const
+{
+    const char *p = m_data.constData() + m_start;
+
+    if (!m_escaped) {
+        return QString::fromUtf8(p, m_size);
+    }
+
+    // Escape sequences were validated while reading the string
+
+    const char *end = p + m_size;
+    const char *run = p;
+    QString str;
+    str.reserve(m_size);
+
+    while (p != end) {
+        if (*p != '\\') {
+            ++p;
+            continue;
+        }
+
+        str += QString::fromUtf8(run, p - run);
+
+        switch (p[1]) {
+        case 'n': str += QChar('\n'); break;
+        case 'r': str += QChar('\r'); break;
+        case 't': str += QChar('\t'); break;
+        case 'b': str += QChar('\b'); break;
+        case 'f': str += QChar('\f'); break;
+        case 'u':
+            str += QChar(static_cast<ushort>(hex4(p + 2)));
+            p += 4;
+            break;
+        default:
+            str += QChar(p[1]); // quotes, backslashes and slashes
             break;
+        }
+
+        p += 2;
+        run = p;
+    }
+
+    str += QString::fromUtf8(run, end - run);
+
+    return str;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::JsonReader::errorOffset() const
+{
+    return hasError() ? m_pos : -1;
+}
 
-        case ParsingKey:
-            if (cc == '"') {
-                if (key.size() > 0) {
-                    stage = SearchingColon;
-                } else {
-                    err = true;
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::JsonReader::TokenType Lvk::Cmn::JsonReader::readValue()
+{
+    char c = m_data.constData()[m_pos];
+
+    switch (c) {
+    case '{':
+    case '[':
+        if (m_stack.size() == JSON_MAX_DEPTH) {
+            return setToken(Invalid);
+        }
+        ++m_pos;
+        m_stack.append(c);
+        m_expected = c == '{' ? ExpectKeyOrEnd : ExpectValueOrEnd;
+        return setToken(c == '{' ? BeginObject : BeginArray);
+
+    case '"':
+        return readString(String);
+
+    case 't':
+        return readLiteral("true", Bool, true);
+
+    case 'f':
+        return readLiteral("false", Bool, false);
+
+    case 'n':
+        return readLiteral("null", Null, false);
+
+    default:
+        return c == '-' || isDigit(c) ? readNumber() : setToken(Invalid);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::JsonReader::TokenType Lvk::Cmn::JsonReader::readString(TokenType type)
+{
+    const char *data = m_data.constData();
+    const int size = m_data.size();
+
+    int i = m_pos + 1;
+    m_start = i;
+    m_escaped = false;
+
+    while (i < size) {
+        unsigned char c = data[i];
+
+        if (c == '"') {
+            m_size = i - m_start;
+            m_pos = i + 1;
+
+            if (type == String) {
+                m_expected = m_stack.isEmpty() ? ExpectEnd : ExpectSeparator;
+            }
+            return setToken(type);
+        } else if (c == '\\') {
+            if (i + 1 == size) {
+                break;
+            }
+
+            char e = data[i + 1];
+
+            if (e == 'u') {
+                if (i + 6 > size || hex4(data + i + 2) == -1) {
+                    break;
                 }
+                i += 6;
+            } else if (strchr("\"\\/bfnrt", e) && e != '\0') {
+                i += 2;
             } else {
-                key.append(cc);
+                break;
             }
+
+            m_escaped = true;
+        } else if (c < 0x20) {
             break;
+        } else {
+            ++i;
+        }
+    }
+
+    m_pos = i;
+
+    return setToken(Invalid);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::JsonReader::TokenType Lvk::Cmn::JsonReader::readNumber()
+{
+    const char *data = m_data.constData();
+    const int size = m_data.size();
+
+    int i = m_pos;
+    bool integer = true;
+
+    if (data[i] == '-') {
+        ++i;
+    }
+
+    if (i < size && data[i] == '0') {
+        ++i;
+    } else if (i < size && isDigit(data[i])) {
+        while (i < size && isDigit(data[i])) {
+            ++i;
+        }
+    } else {
+        m_pos = i;
+        return setToken(Invalid);
+    }
+
+    if (i < size && data[i] == '.') {
+        integer = false;
+        if (++i == size || !isDigit(data[i])) {
+            m_pos = i;
+            return setToken(Invalid);
+        }
+        while (i < size && isDigit(data[i])) {
+            ++i;
+        }
+    }
+
+    if (i < size && (data[i] == 'e' || data[i] == 'E')) {
+        integer = false;
+        if (++i < size && (data[i] == '+' || data[i] == '-')) {
+            ++i;
+        }
+        if (i == size || !isDigit(data[i])) {
+            m_pos = i;
+            return setToken(Invalid);
+        }
+        while (i < size && isDigit(data[i])) {
+            ++i;
+        }
+    }
+
+    m_start = m_pos;
+    m_size = i - m_pos;
+    m_pos = i;
+
+    // Small integers, the most common numbers, are converted without copying the text
+    if (integer && m_size <= 18) {
+        const char *p = data + m_start;
+        bool negative = *p == '-';
+        qint64 n = 0;
+
+        for (p += negative ? 1 : 0; p != data + i; ++p) {
+            n = n*10 + (*p - '0');
+        }
+
+        m_number = static_cast<double>(negative ? -n : n);
+    } else {
+        bool ok = false;
+        m_number = text().toDouble(&ok);
+
+        if (!ok) {
+            return setToken(Invalid);
+        }
+    }
+
+    m_expected = m_stack.isEmpty() ? ExpectEnd : ExpectSeparator;
+
+    return setToken(Number);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::JsonReader::TokenType Lvk::Cmn::JsonReader::readLiteral(const char *literal,
+                                                                  TokenType type, bool value)
+{
+    int n = qstrlen(literal);
+
+    if (m_pos + n > m_data.size() || memcmp(m_data.constData() + m_pos, literal, n) != 0) {
+        return setToken(Invalid);
+    }
+
+    m_start = m_pos;
+    m_size = n;
+    m_pos += n;
+    m_bool = value;
+    m_expected = m_stack.isEmpty() ? ExpectEnd : ExpectSeparator;
+
+    return setToken(type);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::JsonReader::TokenType Lvk::Cmn::JsonReader::endContainer(char c, TokenType type)
+{
+    if (m_stack.isEmpty() || m_stack[m_stack.size() - 1] != c) {
+        return setToken(Invalid);
+    }
+
+    ++m_pos;
+    m_stack.removeLast();
+    m_expected = m_stack.isEmpty() ? ExpectEnd : ExpectSeparator;
+
+    return setToken(type);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline Lvk::Cmn::JsonReader::TokenType Lvk::Cmn::JsonReader::setToken(TokenType type)
+{
+    m_token = type;
+    return type;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonReader::skipSpaces()
+{
+    const char *data = m_data.constData();
+    const int size = m_data.size();
+
+    while (m_pos < size && (data[m_pos] == ' ' || data[m_pos] == '\n' || data[m_pos] == '\r'
+                            || data[m_pos] == '\t')) {
+        ++m_pos;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// JsonWriter
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::JsonWriter::JsonWriter()
+    : m_size(0), m_afterKey(false)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::clear()
+{
+    m_size = 0;
+    m_first.clear();
+    m_afterKey = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::beginObject()
+{
+    separate();
+    append('{');
+    m_first.append(true);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::endObject()
+{
+    if (!m_first.isEmpty()) {
+        m_first.removeLast();
+    }
+    append('}');
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::beginArray()
+{
+    separate();
+    append('[');
+    m_first.append(true);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::endArray()
+{
+    if (!m_first.isEmpty()) {
+        m_first.removeLast();
+    }
+    append(']');
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeKey(const char *key)
+{
+    separate();
+    appendQuoted(key, qstrlen(key));
+    append(':');
+    m_afterKey = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeKey(const QString &key)
+{
+    separate();
+    appendQuoted(key);
+    append(':');
+    m_afterKey = true;
+}
 
-        case SearchingColon:
-            if (cc.isSpace()) {
-                // nothing to do
-            } else if (cc == ':') {
-                stage = SearchingValue;
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeString(const QString &str)
+{
+    separate();
+    appendQuoted(str);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeString(const QByteArray &str)
+{
+    separate();
+    appendQuoted(str.constData(), str.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeNumber(qint64 n)
+{
+    separate();
+
+    // Digits are written backwards
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    quint64 u = n < 0 ? -static_cast<quint64>(n) : static_cast<quint64>(n);
+
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u > 0);
+
+    if (n < 0) {
+        *--p = '-';
+    }
+
+    append(p, buf + sizeof(buf) - p);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeNumber(double n, int decimals)
+{
+    if (qIsNaN(n) || qIsInf(n)) {
+        writeNull();
+    } else if (decimals < 0 && qAbs(n) < 1e15 && n == static_cast<double>(static_cast<qint64>(n))) {
+        writeNumber(static_cast<qint64>(n));
+    } else {
+        separate();
+
+        QByteArray s = decimals < 0 ? QByteArray::number(n, 'g', 15)
+                                    : QByteArray::number(n, 'f', decimals);
+        append(s.constData(), s.size());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeBool(bool b)
+{
+    separate();
+
+    if (b) {
+        append("true", 4);
+    } else {
+        append("false", 5);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeNull()
+{
+    separate();
+    append("null", 4);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::writeVariant(const QVariant &value)
+{
+    switch (value.type()) {
+    case QVariant::Invalid:
+        writeNull();
+        break;
+
+    case QVariant::Bool:
+        writeBool(value.toBool());
+        break;
+
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+        writeNumber(value.toLongLong());
+        break;
+
+    case QVariant::ULongLong:
+    case QVariant::Double:
+        writeNumber(value.toDouble());
+        break;
+
+    case QVariant::ByteArray:
+        writeString(value.toByteArray());
+        break;
+
+    case QVariant::Map: {
+        const QVariantMap map = value.toMap();
+        beginObject();
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            writeKey(it.key());
+            writeVariant(it.value());
+        }
+        endObject();
+        break;
+    }
+
+    case QVariant::Hash: {
+        const QVariantHash hash = value.toHash();
+        beginObject();
+        for (QVariantHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it) {
+            writeKey(it.key());
+            writeVariant(it.value());
+        }
+        endObject();
+        break;
+    }
+
+    case QVariant::List:
+        beginArray();
+        foreach (const QVariant &item, value.toList()) {
+            writeVariant(item);
+        }
+        endArray();
+        break;
+
+    case QVariant::StringList:
+        beginArray();
+        foreach (const QString &item, value.toStringList()) {
+            writeString(item);
+        }
+        endArray();
+        break;
+
+    default:
+        if (value.userType() == qMetaTypeId<Json::Object>()) {
+            writeVariant(QVariant(value.value<Json::Object>()));
+        } else {
+            writeString(value.toString());
+        }
+        break;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void Lvk::Cmn::JsonWriter::separate()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+    } else if (!m_first.isEmpty()) {
+        bool &first = m_first[m_first.size() - 1];
+
+        if (!first) {
+            append(',');
+        }
+        first = false;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::append(const char *s, int n)
+{
+    if (m_size + n > m_buf.size()) {
+        m_buf.resize(qMax(m_size + n, 2*m_buf.size()));
+    }
+
+    memcpy(m_buf.data() + m_size, s, n);
+    m_size += n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void Lvk::Cmn::JsonWriter::append(char c)
+{
+    append(&c, 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::appendQuoted(const char *s, int n)
+{
+    append('"');
+
+    const char *p = s;
+    const char *end = s + n;
+    const char *run = s;
+
+    for (; p != end; ++p) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\' || c < 0x20) {
+            append(run, p - run);
+            appendEscaped(c);
+            run = p + 1;
+        }
+    }
+    append(run, p - run);
+
+    append('"');
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::appendQuoted(const QString &str)
+{
+    // Encodes UTF-8 while escaping, so the string is not converted first
+
+    append('"');
+
+    const QChar *p = str.constData();
+    const int n = str.size();
+
+    for (int i = 0; i < n; ++i) {
+        uint u = p[i].unicode();
+
+        if (u < 0x80) {
+            if (u == '"' || u == '\\' || u < 0x20) {
+                appendEscaped(u);
             } else {
-                err = true;
+                append(static_cast<char>(u));
             }
+            continue;
+        }
+
+        char utf8[4];
+        int size;
+
+        if (QChar::isHighSurrogate(u) && i + 1 < n && QChar::isLowSurrogate(p[i + 1].unicode())) {
+            u = QChar::surrogateToUcs4(u, p[++i].unicode());
+        } else if (QChar::isHighSurrogate(u) || QChar::isLowSurrogate(u)) {
+            u = QChar::ReplacementCharacter;
+        }
+
+        if (u < 0x800) {
+            utf8[0] = 0xc0 | (u >> 6);
+            utf8[1] = 0x80 | (u & 0x3f);
+            size = 2;
+        } else if (u < 0x10000) {
+            utf8[0] = 0xe0 | (u >> 12);
+            utf8[1] = 0x80 | ((u >> 6) & 0x3f);
+            utf8[2] = 0x80 | (u & 0x3f);
+            size = 3;
+        } else {
+            utf8[0] = 0xf0 | (u >> 18);
+            utf8[1] = 0x80 | ((u >> 12) & 0x3f);
+            utf8[2] = 0x80 | ((u >> 6) & 0x3f);
+            utf8[3] = 0x80 | (u & 0x3f);
+            size = 4;
+        }
+
+        append(utf8, size);
+    }
+
+    append('"');
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::JsonWriter::appendEscaped(unsigned char c)
+{
+    switch (c) {
+    case '"':  append("\\\"", 2); break;
+    case '\\': append("\\\\", 2); break;
+    case '\n': append("\\n", 2);  break;
+    case '\r': append("\\r", 2);  break;
+    case '\t': append("\\t", 2);  break;
+    case '\b': append("\\b", 2);  break;
+    case '\f': append("\\f", 2);  break;
+    default: {
+        char hex[6] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xf] };
+        append(hex, 6);
+        break;
+    }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Json
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::Json::Json(StringMode mode)
+    : m_mode(mode)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Json::parse(const QString &json, Json::Object &obj)
+{
+    return parse(json.toUtf8(), obj);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Json::parse(const QByteArray &json, Json::Object &obj)
+{
+    JsonReader reader(json);
+
+    return reader.readNext() == JsonReader::BeginObject && readMembers(reader, obj, 1)
+            && reader.readNext() == JsonReader::EndDocument;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Json::parseList(const QString &json, QList<Json::Object> &objs)
+{
+    return parseList(json.toUtf8(), objs);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Json::parseList(const QByteArray &json, QList<Json::Object> &objs)
+{
+    JsonReader reader(json);
+
+    if (reader.readNext() != JsonReader::BeginArray) {
+        return false;
+    }
+
+    for (;;) {
+        JsonReader::TokenType type = reader.readNext();
+
+        if (type == JsonReader::EndArray) {
             break;
+        }
+
+        Json::Object obj;
+
+        if (type != JsonReader::BeginObject || !readMembers(reader, obj, 2)) {
+            return false;
+        }
+
+        objs.append(obj);
+    }
+
+    return reader.readNext() == JsonReader::EndDocument;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Cmn::Json::escape(const QString &str)
+{
+    QString escaped;
+    escaped.reserve(str.size());
 
-        case SearchingValue:
-            if (cc.isSpace()) {
-                // nothing to do
-            } else if (cc == '"') {
-                stage = ParsingStringValue;
-            } else if (cc.isDigit() || cc == '.') {
-                --i;
-                stage = ParsingDoubleValue;
-            } else if (cc == '{') {
-                qCritical() << "Json: Nested objects are not supported";
-                err = true; // TODO implement
-            } else if (cc == '[') {
-                qCritical() << "Json: Lists are not supported";
-                err = true; // TODO implement
+    foreach (const QChar &c, str) {
+        switch (c.unicode()) {
+        case '"':  escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (c.unicode() < 0x20) {
+                escaped += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
             } else {
-                err = true;
+                escaped += c;
             }
-            break;
+        }
+    }
+
+    return escaped;
+}
+
+//--------------------------------------------------------------------------------------------------
 
-        case ParsingStringValue:
-            if (cc == '"' && pc != '\\') {
-                obj[key] = value;
-                key.clear();
-                value.clear();
-                stage = SearchingComma;
+QString Lvk::Cmn::Json::unescape(const QString &str)
+{
+    QString unescaped;
+    unescaped.reserve(str.size());
+
+    for (int i = 0; i < str.size(); ++i) {
+        if (str[i] != '\\' || i == str.size() - 1) {
+            unescaped += str[i];
+            continue;
+        }
+
+        QChar c = str[++i];
+
+        if (c == 'n') {
+            unescaped += '\n';
+        } else if (c == 'r') {
+            unescaped += '\r';
+        } else if (c == 't') {
+            unescaped += '\t';
+        } else if (c == 'b') {
+            unescaped += '\b';
+        } else if (c == 'f') {
+            unescaped += '\f';
+        } else if (c == 'u' && i + 4 < str.size()) {
+            bool ok = false;
+            ushort code = str.mid(i + 1, 4).toUShort(&ok, 16);
+            if (ok) {
+                unescaped += QChar(code);
+                i += 4;
             } else {
-                value.append(cc);
+                unescaped += c;
             }
-            break;
+        } else {
+            unescaped += c; // quotes, backslashes and slashes
+        }
+    }
 
-        case ParsingDoubleValue:
-            if (cc.isDigit() || cc == '.') {
-                value.append(cc);
-            }
-            if (cc.isSpace() || i == keyvalues.size() - 1) {
-                bool ok = true;
-                obj[key] = value.toDouble(&ok);
-                err = !ok;
-                key.clear();
-                value.clear();
-                stage = SearchingComma;
+    return unescaped;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Json::readMembers(JsonReader &reader, Json::Object &obj, int depth)
+{
+    for (;;) {
+        JsonReader::TokenType type = reader.readNext();
+
+        if (type == JsonReader::EndObject) {
+            return true;
+        } else if (type != JsonReader::Key) {
+            return false;
+        }
+
+        QString key = reader.stringValue();
+        QVariant value;
+
+        reader.readNext();
+
+        if (!readValue(reader, value, depth)) {
+            return false;
+        }
+
+        obj[key] = value;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Json::readValue(JsonReader &reader, QVariant &value, int depth)
+{
+    switch (reader.tokenType()) {
+    case JsonReader::String:
+        if (m_mode == UnescapedStrings) {
+            value = reader.stringValue();
+        } else {
+            QByteArray text = reader.text();
+            value = QString::fromUtf8(text.constData(), text.size());
+        }
+        return true;
+
+    case JsonReader::Number:
+        value = reader.numberValue();
+        return true;
+
+    case JsonReader::Bool:
+        value = reader.boolValue();
+        return true;
+
+    case JsonReader::Null:
+        value = QVariant();
+        return true;
+
+    case JsonReader::BeginObject: {
+        Json::Object obj;
+        if (!readMembers(reader, obj, depth + 1)) {
+            return false;
+        }
+        value = QVariant::fromValue(obj);
+        return true;
+    }
+
+    case JsonReader::BeginArray: {
+        QVariantList list;
+        for (;;) {
+            JsonReader::TokenType type = reader.readNext();
+
+            if (type == JsonReader::EndArray) {
+                break;
             }
-            break;
 
-        case SearchingComma:
-            if (cc.isSpace()) {
-                // nothing to do
-            } else if (cc == ',') {
-                stage = SearchingKey;
-            } else {
-                err = true;
+            QVariant item;
+            if (!readValue(reader, item, depth + 1)) {
+                return false;
             }
-            break;
+            list.append(item);
         }
+        value = list;
+        return true;
     }
 
-    return !err && (stage == SearchingKey || stage == SearchingComma);
+    default:
+        return false;
+    }
 }
@@ -19,11 +19,14 @@
  *
  */
 
+
 #ifndef LVK_CMN_JSON_H
 #define LVK_CMN_JSON_H
 
 #include <QVariantList>
 #include <QString>
+#include <QByteArray>
+#include <QVarLengthArray>
 #include <QMetaType>
 
 namespace Lvk
@@ -39,30 +42,347 @@ namespace Cmn
 /// \addtogroup Cmn
 /// @{
 
+/**
+ * \brief The JsonReader class provides a fast streaming JSON reader.
+ *
+ * JsonReader reads UTF-8 JSON as a stream of tokens, in the same fashion as QXmlStreamReader
+ * reads XML:
+ *
+ * \code
+ * Cmn::JsonReader reader(data);
+ *
+ * while (reader.readNext() != Cmn::JsonReader::EndDocument && !reader.hasError()) {
+ *     ...
+ * }
+ * \endcode
+ *
+ * Reading tokens does not allocate memory. text() returns a view into the source buffer,
+ * strings are only decoded if stringValue() is invoked.
+ */
+class JsonReader
+{
+public:
+
+    /**
+     * Token types
+     */
+    enum TokenType
+    {
+        NoToken,        ///< readNext() has not been invoked yet
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key,            ///< A key of an object, the value is the next token
+        String,
+        Number,
+        Bool,
+        Null,
+        EndDocument,
+        Invalid         ///< The JSON is ill-formed. \see errorOffset()
+    };
+
+    /**
+     * Constructs a reader of \a data. \a data must hold a single JSON value.
+     */
+    JsonReader(const QByteArray &data);
+
+    /**
+     * Reads the next token and returns its type.
+     */
+    TokenType readNext();
+
+    /**
+     * Returns the type of the current token.
+     */
+    TokenType tokenType() const
+    {
+        return m_token;
+    }
+
+    /**
+     * Skips the current value. If the current token is BeginObject or BeginArray, reads until
+     * the matching end token. Returns true on success. Otherwise; returns false.
+     */
+    bool skipValue();
+
+    /**
+     * Returns the text of the current Key, String, Number, Bool or Null token as a view into
+     * the source buffer. Strings are returned without quotes and escape sequences are kept.
+     */
+    QByteArray text() const
+    {
+        return QByteArray::fromRawData(m_data.constData() + m_start, m_size);
+    }
+
+    /**
+     * Returns the current Key or String token with its escape sequences resolved.
+     */
+    QString stringValue() const;
+
+    /**
+     * Returns the current Number token.
+     */
+    double numberValue() const
+    {
+        return m_number;
+    }
+
+    /**
+     * Returns the current Bool token.
+     */
+    bool boolValue() const
+    {
+        return m_bool;
+    }
+
+    /**
+     * Returns true if the JSON is ill-formed. Otherwise; returns false.
+     */
+    bool hasError() const
+    {
+        return m_token == Invalid;
+    }
+
+    /**
+     * Returns the offset in bytes where the error was found, or -1 if there is no error.
+     */
+    int errorOffset() const;
+
+private:
+    enum Expected { ExpectValue, ExpectValueOrEnd, ExpectKey, ExpectKeyOrEnd, ExpectSeparator,
+                    ExpectEnd };
+
+    QByteArray m_data;
+    int m_pos;
+    TokenType m_token;
+    Expected m_expected;
+    QVarLengthArray<char, 16> m_stack;   // '{' or '[' of each open container
+    int m_start;                         // Start of the current token text
+    int m_size;                          // Size of the current token text
+    bool m_escaped;                      // True if the current string has escape sequences
+    double m_number;
+    bool m_bool;
+
+    TokenType readValue();
+    TokenType readString(TokenType type);
+    TokenType readNumber();
+    TokenType readLiteral(const char *literal, TokenType type, bool value);
+    TokenType endContainer(char c, TokenType type);
+    TokenType setToken(TokenType type);
+    void skipSpaces();
+};
+
+/**
+ * \brief The JsonWriter class provides a fast JSON writer.
+ *
+ * JsonWriter appends UTF-8 JSON to an internal buffer. Commas and colons are written as
+ * needed and strings are escaped:
+ *
+ * \code
+ * Cmn::JsonWriter writer;
+ * writer.beginObject();
+ * writer.writeKey("matched");
+ * writer.writeBool(true);
+ * writer.endObject();
+ * socket->write(writer.constData(), writer.size());
+ * \endcode
+ *
+ * clear() keeps the allocated memory, hence a writer can be reused to write many messages
+ * without allocating memory.
+ */
+class JsonWriter
+{
+public:
+
+    /**
+     * Constructs an empty writer.
+     */
+    JsonWriter();
+
+    /**
+     * Discards the written JSON. The allocated memory is kept.
+     */
+    void clear();
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    /**
+     * Writes the key of the next value of the current object.
+     */
+    void writeKey(const char *key);
+
+    /**
+     * \overload
+     */
+    void writeKey(const QString &key);
+
+    /**
+     * Writes \a str as an escaped JSON string.
+     */
+    void writeString(const QString &str);
+
+    /**
+     * Writes the UTF-8 string \a str as an escaped JSON string.
+     */
+    void writeString(const QByteArray &str);
+
+    /**
+     * Writes the integer \a n.
+     */
+    void writeNumber(qint64 n);
+
+    /**
+     * Writes the number \a n. If \a decimals is negative, integral numbers are written without
+     * decimals and other numbers with up to 15 significant digits. Otherwise; \a decimals digits
+     * after the decimal point are written. NaN and infinite numbers are written as null.
+     */
+    void writeNumber(double n, int decimals = -1);
+
+    /**
+     * Writes \a b.
+     */
+    void writeBool(bool b);
+
+    /**
+     * Writes null.
+     */
+    void writeNull();
+
+    /**
+     * Writes \a value. Maps and hashes are written as objects, lists and string lists as
+     * arrays, invalid values as null and other values as numbers, booleans or strings.
+     */
+    void writeVariant(const QVariant &value);
+
+    /**
+     * Returns a pointer to the written JSON. The pointer is invalidated by any other write.
+     */
+    const char *constData() const
+    {
+        return m_buf.constData();
+    }
+
+    /**
+     * Returns the size in bytes of the written JSON.
+     */
+    int size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Returns a copy of the written JSON.
+     */
+    QByteArray toByteArray() const
+    {
+        return QByteArray(m_buf.constData(), m_size);
+    }
+
+private:
+    QByteArray m_buf;
+    int m_size;
+    QVarLengthArray<bool, 16> m_first;   // True if nothing was written yet in each container
+    bool m_afterKey;
+
+    void separate();
+    void append(const char *s, int n);
+    void append(char c);
+    void appendQuoted(const char *s, int n);
+    void appendQuoted(const QString &str);
+    void appendEscaped(unsigned char c);
+};
+
 /**
  * \brief The Json class provides a simple JSON parser.
  *
- * WARNING! Partially implemented. Nested objects and lists are not supported.
+ * Json parses a JSON object, or a list of objects, into hashes. Nested objects are parsed as
+ * Json::Object values, arrays as QVariantList values, numbers as doubles and null as invalid
+ * values. Use JsonReader to read JSON without building hashes.
  */
 class Json
 {
 public:
 
+    /**
+     * String modes. By default string values are kept as they are written in JSON, with their
+     * escape sequences.
+     */
+    enum StringMode
+    {
+        RawStrings,         ///< Escape sequences are kept. \see unescape()
+        UnescapedStrings    ///< Escape sequences are resolved
+    };
+
     /**
      * The Object class provides a JSON object. A JSON object is a key-value map
      */
     typedef QHash<QString, QVariant> Object;
 
+    /**
+     * Constructs a parser with string \a mode.
+     */
+    Json(StringMode mode = RawStrings);
+
     /**
      * Parses the given \a json string into \a obj. Returns true on success. Otherwise, returns
      * false.
      */
     bool parse(const QString &json, Json::Object &obj);
 
+    /**
+     * Parses the given UTF-8 \a json string into \a obj. Returns true on success. Otherwise,
+     * returns false.
+     */
+    bool parse(const QByteArray &json, Json::Object &obj);
+
+    /**
+     * \overload
+     */
+    bool parse(const char *json, Json::Object &obj)
+    {
+        return parse(QByteArray(json), obj);
+    }
+
+    /**
+     * Parses the given \a json list of objects into \a objs. Returns true on success.
+     * Otherwise, returns false. Objects are parsed as in parse().
+     */
+    bool parseList(const QString &json, QList<Json::Object> &objs);
+
+    /**
+     * Parses the given UTF-8 \a json list of objects into \a objs. Returns true on success.
+     * Otherwise, returns false. Objects are parsed as in parse().
+     */
+    bool parseList(const QByteArray &json, QList<Json::Object> &objs);
+
+    /**
+     * \overload
+     */
+    bool parseList(const char *json, QList<Json::Object> &objs)
+    {
+        return parseList(QByteArray(json), objs);
+    }
+
+    /**
+     * Returns \a str with quotes, backslashes and control characters escaped, ready to be
+     * written as a JSON string value.
+     */
+    static QString escape(const QString &str);
+
+    /**
+     * Returns the string value \a str with its escape sequences resolved.
+     */
+    static QString unescape(const QString &str);
+
 private:
-    bool parseObject(const QString &json, Json::Object &obj);
-    bool parseKeyValues(const QString &keyval, Json::Object &obj);
-    bool removeBraces(const QString &json, QString &parsed);
+    StringMode m_mode;
+
+    bool readMembers(JsonReader &reader, Json::Object &obj, int depth);
+    bool readValue(JsonReader &reader, QVariant &value, int depth);
 };
 
 /// @}
@@ -76,4 +396,3 @@ private:
 Q_DECLARE_METATYPE(Lvk::Cmn::Json::Object)
 
 #endif // LVK_CMN_JSON_H
-
@@ -23,8 +23,12 @@
 #include "common/settings.h"
 #include "common/version.h"
 #include "common/settingskeys.h"
+#include "common/trace.h"
+#include "common/profiler.h"
+#include "common/startuptimeline.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <QtDebug>
 #include <QFile>
@@ -34,6 +38,10 @@
 #include <QDateTime>
 #include <QSysInfo>
 #include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
 
 #define DEBUG_STR            "Debug: "
 #define WARNING_STR          "Warning: "
@@ -41,9 +49,14 @@
 #define FATAL_STR            "Fatal: "
 
 #define LOG_FILENAME         "chatbot.log"
+#define LOG_MAX_SIZE         (1024*1024)
 
 #define DATE_TIME_LOG_FORMAT "yyyy-MM-dd hh:mm:ss.zzz"
 
+#define LOG_QUEUE_SIZE       1024   // Records in the async queue. Must be a power of two
+#define LOG_RECORD_MSG_SIZE  500    // Longer messages are truncated in async mode
+#define LOG_WRITER_INTERVAL  50     // Milliseconds the writer sleeps when the queue is empty
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -53,7 +66,7 @@ namespace
 
 inline bool makeLogsPath()
 {
-    Lvk::Cmn::Settings settings;
+    Lvk::Cmn::SettingsSnapshot settings = Lvk::Cmn::SettingsSnapshot::current();
     QString logsPath = settings.value(SETTING_LOGS_PATH).toString();
 
     bool success = true;
@@ -70,7 +83,7 @@ inline bool makeLogsPath()
 
 inline QString chatbotLogFilename()
 {
-    Lvk::Cmn::Settings settings;
+    Lvk::Cmn::SettingsSnapshot settings = Lvk::Cmn::SettingsSnapshot::current();
     QString logsPath = settings.value(SETTING_LOGS_PATH).toString();
 
     return logsPath + QDir::separator() + LOG_FILENAME;
@@ -90,6 +103,233 @@ inline QString getOSType()
 #endif
 }
 
+//--------------------------------------------------------------------------------------------------
+
+inline const char *typeStr(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg:
+        return DEBUG_STR;
+    case QtWarningMsg:
+        return WARNING_STR;
+    case QtCriticalMsg:
+        return CRITICAL_STR;
+    case QtFatalMsg:
+    default:
+        return FATAL_STR;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns a log file line with the form "<date time> <pid> <type>: <msg>\n"
+inline QByteArray logLine(QtMsgType type, qint64 msecs, const QString &pid, const char *msg)
+{
+    QByteArray line = QDateTime::fromMSecsSinceEpoch(msecs).toString(DATE_TIME_LOG_FORMAT)
+            .toUtf8();
+    line += " ";
+    line += pid.toAscii();
+    line += " ";
+    line += typeStr(type);
+    line += msg;
+    line += "\n";
+
+    return line;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Fixed-size log record used by the async queue
+
+struct LogRecord
+{
+    QAtomicInt seq;                     // Sequence number. See LogQueue
+    qint64 msecs;
+    QtMsgType type;
+    bool echo;                          // true if it must be printed in the console
+    char msg[LOG_RECORD_MSG_SIZE];
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Bounded lock-free multiple-producer single-consumer queue of log records.
+// Each slot has a sequence number: a slot is free for position p if seq == p and it holds the
+// record of position p if seq == p + 1. If the queue is full, records are dropped.
+
+class LogQueue
+{
+public:
+    LogQueue()
+        : m_enqueuePos(0), m_dequeuePos(0), m_dropped(0)
+    {
+        for (int i = 0; i < LOG_QUEUE_SIZE; ++i) {
+            m_records[i].seq = i;
+        }
+    }
+
+    // Called by any thread
+    bool enqueue(QtMsgType type, bool echo, const char *msg)
+    {
+        int pos = m_enqueuePos;
+        LogRecord *r = 0;
+
+        forever {
+            r = &m_records[pos & (LOG_QUEUE_SIZE - 1)];
+            int diff = (int)((unsigned)(int)r->seq - (unsigned)pos);
+
+            if (diff == 0) {
+                if (m_enqueuePos.testAndSetRelaxed(pos, pos + 1)) {
+                    break;
+                }
+                pos = m_enqueuePos;
+            } else if (diff < 0) {
+                m_dropped.fetchAndAddRelaxed(1);
+                return false;
+            } else {
+                pos = m_enqueuePos;
+            }
+        }
+
+        r->msecs = QDateTime::currentMSecsSinceEpoch();
+        r->type = type;
+        r->echo = echo;
+        qstrncpy(r->msg, msg, LOG_RECORD_MSG_SIZE);
+
+        r->seq.fetchAndStoreRelease(pos + 1);
+
+        return true;
+    }
+
+    // Called only by one thread at a time. Returns false if the queue is empty
+    bool dequeue(LogRecord &record)
+    {
+        int pos = m_dequeuePos;
+        LogRecord *r = &m_records[pos & (LOG_QUEUE_SIZE - 1)];
+
+        if ((int)r->seq != pos + 1) {
+            return false;
+        }
+
+        record.msecs = r->msecs;
+        record.type = r->type;
+        record.echo = r->echo;
+        qstrncpy(record.msg, r->msg, LOG_RECORD_MSG_SIZE);
+
+        m_dequeuePos = pos + 1;
+        r->seq.fetchAndStoreRelease(pos + LOG_QUEUE_SIZE);
+
+        return true;
+    }
+
+    // Returns the amount of dropped records and resets the counter
+    int takeDropped()
+    {
+        return m_dropped.fetchAndStoreRelaxed(0);
+    }
+
+private:
+    LogRecord m_records[LOG_QUEUE_SIZE];
+    QAtomicInt m_enqueuePos;
+    int m_dequeuePos;
+    QAtomicInt m_dropped;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Thread that writes the records of the async queue in batches
+
+class LogWriter : public QThread
+{
+public:
+    LogWriter(QFile *logFile, const QString &pid)
+        : m_logFile(logFile), m_pid(pid), m_running(1) { }
+
+    LogQueue & queue()
+    {
+        return m_queue;
+    }
+
+    void stop()
+    {
+        m_running = 0;
+        wait();
+        flush();
+    }
+
+    // Writes all queued records. Can be invoked from any thread
+    void flush()
+    {
+        QMutexLocker locker(&m_flushMutex);
+
+        QByteArray batch;
+        QByteArray out;
+        QByteArray err;
+        LogRecord r;
+
+        while (m_queue.dequeue(r)) {
+            batch += logLine(r.type, r.msecs, m_pid, r.msg);
+            if (r.echo) {
+                QByteArray &echo = r.type == QtDebugMsg ? out : err;
+                echo += typeStr(r.type);
+                echo += r.msg;
+                echo += "\n";
+            }
+        }
+
+        int dropped = m_queue.takeDropped();
+        if (dropped > 0) {
+            QByteArray msg = QString("Logger: %1 messages dropped").arg(dropped).toUtf8();
+            batch += logLine(QtWarningMsg, QDateTime::currentMSecsSinceEpoch(), m_pid, msg);
+        }
+
+        if (!out.isEmpty()) {
+            std::cout << out.constData() << std::flush;
+        }
+        if (!err.isEmpty()) {
+            std::cerr << err.constData() << std::flush;
+        }
+
+        if (!batch.isEmpty()) {
+            m_logFile->write(batch);
+            m_logFile->flush();
+
+            rotateIfNeeded();
+        }
+    }
+
+protected:
+    void run()
+    {
+        while (m_running) {
+            flush();
+            msleep(LOG_WRITER_INTERVAL);
+        }
+    }
+
+private:
+    QFile *m_logFile;
+    QString m_pid;
+    QAtomicInt m_running;
+    QMutex m_flushMutex;
+    LogQueue m_queue;
+
+    void rotateIfNeeded()
+    {
+        if (m_logFile->size() > LOG_MAX_SIZE) {
+            QString filename = m_logFile->fileName();
+
+            m_logFile->close();
+            Lvk::Cmn::Logger::rotateLog(filename, LOG_MAX_SIZE);
+
+            if (!m_logFile->open(QFile::Append)) {
+                std::cerr << CRITICAL_STR "Cannot reopen rotated log file" << std::endl;
+            }
+        }
+    }
+};
+
+LogWriter *s_writer = 0;   // Writer in async mode
+
 } // namespace
 
 
@@ -105,6 +345,8 @@ QtMsgType Lvk::Cmn::Logger::m_verbLevel = QtDebugMsg;
 
 void Lvk::Cmn::Logger::init()
 {
+    LVK_STARTUP_PHASE("logger_init");
+
     if (m_logFile) {
         return; // Already initialized
     }
@@ -119,10 +361,18 @@ void Lvk::Cmn::Logger::init()
         m_logFile = new QFile(logFilename);
 
         if (m_logFile->open(QFile::Append)) {
+            if (Cmn::SettingsSnapshot::current().value(SETTING_LOGS_ASYNC).toBool()) {
+                s_writer = new LogWriter(m_logFile, m_strPid);
+                s_writer->start(QThread::LowPriority);
+            }
+
             qInstallMsgHandler(msgHandler);
             qDebug() << "Logger initialized on"
                      << APP_NAME " v" APP_VERSION_STR " rev:" APP_VERSION_REV;
             qDebug() << "OS Type:" << getOSType();
+
+            Cmn::Trace::init();
+            Cmn::Profiler::init();
         } else {
             delete m_logFile;
             m_logFile = 0;
@@ -142,6 +392,12 @@ void Lvk::Cmn::Logger::shutdown()
 
     qInstallMsgHandler(0); // Restore handler
 
+    if (s_writer) {
+        s_writer->stop();
+        delete s_writer;
+        s_writer = 0;
+    }
+
     delete m_logFile;
     m_logFile = 0;
 }
@@ -163,6 +419,15 @@ void Lvk::Cmn::Logger::rotateLog(const QString &logFilename, qint64 maxSize)
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::Cmn::Logger::flush()
+{
+    if (s_writer) {
+        s_writer->flush();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::Cmn::Logger::setVerboseLevel(QtMsgType verbLevel)
 {
     m_verbLevel = verbLevel;
@@ -172,6 +437,25 @@ void Lvk::Cmn::Logger::setVerboseLevel(QtMsgType verbLevel)
 
 void Lvk::Cmn::Logger::msgHandler(QtMsgType type, const char *msg)
 {
+    // In async mode, messages are written by the writer thread. Fatal messages are flushed
+    // synchronously since the application terminates
+    if (s_writer) {
+        bool echo = type >= m_verbLevel;
+
+        if (type != QtFatalMsg) {
+            s_writer->queue().enqueue(type, echo, msg);
+            return;
+        }
+
+        if (!s_writer->queue().enqueue(type, echo, msg)) {
+            s_writer->flush();
+            s_writer->queue().enqueue(type, echo, msg);
+        }
+        s_writer->flush();
+
+        abort();
+    }
+
     m_logFile->write(QDateTime::currentDateTime().toString(DATE_TIME_LOG_FORMAT).toUtf8());
     m_logFile->write(" ");
     m_logFile->write(m_strPid.toAscii());
@@ -48,6 +48,12 @@ namespace Cmn
  *
  * If qFatal() is invoked after logging the message the application is terminated.
  *
+ * If the setting SETTING_LOGS_ASYNC is true, messages are pushed into a bounded lock-free
+ * queue and a background thread writes them in batches, so logging does not block the
+ * calling thread. If the queue is full, messages are dropped and the amount of dropped messages
+ * is logged. Fatal messages flush the queue and are written synchronously. In async mode the log
+ * file is also rotated when it grows bigger than 1MB.
+ *
  * To start using the logger just call init(). To stop the logger call shutdown().
  */
 class Logger
@@ -70,6 +76,11 @@ public:
      */
     static void rotateLog(const QString &logFilename, qint64 maxSize = 1024*1024);
 
+    /**
+     * Writes all pending messages. This method only blocks in async mode.
+     */
+    static void flush();
+
     /**
      * Sets the level of verbosity for information printed in the screen. By default QtDebugMsg.
      */
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "common/maintenancescheduler.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Candidate
+{
+    int index;
+    qint64 overdue;
+};
+
+// Most overdue first
+bool runsFirst(const Candidate &c1, const Candidate &c2)
+{
+    return c1.overdue > c2.overdue;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// MaintenanceScheduler
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MaintenanceScheduler * Lvk::Cmn::MaintenanceScheduler::m_scheduler = 0;
+QMutex *                         Lvk::Cmn::MaintenanceScheduler::m_schedMutex = new QMutex();
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MaintenanceScheduler::MaintenanceScheduler()
+    : m_mutex(new QMutex()),
+      m_activityMutex(new QMutex()),
+      m_active(0),
+      m_lastActivity(-1),
+      m_idleDelay(0),
+      m_budget(0),
+      m_maxDeferral(0),
+      m_checks(0),
+      m_busyChecks(0)
+{
+    m_clock.start();
+
+    connect(&m_timer, SIGNAL(timeout()), SLOT(check()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MaintenanceScheduler::~MaintenanceScheduler()
+{
+    delete m_activityMutex;
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MaintenanceScheduler * Lvk::Cmn::MaintenanceScheduler::scheduler()
+{
+    if (!m_scheduler) {
+        QMutexLocker locker(m_schedMutex);
+        if (!m_scheduler) {
+            // Never destroyed, tasks that are static objects may remove themselves on exit
+            m_scheduler = new MaintenanceScheduler();
+        }
+    }
+
+    return m_scheduler;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::init()
+{
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+
+    MaintenanceScheduler *sched = scheduler();
+    sched->setIdleDelay(settings.intValue(SETTING_MAINTENANCE_IDLE_DELAY)*1000);
+    sched->setBudget(settings.intValue(SETTING_MAINTENANCE_BUDGET));
+    sched->setMaxDeferral(settings.intValue(SETTING_MAINTENANCE_MAX_DEFERRAL));
+
+    int interval = settings.intValue(SETTING_MAINTENANCE_CHECK_INTERVAL);
+
+    if (interval > 0) {
+        sched->m_timer.start(interval*1000);
+    } else {
+        sched->m_timer.stop();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::add(MaintenanceTask *task, const QString &name,
+                                         int interval)
+{
+    Task t;
+    t.task = task;
+    t.name = name;
+    t.interval = (qint64)interval*1000;
+    t.runs = 0;
+    t.deferrals = 0;
+    t.lastDuration = 0;
+    t.totalDuration = 0;
+
+    QMutexLocker locker(m_mutex);
+
+    // The first run is due one interval after the task is added
+    t.lastRun = m_clock.elapsed();
+
+    m_tasks.append(t);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::remove(MaintenanceTask *task)
+{
+    QMutexLocker locker(m_mutex);
+
+    for (int i = 0; i < m_tasks.size(); ++i) {
+        if (m_tasks[i].task == task) {
+            m_tasks.removeAt(i);
+            break;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::beginActivity()
+{
+    QMutexLocker locker(m_activityMutex);
+
+    ++m_active;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::endActivity()
+{
+    QMutexLocker locker(m_activityMutex);
+
+    --m_active;
+    m_lastActivity = m_clock.elapsed();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::MaintenanceScheduler::isIdle() const
+{
+    QMutexLocker locker(m_activityMutex);
+
+    return m_active <= 0
+            && (m_lastActivity < 0 || m_clock.elapsed() - m_lastActivity >= m_idleDelay);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::setIdleDelay(int msecs)
+{
+    QMutexLocker locker(m_activityMutex);
+
+    m_idleDelay = qMax(msecs, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::setBudget(int msecs)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_budget = qMax(msecs, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::setMaxDeferral(int secs)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_maxDeferral = qMax(secs, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::check()
+{
+    bool idle = isIdle();
+
+    QMutexLocker locker(m_mutex);
+
+    ++m_checks;
+
+    if (!idle) {
+        ++m_busyChecks;
+    }
+
+    qint64 now = m_clock.elapsed();
+
+    QList<Candidate> due;
+
+    for (int i = 0; i < m_tasks.size(); ++i) {
+        Task &t = m_tasks[i];
+        qint64 overdue = now - t.lastRun - t.interval;
+
+        if (overdue < 0 || !t.task->needsMaintenance()) {
+            continue;
+        }
+
+        if (idle || (m_maxDeferral > 0 && overdue >= (qint64)m_maxDeferral*1000)) {
+            Candidate c;
+            c.index = i;
+            c.overdue = overdue;
+            due.append(c);
+        } else {
+            ++t.deferrals;
+        }
+    }
+
+    qSort(due.begin(), due.end(), runsFirst);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    foreach (const Candidate &c, due) {
+        if (timer.elapsed() > m_budget && c.index != due.first().index) {
+            break;
+        }
+        run(m_tasks[c.index]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::MaintenanceScheduler::runAll()
+{
+    QMutexLocker locker(m_mutex);
+
+    int count = 0;
+
+    for (int i = 0; i < m_tasks.size(); ++i) {
+        if (m_tasks[i].task->needsMaintenance()) {
+            run(m_tasks[i]);
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MaintenanceScheduler::run(Task &t)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    t.task->runMaintenance();
+
+    t.lastDuration = timer.elapsed();
+    t.totalDuration += t.lastDuration;
+    t.lastRun = m_clock.elapsed();
+    ++t.runs;
+
+    if (t.lastDuration > m_budget && m_budget > 0) {
+        qWarning() << "MaintenanceScheduler: Task" << t.name << "took" << t.lastDuration
+                   << "ms, budget is" << m_budget << "ms";
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Cmn::MaintenanceScheduler::report() const
+{
+    QMutexLocker locker(m_mutex);
+
+    QVariantMap tasks;
+    int runs = 0;
+    int deferrals = 0;
+    qint64 duration = 0;
+
+    foreach (const Task &t, m_tasks) {
+        QVariantMap task = tasks.value(t.name).toMap();
+        task["runs"] = task.value("runs").toInt() + t.runs;
+        task["deferrals"] = task.value("deferrals").toInt() + t.deferrals;
+        task["last_ms"] = t.lastDuration;
+        task["total_ms"] = task.value("total_ms").toLongLong() + t.totalDuration;
+        tasks[t.name] = task;
+
+        runs += t.runs;
+        deferrals += t.deferrals;
+        duration += t.totalDuration;
+    }
+
+    QVariantMap report;
+    report["checks"] = m_checks;
+    report["busy_checks"] = m_busyChecks;
+    report["runs"] = runs;
+    report["deferrals"] = deferrals;
+    report["total_ms"] = duration;
+    report["idle"] = isIdle() ? 1 : 0;
+    report["tasks"] = tasks;
+
+    return report;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_CMN_MAINTENANCESCHEDULER_H
+#define LVK_CMN_MAINTENANCESCHEDULER_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The MaintenanceTask class provides the interface of background housekeeping such as
+ *        compactions, checkpoints and persisting caches
+ *
+ * \see MaintenanceScheduler
+ */
+class MaintenanceTask
+{
+public:
+
+    /**
+     * Destroys the object
+     */
+    virtual ~MaintenanceTask() { }
+
+    /**
+     * Returns true if the task has work to do. By default, returns true.
+     */
+    virtual bool needsMaintenance() const { return true; }
+
+    /**
+     * Runs the task. Long tasks should split their work or run it in a background thread.
+     * Implementations must not add or remove tasks of the MaintenanceScheduler.
+     */
+    virtual void runMaintenance() = 0;
+};
+
+/**
+ * \brief The MaintenanceScheduler class provides a singleton that runs housekeeping tasks when
+ *        the chatbot is idle
+ *
+ * Tasks implement MaintenanceTask and add themselves to the scheduler with a name and an
+ * interval. check() runs the tasks whose interval has elapsed, the most overdue first, until
+ * the time budget of the check is spent. Remaining tasks wait for the next check.
+ *
+ * Replies mark their activity with an Activity object. While there are replies in progress or
+ * the last one finished less than the idle delay ago, tasks are deferred. A task deferred
+ * longer than the max deferral runs anyway, so housekeeping is never starved by a busy bot.
+ *
+ * The check interval, the idle delay, the budget and the max deferral are read from the
+ * application settings SETTING_MAINTENANCE_CHECK_INTERVAL, SETTING_MAINTENANCE_IDLE_DELAY,
+ * SETTING_MAINTENANCE_BUDGET and SETTING_MAINTENANCE_MAX_DEFERRAL by init(). Until init() is
+ * called, tasks only run with runAll().
+ *
+ * This class is thread-safe. Tasks run in the thread that calls check() or runAll().
+ */
+class MaintenanceScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * \brief The Activity class marks a reply in progress during its lifetime
+     */
+    class Activity
+    {
+    public:
+        Activity() { MaintenanceScheduler::scheduler()->beginActivity(); }
+        ~Activity() { MaintenanceScheduler::scheduler()->endActivity(); }
+
+    private:
+        Activity(const Activity&);
+        Activity& operator=(const Activity&);
+    };
+
+    /**
+     * Returns the singleton instance.
+     */
+    static MaintenanceScheduler *scheduler();
+
+    /**
+     * Reads the check interval, the idle delay, the budget and the max deferral from the
+     * application settings and starts the periodic checks. Must be called from the main thread.
+     */
+    static void init();
+
+    /**
+     * Adds \a task with \a name that runs every \a interval seconds.
+     */
+    void add(MaintenanceTask *task, const QString &name, int interval);
+
+    /**
+     * Removes \a task. Tasks must remove themselves before they are destroyed. If the task is
+     * running, waits until it finishes.
+     */
+    void remove(MaintenanceTask *task);
+
+    /**
+     * Marks the beginning of a reply. Tasks are deferred until endActivity() is called and the
+     * idle delay elapses. Consider using an Activity object instead.
+     */
+    void beginActivity();
+
+    /**
+     * Marks the end of a reply started with beginActivity()
+     */
+    void endActivity();
+
+    /**
+     * Returns true if there are no replies in progress and the last one finished before
+     * the idle delay. Otherwise; returns false.
+     */
+    bool isIdle() const;
+
+    /**
+     * Sets the time without replies to consider the chatbot idle to \a msecs.
+     */
+    void setIdleDelay(int msecs);
+
+    /**
+     * Sets the time budget of each check to \a msecs. At least one task runs in each check.
+     */
+    void setBudget(int msecs);
+
+    /**
+     * Sets the time a task can be deferred beyond its interval to \a secs. 0 means tasks are
+     * deferred until the chatbot is idle.
+     */
+    void setMaxDeferral(int secs);
+
+    /**
+     * Runs all tasks that have work to do, regardless of the activity and the budget. Returns
+     * the amount of tasks run.
+     */
+    int runAll();
+
+    /**
+     * Returns a map with the amount of checks, runs, deferrals and the time spent running
+     * tasks and, for key "tasks", a map with the same values for each task name.
+     */
+    QVariantMap report() const;
+
+public slots:
+
+    /**
+     * Runs the tasks whose interval has elapsed, within the budget. Tasks are deferred if the
+     * chatbot is not idle.
+     */
+    void check();
+
+private:
+    MaintenanceScheduler();
+    ~MaintenanceScheduler();
+    MaintenanceScheduler(const MaintenanceScheduler&);
+    MaintenanceScheduler& operator=(const MaintenanceScheduler&);
+
+    struct Task
+    {
+        MaintenanceTask *task;
+        QString name;
+        qint64 interval;        // In msecs
+        qint64 lastRun;         // Msecs of m_clock
+        int runs;
+        int deferrals;
+        qint64 lastDuration;    // In msecs
+        qint64 totalDuration;   // In msecs
+    };
+
+    static MaintenanceScheduler *m_scheduler;
+    static QMutex *m_schedMutex;
+
+    QMutex *m_mutex;            // Held while tasks run
+    QMutex *m_activityMutex;
+    QList<Task> m_tasks;
+    QElapsedTimer m_clock;
+    int m_active;               // Replies in progress
+    qint64 m_lastActivity;      // Msecs of m_clock, -1 if none
+    int m_idleDelay;
+    int m_budget;
+    int m_maxDeferral;
+    int m_checks;
+    int m_busyChecks;
+    QTimer m_timer;
+
+    void run(Task &t);
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CMN_MAINTENANCESCHEDULER_H
@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "common/memorymanager.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+#ifdef Q_OS_WIN
+# include <windows.h>
+#endif
+
+#define MEGABYTE    (1024*1024)
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Candidate
+{
+    Lvk::Cmn::MemoryConsumer *consumer;
+    QString name;
+    int priority;
+    qint64 usage;
+};
+
+// Lower priorities first and, within the same priority, bigger consumers first
+bool releasesFirst(const Candidate &c1, const Candidate &c2)
+{
+    return c1.priority != c2.priority ? c1.priority < c2.priority : c1.usage > c2.usage;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString toMegabytes(qint64 bytes)
+{
+    return QString::number(bytes/(double)MEGABYTE, 'f', 1) + "MB";
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// MemoryManager
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MemoryManager * Lvk::Cmn::MemoryManager::m_manager = 0;
+QMutex *                  Lvk::Cmn::MemoryManager::m_mgrMutex = new QMutex();
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MemoryManager::MemoryManager()
+    : m_mutex(new QMutex()),
+      m_budget(0),
+      m_minAvailable(0)
+{
+    connect(&m_timer, SIGNAL(timeout()), SLOT(check()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MemoryManager::~MemoryManager()
+{
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::MemoryManager * Lvk::Cmn::MemoryManager::manager()
+{
+    if (!m_manager) {
+        QMutexLocker locker(m_mgrMutex);
+        if (!m_manager) {
+            // Never destroyed, consumers that are static objects may remove themselves on exit
+            m_manager = new MemoryManager();
+        }
+    }
+
+    return m_manager;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MemoryManager::init()
+{
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+
+    MemoryManager *mgr = manager();
+    mgr->setBudget((qint64)settings.intValue(SETTING_MEMORY_BUDGET)*MEGABYTE);
+    mgr->setMinAvailable((qint64)settings.intValue(SETTING_MEMORY_MIN_AVAILABLE)*MEGABYTE);
+
+    int interval = settings.intValue(SETTING_MEMORY_CHECK_INTERVAL);
+
+    if (interval > 0) {
+        mgr->m_timer.start(interval*1000);
+    } else {
+        mgr->m_timer.stop();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MemoryManager::add(MemoryConsumer *consumer, const QString &name,
+                                  Priority priority)
+{
+    Consumer c;
+    c.consumer = consumer;
+    c.name = name;
+    c.priority = priority;
+
+    QMutexLocker locker(m_mutex);
+
+    m_consumers.append(c);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MemoryManager::remove(MemoryConsumer *consumer)
+{
+    QMutexLocker locker(m_mutex);
+
+    for (int i = 0; i < m_consumers.size(); ++i) {
+        if (m_consumers[i].consumer == consumer) {
+            m_consumers.removeAt(i);
+            break;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MemoryManager::setBudget(qint64 bytes)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_budget = bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Cmn::MemoryManager::budget() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_budget;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MemoryManager::setMinAvailable(qint64 bytes)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_minAvailable = bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Cmn::MemoryManager::usage() const
+{
+    QMutexLocker locker(m_mutex);
+
+    qint64 bytes = 0;
+
+    foreach (const Consumer &c, m_consumers) {
+        bytes += c.consumer->memoryUsage();
+    }
+
+    return bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Cmn::MemoryManager::report() const
+{
+    QMutexLocker locker(m_mutex);
+
+    QHash<QString, qint64> usageByName;
+    qint64 bytes = 0;
+
+    foreach (const Consumer &c, m_consumers) {
+        qint64 usage = c.consumer->memoryUsage();
+        usageByName[c.name] += usage;
+        bytes += usage;
+    }
+
+    QVariantMap consumers;
+    for (QHash<QString, qint64>::const_iterator it = usageByName.constBegin();
+         it != usageByName.constEnd(); ++it) {
+        consumers[it.key()] = it.value();
+    }
+
+    QVariantMap report;
+    report["budget"] = m_budget;
+    report["usage"] = bytes;
+    report["consumers"] = consumers;
+
+    return report;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Cmn::MemoryManager::release(qint64 bytes)
+{
+    QVariantMap released;
+
+    {
+        QMutexLocker locker(m_mutex);
+
+        QList<Candidate> candidates;
+
+        foreach (const Consumer &c, m_consumers) {
+            Candidate cand;
+            cand.consumer = c.consumer;
+            cand.name = c.name;
+            cand.priority = c.priority;
+            cand.usage = c.consumer->memoryUsage();
+
+            if (cand.usage > 0) {
+                candidates.append(cand);
+            }
+        }
+
+        qStableSort(candidates.begin(), candidates.end(), releasesFirst);
+
+        qint64 total = 0;
+
+        for (int i = 0; i < candidates.size() && total < bytes; ++i) {
+            qint64 freed = candidates[i].consumer->releaseMemory(bytes - total);
+
+            if (freed > 0) {
+                released[candidates[i].name] = released.value(candidates[i].name).toLongLong()
+                        + freed;
+                total += freed;
+            }
+        }
+    }
+
+    if (!released.isEmpty()) {
+        QStringList summary;
+        for (QVariantMap::const_iterator it = released.constBegin(); it != released.constEnd();
+             ++it) {
+            summary.append(it.key() + " " + toMegabytes(it.value().toLongLong()));
+        }
+
+        qWarning() << "MemoryManager: Released" << summary.join(", ");
+
+        emit memoryReleased(released);
+    }
+
+    return released;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::MemoryManager::check()
+{
+    qint64 budget;
+    qint64 minAvailable;
+
+    {
+        QMutexLocker locker(m_mutex);
+        budget = m_budget;
+        minAvailable = m_minAvailable;
+    }
+
+    qint64 excess = 0;
+
+    if (budget > 0) {
+        qint64 bytes = usage();
+
+        if (bytes > budget) {
+            qWarning() << "MemoryManager: Usage" << toMegabytes(bytes) << "exceeds the budget"
+                       << toMegabytes(budget);
+            excess = bytes - budget;
+        }
+    }
+
+    if (minAvailable > 0) {
+        qint64 available = availableSystemMemory();
+
+        if (available >= 0 && available < minAvailable) {
+            qWarning() << "MemoryManager: Low system memory, only" << toMegabytes(available)
+                       << "available";
+            excess = qMax(excess, minAvailable - available);
+        }
+    }
+
+    if (excess > 0) {
+        release(excess);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Cmn::MemoryManager::availableSystemMemory()
+{
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/meminfo");
+
+    if (!file.open(QFile::ReadOnly)) {
+        return -1;
+    }
+
+    // MemAvailable is in kB and includes reclaimable page cache
+    QByteArray line;
+    while (!(line = file.readLine()).isEmpty()) {
+        if (line.startsWith("MemAvailable:")) {
+            return line.mid(13).trimmed().split(' ').first().toLongLong()*1024;
+        }
+    }
+
+    return -1;
+#elif defined(Q_OS_WIN)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+
+    return GlobalMemoryStatusEx(&status) ? (qint64)status.ullAvailPhys : -1;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_CMN_MEMORYMANAGER_H
+#define LVK_CMN_MEMORYMANAGER_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The MemoryConsumer class provides the interface of caches and stores whose memory can
+ *        be released on demand
+ *
+ * \see MemoryManager
+ */
+class MemoryConsumer
+{
+public:
+
+    /**
+     * Destroys the object
+     */
+    virtual ~MemoryConsumer() { }
+
+    /**
+     * Returns an estimation of the memory used in bytes
+     */
+    virtual qint64 memoryUsage() const = 0;
+
+    /**
+     * Releases at least \a bytes if possible. Returns an estimation of the bytes released.
+     * Implementations must not add or remove consumers of the MemoryManager.
+     */
+    virtual qint64 releaseMemory(qint64 bytes) = 0;
+};
+
+/**
+ * \brief The MemoryManager class provides a singleton that keeps the memory of caches and
+ *        stores under a global budget
+ *
+ * Caches and stores implement MemoryConsumer and add themselves to the manager with a name and
+ * a priority. check() estimates the memory of all consumers and, if it exceeds the budget or
+ * the memory available in the system is low, releases memory from the least valuable
+ * consumers first: lower priorities first and, within the same priority, bigger consumers
+ * first. Each time memory is released, the released bytes of each consumer name are logged and
+ * emitted with memoryReleased().
+ *
+ * The budget, the minimum available memory and the check interval are read from the
+ * application settings SETTING_MEMORY_BUDGET, SETTING_MEMORY_MIN_AVAILABLE and
+ * SETTING_MEMORY_CHECK_INTERVAL by init(). By default there is neither a budget nor a minimum,
+ * so memory is never released.
+ *
+ * This class is thread-safe.
+ */
+class MemoryManager : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Priorities of consumers. Consumers with lower priorities release memory first.
+     */
+    enum Priority
+    {
+        CachePriority,      ///< Caches of values that are cheap to compute again
+        IndexPriority,      ///< Indexes that are expensive to build again
+        HistoryPriority     ///< Recent data that must be read again from disk
+    };
+
+    /**
+     * Returns the singleton instance.
+     */
+    static MemoryManager *manager();
+
+    /**
+     * Reads the budget, the minimum available memory and the check interval from the
+     * application settings and starts the periodic checks. Must be called from the main thread.
+     */
+    static void init();
+
+    /**
+     * Adds \a consumer with \a name and \a priority. Several consumers can share the same name.
+     */
+    void add(MemoryConsumer *consumer, const QString &name, Priority priority);
+
+    /**
+     * Removes \a consumer. Consumers must remove themselves before they are destroyed.
+     */
+    void remove(MemoryConsumer *consumer);
+
+    /**
+     * Sets the memory budget of all consumers to \a bytes. 0 means no budget.
+     */
+    void setBudget(qint64 bytes);
+
+    /**
+     * Returns the memory budget of all consumers in bytes
+     */
+    qint64 budget() const;
+
+    /**
+     * Sets the minimum memory available in the system to \a bytes. If less memory is
+     * available, consumers release the difference. 0 disables the check.
+     */
+    void setMinAvailable(qint64 bytes);
+
+    /**
+     * Returns an estimation of the memory used by all consumers in bytes
+     */
+    qint64 usage() const;
+
+    /**
+     * Returns a map with the budget, the estimated usage and, for key "consumers", a map with
+     * the estimated usage of each consumer name in bytes.
+     */
+    QVariantMap report() const;
+
+    /**
+     * Releases at least \a bytes from the consumers if possible. Returns a map with the bytes
+     * released by each consumer name.
+     */
+    QVariantMap release(qint64 bytes);
+
+    /**
+     * Returns the memory available in the system in bytes, or -1 if it is unknown.
+     */
+    static qint64 availableSystemMemory();
+
+public slots:
+
+    /**
+     * Releases memory if the consumers exceed the budget or the memory available in the system
+     * is lower than the minimum.
+     */
+    void check();
+
+signals:
+
+    /**
+     * This signal is emitted after releasing memory. \a released has the bytes released by
+     * each consumer name.
+     */
+    void memoryReleased(const QVariantMap &released);
+
+private:
+    MemoryManager();
+    ~MemoryManager();
+    MemoryManager(const MemoryManager&);
+    MemoryManager& operator=(const MemoryManager&);
+
+    struct Consumer
+    {
+        MemoryConsumer *consumer;
+        QString name;
+        Priority priority;
+    };
+
+    static MemoryManager *m_manager;
+    static QMutex *m_mgrMutex;
+
+    QMutex *m_mutex;
+    QList<Consumer> m_consumers;
+    qint64 m_budget;
+    qint64 m_minAvailable;
+    QTimer m_timer;
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CMN_MEMORYMANAGER_H
@@ -0,0 +1,10 @@
+# Parquet export of conversation histories
+#
+# Not part of common.pri because the writer compresses pages with zlib. Projects that include
+# this file must link zlib, as the chat-adapter and da-server modules do through 3rd-party.pri.
+
+HEADERS += \
+    $$PWD/conversationparquetwriter.h
+
+SOURCES += \
+    $$PWD/conversationparquetwriter.cpp
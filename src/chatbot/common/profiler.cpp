@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/profiler.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThreadStorage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QList>
+#include <QFile>
+#include <QtDebug>
+
+#define RING_BUFFER_SIZE    8192    // Events kept by each thread
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Event
+{
+    Event(const char *name = 0, qint64 start = 0, qint64 duration = 0)
+        : name(name), start(start), duration(duration) { }
+
+    const char *name;
+    qint64 start;           // Microseconds since the profiler clock started
+    qint64 duration;        // Microseconds
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Events of one thread. Only the owner thread records events; the mutex guards them from
+// exports, so it is never contended while recording.
+struct ThreadBuffer
+{
+    ThreadBuffer();
+    ~ThreadBuffer();
+
+    int tid;
+    int depth;              // Nesting depth of the active scopes
+    bool sampled;           // True if the current outermost scope is recorded
+    unsigned outermost;     // Outermost scopes started so far
+    QVector<Event> events;
+    int next;               // Index of the next event to write
+    bool full;
+    QMutex mutex;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+struct Registry
+{
+    Registry() : nextTid(1) { clock.start(); }
+
+    QMutex mutex;
+    QList<ThreadBuffer *> buffers;
+    int nextTid;
+    QElapsedTimer clock;
+};
+
+Q_GLOBAL_STATIC(Registry, registry)
+Q_GLOBAL_STATIC(QThreadStorage<ThreadBuffer *>, threadBuffers)
+
+//--------------------------------------------------------------------------------------------------
+
+ThreadBuffer::ThreadBuffer()
+    : depth(0), sampled(false), outermost(0), events(RING_BUFFER_SIZE), next(0), full(false)
+{
+    QMutexLocker locker(&registry()->mutex);
+
+    tid = registry()->nextTid++;
+    registry()->buffers.append(this);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Invoked when the thread finishes. Its events are discarded.
+ThreadBuffer::~ThreadBuffer()
+{
+    QMutexLocker locker(&registry()->mutex);
+
+    registry()->buffers.removeAll(this);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline ThreadBuffer *currentBuffer()
+{
+    QThreadStorage<ThreadBuffer *> *storage = threadBuffers();
+
+    if (!storage->hasLocalData()) {
+        storage->setLocalData(new ThreadBuffer());
+    }
+
+    return storage->localData();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline qint64 nowUsecs()
+{
+    return registry()->clock.nsecsElapsed() / 1000;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Profiler
+//--------------------------------------------------------------------------------------------------
+
+QAtomicInt Lvk::Cmn::Profiler::m_sampleInterval(0);
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Profiler::init()
+{
+    setSampleInterval(Cmn::SettingsSnapshot::current().value(SETTING_PROFILER_SAMPLING).toInt());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Profiler::setSampleInterval(int interval)
+{
+    m_sampleInterval.fetchAndStoreOrdered(qMax(0, interval));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::Profiler::sampleInterval()
+{
+    return m_sampleInterval;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Profiler::begin(qint64 &start)
+{
+    ThreadBuffer *buffer = currentBuffer();
+
+    if (buffer->depth++ == 0) {
+        int interval = qMax(1, (int)m_sampleInterval);
+        buffer->sampled = buffer->outermost++ % interval == 0;
+    }
+
+    if (!buffer->sampled) {
+        return false;
+    }
+
+    start = nowUsecs();
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Profiler::end(const char *name, qint64 start, bool recorded)
+{
+    ThreadBuffer *buffer = currentBuffer();
+
+    if (buffer->depth > 0) {
+        --buffer->depth;
+    }
+
+    if (!recorded) {
+        return;
+    }
+
+    qint64 duration = nowUsecs() - start;
+
+    QMutexLocker locker(&buffer->mutex);
+
+    buffer->events[buffer->next] = Event(name, start, duration);
+
+    if (++buffer->next == buffer->events.size()) {
+        buffer->next = 0;
+        buffer->full = true;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::Cmn::Profiler::chromeTrace()
+{
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json = "{\"traceEvents\":[";
+    bool first = true;
+
+    QMutexLocker locker(&registry()->mutex);
+
+    foreach (ThreadBuffer *buffer, registry()->buffers) {
+        QMutexLocker bufferLocker(&buffer->mutex);
+
+        QByteArray tid = QByteArray::number(buffer->tid);
+
+        // Oldest events first
+        int size = buffer->full ? buffer->events.size() : buffer->next;
+        int offset = buffer->full ? buffer->next : 0;
+
+        for (int i = 0; i < size; ++i) {
+            const Event &e = buffer->events[(offset + i) % buffer->events.size()];
+
+            json += first ? "\n" : ",\n";
+            json += "{\"name\":\"" + QByteArray(e.name) + "\",\"cat\":\"lvk\",\"ph\":\"X\""
+                    + ",\"ts\":" + QByteArray::number(e.start)
+                    + ",\"dur\":" + QByteArray::number(e.duration)
+                    + ",\"pid\":" + pid + ",\"tid\":" + tid + "}";
+            first = false;
+        }
+    }
+
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return json;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::Profiler::exportChromeTrace(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "Profiler: Cannot open" << filename;
+        return false;
+    }
+
+    QByteArray json = chromeTrace();
+
+    if (file.write(json) != json.size()) {
+        qWarning() << "Profiler: Cannot write" << filename;
+        return false;
+    }
+
+    qDebug() << "Profiler: Exported trace to" << filename;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Profiler::clear()
+{
+    QMutexLocker locker(&registry()->mutex);
+
+    foreach (ThreadBuffer *buffer, registry()->buffers) {
+        QMutexLocker bufferLocker(&buffer->mutex);
+
+        buffer->next = 0;
+        buffer->full = false;
+    }
+}
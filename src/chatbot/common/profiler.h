@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_PROFILER_H
+#define LVK_CMN_PROFILER_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QByteArray>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The Profiler class provides sampled trace events of the hot paths of the application
+ *
+ * Hot paths are instrumented with the LVK_PROFILE() macro, which records the duration of the
+ * enclosing scope:
+ *
+ * \code
+ * void Lvk::Nlp::Tree::getResponses(...)
+ * {
+ *     LVK_PROFILE("Tree::getResponses");
+ *     ...
+ * }
+ * \endcode
+ *
+ * Scopes are sampled per thread: one out of every sampleInterval() outermost scopes is recorded
+ * along with all the scopes nested in it, so sampled traces are complete. Events are stored in
+ * a ring buffer of each thread that keeps the last events only. exportChromeTrace() writes them
+ * in the Chrome trace event format, which can be opened with chrome://tracing.
+ *
+ * If sampling is disabled, scopes cost a single branch. If LVK_NO_TRACE is defined, scopes are
+ * removed at compile time.
+ *
+ * The sample interval is read from the application settings SETTING_PROFILER_SAMPLING by
+ * init(). By default sampling is disabled.
+ */
+class Profiler
+{
+public:
+
+    /**
+     * Reads the sample interval from the application settings
+     */
+    static void init();
+
+    /**
+     * Returns true if sampling is enabled. Otherwise; returns false.
+     */
+    static bool isEnabled()
+    {
+        return (int)m_sampleInterval != 0;
+    }
+
+    /**
+     * Sets the sample \a interval. One of every \a interval outermost scopes of each thread is
+     * recorded. 1 records every scope and 0 disables sampling.
+     */
+    static void setSampleInterval(int interval);
+
+    /**
+     * Returns the sample interval
+     */
+    static int sampleInterval();
+
+    /**
+     * Returns the events recorded so far by all threads in the Chrome trace event format
+     */
+    static QByteArray chromeTrace();
+
+    /**
+     * Writes the events recorded so far by all threads to \a filename in the Chrome trace event
+     * format. Returns true on success. Otherwise; returns false.
+     */
+    static bool exportChromeTrace(const QString &filename);
+
+    /**
+     * Discards the events recorded so far by all threads
+     */
+    static void clear();
+
+    /**
+     * Begins a scope and sets its \a start time. Returns true if the scope is recorded.
+     * Use LVK_PROFILE() instead.
+     */
+    static bool begin(qint64 &start);
+
+    /**
+     * Ends a scope named \a name started at \a start. \a name must be a string literal.
+     * Use LVK_PROFILE() instead.
+     */
+    static void end(const char *name, qint64 start, bool recorded);
+
+private:
+    Profiler();
+    Profiler(Profiler&);
+
+    static QAtomicInt m_sampleInterval;
+};
+
+/**
+ * \brief The ProfileScope class records the duration of a scope. Use LVK_PROFILE() instead.
+ */
+class ProfileScope
+{
+public:
+    ProfileScope(const char *name)
+        : m_name(name), m_start(0), m_active(Profiler::isEnabled()), m_recorded(false)
+    {
+        if (m_active) {
+            m_recorded = Profiler::begin(m_start);
+        }
+    }
+
+    ~ProfileScope()
+    {
+        // Ends the scope even if sampling was disabled meanwhile, so nesting stays balanced
+        if (m_active) {
+            Profiler::end(m_name, m_start, m_recorded);
+        }
+    }
+
+private:
+    ProfileScope(ProfileScope&);
+    ProfileScope& operator=(ProfileScope&);
+
+    const char *m_name;
+    qint64 m_start;
+    bool m_active;
+    bool m_recorded;
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#define LVK_PROFILE_CONCAT_(a, b)   a##b
+#define LVK_PROFILE_CONCAT(a, b)    LVK_PROFILE_CONCAT_(a, b)
+
+#ifdef LVK_NO_TRACE
+#  define LVK_PROFILE(name)
+#else
+#  define LVK_PROFILE(name)  \
+    Lvk::Cmn::ProfileScope LVK_PROFILE_CONCAT(lvkProfileScope, __LINE__)(name)
+#endif
+
+#endif // LVK_CMN_PROFILER_H
@@ -22,16 +22,48 @@
 #include "common/random.h"
 
 #include <QDateTime>
-#include <cstdlib>
+#include <QThread>
+#include <QThreadStorage>
 
-int Lvk::Cmn::Random::getInt(int min, int max)
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
 {
-    static unsigned int seed = 0;
 
-    if (!seed) {
-        seed = QDateTime::currentDateTime().toTime_t();
-        srand(seed);
+// State of the xorshift generator of each thread
+QThreadStorage<quint32 *> threadState;
+
+inline quint32 nextRandom()
+{
+    if (!threadState.hasLocalData()) {
+        // Threads started at the same time must not share the sequence
+        quint32 seed = (quint32)QDateTime::currentMSecsSinceEpoch()
+                ^ ((quint32)(quintptr)QThread::currentThreadId() * 2654435761u);
+
+        threadState.setLocalData(new quint32(seed ? seed : 2463534242u));
+    }
+
+    quint32 &x = *threadState.localData();
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return x;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Random
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::Random::getInt(int min, int max)
+{
+    if (max <= min) {
+        return min;
     }
 
-    return min + (int)(rand()/(double)(RAND_MAX - 1)*(max - min + 1));
+    return min + (int)(nextRandom() % ((quint32)(max - min) + 1));
 }
@@ -37,12 +37,16 @@ namespace Cmn
 
 /**
  * \brief The Random class generares random numbers.
+ *
+ * Each thread has its own xorshift generator seeded the first time it is used, hence
+ * getInt() is thread-safe and does not lock.
  */
 class Random
 {
 public:
     /**
-     * Returns a random integer between the range [min,max]
+     * Returns a random integer between the range [min,max]. If \a max is not greater than
+     * \a min, returns \a min.
      */
     static int getInt(int min, int max);
 
@@ -23,6 +23,10 @@
 #include "common/settings.h"
 #include "common/settingskeys.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
 #ifdef Q_WS_MAC
 #  define SETTINGS_FILENAME   "./chatbot.app/Contents/MacOS/chatbot.conf"
 #else
@@ -35,46 +39,231 @@
 #  define DEFAULT_LANG  "en_EN"
 #endif
 
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// System-wide default values for known keys. Add new defaults here.
+void initDefaults(QVariantHash &d)
+{
+    d.insert(SETTING_LOGS_PATH,                 QString("./logs"));
+    d.insert(SETTING_DATA_PATH,                 QString("./data"));
+    d.insert(SETTING_LANG_PATH,                 QString("./lang"));
+    d.insert(SETTING_CLUE_PATH,                 QString("./clue"));
+    d.insert(SETTING_CLUE_CHARS_FILE,           QString("characters.txt"));
+    d.insert(SETTING_APP_LANGUAGE,              QString(DEFAULT_LANG));
+    d.insert(SETTING_APP_SEND_STATS,            true);
+    d.insert(SETTING_APP_STATS_FLUSH_INTERVAL,  600);
+    d.insert(SETTING_APP_STATS_SAMPLE_RATE,     0.25);
+    d.insert(SETTING_NLP_LEMMA_CACHE_SIZE,      1000);
+    d.insert(SETTING_NLP_LEMMA_CACHE_PERSIST,   true);
+    d.insert(SETTING_NLP_LEMMA_WARM_UP_SIZE,    500);
+    d.insert(SETTING_NLP_ANALYSIS_PROFILE,      QString("full"));
+    d.insert(SETTING_NLP_MAX_SEARCH_STEPS,      200000);
+    d.insert(SETTING_NLP_RESPONSE_CACHE_SIZE,   4096);
+    d.insert(SETTING_NLP_TOPIC_TREES_MAX_NODES, 100000);
+    d.insert(SETTING_NLP_SESSION_TTL,           3600);
+    d.insert(SETTING_NLP_MIN_SIMILARITY,        0.0);
+    d.insert(SETTING_NLP_SHADOW_SAMPLE_RATE,    0.0);
+    d.insert(SETTING_NLP_SHADOW_PROPERTIES,     QString());
+    d.insert(SETTING_LOGS_ASYNC,                true);
+    d.insert(SETTING_JOURNAL_MAX_DELAY,         200);
+    d.insert(SETTING_JOURNAL_MAX_ENTRIES,       64);
+    d.insert(SETTING_JOURNAL_SYNC_POLICY,       0);
+    d.insert(SETTING_HISTORY_WINDOW_ENTRIES,    5000);
+    d.insert(SETTING_HISTORY_WINDOW_DAYS,       30);
+    d.insert(SETTING_CORPUS_MAX_SIZE,           4*1024*1024);
+    d.insert(SETTING_STATS_COUNT_MODE,          0);
+    d.insert(SETTING_XMPP_SEND_RATE,            5.0);
+    d.insert(SETTING_XMPP_SEND_BURST,           10);
+    d.insert(SETTING_XMPP_SHARD_COUNT,          1);
+    d.insert(SETTING_XMPP_SHARD_INDEX,          0);
+    d.insert(SETTING_XMPP_RECV_RATE,            1.0);
+    d.insert(SETTING_XMPP_RECV_BURST,           10);
+    d.insert(SETTING_XMPP_DUPLICATE_WINDOW,     10000);
+    d.insert(SETTING_XMPP_MAX_MESSAGE_LENGTH,   2000);
+    d.insert(SETTING_XMPP_SHED_THRESHOLD,       192);
+    d.insert(SETTING_MAIN_WINDOW_TEST_MAX_ENTRIES, 2000);
+    d.insert(SETTING_UPLOAD_COMPRESS,           false);
+    d.insert(SETTING_UPLOAD_DEDUP,              false);
+    d.insert(SETTING_HTTP_ENDPOINT_PORT,        0);
+    d.insert(SETTING_HTTP_ENDPOINT_METRICS,     false);
+    d.insert(SETTING_AUTH_TOKEN_LIFETIME,       24*3600);
+    d.insert(SETTING_PROFILER_SAMPLING,         0);
+    d.insert(SETTING_STARTUP_BUDGET,            3000);
+    d.insert(SETTING_MEMORY_BUDGET,             0);
+    d.insert(SETTING_MEMORY_MIN_AVAILABLE,      0);
+    d.insert(SETTING_MEMORY_CHECK_INTERVAL,     30);
+    d.insert(SETTING_MAINTENANCE_CHECK_INTERVAL, 5);
+    d.insert(SETTING_MAINTENANCE_IDLE_DELAY,    2);
+    d.insert(SETTING_MAINTENANCE_BUDGET,        200);
+    d.insert(SETTING_MAINTENANCE_MAX_DEFERRAL,  300);
+    d.insert(SETTING_SCHEDULER_THREADS,         0);
+    d.insert(SETTING_SCHEDULER_REPLY_RESERVE,   1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+struct Defaults
+{
+    Defaults() { initDefaults(values); }
+
+    QVariantHash values;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+struct SnapshotRegistry
+{
+    SnapshotRegistry() : loaded(false) { }
+
+    QMutex mutex;
+    Lvk::Cmn::SettingsSnapshot snapshot;
+    bool loaded;
+};
+
+Q_GLOBAL_STATIC(Defaults, defaults)
+Q_GLOBAL_STATIC(SnapshotRegistry, registry)
+Q_GLOBAL_STATIC(Lvk::Cmn::SettingsNotifier, settingsNotifier)
+
+//--------------------------------------------------------------------------------------------------
+
+// Reads all keys of the local settings file
+QVariantHash readSettingsFile()
+{
+    QSettings settings(SETTINGS_FILENAME, QSettings::IniFormat);
+    QVariantHash values;
+
+    foreach (const QString &key, settings.allKeys()) {
+        values.insert(key, settings.value(key));
+    }
+
+    return values;
+}
+
+} // namespace
+
+
 //--------------------------------------------------------------------------------------------------
 // Settings
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Cmn::Settings::Settings(QObject *parent)
-    : QSettings(SETTINGS_FILENAME, QSettings::IniFormat, parent)
+    : QSettings(SETTINGS_FILENAME, QSettings::IniFormat, parent),
+      m_userScope(false)
 {
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Cmn::Settings::Settings(UserScope, QObject *parent)
-    : QSettings(ORGANIZATION_NAME, APP_NAME, parent)
+    : QSettings(ORGANIZATION_NAME, APP_NAME, parent),
+      m_userScope(true)
 {
 }
 
 //--------------------------------------------------------------------------------------------------
 
-QVariant Lvk::Cmn::Settings::value(const QString &key, const QVariant &defaultValue_) const
+QVariant Lvk::Cmn::Settings::value(const QString &key, const QVariant &defaultValue) const
 {
-    QVariant defaultValue = defaultValue_;
-
     if (defaultValue.isNull()) {
-        // Add here system-wide default values for known keys
-        if (key == SETTING_LOGS_PATH) {
-            defaultValue = QString("./logs");
-        } else if (key == SETTING_DATA_PATH) {
-            defaultValue = QString("./data");
-        } else if (key == SETTING_LANG_PATH) {
-            defaultValue = QString("./lang");
-        } else if (key == SETTING_CLUE_PATH) {
-            defaultValue = QString("./clue");
-        } else if (key == SETTING_CLUE_CHARS_FILE) {
-            defaultValue = QString("characters.txt");
-        } else if (key == SETTING_APP_LANGUAGE) {
-            defaultValue = QString(DEFAULT_LANG);
-        } else if (key == SETTING_APP_SEND_STATS) {
-            defaultValue = true;
-        }
+        return QSettings::value(key, defaults()->values.value(key));
     }
 
     return QSettings::value(key, defaultValue);
 }
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Settings::setValue(const QString &key, const QVariant &value)
+{
+    QSettings::setValue(key, value);
+
+    if (!m_userScope) {
+        SettingsSnapshot::update(key, value);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// SettingsSnapshot
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::SettingsSnapshot::SettingsSnapshot()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::SettingsSnapshot Lvk::Cmn::SettingsSnapshot::current()
+{
+    SnapshotRegistry *r = registry();
+
+    QMutexLocker locker(&r->mutex);
+
+    if (!r->loaded) {
+        r->snapshot.m_values = readSettingsFile();
+        r->loaded = true;
+    }
+
+    return r->snapshot;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::SettingsSnapshot::reload()
+{
+    // Read without holding the lock, readers keep using the previous snapshot meanwhile
+    QVariantHash values = readSettingsFile();
+
+    {
+        SnapshotRegistry *r = registry();
+
+        QMutexLocker locker(&r->mutex);
+
+        r->snapshot.m_values = values;
+        r->loaded = true;
+    }
+
+    emit notifier()->changed();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::SettingsSnapshot::update(const QString &key, const QVariant &value)
+{
+    current();
+
+    {
+        SnapshotRegistry *r = registry();
+
+        QMutexLocker locker(&r->mutex);
+
+        r->snapshot.m_values.insert(key, value);
+    }
+
+    emit notifier()->changed();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::SettingsNotifier * Lvk::Cmn::SettingsSnapshot::notifier()
+{
+    return settingsNotifier();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariant Lvk::Cmn::SettingsSnapshot::value(const QString &key, const QVariant &defaultValue) const
+{
+    QVariantHash::const_iterator it = m_values.find(key);
+
+    if (it != m_values.constEnd()) {
+        return *it;
+    }
+
+    return defaultValue.isNull() ? defaults()->values.value(key) : defaultValue;
+}
@@ -23,6 +23,7 @@
 #define LVK_CMN_SETTINGS_H
 
 #include <QSettings>
+#include <QVariantHash>
 
 namespace Lvk
 {
@@ -40,7 +41,8 @@ namespace Cmn
 /**
  * \brief The Settings class provides persistent platform-independent application settings.
  *
- * Settings is a thin wrapper over the QSettings class.
+ * Settings is a thin wrapper over the QSettings class. Every object reads the settings file,
+ * hence code that only reads settings should use SettingsSnapshot instead.
  */
 class Settings : public QSettings
 {
@@ -69,6 +71,120 @@ public:
      * Returns the value for the given key. If the key doesn't exist, returns defaultValue.
      */
     virtual QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+
+    /**
+     * Sets the value of \a key to \a value. If the object has local scope, the current
+     * SettingsSnapshot is updated too.
+     */
+    void setValue(const QString &key, const QVariant &value);
+
+private:
+    bool m_userScope;
+};
+
+/**
+ * \brief The SettingsNotifier class emits a signal whenever the current settings snapshot
+ *        changes. \see SettingsSnapshot::notifier()
+ */
+class SettingsNotifier : public QObject
+{
+    Q_OBJECT
+
+public:
+    SettingsNotifier(QObject *parent = 0) : QObject(parent) { }
+
+signals:
+
+    /**
+     * This signal is emitted after the current settings snapshot has changed.
+     */
+    void changed();
+
+private:
+    friend class SettingsSnapshot;
+};
+
+/**
+ * \brief The SettingsSnapshot class provides an immutable copy of the local application
+ *        settings.
+ *
+ * The settings file is read once, the first time current() is invoked. Afterwards reading a
+ * setting is a hash lookup, so hot paths and engine construction never touch the settings
+ * file. Default values of known keys are included in the snapshot.
+ *
+ * Values written with Settings::setValue() are applied to the current snapshot. Changes made
+ * to the file by other processes are only read by reload(). In both cases notifier() emits
+ * changed(), objects that cache settings should connect to it.
+ *
+ * Snapshots are implicitly shared, hence copying them is cheap. This class is thread-safe.
+ */
+class SettingsSnapshot
+{
+public:
+
+    /**
+     * Constructs an empty snapshot. Only default values are returned. \see current()
+     */
+    SettingsSnapshot();
+
+    /**
+     * Returns the current snapshot of the settings.
+     */
+    static SettingsSnapshot current();
+
+    /**
+     * Reads the settings file again and emits SettingsNotifier::changed()
+     */
+    static void reload();
+
+    /**
+     * Returns the object that notifies changes of the current snapshot.
+     */
+    static SettingsNotifier *notifier();
+
+    /**
+     * Returns the value for the given key. If the key doesn't exist, returns defaultValue.
+     */
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+
+    /**
+     * Returns true if the settings file has the given key. Otherwise; returns false.
+     */
+    bool contains(const QString &key) const
+    {
+        return m_values.contains(key);
+    }
+
+    /**
+     * Returns the value for the given key as string.
+     */
+    QString stringValue(const QString &key) const
+    {
+        return value(key).toString();
+    }
+
+    /**
+     * Returns the value for the given key as integer, 0 if the value is not an integer.
+     */
+    int intValue(const QString &key) const
+    {
+        return value(key).toInt();
+    }
+
+    /**
+     * Returns the value for the given key as boolean.
+     */
+    bool boolValue(const QString &key) const
+    {
+        return value(key).toBool();
+    }
+
+private:
+    QVariantHash m_values;
+
+    static void update(const QString &key, const QVariant &value);
+
+    friend class Settings;
 };
 
 /// @}
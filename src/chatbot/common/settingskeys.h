@@ -24,13 +24,34 @@
 
 #define SETTING_APP_LANGUAGE                        "Application/Language"
 #define SETTING_APP_SEND_STATS                      "Application/SendStatistics"
+#define SETTING_APP_STATS_FLUSH_INTERVAL            "Application/StatisticsFlushInterval"
+#define SETTING_APP_STATS_SAMPLE_RATE               "Application/StatisticsSampleRate"
+#define SETTING_TRACE_CATEGORIES                    "Application/TraceCategories"
+#define SETTING_PROFILER_SAMPLING                   "Application/ProfilerSampling"
+#define SETTING_STARTUP_BUDGET                      "Application/StartupBudget"
+#define SETTING_MEMORY_BUDGET                       "Application/MemoryBudget"
+#define SETTING_MEMORY_MIN_AVAILABLE                "Application/MemoryMinAvailable"
+#define SETTING_MEMORY_CHECK_INTERVAL               "Application/MemoryCheckInterval"
+#define SETTING_MAINTENANCE_CHECK_INTERVAL          "Application/MaintenanceCheckInterval"
+#define SETTING_MAINTENANCE_IDLE_DELAY              "Application/MaintenanceIdleDelay"
+#define SETTING_MAINTENANCE_BUDGET                  "Application/MaintenanceBudget"
+#define SETTING_MAINTENANCE_MAX_DEFERRAL            "Application/MaintenanceMaxDeferral"
+#define SETTING_SCHEDULER_THREADS                   "Application/SchedulerThreads"
+#define SETTING_SCHEDULER_REPLY_RESERVE             "Application/SchedulerReplyReserve"
 
 #define SETTING_LAST_FILE                           "Files/LastClueFile"
 #define SETTING_LOGS_PATH                           "Files/LogsPath"
+#define SETTING_LOGS_ASYNC                          "Files/AsyncLogs"
 #define SETTING_DATA_PATH                           "Files/DataPath"
 #define SETTING_LANG_PATH                           "Files/LangPath"
 #define SETTING_CLUE_PATH                           "Files/CluePath"
 #define SETTING_CLUE_CHARS_FILE                     "Files/CharactersFile"
+#define SETTING_JOURNAL_MAX_DELAY                   "Files/JournalMaxDelay"
+#define SETTING_JOURNAL_MAX_ENTRIES                 "Files/JournalMaxEntries"
+#define SETTING_JOURNAL_SYNC_POLICY                 "Files/JournalSyncPolicy"
+#define SETTING_HISTORY_WINDOW_ENTRIES              "Files/HistoryWindowEntries"
+#define SETTING_HISTORY_WINDOW_DAYS                 "Files/HistoryWindowDays"
+#define SETTING_CORPUS_MAX_SIZE                     "Files/CorpusMaxSize"
 
 #define SETTING_MAIN_WINDOW_SIZE                    "MainWindow/Size"
 #define SETTING_MAIN_WINDOW_POS                     "MainWindow/Position"
@@ -39,9 +60,45 @@
 #define SETTING_MAIN_WINDOW_TEST_TAB_W              "MainWindow/TestTabWidget/Width"
 #define SETTING_MAIN_WINDOW_RULE_TREE_W             "MainWindow/RuleTreeWidget/Width"
 #define SETTING_MAIN_WINDOW_RULE_EDIT_W             "MainWindow/RuleEditWidget/Width"
+#define SETTING_MAIN_WINDOW_TEST_MAX_ENTRIES        "MainWindow/TestConversationWidget/MaxEntries"
 
 #define SETTING_NLP_LANGUAGE                        "NlpEngine/Language"
+#define SETTING_NLP_LEMMA_CACHE_SIZE                "NlpEngine/LemmaCacheSize"
+#define SETTING_NLP_LEMMA_POOL_SIZE                 "NlpEngine/LemmaPoolSize"
+#define SETTING_NLP_MAX_SEARCH_STEPS                "NlpEngine/MaxSearchSteps"
+#define SETTING_NLP_LEMMA_TABLE                     "NlpEngine/LemmaTable"
+#define SETTING_NLP_LEMMA_CACHE_PERSIST             "NlpEngine/LemmaCachePersist"
+#define SETTING_NLP_LEMMA_WARM_UP_SIZE              "NlpEngine/LemmaWarmUpSize"
+#define SETTING_NLP_ANALYSIS_PROFILE                "NlpEngine/AnalysisProfile"
+#define SETTING_NLP_RESPONSE_CACHE_SIZE             "NlpEngine/ResponseCacheSize"
+#define SETTING_NLP_TOPIC_TREES_MAX_NODES           "NlpEngine/TopicTreesMaxNodes"
+#define SETTING_NLP_SESSION_TTL                     "NlpEngine/SessionTtl"
+#define SETTING_NLP_SHARED_SNAPSHOTS_PATH           "NlpEngine/SharedSnapshotsPath"
+#define SETTING_NLP_MIN_SIMILARITY                  "NlpEngine/MinSimilarity"
+#define SETTING_NLP_SHADOW_SAMPLE_RATE              "NlpEngine/ShadowSampleRate"
+#define SETTING_NLP_SHADOW_PROPERTIES               "NlpEngine/ShadowProperties"
+
+#define SETTING_XMPP_SEND_RATE                      "Xmpp/SendRate"
+#define SETTING_XMPP_SEND_BURST                     "Xmpp/SendBurst"
+#define SETTING_XMPP_SHARD_COUNT                    "Xmpp/ShardCount"
+#define SETTING_XMPP_SHARD_INDEX                    "Xmpp/ShardIndex"
+#define SETTING_XMPP_RECV_RATE                      "Xmpp/RecvRate"
+#define SETTING_XMPP_RECV_BURST                     "Xmpp/RecvBurst"
+#define SETTING_XMPP_DUPLICATE_WINDOW               "Xmpp/DuplicateWindow"
+#define SETTING_XMPP_MAX_MESSAGE_LENGTH             "Xmpp/MaxMessageLength"
+#define SETTING_XMPP_SHED_THRESHOLD                 "Xmpp/ShedThreshold"
+
+#define SETTING_UPLOAD_COMPRESS                     "Upload/Compress"
+#define SETTING_UPLOAD_DEDUP                        "Upload/Dedup"
+
+#define SETTING_HTTP_ENDPOINT_PORT                  "HttpEndpoint/Port"
+#define SETTING_HTTP_ENDPOINT_METRICS               "HttpEndpoint/Metrics"
+
+#define SETTING_AUTH_TOKENS                         "Auth/Tokens"
+#define SETTING_AUTH_TOKEN_LIFETIME                 "Auth/TokenLifetime"
 
 #define SETTING_CLUE_WIDGET_COLS_W                  "Clue/Columns/Width"
 
+#define SETTING_STATS_COUNT_MODE                    "Stats/CountMode"
+
 #endif // LVK_CMN_SETTINGSKEYS_H
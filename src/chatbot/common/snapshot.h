@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_SNAPSHOT_H
+#define LVK_CMN_SNAPSHOT_H
+
+#include <QAtomicPointer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The Snapshot class provides a read-mostly value that is published atomically.
+ *
+ * Readers get the current value with a Snapshot::Reader without taking any lock. Writers
+ * never modify the published value, instead they publish() a new one. The old value is
+ * deleted once there are no readers left, i.e. in the next call to publish() or when the
+ * Snapshot is destroyed.
+ *
+ * Use this class for configuration that is read on every message but changes rarely.
+ * Values must not be modified after being published.
+ *
+ * This class is thread-safe.
+ */
+template<class T>
+class Snapshot
+{
+public:
+
+    /**
+     * \brief The Reader class provides access to the value published when it was constructed.
+     *
+     * Readers must be short-lived, published values are not deleted while any reader exists.
+     */
+    class Reader
+    {
+    public:
+
+        /**
+         * Constructs a Reader of the current value of \a snapshot.
+         */
+        Reader(const Snapshot<T> &snapshot)
+            : m_snapshot(snapshot)
+        {
+            m_snapshot.m_readers.ref();
+            m_value = m_snapshot.m_value.fetchAndAddOrdered(0);
+        }
+
+        /**
+         * Destroys the object.
+         */
+        ~Reader()
+        {
+            m_snapshot.m_readers.deref();
+        }
+
+        /**
+         * Returns the value. The value can be null.
+         */
+        T *get() const
+        {
+            return m_value;
+        }
+
+        /**
+         * Returns the value. The value must not be null.
+         */
+        T *operator->() const
+        {
+            return m_value;
+        }
+
+        /**
+         * Returns the value. The value must not be null.
+         */
+        T &operator*() const
+        {
+            return *m_value;
+        }
+
+    private:
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+
+        const Snapshot<T> &m_snapshot;
+        T *m_value;
+    };
+
+    /**
+     * Constructs a Snapshot with \a value and takes ownership of it.
+     */
+    Snapshot(T *value = 0)
+        : m_value(value), m_readers(0)
+    {
+    }
+
+    /**
+     * Destroys the object and all values that were published.
+     */
+    ~Snapshot()
+    {
+        qDeleteAll(m_retired);
+        delete m_value.fetchAndStoreOrdered(0);
+    }
+
+    /**
+     * Publishes \a value and takes ownership of it. Readers constructed after this call get
+     * \a value, current readers keep using the previous value.
+     */
+    void publish(T *value)
+    {
+        QMutexLocker locker(&m_writeMutex);
+
+        T *old = m_value.fetchAndStoreOrdered(value);
+        if (old) {
+            m_retired.append(old);
+        }
+
+        // Readers increment the counter before loading the pointer. If there are no readers
+        // now, nobody can hold a retired value.
+        if (m_readers.fetchAndAddOrdered(0) == 0) {
+            qDeleteAll(m_retired);
+            m_retired.clear();
+        }
+    }
+
+private:
+    Snapshot(const Snapshot&);
+    Snapshot& operator=(const Snapshot&);
+
+    mutable QAtomicPointer<T> m_value;
+    mutable QAtomicInt m_readers;
+    QList<T *> m_retired;
+    QMutex m_writeMutex;
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_CMN_SNAPSHOT_H
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "common/startuptimeline.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Timeline
+{
+    Timeline() : active(false), total(0) { }
+
+    QMutex mutex;
+    QElapsedTimer clock;
+    bool active;
+    qint64 total;
+    QList<Lvk::Cmn::StartupTimeline::Phase> phases;
+};
+
+Q_GLOBAL_STATIC(Timeline, timeline)
+
+//--------------------------------------------------------------------------------------------------
+
+bool startsBefore(const Lvk::Cmn::StartupTimeline::Phase &p1,
+                  const Lvk::Cmn::StartupTimeline::Phase &p2)
+{
+    return p1.start < p2.start;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// StartupTimeline
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::StartupTimeline::start()
+{
+    QMutexLocker locker(&timeline()->mutex);
+
+    timeline()->clock.start();
+    timeline()->active = true;
+    timeline()->total = 0;
+    timeline()->phases.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::StartupTimeline::isActive()
+{
+    QMutexLocker locker(&timeline()->mutex);
+
+    return timeline()->active;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Cmn::StartupTimeline::elapsed()
+{
+    QMutexLocker locker(&timeline()->mutex);
+
+    return timeline()->clock.isValid() ? timeline()->clock.elapsed() : -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::StartupTimeline::addPhase(const QString &name, qint64 start, qint64 duration)
+{
+    QMutexLocker locker(&timeline()->mutex);
+
+    if (timeline()->active) {
+        timeline()->phases.append(Phase(name, start, duration));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::StartupTimeline::finish()
+{
+    {
+        QMutexLocker locker(&timeline()->mutex);
+
+        if (!timeline()->active) {
+            return false;
+        }
+
+        timeline()->active = false;
+        timeline()->total = timeline()->clock.elapsed();
+    }
+
+    qint64 total = totalTime();
+    qint64 maxTime = budget();
+
+    if (maxTime > 0 && total > maxTime) {
+        qWarning() << "Startup took" << total << "ms, over the budget of" << maxTime << "ms\n"
+                   << qPrintable(report());
+    } else {
+        qDebug() << "Startup took" << total << "ms\n" << qPrintable(report());
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QList<Lvk::Cmn::StartupTimeline::Phase> Lvk::Cmn::StartupTimeline::phases()
+{
+    QMutexLocker locker(&timeline()->mutex);
+
+    return timeline()->phases;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Cmn::StartupTimeline::totalTime()
+{
+    QMutexLocker locker(&timeline()->mutex);
+
+    return timeline()->active ? timeline()->clock.elapsed() : timeline()->total;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Cmn::StartupTimeline::budget()
+{
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+
+    return qMax<qint64>(0, settings.value(SETTING_STARTUP_BUDGET).toLongLong());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Cmn::StartupTimeline::toVariantMap()
+{
+    QVariantMap map;
+
+    foreach (const Phase &phase, phases()) {
+        map[phase.name] = map.value(phase.name).toLongLong() + phase.duration;
+    }
+
+    map["total"] = totalTime();
+    map["budget"] = budget();
+
+    return map;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Cmn::StartupTimeline::report()
+{
+    QStringList lines;
+
+    // Nested phases end first but they are listed after the enclosing phase
+    QList<Phase> sorted = phases();
+    qStableSort(sorted.begin(), sorted.end(), startsBefore);
+
+    foreach (const Phase &phase, sorted) {
+        lines.append(QString("  %1 ms +%2 ms %3").arg(phase.start, 6)
+                                                 .arg(phase.duration, 6)
+                                                 .arg(phase.name));
+    }
+
+    return lines.join("\n");
+}
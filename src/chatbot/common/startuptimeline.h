@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_CMN_STARTUPTIMELINE_H
+#define LVK_CMN_STARTUPTIMELINE_H
+
+#include <QString>
+#include <QList>
+#include <QVariantMap>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The StartupTimeline class provides the time spent in each phase of the application
+ *        startup
+ *
+ * The timeline starts with start() at the entry point. Startup phases are timed with the
+ * LVK_STARTUP_PHASE() macro, which records the duration of the enclosing scope:
+ *
+ * \code
+ * void Lvk::CA::HistoryHelper::load()
+ * {
+ *     LVK_STARTUP_PHASE("history_load");
+ *     ...
+ * }
+ * \endcode
+ *
+ * finish() ends the timeline and writes the report to the log. The report is a warning if the
+ * total time exceeds the budget SETTING_STARTUP_BUDGET. Phases ended after finish() are not
+ * recorded, so the code shared with later operations such as opening another file adds no
+ * phases.
+ *
+ * All methods are thread-safe.
+ */
+class StartupTimeline
+{
+public:
+
+    /**
+     * \brief The Phase struct provides the time spent in a startup phase
+     */
+    struct Phase
+    {
+        Phase(const QString &name = QString(), qint64 start = 0, qint64 duration = 0)
+            : name(name), start(start), duration(duration) { }
+
+        QString name;           ///< Phase name
+        qint64 start;           ///< Milliseconds since the timeline started
+        qint64 duration;        ///< Milliseconds
+    };
+
+    /**
+     * Starts the timeline. Phases recorded so far are discarded.
+     */
+    static void start();
+
+    /**
+     * Returns true if the timeline has started and not finished yet. Otherwise; returns false.
+     */
+    static bool isActive();
+
+    /**
+     * Returns the milliseconds elapsed since the timeline started or -1 if it never started.
+     */
+    static qint64 elapsed();
+
+    /**
+     * Records the phase \a name that started \a start milliseconds after the timeline and
+     * lasted \a duration milliseconds. Does nothing if the timeline is not active.
+     */
+    static void addPhase(const QString &name, qint64 start, qint64 duration);
+
+    /**
+     * Finishes the timeline and writes the report to the log. Returns true if the timeline
+     * was active. Otherwise; returns false and does nothing.
+     */
+    static bool finish();
+
+    /**
+     * Returns the recorded phases in the order they ended
+     */
+    static QList<Phase> phases();
+
+    /**
+     * Returns the total startup time in milliseconds. If the timeline is active, returns the
+     * elapsed time.
+     */
+    static qint64 totalTime();
+
+    /**
+     * Returns the startup budget in milliseconds or 0 if there is no budget
+     */
+    static qint64 budget();
+
+    /**
+     * Returns the timeline as a map with the total time of each phase name, the total startup
+     * time "total" and the budget "budget", all in milliseconds.
+     */
+    static QVariantMap toVariantMap();
+
+    /**
+     * Returns a human-readable report with one line per phase, sorted by start time
+     */
+    static QString report();
+
+private:
+    StartupTimeline();
+    StartupTimeline(StartupTimeline&);
+};
+
+/**
+ * \brief The StartupPhase class records the duration of a startup phase.
+ *        Use LVK_STARTUP_PHASE() instead.
+ */
+class StartupPhase
+{
+public:
+    StartupPhase(const char *name)
+        : m_name(name), m_start(StartupTimeline::isActive() ? StartupTimeline::elapsed() : -1)
+    { }
+
+    ~StartupPhase()
+    {
+        if (m_start != -1) {
+            StartupTimeline::addPhase(m_name, m_start, StartupTimeline::elapsed() - m_start);
+        }
+    }
+
+private:
+    StartupPhase(StartupPhase&);
+    StartupPhase& operator=(StartupPhase&);
+
+    const char *m_name;
+    qint64 m_start;
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#define LVK_STARTUP_PHASE_CONCAT_(a, b)   a##b
+#define LVK_STARTUP_PHASE_CONCAT(a, b)    LVK_STARTUP_PHASE_CONCAT_(a, b)
+
+#define LVK_STARTUP_PHASE(name)  \
+    Lvk::Cmn::StartupPhase LVK_STARTUP_PHASE_CONCAT(lvkStartupPhase, __LINE__)(name)
+
+#endif // LVK_CMN_STARTUPTIMELINE_H
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/taskscheduler.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThread>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const char *CLASS_NAMES[] = { "reply", "preview", "build", "background" };
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// TaskScheduler::Worker
+//--------------------------------------------------------------------------------------------------
+
+class Lvk::Cmn::TaskScheduler::Worker : public QThread
+{
+public:
+    Worker(TaskScheduler *scheduler) : m_scheduler(scheduler) { }
+
+protected:
+    void run()
+    {
+        QMutexLocker locker(m_scheduler->m_mutex);
+
+        forever {
+            Entry e;
+            int priority;
+
+            while (!m_scheduler->next(e, priority)) {
+                if (m_scheduler->m_stopped) {
+                    return;
+                }
+                ++m_scheduler->m_idle;
+                m_scheduler->m_workCond->wait(m_scheduler->m_mutex);
+                --m_scheduler->m_idle;
+            }
+
+            locker.unlock();
+
+            bool autoDelete = e.task->autoDelete();
+            e.task->run();
+            if (autoDelete) {
+                delete e.task;
+            }
+
+            locker.relock();
+
+            m_scheduler->finished(e, priority);
+        }
+    }
+
+private:
+    TaskScheduler *m_scheduler;
+};
+
+//--------------------------------------------------------------------------------------------------
+// TaskScheduler
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::TaskScheduler * Lvk::Cmn::TaskScheduler::m_scheduler = 0;
+QMutex *                  Lvk::Cmn::TaskScheduler::m_schedMutex = new QMutex();
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::TaskScheduler::TaskScheduler(int threads /*= 0*/, int replyReserve /*= 1*/)
+    : m_mutex(new QMutex()),
+      m_workCond(new QWaitCondition()),
+      m_doneCond(new QWaitCondition()),
+      m_threads(0),
+      m_replyReserve(0),
+      m_idle(0),
+      m_stopped(false)
+{
+    for (int i = 0; i < PriorityCount; ++i) {
+        m_running[i] = 0;
+        m_finished[i] = 0;
+    }
+
+    setThreadCount(threads);
+    setReplyReserve(replyReserve);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::TaskScheduler::~TaskScheduler()
+{
+    waitForDone();
+
+    {
+        QMutexLocker locker(m_mutex);
+        m_stopped = true;
+        m_workCond->wakeAll();
+    }
+
+    foreach (Worker *w, m_workers) {
+        w->wait();
+    }
+
+    qDeleteAll(m_workers);
+
+    delete m_doneCond;
+    delete m_workCond;
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::TaskScheduler * Lvk::Cmn::TaskScheduler::scheduler()
+{
+    if (!m_scheduler) {
+        QMutexLocker locker(m_schedMutex);
+        if (!m_scheduler) {
+            // Never destroyed, static objects may wait for their tasks on exit
+            m_scheduler = new TaskScheduler();
+        }
+    }
+
+    return m_scheduler;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::TaskScheduler::init()
+{
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+
+    TaskScheduler *sched = scheduler();
+    sched->setThreadCount(settings.intValue(SETTING_SCHEDULER_THREADS));
+    sched->setReplyReserve(settings.intValue(SETTING_SCHEDULER_REPLY_RESERVE));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::TaskScheduler::setThreadCount(int threads)
+{
+    if (threads <= 0) {
+        threads = QThread::idealThreadCount();
+    }
+
+    QMutexLocker locker(m_mutex);
+
+    // Extra workers already started stay idle
+    m_threads = qMax(2, threads);
+    m_workCond->wakeAll();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::TaskScheduler::threadCount() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_threads;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::TaskScheduler::setReplyReserve(int workers)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_replyReserve = qMax(0, workers);
+    m_workCond->wakeAll();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::TaskScheduler::start(QRunnable *task, Priority priority,
+                                    const void *owner /*= 0*/)
+{
+    Entry e;
+    e.task = task;
+    e.owner = owner;
+
+    QMutexLocker locker(m_mutex);
+
+    m_queues[priority].enqueue(e);
+
+    if (owner) {
+        ++m_owned[owner];
+    }
+
+    if (m_idle > 0) {
+        m_workCond->wakeOne();
+    } else if (m_workers.size() < m_threads) {
+        Worker *w = new Worker(this);
+        m_workers.append(w);
+        w->start();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::TaskScheduler::waitForDone(const void *owner /*= 0*/)
+{
+    QMutexLocker locker(m_mutex);
+
+    forever {
+        int pending = 0;
+
+        if (owner) {
+            pending = m_owned.value(owner);
+        } else {
+            for (int i = 0; i < PriorityCount; ++i) {
+                pending += m_queues[i].size() + m_running[i];
+            }
+        }
+
+        if (pending == 0) {
+            break;
+        }
+
+        m_doneCond->wait(m_mutex);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::TaskScheduler::pending(Priority priority) const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_queues[priority].size() + m_running[priority];
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Cmn::TaskScheduler::stats() const
+{
+    QMutexLocker locker(m_mutex);
+
+    QVariantMap stats;
+    stats["threads"] = m_threads;
+    stats["workers"] = m_workers.size();
+
+    for (int i = 0; i < PriorityCount; ++i) {
+        QString name = CLASS_NAMES[i];
+        stats[name + "_queued"] = m_queues[i].size();
+        stats[name + "_running"] = m_running[i];
+        stats[name + "_finished"] = m_finished[i];
+    }
+
+    return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Called with m_mutex locked
+bool Lvk::Cmn::TaskScheduler::canRun(int priority) const
+{
+    int running = 0;
+    for (int i = 0; i < PriorityCount; ++i) {
+        running += m_running[i];
+    }
+
+    if (running >= m_threads) {
+        return false;
+    }
+    if (priority == Reply) {
+        return true;
+    }
+
+    // Workers not reserved for replies
+    int shared = qMax(1, m_threads - m_replyReserve);
+
+    if (running - m_running[Reply] >= shared) {
+        return false;
+    }
+    if (priority == Background) {
+        return m_running[Background] < qMax(1, shared/2);
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Called with m_mutex locked. Takes the oldest task of the highest class that can run.
+bool Lvk::Cmn::TaskScheduler::next(Entry &e, int &priority)
+{
+    for (int i = 0; i < PriorityCount; ++i) {
+        if (!m_queues[i].isEmpty() && canRun(i)) {
+            e = m_queues[i].dequeue();
+            priority = i;
+            ++m_running[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Called with m_mutex locked. The worker looks for its next task right after, so it takes
+// the slot released by this task.
+void Lvk::Cmn::TaskScheduler::finished(const Entry &e, int priority)
+{
+    --m_running[priority];
+    ++m_finished[priority];
+
+    if (e.owner && --m_owned[e.owner] == 0) {
+        m_owned.remove(e.owner);
+    }
+
+    m_doneCond->wakeAll();
+}
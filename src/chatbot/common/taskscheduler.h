@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_TASKSCHEDULER_H
+#define LVK_CMN_TASKSCHEDULER_H
+
+#include <QList>
+#include <QQueue>
+#include <QHash>
+#include <QRunnable>
+#include <QVariantMap>
+#include <QtConcurrentRun>
+
+class QMutex;
+class QWaitCondition;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The TaskScheduler class runs the background work of the application in a shared set
+ *        of worker threads with priority classes
+ *
+ * Each task belongs to a priority class. Workers always run the oldest task of the highest
+ * class that can run, so lower classes yield to higher ones at task boundaries. Running tasks
+ * are never interrupted, long tasks should be split.
+ *
+ * To keep the latency of replies low, no class but Reply can take the reserved workers, and
+ * Background tasks take at most half of the remaining workers. Workers are started on demand
+ * up to the thread count.
+ *
+ * Tasks can be tagged with an owner, usually the object they point to, so the owner can wait
+ * for its tasks before it is destroyed.
+ *
+ * The thread count and the reserved workers are read from the application settings
+ * SETTING_SCHEDULER_THREADS and SETTING_SCHEDULER_REPLY_RESERVE by init().
+ *
+ * TaskScheduler is thread-safe.
+ */
+class TaskScheduler
+{
+public:
+
+    /**
+     * Priority classes, higher first
+     */
+    enum Priority {
+        Reply,          ///< Replies to chat messages and HTTP requests
+        Preview,        ///< Interactive previews such as the test tab
+        Build,          ///< Rebuilds and reloads of the NLP engine
+        Background,     ///< Analysis and maintenance
+        PriorityCount
+    };
+
+    /**
+     * Returns the singleton instance.
+     */
+    static TaskScheduler *scheduler();
+
+    /**
+     * Reads the thread count and the reserved workers of the singleton instance from the
+     * application settings.
+     */
+    static void init();
+
+    /**
+     * Constructs a TaskScheduler with at most \a threads workers and \a replyReserve workers
+     * reserved for replies. If \a threads is zero, the ideal thread count is used.
+     */
+    explicit TaskScheduler(int threads = 0, int replyReserve = 1);
+
+    /**
+     * Destroys the object. Waits for all tasks.
+     */
+    ~TaskScheduler();
+
+    /**
+     * Sets the max amount of workers to \a threads. If \a threads is zero, the ideal thread
+     * count is used. At least two workers are used so replies always have one.
+     */
+    void setThreadCount(int threads);
+
+    /**
+     * Returns the max amount of workers.
+     */
+    int threadCount() const;
+
+    /**
+     * Sets the amount of workers reserved for replies to \a workers.
+     */
+    void setReplyReserve(int workers);
+
+    /**
+     * Schedules \a task with \a priority. If \a task is auto-deleted, the scheduler takes
+     * ownership of it. \a owner is an optional tag for waitForDone().
+     */
+    void start(QRunnable *task, Priority priority, const void *owner = 0);
+
+    /**
+     * Runs \a fn(\a arg1, ...) with \a priority like QtConcurrent::run() and returns its
+     * future.
+     */
+    template <typename T>
+    QFuture<T> run(Priority priority, T (*fn)())
+    {
+        return startFuture(new typename QtConcurrent::SelectStoredFunctorCall0<T, T (*)()>
+                     ::type(fn), priority);
+    }
+
+    /// \copydoc run(Priority, T (*)())
+    template <typename T, typename P1, typename A1>
+    QFuture<T> run(Priority priority, T (*fn)(P1), const A1 &arg1)
+    {
+        return startFuture(new typename QtConcurrent::SelectStoredFunctorCall1<T, T (*)(P1), A1>
+                     ::type(fn, arg1), priority);
+    }
+
+    /// \copydoc run(Priority, T (*)())
+    template <typename T, typename P1, typename A1, typename P2, typename A2>
+    QFuture<T> run(Priority priority, T (*fn)(P1, P2), const A1 &arg1, const A2 &arg2)
+    {
+        return startFuture(new typename QtConcurrent::SelectStoredFunctorCall2<T, T (*)(P1, P2),
+                     A1, A2>::type(fn, arg1, arg2), priority);
+    }
+
+    /// \copydoc run(Priority, T (*)())
+    template <typename T, typename P1, typename A1, typename P2, typename A2, typename P3,
+              typename A3>
+    QFuture<T> run(Priority priority, T (*fn)(P1, P2, P3), const A1 &arg1, const A2 &arg2,
+                   const A3 &arg3)
+    {
+        return startFuture(new typename QtConcurrent::SelectStoredFunctorCall3<T, T (*)(P1, P2, P3),
+                     A1, A2, A3>::type(fn, arg1, arg2, arg3), priority);
+    }
+
+    /// \copydoc run(Priority, T (*)())
+    template <typename T, typename P1, typename A1, typename P2, typename A2, typename P3,
+              typename A3, typename P4, typename A4>
+    QFuture<T> run(Priority priority, T (*fn)(P1, P2, P3, P4), const A1 &arg1,
+                   const A2 &arg2, const A3 &arg3, const A4 &arg4)
+    {
+        return startFuture(new typename QtConcurrent::SelectStoredFunctorCall4<T,
+                     T (*)(P1, P2, P3, P4), A1, A2, A3, A4>::type(fn, arg1, arg2, arg3, arg4),
+                     priority);
+    }
+
+    /**
+     * Runs \a object->\a fn() with \a priority and returns its future. The task is tagged
+     * with \a object as owner.
+     */
+    template <typename T, typename Class>
+    QFuture<T> run(Priority priority, Class *object, T (Class::*fn)())
+    {
+        return startFuture(new typename QtConcurrent::SelectStoredMemberFunctionPointerCall0<T,
+                           Class>::type(fn, object), priority, object);
+    }
+
+    /**
+     * Blocks until all tasks of \a owner have finished. If \a owner is null, blocks until all
+     * tasks have finished. Must not be called from a task of \a owner.
+     */
+    void waitForDone(const void *owner = 0);
+
+    /**
+     * Returns the amount of tasks of \a priority waiting to run or running.
+     */
+    int pending(Priority priority) const;
+
+    /**
+     * Returns a map with the amount of tasks queued, running and finished of each class.
+     */
+    QVariantMap stats() const;
+
+private:
+    TaskScheduler(TaskScheduler&);
+    TaskScheduler& operator=(TaskScheduler&);
+
+    class Worker;
+
+    struct Entry
+    {
+        QRunnable *task;
+        const void *owner;
+    };
+
+    static TaskScheduler *m_scheduler;
+    static QMutex *m_schedMutex;
+
+    QMutex *m_mutex;
+    QWaitCondition *m_workCond;
+    QWaitCondition *m_doneCond;
+    QQueue<Entry> m_queues[PriorityCount];
+    int m_running[PriorityCount];
+    quint64 m_finished[PriorityCount];
+    QHash<const void *, int> m_owned;   // Tasks queued or running of each owner
+    QList<Worker *> m_workers;
+    int m_threads;
+    int m_replyReserve;
+    int m_idle;                         // Workers waiting for tasks
+    bool m_stopped;
+
+    template <typename T>
+    QFuture<T> startFuture(QtConcurrent::RunFunctionTaskBase<T> *task, Priority priority,
+                           const void *owner = 0)
+    {
+        task->reportStarted();
+        QFuture<T> future = task->future();
+        start(static_cast<QRunnable *>(task), priority, owner);
+        return future;
+    }
+
+    bool canRun(int priority) const;
+    bool next(Entry &e, int &priority);
+    void finished(const Entry &e, int priority);
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CMN_TASKSCHEDULER_H
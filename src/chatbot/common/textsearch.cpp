@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/textsearch.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define LVK_TEXTSEARCH_SSE2
+# include <emmintrin.h>
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const int TABLE_SIZE = 0x10000;
+const ushort SKIP = 0;          // Folded value of combining marks, they are skipped
+
+ushort *s_table = 0;
+QMutex *s_tableMutex = new QMutex();
+
+// Returns ch in lower case and without diacritics, or SKIP if ch is a combining mark
+ushort foldChar(QChar ch)
+{
+    while (ch.decompositionTag() == QChar::Canonical) {
+        QString d = ch.decomposition();
+
+        // Only base chars followed by marks. Hangul syllables also decompose canonically.
+        for (int i = 1; i < d.size(); ++i) {
+            if (d[i].category() != QChar::Mark_NonSpacing) {
+                return ch.toLower().unicode();
+            }
+        }
+        ch = d[0];
+    }
+
+    return ch.category() == QChar::Mark_NonSpacing ? SKIP : ch.toLower().unicode();
+}
+
+// Folded value of each UTF-16 unit
+const ushort *foldTable()
+{
+    if (!s_table) {
+        QMutexLocker locker(s_tableMutex);
+        if (!s_table) {
+            // Never released
+            ushort *table = new ushort[TABLE_SIZE];
+            for (int c = 0; c < TABLE_SIZE; ++c) {
+                table[c] = foldChar(QChar(c));
+            }
+            s_table = table;
+        }
+    }
+
+    return s_table;
+}
+
+// Returns true if the folded text from p matches needle[1..n)
+inline bool matchesRest(const ushort *table, const ushort *p, const ushort *end,
+                        const ushort *needle, int n)
+{
+    for (int k = 1; k < n; ) {
+        if (p == end) {
+            return false;
+        }
+        ushort c = table[*p++];
+        if (c == SKIP) {
+            continue;
+        }
+        if (c != needle[k]) {
+            return false;
+        }
+        ++k;
+    }
+    return true;
+}
+
+#ifdef LVK_TEXTSEARCH_SSE2
+
+// Skips blocks of 8 ASCII units with no unit that folds to the ASCII char first. Returns the
+// position of the first block not skipped, or of the last units if there are less than 8.
+inline int skipAsciiBlocks(const ushort *h, int i, int size, ushort first)
+{
+    const __m128i nonAscii = _mm_set1_epi16(short(0xff80));
+    const __m128i beforeA  = _mm_set1_epi16('A' - 1);
+    const __m128i afterZ   = _mm_set1_epi16('Z' + 1);
+    const __m128i caseBit  = _mm_set1_epi16(0x20);
+    const __m128i target   = _mm_set1_epi16(first);
+    const __m128i zero     = _mm_setzero_si128();
+
+    for (; i + 8 <= size; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, nonAscii), zero)) != 0xffff) {
+            break;
+        }
+
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(v, beforeA), _mm_cmplt_epi16(v, afterZ));
+        __m128i lower = _mm_or_si128(v, _mm_and_si128(upper, caseBit));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(lower, target)) != 0) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+#endif // LVK_TEXTSEARCH_SSE2
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// TextSearch
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::TextSearch::TextSearch()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Cmn::TextSearch::TextSearch(const QString &needle)
+{
+    setNeedle(needle);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::TextSearch::setNeedle(const QString &needle)
+{
+    const ushort *table = foldTable();
+
+    m_needle = needle;
+    m_folded.clear();
+    m_folded.reserve(needle.size());
+
+    for (int i = 0; i < needle.size(); ++i) {
+        ushort c = table[needle[i].unicode()];
+        if (c != SKIP) {
+            m_folded.append(c);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::TextSearch::indexIn(const QString &haystack, int from /*= 0*/) const
+{
+    int size = haystack.size();
+    int i = qMax(0, from);
+
+    if (m_folded.isEmpty()) {
+        return i <= size ? i : -1;
+    }
+
+    const ushort *table = foldTable();
+    const ushort *h = haystack.utf16();
+    const ushort *needle = m_folded.constData();
+    int n = m_folded.size();
+    ushort first = needle[0];
+
+    while (i < size) {
+        int end = size;
+
+#ifdef LVK_TEXTSEARCH_SSE2
+        if (first < 0x80) {
+            i = skipAsciiBlocks(h, i, size, first);
+            end = qMin(size, i + 8);
+        }
+#endif
+
+        for (; i < end; ++i) {
+            if (table[h[i]] == first && matchesRest(table, h + i + 1, h + size, needle, n)) {
+                return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Cmn::TextSearch::contains(const QString &haystack, const QString &needle)
+{
+    return TextSearch(needle).isFoundIn(haystack);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::TextSearch::compare(const QString &s1, const QString &s2)
+{
+    const ushort *table = foldTable();
+    const ushort *p1 = s1.utf16();
+    const ushort *p2 = s2.utf16();
+    const ushort *end1 = p1 + s1.size();
+    const ushort *end2 = p2 + s2.size();
+
+    forever {
+        ushort c1 = SKIP;
+        ushort c2 = SKIP;
+
+        while (p1 != end1 && (c1 = table[*p1++]) == SKIP);
+        while (p2 != end2 && (c2 = table[*p2++]) == SKIP);
+
+        if (c1 != c2 || c1 == SKIP) {
+            return int(c1) - int(c2);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Cmn::TextSearch::fold(const QString &str)
+{
+    const ushort *table = foldTable();
+
+    QString folded;
+    folded.reserve(str.size());
+
+    for (int i = 0; i < str.size(); ++i) {
+        ushort c = table[str[i].unicode()];
+        if (c != SKIP) {
+            folded.append(QChar(c));
+        }
+    }
+
+    return folded;
+}
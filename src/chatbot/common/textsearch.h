@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_TEXTSEARCH_H
+#define LVK_CMN_TEXTSEARCH_H
+
+#include <QString>
+#include <QVector>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The TextSearch class provides a case and diacritic insensitive substring search.
+ *
+ * Characters are folded to lower case without diacritics, i.e. "Camión" contains "CAMION".
+ * Folding is a table lookup per UTF-16 unit, with no allocations. The needle is folded once
+ * when it is set, so a TextSearch object should be reused to search many texts, for instance
+ * to filter the rows of a list.
+ *
+ * Where SSE2 is available, runs of ASCII text are scanned eight units at a time for the first
+ * char of the needle. Otherwise, and for non-ASCII text, a scalar loop is used.
+ *
+ * Characters outside the Basic Multilingual Plane are compared as they are.
+ */
+class TextSearch
+{
+public:
+
+    /**
+     * Constructs a TextSearch object with an empty needle
+     */
+    TextSearch();
+
+    /**
+     * Constructs a TextSearch object for \a needle
+     */
+    explicit TextSearch(const QString &needle);
+
+    /**
+     * Sets the text to search to \a needle
+     */
+    void setNeedle(const QString &needle);
+
+    /**
+     * Returns the text to search
+     */
+    const QString &needle() const
+    {
+        return m_needle;
+    }
+
+    /**
+     * Returns the position of the first occurrence of the needle in \a haystack at or after
+     * \a from. If not found, returns -1. An empty needle is found at \a from.
+     */
+    int indexIn(const QString &haystack, int from = 0) const;
+
+    /**
+     * Returns true if \a haystack contains the needle. Otherwise; returns false.
+     */
+    bool isFoundIn(const QString &haystack) const
+    {
+        return indexIn(haystack) != -1;
+    }
+
+    /**
+     * Returns true if \a haystack contains \a needle ignoring case and diacritics.
+     * Otherwise; returns false. Use a TextSearch object to search the same needle many times.
+     */
+    static bool contains(const QString &haystack, const QString &needle);
+
+    /**
+     * Compares \a s1 and \a s2 ignoring case and diacritics. Returns an integer less than,
+     * equal to, or greater than zero if \a s1 is less than, equal to, or greater than \a s2.
+     */
+    static int compare(const QString &s1, const QString &s2);
+
+    /**
+     * Returns \a str in lower case and without diacritics.
+     */
+    static QString fold(const QString &str);
+
+private:
+    QString m_needle;
+    QVector<ushort> m_folded;   // Folded needle without combining marks
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CMN_TEXTSEARCH_H
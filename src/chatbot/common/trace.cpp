@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common/trace.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QStringList>
+
+#ifdef QT_DEBUG
+#  define DEFAULT_CATEGORIES    Lvk::Cmn::Trace::AllCategories
+#else
+#  define DEFAULT_CATEGORIES    0
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Trace
+//--------------------------------------------------------------------------------------------------
+
+QAtomicInt Lvk::Cmn::Trace::m_categories(DEFAULT_CATEGORIES);
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Trace::init()
+{
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+
+    if (settings.contains(SETTING_TRACE_CATEGORIES)) {
+        setCategories(parseCategories(settings.value(SETTING_TRACE_CATEGORIES).toString()));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Cmn::Trace::setCategories(int categories)
+{
+    m_categories.fetchAndStoreOrdered(categories);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::Trace::categories()
+{
+    return m_categories;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Cmn::Trace::parseCategories(const QString &names)
+{
+    int categories = 0;
+
+    foreach (const QString &name, names.toLower().split(",", QString::SkipEmptyParts)) {
+        QString n = name.trimmed();
+
+        if (n == "all") {
+            categories |= AllCategories;
+        } else if (n == "nlp") {
+            categories |= Nlp;
+        } else if (n == "lemmatizer") {
+            categories |= Lemmatizer;
+        } else if (n == "parser") {
+            categories |= Parser;
+        } else if (n == "backend") {
+            categories |= BackEnd;
+        } else {
+            qWarning() << "Trace: Unknown category" << n;
+        }
+    }
+
+    return categories;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CMN_TRACE_H
+#define LVK_CMN_TRACE_H
+
+#include <QtDebug>
+#include <QAtomicInt>
+#include <QString>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Cmn
+{
+
+/// \ingroup Lvk
+/// \addtogroup Cmn
+/// @{
+
+/**
+ * \brief The Trace class provides categories of debug messages that can be enabled at runtime
+ *
+ * Debug messages printed for every chat message, such as the ones printed while matching
+ * rules, must use the LVK_TRACE() macro instead of qDebug():
+ *
+ * \code
+ * LVK_TRACE(Nlp) << "Parsed user input" << words;
+ * \endcode
+ *
+ * If the category is disabled, the message is not built and its arguments are not evaluated,
+ * so disabled traces cost a single branch. If LVK_NO_TRACE is defined, traces are removed at
+ * compile time.
+ *
+ * Enabled categories are read from the application settings SETTING_TRACE_CATEGORIES by init().
+ * By default, all categories are enabled in debug builds and disabled in release builds.
+ */
+class Trace
+{
+public:
+
+    /**
+     * Trace categories
+     */
+    enum Category
+    {
+        Nlp         = 0x01,     ///< NLP engines, rule trees and rule matching
+        Lemmatizer  = 0x02,     ///< Lemmatizers and sanitizers
+        Parser      = 0x04,     ///< Rule output parser
+        BackEnd     = 0x08,     ///< Back-end adapters
+        AllCategories = Nlp | Lemmatizer | Parser | BackEnd
+    };
+
+    /**
+     * Reads enabled categories from the application settings
+     */
+    static void init();
+
+    /**
+     * Returns true if \a category is enabled. Otherwise; returns false.
+     */
+    static bool isEnabled(Category category)
+    {
+        return (int)m_categories & category;
+    }
+
+    /**
+     * Sets the enabled \a categories. \a categories is a bitwise OR of Category values
+     */
+    static void setCategories(int categories);
+
+    /**
+     * Returns the enabled categories
+     */
+    static int categories();
+
+    /**
+     * Parses a comma separated list of category names such as "nlp,lemmatizer" or "all".
+     * Returns a bitwise OR of Category values.
+     */
+    static int parseCategories(const QString &names);
+
+private:
+    Trace();
+    Trace(Trace&);
+
+    static QAtomicInt m_categories;
+};
+
+/// @}
+
+} // namespace Cmn
+
+/// @}
+
+} // namespace Lvk
+
+
+#ifdef LVK_NO_TRACE
+#  define LVK_TRACE(category)  if (true) {} else QNoDebug()
+#else
+#  define LVK_TRACE(category)  \
+    if (!Lvk::Cmn::Trace::isEnabled(Lvk::Cmn::Trace::category)) {} else qDebug()
+#endif
+
+#endif // LVK_CMN_TRACE_H
@@ -20,14 +20,26 @@
  */
 
 #include "cipher.h"
+
 #include <QByteArray>
+#include <QIODevice>
 #include <QDebug>
 
+#include <cstring>
+
 #ifdef OPENSSL_SUPPORT
 # include <openssl/evp.h>
 # include <openssl/err.h>
+# include <openssl/rand.h>
 #endif
 
+#define CIPHER_BUFFER_SIZE      (64*1024)   // Working buffer size used to process devices
+#define CIPHER_MAX_BLOCK_SIZE   32
+
+#define GCM_NONCE_SIZE          12
+#define GCM_TAG_SIZE            16
+#define GCM_HEADER_SIZE         (1 + GCM_NONCE_SIZE) // suite id + nonce
+
 
 //--------------------------------------------------------------------------------------------------
 // Helpers
@@ -38,142 +50,621 @@ namespace
 
 #ifdef OPENSSL_SUPPORT
 
+inline const EVP_CIPHER *evp_cipher(Lvk::Crypto::Cipher::Suite suite)
+{
+    return suite == Lvk::Crypto::Cipher::Aes128GcmSuite ? EVP_aes_128_gcm() : EVP_bf_cbc();
+}
+
 //--------------------------------------------------------------------------------------------------
-// Blowfish CBC encryption
 
-inline bool bf_encrypt(QByteArray &data, const QByteArray &iv_, const QByteArray &key_)
+inline int bf_block_size()
 {
-    if (key_.size() != EVP_CIPHER_key_length(EVP_bf_cbc())) {
-        qCritical() << "bf_encrypt invalid key size";
-        return false;
-    }
+    return EVP_CIPHER_block_size(EVP_bf_cbc());
+}
 
-    const unsigned char *iv = reinterpret_cast<const unsigned char*>(iv_.constData());
-    const unsigned char *key = reinterpret_cast<const unsigned char*>(key_.constData());
-    const unsigned char *inbuf = reinterpret_cast<const unsigned char*>(data.constData());
-    int inlen = data.size();
+//--------------------------------------------------------------------------------------------------
 
-    // TODO initialize context only once
-    EVP_CIPHER_CTX ctx;
-    EVP_CIPHER_CTX_init(&ctx);
-    EVP_EncryptInit_ex(&ctx, EVP_bf_cbc(), NULL, key, iv);
+inline unsigned char *uchar_ptr(char *p)
+{
+    return reinterpret_cast<unsigned char *>(p);
+}
 
-    bool success = false;
-    unsigned char *outbuf = new unsigned char[inlen + EVP_CIPHER_CTX_block_size(&ctx)];
-    int outlen = 0;
+//--------------------------------------------------------------------------------------------------
 
-    // TODO encrypt using a buffer of a fixed size to avoid running out of memory with very big data
-    if (EVP_EncryptUpdate(&ctx, outbuf, &outlen, inbuf, inlen)) {
-        int tmplen = 0;
-        if (EVP_EncryptFinal_ex(&ctx, outbuf + outlen, &tmplen)) {
-            outlen += tmplen;
-            data = QByteArray(reinterpret_cast<const char*>(outbuf), outlen);
-            success = true;
-        }
-    }
+inline const unsigned char *uchar_ptr(const char *p)
+{
+    return reinterpret_cast<const unsigned char *>(p);
+}
 
-    if (!success) {
-        qCritical() << "bf_encrypt failed!";
-        //ERR_print_errors_fp(stderr);
-    }
+//--------------------------------------------------------------------------------------------------
+// PKCS#7 padding, the same padding used by EVP_EncryptFinal_ex
 
-    EVP_CIPHER_CTX_cleanup(&ctx);
-    delete[] outbuf;
+inline void addPadding(QByteArray &data, int blockSize)
+{
+    int size = data.size();
+    int pad = blockSize - size % blockSize;
 
-    return success;
+    data.resize(size + pad);
+    memset(data.data() + size, pad, pad);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Blowfish CBC decryption
-inline bool bf_decrypt(QByteArray &data, const QByteArray &iv_, const QByteArray &key_)
+
+inline int paddingSize(const QByteArray &data, int blockSize)
 {
-    if (key_.size() != EVP_CIPHER_key_length(EVP_bf_cbc())) {
-        qCritical() << "bf_decrypt invalid key size";
-        return false;
+    int pad = static_cast<unsigned char>(data[data.size() - 1]);
+
+    if (pad < 1 || pad > blockSize || pad > data.size()) {
+        return -1;
+    }
+
+    for (int i = data.size() - pad; i < data.size(); ++i) {
+        if (static_cast<unsigned char>(data[i]) != pad) {
+            return -1;
+        }
     }
 
-    const unsigned char *iv = reinterpret_cast<const unsigned char*>(iv_.constData());
-    const unsigned char *key = reinterpret_cast<const unsigned char*>(key_.constData());
-    const unsigned char *inbuf = reinterpret_cast<const unsigned char*>(data.constData());
-    int inlen = data.size();
+    return pad;
+}
 
-    // TODO initialize context only once
-    EVP_CIPHER_CTX ctx;
-    EVP_CIPHER_CTX_init(&ctx);
-    EVP_DecryptInit_ex(&ctx, EVP_bf_cbc(), NULL, key, iv);
+#endif // OPENSSL_SUPPORT
 
-    bool success = false;
-    unsigned char *outbuf = new unsigned char[inlen];
-    int outlen = 0;
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Cipher
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Crypto::Cipher::Cipher(const QByteArray &iv, const QByteArray &key, Suite suite)
+    : m_iv(iv), m_key(key), m_suite(suite), m_decryptedSuite(BlowfishCbcSuite),
+      m_mode(NoMode), m_headerDone(false)
+{
+    memset(m_ctx, 0, sizeof(m_ctx));
+
+#ifndef OPENSSL_SUPPORT
+    // Without OpenSSL data is not encrypted nor authenticated
+    m_suite = BlowfishCbcSuite;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
 
-    // TODO decrypt using a buffer of a fixed size to avoid running out of memory with very big data
-    if (EVP_DecryptUpdate(&ctx, outbuf, &outlen, inbuf, inlen)) {
-        int tmplen = 0;
-        if (EVP_DecryptFinal_ex(&ctx, outbuf + outlen, &tmplen)) {
-            outlen += tmplen;
-            success = true;
-            data = QByteArray(reinterpret_cast<const char*>(outbuf), outlen);
+Lvk::Crypto::Cipher::~Cipher()
+{
+#ifdef OPENSSL_SUPPORT
+    for (unsigned i = 0; i < sizeof(m_ctx)/sizeof(m_ctx[0]); ++i) {
+        if (m_ctx[i]) {
+            EVP_CIPHER_CTX_free(m_ctx[i]);
         }
     }
+#endif
+}
 
-    if (!success) {
-        qCritical() << "bf_decrypt failed!";
-        //ERR_print_errors_fp(stderr);
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Crypto::Cipher::encrypt(QByteArray &data)
+{
+#ifdef OPENSSL_SUPPORT
+    if (m_suite == Aes128GcmSuite) {
+        if (!gcmEncrypt(data)) {
+            qCritical() << "Cipher: encryption failed!";
+            return false;
+        }
+        return true;
     }
 
-    EVP_CIPHER_CTX_cleanup(&ctx);
-    delete[] outbuf;
+    int size = data.size();
 
-    return success;
-}
+    addPadding(data, bf_block_size());
 
-#endif // OPENSSL_SUPPORT
+    if (!cbc(EncryptMode, data)) {
+        qCritical() << "Cipher: encryption failed!";
+        data.resize(size);
+        return false;
+    }
+#else
+    Q_UNUSED(data);
+#endif
+
+    return true;
+}
 
 //--------------------------------------------------------------------------------------------------
 
-inline bool null_encrypt(QByteArray &/*data*/, const QByteArray &/*key*/)
+bool Lvk::Crypto::Cipher::decrypt(QByteArray &data)
 {
+#ifdef OPENSSL_SUPPORT
+    if (data.size() >= GCM_HEADER_SIZE + GCM_TAG_SIZE
+            && static_cast<unsigned char>(data[0]) == Aes128GcmSuite) {
+        if (gcmDecrypt(data)) {
+            m_decryptedSuite = Aes128GcmSuite;
+            return true;
+        }
+        // Otherwise; it could be legacy data that looks like a GCM header
+    }
+
+    if (data.isEmpty() || data.size() % bf_block_size() != 0 || !cbc(DecryptMode, data)) {
+        qCritical() << "Cipher: decryption failed!";
+        return false;
+    }
+
+    int pad = paddingSize(data, bf_block_size());
+
+    if (pad == -1) {
+        qCritical() << "Cipher: decryption failed, invalid padding!";
+        // In CBC mode encrypting the output with the same key and IV restores the input
+        cbc(EncryptMode, data);
+        return false;
+    }
+
+    data.chop(pad);
+#else
+    Q_UNUSED(data);
+#endif
+
+    m_decryptedSuite = BlowfishCbcSuite;
+
     return true;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-inline bool null_decrypt(QByteArray &/*data*/, const QByteArray &/*key*/)
+bool Lvk::Crypto::Cipher::encrypt(QIODevice *in, QIODevice *out)
 {
-    return true;
+    return processDevice(EncryptMode, in, out);
 }
 
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Crypto::Cipher::decrypt(QIODevice *in, QIODevice *out)
+{
+    return processDevice(DecryptMode, in, out);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Cipher
+
+bool Lvk::Crypto::Cipher::beginEncrypt()
+{
+    m_mode = NoMode;
+
+#ifdef OPENSSL_SUPPORT
+    if (m_suite == Aes128GcmSuite) {
+        char nonce[GCM_NONCE_SIZE];
+        const unsigned char aad = Aes128GcmSuite;
+        int len = 0;
+
+        if (RAND_bytes(uchar_ptr(nonce), GCM_NONCE_SIZE) != 1) {
+            return false;
+        }
+
+        EVP_CIPHER_CTX *ctx = context(Aes128GcmSuite, EncryptMode, nonce);
+
+        if (!ctx || !EVP_EncryptUpdate(ctx, NULL, &len, &aad, 1)) {
+            return false;
+        }
+
+        m_stash = QByteArray(1, static_cast<char>(Aes128GcmSuite)) +
+                  QByteArray(nonce, GCM_NONCE_SIZE);
+        m_headerDone = false;
+    } else if (!context(BlowfishCbcSuite, EncryptMode, m_iv.constData())) {
+        return false;
+    }
+#endif
+
+    m_mode = EncryptMode;
+
+    return true;
+}
+
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Crypto::Cipher::Cipher(const QByteArray &iv, const QByteArray &key)
-    : m_iv(iv), m_key(key)
+bool Lvk::Crypto::Cipher::beginDecrypt()
 {
+    m_mode = NoMode;
+
+#ifdef OPENSSL_SUPPORT
+    if (m_suite == Aes128GcmSuite) {
+        // The context is initialized when the nonce is read
+        if (m_key.size() != EVP_CIPHER_key_length(evp_cipher(m_suite))) {
+            qCritical() << "Cipher: invalid key size";
+            return false;
+        }
+
+        m_stash.clear();
+        m_headerDone = false;
+    } else if (!context(BlowfishCbcSuite, DecryptMode, m_iv.constData())) {
+        return false;
+    }
+#endif
+
+    m_mode = DecryptMode;
+
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Crypto::Cipher::encrypt(QByteArray &data)
+bool Lvk::Crypto::Cipher::update(const char *data, int size, QByteArray &out)
 {
+    if (m_mode == NoMode || size < 0) {
+        return false;
+    }
+
 #ifdef OPENSSL_SUPPORT
-    return bf_encrypt(data, m_iv, m_key);
+    if (m_suite == Aes128GcmSuite) {
+        if (!gcmUpdate(data, size, out)) {
+            qCritical() << "Cipher: update failed!";
+            m_mode = NoMode;
+            out.clear();
+            return false;
+        }
+        return true;
+    }
+
+    EVP_CIPHER_CTX *ctx = m_ctx[m_mode == EncryptMode ? 0 : 1];
+
+    out.resize(size + CIPHER_MAX_BLOCK_SIZE);
+    int outlen = 0;
+
+    if (!EVP_CipherUpdate(ctx, uchar_ptr(out.data()), &outlen, uchar_ptr(data), size)) {
+        qCritical() << "Cipher: update failed!";
+        m_mode = NoMode;
+        out.clear();
+        return false;
+    }
+
+    out.resize(outlen);
 #else
-    return null_encrypt(data, m_key);
+    out.resize(size);
+    memcpy(out.data(), data, size);
 #endif
+
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Crypto::Cipher::decrypt(QByteArray &data)
+bool Lvk::Crypto::Cipher::final(QByteArray &out)
 {
+    if (m_mode == NoMode) {
+        return false;
+    }
+
 #ifdef OPENSSL_SUPPORT
-    return bf_decrypt(data, m_iv, m_key);
+    if (m_suite == Aes128GcmSuite) {
+        bool success = gcmFinal(out);
+        m_mode = NoMode;
+        m_stash.clear();
+
+        if (!success) {
+            qCritical() << "Cipher: final failed!";
+            out.clear();
+        }
+        return success;
+    }
+
+    EVP_CIPHER_CTX *ctx = m_ctx[m_mode == EncryptMode ? 0 : 1];
+
+    out.resize(CIPHER_MAX_BLOCK_SIZE);
+    int outlen = 0;
+
+    m_mode = NoMode;
+
+    if (!EVP_CipherFinal_ex(ctx, uchar_ptr(out.data()), &outlen)) {
+        qCritical() << "Cipher: final failed!";
+        out.clear();
+        return false;
+    }
+
+    out.resize(outlen);
 #else
-    return null_decrypt(data, m_key);
+    m_mode = NoMode;
+    out.clear();
 #endif
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#ifdef OPENSSL_SUPPORT
+
+// Contexts are stored by suite and mode. The key schedule is computed only once per context.
+EVP_CIPHER_CTX * Lvk::Crypto::Cipher::context(Suite suite, Mode mode, const char *iv,
+                                              bool padding)
+{
+    EVP_CIPHER_CTX *&ctx = m_ctx[(suite == Aes128GcmSuite ? 2 : 0) + (mode == DecryptMode)];
+
+    if (!ctx) {
+        const EVP_CIPHER *type = evp_cipher(suite);
+
+        if (m_key.size() != EVP_CIPHER_key_length(type)) {
+            qCritical() << "Cipher: invalid key size";
+            return 0;
+        }
+
+        ctx = EVP_CIPHER_CTX_new();
+
+        bool init = ctx && EVP_CipherInit_ex(ctx, type, NULL, NULL, NULL, mode == EncryptMode);
+
+        if (init && suite == Aes128GcmSuite) {
+            init = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_NONCE_SIZE, NULL);
+        }
+
+        if (!init || !EVP_CipherInit_ex(ctx, NULL, NULL, uchar_ptr(m_key.constData()),
+                                        uchar_ptr(iv), -1)) {
+            qCritical() << "Cipher: cannot initialize context";
+            EVP_CIPHER_CTX_free(ctx);
+            ctx = 0;
+            return 0;
+        }
+    } else if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, uchar_ptr(iv), -1)) {
+        // Resets only the IV
+        return 0;
+    }
+
+    EVP_CIPHER_CTX_set_padding(ctx, padding ? 1 : 0);
+
+    return ctx;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Crypto::Cipher::cbc(Mode mode, QByteArray &data)
+{
+    // No padding, data size must be multiple of the block size
+    EVP_CIPHER_CTX *ctx = context(BlowfishCbcSuite, mode, m_iv.constData(), false);
+
+    if (!ctx) {
+        return false;
+    }
+
+    unsigned char *buf = uchar_ptr(data.data());
+    int outlen = 0;
+    int tmplen = 0;
+
+    // In place. Input and output can be the same buffer
+    return EVP_CipherUpdate(ctx, buf, &outlen, buf, data.size()) &&
+           EVP_CipherFinal_ex(ctx, buf + outlen, &tmplen) &&
+           outlen + tmplen == data.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Output: suite id | nonce | encrypted data | tag. The suite id is authenticated too.
+bool Lvk::Crypto::Cipher::gcmEncrypt(QByteArray &data)
+{
+    char nonce[GCM_NONCE_SIZE];
+
+    if (RAND_bytes(uchar_ptr(nonce), GCM_NONCE_SIZE) != 1) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = context(Aes128GcmSuite, EncryptMode, nonce);
+
+    if (!ctx) {
+        return false;
+    }
+
+    const int n = data.size();
+    const unsigned char aad = Aes128GcmSuite;
+
+    data.resize(GCM_HEADER_SIZE + n + GCM_TAG_SIZE);
+
+    char *buf = data.data();
+    memmove(buf + GCM_HEADER_SIZE, buf, n);
+    buf[0] = static_cast<char>(Aes128GcmSuite);
+    memcpy(buf + 1, nonce, GCM_NONCE_SIZE);
+
+    unsigned char *p = uchar_ptr(buf + GCM_HEADER_SIZE);
+    int len = 0;
+
+    bool success = EVP_EncryptUpdate(ctx, NULL, &len, &aad, 1) &&
+                   EVP_EncryptUpdate(ctx, p, &len, p, n) &&
+                   EVP_EncryptFinal_ex(ctx, p + len, &len) &&
+                   EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_SIZE, p + n);
+
+    if (!success) {
+        memmove(buf, buf + GCM_HEADER_SIZE, n);
+        data.resize(n);
+    }
+
+    return success;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Crypto::Cipher::gcmDecrypt(QByteArray &data)
+{
+    char *buf = data.data();
+    const char *nonce = buf + 1;
+    const int n = data.size() - GCM_HEADER_SIZE - GCM_TAG_SIZE;
+    const unsigned char aad = Aes128GcmSuite;
+
+    EVP_CIPHER_CTX *ctx = context(Aes128GcmSuite, DecryptMode, nonce);
+
+    if (!ctx) {
+        return false;
+    }
+
+    unsigned char *p = uchar_ptr(buf + GCM_HEADER_SIZE);
+    int len = 0;
+
+    bool success = EVP_DecryptUpdate(ctx, NULL, &len, &aad, 1) &&
+                   EVP_DecryptUpdate(ctx, p, &len, p, n) &&
+                   EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_SIZE, p + n) &&
+                   EVP_DecryptFinal_ex(ctx, p + len, &len) > 0;
+
+    if (!success) {
+        // GCM is a stream cipher, encrypting with the same nonce restores the input
+        ctx = context(Aes128GcmSuite, EncryptMode, nonce);
+        if (ctx) {
+            EVP_EncryptUpdate(ctx, NULL, &len, &aad, 1);
+            EVP_EncryptUpdate(ctx, p, &len, p, n);
+        }
+        return false;
+    }
+
+    memmove(buf, buf + GCM_HEADER_SIZE, n);
+    data.resize(n);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Crypto::Cipher::gcmUpdate(const char *data, int size, QByteArray &out)
+{
+    int len = 0;
+
+    if (m_mode == EncryptMode) {
+        EVP_CIPHER_CTX *ctx = m_ctx[2];
+        int offset = 0;
+
+        out.resize(m_stash.size() + size);
+
+        if (!m_headerDone) {
+            memcpy(out.data(), m_stash.constData(), m_stash.size());
+            offset = m_stash.size();
+            m_stash.clear();
+            m_headerDone = true;
+        }
+
+        if (!EVP_EncryptUpdate(ctx, uchar_ptr(out.data() + offset), &len, uchar_ptr(data),
+                               size)) {
+            return false;
+        }
+
+        out.resize(offset + len);
+
+        return true;
+    }
+
+    // Decryption. The header and the last GCM_TAG_SIZE bytes are kept in the stash
+    QByteArray input = m_stash;
+    input.append(data, size);
+
+    int pos = 0;
+
+    if (!m_headerDone) {
+        if (input.size() < GCM_HEADER_SIZE) {
+            m_stash = input;
+            out.clear();
+            return true;
+        }
+
+        const unsigned char aad = Aes128GcmSuite;
+
+        if (static_cast<unsigned char>(input[0]) != Aes128GcmSuite) {
+            return false;
+        }
+
+        EVP_CIPHER_CTX *ctx = context(Aes128GcmSuite, DecryptMode, input.constData() + 1);
+
+        if (!ctx || !EVP_DecryptUpdate(ctx, NULL, &len, &aad, 1)) {
+            return false;
+        }
+
+        pos = GCM_HEADER_SIZE;
+        m_headerDone = true;
+    }
+
+    int n = input.size() - pos - GCM_TAG_SIZE;
+
+    if (n > 0) {
+        out.resize(n);
+
+        if (!EVP_DecryptUpdate(m_ctx[3], uchar_ptr(out.data()), &len,
+                               uchar_ptr(input.constData() + pos), n)) {
+            return false;
+        }
+
+        out.resize(len);
+        pos += n;
+    } else {
+        out.clear();
+    }
+
+    m_stash = input.mid(pos);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Crypto::Cipher::gcmFinal(QByteArray &out)
+{
+    int len = 0;
+
+    if (m_mode == EncryptMode) {
+        EVP_CIPHER_CTX *ctx = m_ctx[2];
+
+        out = m_headerDone ? QByteArray() : m_stash;
+        int offset = out.size();
+        out.resize(offset + CIPHER_MAX_BLOCK_SIZE + GCM_TAG_SIZE);
+
+        unsigned char *p = uchar_ptr(out.data() + offset);
+
+        if (!EVP_EncryptFinal_ex(ctx, p, &len) ||
+                !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_SIZE, p + len)) {
+            return false;
+        }
+
+        out.resize(offset + len + GCM_TAG_SIZE);
+
+        return true;
+    }
+
+    if (!m_headerDone || m_stash.size() != GCM_TAG_SIZE) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = m_ctx[3];
+
+    out.resize(CIPHER_MAX_BLOCK_SIZE);
+
+    if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_SIZE, m_stash.data()) ||
+            EVP_DecryptFinal_ex(ctx, uchar_ptr(out.data()), &len) <= 0) {
+        return false;
+    }
+
+    out.resize(len);
+
+    return true;
 }
 
+#endif // OPENSSL_SUPPORT
 
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Crypto::Cipher::processDevice(Mode mode, QIODevice *in, QIODevice *out)
+{
+    if (!in || !out) {
+        return false;
+    }
+
+    if (!(mode == EncryptMode ? beginEncrypt() : beginDecrypt())) {
+        return false;
+    }
+
+    QByteArray inbuf(CIPHER_BUFFER_SIZE, 0);
+    QByteArray outbuf;
+    outbuf.reserve(CIPHER_BUFFER_SIZE + CIPHER_MAX_BLOCK_SIZE + GCM_HEADER_SIZE);
+
+    qint64 n = 0;
+
+    while ((n = in->read(inbuf.data(), inbuf.size())) > 0) {
+        if (!update(inbuf.constData(), n, outbuf) || out->write(outbuf) != outbuf.size()) {
+            m_mode = NoMode;
+            return false;
+        }
+    }
+
+    if (n < 0 || !final(outbuf) || out->write(outbuf) != outbuf.size()) {
+        m_mode = NoMode;
+        return false;
+    }
+
+    return true;
+}
@@ -24,6 +24,9 @@
 
 #include <QByteArray>
 
+class QIODevice;
+struct evp_cipher_ctx_st;
+
 namespace Lvk
 {
 
@@ -41,15 +44,41 @@ namespace Crypto
 
 /**
  * \brief The Cipher class provides a symmetric block cipher to encrypt or decrypt data.
+ *
+ * The cipher context is initialized with the key only once and reused by all operations of
+ * the object. Byte arrays are encrypted and decrypted in place. Big amounts of data can be
+ * processed from a QIODevice with encrypt(QIODevice*, QIODevice*) or with beginEncrypt(),
+ * update() and final(), using buffers of a fixed size.
+ *
+ * Data is encrypted with the cipher suite given in the constructor. Aes128GcmSuite encrypts
+ * and authenticates in one pass. Its output starts with the suite id and a random nonce,
+ * and ends with the authentication tag. BlowfishCbcSuite output has no header. Byte arrays
+ * encrypted with any suite can be decrypted; see decryptedSuite().
  */
 class Cipher
 {
 public:
 
     /**
-     * Constructs a Cipher with initialization vector \a iv  and key \a key
+     * Cipher suites
+     */
+    enum Suite
+    {
+        BlowfishCbcSuite = 1,   ///< Blowfish in CBC mode, no authentication. Legacy suite.
+        Aes128GcmSuite = 2      ///< AES-128 in GCM mode with a 128-bit authentication tag
+    };
+
+    /**
+     * Constructs a Cipher with initialization vector \a iv, key \a key and cipher suite
+     * \a suite. The initialization vector is not used by Aes128GcmSuite, since every
+     * encryption uses a new random nonce.
+     */
+    Cipher(const QByteArray &iv, const QByteArray &key, Suite suite = BlowfishCbcSuite);
+
+    /**
+     * Destroys the object.
      */
-    Cipher(const QByteArray &iv, const QByteArray &key);
+    ~Cipher();
 
     /**
      * Encrypts \a data using the given \a key. Returns true on success; Otherwise false.
@@ -57,13 +86,86 @@ public:
     bool encrypt(QByteArray &data);
 
     /**
-     * Decrypts \a data using the given \a key. Returns true on success; Otherwise false.
+     * Decrypts \a data using the given \a key. Returns true on success; Otherwise false and
+     * \a data is left unchanged. Data encrypted with Aes128GcmSuite is detected by its
+     * header, otherwise BlowfishCbcSuite is assumed.
      */
     bool decrypt(QByteArray &data);
 
+    /**
+     * Returns the cipher suite used to encrypt.
+     */
+    Suite suite() const
+    {
+        return m_suite;
+    }
+
+    /**
+     * Returns the cipher suite of the last data successfully decrypted with
+     * decrypt(QByteArray &). Data decrypted with BlowfishCbcSuite is not authenticated.
+     */
+    Suite decryptedSuite() const
+    {
+        return m_decryptedSuite;
+    }
+
+    /**
+     * Encrypts all data read from \a in and writes it into \a out. Returns true on success;
+     * Otherwise false.
+     */
+    bool encrypt(QIODevice *in, QIODevice *out);
+
+    /**
+     * Decrypts all data read from \a in and writes it into \a out. Returns true on success;
+     * Otherwise false. On failure \a out may contain part of the data.
+     */
+    bool decrypt(QIODevice *in, QIODevice *out);
+
+    /**
+     * Starts a streaming encryption with suite(). Returns true on success; Otherwise false.
+     */
+    bool beginEncrypt();
+
+    /**
+     * Starts a streaming decryption with suite(). Returns true on success; Otherwise false.
+     */
+    bool beginDecrypt();
+
+    /**
+     * Processes \a size bytes of \a data and sets into \a out the output available so far.
+     * Returns true on success; Otherwise false.
+     */
+    bool update(const char *data, int size, QByteArray &out);
+
+    /**
+     * Finishes the streaming operation and sets into \a out the remaining output.
+     * Returns true on success; Otherwise false. With Aes128GcmSuite decryption
+     * returns false if data is not authentic.
+     */
+    bool final(QByteArray &out);
+
 private:
+    Cipher(Cipher&);
+    Cipher& operator=(Cipher&);
+
+    enum Mode { NoMode, EncryptMode, DecryptMode };
+
     QByteArray m_iv;
     QByteArray m_key;
+    Suite m_suite;
+    Suite m_decryptedSuite;
+    Mode m_mode;
+    QByteArray m_stash;     // Streaming GCM: pending header or tag bytes
+    bool m_headerDone;      // Streaming GCM: header already written or read
+    evp_cipher_ctx_st *m_ctx[4];
+
+    evp_cipher_ctx_st *context(Suite suite, Mode mode, const char *iv, bool padding = true);
+    bool cbc(Mode mode, QByteArray &data);
+    bool gcmEncrypt(QByteArray &data);
+    bool gcmDecrypt(QByteArray &data);
+    bool gcmUpdate(const char *data, int size, QByteArray &out);
+    bool gcmFinal(QByteArray &out);
+    bool processDevice(Mode mode, QIODevice *in, QIODevice *out);
 };
 
 /// @}
@@ -76,4 +178,3 @@ private:
 
 
 #endif // LVK_CRYPTO_CIPHER_H
-
@@ -9,7 +9,9 @@ HEADERS += \
     $$PROJECT_PATH/crypto/keymanager.h \
     $$PROJECT_PATH/crypto/defaultkeymanager.h \
     $$PROJECT_PATH/crypto/keymanagerfactory.h \
+    $$PROJECT_PATH/crypto/keycache.h \
 
 SOURCES += \
     $$PROJECT_PATH/crypto/cipher.cpp \
     $$PROJECT_PATH/crypto/keymanagerfactory.cpp \
+    $$PROJECT_PATH/crypto/keycache.cpp \
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "crypto/keycache.h"
+#include "crypto/keymanagerfactory.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadStorage>
+
+#include <memory>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Ciphers owned by a thread
+struct ThreadCiphers
+{
+    ~ThreadCiphers()
+    {
+        qDeleteAll(ciphers);
+    }
+
+    QHash<int, Lvk::Crypto::Cipher *> ciphers;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+QThreadStorage<ThreadCiphers *> threadCiphers;
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// KeyCache
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Crypto::KeyCache * Lvk::Crypto::KeyCache::m_cache = 0;
+QMutex *                Lvk::Crypto::KeyCache::m_cacheMutex = new QMutex();
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Crypto::KeyCache::KeyCache()
+    : m_mutex(new QMutex())
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Crypto::KeyCache * Lvk::Crypto::KeyCache::cache()
+{
+    if (!m_cache) {
+        QMutexLocker locker(m_cacheMutex);
+        if (!m_cache) {
+            static KeyCache cache;
+            m_cache = &cache;
+        }
+    }
+
+    return m_cache;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::Crypto::KeyCache::getKey(KeyManager::Role role)
+{
+    return keyInfo(role).key;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::Crypto::KeyCache::getIV(KeyManager::Role role)
+{
+    return keyInfo(role).iv;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Crypto::Cipher::Suite Lvk::Crypto::KeyCache::cipherSuite(KeyManager::Role role)
+{
+    return keyInfo(role).suite;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Crypto::Cipher & Lvk::Crypto::KeyCache::threadCipher(KeyManager::Role role)
+{
+    if (!threadCiphers.hasLocalData()) {
+        threadCiphers.setLocalData(new ThreadCiphers());
+    }
+
+    Cipher *&cipher = threadCiphers.localData()->ciphers[role];
+
+    if (!cipher) {
+        KeyInfo info = keyInfo(role);
+        cipher = new Cipher(info.iv, info.key, info.suite);
+    }
+
+    return *cipher;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Crypto::KeyCache::KeyInfo Lvk::Crypto::KeyCache::keyInfo(KeyManager::Role role)
+{
+    QMutexLocker locker(m_mutex);
+
+    QHash<int, KeyInfo>::const_iterator it = m_keys.find(role);
+
+    if (it != m_keys.end()) {
+        return *it;
+    }
+
+    std::auto_ptr<KeyManager> keyMgr(KeyManagerFactory().create());
+
+    KeyInfo info;
+    info.key = keyMgr->getKey(role);
+    info.iv = keyMgr->getIV(role);
+    info.suite = keyMgr->cipherSuite(role);
+
+    m_keys.insert(role, info);
+
+    return info;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_CRYPTO_KEYCACHE_H
+#define LVK_CRYPTO_KEYCACHE_H
+
+#include "crypto/keymanager.h"
+#include "crypto/cipher.h"
+
+#include <QByteArray>
+#include <QHash>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Crypto
+{
+
+/// \ingroup Lvk
+/// \addtogroup Crypto
+/// @{
+
+/**
+ * \brief The KeyCache class provides process-wide cached access to the key material provided
+ *        by the default KeyManager.
+ *
+ * Keys, initialization vectors and cipher suites are requested to the KeyManager only once per
+ * role. Besides, each thread gets its own Cipher per role, so the cipher key schedule is
+ * computed only once per thread. KeyCache is thread-safe.
+ */
+class KeyCache
+{
+public:
+
+    /**
+     * Returns the key cache
+     */
+    static KeyCache *cache();
+
+    /**
+     * Returns the key for the given \a role
+     */
+    QByteArray getKey(KeyManager::Role role);
+
+    /**
+     * Returns the initialization vector for the given \a role
+     */
+    QByteArray getIV(KeyManager::Role role);
+
+    /**
+     * Returns the cipher suite for the given \a role
+     */
+    Cipher::Suite cipherSuite(KeyManager::Role role);
+
+    /**
+     * Returns the cipher for the given \a role owned by the calling thread. The cipher is
+     * destroyed when the thread finishes and must not be shared with other threads.
+     */
+    Cipher &threadCipher(KeyManager::Role role);
+
+private:
+    KeyCache();
+    KeyCache(KeyCache&);
+    KeyCache& operator=(KeyCache&);
+
+    static KeyCache *m_cache;
+    static QMutex *m_cacheMutex;
+
+    struct KeyInfo
+    {
+        QByteArray key;
+        QByteArray iv;
+        Cipher::Suite suite;
+    };
+
+    QMutex *m_mutex;
+    QHash<int, KeyInfo> m_keys;
+
+    KeyInfo keyInfo(KeyManager::Role role);
+};
+
+/// @}
+
+} // namespace Crypto
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_CRYPTO_KEYCACHE_H
@@ -22,6 +22,8 @@
 #ifndef LVK_CRYPTO_KEYMANAGER_H
 #define LVK_CRYPTO_KEYMANAGER_H
 
+#include "crypto/cipher.h"
+
 #include <QByteArray>
 
 namespace Lvk
@@ -72,6 +74,16 @@ public:
      * Returns the initialization vector for the given \a role
      */
     virtual QByteArray getIV(Role role) = 0;
+
+    /**
+     * Returns the cipher suite used to encrypt data for the given \a role. By default,
+     * local stats use Aes128GcmSuite. Other roles use BlowfishCbcSuite since their data
+     * is also read by external tools.
+     */
+    virtual Cipher::Suite cipherSuite(Role role)
+    {
+        return role == LocalStatsRole ? Cipher::Aes128GcmSuite : Cipher::BlowfishCbcSuite;
+    }
 };
 
 /// @}
@@ -25,6 +25,8 @@
 #include "da-clue/genericscript.h"
 #include "da-clue/analyzedline.h"
 
+#include <QPair>
+
 namespace Lvk
 {
 
@@ -93,6 +95,13 @@ public:
  */
 typedef QList<AnalyzedScript> AnalyzedList;
 
+
+/**
+ * \brief The LineIndexList class provides a list of pairs (script index, line index) that
+ *        identify lines of an AnalyzedList
+ */
+typedef QList< QPair<int, int> > LineIndexList;
+
 /// @}
 
 } // namespace Clue
@@ -23,6 +23,10 @@
 #include "back-end/appfacade.h"
 #include "common/globalstrings.h"
 #include "common/version.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "common/json.h"
+#include "common/csvrow.h"
 
 #include <QtGlobal>
 #include <QtAlgorithms>
@@ -30,6 +34,13 @@
 #include <QStringList>
 #include <QFileInfo>
 #include <QDir>
+#include <QDataStream>
+#include <QTextStream>
+#include <QTemporaryFile>
+#include <QProcess>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
 
 #include <iostream>
 
@@ -39,6 +50,9 @@
 #define BATCH_OUTPUT_FILENAME   "batch-mode-result.txt"
 #endif
 
+#define BATCH_CACHE_FILENAME    "batch-mode-cache.dat"
+#define WORKER_POLL_INTERVAL    500     // Milliseconds between reads of the worker outputs
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -48,6 +62,18 @@ namespace
 
 const int PRINT_FILENAME_MAX_LEN = 30;
 
+const quint32 WORKER_OUTPUT_MAGIC_NUMBER = 0x62617464;  // "batd"
+const quint32 CACHE_MAGIC_NUMBER         = 0x62636164;  // "bcad"
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString cacheFilename()
+{
+    QString dataPath = Lvk::Cmn::SettingsSnapshot::current().value(SETTING_DATA_PATH).toString();
+
+    return dataPath + "/" + BATCH_CACHE_FILENAME;
+}
+
 //--------------------------------------------------------------------------------------------------
 
 inline QString covFormat(float f)
@@ -57,6 +83,23 @@ inline QString covFormat(float f)
 
 //--------------------------------------------------------------------------------------------------
 
+inline QString memFormat(const QVariantMap &m)
+{
+    return QString("Nodes: %1 (words %2, wildcards %3, variables %4)  Outputs: %5 in %6 "
+                   "entries  Symbols: %7 (%8 bytes)  Targets: %9")
+            .arg(m.value("nodes").toInt())
+            .arg(m.value("wordNodes").toInt())
+            .arg(m.value("wildcardNodes").toInt())
+            .arg(m.value("variableNodes").toInt())
+            .arg(m.value("outputs").toInt())
+            .arg(m.value("omapEntries").toInt())
+            .arg(m.value("symbols").toInt())
+            .arg(m.value("symbolBytes").toLongLong())
+            .arg(m.value("targets").toInt());
+}
+
+//--------------------------------------------------------------------------------------------------
+
 inline float globalCoverage(const Lvk::Clue::AnalyzedList &ascripts)
 {
     if (ascripts.isEmpty()) {
@@ -92,7 +135,7 @@ inline QString truncatedFilename(const QString &filename)
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Clue::BatchAnalyzer::BatchAnalyzer(QObject *parent /*= 0*/)
-    : QObject(parent), m_appFacade(0)
+    : QObject(parent), m_appFacade(0), m_jobs(1), m_cacheEnabled(true), m_csvReport(false)
     #ifdef WIN32
       , m_outputFile(BATCH_OUTPUT_FILENAME)
     #endif
@@ -130,14 +173,75 @@ int Lvk::Clue::BatchAnalyzer::exec(const QString &target)
     }
     #endif
 
-    if (!m_appFacade) {
-        m_appFacade = new BE::AppFacade();
+    if (!m_reportFile.fileName().isEmpty() && !openReport()) {
+        printErr(tr("Cannot create file %1").arg(m_reportFile.fileName()));
+
+        return 2;
     }
 
     m_data.clear();
     analyze(target, 0);
-    qSort(m_data);
-    printDataCollection();
+
+    // Use cached results of files that did not change since the last execution
+
+    QList<QByteArray> keys;
+    QList<int> pending;
+
+    if (m_cacheEnabled) {
+        loadCache();
+        hashScripts();
+    }
+
+    for (int i = 0; i < m_data.size(); ++i) {
+        QByteArray key = m_cacheEnabled ? entryKey(m_data[i].filename) : QByteArray();
+        DataCache::const_iterator it = m_cache.find(key);
+
+        if (!key.isEmpty() && it != m_cache.constEnd()) {
+            m_data[i].username = it->username;
+            m_data[i].character = it->character;
+            m_data[i].ascripts = it->ascripts;
+            m_data[i].globalCoverage = it->globalCoverage;
+            m_data[i].cached = true;
+            reportEntry(m_data[i]);
+        } else {
+            pending.append(i);
+        }
+
+        keys.append(key);
+    }
+
+    if (m_data.size() > pending.size()) {
+        printInfo(tr("Using cached results for %1 files").arg(m_data.size() - pending.size()));
+    }
+
+    if (m_jobs > 1 && pending.size() > 1) {
+        runWorkers(pending);
+    } else {
+        foreach (int i, pending) {
+            analyzeEntry(m_data[i]);
+            reportEntry(m_data[i]);
+        }
+    }
+
+    if (m_cacheEnabled) {
+        // Errors are not cached since some of them might be temporary
+        foreach (int i, pending) {
+            if (!keys[i].isEmpty() && !m_data[i].hasError()) {
+                m_cache[keys[i]] = m_data[i];
+            }
+        }
+
+        saveCache();
+    }
+
+    // Results of the report were already printed as they were analyzed
+    if (m_reportFile.isOpen()) {
+        m_reportFile.close();
+        printInfo(tr("Report written to %1").arg(m_reportFile.fileName()));
+    } else {
+        qSort(m_data);
+        printDataCollection();
+    }
 
     return dataCollectionHasError() ? 3 : 0;
 }
@@ -215,11 +319,25 @@ void Lvk::Clue::BatchAnalyzer::analyzeDir(const QString &dirname, int depth)
 
 void Lvk::Clue::BatchAnalyzer::analyzeFile(const QString &filename, int depth)
 {
-    DataEntry entry(filename, depth);
+    // Files are analyzed once all of them have been collected
+    m_data.append(DataEntry(filename, depth));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::analyzeEntry(DataEntry &entry)
+{
+    QElapsedTimer timer;
+    timer.start();
 
-    if (m_appFacade->load(filename)) {
+    if (!m_appFacade) {
+        m_appFacade = new BE::AppFacade();
+    }
+
+    if (m_appFacade->load(entry.filename)) {
         QString username = m_appFacade->username();
         entry.username = username.isEmpty() ? tr("(No username)") : username;
+        entry.memory = m_appFacade->nlpMemoryReport();
 
         QString character = m_appFacade->currentCharacter();
         if (!character.isEmpty()) {
@@ -238,7 +356,460 @@ void Lvk::Clue::BatchAnalyzer::analyzeFile(const QString &filename, int depth)
         entry.error = tr("Cannot load file");
     }
 
-    m_data.append(entry);
+    entry.msecs = timer.elapsed();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::setJobs(int jobs)
+{
+    m_jobs = qMax(jobs, 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::setCacheEnabled(bool enabled)
+{
+    m_cacheEnabled = enabled;
+
+    if (!enabled) {
+        m_cache.clear();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::setReportFile(const QString &filename)
+{
+    m_reportFile.setFileName(filename);
+    m_csvReport = filename.endsWith(".csv", Qt::CaseInsensitive);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::runWorkers(const QList<int> &pending)
+{
+    int workers = qMin(m_jobs, pending.size());
+
+    printInfo(tr("Analyzing %1 files with %2 workers...").arg(pending.size()).arg(workers));
+
+    QList<QTemporaryFile *> listFiles;
+    QList<QTemporaryFile *> outputFiles;
+    QList<QProcess *> procs;
+
+    // Files are dealt round-robin. Each worker gets the index and name of its files
+
+    for (int k = 0; k < workers; ++k) {
+        QTemporaryFile *listFile = new QTemporaryFile(this);
+        QTemporaryFile *outputFile = new QTemporaryFile(this);
+        QProcess *proc = new QProcess(this);
+
+        listFiles.append(listFile);
+        outputFiles.append(outputFile);
+        procs.append(proc);
+
+        if (!listFile->open() || !outputFile->open()) {
+            printErr(tr("Cannot create temporary files for worker %1").arg(k));
+            continue;
+        }
+
+        QTextStream list(listFile);
+        list.setCodec("UTF-8");
+        for (int j = k; j < pending.size(); j += workers) {
+            list << pending[j] << " " << m_data[pending[j]].filename << "\n";
+        }
+        list.flush();
+
+        listFile->close();
+        outputFile->close();
+
+        proc->setProcessChannelMode(QProcess::ForwardedChannels);
+        proc->start(QCoreApplication::applicationFilePath(), QStringList()
+                    << BATCH_WORKER_OPTION << listFile->fileName() << outputFile->fileName());
+    }
+
+    // Merge results by index as workers write them, so the order does not depend on the workers
+
+    QVector<bool> analyzed(m_data.size(), false);
+    QList<QFile *> outputs;
+
+    for (int k = 0; k < workers; ++k) {
+        outputs.append(new QFile(outputFiles[k]->fileName()));
+        outputs[k]->open(QFile::ReadOnly);
+    }
+
+    forever {
+        QProcess *running = 0;
+
+        for (int k = 0; k < workers; ++k) {
+            readWorkerOutput(*outputs[k], analyzed);
+
+            if (!running && procs[k]->state() != QProcess::NotRunning) {
+                running = procs[k];
+            }
+        }
+
+        if (!running) {
+            break;
+        }
+
+        running->waitForFinished(WORKER_POLL_INTERVAL);
+    }
+
+    for (int k = 0; k < workers; ++k) {
+        readWorkerOutput(*outputs[k], analyzed);
+
+        if (procs[k]->error() == QProcess::FailedToStart
+                || procs[k]->exitStatus() != QProcess::NormalExit || procs[k]->exitCode() != 0) {
+            printWarn(tr("Worker %1 finished with errors").arg(k));
+        }
+    }
+
+    foreach (int i, pending) {
+        if (!analyzed[i]) {
+            m_data[i].error = tr("Cannot analyze file");
+            reportEntry(m_data[i]);
+        }
+    }
+
+    qDeleteAll(outputs);
+    qDeleteAll(procs);
+    qDeleteAll(listFiles);
+    qDeleteAll(outputFiles);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Reads the results written so far by a worker. A result that is still being written is read the
+// next time.
+void Lvk::Clue::BatchAnalyzer::readWorkerOutput(QFile &file, QVector<bool> &analyzed)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+
+    QDataStream istream(&file);
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    if (file.pos() == 0) {
+        quint32 magic = 0;
+        istream >> magic;
+
+        if (istream.status() != QDataStream::Ok) {
+            file.seek(0);
+            return;
+        }
+
+        if (magic != WORKER_OUTPUT_MAGIC_NUMBER) {
+            file.close();
+            return;
+        }
+    }
+
+    forever {
+        qint64 pos = file.pos();
+        qint32 i = -1;
+        qint64 msecs = 0;
+        DataEntry entry;
+
+        istream >> i >> msecs;
+        readEntry(istream, entry);
+
+        if (istream.status() != QDataStream::Ok) {
+            file.seek(pos);
+            return;
+        }
+
+        if (i < 0 || i >= m_data.size()) {
+            file.close();
+            return;
+        }
+
+        entry.filename = m_data[i].filename;
+        entry.depth = m_data[i].depth;
+        entry.msecs = msecs;
+        m_data[i] = entry;
+        analyzed[i] = true;
+
+        reportEntry(m_data[i]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Clue::BatchAnalyzer::execWorker(const QString &listFilename,
+                                         const QString &outputFilename)
+{
+    QFile listFile(listFilename);
+    QFile outputFile(outputFilename);
+
+    if (!listFile.open(QFile::ReadOnly | QFile::Text)
+            || !outputFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        return 1;
+    }
+
+    QTextStream list(&listFile);
+    list.setCodec("UTF-8");
+
+    QDataStream ostream(&outputFile);
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << WORKER_OUTPUT_MAGIC_NUMBER;
+
+    while (!list.atEnd()) {
+        QString line = list.readLine();
+        int sep = line.indexOf(' ');
+
+        if (sep <= 0) {
+            continue;
+        }
+
+        DataEntry entry(line.mid(sep + 1), 0);
+        analyzeEntry(entry);
+
+        ostream << (qint32)line.left(sep).toInt() << entry.msecs;
+        writeEntry(ostream, entry);
+
+        outputFile.flush();
+    }
+
+    return ostream.status() == QDataStream::Ok ? 0 : 2;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::writeEntry(QDataStream &ostream, const DataEntry &entry)
+{
+    // Only what is printed by printBrief() and printDetails() is written
+    ostream << entry.username << entry.character << entry.error << entry.globalCoverage
+            << entry.memory << (quint32)entry.ascripts.size();
+
+    foreach (const Clue::AnalyzedScript &s, entry.ascripts) {
+        ostream << s.filename << s.coverage;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::readEntry(QDataStream &istream, DataEntry &entry)
+{
+    quint32 nscripts = 0;
+
+    istream >> entry.username >> entry.character >> entry.error >> entry.globalCoverage
+            >> entry.memory >> nscripts;
+
+    for (quint32 j = 0; j < nscripts && istream.status() == QDataStream::Ok; ++j) {
+        Clue::AnalyzedScript ascript;
+        istream >> ascript.filename >> ascript.coverage;
+        entry.ascripts.append(ascript);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::loadCache()
+{
+    m_cache.clear();
+
+    QFile file(cacheFilename());
+
+    if (!file.open(QFile::ReadOnly)) {
+        return;
+    }
+
+    QDataStream istream(&file);
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic = 0;
+    istream >> magic;
+
+    if (magic != CACHE_MAGIC_NUMBER) {
+        printWarn(tr("Ignoring invalid cache file %1").arg(file.fileName()));
+        return;
+    }
+
+    while (!istream.atEnd() && istream.status() == QDataStream::Ok) {
+        QByteArray key;
+        DataEntry entry;
+
+        istream >> key;
+        readEntry(istream, entry);
+
+        if (istream.status() == QDataStream::Ok) {
+            m_cache[key] = entry;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::saveCache()
+{
+    QFile file(cacheFilename());
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        printWarn(tr("Cannot write cache file %1").arg(file.fileName()));
+        return;
+    }
+
+    QDataStream ostream(&file);
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << CACHE_MAGIC_NUMBER;
+
+    for (DataCache::const_iterator it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        ostream << it.key();
+        writeEntry(ostream, it.value());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::BatchAnalyzer::hashScripts()
+{
+    // Scripts are filtered by character after loading the chatbot file, so we hash all of them
+
+    QString cluePath = Cmn::SettingsSnapshot::current().value(SETTING_CLUE_PATH).toString();
+
+    QDir dir(cluePath);
+    QStringList nameFilters;
+    nameFilters.append("*." SCRIPT_FILE_EXT);
+    QStringList files = dir.entryList(nameFilters, QDir::Files, QDir::Name);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    hash.addData(APP_VERSION_STR);
+    hash.addData(APP_VERSION_REV);
+
+    foreach (const QString &filename, files) {
+        QFile file(dir.filePath(filename));
+
+        if (file.open(QFile::ReadOnly)) {
+            hash.addData(filename.toUtf8());
+            hash.addData(file.readAll());
+        }
+    }
+
+    m_scriptsHash = hash.result();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::Clue::BatchAnalyzer::entryKey(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(file.readAll());
+
+    return hash.result() + m_scriptsHash;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Clue::BatchAnalyzer::openReport()
+{
+    if (!m_reportFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+
+    if (m_csvReport) {
+        Cmn::CsvRow header(QStringList() << "file" << "username" << "character" << "coverage"
+                           << "nodes" << "msecs" << "cached" << "error" << "scripts");
+
+        m_reportFile.write(header.toString().toUtf8() + "\n");
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Writes the entry to the report and prints it. The report is flushed, so it can be followed
+// while files are analyzed.
+void Lvk::Clue::BatchAnalyzer::reportEntry(DataEntry &entry)
+{
+    if (!m_reportFile.isOpen()) {
+        return;
+    }
+
+    QByteArray record;
+
+    if (m_csvReport) {
+        QStringList scripts;
+        foreach (const Clue::AnalyzedScript &s, entry.ascripts) {
+            scripts.append(QString("%1:%2").arg(s.filename).arg(s.coverage, 0, 'f', 2));
+        }
+
+        Cmn::CsvRow row;
+        row.append(entry.filename);
+        row.append(entry.username);
+        row.append(entry.character);
+        row.append(QString::number(entry.globalCoverage, 'f', 2));
+        row.append(QString::number(entry.memory.value("nodes").toInt()));
+        row.append(QString::number(entry.msecs));
+        row.append(entry.cached ? "1" : "0");
+        row.append(entry.error);
+        row.append(scripts.join("|"));
+
+        record = row.toString().toUtf8();
+    } else {
+        Cmn::JsonWriter w;
+
+        w.beginObject();
+        w.writeKey("file");
+        w.writeString(entry.filename);
+        w.writeKey("username");
+        w.writeString(entry.username);
+        w.writeKey("character");
+        w.writeString(entry.character);
+        w.writeKey("coverage");
+        w.writeNumber(entry.globalCoverage, 2);
+        w.writeKey("scripts");
+        w.beginArray();
+        foreach (const Clue::AnalyzedScript &s, entry.ascripts) {
+            w.beginObject();
+            w.writeKey("file");
+            w.writeString(s.filename);
+            w.writeKey("coverage");
+            w.writeNumber(s.coverage, 2);
+            w.endObject();
+        }
+        w.endArray();
+        w.writeKey("nodes");
+        w.writeNumber(static_cast<qint64>(entry.memory.value("nodes").toInt()));
+        w.writeKey("msecs");
+        w.writeNumber(entry.msecs);
+        w.writeKey("cached");
+        w.writeBool(entry.cached);
+        w.writeKey("error");
+        if (entry.hasError()) {
+            w.writeString(entry.error);
+        } else {
+            w.writeNull();
+        }
+        w.endObject();
+
+        record = w.toByteArray();
+    }
+
+    record += "\n";
+
+    if (m_reportFile.write(record) != record.size() || !m_reportFile.flush()) {
+        printWarn(tr("Cannot write file %1").arg(m_reportFile.fileName()));
+    }
+
+    printBrief(entry);
+
+    // Without cache, reported details are not needed anymore
+    if (!m_cacheEnabled) {
+        entry.ascripts.clear();
+        entry.memory.clear();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -258,12 +829,13 @@ void Lvk::Clue::BatchAnalyzer::printBrief(const DataEntry &entry)
             strPartialCov += covFormat(s.coverage);
         }
 
-        printInfo(tr("%1 %2 %3 Global: %4   Partials: %5")
+        printInfo(tr("%1 %2 %3 Global: %4   Partials: %5   Nodes: %6")
                   .arg(truncatedFilename(entry.filename), -PRINT_FILENAME_MAX_LEN)
                   .arg(entry.username, -30, ' ')
                   .arg(entry.character, -12, ' ')
                   .arg(covFormat(entry.globalCoverage))
-                  .arg(strPartialCov));
+                  .arg(strPartialCov)
+                  .arg(entry.memory.value("nodes").toInt()));
     }
 }
 
@@ -282,12 +854,13 @@ void Lvk::Clue::BatchAnalyzer::printDetails(const DataEntry &entry)
         }
 
         printInfo(tr("Chabot File: %1\nUsername: %2\nCharacter: %3\n"
-                     "Global Coverage: %4\nPartial Coverages:\n%5")
+                     "Global Coverage: %4\nPartial Coverages:\n%5Memory:\n  %6")
                   .arg(entry.filename)
                   .arg(entry.username)
                   .arg(entry.character)
                   .arg(covFormat(entry.globalCoverage))
-                  .arg(strPartialCov));
+                  .arg(strPartialCov)
+                  .arg(memFormat(entry.memory)));
     }
 }
 
@@ -25,9 +25,16 @@
 #include <QString>
 #include <QObject>
 #include <QFile>
+#include <QHash>
+#include <QByteArray>
+#include <QDataStream>
+#include <QVariantMap>
+#include <QVector>
 
 #include "da-clue/analyzedscript.h"
 
+#define BATCH_WORKER_OPTION     "--batch-worker"    // Command line option of worker processes
+
 namespace Lvk
 {
 
@@ -49,6 +56,18 @@ namespace Clue
 /**
  * \brief The BatchAnalyzer class provides a batch execution mode to show script coverage in the
  *        OS console
+ *
+ * Files can be analyzed by several worker processes simultaneously, see setJobs(). Workers are
+ * new instances of the application executed with execWorker(). Each one has its own NLP engine
+ * and lemmatizer, since most of the back-end is not thread-safe. Results are always merged in
+ * the same order, so the output does not depend on the amount of workers.
+ *
+ * Results are cached on disk. The cache key is a hash of the chatbot file, the clue scripts and
+ * the application version, hence only new or modified files are analyzed again.
+ *
+ * Optionally, results are written to a machine-readable report as soon as each file is analyzed,
+ * see setReportFile(). In this mode results are printed in completion order and they are not
+ * sorted by coverage.
  */
 class BatchAnalyzer : public QObject
 {
@@ -71,25 +90,54 @@ public:
      */
     int exec(const QString &target);
 
+    /**
+     * Sets the maximum amount of worker processes to analyze files. By default is 1, i.e. files
+     * are analyzed by this process one after another.
+     */
+    void setJobs(int jobs);
+
+    /**
+     * Enables or disables the cache of results. By default is enabled.
+     */
+    void setCacheEnabled(bool enabled);
+
+    /**
+     * Sets the report file to \a filename. If \a filename ends with ".csv" the report has one CSV
+     * row per chatbot file. Otherwise, it has one JSON object per line (JSON Lines). Each record
+     * has the coverage of each script, the analysis time in milliseconds and whether the result
+     * was cached. By default there is no report.
+     */
+    void setReportFile(const QString &filename);
+
+    /**
+     * Executes the application as a batch mode worker. Analyzes the files listed in
+     * \a listFilename and writes the results in \a outputFilename. Returns 0 if success or not
+     * zero if there was an error.
+     */
+    int execWorker(const QString &listFilename, const QString &outputFilename);
+
 private:
 
     struct DataEntry
     {
         DataEntry()
-            : depth(0), globalCoverage(0)
+            : depth(0), globalCoverage(0), msecs(0), cached(false)
         { }
 
         DataEntry(const QString &filename, int depth)
-            : filename(filename), depth(depth), globalCoverage(0)
+            : filename(filename), depth(depth), globalCoverage(0), msecs(0), cached(false)
         { }
 
         QString filename;
         QString username;
         QString character;
         AnalyzedList ascripts;
+        QVariantMap memory;
         QString error;
         int depth;
         float globalCoverage;
+        qint64 msecs;           // Analysis time, not cached
+        bool cached;
 
         bool hasError() const
         {
@@ -104,9 +152,16 @@ private:
     };
 
     typedef QList<DataEntry> DataCollection;
+    typedef QHash<QByteArray, DataEntry> DataCache;
 
     BE::AppFacade *m_appFacade;
     DataCollection m_data;
+    int m_jobs;
+    bool m_cacheEnabled;
+    DataCache m_cache;
+    QByteArray m_scriptsHash;
+    QFile m_reportFile;
+    bool m_csvReport;
 
 #ifdef WIN32
     QFile m_outputFile;
@@ -115,6 +170,17 @@ private:
     void analyze(const QString &target, int depth);
     void analyzeDir(const QString &dirname, int depth);
     void analyzeFile(const QString &filename, int depth);
+    void analyzeEntry(DataEntry &entry);
+    void runWorkers(const QList<int> &pending);
+    void readWorkerOutput(QFile &file, QVector<bool> &analyzed);
+    void loadCache();
+    void saveCache();
+    void hashScripts();
+    QByteArray entryKey(const QString &filename);
+    static void writeEntry(QDataStream &ostream, const DataEntry &entry);
+    static void readEntry(QDataStream &istream, DataEntry &entry);
+    bool openReport();
+    void reportEntry(DataEntry &entry);
     void printDataCollection();
     bool dataCollectionHasError();
     void printBrief(const DataEntry &entry);
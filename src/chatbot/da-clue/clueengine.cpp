@@ -24,15 +24,20 @@
 #include "da-clue/script.h"
 #include "nlp-engine/enginefactory.h"
 #include "nlp-engine/nlpproperties.h"
+#include "nlp-engine/syntax.h"
 
+#include <QRegExp>
 #include <QtDebug>
+#include <memory>
 
 //--------------------------------------------------------------------------------------------------
 // ClueEngine
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Clue::ClueEngine::ClueEngine()
-    : m_engine(Nlp::EngineFactory().createEngine())
+    : m_engine(Nlp::EngineFactory().createEngine()),
+      m_source(0),
+      m_categories(false)
 {
 }
 
@@ -47,7 +52,46 @@ Lvk::Clue::ClueEngine::~ClueEngine()
 
 void Lvk::Clue::ClueEngine::setRules(const Nlp::RuleList &rules)
 {
+    if (m_source) {
+        return;
+    }
+
     m_engine->setRules(rules);
+
+    m_rules.clear();
+    foreach (const Nlp::Rule &rule, rules) {
+        m_rules.insert(rule.id(), rule);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::ClueEngine::setEngine(Nlp::Engine *engine)
+{
+    delete m_engine;
+
+    m_source = engine;
+    m_engine = 0;
+
+    if (!m_source) {
+        m_engine = Nlp::EngineFactory().createEngine();
+        m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, m_categories);
+    }
+
+    m_regexp.clear();
+    m_rules.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::ClueEngine::takeSession()
+{
+    // The session keeps the trees compiled by m_source so far, even if its rules change later
+
+    delete m_engine;
+
+    m_engine = m_source->createSession();
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, m_categories);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -61,14 +105,33 @@ void Lvk::Clue::ClueEngine::setEvasive(const QString &evasive)
 
 void Lvk::Clue::ClueEngine::setCategoriesEnabled(bool enabled)
 {
-    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, enabled);
+    if (m_categories == enabled) {
+        return;
+    }
+
+    // The last analysis is no longer valid, rules are analyzed again as if they were new
+    clear();
+
+    m_categories = enabled;
+
+    if (m_engine) {
+        m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, enabled);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::Clue::ClueEngine::clear()
 {
-    m_engine->clear();
+    if (m_source) {
+        delete m_engine;
+        m_engine = 0;
+    } else {
+        m_engine->clear();
+    }
+
+    m_regexp.clear();
+    m_rules.clear();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -76,6 +139,15 @@ void Lvk::Clue::ClueEngine::clear()
 void Lvk::Clue::ClueEngine::analyze(const Clue::ScriptList &scripts,
                                     Clue::AnalyzedList &ascripts)
 {
+    if (m_source) {
+        takeSession();
+
+        m_rules.clear();
+        foreach (const Nlp::Rule &rule, m_engine->rules()) {
+            m_rules.insert(rule.id(), rule);
+        }
+    }
+
     Clue::AnalyzedScript as;
 
     foreach (const Clue::Script &s, scripts) {
@@ -93,60 +165,227 @@ void Lvk::Clue::ClueEngine::analyze(const Clue::Script &script, Clue::AnalyzedSc
     ascript.character = script.character;
     ascript.number = script.number;
 
-    int matches = 0;
-    Nlp::Engine::MatchList ml;
+    qDebug() << "ClueEngine: Analyzing script:"  << script.filename;
+
+    if (!m_engine) {
+        takeSession();
+    }
+
+    foreach (const Clue::ScriptLine &line, script) {
+        ascript.append(analyze(m_engine, line));
+    }
+
+    updateCoverage(ascript);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Clue::AnalyzedLine Lvk::Clue::ClueEngine::analyze(Nlp::Engine *engine,
+                                                       const Clue::ScriptLine &line)
+{
+    Nlp::Result result;
 
     // FIXME not setting real score and outputIdx
 
-    qDebug() << "ClueEngine: Analyzing script:"  << script.filename;
+    qDebug() << "ClueEngine: Getting response for question:"  << line.question;
 
-    foreach (const Clue::ScriptLine &line, script) {
-        qDebug() << "ClueEngine: Getting response for question:"  << line.question;
+    engine->getResponse(line.question, "", result);
+    const QString &resp = result.output;
+    QString topic = engine->getCurrentTopic("");
 
-        QString resp = m_engine->getResponse(line.question, ml);
-        QString topic = m_engine->getCurrentTopic("");
+    if (!result.isValid()) {
+        qDebug() << "ClueEngine: no response!";
 
-        if (ml.isEmpty()) {
-            qDebug() << "ClueEngine: no response!";
+        Clue::AnalyzedLine aline(line);
 
-            Clue::AnalyzedLine aline(line);
+        aline.status = Clue::NoAnswerFound;
+        aline.answer = m_evasive;
+        aline.topic = topic;
 
-            aline.status = Clue::NoAnswerFound;
-            aline.answer = m_evasive;
-            aline.topic = topic;
+        return aline;
+    }
 
-            ascript.append(aline);
-        } else {
-            qDebug() << "ClueEngine: Checking response:" << resp
-                     << "with expected pattern:" << line.expAnswer
-                     << "and forbidden pattern:" << line.forbidAnswer;
+    qDebug() << "ClueEngine: Checking response:" << resp
+             << "with expected pattern:" << line.expAnswer
+             << "and forbidden pattern:" << line.forbidAnswer;
 
-            Clue::AnalyzedLine aline(line, ml[0].first, ml[0].second, 0, resp);
+    Clue::AnalyzedLine aline(line, result.ruleId, result.inputIdx, 0, resp);
 
-            aline.topic = topic;
+    aline.topic = topic;
 
-            if (!m_regexp.exactMatch(line.expAnswer, resp)) {
-                qDebug() << "ClueEngine: Mismatch expected answer!";
-                aline.status = Clue::MismatchExpectedAnswer;
-            } else if (m_regexp.exactMatch(line.forbidAnswer, resp)) {
-                qDebug() << "ClueEngine: Match forbidden answer!";
-                aline.status = Clue::MatchForbiddenAnswer;
-            } else {
-                qDebug() << "ClueEngine: Answer OK";
-                aline.status = Clue::AnswerOk;
-                aline.outputIdx = 0;
-                ++matches;
-            }
+    if (!m_regexp.exactMatch(line.expAnswer, resp)) {
+        qDebug() << "ClueEngine: Mismatch expected answer!";
+        aline.status = Clue::MismatchExpectedAnswer;
+    } else if (m_regexp.exactMatch(line.forbidAnswer, resp)) {
+        qDebug() << "ClueEngine: Match forbidden answer!";
+        aline.status = Clue::MatchForbiddenAnswer;
+    } else {
+        qDebug() << "ClueEngine: Answer OK";
+        aline.status = Clue::AnswerOk;
+        aline.outputIdx = 0;
+    }
+
+    return aline;
+}
 
-            ascript.append(aline);
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::ClueEngine::updateCoverage(Clue::AnalyzedScript &ascript)
+{
+    int matches = 0;
+
+    foreach (const Clue::AnalyzedLine &aline, ascript) {
+        if (aline.status == Clue::AnswerOk) {
+            ++matches;
         }
     }
 
-    if (script.size() > 0) {
-        ascript.coverage = matches/(float)script.size()*100;
+    if (ascript.size() > 0) {
+        ascript.coverage = matches/(float)ascript.size()*100;
     } else {
         ascript.coverage = 100; //?
     }
 }
 
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::ClueEngine::reanalyze(const Nlp::RuleList &rules, Clue::AnalyzedList &ascripts,
+                                      Clue::LineIndexList *changed /*= 0*/)
+{
+    QSet<Nlp::RuleId> changedIds;
+    Nlp::RuleList changedRules;
+
+    if (m_source) {
+        takeSession();
+    }
+
+    updateRules(rules, changedIds, changedRules);
+
+    qDebug() << "ClueEngine: Reanalyzing scripts," << changedIds.size() << "rules changed";
+
+    std::auto_ptr<Nlp::Engine> session;
+    std::auto_ptr<Nlp::Engine> probe;
+    QSet<Nlp::RuleId> recursive;
+
+    if (m_categories) {
+        // Lines depend on the topic left by the previous lines, start over with fresh topics
+        if (!changedIds.isEmpty()) {
+            session.reset(m_engine->createSession());
+        }
+    } else if (!changedIds.isEmpty()) {
+        // Engine with the new rules only. A line that matches any of them could have a
+        // different response now.
+        probe.reset(Nlp::EngineFactory().createEngine());
+        probe->setRules(changedRules);
+
+        // The response of a recursive rule depends on other rules
+        QRegExp recursion(RECURSION_REGEX);
+        foreach (const Nlp::Rule &rule, m_rules) {
+            foreach (const QString &output, rule.output()) {
+                if (output.contains(recursion)) {
+                    recursive.insert(rule.id());
+                    break;
+                }
+            }
+        }
+    }
+
+    // Every line is probed in a single batch, so questions are lemmatized at once
+    QList<Nlp::ResultList> probeResults;
+
+    if (probe.get()) {
+        QStringList questions;
+        foreach (const Clue::AnalyzedScript &ascript, ascripts) {
+            foreach (const Clue::AnalyzedLine &line, ascript) {
+                questions.append(line.question);
+            }
+        }
+
+        probe->getResponses(questions, "", probeResults);
+    }
+
+    int lineCount = 0;
+
+    for (int i = 0; i < ascripts.size(); ++i) {
+        bool scriptChanged = false;
+
+        for (int j = 0; j < ascripts[i].size(); ++j) {
+            const Clue::AnalyzedLine &line = ascripts.at(i).at(j);
+            int lineIdx = lineCount++;
+
+            bool dirty = session.get()
+                    || changedIds.contains(line.ruleId)
+                    || recursive.contains(line.ruleId);
+
+            if (!dirty && probe.get()) {
+                dirty = !probeResults.value(lineIdx).isEmpty();
+            }
+
+            Clue::AnalyzedLine aline;
+
+            if (dirty) {
+                aline = analyze(session.get() ? session.get() : m_engine, line);
+            } else if (line.status == Clue::NoAnswerFound && line.answer != m_evasive) {
+                aline = line;
+                aline.answer = m_evasive;
+            } else {
+                continue;
+            }
+
+            if (aline != line) {
+                ascripts[i][j] = aline;
+                scriptChanged = true;
+
+                if (changed) {
+                    changed->append(qMakePair(i, j));
+                }
+            }
+        }
+
+        if (scriptChanged) {
+            updateCoverage(ascripts[i]);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::ClueEngine::updateRules(const Nlp::RuleList &rules,
+                                        QSet<Nlp::RuleId> &changedIds,
+                                        Nlp::RuleList &changedRules)
+{
+    QHash<Nlp::RuleId, Nlp::Rule> newRules;
+
+    foreach (const Nlp::Rule &rule, rules) {
+        newRules.insert(rule.id(), rule);
 
+        QHash<Nlp::RuleId, Nlp::Rule>::const_iterator it = m_rules.find(rule.id());
+
+        if (it != m_rules.constEnd() && *it == rule) {
+            continue;
+        }
+
+        // Sessions of m_source already have the new rules
+        if (!m_source) {
+            if (it == m_rules.constEnd()) {
+                m_engine->addRule(rule);
+            } else {
+                m_engine->updateRule(rule);
+            }
+        }
+
+        changedIds.insert(rule.id());
+        changedRules.append(rule);
+    }
+
+    foreach (Nlp::RuleId id, m_rules.keys()) {
+        if (!newRules.contains(id)) {
+            if (!m_source) {
+                m_engine->removeRule(id);
+            }
+            changedIds.insert(id);
+        }
+    }
+
+    m_rules = newRules;
+}
@@ -28,6 +28,9 @@
 #include "da-clue/regexp.h"
 #include "da-clue/analyzedscript.h"
 
+#include <QHash>
+#include <QSet>
+
 namespace Lvk
 {
 
@@ -43,6 +46,12 @@ namespace Clue
 
 /**
  * \brief The ClueEngine class provides the engine to analyze scripts againts a set of rules.
+ *
+ * By default, the ClueEngine compiles the rules given with setRules() in an engine of its own.
+ * If an engine is given with setEngine(), each analysis runs on a new session of that engine
+ * instead. Sessions share the trees already compiled by the engine, so no rules are compiled
+ * again, and have their own topics, so the analysis does not change the topics of the engine
+ * and can run in another thread.
  */
 class ClueEngine
 {
@@ -59,22 +68,33 @@ public:
     ~ClueEngine();
 
     /**
-     * Sets \a rules as the current rules to analize scripts
+     * Sets \a rules as the current rules to analize scripts. If an engine was set with
+     * setEngine(), rules are taken from the engine and this method does nothing.
      */
     void setRules(const Nlp::RuleList &rules);
 
+    /**
+     * Analyzes scripts with sessions of \a engine instead of an engine of its own. Each call to
+     * analyze(const Clue::ScriptList &, Clue::AnalyzedList &) or reanalyze() takes a new session
+     * with the rules \a engine has at that time. If \a engine is null, the object goes back to
+     * an engine of its own without rules. The object does not own \a engine and clear() must be
+     * called before \a engine is destroyed.
+     */
+    void setEngine(Nlp::Engine *engine);
+
     /**
      * Sets \a evasive as the response when there is no match
      */
     void setEvasive(const QString &evasive);
 
     /**
-     *
+     * Enables or disables categories. If enabled, rules on the current category are prefered.
+     * Changing this setting clears the rules.
      */
     void setCategoriesEnabled(bool enabled);
 
     /**
-     * Clears the rules
+     * Clears the rules. If an engine was set with setEngine(), the current session is released.
      */
     void clear();
 
@@ -88,13 +108,35 @@ public:
      */
     void analyze(const Clue::ScriptList & scripts, Clue::AnalyzedList &ascripts);
 
+    /**
+     * Sets \a rules as the current rules and updates \a ascripts, the result of the last
+     * analysis, accordingly.
+     *
+     * Only lines whose matched rule has changed or that match any rule added or changed are
+     * analyzed again. If categories are enabled, topics flow from line to line, so every line
+     * is analyzed again. If \a changed is not null, it contains the lines that have changed.
+     *
+     * If an engine was set with setEngine(), \a rules must be the rules of the engine.
+     */
+    void reanalyze(const Nlp::RuleList &rules, Clue::AnalyzedList &ascripts,
+                   Clue::LineIndexList *changed = 0);
+
 private:
     ClueEngine(const ClueEngine&);
     ClueEngine & operator=(const ClueEngine&);
 
-    Nlp::Engine *m_engine;
+    Nlp::Engine *m_engine;      // Null until the first analysis if m_source is set
+    Nlp::Engine *m_source;      // Engine whose sessions are analyzed, not owned
     Clue::RegExp m_regexp;
     QString m_evasive;
+    bool m_categories;
+    QHash<Nlp::RuleId, Nlp::Rule> m_rules;
+
+    Clue::AnalyzedLine analyze(Nlp::Engine *engine, const Clue::ScriptLine &line);
+    void updateCoverage(Clue::AnalyzedScript &ascript);
+    void takeSession();
+    void updateRules(const Nlp::RuleList &rules, QSet<Nlp::RuleId> &changedIds,
+                     Nlp::RuleList &changedRules);
 };
 
 /// @}
@@ -20,19 +20,23 @@
  */
 
 #include "da-clue/regexp.h"
-#include "nlp-engine/enginefactory.h"
+#include "nlp-engine/tree.h"
 #include "nlp-engine/rule.h"
+#include "nlp-engine/searchcontext.h"
+#include "nlp-engine/result.h"
 
 #include <QStringList>
 #include <QtDebug>
 
+#define PATTERN_CACHE_SIZE      1000    // Max amount of compiled patterns
+
 
 //--------------------------------------------------------------------------------------------------
 // RegExp
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Clue::RegExp::RegExp()
-    : m_engine(Nlp::EngineFactory().createEngine())
+    : m_patterns(PATTERN_CACHE_SIZE), m_hasLastStr(false)
 {
 }
 
@@ -40,7 +44,6 @@ Lvk::Clue::RegExp::RegExp()
 
 Lvk::Clue::RegExp::~RegExp()
 {
-    delete m_engine;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -53,13 +56,46 @@ bool Lvk::Clue::RegExp::exactMatch(const QString &pattern, const QString &str)
         return false;
     }
 
-    m_engine->clear();
-    m_engine->addRule(Nlp::Rule(1, pattern.split("|"), QStringList() << "dummy"));
+    const Nlp::Tree *tree = compile(pattern);
+
+    if (!m_hasLastStr || str != m_lastStr) {
+        tree->parseUserInput(str, m_lastWords);
+        m_lastStr = str;
+        m_hasLastStr = true;
+    }
 
-    Nlp::Engine::MatchList matches;
-    bool match = m_engine->getResponse(str, matches).size() > 0;
+    Nlp::Result result;
+    Nlp::SearchContext ctx;
+    tree->getResponse(m_lastWords, result, ctx);
+
+    bool match = result.output.size() > 0;
 
     qDebug() << "RegExp: Match?" << match;
 
     return match;
 }
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::RegExp::clear()
+{
+    m_patterns.clear();
+    m_lastStr.clear();
+    m_lastWords.clear();
+    m_hasLastStr = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Nlp::Tree * Lvk::Clue::RegExp::compile(const QString &pattern)
+{
+    Nlp::Tree *tree = m_patterns.object(pattern);
+
+    if (!tree) {
+        tree = new Nlp::Tree();
+        tree->add(Nlp::Rule(1, pattern.split("|"), QStringList() << "dummy"));
+        m_patterns.insert(pattern, tree);
+    }
+
+    return tree;
+}
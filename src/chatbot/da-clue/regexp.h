@@ -22,9 +22,10 @@
 #ifndef LVK_CLUE_REGEXP_H
 #define LVK_CLUE_REGEXP_H
 
-#include "nlp-engine/engine.h"
+#include "nlp-engine/word.h"
 
 #include <QString>
+#include <QCache>
 
 namespace Lvk
 {
@@ -32,6 +33,11 @@ namespace Lvk
 /// \addtogroup Lvk
 /// @{
 
+namespace Nlp
+{
+    class Tree;
+}
+
 namespace Clue
 {
 
@@ -41,6 +47,12 @@ namespace Clue
 
 /**
  * \brief The RegExp class provides pattern matching using the NLP engine regular expressions
+ *
+ * Each pattern is compiled once into an NLP tree and cached by pattern string. The last string
+ * matched is also cached, so checking the same string against several patterns lemmatizes it
+ * only once.
+ *
+ * This class is not thread-safe.
  */
 class RegExp
 {
@@ -62,11 +74,21 @@ public:
      */
     bool exactMatch(const QString &pattern, const QString &str);
 
+    /**
+     * Removes all compiled patterns. Patterns must be recompiled if the NLP tools change.
+     */
+    void clear();
+
 private:
     RegExp(const RegExp&);
     RegExp & operator=(const RegExp&);
 
-    Nlp::Engine *m_engine;
+    const Nlp::Tree *compile(const QString &pattern);
+
+    QCache<QString, Nlp::Tree> m_patterns;
+    QString m_lastStr;
+    Nlp::WordList m_lastWords;
+    bool m_hasLastStr;
 };
 
 /// @}
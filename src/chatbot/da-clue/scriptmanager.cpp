@@ -20,10 +20,12 @@
  */
 
 #include "da-clue/scriptmanager.h"
+#include "common/startuptimeline.h"
 #include "da-clue/scriptparser.h"
 #include "common/settings.h"
 #include "common/settingskeys.h"
 #include "common/globalstrings.h"
+#include "common/textsearch.h"
 
 #include <QStringList>
 #include <QDir>
@@ -31,6 +33,13 @@
 #include <QFileInfo>
 #include <QtDebug>
 #include <QObject>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QDateTime>
+#include <QMutex>
+#include <QMutexLocker>
+
+#define MIN_CONCURRENT_SCRIPTS      4   // Fewer scripts are parsed in the calling thread
 
 //--------------------------------------------------------------------------------------------------
 // Helpers
@@ -48,6 +57,109 @@ inline bool equalFilename(QString f1, QString f2)
 #endif
 }
 
+//--------------------------------------------------------------------------------------------------
+
+// Reads, deobfuscates and parses one script. Jobs of different files run concurrently, each
+// thread uses its own cipher. See Crypto::KeyCache::threadCipher()
+struct ParseJob
+{
+    ParseJob(const QString &filename = "", Lvk::Clue::ScriptFormat format = Lvk::Clue::XmlPlain)
+        : filename(filename), format(format), parsed(false) { }
+
+    void run()
+    {
+        parsed = parser.parse(filename, script, format);
+    }
+
+    QString filename;
+    Lvk::Clue::ScriptFormat format;
+    Lvk::Clue::ScriptParser parser;
+    Lvk::Clue::Script script;
+    bool parsed;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// The scripts of a character and the state of the directory and the files they were read from
+struct CharacterEntry
+{
+    QDateTime dirModified;
+    QStringList files;
+    QList<QDateTime> filesModified;
+    Lvk::Clue::ScriptList scripts;
+};
+
+struct CharacterCache
+{
+    QMutex mutex;
+    QHash<QString, CharacterEntry> entries;     // directory, format and character -> entry
+};
+
+Q_GLOBAL_STATIC(CharacterCache, characterCache)
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString characterKey(const QString &dir, Lvk::Clue::ScriptFormat format,
+                            const QString &name)
+{
+    return QFileInfo(dir).absoluteFilePath() + "\t" + QString::number(format) + "\t"
+            + name.toLower();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool findCachedCharacter(const QString &key, const QString &dir, Lvk::Clue::ScriptList &scripts)
+{
+    CharacterEntry entry;
+
+    {
+        QMutexLocker locker(&characterCache()->mutex);
+
+        QHash<QString, CharacterEntry>::const_iterator it = characterCache()->entries.find(key);
+
+        if (it == characterCache()->entries.constEnd()) {
+            return false;
+        }
+
+        entry = *it;
+    }
+
+    // Files are checked without holding the lock
+
+    if (QFileInfo(dir).lastModified() != entry.dirModified) {
+        return false;
+    }
+
+    for (int i = 0; i < entry.files.size(); ++i) {
+        if (QFileInfo(entry.files[i]).lastModified() != entry.filesModified[i]) {
+            return false;
+        }
+    }
+
+    scripts = entry.scripts;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void cacheCharacter(const QString &key, const QDateTime &dirModified, const QStringList &files,
+                    const Lvk::Clue::ScriptList &scripts)
+{
+    CharacterEntry entry;
+    entry.dirModified = dirModified;
+    entry.files = files;
+    entry.scripts = scripts;
+
+    foreach (const QString &file, files) {
+        entry.filesModified.append(QFileInfo(file).lastModified());
+    }
+
+    QMutexLocker locker(&characterCache()->mutex);
+
+    characterCache()->entries.insert(key, entry);
+}
+
 } // namespace
 
 
@@ -67,12 +179,14 @@ void Lvk::Clue::ScriptManager::initPaths()
 {
     qDebug() << "ScriptManager: Initializing paths...";
 
-    m_clueBasePath = Cmn::Settings().value(SETTING_CLUE_PATH).toString();
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+
+    m_clueBasePath = settings.stringValue(SETTING_CLUE_PATH);
     if (!m_clueBasePath.endsWith("/")) {
         m_clueBasePath.append("/");
     }
 
-    m_charsPath = m_clueBasePath + Cmn::Settings().value(SETTING_CLUE_CHARS_FILE).toString();
+    m_charsPath = m_clueBasePath + settings.stringValue(SETTING_CLUE_CHARS_FILE);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -137,6 +251,8 @@ void Lvk::Clue::ScriptManager::setScriptFormat(Clue::ScriptFormat format)
 
 bool Lvk::Clue::ScriptManager::loadScripts()
 {
+    LVK_STARTUP_PHASE("scripts_load");
+
     if (m_curChar.isEmpty()) {
         return false;
     }
@@ -156,25 +272,58 @@ bool Lvk::Clue::ScriptManager::loadScriptsForCharacter(const QString &name)
 {
     qDebug() << "ScriptManager: Loading scripts for character" << name;
 
+    m_scripts.clear();
+    resetError();
+
+    QString key = characterKey(m_clueBasePath, m_format, name);
+
+    if (findCachedCharacter(key, m_clueBasePath, m_scripts)) {
+        qDebug() << "ScriptManager: Using cached scripts for character" << name;
+        return true;
+    }
+
+    // Taken before listing, so files added meanwhile invalidate the entry
+    QDateTime dirModified = QFileInfo(m_clueBasePath).lastModified();
+
     QDir dir(m_clueBasePath);
     QStringList nameFilters;
     nameFilters.append("*." SCRIPT_FILE_EXT);
     QStringList files = dir.entryList(nameFilters, QDir::Files, QDir::Name);
 
-    m_scripts.clear();
-    resetError();
+    QList<ParseJob> jobs;
 
     foreach (const QString &file, files) {
-        if (!loadFile(m_clueBasePath + file, name)) {
-            if (m_error == Clue::CharacterMismatchError) {
-                resetError();
-            } else {
-                break;
-            }
+        jobs.append(ParseJob(m_clueBasePath + file, m_format));
+    }
+
+    // Files are parsed concurrently but added in the same order as they are listed
+    if (jobs.size() >= MIN_CONCURRENT_SCRIPTS && QThread::idealThreadCount() > 1) {
+        QtConcurrent::blockingMap(jobs, &ParseJob::run);
+    } else {
+        for (int i = 0; i < jobs.size(); ++i) {
+            jobs[i].run();
         }
     }
 
-    return m_error == Clue::NoError;
+    QStringList charFiles;
+
+    foreach (const ParseJob &job, jobs) {
+        if (addScript(job.parser, job.parsed, job.script, job.filename, name)) {
+            charFiles.append(job.filename);
+        } else if (m_error == Clue::CharacterMismatchError) {
+            resetError();
+        } else {
+            break;
+        }
+    }
+
+    if (m_error != Clue::NoError) {
+        return false;
+    }
+
+    cacheCharacter(key, dirModified, charFiles, m_scripts);
+
+    return true;
 }
 
 
@@ -185,10 +334,21 @@ bool Lvk::Clue::ScriptManager::loadFile(const QString &filename, const QString &
     Clue::ScriptParser parser;
     Clue::Script script;
 
+    bool parsed = parser.parse(filename, script, m_format);
+
+    return addScript(parser, parsed, script, filename, name);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Clue::ScriptManager::addScript(const Clue::ScriptParser &parser, bool parsed,
+                                         const Clue::Script &script, const QString &filename,
+                                         const QString &name)
+{
     resetError();
 
-    if (parser.parse(filename, script, m_format)) {
-        if (QString::compare(script.character, name, Qt::CaseInsensitive) == 0) {
+    if (parsed) {
+        if (Cmn::TextSearch::compare(script.character, name) == 0) {
             int i = 0;
 
             for (; i < m_scripts.size() && !equalFilename(m_scripts[i].filename, filename); ++i);
@@ -240,6 +400,9 @@ bool Lvk::Clue::ScriptManager::import(const QString &filename)
         return false;
     }
 
+    // Modification times could be within the same second than the cached ones
+    clearCache();
+
     if (!loadFile(impFile, m_curChar)) {
         QFile::remove(impFile);
         return false;
@@ -266,6 +429,8 @@ bool Lvk::Clue::ScriptManager::remove(const QString &filename)
         return false;
     }
 
+    clearCache();
+
     return true;
 }
 
@@ -345,6 +510,15 @@ void Lvk::Clue::ScriptManager::setError(Clue::ScriptError err, const QString &fi
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::Clue::ScriptManager::clearCache()
+{
+    QMutexLocker locker(&characterCache()->mutex);
+
+    characterCache()->entries.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::Clue::ScriptManager::setParsingError(const Clue::ScriptParser &parser)
 {
     m_error = parser.error(&m_errMsg);
@@ -44,6 +44,12 @@ class ScriptParser;
 
 /**
  * \brief The ScriptManager class manages all the scripts and characters in the system
+ *
+ * The scripts of each character are kept in a process-wide cache keyed by scripts directory,
+ * script format and character, shared by all instances and threads. Cached scripts are valid
+ * while no file is added to or removed from the directory and the files of the character are
+ * not modified, so loading the same character again does not list nor parse every script. Each
+ * file is also cached by ScriptParser.
  */
 class ScriptManager
 {
@@ -117,6 +123,11 @@ public:
      */
     void clear();
 
+    /**
+     * Removes all characters from the cache of loaded scripts.
+     */
+    static void clearCache();
+
 private:
     QString m_curChar;
     ScriptList m_scripts;
@@ -128,6 +139,8 @@ private:
 
     void initPaths();
     bool loadFile(const QString &filename, const QString &name);
+    bool addScript(const Clue::ScriptParser &parser, bool parsed, const Clue::Script &script,
+                   const QString &filename, const QString &name);
     void resetError();
     void setError(Clue::ScriptError err, const QString &filename, const QString &extra = "");
     void setParsingError(const Clue::ScriptParser &parser);
@@ -20,16 +20,18 @@
  */
 
 #include "da-clue/scriptparser.h"
-#include "crypto/keymanagerfactory.h"
+#include "crypto/keycache.h"
 #include "crypto/cipher.h"
 
 #include <QFile>
 #include <QFileInfo>
 #include <QObject>
-#include <QDomDocument>
-#include <QRegExp>
+#include <QXmlStreamReader>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QtDebug>
-#include <memory>
 
 /* Script example:
 
@@ -67,6 +69,69 @@
     </SCRIPT>
 */
 
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// A parsed script and the state of its file when it was parsed
+struct CacheEntry
+{
+    QDateTime lastModified;
+    qint64 size;
+    Lvk::Clue::ScriptFormat format;
+    Lvk::Clue::Script script;
+};
+
+struct ScriptCache
+{
+    QMutex mutex;
+    QHash<QString, CacheEntry> entries;     // absolute file path -> entry
+};
+
+Q_GLOBAL_STATIC(ScriptCache, scriptCache)
+
+//--------------------------------------------------------------------------------------------------
+
+bool findCachedScript(const QFileInfo &info, Lvk::Clue::ScriptFormat format,
+                      Lvk::Clue::Script &script)
+{
+    QMutexLocker locker(&scriptCache()->mutex);
+
+    QHash<QString, CacheEntry>::const_iterator it
+            = scriptCache()->entries.find(info.absoluteFilePath());
+
+    if (it == scriptCache()->entries.constEnd() || it->lastModified != info.lastModified()
+            || it->size != info.size() || it->format != format) {
+        return false;
+    }
+
+    script = it->script;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void cacheScript(const QFileInfo &info, Lvk::Clue::ScriptFormat format,
+                 const Lvk::Clue::Script &script)
+{
+    CacheEntry entry;
+    entry.lastModified = info.lastModified();
+    entry.size = info.size();
+    entry.format = format;
+    entry.script = script;
+
+    QMutexLocker locker(&scriptCache()->mutex);
+
+    scriptCache()->entries.insert(info.absoluteFilePath(), entry);
+}
+
+} // namespace
+
+
 //--------------------------------------------------------------------------------------------------
 // ScriptParser
 //--------------------------------------------------------------------------------------------------
@@ -81,8 +146,6 @@ Lvk::Clue::ScriptParser::ScriptParser()
 bool Lvk::Clue::ScriptParser::parse(const QString &filename, Clue::Script &script,
                                     Clue::ScriptFormat format)
 {
-    qDebug() << "ScriptParser: parsing filename" << filename;
-
     m_errMsg.clear();
     script.clear();
     script.filename = QFileInfo(filename).fileName();
@@ -95,6 +158,15 @@ bool Lvk::Clue::ScriptParser::parse(const QString &filename, Clue::Script &scrip
         return false;
     }
 
+    QFileInfo info(f);
+
+    if (findCachedScript(info, format, script)) {
+        qDebug() << "ScriptParser: using cached script" << filename;
+        return true;
+    }
+
+    qDebug() << "ScriptParser: parsing filename" << filename;
+
     QIODevice::OpenMode flags = (format == XmlObfuscated) ? QFile::ReadOnly
                                                           : QFile::ReadOnly | QFile::Text;
 
@@ -114,25 +186,23 @@ bool Lvk::Clue::ScriptParser::parse(const QString &filename, Clue::Script &scrip
         }
     }
 
-    QString xml = QString::fromUtf8(data);
-    QDomDocument doc;
-    QString err;
-    int line = 0;
-    int col = 0;
-    bool parsingOk = false;
+    // Scripts are written by hand and usually have comments that are not valid XML comments
+    // such as "<!-- -- -->", hence comments are removed before parsing.
+    removeComments(data);
 
-    removeComments(xml);
+    QXmlStreamReader xml(data);
 
-    if (doc.setContent(xml, &err, &line, &col)) {
-        QDomElement root = doc.documentElement();
+    bool parsingOk = parseRoot(xml, script);
 
-        if (requireTagName("script", root)) {
-            parsingOk = parseRoot(root, script);
-        }
-    } else {
-        m_errMsg = QObject::tr("Ill-formed XML in line %1:%2").arg(line).arg(col);
-        // More details:
-        //m_errMsg = QObject::tr("Ill-formed XML in line %1:%2 %3").arg(line).arg(col).arg(xml);
+    // Read until the end to report ill-formed XML after the body
+    while (parsingOk && !xml.atEnd()) {
+        xml.readNext();
+    }
+
+    if (xml.hasError()) {
+        m_errMsg = QObject::tr("Ill-formed XML in line %1:%2").arg(xml.lineNumber())
+                .arg(xml.columnNumber());
+        parsingOk = false;
     }
 
     if (!parsingOk) {
@@ -141,6 +211,8 @@ bool Lvk::Clue::ScriptParser::parse(const QString &filename, Clue::Script &scrip
         return false;
     }
 
+    cacheScript(info, format, script);
+
     return true;
 }
 
@@ -148,53 +220,87 @@ bool Lvk::Clue::ScriptParser::parse(const QString &filename, Clue::Script &scrip
 
 bool Lvk::Clue::ScriptParser::deobfuscate(QByteArray &data)
 {
-    std::auto_ptr<Crypto::KeyManager> keyMgr(Crypto::KeyManagerFactory().create());
-
-    QByteArray iv = keyMgr->getIV(Crypto::KeyManager::ClueScriptsRole);
-    QByteArray key = keyMgr->getKey(Crypto::KeyManager::ClueScriptsRole);
-
-    return Crypto::Cipher(iv, key).decrypt(data);
+    return Crypto::KeyCache::cache()->threadCipher(Crypto::KeyManager::ClueScriptsRole)
+            .decrypt(data);
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Clue::ScriptParser::removeComments(QString &xml)
+void Lvk::Clue::ScriptParser::removeComments(QByteArray &data)
 {
-    xml.remove(QRegExp("<!--((?!-->).)*-->"));
+    // Each comment ends in the first "-->" after its "<!--". Unterminated comments are kept.
+
+    int from = data.indexOf("<!--");
+
+    if (from == -1) {
+        return;
+    }
+
+    QByteArray stripped;
+    stripped.reserve(data.size());
+
+    int pos = 0;
+
+    while (from != -1) {
+        int end = data.indexOf("-->", from + 4);
+
+        if (end == -1) {
+            break;
+        }
+
+        stripped.append(data.constData() + pos, from - pos);
+        pos = end + 3;
+        from = data.indexOf("<!--", pos);
+    }
+
+    stripped.append(data.constData() + pos, data.size() - pos);
+
+    data = stripped;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Clue::ScriptParser::parseRoot(QDomElement &root, Clue::Script &script)
+bool Lvk::Clue::ScriptParser::parseRoot(QXmlStreamReader &xml, Clue::Script &script)
 {
-    if (root.childNodes().size() < 2) {
+    if (!xml.readNextStartElement()) {
+        return false;
+    }
+
+    if (!requireTagName("script", xml)) {
+        return false;
+    }
+
+    if (!xml.readNextStartElement()) {
         m_errMsg = QObject::tr("Missing Header and/or Body");
         return false;
     }
 
-    QDomElement e0 = root.childNodes().item(0).toElement();
-    QDomElement e1 = root.childNodes().item(1).toElement();
+    if (!requireTagName("header", xml) || !parseHeader(xml, script)) {
+        return false;
+    }
+
+    if (!xml.readNextStartElement()) {
+        m_errMsg = QObject::tr("Missing Header and/or Body");
+        return false;
+    }
 
-    return requireTagName("header", e0) && parseHeader(e0, script) &&
-            requireTagName("body", e1) && parseBody(e1, script);
+    return requireTagName("body", xml) && parseBody(xml, script);
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Clue::ScriptParser::parseHeader(QDomElement &header, Clue::Script &script)
+bool Lvk::Clue::ScriptParser::parseHeader(QXmlStreamReader &xml, Clue::Script &script)
 {
     bool hasCharacter = false;
 
-    for (int i = 0; i < header.childNodes().size(); ++i) {
-        QDomNode node = header.childNodes().item(i);
+    while (xml.readNextStartElement()) {
+        QString name = xml.name().toString().toLower();
+        QString value = xml.readElementText(QXmlStreamReader::SkipChildElements).trimmed();
 
-        if (node.childNodes().isEmpty()) {
+        if (value.isEmpty()) {
             continue;
         }
 
-        QString name = node.nodeName().toLower();
-        QString value = node.childNodes().at(0).nodeValue().trimmed();
-
         if (name == "character") {
             script.character = value;
             hasCharacter = true;
@@ -206,41 +312,37 @@ bool Lvk::Clue::ScriptParser::parseHeader(QDomElement &header, Clue::Script &scr
         }
     }
 
-    return hasCharacter;
+    return hasCharacter && !xml.hasError();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Clue::ScriptParser::parseBody(QDomElement &body, Clue::Script &script)
+bool Lvk::Clue::ScriptParser::parseBody(QXmlStreamReader &xml, Clue::Script &script)
 {
-    bool parsingOk = true;
-
-    for (int i = 0; i < body.childNodes().size() && parsingOk; ++i) {
-        QDomElement e = body.childNodes().item(i).toElement();
-        parsingOk = requireTagName("question", e) && parseQuestion(e, script);
-
+    while (xml.readNextStartElement()) {
+        if (!requireTagName("question", xml) || !parseQuestion(xml, script)) {
+            return false;
+        }
     }
 
-    return parsingOk;
+    return !xml.hasError();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Clue::ScriptParser::parseQuestion(QDomElement &q, Clue::Script &script)
+bool Lvk::Clue::ScriptParser::parseQuestion(QXmlStreamReader &xml, Clue::Script &script)
 {
     QString phrase, expAnswer, forbAnswer, expHint, forbHint;
     Clue::ScriptLine::Importance importance = Clue::ScriptLine::Standard;
 
-    for (int i = 0; i < q.childNodes().size(); ++i) {
-        QDomNode node = q.childNodes().item(i);
+    while (xml.readNextStartElement()) {
+        QString name = xml.name().toString().toLower();
+        QString value = xml.readElementText(QXmlStreamReader::SkipChildElements).trimmed();
 
-        if (node.childNodes().isEmpty()) {
+        if (value.isEmpty()) {
             continue;
         }
 
-        QString name = node.nodeName().toLower();
-        QString value = node.childNodes().at(0).nodeValue().trimmed();
-
         if (name == "phrase") {
             phrase = value;
         } else if (name == "expectedanswers") {
@@ -260,6 +362,10 @@ bool Lvk::Clue::ScriptParser::parseQuestion(QDomElement &q, Clue::Script &script
         }
     }
 
+    if (xml.hasError()) {
+        return false;
+    }
+
     // Check mandatory tags
     if (phrase.isEmpty()) {
         m_errMsg = QObject::tr("Incomplete question found: Phrase is missing");
@@ -276,10 +382,10 @@ bool Lvk::Clue::ScriptParser::parseQuestion(QDomElement &q, Clue::Script &script
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Clue::ScriptParser::requireTagName(const QString &name, const QDomElement &e)
+bool Lvk::Clue::ScriptParser::requireTagName(const QString &name, const QXmlStreamReader &xml)
 {
-    if (e.tagName().toLower() != name) {
-        m_errMsg = QObject::tr("Invalid tag '%1' expected '%2'").arg(e.tagName(), name);
+    if (xml.name().toString().toLower() != name) {
+        m_errMsg = QObject::tr("Invalid tag '%1' expected '%2'").arg(xml.name().toString(), name);
         return false;
     }
     return true;
@@ -294,3 +400,12 @@ Lvk::Clue::ScriptError Lvk::Clue::ScriptParser::error(QString *errMsg) const
     }
     return m_error;
 }
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Clue::ScriptParser::clearCache()
+{
+    QMutexLocker locker(&scriptCache()->mutex);
+
+    scriptCache()->entries.clear();
+}
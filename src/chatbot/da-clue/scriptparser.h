@@ -27,8 +27,9 @@
 #include "da-clue/scriptformat.h"
 
 #include <QString>
+#include <QByteArray>
 
-class QDomElement;
+class QXmlStreamReader;
 
 namespace Lvk
 {
@@ -45,6 +46,12 @@ namespace Clue
 
 /**
  * \brief The ScriptParser class provides a parser of scripts
+ *
+ * Scripts are parsed in a single pass with a streaming XML reader, script lines are built as
+ * their tags are read. Parsed scripts are kept in a process-wide cache keyed by file path, so
+ * parsing again a file that has not been modified since, returns the cached script.
+ *
+ * This class is reentrant. The cache is thread-safe.
  */
 class ScriptParser
 {
@@ -65,17 +72,22 @@ public:
      */
     ScriptError error(QString *errMsg = 0) const;
 
+    /**
+     * Removes all scripts from the cache of parsed scripts.
+     */
+    static void clearCache();
+
 private:
     ScriptError m_error;
     QString m_errMsg;
 
     bool deobfuscate(QByteArray &data);
-    void removeComments(QString &xml);
-    bool parseRoot(QDomElement &root, Clue::Script &script);
-    bool parseHeader(QDomElement &head, Clue::Script &script);
-    bool parseBody(QDomElement &body, Clue::Script &script);
-    bool parseQuestion(QDomElement &q, Clue::Script &script);
-    bool requireTagName(const QString &name, const QDomElement &e);
+    void removeComments(QByteArray &data);
+    bool parseRoot(QXmlStreamReader &xml, Clue::Script &script);
+    bool parseHeader(QXmlStreamReader &xml, Clue::Script &script);
+    bool parseBody(QXmlStreamReader &xml, Clue::Script &script);
+    bool parseQuestion(QXmlStreamReader &xml, Clue::Script &script);
+    bool requireTagName(const QString &name, const QXmlStreamReader &xml);
 };
 
 /// @}
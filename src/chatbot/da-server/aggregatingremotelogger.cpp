@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "da-server/aggregatingremotelogger.h"
+#include "da-server/remoteloggerkeys.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#define AGGREGATED_MSG          "Aggregated events"
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// "Chatbot connected" -> "chatbot_connected"
+QString fieldName(const QString &msg)
+{
+    QString name = msg.trimmed().toLower();
+
+    for (int i = 0; i < name.size(); ++i) {
+        if (!name[i].isLetterOrNumber()) {
+            name[i] = QChar('_');
+        }
+    }
+
+    return name;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void setField(Lvk::DAS::RemoteLogger::FieldList &fields, const QString &key, const QString &value)
+{
+    for (int i = 0; i < fields.size(); ++i) {
+        if (fields[i].first == key) {
+            fields[i].second = value;
+            return;
+        }
+    }
+
+    fields.append(key, value);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Logs exactly one of every 1/rate calls
+inline bool mustSample(quint64 &count, double rate)
+{
+    quint64 n = count++;
+
+    return (quint64)((n + 1.0) * rate) != (quint64)(n * rate);
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// AggregatingRemoteLogger
+//--------------------------------------------------------------------------------------------------
+
+Lvk::DAS::AggregatingRemoteLogger::AggregatingRemoteLogger(RemoteLogger *logger,
+                                                           int flushInterval)
+    : m_logger(logger), m_mutex(new QMutex()), m_scheduled(flushInterval > 0)
+{
+    if (m_scheduled) {
+        Cmn::MaintenanceScheduler::scheduler()->add(this, "remoteLog", flushInterval);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::DAS::AggregatingRemoteLogger::~AggregatingRemoteLogger()
+{
+    if (m_scheduled) {
+        Cmn::MaintenanceScheduler::scheduler()->remove(this);
+    }
+
+    flush();
+
+    delete m_logger;
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::AggregatingRemoteLogger::setAggregated(const QString &msg,
+                                                      const QStringList &numericFields
+                                                      /*= QStringList()*/)
+{
+    QMutexLocker locker(m_mutex);
+
+    Policy &policy = m_policies[msg];
+    policy.aggregated = true;
+    policy.numericFields = numericFields;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::AggregatingRemoteLogger::setSampled(const QString &msg, double rate)
+{
+    QMutexLocker locker(m_mutex);
+
+    Policy &policy = m_policies[msg];
+    policy.aggregated = false;
+    policy.sampleRate = qBound(0.0, rate, 1.0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::DAS::AggregatingRemoteLogger::log(const QString &msg)
+{
+    return log(msg, FieldList());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::DAS::AggregatingRemoteLogger::log(const QString &msg, const FieldList &fields)
+{
+    double sampleRate = 1.0;
+
+    {
+        QMutexLocker locker(m_mutex);
+
+        QHash<QString, Policy>::iterator it = m_policies.find(msg);
+
+        if (it != m_policies.end() && it->aggregated) {
+            if (m_periodStart.isNull()) {
+                m_periodStart = QDateTime::currentDateTime();
+            }
+
+            Aggregate &agg = m_aggregates[msg];
+            ++agg.count;
+
+            foreach (const Field &field, fields) {
+                if (!it->numericFields.contains(field.first)) {
+                    setField(m_context, field.first, field.second);
+                    continue;
+                }
+
+                bool ok = false;
+                double value = field.second.toDouble(&ok);
+
+                if (!ok) {
+                    continue;
+                }
+
+                if (agg.fields.contains(field.first)) {
+                    Summary &s = agg.fields[field.first];
+                    s.min = qMin(s.min, value);
+                    s.max = qMax(s.max, value);
+                    s.sum += value;
+                } else {
+                    Summary &s = agg.fields[field.first];
+                    s.min = s.max = s.sum = value;
+                }
+            }
+
+            return 0;
+        }
+
+        if (it != m_policies.end() && it->sampleRate < 1.0) {
+            if (!mustSample(it->count, it->sampleRate)) {
+                return 0;
+            }
+            sampleRate = it->sampleRate;
+        }
+    }
+
+    if (sampleRate < 1.0) {
+        FieldList sampledFields = fields;
+        sampledFields.append(RLOG_KEY_SAMPLE_RATE, QString::number(sampleRate));
+
+        return m_logger->log(msg, sampledFields);
+    }
+
+    return m_logger->log(msg, fields);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::DAS::AggregatingRemoteLogger::flush()
+{
+    FieldList fields;
+
+    {
+        QMutexLocker locker(m_mutex);
+
+        if (m_aggregates.isEmpty()) {
+            return 0;
+        }
+
+        fields = m_context;
+        fields.append(RLOG_KEY_AGGREGATE_PERIOD,
+                      QString::number(m_periodStart.secsTo(QDateTime::currentDateTime())));
+
+        QMap<QString, Aggregate>::const_iterator it;
+        for (it = m_aggregates.constBegin(); it != m_aggregates.constEnd(); ++it) {
+            QString prefix = RLOG_KEY_AGGREGATE_PREFIX + fieldName(it.key()) + "_";
+
+            fields.append(prefix + "count", QString::number(it->count));
+
+            QMap<QString, Summary>::const_iterator jt;
+            for (jt = it->fields.constBegin(); jt != it->fields.constEnd(); ++jt) {
+                fields.append(prefix + jt.key() + "_min", QString::number(jt->min));
+                fields.append(prefix + jt.key() + "_max", QString::number(jt->max));
+                fields.append(prefix + jt.key() + "_sum", QString::number(jt->sum));
+            }
+        }
+
+        m_aggregates.clear();
+        m_context.clear();
+        m_periodStart = QDateTime();
+    }
+
+    return m_logger->log(AGGREGATED_MSG, fields);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::DAS::AggregatingRemoteLogger::needsMaintenance() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return !m_aggregates.isEmpty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::AggregatingRemoteLogger::runMaintenance()
+{
+    flush();
+}
+
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_DAS_AGGREGATINGREMOTELOGGER_H
+#define LVK_DAS_AGGREGATINGREMOTELOGGER_H
+
+#include "da-server/remotelogger.h"
+#include "common/maintenancescheduler.h"
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMap>
+#include <QDateTime>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace DAS
+{
+
+/// \ingroup Lvk
+/// \addtogroup DAS
+/// @{
+
+/**
+ * \brief The AggregatingRemoteLogger class reduces the amount of messages sent by another
+ *        remote logger.
+ *
+ * Messages are handled according to the policy of their text:
+ *
+ * - Raw: Messages are logged immediately. This is the default policy, used for rare and
+ *   important events such as errors.
+ * - Aggregated: Messages are not logged one by one. Occurrences are counted and the numeric
+ *   fields given to setAggregated() are summarized with their min, max and sum. The other fields
+ *   of the last occurrence are kept as they are. All aggregates are logged as a single message
+ *   by flush(), with fields of the form <tt>agg_&lt;message&gt;_count</tt> and
+ *   <tt>agg_&lt;message&gt;_&lt;field&gt;_{min,max,sum}</tt>.
+ * - Sampled: Exactly one of every 1/rate messages is logged, with a RLOG_KEY_SAMPLE_RATE
+ *   field so the server can scale counts back.
+ *
+ * Aggregates are flushed by the MaintenanceScheduler every flush interval and when the object
+ * is destroyed. Fields that identify the user must not change between flushes, so callers must
+ * call flush() before they change.
+ *
+ * This class is thread-safe.
+ */
+class AggregatingRemoteLogger : public RemoteLogger, public Cmn::MaintenanceTask
+{
+public:
+
+    /**
+     * Creates an AggregatingRemoteLogger object that logs through \a logger and flushes
+     * aggregates every \a flushInterval seconds. If \a flushInterval is zero, aggregates are
+     * flushed only by flush() and the destructor. After construction class owns the pointer.
+     */
+    AggregatingRemoteLogger(RemoteLogger *logger, int flushInterval);
+
+    /**
+     * Flushes aggregates and destroys the object.
+     */
+    ~AggregatingRemoteLogger();
+
+    /**
+     * Aggregates messages with text \a msg. Fields in \a numericFields are summarized.
+     */
+    void setAggregated(const QString &msg, const QStringList &numericFields = QStringList());
+
+    /**
+     * Samples messages with text \a msg with \a rate between 0 and 1. Zero means that messages
+     * are never logged.
+     */
+    void setSampled(const QString &msg, double rate);
+
+    /**
+     * Logs all aggregates in a single message. Returns 0 if success or there is nothing to log.
+     * Otherwise; returns a non-zero value.
+     */
+    int flush();
+
+    /**
+     * \copydoc RemoteLogger::log(const QString&)
+     */
+    virtual int log(const QString &msg);
+
+    /**
+     * \copydoc RemoteLogger::log(const QString &, const FieldList&)
+     */
+    virtual int log(const QString &msg, const FieldList &fields);
+
+    /**
+     * Returns true if there are aggregates to flush. Otherwise; returns false.
+     */
+    virtual bool needsMaintenance() const;
+
+    /**
+     * Flushes aggregates.
+     */
+    virtual void runMaintenance();
+
+private:
+    AggregatingRemoteLogger(AggregatingRemoteLogger&);
+    AggregatingRemoteLogger& operator=(AggregatingRemoteLogger&);
+
+    struct Policy
+    {
+        Policy() : aggregated(false), sampleRate(1.0), count(0) { }
+
+        bool aggregated;
+        QStringList numericFields;
+        double sampleRate;
+        quint64 count;
+    };
+
+    struct Summary
+    {
+        Summary() : min(0), max(0), sum(0) { }
+
+        double min;
+        double max;
+        double sum;
+    };
+
+    struct Aggregate
+    {
+        Aggregate() : count(0) { }
+
+        qint64 count;
+        QMap<QString, Summary> fields;
+    };
+
+    RemoteLogger *m_logger;
+    QMutex *m_mutex;
+    QHash<QString, Policy> m_policies;
+    QMap<QString, Aggregate> m_aggregates;      // By message, sorted for a stable output
+    FieldList m_context;                        // Not summarized fields of the last message
+    QDateTime m_periodStart;
+    bool m_scheduled;
+};
+
+/// @}
+
+} // namespace DAS
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_DAS_AGGREGATINGREMOTELOGGER_H
+
@@ -13,9 +13,11 @@ HEADERS += \
     $$PROJECT_PATH/da-server/remoteloggerkeys.h \
     $$PROJECT_PATH/da-server/remotelogger.h \
     $$PROJECT_PATH/da-server/nullremotelogger.h \
+    $$PROJECT_PATH/da-server/aggregatingremotelogger.h \
     $$PROJECT_PATH/da-server/rest.h \
     $$PROJECT_PATH/da-server/userauth.h \
     $$PROJECT_PATH/da-server/updater.h \
+    $$PROJECT_PATH/da-server/updatedownloader.h \
     $$PROJECT_PATH/da-server/updateinfo.h \
     $$PROJECT_PATH/da-server/updateversion.h \
     $$PROJECT_PATH/da-server/serverconfig.h \
@@ -27,9 +29,11 @@ HEADERS += \
 
 SOURCES += \
     $$PROJECT_PATH/da-server/remoteloggerfactory.cpp \
+    $$PROJECT_PATH/da-server/aggregatingremotelogger.cpp \
     $$PROJECT_PATH/da-server/rest.cpp \
     $$PROJECT_PATH/da-server/userauth.cpp \
     $$PROJECT_PATH/da-server/updater.cpp \
+    $$PROJECT_PATH/da-server/updatedownloader.cpp \
     $$PROJECT_PATH/da-server/datauploaderfactory.cpp \
 
 RESOURCES += \
@@ -21,20 +21,88 @@
 
 #include "da-server/gelf.h"
 #include "da-server/zlibhelper.h"
+#include "common/json.h"
 #include "common/version.h"
 
 #include <QString>
 #include <QHostInfo>
+#include <QDateTime>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QtEndian>
+#include <QtDebug>
+
+#define GELF_CHUNK_MAGIC_0      0x1e
+#define GELF_CHUNK_MAGIC_1      0x0f
+#define GELF_CHUNK_HEADER_SIZE  12      // magic (2) + message id (8) + seq num (1) + seq count (1)
+#define GELF_MAX_CHUNKS         128
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Per-thread GELF encoder. JSON is written in a writer that is reused between messages and
+// compressed with a reusable deflate stream.
+
+class GelfEncoder
+{
+public:
+    GelfEncoder()
+        : m_host(QHostInfo::localHostName().toUtf8()) { }
+
+    Lvk::Cmn::JsonWriter &writer()
+    {
+        return m_writer;
+    }
+
+    const QByteArray &host() const
+    {
+        return m_host;
+    }
+
+    int compress(QByteArray &out)
+    {
+        return m_zlib.compress(m_writer.constData(), m_writer.size(), out);
+    }
+
+private:
+    Lvk::Cmn::JsonWriter m_writer;
+    QByteArray m_host;
+    Lvk::DAS::ZLibHelper m_zlib;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+QThreadStorage<GelfEncoder *> threadEncoders;
+
+inline GelfEncoder &threadEncoder()
+{
+    if (!threadEncoders.hasLocalData()) {
+        threadEncoders.setLocalData(new GelfEncoder());
+    }
+
+    return *threadEncoders.localData();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QAtomicInt s_chunkedCount;
+
+// Returns a 8-byte id for a chunked message. Unique per process and very likely unique between
+// hosts since it contains the current time.
+inline void newMessageId(char *id)
+{
+    quint64 msecs = QDateTime::currentMSecsSinceEpoch();
+    quint64 count = static_cast<quint16>(s_chunkedCount.fetchAndAddRelaxed(1));
+
+    qToBigEndian<quint64>((msecs << 16) | count, reinterpret_cast<uchar *>(id));
+}
+
+} // namespace
 
-#define GELF_MSG_TEMPLATE   "{"\
-                            "\"version\": \"1.0\","\
-                            "\"facility\": \"%1\","\
-                            "\"host\": \"%2\","\
-                            "\"short_message\": \"%3\","\
-                            "\"full_message\": \"%4\","\
-                            "\"level\": %5,"\
-                            "%6"\
-                            "}"
 
 //--------------------------------------------------------------------------------------------------
 // Gelf
@@ -70,17 +138,88 @@ bool Lvk::DAS::Gelf::isValid()
 
 void Lvk::DAS::Gelf::buildGelf(Level level, const QString &msg, const FieldList &fields)
 {
-    QString gelfMsg = QString(GELF_MSG_TEMPLATE).arg(QString(APP_NAME "_" APP_VERSION_STR),
-                                                     QHostInfo::localHostName(),
-                                                     msg, msg,
-                                                     QString::number(level),
-                                                     fields.toString());
+    GelfEncoder &enc = threadEncoder();
+    Cmn::JsonWriter &w = enc.writer();
+
+    w.clear();
+    w.beginObject();
+    w.writeKey("version");
+    w.writeString(QByteArray("1.0"));
+    w.writeKey("facility");
+    w.writeString(QByteArray(APP_NAME "_" APP_VERSION_STR));
+    w.writeKey("host");
+    w.writeString(enc.host());
+    w.writeKey("short_message");
+    w.writeString(msg);
+    w.writeKey("full_message");
+    w.writeString(msg);
+    w.writeKey("timestamp");
+    w.writeNumber(QDateTime::currentMSecsSinceEpoch()/1000.0, 3);
+    w.writeKey("level");
+    w.writeNumber(static_cast<qint64>(level));
+
+    foreach (const Field &f, fields) {
+        w.writeKey(f.first.startsWith("_") ? f.first : "_" + f.first);
+
+        bool isInt = false;
+        int n = f.second.toInt(&isInt);
 
-    if (ZLibHelper::deflate(gelfMsg.toUtf8(), m_data) != Z_OK) {
+        if (isInt) {
+            w.writeNumber(static_cast<qint64>(n));
+        } else {
+            w.writeString(f.second);
+        }
+    }
+
+    w.endObject();
+
+    if (enc.compress(m_data) != Z_OK) {
         m_data.clear();
     }
 }
 
+//--------------------------------------------------------------------------------------------------
+
+QList<QByteArray> Lvk::DAS::Gelf::chunk(const QByteArray &data, int datagramSize)
+{
+    QList<QByteArray> chunks;
+
+    if (data.size() <= datagramSize) {
+        chunks.append(data);
+        return chunks;
+    }
+
+    int payloadSize = datagramSize - GELF_CHUNK_HEADER_SIZE;
+    int count = payloadSize > 0 ? (data.size() + payloadSize - 1) / payloadSize : 0;
+
+    if (count <= 0 || count > GELF_MAX_CHUNKS) {
+        qWarning() << "Gelf: Message too big to be chunked:" << data.size() << "bytes";
+        return chunks;
+    }
+
+    char header[GELF_CHUNK_HEADER_SIZE];
+    header[0] = GELF_CHUNK_MAGIC_0;
+    header[1] = GELF_CHUNK_MAGIC_1;
+    newMessageId(header + 2);
+    header[11] = static_cast<char>(count);
+
+    for (int i = 0; i < count; ++i) {
+        int offset = i*payloadSize;
+        int size = qMin(payloadSize, data.size() - offset);
+
+        header[10] = static_cast<char>(i);
+
+        QByteArray c;
+        c.reserve(GELF_CHUNK_HEADER_SIZE + size);
+        c.append(header, GELF_CHUNK_HEADER_SIZE);
+        c.append(data.constData() + offset, size);
+
+        chunks.append(c);
+    }
+
+    return chunks;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Gelf::Field
 //--------------------------------------------------------------------------------------------------
@@ -65,6 +65,9 @@ namespace DAS
  * be provided. Short message and full message are set to the same given message. Line and file are
  * not set.
  *
+ * Messages bigger than a UDP datagram must be split with chunk() using the GELF chunked
+ * format.
+ *
  * More info about GELF format at http://graylog2.org/about/gelf
  */
 class Gelf
@@ -148,6 +151,21 @@ public:
         return m_data;
     }
 
+    /**
+     * Default max size of a UDP datagram
+     */
+    enum { DefaultDatagramSize = 1420 };
+
+    /**
+     * Splits the GELF message \a data in chunks of at most \a datagramSize bytes using the
+     * GELF chunked format. Each chunk has a 12-byte header with the chunk magic bytes, the
+     * message id, the sequence number and the sequence count. If \a data fits in one datagram,
+     * returns a list with \a data. If \a data requires more than 128 chunks, returns an empty
+     * list.
+     */
+    static QList<QByteArray> chunk(const QByteArray &data,
+                                   int datagramSize = DefaultDatagramSize);
+
 private:
     QByteArray m_data;
 
@@ -23,15 +23,43 @@
 #include "da-server/gelf.h"
 #include "da-server/syslog.h"
 #include "da-server/serverconfig.h"
+#include "da-server/remoteloggerkeys.h"
 #include "common/version.h"
+#include "common/json.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
 #include "crypto/cipher.h"
-#include "crypto/keymanagerfactory.h"
+#include "crypto/keycache.h"
 
 #include <QUdpSocket>
 #include <QTcpSocket>
 #include <QDateTime>
 #include <QDebug>
-#include <memory>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QStringList>
+#include <QUuid>
+#include <QNetworkConfigurationManager>
+#include <QtEndian>
+
+#define GRAYLOG_QUEUE_SIZE          256          // Messages in memory, the rest are spooled
+#define GRAYLOG_BATCH_SIZE          32           // Max messages sent per batch
+#define GRAYLOG_SPOOL_MAX_SIZE      (1024*1024)  // Max size of all spool segments in bytes
+#define GRAYLOG_SEGMENT_SIZE        (64*1024)    // Segments bigger than this are not appended
+#define GRAYLOG_SPOOL_FILENAME      "rlog_%1_%2.spool"
+#define GRAYLOG_OLD_SPILL_FILENAME  "rlog_%1.spool"
+#define GRAYLOG_CONNECT_TIMEOUT     6000         // Milliseconds
+#define GRAYLOG_WRITE_TIMEOUT       6000         // Milliseconds
+#define GRAYLOG_MIN_BACKOFF         1000         // Milliseconds
+#define GRAYLOG_MAX_BACKOFF         (5*60*1000)  // Milliseconds
+#define GRAYLOG_OFFLINE_POLL        5000         // Milliseconds
 
 //--------------------------------------------------------------------------------------------------
 // Helpers
@@ -55,105 +83,551 @@ inline Lvk::DAS::Gelf::FieldList toGelfFields(const Lvk::DAS::RemoteLogger::Fiel
 // convert RemoteLogger::FieldList to QString
 inline QString toString(const Lvk::DAS::RemoteLogger::FieldList &fields)
 {
-    QString s;
+    if (fields.isEmpty()) {
+        return QString();
+    }
+
+    Lvk::Cmn::JsonWriter writer;
+
+    writer.beginObject();
     foreach (const Lvk::DAS::RemoteLogger::Field &f, fields) {
-        if (s.isEmpty()) {
-            s += "{";
-        } else {
-            s += ",";
-        }
-        if (f.first.startsWith("_")) {
-            s += QString("\"%1\":\"%2\"").arg(f.first, f.second);
-        } else {
-            s += QString("\"_%1\":\"%2\"").arg(f.first, f.second);
-        }
+        writer.writeKey(f.first.startsWith("_") ? f.first : "_" + f.first);
+        writer.writeString(f.second);
     }
+    writer.endObject();
+
+    return QString::fromUtf8(writer.constData(), writer.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QMutex s_spoolMutex;                // Spool segments can be shared by several loggers
+QSet<QString> s_sendingSegments;    // Segments taken by a shipper
 
-    if (!s.isEmpty()) {
-        s += "}";
+//--------------------------------------------------------------------------------------------------
+
+inline QString logsPath()
+{
+    return Lvk::Cmn::SettingsSnapshot::current().value(SETTING_LOGS_PATH).toString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString segmentFilename(int format, int n)
+{
+    return logsPath() + QDir::separator()
+            + QString(GRAYLOG_SPOOL_FILENAME).arg(format).arg(n, 8, 10, QChar('0'));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline int segmentNumber(const QString &filename)
+{
+    return QFileInfo(filename).baseName().section('_', -1).toInt();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString ackFilename(const QString &segment)
+{
+    return segment + ".ack";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the spool segments of format from the oldest to the newest. Requires s_spoolMutex
+QStringList segments(int format)
+{
+    QDir dir(logsPath());
+    QStringList pattern(QString(GRAYLOG_SPOOL_FILENAME).arg(format).arg("*"));
+    QStringList filenames;
+
+    foreach (const QString &name, dir.entryList(pattern, QDir::Files, QDir::Name)) {
+        filenames.append(dir.filePath(name));
     }
 
-    return s;
+    return filenames;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-inline int sendUdpMessage(const QByteArray &data, const QString &host, unsigned port)
+// Renames the spill file of older versions to the first segment. Returns true if there are
+// spooled messages
+bool initSpool(int format)
 {
-    qint64 bytes = QUdpSocket().writeDatagram(data, QHostAddress(host), port);
+    QMutexLocker locker(&s_spoolMutex);
+
+    QString oldFilename = logsPath() + QDir::separator()
+            + QString(GRAYLOG_OLD_SPILL_FILENAME).arg(format);
 
-    if (bytes == -1) {
-        qWarning() << "sendUdpMessage error";
+    if (QFile::exists(oldFilename)) {
+        QFile::rename(oldFilename, segmentFilename(format, 0));
     }
 
-    return bytes != -1 ? 0 : 1;
+    return !segments(format).isEmpty();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-inline int sendTcpMessage(const QByteArray &data, const QString &host, unsigned port)
+// Appends messages to the newest spool segment of format. A new segment is started if the newest
+// one is full or taken by a shipper. Each record has the form <32-bit big endian size><data>
+bool spool(int format, const QList<QByteArray> &msgs)
 {
-    qint64 bytes = -1;
+    QMutexLocker locker(&s_spoolMutex);
 
-    try {
-        QTcpSocket tcpSocket;
+    QByteArray data;
+    foreach (const QByteArray &msg, msgs) {
+        uchar size[4];
+        qToBigEndian<quint32>(msg.size(), size);
+        data.append(reinterpret_cast<const char *>(size), sizeof(size));
+        data.append(msg);
+    }
 
-        //qDebug() << "sendTcpMessage Host/port:" << host << port;
+    QStringList filenames = segments(format);
+    qint64 total = 0;
 
-        tcpSocket.connectToHost(QHostAddress(host), port);
+    foreach (const QString &filename, filenames) {
+        total += QFileInfo(filename).size();
+    }
+
+    if (total + data.size() > GRAYLOG_SPOOL_MAX_SIZE) {
+        qWarning() << "GraylogRemoteLogger: Spool full," << msgs.size() << "messages dropped";
+        return false;
+    }
 
-        if (!tcpSocket.waitForConnected(6000)) {
-            throw 1;
+    QString filename;
+
+    if (!filenames.isEmpty() && !s_sendingSegments.contains(filenames.last())
+            && QFileInfo(filenames.last()).size() < GRAYLOG_SEGMENT_SIZE) {
+        filename = filenames.last();
+    } else {
+        filename = segmentFilename(format, filenames.isEmpty() ? 1
+                                                            : segmentNumber(filenames.last()) + 1);
+    }
+
+    QFile file(filename);
+
+    if (!file.open(QFile::Append)) {
+        qWarning() << "GraylogRemoteLogger: Cannot open spool segment" << filename;
+        return false;
+    }
+
+    return file.write(data) == data.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QList<QByteArray> readSegment(const QString &filename)
+{
+    QList<QByteArray> msgs;
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return msgs;
+    }
+
+    QByteArray data = file.readAll();
+
+    int pos = 0;
+
+    while (pos + 4 <= data.size()) {
+        int len = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(data.constData() + pos));
+
+        if (len < 0 || pos + 4 + len > data.size()) {
+            break; // Incomplete record
         }
 
-        bytes = tcpSocket.write(data);
+        msgs.append(data.mid(pos + 4, len));
+        pos += 4 + len;
+    }
+
+    return msgs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Records that the first count messages of segment were sent
+void writeAck(const QString &segment, int count)
+{
+    QFile file(ackFilename(segment));
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "GraylogRemoteLogger: Cannot write" << file.fileName();
+        return;
+    }
 
-        if (bytes == -1) {
-            throw 2;
+    file.write(QByteArray::number(count));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Takes the oldest spool segment of format not taken by another shipper. Sets msgs with the
+// messages not sent yet and acked with the number of messages sent before.
+bool takeSegment(int format, QString &segment, QList<QByteArray> &msgs, int &acked)
+{
+    QMutexLocker locker(&s_spoolMutex);
+
+    foreach (const QString &filename, segments(format)) {
+        if (s_sendingSegments.contains(filename)) {
+            continue;
         }
 
-        if (!tcpSocket.waitForBytesWritten()) {
-            throw 3;
+        s_sendingSegments.insert(filename);
+
+        QFile ackFile(ackFilename(filename));
+        acked = ackFile.open(QFile::ReadOnly) ? ackFile.readAll().toInt() : 0;
+
+        segment = filename;
+        msgs = readSegment(filename).mid(acked);
+
+        return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Releases a segment taken by a shipper. If sent is true, removes it.
+void releaseSegment(const QString &segment, bool sent)
+{
+    QMutexLocker locker(&s_spoolMutex);
+
+    s_sendingSegments.remove(segment);
+
+    if (sent) {
+        QFile::remove(segment);
+        QFile::remove(ackFilename(segment));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns false if the network is known to be down. Platforms without network configurations
+// are assumed to be online.
+inline bool isOnline(QNetworkConfigurationManager &mgr)
+{
+    return mgr.isOnline() || mgr.allConfigurations().isEmpty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString newEventId()
+{
+    return QUuid::createUuid().toString().mid(1, 36);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sends and removes messages from batch through the given UDP socket. If gelf is true, big
+// messages are sent with the GELF chunked format
+inline bool sendUdpBatch(QList<QByteArray> &batch, QUdpSocket &socket, const QString &host,
+                         unsigned port, bool gelf)
+{
+    QHostAddress addr(host);
+
+    while (!batch.isEmpty()) {
+        QList<QByteArray> datagrams;
+
+        if (gelf) {
+            datagrams = Lvk::DAS::Gelf::chunk(batch.first());
+        } else {
+            datagrams.append(batch.first());
+        }
+
+        foreach (const QByteArray &datagram, datagrams) {
+            if (socket.writeDatagram(datagram, addr, port) == -1) {
+                qWarning() << "sendUdpBatch error" << socket.errorString();
+                return false;
+            }
+        }
+
+        batch.removeFirst();
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Sends and removes messages from batch through the given persistent TCP socket.
+// Messages are framed with octet counting (RFC 6587) since several messages share the
+// connection and a message can contain new lines.
+inline bool sendTcpBatch(QList<QByteArray> &batch, QTcpSocket &socket, const QString &host,
+                         unsigned port)
+{
+    if (socket.state() == QAbstractSocket::ConnectedState) {
+        socket.waitForReadyRead(0); // Process a pending remote close, if any
+    }
+
+    if (socket.state() != QAbstractSocket::ConnectedState) {
+        socket.abort();
+        socket.connectToHost(QHostAddress(host), port);
+
+        if (!socket.waitForConnected(GRAYLOG_CONNECT_TIMEOUT)) {
+            qDebug() << "sendTcpBatch cannot connect" << socket.errorString();
+            socket.abort();
+            return false;
         }
+    }
+
+    // Frames are written with a single call. The buffer is allocated once.
+    int size = 0;
+    foreach (const QByteArray &msg, batch) {
+        size += msg.size() + 12;
+    }
+
+    QByteArray frames;
+    frames.reserve(size);
+
+    foreach (const QByteArray &msg, batch) {
+        frames += QByteArray::number(msg.size());
+        frames += ' ';
+        frames += msg;
+    }
 
-        qDebug() << "sendTcpMessage OK";
+    if (socket.write(frames) == -1) {
+        qDebug() << "sendTcpBatch write error" << socket.errorString();
+        socket.abort();
+        return false;
+    }
 
-    } catch (int err) {
-        qDebug() << "sendTcpMessage error" << err;
-        bytes = -1;
+    while (socket.bytesToWrite() > 0) {
+        if (!socket.waitForBytesWritten(GRAYLOG_WRITE_TIMEOUT)) {
+            qDebug() << "sendTcpBatch write error" << socket.errorString();
+            socket.abort();
+            return false;
+        }
     }
 
-    return bytes != -1 ? 0 : 1;
+    batch.clear();
+
+    return true;
 }
 
 } // namespace
 
 
+//--------------------------------------------------------------------------------------------------
+// GraylogRemoteLogger::Shipper
+//--------------------------------------------------------------------------------------------------
+
+// Thread that sends queued and spooled messages in batches. Sockets are created by the thread
+// and kept open between batches.
+
+class Lvk::DAS::GraylogRemoteLogger::Shipper : public QThread
+{
+public:
+    Shipper(LogFomat format, const QString &host, unsigned port)
+        : m_format(format), m_tcp(format == SyslogTCP || format == EncSyslogTCP),
+          m_gelf(format == GELF), m_durable(m_tcp), m_host(host), m_port(port),
+          m_running(true), m_hasSpool(initSpool(format)) { }
+
+    ~Shipper()
+    {
+        stop();
+    }
+
+    // Called by any thread. Never blocks on the network. Messages of reliable formats are spooled
+    // right away so they survive a crash.
+    bool enqueue(const QByteArray &data)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (!m_durable && m_queue.size() < GRAYLOG_QUEUE_SIZE) {
+            m_queue.enqueue(data);
+            m_cond.wakeOne();
+            return true;
+        }
+
+        locker.unlock();
+
+        if (!spool(m_format, QList<QByteArray>() << data)) {
+            return false;
+        }
+
+        locker.relock();
+        m_hasSpool = true;
+        m_cond.wakeOne();
+
+        return true;
+    }
+
+    // Makes a last attempt to send queued messages. Unsent messages are spooled.
+    void stop()
+    {
+        m_mutex.lock();
+        m_running = false;
+        m_cond.wakeOne();
+        m_mutex.unlock();
+
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        QTcpSocket tcpSocket;
+        QUdpSocket udpSocket;
+        QNetworkConfigurationManager netMgr;
+        QList<QByteArray> batch;
+        QString segment;                // Spool segment being sent, if any
+        QList<QByteArray> pending;      // Messages of the segment not in a batch yet
+        int acked = 0;                  // Messages of the segment sent
+        qint64 retryAt = 0;
+        int backoff = 0;
+
+        QMutexLocker locker(&m_mutex);
+
+        forever {
+            // A segment is sent completely before sending queued messages, so acks stay valid
+            if (batch.isEmpty() && !segment.isEmpty()) {
+                if (pending.isEmpty()) {
+                    locker.unlock();
+                    releaseSegment(segment, true);
+                    locker.relock();
+                    segment.clear();
+                } else {
+                    batch = pending.mid(0, GRAYLOG_BATCH_SIZE);
+                    pending = pending.mid(batch.size());
+                }
+            }
+
+            if (segment.isEmpty()) {
+                while (batch.size() < GRAYLOG_BATCH_SIZE && !m_queue.isEmpty()) {
+                    batch.append(m_queue.dequeue());
+                }
+            }
+
+            if (batch.isEmpty() && m_hasSpool && m_running) {
+                m_hasSpool = false;
+                locker.unlock();
+                bool taken = takeSegment(m_format, segment, pending, acked);
+                locker.relock();
+                m_hasSpool = m_hasSpool || taken;
+                continue;
+            }
+
+            if (batch.isEmpty()) {
+                if (!m_running) {
+                    break;
+                }
+                m_cond.wait(&m_mutex);
+                continue;
+            }
+
+            qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+            if (now < retryAt) {
+                if (!m_running) {
+                    break;
+                }
+                m_cond.wait(&m_mutex, retryAt - now);
+                continue;
+            }
+
+            locker.unlock();
+
+            bool online = isOnline(netMgr);
+            int batchSize = batch.size();
+
+            bool sent = online && (m_tcp ? sendTcpBatch(batch, tcpSocket, m_host, m_port)
+                                         : sendUdpBatch(batch, udpSocket, m_host, m_port, m_gelf));
+
+            // Sent messages are not sent again if we crash or stop before finishing the segment
+            if (!segment.isEmpty() && batch.size() < batchSize) {
+                acked += batchSize - batch.size();
+                writeAck(segment, acked);
+            }
+
+            locker.relock();
+
+            if (sent) {
+                backoff = 0;
+                retryAt = 0;
+            } else if (!online) {
+                backoff = 0;
+                retryAt = QDateTime::currentMSecsSinceEpoch() + GRAYLOG_OFFLINE_POLL;
+                qDebug() << "GraylogRemoteLogger: Offline. Retrying in" << GRAYLOG_OFFLINE_POLL
+                         << "ms";
+            } else {
+                backoff = backoff ? qMin(backoff*2, GRAYLOG_MAX_BACKOFF) : GRAYLOG_MIN_BACKOFF;
+                retryAt = QDateTime::currentMSecsSinceEpoch() + backoff;
+                qDebug() << "GraylogRemoteLogger: Send failed. Retrying in" << backoff << "ms";
+            }
+        }
+
+        // Stopped. Unsent messages are kept for the next time. Messages of the segment are
+        // already on disk.
+        if (!segment.isEmpty()) {
+            batch.clear();
+        }
+
+        batch.append(m_queue);
+        m_queue.clear();
+
+        locker.unlock();
+
+        if (!segment.isEmpty()) {
+            releaseSegment(segment, false);
+        }
+
+        if (!batch.isEmpty()) {
+            spool(m_format, batch);
+        }
+    }
+
+private:
+    LogFomat m_format;
+    bool m_tcp;
+    bool m_gelf;
+    bool m_durable;
+    QString m_host;
+    unsigned m_port;
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    QQueue<QByteArray> m_queue;
+    bool m_running;
+    bool m_hasSpool;
+};
+
+
 //--------------------------------------------------------------------------------------------------
 // GraylogRemoteLogger
 //--------------------------------------------------------------------------------------------------
 
 Lvk::DAS::GraylogRemoteLogger::GraylogRemoteLogger()
-    : m_format(GELF), m_udpPort(0), m_tcpPort(0)
+    : m_format(GELF), m_udpPort(0), m_tcpPort(0), m_shipper(0)
 {
-    initHostPort();
+    init();
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::DAS::GraylogRemoteLogger::GraylogRemoteLogger(LogFomat format)
-    : m_format(format), m_udpPort(0), m_tcpPort(0)
+    : m_format(format), m_udpPort(0), m_tcpPort(0), m_shipper(0)
+{
+    init();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::DAS::GraylogRemoteLogger::~GraylogRemoteLogger()
 {
-    initHostPort();
+    delete m_shipper;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::DAS::GraylogRemoteLogger::initHostPort()
+void Lvk::DAS::GraylogRemoteLogger::init()
 {
     m_host    = GRAYLOG_HOST;
     m_udpPort = GRAYLOG_UDP_PORT;
     m_tcpPort = GRAYLOG_TCP_PORT;
+
+    unsigned port = m_format == SyslogTCP || m_format == EncSyslogTCP ? m_tcpPort : m_udpPort;
+
+    m_shipper = new Shipper(m_format, m_host, port);
+    m_shipper->start(QThread::LowPriority);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -170,18 +644,21 @@ int Lvk::DAS::GraylogRemoteLogger::log(const QString &msg, const FieldList &fiel
     QByteArray data;
     QString encMsg;
 
-    // Build message
+    // Build message. The event ID lets the server discard messages sent twice
+
+    FieldList idFields(fields);
+    idFields.append(RLOG_KEY_EVENT_ID, newEventId());
 
     switch (m_format) {
     case GELF:
-        data = DAS::Gelf(Gelf::Informational, msg, toGelfFields(fields)).data();
+        data = DAS::Gelf(Gelf::Informational, msg, toGelfFields(idFields)).data();
         break;
     case SyslogTCP:
     case SyslogUDP:
-        data = Syslog(msg + " " + toString(fields)).data();
+        data = Syslog(msg + " " + toString(idFields)).data();
         break;
     case EncSyslogTCP:
-        if (encrypt(encMsg, msg + " " + toString(fields))) {
+        if (encrypt(encMsg, msg + " " + toString(idFields))) {
             data = Syslog(encMsg).data();
         }
         break;
@@ -194,18 +671,9 @@ int Lvk::DAS::GraylogRemoteLogger::log(const QString &msg, const FieldList &fiel
         return 1;
     }
 
-    // Send message with proper protocol
+    // Queue message. The shipper sends it with the proper protocol
 
-    switch (m_format) {
-    case GELF:
-    case SyslogUDP:
-        return sendUdpMessage(data, m_host, m_udpPort);
-    case SyslogTCP:
-    case EncSyslogTCP:
-        return sendTcpMessage(data, m_host, m_tcpPort);
-    default:
-        return 1;
-    }
+    return m_shipper->enqueue(data) ? 0 : 1;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -214,13 +682,12 @@ bool Lvk::DAS::GraylogRemoteLogger::encrypt(QString &cipherText, const QString &
 {
     cipherText.clear();
 
-    std::auto_ptr<Crypto::KeyManager> keyMgr(Crypto::KeyManagerFactory().create());
+    Crypto::Cipher &cipher =
+            Crypto::KeyCache::cache()->threadCipher(Crypto::KeyManager::RemoteLoggerRole);
 
-    QByteArray iv = keyMgr->getIV(Crypto::KeyManager::RemoteLoggerRole);
-    QByteArray key = keyMgr->getKey(Crypto::KeyManager::RemoteLoggerRole);
     QByteArray data = plainText.toUtf8();
 
-    if (Crypto::Cipher(iv, key).encrypt(data)) {
+    if (cipher.encrypt(data)) {
         cipherText = "::E::"; // prefix for encoded data
         cipherText += data.toBase64();
     } else {
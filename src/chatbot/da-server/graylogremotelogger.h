@@ -44,6 +44,19 @@ namespace DAS
  *
  * The GraylogRemoteLogger sends messages to the server set in the configuration file.
  *
+ * Messages are sent asynchronously. log() only builds the message and puts it in a bounded
+ * queue. A background thread sends queued messages in batches through a persistent
+ * connection. If the connection fails, it is retried with exponential backoff. While the network
+ * is offline no connection is attempted. Messages that do not fit in the queue or remain unsent
+ * when the logger is destroyed are spooled to disk and sent later, possibly by another instance
+ * with the same format. Messages of the TCP formats are always spooled first, so they are not
+ * lost if the application crashes.
+ *
+ * The spool is a set of segment files in the logs directory. Each segment is sent by one logger
+ * at a time, which records how many messages were sent so far. Hence messages are not sent
+ * twice when sending is resumed. Every message also carries a unique RLOG_KEY_EVENT_ID field so
+ * the server can discard a batch sent twice after a failure.
+ *
  * More info about Graylog at http://graylog2.org/
  */
 class GraylogRemoteLogger : public RemoteLogger
@@ -72,23 +85,35 @@ public:
     GraylogRemoteLogger(LogFomat format);
 
     /**
-     * \copydoc RemoteLogger::log(const QString&)
+     * Destroys the object. Queued messages are sent or spooled to disk.
+     */
+    ~GraylogRemoteLogger();
+
+    /**
+     * Queues \a msg to be logged in the Graylog server. Returns 0 if the message was queued.
+     * Otherwise; returns a non-zero value.
      */
     virtual int log(const QString &msg);
 
     /**
-     * \copydoc RemoteLogger::log(const QString &, const FieldList&)
+     * Queues \a msg with additional fields \a fields to be logged in the Graylog server.
+     * Returns 0 if the message was queued. Otherwise; returns a non-zero value.
      */
     virtual int log(const QString &msg, const FieldList &fields);
 
 private:
+    GraylogRemoteLogger(GraylogRemoteLogger&);
+    GraylogRemoteLogger& operator=(GraylogRemoteLogger&);
+
+    class Shipper;
 
     LogFomat m_format;
     QString m_host;
     unsigned m_udpPort;
     unsigned m_tcpPort;
+    Shipper *m_shipper;
 
-    void initHostPort();
+    void init();
 
     bool encrypt(QString &cipherText, const QString &plainText);
 };
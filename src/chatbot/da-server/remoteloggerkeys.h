@@ -22,6 +22,7 @@
 #ifndef LVK_DAS_REMOTELOGGERKEYS_H
 #define LVK_DAS_REMOTELOGGERKEYS_H
 
+#define RLOG_KEY_EVENT_ID           "event_id"
 #define RLOG_KEY_APP_VERSION        "app_version"
 #define RLOG_KEY_CHATBOT_ID         "chatbot_id"
 #define RLOG_KEY_USER_ID            "user_id"
@@ -44,5 +45,12 @@
 #define RLOG_KEY_ROSTER_SIZE        "roster_size"
 #define RLOG_KEY_BLACK_ROSTER_SIZE  "black_roster_size"
 #define RLOG_KEY_INTERVAL_COUNT     "interval_count"
+#define RLOG_KEY_NLP_STATS_PREFIX   "nlp_"
+#define RLOG_KEY_NLP_MEMORY_PREFIX  "nlp_mem_"
+#define RLOG_KEY_NLP_SHADOW_PREFIX  "nlp_shadow_"
+#define RLOG_KEY_STARTUP_PREFIX     "startup_"
+#define RLOG_KEY_SAMPLE_RATE        "sample_rate"
+#define RLOG_KEY_AGGREGATE_PREFIX   "agg_"
+#define RLOG_KEY_AGGREGATE_PERIOD   "agg_period"
 
 #endif // LVK_DAS_REMOTELOGGERKEYS_H
@@ -1,4 +1,5 @@
 #include "da-server/rest.h"
+#include "da-server/serverconfig.h"
 #include "common/version.h"
 
 #include <QNetworkAccessManager>
@@ -9,6 +10,12 @@
 #include <QFile>
 #include <QDir>
 #include <QSslConfiguration>
+#include <QHash>
+#include <QPointer>
+#include <QCoreApplication>
+
+#define REST_REFS_PROPERTY      "lvkRestRefs"   // Amount of Rest objects sharing a reply
+#define REST_BODY_PROPERTY      "lvkRestBody"   // Body of a finished reply
 
 
 //--------------------------------------------------------------------------------------------------
@@ -26,6 +33,99 @@ inline void appendCertificate(const QString &filename, QList<QSslCertificate> &c
     delete f;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+QMutex                                  s_sharedMutex;
+QPointer<QNetworkAccessManager>         s_manager;
+QSslConfiguration *                     s_sslConf = 0;
+QHash<QString, QNetworkReply *>         s_running;  // Running requests by coalescing key
+
+//--------------------------------------------------------------------------------------------------
+
+// The process-wide network access manager. It is destroyed with the application object.
+inline QNetworkAccessManager *sharedManager()
+{
+    QMutexLocker locker(&s_sharedMutex);
+
+    if (!s_manager) {
+        s_manager = new QNetworkAccessManager(QCoreApplication::instance());
+    }
+
+    return s_manager;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// The SSL configuration with the pinned certificates. Certificates are parsed only once.
+inline const QSslConfiguration &pinnedSslConfiguration()
+{
+    QMutexLocker locker(&s_sharedMutex);
+
+    if (!s_sslConf) {
+        QSslConfiguration conf = QSslConfiguration::defaultConfiguration();
+        QList<QSslCertificate> certs = conf.caCertificates();
+
+        appendCertificate(":/certs/GeoTrustGlobalCA.pem", certs);
+        appendCertificate(":/certs/RapidSSLCA.pem", certs);
+
+        conf.setCaCertificates(certs);
+
+        s_sslConf = new QSslConfiguration(conf);
+    }
+
+    return *s_sslConf;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString coalescingKey(const QString &url, bool ignoreSslErrors)
+{
+    return ignoreSslErrors ? url + " ignoreSslErrors" : url;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QNetworkReply *runningReply(const QString &key)
+{
+    QMutexLocker locker(&s_sharedMutex);
+
+    QNetworkReply *reply = s_running.value(key);
+
+    return reply && reply->isRunning() ? reply : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void removeRunningReply(QNetworkReply *reply)
+{
+    QMutexLocker locker(&s_sharedMutex);
+
+    QHash<QString, QNetworkReply *>::iterator it = s_running.begin();
+    while (it != s_running.end()) {
+        if (it.value() == reply) {
+            it = s_running.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// The body can be read only once from the reply, so it is stored for the other Rest objects
+// sharing it
+inline QByteArray replyBody(QNetworkReply *reply)
+{
+    QVariant body = reply->property(REST_BODY_PROPERTY);
+
+    if (!body.isValid()) {
+        body = reply->readAll();
+        reply->setProperty(REST_BODY_PROPERTY, body);
+    }
+
+    return body.toByteArray();
+}
+
 } // namespace
 
 
@@ -36,7 +136,7 @@ inline void appendCertificate(const QString &filename, QList<QSslCertificate> &c
 Lvk::DAS::Rest::Rest(QObject *parent) :
     QObject(parent),
     m_replyMutex(new QMutex(QMutex::Recursive)),
-    m_manager(new QNetworkAccessManager(this)),
+    m_manager(0),
     m_reply(0),
     m_lastErr(QNetworkReply::NoError),
     m_ignoreSslErrors(false)
@@ -49,8 +149,7 @@ Lvk::DAS::Rest::~Rest()
 {
     {
         QMutexLocker locker(m_replyMutex);
-        delete m_reply;
-        delete m_manager;
+        releaseReply();
     }
 
     delete m_replyMutex;
@@ -70,17 +169,41 @@ bool Lvk::DAS::Rest::request(const QString &url)
             return false;
         }
 
-        delete m_reply;
-        m_reply = 0;
+        releaseReply();
     }
 
-    QNetworkRequest request;
-    request.setUrl(QUrl(url));
-    request.setRawHeader("User-Agent", APP_NAME "-" APP_VERSION_STR);
+    QString key = coalescingKey(url, m_ignoreSslErrors);
+    QNetworkReply *reply = runningReply(key);
+
+    if (reply) {
+        qDebug() << "Rest: Sharing running request";
+
+        reply->setProperty(REST_REFS_PROPERTY, reply->property(REST_REFS_PROPERTY).toInt() + 1);
+    } else {
+        QNetworkRequest request;
+        request.setUrl(QUrl(url));
+        request.setRawHeader("User-Agent", APP_NAME "-" APP_VERSION_STR);
+        request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+
+        if (!m_ignoreSslErrors) {
+            request.setSslConfiguration(pinnedSslConfiguration());
+        }
+
+        if (!m_manager) {
+            m_manager = sharedManager();
+        }
+
+        reply = m_manager->get(request);
+
+        if (m_ignoreSslErrors) {
+            reply->ignoreSslErrors();
+        }
 
-    QNetworkReply *reply = m_manager->get(request);
+        reply->setProperty(REST_REFS_PROPERTY, 1);
 
-    configureSsl(reply);
+        QMutexLocker sharedLocker(&s_sharedMutex);
+        s_running.insert(key, reply);
+    }
 
     connect(reply, SIGNAL(finished()), SLOT(onFinished()));
     connect(reply, SIGNAL(error(QNetworkReply::NetworkError)),
@@ -103,8 +226,38 @@ void Lvk::DAS::Rest::abort()
     QMutexLocker locker(m_replyMutex);
 
     if (m_reply) {
-        m_reply->abort();
+        if (m_reply->property(REST_REFS_PROPERTY).toInt() > 1) {
+            // Other Rest objects are sharing the request, only this one is detached
+            bool running = m_reply->isRunning();
+            releaseReply();
+            if (running) {
+                onError(QNetworkReply::OperationCanceledError);
+            }
+        } else {
+            m_reply->abort();
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::Rest::releaseReply()
+{
+    if (!m_reply) {
+        return;
     }
+
+    disconnect(m_reply, 0, this, 0);
+
+    int refs = m_reply->property(REST_REFS_PROPERTY).toInt() - 1;
+    m_reply->setProperty(REST_REFS_PROPERTY, refs);
+
+    if (refs <= 0) {
+        removeRunningReply(m_reply);
+        m_reply->deleteLater();
+    }
+
+    m_reply = 0;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -130,6 +283,44 @@ QList<QSslCertificate> Lvk::DAS::Rest::peerCertificateChain()
 
 //--------------------------------------------------------------------------------------------------
 
+bool Lvk::DAS::Rest::verifyPeerCertChain(const QList<QSslCertificate> &chain)
+{
+    QString err;
+
+    if (chain.isEmpty()) {
+        err = "Empty cert chain";
+    } else if (!chain[0].isValid()) {
+        err = "Invalid peer's immediate cert";
+    } else if (chain[0].issuerInfo(QSslCertificate::CommonName) != CA2_CERT_ISSUER_NAME) {
+        err = "Wrong issuer name: " + chain[0].issuerInfo(QSslCertificate::CommonName);
+    } else if (chain[0].subjectInfo(QSslCertificate::CommonName) != PEER_CERT_SUBJECT_NAME) {
+        err = "Wrong subject name: " + chain[0].subjectInfo(QSslCertificate::CommonName);
+    }
+
+    if (!err.isEmpty()) {
+        qCritical() << "Rest: Invalid peer cert chain:" << err;
+        return false;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QNetworkAccessManager * Lvk::DAS::Rest::networkManager()
+{
+    return sharedManager();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QSslConfiguration Lvk::DAS::Rest::sslConfiguration()
+{
+    return pinnedSslConfiguration();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::DAS::Rest::onFinished()
 {
     qDebug() << "Rest::onFinished";
@@ -139,8 +330,11 @@ void Lvk::DAS::Rest::onFinished()
     {
         QMutexLocker locker(m_replyMutex);
 
+        // Finished requests are not shared anymore
+        removeRunningReply(m_reply);
+
         if (m_reply->error() == QNetworkReply::NoError) {
-            resp = QString::fromUtf8(m_reply->readAll());
+            resp = QString::fromUtf8(replyBody(m_reply));
             unescape(resp);
             m_peerCertificateChain = m_reply->sslConfiguration().peerCertificateChain();
         }
@@ -192,22 +386,3 @@ void Lvk::DAS::Rest::unescape(QString &resp)
         resp.replace(pos++, 6, QChar(regex.cap(1).right(4).toUShort(0, 16)));
     }
 }
-
-//--------------------------------------------------------------------------------------------------
-
-void Lvk::DAS::Rest::configureSsl(QNetworkReply *reply)
-{
-    if (!m_ignoreSslErrors) {
-        QSslConfiguration conf = reply->sslConfiguration();
-        QList<QSslCertificate> certs = conf.caCertificates();
-
-        appendCertificate(":/certs/GeoTrustGlobalCA.pem", certs);
-        appendCertificate(":/certs/RapidSSLCA.pem", certs);
-
-        conf.setCaCertificates(certs);
-
-        reply->setSslConfiguration(conf);
-    } else {
-        reply->ignoreSslErrors();
-    }
-}
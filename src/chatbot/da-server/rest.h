@@ -8,6 +8,7 @@
 #include <QSslCertificate>
 
 class QNetworkAccessManager;
+class QSslConfiguration;
 class QMutex;
 
 
@@ -26,6 +27,11 @@ namespace DAS
 
 /**
  * \brief The Rest class provides a way to make REST requests
+ *
+ * All Rest objects share one QNetworkAccessManager, so connections are kept alive and reused
+ * between requests to the same host, and one SSL configuration with the pinned certificates,
+ * which are parsed only once. Concurrent requests for the same URL are coalesced into a single
+ * network request. Requests must be made from the main thread.
  */
 class Rest : public QObject
 {
@@ -45,6 +51,24 @@ public:
 
     virtual QList<QSslCertificate> peerCertificateChain();
 
+    /**
+     * Returns true if \a chain is the certificate chain of the Dale Aceptar servers.
+     * Otherwise; returns false. This function is thread-safe.
+     */
+    static bool verifyPeerCertChain(const QList<QSslCertificate> &chain);
+
+    /**
+     * Returns the network access manager shared by all Rest objects. It is destroyed with the
+     * application object.
+     */
+    static QNetworkAccessManager *networkManager();
+
+    /**
+     * Returns the SSL configuration with the certificates of the Dale Aceptar servers.
+     * This function is thread-safe.
+     */
+    static QSslConfiguration sslConfiguration();
+
 signals:
 
     void response(const QString &resp);
@@ -68,7 +92,7 @@ private:
     bool m_ignoreSslErrors;
     QList<QSslCertificate> m_peerCertificateChain;
 
-    void configureSsl(QNetworkReply *reply);
+    void releaseReply();
     void unescape(QString &resp);
 };
 
@@ -23,23 +23,145 @@
 #include "da-server/serverconfig.h"
 #include "da-server/remoteloggerfactory.h"
 #include "da-server/remoteloggerkeys.h"
-#include "crypto/keymanagerfactory.h"
+#include "da-server/zlibhelper.h"
+#include "crypto/keycache.h"
 #include "common/version.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "qssh/sshconnectionmanager.h"
 
 #include <QtDebug>
+#include <QDir>
 #include <QFileInfo>
+#include <QSet>
+#include <QCryptographicHash>
+#include <QTemporaryFile>
+#include <QTimer>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QDateTime>
 #include <memory>
 
+#define UPLOAD_CHUNK_SIZE       (256*1024)
+#define UPLOAD_MAX_RETRIES      5
+#define UPLOAD_RETRY_DELAY      2000    // In milliseconds
+
+#define CHUNK_MIN_SIZE          (2*1024)
+#define CHUNK_MAX_SIZE          (64*1024)
+#define CHUNK_BOUNDARY_MASK     0x1fff  // Average chunk size of 8 KB
+#define CHUNK_INDEX_FILENAME    "uploadchunks.idx"
+#define MANIFEST_HEADER         "LVK-CHUNKS 1\n"
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Random values for the gear rolling hash. Chunk boundaries, and hence the hashes kept in the
+// local index, depend on them so they must never change.
+struct GearTable
+{
+    GearTable()
+    {
+        quint32 x = 0x9e3779b9;
+
+        for (int i = 0; i < 256; ++i) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            values[i] = x;
+        }
+    }
+
+    quint32 values[256];
+};
+
+Q_GLOBAL_STATIC(GearTable, gearTable)
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the size of the content-defined chunk of data that starts at offset
+int nextChunkSize(const QByteArray &data, int offset)
+{
+    const quint32 *gear = gearTable()->values;
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData()) + offset;
+    int size = qMin(data.size() - offset, CHUNK_MAX_SIZE);
+    quint32 h = 0;
+
+    for (int i = 0; i < size; ++i) {
+        h = (h << 1) + gear[p[i]];
+
+        if (i + 1 >= CHUNK_MIN_SIZE && (h & CHUNK_BOUNDARY_MASK) == 0) {
+            return i + 1;
+        }
+    }
+
+    return size;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString chunkIndexFilename()
+{
+    QString dataPath = Lvk::Cmn::SettingsSnapshot::current().value(SETTING_DATA_PATH).toString();
+
+    return dataPath + QDir::separator() + CHUNK_INDEX_FILENAME;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the hashes of the chunks uploaded so far
+QSet<QByteArray> readChunkIndex()
+{
+    QSet<QByteArray> hashes;
+    QFile file(chunkIndexFilename());
+
+    if (file.open(QFile::ReadOnly)) {
+        while (!file.atEnd()) {
+            QByteArray hash = file.readLine().trimmed();
+
+            if (!hash.isEmpty()) {
+                hashes.insert(hash);
+            }
+        }
+    }
+
+    return hashes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void appendToChunkIndex(const QByteArray &hash)
+{
+    QFile file(chunkIndexFilename());
+    QByteArray line = hash + "\n";
+
+    if (!file.open(QFile::WriteOnly | QFile::Append) || file.write(line) != line.size()) {
+        qDebug() << "SftpContestDataUploader: Cannot write chunk index" << file.fileName();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString chunkRemoteFilename(const QByteArray &hash)
+{
+    return QString("%1/chunk_%2.z").arg(FILE_SERVER_DEST_PATH, QString::fromLatin1(hash));
+}
+
+} // namespace
+
 
 //--------------------------------------------------------------------------------------------------
 // SftpContestDataUploader
 //--------------------------------------------------------------------------------------------------
 
 Lvk::DAS::SftpContestDataUploader::SftpContestDataUploader()
-    : m_mutex(new QMutex(QMutex::Recursive)), m_inProgress(false), m_connection(0)
+    : m_mutex(new QMutex(QMutex::Recursive)), m_inProgress(false), m_connection(0),
+      m_localFile(0), m_chunkFile(0), m_offset(0), m_remoteSize(-1), m_retries(0),
+      m_statJob(QSsh::SftpInvalidJob), m_uploadJob(QSsh::SftpInvalidJob), m_dedup(false),
+      m_nextChunk(0)
 {
 }
 
@@ -68,25 +190,21 @@ void Lvk::DAS::SftpContestDataUploader::upload(const DAS::ContestData &data)
 
     m_inProgress = true;
     m_data = data;
+    m_offset = 0;
+    m_retries = 0;
 
-    initFilenames();
-
-    QSsh::SshConnectionParameters params;
-    getConnectionParams(params);
-
-    m_connection = new QSsh::SshConnection(params, this);
-
-    connect(m_connection, SIGNAL(connected()), SLOT(onConnected()));
-    connect(m_connection, SIGNAL(error(QSsh::SshError)), SLOT(onConnectionError(QSsh::SshError)));
+    if (!initFilenames()) {
+        finish(ChannelError);
 
-    qDebug() << "SftpContestDataUploader: Connecting to host...";
+        return;
+    }
 
-    m_connection->connectToHost();
+    connectToServer();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::DAS::SftpContestDataUploader::initFilenames()
+bool Lvk::DAS::SftpContestDataUploader::initFilenames()
 {
     QFileInfo info(m_data.filename);
 
@@ -95,14 +213,130 @@ void Lvk::DAS::SftpContestDataUploader::initFilenames()
     m_remoteFilename = QString("%1/%2_%3_%4.crf")
             .arg(FILE_SERVER_DEST_PATH, QDateTime::currentDateTime().toString(Qt::ISODate),
                  m_data.username, m_data.chatbotId);
+
+    m_dedup = Cmn::SettingsSnapshot::current().value(SETTING_UPLOAD_DEDUP).toBool();
+
+    if (m_dedup) {
+        // Chunks are compressed one by one
+        m_remoteFilename += ".manifest";
+    } else if (Cmn::SettingsSnapshot::current().value(SETTING_UPLOAD_COMPRESS).toBool()) {
+        if (!compressLocalFile()) {
+            return false;
+        }
+
+        m_localFilename = m_compressedFilename;
+        m_remoteFilename += ".z";
+    }
+
+    m_localFile = new QFile(m_localFilename);
+
+    if (!m_localFile->open(QFile::ReadOnly)) {
+        qDebug() << "SftpContestDataUploader: Cannot open" << m_localFilename;
+
+        return false;
+    }
+
+    m_chunkFile = new QTemporaryFile();
+
+    if (!m_chunkFile->open()) {
+        qDebug() << "SftpContestDataUploader: Cannot create chunk file";
+
+        return false;
+    }
+
+    return m_dedup ? initChunks() : true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::DAS::SftpContestDataUploader::initChunks()
+{
+    QByteArray data = m_localFile->readAll();
+
+    if (data.size() != m_localFile->size()) {
+        qDebug() << "SftpContestDataUploader: Cannot read" << m_localFilename;
+
+        return false;
+    }
+
+    QSet<QByteArray> uploaded = readChunkIndex();
+
+    m_chunks.clear();
+    m_nextChunk = 0;
+    m_manifest = MANIFEST_HEADER;
+
+    int offset = 0;
+
+    while (offset < data.size()) {
+        Chunk chunk;
+        chunk.offset = offset;
+        chunk.size = nextChunkSize(data, offset);
+        chunk.hash = QCryptographicHash::hash(QByteArray::fromRawData(data.constData() + offset,
+                                                                      chunk.size),
+                                              QCryptographicHash::Sha1).toHex();
+
+        m_manifest += chunk.hash + " " + QByteArray::number(chunk.size) + "\n";
+
+        // Files often repeat chunks, they are uploaded once
+        if (!uploaded.contains(chunk.hash)) {
+            uploaded.insert(chunk.hash);
+            m_chunks.append(chunk);
+        }
+
+        offset += chunk.size;
+    }
+
+    qDebug() << "SftpContestDataUploader: Split" << data.size() << "bytes,"
+             << m_chunks.size() << "new chunks";
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::DAS::SftpContestDataUploader::compressLocalFile()
+{
+    QFile file(m_localFilename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        qDebug() << "SftpContestDataUploader: Cannot open" << m_localFilename;
+
+        return false;
+    }
+
+    QByteArray compressed;
+
+    if (ZLibHelper::deflate(file.readAll(), compressed) != Z_OK) {
+        qDebug() << "SftpContestDataUploader: Cannot compress" << m_localFilename;
+
+        return false;
+    }
+
+    QTemporaryFile compressedFile;
+    compressedFile.setAutoRemove(false);
+
+    if (!compressedFile.open() || compressedFile.write(compressed) != compressed.size()) {
+        qDebug() << "SftpContestDataUploader: Cannot write compressed file";
+
+        compressedFile.remove();
+
+        return false;
+    }
+
+    m_compressedFilename = compressedFile.fileName();
+
+    qDebug() << "SftpContestDataUploader: Compressed" << file.size() << "bytes to"
+             << compressed.size() << "bytes";
+
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::DAS::SftpContestDataUploader::getConnectionParams(QSsh::SshConnectionParameters &params)
 {
-    std::auto_ptr<Crypto::KeyManager> keyMgr(Crypto::KeyManagerFactory().create());
-    QString passwd = QString::fromUtf8(keyMgr->getKey(Crypto::KeyManager::FileServerRole));
+    QByteArray key = Crypto::KeyCache::cache()->getKey(Crypto::KeyManager::FileServerRole);
+    QString passwd = QString::fromUtf8(key);
 
     params.host = FILE_SERVER_HOST;
     params.port = FILE_SERVER_PORT;
@@ -114,6 +348,35 @@ void Lvk::DAS::SftpContestDataUploader::getConnectionParams(QSsh::SshConnectionP
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::DAS::SftpContestDataUploader::connectToServer()
+{
+    QMutexLocker locker(m_mutex);
+
+    if (!m_inProgress) {
+        return;
+    }
+
+    QSsh::SshConnectionParameters params;
+    getConnectionParams(params);
+
+    m_connection = QSsh::SshConnectionManager::instance().acquireConnection(params);
+
+    connect(m_connection, SIGNAL(connected()), SLOT(onConnected()));
+    connect(m_connection, SIGNAL(error(QSsh::SshError)), SLOT(onConnectionError(QSsh::SshError)));
+
+    if (m_connection->state() == QSsh::SshConnection::Connected) {
+        qDebug() << "SftpContestDataUploader: Reusing connection";
+
+        onConnected();
+    } else {
+        qDebug() << "SftpContestDataUploader: Connecting to host...";
+
+        m_connection->connectToHost();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::DAS::SftpContestDataUploader::onConnected()
 {
     qDebug() << "SftpContestDataUploader: Connected";
@@ -128,6 +391,9 @@ void Lvk::DAS::SftpContestDataUploader::onConnected()
                 SLOT(onChannelInitialized()));
         connect(m_channel.data(), SIGNAL(initializationFailed(QString)),
                 SLOT(onChannelError(QString)));
+        connect(m_channel.data(), SIGNAL(fileInfoAvailable(QSsh::SftpJobId,
+                                                           QList<QSsh::SftpFileInfo>)),
+                SLOT(onFileInfoAvailable(QSsh::SftpJobId, QList<QSsh::SftpFileInfo>)));
         connect(m_channel.data(), SIGNAL(finished(QSsh::SftpJobId, QString)),
                 SLOT(onOpfinished(QSsh::SftpJobId, QString)));
 
@@ -136,7 +402,7 @@ void Lvk::DAS::SftpContestDataUploader::onConnected()
     } else {
         qDebug() << "SftpContestDataUploader: Error null channel";
 
-        finish(ConnectionError);
+        retry(ConnectionError);
     }
 }
 
@@ -146,7 +412,7 @@ void Lvk::DAS::SftpContestDataUploader::onConnectionError(QSsh::SshError err)
 {
     qDebug() << "SftpContestDataUploader: Connection error" << err;
 
-    finish(ConnectionError);
+    retry(ConnectionError);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -154,19 +420,30 @@ void Lvk::DAS::SftpContestDataUploader::onConnectionError(QSsh::SshError err)
 void Lvk::DAS::SftpContestDataUploader::onChannelInitialized()
 {
     qDebug() << "SftpContestDataUploader: Channel Initialized";
-    qDebug() << "SftpContestDataUploader: Uploading" << m_localFilename << "->" << m_remoteFilename;
 
     QMutexLocker locker(m_mutex);
 
-    QSsh::SftpJobId job = m_channel->uploadFile(m_localFilename, m_remoteFilename,
-                                                QSsh::SftpOverwriteExisting);
+    if (m_dedup) {
+        uploadNextNewChunk();
 
-    if (job != QSsh::SftpInvalidJob) {
-        qDebug() << "SftpContestDataUploader: Started job #" << job;
-    } else {
+        return;
+    }
+
+    if (m_offset == 0) {
+        uploadNextChunk();
+
+        return;
+    }
+
+    // Resuming, check how much the server has received
+
+    m_remoteSize = -1;
+    m_statJob = m_channel->statFile(m_remoteFilename);
+
+    if (m_statJob == QSsh::SftpInvalidJob) {
         qDebug() << "SftpContestDataUploader: Invalid Job";
 
-        finish(ChannelError);
+        retry(ChannelError);
     }
 }
 
@@ -176,7 +453,112 @@ void Lvk::DAS::SftpContestDataUploader::onChannelError(const QString &err)
 {
     qDebug() << "SftpContestDataUploader: Error: " << err;
 
-    finish(ChannelError);
+    retry(ChannelError);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::SftpContestDataUploader::onFileInfoAvailable(QSsh::SftpJobId job,
+                                                            const QList<QSsh::SftpFileInfo> &list)
+{
+    QMutexLocker locker(m_mutex);
+
+    if (job == m_statJob && !list.isEmpty() && list.first().sizeValid) {
+        m_remoteSize = list.first().size;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// The file is uploaded one chunk at a time. QSsh pipelines the write requests of each chunk.
+void Lvk::DAS::SftpContestDataUploader::uploadNextChunk()
+{
+    bool success = m_localFile->seek(m_offset);
+
+    QByteArray chunk = m_localFile->read(UPLOAD_CHUNK_SIZE);
+
+    success = success && m_chunkFile->resize(0) && m_chunkFile->seek(0)
+            && m_chunkFile->write(chunk) == chunk.size() && m_chunkFile->flush();
+
+    if (!success) {
+        qDebug() << "SftpContestDataUploader: Cannot read" << m_localFilename;
+
+        finish(ChannelError);
+
+        return;
+    }
+
+    qDebug() << "SftpContestDataUploader: Uploading" << m_localFilename << "->" << m_remoteFilename
+             << "from" << m_offset << "of" << m_localFile->size() << "bytes";
+
+    QSsh::SftpOverwriteMode mode = m_offset == 0 ? QSsh::SftpOverwriteExisting
+                                                 : QSsh::SftpAppendToExisting;
+
+    m_uploadJob = m_channel->uploadFile(m_chunkFile->fileName(), m_remoteFilename, mode);
+
+    if (m_uploadJob != QSsh::SftpInvalidJob) {
+        qDebug() << "SftpContestDataUploader: Started job #" << m_uploadJob;
+    } else {
+        qDebug() << "SftpContestDataUploader: Invalid Job";
+
+        retry(ChannelError);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Uploads the next new chunk compressed, or the manifest once every new chunk is uploaded. Chunks
+// are small, so a failed chunk is uploaded again from the beginning.
+void Lvk::DAS::SftpContestDataUploader::uploadNextNewChunk()
+{
+    QByteArray content;
+    QString remoteFilename;
+
+    if (m_nextChunk < m_chunks.size()) {
+        const Chunk &chunk = m_chunks[m_nextChunk];
+
+        bool success = m_localFile->seek(chunk.offset);
+
+        QByteArray raw = m_localFile->read(chunk.size);
+
+        if (!success || raw.size() != chunk.size || ZLibHelper::deflate(raw, content) != Z_OK) {
+            qDebug() << "SftpContestDataUploader: Cannot read chunk" << chunk.hash;
+
+            finish(ChannelError);
+
+            return;
+        }
+
+        remoteFilename = chunkRemoteFilename(chunk.hash);
+    } else {
+        content = m_manifest;
+        remoteFilename = m_remoteFilename;
+    }
+
+    bool success = m_chunkFile->resize(0) && m_chunkFile->seek(0)
+            && m_chunkFile->write(content) == content.size() && m_chunkFile->flush();
+
+    if (!success) {
+        qDebug() << "SftpContestDataUploader: Cannot write chunk file";
+
+        finish(ChannelError);
+
+        return;
+    }
+
+    qDebug() << "SftpContestDataUploader: Uploading" << remoteFilename << "chunk"
+             << m_nextChunk + 1 << "of" << m_chunks.size() + 1;
+
+    m_uploadJob = m_channel->uploadFile(m_chunkFile->fileName(), remoteFilename,
+                                        QSsh::SftpOverwriteExisting);
+
+    if (m_uploadJob != QSsh::SftpInvalidJob) {
+        qDebug() << "SftpContestDataUploader: Started job #" << m_uploadJob;
+    } else {
+        qDebug() << "SftpContestDataUploader: Invalid Job";
+
+        retry(ChannelError);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -187,19 +569,117 @@ void Lvk::DAS::SftpContestDataUploader::onOpfinished(QSsh::SftpJobId job, const
 
     qDebug() << "SftpContestDataUploader: Finished job #" << job << ":" << (success ? "Success" : err);
 
-    if (success) {
+    QMutexLocker locker(m_mutex);
+
+    if (!m_inProgress) {
+        return;
+    }
+
+    if (job == m_statJob) {
+        m_statJob = QSsh::SftpInvalidJob;
+
+        // If the last chunk was partially written, we cannot truncate it. Start again.
+        if (!success || m_remoteSize != m_offset) {
+            qDebug() << "SftpContestDataUploader: Cannot resume, remote size" << m_remoteSize
+                     << "expected" << m_offset;
+
+            m_offset = 0;
+        }
+
+        uploadNextChunk();
+
+    } else if (job == m_uploadJob) {
+        m_uploadJob = QSsh::SftpInvalidJob;
+
+        if (!success) {
+            retry(ChannelError);
+
+            return;
+        }
+
+        m_retries = 0;
+
+        if (m_dedup) {
+            if (m_nextChunk < m_chunks.size()) {
+                appendToChunkIndex(m_chunks[m_nextChunk++].hash);
+                uploadNextNewChunk();
+
+                return;
+            }
+        } else {
+            m_offset += m_chunkFile->size();
+
+            if (m_offset < m_localFile->size()) {
+                uploadNextChunk();
+
+                return;
+            }
+        }
+
         if (sendScore()) {
             finish(Success);
         } else {
             finish(SecureLogError);
         }
-    } else {
-        finish(ChannelError);
     }
 }
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::DAS::SftpContestDataUploader::retry(Status status)
+{
+    QMutexLocker locker(m_mutex);
+
+    if (!m_inProgress) {
+        return;
+    }
+
+    releaseConnection(true);
+
+    if (++m_retries > UPLOAD_MAX_RETRIES) {
+        finish(status);
+
+        return;
+    }
+
+    qDebug() << "SftpContestDataUploader: Retrying in" << UPLOAD_RETRY_DELAY << "ms from"
+             << m_offset << "bytes. Retry" << m_retries << "of" << UPLOAD_MAX_RETRIES;
+
+    QTimer::singleShot(UPLOAD_RETRY_DELAY, this, SLOT(connectToServer()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Connections are released to the connection manager so they can be reused. Broken connections
+// are discarded.
+void Lvk::DAS::SftpContestDataUploader::releaseConnection(bool force)
+{
+    if (m_channel) {
+        m_channel->disconnect(this);
+        m_channel->closeChannel();
+        m_channel.clear();
+    }
+
+    if (m_connection) {
+        m_connection->disconnect(this);
+
+        if (force) {
+            QSsh::SshConnectionParameters params;
+            getConnectionParams(params);
+
+            QSsh::SshConnectionManager::instance().forceNewConnection(params);
+        }
+
+        QSsh::SshConnectionManager::instance().releaseConnection(m_connection);
+        m_connection = 0;
+    }
+
+    m_statJob = QSsh::SftpInvalidJob;
+    m_uploadJob = QSsh::SftpInvalidJob;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool Lvk::DAS::SftpContestDataUploader::sendScore()
 {
 // Disabled send score:
@@ -239,8 +719,21 @@ void Lvk::DAS::SftpContestDataUploader::close()
 
     if (m_inProgress) {
         m_inProgress = false;
-        m_channel.clear();
-        delete m_connection;
+
+        releaseConnection(false);
+
+        delete m_localFile;
+        m_localFile = 0;
+        delete m_chunkFile;
+        m_chunkFile = 0;
+
+        m_chunks.clear();
+        m_manifest.clear();
+
+        if (!m_compressedFilename.isEmpty()) {
+            QFile::remove(m_compressedFilename);
+            m_compressedFilename.clear();
+        }
     }
 }
 
@@ -23,6 +23,8 @@
 #define LVK_DAS_SFTPCONTESTDATAUPLOADER_H
 
 #include <QObject>
+#include <QList>
+#include <QByteArray>
 
 #include "da-server/contestdata.h"
 #include "da-server/contestdatauploader.h"
@@ -30,6 +32,8 @@
 #include "qssh/sshconnection.h"
 
 class QMutex;
+class QFile;
+class QTemporaryFile;
 
 namespace Lvk
 {
@@ -46,6 +50,21 @@ namespace DAS
 
 /**
  * \brief The SftpContestDataUploader class provides an SFTP uploader
+ *
+ * Files are uploaded in chunks. Each chunk is sent with several write requests in flight and
+ * it is appended to the remote file. If the connection fails, the uploader reconnects and
+ * resumes the upload from the last chunk the server has completely received.
+ *
+ * Optionally, files are compressed with zlib before the transfer. See SETTING_UPLOAD_COMPRESS.
+ *
+ * If SETTING_UPLOAD_DEDUP is enabled, files are split in content-defined chunks instead, so an
+ * edit only changes the chunks around it. Only chunks not uploaded before are sent, each one
+ * compressed with zlib to <tt>chunk_&lt;sha1&gt;.z</tt>, followed by a manifest that lists the
+ * SHA-1 and size of every chunk of the file in order. The hashes of the uploaded chunks are kept
+ * in a local index, hence an interrupted upload also resumes from the first chunk not sent.
+ *
+ * SSH connections are shared through QSsh::SshConnectionManager, hence repeated uploads in
+ * the same session reuse the connection.
  */
 class SftpContestDataUploader : public ContestDataUploader
 {
@@ -76,13 +95,22 @@ signals:
     void finished(DAS::ContestDataUploader::Status status);
 
 private slots:
+    void connectToServer();
     void onConnected();
     void onConnectionError(QSsh::SshError);
     void onChannelInitialized();
     void onChannelError(const QString &err);
+    void onFileInfoAvailable(QSsh::SftpJobId job, const QList<QSsh::SftpFileInfo> &fileInfoList);
     void onOpfinished(QSsh::SftpJobId job, const QString & error = QString());
 
 private:
+    struct Chunk
+    {
+        QByteArray hash;                // Hex SHA-1 of the uncompressed chunk
+        qint64 offset;
+        int size;
+    };
+
     QMutex *m_mutex;
     bool m_inProgress;
     QString m_localFilename;
@@ -90,10 +118,28 @@ private:
     ContestData m_data;
     QSsh::SftpChannel::Ptr m_channel;
     QSsh::SshConnection *m_connection;
-
-    void initFilenames();
+    QFile *m_localFile;
+    QTemporaryFile *m_chunkFile;        // Chunk being uploaded
+    QString m_compressedFilename;
+    qint64 m_offset;                    // Bytes completely uploaded
+    qint64 m_remoteSize;
+    int m_retries;
+    QSsh::SftpJobId m_statJob;
+    QSsh::SftpJobId m_uploadJob;
+    bool m_dedup;
+    QList<Chunk> m_chunks;              // New chunks, in upload order
+    int m_nextChunk;                    // Index of the next new chunk to upload
+    QByteArray m_manifest;
+
+    bool initFilenames();
+    bool compressLocalFile();
+    bool initChunks();
+    void uploadNextNewChunk();
     void getConnectionParams(QSsh::SshConnectionParameters &params);
     void parseDestination(const QString &dest);
+    void uploadNextChunk();
+    void retry(Status status);
+    void releaseConnection(bool force);
     bool sendScore();
     void finish(Status status);
     void close();
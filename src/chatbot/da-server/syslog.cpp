@@ -25,40 +25,101 @@
 #include <QString>
 #include <QHostInfo>
 #include <QDateTime>
+#include <QThreadStorage>
 #include <QDebug>
 
 #define NILVALUE            "-"
 #define SP                  " "
 #define SYSLOG_VERSION      "1"
-#define SYSLOG_DATE_FORMAT  "yyyy-MM-ddThh:mm:ss.zzz-03:00"
+#define SYSLOG_PRIORITY     "<165>"     // FIXME priority
+#define SYSLOG_DATE_FORMAT  "yyyy-MM-ddThh:mm:ss"
+#define SYSLOG_TIME_ZONE    "-03:00"
+#define SYSLOG_DATE_SIZE    29          // Date with milliseconds and time zone
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Per-thread Syslog header. The host name and the app name never change, so they are formatted
+// once. The date is formatted once per second and milliseconds are appended to it.
+
+class SyslogHeader
+{
+public:
+    SyslogHeader()
+        : m_tail(SP + QHostInfo::localHostName().toAscii() + SP + APP_NAME "_" APP_VERSION_STR
+                 SP NILVALUE SP),
+          m_secs(-1) { }
+
+    // Returns " HOSTNAME APP-NAME PROCID "
+    const QByteArray &tail() const
+    {
+        return m_tail;
+    }
+
+    // Appends the current date with milliseconds and time zone to data
+    void appendDate(QByteArray &data)
+    {
+        qint64 msecs = QDateTime::currentMSecsSinceEpoch();
+        qint64 secs = msecs / 1000;
+
+        if (secs != m_secs) {
+            m_secs = secs;
+            m_date = QDateTime::fromMSecsSinceEpoch(secs*1000).toString(SYSLOG_DATE_FORMAT)
+                    .toAscii();
+        }
+
+        int ms = msecs % 1000;
+        char frac[] = { '.', char('0' + ms/100), char('0' + ms/10%10), char('0' + ms%10) };
+
+        data.append(m_date);
+        data.append(frac, sizeof(frac));
+        data.append(SYSLOG_TIME_ZONE);
+    }
+
+private:
+    QByteArray m_tail;
+    qint64 m_secs;
+    QByteArray m_date;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+QThreadStorage<SyslogHeader *> threadHeaders;
+
+inline SyslogHeader &threadHeader()
+{
+    if (!threadHeaders.hasLocalData()) {
+        threadHeaders.setLocalData(new SyslogHeader());
+    }
+
+    return *threadHeaders.localData();
+}
+
+} // namespace
+
 
 //--------------------------------------------------------------------------------------------------
 // Syslog
 //--------------------------------------------------------------------------------------------------
 
+// Format: PRI VERSION SP DATETIME SP HOSTNAME SP APP-NAME SP PROCID SP MSG. MSGID and
+// STRUCTURED-DATA are omitted.
 Lvk::DAS::Syslog::Syslog(const QString &msg)
 {
-    QByteArray priority = "<165>"; // FIXME priority
-    QByteArray date = QDateTime::currentDateTime().toString(SYSLOG_DATE_FORMAT).toAscii();
-    QByteArray host = QHostInfo::localHostName().toAscii();
-    QByteArray app = APP_NAME "_" APP_VERSION_STR;
-
-    m_data.append(priority);              // PRI
-    m_data.append(SYSLOG_VERSION);        // VERSION
-    m_data.append(SP);                    // SP
-    m_data.append(date);                  // DATETIME
-    m_data.append(SP);                    // SP
-    m_data.append(host);                  // HOSTNAME
-    m_data.append(SP);                    // SP
-    m_data.append(app);                   // APP-NAME
-    m_data.append(SP);                    // SP
-    m_data.append(NILVALUE);              // PROCID
-    //data.append(SP);                    // SP
-    //data.append(NILVALUE);              // MSGID
-    //data.append(SP);                    // SP
-    //data.append(NILVALUE);              // STRUCTURED-DATA
-    m_data.append(SP);                    // SP
-    m_data.append(msg.toUtf8());          // MSG
+    SyslogHeader &header = threadHeader();
+    QByteArray utf8Msg = msg.toUtf8();
+
+    m_data.reserve(sizeof(SYSLOG_PRIORITY SYSLOG_VERSION SP) + SYSLOG_DATE_SIZE
+                   + header.tail().size() + utf8Msg.size());
+
+    m_data.append(SYSLOG_PRIORITY SYSLOG_VERSION SP);
+    header.appendDate(m_data);
+    m_data.append(header.tail());
+    m_data.append(utf8Msg);
 
     //qDebug() << "Syslog message:" << m_data;
 }
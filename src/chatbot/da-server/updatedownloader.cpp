@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "da-server/updatedownloader.h"
+#include "da-server/rest.h"
+#include "common/version.h"
+
+#include <QtDebug>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QUrl>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QSslConfiguration>
+#include <QCryptographicHash>
+#include <QtConcurrentRun>
+
+#define PART_SUFFIX             ".part"
+#define DATA_STAGING_DIR        "data"
+#define HASH_CHUNK_SIZE         (1024*1024)
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+inline QString urlFileName(const QString &url)
+{
+    return QFileInfo(QUrl(url).path()).fileName();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool sameHash(const QString &h1, const QString &h2)
+{
+    return !h1.isEmpty() && h1.compare(h2, Qt::CaseInsensitive) == 0;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// UpdateDownloader
+//--------------------------------------------------------------------------------------------------
+
+Lvk::DAS::UpdateDownloader::UpdateDownloader(QObject *parent /*= 0*/)
+    : QObject(parent),
+      m_reply(0),
+      m_offset(0),
+      m_statusChecked(false),
+      m_ignoreSslErrors(false),
+      m_running(false),
+      m_aborted(false)
+{
+    connect(&m_planWatcher, SIGNAL(finished()), SLOT(onPlanned()));
+    connect(&m_hashWatcher, SIGNAL(finished()), SLOT(onVerified()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::DAS::UpdateDownloader::~UpdateDownloader()
+{
+    abort();
+
+    // Worker threads do not use this object but their results must not be delivered
+    m_planWatcher.waitForFinished();
+    m_hashWatcher.waitForFinished();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::DAS::UpdateDownloader::download(const DAS::UpdateInfo &info, const QString &dir)
+{
+    if (m_running || m_planWatcher.isRunning() || m_hashWatcher.isRunning()) {
+        qCritical() << "UpdateDownloader: Previous download still running";
+        return false;
+    }
+
+    // Unverified packages are never downloaded
+    if (info.url().isEmpty() || info.hash().isEmpty()) {
+        qCritical() << "UpdateDownloader: Update without package hash";
+        return false;
+    }
+
+    qDebug() << "UpdateDownloader: Downloading update" << info.version().toString();
+
+    if (!QDir().mkpath(QDir(dir).filePath(DATA_STAGING_DIR))) {
+        qCritical() << "UpdateDownloader: Cannot create path" << dir;
+        return false;
+    }
+
+    m_running = true;
+    m_aborted = false;
+    m_jobs.clear();
+    m_package.clear();
+    m_dataFiles.clear();
+
+    // Local files are hashed to find out what must be downloaded
+    m_planWatcher.setFuture(QtConcurrent::run(&UpdateDownloader::planJobs, info, dir));
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Runs in a worker thread
+QList<Lvk::DAS::UpdateDownloader::Job>
+Lvk::DAS::UpdateDownloader::planJobs(const DAS::UpdateInfo &info, const QString &dir)
+{
+    QList<Job> jobs;
+
+    Job pkg;
+    pkg.isPackage = true;
+
+    if (!info.deltaUrl().isEmpty()) {
+        pkg.url = info.deltaUrl();
+        pkg.hash = info.deltaHash();
+        pkg.fallbackUrl = info.url();
+        pkg.fallbackHash = info.hash();
+    } else {
+        pkg.url = info.url();
+        pkg.hash = info.hash();
+    }
+
+    pkg.filename = QDir(dir).filePath(urlFileName(pkg.url));
+    pkg.done = QFile::exists(pkg.filename) && sameHash(fileHash(pkg.filename), pkg.hash);
+    jobs.append(pkg);
+
+    QDir stagingDir(QDir(dir).filePath(DATA_STAGING_DIR));
+    QDir appDir(QCoreApplication::applicationDirPath());
+
+    foreach (const DAS::UpdateInfo::DataFile &df, info.dataFiles()) {
+        if (sameHash(fileHash(appDir.filePath(df.path)), df.hash)) {
+            continue; // Unchanged
+        }
+
+        Job job;
+        job.url = df.url;
+        job.hash = df.hash;
+        job.filename = stagingDir.filePath(df.hash.toLower());
+        job.done = QFile::exists(job.filename) && sameHash(fileHash(job.filename), job.hash);
+        jobs.append(job);
+    }
+
+    return jobs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Runs in a worker thread. Returns an empty string if the file cannot be read.
+QString Lvk::DAS::UpdateDownloader::fileHash(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    while (!file.atEnd()) {
+        hash.addData(file.read(HASH_CHUNK_SIZE));
+    }
+
+    return QString(hash.result().toHex());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::onPlanned()
+{
+    if (m_aborted) {
+        return;
+    }
+
+    m_jobs = m_planWatcher.result();
+
+    nextJob();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::nextJob()
+{
+    while (!m_jobs.isEmpty() && m_jobs.first().done) {
+        const Job &job = m_jobs.first();
+
+        if (job.isPackage) {
+            m_package = job.filename;
+        } else {
+            m_dataFiles.append(job.filename);
+        }
+
+        m_jobs.removeFirst();
+    }
+
+    if (m_jobs.isEmpty()) {
+        qDebug() << "UpdateDownloader: Update downloaded";
+
+        m_running = false;
+        emit finished(m_package, m_dataFiles);
+    } else {
+        startJob();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::startJob()
+{
+    const Job &job = m_jobs.first();
+
+    m_part.setFileName(job.filename + PART_SUFFIX);
+
+    if (!m_part.open(QFile::ReadWrite)) {
+        qCritical() << "UpdateDownloader: Cannot open" << m_part.fileName();
+        fail(job.url);
+        return;
+    }
+
+    m_offset = m_part.size();
+    m_part.seek(m_offset);
+    m_statusChecked = false;
+
+    qDebug() << "UpdateDownloader: Downloading" << job.url << "from byte" << m_offset;
+
+    QNetworkRequest request;
+    request.setUrl(QUrl(job.url));
+    request.setRawHeader("User-Agent", APP_NAME "-" APP_VERSION_STR);
+
+    if (m_offset > 0) {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(m_offset) + "-");
+    }
+
+    if (!m_ignoreSslErrors) {
+        request.setSslConfiguration(Rest::sslConfiguration());
+    }
+
+    m_reply = Rest::networkManager()->get(request);
+
+    if (m_ignoreSslErrors) {
+        m_reply->ignoreSslErrors();
+    }
+
+    connect(m_reply, SIGNAL(readyRead()), SLOT(onReadyRead()));
+    connect(m_reply, SIGNAL(downloadProgress(qint64,qint64)),
+            SLOT(onDownloadProgress(qint64,qint64)));
+    connect(m_reply, SIGNAL(sslErrors(QList<QSslError>)), SLOT(onSslErrors(QList<QSslError>)));
+    connect(m_reply, SIGNAL(finished()), SLOT(onReplyFinished()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::onReadyRead()
+{
+    if (!m_statusChecked) {
+        m_statusChecked = true;
+
+        int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+        // The server ignored the Range header and sends the whole file
+        if (m_offset > 0 && status == 200) {
+            qDebug() << "UpdateDownloader: Cannot resume" << m_reply->url().toString();
+            m_part.resize(0);
+            m_part.seek(0);
+            m_offset = 0;
+        }
+    }
+
+    if (m_part.write(m_reply->readAll()) == -1) {
+        qCritical() << "UpdateDownloader: Cannot write" << m_part.fileName();
+        m_reply->abort();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::onDownloadProgress(qint64 received, qint64 total)
+{
+    emit progress(m_offset + received, total >= 0 ? m_offset + total : -1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::onSslErrors(const QList<QSslError> &errs)
+{
+    qCritical() << "UpdateDownloader: SSL errors" << errs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::onReplyFinished()
+{
+    if (!m_aborted && m_reply->error() == QNetworkReply::NoError) {
+        onReadyRead();
+    }
+
+    QNetworkReply *reply = m_reply;
+    m_reply = 0;
+    reply->deleteLater();
+
+    m_part.close();
+
+    if (m_aborted) {
+        return;
+    }
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // 416: The part file is already complete, it is verified as it is
+    if (reply->error() != QNetworkReply::NoError && status != 416) {
+        qCritical() << "UpdateDownloader: Download error" << reply->error();
+        fail(m_jobs.first().url);
+        return;
+    }
+
+    m_hashWatcher.setFuture(QtConcurrent::run(&UpdateDownloader::fileHash, m_part.fileName()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::onVerified()
+{
+    if (m_aborted) {
+        return;
+    }
+
+    Job &job = m_jobs.first();
+
+    if (sameHash(m_hashWatcher.result(), job.hash)) {
+        QFile::remove(job.filename);
+
+        if (QFile::rename(m_part.fileName(), job.filename)) {
+            job.done = true;
+            nextJob();
+        } else {
+            qCritical() << "UpdateDownloader: Cannot rename" << m_part.fileName();
+            fail(job.url);
+        }
+    } else {
+        qCritical() << "UpdateDownloader: Wrong hash for" << job.url;
+
+        // A corrupted part file must not be resumed
+        QFile::remove(m_part.fileName());
+
+        if (!job.fallbackUrl.isEmpty()) {
+            qDebug() << "UpdateDownloader: Falling back to the full package";
+
+            job.url = job.fallbackUrl;
+            job.hash = job.fallbackHash;
+            job.filename = QFileInfo(job.filename).dir().filePath(urlFileName(job.url));
+            job.fallbackUrl.clear();
+            job.fallbackHash.clear();
+            startJob();
+        } else {
+            fail(job.url);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::fail(const QString &url)
+{
+    m_jobs.clear();
+    m_running = false;
+
+    emit error(url);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::abort()
+{
+    if (!m_running) {
+        return;
+    }
+
+    qDebug() << "UpdateDownloader: Download aborted";
+
+    m_aborted = true;
+    m_running = false;
+    m_jobs.clear();
+
+    if (m_reply) {
+        m_reply->abort();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::DAS::UpdateDownloader::isRunning() const
+{
+    return m_running;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UpdateDownloader::setIgnoreSslErrors(bool ignore)
+{
+    m_ignoreSslErrors = ignore;
+}
+
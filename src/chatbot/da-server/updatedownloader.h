@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_DAS_UPDATEDOWNLOADER_H
+#define LVK_DAS_UPDATEDOWNLOADER_H
+
+#include "da-server/updateinfo.h"
+
+#include <QObject>
+#include <QFile>
+#include <QStringList>
+#include <QFutureWatcher>
+
+class QNetworkReply;
+class QSslError;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace DAS
+{
+
+/// \ingroup Lvk
+/// \addtogroup DAS
+/// @{
+
+/**
+ * \brief The UpdateDownloader class downloads application updates in background
+ *
+ * The binary delta from the current version is downloaded if the update provides one, otherwise
+ * the full package is downloaded. Data files are content-addressed, so only those whose local
+ * copy differs from the update are downloaded. They are staged as <tt>data/&lt;hash&gt;</tt>
+ * in the download directory because the running application may have them mapped.
+ *
+ * Files are downloaded to a <tt>.part</tt> file that is kept if the download is aborted or
+ * fails, so the next download() resumes it with an HTTP Range request. Once complete, every
+ * file is verified against the SHA-1 hash of the update info, which comes from the check for
+ * update response. Files are hashed in a worker thread.
+ */
+class UpdateDownloader : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Creates an UpdateDownloader object with parent object \a parent
+     */
+    explicit UpdateDownloader(QObject *parent = 0);
+
+    /**
+     * Destroys the object and aborts the download in progress (if any)
+     */
+    ~UpdateDownloader();
+
+    /**
+     * Starts downloading the update \a info into the directory \a dir. Emits finished() once
+     * all files are downloaded and verified. Otherwise; emits error(). Returns false if there
+     * is a download in progress or \a info has no hash to verify the package.
+     */
+    bool download(const UpdateInfo &info, const QString &dir);
+
+    /**
+     * Aborts the download in progress (if any). Partial files are kept to resume later.
+     */
+    void abort();
+
+    /**
+     * Returns true if there is a download in progress. Otherwise; returns false.
+     */
+    bool isRunning() const;
+
+    /**
+     * If \a ignore is true then SSL errors are ignored. By default are not ignored.
+     */
+    void setIgnoreSslErrors(bool ignore);
+
+signals:
+
+    /**
+     * This signal is emitted to indicate the progress of the file being downloaded.
+     * \a total is -1 if the size is unknown.
+     */
+    void progress(qint64 received, qint64 total);
+
+    /**
+     * This signal is emitted when the update was downloaded and verified. \a package is the
+     * full package or the delta and \a dataFiles are the staged data files.
+     */
+    void finished(const QString &package, const QStringList &dataFiles);
+
+    /**
+     * This signal is emitted if the file with URL \a url cannot be downloaded or verified.
+     */
+    void error(const QString &url);
+
+private slots:
+    void onPlanned();
+    void onReadyRead();
+    void onDownloadProgress(qint64 received, qint64 total);
+    void onSslErrors(const QList<QSslError> &errs);
+    void onReplyFinished();
+    void onVerified();
+
+private:
+    UpdateDownloader(const UpdateDownloader&);
+    UpdateDownloader & operator=(const UpdateDownloader&);
+
+    struct Job
+    {
+        Job() : isPackage(false), done(false) { }
+
+        QString url;
+        QString hash;
+        QString filename;
+        QString fallbackUrl;    // Full package if the delta cannot be verified
+        QString fallbackHash;
+        bool isPackage;
+        bool done;              // Already downloaded and verified
+    };
+
+    QList<Job> m_jobs;
+    QString m_package;
+    QStringList m_dataFiles;
+    QNetworkReply *m_reply;
+    QFile m_part;
+    qint64 m_offset;
+    bool m_statusChecked;
+    bool m_ignoreSslErrors;
+    bool m_running;
+    bool m_aborted;
+    QFutureWatcher< QList<Job> > m_planWatcher;
+    QFutureWatcher<QString> m_hashWatcher;
+
+    static QList<Job> planJobs(const UpdateInfo &info, const QString &dir);
+    static QString fileHash(const QString &filename);
+
+    void nextJob();
+    void startJob();
+    void fail(const QString &url);
+};
+
+/// @}
+
+} // namespace DAS
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_DAS_UPDATEDOWNLOADER_H
+
@@ -25,6 +25,7 @@
 #include <QString>
 #include <QDate>
 #include <QStringList>
+#include <QList>
 
 #include "da-server/updateversion.h"
 
@@ -46,11 +47,31 @@ namespace DAS
  *
  * The UpdateInfo class provides information such as update version, update severity, what's new,
  * download URL, date, etc..
+ *
+ * An update can also provide a binary delta from the current version, which is much smaller than
+ * the full package, and a list of content-addressed data files such as Freeling dictionaries.
  */
 class UpdateInfo
 {
 public:
 
+    /**
+     * \brief The DataFile struct provides information about a data file shipped with the update.
+     *
+     * Data files are content-addressed: \a hash is the SHA-1 of the file contents and it only
+     * changes if the file changes. \a path is relative to the application directory.
+     */
+    struct DataFile
+    {
+        DataFile(const QString &path = QString(), const QString &url = QString(),
+                 const QString &hash = QString())
+            : path(path), url(url), hash(hash) { }
+
+        QString path;
+        QString url;
+        QString hash;
+    };
+
     /**
      * Update severity
      */
@@ -122,6 +143,37 @@ public:
      */
     const QString & hash() const { return m_hash; }
 
+    /**
+     * Sets the URL of the binary delta from the current version to this update
+     */
+    void setDeltaUrl(const QString &url) { m_deltaUrl = url; }
+
+    /**
+     * Returns the URL of the binary delta from the current version or an empty string if the
+     * update does not provide one.
+     */
+    const QString & deltaUrl() const { return m_deltaUrl; }
+
+    /**
+     *
+     */
+    void setDeltaHash(const QString &hash) { m_deltaHash = hash; }
+
+    /**
+     *
+     */
+    const QString & deltaHash() const { return m_deltaHash; }
+
+    /**
+     *
+     */
+    void setDataFiles(const QList<DataFile> &files) { m_dataFiles = files; }
+
+    /**
+     *
+     */
+    const QList<DataFile> & dataFiles() const { return m_dataFiles; }
+
     /**
      *
      */
@@ -133,6 +185,9 @@ public:
         m_url.clear();
         m_date = QDate();
         m_hash.clear();
+        m_deltaUrl.clear();
+        m_deltaHash.clear();
+        m_dataFiles.clear();
     }
 
 private:
@@ -142,6 +197,9 @@ private:
     QString m_url;
     QDate m_date;
     QString m_hash;
+    QString m_deltaUrl;
+    QString m_deltaHash;
+    QList<DataFile> m_dataFiles;
 };
 
 /// @}
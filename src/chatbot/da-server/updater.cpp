@@ -21,39 +21,75 @@
 
 #include "da-server/updater.h"
 #include "da-server/rest.h"
+#include "da-server/updatedownloader.h"
 #include "common/version.h"
 #include "da-server/serverconfig.h"
 
 #include <QtDebug>
 #include <QDomDocument>
+#include <QDir>
+#include <QRegExp>
+#include <QtConcurrentRun>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Hashes name staged files, so anything but a SHA-1 hex digest is rejected
+inline bool isSha1Hex(const QString &hash)
+{
+    return QRegExp("[0-9a-fA-F]{40}").exactMatch(hash);
+}
+
+} // namespace
+
 
 //--------------------------------------------------------------------------------------------------
 // Updater
 //--------------------------------------------------------------------------------------------------
 
 Lvk::DAS::Updater::Updater()
-    : m_rest(new DAS::Rest()), m_curVersion(APP_VERSION_STR), m_verifySsl(true)
+    : m_rest(new DAS::Rest()), m_curVersion(APP_VERSION_STR), m_verifySsl(true), m_aborted(false),
+      m_downloader(new DAS::UpdateDownloader(this))
 {
-    connect(m_rest, SIGNAL(response(QString)), SLOT(onCfuResponse(QString)));
-    connect(m_rest, SIGNAL(error(QNetworkReply::NetworkError)),
-            SLOT(onCfuRerror(QNetworkReply::NetworkError)));
+    init();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-
 Lvk::DAS::Updater::Updater(DAS::Rest *rest)
-    : m_rest(rest), m_curVersion(APP_VERSION_STR), m_verifySsl(true)
+    : m_rest(rest), m_curVersion(APP_VERSION_STR), m_verifySsl(true), m_aborted(false),
+      m_downloader(new DAS::UpdateDownloader(this))
+{
+    init();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::Updater::init()
 {
     connect(m_rest, SIGNAL(response(QString)), SLOT(onCfuResponse(QString)));
     connect(m_rest, SIGNAL(error(QNetworkReply::NetworkError)),
             SLOT(onCfuRerror(QNetworkReply::NetworkError)));
+    connect(&m_watcher, SIGNAL(finished()), SLOT(onCfuProcessed()));
+
+    connect(m_downloader, SIGNAL(progress(qint64,qint64)),
+            SIGNAL(downloadProgress(qint64,qint64)));
+    connect(m_downloader, SIGNAL(finished(QString,QStringList)),
+            SIGNAL(downloaded(QString,QStringList)));
+    connect(m_downloader, SIGNAL(error(QString)), SIGNAL(downloadError(QString)));
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::DAS::Updater::~Updater()
 {
+    // The worker thread uses this object
+    m_watcher.waitForFinished();
+
     delete m_rest;
 }
 
@@ -63,6 +99,7 @@ void Lvk::DAS::Updater::checkForUpdate()
 {
     qDebug() << "Updater: Checking for updates...";
 
+    m_aborted = false;
     m_rest->request(UPDATER_REST_API_CFU);
 }
 
@@ -72,6 +109,8 @@ void Lvk::DAS::Updater::abort()
 {
     qDebug() << "Updater: CFU Aborted";
 
+    // A response being parsed is discarded
+    m_aborted = true;
     m_rest->abort();
 }
 
@@ -81,6 +120,21 @@ void Lvk::DAS::Updater::abort()
 void Lvk::DAS::Updater::setIgnoreSslErrors(bool ignore)
 {
     m_verifySsl = !ignore;
+    m_downloader->setIgnoreSslErrors(ignore);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::DAS::Updater::download(const DAS::UpdateInfo &info, const QString &dir)
+{
+    return m_downloader->download(info, dir);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::Updater::abortDownload()
+{
+    m_downloader->abort();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -89,20 +143,28 @@ void Lvk::DAS::Updater::onCfuResponse(const QString &resp)
 {
     qDebug() << "Updater: CFU response";
 
-    if (m_verifySsl && !verifyCertChain()) {
-        qCritical() << "Updater: Invalid certificate chain. Ignoring response.";
+    QList<QSslCertificate> chain;
+
+    if (m_verifySsl) {
+        chain = m_rest->peerCertificateChain();
+    }
+
+    m_watcher.setFuture(QtConcurrent::run(this, &Updater::processResponse, resp, chain));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::Updater::onCfuProcessed()
+{
+    if (m_aborted) {
         return;
     }
 
-    DAS::UpdateInfo info;
+    DAS::UpdateInfo info = m_watcher.result();
 
-    if (parseResponse(info, resp)) {
-        if (m_curVersion < info.version()) {
-            qDebug() << "Updater: Found new update!";
-            emit update(info);
-        } else {
-            emit noUpdate();
-        }
+    if (!info.version().isEmpty()) {
+        qDebug() << "Updater: Found new update!";
+        emit update(info);
     } else {
         emit noUpdate();
     }
@@ -110,6 +172,26 @@ void Lvk::DAS::Updater::onCfuResponse(const QString &resp)
 
 //--------------------------------------------------------------------------------------------------
 
+// Runs in a worker thread. Returns an empty info if there is no update.
+Lvk::DAS::UpdateInfo Lvk::DAS::Updater::processResponse(const QString &response,
+                                                       const QList<QSslCertificate> &chain)
+{
+    if (m_verifySsl && !Rest::verifyPeerCertChain(chain)) {
+        qCritical() << "Updater: Invalid certificate chain. Ignoring response.";
+        return DAS::UpdateInfo();
+    }
+
+    DAS::UpdateInfo info;
+
+    if (parseResponse(info, response) && m_curVersion < info.version()) {
+        return info;
+    }
+
+    return DAS::UpdateInfo();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::DAS::Updater::onCfuRerror(QNetworkReply::NetworkError err)
 {
     qDebug() << "Updater: CFU error" << err;
@@ -130,6 +212,8 @@ bool Lvk::DAS::Updater::parseResponse(Lvk::DAS::UpdateInfo &info, const QString
           <lastcritical>1.2</lastcritical>
           <url>http://lvklabs.com/builds/chatbot/chatbot-linux32-0.23.zip</url>
           <hash>ce286df1e54f176ca76a8020a1ae3b464223fc0f</hash>
+          <delta from="1.0" hash="0b1f...">http://lvklabs.com/builds/chatbot/1.0-1.1.delta</delta>
+          <data path="data/freeling/es/dicc.src" hash="8d3c...">http://lvklabs.com/8d3c...</data>
           <whatsnew>
             <li>Fixed bug 1</li>
             <li>Fixed bug 2</li>
@@ -192,6 +276,10 @@ bool Lvk::DAS::Updater::parseUpdateNode(Lvk::DAS::UpdateInfo &info, QDomNode &up
             parseWhatsNewNode(info, node);
         } else if (name == "hash") {
             info.setHash(value);
+        } else if (name == "delta") {
+            parseDeltaNode(info, node, value);
+        } else if (name == "data") {
+            parseDataNode(info, node, value);
         } else {
             qWarning() << "Updater: parseUpdateNode: Unknown node" << name;
         }
@@ -215,6 +303,50 @@ bool Lvk::DAS::Updater::parseLastCritical(DAS::UpdateInfo &info, const QString &
 
 //--------------------------------------------------------------------------------------------------
 
+bool Lvk::DAS::Updater::parseDeltaNode(DAS::UpdateInfo &info, QDomNode &deltaNode,
+                                       const QString &url)
+{
+    // Deltas are built between consecutive versions. Only the one from our version is useful.
+    QString strFrom = deltaNode.attributes().namedItem("from").nodeValue().trimmed();
+    QString hash = deltaNode.attributes().namedItem("hash").nodeValue().trimmed();
+
+    if (strFrom.isEmpty() || !isSha1Hex(hash) || url.isEmpty()) {
+        qWarning() << "Updater: parseDeltaNode: Invalid delta node";
+        return false;
+    }
+
+    if (DAS::UpdateVersion(strFrom) == m_curVersion) {
+        info.setDeltaUrl(url);
+        info.setDeltaHash(hash);
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::DAS::Updater::parseDataNode(DAS::UpdateInfo &info, QDomNode &dataNode,
+                                      const QString &url)
+{
+    QString path = dataNode.attributes().namedItem("path").nodeValue().trimmed();
+    QString hash = dataNode.attributes().namedItem("hash").nodeValue().trimmed();
+
+    // Paths must stay inside the application directory
+    if (path.isEmpty() || !isSha1Hex(hash) || url.isEmpty() || QDir::isAbsolutePath(path)
+            || QDir::cleanPath(path).startsWith("..")) {
+        qWarning() << "Updater: parseDataNode: Invalid data node" << path;
+        return false;
+    }
+
+    QList<DAS::UpdateInfo::DataFile> files = info.dataFiles();
+    files.append(DAS::UpdateInfo::DataFile(QDir::cleanPath(path), url, hash));
+    info.setDataFiles(files);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool Lvk::DAS::Updater::parseWhatsNewNode(Lvk::DAS::UpdateInfo &info, QDomNode &wnNode)
 {
     QStringList whatsNew;
@@ -247,43 +379,3 @@ bool Lvk::DAS::Updater::parseWhatsNewNode(Lvk::DAS::UpdateInfo &info, QDomNode &
 
     return true;
 }
-
-//--------------------------------------------------------------------------------------------------
-
-bool Lvk::DAS::Updater::verifyCertChain()
-{
-    // TODO duplicated code! Refactor!
-
-    bool valid = false;
-
-    QList<QSslCertificate> certChain = m_rest->peerCertificateChain();
-
-    try {
-        // TODO check if all this stuff is really necessary or just check the immediate
-        //      subject name
-
-        if (certChain.size() == 0) {
-            throw QString("Empty cert chain");
-        }
-
-        const QSslCertificate &cert = certChain[0];
-
-        if (!cert.isValid()) {
-            throw QString("Invalid peer's immediate cert");
-        }
-        if (cert.issuerInfo(QSslCertificate::CommonName) != CA2_CERT_ISSUER_NAME) {
-            throw QString("wrong issuer name: " + cert.issuerInfo(QSslCertificate::CommonName));
-        }
-        if (cert.subjectInfo(QSslCertificate::CommonName) != PEER_CERT_SUBJECT_NAME) {
-            throw QString("wrong subect name: " + cert.subjectInfo(QSslCertificate::CommonName));
-        }
-
-        valid = true;
-
-    } catch (const QString &err) {
-        qCritical() << "Updater: Invalid peer cert chain:" << err;
-    }
-
-    return valid;
-}
-
@@ -26,6 +26,7 @@
 
 #include <QObject>
 #include <QNetworkReply>
+#include <QFutureWatcher>
 
 class QDomNode;
 class UpdaterUnitTest;
@@ -40,6 +41,7 @@ namespace DAS
 {
 
 class Rest;
+class UpdateDownloader;
 
 /// \ingroup Lvk
 /// \addtogroup DAS
@@ -47,6 +49,9 @@ class Rest;
 
 /**
  * \brief The Updater class provides functionality related with application udpates
+ *
+ * Responses are verified and parsed in a worker thread, so checking for updates never blocks
+ * the main thread. Updates can be downloaded in background with download(). \see UpdateDownloader
  */
 class Updater : public QObject
 {
@@ -62,7 +67,7 @@ public:
     Updater();
 
     /**
-     * Destroys the object
+     * Destroys the object and waits for the response being parsed (if any)
      */
     ~Updater();
 
@@ -82,6 +87,18 @@ public:
      */
     void setIgnoreSslErrors(bool ignore);
 
+    /**
+     * Downloads the update \a info into the directory \a dir in background, resuming any
+     * previous partial download. Emits downloaded() once the update is downloaded and verified.
+     * Otherwise; emits downloadError(). Returns false if the download cannot be started.
+     */
+    bool download(const DAS::UpdateInfo &info, const QString &dir);
+
+    /**
+     * Aborts the download in progress (if any). It is resumed by the next call to download().
+     */
+    void abortDownload();
+
 signals:
 
     /**
@@ -94,9 +111,28 @@ signals:
      */
     void update(const DAS::UpdateInfo &info);
 
+    /**
+     * This signal is emitted to indicate the progress of the file being downloaded.
+     */
+    void downloadProgress(qint64 received, qint64 total);
+
+    /**
+     * This signal is emitted whenever download() was called and the update was downloaded and
+     * verified. \a package is the full package or the binary delta from the current version and
+     * \a dataFiles are the changed data files, named after their SHA-1 hash.
+     */
+    void downloaded(const QString &package, const QStringList &dataFiles);
+
+    /**
+     * This signal is emitted whenever download() was called and the file with URL \a url cannot
+     * be downloaded or verified.
+     */
+    void downloadError(const QString &url);
+
 private slots:
     void onCfuResponse(const QString &resp);
     void onCfuRerror(QNetworkReply::NetworkError err);
+    void onCfuProcessed();
 
 private:
     Updater(Rest *rest);
@@ -106,14 +142,19 @@ private:
     Rest *m_rest;
     UpdateVersion m_curVersion;
     bool m_verifySsl;
+    bool m_aborted;
+    QFutureWatcher<UpdateInfo> m_watcher;
+    UpdateDownloader *m_downloader;
 
-
-    bool verifyCertChain();
+    void init();
+    UpdateInfo processResponse(const QString &response, const QList<QSslCertificate> &chain);
     bool parseResponse(UpdateInfo &info, const QString &response);
     bool parseVersion(UpdateInfo &info, const QString &strVer);
     bool parseUpdateNode(UpdateInfo &info, QDomNode &updateElem);
     bool parseLastCritical(UpdateInfo &info, const QString &strVer);
     bool parseWhatsNewNode(UpdateInfo &info, QDomNode &wnNode);
+    bool parseDeltaNode(UpdateInfo &info, QDomNode &deltaNode, const QString &url);
+    bool parseDataNode(UpdateInfo &info, QDomNode &dataNode, const QString &url);
 };
 
 /// @}
@@ -21,10 +21,15 @@
 
 #include "da-server/userauth.h"
 #include "da-server/serverconfig.h"
-#include "crypto/keymanagerfactory.h"
+#include "crypto/keycache.h"
 #include "common/json.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
 
-#include <memory>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QStringList>
+#include <QtConcurrentRun>
 #include <QtDebug>
 
 
@@ -34,28 +39,100 @@
 #define KEY_ERR_MSG      "error_message"
 #define KEY_ERR_CODE     "error_code"
 
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Cached authentications are stored as a list with the form (email, username, uid, expiry) where
+// expiry is given in seconds since the epoch
+
+inline QString tokenKey(const QString &email)
+{
+    QByteArray hash = QCryptographicHash::hash(email.toLower().toUtf8(), QCryptographicHash::Md5);
+
+    return QString(SETTING_AUTH_TOKENS) + "/" + QString::fromLatin1(hash.toHex());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool loadToken(const QString &email, Lvk::DAS::UserAuth::AuthInfo &info)
+{
+    Lvk::Cmn::Settings settings(Lvk::Cmn::Settings::UserScope());
+    QStringList token = settings.value(tokenKey(email)).toStringList();
+
+    if (token.size() != 4 || QDateTime::currentDateTime().toTime_t() >= token[3].toUInt()) {
+        return false;
+    }
+
+    info = Lvk::DAS::UserAuth::AuthInfo(token[0], token[1], token[2]);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void saveToken(const QString &email, const Lvk::DAS::UserAuth::AuthInfo &info)
+{
+    int lifetime = Lvk::Cmn::SettingsSnapshot::current().intValue(SETTING_AUTH_TOKEN_LIFETIME);
+
+    if (lifetime <= 0) {
+        return;
+    }
+
+    uint expiry = QDateTime::currentDateTime().toTime_t() + lifetime;
+
+    Lvk::Cmn::Settings settings(Lvk::Cmn::Settings::UserScope());
+    settings.setValue(tokenKey(email), QStringList() << info.email << info.username << info.uid
+                                                     << QString::number(expiry));
+}
+
+} // namespace
+
 
 //--------------------------------------------------------------------------------------------------
 // UserAuth
 //--------------------------------------------------------------------------------------------------
 
 Lvk::DAS::UserAuth::UserAuth()
+    : m_aborted(false)
 {
     connect(&m_rest, SIGNAL(response(const QString &)), SLOT(onRestResponse(const QString&)));
 
     connect(&m_rest, SIGNAL(error(QNetworkReply::NetworkError)),
             SLOT(onRestError(QNetworkReply::NetworkError)));
+
+    connect(&m_watcher, SIGNAL(finished()), SLOT(onResponseProcessed()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::DAS::UserAuth::~UserAuth()
+{
+    m_watcher.waitForFinished();
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::DAS::UserAuth::authenticate(const QString &email)
 {
-    qDebug() << "UserAuth: Authenticating " << email << "...";
+    m_email = email;
+    m_aborted = false;
+
+    if (loadToken(email, m_cachedInfo)) {
+        qDebug() << "UserAuth: Using cached authentication for" << email;
+
+        // Notified asynchronously as if the server had replied
+        QMetaObject::invokeMethod(this, "onCachedAuth", Qt::QueuedConnection);
+        return;
+    }
 
-    std::auto_ptr<Crypto::KeyManager> keyMgr(Crypto::KeyManagerFactory().create());
+    qDebug() << "UserAuth: Authenticating " << email << "...";
 
-    QString passwd = QString::fromUtf8(keyMgr->getKey(Crypto::KeyManager::AuthServerRole));
+    QByteArray key = Crypto::KeyCache::cache()->getKey(Crypto::KeyManager::AuthServerRole);
+    QString passwd = QString::fromUtf8(key);
 
     if (passwd.size() > 0) {
         passwd.prepend("chatbot:");
@@ -75,107 +152,116 @@ void Lvk::DAS::UserAuth::abort()
 {
     qDebug() << "UserAuth: Manually aborted!";
 
+    // Cached authentications and responses being parsed are discarded
+    m_aborted = true;
     m_rest.abort();
 }
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::DAS::UserAuth::clearCache()
+{
+    Cmn::Settings(Cmn::Settings::UserScope()).remove(SETTING_AUTH_TOKENS);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UserAuth::onCachedAuth()
+{
+    if (!m_aborted) {
+        emit success(m_cachedInfo);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::DAS::UserAuth::onRestResponse(const QString &response)
 {
     qDebug() << "UserAuth: Got response: " << response;
 
-    if (!verifyCertChain()) {
-        emit error(SSLHandshakeError, tr("SSL handshake error. Please try later."));
+    m_watcher.setFuture(QtConcurrent::run(&UserAuth::processResponse, response,
+                                          m_rest.peerCertificateChain()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UserAuth::onResponseProcessed()
+{
+    if (m_aborted) {
         return;
     }
 
+    Result r = m_watcher.result();
+
+    if (r.code == 0) {
+        saveToken(m_email, r.info);
+        emit success(r.info);
+    } else {
+        emit error(r.code, r.msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::DAS::UserAuth::onRestError(QNetworkReply::NetworkError err)
+{
+    qDebug() << "UserAuth: Error " << err;
+    emit error(ConnectionError, tr("Cannot connect to the server. Please try later."));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Runs in a worker thread
+Lvk::DAS::UserAuth::Result Lvk::DAS::UserAuth::processResponse(const QString &response,
+                                                               const QList<QSslCertificate> &chain)
+{
+    Result r;
+
+    if (!Rest::verifyPeerCertChain(chain)) {
+        r.code = SSLHandshakeError;
+        r.msg = tr("SSL handshake error. Please try later.");
+        return r;
+    }
+
     Cmn::Json::Object jresp;
     if (Cmn::Json().parse(response, jresp)) {
         if (jresp.contains(KEY_USERNAME)) {
             qDebug() << "UserAuth: Parsed AuthOk msg ";
-            handleAuthOk(jresp);
+            handleAuthOk(jresp, r);
         } else if (jresp.contains(KEY_ERR_MSG)){
             qDebug() << "UserAuth: Parsed AuthError msg ";
-            handleAuthError(jresp);
+            handleAuthError(jresp, r);
         } else {
             qCritical() << "UserAuth: Unknown response!";
-            emit error(UnknownResponseError,
-                       tr("Unknown response from server. Please try later."));
+            r.code = UnknownResponseError;
+            r.msg = tr("Unknown response from server. Please try later.");
         }
     } else {
         qCritical() << "UserAuth: Invalid message format!";
-        emit error(InvalidResponseFormatError,
-                   tr("Unknown response from server. Please try later."));
+        r.code = InvalidResponseFormatError;
+        r.msg = tr("Unknown response from server. Please try later.");
     }
-}
-
-//--------------------------------------------------------------------------------------------------
 
-void Lvk::DAS::UserAuth::onRestError(QNetworkReply::NetworkError err)
-{
-    qDebug() << "UserAuth: Error " << err;
-    emit error(ConnectionError, tr("Cannot connect to the server. Please try later."));
+    return r;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::DAS::UserAuth::handleAuthOk(Cmn::Json::Object &jresp)
+void Lvk::DAS::UserAuth::handleAuthOk(Cmn::Json::Object &jresp, Result &r)
 {
     QString email = jresp[KEY_EMAIL].toString();
     QString username = jresp[KEY_USERNAME].toString();
     QString uid = jresp[KEY_UID].toString();
 
-    emit success(AuthInfo(email, username, uid));
+    r.info = AuthInfo(email, username, uid);
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::DAS::UserAuth::handleAuthError(Cmn::Json::Object &jresp)
+void Lvk::DAS::UserAuth::handleAuthError(Cmn::Json::Object &jresp, Result &r)
 {
-    QString msg = jresp[KEY_ERR_MSG].toString();
     int code = jresp[KEY_ERR_CODE].toInt();
 
-    int mappedCode = (code >= 1 && code <= 3) ? (1000 + code) : (UnknownSessionError + code);
-
-    emit error(mappedCode, msg);
-}
-
-//--------------------------------------------------------------------------------------------------
-
-bool Lvk::DAS::UserAuth::verifyCertChain()
-{
-    // TODO duplicated code! Refactor!
-
-    bool valid = false;
-
-    QList<QSslCertificate> certChain = m_rest.peerCertificateChain();
-
-    try {
-        // TODO check if all this stuff is really necessary or just check the immediate
-        //      subject name
-
-        if (certChain.size() == 0) {
-            throw QString("Empty cert chain");
-        }
-
-        const QSslCertificate &cert = certChain[0];
-
-        if (!cert.isValid()) {
-            throw QString("Invalid peer's immediate cert");
-        }
-        if (cert.issuerInfo(QSslCertificate::CommonName) != CA2_CERT_ISSUER_NAME) {
-            throw QString("wrong issuer name: " + cert.issuerInfo(QSslCertificate::CommonName));
-        }
-        if (cert.subjectInfo(QSslCertificate::CommonName) != PEER_CERT_SUBJECT_NAME) {
-            throw QString("wrong subect name: " + cert.subjectInfo(QSslCertificate::CommonName));
-        }
-
-        valid = true;
-
-    } catch (const QString &err) {
-        qCritical() << "UserAuth: Invalid peer cert chain:" << err;
-    }
-
-    return valid;
+    r.code = (code >= 1 && code <= 3) ? (1000 + code) : (UnknownSessionError + code);
+    r.msg = jresp[KEY_ERR_MSG].toString();
 }
-
@@ -24,6 +24,7 @@
 
 #include <QObject>
 #include <QString>
+#include <QFutureWatcher>
 
 #include "da-server/rest.h"
 #include "common/json.h"
@@ -45,6 +46,11 @@ namespace DAS
 
 /**
  * \brief The UserAuth class provides user authentification against the 'Dale Aceptar' server
+ *
+ * Successful authentications are cached in the user settings for SETTING_AUTH_TOKEN_LIFETIME
+ * seconds, so authenticating the same user again within that time makes no requests.
+ * Responses are verified and parsed in a worker thread. In every case the result is notified
+ * asynchronously.
  */
 class UserAuth : public QObject
 {
@@ -89,6 +95,11 @@ public:
      */
     UserAuth();
 
+    /**
+     * Destroys the object and waits for the response being parsed (if any)
+     */
+    ~UserAuth();
+
     /**
      * Authenticates \a email. On success signal \a success() is emitted. Otherwise; signal
      * \a error() is emitted.
@@ -100,6 +111,11 @@ public:
      */
     void abort();
 
+    /**
+     * Removes the cached authentication of every user
+     */
+    static void clearCache();
+
 signals:
 
     /**
@@ -115,16 +131,31 @@ signals:
 private slots:
     void onRestResponse(const QString &response);
     void onRestError(QNetworkReply::NetworkError err);
+    void onResponseProcessed();
+    void onCachedAuth();
 
 private:
     UserAuth(const UserAuth&);
     UserAuth & operator=(const UserAuth&);
 
-    Rest m_rest;
+    struct Result
+    {
+        Result() : code(0) { }
 
-    bool verifyCertChain();
-    void handleAuthOk(Cmn::Json::Object &jresp);
-    void handleAuthError(Cmn::Json::Object &jresp);
+        int code;           ///< Error code or 0 on success
+        QString msg;        ///< Error message
+        AuthInfo info;      ///< Authentication information on success
+    };
+
+    Rest m_rest;
+    QString m_email;
+    AuthInfo m_cachedInfo;
+    bool m_aborted;
+    QFutureWatcher<Result> m_watcher;
+
+    static Result processResponse(const QString &response, const QList<QSslCertificate> &chain);
+    static void handleAuthOk(Cmn::Json::Object &jresp, Result &r);
+    static void handleAuthError(Cmn::Json::Object &jresp, Result &r);
 };
 
 /// @}
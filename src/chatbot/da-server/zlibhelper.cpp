@@ -21,105 +21,63 @@
 
 #include "zlibhelper.h"
 
-#include <stdio.h>
-#include <string.h>
-#include <assert.h>
-#include "zlib.h"
-
-#if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(__CYGWIN__)
-#  include <fcntl.h>
-#  include <io.h>
-#  define SET_BINARY_MODE(file) setmode(fileno(file), O_BINARY)
-#else
-#  define SET_BINARY_MODE(file)
-#endif
-
-#define CHUNK 16384
-
 //--------------------------------------------------------------------------------------------------
-// Helpers
+// ZLibHelper
 //--------------------------------------------------------------------------------------------------
 
-namespace
-{
-
-int zlib_deflate(const char *source, long ssize, char *dest, long *dsize, int level)
+Lvk::DAS::ZLibHelper::ZLibHelper(int level)
 {
-    int ret, flush;
-    z_stream strm;
-
-    /* allocate deflate state */
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    ret = deflateInit(&strm, level);
-    if (ret != Z_OK)
-        return ret;
-
-    /* compress until end of buffer */
-    do {
-        strm.next_in = (Bytef *)source;
-
-        if (ssize > CHUNK) {
-            strm.avail_in = CHUNK;
-            ssize -= CHUNK;
-            source += CHUNK;
-            flush = Z_NO_FLUSH;
-        } else {
-            strm.avail_in = ssize;
-            ssize = 0;
-            flush = Z_FINISH;
-        }
-
-        /* run deflate() on input until output buffer not full, finish
-           compression if all of source has been read in */
-        do {
-            strm.avail_out = CHUNK;
-            strm.next_out = (Bytef *)dest;
-            ret = deflate(&strm, flush);    /* no bad return value */
-            dest += (CHUNK - strm.avail_out);
-        } while (strm.avail_out == 0);
-
-        assert(strm.avail_in == 0);     /* all input will be used */
-
-        /* done when last data in file processed */
-    } while (flush != Z_FINISH);
-
-    assert(ret == Z_STREAM_END);        /* stream will be complete */
-
-    *dsize = strm.total_out;
-
-    /* clean up and return */
-    (void)deflateEnd(&strm);
-    return Z_OK;
-}
+    m_strm.zalloc = Z_NULL;
+    m_strm.zfree = Z_NULL;
+    m_strm.opaque = Z_NULL;
 
+    m_init = deflateInit(&m_strm, level);
 }
 
-//--------------------------------------------------------------------------------------------------
-// ZLibHelper
 //--------------------------------------------------------------------------------------------------
 
-Lvk::DAS::ZLibHelper::ZLibHelper()
+Lvk::DAS::ZLibHelper::~ZLibHelper()
 {
+    if (m_init == Z_OK) {
+        deflateEnd(&m_strm);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-int Lvk::DAS::ZLibHelper::deflate(const QByteArray &in, QByteArray &out)
+int Lvk::DAS::ZLibHelper::compress(const char *source, int size, QByteArray &dest)
 {
-    char *dest = new char[in.size()*2];
-    long dsize = in.size()*2;
+    if (m_init != Z_OK) {
+        return m_init;
+    }
+
+    // Keeps the allocated state, only the counters are reset
+    deflateReset(&m_strm);
+
+    // Only one call to deflate() is required if the output buffer is big enough
+    uLong bound = deflateBound(&m_strm, size);
+    dest.resize(bound);
 
-    int ret = zlib_deflate(in.data(), in.size(), dest, &dsize, Z_DEFAULT_COMPRESSION);
-    if (ret == Z_OK) {
-        out = QByteArray(dest, dsize);
+    m_strm.next_in = (Bytef *)source;
+    m_strm.avail_in = size;
+    m_strm.next_out = (Bytef *)dest.data();
+    m_strm.avail_out = bound;
+
+    int ret = ::deflate(&m_strm, Z_FINISH);
+
+    if (ret != Z_STREAM_END) {
+        dest.clear();
+        return ret == Z_OK ? Z_BUF_ERROR : ret;
     }
 
-    delete[] dest;
+    dest.resize(m_strm.total_out);
 
-    return ret;
+    return Z_OK;
 }
 
+//--------------------------------------------------------------------------------------------------
 
-
+int Lvk::DAS::ZLibHelper::deflate(const QByteArray &in, QByteArray &out)
+{
+    return ZLibHelper().compress(in.constData(), in.size(), out);
+}
@@ -41,10 +41,32 @@ namespace DAS
 /**
  * \brief The ZLibHelper class provides a wrapper to the Zlib library to compress
  *        data easily
+ *
+ * A ZLibHelper object keeps its deflate stream between calls to compress(), so compressing
+ * many small buffers does not pay the stream setup each time. ZLibHelper objects are not
+ * thread-safe.
  */
 class ZLibHelper
 {
 public:
+
+    /**
+     * Constructs a ZLibHelper with compression level \a level.
+     */
+    ZLibHelper(int level = Z_DEFAULT_COMPRESSION);
+
+    /**
+     * Destroys the object.
+     */
+    ~ZLibHelper();
+
+    /**
+     * Compress (deflates) \a size bytes from \a source and stores the result in \a dest.
+     * Returns Z_OK on success, Z_MEM_ERROR if memory could not be allocated for processing or
+     * Z_STREAM_ERROR if an invalid compression level was supplied.
+     */
+    int compress(const char *source, int size, QByteArray &dest);
+
     /**
      * Compress (deflates) \a source and stores the result in \a dest.
      * Returns Z_OK on success, Z_MEM_ERROR if memory could not be allocated for processing,
@@ -55,7 +77,11 @@ public:
     static int deflate(const QByteArray &source, QByteArray &dest);
 
 private:
-    ZLibHelper();
+    ZLibHelper(ZLibHelper&);
+    ZLibHelper& operator=(ZLibHelper&);
+
+    z_stream m_strm;
+    int m_init;         // Result of deflateInit()
 };
 
 /// @}
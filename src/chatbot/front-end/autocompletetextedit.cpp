@@ -20,8 +20,10 @@
  */
 
 #include "front-end/autocompletetextedit.h"
+#include "common/textsearch.h"
 
 #include <QListWidget>
+#include <QSet>
 #include <QListWidgetItem>
 #include <QKeyEvent>
 #include <QStringList>
@@ -29,6 +31,11 @@
 #include <QVBoxLayout>
 #include <QDebug>
 
+#include <algorithm>
+#include <climits>
+
+#define MAX_COMPLETIONS     100
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -76,6 +83,13 @@ int rfind(const QString &token, const QString &text, int from)
     return -1;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+inline bool isWordStart(const QString &str, int i)
+{
+    return str[i].isLetterOrNumber() && (i == 0 || !str[i - 1].isLetterOrNumber());
+}
+
 }  // namespace
 
 
@@ -196,6 +210,20 @@ void Lvk::FE::AutocompleteTextEdit::moveEvent(QMoveEvent *event)
 void Lvk::FE::AutocompleteTextEdit::setVocabulary(const QStringList &v)
 {
     m_vocab = v;
+    m_index.clear();
+
+    // Each string is indexed once per word, so the prefix of any word can be looked up
+    for (int i = 0; i < m_vocab.size(); ++i) {
+        QString folded = Cmn::TextSearch::fold(m_vocab[i]);
+
+        for (int j = 0; j < folded.size(); ++j) {
+            if (isWordStart(folded, j)) {
+                m_index.append(qMakePair(folded.mid(j), i));
+            }
+        }
+    }
+
+    std::sort(m_index.begin(), m_index.end());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -235,16 +263,13 @@ void Lvk::FE::AutocompleteTextEdit::onTargetTextEdited(QString)
     } else {
         QString current = m_current.trimmed();
 
-        //if (current.size() > 0) {
-            foreach (const QString &str, m_vocab) {
-                if (str.contains(current, Qt::CaseInsensitive)) {
-                    m_listWidget->addItem(str);
-                }
-                if (m_listWidget->count() == 1) {
-                    m_listWidget->setCurrentRow(0);
-                }
-            }
-        //}
+        foreach (int i, completions(current, MAX_COMPLETIONS)) {
+            m_listWidget->addItem(m_vocab[i]);
+        }
+
+        if (m_listWidget->count() > 0) {
+            m_listWidget->setCurrentRow(0);
+        }
 
 
         if (m_listWidget->count() > 0) {
@@ -330,6 +355,32 @@ void Lvk::FE::AutocompleteTextEdit::updateTextParts()
     //              << std::endl;
 }
 
+//--------------------------------------------------------------------------------------------------
 
+QList<int> Lvk::FE::AutocompleteTextEdit::completions(const QString &prefix, int max) const
+{
+    QList<int> indexes;
 
+    // Without prefix, suggest the first strings of the vocabulary
+    if (prefix.isEmpty()) {
+        for (int i = 0; i < m_vocab.size() && i < max; ++i) {
+            indexes.append(i);
+        }
+        return indexes;
+    }
+
+    QString key = Cmn::TextSearch::fold(prefix);
+    QSet<int> added;
 
+    QVector< QPair<QString, int> >::const_iterator it =
+            std::lower_bound(m_index.constBegin(), m_index.constEnd(), qMakePair(key, INT_MIN));
+
+    for (; it != m_index.constEnd() && it->first.startsWith(key) && indexes.size() < max; ++it) {
+        if (!added.contains(it->second)) {
+            added.insert(it->second);
+            indexes.append(it->second);
+        }
+    }
+
+    return indexes;
+}
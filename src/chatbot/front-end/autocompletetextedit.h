@@ -24,6 +24,8 @@
 
 #include <QLineEdit>
 #include <QStringList>
+#include <QVector>
+#include <QPair>
 
 class QListWidget;
 class QFrame;
@@ -49,6 +51,9 @@ namespace FE
  * vocabulary you must invoke setVocabulary(). The autocomplete mechanism is no limited to
  * colloquial words, can be any kind of strings. In that case, consider changing the word delimiter
  * with setDelimiter()
+ *
+ * Suggestions are the vocabulary strings with a word that starts with the text being edited,
+ * ignoring case and diacritics.
  */
 class AutocompleteTextEdit : public QLineEdit
 {
@@ -62,7 +67,8 @@ public:
     explicit AutocompleteTextEdit(QWidget *parent = 0);
 
     /**
-     * Sets the list of words used to autocomplete text
+     * Sets the list of words used to autocomplete text. The list is indexed once, so each
+     * lookup only depends on the length of the text and the number of suggestions.
      */
     void setVocabulary(const QStringList &v);
 
@@ -99,6 +105,7 @@ protected:
 private:
     QString m_delimiter;
     QStringList m_vocab;
+    QVector< QPair<QString, int> > m_index; // Sorted folded word suffixes and vocabulary index
     QFrame *m_container;
     QListWidget *m_listWidget;
     QString m_head;
@@ -108,6 +115,7 @@ private:
     void initContainer();
     void updateContainerGeometry();
     void updateTextParts();
+    QList<int> completions(const QString &prefix, int max) const;
 
 private slots:
     void onTargetTextEdited(QString);
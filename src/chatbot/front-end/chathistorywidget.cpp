@@ -20,94 +20,20 @@
  */
 
 #include "front-end/chathistorywidget.h"
+#include "front-end/datecontacttablemodel.h"
+#include "front-end/conversationtablemodel.h"
+#include "front-end/keyfilterproxymodel.h"
 #include "common/globalstrings.h"
 #include "ui_chathistorywidget.h"
 
-#include <QIcon>
 #include <QMessageBox>
 #include <QMenu>
+#include <QTimer>
 
-#define DATE_FORMAT     "dd/MM/yy"
-#define TIME_FORMAT     "hh:mm:ss"
+typedef Lvk::FE::DateContactTableModel DateContactModel;
+typedef Lvk::FE::ConversationTableModel ConversationModel;
 
-#define MATCH_ICON      ":/icons/match.png"
-#define NO_MATCH_ICON   ":/icons/no_match.png"
-#define FB_ICON         ":/icons/facebook.png"
-#define GMAIL_ICON      ":/icons/gmail.png"
-#define LOCAL_TEST_ICON ":/icons/app_icon"
-
-
-enum DateContactTableColumns
-{
-    DateColumnn,
-    UsernameColumn,
-    DateContactTableTotalColumns
-};
-
-enum ConversationTableColumns
-{
-    StatusColumn,
-    TimeColumnn,
-    MessageColumn,
-    ResponseColumn,
-    ConversationTableTotalColumns
-};
-
-enum
-{
-    HashKeyRole = Qt::UserRole,
-    EntryMatchRole,
-    EntryFromRole,
-    EntryRuleIdRole
-};
-
-
-//--------------------------------------------------------------------------------------------------
-// Helpers
-//--------------------------------------------------------------------------------------------------
-
-namespace
-{
-
-// builds a hash key with the given data
-QString hashKey(const QString &date, const QString &from)
-{
-    return date + from;
-}
-
-// builds a hash key with the given data
-QString hashKey(const Lvk::Cmn::Conversation::Entry &entry)
-{
-    return hashKey(entry.dateTime.toString(DATE_FORMAT), entry.from);
-}
-
-// gets username from strings with format "FullName <Username>" or "Username"
-QString getUsername(const QString &from)
-{
-    QString username;
-
-    if (from.contains(USERNAME_START_TOKEN)) {
-         username = from.split(USERNAME_START_TOKEN).at(1).trimmed();
-         username.remove(USERNAME_END_TOKEN);
-    } else {
-        username = from;
-    }
-    return username;
-}
-
-// gets fullname from strings with format "FullName <Username>" or "Username"
-QString getFullname(const QString &from)
-{
-    QString fullname;
-
-    if (from.contains(USERNAME_START_TOKEN)) {
-         fullname = from.split(USERNAME_START_TOKEN).at(0).trimmed();
-    }
-
-    return fullname;
-}
-
-} // namespace
+#define FILTER_DELAY    250    // Milliseconds without typing before the filter is applied
 
 
 //--------------------------------------------------------------------------------------------------
@@ -115,12 +41,12 @@ QString getFullname(const QString &from)
 //--------------------------------------------------------------------------------------------------
 
 Lvk::FE::ChatHistoryWidget::ChatHistoryWidget(QWidget *parent)
-    : QWidget(parent), ui(new Ui::ChatHistoryWidget)
+    : QWidget(parent), ui(new Ui::ChatHistoryWidget), m_filtered(false)
 {
     ui->setupUi(this);
 
-    clear();
     setupTables();
+    clear();
     setupMenus();
     connectSignals();
 }
@@ -128,12 +54,12 @@ Lvk::FE::ChatHistoryWidget::ChatHistoryWidget(QWidget *parent)
 //--------------------------------------------------------------------------------------------------
 
 Lvk::FE::ChatHistoryWidget::ChatHistoryWidget(const Lvk::Cmn::Conversation &conv, QWidget *parent)
-    : QWidget(parent), ui(new Ui::ChatHistoryWidget)
+    : QWidget(parent), ui(new Ui::ChatHistoryWidget), m_filtered(false)
 {
     ui->setupUi(this);
 
-    clear();
     setupTables();
+    clear();
     setupMenus();
     connectSignals();
     setConversation(conv);
@@ -148,43 +74,52 @@ Lvk::FE::ChatHistoryWidget::~ChatHistoryWidget()
 
 //--------------------------------------------------------------------------------------------------
 
+// Views display the models through sort proxies. Rows of the views must be mapped to rows of
+// the models with dateContactRow() and conversationEntry().
 void Lvk::FE::ChatHistoryWidget::setupTables()
 {
+    m_dateContactModel = new DateContactModel(this);
+    m_conversationModel = new ConversationModel(this);
+
+    m_dateContactProxy = new KeyFilterProxyModel(DateContactModel::IdRole, this);
+    m_dateContactProxy->setSourceModel(m_dateContactModel);
+    m_dateContactProxy->setSortRole(DateContactModel::SortRole);
+
+    m_conversationProxy = new KeyFilterProxyModel(ConversationModel::PositionRole, this);
+    m_conversationProxy->setSourceModel(m_conversationModel);
+    m_conversationProxy->setSortRole(ConversationModel::SortRole);
+
+    m_filterTimer = new QTimer(this);
+    m_filterTimer->setSingleShot(true);
+    m_filterTimer->setInterval(FILTER_DELAY);
+
     ui->splitter->setSizes(QList<int>() << (width()*1/3) << (width()*2/3));
 
     // Date-Contact table
-    ui->dateContactTable->setRowCount(0);
-    ui->dateContactTable->setColumnCount(DateContactTableTotalColumns);
+    ui->dateContactTable->setModel(m_dateContactProxy);
     ui->dateContactTable->setSortingEnabled(true);
+    ui->dateContactTable->sortByColumn(-1, Qt::AscendingOrder);
     ui->dateContactTable->setSelectionMode(QAbstractItemView::SingleSelection);
     ui->dateContactTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     ui->dateContactTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
     ui->dateContactTable->setAlternatingRowColors(true);
     ui->dateContactTable->horizontalHeader()->setStretchLastSection(true);
     ui->dateContactTable->verticalHeader()->hide();
-    ui->dateContactTable->setColumnWidth(DateColumnn, 70);
-    ui->dateContactTable->setHorizontalHeaderLabels(QStringList()
-                                                    << tr("Date")
-                                                    << tr("Username"));
+    ui->dateContactTable->setColumnWidth(DateContactModel::DateColumn, 70);
 
     // Conversation table
-    ui->conversationTable->setRowCount(0);
-    ui->conversationTable->setColumnCount(ConversationTableTotalColumns);
+    ui->conversationTable->setModel(m_conversationProxy);
     ui->conversationTable->setSortingEnabled(true);
+    ui->conversationTable->sortByColumn(-1, Qt::AscendingOrder);
     ui->conversationTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    ui->conversationTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    ui->conversationTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
     ui->conversationTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     ui->conversationTable->setAlternatingRowColors(true);
     ui->conversationTable->horizontalHeader()->setStretchLastSection(true);
     ui->conversationTable->verticalHeader()->hide();
-    ui->conversationTable->setColumnWidth(TimeColumnn, 70);
-    ui->conversationTable->setColumnWidth(StatusColumn, 22);
-    ui->conversationTable->setColumnWidth(MessageColumn, 170);
-    ui->conversationTable->setHorizontalHeaderLabels(QStringList()
-                                                     << tr("")
-                                                     << tr("Time")
-                                                     << tr("Message")
-                                                     << tr("Response"));
+    ui->conversationTable->setColumnWidth(ConversationModel::TimeColumn, 70);
+    ui->conversationTable->setColumnWidth(ConversationModel::StatusColumn, 22);
+    ui->conversationTable->setColumnWidth(ConversationModel::MessageColumn, 170);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -195,6 +130,11 @@ void Lvk::FE::ChatHistoryWidget::setupMenus()
     menu->addAction(ui->removeSelAction);
     menu->addAction(ui->removeAllAction);
     ui->removeHistoryButton->setMenu(menu);
+
+    QMenu *teachMenu = new QMenu(this);
+    teachMenu->addAction(ui->teachSelAction);
+    teachMenu->addAction(ui->teachAllAction);
+    ui->teachRuleButton->setMenu(teachMenu);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -210,13 +150,15 @@ void Lvk::FE::ChatHistoryWidget::connectSignals()
             SLOT(onConversationRowChanged(QModelIndex,QModelIndex)));
 
     connect(ui->conversationTable,
-            SIGNAL(cellDoubleClicked(int,int)),
-            SLOT(onCellDoubleClicked(int,int)));
+            SIGNAL(doubleClicked(QModelIndex)),
+            SLOT(onConversationDoubleClicked(QModelIndex)));
 
     connect(ui->filter,
             SIGNAL(textChanged(QString)),
             SLOT(onFilterTextChanged(QString)));
 
+    connect(m_filterTimer, SIGNAL(timeout()), SLOT(onFilterTimeout()));
+
     // Toolbar signals
 
     connect(ui->teachRuleButton,     SIGNAL(clicked()),   SLOT(onTeachRuleClicked()));
@@ -224,6 +166,8 @@ void Lvk::FE::ChatHistoryWidget::connectSignals()
     connect(ui->removeHistoryButton, SIGNAL(clicked()),   SLOT(removeSelectedWithDialog()));
     connect(ui->removeAllAction,     SIGNAL(triggered()), SLOT(removeAllWithDialog()));
     connect(ui->removeSelAction,     SIGNAL(triggered()), SLOT(removeSelectedWithDialog()));
+    connect(ui->teachSelAction,      SIGNAL(triggered()), SLOT(teachSelectedWithDialog()));
+    connect(ui->teachAllAction,      SIGNAL(triggered()), SLOT(teachAllWithDialog()));
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -238,17 +182,15 @@ void Lvk::FE::ChatHistoryWidget::clear()
 
 void Lvk::FE::ChatHistoryWidget::clearConversations()
 {
-    ui->dateContactTable->clearContents();
-    ui->dateContactTable->setRowCount(0);
-    ui->conversationTable->clearContents();
-    ui->conversationTable->setRowCount(0);
+    m_conversationModel->setEntries(0);
+    m_dateContactModel->clear();
+    m_index.clear();
+    m_hits.clear();
 
     ui->teachRuleButton->setEnabled(false);
     ui->showRuleButton->setEnabled(false);
     ui->removeHistoryButton->setEnabled(false);
     ui->filter->setEnabled(false);
-
-    m_entries.clear();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -260,33 +202,34 @@ void Lvk::FE::ChatHistoryWidget::addConversationEntry(const Lvk::Cmn::Conversati
         return;
     }
 
-    QString key = hashKey(entry);
-
-    if (!m_entries.contains(key)) {
-        m_entries[key] = EntryList();
+    int row = m_dateContactModel->findConversation(entry);
 
-        addDateContactTableRow(entry);
-
-        if (ui->dateContactTable->rowCount() == 1) {
-            ui->dateContactTable->selectRow(0);
-        }
+    if (row == -1) {
+        row = m_dateContactModel->addConversation(entry);
     }
 
-    m_entries[key].append(entry);
+    DateContactModel::EntryList *entries = m_dateContactModel->entries(row);
 
-    if (ui->dateContactTable->rowCount() == 1) {
-        addConversationTableRow(entry);
-    } else if (ui->dateContactTable->selectionModel()->hasSelection()) {
-        QModelIndex selectedIndex = ui->dateContactTable->selectionModel()->currentIndex();
-        const QString &selectedKey = selectedIndex.data(HashKeyRole).toString();
+    m_index.add(m_dateContactModel->conversationId(row), entries->size(), entry);
 
-        if (key == selectedKey) {
-            addConversationTableRow(entry);
-        }
+    // Only the displayed conversation notifies the view
+    if (m_conversationModel->entries() == entries) {
+        m_conversationModel->appendEntry(entry);
+    } else {
+        entries->append(entry);
+    }
+
+    if (m_dateContactModel->rowCount() == 1 && !m_conversationModel->entries()) {
+        ui->dateContactTable->selectRow(0);
     }
 
     ui->removeHistoryButton->setEnabled(true);
     ui->filter->setEnabled(true);
+
+    // The new entry may match the filter
+    if (m_filtered) {
+        m_filterTimer->start();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -294,32 +237,18 @@ void Lvk::FE::ChatHistoryWidget::addConversationEntry(const Lvk::Cmn::Conversati
 void Lvk::FE::ChatHistoryWidget::onDateContactRowChanged(const QModelIndex &current,
                                                          const QModelIndex &/*previous*/)
 {
-    ui->conversationTable->clearContents();
-    ui->conversationTable->setRowCount(0);
-
-    if (current.isValid()) {
-        int row = current.row();
-
-        // Fill table with new selected conversation
-
-        QTableWidgetItem *selectedItem = ui->dateContactTable->item(row, current.column());
-        QString key = selectedItem->data(HashKeyRole).toString();
-        const EntryList &entries = m_entries[key];
-
-        for (int i = 0; i < entries.size(); ++i) {
-           addConversationTableRow(entries[i]);
-        }
+    int row = dateContactRow(current);
 
-        // Filter table
+    m_conversationModel->setEntries(m_dateContactModel->entries(row));
 
-        if (ui->filter->text().size() > 0) {
-            filter(ui->filter->text());
-        }
+    filterConversation();
 
+    if (row != -1) {
         // Update removeSelAction displayed text
 
-        QString date = ui->dateContactTable->item(row, DateColumnn)->text();
-        QString user = ui->dateContactTable->item(row, UsernameColumn)->text();
+        QString date = m_dateContactModel->index(row, DateContactModel::DateColumn).data()
+                .toString();
+        QString user = m_dateContactModel->displayName(row);
         QString actionTextFormat = tr("Remove conversation with %1 on %2");
         ui->removeSelAction->setText(actionTextFormat.arg(user, date));
     }
@@ -346,80 +275,49 @@ void Lvk::FE::ChatHistoryWidget::onConversationRowChanged(const QModelIndex &cur
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::FE::ChatHistoryWidget::addConversationTableRow(const Lvk::Cmn::Conversation::Entry &entry)
+void Lvk::FE::ChatHistoryWidget::setConversation(const Lvk::Cmn::Conversation &conv)
 {
-    QString time = entry.dateTime.toString(TIME_FORMAT);
-    QString matchStr = entry.match ? tr("Response found") : tr("Response not found");
-
-    int nextRow = ui->conversationTable->rowCount();
-    ui->conversationTable->insertRow(nextRow);
-    ui->conversationTable->setItem(nextRow, TimeColumnn,    new QTableWidgetItem(time));
-    ui->conversationTable->setItem(nextRow, MessageColumn,  new QTableWidgetItem(entry.msg));
-    ui->conversationTable->setItem(nextRow, ResponseColumn, new QTableWidgetItem(entry.response));
-    ui->conversationTable->setItem(nextRow, StatusColumn,   new QTableWidgetItem(""));
-
-    ui->conversationTable->item(nextRow, MessageColumn)->setData(Qt::ToolTipRole, entry.msg);
-    ui->conversationTable->item(nextRow, ResponseColumn)->setData(Qt::ToolTipRole, entry.response);
-    ui->conversationTable->item(nextRow, StatusColumn)->setData(Qt::ToolTipRole, matchStr);
-    ui->conversationTable->item(nextRow, StatusColumn)->setData(EntryMatchRole, entry.match);
-    ui->conversationTable->item(nextRow, StatusColumn)->setData(EntryRuleIdRole, entry.ruleId);
-
-    if (entry.match) {
-        ui->conversationTable->item(nextRow, StatusColumn)->setIcon(QIcon(MATCH_ICON));
-    } else {
-        ui->conversationTable->item(nextRow, StatusColumn)->setIcon(QIcon(NO_MATCH_ICON));
+    clear();
+
+    // Conversations are indexed in a single pass without notifying the views for each entry
+    DateContactModel::EntryList entries;
+
+    foreach (const Cmn::Conversation::Entry &entry, conv.entries()) {
+        if (!entry.from.startsWith(OWN_MESSAGE_TOKEN)) {
+            entries.append(entry);
+        }
     }
-}
 
-//--------------------------------------------------------------------------------------------------
+    m_dateContactModel->setEntries(entries);
 
-void Lvk::FE::ChatHistoryWidget::addDateContactTableRow(const Lvk::Cmn::Conversation::Entry &entry)
-{
-    QString date = entry.dateTime.toString(DATE_FORMAT);
-    QString username = getUsername(entry.from);
-    QString fullname = getFullname(entry.from);
+    for (int row = 0; row < m_dateContactModel->rowCount(); ++row) {
+        int convId = m_dateContactModel->conversationId(row);
+        const DateContactModel::EntryList *convEntries = m_dateContactModel->entries(row);
 
-    if (fullname.isEmpty()) {
-        fullname = username;
+        for (int i = 0; i < convEntries->size(); ++i) {
+            m_index.add(convId, i, convEntries->at(i));
+        }
     }
 
-    int nextRow = ui->dateContactTable->rowCount();
-    ui->dateContactTable->insertRow(nextRow);
-    ui->dateContactTable->setItem(nextRow, DateColumnn,    new QTableWidgetItem(date));
-    ui->dateContactTable->setItem(nextRow, UsernameColumn, new QTableWidgetItem(fullname));
-
-    ui->dateContactTable->item(nextRow, DateColumnn)->setData(HashKeyRole, hashKey(entry));
-    ui->dateContactTable->item(nextRow, UsernameColumn)->setData(HashKeyRole, hashKey(entry));
-    ui->dateContactTable->item(nextRow, UsernameColumn)->setData(EntryFromRole, entry.from);
-
-    if (username.contains("@gmail.com")) {
-        ui->dateContactTable->item(nextRow, UsernameColumn)->setIcon(QIcon(GMAIL_ICON));
-    } else if (username.contains("@chat.facebook.com")) {
-        ui->dateContactTable->item(nextRow, UsernameColumn)->setIcon(QIcon(FB_ICON));
-    } else if (username.contains(tr("(test)"))) {
-        ui->dateContactTable->item(nextRow, UsernameColumn)->setIcon(QIcon(LOCAL_TEST_ICON));
+    if (m_dateContactModel->rowCount() > 0) {
+        ui->dateContactTable->selectRow(0);
+        ui->removeHistoryButton->setEnabled(true);
+        ui->filter->setEnabled(true);
     }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::FE::ChatHistoryWidget::setConversation(const Lvk::Cmn::Conversation &conv)
+void Lvk::FE::ChatHistoryWidget::onConversationDoubleClicked(const QModelIndex &index)
 {
-    clear();
-
-    for (int i = 0; i < conv.entries().size(); ++i) {
-        addConversationEntry(conv.entries()[i]);
+    if (!index.isValid()) {
+        return;
     }
-}
 
-//--------------------------------------------------------------------------------------------------
-
-void Lvk::FE::ChatHistoryWidget::onCellDoubleClicked(int row, int /*col*/)
-{
-    if (!rowHasMatchStatus(row)) {
-        teachRuleWithDialog(row);
+    if (!rowHasMatchStatus(index.row())) {
+        teachRuleWithDialog(index.row());
     } else {
-        showRuleWithDialog(row);
+        showRuleWithDialog(index.row());
     }
 }
 
@@ -427,6 +325,11 @@ void Lvk::FE::ChatHistoryWidget::onCellDoubleClicked(int row, int /*col*/)
 
 void Lvk::FE::ChatHistoryWidget::onTeachRuleClicked()
 {
+    if (ui->conversationTable->selectionModel()->selectedRows().size() > 1) {
+        teachSelectedWithDialog();
+        return;
+    }
+
     QModelIndex selectedIndex = ui->conversationTable->selectionModel()->currentIndex();
 
     if (selectedIndex.isValid()) {
@@ -449,14 +352,27 @@ void Lvk::FE::ChatHistoryWidget::onShowRuleClicked()
 
 void Lvk::FE::ChatHistoryWidget::onFilterTextChanged(const QString &text)
 {
-    filter(text);
+    // Wait until the user stops typing, except if the filter was cleared
+    if (text.trimmed().isEmpty()) {
+        m_filterTimer->stop();
+        filter(text);
+    } else {
+        m_filterTimer->start();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::ChatHistoryWidget::onFilterTimeout()
+{
+    filter(ui->filter->text());
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::FE::ChatHistoryWidget::teachRuleWithDialog(int row)
 {
-    QString chatMsg = ui->conversationTable->item(row, MessageColumn)->text();
+    QString chatMsg = conversationEntry(row).msg;
 
     QString title = tr("Teach rule");
     QString text = QString(tr("Teach new rule for message: \"%1\" ?")).arg(chatMsg);
@@ -468,16 +384,84 @@ void Lvk::FE::ChatHistoryWidget::teachRuleWithDialog(int row)
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::ChatHistoryWidget::teachSelectedWithDialog()
+{
+    QStringList inputs;
+
+    foreach (const QModelIndex &index, ui->conversationTable->selectionModel()->selectedRows()) {
+        const Cmn::Conversation::Entry &entry = conversationEntry(index.row());
+        if (!entry.match) {
+            inputs.append(entry.msg);
+        }
+    }
+
+    teachRulesWithDialog(inputs);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Teaches the unmatched messages of all conversations that pass the current filter
+void Lvk::FE::ChatHistoryWidget::teachAllWithDialog()
+{
+    QStringList inputs;
+
+    for (int i = 0; i < m_dateContactProxy->rowCount(); ++i) {
+        int row = dateContactRow(m_dateContactProxy->index(i, 0));
+        int convId = m_dateContactModel->conversationId(row);
+        const DateContactModel::EntryList *entries = m_dateContactModel->entries(row);
+
+        for (int pos = 0; pos < entries->size(); ++pos) {
+            const Cmn::Conversation::Entry &entry = entries->at(pos);
+            if (!entry.match && (!m_filtered || m_hits.value(convId).contains(pos))) {
+                inputs.append(entry.msg);
+            }
+        }
+    }
+
+    teachRulesWithDialog(inputs);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::ChatHistoryWidget::teachRulesWithDialog(const QStringList &inputs)
+{
+    QString title = tr("Teach rules");
+
+    QStringList uniqueInputs;
+    QSet<QString> seen;
+
+    foreach (const QString &input, inputs) {
+        QString trimmed = input.trimmed();
+        if (!trimmed.isEmpty() && !seen.contains(trimmed)) {
+            seen.insert(trimmed);
+            uniqueInputs.append(trimmed);
+        }
+    }
+
+    if (uniqueInputs.isEmpty()) {
+        QMessageBox::information(this, title, tr("There are no unmatched messages to teach."));
+        return;
+    }
+
+    QString text = QString(tr("Teach new rules for %1 unmatched messages?"))
+            .arg(uniqueInputs.size());
+
+    if (askConfirmation(title, text)) {
+        emit teachRules(uniqueInputs);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::ChatHistoryWidget::showRuleWithDialog(int row)
 {
-    //QString chatMsg = ui->conversationTable->item(row, MessageColumn)->text();
+    //QString chatMsg = conversationEntry(row).msg;
 
     //QString title = tr("Show rule definition");
     //QString text = QString(tr("Show rule definition for message: \"%1\" ?")).arg(chatMsg);
 
     //if (askConfirmation(title, text)) {
-        quint64 ruleId = ui->conversationTable->item(row, StatusColumn)->data(EntryRuleIdRole)
-                .toULongLong();
+        quint64 ruleId = conversationEntry(row).ruleId;
 
         emit showRule(ruleId);
     //}
@@ -502,22 +486,24 @@ void Lvk::FE::ChatHistoryWidget::removeSelectedWithDialog()
 {
     QModelIndex selectedIndex = ui->dateContactTable->selectionModel()->currentIndex();
 
-    if (!selectedIndex.isValid()) {
+    int row = dateContactRow(selectedIndex);
+
+    if (row == -1) {
         return;
     }
 
-    int row = selectedIndex.row();
-
-    QString date = ui->dateContactTable->item(row, DateColumnn)->text();
-    QString user = ui->dateContactTable->item(row, UsernameColumn)->text();
-    QString from = ui->dateContactTable->item(row, UsernameColumn)->data(EntryFromRole).toString();
+    QDate date = m_dateContactModel->date(row);
+    QString user = m_dateContactModel->displayName(row);
+    QString from = m_dateContactModel->from(row);
+    QString dateStr = m_dateContactModel->index(row, DateContactModel::DateColumn).data()
+            .toString();
 
     QString title = tr("Remove conversation");
     QString text  = tr("Are you sure you want to remove the conversation with %1 on %2?");
 
-    if (askConfirmation(title, text.arg(user, date))) {
+    if (askConfirmation(title, text.arg(user, dateStr))) {
         removeDateContactRow(row);
-        emit removed(QDate::fromString(date, DATE_FORMAT), from);
+        emit removed(date, from);
     }
 }
 
@@ -525,13 +511,17 @@ void Lvk::FE::ChatHistoryWidget::removeSelectedWithDialog()
 
 void Lvk::FE::ChatHistoryWidget::removeDateContactRow(int row)
 {
-    QString date = ui->dateContactTable->item(row, DateColumnn)->text();
-    QString from = ui->dateContactTable->item(row, UsernameColumn)->data(EntryFromRole).toString();
+    if (m_conversationModel->entries() == m_dateContactModel->entries(row)) {
+        m_conversationModel->setEntries(0);
+    }
+
+    int convId = m_dateContactModel->conversationId(row);
 
-    m_entries.remove(hashKey(date, from));
-    ui->dateContactTable->removeRow(row);
+    m_index.remove(convId);
+    m_hits.remove(convId);
+    m_dateContactModel->removeConversation(row);
 
-    if (ui->dateContactTable->rowCount() == 0) {
+    if (m_dateContactModel->rowCount() == 0) {
         ui->removeHistoryButton->setEnabled(false);
         ui->filter->setEnabled(false);
     }
@@ -543,22 +533,74 @@ void Lvk::FE::ChatHistoryWidget::removeDateContactRow(int row)
 
 void Lvk::FE::ChatHistoryWidget::filter(const QString &text)
 {
-    for (int i = 0; i < ui->conversationTable->rowCount(); ++i) {
-        bool match = false;
-        for (int j = 0; j < ui->conversationTable->columnCount() && !match; ++j) {
-            if (ui->conversationTable->item(i, j)->text().contains(text, Qt::CaseInsensitive)) {
-                match = true;
-            }
-        }
-        ui->conversationTable->setRowHidden(i, !match);
+    m_hits.clear();
+    m_filtered = !text.trimmed().isEmpty();
+
+    if (!m_filtered) {
+        m_dateContactProxy->acceptAll();
+        m_conversationProxy->acceptAll();
+        return;
+    }
+
+    m_hits = m_index.search(text);
+
+    filterConversation();
+    m_dateContactProxy->setAcceptedKeys(m_hits.keys().toSet());
+
+    // Jump to the first match if the current conversation or entry was filtered out
+
+    if (!ui->dateContactTable->selectionModel()->currentIndex().isValid()
+            && m_dateContactProxy->rowCount() > 0) {
+        ui->dateContactTable->selectRow(0);
+    }
+
+    QModelIndex current = ui->conversationTable->selectionModel()->currentIndex();
+
+    if (!current.isValid() && m_conversationProxy->rowCount() > 0) {
+        ui->conversationTable->selectRow(0);
+        current = ui->conversationTable->selectionModel()->currentIndex();
+    }
+
+    ui->conversationTable->scrollTo(current);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Displays only the matching entries of the current conversation
+void Lvk::FE::ChatHistoryWidget::filterConversation()
+{
+    if (!m_filtered) {
+        m_conversationProxy->acceptAll();
+        return;
     }
+
+    int row = dateContactRow(ui->dateContactTable->selectionModel()->currentIndex());
+
+    m_conversationProxy->setAcceptedKeys(m_hits.value(m_dateContactModel->conversationId(row)));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::ChatHistoryWidget::dateContactRow(const QModelIndex &viewIndex) const
+{
+    return viewIndex.isValid() ? m_dateContactProxy->mapToSource(viewIndex).row() : -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Cmn::Conversation::Entry &
+Lvk::FE::ChatHistoryWidget::conversationEntry(int viewRow) const
+{
+    QModelIndex index = m_conversationProxy->mapToSource(m_conversationProxy->index(viewRow, 0));
+
+    return m_conversationModel->entry(index.row());
 }
 
 //--------------------------------------------------------------------------------------------------
 
 bool Lvk::FE::ChatHistoryWidget::rowHasMatchStatus(int row)
 {
-    return ui->conversationTable->item(row, StatusColumn)->data(EntryMatchRole).toBool();
+    return conversationEntry(row).match;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -569,5 +611,3 @@ bool Lvk::FE::ChatHistoryWidget::askConfirmation(const QString &title, const QSt
 
     return btn == QMessageBox::Yes;
 }
-
-
@@ -27,14 +27,14 @@
 #include <QList>
 
 #include "common/conversation.h"
+#include "front-end/historysearchindex.h"
 
 namespace Ui {
     class ChatHistoryWidget;
 }
 
-class QTableWidget;
 class QModelIndex;
-class QSplitter;
+class QTimer;
 class TestMainWindow;
 
 namespace Lvk
@@ -46,6 +46,10 @@ namespace Lvk
 namespace FE
 {
 
+class DateContactTableModel;
+class ConversationTableModel;
+class KeyFilterProxyModel;
+
 /// \ingroup Lvk
 /// \addtogroup FE
 /// @{
@@ -56,6 +60,10 @@ namespace FE
  *
  * The ChatHistoryWidget is used in the "History" tab.
  *
+ * Conversations are displayed with DateContactTableModel and ConversationTableModel, so rows
+ * are only built as they are displayed and adding an entry does not relayout existing rows.
+ * The filter searches all conversations with a HistorySearchIndex.
+ *
  * \see Cmn::Conversation
  */
 class ChatHistoryWidget : public QWidget
@@ -110,6 +118,12 @@ signals:
      */
     void teachRule(const QString &input);
 
+    /**
+     * This signal is emitted if the user wants to teach new rules from history with rule
+     * inputs \a inputs
+     */
+    void teachRules(const QStringList &inputs);
+
     /**
      * This signal is emitted if the user wants to see the definition of a rule that has matched.
      */
@@ -130,29 +144,40 @@ private:
 
     Ui::ChatHistoryWidget *ui;
 
-    typedef QList<Lvk::Cmn::Conversation::Entry> EntryList;
-    QHash<QString, EntryList> m_entries;
+    DateContactTableModel *m_dateContactModel;
+    ConversationTableModel *m_conversationModel;
+    KeyFilterProxyModel *m_dateContactProxy;
+    KeyFilterProxyModel *m_conversationProxy;
+    HistorySearchIndex m_index;
+    HistorySearchIndex::Hits m_hits;
+    bool m_filtered;
+    QTimer *m_filterTimer;
 
     void setupTables();
     void setupMenus();
     void connectSignals();
 
-    void addConversationTableRow(const Lvk::Cmn::Conversation::Entry &entry);
-    void addDateContactTableRow(const Lvk::Cmn::Conversation::Entry &entry);
     void removeDateContactRow(int row);
     void filter(const QString &text);
+    void filterConversation();
+    int dateContactRow(const QModelIndex &viewIndex) const;
+    const Lvk::Cmn::Conversation::Entry &conversationEntry(int viewRow) const;
     bool rowHasMatchStatus(int row);
     bool askConfirmation(const QString &title, const QString &text);
+    void teachRulesWithDialog(const QStringList &inputs);
 
 private slots:
     void onDateContactRowChanged(const QModelIndex &current, const QModelIndex &previous);
     void onConversationRowChanged(const QModelIndex &current, const QModelIndex &previous);
-    void onCellDoubleClicked(int row, int col);
+    void onConversationDoubleClicked(const QModelIndex &index);
     void onFilterTextChanged(const QString &text);
+    void onFilterTimeout();
     void onTeachRuleClicked();
     void onShowRuleClicked();
 
     void teachRuleWithDialog(int row);
+    void teachSelectedWithDialog();
+    void teachAllWithDialog();
     void showRuleWithDialog(int row);
     void removeAllWithDialog();
     void removeSelectedWithDialog();
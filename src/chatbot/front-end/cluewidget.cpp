@@ -99,6 +99,19 @@ void Lvk::FE::ClueWidget::refresh()
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::ClueWidget::updateCoverage()
+{
+#ifdef DA_CONTEST
+    if (m_appFacade && !m_appFacade->currentCharacter().isEmpty()) {
+        Clue::AnalyzedList ascripts = ui->scripts->analyzedScripts();
+        Clue::LineIndexList changed = m_appFacade->updateAnalyzedScripts(ascripts);
+        ui->scripts->updateAnalyzedScripts(ascripts, changed);
+    }
+#endif // DA_CONTEST
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::ClueWidget::import()
 {
 #ifdef DA_CONTEST
@@ -76,6 +76,12 @@ public slots:
      */
     void refresh();
 
+    /**
+     * Updates the script coverage after changing rules. Unlike refresh(), scripts are not
+     * reloaded and only the lines affected by the changes are analyzed again.
+     */
+    void updateCoverage();
+
     /**
      * Opens a file dialog and imports the selected file
      */
@@ -63,6 +63,14 @@ void Lvk::FE::ConnectionWidget::setAppFacade(BE::AppFacade *appFacade)
         connect(m_appFacade, SIGNAL(connected()),               SLOT(onConnectionOk()));
         connect(m_appFacade, SIGNAL(disconnected()),            SLOT(onDisconnection()));
         connect(m_appFacade, SIGNAL(connectionError(int)),      SLOT(onConnectionError(int)));
+
+        // Roster updates while connected are applied incrementally
+        connect(m_appFacade, SIGNAL(rosterItemAdded(BE::RosterItem)),
+                ui->rosterWidget, SLOT(addRosterItem(BE::RosterItem)));
+        connect(m_appFacade, SIGNAL(rosterItemChanged(BE::RosterItem)),
+                ui->rosterWidget, SLOT(updateRosterItem(BE::RosterItem)));
+        connect(m_appFacade, SIGNAL(rosterItemRemoved(QString)),
+                ui->rosterWidget, SLOT(removeRosterItem(QString)));
     }
 
     ui->verifactionWidget->setAppFacade(appFacade);
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "front-end/conversationtablemodel.h"
+
+#define TIME_FORMAT     "hh:mm:ss"
+
+#define MATCH_ICON      ":/icons/match.png"
+#define NO_MATCH_ICON   ":/icons/no_match.png"
+
+
+//--------------------------------------------------------------------------------------------------
+// ConversationTableModel
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::ConversationTableModel::ConversationTableModel(QObject *parent)
+    : QAbstractTableModel(parent),
+      m_entries(0),
+      m_matchIcon(MATCH_ICON),
+      m_noMatchIcon(NO_MATCH_ICON)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::ConversationTableModel::~ConversationTableModel()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::ConversationTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() || !m_entries ? 0 : m_entries->size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::ConversationTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariant Lvk::FE::ConversationTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || !m_entries || index.row() >= m_entries->size()) {
+        return QVariant();
+    }
+
+    const Cmn::Conversation::Entry &entry = m_entries->at(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case TimeColumn:
+            return entry.dateTime.toString(TIME_FORMAT);
+        case MessageColumn:
+            return entry.msg;
+        case ResponseColumn:
+            return entry.response;
+        }
+        break;
+
+    case Qt::ToolTipRole:
+        switch (index.column()) {
+        case StatusColumn:
+            return entry.match ? tr("Response found") : tr("Response not found");
+        case MessageColumn:
+            return entry.msg;
+        case ResponseColumn:
+            return entry.response;
+        }
+        break;
+
+    case Qt::DecorationRole:
+        if (index.column() == StatusColumn) {
+            return entry.match ? m_matchIcon : m_noMatchIcon;
+        }
+        break;
+
+    case PositionRole:
+        return index.row();
+
+    case SortRole:
+        switch (index.column()) {
+        case StatusColumn:
+            return entry.match;
+        case TimeColumn:
+            return entry.dateTime;
+        case MessageColumn:
+            return entry.msg;
+        case ResponseColumn:
+            return entry.response;
+        }
+        break;
+    }
+
+    return QVariant();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariant Lvk::FE::ConversationTableModel::headerData(int section, Qt::Orientation orientation,
+                                                     int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+        case StatusColumn:
+            return QString();
+        case TimeColumn:
+            return tr("Time");
+        case MessageColumn:
+            return tr("Message");
+        case ResponseColumn:
+            return tr("Response");
+        }
+    }
+
+    return QVariant();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::ConversationTableModel::setEntries(EntryList *entries)
+{
+    beginResetModel();
+
+    m_entries = entries;
+
+    endResetModel();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::FE::ConversationTableModel::EntryList * Lvk::FE::ConversationTableModel::entries() const
+{
+    return m_entries;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::ConversationTableModel::appendEntry(const Cmn::Conversation::Entry &entry)
+{
+    if (!m_entries) {
+        return;
+    }
+
+    int row = m_entries->size();
+
+    beginInsertRows(QModelIndex(), row, row);
+
+    m_entries->append(entry);
+
+    endInsertRows();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Cmn::Conversation::Entry & Lvk::FE::ConversationTableModel::entry(int row) const
+{
+    return m_entries->at(row);
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_FE_CONVERSATIONTABLEMODEL_H
+#define LVK_FE_CONVERSATIONTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QList>
+#include <QIcon>
+
+#include "common/conversation.h"
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace FE
+{
+
+/// \ingroup Lvk
+/// \addtogroup FE
+/// @{
+
+/**
+ * \brief The ConversationTableModel class provides a table model to display the entries of a
+ *        single conversation.
+ *
+ * The model does not copy the entries, it displays the list set with setEntries(). Cells are
+ * built when the view requests them, so only visible rows are materialized.
+ *
+ * \see DateContactTableModel, ChatHistoryWidget
+ */
+class ConversationTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Table columns
+     */
+    enum Column
+    {
+        StatusColumn,
+        TimeColumn,
+        MessageColumn,
+        ResponseColumn,
+        ColumnCount
+    };
+
+    /**
+     * Custom roles
+     */
+    enum Role
+    {
+        SortRole = Qt::UserRole,    ///< Value used to sort rows
+        PositionRole                ///< Position of the entry in the conversation
+    };
+
+    typedef QList<Cmn::Conversation::Entry> EntryList;
+
+    /**
+     * Constructs an empty ConversationTableModel which is a child of \a parent.
+     */
+    ConversationTableModel(QObject *parent = 0);
+
+    /**
+     * Destroys the object.
+     */
+    ~ConversationTableModel();
+
+    /**
+     * Returns the number of entries.
+     */
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /**
+     * Returns the number of columns.
+     */
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /**
+     * Returns the data stored under the given \a role for the item referred to by the \a index.
+     */
+    virtual QVariant data(const QModelIndex &index, int role) const;
+
+    /**
+     * Returns the data for the given \a role and \a section in the header with the specified
+     * \a orientation.
+     */
+    virtual QVariant headerData(int section, Qt::Orientation orientation,
+                                int role = Qt::DisplayRole) const;
+
+    /**
+     * Sets the list of \a entries to display. The list must outlive the model or be unset
+     * before it is destroyed. If \a entries is null, the model is empty.
+     */
+    void setEntries(EntryList *entries);
+
+    /**
+     * Returns the list of entries displayed or null if there is none.
+     */
+    const EntryList *entries() const;
+
+    /**
+     * Appends \a entry to the displayed list. Existing rows are not updated.
+     */
+    void appendEntry(const Cmn::Conversation::Entry &entry);
+
+    /**
+     * Returns the entry in \a row.
+     */
+    const Cmn::Conversation::Entry &entry(int row) const;
+
+private:
+    ConversationTableModel(ConversationTableModel&);
+    ConversationTableModel& operator=(ConversationTableModel&);
+
+    EntryList *m_entries;
+    QIcon m_matchIcon;
+    QIcon m_noMatchIcon;
+};
+
+/// @}
+
+} // namespace FE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_FE_CONVERSATIONTABLEMODEL_H
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "front-end/datecontacttablemodel.h"
+#include "common/globalstrings.h"
+
+#define DATE_FORMAT     "dd/MM/yy"
+
+#define FB_ICON         ":/icons/facebook.png"
+#define GMAIL_ICON      ":/icons/gmail.png"
+#define LOCAL_TEST_ICON ":/icons/app_icon"
+
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// builds a hash key with the given data
+inline QString hashKey(const QDate &date, const QString &from)
+{
+    return date.toString(DATE_FORMAT) + from;
+}
+
+// gets username from strings with format "FullName <Username>" or "Username"
+QString getUsername(const QString &from)
+{
+    QString username;
+
+    if (from.contains(USERNAME_START_TOKEN)) {
+         username = from.split(USERNAME_START_TOKEN).at(1).trimmed();
+         username.remove(USERNAME_END_TOKEN);
+    } else {
+        username = from;
+    }
+    return username;
+}
+
+// gets fullname from strings with format "FullName <Username>" or "Username"
+QString getFullname(const QString &from)
+{
+    QString fullname;
+
+    if (from.contains(USERNAME_START_TOKEN)) {
+         fullname = from.split(USERNAME_START_TOKEN).at(0).trimmed();
+    }
+
+    return fullname;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// DateContactTableModel::Conversation
+//--------------------------------------------------------------------------------------------------
+
+// Display strings are computed once, when the conversation is created
+struct Lvk::FE::DateContactTableModel::Conversation
+{
+    int id;
+    QDate date;
+    QString dateString;
+    QString from;
+    QString username;
+    QString displayName;
+    EntryList entries;
+};
+
+//--------------------------------------------------------------------------------------------------
+// DateContactTableModel
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::DateContactTableModel::DateContactTableModel(QObject *parent)
+    : QAbstractTableModel(parent),
+      m_nextId(0),
+      m_gmailIcon(GMAIL_ICON),
+      m_fbIcon(FB_ICON),
+      m_testIcon(LOCAL_TEST_ICON)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::DateContactTableModel::~DateContactTableModel()
+{
+    qDeleteAll(m_rows);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::DateContactTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::DateContactTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariant Lvk::FE::DateContactTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+
+    const Conversation *conv = m_rows[index.row()];
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return index.column() == DateColumn ? conv->dateString : conv->displayName;
+
+    case SortRole:
+        if (index.column() == DateColumn) {
+            return conv->date;
+        }
+        return conv->displayName;
+
+    case IdRole:
+        return conv->id;
+
+    case Qt::DecorationRole:
+        if (index.column() == UsernameColumn) {
+            if (conv->username.contains("@gmail.com")) {
+                return m_gmailIcon;
+            } else if (conv->username.contains("@chat.facebook.com")) {
+                return m_fbIcon;
+            } else if (conv->username.contains(tr("(test)"))) {
+                return m_testIcon;
+            }
+        }
+        break;
+    }
+
+    return QVariant();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariant Lvk::FE::DateContactTableModel::headerData(int section, Qt::Orientation orientation,
+                                                    int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+        case DateColumn:
+            return tr("Date");
+        case UsernameColumn:
+            return tr("Username");
+        }
+    }
+
+    return QVariant();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::DateContactTableModel::setEntries(const EntryList &entries)
+{
+    beginResetModel();
+
+    qDeleteAll(m_rows);
+    m_rows.clear();
+    m_rowsByKey.clear();
+
+    foreach (const Cmn::Conversation::Entry &entry, entries) {
+        QString key = hashKey(entry.dateTime.date(), entry.from);
+        QHash<QString, int>::const_iterator it = m_rowsByKey.find(key);
+
+        int row;
+        if (it != m_rowsByKey.constEnd()) {
+            row = *it;
+        } else {
+            row = m_rows.size();
+            m_rows.append(newConversation(entry));
+            m_rowsByKey.insert(key, row);
+        }
+
+        m_rows[row]->entries.append(entry);
+    }
+
+    endResetModel();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::DateContactTableModel::findConversation(const Cmn::Conversation::Entry &entry) const
+{
+    return m_rowsByKey.value(hashKey(entry.dateTime.date(), entry.from), -1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::DateContactTableModel::addConversation(const Cmn::Conversation::Entry &entry)
+{
+    int row = m_rows.size();
+
+    beginInsertRows(QModelIndex(), row, row);
+
+    m_rows.append(newConversation(entry));
+    m_rowsByKey.insert(hashKey(entry.dateTime.date(), entry.from), row);
+
+    endInsertRows();
+
+    return row;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::DateContactTableModel::Conversation *
+Lvk::FE::DateContactTableModel::newConversation(const Cmn::Conversation::Entry &entry)
+{
+    Conversation *conv = new Conversation();
+    conv->id = m_nextId++;
+    conv->date = entry.dateTime.date();
+    conv->dateString = conv->date.toString(DATE_FORMAT);
+    conv->from = entry.from;
+    conv->username = getUsername(entry.from);
+    conv->displayName = getFullname(entry.from);
+
+    if (conv->displayName.isEmpty()) {
+        conv->displayName = conv->username;
+    }
+
+    return conv;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::FE::DateContactTableModel::conversationId(int row) const
+{
+    return row >= 0 && row < m_rows.size() ? m_rows[row]->id : -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::DateContactTableModel::EntryList * Lvk::FE::DateContactTableModel::entries(int row)
+{
+    return row >= 0 && row < m_rows.size() ? &m_rows[row]->entries : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QDate Lvk::FE::DateContactTableModel::date(int row) const
+{
+    return row >= 0 && row < m_rows.size() ? m_rows[row]->date : QDate();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::FE::DateContactTableModel::from(int row) const
+{
+    return row >= 0 && row < m_rows.size() ? m_rows[row]->from : QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::FE::DateContactTableModel::displayName(int row) const
+{
+    return row >= 0 && row < m_rows.size() ? m_rows[row]->displayName : QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::DateContactTableModel::removeConversation(int row)
+{
+    if (row < 0 || row >= m_rows.size()) {
+        return;
+    }
+
+    beginRemoveRows(QModelIndex(), row, row);
+
+    Conversation *conv = m_rows.takeAt(row);
+    m_rowsByKey.remove(hashKey(conv->date, conv->from));
+    delete conv;
+
+    // Rows after the removed one move up
+    for (QHash<QString, int>::iterator it = m_rowsByKey.begin(); it != m_rowsByKey.end(); ++it) {
+        if (*it > row) {
+            --(*it);
+        }
+    }
+
+    endRemoveRows();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::DateContactTableModel::clear()
+{
+    beginResetModel();
+
+    qDeleteAll(m_rows);
+    m_rows.clear();
+    m_rowsByKey.clear();
+
+    endResetModel();
+}
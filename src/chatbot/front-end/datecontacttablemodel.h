@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_FE_DATECONTACTTABLEMODEL_H
+#define LVK_FE_DATECONTACTTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QList>
+#include <QHash>
+#include <QIcon>
+
+#include "common/conversation.h"
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace FE
+{
+
+/// \ingroup Lvk
+/// \addtogroup FE
+/// @{
+
+/**
+ * \brief The DateContactTableModel class provides a table model with one row for each
+ *        conversation held with a contact on a given date.
+ *
+ * Each row keeps the entries of its conversation. Rows are indexed by date and contact, so
+ * adding an entry does not need to search or relayout the existing rows.
+ *
+ * \see ConversationTableModel, ChatHistoryWidget
+ */
+class DateContactTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Table columns
+     */
+    enum Column
+    {
+        DateColumn,
+        UsernameColumn,
+        ColumnCount
+    };
+
+    /**
+     * Custom roles
+     */
+    enum Role
+    {
+        SortRole = Qt::UserRole,    ///< Value used to sort rows
+        IdRole                      ///< Id of the conversation
+    };
+
+    typedef QList<Cmn::Conversation::Entry> EntryList;
+
+    /**
+     * Constructs an empty DateContactTableModel which is a child of \a parent.
+     */
+    DateContactTableModel(QObject *parent = 0);
+
+    /**
+     * Destroys the object.
+     */
+    ~DateContactTableModel();
+
+    /**
+     * Returns the number of conversations.
+     */
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /**
+     * Returns the number of columns.
+     */
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /**
+     * Returns the data stored under the given \a role for the item referred to by the \a index.
+     */
+    virtual QVariant data(const QModelIndex &index, int role) const;
+
+    /**
+     * Returns the data for the given \a role and \a section in the header with the specified
+     * \a orientation.
+     */
+    virtual QVariant headerData(int section, Qt::Orientation orientation,
+                                int role = Qt::DisplayRole) const;
+
+    /**
+     * Replaces all conversations with the conversations of \a entries.
+     */
+    void setEntries(const EntryList &entries);
+
+    /**
+     * Returns the row of the conversation of \a entry. If there is no such conversation,
+     * returns -1.
+     */
+    int findConversation(const Cmn::Conversation::Entry &entry) const;
+
+    /**
+     * Appends an empty conversation with the date and contact of \a entry and returns its row.
+     */
+    int addConversation(const Cmn::Conversation::Entry &entry);
+
+    /**
+     * Returns the id of the conversation in \a row. Ids are never reused, not even after
+     * the model is cleared. If \a row is not valid, returns -1.
+     */
+    int conversationId(int row) const;
+
+    /**
+     * Returns the entries of the conversation in \a row.
+     */
+    EntryList *entries(int row);
+
+    /**
+     * Returns the date of the conversation in \a row.
+     */
+    QDate date(int row) const;
+
+    /**
+     * Returns the contact of the conversation in \a row with format "FullName <Username>"
+     * or "Username".
+     */
+    QString from(int row) const;
+
+    /**
+     * Returns the name displayed for the contact of the conversation in \a row.
+     */
+    QString displayName(int row) const;
+
+    /**
+     * Removes the conversation in \a row.
+     */
+    void removeConversation(int row);
+
+    /**
+     * Removes all conversations.
+     */
+    void clear();
+
+private:
+    DateContactTableModel(DateContactTableModel&);
+    DateContactTableModel& operator=(DateContactTableModel&);
+
+    struct Conversation;
+
+    QList<Conversation *> m_rows;
+    QHash<QString, int> m_rowsByKey;
+    int m_nextId;
+    QIcon m_gmailIcon;
+    QIcon m_fbIcon;
+    QIcon m_testIcon;
+
+    Conversation *newConversation(const Cmn::Conversation::Entry &entry);
+};
+
+/// @}
+
+} // namespace FE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_FE_DATECONTACTTABLEMODEL_H
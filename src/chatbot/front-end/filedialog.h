@@ -136,6 +136,21 @@ public:
         return filename;
     }
 
+    /**
+     * Shows the "Export performance trace" dialog. Returns the selected filename or
+     * an empty string if the dialog was canceled
+     */
+    static QString saveTrace(QWidget *parent = 0)
+    {
+        QString filename = QFileDialog::getSaveFileName(parent,
+                                                        QObject::tr("Export Performance Trace"),
+                                                        defaultLocation(), traceFilter());
+
+        appendExtension(filename, "json");
+
+        return filename;
+    }
+
     /**
      * Shows the "Open export file" dialog. Returns the selected filename or
      * an empty string if the dialog was canceled
@@ -167,6 +182,12 @@ private:
         return QObject::tr("Chatbot Export Files") + QString(" (*.") + exportExtension()
                 + QString(");;") + QObject::tr("All files") + QString(" (*.*)");
     }
+
+    static QString traceFilter()
+    {
+        return QObject::tr("Chrome Trace Files") + QString(" (*.json);;")
+                + QObject::tr("All files") + QString(" (*.*)");
+    }
 };
 
 /// @}
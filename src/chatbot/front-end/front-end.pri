@@ -20,6 +20,10 @@ HEADERS += \
     $$PROJECT_PATH/front-end/rosterwidget.h \
     $$PROJECT_PATH/front-end/autocompletetextedit.h \
     $$PROJECT_PATH/front-end/chathistorywidget.h \
+    $$PROJECT_PATH/front-end/datecontacttablemodel.h \
+    $$PROJECT_PATH/front-end/conversationtablemodel.h \
+    $$PROJECT_PATH/front-end/historysearchindex.h \
+    $$PROJECT_PATH/front-end/keyfilterproxymodel.h \
     $$PROJECT_PATH/front-end/linefilteredit.h \
     $$PROJECT_PATH/front-end/ruletextview.h \
     $$PROJECT_PATH/front-end/scorewidget.h \
@@ -54,6 +58,10 @@ SOURCES += \
     $$PROJECT_PATH/front-end/rosterwidget.cpp \
     $$PROJECT_PATH/front-end/autocompletetextedit.cpp \
     $$PROJECT_PATH/front-end/chathistorywidget.cpp \
+    $$PROJECT_PATH/front-end/datecontacttablemodel.cpp \
+    $$PROJECT_PATH/front-end/conversationtablemodel.cpp \
+    $$PROJECT_PATH/front-end/historysearchindex.cpp \
+    $$PROJECT_PATH/front-end/keyfilterproxymodel.cpp \
     $$PROJECT_PATH/front-end/linefilteredit.cpp \
     $$PROJECT_PATH/front-end/ruletextview.cpp \
     $$PROJECT_PATH/front-end/scorewidget.cpp \
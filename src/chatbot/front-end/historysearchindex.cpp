@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "front-end/historysearchindex.h"
+#include "nlp-engine/sanitizerfactory.h"
+
+#include <QRegExp>
+
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+inline quint64 makePosting(int convId, int pos)
+{
+    return (quint64(quint32(convId)) << 32) | quint32(pos);
+}
+
+inline int postingConvId(quint64 posting)
+{
+    return int(posting >> 32);
+}
+
+inline int postingPos(quint64 posting)
+{
+    return int(posting & 0xffffffff);
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// HistorySearchIndex
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::HistorySearchIndex::HistorySearchIndex()
+    : m_preSanitizer(Nlp::SanitizerFactory().createPreSanitizer()),
+      m_postSanitizer(Nlp::SanitizerFactory().createPostSanitizer())
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::HistorySearchIndex::~HistorySearchIndex()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::HistorySearchIndex::add(int convId, int pos, const Cmn::Conversation::Entry &entry)
+{
+    quint64 posting = makePosting(convId, pos);
+
+    // A token repeated in the entry is indexed once
+    QSet<QString> tokens = tokenize(entry.msg + " " + entry.response).toSet();
+
+    foreach (const QString &token, tokens) {
+        m_postings[token].append(posting);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::HistorySearchIndex::remove(int convId)
+{
+    // Postings of removed conversations are skipped until the index is cleared
+    m_removed.insert(convId);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::HistorySearchIndex::clear()
+{
+    m_postings.clear();
+    m_removed.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::HistorySearchIndex::Hits Lvk::FE::HistorySearchIndex::search(const QString &query) const
+{
+    Hits hits;
+
+    QStringList terms = tokenize(query);
+
+    if (terms.isEmpty()) {
+        return hits;
+    }
+
+    QSet<quint64> postings = lookup(terms[0]);
+
+    for (int i = 1; i < terms.size() && !postings.isEmpty(); ++i) {
+        postings.intersect(lookup(terms[i]));
+    }
+
+    foreach (quint64 posting, postings) {
+        int convId = postingConvId(posting);
+
+        if (!m_removed.contains(convId)) {
+            hits[convId].insert(postingPos(posting));
+        }
+    }
+
+    return hits;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QStringList Lvk::FE::HistorySearchIndex::tokenize(const QString &text) const
+{
+    QString sanitized = m_postSanitizer->sanitize(m_preSanitizer->sanitize(text));
+
+    return sanitized.split(QRegExp("\\W+"), QString::SkipEmptyParts);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QSet<quint64> Lvk::FE::HistorySearchIndex::lookup(const QString &prefix) const
+{
+    QSet<quint64> postings;
+
+    QMap<QString, PostingList>::const_iterator it = m_postings.lowerBound(prefix);
+
+    for (; it != m_postings.constEnd() && it.key().startsWith(prefix); ++it) {
+        foreach (quint64 posting, it.value()) {
+            postings.insert(posting);
+        }
+    }
+
+    return postings;
+}
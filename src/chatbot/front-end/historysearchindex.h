@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_FE_HISTORYSEARCHINDEX_H
+#define LVK_FE_HISTORYSEARCHINDEX_H
+
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QStringList>
+#include <memory>
+
+#include "common/conversation.h"
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+class Sanitizer;
+}
+
+namespace FE
+{
+
+/// \ingroup Lvk
+/// \addtogroup FE
+/// @{
+
+/**
+ * \brief The HistorySearchIndex class provides an inverted index over the messages and
+ *        responses of the chat history.
+ *
+ * Entries are identified by the id of their conversation and their position in it. Text is
+ * tokenized with the same pre and post sanitizers used by the NLP engine, so searches ignore
+ * case, diacritics and duplicated characters. Every query term matches the tokens that start
+ * with it.
+ *
+ * \see ChatHistoryWidget
+ */
+class HistorySearchIndex
+{
+public:
+
+    /**
+     * Search hits. Maps conversation ids to the positions of the matching entries.
+     */
+    typedef QHash<int, QSet<int> > Hits;
+
+    /**
+     * Constructs an empty index.
+     */
+    HistorySearchIndex();
+
+    /**
+     * Destroys the object.
+     */
+    ~HistorySearchIndex();
+
+    /**
+     * Indexes \a entry as the entry in position \a pos of the conversation \a convId.
+     */
+    void add(int convId, int pos, const Cmn::Conversation::Entry &entry);
+
+    /**
+     * Removes all entries of the conversation \a convId.
+     */
+    void remove(int convId);
+
+    /**
+     * Removes all entries.
+     */
+    void clear();
+
+    /**
+     * Returns the entries that contain all terms of \a query.
+     */
+    Hits search(const QString &query) const;
+
+private:
+    HistorySearchIndex(HistorySearchIndex&);
+    HistorySearchIndex& operator=(HistorySearchIndex&);
+
+    // Posting: conversation id in the high 32 bits, entry position in the low 32 bits
+    typedef QVector<quint64> PostingList;
+
+    std::auto_ptr<Nlp::Sanitizer> m_preSanitizer;
+    std::auto_ptr<Nlp::Sanitizer> m_postSanitizer;
+    QMap<QString, PostingList> m_postings;
+    QSet<int> m_removed;
+
+    QStringList tokenize(const QString &text) const;
+    QSet<quint64> lookup(const QString &prefix) const;
+};
+
+/// @}
+
+} // namespace FE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_FE_HISTORYSEARCHINDEX_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "front-end/keyfilterproxymodel.h"
+
+
+//--------------------------------------------------------------------------------------------------
+// KeyFilterProxyModel
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::KeyFilterProxyModel::KeyFilterProxyModel(int keyRole, QObject *parent)
+    : QSortFilterProxyModel(parent),
+      m_keyRole(keyRole),
+      m_acceptAll(true)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::KeyFilterProxyModel::setAcceptedKeys(const QSet<int> &keys)
+{
+    m_acceptAll = false;
+    m_keys = keys;
+
+    invalidateFilter();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::KeyFilterProxyModel::acceptAll()
+{
+    if (m_acceptAll) {
+        return;
+    }
+
+    m_acceptAll = true;
+    m_keys.clear();
+
+    invalidateFilter();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::FE::KeyFilterProxyModel::filterAcceptsRow(int sourceRow,
+                                                    const QModelIndex &sourceParent) const
+{
+    if (m_acceptAll) {
+        return true;
+    }
+
+    QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+
+    return m_keys.contains(sourceModel()->data(index, m_keyRole).toInt());
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_FE_KEYFILTERPROXYMODEL_H
+#define LVK_FE_KEYFILTERPROXYMODEL_H
+
+#include <QSortFilterProxyModel>
+#include <QSet>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace FE
+{
+
+/// \ingroup Lvk
+/// \addtogroup FE
+/// @{
+
+/**
+ * \brief The KeyFilterProxyModel class provides a sort proxy that only accepts the rows whose
+ *        key is in a given set.
+ *
+ * The key of a row is the integer stored in the first column under the key role.
+ */
+class KeyFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Constructs a KeyFilterProxyModel which is a child of \a parent. Keys are read from
+     * \a keyRole. Initially, all rows are accepted.
+     */
+    KeyFilterProxyModel(int keyRole, QObject *parent = 0);
+
+    /**
+     * Accepts only the rows with a key in \a keys.
+     */
+    void setAcceptedKeys(const QSet<int> &keys);
+
+    /**
+     * Accepts all rows.
+     */
+    void acceptAll();
+
+protected:
+    virtual bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
+
+private:
+    KeyFilterProxyModel(KeyFilterProxyModel&);
+    KeyFilterProxyModel& operator=(KeyFilterProxyModel&);
+
+    int m_keyRole;
+    bool m_acceptAll;
+    QSet<int> m_keys;
+};
+
+/// @}
+
+} // namespace FE
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_FE_KEYFILTERPROXYMODEL_H
@@ -32,6 +32,7 @@
 #include "front-end/updateexecutor.h"
 #include "front-end/memberfunctor.h"
 #include "front-end/uploaderprogressdialog.h"
+#include "front-end/detailsdialog.h"
 #include "back-end/appfacade.h"
 #include "back-end/rule.h"
 #include "back-end/roster.h"
@@ -41,6 +42,7 @@
 #include "common/settings.h"
 #include "common/settingskeys.h"
 #include "common/globalstrings.h"
+#include "common/profiler.h"
 #include "da-server/updater.h"
 #include "da-server/contestdata.h"
 #include "ui_mainwindow.h"
@@ -55,8 +57,11 @@
 #include <QDir>
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QTimer>
 #include <QtDebug>
 
+#define SCORE_REPAINT_DELAY     250 // Milliseconds between repaints of the score widgets
+
 
 //--------------------------------------------------------------------------------------------------
 // Constructors, destructor and init methods
@@ -70,7 +75,10 @@ Lvk::FE::MainWindow::MainWindow(QWidget *parent) :
     m_ruleTreeModel(0),
     m_ruleEdited(false),
     m_ruleAdded(false),
-    m_tinyScore(0)
+    m_tinyScore(0),
+    m_scoreTimer(new QTimer(this)),
+    m_historyStale(false),
+    m_cluesStale(false)
 {
     qDebug() << "Setting up main window...";
 
@@ -112,9 +120,14 @@ void Lvk::FE::MainWindow::setupUi()
 
     ui->curScoreWidget->setUploadVisible(false);
 
+    ui->testInputText->setPreviewEnabled(true);
+
     m_tinyScore = new TinyScoreWidget(ui->mainTabWidget);
     m_tinyScore->setVisible(false);
 
+    m_scoreTimer->setSingleShot(true);
+    m_scoreTimer->setInterval(SCORE_REPAINT_DELAY);
+
     clear();
 
     connectSignals();
@@ -145,6 +158,9 @@ void Lvk::FE::MainWindow::clear(bool resetModel)
         initWithFile("");
     }
 
+    m_ruleHistory.clear();
+    updateHistoryActions();
+
     m_appFacade->disconnectFromChat();
 
     if (m_ruleEdited) {
@@ -167,11 +183,13 @@ void Lvk::FE::MainWindow::clear(bool resetModel)
 
     // conversation tab widgets
     ui->chatHistory->clear();
+    m_historyStale = false;
 
     // test tab widgets
     // TODO create a new widget to handle this:
     ui->testConversationText->clear();
     ui->testInputText->clearAll();
+    ui->testPreviewLabel->clear();
     ui->clearTestConvButton->setEnabled(false);
     ui->categoryGroupBox->setVisible(false);
     ui->categoryLabel->clear();
@@ -185,9 +203,11 @@ void Lvk::FE::MainWindow::clear(bool resetModel)
     ui->bestScoreWidget->clear();
     ui->remainingTimeLabel->clear();
     m_tinyScore->clear();
+    m_scoreTimer->stop();
 
     // Clue tab widgets
     ui->clueWidget->clear();
+    m_cluesStale = false;
 
     setUiMode(FE::WelcomeTabUiMode);
 }
@@ -241,6 +261,11 @@ void Lvk::FE::MainWindow::connectSignals()
     connect(ui->actionImport,          SIGNAL(triggered()), SLOT(onImportMenuTriggered()));
     connect(ui->actionExport,          SIGNAL(triggered()), SLOT(onExportMenuTriggered()));
     connect(ui->actionOptions,         SIGNAL(triggered()), SLOT(onOptionsMenuTriggered()));
+    connect(ui->actionCheckRules,      SIGNAL(triggered()), SLOT(onCheckRulesMenuTriggered()));
+    connect(ui->actionProfileRules,    SIGNAL(triggered()), SLOT(onProfileRulesMenuTriggered()));
+    connect(ui->actionExportTrace,     SIGNAL(triggered()), SLOT(onExportTraceMenuTriggered()));
+    connect(ui->actionUndoEdit,        SIGNAL(triggered()), SLOT(onUndoEditMenuTriggered()));
+    connect(ui->actionRedoEdit,        SIGNAL(triggered()), SLOT(onRedoEditMenuTriggered()));
 
     // init tab
     connect(ui->openChatbotButton,     SIGNAL(clicked()),   SLOT(onOpenMenuTriggered()));
@@ -276,7 +301,9 @@ void Lvk::FE::MainWindow::connectSignals()
     // Test tab
     connect(ui->testInputText,         SIGNAL(testInputEntered()), SLOT(onTestInputTextEntered()));
     connect(ui->testInputText,         SIGNAL(currentItemChanged()), SLOT(onTestTargetChanged()));
+    connect(ui->testInputText,         SIGNAL(previewRequested()), SLOT(onTestPreviewRequested()));
     connect(ui->clearTestConvButton,   SIGNAL(clicked()),       SLOT(onClearTestConvPressed()));
+    connect(ui->explainTestButton,     SIGNAL(clicked()),       SLOT(onExplainTestPressed()));
     connect(ui->showRuleDefButton,     SIGNAL(clicked()),       SLOT(onTestShowRule()));
 
     // Chat connetion tab
@@ -292,17 +319,27 @@ void Lvk::FE::MainWindow::connectSignals()
 
     // Conversation history tab
     connect(ui->chatHistory,          SIGNAL(teachRule(QString)),SLOT(onTeachFromHistory(QString)));
+    connect(ui->chatHistory,          SIGNAL(teachRules(QStringList)),
+            SLOT(onTeachFromHistory(QStringList)));
     connect(ui->chatHistory,          SIGNAL(showRule(quint64)), SLOT(onHistoryShowRule(quint64)));
     connect(ui->chatHistory,          SIGNAL(removedAll()),      SLOT(onRemovedAllHistory()));
     connect(ui->chatHistory,          SIGNAL(removed(QDate,QString)),
             SLOT(onRemovedHistory(QDate,QString)));
     connect(m_appFacade,              SIGNAL(newConversationEntry(Cmn::Conversation::Entry)),
             SLOT(onNewChatConversation(Cmn::Conversation::Entry)));
+    connect(m_appFacade,              SIGNAL(nlpEngineReady()), SLOT(onNlpEngineReady()));
+    connect(m_appFacade,
+            SIGNAL(responsePreviewReady(QString,QString,BE::AppFacade::ResponseCandidateList)),
+            SLOT(onResponsePreviewReady(QString,QString,BE::AppFacade::ResponseCandidateList)));
 
     // Score tab
     connect(ui->bestScoreWidget,      SIGNAL(upload()),          SLOT(onUploadScore()));
     connect(m_appFacade,              SIGNAL(scoreRemainingTime(int)),
             SLOT(onScoreRemainingTime(int)));
+    connect(m_appFacade,              SIGNAL(scoreChanged(Lvk::Stats::Score,Lvk::Stats::Score)),
+            SLOT(onScoreChanged(Lvk::Stats::Score,Lvk::Stats::Score)));
+    connect(m_scoreTimer,             SIGNAL(timeout()),         SLOT(onScoreTimeout()));
+    connect(m_appFacade,              SIGNAL(rulesCommitted()),  SLOT(onRulesCommitted()));
 
     // Clue tab
     connect(ui->clueWidget,           SIGNAL(upload()),          SLOT(onUploadScore()));
@@ -721,6 +758,7 @@ bool Lvk::FE::MainWindow::saveAsChanges()
         if (saved) {
             setFilename(filename);
             ui->chatHistory->clear();
+            m_historyStale = false;
             updateScore();
             onScoreRemainingTime(m_appFacade->scoreRemainingTime());
         } else  {
@@ -741,12 +779,19 @@ bool Lvk::FE::MainWindow::load(const QString &filename)
     bool success = initWithFile(filename);
 
     if (success) {
-        ui->chatHistory->setConversation(m_appFacade->chatHistory());
+        // The chat history is shown when its tab is first activated
+        m_historyStale = true;
+        refreshStaleTab();
+
         ui->ruleEditWidget->setRoster(m_appFacade->roster());
         ui->testInputText->setRoster(m_appFacade->roster());
 
         updateScore();
         onScoreRemainingTime(m_appFacade->scoreRemainingTime());
+
+        if (!m_appFacade->isNlpEngineReady()) {
+            ui->testLabel->setText(tr("Test (loading rules...):"));
+        }
     } else {
         QMessageBox::critical(this, tr("Open File"), tr("Cannot open ") + m_filename);
     }
@@ -940,6 +985,124 @@ void Lvk::FE::MainWindow::onOptionsMenuTriggered()
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::MainWindow::onCheckRulesMenuTriggered()
+{
+    QString title = tr("Check rules");
+
+    Nlp::RuleIssueList issues = m_appFacade->lintRules();
+
+    if (issues.isEmpty()) {
+        QMessageBox::information(this, title, tr("No problems found in the rules."));
+        return;
+    }
+
+    QStringList details;
+
+    foreach (const Nlp::RuleIssue &issue, issues) {
+        const BE::Rule *rule = findRule(issue.ruleId);
+        const BE::Rule *other = findRule(issue.otherRuleId);
+
+        QString name = QString("'%1' (#%2)").arg(getRuleDisplayName(rule))
+                                            .arg(issue.ruleId);
+        QString otherName = QString("'%1' (#%2)").arg(getRuleDisplayName(other))
+                                                 .arg(issue.otherRuleId);
+        QString input = rule ? rule->input().value(issue.inputIdx) : QString();
+        QString otherInput = other ? other->input().value(issue.otherInputIdx) : QString();
+
+        switch (issue.type) {
+        case Nlp::RuleIssue::EmptyInput:
+            details.append(tr("Rule %1: Input \"%2\" never matches because it has no words.")
+                           .arg(name, input));
+            break;
+        case Nlp::RuleIssue::DuplicatedInput:
+            details.append(tr("Rule %1: Input \"%2\" never matches because rule %3 has the "
+                              "same input.").arg(name, input, otherName));
+            break;
+        case Nlp::RuleIssue::ShadowedByWildcard:
+            details.append(tr("Rule %1: Input \"%2\" never matches because input \"%3\" of "
+                              "rule %4 matches first.").arg(name, input, otherInput, otherName));
+            break;
+        }
+    }
+
+    QString msg = tr("%1 problem(s) found in the rules.").arg(issues.size());
+
+    DetailsDialog dialog(msg, tr("Details"), details.join("\n"), this);
+    dialog.setWindowTitle(title);
+    dialog.setCancelButtonVisible(false);
+    dialog.setPixmap(QStyle::SP_MessageBoxWarning);
+    dialog.exec();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::onProfileRulesMenuTriggered()
+{
+    QString title = tr("Profile rules");
+
+    Nlp::RuleCostList costs = m_appFacade->profileRules();
+
+    if (costs.isEmpty()) {
+        QMessageBox::information(this, title, tr("There are no rules to profile."));
+        return;
+    }
+
+    int nodes = 0;
+    qint64 usecs = 0;
+    QStringList details;
+
+    foreach (const Nlp::RuleCost &c, costs) {
+        nodes += c.nodes;
+        usecs += c.usecs();
+
+        details.append(tr("Rule '%1' (#%2): %3 node(s), %4 wildcard edge(s), %5 output(s), "
+                          "%6 word(s) in %7 input(s), %8 ms")
+                       .arg(getRuleDisplayName(findRule(c.ruleId)))
+                       .arg(c.ruleId)
+                       .arg(c.nodes)
+                       .arg(c.wildcardEdges)
+                       .arg(c.omapEntries)
+                       .arg(c.words)
+                       .arg(c.inputs)
+                       .arg(c.usecs()/1000.0, 0, 'f', 2));
+    }
+
+    QString msg = tr("%1 rule(s) compiled into %2 node(s) in %3 ms. The costliest rules are "
+                     "listed first.").arg(costs.size()).arg(nodes).arg(usecs/1000);
+
+    DetailsDialog dialog(msg, tr("Details"), details.join("\n"), this);
+    dialog.setWindowTitle(title);
+    dialog.setCancelButtonVisible(false);
+    dialog.setPixmap(QStyle::SP_MessageBoxInformation);
+    dialog.exec();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::onExportTraceMenuTriggered()
+{
+    QString title = tr("Export performance trace");
+
+    if (!Cmn::Profiler::isEnabled()) {
+        QMessageBox::information(this, title, tr("The profiler is disabled. Set the sampling "
+                                                 "interval in the application settings to "
+                                                 "record a performance trace."));
+        return;
+    }
+
+    QString filename = FileDialog::saveTrace(this);
+
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    if (!Cmn::Profiler::exportChromeTrace(filename)) {
+        QMessageBox::critical(this, title, tr("Could not write file '%1'").arg(filename));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool Lvk::FE::MainWindow::nlpEngineOption(BE::AppFacade::NlpEngineOption option)
 {
     return m_appFacade->nlpEngineOptions() & option;
@@ -1208,6 +1371,10 @@ const Lvk::BE::Rule *Lvk::FE::MainWindow::findRule(quint64 ruleId) const
         return 0;
     }
 
+    if (root->tracker()) {
+        return root->tracker()->rule(ruleId);
+    }
+
     for (BE::Rule::const_iterator it = root->begin(); it != root->end(); ++it) {
         const BE::Rule* rule = *it;
         if (rule->id() == ruleId /*&& rule->type() == BE::Rule::OrdinaryRule*/) {
@@ -1281,6 +1448,53 @@ void Lvk::FE::MainWindow::onTeachFromHistory(const QString &msg)
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::MainWindow::onTeachFromHistory(const QStringList &msgs)
+{
+    // Similar messages are proposed as inputs of the same rule
+    QList<QStringList> groups = m_appFacade->groupSimilarInputs(msgs);
+
+    QStringList details;
+    foreach (const QStringList &group, groups) {
+        details.append(group.join("\n"));
+    }
+
+    QString msg = QString(tr("%1 messages will be taught as %2 new rules. Messages with similar "
+                             "words are grouped in the same rule.")).arg(msgs.size())
+                                                                    .arg(groups.size());
+
+    DetailsDialog dialog(msg, tr("Show rules"), details.join("\n\n"), this);
+    dialog.setWindowTitle(tr("Teach rules"));
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    setUiMode(FE::EditRuleUiMode);
+
+    BE::Rule *category = getCategoryFromDialog();
+
+    if (!category) {
+        return;
+    }
+
+    QList<BE::Rule *> rules;
+    foreach (const QStringList &group, groups) {
+        rules.append(new BE::Rule("", group, QStringList()));
+    }
+
+    // All rules are added at once and the NLP engine is refreshed only once
+    if (m_ruleTreeModel->appendItems(rules, category)) {
+        m_appFacade->markRulesChanged();
+
+        selectRule(rules.first());
+        ui->ruleEditWidget->setFocusOnOutput();
+    } else {
+        qDeleteAll(rules);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 Lvk::BE::Rule * Lvk::FE::MainWindow::getCategoryFromDialog()
 {
     const QString SPLIT_TOKEN = ". ";
@@ -1379,7 +1593,11 @@ void Lvk::FE::MainWindow::selectRule(const BE::Rule *rule)
 void Lvk::FE::MainWindow::startEditMode()
 {
     ui->connectionWidget->refresh();
-    ui->clueWidget->refresh();
+
+    // Scripts are analyzed when the clue tab is first activated
+    m_cluesStale = true;
+    refreshStaleTab();
+
     setUiMode(FE::EditRuleUiMode);
     selectFirstRule();
     updateScore();
@@ -1476,18 +1694,21 @@ void Lvk::FE::MainWindow::teachRule(BE::Rule *rule)
         return;
     }
 
+    BE::RuleHistory::State before(*rule);
+
     rule->setName(ui->ruleEditWidget->name());
     rule->setTarget(ui->ruleEditWidget->targets());
     rule->setInput(ui->ruleEditWidget->input());
     rule->setOutput(ui->ruleEditWidget->output());
     rule->setNextCategory(ui->ruleEditWidget->nextCategory());
 
+    m_ruleHistory.record(before, BE::RuleHistory::State(*rule));
+    updateHistoryActions();
+
     ruleEditFinished();
 
-    m_appFacade->refreshNlpEngine();
-    m_appFacade->save();
-
-    updateScore();
+    // Refresh and save are coalesced with the next edits, score is updated by onRulesCommitted()
+    m_appFacade->markRulesChanged();
 
     ui->ruleEditWidget->setButtonsEnabled(false);
 }
@@ -1519,6 +1740,50 @@ void Lvk::FE::MainWindow::undoRule(BE::Rule *rule)
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::MainWindow::onUndoEditMenuTriggered()
+{
+    // The pending edit is taught or discarded first, so it is the one undone
+    if (m_ruleEdited || m_ruleAdded) {
+        handleRuleEdited(selectedRule());
+    }
+
+    showHistoryStep(m_ruleHistory.undo(rootRule()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::onRedoEditMenuTriggered()
+{
+    if (m_ruleEdited || m_ruleAdded) {
+        handleRuleEdited(selectedRule());
+    }
+
+    showHistoryStep(m_ruleHistory.redo(rootRule()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::showHistoryStep(BE::Rule *rule)
+{
+    if (rule) {
+        m_ruleTreeModel->updateItem(rule);
+        selectRule(rule);
+        refreshRuleOnWidget();
+
+        m_appFacade->markRulesChanged();
+    }
+
+    updateHistoryActions();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::updateHistoryActions()
+{
+    ui->actionUndoEdit->setEnabled(m_ruleHistory.canUndo());
+    ui->actionRedoEdit->setEnabled(m_ruleHistory.canRedo());
+}
+
 void Lvk::FE::MainWindow::ruleEditFinished()
 {
     m_ruleAdded = false;
@@ -1532,12 +1797,19 @@ void Lvk::FE::MainWindow::onRulesRemoved(const QModelIndex &parent, int first, i
 {
     // This slot is called when the user removes a rule or when there was a drag & drop action
     qDebug() << "MainWindow: Rows removed:" << parent.row() << first << last;
-    qDebug() << "MainWindow: Refreshing NLP engine...";
 
-    m_appFacade->refreshNlpEngine();
+    m_appFacade->markRulesChanged();
+}
+
+//--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::MainWindow::onRulesCommitted()
+{
     updateScore();
 
+    if (!m_cluesStale) {
+        ui->clueWidget->updateCoverage();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1551,11 +1823,13 @@ void Lvk::FE::MainWindow::onTestInputTextEntered()
     }
 
     QString input = ui->testInputText->text();
-    QString target = ui->testInputText->currentItem().username;
+    QString target = testTarget();
 
-    if (target.isEmpty()) {
-        target = "[ChatbotTest]";
-    }
+    m_appFacade->cancelResponsePreview();
+    ui->testPreviewLabel->clear();
+
+    // Rules taught just before must be used
+    m_appFacade->commitRuleChanges();
 
     // FIXME if target is currently talking with the chatbot, we can change the current topic,
     // it's not very likely but possible.
@@ -1575,6 +1849,63 @@ void Lvk::FE::MainWindow::onTestInputTextEntered()
 
 //--------------------------------------------------------------------------------------------------
 
+QString Lvk::FE::MainWindow::testTarget()
+{
+    QString target = ui->testInputText->currentItem().username;
+
+    return !target.isEmpty() ? target : QString("[ChatbotTest]");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::onTestPreviewRequested()
+{
+    QString input = ui->testInputText->text();
+
+    if (input.trimmed().isEmpty()) {
+        m_appFacade->cancelResponsePreview();
+        ui->testPreviewLabel->clear();
+    } else {
+        m_appFacade->requestResponsePreview(input, testTarget());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::onResponsePreviewReady(const QString &input, const QString &target,
+                                         const BE::AppFacade::ResponseCandidateList &candidates)
+{
+    // Ignore previews of text no longer in the input box
+    if (input != ui->testInputText->text() || target != testTarget()) {
+        return;
+    }
+
+    if (candidates.isEmpty()) {
+        ui->testPreviewLabel->setText(tr("Preview: no rule matches"));
+        return;
+    }
+
+    QStringList lines;
+
+    for (int i = 0; i < candidates.size(); ++i) {
+        const BE::AppFacade::ResponseCandidate &c = candidates[i];
+        const BE::Rule *rule = findRule(c.ruleId);
+        QString ruleName = rule ? getRuleDisplayName(rule) : QString::number(c.ruleId);
+
+        if (i == 0) {
+            lines.append(tr("Preview: \"%1\" (rule '%2', score %3)")
+                         .arg(c.output, ruleName, QString::number(c.score, 'f', 2)));
+        } else {
+            lines.append(tr("    also matches rule '%1', score %2")
+                         .arg(ruleName, QString::number(c.score, 'f', 2)));
+        }
+    }
+
+    ui->testPreviewLabel->setText(lines.join("\n"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::MainWindow::onTestTargetChanged()
 {
     BE::RosterItem target = ui->testInputText->currentItem();
@@ -1588,6 +1919,13 @@ void Lvk::FE::MainWindow::onTestTargetChanged()
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::MainWindow::onNlpEngineReady()
+{
+    onTestTargetChanged();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::MainWindow::onClearTestConvPressed()
 {
     ui->clearTestConvButton->setEnabled(false);
@@ -1600,6 +1938,77 @@ void Lvk::FE::MainWindow::onClearTestConvPressed()
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::MainWindow::onExplainTestPressed()
+{
+    QString title = tr("Explain response");
+    QString input = ui->testInputText->text();
+
+    if (input.trimmed().isEmpty()) {
+        QMessageBox::information(this, title, tr("Type the message to explain first."));
+        return;
+    }
+
+    // Rules taught just before must be used
+    m_appFacade->commitRuleChanges();
+
+    Nlp::SearchExplain explain = m_appFacade->explainResponse(input, testTarget());
+
+    QString msg;
+
+    if (explain.result.isValid()) {
+        msg = tr("Rule '%1' replies with score %2.")
+                .arg(getRuleDisplayName(findRule(explain.result.ruleId)))
+                .arg(QString::number(explain.result.score, 'f', 2));
+    } else {
+        msg = tr("No rule matches, the chatbot replies with an evasive.");
+    }
+
+    QStringList details;
+
+    details.append(tr("Searches: %1%2").arg(explain.searches)
+                   .arg(explain.aborted ? tr(" (aborted, search budget exceeded)") : QString()));
+    details.append(tr("Nodes visited: %1").arg(explain.steps));
+    details.append(tr("Edges followed: %1 word(s), %2 wildcard(s), %3 variable(s). "
+                      "Skipped by filters: %4")
+                   .arg(explain.wordEdges)
+                   .arg(explain.wildcardEdges)
+                   .arg(explain.variableEdges)
+                   .arg(explain.filteredEdges));
+    details.append(tr("Terminal nodes reached: %1").arg(explain.terminalNodes));
+    details.append(tr("Outputs evaluated: %1").arg(explain.outputsEvaluated));
+    details.append(tr("Recursive expansions: %1 (%2 from memo)")
+                   .arg(explain.nestedSearches)
+                   .arg(explain.memoHits));
+    details.append(tr("Exact matches: %1").arg(explain.literalHits));
+
+    for (int i = 0; i < Nlp::EngineStats::StageCount; ++i) {
+        Nlp::EngineStats::Stage stage = static_cast<Nlp::EngineStats::Stage>(i);
+        details.append(tr("Time in %1: %2 us").arg(Nlp::EngineStats::stageName(stage))
+                       .arg(explain.stageUsecs[i]));
+    }
+
+    details.append("");
+    details.append(tr("Candidates:"));
+
+    foreach (const Nlp::Result &r, explain.candidates) {
+        const BE::Rule *rule = findRule(r.ruleId);
+        details.append(tr("  Rule '%1' (#%2), input \"%3\", score %4: %5")
+                       .arg(getRuleDisplayName(rule))
+                       .arg(r.ruleId)
+                       .arg(rule ? rule->input().value(r.inputIdx) : QString())
+                       .arg(QString::number(r.score, 'f', 2))
+                       .arg(r.output));
+    }
+
+    DetailsDialog dialog(msg, tr("Details"), details.join("\n"), this);
+    dialog.setWindowTitle(title);
+    dialog.setCancelButtonVisible(false);
+    dialog.setPixmap(QStyle::SP_MessageBoxInformation);
+    dialog.exec();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::MainWindow::onTestShowRule()
 {
     qDebug() << ui->ruleView->ruleId();
@@ -1742,9 +2151,10 @@ void Lvk::FE::MainWindow::onDisconnection()
 
 void Lvk::FE::MainWindow::onNewChatConversation(const Cmn::Conversation::Entry &entry)
 {
-    ui->chatHistory->addConversationEntry(entry);
-
-    updateScore();
+    // Otherwise; the entry is shown along with the rest of the history
+    if (!m_historyStale) {
+        ui->chatHistory->addConversationEntry(entry);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1783,6 +2193,28 @@ void Lvk::FE::MainWindow::onCurrentTabChanged(QWidget *tab)
     if (tab == ui->testTab) {
         ui->testInputText->setFocus();
     }
+
+    // Deferred, so the tab is painted before its content is built
+    if ((tab == ui->conversationsTab && m_historyStale) || (tab == ui->clueTab && m_cluesStale)) {
+        QTimer::singleShot(0, this, SLOT(refreshStaleTab()));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Builds the content of the current tab if it has not been built yet. The chat history and the
+// analyzed scripts are expensive to build and most sessions never visit their tabs.
+void Lvk::FE::MainWindow::refreshStaleTab()
+{
+    QWidget *tab = ui->mainTabWidget->currentWidget();
+
+    if (tab == ui->conversationsTab && m_historyStale) {
+        m_historyStale = false;
+        ui->chatHistory->setConversation(m_appFacade->chatHistory());
+    } else if (tab == ui->clueTab && m_cluesStale) {
+        m_cluesStale = false;
+        ui->clueWidget->refresh();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1791,9 +2223,22 @@ void Lvk::FE::MainWindow::onCurrentTabChanged(QWidget *tab)
 
 void Lvk::FE::MainWindow::updateScore()
 {
+    // currentScore() scores the rules again, a change is also notified with scoreChanged()
     Stats::Score cur = m_appFacade->currentScore();
     Stats::Score best = m_appFacade->bestScore();
 
+    m_scoreTimer->stop();
+
+    showScore(cur, best);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::showScore(const Stats::Score &cur, const Stats::Score &best)
+{
+    m_curScore = cur;
+    m_bestScore = best;
+
     m_tinyScore->setScore(cur, best);
     updateTinyScorePos();
 
@@ -1803,6 +2248,27 @@ void Lvk::FE::MainWindow::updateScore()
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::MainWindow::onScoreChanged(const Lvk::Stats::Score &cur,
+                                         const Lvk::Stats::Score &best)
+{
+    // Score widgets are repainted at most once per SCORE_REPAINT_DELAY
+    m_curScore = cur;
+    m_bestScore = best;
+
+    if (!m_scoreTimer->isActive()) {
+        m_scoreTimer->start();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::MainWindow::onScoreTimeout()
+{
+    showScore(m_curScore, m_bestScore);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::MainWindow::updateTinyScorePos()
 {
 #ifdef DA_CONTEST
@@ -1856,10 +2322,6 @@ void Lvk::FE::MainWindow::onScoreRemainingTime(int secs)
     QString text = QString(tr("Remaining time: %1 (%2)")).arg(time.toString("hh:mm:ss"), status);
 
     ui->remainingTimeLabel->setText(text);
-
-    if (secs == 0) {
-        updateScore();
-    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1878,6 +2340,8 @@ void Lvk::FE::MainWindow::uploadContestData()
         int rc = dialog.exec();
 
         qDebug() << "MainWindow::uploadContestData() finished with code" << rc;
+
+        QFile::remove(data.filename);
     } else {
         QMessageBox::critical(this, tr("Error"),
                               tr("Could not create file for upload. Please verify that you have "
@@ -26,6 +26,7 @@
 
 #include "back-end/appfacade.h"
 #include "back-end/rule.h"
+#include "back-end/rulehistory.h"
 #include "common/conversation.h"
 #include "front-end/mainwindowrefactor.h"
 
@@ -33,6 +34,7 @@ class TestMainWindow;
 class QModelIndex;
 class QFile;
 class QLabel;
+class QTimer;
 
 namespace Ui
 {
@@ -106,7 +108,7 @@ public:
     /**
      * Opens the given file and sets the window with edit mode
      */
-    void openFile(const QString &filename);
+    Q_INVOKABLE void openFile(const QString &filename);
 
     /**
      * Opens the last opened file (if any) and sets the window with edit mode
@@ -130,6 +132,12 @@ private:
     bool                     m_ruleAdded;
     QString                  m_filename;
     TinyScoreWidget         *m_tinyScore;
+    QTimer                  *m_scoreTimer;
+    Stats::Score             m_curScore;
+    Stats::Score             m_bestScore;
+    bool                     m_historyStale; // Chat history not shown yet
+    bool                     m_cluesStale;   // Scripts not analyzed yet
+    BE::RuleHistory          m_ruleHistory;  // Taught rule edits
 
     void setupUi();
 
@@ -172,10 +180,13 @@ private:
 
     void teachRule(BE::Rule *rule);
     void undoRule(BE::Rule *rule);
+    void showHistoryStep(BE::Rule *rule);
+    void updateHistoryActions();
     void handleRuleEdited(BE::Rule *rule);
     void ruleEditFinished();
 
     void highlightMatchedRules(const BE::AppFacade::MatchList &matches);
+    QString testTarget();
     void setCurrentCategory(quint64 catId);
 
     void undoRuleEdited(BE::Rule *rule);
@@ -203,6 +214,7 @@ private:
     void uploadContestData();
 
     void updateScore();
+    void showScore(const Stats::Score &cur, const Stats::Score &best);
     void uploadBlockedForUpdate(const DAS::UpdateInfo &info);
     void updateTinyScorePos();
 
@@ -215,6 +227,7 @@ private slots:
 
     BE::Rule *getCategoryFromDialog();
     void onTeachFromHistory(const QString &msg);
+    void onTeachFromHistory(const QStringList &msgs);
     void onHistoryShowRule(quint64 ruleId);
     void onRemovedAllHistory();
     void onRemovedHistory(const QDate &date, const QString &username);
@@ -226,10 +239,16 @@ private slots:
     void onTeachRule();
     void onUndoRule();
     void onRulesRemoved(const QModelIndex &parent, int first, int last);
+    void onRulesCommitted();
 
     void onTestInputTextEntered();
+    void onTestPreviewRequested();
+    void onResponsePreviewReady(const QString &input, const QString &target,
+                                const BE::AppFacade::ResponseCandidateList &candidates);
     void onTestTargetChanged();
+    void onNlpEngineReady();
     void onClearTestConvPressed();
+    void onExplainTestPressed();
     void onTestShowRule();
 
     void onVerifyAccountOk();
@@ -253,13 +272,21 @@ private slots:
     void onExportMenuTriggered();
     void onAboutMenuTriggered();
     void onOptionsMenuTriggered();
+    void onCheckRulesMenuTriggered();
+    void onProfileRulesMenuTriggered();
+    void onExportTraceMenuTriggered();
+    void onUndoEditMenuTriggered();
+    void onRedoEditMenuTriggered();
     void onExitMenuTriggered();
 
     void onSplitterMoved(int, int);
     void onCurrentTabChanged(QWidget *tab);
+    void refreshStaleTab();
 
     void onUploadScore();
     void onScoreRemainingTime(int time);
+    void onScoreChanged(const Lvk::Stats::Score &cur, const Lvk::Stats::Score &best);
+    void onScoreTimeout();
 
     void onUpdate(const DAS::UpdateInfo &info);
 
@@ -29,20 +29,35 @@
 #include <QLineEdit>
 #include <QLabel>
 
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+enum RosterRole
+{
+    CountedCheckedRole = Qt::UserRole  // True if the item is counted in m_checkedCount
+};
+
+} // namespace
+
+
 //--------------------------------------------------------------------------------------------------
 // RosterWidget
 //--------------------------------------------------------------------------------------------------
 
 Lvk::FE::RosterWidget::RosterWidget(QWidget *parent) :
     QWidget(parent), m_allUsersCheckBox(new QCheckBox()), m_rosterListWidget(new QListWidget()),
-    m_filterText(new FE::LineFilterEdit())
+    m_filterText(new FE::LineFilterEdit()), m_checkedCount(0)
 {
     setupWidget();
 
     connect(m_allUsersCheckBox, SIGNAL(clicked()), SLOT(onAllUsersClicked()));
 
-    connect(m_rosterListWidget, SIGNAL(itemClicked(QListWidgetItem*)),
-            SLOT(onRosterItemClicked(QListWidgetItem*)));
+    connect(m_rosterListWidget, SIGNAL(itemChanged(QListWidgetItem*)),
+            SLOT(onRosterItemChanged(QListWidgetItem*)));
 
     connect(m_filterText,       SIGNAL(textChanged(QString)), SLOT(onFilterTextChanged(QString)));
 }
@@ -78,17 +93,39 @@ void Lvk::FE::RosterWidget::setRoster(const Lvk::BE::Roster &roster,
 
     m_allUsersCheckBox->setCheckState(initialState);
 
+    m_rosterListWidget->setUpdatesEnabled(false);
+    m_rosterListWidget->blockSignals(true);
+
     m_rosterListWidget->clear();
+    m_rows.clear();
+    m_checkedCount = 0;
 
-    foreach (Lvk::BE::RosterItem rosterItem, roster) {
-        QString text = !rosterItem.fullname.isEmpty() ? rosterItem.fullname : rosterItem.username;
+    foreach (const Lvk::BE::RosterItem &rosterItem, roster) {
+        appendListItem(rosterItem, initialState);
+    }
 
-        QListWidgetItem *listItem = new QListWidgetItem(text);
-        listItem->setCheckState(initialState);
+    m_rosterListWidget->blockSignals(false);
+    m_rosterListWidget->setUpdatesEnabled(true);
+}
 
-        m_rows[rosterItem.username] = m_rosterListWidget->count();
+//--------------------------------------------------------------------------------------------------
 
-        m_rosterListWidget->addItem(listItem);
+void Lvk::FE::RosterWidget::appendListItem(const Lvk::BE::RosterItem &item, Qt::CheckState state)
+{
+    QListWidgetItem *listItem = new QListWidgetItem(item.displayText());
+    listItem->setCheckState(state);
+    listItem->setData(CountedCheckedRole, state == Qt::Checked);
+
+    if (state == Qt::Checked) {
+        ++m_checkedCount;
+    }
+
+    m_rows[item.username] = m_rosterListWidget->count();
+
+    m_rosterListWidget->addItem(listItem);
+
+    if (!m_filter.needle().isEmpty()) {
+        listItem->setHidden(!matchesFilter(listItem));
     }
 }
 
@@ -101,24 +138,147 @@ void Lvk::FE::RosterWidget::setRoster(const Lvk::BE::Roster &roster,
 
     // uncheck subset
 
+    m_rosterListWidget->blockSignals(true);
+
     foreach (const Lvk::BE::RosterItem &item, uncheckedSubset) {
         QHash<QString, int>::const_iterator it = m_rows.find(item.username);
         if (it != m_rows.end()) {
-            m_rosterListWidget->item(m_rows[item.username])->setCheckState(Qt::Unchecked);
+            setItemCheckState(m_rosterListWidget->item(*it), Qt::Unchecked);
         }
     }
 
-    // update all-users check box state
+    m_rosterListWidget->blockSignals(false);
+
+    updateAllUsersCheckState();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Sets the check state of the item and keeps the checked count. The caller must block the
+// signals of the list, so onRosterItemChanged() does not count the change again.
+void Lvk::FE::RosterWidget::setItemCheckState(QListWidgetItem *item, Qt::CheckState state)
+{
+    bool counted = item->data(CountedCheckedRole).toBool();
+    bool checked = state == Qt::Checked;
+
+    if (checked != counted) {
+        m_checkedCount += checked ? 1 : -1;
+        item->setData(CountedCheckedRole, checked);
+    }
+
+    item->setCheckState(state);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Checks or unchecks every item with a single repaint
+void Lvk::FE::RosterWidget::setAllItemsCheckState(Qt::CheckState state)
+{
+    bool checked = state == Qt::Checked;
+
+    m_rosterListWidget->setUpdatesEnabled(false);
+    m_rosterListWidget->blockSignals(true);
 
     for (int i = 0; i < m_rosterListWidget->count(); ++i) {
-        Qt::CheckState itemCheckState = m_rosterListWidget->item(i)->checkState();
-        if (i == 0) {
-            m_allUsersCheckBox->setCheckState(itemCheckState);
-        } else if (itemCheckState != m_allUsersCheckBox->checkState()) {
-           m_allUsersCheckBox->setCheckState(Qt::PartiallyChecked);
-           break;
+        QListWidgetItem *item = m_rosterListWidget->item(i);
+        if (item->checkState() != state) {
+            item->setCheckState(state);
+            item->setData(CountedCheckedRole, checked);
         }
     }
+
+    m_checkedCount = checked ? m_rosterListWidget->count() : 0;
+
+    m_rosterListWidget->blockSignals(false);
+    m_rosterListWidget->setUpdatesEnabled(true);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RosterWidget::updateAllUsersCheckState()
+{
+    int count = m_rosterListWidget->count();
+
+    if (count == 0) {
+        return;
+    }
+
+    if (m_checkedCount == count) {
+        m_allUsersCheckBox->setCheckState(Qt::Checked);
+    } else if (m_checkedCount == 0) {
+        m_allUsersCheckBox->setCheckState(Qt::Unchecked);
+    } else {
+        m_allUsersCheckBox->setCheckState(Qt::PartiallyChecked);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RosterWidget::addRosterItem(const BE::RosterItem &item,
+                                          Qt::CheckState state /*= Qt::Checked*/)
+{
+    if (m_rows.contains(item.username)) {
+        updateRosterItem(item);
+        return;
+    }
+
+    m_roster.append(item);
+
+    m_rosterListWidget->blockSignals(true);
+    appendListItem(item, state);
+    m_rosterListWidget->blockSignals(false);
+
+    updateAllUsersCheckState();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RosterWidget::updateRosterItem(const BE::RosterItem &item)
+{
+    QHash<QString, int>::const_iterator it = m_rows.find(item.username);
+
+    if (it == m_rows.constEnd()) {
+        addRosterItem(item);
+        return;
+    }
+
+    m_roster[*it] = item;
+
+    QListWidgetItem *listItem = m_rosterListWidget->item(*it);
+
+    m_rosterListWidget->blockSignals(true);
+    listItem->setText(item.displayText());
+    m_rosterListWidget->blockSignals(false);
+
+    listItem->setHidden(!matchesFilter(listItem));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RosterWidget::removeRosterItem(const QString &username)
+{
+    QHash<QString, int>::iterator it = m_rows.find(username);
+
+    if (it == m_rows.end()) {
+        return;
+    }
+
+    int row = *it;
+    m_rows.erase(it);
+
+    QListWidgetItem *listItem = m_rosterListWidget->takeItem(row);
+    if (listItem->data(CountedCheckedRole).toBool()) {
+        --m_checkedCount;
+    }
+    delete listItem;
+    m_roster.removeAt(row);
+
+    // Only the rows after the removed one are shifted
+    for (int i = row; i < m_roster.size(); ++i) {
+        m_rows[m_roster[i].username] = i;
+    }
+
+    updateAllUsersCheckState();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -156,6 +316,7 @@ void Lvk::FE::RosterWidget::clear()
     m_rosterListWidget->clear();
     m_roster.clear();
     m_rows.clear();
+    m_checkedCount = 0;
     m_filterText->clear();
 }
 
@@ -163,8 +324,19 @@ void Lvk::FE::RosterWidget::clear()
 
 Lvk::BE::Roster Lvk::FE::RosterWidget::filterRosteryBy(Qt::CheckState state)
 {
+    // If every item has the same state, the subset is either the full roster or empty
+    int count = m_rosterListWidget->count();
+    int stateCount = state == Qt::Checked ? m_checkedCount : count - m_checkedCount;
+
+    if (stateCount == 0) {
+        return Lvk::BE::Roster();
+    }
+    if (stateCount == count) {
+        return m_roster;
+    }
+
     Lvk::BE::Roster filteredRoster;
-    for (int i = 0; i < m_rosterListWidget->count(); ++i){
+    for (int i = 0; i < count && filteredRoster.size() < stateCount; ++i) {
         if (m_rosterListWidget->item(i)->checkState() == state) {
             filteredRoster.append(m_roster[i]);
         }
@@ -183,44 +355,67 @@ void Lvk::FE::RosterWidget::onAllUsersClicked()
         state = Qt::Checked;
     }
 
-    for (int i = 0; i < m_rosterListWidget->count(); ++i) {
-        m_rosterListWidget->item(i)->setCheckState(state);
-    }
+    setAllItemsCheckState(state);
 
     emit selectionChanged();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::FE::RosterWidget::onRosterItemClicked(QListWidgetItem *item)
+void Lvk::FE::RosterWidget::onRosterItemChanged(QListWidgetItem *item)
 {
-    Qt::CheckState itemState = item->checkState();
+    // Only changes made by the user get here. Text changes are ignored.
+    bool counted = item->data(CountedCheckedRole).toBool();
+    bool checked = item->checkState() == Qt::Checked;
 
-    // Update allUsersCheckBox check state
-
-    m_allUsersCheckBox->setCheckState(itemState);
-    for (int i = 0; i < m_rosterListWidget->count(); ++i) {
-        if (m_rosterListWidget->item(i)->checkState() != itemState) {
-               m_allUsersCheckBox->setCheckState(Qt::PartiallyChecked);
-               break;
-        }
+    if (checked == counted) {
+        return;
     }
 
+    m_checkedCount += checked ? 1 : -1;
+
+    m_rosterListWidget->blockSignals(true);
+    item->setData(CountedCheckedRole, checked);
+    m_rosterListWidget->blockSignals(false);
+
+    updateAllUsersCheckState();
+
     emit selectionChanged();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::FE::RosterWidget::onFilterTextChanged(const QString &)
+bool Lvk::FE::RosterWidget::matchesFilter(const QListWidgetItem *item) const
 {
+    return m_filter.isFoundIn(item->text());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RosterWidget::onFilterTextChanged(const QString &text)
+{
+    // If the new filter contains the previous one, only visible items can change and they can
+    // only be hidden. If the previous filter contains the new one, only hidden items can change.
+    bool narrower = m_filter.isFoundIn(text);
+    bool wider = Cmn::TextSearch::contains(m_filter.needle(), text);
+
+    m_filter.setNeedle(text);
+
+    m_rosterListWidget->setUpdatesEnabled(false);
+
     for (int i = 0; i < m_rosterListWidget->count(); ++i) {
         QListWidgetItem *item = m_rosterListWidget->item(i);
-        if (item->text().contains(m_filterText->text(), Qt::CaseInsensitive)) {
-            item->setHidden(false);
-        } else {
-            item->setHidden(true);
+        bool hidden = item->isHidden();
+
+        if ((narrower && hidden) || (wider && !hidden)) {
+            continue;
         }
-    }
-}
 
+        bool match = matchesFilter(item);
+        if (match == hidden) {
+            item->setHidden(!match);
+        }
+    }
 
+    m_rosterListWidget->setUpdatesEnabled(true);
+}
@@ -28,6 +28,7 @@
 #include <QHash>
 
 #include "back-end/roster.h"
+#include "common/textsearch.h"
 
 class QListWidget;
 class QCheckBox;
@@ -57,6 +58,10 @@ namespace FE
  * The widget consists of a list of contacts where each item is checkeable, an input textbox to
  * filter contacts and a global checkbox to check/uncheck all items. The widget provides methods
  * to get and set the check state of the items.
+ *
+ * The widget keeps the amount of checked items, so the state of the "All users" checkbox and
+ * the checked or unchecked subsets of a roster with every item in the same state are computed
+ * without scanning the list. Filtering only tests the items whose visibility can change.
  */
 class RosterWidget : public QWidget
 {
@@ -105,6 +110,25 @@ public:
      */
     void clear();
 
+public slots:
+
+    /**
+     * Appends \a item to the roster with state \a state. If there is an item with the same
+     * username, updates it instead.
+     */
+    void addRosterItem(const BE::RosterItem &item, Qt::CheckState state = Qt::Checked);
+
+    /**
+     * Updates the item with the same username than \a item. The check state is not changed.
+     * If there is no such item, appends it.
+     */
+    void updateRosterItem(const BE::RosterItem &item);
+
+    /**
+     * Removes the item with \a username. If there is no such item, this method does nothing.
+     */
+    void removeRosterItem(const QString &username);
+
 signals:
 
     /**
@@ -114,7 +138,7 @@ signals:
 
 private slots:
     void onAllUsersClicked();
-    void onRosterItemClicked(QListWidgetItem *item);
+    void onRosterItemChanged(QListWidgetItem *item);
     void onFilterTextChanged(const QString &);
 
 private:
@@ -123,9 +147,16 @@ private:
     QLineEdit *m_filterText;
     Lvk::BE::Roster m_roster;
     QHash<QString, int> m_rows; // username -> list row
+    int m_checkedCount;         // Items with state Qt::Checked
+    Cmn::TextSearch m_filter;   // Filter applied to the items
 
     void setupWidget();
     Lvk::BE::Roster filterRosteryBy(Qt::CheckState);
+    void appendListItem(const Lvk::BE::RosterItem &item, Qt::CheckState state);
+    void setItemCheckState(QListWidgetItem *item, Qt::CheckState state);
+    void setAllItemsCheckState(Qt::CheckState state);
+    bool matchesFilter(const QListWidgetItem *item) const;
+    void updateAllUsersCheckState();
 };
 
 /// @}
@@ -23,11 +23,14 @@
 #include "back-end/rule.h"
 
 #include <QString>
+#include <QTextDocument>
+#include <QTextCursor>
 
 #define SEP_1       "&nbsp;"
 #define SEP_2       "<br/>"
-#define HL_START    "<span style=\"color:#0000ff;\">"
-#define HL_END      "</span>"
+#define HL_COLOR    "#0000ff"
+
+#define RULE_CACHE_SIZE     200 // Max number of rendered rules
 
 //--------------------------------------------------------------------------------------------------
 // Helpers
@@ -38,21 +41,14 @@
 namespace
 {
 
-// Join l and highlight n-th element
-inline QString hljoin(const QStringList &l, int n)
+typedef QList< QPair<int, int> > SpanList;
+
+inline QString join(const QStringList &l)
 {
     QString s;
 
     for (int i = 0; i < l.size(); ++i) {
-        if (i == n) {
-            s += HL_START;
-        }
-
         s += SEP_1 + l[i] + SEP_2;
-
-        if (i == n) {
-            s += HL_END;
-        }
     }
 
     return s;
@@ -78,41 +74,98 @@ inline QString childrenToHtml(const Lvk::BE::Rule *rule)
 
 //--------------------------------------------------------------------------------------------------
 
-// HTML string for the given rule with n-th input highlighted
-inline QString ruleToHtml(const Lvk::BE::Rule *rule, int n)
+// Inserts the given rule with the cursor c and appends to inputSpans the start and end
+// position of each input
+inline void renderRule(QTextCursor &c, const Lvk::BE::Rule *rule, SpanList &inputSpans)
 {
-    if (!rule) {
-        return "";
-    } else if (rule->type() == Lvk::BE::Rule::OrdinaryRule) {
-        return QString(QObject::tr("<b>Category:</b><br/>%1<br/><br/>"
-                                   "<b>If user writes:</b><br/>%2<br/>"
-                                   "<b>Chatbot replies:</b><br/>%3"))
-                .arg(SEP_1 + (rule->parent() ? rule->parent()->name() : ""))
-                .arg(hljoin(rule->input(), n))
-                .arg(hljoin(rule->output(), -1)); // TODO highlight output
+    if (rule->type() == Lvk::BE::Rule::OrdinaryRule) {
+        c.insertHtml(QString(QObject::tr("<b>Category:</b><br/>%1<br/><br/>"
+                                         "<b>If user writes:</b><br/>"))
+                     .arg(SEP_1 + (rule->parent() ? rule->parent()->name() : "")));
+
+        foreach (const QString &input, rule->input()) {
+            int start = c.position();
+            c.insertHtml(SEP_1 + input);
+            inputSpans.append(qMakePair(start, c.position()));
+            c.insertHtml(SEP_2);
+        }
+
+        c.insertHtml(QString(QObject::tr("<b>Chatbot replies:</b><br/>%1"))
+                     .arg(join(rule->output()))); // TODO highlight output
     } else if (rule->type() == Lvk::BE::Rule::ContainerRule) {
-        return QString(QObject::tr("<b>Category:</b><br/>%1<br/><br/>"
-                                   "<b>Rules:</b><br/>%2"))
-                .arg(SEP_1 + rule->name())
-                .arg(childrenToHtml(rule));
+        c.insertHtml(QString(QObject::tr("<b>Category:</b><br/>%1<br/><br/>"
+                                         "<b>Rules:</b><br/>%2"))
+                     .arg(SEP_1 + rule->name())
+                     .arg(childrenToHtml(rule)));
     } else if (rule->type() == Lvk::BE::Rule::EvasiveRule) {
-        return QString(QObject::tr("<b>If Chatbot does not understand:</b><br/>%1"))
-                .arg(hljoin(rule->output(), -1));  // TODO highlight output
+        c.insertHtml(QString(QObject::tr("<b>If Chatbot does not understand:</b><br/>%1"))
+                     .arg(join(rule->output())));  // TODO highlight output
     } else {
-        return QObject::tr("<Unknown Rule Type>");
+        c.insertText(QObject::tr("<Unknown Rule Type>"));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Revision of all the rules displayed when the given rule is rendered. Ordinary rules display
+// their category name and categories display the first input of their rules.
+inline quint32 renderRevision(const Lvk::BE::Rule *rule)
+{
+    quint32 rev = rule->revision();
+
+    if (rule->type() == Lvk::BE::Rule::ContainerRule) {
+        foreach (const Lvk::BE::Rule *child, rule->children()) {
+            rev = rev*31 + child->revision();
+        }
+    } else if (rule->parent()) {
+        rev = rev*31 + rule->parent()->revision();
     }
+
+    return rev;
 }
 
 } // namespace
 
+//--------------------------------------------------------------------------------------------------
+// RuleTextView::RenderedRule
+//--------------------------------------------------------------------------------------------------
+
+struct Lvk::FE::RuleTextView::RenderedRule
+{
+    RenderedRule(quint32 revision)
+        : revision(revision), doc(new QTextDocument())
+    {
+        doc->setUndoRedoEnabled(false);
+    }
+
+    ~RenderedRule()
+    {
+        delete doc;
+    }
+
+    quint32 revision;
+    QTextDocument *doc;
+    SpanList inputSpans;
+};
+
 //--------------------------------------------------------------------------------------------------
 // RuleTextView
 //--------------------------------------------------------------------------------------------------
 
 Lvk::FE::RuleTextView::RuleTextView(QWidget *parent)
-    : QTextEdit(parent), m_ruleId(0)
+    : QTextEdit(parent), m_ruleId(0), m_blankDoc(new QTextDocument(this)),
+      m_cache(RULE_CACHE_SIZE)
 {
     setReadOnly(true);
+    setDocument(m_blankDoc);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::FE::RuleTextView::~RuleTextView()
+{
+    // Cached documents are deleted before the widget
+    setDocument(m_blankDoc);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -126,13 +179,62 @@ void Lvk::FE::RuleTextView::setRule(const BE::Rule *rule)
 
 void Lvk::FE::RuleTextView::setRule(const BE::Rule *rule, int n)
 {
-    if (rule) {
-        setText(ruleToHtml(rule, n));
-        m_ruleId = rule->id();
-    } else {
-        setText("");
-        m_ruleId = 0;
+    if (!rule) {
+        clear();
+        return;
+    }
+
+    const RenderedRule *rendered = render(rule);
+
+    QList<QTextEdit::ExtraSelection> selections;
+
+    if (n >= 0 && n < rendered->inputSpans.size()) {
+        QTextEdit::ExtraSelection selection;
+        selection.cursor = QTextCursor(rendered->doc);
+        selection.cursor.setPosition(rendered->inputSpans[n].first);
+        selection.cursor.setPosition(rendered->inputSpans[n].second, QTextCursor::KeepAnchor);
+        selection.format.setForeground(QColor(HL_COLOR));
+        selections.append(selection);
+    }
+
+    setExtraSelections(selections);
+
+    m_ruleId = rule->id();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::FE::RuleTextView::RenderedRule * Lvk::FE::RuleTextView::render(const BE::Rule *rule)
+{
+    quint32 revision = renderRevision(rule);
+
+    RenderedRule *rendered = m_cache.object(rule->id());
+
+    if (!rendered || rendered->revision != revision) {
+        rendered = new RenderedRule(revision);
+        rendered->doc->setDefaultFont(font());
+
+        QTextCursor cursor(rendered->doc);
+        renderRule(cursor, rule, rendered->inputSpans);
+
+        // Set the new document before the cache deletes the one being displayed
+        setDocument(rendered->doc);
+        m_cache.insert(rule->id(), rendered);
+    } else if (document() != rendered->doc) {
+        setDocument(rendered->doc);
     }
+
+    return rendered;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RuleTextView::clear()
+{
+    // QTextEdit::clear() would clear the cached document being displayed
+    setExtraSelections(QList<QTextEdit::ExtraSelection>());
+    setDocument(m_blankDoc);
+    m_ruleId = 0;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -23,6 +23,7 @@
 #define LVK_FE_RULETEXTVIEW_H
 
 #include <QTextEdit>
+#include <QCache>
 
 namespace Lvk
 {
@@ -48,6 +49,12 @@ namespace FE
  * \brief The RuleTextView class provides a read-only text edit widget to display a rule.
  */
 
+/**
+ * \brief The RuleTextView class provides a read-only widget to display rules.
+ *
+ * Rendered rules are cached by rule ID and revision, so displaying again a rule that has not
+ * changed does not render it again.
+ */
 class RuleTextView : public QTextEdit
 {
     Q_OBJECT
@@ -59,6 +66,11 @@ public:
      */
     explicit RuleTextView(QWidget *parent = 0);
 
+    /**
+     * Destroys the widget.
+     */
+    ~RuleTextView();
+
     /**
      * Displays \a rule in the widget.
      */
@@ -74,8 +86,24 @@ public:
      */
     quint64 ruleId();
 
+public slots:
+
+    /**
+     * Clears the widget.
+     */
+    void clear();
+
 private:
+    RuleTextView(RuleTextView&);
+    RuleTextView& operator=(RuleTextView&);
+
+    struct RenderedRule;
+
     quint64 m_ruleId;
+    QTextDocument *m_blankDoc;
+    QCache<quint64, RenderedRule> m_cache;
+
+    const RenderedRule *render(const BE::Rule *rule);
 };
 
 /// @}
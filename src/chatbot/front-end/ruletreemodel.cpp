@@ -31,6 +31,8 @@
 
 #define MIME_RULE_DATA  "rule_data"
 
+#define FETCH_BATCH     256     // Number of children fetched at once
+
 
 //--------------------------------------------------------------------------------------------------
 // Constructors & Destructors
@@ -91,7 +93,7 @@ int Lvk::FE::RuleTreeModel::rowCount(const QModelIndex &parent) const
     BE::Rule *parentItem = parent.isValid() ?
                 static_cast<BE::Rule *>(parent.internalPointer()) : m_rootRule;
 
-    return parentItem->childCount();
+    return fetchedCount(parentItem);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -106,6 +108,24 @@ int Lvk::FE::RuleTreeModel::columnCount(const QModelIndex &parent) const
 
 //--------------------------------------------------------------------------------------------------
 
+bool Lvk::FE::RuleTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    const BE::Rule *parentItem = itemFromIndex(parent);
+
+    return fetchedCount(parentItem) < parentItem->childCount();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RuleTreeModel::fetchMore(const QModelIndex &parent)
+{
+    BE::Rule *parentItem = itemFromIndex(parent);
+
+    fetchUpTo(parentItem, fetchedCount(parentItem) + FETCH_BATCH);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QVariant Lvk::FE::RuleTreeModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid()) {
@@ -170,8 +190,14 @@ bool Lvk::FE::RuleTreeModel::insertRows(int position, int rows, const QModelInde
     bool inserted = false;
 
     if (parentItem) {
+        // Rows are only inserted after all existing rows are fetched
+        fetchUpTo(parentItem, parentItem->childCount());
+
         beginInsertRows(parent, position, position + rows - 1);
         inserted = parentItem->insertChildren(position, rows);
+        if (parentItem != m_rootRule) {
+            m_fetched.insert(parentItem, parentItem->childCount());
+        }
         endInsertRows();
     }
 
@@ -187,8 +213,13 @@ bool Lvk::FE::RuleTreeModel::removeRows(int position, int rows, const QModelInde
     bool removed = false;
 
     if (parentItem) {
+        fetchUpTo(parentItem, parentItem->childCount());
+
         beginRemoveRows(parent, position, position + rows - 1);
         removed = parentItem->removeChildren(position, rows);
+        if (parentItem != m_rootRule) {
+            m_fetched.insert(parentItem, parentItem->childCount());
+        }
         endRemoveRows();
     }
 
@@ -248,6 +279,7 @@ void Lvk::FE::RuleTreeModel::setRootItem(BE::Rule *root)
 {
     emit layoutAboutToBeChanged();
     m_rootRule = root;
+    m_fetched.clear();
     emit layoutChanged();
 }
 
@@ -286,7 +318,13 @@ QModelIndex Lvk::FE::RuleTreeModel::index(int row, int column, BE::Rule *parentI
 
 QModelIndex Lvk::FE::RuleTreeModel::indexFromItem(const BE::Rule *item)
 {
-    return item != m_rootRule ? createIndex(rowForItem(item), 0, (void *)item) : QModelIndex();
+    if (item == m_rootRule) {
+        return QModelIndex();
+    }
+
+    fetchItem(item);
+
+    return createIndex(rowForItem(item), 0, (void *)item);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -296,9 +334,38 @@ bool Lvk::FE::RuleTreeModel::appendItem(BE::Rule *item, BE::Rule *parent)
     bool appended = false;
 
     if (parent) {
+        fetchUpTo(parent, parent->childCount());
+
         int row = parent->childCount();
         beginInsertRows(indexFromItem(parent), row, row);
         appended = parent->appendChild(item);
+        if (parent != m_rootRule) {
+            m_fetched.insert(parent, parent->childCount());
+        }
+        endInsertRows();
+    }
+
+    return appended;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::FE::RuleTreeModel::appendItems(const QList<BE::Rule *> &items, BE::Rule *parent)
+{
+    bool appended = false;
+
+    if (parent && !items.isEmpty()) {
+        fetchUpTo(parent, parent->childCount());
+
+        int row = parent->childCount();
+        beginInsertRows(indexFromItem(parent), row, row + items.size() - 1);
+        appended = true;
+        foreach (BE::Rule *item, items) {
+            appended = parent->appendChild(item) && appended;
+        }
+        if (parent != m_rootRule) {
+            m_fetched.insert(parent, parent->childCount());
+        }
         endInsertRows();
     }
 
@@ -346,11 +413,70 @@ void Lvk::FE::RuleTreeModel::clear()
 
 int Lvk::FE::RuleTreeModel::rowForItem(const BE::Rule *item) const
 {
-    if (item->parent()) {
-        return item->parent()->children().indexOf((BE::Rule *)item);
+    return item->row();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Number of children of parent available in the model. Rules not fetched yet have the first
+// batch of children available.
+int Lvk::FE::RuleTreeModel::fetchedCount(const BE::Rule *parent) const
+{
+    int count = parent->childCount();
+
+    if (parent == m_rootRule) {
+        return count;
+    }
+
+    return qMin(count, m_fetched.value(parent, FETCH_BATCH));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RuleTreeModel::fetchUpTo(BE::Rule *parent, int count)
+{
+    int fetched = fetchedCount(parent);
+
+    count = qMin(count, parent->childCount());
+
+    if (count <= fetched) {
+        return;
+    }
+
+    // The parent itself must be available before its children
+    fetchItem(parent);
+
+    QModelIndex parentIndex = parent != m_rootRule ?
+                createIndex(rowForItem(parent), 0, parent) : QModelIndex();
+
+    beginInsertRows(parentIndex, fetched, count - 1);
+    m_fetched.insert(parent, count);
+    endInsertRows();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::RuleTreeModel::fetchItem(const BE::Rule *item)
+{
+    BE::Rule *parent = const_cast<BE::Rule *>(item->parent());
+
+    if (parent && item != m_rootRule) {
+        fetchItem(parent);
+        fetchUpTo(parent, rowForItem(item) + 1);
     }
+}
+
+//--------------------------------------------------------------------------------------------------
 
-    return 0;
+bool Lvk::FE::RuleTreeModel::isFetched(const BE::Rule *item) const
+{
+    for (; item && item != m_rootRule; item = item->parent()) {
+        if (!item->parent() || rowForItem(item) >= fetchedCount(item->parent())) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -503,13 +629,26 @@ void Lvk::FE::RuleTreeModel::updateCheckStateOnParent(BE::Rule *item, Qt::CheckS
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::RuleTreeModel::updateItem(const BE::Rule *item)
+{
+    if (item && isFetched(item)) {
+        QModelIndex index = indexFromItem(item);
+        emit dataChanged(index, index);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::RuleTreeModel::setCheckState(BE::Rule *item, Qt::CheckState state)
 {
     if (item->checkState() != state) {
         item->setCheckState(state);
 
-        QModelIndex index = indexFromItem(item);
-        emit dataChanged(index, index);
+        // Rows not fetched yet get the new state when they are fetched
+        if (isFetched(item)) {
+            QModelIndex index = indexFromItem(item);
+            emit dataChanged(index, index);
+        }
     }
 }
 
@@ -540,6 +679,9 @@ bool Lvk::FE::RuleTreeModel::dropMimeData(const QMimeData *data, Qt::DropAction
 
         BE::Rule *parentItem = itemFromIndex(parent);
 
+        // Dropped rows are appended after all existing rows
+        fetchUpTo(parentItem, parentItem->childCount());
+
         // Ordinary items cannot be dropped on the root rule
         if (ruleType == BE::Rule::OrdinaryRule && parentItem == m_rootRule) {
             throw QString("RuleTreeModel: Drop not allowed type #1");
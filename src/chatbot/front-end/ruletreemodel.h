@@ -23,6 +23,7 @@
 #define LVK_FE_RULETREEMODEL_H
 
 #include <QAbstractItemModel>
+#include <QHash>
 
 namespace Lvk
 {
@@ -51,6 +52,9 @@ namespace FE
  *
  * This class is most commonly used with QTreeView to display a tree of rules.
  *
+ * Children of the root rule are always available. Children of other rules are fetched in
+ * batches as the view needs them, see canFetchMore() and fetchMore().
+ *
  * \see BE::Rule
  */
 
@@ -107,6 +111,16 @@ public:
      */
     virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
 
+    /**
+     * Returns true if there are more children of \a parent to fetch. Otherwise; returns false.
+     */
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+
+    /**
+     * Fetches the next batch of children of \a parent.
+     */
+    virtual void fetchMore(const QModelIndex &parent);
+
     /**
      * Returns the item flags for the given \a index.
      */
@@ -179,10 +193,16 @@ public:
     QModelIndex index(int row, int column, BE::Rule *parent) const;
 
     /**
-     * Returns the model index of the \a item.
+     * Returns the model index of the \a item. The item and its ancestors are fetched if needed.
      */
     QModelIndex indexFromItem(const BE::Rule *item);
 
+    /**
+     * Notifies views that the data of \a item has changed. If the item has not been fetched
+     * yet, this method does nothing.
+     */
+    void updateItem(const BE::Rule *item);
+
     /**
      * Appends the given \a item in the model with the given \a parent
      * If the item has no parent, the item is not inserted.
@@ -190,6 +210,13 @@ public:
      */
     bool appendItem(BE::Rule *item, BE::Rule *parent);
 
+    /**
+     * Appends the given \a items in the model with the given \a parent. Views are notified
+     * once for all items. If the items have no parent, they are not inserted.
+     * Returns true if the items are appended. Otherwise; false.
+     */
+    bool appendItems(const QList<BE::Rule *> &items, BE::Rule *parent);
+
     /**
      * Removes all rows in the given \a parent.
      */
@@ -234,6 +261,10 @@ private:
     RuleTreeModel& operator=(RuleTreeModel&);
 
     int rowForItem(const BE::Rule *item) const;
+    int fetchedCount(const BE::Rule *parent) const;
+    void fetchUpTo(BE::Rule *parent, int count);
+    void fetchItem(const BE::Rule *item);
+    bool isFetched(const BE::Rule *item) const;
     int columnCountForItem(const BE::Rule *item) const;
     QVariant dataForItem(const BE::Rule *item, int column, int role) const;
     bool setDataForItem(BE::Rule *item, const QVariant &value, int column, int role);
@@ -243,6 +274,7 @@ private:
     void setCheckState(BE::Rule *item, Qt::CheckState state);
 
     BE::Rule *m_rootRule;
+    QHash<const BE::Rule *, int> m_fetched; // Number of fetched children if not the default
     bool m_isUserCheckable;
     bool m_dropAccepted;
 };
@@ -24,6 +24,8 @@
 
 #include <QMenu>
 #include <QMessageBox>
+#include <QScrollBar>
+#include <QSet>
 
 enum ScriptsTableColumns
 {
@@ -71,6 +73,7 @@ Lvk::FE::ScriptCoverageWidget::ScriptCoverageWidget(QWidget *parent)
       ui(new Ui::ScriptCoverageWidget),
       m_detective(tr("Detective")),
       m_root(0),
+      m_shownScript(-1),
       m_collapseDef(false), // Collapse rule defintion column when it is not used
       m_categoryVisible(false)
 {
@@ -209,20 +212,81 @@ void Lvk::FE::ScriptCoverageWidget::setAnalyzedScripts(const Clue::AnalyzedList
     m_scripts = scripts;
     m_root = root; // CHECK deep copy? !!!
 
-    float globalCov = 0.0;
     int i = 0;
 
     ui->scriptsTable->setSortingEnabled(false);
 
     foreach (const Clue::AnalyzedScript &s, scripts) {
         addScriptRow(i++, s.filename, s.coverage);
-        globalCov += s.coverage;
     }
 
     ui->scriptsTable->setSortingEnabled(true);
 
-    if (scripts.size() > 0) {
-        globalCov /= scripts.size();
+    updateGlobalCoverage();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Clue::AnalyzedList &Lvk::FE::ScriptCoverageWidget::analyzedScripts() const
+{
+    return m_scripts;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::ScriptCoverageWidget::updateAnalyzedScripts(const Clue::AnalyzedList &scripts,
+                                                          const Clue::LineIndexList &changed)
+{
+    if (changed.isEmpty()) {
+        return;
+    }
+
+    m_scripts = scripts;
+
+    QSet<int> changedScripts;
+
+    for (int k = 0; k < changed.size(); ++k) {
+        int i = changed[k].first;
+        int j = changed[k].second;
+
+        changedScripts.insert(i);
+
+        QHash<int, QStringList>::iterator it = m_linesHtml.find(i);
+        if (it != m_linesHtml.end()) {
+            (*it)[j] = lineHtml(i, j);
+        }
+    }
+
+    // Rows are sorted by the user, look them up by script index
+    for (int r = 0; r < ui->scriptsTable->rowCount(); ++r) {
+        int i = ui->scriptsTable->item(r, ScriptNameCol)->data(ScriptIdRole).toInt();
+
+        if (changedScripts.contains(i)) {
+            ui->scriptsTable->item(r, ScriptCoverageCol)->setText(covFormat(m_scripts[i].coverage));
+        }
+    }
+
+    updateGlobalCoverage();
+
+    if (changedScripts.contains(m_shownScript)) {
+        int scrollPos = ui->scriptView->verticalScrollBar()->value();
+        showScript(m_shownScript);
+        ui->scriptView->verticalScrollBar()->setValue(scrollPos);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::ScriptCoverageWidget::updateGlobalCoverage()
+{
+    float globalCov = 0.0;
+
+    foreach (const Clue::AnalyzedScript &s, m_scripts) {
+        globalCov += s.coverage;
+    }
+
+    if (m_scripts.size() > 0) {
+        globalCov /= m_scripts.size();
         ui->coverageLabel->setText(tr("Global coverage: ") + covFormat(globalCov));
     } else {
         ui->coverageLabel->clear();
@@ -269,6 +333,8 @@ void Lvk::FE::ScriptCoverageWidget::clear()
 {
     m_root = 0;
     m_scripts.clear();
+    m_linesHtml.clear();
+    m_shownScript = -1;
 
     ui->scriptsTable->clearContents();
     ui->scriptsTable->setRowCount(0);
@@ -321,6 +387,8 @@ void Lvk::FE::ScriptCoverageWidget::showScript(int i)
 {
     qDebug() << "ScriptCoverageWidget: Showing script #" << i;
 
+    m_shownScript = i;
+
     if (i < 0 || i >= m_scripts.size()) {
         ui->scriptView->setHtml(tr("Error: Wrong script index"));
         return;
@@ -330,31 +398,44 @@ void Lvk::FE::ScriptCoverageWidget::showScript(int i)
         return;
     }
 
-    QString html = HTML_SCRIPT_START;
-    QString linePattern;
-
-    for (int j = 0; j < m_scripts[i].size(); ++j) {
-        const Clue::AnalyzedLine &line = m_scripts[i][j];
-        const QString &character = m_scripts[i].character;
+    QHash<int, QStringList>::iterator it = m_linesHtml.find(i);
 
-        if (line.outputIdx != -1) {
-            linePattern = HTML_SCRIPT_LINE_OK;
-        } else if (line.ruleId != 0) {
-            linePattern = HTML_SCRIPT_LINE_ERR1;
-        } else {
-            linePattern = HTML_SCRIPT_LINE_ERR2;
+    if (it == m_linesHtml.end()) {
+        QStringList lines;
+        for (int j = 0; j < m_scripts[i].size(); ++j) {
+            lines.append(lineHtml(i, j));
         }
-
-        html += linePattern.arg(m_detective, line.question, character, line.answer).arg(i).arg(j);
+        it = m_linesHtml.insert(i, lines);
     }
 
-    html += HTML_SCRIPT_END;
+    QString html = HTML_SCRIPT_START + it->join("") + HTML_SCRIPT_END;
 
     ui->scriptView->setHtml(html);
 }
 
 //--------------------------------------------------------------------------------------------------
 
+QString Lvk::FE::ScriptCoverageWidget::lineHtml(int i, int j) const
+{
+    const Clue::AnalyzedLine &line = m_scripts[i][j];
+    const QString &character = m_scripts[i].character;
+
+    const QString *linePattern;
+
+    if (line.outputIdx != -1) {
+        linePattern = &HTML_SCRIPT_LINE_OK;
+    } else if (line.ruleId != 0) {
+        linePattern = &HTML_SCRIPT_LINE_ERR1;
+    } else {
+        linePattern = &HTML_SCRIPT_LINE_ERR2;
+    }
+
+    return linePattern->arg(m_detective, line.question, character, line.answer,
+                            QString::number(i), QString::number(j));
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::ScriptCoverageWidget::showRuleUsed(int i, int j)
 {
     if (i >= m_scripts.size() || j >= m_scripts[i].size()) {
@@ -435,6 +516,10 @@ const Lvk::BE::Rule *Lvk::FE::ScriptCoverageWidget::findRule(quint64 ruleId)
         return 0;
     }
 
+    if (ruleId != 0 && m_root->tracker()) {
+        return m_root->tracker()->rule(ruleId);
+    }
+
     for (BE::Rule::const_iterator it = m_root->begin(); it != m_root->end(); ++it) {
         if (ruleId != 0) {
             if ((*it)->id() == ruleId) {
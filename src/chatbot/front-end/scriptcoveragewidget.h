@@ -27,6 +27,8 @@
 
 #include <QWidget>
 #include <QList>
+#include <QHash>
+#include <QStringList>
 
 class QModelIndex;
 class QUrl;
@@ -85,6 +87,18 @@ public:
      */
     void setAnalyzedScripts(const Clue::AnalyzedList &scripts, const BE::Rule *root);
 
+    /**
+     * Returns the list of analyzed scripts currently displayed
+     */
+    const Clue::AnalyzedList &analyzedScripts() const;
+
+    /**
+     * Displays \a scripts, an update of the analyzed scripts currently displayed where only the
+     * lines in \a changed have changed. Only the affected rows and lines are refreshed.
+     */
+    void updateAnalyzedScripts(const Clue::AnalyzedList &scripts,
+                               const Clue::LineIndexList &changed);
+
     /**
      * Returns the index of the currently selected script
      */
@@ -131,6 +145,8 @@ private:
 
     Ui::ScriptCoverageWidget *ui;
     Clue::AnalyzedList m_scripts;
+    QHash<int, QStringList> m_linesHtml;  // HTML of each line, by script index
+    int m_shownScript;
     QString m_detective;
     const BE::Rule *m_root;
     QList<int> m_sizes;
@@ -141,6 +157,8 @@ private:
     void connectSignals();
     void addScriptRow(int i, const QString &filename, float coverage);
     void showScript(int i);
+    QString lineHtml(int i, int j) const;
+    void updateGlobalCoverage();
     void showRuleUsed(int i, int j);
     void showHint(const QString &hint);
     void showRuleUsedColumn(bool show);
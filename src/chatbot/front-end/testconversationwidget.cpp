@@ -20,49 +20,55 @@
  */
 
 #include "front-end/testconversationwidget.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
 
 #include <QScrollBar>
+#include <QTextCursor>
+#include <QTextCharFormat>
 
 //--------------------------------------------------------------------------------------------------
 // TestConversationWidget
 //--------------------------------------------------------------------------------------------------
 
+// Each conversation is a block of the document. Blocks are appended at the end and the oldest
+// ones are removed by the document once the maximum is reached, so appending does not depend
+// on the length of the test session.
 Lvk::FE::TestConversationWidget::TestConversationWidget(QWidget *parent) :
     QTextEdit(parent)
 {
+    document()->setMaximumBlockCount(Cmn::SettingsSnapshot::current()
+                                     .intValue(SETTING_MAIN_WINDOW_TEST_MAX_ENTRIES));
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::FE::TestConversationWidget::appendConversation(const QString &userInput,
-                                                         const QString &botOuput_, bool match)
+                                                         const QString &botOuput, bool match)
 {
-    QString botOuput = botOuput_;
+    Q_UNUSED(match);
 
-    static const QString START_USER_SPAN = "<span style=\" color:#000088;\">";
-    static const QString START_CHATBOT_SPAN = "<span style=\" color:#008800;\">";
-    //static const QString START_NOT_MATCH_SPAN = "<span style=\" color:#880000;\">";
-    static const QString END_SPAN = "</span>";
-    static const QString BR = "<br/>";
-    static const QString END_P_BODY_HTML = "</p></body></html>";
+    QTextCharFormat userFormat;
+    userFormat.setForeground(QColor(0x00, 0x00, 0x88));
 
-    if (!match) {
-        //botOuput = START_NOT_MATCH_SPAN + botOuput + END_SPAN;
-    }
-
-    QString conversation = toHtml();
+    QTextCharFormat chatbotFormat;
+    chatbotFormat.setForeground(QColor(0x00, 0x88, 0x00));
 
-    conversation.remove(END_P_BODY_HTML);
-    conversation += START_USER_SPAN + tr("Me:") + " " + END_SPAN + userInput + BR;
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
 
-    if (!botOuput_.isEmpty()) {
-        conversation += START_CHATBOT_SPAN + tr("Chatbot:") + " " + END_SPAN + botOuput + BR;
+    if (!document()->isEmpty()) {
+        cursor.insertBlock();
     }
 
-    conversation += END_P_BODY_HTML;
+    cursor.insertText(tr("Me:") + " ", userFormat);
+    cursor.insertText(userInput, QTextCharFormat());
 
-    setHtml(conversation);
+    if (!botOuput.isEmpty()) {
+        cursor.insertText(QString(QChar::LineSeparator));
+        cursor.insertText(tr("Chatbot:") + " ", chatbotFormat);
+        cursor.insertText(botOuput, QTextCharFormat());
+    }
 
     verticalScrollBar()->setValue(verticalScrollBar()->maximum());
 }
-
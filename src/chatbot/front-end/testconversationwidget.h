@@ -43,6 +43,8 @@ namespace FE
  *        the chatbot.
  *
  * By "test conversation" we mean tests that were performed in the "Test" tab.
+ *
+ * Only the last conversations are kept. See SETTING_MAIN_WINDOW_TEST_MAX_ENTRIES.
  */
 class TestConversationWidget : public QTextEdit
 {
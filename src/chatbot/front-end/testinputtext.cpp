@@ -25,8 +25,11 @@
 #include <QContextMenuEvent>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QTimer>
 #include <algorithm>
 
+#define PREVIEW_DELAY   200    // Milliseconds without typing before the preview is requested
+
 //--------------------------------------------------------------------------------------------------
 // TestInputText
 //--------------------------------------------------------------------------------------------------
@@ -46,13 +49,41 @@ inline bool fullnameComp(const Lvk::BE::RosterItem &i1, const Lvk::BE::RosterIte
 //--------------------------------------------------------------------------------------------------
 
 Lvk::FE::TestInputText::TestInputText(QWidget *parent)
-    : QLineEdit(parent), m_anyUser(tr("Any user")), m_histIndex(0)
+    : QLineEdit(parent), m_anyUser(tr("Any user")), m_histIndex(0),
+      m_previewTimer(new QTimer(this)), m_previewEnabled(false)
 {
+    m_previewTimer->setSingleShot(true);
+    m_previewTimer->setInterval(PREVIEW_DELAY);
+
+    connect(m_previewTimer, SIGNAL(timeout()), SIGNAL(previewRequested()));
+    connect(this, SIGNAL(textEdited(QString)), SLOT(onTextEdited()));
+
     clearAll();
 }
 
 //--------------------------------------------------------------------------------------------------
 
+void Lvk::FE::TestInputText::setPreviewEnabled(bool enabled)
+{
+    m_previewEnabled = enabled;
+
+    if (!enabled) {
+        m_previewTimer->stop();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::FE::TestInputText::onTextEdited()
+{
+    // Restart the timer, so only the last keystroke of a burst requests a preview
+    if (m_previewEnabled) {
+        m_previewTimer->start();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::FE::TestInputText::setRoster(const BE::Roster &roster)
 {
     m_roster = roster;
@@ -114,6 +145,7 @@ void Lvk::FE::TestInputText::keyPressEvent(QKeyEvent *event)
         }
         if (!t.isEmpty()) {
             m_histIndex = m_history.size();
+            m_previewTimer->stop();
             emit testInputEntered();
         }
         break;
@@ -124,15 +156,18 @@ void Lvk::FE::TestInputText::keyPressEvent(QKeyEvent *event)
                 m_tmpCurrent = t;
             }
             setText(m_history[--m_histIndex]);
+            onTextEdited();
         }
         break;
 
     case Qt::Key_Down:
         if (m_histIndex < m_history.size() - 1) {
             setText(m_history[++m_histIndex]);
+            onTextEdited();
         } else if (m_histIndex == m_history.size() - 1) {
             ++m_histIndex;
             setText(m_tmpCurrent);
+            onTextEdited();
         }
         break;
     }
@@ -176,6 +211,7 @@ void Lvk::FE::TestInputText::clear()
 {
     QLineEdit::clear();
     m_tmpCurrent.clear();
+    m_previewTimer->stop();
 }
 
 //--------------------------------------------------------------------------------------------------
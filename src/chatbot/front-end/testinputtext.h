@@ -27,6 +27,8 @@
 #include <QLineEdit>
 #include <QStringList>
 
+class QTimer;
+
 namespace Lvk
 {
 
@@ -63,17 +65,26 @@ public:
 
     BE::RosterItem currentItem();
 
+    /**
+     * Enables or disables the preview mode. In preview mode the signal previewRequested()
+     * is emitted shortly after the user stops typing. By default it is disabled.
+     */
+    void setPreviewEnabled(bool enabled);
+
 signals:
     void currentItemChanged();
 
     void testInputEntered();
 
+    void previewRequested();
+
 protected:
     void contextMenuEvent(QContextMenuEvent *event);
     void keyPressEvent(QKeyEvent *event);
 
 private slots:
     void onSimulateUser();
+    void onTextEdited();
 
 private:
     QString m_anyUser;
@@ -83,6 +94,8 @@ private:
     QStringList m_history;
     int m_histIndex;
     QString m_tmpCurrent;
+    QTimer *m_previewTimer;
+    bool m_previewEnabled;
 };
 
 /// @}
@@ -22,15 +22,25 @@
 #include <QApplication>
 #include <QTranslator>
 #include <QDir>
+#include <QFileInfo>
 #include <QDebug>
 #include <iostream>
 
 #include "main/windowbootstrap.h"
+#include "back-end/rulecompiler.h"
+#include "back-end/phraseminer.h"
 #include "common/version.h"
 #include "common/settings.h"
 #include "common/settingskeys.h"
 #include "common/logger.h"
 #include "common/crashhandler.h"
+#include "common/memorymanager.h"
+#include "common/maintenancescheduler.h"
+#include "common/taskscheduler.h"
+#include "common/startuptimeline.h"
+#include "common/conversationparquetwriter.h"
+#include "chat-adapter/historyhelper.h"
+#include "nlp-engine/lemmatizerfactory.h"
 
 #ifdef DA_CONTEST
 # include "da-clue/batchanalyzer.h"
@@ -43,6 +53,21 @@ struct CmdLineOptions
     QString chatbotFilename;
     bool isBatchMode;
     QString batchTarget;
+    int jobs;
+    bool useCache;
+    QString reportFilename;
+    bool isBatchWorker;
+    QString workerList;
+    QString workerOutput;
+    bool isCompileMode;
+    QString compileTarget;
+    QString compileOutput;
+    bool profileRules;
+    bool isMineMode;
+    QString mineTarget;
+    int top;
+    bool isExportMode;
+    QString exportTarget;
 };
 
 void getCmdLineOptions(CmdLineOptions &opt);
@@ -51,6 +76,7 @@ void showSyntax();
 void setLanguage();
 void makeDir(const QString &name);
 void showWindow(int argc, char *argv[]);
+int exportHistory(const QString &historyFilename, const QString &outputFilename);
 
 
 //--------------------------------------------------------------------------------------------------
@@ -63,6 +89,8 @@ int main(int argc, char *argv[])
     QApplication::setOrganizationDomain(ORGANIZATION_DOMAIN);
     QApplication::setApplicationName(APP_NAME);
 
+    Lvk::Cmn::StartupTimeline::start();
+
     QApplication app(argc, argv);
 
     CmdLineOptions opt;
@@ -74,19 +102,57 @@ int main(int argc, char *argv[])
 
     Lvk::Cmn::Logger::setVerboseLevel(opt.verboseLevel);
     Lvk::Cmn::Logger::init();
+    Lvk::Cmn::MemoryManager::init();
+    Lvk::Cmn::MaintenanceScheduler::init();
+    Lvk::Cmn::TaskScheduler::init();
 
     setLanguage();
 
     int exitCode = 0;
 
     if (opt.valid) {
-        if (opt.isBatchMode) {
+        if (opt.isCompileMode) {
+            Lvk::BE::RuleCompiler rc;
+            rc.setOutputFile(opt.compileOutput);
+            rc.setReportFile(opt.reportFilename);
+            if (opt.profileRules) {
+                rc.setProfileRules(true, opt.top > 0 ? opt.top : 10);
+            }
+            exitCode = rc.exec(opt.compileTarget);
+        } else if (opt.isMineMode) {
+            Lvk::BE::PhraseMiner pm;
+            if (opt.jobs > 0) {
+                pm.setJobs(opt.jobs);
+            }
+            if (opt.top > 0) {
+                pm.setTopCount(opt.top);
+            }
+            pm.setReportFile(opt.reportFilename);
+            exitCode = pm.exec(opt.mineTarget);
+        } else if (opt.isExportMode) {
+            exitCode = exportHistory(opt.exportTarget, opt.compileOutput);
+        } else if (opt.isBatchMode) {
+#ifdef DA_CONTEST
+            Lvk::Clue::BatchAnalyzer ba;
+            ba.setJobs(qMax(1, opt.jobs));
+            ba.setCacheEnabled(opt.useCache);
+            ba.setReportFile(opt.reportFilename);
+            exitCode = ba.exec(opt.batchTarget);
+#endif // DA_CONTEST
+        } else if (opt.isBatchWorker) {
 #ifdef DA_CONTEST
-            exitCode = Lvk::Clue::BatchAnalyzer().exec(opt.batchTarget);
+            exitCode = Lvk::Clue::BatchAnalyzer().execWorker(opt.workerList, opt.workerOutput);
 #endif // DA_CONTEST
         } else {
             Lvk::Cmn::CrashHandler::init();
+            Lvk::Nlp::LemmatizerFactory().preloadLemmatizer();
             WindowBootstrap wb(opt.chatbotFilename);
+            qDebug() << "Window shown" << Lvk::Cmn::StartupTimeline::elapsed()
+                     << "ms after launch";
+            if (opt.chatbotFilename.isEmpty()) {
+                // Otherwise, the timeline finishes once the file is loaded
+                Lvk::Cmn::StartupTimeline::finish();
+            }
             exitCode = app.exec();
         }
     } else {
@@ -106,6 +172,14 @@ void getCmdLineOptions(CmdLineOptions & opt)
     opt.valid = true;
     opt.verboseLevel = QtWarningMsg;
     opt.isBatchMode = false;
+    opt.jobs = 0;
+    opt.useCache = true;
+    opt.isBatchWorker = false;
+    opt.isCompileMode = false;
+    opt.profileRules = false;
+    opt.isMineMode = false;
+    opt.top = 0;
+    opt.isExportMode = false;
 
     QStringList args = QApplication::arguments();
 
@@ -114,6 +188,62 @@ void getCmdLineOptions(CmdLineOptions & opt)
         if (arg.startsWith("--verbose=")) {
             QStringList tokens = arg.split("=");
             opt.verboseLevel = static_cast<QtMsgType>(QtFatalMsg - tokens[1].toInt(&opt.valid));
+        } else if (arg == "--compile") {
+            ++i;
+            if (i < args.size()) {
+                opt.isCompileMode = true;
+                opt.compileTarget = args[i];
+            } else {
+                opt.valid = false;
+            }
+        } else if (arg == "--output") {
+            ++i;
+            if (i < args.size()) {
+                opt.compileOutput = args[i];
+            } else {
+                opt.valid = false;
+            }
+        } else if (arg == "--profile-rules") {
+            opt.profileRules = true;
+        } else if (arg == "--report") {
+            ++i;
+            if (i < args.size()) {
+                opt.reportFilename = args[i];
+            } else {
+                opt.valid = false;
+            }
+        } else if (arg == "--mine") {
+            ++i;
+            if (i < args.size()) {
+                opt.isMineMode = true;
+                opt.mineTarget = args[i];
+            } else {
+                opt.valid = false;
+            }
+        } else if (arg == "--export-history") {
+            ++i;
+            if (i < args.size()) {
+                opt.isExportMode = true;
+                opt.exportTarget = args[i];
+            } else {
+                opt.valid = false;
+            }
+        } else if (arg == "--top") {
+            ++i;
+            if (i < args.size()) {
+                opt.top = args[i].toInt(&opt.valid);
+                opt.valid = opt.valid && opt.top >= 1;
+            } else {
+                opt.valid = false;
+            }
+        } else if (arg == "--jobs") {
+            ++i;
+            if (i < args.size()) {
+                opt.jobs = args[i].toInt(&opt.valid);
+                opt.valid = opt.valid && opt.jobs >= 1;
+            } else {
+                opt.valid = false;
+            }
 #ifdef DA_CONTEST
         } else if (arg == "--batch-mode") {
             ++i;
@@ -123,6 +253,17 @@ void getCmdLineOptions(CmdLineOptions & opt)
             } else {
                 opt.valid = false;
             }
+        } else if (arg == "--no-cache") {
+            opt.useCache = false;
+        } else if (arg == BATCH_WORKER_OPTION) {
+            i += 2;
+            if (i < args.size()) {
+                opt.isBatchWorker = true;
+                opt.workerList = args[i - 1];
+                opt.workerOutput = args[i];
+            } else {
+                opt.valid = false;
+            }
 #endif // DA_CONTEST
         } else if (!arg.startsWith("-")) {
             opt.chatbotFilename = arg;
@@ -130,6 +271,29 @@ void getCmdLineOptions(CmdLineOptions & opt)
             qWarning() << QObject::tr("Warning: Unknown option") << arg;
         }
     }
+
+    // Paths are relative to the dir the app was launched from, main() changes it later
+    if (opt.isCompileMode) {
+        opt.compileTarget = QFileInfo(opt.compileTarget).absoluteFilePath();
+        if (!opt.compileOutput.isEmpty()) {
+            opt.compileOutput = QFileInfo(opt.compileOutput).absoluteFilePath();
+        }
+        if (!opt.reportFilename.isEmpty()) {
+            opt.reportFilename = QFileInfo(opt.reportFilename).absoluteFilePath();
+        }
+    }
+    if (opt.isMineMode) {
+        opt.mineTarget = QFileInfo(opt.mineTarget).absoluteFilePath();
+        if (!opt.reportFilename.isEmpty()) {
+            opt.reportFilename = QFileInfo(opt.reportFilename).absoluteFilePath();
+        }
+    }
+    if (opt.isExportMode) {
+        opt.exportTarget = QFileInfo(opt.exportTarget).absoluteFilePath();
+        if (!opt.compileOutput.isEmpty()) {
+            opt.compileOutput = QFileInfo(opt.compileOutput).absoluteFilePath();
+        }
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -141,16 +305,64 @@ void showSyntax()
     std::cerr << QObject::tr("Error: Invalid command line arguments.").toUtf8().data() << std::endl;
     std::cout << QObject::tr("Syntax: ").toUtf8().data() << std::endl;
     std::cout << QObject::tr("   %1 [chatbot_file]").arg(appname).toUtf8().data() << std::endl;
+    std::cout << QObject::tr("   %1 --compile <chatbot_file> [--output <file.snap>] "
+                             "[--profile-rules [--top N]] [--report <file.json>]").arg(appname)
+                 .toUtf8().data() << std::endl;
+    std::cout << QObject::tr("   %1 --mine <chatbot_file> [--jobs N] [--top N] "
+                             "[--report <file.jsonl> | <file.csv>]").arg(appname).toUtf8()
+                 .data() << std::endl;
+    std::cout << QObject::tr("   %1 --export-history <history_file> [--output <file.parquet>]")
+                 .arg(appname).toUtf8().data() << std::endl;
 #ifdef DA_CONTEST
-    std::cout << QObject::tr("   %1 --batch-mode <dir> | <chatbot_file>").arg(appname).toUtf8()
+    std::cout << QObject::tr("   %1 --batch-mode <dir> | <chatbot_file> [--jobs N] [--no-cache] "
+                             "[--report <file.jsonl> | <file.csv>]").arg(appname).toUtf8()
                  .data() << std::endl;
 #endif // DA_CONTEST
 }
 
 //--------------------------------------------------------------------------------------------------
 
+// Streams the history file into a Parquet file. Removed entries are not exported.
+int exportHistory(const QString &historyFilename, const QString &outputFilename)
+{
+    if (!QFileInfo(historyFilename).exists()) {
+        std::cerr << QObject::tr("Error: Cannot open %1").arg(historyFilename).toUtf8().data()
+                  << std::endl;
+        return 1;
+    }
+
+    QString output = outputFilename.isEmpty() ? historyFilename + ".parquet" : outputFilename;
+
+    Lvk::CA::HistoryHelper::Reader reader(historyFilename);
+    Lvk::Cmn::ConversationParquetWriter writer(output);
+    Lvk::Cmn::Conversation::Entry entry;
+
+    bool success = true;
+
+    while (success && reader.next(entry)) {
+        success = writer.write(entry);
+    }
+
+    success = writer.close() && success;
+
+    if (!success) {
+        std::cerr << QObject::tr("Error: Cannot write %1").arg(output).toUtf8().data()
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << QObject::tr("%1 entries exported to %2").arg(writer.entryCount()).arg(output)
+                 .toUtf8().data() << std::endl;
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void setLanguage()
 {
+    LVK_STARTUP_PHASE("set_language");
+
     qDebug() << "Setting app language...";
 
     Lvk::Cmn::Settings settings;
@@ -180,6 +392,8 @@ void setLanguage()
 
 void makeDirStructure()
 {
+    LVK_STARTUP_PHASE("make_dirs");
+
     Lvk::Cmn::Settings settings;
 
     makeDir(settings.value(SETTING_LOGS_PATH).toString());
@@ -23,6 +23,8 @@
 
 #include "front-end/mainwindow.h"
 
+#include <QMetaObject>
+
 #ifdef ENABLE_WELCOME_WINDOW
 # include "front-end/welcomewidget.h"
 #endif
@@ -39,6 +41,8 @@ public:
     /**
      * Constructs a WindowBootstrap class and opens the given file.
      * If no Chatbot file is provided the "welcome" window is displayed.
+     *
+     * The file is opened once the event loop starts, so the window is shown immediately.
      */
     WindowBootstrap(const QString &filename)
         : m_w(0)
@@ -46,7 +50,8 @@ public:
         if (!filename.isEmpty()) {
             m_w = new MainWindow();
             m_w->show();
-            dynamic_cast<MainWindow*>(m_w)->openFile(filename);
+            QMetaObject::invokeMethod(m_w, "openFile", Qt::QueuedConnection,
+                                      Q_ARG(QString, filename));
         } else {
             m_w = new WelcomeWindow();
             m_w->show();
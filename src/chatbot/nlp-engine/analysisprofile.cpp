@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/analysisprofile.h"
+#include "nlp-engine/toolchain.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QFile>
+#include <QHash>
+#include <QRegExp>
+#include <QStringList>
+#include <QTextStream>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtDebug>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct ModuleName
+{
+    Lvk::Nlp::AnalysisProfile::Module module;
+    const char *name;
+};
+
+const ModuleName s_moduleNames[] = {
+    { Lvk::Nlp::AnalysisProfile::Probabilities, "probabilities" },
+    { Lvk::Nlp::AnalysisProfile::Quantities,    "quantities"    },
+    { Lvk::Nlp::AnalysisProfile::Numbers,       "numbers"       },
+    { Lvk::Nlp::AnalysisProfile::Affixes,       "affixes"       },
+    { Lvk::Nlp::AnalysisProfile::Punctuation,   "punctuation"   },
+    { Lvk::Nlp::AnalysisProfile::Multiwords,    "multiwords"    }
+};
+
+const int s_moduleCount = sizeof(s_moduleNames)/sizeof(ModuleName);
+
+//--------------------------------------------------------------------------------------------------
+
+// Locutions of a language indexed by their first word. Each locution is stored as the list
+// of its remaining words.
+typedef QHash<QString, QList<QStringList> > LocutionIndex;
+
+QMutex s_locutionsMutex;
+QHash<QString, QSharedPointer<const LocutionIndex> > s_locutions;
+
+//--------------------------------------------------------------------------------------------------
+
+// Loads the locutions of the Freeling file locucions.dat. Returns a null pointer if the file
+// cannot be read. Patterns with lemmas or tags, i.e. "a_<lo>_mejor", are skipped since they
+// cannot be told apart from plain text without a full analysis.
+QSharedPointer<const LocutionIndex> loadLocutions(const QString &lang)
+{
+    QString filename = Lvk::Cmn::SettingsSnapshot::current().stringValue(SETTING_DATA_PATH)
+            + "/freeling/" + lang + "/locucions.dat";
+
+    QMutexLocker locker(&s_locutionsMutex);
+
+    if (s_locutions.contains(filename)) {
+        return s_locutions.value(filename);
+    }
+
+    QSharedPointer<LocutionIndex> index;
+
+    QFile file(filename);
+
+    if (file.open(QFile::ReadOnly)) {
+        index = QSharedPointer<LocutionIndex>(new LocutionIndex());
+
+        QTextStream in(&file);
+        in.setCodec("UTF-8");
+
+        while (!in.atEnd()) {
+            QString line = in.readLine().trimmed();
+
+            if (line.isEmpty() || line.startsWith('<') || line.startsWith('#')) {
+                continue;
+            }
+
+            QString form = line.section(' ', 0, 0);
+
+            if (!form.contains('_') || form.contains('<') || form.contains('(')) {
+                continue;
+            }
+
+            QStringList words = form.toLower().split('_', QString::SkipEmptyParts);
+            QString first = words.takeFirst();
+
+            (*index)[first].append(words);
+        }
+    } else {
+        qWarning() << "AnalysisProfile: Cannot read locutions file" << filename;
+    }
+
+    s_locutions[filename] = index;
+
+    return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns true if the sequence of words starting at i is a locution
+inline bool startsLocution(const QStringList &words, int i, const LocutionIndex &index)
+{
+    LocutionIndex::const_iterator it = index.find(words[i]);
+
+    if (it == index.end()) {
+        return false;
+    }
+
+    foreach (const QStringList &rest, *it) {
+        if (i + rest.size() >= words.size()) {
+            continue;
+        }
+
+        bool match = true;
+
+        for (int j = 0; j < rest.size() && match; ++j) {
+            match = words[i + j + 1] == rest[j];
+        }
+
+        if (match) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the words of a rule input, without variables and punctuation
+inline QStringList inputWords(const QString &input)
+{
+    QString s = input.toLower();
+
+    s.remove(QRegExp("\\[[^\\]]*\\]"));
+
+    return s.split(QRegExp("[^\\w]+"), QString::SkipEmptyParts);
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// AnalysisProfile
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::AnalysisProfile::AnalysisProfile(unsigned modules /*= AllModules*/)
+    : m_modules(modules & AllModules)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::AnalysisProfile Lvk::Nlp::AnalysisProfile::full()
+{
+    return AnalysisProfile(AllModules);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::AnalysisProfile Lvk::Nlp::AnalysisProfile::minimal()
+{
+    return AnalysisProfile(Affixes);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::AnalysisProfile Lvk::Nlp::AnalysisProfile::fromRules(const RuleList &rules,
+                                                               const QString &lang)
+{
+    // Cheap modules that change the lemma of common words are always kept
+    unsigned modules = Probabilities | Affixes | Punctuation;
+
+    QSharedPointer<const LocutionIndex> locutions =
+            loadLocutions(lang.isEmpty() ? Toolchain::defaultLanguage() : lang);
+
+    if (!locutions) {
+        modules |= Multiwords;
+    }
+
+    foreach (const Rule &rule, rules) {
+        foreach (const QString &input, rule.input()) {
+            QStringList words = inputWords(input);
+
+            for (int i = 0; i < words.size(); ++i) {
+                if (!(modules & Numbers) && words[i].contains(QRegExp("\\d"))) {
+                    modules |= Numbers | Quantities;
+                }
+                if (!(modules & Multiwords) && startsLocution(words, i, *locutions)) {
+                    modules |= Multiwords;
+                }
+            }
+
+            if (modules == AllModules) {
+                return AnalysisProfile(modules);
+            }
+        }
+    }
+
+    return AnalysisProfile(modules);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::AnalysisProfile Lvk::Nlp::AnalysisProfile::fromSettings(bool *automatic /*= 0*/)
+{
+    QString str = Cmn::SettingsSnapshot::current().stringValue(SETTING_NLP_ANALYSIS_PROFILE);
+
+    bool isAuto = str.trimmed().toLower() == "auto";
+
+    if (automatic) {
+        *automatic = isAuto;
+    }
+
+    return isAuto ? full() : fromString(str);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::AnalysisProfile Lvk::Nlp::AnalysisProfile::fromString(const QString &str,
+                                                                bool *ok /*= 0*/)
+{
+    QString s = str.trimmed().toLower();
+
+    if (ok) {
+        *ok = true;
+    }
+
+    if (s == "full") {
+        return full();
+    }
+    if (s == "minimal") {
+        return minimal();
+    }
+
+    unsigned modules = 0;
+
+    foreach (const QString &name, s.split(',', QString::SkipEmptyParts)) {
+        int i = 0;
+
+        while (i < s_moduleCount && name.trimmed() != s_moduleNames[i].name) {
+            ++i;
+        }
+
+        if (i == s_moduleCount) {
+            qWarning() << "AnalysisProfile: Unknown module" << name;
+            if (ok) {
+                *ok = false;
+            }
+            return full();
+        }
+
+        modules |= s_moduleNames[i].module;
+    }
+
+    return AnalysisProfile(modules);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::AnalysisProfile::toString() const
+{
+    if (isFull()) {
+        return "full";
+    }
+
+    QStringList names;
+
+    for (int i = 0; i < s_moduleCount; ++i) {
+        if (m_modules & s_moduleNames[i].module) {
+            names.append(s_moduleNames[i].name);
+        }
+    }
+
+    return names.join(",");
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_ANALYSISPROFILE_H
+#define LVK_NLP_ANALYSISPROFILE_H
+
+#include <QString>
+
+#include "nlp-engine/rule.h"
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The AnalysisProfile class provides the set of morphological analysis modules used
+ *        by the lemmatizer.
+ *
+ * Dictionary search is always performed. The other modules are optional: matching only
+ * uses the words and their lemmas, so a module is only worth its cost if some rule depends
+ * on it. For instance, multiword detection is only needed if rules contain locutions such as
+ * "a pesar de", and number and quantity detection only if rules contain numbers.
+ *
+ * Rules and user inputs must be analyzed with the same profile, hence profiles are part of
+ * the lemma cache and snapshot keys.
+ */
+class AnalysisProfile
+{
+public:
+
+    /**
+     * Optional analysis modules
+     */
+    enum Module
+    {
+        Probabilities   = 0x01,     ///< Lexical probabilities and guesser of unknown words
+        Quantities      = 0x02,     ///< Quantities, currencies and percentages
+        Numbers         = 0x04,     ///< Numbers written in digits or words
+        Affixes         = 0x08,     ///< Affixes and clitics, i.e. "dímelo"
+        Punctuation     = 0x10,     ///< Punctuation symbols
+        Multiwords      = 0x20,     ///< Locutions, i.e. "a pesar de"
+        AllModules      = 0x3f
+    };
+
+    /**
+     * Constructs a profile with the given \a modules, a combination of Module values.
+     * By default all modules are enabled.
+     */
+    AnalysisProfile(unsigned modules = AllModules);
+
+    /**
+     * Returns the profile with all modules enabled
+     */
+    static AnalysisProfile full();
+
+    /**
+     * Returns the cheapest profile that still lemmatizes inflected words and clitics
+     */
+    static AnalysisProfile minimal();
+
+    /**
+     * Returns the profile with the modules required by \a rules of language \a lang. If
+     * \a lang is empty, the language in the application settings is used. Modules that
+     * cannot be ruled out, i.e. if the locutions file of the language cannot be read, are
+     * enabled.
+     */
+    static AnalysisProfile fromRules(const RuleList &rules, const QString &lang = QString());
+
+    /**
+     * Returns the profile in the application settings. If the setting is "auto", the profile
+     * must be derived from the rules with fromRules(), sets \a automatic to true if it is not
+     * null and returns the full profile.
+     */
+    static AnalysisProfile fromSettings(bool *automatic = 0);
+
+    /**
+     * Parses \a str, either "full", "minimal" or a comma separated list of module names, i.e.
+     * "affixes,numbers". If \a ok is not null, it is set to false if \a str cannot be parsed,
+     * in which case the full profile is returned.
+     */
+    static AnalysisProfile fromString(const QString &str, bool *ok = 0);
+
+    /**
+     * Returns the profile as string. The string can be parsed with fromString()
+     */
+    QString toString() const;
+
+    /**
+     * Returns the enabled modules
+     */
+    unsigned modules() const { return m_modules; }
+
+    /**
+     * Returns true if \a module is enabled. Otherwise; returns false.
+     */
+    bool has(Module module) const { return m_modules & module; }
+
+    /**
+     * Returns true if all modules are enabled. Otherwise; returns false.
+     */
+    bool isFull() const { return m_modules == AllModules; }
+
+    /**
+     * Returns true if all modules of \a other are enabled in this profile. Otherwise; returns
+     * false.
+     */
+    bool contains(const AnalysisProfile &other) const
+    { return (m_modules & other.m_modules) == other.m_modules; }
+
+    bool operator==(const AnalysisProfile &other) const { return m_modules == other.m_modules; }
+
+    bool operator!=(const AnalysisProfile &other) const { return m_modules != other.m_modules; }
+
+private:
+    unsigned m_modules;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_ANALYSISPROFILE_H
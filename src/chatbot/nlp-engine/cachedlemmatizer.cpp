@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/cachedlemmatizer.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QDataStream>
+#include <QtDebug>
+
+#define LEMMA_CACHE_MAGIC_NUMBER        (('l'<<0) | ('c'<<8) | ('c'<<16) | ('\0'<<24))
+#define LEMMA_CACHE_FILE_FORMAT_VERSION 1
+#define LEMMA_CACHE_ENTRY_BYTES         1024    // Estimated size of a 4-word input and its words
+#define LEMMA_CACHE_SAVE_INTERVAL       600     // In seconds
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Reads words written with operator<<. Unlike operator>>, words are not interned: results of
+// user inputs are never interned, otherwise the symbol table would grow with every new word.
+void readWords(QDataStream &istream, QVector<Lvk::Nlp::Word> &words)
+{
+    quint32 size = 0;
+    istream >> size;
+
+    words.reserve(words.size() + size);
+
+    for (quint32 i = 0; i < size && istream.status() == QDataStream::Ok; ++i) {
+        Lvk::Nlp::Word w;
+        istream >> w.origWord >> w.normWord >> w.lemma >> w.posTag >> w.altSpells;
+        words.append(w);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Copies the words of a cached result
+inline void fromCached(const QVector<Lvk::Nlp::Word> &cached, Lvk::Nlp::WordList &words)
+{
+    words.clear();
+    words.reserve(cached.size());
+
+    for (int i = 0; i < cached.size(); ++i) {
+        words.append(cached.at(i));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns a compact copy of words to insert in the cache
+inline QVector<Lvk::Nlp::Word> *toCached(const Lvk::Nlp::WordList &words)
+{
+    QVector<Lvk::Nlp::Word> *cached = new QVector<Lvk::Nlp::Word>();
+    cached->reserve(words.size());
+
+    for (int i = 0; i < words.size(); ++i) {
+        cached->append(words.at(i));
+    }
+
+    return cached;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// CachedLemmatizer
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::CachedLemmatizer::CachedLemmatizer(Lemmatizer *lemmatizer, int maxSize)
+    : m_lemmatizer(lemmatizer),
+      m_cacheMutex(new QMutex()),
+      m_lemmaMutex(new QMutex()),
+      m_hits(0),
+      m_misses(0),
+      m_unsaved(0)
+{
+    if (maxSize < 0) {
+        maxSize = Cmn::SettingsSnapshot::current().value(SETTING_NLP_LEMMA_CACHE_SIZE).toInt();
+    }
+
+    m_cache.setMaxCost(maxSize);
+
+    Cmn::MemoryManager::manager()->add(this, "lemmaCache", Cmn::MemoryManager::CachePriority);
+    Cmn::MaintenanceScheduler::scheduler()->add(this, "lemmaCache", LEMMA_CACHE_SAVE_INTERVAL);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::CachedLemmatizer::~CachedLemmatizer()
+{
+    Cmn::MemoryManager::manager()->remove(this);
+    Cmn::MaintenanceScheduler::scheduler()->remove(this);
+
+    if (!m_persistentFile.isEmpty()) {
+        save(m_persistentFile, m_persistentKey);
+    }
+
+    delete m_lemmaMutex;
+    delete m_cacheMutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::CachedLemmatizer::tokenize(const QString &input, QStringList &l)
+{
+    QMutexLocker locker(m_lemmatizer->isThreadSafe() ? 0 : m_lemmaMutex);
+
+    m_lemmatizer->tokenize(input, l);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::CachedLemmatizer::lemmatize(const QString &input, Nlp::WordList &l)
+{
+    {
+        QMutexLocker locker(m_cacheMutex);
+
+        if (const CachedWords *cached = m_cache.object(input)) {
+            ++m_hits;
+            fromCached(*cached, l);
+            return;
+        }
+
+        ++m_misses;
+    }
+
+    // The cache is not locked meanwhile, so other threads can still get cached results
+
+    {
+        QMutexLocker locker(m_lemmatizer->isThreadSafe() ? 0 : m_lemmaMutex);
+
+        m_lemmatizer->lemmatize(input, l);
+    }
+
+    QMutexLocker locker(m_cacheMutex);
+
+    m_cache.insert(input, toCached(l));
+    ++m_unsaved;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::CachedLemmatizer::lemmatizeBatch(const QStringList &inputs,
+                                                QList<Nlp::WordList> &l)
+{
+    l.clear();
+
+    QStringList missed;
+    QList<int> missedIdx;
+
+    {
+        QMutexLocker locker(m_cacheMutex);
+
+        for (int i = 0; i < inputs.size(); ++i) {
+            if (const CachedWords *cached = m_cache.object(inputs[i])) {
+                ++m_hits;
+                l.append(Nlp::WordList());
+                fromCached(*cached, l.last());
+            } else {
+                ++m_misses;
+                l.append(Nlp::WordList());
+                missed.append(inputs[i]);
+                missedIdx.append(i);
+            }
+        }
+    }
+
+    if (missed.isEmpty()) {
+        return;
+    }
+
+    QList<Nlp::WordList> missedWords;
+
+    {
+        QMutexLocker locker(m_lemmatizer->isThreadSafe() ? 0 : m_lemmaMutex);
+
+        m_lemmatizer->lemmatizeBatch(missed, missedWords);
+    }
+
+    QMutexLocker locker(m_cacheMutex);
+
+    for (int i = 0; i < missed.size() && i < missedWords.size(); ++i) {
+        l[missedIdx[i]] = missedWords[i];
+        m_cache.insert(missed[i], toCached(missedWords[i]));
+        ++m_unsaved;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::CachedLemmatizer::isThreadSafe() const
+{
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::CachedLemmatizer::hits() const
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    return m_hits;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::CachedLemmatizer::misses() const
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    return m_misses;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::CachedLemmatizer::size() const
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    return m_cache.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::CachedLemmatizer::maxSize() const
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    return m_cache.maxCost();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::CachedLemmatizer::clear()
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    m_cache.clear();
+    m_hits = 0;
+    m_misses = 0;
+    m_unsaved = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::CachedLemmatizer::setPersistentFile(const QString &filename, const QString &key)
+{
+    m_persistentFile = filename;
+    m_persistentKey = key;
+
+    return !filename.isEmpty() && load(filename, key);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::CachedLemmatizer::save(const QString &filename, const QString &key) const
+{
+    // Write a temporary file first, so a crash never leaves a truncated cache. Other processes
+    // with the same file overwrite it, the last one wins.
+    QString tmpFilename = filename + ".tmp";
+    QFile file(tmpFilename);
+
+    if (!file.open(QFile::WriteOnly)) {
+        qCritical() << "CachedLemmatizer: Cannot write" << tmpFilename;
+        return false;
+    }
+
+    QDataStream ostream(&file);
+
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << (quint32)LEMMA_CACHE_MAGIC_NUMBER;
+    ostream << (quint32)LEMMA_CACHE_FILE_FORMAT_VERSION;
+    ostream << key;
+
+    {
+        QMutexLocker locker(m_cacheMutex);
+
+        QList<QString> inputs = m_cache.keys();
+
+        ostream << (quint32)inputs.size();
+
+        foreach (const QString &input, inputs) {
+            ostream << input << *m_cache.object(input);
+        }
+    }
+
+    file.close();
+
+    if (ostream.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        qCritical() << "CachedLemmatizer: Cannot write" << tmpFilename;
+        QFile::remove(tmpFilename);
+        return false;
+    }
+
+    QFile::remove(filename);
+
+    if (!QFile::rename(tmpFilename, filename)) {
+        qCritical() << "CachedLemmatizer: Cannot rename" << tmpFilename << "to" << filename;
+        return false;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::CachedLemmatizer::load(const QString &filename, const QString &key)
+{
+    QFile file(filename);
+
+    if (!file.exists() || !file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream istream(&file);
+
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString fileKey;
+    quint32 size = 0;
+
+    istream >> magic >> version >> fileKey >> size;
+
+    if (magic != LEMMA_CACHE_MAGIC_NUMBER || version != LEMMA_CACHE_FILE_FORMAT_VERSION) {
+        qWarning() << "CachedLemmatizer: Invalid or old cache file" << filename;
+        return false;
+    }
+
+    if (fileKey != key) {
+        qDebug() << "CachedLemmatizer: Ignoring cache file of other lemmatizer" << filename;
+        return false;
+    }
+
+    QList<QString> inputs;
+    QList<CachedWords> words;
+
+    for (quint32 i = 0; i < size && istream.status() == QDataStream::Ok; ++i) {
+        QString input;
+        CachedWords l;
+
+        istream >> input;
+        readWords(istream, l);
+
+        inputs.append(input);
+        words.append(l);
+    }
+
+    if (istream.status() != QDataStream::Ok) {
+        qWarning() << "CachedLemmatizer: Corrupted cache file" << filename;
+        return false;
+    }
+
+    QMutexLocker locker(m_cacheMutex);
+
+    for (int i = 0; i < inputs.size() && m_cache.size() < m_cache.maxCost(); ++i) {
+        if (!m_cache.contains(inputs[i])) {
+            m_cache.insert(inputs[i], new CachedWords(words[i]));
+        }
+    }
+
+    qDebug() << "CachedLemmatizer: Loaded" << m_cache.size() << "results from" << filename;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::CachedLemmatizer::memoryUsage() const
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    return (qint64)m_cache.size()*LEMMA_CACHE_ENTRY_BYTES;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::CachedLemmatizer::releaseMemory(qint64 bytes)
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    int size = m_cache.size();
+    int maxSize = m_cache.maxCost();
+    int evict = (int)qMin((qint64)size,
+                          (bytes + LEMMA_CACHE_ENTRY_BYTES - 1)/LEMMA_CACHE_ENTRY_BYTES);
+
+    // Lowering the max cost evicts the least recently used results
+    m_cache.setMaxCost(size - evict);
+    m_cache.setMaxCost(maxSize);
+
+    return (qint64)(size - m_cache.size())*LEMMA_CACHE_ENTRY_BYTES;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::CachedLemmatizer::needsMaintenance() const
+{
+    QMutexLocker locker(m_cacheMutex);
+
+    return !m_persistentFile.isEmpty() && m_unsaved > 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::CachedLemmatizer::runMaintenance()
+{
+    int unsaved = 0;
+
+    {
+        QMutexLocker locker(m_cacheMutex);
+
+        unsaved = m_unsaved;
+    }
+
+    if (unsaved > 0 && !m_persistentFile.isEmpty() && save(m_persistentFile, m_persistentKey)) {
+        QMutexLocker locker(m_cacheMutex);
+
+        // Results inserted while saving are written next time
+        m_unsaved = qMax(m_unsaved - unsaved, 0);
+    }
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_CACHEDLEMMATIZER_H
+#define LVK_NLP_CACHEDLEMMATIZER_H
+
+#include "nlp-engine/lemmatizer.h"
+#include "common/memorymanager.h"
+#include "common/maintenancescheduler.h"
+
+#include <QCache>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The CachedLemmatizer class provides a LRU cache of lemmatization results on top of
+ *        another lemmatizer
+ *
+ * Chat traffic is very repetitive, so caching avoids running expensive lemmatizers such as
+ * FreelingLemmatizer for the same input again and again.
+ *
+ * Results can persist across runs, see setPersistentFile(), so the cache is not cold after a
+ * restart. New results are also written periodically by the MaintenanceScheduler, so they are
+ * not lost if the application crashes. The cache is a consumer of the MemoryManager, which
+ * evicts the least recently used results under memory pressure.
+ *
+ * This class is thread-safe. Calls to the underlying lemmatizer are serialized unless it is
+ * thread-safe too.
+ */
+class CachedLemmatizer : public Lemmatizer, public Cmn::MemoryConsumer,
+                         public Cmn::MaintenanceTask
+{
+public:
+
+    /**
+     * Constructs a CachedLemmatizer on top of \a lemmatizer that caches up to \a maxSize
+     * results. If \a maxSize is negative, the size is read from the application settings.
+     * After construction, the object owns the given pointer.
+     */
+    CachedLemmatizer(Lemmatizer *lemmatizer, int maxSize = -1);
+
+    /**
+     * \copydoc Lemmatizer::~Lemmatizer()
+     *
+     * If there is a persistent file, results are written to it.
+     */
+    ~CachedLemmatizer();
+
+    /**
+     * \copydoc Lemmatizer::tokenize(const QString &input, QStringList &l)
+     *
+     * Tokenization results are not cached.
+     */
+    virtual void tokenize(const QString &input, QStringList &l);
+
+    /**
+     * \copydoc Lemmatizer::lemmatize(const QString &input, WordList &l)
+     */
+    virtual void lemmatize(const QString &input, WordList &l);
+
+    /**
+     * \copydoc Lemmatizer::lemmatizeBatch(const QStringList &, QList<WordList> &)
+     *
+     * Only inputs not found in the cache are sent to the underlying lemmatizer, in one batch.
+     */
+    virtual void lemmatizeBatch(const QStringList &inputs, QList<WordList> &l);
+
+    /**
+     * Returns true.
+     */
+    virtual bool isThreadSafe() const;
+
+    /**
+     * Returns the amount of lemmatizations found in the cache
+     */
+    int hits() const;
+
+    /**
+     * Returns the amount of lemmatizations not found in the cache
+     */
+    int misses() const;
+
+    /**
+     * Returns the amount of results in the cache
+     */
+    int size() const;
+
+    /**
+     * Returns the maximum amount of results in the cache
+     */
+    int maxSize() const;
+
+    /**
+     * Removes all results from the cache and resets counters
+     */
+    void clear();
+
+    /**
+     * Sets the file where results persist to \a filename. Results are read now from the file
+     * if it was written with the same \a key, and written back when the object is destroyed.
+     * The key must change whenever the underlying lemmatizer could give other results, for
+     * instance, if the language or its dictionaries change. Returns true if results were read.
+     * Otherwise; returns false.
+     */
+    bool setPersistentFile(const QString &filename, const QString &key);
+
+    /**
+     * Writes the results in the cache and \a key to \a filename. Returns true on success.
+     * Otherwise; returns false.
+     */
+    bool save(const QString &filename, const QString &key) const;
+
+    /**
+     * Adds to the cache the results in \a filename, as long as they fit, if the file was
+     * written with \a key. Returns true on success. Otherwise; returns false and the cache is
+     * not modified.
+     */
+    bool load(const QString &filename, const QString &key);
+
+    /**
+     * \copydoc Cmn::MemoryConsumer::memoryUsage()
+     */
+    virtual qint64 memoryUsage() const;
+
+    /**
+     * \copydoc Cmn::MemoryConsumer::releaseMemory()
+     *
+     * The least recently used results are evicted first.
+     */
+    virtual qint64 releaseMemory(qint64 bytes);
+
+    /**
+     * Returns true if there is a persistent file and results not written to it yet.
+     * Otherwise; returns false.
+     */
+    virtual bool needsMaintenance() const;
+
+    /**
+     * Writes the results in the cache to the persistent file.
+     */
+    virtual void runMaintenance();
+
+private:
+    CachedLemmatizer(const CachedLemmatizer&);
+    CachedLemmatizer & operator=(const CachedLemmatizer&);
+
+    // WordList keeps 16 words inline, about 1 KB. Cached results are stored without that
+    // capacity, so each one only costs the words it has.
+    typedef QVector<Word> CachedWords;
+
+    std::auto_ptr<Lemmatizer> m_lemmatizer;
+    QCache<QString, CachedWords> m_cache;
+    QMutex *m_cacheMutex;
+    QMutex *m_lemmaMutex;
+    int m_hits;
+    int m_misses;
+    int m_unsaved;              // Results inserted since the persistent file was written
+    QString m_persistentFile;
+    QString m_persistentKey;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_CACHEDLEMMATIZER_H
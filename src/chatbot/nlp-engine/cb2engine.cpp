@@ -23,19 +23,57 @@
 #include "nlp-engine/rule.h"
 #include "nlp-engine/nlpproperties.h"
 #include "nlp-engine/globaltools.h"
+#include "nlp-engine/responsecache.h"
+#include "nlp-engine/sessionstore.h"
+#include "nlp-engine/rulehits.h"
+#include "nlp-engine/varstack.h"
+#include "nlp-engine/symboltable.h"
 #include "common/settings.h"
 #include "common/settingskeys.h"
 #include "common/logger.h"
+#include "common/trace.h"
+#include "common/profiler.h"
+#include "common/memorymanager.h"
+#include "common/taskscheduler.h"
 
 #include <QStringList>
+#include <QByteArray>
+#include <QDataStream>
+#include <QCryptographicHash>
 #include <QFile>
 #include <QDir>
+#include <QDateTime>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+#include <QThread>
+#include <QRunnable>
+#include <QFutureInterface>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QWeakPointer>
 #include <QtDebug>
 
 #define ANY_USER    ""
 
+#define STATS_LOG_INTERVAL  1000    // Write stats to the log file every 1000 calls
+
+#define DEFAULT_MAX_RECURSION       16  // Max nested searches depth
+#define DEFAULT_MAX_RECURSION_TIME  0   // Max msecs for nested searches, 0 means no limit
+
+#define MIN_CONCURRENT_BATCH_SIZE   32  // Smaller batches are searched in the calling thread
+
+#define PARALLEL_SENTENCES          3   // Messages with fewer sentences are matched in sequence
+
+#define TREE_NODE_BYTES     128     // Estimated size of a tree node and its outputs
+
+#define SNAPSHOT_MAGIC_NUMBER           (('c'<<0) | ('b'<<8) | ('s'<<16) | ('\0'<<24))
+#define SNAPSHOT_FILE_FORMAT_VERSION    5
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -52,14 +90,196 @@ inline QSharedPointer<T> makeSharedPtr(T *p)
 
 //--------------------------------------------------------------------------------------------------
 
+// The step budget is read from the settings, so it can be tuned without rebuilding
+inline int defaultMaxSearchSteps()
+{
+    return qMax(0, Lvk::Cmn::SettingsSnapshot::current().intValue(SETTING_NLP_MAX_SEARCH_STEPS));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// The similarity fallback is disabled unless the settings enable it
+inline float defaultMinSimilarity()
+{
+    float minSimilarity = Lvk::Cmn::SettingsSnapshot::current()
+            .value(SETTING_NLP_MIN_SIMILARITY).toFloat();
+
+    return qBound(0.0f, minSimilarity, 1.0f);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 // Convert ResultList to (QStringList, MatchList)
 inline void convert(const Lvk::Nlp::ResultList &results, QStringList &responses,
                     Lvk::Nlp::Engine::MatchList &matches)
 {
-    foreach (const Lvk::Nlp::Result &r, results) {
-        responses.append(r.output);
-        matches.append(Lvk::Nlp::Engine::RuleMatch(r.ruleId, r.inputIdx));
+    for (int i = 0; i < results.size(); ++i) {
+        responses.append(results[i].output);
+        matches.append(Lvk::Nlp::Engine::RuleMatch(results[i].ruleId, results[i].inputIdx));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Search of one input of a batch. Several lookups can run simultaneously since each one uses
+// its own search context
+struct BatchLookup
+{
+    const Lvk::Nlp::Tree *tree;
+    QList<Lvk::Nlp::SymbolId> targets;      // Targets to search until one has results
+    const Lvk::Nlp::WordList *words;
+    Lvk::Nlp::ResultList *results;
+    Lvk::Nlp::EngineStats *stats;
+    int maxRecursion;
+    qint64 maxRecursionTime;
+    int maxSearchSteps;
+
+    void run()
+    {
+        Lvk::Nlp::SearchContext ctx(stats);
+        ctx.setBudget(maxRecursion, maxRecursionTime);
+        ctx.setStepBudget(maxSearchSteps);
+
+        foreach (Lvk::Nlp::SymbolId target, targets) {
+            ctx.setTarget(target);
+            tree->getResponses(*words, *results, ctx);
+
+            if (!results->isEmpty()) {
+                break;
+            }
+        }
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool isSentenceEnd(const QChar &c)
+{
+    return c == '.' || c == '!' || c == '?' || c == '\n';
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Splits the input into sentences. Sentences end with '.', '!', '?' or a line break followed by
+// whitespace or the end of input, so decimals and URLs such as "1.5" or "www.lvk.com.ar" are
+// not split. Empty sentences are skipped.
+QStringList splitSentences(const QString &input)
+{
+    QStringList sentences;
+    int start = 0;
+
+    for (int i = 0; i < input.size(); ++i) {
+        if (!isSentenceEnd(input[i])) {
+            continue;
+        }
+
+        int end = i + 1;
+        while (end < input.size() && isSentenceEnd(input[end])) {
+            ++end;
+        }
+
+        if (end == input.size() || input[end].isSpace()) {
+            QString sentence = input.mid(start, end - start).trimmed();
+            if (!sentence.isEmpty()) {
+                sentences.append(sentence);
+            }
+            start = end;
+        }
+
+        i = end - 1;
+    }
+
+    QString sentence = input.mid(start).trimmed();
+    if (!sentence.isEmpty()) {
+        sentences.append(sentence);
+    }
+
+    return sentences;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Engines without a toolchain use the global one
+inline Lvk::Nlp::Toolchain *toolchain(const QSharedPointer<Lvk::Nlp::Toolchain> &tools)
+{
+    return tools ? tools.data() : Lvk::Nlp::GlobalTools::instance();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Parses inputs as user inputs and drops the results. Runs in a worker thread.
+void warmUpTools(QSharedPointer<Lvk::Nlp::Toolchain> tools, const QStringList &inputs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<Lvk::Nlp::WordList> words;
+    Lvk::Nlp::Tree(Lvk::Nlp::MatchPolicy::LemmaMatch, tools).parseUserInputs(inputs, words);
+
+    qDebug() << "Cb2Engine: Warmed up with" << inputs.size() << "inputs in" << timer.elapsed()
+             << "ms";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Builds a tree with all rules. Rules of every target are added once to the same tree. Each
+// rule keeps its targets and searches filter outputs by target. If minimize, the tree is
+// minimized, see Tree::minimize(). If profiling, the tree records the cost of each rule and it
+// is not minimized, see Tree::setProfiling()
+QSharedPointer<Lvk::Nlp::Tree> buildTree(const Lvk::Nlp::RuleList &rules,
+                                         Lvk::Nlp::MatchPolicy::Mode matchMode,
+                                         QSharedPointer<Lvk::Nlp::Toolchain> tools,
+                                         bool minimize = false, bool profiling = false)
+{
+    if (profiling) {
+        QSharedPointer<Lvk::Nlp::Tree> tree =
+                makeSharedPtr(new Lvk::Nlp::Tree(matchMode, tools));
+        tree->setProfiling(true);
+        tree->add(rules);
+        return tree;
     }
+
+    // Lemmatize all rule inputs at once
+
+    QStringList inputs;
+
+    foreach (const Lvk::Nlp::Rule &rule, rules) {
+        inputs.append(rule.input());
+    }
+
+    QList<Lvk::Nlp::WordList> words;
+    toolchain(tools)->lemmatizeBatch(inputs, words);
+
+    qDebug() << "Cb2Engine: Building tree for" << rules.size() << "rules";
+
+    QSharedPointer<Lvk::Nlp::Tree> tree = makeSharedPtr(new Lvk::Nlp::Tree(matchMode, tools));
+
+    for (int i = 0, j = 0; i < rules.size(); ++i) {
+        int inputCount = rules[i].input().size();
+        tree->add(rules[i], words.mid(j, inputCount));
+        j += inputCount;
+    }
+
+    if (minimize) {
+        tree->minimize();
+    }
+
+    return tree;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Trees of the snapshots loaded or saved in this process, so engines with the same rules and
+// config share one tree instead of decoding a copy each
+typedef QHash<QByteArray, QWeakPointer<Lvk::Nlp::Tree> > SnapshotTreeRegistry;
+
+QMutex s_snapshotTreesMutex;
+SnapshotTreeRegistry s_snapshotTrees;
+
+// Trees are compiled for one match mode, so the mode is part of the registry key
+inline QByteArray sharedTreeKey(const QByteArray &snapshotKey, int matchMode)
+{
+    return snapshotKey + ':' + QByteArray::number(matchMode);
 }
 
 } // namespace
@@ -70,24 +290,70 @@ inline void convert(const Lvk::Nlp::ResultList &results, QStringList &responses,
 
 Lvk::Nlp::Cb2Engine::Cb2Engine()
     : m_logFile(new QFile()),
-      m_mutex(new QMutex(QMutex::Recursive)),
+      m_topicTreesNodes(0),
+      m_rwLock(new QReadWriteLock(QReadWriteLock::Recursive)),
+      m_sessions(new Nlp::SessionStore()),
+      m_topicTreesMutex(new QMutex()),
+      m_logMutex(new QMutex()),
+      m_buildMutex(new QMutex()),
+      m_stats(new Nlp::EngineStats()),
+      m_ruleHits(new Nlp::RuleHits()),
+      m_responseCache(new Nlp::ResponseCache()),
       m_dirty(false),
-      m_preferCurTopic(false)
+      m_asyncReload(false),
+      m_reloading(false),
+      m_rulesVersion(0),
+      m_treeVersion(0),
+      m_sharedTrees(false),
+      m_preferCurTopic(false),
+      m_splitSentences(false),
+      m_matchMode(Nlp::MatchPolicy::LemmaMatch),
+      m_maxRecursion(DEFAULT_MAX_RECURSION),
+      m_maxRecursionTime(DEFAULT_MAX_RECURSION_TIME),
+      m_maxSearchSteps(defaultMaxSearchSteps()),
+      m_minSimilarity(defaultMinSimilarity()),
+      m_bestEffort(false),
+      m_minimizeTree(false)
 {
     initLog();
+
+    Cmn::MemoryManager::manager()->add(this, "topicTrees", Cmn::MemoryManager::IndexPriority);
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Nlp::Cb2Engine::Cb2Engine(Sanitizer *sanitizer)
     : m_logFile(new QFile()),
-      m_mutex(new QMutex(QMutex::Recursive)),
+      m_topicTreesNodes(0),
+      m_rwLock(new QReadWriteLock(QReadWriteLock::Recursive)),
+      m_sessions(new Nlp::SessionStore()),
+      m_topicTreesMutex(new QMutex()),
+      m_logMutex(new QMutex()),
+      m_buildMutex(new QMutex()),
+      m_stats(new Nlp::EngineStats()),
+      m_ruleHits(new Nlp::RuleHits()),
+      m_responseCache(new Nlp::ResponseCache()),
       m_dirty(false),
-      m_preferCurTopic(false)
+      m_asyncReload(false),
+      m_reloading(false),
+      m_rulesVersion(0),
+      m_treeVersion(0),
+      m_sharedTrees(false),
+      m_preferCurTopic(false),
+      m_splitSentences(false),
+      m_matchMode(Nlp::MatchPolicy::LemmaMatch),
+      m_maxRecursion(DEFAULT_MAX_RECURSION),
+      m_maxRecursionTime(DEFAULT_MAX_RECURSION_TIME),
+      m_maxSearchSteps(defaultMaxSearchSteps()),
+      m_minSimilarity(defaultMinSimilarity()),
+      m_bestEffort(false),
+      m_minimizeTree(false)
 {
     Nlp::GlobalTools::instance()->setPreSanitizer(sanitizer);
 
     initLog();
+
+    Cmn::MemoryManager::manager()->add(this, "topicTrees", Cmn::MemoryManager::IndexPriority);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -95,33 +361,180 @@ Lvk::Nlp::Cb2Engine::Cb2Engine(Sanitizer *sanitizer)
 Lvk::Nlp::Cb2Engine::Cb2Engine(Sanitizer *preSanitizer, Lemmatizer *lemmatizer,
                                Sanitizer *postSanitizer)
     : m_logFile(new QFile()),
-      m_mutex(new QMutex(QMutex::Recursive)),
+      m_topicTreesNodes(0),
+      m_rwLock(new QReadWriteLock(QReadWriteLock::Recursive)),
+      m_sessions(new Nlp::SessionStore()),
+      m_topicTreesMutex(new QMutex()),
+      m_logMutex(new QMutex()),
+      m_buildMutex(new QMutex()),
+      m_stats(new Nlp::EngineStats()),
+      m_ruleHits(new Nlp::RuleHits()),
+      m_responseCache(new Nlp::ResponseCache()),
       m_dirty(false),
-      m_preferCurTopic(false)
+      m_asyncReload(false),
+      m_reloading(false),
+      m_rulesVersion(0),
+      m_treeVersion(0),
+      m_sharedTrees(false),
+      m_preferCurTopic(false),
+      m_splitSentences(false),
+      m_matchMode(Nlp::MatchPolicy::LemmaMatch),
+      m_maxRecursion(DEFAULT_MAX_RECURSION),
+      m_maxRecursionTime(DEFAULT_MAX_RECURSION_TIME),
+      m_maxSearchSteps(defaultMaxSearchSteps()),
+      m_minSimilarity(defaultMinSimilarity()),
+      m_bestEffort(false),
+      m_minimizeTree(false)
 {
     Nlp::GlobalTools::instance()->setPreSanitizer(preSanitizer);
     Nlp::GlobalTools::instance()->setLemmatizer(lemmatizer);
     Nlp::GlobalTools::instance()->setPostSanitizer(postSanitizer);
 
     initLog();
+
+    Cmn::MemoryManager::manager()->add(this, "topicTrees", Cmn::MemoryManager::IndexPriority);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Cb2Engine::Cb2Engine(QSharedPointer<Nlp::Toolchain> tools)
+    : m_tools(tools),
+      m_logFile(new QFile()),
+      m_topicTreesNodes(0),
+      m_rwLock(new QReadWriteLock(QReadWriteLock::Recursive)),
+      m_sessions(new Nlp::SessionStore()),
+      m_topicTreesMutex(new QMutex()),
+      m_logMutex(new QMutex()),
+      m_buildMutex(new QMutex()),
+      m_stats(new Nlp::EngineStats()),
+      m_ruleHits(new Nlp::RuleHits()),
+      m_responseCache(new Nlp::ResponseCache()),
+      m_dirty(false),
+      m_asyncReload(false),
+      m_reloading(false),
+      m_rulesVersion(0),
+      m_treeVersion(0),
+      m_sharedTrees(false),
+      m_preferCurTopic(false),
+      m_splitSentences(false),
+      m_matchMode(Nlp::MatchPolicy::LemmaMatch),
+      m_maxRecursion(DEFAULT_MAX_RECURSION),
+      m_maxRecursionTime(DEFAULT_MAX_RECURSION_TIME),
+      m_maxSearchSteps(defaultMaxSearchSteps()),
+      m_minSimilarity(defaultMinSimilarity()),
+      m_bestEffort(false),
+      m_minimizeTree(false)
+{
+    initLog();
+
+    Cmn::MemoryManager::manager()->add(this, "topicTrees", Cmn::MemoryManager::IndexPriority);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Session engine. Shares all rules, trees and properties of the given engine but not the topics
+Lvk::Nlp::Cb2Engine::Cb2Engine(Cb2Engine *shared)
+    : m_logFile(new QFile()),
+      m_topicTreesNodes(0),
+      m_rwLock(new QReadWriteLock(QReadWriteLock::Recursive)),
+      m_sessions(new Nlp::SessionStore()),
+      m_topicTreesMutex(new QMutex()),
+      m_logMutex(new QMutex()),
+      m_buildMutex(new QMutex()),
+      m_stats(new Nlp::EngineStats()),
+      m_ruleHits(new Nlp::RuleHits()),
+      m_responseCache(new Nlp::ResponseCache()),
+      m_dirty(false),
+      m_asyncReload(false),
+      m_reloading(false),
+      m_rulesVersion(0),
+      m_treeVersion(0),
+      m_sharedTrees(true),
+      m_preferCurTopic(false),
+      m_splitSentences(false),
+      m_matchMode(Nlp::MatchPolicy::LemmaMatch),
+      m_maxRecursion(DEFAULT_MAX_RECURSION),
+      m_maxRecursionTime(DEFAULT_MAX_RECURSION_TIME),
+      m_maxSearchSteps(defaultMaxSearchSteps()),
+      m_minSimilarity(defaultMinSimilarity()),
+      m_bestEffort(false),
+      m_minimizeTree(false)
+{
+    // Compile rules once, so sessions do not compile their own trees
+    shared->refreshIfDirty();
+
+    QWriteLocker locker(shared->m_rwLock);
+
+    shared->m_sharedTrees = true;
+
+    m_tools            = shared->m_tools;
+    m_rules            = shared->m_rules;
+    m_tree             = shared->m_tree;
+    m_topicTrees       = shared->m_topicTrees;
+    m_topicTreesLru    = shared->m_topicTreesLru;
+    m_topicTreesNodes  = shared->m_topicTreesNodes;
+    m_ruleTopics       = shared->m_ruleTopics;
+    m_topicNames       = shared->m_topicNames;
+    m_topicIds         = shared->m_topicIds;
+    m_evasives         = shared->m_evasives;
+    m_dirty            = shared->m_dirty;
+    m_rulesVersion     = shared->m_rulesVersion;
+    m_treeVersion      = shared->m_treeVersion;
+    m_preferCurTopic   = shared->m_preferCurTopic;
+    m_splitSentences   = shared->m_splitSentences;
+    m_matchMode        = shared->m_matchMode;
+    m_maxRecursion     = shared->m_maxRecursion;
+    m_maxRecursionTime = shared->m_maxRecursionTime;
+    m_maxSearchSteps   = shared->m_maxSearchSteps;
+    m_minSimilarity    = shared->m_minSimilarity;
+    m_bestEffort       = shared->m_bestEffort;
+    m_minimizeTree     = shared->m_minimizeTree;
+
+    m_ruleHits->setRules(m_rules);
+
+    initLog(false);
+
+    Cmn::MemoryManager::manager()->add(this, "topicTrees", Cmn::MemoryManager::IndexPriority);
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Nlp::Cb2Engine::~Cb2Engine()
 {
-    delete m_mutex;
+    Cmn::MemoryManager::manager()->remove(this);
+
+    Cmn::TaskScheduler::scheduler()->waitForDone(this);
+
+    m_warmUp.waitForFinished();
+
+    // A finished background build could still be releasing the lock
+    m_reload.waitForFinished();
+    {
+        QWriteLocker locker(m_rwLock);
+    }
+
+    delete m_responseCache;
+    delete m_ruleHits;
+    delete m_stats;
+    delete m_buildMutex;
+    delete m_logMutex;
+    delete m_topicTreesMutex;
+    delete m_sessions;
+    delete m_rwLock;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Cb2Engine::initLog()
+void Lvk::Nlp::Cb2Engine::initLog(bool rotate)
 {
-    Cmn::Settings settings;
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
     QString logsPath = settings.value(SETTING_LOGS_PATH).toString();
     QString filename = logsPath + QDir::separator() + "cb2engine.log";
 
-    Cmn::Logger::rotateLog(filename);
+    // Sessions append to the log of the engine they were created from
+    if (rotate) {
+        Cmn::Logger::rotateLog(filename);
+    }
 
     m_logFile->setFileName(filename);
 
@@ -134,7 +547,7 @@ void Lvk::Nlp::Cb2Engine::initLog()
 
 Lvk::Nlp::RuleList Lvk::Nlp::Cb2Engine::rules() const
 {
-    QMutexLocker locker(m_mutex);
+    QReadLocker locker(m_rwLock);
 
     return m_rules;
 }
@@ -145,11 +558,12 @@ void Lvk::Nlp::Cb2Engine::setRules(const Lvk::Nlp::RuleList &rules)
 {
     qDebug() << "Cb2Engine: Setting new rules...";
 
-    QMutexLocker locker(m_mutex);
+    QWriteLocker locker(m_rwLock);
 
     m_rules = rules;
+    m_ruleHits->setRules(rules);
 
-    m_dirty = true;
+    markDirty();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -158,11 +572,69 @@ void Lvk::Nlp::Cb2Engine::addRule(const Lvk::Nlp::Rule &rule)
 {
     qDebug() << "Cb2Engine: Adding new rule...";
 
-    QMutexLocker locker(m_mutex);
+    QWriteLocker locker(m_rwLock);
 
     m_rules.append(rule);
+    m_ruleHits->addRule(rule.id());
+    updateRuleTopics(rule);
 
-    m_dirty = true;
+    // If dirty, trees are going to be rebuilt anyway
+    if (!m_dirty) {
+        addToTrees(rule);
+    }
+
+    markUpdated();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::removeRule(Nlp::RuleId ruleId)
+{
+    qDebug() << "Cb2Engine: Removing rule" << ruleId << "...";
+
+    QWriteLocker locker(m_rwLock);
+
+    int i = indexOfRule(ruleId);
+
+    if (i == -1) {
+        return;
+    }
+
+    if (!m_dirty) {
+        removeFromTrees(m_rules[i]);
+    }
+
+    m_rules.removeAt(i);
+    m_ruleTopics.remove(ruleId);
+    m_ruleHits->removeRule(ruleId);
+
+    markUpdated();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::updateRule(const Lvk::Nlp::Rule &rule)
+{
+    qDebug() << "Cb2Engine: Updating rule" << rule.id() << "...";
+
+    QWriteLocker locker(m_rwLock);
+
+    int i = indexOfRule(rule.id());
+
+    if (i == -1) {
+        addRule(rule);
+        return;
+    }
+
+    if (!m_dirty) {
+        removeFromTrees(m_rules[i]);
+        addToTrees(rule);
+    }
+
+    m_rules[i] = rule;
+    updateRuleTopics(rule);
+
+    markUpdated();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -179,16 +651,14 @@ QString Lvk::Nlp::Cb2Engine::getResponse(const QString &input, const QString &ta
 {
     matches.clear();
 
-    MatchList allMatches;
-    QStringList responses = getAllResponses(input, target, allMatches);
+    Nlp::Result result;
+    getResponse(input, target, result);
 
-    if (!allMatches.empty()) {
-        matches.append(allMatches.first());
-
-        return responses.first();
-    } else {
-        return "";
+    if (result.isValid()) {
+        matches.append(Lvk::Nlp::Engine::RuleMatch(result.ruleId, result.inputIdx));
     }
+
+    return result.output;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -203,214 +673,1538 @@ QStringList Lvk::Nlp::Cb2Engine::getAllResponses(const QString &input, MatchList
 QStringList Lvk::Nlp::Cb2Engine::getAllResponses(const QString &input, const QString &target,
                                                   MatchList &matches)
 {
-    QMutexLocker locker(m_mutex);
-
-    if (m_dirty) {
-        qDebug("Cb2Engine: Dirty flag set. Refreshing trees...");
-        refresh();
-        m_dirty = false;
-    }
-
-    qDebug() << "Cb2Engine: Getting response for input" << input
-             << "and target" << target << "...";
-
     Nlp::ResultList results;
+    getAllResponses(input, target, results);
 
-    // If no response found with the given target, fallback to rules with any user
-    getAllResponsesWithTree(target, input, results);
-    if (results.isEmpty() && target != ANY_USER) {
-        getAllResponsesWithTree(ANY_USER, input, results);
-    }
-
-    // If rules with current topic are prefered: Reorder results and update current topic
-    if (m_preferCurTopic && !results.isEmpty()) {
-        QString &topic = m_topics[target];
-        reorderByTopic(topic, results);
-        topic = nextTopicForRule(results[0].ruleId);
-    }
-
-    // TODO Avoid this convertion. In the future remove MatchList and use only ResultList
     QStringList responses;
     convert(results, responses, matches);
-    qDebug() << "Cb2Engine: Responses found: " << responses;
 
     return responses;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Cb2Engine::getAllResponsesWithTree(const QString &treeName, const QString &input,
-                                                  Nlp::ResultList &results)
+void Lvk::Nlp::Cb2Engine::getResponse(const QString &input, const QString &target,
+                                      Nlp::Result &result)
 {
-    results.clear();
+    getResponse(input, target, result, Request());
+}
+
+//--------------------------------------------------------------------------------------------------
 
-    qDebug() << "Cb2Engine: Searching tree with name" << treeName;
+// Runs a request of getResponseAsync() in the Reply class of the task scheduler
+class Lvk::Nlp::Cb2Engine::ResponseTask : public QRunnable
+{
+public:
+    ResponseTask(Cb2Engine *engine, const QString &input, const QString &target, int deadline)
+        : m_engine(engine), m_input(input), m_target(target), m_request(&m_future, deadline)
+    {
+        m_future.reportStarted();
+    }
 
-    TreesMap::iterator it = m_trees.find(treeName);
-    if (it != m_trees.end()) {
-        qDebug() << "Cb2Engine: Found!";
-        (*it)->getResponses(input, results);
+    QFuture<Nlp::Result> future()
+    {
+        return m_future.future();
     }
-}
+
+    virtual void run()
+    {
+        Nlp::Result result;
+
+        // Requests canceled or expired while queued are not searched. Results of canceled
+        // requests are ignored by the future.
+        if (!m_request.isExpired()) {
+            m_engine->getResponse(m_input, m_target, result, m_request);
+        }
+
+        m_future.reportResult(result);
+        m_future.reportFinished();
+    }
+
+private:
+    Cb2Engine *m_engine;
+    QString m_input;
+    QString m_target;
+    QFutureInterface<Nlp::Result> m_future;
+    Request m_request;
+};
 
 //--------------------------------------------------------------------------------------------------
 
-QString Lvk::Nlp::Cb2Engine::getCurrentTopic(const QString &target) const
+QFuture<Lvk::Nlp::Result> Lvk::Nlp::Cb2Engine::getResponseAsync(const QString &input,
+                                                                const QString &target,
+                                                                int deadline /*= 0*/)
 {
-    return m_topics[target];
+    ResponseTask *task = new ResponseTask(this, input, target, deadline);
+    QFuture<Nlp::Result> future = task->future();
+
+    Cmn::TaskScheduler::scheduler()->start(task, Cmn::TaskScheduler::Reply, this);
+
+    return future;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Cb2Engine::refresh()
+void Lvk::Nlp::Cb2Engine::getResponse(const QString &input, const QString &target,
+                                      Nlp::Result &result, const Request &request)
 {
-    m_trees.clear();
+    LVK_PROFILE("Cb2Engine::getResponse");
 
-    // Initialize tree for rules without targets
+    result.clear();
 
-    m_trees[ANY_USER] = makeSharedPtr(buildTree(ANY_USER));
+    QReadLocker locker(m_rwLock);
 
-    // Initialize tree for each different target
+    if (mustRefresh()) {
+        locker.unlock();
+        refreshIfDirty();
+        locker.relock();
+    }
 
-    foreach (const Nlp::Rule &rule, m_rules) {
-        foreach (const QString &target, rule.target()) {
-            if (!m_trees.contains(target)) {
-                m_trees[target] = makeSharedPtr(buildTree(target));
-            }
-        }
+    LVK_TRACE(Nlp) << "Cb2Engine: Getting best response for input" << input
+                   << "and target" << target << "...";
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int topic = 0;
+    if (m_preferCurTopic) {
+        topic = m_sessions->topic(target);
     }
-}
 
-//--------------------------------------------------------------------------------------------------
+    QStringList sentences;
+    if (m_splitSentences) {
+        sentences = splitSentences(input);
+    }
 
-Lvk::Nlp::Tree * Lvk::Nlp::Cb2Engine::buildTree(const QString &target)
-{
-    Nlp::Tree *tree = new Nlp::Tree();
+    if (sentences.size() > 1) {
+        getBestResponseBySentence(sentences, target, topic, result, request);
+    } else {
+        result = getBestResponse(input, target, topic, request);
+    }
 
-    qDebug() << "Cb2Engine: Building tree for target" << target;
+    if (result.isValid()) {
+        if (m_preferCurTopic) {
+            QElapsedTimer topicTimer;
+            topicTimer.start();
 
-    for (int i = 0; i < m_rules.size(); ++i) {
-        const QStringList &targetList = m_rules[i].target();
-        if ((target == ANY_USER && targetList.isEmpty()) || targetList.contains(target)) {
-            tree->add(m_rules[i]);
+            m_sessions->setTopic(target, m_ruleTopics.value(result.ruleId).nextTopic);
+
+            m_stats->record(Nlp::EngineStats::TopicStage, topicTimer.nsecsElapsed() / 1000);
         }
+
+        setTopic(result);
+        result.rulesVersion = m_treeVersion;
+
+        m_ruleHits->record(result.ruleId);
     }
 
-    return tree;
+    recordTotal(timer.nsecsElapsed() / 1000);
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Best response found: " << result.output;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Cb2Engine::reorderByTopic(const QString &topic, Nlp::ResultList &results)
+void Lvk::Nlp::Cb2Engine::explainResponse(const QString &input, const QString &target,
+                                          Nlp::SearchExplain &explain, int topCount /*= 10*/)
 {
-    if (topic.isEmpty()) {
-        return;
+    explain = Nlp::SearchExplain();
+
+    QReadLocker locker(m_rwLock);
+
+    if (mustRefresh()) {
+        locker.unlock();
+        refreshIfDirty();
+        locker.relock();
     }
 
-    for (int i = 0, j = 0; i < results.size(); ++i) {
-        if (topicForRule(results[i].ruleId) == topic) {
-            results.move(i, j++);
+    QElapsedTimer timer;
+    timer.start();
+
+    // Same searches than getBestResponseByTopic() and getBestResponse(), without the cache
+
+    int topic = m_preferCurTopic ? m_sessions->topic(target) : 0;
+    QSharedPointer<Nlp::Tree> tree = topic != 0 ? topicTree(topic) : QSharedPointer<Nlp::Tree>();
+
+    foreach (Nlp::SymbolId searchTarget, searchTargets(target)) {
+        if (tree) {
+            getBestResponseWithTree(tree.data(), searchTarget, input, explain.result, Request(),
+                                    &explain);
         }
-    }
-}
 
-//--------------------------------------------------------------------------------------------------
+        if (!explain.result.isValid()) {
+            getBestResponseWithTree(m_tree.data(), searchTarget, input, explain.result,
+                                    Request(), &explain);
+        }
 
-QString Lvk::Nlp::Cb2Engine::topicForRule(Nlp::RuleId ruleId)
-{
-    foreach (const Nlp::Rule &rule, m_rules) {
-        if (rule.id() == ruleId) {
-            return rule.topic();
+        if (explain.result.isValid()) {
+            break;
         }
     }
-    return "";
-}
 
+    explain.recordStage(Nlp::EngineStats::TotalStage, timer.nsecsElapsed() / 1000);
 
-//--------------------------------------------------------------------------------------------------
+    if (explain.result.isValid()) {
+        setTopic(explain.result);
+        explain.result.rulesVersion = m_treeVersion;
+    }
 
-QString Lvk::Nlp::Cb2Engine::nextTopicForRule(Nlp::RuleId ruleId)
-{
-    foreach (const Nlp::Rule &rule, m_rules) {
-        if (rule.id() == ruleId) {
-            return !rule.nextTopic().isEmpty() ? rule.nextTopic() : rule.topic();
+    // Candidates are the results of the first target with any, as in getAllResponses()
+    foreach (Nlp::SymbolId searchTarget, searchTargets(target)) {
+        Nlp::SearchContext ctx;
+        ctx.setBudget(m_maxRecursion, m_maxRecursionTime);
+        ctx.setStepBudget(m_maxSearchSteps);
+        ctx.setTarget(searchTarget);
+        m_tree->getResponses(input, explain.candidates, ctx);
+
+        if (!explain.candidates.isEmpty()) {
+            break;
         }
     }
-    return "";
-}
-
-//--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Cb2Engine::setPreSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
-{
-    QMutexLocker locker(m_mutex);
+    if (m_preferCurTopic) {
+        reorderByTopic(topic, explain.candidates);
+    }
 
-    Nlp::GlobalTools::instance()->setPreSanitizer(sanitizer);
+    while (explain.candidates.size() > topCount) {
+        explain.candidates.removeLast();
+    }
 
-    m_dirty = true;
+    for (int i = 0; i < explain.candidates.size(); ++i) {
+        setTopic(explain.candidates[i]);
+        explain.candidates[i].rulesVersion = m_treeVersion;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Cb2Engine::setLemmatizer(Lvk::Nlp::Lemmatizer *lemmatizer)
+// Returns the best response of the response cache or a search, without updating the topic
+Lvk::Nlp::Result Lvk::Nlp::Cb2Engine::getBestResponse(const QString &input, const QString &target,
+                                                      int topic, const Request &request)
 {
-    QMutexLocker locker(m_mutex);
+    Nlp::Result result;
 
-    Nlp::GlobalTools::instance()->setLemmatizer(lemmatizer);
+    QString cacheKey = Nlp::ResponseCache::key(input, target, topic);
 
-    m_dirty = true;
-}
+    if (!getCachedResponse(cacheKey, topic, result)) {
+        bool cacheable = true;
 
-//--------------------------------------------------------------------------------------------------
+        if (m_preferCurTopic) {
+            cacheable = getBestResponseByTopic(target, topic, input, result, request);
+        } else {
+            // If no response found with the given target, fallback to rules with any user
+            foreach (Nlp::SymbolId searchTarget, searchTargets(target)) {
+                cacheable &= getBestResponseWithTree(m_tree.data(), searchTarget, input, result,
+                                                     request);
 
-void Lvk::Nlp::Cb2Engine::setPostSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
-{
-    QMutexLocker locker(m_mutex);
+                if (result.isValid() || request.isExpired()) {
+                    break;
+                }
+            }
+        }
 
-    Nlp::GlobalTools::instance()->setPostSanitizer(sanitizer);
+        if (cacheable && result.isValid()) {
+            cacheResponse(cacheKey, topic, result);
+        }
+    }
 
-    m_dirty = true;
+    return result;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-QVariant Lvk::Nlp::Cb2Engine::property(const QString &name)
+// Matches each sentence independently, all of them on the current topic. The reply joins the
+// outputs of the sentences that matched and the rest of the result, including the next topic,
+// comes from the last sentence that matched. Long messages are matched in parallel.
+void Lvk::Nlp::Cb2Engine::getBestResponseBySentence(const QStringList &sentences,
+                                                    const QString &target, int topic,
+                                                    Nlp::Result &result,
+                                                    const Request &request)
 {
-    if (name == NLP_PROP_PREFER_CUR_TOPIC) {
-        return QVariant(m_preferCurTopic);
-    } else {
-        return QVariant();
+    LVK_TRACE(Nlp) << "Cb2Engine: Matching" << sentences.size() << "sentences";
+
+    QList< QFuture<Nlp::Result> > futures;
+
+    if (sentences.size() >= PARALLEL_SENTENCES) {
+        for (int i = 1; i < sentences.size(); ++i) {
+            futures.append(QtConcurrent::run(this, &Cb2Engine::getBestResponse, sentences[i],
+                                             target, topic, request));
+        }
     }
-}
 
-//--------------------------------------------------------------------------------------------------
+    QStringList outputs;
 
-void Lvk::Nlp::Cb2Engine::setProperty(const QString &name, const QVariant &value)
-{
-    if (name == NLP_PROP_PREFER_CUR_TOPIC) {
-        QMutexLocker locker(m_mutex);
+    for (int i = 0; i < sentences.size(); ++i) {
+        Nlp::Result sentenceResult;
 
-        if (value.toBool() == true && !m_preferCurTopic) {
-            qDebug() << "Cb2Engine: Enabled topics";
-            m_preferCurTopic = true;
+        if (i == 0 || futures.isEmpty()) {
+            sentenceResult = getBestResponse(sentences[i], target, topic, request);
+        } else {
+            sentenceResult = futures[i - 1].result();
         }
-        if (value.toBool() == false && m_preferCurTopic) {
-            qDebug() << "Cb2Engine: Disabled topics";
-            m_preferCurTopic = false;
-            m_topics.clear();
+
+        if (sentenceResult.isValid()) {
+            outputs.append(sentenceResult.output);
+            result = sentenceResult;
         }
     }
-}
+
+    if (!outputs.isEmpty()) {
+        result.output = outputs.join(" ");
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::getAllResponses(const QString &input, const QString &target,
+                                          Nlp::ResultList &results)
+{
+    LVK_PROFILE("Cb2Engine::getAllResponses");
+
+    results.clear();
+
+    QReadLocker locker(m_rwLock);
+
+    if (mustRefresh()) {
+        locker.unlock();
+        refreshIfDirty();
+        locker.relock();
+    }
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Getting response for input" << input
+                   << "and target" << target << "...";
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // If no response found with the given target, fallback to rules with any user
+    foreach (Nlp::SymbolId searchTarget, searchTargets(target)) {
+        getAllResponsesWithTarget(searchTarget, input, results);
+
+        if (!results.isEmpty()) {
+            break;
+        }
+    }
+
+    updateTopic(target, results);
+
+    recordTotal(timer.nsecsElapsed() / 1000);
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Results found: " << results;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::getResponses(const QStringList &inputs, const QString &target,
+                                       QList<Nlp::ResultList> &results)
+{
+    LVK_PROFILE("Cb2Engine::getResponses");
+
+    results.clear();
+
+    QReadLocker locker(m_rwLock);
+
+    if (mustRefresh()) {
+        locker.unlock();
+        refreshIfDirty();
+        locker.relock();
+    }
+
+    for (int i = 0; i < inputs.size(); ++i) {
+        results.append(Nlp::ResultList());
+    }
+
+    if (inputs.isEmpty() || !m_tree) {
+        return;
+    }
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Getting responses for" << inputs.size()
+                   << "inputs and target" << target << "...";
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<Nlp::WordList> words;
+    m_tree->parseUserInputs(inputs, words);
+
+    qint64 lemmatizeUsecs = timer.nsecsElapsed() / 1000 / inputs.size();
+    for (int i = 0; i < inputs.size(); ++i) {
+        m_stats->record(Nlp::EngineStats::LemmatizeStage, lemmatizeUsecs);
+    }
+
+    QList<Nlp::SymbolId> targets = searchTargets(target);
+
+    QList<BatchLookup> lookups;
+
+    for (int i = 0; i < inputs.size(); ++i) {
+        BatchLookup lookup;
+        lookup.tree = m_tree.data();
+        lookup.targets = targets;
+        lookup.words = &words[i];
+        lookup.results = &results[i];
+        lookup.stats = m_stats;
+        lookup.maxRecursion = m_maxRecursion;
+        lookup.maxRecursionTime = m_maxRecursionTime;
+        lookup.maxSearchSteps = m_maxSearchSteps;
+        lookups.append(lookup);
+    }
+
+    // Searches do not depend on topics, so they can run in any order
+    if (lookups.size() >= MIN_CONCURRENT_BATCH_SIZE && QThread::idealThreadCount() > 1) {
+        QtConcurrent::blockingMap(lookups, &BatchLookup::run);
+    } else {
+        for (int i = 0; i < lookups.size(); ++i) {
+            lookups[i].run();
+        }
+    }
+
+    // Topics are updated in the same order as inputs
+    for (int i = 0; i < results.size(); ++i) {
+        updateTopic(target, results[i]);
+    }
+
+    qint64 totalUsecs = timer.nsecsElapsed() / 1000 / inputs.size();
+    for (int i = 0; i < inputs.size(); ++i) {
+        recordTotal(totalUsecs);
+    }
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Batch of" << inputs.size() << "inputs done";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::updateTopic(const QString &target, Nlp::ResultList &results)
+{
+    // If rules with current topic are prefered: Reorder results and update current topic
+    if (m_preferCurTopic && !results.isEmpty()) {
+        QElapsedTimer topicTimer;
+        topicTimer.start();
+
+        reorderByTopic(m_sessions->topic(target), results);
+        m_sessions->setTopic(target, m_ruleTopics.value(results[0].ruleId).nextTopic);
+
+        m_stats->record(Nlp::EngineStats::TopicStage, topicTimer.nsecsElapsed() / 1000);
+    }
+
+    for (int i = 0; i < results.size(); ++i) {
+        setTopic(results[i]);
+        results[i].rulesVersion = m_treeVersion;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the targets to search in order: the given target if any rule has it and then rules
+// with any user. Each one is a separate search, so bounded searches keep pruning with the best
+// score of a single target.
+QList<Lvk::Nlp::SymbolId> Lvk::Nlp::Cb2Engine::searchTargets(const QString &target) const
+{
+    QList<Nlp::SymbolId> targets;
+
+    if (!m_tree) {
+        return targets;
+    }
+
+    // Targets are interned when rules are added, so unknown targets have no rules
+    Nlp::SymbolId id = Nlp::SymbolTable::instance()->lookup(target);
+
+    if (target != ANY_USER && id != Nlp::NullSymbol && m_tree->hasTarget(id)) {
+        targets.append(id);
+    }
+    if (m_tree->hasTarget(Nlp::NullSymbol)) {
+        targets.append(Nlp::NullSymbol);
+    }
+
+    return targets;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::getAllResponsesWithTarget(Nlp::SymbolId target, const QString &input,
+                                                    Nlp::ResultList &results) const
+{
+    results.clear();
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Searching rules with target"
+                   << Nlp::SymbolTable::instance()->string(target);
+
+    Nlp::SearchContext ctx(m_stats);
+    ctx.setBudget(m_maxRecursion, m_maxRecursionTime);
+    ctx.setStepBudget(m_maxSearchSteps);
+    ctx.setTarget(target);
+    m_tree->getResponses(input, results, ctx);
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Nested searches:" << ctx.nestedSearches()
+                   << "Memo hits:" << ctx.memoHits();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns true if the result only depends on the input, that is, no nested searches ran and
+// the search was not aborted
+bool Lvk::Nlp::Cb2Engine::getBestResponseWithTree(const Nlp::Tree *tree, Nlp::SymbolId target,
+                                                  const QString &input, Nlp::Result &result,
+                                                  const Request &request,
+                                                  Nlp::SearchExplain *explain /*= 0*/) const
+{
+    result.clear();
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Searching rules with target"
+                   << Nlp::SymbolTable::instance()->string(target);
+
+    // Explained searches do not change the stats
+    Nlp::SearchContext ctx(explain ? 0 : m_stats);
+    ctx.setBudget(m_maxRecursion, m_maxRecursionTime);
+    ctx.setStepBudget(m_maxSearchSteps);
+    ctx.setMinSimilarity(m_minSimilarity);
+    ctx.setTarget(target);
+    ctx.setRequest(request.future, &request.clock, request.deadline);
+    ctx.setBestEffort(m_bestEffort);
+    ctx.setExplain(explain);
+    tree->getResponse(input, result, ctx);
+
+    if (explain) {
+        ++explain->searches;
+        explain->steps += ctx.steps();
+        explain->nestedSearches += ctx.nestedSearches();
+        explain->memoHits += ctx.memoHits();
+        explain->aborted |= ctx.isAborted();
+    }
+
+    LVK_TRACE(Nlp) << "Cb2Engine: Nested searches:" << ctx.nestedSearches()
+                   << "Memo hits:" << ctx.memoHits();
+
+    return ctx.nestedSearches() == 0 && !ctx.isAborted();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns true if the result only depends on the input and the topic
+bool Lvk::Nlp::Cb2Engine::getBestResponseByTopic(const QString &target, int topic,
+                                                 const QString &input, Nlp::Result &result,
+                                                 const Request &request)
+{
+    result.clear();
+
+    // Same result than the first one of getAllResponses(): reorderByTopic() moves results on
+    // the current topic to the front, so the best one on the topic wins if there is any. The
+    // fallback to rules with any user only happens if rules of the target have no results at
+    // all.
+
+    QSharedPointer<Nlp::Tree> tree = topic != 0 ? topicTree(topic) : QSharedPointer<Nlp::Tree>();
+    bool cacheable = true;
+
+    foreach (Nlp::SymbolId searchTarget, searchTargets(target)) {
+        if (tree) {
+            LVK_TRACE(Nlp) << "Cb2Engine: Searching topic tree" << topic;
+            cacheable &= getBestResponseWithTree(tree.data(), searchTarget, input, result,
+                                                 request);
+        }
+
+        if (!result.isValid() && !request.isExpired()) {
+            cacheable &= getBestResponseWithTree(m_tree.data(), searchTarget, input, result,
+                                                 request);
+        }
+
+        if (result.isValid() || request.isExpired()) {
+            break;
+        }
+    }
+
+    return cacheable;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the tree where searches find the given rule: the tree of the current topic if the
+// rule is on it, since topic trees are searched first. Otherwise; the tree of all rules
+QSharedPointer<Lvk::Nlp::Tree> Lvk::Nlp::Cb2Engine::resultTree(Nlp::RuleId ruleId,
+                                                               int topic) const
+{
+    if (topic != 0 && m_ruleTopics.value(ruleId).topic == topic) {
+        return topicTree(topic);
+    }
+
+    return m_tree;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Cb2Engine::getCachedResponse(const QString &key, int topic,
+                                            Nlp::Result &result) const
+{
+    if (m_responseCache->maxSize() == 0) {
+        return false;
+    }
+
+    Nlp::ResponseCache::Entry entry;
+    bool found = false;
+
+    if (m_responseCache->find(key, m_treeVersion, entry)) {
+        QSharedPointer<Nlp::Tree> tree = resultTree(entry.ruleId, topic);
+
+        // The next output is chosen as the search would do, so outputs keep rotating
+        found = tree && tree->getRuleResponse(entry.ruleId, entry.inputIdx, entry.score, result);
+    }
+
+    m_stats->recordCacheLookup(found);
+
+    if (found) {
+        LVK_TRACE(Nlp) << "Cb2Engine: Response cache hit for rule" << entry.ruleId;
+    }
+
+    return found;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::cacheResponse(const QString &key, int topic,
+                                        const Nlp::Result &result) const
+{
+    if (m_responseCache->maxSize() == 0) {
+        return;
+    }
+
+    // Rules with variables or conditions get outputs that depend on the words matched
+    QSharedPointer<Nlp::Tree> tree = resultTree(result.ruleId, topic);
+
+    if (tree && tree->hasConstantOutput(result.ruleId, result.inputIdx)) {
+        m_responseCache->insert(key, m_treeVersion,
+                                Nlp::ResponseCache::Entry(result.ruleId, result.inputIdx,
+                                                          result.score));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QSharedPointer<Lvk::Nlp::Tree> Lvk::Nlp::Cb2Engine::topicTree(int topic) const
+{
+    QMutexLocker locker(m_topicTreesMutex);
+
+    TopicTreesMap::const_iterator it = m_topicTrees.find(topic);
+    if (it != m_topicTrees.constEnd()) {
+        m_topicTreesLru.removeOne(topic);
+        m_topicTreesLru.append(topic);
+        return it->tree;
+    }
+
+    // Topic trees are read-only copies of a subset of the rules, so they can be shared with
+    // sessions. Topics without rules are also cached to avoid looking them up again.
+
+    QSharedPointer<Nlp::Tree> tree;
+    int nodes = 0;
+
+    if (m_tree) {
+        qDebug() << "Cb2Engine: Building tree for topic" << topicName(topic);
+
+        Nlp::Tree *t = new Nlp::Tree(m_matchMode, m_tools);
+
+        Nlp::RuleList rules;
+        foreach (const Nlp::Rule &rule, m_rules) {
+            if (m_ruleTopics.value(rule.id()).topic == topic) {
+                rules.append(rule);
+            }
+        }
+
+        // Outputs are already parsed in the tree of all rules
+        t->setOutputSource(m_tree.data());
+        t->add(rules);
+        t->setOutputSource(0);
+
+        if (!t->isEmpty()) {
+            tree = makeSharedPtr(t);
+            nodes = t->memoryReport().value("nodes").toInt();
+        } else {
+            delete t;
+        }
+    }
+
+    // Least recently used trees are evicted to keep the nodes of all topic trees under the
+    // limit. Evicted trees are freed once no search uses them and rebuilt on their next lookup.
+
+    int maxNodes = Cmn::SettingsSnapshot::current().intValue(SETTING_NLP_TOPIC_TREES_MAX_NODES);
+
+    while (!m_topicTreesLru.isEmpty() && m_topicTreesNodes + nodes > maxNodes) {
+        m_topicTreesNodes -= m_topicTrees.take(m_topicTreesLru.takeFirst()).nodes;
+    }
+
+    m_topicTrees.insert(topic, TopicTree(tree, nodes));
+    m_topicTreesLru.append(topic);
+    m_topicTreesNodes += nodes;
+
+    return tree;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::clearTopicTrees()
+{
+    QMutexLocker locker(m_topicTreesMutex);
+
+    m_topicTrees.clear();
+    m_topicTreesLru.clear();
+    m_topicTreesNodes = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::recordTotal(qint64 usecs)
+{
+    m_stats->record(Nlp::EngineStats::TotalStage, usecs);
+
+    if (m_stats->histogram(Nlp::EngineStats::TotalStage).count() % STATS_LOG_INTERVAL == 0) {
+        QMutexLocker locker(m_logMutex);
+
+        if (m_logFile->isOpen()) {
+            QString line = QString("%1 Stats: %2\n")
+                    .arg(QDateTime::currentDateTime().toString(Qt::ISODate))
+                    .arg(m_stats->toString());
+            m_logFile->write(line.toUtf8());
+            m_logFile->flush();
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::setEvasives(const QStringList &evasives, const QString &target)
+{
+    QWriteLocker locker(m_rwLock);
+
+    if (evasives.isEmpty()) {
+        m_evasives.remove(target);
+    } else {
+        m_evasives[target] = Nlp::CondOutputList(evasives, true);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::Cb2Engine::getEvasive(const QString &target) const
+{
+    QReadLocker locker(m_rwLock);
+
+    EvasivesMap::const_iterator it = m_evasives.find(target);
+    if (it == m_evasives.constEnd()) {
+        it = m_evasives.find(ANY_USER);
+    }
+
+    if (it == m_evasives.constEnd()) {
+        return QString();
+    }
+
+    // There is no matched input, so conditions and variables are evaluated with empty values
+    const Nlp::OutputTemplate *output = it->nextValidOutput(Nlp::VarStack());
+
+    if (!output) {
+        return QString();
+    }
+
+    if (!output->hasVariables()) {
+        return output->rawString();
+    }
+
+    QString evasive;
+    foreach (const Nlp::OutputTemplate::Segment &seg, output->segments()) {
+        evasive += seg.text;
+    }
+
+    return evasive;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::Cb2Engine::getCurrentTopic(const QString &target) const
+{
+    QReadLocker locker(m_rwLock);
+
+    return topicName(m_sessions->topic(target));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::markDirty()
+{
+    m_dirty = true;
+    ++m_rulesVersion;
+
+    if (m_asyncReload) {
+        startReload();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::markUpdated()
+{
+    // Incremental updates change the tree in place unless it is dirty
+    ++m_rulesVersion;
+
+    if (!m_dirty) {
+        m_treeVersion = m_rulesVersion;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Cb2Engine::mustRefresh() const
+{
+    // With async reload lookups only wait if there is no tree at all
+    return m_dirty && !(m_asyncReload && m_tree);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::startReload()
+{
+    // Invoked with the write lock held, as reload() resets the flag
+    if (!m_reloading) {
+        m_reloading = true;
+        m_reload = Cmn::TaskScheduler::scheduler()->run(Cmn::TaskScheduler::Build, this,
+                                                         &Cb2Engine::reload);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::reload()
+{
+    for (;;) {
+        refreshIfDirty();
+
+        QWriteLocker locker(m_rwLock);
+
+        // Rules could have changed after refreshing. If so, build again in this same thread
+        if (!m_dirty) {
+            m_reloading = false;
+            return;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::refreshIfDirty()
+{
+    // One build at a time. NLP tools do not change while building
+    QMutexLocker buildLocker(m_buildMutex);
+
+    for (;;) {
+        Nlp::RuleList rules;
+        Nlp::MatchPolicy::Mode matchMode = Nlp::MatchPolicy::LemmaMatch;
+        QSharedPointer<Nlp::Toolchain> tools;
+        bool minimize = false;
+        quint32 version = 0;
+
+        {
+            QReadLocker locker(m_rwLock);
+
+            // Another thread could have refreshed the trees meanwhile
+            if (!m_dirty) {
+                return;
+            }
+
+            rules = m_rules;
+            matchMode = m_matchMode;
+            tools = m_tools;
+            minimize = m_minimizeTree;
+            version = m_rulesVersion;
+        }
+
+        qDebug("Cb2Engine: Dirty flag set. Refreshing trees...");
+
+        // The lock is not held while building, so lookups are not blocked meanwhile
+        QSharedPointer<Nlp::Tree> tree = buildTree(rules, matchMode, tools, minimize);
+
+        QWriteLocker locker(m_rwLock);
+
+        // If rules changed while building, the tree is outdated. Build it again
+        if (version == m_rulesVersion) {
+            publishTree(tree, version);
+            return;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::refresh()
+{
+    publishTree(buildTree(m_rules, m_matchMode, m_tools, m_minimizeTree), m_rulesVersion);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::publishTree(QSharedPointer<Nlp::Tree> tree, quint32 version)
+{
+    m_tree = tree;
+    m_treeVersion = version;
+    m_sharedTrees = false;
+    m_dirty = false;
+    clearTopicTrees();
+
+    refreshTopics();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::Cb2Engine::indexOfRule(Nlp::RuleId ruleId) const
+{
+    for (int i = 0; i < m_rules.size(); ++i) {
+        if (m_rules[i].id() == ruleId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::addToTrees(const Nlp::Rule &rule)
+{
+    // Shared trees are read-only and minimized trees cannot grow. Compile our own trees on the
+    // next lookup
+    if (m_sharedTrees || (m_tree && m_tree->isMinimized())) {
+        markDirty();
+        return;
+    }
+
+    clearTopicTrees();
+
+    if (!m_tree) {
+        m_tree = makeSharedPtr(new Nlp::Tree(m_matchMode, m_tools));
+    }
+
+    m_tree->add(rule);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::removeFromTrees(const Nlp::Rule &rule)
+{
+    // Shared trees are read-only. Compile our own trees on the next lookup
+    if (m_sharedTrees) {
+        markDirty();
+        return;
+    }
+
+    clearTopicTrees();
+
+    if (m_tree) {
+        m_tree->remove(rule.id());
+
+        // Prune the nodes left without outputs
+        if (m_tree->isMinimized()) {
+            m_tree->minimize();
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::Nlp::Cb2Engine::snapshotKey(const QString &config) const
+{
+    QByteArray data;
+    QDataStream ostream(&data, QIODevice::WriteOnly);
+
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << config;
+
+    if (m_tools) {
+        ostream << m_tools->lang();
+    }
+
+    foreach (const Nlp::Rule &rule, m_rules) {
+        ostream << (quint64)rule.id() << rule.input() << rule.output() << rule.target()
+                << rule.topic() << rule.nextTopic() << rule.randomOutput();
+    }
+
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::Cb2Engine::snapshotId(const QString &config) const
+{
+    QReadLocker locker(m_rwLock);
+
+    return QString::fromLatin1(snapshotKey(config).toHex());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::shareSnapshotTree(const QByteArray &key)
+{
+    QMutexLocker locker(&s_snapshotTreesMutex);
+
+    // Forget trees that no engine uses anymore
+    SnapshotTreeRegistry::iterator it = s_snapshotTrees.begin();
+    while (it != s_snapshotTrees.end()) {
+        if (it->isNull()) {
+            it = s_snapshotTrees.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    s_snapshotTrees[key] = m_tree;
+
+    // Shared trees are read-only, rule changes compile a new tree
+    m_sharedTrees = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::build()
+{
+    refreshIfDirty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Cb2Engine::saveSnapshot(const QString &filename, const QString &config)
+{
+    QWriteLocker locker(m_rwLock);
+
+    if (m_dirty) {
+        refresh();
+    }
+
+    // The snapshot is written aside and then renamed, so other processes never map a partial
+    // file. The temporary name is per process, several of them may write the same snapshot.
+    QString tmpFilename = filename + "." + QString::number(QCoreApplication::applicationPid())
+            + ".tmp";
+
+    QFile file(tmpFilename);
+
+    if (!file.open(QFile::WriteOnly)) {
+        qCritical() << "Cb2Engine: Cannot write snapshot" << filename;
+        return false;
+    }
+
+    qDebug() << "Cb2Engine: Writing snapshot" << filename;
+
+    QByteArray key = snapshotKey(config);
+
+    QDataStream ostream(&file);
+
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << (quint32)SNAPSHOT_MAGIC_NUMBER;
+    ostream << (quint32)SNAPSHOT_FILE_FORMAT_VERSION;
+    ostream << key;
+
+    if (m_tree) {
+        m_tree->save(ostream);
+    } else {
+        Nlp::Tree().save(ostream);
+    }
+
+    file.close();
+
+    if (ostream.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        qCritical() << "Cb2Engine: Cannot write snapshot" << filename;
+        QFile::remove(tmpFilename);
+        return false;
+    }
+
+    QFile::remove(filename);
+
+    if (!QFile::rename(tmpFilename, filename)) {
+        qCritical() << "Cb2Engine: Cannot rename" << tmpFilename << "to" << filename;
+        QFile::remove(tmpFilename);
+        return false;
+    }
+
+    if (m_tree) {
+        shareSnapshotTree(sharedTreeKey(key, m_matchMode));
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Cb2Engine::loadSnapshot(const QString &filename, const QString &config)
+{
+    QWriteLocker locker(m_rwLock);
+
+    QFile file(filename);
+
+    if (!file.exists() || !file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    qDebug() << "Cb2Engine: Reading snapshot" << filename;
+
+    // If possible, map the snapshot instead of reading it
+    uchar *mapped = file.map(0, file.size());
+    QByteArray data = mapped ? QByteArray::fromRawData((const char *)mapped, file.size())
+                             : file.readAll();
+
+    QDataStream istream(data);
+
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray key;
+
+    istream >> magic >> version;
+
+    if (magic != SNAPSHOT_MAGIC_NUMBER || version != SNAPSHOT_FILE_FORMAT_VERSION) {
+        qWarning() << "Cb2Engine: Ignoring snapshot with invalid format version" << filename;
+        return false;
+    }
+
+    istream >> key;
+
+    if (key != snapshotKey(config)) {
+        qDebug() << "Cb2Engine: Ignoring outdated snapshot" << filename;
+        return false;
+    }
+
+    QByteArray treeKey = sharedTreeKey(key, m_matchMode);
+    QSharedPointer<Nlp::Tree> tree;
+
+    {
+        QMutexLocker registryLocker(&s_snapshotTreesMutex);
+        tree = s_snapshotTrees.value(treeKey).toStrongRef();
+    }
+
+    // Another engine of this process already decoded the same snapshot
+    if (tree) {
+        qDebug() << "Cb2Engine: Sharing the tree of snapshot" << filename;
+    } else {
+        tree = makeSharedPtr(new Nlp::Tree(m_matchMode, m_tools));
+
+        if (!tree->load(istream) || istream.status() != QDataStream::Ok) {
+            qCritical() << "Cb2Engine: Cannot read snapshot: Invalid file format" << filename;
+            return false;
+        }
+    }
+
+    // Trees do not reference the mapped data, so it's safe to unmap the file
+    data.clear();
+    if (mapped) {
+        file.unmap(mapped);
+    }
+
+    publishTree(tree, m_rulesVersion);
+    shareSnapshotTree(treeKey);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::reorderByTopic(int topic, Nlp::ResultList &results) const
+{
+    if (topic == 0) {
+        return;
+    }
+
+    for (int i = 0, j = 0; i < results.size(); ++i) {
+        if (m_ruleTopics.value(results[i].ruleId).topic == topic) {
+            results.move(i, j++);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::Cb2Engine::internTopic(const QString &topic)
+{
+    if (topic.isEmpty()) {
+        return 0;
+    }
+
+    // Topic ids are never reused, so current topics remain valid after rule updates
+    QHash<QString, int>::const_iterator it = m_topicIds.find(topic);
+
+    if (it != m_topicIds.constEnd()) {
+        return *it;
+    }
+
+    m_topicNames.append(topic);
+
+    return m_topicIds[topic] = m_topicNames.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::Cb2Engine::topicName(int topic) const
+{
+    return topic > 0 ? m_topicNames[topic - 1] : QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::updateRuleTopics(const Nlp::Rule &rule)
+{
+    int topic = internTopic(rule.topic());
+    int nextTopic = rule.nextTopic().isEmpty() ? topic : internTopic(rule.nextTopic());
+
+    m_ruleTopics[rule.id()] = RuleTopics(topic, nextTopic);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::refreshTopics()
+{
+    m_ruleTopics.clear();
+    m_ruleTopics.reserve(m_rules.size());
+
+    foreach (const Nlp::Rule &rule, m_rules) {
+        updateRuleTopics(rule);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::setTopic(Nlp::Result &result) const
+{
+    result.topic = topicName(m_ruleTopics.value(result.ruleId).topic);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::setPreSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
+{
+    // Builds use the NLP tools without holding the lock
+    QMutexLocker buildLocker(m_buildMutex);
+    QWriteLocker locker(m_rwLock);
+
+    toolchain(m_tools)->setPreSanitizer(sanitizer);
+
+    markDirty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::setLemmatizer(Lvk::Nlp::Lemmatizer *lemmatizer)
+{
+    // Builds use the NLP tools without holding the lock
+    QMutexLocker buildLocker(m_buildMutex);
+    QWriteLocker locker(m_rwLock);
+
+    toolchain(m_tools)->setLemmatizer(lemmatizer);
+
+    markDirty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::setPostSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
+{
+    // Builds use the NLP tools without holding the lock
+    QMutexLocker buildLocker(m_buildMutex);
+    QWriteLocker locker(m_rwLock);
+
+    toolchain(m_tools)->setPostSanitizer(sanitizer);
+
+    markDirty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariant Lvk::Nlp::Cb2Engine::property(const QString &name)
+{
+    if (name == NLP_PROP_PREFER_CUR_TOPIC) {
+        return QVariant(m_preferCurTopic);
+    } else if (name == NLP_PROP_SPLIT_SENTENCES) {
+        return QVariant(m_splitSentences);
+    } else if (name == NLP_PROP_LEMMA_MATCH) {
+        return QVariant(m_matchMode != Nlp::MatchPolicy::ExactMatch);
+    } else if (name == NLP_PROP_FUZZY_MATCH) {
+        return QVariant(m_matchMode == Nlp::MatchPolicy::FuzzyMatch);
+    } else if (name == NLP_PROP_STATS) {
+        return QVariant(m_stats->toVariantMap());
+    } else if (name == NLP_PROP_RULE_HITS) {
+        QReadLocker locker(m_rwLock);
+        return QVariant(m_ruleHits->toVariantMap());
+    } else if (name == NLP_PROP_MAX_RECURSION) {
+        return QVariant(m_maxRecursion);
+    } else if (name == NLP_PROP_MAX_RECURSION_TIME) {
+        return QVariant(m_maxRecursionTime);
+    } else if (name == NLP_PROP_MAX_SEARCH_STEPS) {
+        return QVariant(m_maxSearchSteps);
+    } else if (name == NLP_PROP_MIN_SIMILARITY) {
+        return QVariant(m_minSimilarity);
+    } else if (name == NLP_PROP_BEST_EFFORT) {
+        return QVariant(m_bestEffort);
+    } else if (name == NLP_PROP_MINIMIZE_TREE) {
+        return QVariant(m_minimizeTree);
+    } else if (name == NLP_PROP_MEMORY) {
+        return QVariant(memoryReport());
+    } else if (name == NLP_PROP_ASYNC_RELOAD) {
+        return QVariant(m_asyncReload);
+    } else if (name == NLP_PROP_LANGUAGE) {
+        QString lang = toolchain(m_tools)->lang();
+        return QVariant(lang.isEmpty() ? Nlp::Toolchain::defaultLanguage() : lang);
+    } else if (name == NLP_PROP_RESPONSE_CACHE_SIZE) {
+        return QVariant(m_responseCache->maxSize());
+    } else if (name == NLP_PROP_RULES_VERSION) {
+        QReadLocker locker(m_rwLock);
+        return QVariant(m_treeVersion);
+    } else {
+        return QVariant();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Nlp::Cb2Engine::memoryReport() const
+{
+    QReadLocker locker(m_rwLock);
+
+    QVariantMap report;
+
+    if (m_tree) {
+        report = m_tree->memoryReport();
+    }
+
+    int evasiveOutputs = 0;
+    foreach (const Nlp::CondOutputList &outputList, m_evasives) {
+        evasiveOutputs += outputList.size();
+    }
+
+    Nlp::SymbolTable *symbols = Nlp::SymbolTable::instance();
+
+    report["rules"] = m_rules.size();
+    report["treeCount"] = m_tree ? 1 : 0;
+    {
+        QMutexLocker topicTreesLocker(m_topicTreesMutex);
+        report["topicTreeCount"] = m_topicTrees.size();
+        report["topicTreeNodes"] = m_topicTreesNodes;
+    }
+    report["evasiveOutputs"] = evasiveOutputs;
+    report["sessions"] = m_sessions->size();
+    report["symbols"] = symbols->size();
+    report["symbolBytes"] = symbols->bytes();
+
+    return report;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::setProperty(const QString &name, const QVariant &value)
+{
+    if (name == NLP_PROP_PREFER_CUR_TOPIC) {
+        QWriteLocker locker(m_rwLock);
+
+        if (value.toBool() == true && !m_preferCurTopic) {
+            qDebug() << "Cb2Engine: Enabled topics";
+            m_preferCurTopic = true;
+        }
+        if (value.toBool() == false && m_preferCurTopic) {
+            qDebug() << "Cb2Engine: Disabled topics";
+            m_preferCurTopic = false;
+            m_sessions->clear();
+        }
+    } else if (name == NLP_PROP_SPLIT_SENTENCES) {
+        QWriteLocker locker(m_rwLock);
+
+        m_splitSentences = value.toBool();
+    } else if (name == NLP_PROP_LEMMA_MATCH) {
+        QWriteLocker locker(m_rwLock);
+
+        Nlp::MatchPolicy::Mode mode = m_matchMode;
+        if (!value.toBool()) {
+            mode = Nlp::MatchPolicy::ExactMatch;
+        } else if (mode == Nlp::MatchPolicy::ExactMatch) {
+            mode = Nlp::MatchPolicy::LemmaMatch;
+        }
+        if (mode != m_matchMode) {
+            qDebug() << "Cb2Engine: Lemma match" << (value.toBool() ? "enabled" : "disabled");
+            m_matchMode = mode;
+            markDirty();
+        }
+    } else if (name == NLP_PROP_FUZZY_MATCH) {
+        QWriteLocker locker(m_rwLock);
+
+        // Disabling fuzzy match keeps lemma match
+        Nlp::MatchPolicy::Mode mode = m_matchMode;
+        if (value.toBool()) {
+            mode = Nlp::MatchPolicy::FuzzyMatch;
+        } else if (mode == Nlp::MatchPolicy::FuzzyMatch) {
+            mode = Nlp::MatchPolicy::LemmaMatch;
+        }
+        if (mode != m_matchMode) {
+            qDebug() << "Cb2Engine: Fuzzy match" << (value.toBool() ? "enabled" : "disabled");
+            m_matchMode = mode;
+            markDirty();
+        }
+    } else if (name == NLP_PROP_STATS) {
+        // Any value resets the stats
+        m_stats->clear();
+    } else if (name == NLP_PROP_RULE_HITS) {
+        QWriteLocker locker(m_rwLock);
+
+        if (value.type() == QVariant::Map) {
+            m_ruleHits->setHits(value.toMap());
+        } else {
+            m_ruleHits->reset();
+        }
+    } else if (name == NLP_PROP_MAX_RECURSION) {
+        QWriteLocker locker(m_rwLock);
+
+        m_maxRecursion = value.isValid() ? value.toInt() : DEFAULT_MAX_RECURSION;
+        m_responseCache->clear();
+    } else if (name == NLP_PROP_MAX_RECURSION_TIME) {
+        QWriteLocker locker(m_rwLock);
+
+        m_maxRecursionTime = value.isValid() ? value.toLongLong() : DEFAULT_MAX_RECURSION_TIME;
+        m_responseCache->clear();
+    } else if (name == NLP_PROP_MAX_SEARCH_STEPS) {
+        QWriteLocker locker(m_rwLock);
+
+        m_maxSearchSteps = value.isValid() ? value.toInt() : defaultMaxSearchSteps();
+        m_responseCache->clear();
+    } else if (name == NLP_PROP_MIN_SIMILARITY) {
+        QWriteLocker locker(m_rwLock);
+
+        m_minSimilarity = value.isValid() ? qBound(0.0f, value.toFloat(), 1.0f)
+                                          : defaultMinSimilarity();
+        m_responseCache->clear();
+    } else if (name == NLP_PROP_BEST_EFFORT) {
+        QWriteLocker locker(m_rwLock);
+
+        m_bestEffort = value.toBool();
+    } else if (name == NLP_PROP_MINIMIZE_TREE) {
+        QWriteLocker locker(m_rwLock);
+
+        if (value.toBool() != m_minimizeTree) {
+            qDebug() << "Cb2Engine: Tree minimization" << (value.toBool() ? "enabled" : "disabled");
+            m_minimizeTree = value.toBool();
+            markDirty();
+        }
+    } else if (name == NLP_PROP_ASYNC_RELOAD) {
+        QWriteLocker locker(m_rwLock);
+
+        m_asyncReload = value.toBool();
+
+        if (m_asyncReload && m_dirty) {
+            startReload();
+        }
+    } else if (name == NLP_PROP_WARM_UP) {
+        QStringList inputs = value.toStringList();
+
+        if (!inputs.isEmpty()) {
+            QMutexLocker locker(m_buildMutex);
+
+            m_warmUp.waitForFinished();
+            m_warmUp = Cmn::TaskScheduler::scheduler()->run(Cmn::TaskScheduler::Background,
+                                                            warmUpTools, m_tools, inputs);
+        }
+    } else if (name == NLP_PROP_RESPONSE_CACHE_SIZE) {
+        int size = Cmn::SettingsSnapshot::current().value(SETTING_NLP_RESPONSE_CACHE_SIZE).toInt();
+
+        m_responseCache->setMaxSize(value.isValid() ? value.toInt() : size);
+    }
+}
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::Nlp::Cb2Engine::clear()
 {
-    QMutexLocker locker(m_mutex);
+    QWriteLocker locker(m_rwLock);
 
-    m_dirty = true;
+    markDirty();
     m_rules.clear();
-    m_trees.clear();
-    m_topics.clear();
+    m_ruleHits->clear();
+    m_tree.clear();
+    m_sharedTrees = false;
+    m_ruleTopics.clear();
+    m_evasives.clear();
+    clearTopicTrees();
+
+    m_sessions->clear();
+    m_topicNames.clear();
+    m_topicIds.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Engine * Lvk::Nlp::Cb2Engine::createSession()
+{
+    return new Cb2Engine(this);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::lintRules(Nlp::RuleIssueList &issues)
+{
+    issues.clear();
+
+    refreshIfDirty();
+
+    QReadLocker locker(m_rwLock);
+
+    QSet<Nlp::Tree::RuleInput> inputs;
+
+    if (m_tree) {
+        m_tree->lint(issues, inputs);
+    }
+
+    // Inputs not present in any tree were discarded because they were empty once parsed
+    foreach (const Nlp::Rule &rule, m_rules) {
+        for (int i = 0; i < rule.input().size(); ++i) {
+            if (!inputs.contains(Nlp::Tree::RuleInput(rule.id(), i))) {
+                issues.append(Nlp::RuleIssue(Nlp::RuleIssue::EmptyInput, rule.id(), i));
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Cb2Engine::profileRules(Nlp::RuleCostList &costs)
+{
+    // NLP tools do not change while building
+    QMutexLocker buildLocker(m_buildMutex);
+
+    Nlp::RuleList rules;
+    Nlp::MatchPolicy::Mode matchMode = Nlp::MatchPolicy::LemmaMatch;
+    QSharedPointer<Nlp::Toolchain> tools;
+
+    {
+        QReadLocker locker(m_rwLock);
+
+        rules = m_rules;
+        matchMode = m_matchMode;
+        tools = m_tools;
+    }
+
+    // The tree is dropped afterwards, lookups keep using the published one
+    costs = buildTree(rules, matchMode, tools, false, true)->ruleCosts();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::Cb2Engine::memoryUsage() const
+{
+    QMutexLocker locker(m_topicTreesMutex);
+
+    return (qint64)m_topicTreesNodes*TREE_NODE_BYTES;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::Cb2Engine::releaseMemory(qint64 bytes)
+{
+    QMutexLocker locker(m_topicTreesMutex);
+
+    // Evicted trees are freed once no search nor session uses them
+
+    qint64 released = 0;
+
+    while (!m_topicTreesLru.isEmpty() && released < bytes) {
+        int nodes = m_topicTrees.take(m_topicTreesLru.takeFirst()).nodes;
+        m_topicTreesNodes -= nodes;
+        released += (qint64)nodes*TREE_NODE_BYTES;
+    }
+
+    return released;
+}
@@ -24,13 +24,20 @@
 
 #include "nlp-engine/engine.h"
 #include "nlp-engine/tree.h"
+#include "nlp-engine/condoutputlist.h"
+#include "common/memorymanager.h"
 
 #include <QHash>
 #include <QString>
+#include <QStringList>
+#include <QByteArray>
 #include <QSharedPointer>
+#include <QFuture>
+#include <QElapsedTimer>
 #include <memory>
 
 class QMutex;
+class QReadWriteLock;
 class QFile;
 
 namespace Lvk
@@ -48,14 +55,38 @@ namespace Nlp
 
 class Sanitizer;
 class Lemmatizer;
+class Toolchain;
+class ResponseCache;
+class RuleHits;
+class SessionStore;
 
 /**
  * \brief The Cb2Engine class provides a custom NLP engine
  *
  * Optionally, sanitizers and lemmatizers can be provided at construction time to improve
  * rule matching.
+ *
+ * Cb2Engine is thread-safe. Lookups only take a read lock, so several threads can get responses
+ * in parallel. Methods that change rules or NLP tools take a write lock.
+ *
+ * Rules are compiled without holding the lock. The new tree is swapped in under a short write
+ * lock, so lookups running meanwhile finish on the old tree. By default, the first lookup after
+ * a change compiles the rules and waits for them. If NLP_PROP_ASYNC_RELOAD is enabled, rules
+ * are compiled in background as soon as they change, and lookups keep using the old tree until
+ * the new one is ready. Every change of rules increments the rules version, which is stamped
+ * on each Result.
+ *
+ * getResponse() keeps the winning rule of each input, target and current topic in a
+ * ResponseCache, so repeated inputs skip lemmatization and search. Only rules with constant
+ * outputs are cached, and the cache is discarded whenever the rules change.
+ *
+ * Engines of the same process that load or save a snapshot with the same rules, config and
+ * match mode share one read-only tree. Changing the rules of one of them compiles its own tree.
+ *
+ * Topic trees and the ResponseCache are consumers of the MemoryManager, so they shrink under
+ * memory pressure.
  */
-class Cb2Engine : public Engine
+class Cb2Engine : public Engine, public Cmn::MemoryConsumer
 {
 public:
 
@@ -80,6 +111,15 @@ public:
      */
     Cb2Engine(Sanitizer *preSanitizer, Lemmatizer *lemmatizer, Sanitizer *postSanitizer);
 
+    /**
+     * Construtcs a Cb2Engine object that parses rules and inputs with its own NLP \a tools
+     * instead of GlobalTools. Engines of different languages can run in the same process this
+     * way. Setting sanitizers or lemmatizers changes \a tools.
+     *
+     * \see EngineFactory::createEngine(const QString &)
+     */
+    explicit Cb2Engine(QSharedPointer<Nlp::Toolchain> tools);
+
     /**
      * Destroys the object.
      */
@@ -100,6 +140,20 @@ public:
      */
     virtual void addRule(const Rule &rule);
 
+    /**
+     * \copydoc Engine::removeRule()
+     *
+     * Only the outputs of the rule are removed, the tree is not rebuilt.
+     */
+    virtual void removeRule(RuleId ruleId);
+
+    /**
+     * \copydoc Engine::updateRule()
+     *
+     * Only the outputs of the old and new rule are updated, the tree is not rebuilt.
+     */
+    virtual void updateRule(const Rule &rule);
+
     /**
      * \copydoc Engine::getResponse(const QString &, MatchList &)
      */
@@ -107,6 +161,12 @@ public:
 
     /**
      * \copydoc Engine::getResponse(const QString &input, const QString&, MatchList &)
+     *
+     * This method does not compute all responses. It runs a bounded search that only looks for
+     * the best one. If NLP_PROP_PREFER_CUR_TOPIC is enabled, it first searches a tree with only
+     * the rules on the current topic, and only on a miss it searches the tree with all rules.
+     * Topic trees are built on first use and the least recently used ones are evicted once
+     * their nodes exceed the setting SETTING_NLP_TOPIC_TREES_MAX_NODES.
      */
     virtual QString getResponse(const QString &input, const QString &target, MatchList &matches);
 
@@ -121,6 +181,54 @@ public:
     virtual QStringList getAllResponses(const QString &input, const QString &target,
                                         MatchList &matches);
 
+    /**
+     * \copydoc Engine::getResponse(const QString &, const QString &, Result &)
+     */
+    virtual void getResponse(const QString &input, const QString &target, Result &result);
+
+    /**
+     * \copydoc Engine::getResponseAsync()
+     *
+     * Searches run in the Reply class of the shared Cmn::TaskScheduler. The engine waits for
+     * the running searches when it is destroyed.
+     */
+    virtual QFuture<Result> getResponseAsync(const QString &input, const QString &target,
+                                             int deadline = 0);
+
+    /**
+     * \copydoc Engine::explainResponse()
+     *
+     * Candidates come from a second search that gets all results, so its steps are not
+     * counted. If split sentences is enabled, the whole input is explained as one sentence.
+     */
+    virtual void explainResponse(const QString &input, const QString &target,
+                                 SearchExplain &explain, int topCount = 10);
+
+    /**
+     * \copydoc Engine::getAllResponses(const QString &, const QString &, ResultList &)
+     */
+    virtual void getAllResponses(const QString &input, const QString &target,
+                                 ResultList &results);
+
+    /**
+     * \copydoc Engine::getResponses()
+     *
+     * Inputs are lemmatized in a single batch. Large batches are searched concurrently
+     * in the global thread pool.
+     */
+    virtual void getResponses(const QStringList &inputs, const QString &target,
+                              QList<ResultList> &results);
+
+    /**
+     * \copydoc Engine::setEvasives()
+     */
+    virtual void setEvasives(const QStringList &evasives, const QString &target);
+
+    /**
+     * \copydoc Engine::getEvasive()
+     */
+    virtual QString getEvasive(const QString &target) const;
+
     /**
      * \copydoc Engine::getCurrentTopic()
      */
@@ -150,49 +258,278 @@ public:
     /**
      * \copydoc Engine::property()
      *
-     * Cb2Engine supports only one property:
-     * NLP_PROP_PREFER_CUR_TOPIC with values \a true or \a false. If \a true rules on the current
-     * topic have higher priority. By default is false.
+     * Cb2Engine supports sixteen properties:
+     * - NLP_PROP_PREFER_CUR_TOPIC with values \a true or \a false. If \a true rules on the
+     *   current topic have higher priority. By default is false. Targets idle for longer than
+     *   the setting SETTING_NLP_SESSION_TTL lose their current topic.
+     * - NLP_PROP_SPLIT_SENTENCES with values \a true or \a false. If \a true getResponse()
+     *   splits the input into sentences and matches each one apart. The reply joins the outputs
+     *   of the sentences that matched. By default is false.
+     * - NLP_PROP_LEMMA_MATCH with values \a true or \a false. If \a false words are only
+     *   matched by their original form and lemmas are never compared. By default is true.
+     * - NLP_PROP_FUZZY_MATCH with values \a true or \a false. If \a true words also match,
+     *   with less weight, words of the rules within a small edit distance. It implies
+     *   NLP_PROP_LEMMA_MATCH. By default is false.
+     * - NLP_PROP_STATS returns a QVariantMap with the latency of each stage of a response.
+     *   \see EngineStats::toVariantMap()
+     * - NLP_PROP_MAX_RECURSION with the maximum depth of nested searches started by recursive
+     *   variables. Outputs that exceed it are skipped. -1 means no limit. By default is 16.
+     * - NLP_PROP_MAX_RECURSION_TIME with the maximum time in milliseconds a response can spend
+     *   in nested searches before they fail. 0 means no limit. By default is 0.
+     * - NLP_PROP_MAX_SEARCH_STEPS with the maximum amount of nodes a search, including its
+     *   nested searches, can visit. Searches that exceed it are aborted and find no results,
+     *   so the chatbot replies with an evasive. 0 means no limit. By default is the setting
+     *   SETTING_NLP_MAX_SEARCH_STEPS.
+     * - NLP_PROP_MIN_SIMILARITY with the minimum cosine similarity, between 0 and 1, of the
+     *   rule input used when nothing matches, before falling back to evasives. Only rule
+     *   inputs with constant outputs are used. 0 disables the fallback. By default is the
+     *   setting SETTING_NLP_MIN_SIMILARITY. \see Tree::getResponse()
+     * - NLP_PROP_BEST_EFFORT with values \a true or \a false. See setProperty().
+     * - NLP_PROP_MINIMIZE_TREE with values \a true or \a false. See setProperty().
+     * - NLP_PROP_MEMORY returns a QVariantMap with the memory report of the compiled trees:
+     *   the keys of Tree::memoryReport() for the tree of all rules, the amount of rules, trees,
+     *   topic trees, nodes of topic trees, evasive outputs, targets with a current topic and
+     *   interned symbols, and the bytes used by interned symbols.
+     * - NLP_PROP_ASYNC_RELOAD with values \a true or \a false. See setProperty().
+     * - NLP_PROP_RULES_VERSION returns the version of the rules used by lookups. It falls
+     *   behind the latest version while rules are compiled in background.
+     * - NLP_PROP_LANGUAGE returns the language of the NLP tools of the engine.
+     * - NLP_PROP_RESPONSE_CACHE_SIZE with the maximum amount of entries of the response cache.
+     *   See setProperty().
      */
     virtual QVariant property(const QString &name);
 
     /**
      * \copydoc Engine::setProperty()
      *
-     * Cb2Engine supports only one property:
-     * NLP_PROP_PREFER_CUR_TOPIC with values \a true or \a false. If \a true rules on the current
-     * topic have higher priority. By default is false.
+     * Cb2Engine supports fourteen properties:
+     * - NLP_PROP_PREFER_CUR_TOPIC with values \a true or \a false. If \a true rules on the
+     *   current topic have higher priority. By default is false. Targets idle for longer than
+     *   the setting SETTING_NLP_SESSION_TTL lose their current topic.
+     * - NLP_PROP_SPLIT_SENTENCES with values \a true or \a false. If \a true getResponse()
+     *   splits the input into sentences and matches each one apart. The reply joins the outputs
+     *   of the sentences that matched. By default is false.
+     * - NLP_PROP_LEMMA_MATCH with values \a true or \a false. If \a false words are only
+     *   matched by their original form and lemmas are never compared. By default is true.
+     * - NLP_PROP_FUZZY_MATCH with values \a true or \a false. If \a true words also match,
+     *   with less weight, words of the rules within a small edit distance. It implies
+     *   NLP_PROP_LEMMA_MATCH. By default is false.
+     * - NLP_PROP_STATS with any value resets the latency stats.
+     * - NLP_PROP_MAX_RECURSION with the maximum depth of nested searches started by recursive
+     *   variables. Outputs that exceed it are skipped. -1 means no limit. By default is 16.
+     * - NLP_PROP_MAX_RECURSION_TIME with the maximum time in milliseconds a response can spend
+     *   in nested searches before they fail. 0 means no limit. By default is 0.
+     * - NLP_PROP_MAX_SEARCH_STEPS with the maximum amount of nodes a search, including its
+     *   nested searches, can visit. Searches that exceed it are aborted and find no results,
+     *   so the chatbot replies with an evasive. 0 means no limit. By default is the setting
+     *   SETTING_NLP_MAX_SEARCH_STEPS.
+     * - NLP_PROP_MIN_SIMILARITY with the minimum cosine similarity, between 0 and 1, of the
+     *   rule input used when nothing matches, before falling back to evasives. Only rule
+     *   inputs with constant outputs are used. 0 disables the fallback. By default is the
+     *   setting SETTING_NLP_MIN_SIMILARITY. \see Tree::getResponse()
+     * - NLP_PROP_BEST_EFFORT with values \a true or \a false. If \a true searches of
+     *   getResponseAsync() that miss their deadline reply with the best result found so far
+     *   instead of no result. Such results are not cached. By default is false.
+     * - NLP_PROP_MINIMIZE_TREE with values \a true or \a false. If \a true the tree of all
+     *   rules is minimized after it is compiled, so equal subtrees are shared and use less
+     *   memory. Results do not change. Adding or updating a rule compiles all rules again.
+     *   By default is false. \see Tree::minimize()
+     * - NLP_PROP_ASYNC_RELOAD with values \a true or \a false. If \a true rules are compiled in
+     *   background and lookups do not wait for them, they get responses from the previous rules
+     *   until the new ones are ready. build() still waits. By default is false.
+     * - NLP_PROP_RESPONSE_CACHE_SIZE with the maximum amount of entries of the response cache.
+     *   0 disables the cache. By default is the setting SETTING_NLP_RESPONSE_CACHE_SIZE.
+     * - NLP_PROP_WARM_UP with a QStringList of inputs. They are parsed in background like user
+     *   inputs and the results are dropped, so a lemmatizer that caches results, such as
+     *   CachedLemmatizer, has them ready for the first lookups.
      */
     virtual void setProperty(const QString &name, const QVariant &value);
 
+    /**
+     * \copydoc Engine::build()
+     */
+    virtual void build();
+
+    /**
+     * \copydoc Engine::saveSnapshot()
+     */
+    virtual bool saveSnapshot(const QString &filename, const QString &config);
+
+    /**
+     * \copydoc Engine::loadSnapshot()
+     */
+    virtual bool loadSnapshot(const QString &filename, const QString &config);
+
+    /**
+     * \copydoc Engine::snapshotId()
+     */
+    virtual QString snapshotId(const QString &config) const;
+
     /**
      * \copydoc Engine::clear()
      */
     virtual void clear();
 
+    /**
+     * \copydoc Engine::createSession()
+     *
+     * Trees are shared until the rules of one of the engines change. Then, that engine
+     * compiles its own trees again.
+     */
+    virtual Engine *createSession();
+
+    /**
+     * \copydoc Engine::lintRules()
+     */
+    virtual void lintRules(RuleIssueList &issues);
+
+    /**
+     * \copydoc Engine::profileRules()
+     */
+    virtual void profileRules(RuleCostList &costs);
+
+    /**
+     * \copydoc Cmn::MemoryConsumer::memoryUsage()
+     *
+     * Only topic trees are counted, since the tree of all rules cannot be released.
+     */
+    virtual qint64 memoryUsage() const;
+
+    /**
+     * \copydoc Cmn::MemoryConsumer::releaseMemory()
+     *
+     * The least recently used topic trees are evicted first. They are rebuilt on their next
+     * lookup.
+     */
+    virtual qint64 releaseMemory(qint64 bytes);
+
 private:
     Cb2Engine(Cb2Engine&);
     Cb2Engine& operator=(Cb2Engine&);
 
-    typedef QHash<QString, QSharedPointer<Nlp::Tree> > TreesMap;
-    typedef QHash<QString, QString> TopicsMap;
+    explicit Cb2Engine(Cb2Engine *shared);
+
+    // Topics are interned as integers, topic id 0 means no topic
+    struct RuleTopics
+    {
+        RuleTopics(int topic = 0, int nextTopic = 0) : topic(topic), nextTopic(nextTopic) { }
+
+        int topic;          // Topic of the rule
+        int nextTopic;      // Topic after the rule matches
+    };
+
+    struct TopicTree
+    {
+        TopicTree(const QSharedPointer<Nlp::Tree> &tree = QSharedPointer<Nlp::Tree>(),
+                  int nodes = 0)
+            : tree(tree), nodes(nodes) { }
+
+        QSharedPointer<Nlp::Tree> tree; // Null if the topic has no rules
+        int nodes;                      // Nodes of the tree, used as its memory cost
+    };
+
+    typedef QHash<int, TopicTree> TopicTreesMap;
+
+    // Asynchronous request of getResponseAsync(). Synchronous lookups use a request without
+    // future nor deadline.
+    struct Request
+    {
+        Request(const QFutureInterfaceBase *future = 0, qint64 deadline = 0)
+            : future(future), deadline(deadline) { clock.start(); }
+
+        bool isExpired() const
+        {
+            return (future && future->isCanceled()) || (deadline > 0 && clock.elapsed() > deadline);
+        }
+
+        const QFutureInterfaceBase *future;
+        QElapsedTimer clock;    // Started when the request was made
+        qint64 deadline;        // Milliseconds, 0 means no deadline
+    };
+
+    class ResponseTask;
+    typedef QHash<Nlp::RuleId, RuleTopics> RuleTopicsMap;
+    typedef QHash<QString, Nlp::CondOutputList> EvasivesMap;
 
     RuleList m_rules;
+    QSharedPointer<Nlp::Toolchain> m_tools; // Null if the engine uses GlobalTools
     std::auto_ptr<QFile>      m_logFile;
-    TreesMap                  m_trees;
-    TopicsMap                 m_topics;
-    QMutex *m_mutex;
+    QSharedPointer<Nlp::Tree> m_tree;       // Rules of every target
+    mutable TopicTreesMap     m_topicTrees;      // topic -> tree, built on first lookup
+    mutable QList<int>        m_topicTreesLru;   // Topics in m_topicTrees, most recent last
+    mutable int               m_topicTreesNodes; // Nodes of every tree in m_topicTrees
+    RuleTopicsMap             m_ruleTopics;
+    QStringList               m_topicNames;
+    QHash<QString, int>       m_topicIds;
+    EvasivesMap               m_evasives;
+    QReadWriteLock *m_rwLock;
+    Nlp::SessionStore *m_sessions;    // Current topic of each target
+    QMutex *m_topicTreesMutex;
+    QMutex *m_logMutex;
+    QMutex *m_buildMutex;     // Serializes builds and changes of NLP tools
+    QFuture<void> m_reload;   // Background build, if NLP_PROP_ASYNC_RELOAD is enabled
+    QFuture<void> m_warmUp;   // Background parsing of NLP_PROP_WARM_UP inputs
+    Nlp::EngineStats *m_stats;
+    Nlp::RuleHits *m_ruleHits;       // Responses of each rule
+    Nlp::ResponseCache *m_responseCache;    // Winning rules of previous searches
     bool m_dirty;
+    bool m_asyncReload;
+    bool m_reloading;         // True while a background build is running
+    quint32 m_rulesVersion;   // Incremented on every change of rules or match mode
+    quint32 m_treeVersion;    // Version of the rules in m_tree
+    bool m_sharedTrees;       // True if m_tree and m_topicTrees are shared with other engines
     bool m_preferCurTopic;
-
-    void initLog();
-    void getAllResponsesWithTree(const QString &treeName, const QString &input,
-                                 Nlp::ResultList &results);
+    bool m_splitSentences;
+    Nlp::MatchPolicy::Mode m_matchMode;
+    int m_maxRecursion;
+    qint64 m_maxRecursionTime;
+    int m_maxSearchSteps;
+    float m_minSimilarity;
+    bool m_bestEffort;
+    bool m_minimizeTree;
+
+    void initLog(bool rotate = true);
+    void recordTotal(qint64 usecs);
+    QVariantMap memoryReport() const;
+    QList<Nlp::SymbolId> searchTargets(const QString &target) const;
+    void getAllResponsesWithTarget(Nlp::SymbolId target, const QString &input,
+                                   Nlp::ResultList &results) const;
+    void getResponse(const QString &input, const QString &target, Nlp::Result &result,
+                     const Request &request);
+    bool getBestResponseWithTree(const Nlp::Tree *tree, Nlp::SymbolId target,
+                                 const QString &input, Nlp::Result &result,
+                                 const Request &request, Nlp::SearchExplain *explain = 0) const;
+    bool getBestResponseByTopic(const QString &target, int topic, const QString &input,
+                                Nlp::Result &result, const Request &request);
+    Nlp::Result getBestResponse(const QString &input, const QString &target, int topic,
+                                const Request &request);
+    void getBestResponseBySentence(const QStringList &sentences, const QString &target,
+                                   int topic, Nlp::Result &result, const Request &request);
+    QSharedPointer<Nlp::Tree> resultTree(Nlp::RuleId ruleId, int topic) const;
+    bool getCachedResponse(const QString &key, int topic, Nlp::Result &result) const;
+    void cacheResponse(const QString &key, int topic, const Nlp::Result &result) const;
+    QSharedPointer<Nlp::Tree> topicTree(int topic) const;
+    void clearTopicTrees();
+    void updateTopic(const QString &target, Nlp::ResultList &results);
+    void markDirty();
+    void markUpdated();
+    bool mustRefresh() const;
+    void startReload();
+    void reload();
+    void refreshIfDirty();
     void refresh();
-    Nlp::Tree * buildTree(const QString &target);
-    void reorderByTopic(const QString &topic, Nlp::ResultList &results);
-    QString topicForRule(Nlp::RuleId ruleId);
-    QString nextTopicForRule(Nlp::RuleId ruleId);
+    void publishTree(QSharedPointer<Nlp::Tree> tree, quint32 version);
+    QByteArray snapshotKey(const QString &config) const;
+    void shareSnapshotTree(const QByteArray &key);
+    int indexOfRule(Nlp::RuleId ruleId) const;
+    void addToTrees(const Nlp::Rule &rule);
+    void removeFromTrees(const Nlp::Rule &rule);
+    void reorderByTopic(int topic, Nlp::ResultList &results) const;
+    int internTopic(const QString &topic);
+    QString topicName(int topic) const;
+    void updateRuleTopics(const Nlp::Rule &rule);
+    void refreshTopics();
+    void setTopic(Nlp::Result &result) const;
 };
 
 /// @}
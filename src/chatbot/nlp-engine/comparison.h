@@ -23,6 +23,7 @@
 #define LVK_NLP_COMPARISON_H
 
 #include "nlp-engine/predicate.h"
+#include "common/textsearch.h"
 
 namespace Lvk
 {
@@ -37,24 +38,11 @@ namespace Nlp
 /// \addtogroup Nlp
 /// @{
 
-/**
- * Comparison types
- */
-// TODO consider using functors
-enum CompType
-{
-    Equal,
-    Less,
-    Greater,
-    LessOrEqual,
-    GreaterOrEqual,
-    NotEqual
-};
-
 /**
  * \brief The comparison class provides a Predicate that compares two values.
  *
- * Values Must be of type int, QString and Nlp::Variable
+ * Values Must be of type int, QString and Nlp::Variable. Strings that are not integers are
+ * compared ignoring case and diacritics.
  */
 template<typename T1, typename T2>
 class Comparison : public Predicate
@@ -75,6 +63,18 @@ public:
         return eval(m_comp1, m_comp2, varStack);
     }
 
+    /**
+     * \copydoc Predicate::compile()
+     */
+    virtual bool compile(Nlp::CompiledPredicate &code, QStringList &varNames) const
+    {
+        code.opcode = Nlp::CompiledPredicate::Compare;
+        code.comp = m_type;
+        code.op1 = operand(m_comp1, varNames);
+        code.op2 = operand(m_comp2, varNames);
+        return true;
+    }
+
 private:
 
     T1 m_comp1;
@@ -105,43 +105,41 @@ private:
         if (ok1 && ok2) {
             return eval(i, j, varStack);
         } else {
-            switch (m_type) {
-            case Equal:
-                return s1.compare(s2, Qt::CaseInsensitive) == 0;
-            case Less:
-                return s1.compare(s2, Qt::CaseInsensitive) < 0;
-            case Greater:
-                return s1.compare(s2, Qt::CaseInsensitive) > 0;
-            case LessOrEqual:
-                return s1.compare(s2, Qt::CaseInsensitive) <= 0;
-            case GreaterOrEqual:
-                return s1.compare(s2, Qt::CaseInsensitive) >= 0;
-            case NotEqual:
-                return s1.compare(s2, Qt::CaseInsensitive) != 0;
-            default:
-                return false;
-            }
+            return compResult(m_type, Cmn::TextSearch::compare(s1, s2));
         }
-   }
+    }
 
     bool eval(int i, int j, const Nlp::VarStack &/*varStack*/) const
     {
-        switch (m_type) {
-        case Equal:
-            return i == j;
-        case Less:
-            return i < j;
-        case Greater:
-            return i > j;
-        case LessOrEqual:
-            return i <= j;
-        case GreaterOrEqual:
-            return i >= j;
-        case NotEqual:
-            return i != j;
-        default:
-            return false;
+        return compResult(m_type, i < j ? -1 : (i > j ? 1 : 0));
+    }
+
+    static Nlp::PredicateOperand operand(const QString &s, QStringList &/*varNames*/)
+    {
+        Nlp::PredicateOperand op;
+        op.str = s.toCaseFolded();
+        op.num = s.toInt(&op.isNum);
+        return op;
+    }
+
+    static Nlp::PredicateOperand operand(int i, QStringList &/*varNames*/)
+    {
+        Nlp::PredicateOperand op;
+        op.str = QString::number(i);
+        op.num = i;
+        op.isNum = true;
+        return op;
+    }
+
+    static Nlp::PredicateOperand operand(const Nlp::Variable &v, QStringList &varNames)
+    {
+        Nlp::PredicateOperand op;
+        op.slot = varNames.indexOf(v.name);
+        if (op.slot == -1) {
+            op.slot = varNames.size();
+            varNames.append(v.name);
         }
+        return op;
     }
 };
 
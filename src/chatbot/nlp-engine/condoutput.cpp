@@ -24,6 +24,79 @@
 #include "nlp-engine/predicate.h"
 #include "nlp-engine/parser.h"
 
+#include <QVarLengthArray>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Value of a variable slot, looked up on first use
+struct SlotValue
+{
+    SlotValue() : resolved(false), num(0), isNum(false) { }
+
+    bool resolved;
+    QString str;    // Case folded
+    int num;
+    bool isNum;
+};
+
+typedef QVarLengthArray<SlotValue, 4> SlotValues;
+
+//--------------------------------------------------------------------------------------------------
+
+inline void resolve(const Lvk::Nlp::PredicateOperand &op, const QStringList &varNames,
+                    const Lvk::Nlp::VarStack &varStack, SlotValues &values, QString &str, int &num,
+                    bool &isNum)
+{
+    if (op.slot == -1) {
+        str = op.str;
+        num = op.num;
+        isNum = op.isNum;
+        return;
+    }
+
+    SlotValue &value = values[op.slot];
+
+    if (!value.resolved) {
+        QString s = varStack.value(varNames[op.slot]);
+        value.num = s.toInt(&value.isNum);
+        value.str = s.toCaseFolded();
+        value.resolved = true;
+    }
+
+    str = value.str;
+    num = value.num;
+    isNum = value.isNum;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Same semantics than Comparison::eval(): integers are compared numerically and any other value
+// is compared as a case insensitive string
+inline bool compare(const Lvk::Nlp::CompiledPredicate &code, const QStringList &varNames,
+                    const Lvk::Nlp::VarStack &varStack, SlotValues &values)
+{
+    QString s1, s2;
+    int i = 0, j = 0;
+    bool ok1 = false, ok2 = false;
+
+    resolve(code.op1, varNames, varStack, values, s1, i, ok1);
+    resolve(code.op2, varNames, varStack, values, s2, j, ok2);
+
+    if (ok1 && ok2) {
+        return Lvk::Nlp::compResult(code.comp, i < j ? -1 : (i > j ? 1 : 0));
+    } else {
+        return Lvk::Nlp::compResult(code.comp, s1.compare(s2));
+    }
+}
+
+} // namespace
+
+
 //--------------------------------------------------------------------------------------------------
 // CondOutput
 //--------------------------------------------------------------------------------------------------
@@ -36,21 +109,53 @@ Lvk::Nlp::CondOutput::CondOutput()
 
 void Lvk::Nlp::CondOutput::append(const QString &output, Nlp::Predicate *pred)
 {
-    m_outputs.append(output.trimmed());
+    m_outputs.append(Nlp::OutputTemplate(output.trimmed()));
     m_predicates.append(QSharedPointer<Nlp::Predicate>(pred));
+
+    Nlp::CompiledPredicate code;
+    if (!pred || !pred->compile(code, m_varNames)) {
+        code = Nlp::CompiledPredicate();
+    }
+    m_code.append(code);
 }
 
 //--------------------------------------------------------------------------------------------------
 
-bool Lvk::Nlp::CondOutput::eval(const Nlp::VarStack &varStack, QString &output) const
+const Lvk::Nlp::OutputTemplate * Lvk::Nlp::CondOutput::eval(const Nlp::VarStack &varStack) const
 {
-    for (int i = 0; i < m_predicates.size(); ++i) {
-        if (m_predicates[i]->eval(varStack)) {
-            output = m_outputs[i];
-            return true;
+    SlotValues values(m_varNames.size());
+
+    for (int i = 0; i < m_code.size(); ++i) {
+        bool sat = false;
+
+        switch (m_code[i].opcode) {
+        case Nlp::CompiledPredicate::AlwaysTrue:
+            sat = true;
+            break;
+        case Nlp::CompiledPredicate::AlwaysFalse:
+            sat = false;
+            break;
+        case Nlp::CompiledPredicate::Compare:
+            sat = compare(m_code[i], m_varNames, varStack, values);
+            break;
+        case Nlp::CompiledPredicate::Call:
+            sat = m_predicates[i] && m_predicates[i]->eval(varStack);
+            break;
+        }
+
+        if (sat) {
+            return &m_outputs[i];
         }
     }
-    return false;
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::CondOutput::isConstant() const
+{
+    return !m_code.isEmpty() && m_code[0].opcode == Nlp::CompiledPredicate::AlwaysTrue
+            && !m_outputs[0].hasVariables();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -59,7 +164,7 @@ Lvk::Nlp::CondOutput Lvk::Nlp::CondOutput::fromRawString(const QString &s)
 {
     CondOutput co;
 
-    Nlp::Parser parser;
+    Nlp::Parser &parser = Nlp::Parser::threadParser();
 
     int i = 0;
     int offset = 0;
@@ -26,8 +26,10 @@
 #include <QString>
 #include <QStringList>
 #include <QSharedPointer>
+#include <QVector>
 
 #include "nlp-engine/predicate.h"
+#include "nlp-engine/outputtemplate.h"
 
 namespace Lvk
 {
@@ -50,6 +52,10 @@ class VarStack;
  *
  * The key concept of this class is the eval() method that chooses an output that
  * satisfies its predicate given a context.
+ *
+ * Predicates are compiled when appended to a flat array of instructions, so eval() does not do
+ * virtual calls, literals are not parsed again and each variable is looked up in the stack at
+ * most once. Predicates that cannot be compiled are evaluated with Predicate::eval().
  */
 class CondOutput
 {
@@ -58,13 +64,21 @@ public:
 
     void append(const QString &output, Nlp::Predicate *pred);
 
-    bool eval(const Nlp::VarStack &varStack, QString &output) const;
+    const Nlp::OutputTemplate *eval(const Nlp::VarStack &varStack) const;
+
+    /**
+     * Returns true if eval() always chooses the same output and the output has no variables,
+     * so it does not depend on the context. Otherwise; returns false.
+     */
+    bool isConstant() const;
 
     static CondOutput fromRawString(const QString &s);
 
 private:
-    QStringList m_outputs;
+    QList<Nlp::OutputTemplate> m_outputs;
     QList< QSharedPointer<Nlp::Predicate> > m_predicates;
+    QVector<Nlp::CompiledPredicate> m_code;     // One instruction per output
+    QStringList m_varNames;                     // Variable slots used by m_code
 
 };
 
@@ -28,7 +28,7 @@
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Nlp::CondOutputList::CondOutputList(const QStringList &outputs, bool random)
-    : m_next(0)
+    : m_rawOutputs(outputs), m_random(false), m_next(0)
 {
     setRandomOutput(random);
 
@@ -42,39 +42,77 @@ Lvk::Nlp::CondOutputList::CondOutputList(const QStringList &outputs, bool random
 
 //--------------------------------------------------------------------------------------------------
 
-QString Lvk::Nlp::CondOutputList::nextValidOutput(const Nlp::VarStack &varStack) const
+const Lvk::Nlp::OutputTemplate *
+Lvk::Nlp::CondOutputList::nextValidOutput(const Nlp::VarStack &varStack) const
 {
     // If random
-    if (m_next == -1) {
-        QList<QString> valid;
+    if (m_random) {
+        // Reservoir sampling: the n-th valid output replaces the chosen one with probability 1/n
+        const Nlp::OutputTemplate *chosen = 0;
+        int valid = 0;
         for (int i = 0; i < size(); ++i) {
-            QString output;
-            if (at(i).eval(varStack, output)) {
-                valid.append(output);
+            if (const Nlp::OutputTemplate *output = at(i).eval(varStack)) {
+                ++valid;
+                if (valid == 1 || Cmn::Random::getInt(0, valid - 1) == 0) {
+                    chosen = output;
+                }
             }
         }
-        if (!valid.isEmpty()) {
-            return valid[Cmn::Random::getInt(0, valid.size() - 1)];
+        if (chosen) {
+            return chosen;
         }
     // if secuential
     } else {
+        int next = m_next;
         for (int i = 0; i < size(); ++i) {
-            int j = (m_next  + i) % size();
-            QString output;
-            if (at(j).eval(varStack, output)) {
-                m_next = j + 1;
+            int j = (next  + i) % size();
+            if (const Nlp::OutputTemplate *output = at(j).eval(varStack)) {
+                // If another thread has moved the cursor meanwhile, keep its value
+                m_next.testAndSetOrdered(next, j + 1);
                 return output;
             }
         }
     }
 
-    return QString();
+    return 0;
  }
 
 //--------------------------------------------------------------------------------------------------
 
+bool Lvk::Nlp::CondOutputList::isConstant() const
+{
+    if (isEmpty()) {
+        return false;
+    }
+
+    for (int i = 0; i < size(); ++i) {
+        if (!at(i).isConstant()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::Nlp::CondOutputList::setRandomOutput(bool random)
 {
-    m_next = random ? -1 : 0;
+    m_random = random;
+    m_next = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::CondOutputList::randomOutput() const
+{
+    return m_random;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const QStringList & Lvk::Nlp::CondOutputList::rawOutputs() const
+{
+    return m_rawOutputs;
 }
 
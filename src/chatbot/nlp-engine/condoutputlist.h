@@ -25,6 +25,7 @@
 #include <QList>
 #include <QString>
 #include <QStringList>
+#include <QAtomicInt>
 
 #include "nlp-engine/varstack.h"
 #include "nlp-engine/condoutput.h"
@@ -55,18 +56,41 @@ public:
     CondOutputList(const QStringList &outputs = QStringList(), bool random = false);
 
     /**
-     * Returns the next valid output based on the given context \a varStack. Returns an empty
-     * string if there is no valid output.
+     * Returns the next valid output based on the given context \a varStack. Returns 0 if there
+     * is no valid output.
+     *
+     * This method is thread-safe. If the output is chosen sequentially, concurrent calls
+     * advance the same cursor.
      */
-    QString nextValidOutput(const Nlp::VarStack &varStack) const;
+    const Nlp::OutputTemplate *nextValidOutput(const Nlp::VarStack &varStack) const;
+
+    /**
+     * Returns true if the list is not empty and no output has conditions or variables, so
+     * nextValidOutput() never fails nor depends on the context. Otherwise; returns false.
+     *
+     * \see CondOutput::isConstant()
+     */
+    bool isConstant() const;
 
     /**
      * If \a random is true, the output is chosen randomly. Otherwise; is chosen sequentially.
      */
     void setRandomOutput(bool random);
 
+    /**
+     * Returns true if the output is chosen randomly. Otherwise; returns false.
+     */
+    bool randomOutput() const;
+
+    /**
+     * Returns the list of outputs used to construct the object
+     */
+    const QStringList &rawOutputs() const;
+
 private:
-    mutable int m_next;
+    QStringList m_rawOutputs;
+    bool m_random;
+    mutable QAtomicInt m_next;
 };
 
 /// @}
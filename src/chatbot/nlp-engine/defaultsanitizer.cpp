@@ -23,6 +23,8 @@
 
 #include <QtDebug>
 
+#include <cstring>
+
 #define utf8_a_acute                    "\xc3\xa1"
 #define utf8_e_acute                    "\xc3\xa9"
 #define utf8_i_acute                    "\xc3\xad"
@@ -48,60 +50,79 @@ Lvk::Nlp::DefaultSanitizer::DefaultSanitizer()
       m_logEnabled(false)
 {
     initSets();
+    initKernel();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::DefaultSanitizer::DefaultSanitizer(unsigned options)
+Lvk::Nlp::DefaultSanitizer::DefaultSanitizer(unsigned options, const QString &lang /*= QString()*/)
     : m_options(options), m_logEnabled(false)
 {
-    initSets();
+    initSets(lang);
+    initKernel();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::DefaultSanitizer::initSets()
+void Lvk::Nlp::DefaultSanitizer::initSets(const QString &lang /*= QString()*/)
 {
+    for (int c = 0; c < TableSize; ++c) {
+        QChar ch(c);
+        m_flags[c] = ch.isLetter() ? LetterFlag : 0;
+        m_fold[c] = ch.toLower().unicode();
+        m_map[c] = c;
+    }
+
     // Punctuation chars to be removed
-    m_punctSet.insert(',');
-    m_punctSet.insert(';');
-    m_punctSet.insert('.');
-    m_punctSet.insert('!');
-    m_punctSet.insert('?');
-    m_punctSet.insert(QString::fromUtf8(utf8_inverted_exclamation_mark)[0]);
-    m_punctSet.insert(QString::fromUtf8(utf8_inverted_question_mark)[0]);
+    QString punct = QString::fromUtf8(",;.!?"
+                                      utf8_inverted_exclamation_mark
+                                      utf8_inverted_question_mark);
 
     // Map of vowels with diacritic to vowels without
     // NOTE: this maps only makes sense for Spanish language.
-    m_diacMap.insert(QString::fromUtf8(utf8_a_acute)[0],     'a');
-    m_diacMap.insert(QString::fromUtf8(utf8_e_acute)[0],     'e');
-    m_diacMap.insert(QString::fromUtf8(utf8_i_acute)[0],     'i');
-    m_diacMap.insert(QString::fromUtf8(utf8_o_acute)[0],     'o');
-    m_diacMap.insert(QString::fromUtf8(utf8_u_acute)[0],     'u');
-    m_diacMap.insert(QString::fromUtf8(utf8_A_acute)[0],     'A');
-    m_diacMap.insert(QString::fromUtf8(utf8_E_acute)[0],     'E');
-    m_diacMap.insert(QString::fromUtf8(utf8_I_acute)[0],     'I');
-    m_diacMap.insert(QString::fromUtf8(utf8_O_acute)[0],     'O');
-    m_diacMap.insert(QString::fromUtf8(utf8_U_acute)[0],     'U');
-    m_diacMap.insert(QString::fromUtf8(utf8_u_diaeresis)[0], 'u');
-    m_diacMap.insert(QString::fromUtf8(utf8_U_diaeresis)[0], 'U');
+    QString diacFrom = QString::fromUtf8(utf8_a_acute utf8_e_acute utf8_i_acute utf8_o_acute
+                                         utf8_u_acute utf8_A_acute utf8_E_acute utf8_I_acute
+                                         utf8_O_acute utf8_U_acute utf8_u_diaeresis
+                                         utf8_U_diaeresis);
+    QString diacTo = "aeiouAEIOUuU";
 
     // Chars allowed to repeat once
-    // NOTE: this set only makes sense for Spanish language.
-    m_rSet.insert('r');
-    m_rSet.insert('l');
-    m_rSet.insert('n');
-    m_rSet.insert('c');
-    m_rSet.insert('z');
-    //m_rSet.insert('o');
+    QString repeat = lang == "en" ? "bcdefglmnoprstz" : "rlncz";
 
     // Braces to be removed
-    m_bracesSet.insert('{');
-    m_bracesSet.insert('}');
-    m_bracesSet.insert('[');
-    m_bracesSet.insert(']');
-    m_bracesSet.insert('(');
-    m_bracesSet.insert(')');
+    QString braces = "{}[]()";
+
+    foreach (const QChar &ch, repeat) {
+        m_flags[ch.unicode()] |= RepeatFlag;
+    }
+
+    if (m_options & RemovePunctuation) {
+        foreach (const QChar &ch, punct) {
+            m_flags[ch.unicode()] |= DropFlag;
+        }
+    }
+
+    if (m_options & RemoveDiacritic) {
+        for (int i = 0; i < diacFrom.size(); ++i) {
+            m_map[diacFrom[i].unicode()] = diacTo[i].unicode();
+        }
+    }
+
+    if (m_options & RemoveBraces) {
+        foreach (const QChar &ch, braces) {
+            m_flags[ch.unicode()] |= DropFlag;
+        }
+    }
+
+    if (m_options & RemoveDoubleQuotes) {
+        m_flags['"'] |= DropFlag;
+    }
+
+    if (m_options & LowerCase) {
+        for (int c = 0; c < TableSize; ++c) {
+            m_map[c] = QChar(m_map[c]).toLower().unicode();
+        }
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -112,14 +133,53 @@ QString Lvk::Nlp::DefaultSanitizer::sanitize(const QString &str) const
         return str;
     }
 
+    QString szStr = (this->*m_kernel)(str);
+
+    if (m_logEnabled) {
+        qDebug() << "   - Sanitized:" << str << "->" << szStr;
+    }
+
+    return szStr;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::DefaultSanitizer::initKernel()
+{
+    // Other options are already in the lookup tables
+    switch (m_options & (RemoveDupChars | LowerCase)) {
+    case 0:
+        m_kernel = &DefaultSanitizer::sanitizeWith<0>;
+        break;
+    case RemoveDupChars:
+        m_kernel = &DefaultSanitizer::sanitizeWith<RemoveDupChars>;
+        break;
+    case LowerCase:
+        m_kernel = &DefaultSanitizer::sanitizeWith<LowerCase>;
+        break;
+    default:
+        m_kernel = &DefaultSanitizer::sanitizeWith<RemoveDupChars | LowerCase>;
+        break;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+template<unsigned Options>
+QString Lvk::Nlp::DefaultSanitizer::sanitizeWith(const QString &str) const
+{
+    const int size = str.size();
+    const ushort *src = str.utf16();
+
     int rcount = 0;     // repeat count
-    QChar prev;         // previous char
-    QChar cur;          // current char
     QString szStr;      // Sanitized string
+    ushort *dst = 0;    // Write position in szStr. Null until the first char changes
+    int len = 0;        // Length of szStr
 
-    for (int i = 0; i < str.size(); ++i) {
-        prev = i > 0 ? str[i-1] : QChar();
-        cur = str[i];
+    for (int i = 0; i < size; ++i) {
+        const ushort cur = src[i];
+        const bool inTable = cur < TableSize;
+        const uchar flags = inTable ? m_flags[cur] : 0;
 
         bool append = true;
 
@@ -128,79 +188,57 @@ QString Lvk::Nlp::DefaultSanitizer::sanitize(const QString &str) const
         //
         // NOTE: this implementation only makes sense for Spanish language.
 
-        if ((m_options & RemoveDupChars) && i > 0) {
-
-             if (cur.isLetter() && cur.toLower() == prev.toLower()) {
-                ++rcount;
-             } else {
-                 rcount = 0;
-             }
-
-             append = rcount == 0 || (rcount == 1 && m_rSet.contains(cur));
-
-             if (!append) {
-                 continue;
-             }
-        }
+        if ((Options & RemoveDupChars) && i > 0) {
+            const ushort prev = src[i-1];
 
-        //-------------------------------------------------------------------------------
-        // Remove punctuation
-
-        if (m_options & RemovePunctuation) {
-            append = !m_punctSet.contains(cur);
+            bool isLetter = inTable ? (flags & LetterFlag) : QChar(cur).isLetter();
 
-            if (!append) {
-                continue;
+            if (isLetter && fold(cur) == fold(prev)) {
+                ++rcount;
+            } else {
+                rcount = 0;
             }
-        }
-
-        //-------------------------------------------------------------------------------
-        // Remove diacritic
-
-        if (m_options & RemoveDiacritic) {
-            QHash<QChar,QChar>::const_iterator it = m_diacMap.find(cur);
 
-            if (it != m_diacMap.constEnd()) {
-                cur = *it;
-            }
+            append = rcount == 0 || (rcount == 1 && (flags & RepeatFlag));
         }
 
         //-------------------------------------------------------------------------------
-        // Remove braces
+        // Remove punctuation, braces and double quotes, remove diacritic and lower case
 
-        if (m_options & RemoveBraces) {
-            append = !m_bracesSet.contains(cur);
+        ushort out = cur;
 
-            if (!append) {
-                continue;
+        if (append) {
+            if (inTable) {
+                append = !(flags & DropFlag);
+                out = m_map[cur];
+            } else if (Options & LowerCase) {
+                out = QChar(cur).toLower().unicode();
             }
         }
 
         //-------------------------------------------------------------------------------
-        // Remove double quotes
+        // Unchanged prefixes are not copied. If nothing changes we return str as is.
 
-        if (m_options & RemoveDoubleQuotes) {
-            append = cur != '"';
-
-            if (!append) {
+        if (!dst) {
+            if (append && out == cur) {
                 continue;
             }
-        }
 
-        //-------------------------------------------------------------------------------
-        // Lower case letters
-
-        if (m_options & LowerCase) {
-            cur = cur.toLower();
+            szStr.resize(size);
+            dst = reinterpret_cast<ushort *>(szStr.data());
+            memcpy(dst, src, i*sizeof(ushort));
+            len = i;
         }
 
-        //-------------------------------------------------------------------------------
-
-        szStr.append(cur);
+        if (append) {
+            dst[len++] = out;
+        }
     }
 
-    if (m_logEnabled) {
-        qDebug() << "   - Sanitized:" << str << "->" << szStr;
+    if (dst) {
+        szStr.resize(len);
+    } else {
+        szStr = str;
     }
 
     return szStr;
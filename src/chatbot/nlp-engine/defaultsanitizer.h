@@ -24,9 +24,6 @@
 
 #include "nlp-engine/sanitizer.h"
 
-#include <QSet>
-#include <QHash>
-
 namespace Lvk
 {
 
@@ -67,7 +64,8 @@ public:
         RemovePunctuation = 0x02,
 
         /**
-         * Removes duplicated characters. Currently, this option is only well defined for Spanish.
+         * Removes duplicated characters. Letters that can be doubled in the language of the
+         * sanitizer are kept twice. Currently, only Spanish and English are well defined.
          */
         RemoveDupChars = 0x04,
 
@@ -96,11 +94,12 @@ public:
     DefaultSanitizer();
 
     /**
-     * Constructs a DefaultSanitizer with the options flags given.
+     * Constructs a DefaultSanitizer with the options flags given for language \a lang.
+     * If \a lang is empty or unknown, Spanish is assumed.
      *
      * \see Option
      */
-    DefaultSanitizer(unsigned options);
+    DefaultSanitizer(unsigned options, const QString &lang = QString());
 
     /**
      * Sanitizes the string \a str
@@ -113,14 +112,37 @@ public:
     void setLogEnabled(bool enabled);
 
 private:
+    // Lookup tables are indexed by Latin-1 code. Characters beyond Latin-1 are never removed
+    // nor mapped, they are only lower cased if needed.
+    enum { TableSize = 256 };
+
+    // Per-char flags
+    enum CharFlag {
+        DropFlag        = 0x01,  // char must be removed
+        LetterFlag      = 0x02,  // QChar::isLetter()
+        RepeatFlag      = 0x04   // char allowed to repeat once
+    };
+
+    // Sanitization loop specialized for the options that are not in the lookup tables
+    typedef QString (DefaultSanitizer::*Kernel)(const QString &str) const;
+
     unsigned m_options;
-    QSet<QChar> m_rSet;
-    QSet<QChar> m_punctSet;
-    QSet<QChar> m_bracesSet;
-    QHash<QChar,QChar> m_diacMap;
+    uchar m_flags[TableSize];    // Combination of CharFlag values
+    ushort m_map[TableSize];     // Output char after diacritic removal and lower casing
+    ushort m_fold[TableSize];    // Lower case char used to detect duplicates
+    Kernel m_kernel;
     bool m_logEnabled;
 
-    void initSets();
+    void initSets(const QString &lang = QString());
+    void initKernel();
+
+    template<unsigned Options>
+    QString sanitizeWith(const QString &str) const;
+
+    ushort fold(ushort c) const
+    {
+        return c < TableSize ? m_fold[c] : QChar(c).toLower().unicode();
+    }
 };
 
 /// @}
@@ -25,8 +25,13 @@
 #include <QString>
 #include <QVariant>
 #include <QPair>
+#include <QFuture>
 
 #include "nlp-engine/rule.h"
+#include "nlp-engine/result.h"
+#include "nlp-engine/ruleissue.h"
+#include "nlp-engine/rulecost.h"
+#include "nlp-engine/searchexplain.h"
 
 namespace Lvk
 {
@@ -82,6 +87,17 @@ public:
      */
     virtual void addRule(const Rule &rule) = 0;
 
+    /**
+     * Removes the rule with ID \a ruleId. If there is no such rule, this method does nothing.
+     */
+    virtual void removeRule(RuleId ruleId) = 0;
+
+    /**
+     * Replaces the rule with the same ID than \a rule. If there is no such rule, \a rule is
+     * added.
+     */
+    virtual void updateRule(const Rule &rule) = 0;
+
     /**
      * Gets a response for the given \a input ignoring targets.
      *
@@ -124,6 +140,75 @@ public:
     virtual QStringList getAllResponses(const QString &input, const QString &target,
                                         MatchList &matches) = 0;
 
+    /**
+     * Gets the best response for the given \a input and \a target.
+     *
+     * If there is a match, \a result contains the response, the rule and input that has
+     * matched, the score and the topic of the rule. Otherwise; \a result is cleared.
+     *
+     * Unlike getResponse(const QString &, const QString &, MatchList &) responses are not
+     * copied into intermediate lists.
+     */
+    virtual void getResponse(const QString &input, const QString &target, Result &result) = 0;
+
+    /**
+     * Gets the best response for the given \a input and \a target in a thread owned by the
+     * engine, so the caller can keep doing I/O. The returned future has a single Result as
+     * described in getResponse(const QString &, const QString &, Result &).
+     *
+     * Canceling the future aborts the search, which is useful if a newer request supersedes it.
+     * If \a deadline is greater than zero and the search does not finish within \a deadline
+     * milliseconds since this call, the search is aborted and the result is cleared, unless
+     * the engine supports best effort searches and they are enabled, in which case the result
+     * is the best one found before the deadline.
+     */
+    virtual QFuture<Result> getResponseAsync(const QString &input, const QString &target,
+                                             int deadline = 0) = 0;
+
+    /**
+     * Searches the best response for the given \a input and \a target as getResponse() does
+     * and fills \a explain with what the search did: nodes visited, edges followed, outputs
+     * evaluated, time of each stage, the best result and the \a topCount results with the
+     * highest scores. Unlike getResponse(), the state of the engine, i.e. the current topic
+     * and the stats, is not changed and responses are never taken from a cache.
+     */
+    virtual void explainResponse(const QString &input, const QString &target,
+                                 SearchExplain &explain, int topCount = 10) = 0;
+
+    /**
+     * Gets all responses for the given \a input and \a target sorted by priority.
+     *
+     * \a results is cleared and filled with one Result for each match.
+     * \see getResponse(const QString &, const QString &, Result &)
+     */
+    virtual void getAllResponses(const QString &input, const QString &target,
+                                 ResultList &results) = 0;
+
+    /**
+     * Gets all responses for each of the given \a inputs and \a target sorted by priority.
+     *
+     * \a results is cleared and filled with one ResultList for each input in the same order.
+     * Topics are updated as if getAllResponses(const QString &, const QString &, ResultList &)
+     * were invoked for each input in order, but engines can lemmatize and search all inputs
+     * at once.
+     */
+    virtual void getResponses(const QStringList &inputs, const QString &target,
+                              QList<ResultList> &results) = 0;
+
+    /**
+     * Sets the \a evasives of \a target. Evasives are the outputs used when there is no match.
+     * They support the same syntax than rule outputs, but variables are always empty since
+     * there is no matched input. If \a target is empty, sets the evasives of any user.
+     * An empty list of evasives removes the evasives of \a target.
+     */
+    virtual void setEvasives(const QStringList &evasives, const QString &target) = 0;
+
+    /**
+     * Returns an evasive for \a target chosen randomly. If \a target has no evasives, the
+     * evasives of any user are used. Returns an empty string if there are no evasives.
+     */
+    virtual QString getEvasive(const QString &target) const = 0;
+
     /**
      * Returns the current topic for \a target if topics are enabled. Otherwise returns an
      * empty string
@@ -157,11 +242,59 @@ public:
      */
     virtual void setProperty(const QString &name, const QVariant &value) = 0;
 
+    /**
+     * Builds the internal structures used to match rules if they are outdated. Calling this
+     * method is optional since they are built on demand. It can be called from a worker thread,
+     * in which case other calls wait until the build finishes.
+     */
+    virtual void build() = 0;
+
+    /**
+     * Saves a snapshot of the compiled rules in \a filename. \a config must identify the
+     * configuration of the NLP tools used to compile the rules, i.e. sanitizers and lemmatizer.
+     * Returns true on success. Otherwise; returns false.
+     */
+    virtual bool saveSnapshot(const QString &filename, const QString &config) = 0;
+
+    /**
+     * Loads the compiled rules from the snapshot \a filename. The snapshot is only loaded if it
+     * was saved with the current rules and the same \a config. Returns true on success.
+     * Otherwise; returns false and rules will be compiled as usual.
+     */
+    virtual bool loadSnapshot(const QString &filename, const QString &config) = 0;
+
+    /**
+     * Returns the identifier of the compiled rules with \a config, i.e. the hash stored in
+     * their snapshots. Engines with the same rules and \a config return the same identifier,
+     * so it can name a snapshot shared by several chatbots and processes.
+     */
+    virtual QString snapshotId(const QString &config) const = 0;
+
     /**
      * Clears the engine state. Properties are not considered part of the state, so they are not
      * cleared.
      */
     virtual void clear() = 0;
+
+    /**
+     * Creates a new engine that shares the compiled rules of this engine. The new engine keeps
+     * its own state, i.e. topics and stats, so it can be used to chat with another account.
+     * Changing the rules of one of the engines does not change the rules of the other one.
+     */
+    virtual Engine *createSession() = 0;
+
+    /**
+     * Analyzes the compiled rules and fills \a issues with the rule inputs that never match or
+     * that are shadowed by inputs of other rules. \a issues is cleared first.
+     */
+    virtual void lintRules(RuleIssueList &issues) = 0;
+
+    /**
+     * Compiles the rules again recording the cost of each rule and fills \a costs with them,
+     * the costliest first. The compiled rules in use are not replaced. \a costs is cleared
+     * first.
+     */
+    virtual void profileRules(RuleCostList &costs) = 0;
 };
 
 /// @}
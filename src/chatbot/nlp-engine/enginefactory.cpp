@@ -21,6 +21,67 @@
 
 #include "nlp-engine/enginefactory.h"
 #include "nlp-engine/cb2engine.h"
+#include "nlp-engine/shadowengine.h"
+#include "nlp-engine/toolchain.h"
+#include "nlp-engine/sanitizerfactory.h"
+#include "nlp-engine/lemmatizerfactory.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QStringList>
+#include <QtDebug>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Parses the shadow properties setting with the form "Name=value,Name=value"
+QVariantMap shadowOverrides(const QString &str)
+{
+    QVariantMap overrides;
+
+    foreach (const QString &pair, str.split(",", QString::SkipEmptyParts)) {
+        int i = pair.indexOf('=');
+        if (i > 0) {
+            overrides[pair.left(i).trimmed()] = pair.mid(i + 1).trimmed();
+        } else {
+            qWarning() << "EngineFactory: Invalid shadow property" << pair;
+        }
+    }
+
+    return overrides;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Wraps engine in a ShadowEngine if the settings enable it. The shadow engine is built with
+// the same NLP tools.
+Lvk::Nlp::Engine *withShadow(Lvk::Nlp::Cb2Engine *engine,
+                             QSharedPointer<Lvk::Nlp::Toolchain> tools)
+{
+    Lvk::Cmn::SettingsSnapshot settings = Lvk::Cmn::SettingsSnapshot::current();
+
+    double rate = settings.value(SETTING_NLP_SHADOW_SAMPLE_RATE).toDouble();
+
+    if (rate <= 0) {
+        return engine;
+    }
+
+    QVariantMap overrides = shadowOverrides(settings.stringValue(SETTING_NLP_SHADOW_PROPERTIES));
+
+    qDebug() << "EngineFactory: Shadow engine enabled with sample rate" << rate
+             << "and properties" << overrides;
+
+    Lvk::Nlp::Cb2Engine *shadow = tools ? new Lvk::Nlp::Cb2Engine(tools)
+                                        : new Lvk::Nlp::Cb2Engine();
+
+    return new Lvk::Nlp::ShadowEngine(engine, shadow, rate, overrides);
+}
+
+} // namespace
 
 //--------------------------------------------------------------------------------------------------
 // EngineFactory
@@ -28,5 +89,18 @@
 
 Lvk::Nlp::Engine * Lvk::Nlp::EngineFactory::createEngine()
 {
-    return new Nlp::Cb2Engine();
+    return withShadow(new Nlp::Cb2Engine(), QSharedPointer<Nlp::Toolchain>());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Engine * Lvk::Nlp::EngineFactory::createEngine(const QString &lang)
+{
+    QSharedPointer<Nlp::Toolchain> tools(new Nlp::Toolchain(lang));
+
+    tools->setPreSanitizer(Nlp::SanitizerFactory().createPreSanitizer(lang));
+    tools->setLemmatizer(Nlp::LemmatizerFactory().createLemmatizer(lang));
+    tools->setPostSanitizer(Nlp::SanitizerFactory().createPostSanitizer(lang));
+
+    return withShadow(new Nlp::Cb2Engine(tools), tools);
 }
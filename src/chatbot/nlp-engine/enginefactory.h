@@ -47,8 +47,22 @@ public:
 
     /**
      * Creates a default NLP engine.
+     *
+     * If the setting SETTING_NLP_SHADOW_SAMPLE_RATE is greater than zero, the engine is a
+     * ShadowEngine that compares that fraction of the replies with a shadow engine with the
+     * properties of the setting SETTING_NLP_SHADOW_PROPERTIES, e.g. "FuzzyMatch=true".
      */
     Engine* createEngine();
+
+    /**
+     * Creates an NLP engine for language \a lang with its own NLP tools. Engines of different
+     * languages can be used in the same process.
+     *
+     * The shadow engine settings apply as in createEngine().
+     *
+     * \see Toolchain, LemmatizerFactory, SanitizerFactory
+     */
+    Engine* createEngine(const QString &lang);
 };
 
 /// @}
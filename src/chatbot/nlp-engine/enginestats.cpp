@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/enginestats.h"
+
+#include <QStringList>
+#include <limits>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Returns the bucket of value v.
+// Values lower than LATENCY_SUB_BUCKETS have their own bucket. Higher values are split by
+// their most significant bit and the next LATENCY_SUB_BUCKET_BITS bits.
+int bucketOf(qint64 v)
+{
+    if (v < LATENCY_SUB_BUCKETS) {
+        return v < 0 ? 0 : (int)v;
+    }
+
+    int e = 0;
+    while ((v >> (e + 1)) != 0) {
+        ++e;
+    }
+
+    if (e >= LATENCY_MAX_EXPONENT) {
+        return LATENCY_BUCKET_COUNT - 1;
+    }
+
+    int sub = (int)(v >> (e - LATENCY_SUB_BUCKET_BITS)) - LATENCY_SUB_BUCKETS;
+
+    return (e - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the highest value of bucket b
+qint64 upperBoundOf(int b)
+{
+    if (b < LATENCY_SUB_BUCKETS) {
+        return b;
+    }
+
+    int e = b / LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS - 1;
+    int sub = b % LATENCY_SUB_BUCKETS;
+    int shift = e - LATENCY_SUB_BUCKET_BITS;
+
+    return ((qint64)(LATENCY_SUB_BUCKETS + sub) << shift) + ((qint64)1 << shift) - 1;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// LatencyHistogram
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LatencyHistogram::LatencyHistogram()
+    : m_count(0), m_max(0)
+{
+    // QAtomicInt default constructor already sets buckets to zero
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LatencyHistogram::record(qint64 usecs)
+{
+    m_buckets[bucketOf(usecs)].fetchAndAddRelaxed(1);
+    m_count.fetchAndAddRelaxed(1);
+
+    int v = (int)qMin(usecs, (qint64)std::numeric_limits<int>::max());
+
+    for (int max = m_max; v > max; max = m_max) {
+        if (m_max.testAndSetOrdered(max, v)) {
+            break;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::LatencyHistogram::count() const
+{
+    return m_count;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::LatencyHistogram::percentile(double p) const
+{
+    int count = m_count;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    // Rank of the value, counting from 1
+    qint64 rank = qMax((qint64)1, (qint64)(p / 100.0 * count + 0.5));
+    qint64 acc = 0;
+
+    for (int b = 0; b < LATENCY_BUCKET_COUNT; ++b) {
+        acc += m_buckets[b];
+        if (acc >= rank) {
+            return qMin(upperBoundOf(b), max());
+        }
+    }
+
+    return max();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::LatencyHistogram::max() const
+{
+    return m_max;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LatencyHistogram::clear()
+{
+    for (int b = 0; b < LATENCY_BUCKET_COUNT; ++b) {
+        m_buckets[b] = 0;
+    }
+    m_count = 0;
+    m_max = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// EngineStats
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::EngineStats::EngineStats()
+    : m_cacheHits(0), m_cacheMisses(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::EngineStats::cacheHitRate() const
+{
+    int hits = m_cacheHits;
+    int lookups = hits + m_cacheMisses;
+
+    return lookups > 0 ? (int)((qint64)hits * 100 / lookups) : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Nlp::EngineStats::toVariantMap() const
+{
+    QVariantMap map;
+
+    for (int i = 0; i < StageCount; ++i) {
+        const LatencyHistogram &h = m_histograms[i];
+
+        QVariantMap stage;
+        stage["count"] = h.count();
+        stage["p50"] = h.percentile(50);
+        stage["p90"] = h.percentile(90);
+        stage["p99"] = h.percentile(99);
+        stage["max"] = h.max();
+
+        map[stageName(static_cast<Stage>(i))] = stage;
+    }
+
+    QVariantMap cache;
+    cache["hits"] = cacheHits();
+    cache["misses"] = cacheMisses();
+    cache["hit_rate"] = cacheHitRate();
+
+    map["cache"] = cache;
+
+    return map;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::EngineStats::toString() const
+{
+    QStringList l;
+
+    for (int i = 0; i < StageCount; ++i) {
+        const LatencyHistogram &h = m_histograms[i];
+
+        l.append(QString("%1: count=%2 p50=%3us p90=%4us p99=%5us max=%6us")
+                 .arg(stageName(static_cast<Stage>(i)))
+                 .arg(h.count())
+                 .arg(h.percentile(50))
+                 .arg(h.percentile(90))
+                 .arg(h.percentile(99))
+                 .arg(h.max()));
+    }
+
+    l.append(QString("cache: hits=%1 misses=%2 hit_rate=%3%")
+             .arg(cacheHits())
+             .arg(cacheMisses())
+             .arg(cacheHitRate()));
+
+    return l.join("; ");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::EngineStats::clear()
+{
+    for (int i = 0; i < StageCount; ++i) {
+        m_histograms[i].clear();
+    }
+    m_cacheHits = 0;
+    m_cacheMisses = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::EngineStats::stageName(Stage stage)
+{
+    switch (stage) {
+    case TotalStage:
+        return "total";
+    case LemmatizeStage:
+        return "lemmatize";
+    case SearchStage:
+        return "search";
+    case ExpandStage:
+        return "expand";
+    case TopicStage:
+        return "topic";
+    default:
+        return "";
+    }
+}
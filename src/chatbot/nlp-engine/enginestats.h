@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_ENGINESTATS_H
+#define LVK_NLP_ENGINESTATS_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QVariantMap>
+
+#define LATENCY_SUB_BUCKETS        8    // Buckets per power of two. Must be a power of two
+#define LATENCY_SUB_BUCKET_BITS    3    // log2(LATENCY_SUB_BUCKETS)
+#define LATENCY_MAX_EXPONENT       36   // Values up to 2^36 usecs
+#define LATENCY_BUCKET_COUNT       ((LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 1) \
+                                    * LATENCY_SUB_BUCKETS)
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The LatencyHistogram class provides a lock-free histogram of durations
+ *
+ * Durations are stored in microseconds in logarithmic buckets with LATENCY_SUB_BUCKETS linear
+ * sub-buckets each, so percentiles have a relative error lower than 1/LATENCY_SUB_BUCKETS no
+ * matter the magnitude of the values. Several threads can record values simultaneously.
+ */
+class LatencyHistogram
+{
+public:
+
+    /**
+     * Constructs an empty histogram
+     */
+    LatencyHistogram();
+
+    /**
+     * Records a duration of \a usecs microseconds
+     */
+    void record(qint64 usecs);
+
+    /**
+     * Returns the amount of durations recorded
+     */
+    int count() const;
+
+    /**
+     * Returns the duration in microseconds below which \a p percent of the recorded durations
+     * fall. If there are no durations, returns 0.
+     */
+    qint64 percentile(double p) const;
+
+    /**
+     * Returns the highest duration recorded in microseconds
+     */
+    qint64 max() const;
+
+    /**
+     * Removes all durations
+     */
+    void clear();
+
+private:
+    LatencyHistogram(const LatencyHistogram&);
+    LatencyHistogram & operator=(const LatencyHistogram&);
+
+    QAtomicInt m_buckets[LATENCY_BUCKET_COUNT];
+    QAtomicInt m_count;
+    QAtomicInt m_max;
+};
+
+
+/**
+ * \brief The EngineStats class provides latency histograms for each stage of the Cb2Engine
+ *        and the hit rate of its response cache
+ *
+ * This class is thread-safe.
+ */
+class EngineStats
+{
+public:
+
+    /**
+     * Stages of a response
+     */
+    enum Stage
+    {
+        TotalStage,         ///< Whole call to get responses
+        LemmatizeStage,     ///< Pre-sanitization, lemmatization and post-sanitization
+        SearchStage,        ///< Tree search, including output expansion
+        ExpandStage,        ///< Output expansion, including recursive searches
+        TopicStage,         ///< Reordering of results by topic
+        StageCount
+    };
+
+    /**
+     * Constructs an empty object
+     */
+    EngineStats();
+
+    /**
+     * Records a duration of \a usecs microseconds for \a stage
+     */
+    void record(Stage stage, qint64 usecs)
+    {
+        m_histograms[stage].record(usecs);
+    }
+
+    /**
+     * Records a lookup in the response cache. \a hit is true if the lookup found an entry.
+     * \see ResponseCache
+     */
+    void recordCacheLookup(bool hit)
+    {
+        (hit ? m_cacheHits : m_cacheMisses).fetchAndAddRelaxed(1);
+    }
+
+    /**
+     * Returns the amount of lookups that found an entry in the response cache
+     */
+    int cacheHits() const
+    {
+        return m_cacheHits;
+    }
+
+    /**
+     * Returns the amount of lookups that did not find an entry in the response cache
+     */
+    int cacheMisses() const
+    {
+        return m_cacheMisses;
+    }
+
+    /**
+     * Returns the histogram of \a stage
+     */
+    const LatencyHistogram & histogram(Stage stage) const
+    {
+        return m_histograms[stage];
+    }
+
+    /**
+     * Returns a map with the name of each stage and a map with its count, p50, p90, p99
+     * and max durations in microseconds. Key "cache" has a map with the hits, misses and
+     * hit rate, in percent, of the response cache.
+     */
+    QVariantMap toVariantMap() const;
+
+    /**
+     * Returns the string representation of the object
+     */
+    QString toString() const;
+
+    /**
+     * Removes all durations and cache lookups
+     */
+    void clear();
+
+    /**
+     * Returns the name of \a stage
+     */
+    static QString stageName(Stage stage);
+
+private:
+    EngineStats(const EngineStats&);
+    EngineStats & operator=(const EngineStats&);
+
+    LatencyHistogram m_histograms[StageCount];
+    QAtomicInt m_cacheHits;
+    QAtomicInt m_cacheMisses;
+
+    int cacheHitRate() const;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_ENGINESTATS_H
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/flattree.h"
+
+#include <QSet>
+#include <QtAlgorithms>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+typedef Lvk::Nlp::FlatTree::Edge Edge;
+
+// Bookkeeping of each heap block, roughly what glibc malloc uses on 64 bits
+const qint64 ALLOC_OVERHEAD = 16;
+
+// Header of a QString heap block
+const qint64 STRING_HEADER = 3*sizeof(int) + 2*sizeof(void *);
+
+//--------------------------------------------------------------------------------------------------
+
+bool stringLessThan(const Edge &e1, const Edge &e2)
+{
+    return e1.string < e2.string;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Sorts by string and then by node, so equal strings keep the depth-first order
+bool edgeLessThan(const Edge &e1, const Edge &e2)
+{
+    return e1.string < e2.string || (e1.string == e2.string && e1.node < e2.node);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool outputLessThan(const Lvk::Nlp::FlatTree::OutputEntry &e1,
+                    const Lvk::Nlp::FlatTree::OutputEntry &e2)
+{
+    return e1.key < e2.key;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Appends the nodes of the edges in [begin, end) with string s
+void appendMatching(const Edge *begin, const Edge *end, qint32 s, QVector<quint32> &childs)
+{
+    Edge key;
+    key.string = s;
+    key.node = 0;
+
+    for (const Edge *e = qLowerBound(begin, end, key, stringLessThan);
+         e != end && e->string == s; ++e) {
+        childs.append(e->node);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 vectorBytes(int capacity, int itemSize)
+{
+    return capacity > 0 ? sizeof(QVectorData) + capacity*itemSize + ALLOC_OVERHEAD : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 stringBytes(const QString &s)
+{
+    return !s.isEmpty() ? STRING_HEADER + (s.capacity() + 1)*sizeof(QChar) + ALLOC_OVERHEAD : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// QList of n pointers or ints
+qint64 listBytes(int n)
+{
+    return n > 0 ? sizeof(QListData::Data) + n*sizeof(void *) + ALLOC_OVERHEAD : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// QHash of n entries with nodeSize bytes each. QHash has at least as many buckets as entries.
+qint64 hashBytes(int n, int nodeSize)
+{
+    return n > 0 ? sizeof(QHashData) + ALLOC_OVERHEAD + n*sizeof(void *) + ALLOC_OVERHEAD
+                   + n*(nodeSize + ALLOC_OVERHEAD)
+                 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Bytes allocated by node, without its childs nor its outputs
+qint64 nodeBytes(const Lvk::Nlp::Node *node)
+{
+    qint64 bytes = ALLOC_OVERHEAD;
+    int wordChilds = 0;
+    int origWords = 0;
+    int lemmas = 0;
+
+    foreach (const Lvk::Nlp::Node *child, node->childs()) {
+        if (const Lvk::Nlp::WordNode *wNode = child->to<Lvk::Nlp::WordNode>()) {
+            ++wordChilds;
+            origWords += wNode->word.origWordId != Lvk::Nlp::NullSymbol ? 1 : 0;
+            lemmas += wNode->word.lemmaId != Lvk::Nlp::NullSymbol ? 1 : 0;
+        }
+    }
+
+    // Child list, its indexes by original word and lemma and the list of non-word childs
+    bytes += listBytes(node->childs().size());
+    bytes += hashBytes(origWords, sizeof(QHashNode<Lvk::Nlp::SymbolId, int>));
+    bytes += hashBytes(lemmas, sizeof(QHashNode<Lvk::Nlp::SymbolId, int>));
+    bytes += listBytes(node->childs().size() - wordChilds);
+    bytes += hashBytes(node->omap.size(), sizeof(QHashNode<quint64, Lvk::Nlp::CondOutputList>));
+
+    if (const Lvk::Nlp::WordNode *wNode = node->to<Lvk::Nlp::WordNode>()) {
+        const Lvk::Nlp::Word &w = wNode->word;
+
+        bytes += sizeof(Lvk::Nlp::WordNode);
+        bytes += stringBytes(w.origWord) + stringBytes(w.normWord) + stringBytes(w.lemma)
+                + stringBytes(w.posTag) + listBytes(w.altSpells.size());
+
+        foreach (const QString &s, w.altSpells) {
+            bytes += stringBytes(s);
+        }
+    } else if (node->is<Lvk::Nlp::WildcardNode>()) {
+        bytes += sizeof(Lvk::Nlp::WildcardNode);
+    } else if (const Lvk::Nlp::VariableNode *vNode = node->to<Lvk::Nlp::VariableNode>()) {
+        bytes += sizeof(Lvk::Nlp::VariableNode) + stringBytes(vNode->varName);
+    } else {
+        bytes += sizeof(Lvk::Nlp::Node);
+    }
+
+    return bytes;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// FlatTree
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::FlatTree::FlatTree()
+    : m_phraseRoot(-1)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FlatTree::build(const Nlp::Node *root, const Nlp::Node *phraseRoot)
+{
+    clear();
+
+    if (!root) {
+        return;
+    }
+
+    // Number the nodes in depth-first order, so the first child of a node is next to it. The
+    // trie of phrases goes after all nodes of the tree.
+
+    QHash<const Nlp::Node *, quint32> index;
+    QVector<const Nlp::Node *> order;
+    QList<const Nlp::Node *> pending;
+
+    if (phraseRoot) {
+        pending.append(phraseRoot);
+    }
+    pending.append(root);
+
+    while (!pending.isEmpty()) {
+        const Nlp::Node *node = pending.takeLast();
+
+        if (index.contains(node)) {
+            continue;
+        }
+
+        index.insert(node, order.size());
+        order.append(node);
+
+        for (int i = node->childs().size() - 1; i >= 0; --i) {
+            if (!index.contains(node->childs()[i])) {
+                pending.append(node->childs()[i]);
+            }
+        }
+    }
+
+    m_nodes.resize(order.size());
+    m_phraseRoot = phraseRoot ? index.value(phraseRoot) : -1;
+
+    QVector<Edge> wordEdges;
+    QVector<Edge> lemmaEdges;
+    QVector<OutputEntry> outputs;
+
+    for (int i = 0; i < order.size(); ++i) {
+        const Nlp::Node *node = order[i];
+        FlatNode &n = m_nodes[i];
+
+        n.type = node->type();
+        n.arg1 = 0;
+        n.arg2 = 0;
+
+        if (const Nlp::WordNode *wNode = node->to<Nlp::WordNode>()) {
+            n.arg1 = addString(wNode->word.origWord);
+            n.arg2 = !wNode->word.lemma.isEmpty() ? addString(wNode->word.lemma) : -1;
+        } else if (const Nlp::WildcardNode *wcNode = node->to<Nlp::WildcardNode>()) {
+            n.arg1 = wcNode->min;
+            n.arg2 = wcNode->max;
+        } else if (const Nlp::VariableNode *vNode = node->to<Nlp::VariableNode>()) {
+            n.arg1 = addString(vNode->varName);
+        }
+
+        // Childs
+
+        wordEdges.clear();
+        lemmaEdges.clear();
+
+        n.firstChild = m_edges.size();
+        n.firstLemma = m_lemmaEdges.size();
+
+        foreach (const Nlp::Node *child, node->childs()) {
+            Edge e;
+            e.node = index.value(child);
+
+            if (const Nlp::WordNode *wChild = child->to<Nlp::WordNode>()) {
+                e.string = addString(wChild->word.origWord);
+                wordEdges.append(e);
+                if (!wChild->word.lemma.isEmpty()) {
+                    e.string = addString(wChild->word.lemma);
+                    lemmaEdges.append(e);
+                }
+            } else {
+                e.string = -1;
+                m_edges.append(e);
+            }
+        }
+
+        qSort(wordEdges.begin(), wordEdges.end(), edgeLessThan);
+        qSort(lemmaEdges.begin(), lemmaEdges.end(), edgeLessThan);
+
+        n.nonWordCount = m_edges.size() - n.firstChild;
+        n.wordCount = wordEdges.size();
+        n.lemmaCount = lemmaEdges.size();
+
+        m_edges += wordEdges;
+        m_lemmaEdges += lemmaEdges;
+
+        // Outputs
+
+        outputs.clear();
+
+        for (OutputMap::const_iterator it = node->omap.constBegin();
+             it != node->omap.constEnd(); ++it) {
+            OutputEntry entry;
+            entry.key = it.key();
+            entry.outputs = it.value();
+            outputs.append(entry);
+        }
+
+        qSort(outputs.begin(), outputs.end(), outputLessThan);
+
+        n.firstOutput = m_outputs.size();
+        n.outputCount = outputs.size();
+
+        m_outputs += outputs;
+    }
+
+    m_edges.squeeze();
+    m_lemmaEdges.squeeze();
+    m_outputs.squeeze();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FlatTree::clear()
+{
+    m_phraseRoot = -1;
+    m_nodes.clear();
+    m_edges.clear();
+    m_lemmaEdges.clear();
+    m_outputs.clear();
+    m_strings.clear();
+    m_stringIndex.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint32 Lvk::Nlp::FlatTree::addString(const QString &s)
+{
+    QHash<QString, qint32>::const_iterator it = m_stringIndex.constFind(s);
+
+    if (it != m_stringIndex.constEnd()) {
+        return it.value();
+    }
+
+    qint32 i = m_strings.size();
+    m_strings.append(s);
+    m_stringIndex.insert(s, i);
+
+    return i;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Nlp::CondOutputList * Lvk::Nlp::FlatTree::outputs(quint32 i, quint64 key) const
+{
+    const FlatNode &n = m_nodes[i];
+    const OutputEntry *begin = m_outputs.constData() + n.firstOutput;
+    const OutputEntry *end = begin + n.outputCount;
+
+    OutputEntry entry;
+    entry.key = key;
+
+    const OutputEntry *it = qLowerBound(begin, end, entry, outputLessThan);
+
+    return it != end && it->key == key ? &it->outputs : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FlatTree::matchingChilds(quint32 i, qint32 origWord, qint32 lemma,
+                                        QVector<quint32> &childs) const
+{
+    const FlatNode &n = m_nodes[i];
+    const Edge *nonWords = m_edges.constData() + n.firstChild;
+    const Edge *words = nonWords + n.nonWordCount;
+    const Edge *lemmas = m_lemmaEdges.constData() + n.firstLemma;
+    int start = childs.size();
+
+    for (const Edge *e = nonWords; e != words; ++e) {
+        childs.append(e->node);
+    }
+
+    if (origWord != -1) {
+        appendMatching(words, words + n.wordCount, origWord, childs);
+    }
+
+    if (lemma != -1) {
+        appendMatching(lemmas, lemmas + n.lemmaCount, lemma, childs);
+    }
+
+    if (childs.size() - start > 1) {
+        qSort(childs.begin() + start, childs.end());
+
+        // Remove childs with the same original word and lemma
+        int last = start;
+        for (int j = start + 1; j < childs.size(); ++j) {
+            if (childs[j] != childs[last]) {
+                childs[++last] = childs[j];
+            }
+        }
+        childs.resize(last + 1);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::FlatTree::memoryUsage() const
+{
+    qint64 bytes = vectorBytes(m_nodes.capacity(), sizeof(FlatNode))
+            + vectorBytes(m_edges.capacity(), sizeof(Edge))
+            + vectorBytes(m_lemmaEdges.capacity(), sizeof(Edge))
+            + vectorBytes(m_outputs.capacity(), sizeof(OutputEntry))
+            + listBytes(m_strings.size())
+            + hashBytes(m_stringIndex.size(), sizeof(QHashNode<QString, qint32>));
+
+    foreach (const QString &s, m_strings) {
+        bytes += stringBytes(s);
+    }
+
+    return bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::FlatTree::nodeMemoryUsage(const Nlp::Node *root)
+{
+    if (!root) {
+        return 0;
+    }
+
+    qint64 bytes = 0;
+
+    QSet<const Nlp::Node *> visited;
+    QList<const Nlp::Node *> pending;
+
+    visited.insert(root);
+    pending.append(root);
+
+    while (!pending.isEmpty()) {
+        const Nlp::Node *node = pending.takeLast();
+
+        foreach (const Nlp::Node *child, node->childs()) {
+            if (!visited.contains(child)) {
+                visited.insert(child);
+                pending.append(child);
+            }
+        }
+
+        bytes += nodeBytes(node);
+    }
+
+    return bytes;
+}
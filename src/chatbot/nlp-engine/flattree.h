@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_FLATTREE_H
+#define LVK_NLP_FLATTREE_H
+
+#include <QVector>
+#include <QStringList>
+#include <QHash>
+
+#include "nlp-engine/node.h"
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The FlatTree class provides a read-only copy of a tree of Node objects stored in
+ *        contiguous arrays
+ *
+ * Nodes are stored by value in one array, in depth-first order, and refer to each other by
+ * index. Node kinds are a tag, so there is no virtual table. The childs of a node are a range
+ * of an edge array: first the childs that are not word nodes, then the word nodes sorted by
+ * original word. A second range holds the word nodes sorted by lemma, so the childs that match
+ * a word are found by binary search.
+ *
+ * Most nodes have no outputs, so output map entries are stored in a side table instead of a
+ * hash in each node. Output lists share their data with the tree they were copied from.
+ *
+ * Words, lemmas and variable names are stored once in a string table of the tree, and nodes
+ * refer to them by index. Nodes reached from several parents are copied once, and the loops
+ * of wildcard and variable nodes are kept. The trie of phrases of a Tree is copied after the
+ * nodes of the tree.
+ *
+ * FlatTree is a prototype to measure the layout: searches still run on the Node tree.
+ *
+ * \see Tree::flatten()
+ */
+class FlatTree
+{
+public:
+
+    /**
+     * \brief A node stored by value
+     */
+    struct FlatNode
+    {
+        qint32 arg1;            ///< Original word, min occurrences or variable name
+        qint32 arg2;            ///< Lemma or max occurrences
+        quint32 firstChild;     ///< Index of the first child in edges()
+        quint32 nonWordCount;   ///< Amount of childs that are not word nodes
+        quint32 wordCount;      ///< Amount of word node childs
+        quint32 firstLemma;     ///< Index of the first word child in lemmaEdges()
+        quint32 lemmaCount;     ///< Amount of word node childs with lemma
+        quint32 firstOutput;    ///< Index of the first output map entry in outputs()
+        quint32 outputCount;    ///< Amount of output map entries
+        quint8 type;            ///< Node::Type
+    };
+
+    /**
+     * \brief An edge to a child node and the string used to look it up
+     */
+    struct Edge
+    {
+        qint32 string;          ///< Original word or lemma. -1 if the child is not a word node.
+        quint32 node;           ///< Index of the child node
+    };
+
+    /**
+     * \brief An output map entry of a node
+     */
+    struct OutputEntry
+    {
+        quint64 key;            ///< The key of the output map
+        CondOutputList outputs; ///< The outputs
+    };
+
+    /**
+     * Constructs an empty tree
+     */
+    FlatTree();
+
+    /**
+     * Replaces the nodes with a copy of the nodes reachable from \a root and, if not null, from
+     * \a phraseRoot. The root is node 0. \see phraseRoot()
+     */
+    void build(const Node *root, const Node *phraseRoot = 0);
+
+    /**
+     * Removes all nodes
+     */
+    void clear();
+
+    /**
+     * Returns the amount of nodes
+     */
+    int size() const
+    {
+        return m_nodes.size();
+    }
+
+    /**
+     * Returns the index of the root of the trie of phrases, or -1 if there is none
+     */
+    qint32 phraseRoot() const
+    {
+        return m_phraseRoot;
+    }
+
+    /**
+     * Returns the node with index \a i
+     */
+    const FlatNode &node(quint32 i) const
+    {
+        return m_nodes[i];
+    }
+
+    /**
+     * Returns the array of child edges. The childs of node \a n are the edges from
+     * n.firstChild to n.firstChild + n.nonWordCount + n.wordCount.
+     */
+    const QVector<Edge> &edges() const
+    {
+        return m_edges;
+    }
+
+    /**
+     * Returns the array of word child edges sorted by lemma. The word childs of node \a n with
+     * lemma are the edges from n.firstLemma to n.firstLemma + n.lemmaCount.
+     */
+    const QVector<Edge> &lemmaEdges() const
+    {
+        return m_lemmaEdges;
+    }
+
+    /**
+     * Returns the array of output map entries. The entries of node \a n are the ones from
+     * n.firstOutput to n.firstOutput + n.outputCount, sorted by key.
+     */
+    const QVector<OutputEntry> &outputs() const
+    {
+        return m_outputs;
+    }
+
+    /**
+     * Returns the outputs of node \a i with output map key \a key. Returns 0 if not found.
+     */
+    const CondOutputList *outputs(quint32 i, quint64 key) const;
+
+    /**
+     * Returns the string with index \a i
+     */
+    const QString &string(qint32 i) const
+    {
+        return m_strings[i];
+    }
+
+    /**
+     * Returns the index of string \a s, or -1 if no node uses it
+     */
+    qint32 stringIndex(const QString &s) const
+    {
+        return m_stringIndex.value(s, -1);
+    }
+
+    /**
+     * Returns the name of the variable of node \a i. \a i must be a variable node.
+     */
+    const QString &varName(quint32 i) const
+    {
+        return m_strings[m_nodes[i].arg1];
+    }
+
+    /**
+     * Appends to \a childs the indexes of the childs of node \a i that can match a word with
+     * original word \a origWord and lemma \a lemma, sorted in ascending order. Both are string
+     * indexes, or -1 if unknown. Word childs match if they have the same original word or the
+     * same non-empty lemma, as in MatchPolicy. Childs of any other type always match.
+     */
+    void matchingChilds(quint32 i, qint32 origWord, qint32 lemma, QVector<quint32> &childs) const;
+
+    /**
+     * Returns the bytes allocated by the tree, without the outputs shared with the tree it
+     * was copied from. Strings are counted as if they were not shared.
+     */
+    qint64 memoryUsage() const;
+
+    /**
+     * Returns an estimate of the bytes allocated by the nodes reachable from \a root, their
+     * child lists and indexes, their output maps and the strings of word nodes, without the
+     * outputs. Includes the bookkeeping of the allocator, so it can be compared with
+     * memoryUsage().
+     */
+    static qint64 nodeMemoryUsage(const Node *root);
+
+private:
+    qint32 addString(const QString &s);
+
+    qint32 m_phraseRoot;
+    QVector<FlatNode> m_nodes;
+    QVector<Edge> m_edges;
+    QVector<Edge> m_lemmaEdges;
+    QVector<OutputEntry> m_outputs;
+    QStringList m_strings;
+    QHash<QString, qint32> m_stringIndex;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+Q_DECLARE_TYPEINFO(Lvk::Nlp::FlatTree::FlatNode, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(Lvk::Nlp::FlatTree::Edge, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(Lvk::Nlp::FlatTree::OutputEntry, Q_MOVABLE_TYPE);
+
+#endif // LVK_NLP_FLATTREE_H
@@ -1,13 +1,15 @@
 #include "nlp-engine/freelinglemmatizer.h"
 #include "nlp-engine/sanitizerfactory.h"
-#include "common/settings.h"
-#include "common/settingskeys.h"
+#include "nlp-engine/freelingresources.h"
+#include "common/trace.h"
+#include "common/profiler.h"
 
-#include <QFile>
 #include <QStringList>
+#include <QElapsedTimer>
 #include <QtDebug>
 #include <list>
 #include <string>
+#include <iterator>
 
 #include "freeling.h"
 
@@ -15,18 +17,6 @@
 # include "freeling/traces.h"
 #endif
 
-#define KEY_TOKENIZER_FILE  1
-#define KEY_SPLITTER_FILE   2
-#define KEY_PROBS_FILE      3
-#define KEY_QUANTS_FILE     4
-#define KEY_DICT_FILE       5
-#define KEY_AFFIXES_FILE    6
-#define KEY_LOCUTIONS_FILE  7
-#define KEY_PUNCT_FILE      8
-
-typedef QHash<int, std::string> ConfigFilesMap;
-
-
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -34,88 +24,60 @@ typedef QHash<int, std::string> ConfigFilesMap;
 namespace
 {
 
-inline std::string getLang()
+// Checks out a set of Freeling analyzers during its lifetime
+class Lease
 {
-    Lvk::Cmn::Settings settings;
-    QString lang = settings.value(SETTING_NLP_LANGUAGE).toString();
-
-    if (lang.isEmpty()) {
-        lang = settings.value(SETTING_APP_LANGUAGE).toString().split("_").at(0);
+public:
+    Lease(Lvk::Nlp::FreelingResources *resources)
+        : m_resources(resources), m_analyzers(resources->checkout()) { }
+
+    ~Lease()
+    {
+        if (m_analyzers) {
+            m_resources->checkin(m_analyzers);
+        }
     }
 
-    return lang.toStdString();
-}
+    Lvk::Nlp::FreelingResources::Analyzers *operator->() { return m_analyzers; }
 
-//--------------------------------------------------------------------------------------------------
+    Lvk::Nlp::FreelingResources::Analyzers *get() { return m_analyzers; }
 
-inline void getFlConfigFiles(ConfigFilesMap &configFiles)
-{
-    Lvk::Cmn::Settings settings;
-    std::string dataPath = settings.value(SETTING_DATA_PATH).toString().toStdString();
-    std::string flDataPath = dataPath + "/freeling/" + getLang() + "/";
-
-    configFiles[KEY_TOKENIZER_FILE] = flDataPath + "tokenizer.dat";
-    configFiles[KEY_SPLITTER_FILE]  = flDataPath + "splitter.dat";
-    configFiles[KEY_PROBS_FILE]     = flDataPath + "probabilitats.dat";
-    configFiles[KEY_QUANTS_FILE]    = flDataPath + "quantities.dat";
-    configFiles[KEY_DICT_FILE]      = flDataPath + "dicc.src";
-    configFiles[KEY_AFFIXES_FILE]   = flDataPath + "afixos.dat";
-    configFiles[KEY_LOCUTIONS_FILE] = flDataPath + "locucions.dat";
-    configFiles[KEY_PUNCT_FILE]     = flDataPath + "tags.dat";
-}
+    bool isValid() const { return m_analyzers != 0; }
+
+private:
+    Lvk::Nlp::FreelingResources *m_resources;
+    Lvk::Nlp::FreelingResources::Analyzers *m_analyzers;
+};
 
 //--------------------------------------------------------------------------------------------------
 
-inline bool exists(ConfigFilesMap &configFiles)
+// Records the time elapsed until it is stopped or destroyed. Does nothing if stats is null.
+class StageTimer
 {
-    ConfigFilesMap::const_iterator it;
-
-    for (it = configFiles.constBegin(); it != configFiles.constEnd(); ++it) {
-        const char* const filename = it.value().c_str();
-        if (!QFile::exists(filename)) {
-            qCritical() << "File not found" << filename;
-            return false;
+public:
+    StageTimer(Lvk::Nlp::LemmatizerStats *stats, Lvk::Nlp::LemmatizerStats::Stage stage)
+        : m_stats(stats), m_stage(stage)
+    {
+        if (m_stats) {
+            m_timer.start();
         }
     }
-    return true;
-}
 
-//--------------------------------------------------------------------------------------------------
+    ~StageTimer() { stop(); }
 
-template<class T>
-inline void init(T** p, const std::string &configFile)
-{
-    *p  = new T(configFile);
-}
-
-//--------------------------------------------------------------------------------------------------
+    void stop()
+    {
+        if (m_stats) {
+            m_stats->record(m_stage, m_timer.nsecsElapsed());
+            m_stats = 0;
+        }
+    }
 
-inline void init(maco** p, const ConfigFilesMap &configFiles)
-{
-    maco_options opt(getLang());
-
-    // Set all modules disabled:
-    opt.set_active_modules(false, false, false, false, false, false, false, false, NER_NONE, false);
-    opt.set_data_files("", "", "", "", "", "", "", "");
-
-    // Enable one by one:
-    opt.ProbabilityAssignment = true;
-    opt.DictionarySearch      = true;
-    opt.QuantitiesDetection   = true;
-    opt.NumbersDetection      = true;
-    opt.AffixAnalysis         = true;
-    //opt.DatesDetection        = true;
-    opt.PunctuationDetection  = true;
-    opt.MultiwordsDetection   = true;
-    opt.ProbabilityFile       = configFiles[KEY_PROBS_FILE];
-    opt.DictionaryFile        = configFiles[KEY_DICT_FILE];
-    opt.QuantitiesFile        = configFiles[KEY_QUANTS_FILE];
-    opt.AffixFile             = configFiles[KEY_AFFIXES_FILE];
-    opt.LocutionsFile         = configFiles[KEY_LOCUTIONS_FILE];
-    opt.PunctuationFile       = configFiles[KEY_PUNCT_FILE];
-
-    *p = new maco(opt);
-}
+private:
+    Lvk::Nlp::LemmatizerStats *m_stats;
+    Lvk::Nlp::LemmatizerStats::Stage m_stage;
+    QElapsedTimer m_timer;
+};
 
 //--------------------------------------------------------------------------------------------------
 
@@ -152,24 +114,41 @@ inline void convert(const std::list<word> &lw, QStringList &l)
 
 //--------------------------------------------------------------------------------------------------
 
-inline void convert(const std::list<sentence> &ls, Lvk::Nlp::WordList &l)
+inline void convert(std::list<sentence>::const_iterator begin,
+                    std::list<sentence>::const_iterator end, Lvk::Nlp::WordList &l)
 {
     l.clear();
 
-    for (list<sentence>::const_iterator lit = ls.begin(); lit != ls.end(); ++lit) {
+    for (list<sentence>::const_iterator lit = begin; lit != end; ++lit) {
         for (sentence::const_iterator wit = lit->begin(); wit != lit->end(); ++wit) {
             Lvk::Nlp::Word w;
             // CHECK
             //w.origWord = input.mid(wit->get_span_start(), wit->get_span_finish() - wit->get_span_start());
             //w.normWord = QString::fromStdString(wit->get_form());
             w.origWord = QString::fromStdString(wit->get_form());
-            w.lemma    = QString::fromStdString(wit->get_lemma());
+            // Without the probabilities module unknown words have no analysis
+            if (wit->get_n_analysis() == 0) {
+                w.lemma = w.origWord;
+                l.append(w);
+                continue;
+            }
+            // Chat inputs are mostly lower case so many words are their own lemma. Sharing the
+            // string saves a conversion per word
+            w.lemma    = wit->get_lemma() == wit->get_form()
+                            ? w.origWord : QString::fromStdString(wit->get_lemma());
             w.posTag   = QString::fromStdString(wit->get_parole());
             l.append(w);
         }
     }
 }
 
+//--------------------------------------------------------------------------------------------------
+
+inline void convert(const std::list<sentence> &ls, Lvk::Nlp::WordList &l)
+{
+    convert(ls.begin(), ls.end(), l);
+}
+
 } // namespace
 
 
@@ -177,85 +156,218 @@ inline void convert(const std::list<sentence> &ls, Lvk::Nlp::WordList &l)
 // Lemmatizer
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::FreelingLemmatizer::FreelingLemmatizer()
-    : m_flInit(false), m_tk(0), m_sp(0), m_morpho(0), m_preSanitizer(0), m_postSanitizer(0)
+Lvk::Nlp::FreelingLemmatizer::FreelingLemmatizer(const QString &lang /*= QString()*/)
+    : m_resources(FreelingResources::get(lang)), m_preSanitizer(0), m_postSanitizer(0),
+      m_stats(new LemmatizerStats()), m_profiling(false)
 {
 #ifdef ENABLE_FREELING_TRACES
     traces::TraceLevel=4;
     traces::TraceModule=0xFFFFF;
 #endif
 
-    ConfigFilesMap configFiles;
-
-    getFlConfigFiles(configFiles);
-
-    if (exists(configFiles)) {
-        qDebug() << "Initializing Freeling...";
-        init(&m_tk, configFiles[KEY_TOKENIZER_FILE]);
-        init(&m_sp, configFiles[KEY_SPLITTER_FILE]);
-        init(&m_morpho, configFiles);
-    }
+    m_preSanitizer = Nlp::SanitizerFactory().createPreSanitizer(lang);
+    m_postSanitizer = Nlp::SanitizerFactory().createPostSanitizer(lang);
+}
 
-    if (m_tk && m_sp && m_morpho) {
-        m_flInit = true;
-    } else {
-        qCritical() << "Freeling could not be initialized. Lemmatization is disabled.";
-    }
+//--------------------------------------------------------------------------------------------------
 
-    m_preSanitizer = Nlp::SanitizerFactory().createPreSanitizer();
-    m_postSanitizer = Nlp::SanitizerFactory().createPostSanitizer();
+Lvk::Nlp::FreelingLemmatizer::FreelingLemmatizer(const QString &lang,
+                                                 const AnalysisProfile &profile)
+    : m_resources(FreelingResources::get(lang, profile)), m_preSanitizer(0), m_postSanitizer(0),
+      m_stats(new LemmatizerStats()), m_profiling(false)
+{
+    m_preSanitizer = Nlp::SanitizerFactory().createPreSanitizer(lang);
+    m_postSanitizer = Nlp::SanitizerFactory().createPostSanitizer(lang);
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Nlp::FreelingLemmatizer::~FreelingLemmatizer()
 {
+    delete m_stats;
     delete m_postSanitizer;
     delete m_preSanitizer;
-    delete m_morpho;
-    delete m_sp;
-    delete m_tk;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::Nlp::FreelingLemmatizer::tokenize(const QString &input, QStringList &l)
 {
-    if (m_flInit) {
+    LemmatizerStats *stats = activeStats();
+    StageTimer totalTimer(stats, LemmatizerStats::TotalStage);
+
+    Lease analyzers(m_resources.data());
+
+    if (analyzers.isValid()) {
+        StageTimer toStdTimer(stats, LemmatizerStats::ConvertStage);
+        std::string text = addFullStop(input).toStdString();
+        toStdTimer.stop();
+
         std::list<word> lw;
-        m_tk->tokenize(addFullStop(input).toStdString(), lw);
+        StageTimer tokenizeTimer(stats, LemmatizerStats::TokenizeStage);
+        analyzers->tk->tokenize(text, lw);
+        tokenizeTimer.stop();
 
+        StageTimer fromStdTimer(stats, LemmatizerStats::ConvertStage);
         convert(lw, l);
     } else {
         qCritical() << "Freeling could not be initialized. Lemmatization is disabled.";
     }
 
-    qDebug() << "Tokenized:" << input << "->" << l;
+    LVK_TRACE(Lemmatizer) << "Tokenized:" << input << "->" << l;
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::Nlp::FreelingLemmatizer::lemmatize(const QString &input, Nlp::WordList &words)
 {
-    if (m_flInit) {
-        QString szInput = m_preSanitizer->sanitize(input);
+    LVK_PROFILE("FreelingLemmatizer::lemmatize");
 
-        std::list<word> lw;
-        m_tk->tokenize(addFullStop(szInput).toStdString(), lw);
+    LemmatizerStats *stats = activeStats();
+    StageTimer totalTimer(stats, LemmatizerStats::TotalStage);
+
+    Lease analyzers(m_resources.data());
 
+    if (analyzers.isValid()) {
         std::list<sentence> ls;
-        m_sp->split(lw, false, ls);
+        split(analyzers.get(), input, ls);
 
-        m_morpho->analyze(ls);
+        StageTimer analyzeTimer(stats, LemmatizerStats::AnalyzeStage);
+        analyzers->morpho->analyze(ls);
+        analyzeTimer.stop();
 
+        StageTimer fromStdTimer(stats, LemmatizerStats::ConvertStage);
         convert(ls, words);
+        fromStdTimer.stop();
 
-        for (int i = 0; i < words.size(); ++i)  {
-            words[i].normWord = m_postSanitizer->sanitize(words[i].origWord);
-        }
+        postSanitize(words);
     } else {
         qCritical() << "Freeling could not be initialized. Lemmatization is disabled.";
     }
 
-    qDebug() << "Lemmatized:" << input << "->" << words;
+    LVK_TRACE(Lemmatizer) << "Lemmatized:" << input << "->" << words;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FreelingLemmatizer::lemmatizeBatch(const QStringList &inputs,
+                                                  QList<Nlp::WordList> &l)
+{
+    LVK_PROFILE("FreelingLemmatizer::lemmatizeBatch");
+
+    l.clear();
+
+    LemmatizerStats *stats = activeStats();
+    StageTimer totalTimer(stats, LemmatizerStats::TotalStage);
+
+    Lease analyzers(m_resources.data());
+
+    if (!analyzers.isValid()) {
+        qCritical() << "Freeling could not be initialized. Lemmatization is disabled.";
+        for (int i = 0; i < inputs.size(); ++i) {
+            l.append(Nlp::WordList());
+        }
+        return;
+    }
+
+    // Split all inputs and analyze all sentences at once
+
+    std::list<sentence> ls;
+    QList<int> sentenceCount;
+
+    foreach (const QString &input, inputs) {
+        std::list<sentence> inputLs;
+        split(analyzers.get(), input, inputLs);
+
+        sentenceCount.append(inputLs.size());
+        ls.splice(ls.end(), inputLs);
+    }
+
+    StageTimer analyzeTimer(stats, LemmatizerStats::AnalyzeStage);
+    analyzers->morpho->analyze(ls);
+    analyzeTimer.stop();
+
+    // Convert sentences back to one list of words per input
+
+    std::list<sentence>::const_iterator begin = ls.begin();
+
+    for (int i = 0; i < inputs.size(); ++i) {
+        std::list<sentence>::const_iterator end = begin;
+        std::advance(end, sentenceCount[i]);
+
+        Nlp::WordList words;
+        StageTimer fromStdTimer(stats, LemmatizerStats::ConvertStage);
+        convert(begin, end, words);
+        fromStdTimer.stop();
+
+        postSanitize(words);
+        l.append(words);
+
+        LVK_TRACE(Lemmatizer) << "Lemmatized:" << inputs[i] << "->" << words;
+
+        begin = end;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FreelingLemmatizer::split(FreelingResources::Analyzers *analyzers,
+                                         const QString &input, std::list<sentence> &ls)
+{
+    LemmatizerStats *stats = activeStats();
+
+    StageTimer preSanitizeTimer(stats, LemmatizerStats::PreSanitizeStage);
+    QString szInput = m_preSanitizer->sanitize(input);
+    preSanitizeTimer.stop();
+
+    StageTimer toStdTimer(stats, LemmatizerStats::ConvertStage);
+    std::string text = addFullStop(szInput).toStdString();
+    toStdTimer.stop();
+
+    std::list<word> lw;
+    StageTimer tokenizeTimer(stats, LemmatizerStats::TokenizeStage);
+    analyzers->tk->tokenize(text, lw);
+    tokenizeTimer.stop();
+
+    StageTimer splitTimer(stats, LemmatizerStats::SplitStage);
+    analyzers->sp->split(lw, false, ls);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FreelingLemmatizer::postSanitize(Nlp::WordList &words)
+{
+    StageTimer postSanitizeTimer(activeStats(), LemmatizerStats::PostSanitizeStage);
+
+    for (int i = 0; i < words.size(); ++i)  {
+        words[i].normWord = m_postSanitizer->sanitize(words[i].origWord);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FreelingLemmatizer::setProfiling(bool enabled)
+{
+    m_profiling = enabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Nlp::LemmatizerStats & Lvk::Nlp::FreelingLemmatizer::stats() const
+{
+    return *m_stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FreelingLemmatizer::clearStats()
+{
+    m_stats->clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmatizerStats * Lvk::Nlp::FreelingLemmatizer::activeStats()
+{
+    return m_profiling ? m_stats : 0;
 }
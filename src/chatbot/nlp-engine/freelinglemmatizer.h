@@ -3,10 +3,13 @@
 
 #include "nlp-engine/lemmatizer.h"
 #include "nlp-engine/sanitizer.h"
+#include "nlp-engine/freelingresources.h"
+#include "nlp-engine/lemmatizerstats.h"
 
-class tokenizer;
-class splitter;
-class maco;
+#include <list>
+#include <QSharedPointer>
+
+class sentence;
 
 namespace Lvk
 {
@@ -25,15 +28,28 @@ namespace Nlp
  * \brief The FreelingLemmatizer class provides the default implementation of the Lemmatizer
  *        interface.
  *
- * The FreelingLemmatizer class uses Freeling to tokenize and lemmatize sentences.
+ * The FreelingLemmatizer class uses Freeling to tokenize and lemmatize sentences. Freeling
+ * analyzers are shared with other lemmatizers through FreelingResources, so constructing a
+ * FreelingLemmatizer is cheap once the resources are loaded.
+ *
+ * If profiling is enabled, the time spent in each stage of the Freeling pipeline is recorded
+ * and can be queried with stats().
  */
 class FreelingLemmatizer : public Lemmatizer
 {
 public:
     /**
-     * Constructs a FreelingLemmatizer with the default parameters.
+     * Constructs a FreelingLemmatizer for language \a lang. If \a lang is empty, the language
+     * in the application settings is used. Lemmatizers of the same language share the Freeling
+     * resources.
+     */
+    FreelingLemmatizer(const QString &lang = QString());
+
+    /**
+     * Constructs a FreelingLemmatizer for language \a lang that runs the analysis modules of
+     * \a profile. Lemmatizers of the same language and profile share the Freeling resources.
      */
-    FreelingLemmatizer();
+    FreelingLemmatizer(const QString &lang, const AnalysisProfile &profile);
 
     /**
      * \copydoc Lemmatizer::~Lemmatizer()
@@ -50,17 +66,42 @@ public:
      */
     virtual void lemmatize(const QString &input, WordList &words);
 
+    /**
+     * \copydoc Lemmatizer::lemmatizeBatch(const QStringList &, QList<WordList> &)
+     *
+     * All sentences are analyzed in one pass.
+     */
+    virtual void lemmatizeBatch(const QStringList &inputs, QList<WordList> &l);
+
+    /**
+     * Enables or disables profiling. By default profiling is disabled.
+     */
+    void setProfiling(bool enabled);
+
+    /**
+     * Returns the time spent in each stage since profiling was enabled or stats were cleared.
+     */
+    const LemmatizerStats & stats() const;
+
+    /**
+     * Clears the stats.
+     */
+    void clearStats();
 
 private:
     FreelingLemmatizer(const FreelingLemmatizer&);
     FreelingLemmatizer & operator=(const FreelingLemmatizer&);
 
-    bool m_flInit;
-    tokenizer *m_tk;
-    splitter *m_sp;
-    maco *m_morpho;
+    void split(FreelingResources::Analyzers *analyzers, const QString &input,
+               std::list<sentence> &ls);
+    void postSanitize(Nlp::WordList &words);
+    LemmatizerStats *activeStats();
+
+    QSharedPointer<FreelingResources> m_resources;
     Sanitizer *m_preSanitizer;
     Sanitizer *m_postSanitizer;
+    LemmatizerStats *m_stats;
+    bool m_profiling;
 };
 
 /// @}
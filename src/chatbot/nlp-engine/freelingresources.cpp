@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/freelingresources.h"
+#include "nlp-engine/toolchain.h"
+#include "common/startuptimeline.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QFile>
+#include <QHash>
+#include <QWeakPointer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThread>
+#include <QTime>
+#include <QtConcurrentRun>
+#include <QtDebug>
+#include <string>
+
+#include "freeling.h"
+
+#define KEY_TOKENIZER_FILE  1
+#define KEY_SPLITTER_FILE   2
+#define KEY_PROBS_FILE      3
+#define KEY_QUANTS_FILE     4
+#define KEY_DICT_FILE       5
+#define KEY_AFFIXES_FILE    6
+#define KEY_LOCUTIONS_FILE  7
+#define KEY_PUNCT_FILE      8
+
+typedef QHash<int, std::string> ConfigFilesMap;
+
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+typedef QHash<QString, QWeakPointer<Lvk::Nlp::FreelingResources> > Registry;
+
+QMutex s_registryMutex;
+Registry s_registry;
+QList< QSharedPointer<Lvk::Nlp::FreelingResources> > s_preloaded;
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString getDataPath()
+{
+    return Lvk::Cmn::SettingsSnapshot::current().value(SETTING_DATA_PATH).toString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void getFlConfigFiles(ConfigFilesMap &configFiles, const QString &lang,
+                             const QString &dataPath)
+{
+    std::string flDataPath = dataPath.toStdString() + "/freeling/" + lang.toStdString() + "/";
+
+    configFiles[KEY_TOKENIZER_FILE] = flDataPath + "tokenizer.dat";
+    configFiles[KEY_SPLITTER_FILE]  = flDataPath + "splitter.dat";
+    configFiles[KEY_PROBS_FILE]     = flDataPath + "probabilitats.dat";
+    configFiles[KEY_QUANTS_FILE]    = flDataPath + "quantities.dat";
+    configFiles[KEY_DICT_FILE]      = flDataPath + "dicc.src";
+    configFiles[KEY_AFFIXES_FILE]   = flDataPath + "afixos.dat";
+    configFiles[KEY_LOCUTIONS_FILE] = flDataPath + "locucions.dat";
+    configFiles[KEY_PUNCT_FILE]     = flDataPath + "tags.dat";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool exists(ConfigFilesMap &configFiles)
+{
+    ConfigFilesMap::const_iterator it;
+
+    for (it = configFiles.constBegin(); it != configFiles.constEnd(); ++it) {
+        const char* const filename = it.value().c_str();
+        if (!QFile::exists(filename)) {
+            qCritical() << "File not found" << filename;
+            return false;
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+template<class T>
+inline void init(T** p, const std::string &configFile)
+{
+    *p  = new T(configFile);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void init(maco** p, const ConfigFilesMap &configFiles, const QString &lang,
+                 const Lvk::Nlp::AnalysisProfile &profile)
+{
+    maco_options opt(lang.toStdString());
+
+    // Set all modules disabled:
+    opt.set_active_modules(false, false, false, false, false, false, false, false, NER_NONE, false);
+    opt.set_data_files("", "", "", "", "", "", "", "");
+
+    // Enable the modules of the profile:
+    opt.DictionarySearch      = true;
+    opt.ProbabilityAssignment = profile.has(Lvk::Nlp::AnalysisProfile::Probabilities);
+    opt.QuantitiesDetection   = profile.has(Lvk::Nlp::AnalysisProfile::Quantities);
+    opt.NumbersDetection      = profile.has(Lvk::Nlp::AnalysisProfile::Numbers);
+    opt.AffixAnalysis         = profile.has(Lvk::Nlp::AnalysisProfile::Affixes);
+    //opt.DatesDetection        = true;
+    opt.PunctuationDetection  = profile.has(Lvk::Nlp::AnalysisProfile::Punctuation);
+    opt.MultiwordsDetection   = profile.has(Lvk::Nlp::AnalysisProfile::Multiwords);
+    opt.ProbabilityFile       = configFiles[KEY_PROBS_FILE];
+    opt.DictionaryFile        = configFiles[KEY_DICT_FILE];
+    opt.QuantitiesFile        = configFiles[KEY_QUANTS_FILE];
+    opt.AffixFile             = configFiles[KEY_AFFIXES_FILE];
+    opt.LocutionsFile         = configFiles[KEY_LOCUTIONS_FILE];
+    opt.PunctuationFile       = configFiles[KEY_PUNCT_FILE];
+
+    *p = new maco(opt);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void destroy(Lvk::Nlp::FreelingResources::Analyzers *analyzers)
+{
+    delete analyzers->morpho;
+    delete analyzers->sp;
+    delete analyzers->tk;
+    delete analyzers;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void preloadResources()
+{
+    LVK_STARTUP_PHASE("lemmatizer_load");
+
+    QSharedPointer<Lvk::Nlp::FreelingResources> resources = Lvk::Nlp::FreelingResources::get();
+
+    {
+        QMutexLocker locker(&s_registryMutex);
+        s_preloaded.append(resources);
+    }
+
+    Lvk::Nlp::FreelingResources::Analyzers *analyzers = resources->checkout();
+
+    if (analyzers) {
+        resources->checkin(analyzers);
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// FreelingResources
+//--------------------------------------------------------------------------------------------------
+
+QSharedPointer<Lvk::Nlp::FreelingResources> Lvk::Nlp::FreelingResources::get()
+{
+    return get(QString());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QSharedPointer<Lvk::Nlp::FreelingResources> Lvk::Nlp::FreelingResources::get(const QString &lang)
+{
+    return get(lang, AnalysisProfile::fromSettings());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QSharedPointer<Lvk::Nlp::FreelingResources>
+Lvk::Nlp::FreelingResources::get(const QString &lang, const AnalysisProfile &profile)
+{
+    return get(lang.isEmpty() ? Toolchain::defaultLanguage() : lang, getDataPath(), profile);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QSharedPointer<Lvk::Nlp::FreelingResources>
+Lvk::Nlp::FreelingResources::get(const QString &lang, const QString &dataPath,
+                                 const AnalysisProfile &profile /*= AnalysisProfile::full()*/)
+{
+    QString key = lang + "|" + dataPath + "|" + QString::number(profile.modules());
+
+    QMutexLocker locker(&s_registryMutex);
+
+    QSharedPointer<FreelingResources> resources = s_registry.value(key).toStrongRef();
+
+    if (!resources) {
+        resources = QSharedPointer<FreelingResources>(new FreelingResources(lang, dataPath,
+                                                                            profile));
+        s_registry[key] = resources;
+    }
+
+    return resources;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FreelingResources::preload()
+{
+    qDebug() << "Preloading Freeling resources...";
+
+    QtConcurrent::run(preloadResources);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::FreelingResources::FreelingResources(const QString &lang, const QString &dataPath,
+                                               const AnalysisProfile &profile)
+    : m_lang(lang),
+      m_dataPath(dataPath),
+      m_profile(profile),
+      m_valid(true),
+      m_maxSize(Cmn::SettingsSnapshot::current().value(SETTING_NLP_LEMMA_POOL_SIZE).toInt()),
+      m_loading(0),
+      m_mutex(new QMutex()),
+      m_loadMutex(new QMutex()),
+      m_available(new QWaitCondition())
+{
+    if (m_maxSize <= 0) {
+        m_maxSize = QThread::idealThreadCount();
+    }
+    if (m_maxSize <= 0) {
+        m_maxSize = 1;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::FreelingResources::~FreelingResources()
+{
+    foreach (Analyzers *analyzers, m_all) {
+        destroy(analyzers);
+    }
+
+    delete m_available;
+    delete m_loadMutex;
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const QString & Lvk::Nlp::FreelingResources::lang() const
+{
+    return m_lang;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Nlp::AnalysisProfile & Lvk::Nlp::FreelingResources::profile() const
+{
+    return m_profile;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::FreelingResources::isValid() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_valid;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::FreelingResources::maxSize() const
+{
+    return m_maxSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::FreelingResources::Analyzers * Lvk::Nlp::FreelingResources::checkout()
+{
+    QMutexLocker locker(m_mutex);
+
+    // While the first set is loading, e.g. by preload(), wait for it instead of loading another
+    while (m_valid && m_free.isEmpty()
+           && (m_all.size() + m_loading >= m_maxSize || (m_all.isEmpty() && m_loading > 0))) {
+        m_available->wait(m_mutex);
+    }
+
+    if (!m_valid) {
+        return 0;
+    }
+
+    if (!m_free.isEmpty()) {
+        return m_free.takeLast();
+    }
+
+    // Loading takes seconds, so other threads are not blocked meanwhile. Loading itself is
+    // serialized since Freeling does not support concurrent construction.
+    ++m_loading;
+    locker.unlock();
+
+    Analyzers *analyzers = 0;
+
+    {
+        QMutexLocker loadLocker(m_loadMutex);
+        analyzers = load();
+    }
+
+    locker.relock();
+    --m_loading;
+
+    if (analyzers) {
+        m_all.append(analyzers);
+    } else {
+        m_valid = false;
+        m_available->wakeAll();
+    }
+
+    return analyzers;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FreelingResources::checkin(Analyzers *analyzers)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_free.append(analyzers);
+    m_available->wakeOne();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::FreelingResources::Analyzers * Lvk::Nlp::FreelingResources::load()
+{
+    ConfigFilesMap configFiles;
+
+    getFlConfigFiles(configFiles, m_lang, m_dataPath);
+
+    if (!exists(configFiles)) {
+        return 0;
+    }
+
+    qDebug() << "Initializing Freeling for language" << m_lang << "with profile"
+             << m_profile.toString() << "...";
+
+    QTime t;
+    t.start();
+
+    Analyzers *analyzers = new Analyzers();
+
+    init(&analyzers->tk, configFiles[KEY_TOKENIZER_FILE]);
+    init(&analyzers->sp, configFiles[KEY_SPLITTER_FILE]);
+    init(&analyzers->morpho, configFiles, m_lang, m_profile);
+
+    if (!analyzers->tk || !analyzers->sp || !analyzers->morpho) {
+        destroy(analyzers);
+        return 0;
+    }
+
+    qDebug() << "Freeling initialized in" << t.elapsed() << "ms";
+
+    return analyzers;
+}
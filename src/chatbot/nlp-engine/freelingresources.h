@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_FREELINGRESOURCES_H
+#define LVK_NLP_FREELINGRESOURCES_H
+
+#include <QString>
+#include <QList>
+#include <QSharedPointer>
+
+#include "nlp-engine/analysisprofile.h"
+
+class tokenizer;
+class splitter;
+class maco;
+class QMutex;
+class QWaitCondition;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The FreelingResources class provides Freeling analyzers shared by all lemmatizers
+ *        of the process.
+ *
+ * Loading Freeling dictionaries is the most expensive step of creating a lemmatizer. Resources
+ * are registered by language, data path and analysis profile, so every FreelingLemmatizer with
+ * the same configuration shares the loaded analyzers. Resources are released when the last
+ * reference is destroyed unless they were preloaded with preload().
+ *
+ * Freeling analyzers are not reentrant, hence each call checks out a set of analyzers for its
+ * exclusive use. A new set is loaded only if all sets are busy, up to maxSize() sets.
+ */
+class FreelingResources
+{
+public:
+
+    /**
+     * \brief The Analyzers struct provides a set of Freeling analyzers
+     */
+    struct Analyzers
+    {
+        Analyzers() : tk(0), sp(0), morpho(0) { }
+
+        tokenizer *tk;
+        splitter *sp;
+        maco *morpho;
+    };
+
+    /**
+     * Returns the resources for the language, data path and analysis profile in the
+     * application settings.
+     */
+    static QSharedPointer<FreelingResources> get();
+
+    /**
+     * Returns the resources for \a lang and the data path and analysis profile in the
+     * application settings. If \a lang is empty, returns the resources for the language in
+     * the application settings. All callers of the same language share the same resources.
+     */
+    static QSharedPointer<FreelingResources> get(const QString &lang);
+
+    /**
+     * Returns the resources for \a lang, the data path in the application settings and
+     * \a profile. If \a lang is empty, the language in the application settings is used.
+     */
+    static QSharedPointer<FreelingResources> get(const QString &lang,
+                                                 const AnalysisProfile &profile);
+
+    /**
+     * Returns the resources for \a lang, \a dataPath and \a profile. Resources are loaded on
+     * demand.
+     */
+    static QSharedPointer<FreelingResources> get(const QString &lang, const QString &dataPath,
+                                                 const AnalysisProfile &profile
+                                                 = AnalysisProfile::full());
+
+    /**
+     * Loads in a background thread the resources for the language, data path and analysis
+     * profile in the application settings. Preloaded resources are kept until the application
+     * exits.
+     */
+    static void preload();
+
+    /**
+     * Destroys the object and all loaded analyzers.
+     */
+    ~FreelingResources();
+
+    /**
+     * Returns the language of the resources.
+     */
+    const QString &lang() const;
+
+    /**
+     * Returns the analysis profile of the resources.
+     */
+    const AnalysisProfile &profile() const;
+
+    /**
+     * Returns false if the analyzers could not be loaded. Otherwise; returns true.
+     */
+    bool isValid() const;
+
+    /**
+     * Checks out a set of analyzers for the exclusive use of the caller. If all sets are busy
+     * and there are maxSize() sets, the call waits until one is checked in. Returns 0 if the
+     * analyzers could not be loaded.
+     */
+    Analyzers *checkout();
+
+    /**
+     * Checks in \a analyzers previously returned by checkout().
+     */
+    void checkin(Analyzers *analyzers);
+
+    /**
+     * Returns the maximum amount of sets of analyzers
+     */
+    int maxSize() const;
+
+private:
+    FreelingResources(const QString &lang, const QString &dataPath,
+                      const AnalysisProfile &profile);
+    FreelingResources(const FreelingResources&);
+    FreelingResources & operator=(const FreelingResources&);
+
+    QString m_lang;
+    QString m_dataPath;
+    AnalysisProfile m_profile;
+    bool m_valid;
+    int m_maxSize;
+    int m_loading;
+    QList<Analyzers *> m_all;
+    QList<Analyzers *> m_free;
+    QMutex *m_mutex;
+    QMutex *m_loadMutex;
+    QWaitCondition *m_available;
+
+    Analyzers *load();
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_FREELINGRESOURCES_H
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/fuzzyindex.h"
+
+#include <QSet>
+#include <QVector>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Appends to deletes all strings obtained by deleting up to depth chars of str
+void generateDeletes(const QString &str, int depth, QSet<QString> &deletes)
+{
+    if (depth == 0 || str.size() <= 1) {
+        return;
+    }
+
+    for (int i = 0; i < str.size(); ++i) {
+        QString del = QString(str).remove(i, 1);
+        if (!deletes.contains(del)) {
+            deletes.insert(del);
+            generateDeletes(del, depth - 1, deletes);
+        }
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// FuzzyIndex
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::FuzzyIndex::FuzzyIndex()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FuzzyIndex::add(SymbolId symbol, const QString &word)
+{
+    if (symbol == NullSymbol || m_words.contains(symbol)) {
+        return;
+    }
+
+    QString lword = word.toLower();
+
+    m_words.insert(symbol, lword);
+
+    addDeletes(lword, symbol, MaxDistance);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FuzzyIndex::addDeletes(const QString &str, SymbolId symbol, int depth)
+{
+    QSet<QString> deletes;
+    deletes.insert(str);
+    generateDeletes(str, depth, deletes);
+
+    foreach (const QString &del, deletes) {
+        m_deletes[del].append(symbol);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FuzzyIndex::clear()
+{
+    m_words.clear();
+    m_deletes.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::FuzzyIndex::size() const
+{
+    return m_words.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::FuzzyIndex::deletesCount() const
+{
+    return m_deletes.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::FuzzyIndex::contains(SymbolId symbol) const
+{
+    return m_words.contains(symbol);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::FuzzyIndex::lookup(const QString &word, FuzzyCandidateList &candidates) const
+{
+    int max = maxDistance(word.size());
+
+    if (max == 0 || m_words.isEmpty()) {
+        return;
+    }
+
+    QString lword = word.toLower();
+
+    QSet<QString> deletes;
+    deletes.insert(lword);
+    generateDeletes(lword, max, deletes);
+
+    QSet<SymbolId> checked;
+
+    foreach (const QString &del, deletes) {
+        DeletesMap::const_iterator it = m_deletes.find(del);
+
+        if (it == m_deletes.constEnd()) {
+            continue;
+        }
+
+        foreach (SymbolId symbol, *it) {
+            if (checked.contains(symbol)) {
+                continue;
+            }
+            checked.insert(symbol);
+
+            int d = distance(lword, m_words.value(symbol), max);
+
+            if (d > 0 && d <= max) {
+                candidates.append(FuzzyCandidate(symbol, d));
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::FuzzyIndex::maxDistance(int length)
+{
+    if (length < 3) {
+        return 0;
+    } else if (length < 5) {
+        return 1;
+    } else {
+        return MaxDistance;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::FuzzyIndex::distance(const QString &s1, const QString &s2, int max)
+{
+    int n = s1.size();
+    int m = s2.size();
+
+    if (qAbs(n - m) > max) {
+        return max + 1;
+    }
+
+    // Three rows of the dynamic programming matrix are enough for transpositions
+    QVector<int> prev2(m + 1), prev(m + 1), cur(m + 1);
+
+    for (int j = 0; j <= m; ++j) {
+        prev[j] = j;
+    }
+
+    for (int i = 1; i <= n; ++i) {
+        cur[0] = i;
+        int rowMin = cur[0];
+
+        for (int j = 1; j <= m; ++j) {
+            int cost = s1[i - 1] == s2[j - 1] ? 0 : 1;
+
+            cur[j] = qMin(qMin(prev[j] + 1, cur[j - 1] + 1), prev[j - 1] + cost);
+
+            if (i > 1 && j > 1 && s1[i - 1] == s2[j - 2] && s1[i - 2] == s2[j - 1]) {
+                cur[j] = qMin(cur[j], prev2[j - 2] + 1);
+            }
+
+            rowMin = qMin(rowMin, cur[j]);
+        }
+
+        if (rowMin > max) {
+            return max + 1;
+        }
+
+        prev2 = prev;
+        prev = cur;
+    }
+
+    return qMin(prev[m], max + 1);
+}
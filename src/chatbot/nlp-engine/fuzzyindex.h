@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_FUZZYINDEX_H
+#define LVK_NLP_FUZZYINDEX_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+
+#include "nlp-engine/symboltable.h"
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The FuzzyCandidate struct provides a dictionary word similar to a user word
+ */
+struct FuzzyCandidate
+{
+    FuzzyCandidate(SymbolId symbol = NullSymbol, int distance = 0)
+        : symbol(symbol), distance(distance) { }
+
+    SymbolId symbol;    ///< Symbol of the dictionary word
+    int distance;       ///< Edit distance to the user word
+};
+
+/**
+ * \brief List of fuzzy candidates
+ */
+typedef QList<FuzzyCandidate> FuzzyCandidateList;
+
+/**
+ * \brief The FuzzyIndex class provides a dictionary of words to find the ones within a small
+ *        edit distance of a misspelled word
+ *
+ * The index stores every string obtained by deleting up to MaxDistance characters of each
+ * dictionary word (SymSpell algorithm). A lookup generates the deletes of the user word, so
+ * it only needs a few hash lookups instead of comparing it with the whole dictionary. The
+ * candidates found are verified with the optimal string alignment distance, that is, the
+ * Levenshtein distance with transpositions of adjacent characters.
+ *
+ * The maximum distance depends on the length of the user word, see maxDistance(). Words are
+ * compared in lower case.
+ */
+class FuzzyIndex
+{
+public:
+
+    /**
+     * Maximum distance supported by the index
+     */
+    static const int MaxDistance = 2;
+
+    /**
+     * Constructs an empty index
+     */
+    FuzzyIndex();
+
+    /**
+     * Adds \a word with \a symbol to the dictionary. Adding the same symbol twice does nothing.
+     */
+    void add(SymbolId symbol, const QString &word);
+
+    /**
+     * Removes all words
+     */
+    void clear();
+
+    /**
+     * Returns the amount of words in the dictionary
+     */
+    int size() const;
+
+    /**
+     * Returns the amount of deletes indexed
+     */
+    int deletesCount() const;
+
+    /**
+     * Returns true if \a symbol is in the dictionary. Otherwise; returns false.
+     */
+    bool contains(SymbolId symbol) const;
+
+    /**
+     * Appends to \a candidates the dictionary words within maxDistance() of \a word, excluding
+     * \a word itself.
+     */
+    void lookup(const QString &word, FuzzyCandidateList &candidates) const;
+
+    /**
+     * Returns the maximum edit distance allowed for a word with \a length characters.
+     * Words shorter than 3 characters are never corrected since almost any word is near them.
+     */
+    static int maxDistance(int length);
+
+    /**
+     * Returns the optimal string alignment distance between \a s1 and \a s2 or \a max + 1 if
+     * it is greater than \a max
+     */
+    static int distance(const QString &s1, const QString &s2, int max);
+
+private:
+    typedef QHash<QString, QList<SymbolId> > DeletesMap;
+
+    QHash<SymbolId, QString> m_words;
+    DeletesMap m_deletes;   // delete -> words
+
+    void addDeletes(const QString &str, SymbolId symbol, int depth);
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_FUZZYINDEX_H
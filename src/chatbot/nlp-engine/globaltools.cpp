@@ -20,8 +20,6 @@
  */
 
 #include "globaltools.h"
-#include "nlp-engine/nullsanitizer.h"
-#include "nlp-engine/nulllemmatizer.h"
 
 #include <QMutex>
 #include <QMutexLocker>
@@ -36,9 +34,6 @@ QMutex * Lvk::Nlp::GlobalTools::m_mutex = new QMutex();
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Nlp::GlobalTools::GlobalTools()
-    : m_preSanitizer(new NullSanitizer()),
-      m_lemmatizer(new NullLemmatizer()),
-      m_postSanitizer(new NullSanitizer())
 {
 }
 
@@ -55,47 +50,3 @@ Lvk::Nlp::GlobalTools * Lvk::Nlp::GlobalTools::instance()
 
     return m_instance;
 }
-
-//--------------------------------------------------------------------------------------------------
-
-Lvk::Nlp::Sanitizer * Lvk::Nlp::GlobalTools::preSanitizer()
-{
-    return m_preSanitizer.get();
-}
-
-//--------------------------------------------------------------------------------------------------
-
-void Lvk::Nlp::GlobalTools::setPreSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
-{
-    m_preSanitizer.reset(sanitizer ? sanitizer : new NullSanitizer());
-}
-
-//--------------------------------------------------------------------------------------------------
-
-Lvk::Nlp::Lemmatizer * Lvk::Nlp::GlobalTools::lemmatizer()
-{
-    return m_lemmatizer.get();
-}
-
-//--------------------------------------------------------------------------------------------------
-
-void Lvk::Nlp::GlobalTools::setLemmatizer(Lvk::Nlp::Lemmatizer *lemmatizer)
-{
-    m_lemmatizer.reset(lemmatizer ? lemmatizer : new NullLemmatizer());
-}
-
-//--------------------------------------------------------------------------------------------------
-
-Lvk::Nlp::Sanitizer * Lvk::Nlp::GlobalTools::postSanitizer()
-{
-    return m_postSanitizer.get();
-}
-
-//--------------------------------------------------------------------------------------------------
-
-void Lvk::Nlp::GlobalTools::setPostSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
-{
-    m_postSanitizer.reset(sanitizer ? sanitizer : new NullSanitizer());
-}
-
-
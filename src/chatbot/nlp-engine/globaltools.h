@@ -22,9 +22,7 @@
 #ifndef LVK_NLP_GLOBALTOOLS_H
 #define LVK_NLP_GLOBALTOOLS_H
 
-#include "nlp-engine/sanitizer.h"
-#include "nlp-engine/lemmatizer.h"
-#include <memory>
+#include "nlp-engine/toolchain.h"
 
 class QMutex;
 
@@ -41,29 +39,18 @@ namespace Nlp
 /// \addtogroup Nlp
 /// @{
 
-// TODO refactor and remove this class!
-
 /**
- * \brief The GlobalTools class provides collection of common NLP tools
+ * \brief The GlobalTools class provides the process-wide default toolchain.
+ *
+ * It is used by engines and trees that have no toolchain of their own.
+ *
+ * \see Toolchain
  */
-class GlobalTools
+class GlobalTools : public Toolchain
 {
 public:
     static GlobalTools* instance();
 
-
-    Sanitizer * preSanitizer();
-
-    void setPreSanitizer(Sanitizer *sanitizer);
-
-    Lemmatizer * lemmatizer();
-
-    void setLemmatizer(Lemmatizer *lemmatizer);
-
-    Sanitizer * postSanitizer();
-
-    void setPostSanitizer(Sanitizer *sanitizer);
-
 private:
     GlobalTools();
     GlobalTools(GlobalTools&);
@@ -71,11 +58,6 @@ private:
 
     static GlobalTools *m_instance;
     static QMutex *m_mutex;
-
-    // TODO use share pointers
-    std::auto_ptr<Sanitizer>  m_preSanitizer;
-    std::auto_ptr<Lemmatizer> m_lemmatizer;
-    std::auto_ptr<Sanitizer>  m_postSanitizer;
 };
 
 /// @}
@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_INLINELIST_H
+#define LVK_NLP_INLINELIST_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QDebug>
+
+#include <new>
+#include <string.h>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The InlineList class provides a contiguous list with inline capacity
+ *
+ * The first \a Prealloc elements are stored inside the object, so lists of typical sizes cost
+ * no allocation at all. Larger lists move to a single heap block that grows geometrically.
+ * Unlike QList, elements are never allocated one by one and removing elements only shifts the
+ * tail. Types declared Q_MOVABLE_TYPE are relocated with memcpy().
+ *
+ * The interface is the subset of QList used by the NLP engine, so InlineList can replace
+ * QList without changing the call sites. Iterators are plain pointers and are invalidated by
+ * any operation that adds or removes elements.
+ *
+ * InlineList is not implicitly shared. Copies are deep.
+ */
+template <typename T, int Prealloc>
+class InlineList
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+    typedef iterator Iterator;
+    typedef const_iterator ConstIterator;
+    typedef int size_type;
+    typedef qptrdiff difference_type;
+
+    /**
+     * Constructs an empty list.
+     */
+    InlineList() : m_data(inlineData()), m_size(0), m_capacity(Prealloc) { }
+
+    /**
+     * Constructs a copy of \a other.
+     */
+    InlineList(const InlineList &other) : m_data(inlineData()), m_size(0), m_capacity(Prealloc)
+    {
+        append(other.m_data, other.m_size);
+    }
+
+    /**
+     * Destroys the list.
+     */
+    ~InlineList()
+    {
+        destroy(m_data, m_data + m_size);
+        release();
+    }
+
+    /**
+     * Assigns \a other to this list.
+     */
+    InlineList &operator=(const InlineList &other)
+    {
+        if (this != &other) {
+            clear();
+            append(other.m_data, other.m_size);
+        }
+        return *this;
+    }
+
+    /**
+     * Returns a list with the elements of \a list.
+     */
+    static InlineList fromList(const QList<T> &list)
+    {
+        InlineList l;
+        l.reserve(list.size());
+        for (int i = 0; i < list.size(); ++i) {
+            l.append(list.at(i));
+        }
+        return l;
+    }
+
+    /**
+     * Returns a QList with the elements of this list.
+     */
+    QList<T> toList() const
+    {
+        QList<T> list;
+        list.reserve(m_size);
+        for (int i = 0; i < m_size; ++i) {
+            list.append(m_data[i]);
+        }
+        return list;
+    }
+
+    int size() const { return m_size; }
+    int count() const { return m_size; }
+    int length() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    bool empty() const { return m_size == 0; }
+
+    /**
+     * Returns the number of elements that fit without allocating.
+     */
+    int capacity() const { return m_capacity; }
+
+    /**
+     * Returns true if the elements are stored inside the object. Otherwise; returns false.
+     */
+    bool isInline() const { return m_data == inlineData(); }
+
+    /**
+     * Makes room for at least \a n elements.
+     */
+    void reserve(int n)
+    {
+        if (n > m_capacity) {
+            relocate(n);
+        }
+    }
+
+    /**
+     * Removes all elements. The capacity is kept.
+     */
+    void clear()
+    {
+        destroy(m_data, m_data + m_size);
+        m_size = 0;
+    }
+
+    const T &at(int i) const
+    {
+        Q_ASSERT_X(i >= 0 && i < m_size, "InlineList::at", "index out of range");
+        return m_data[i];
+    }
+
+    T &operator[](int i)
+    {
+        Q_ASSERT_X(i >= 0 && i < m_size, "InlineList::operator[]", "index out of range");
+        return m_data[i];
+    }
+
+    const T &operator[](int i) const { return at(i); }
+
+    T value(int i) const { return i >= 0 && i < m_size ? m_data[i] : T(); }
+    T value(int i, const T &defaultValue) const
+    {
+        return i >= 0 && i < m_size ? m_data[i] : defaultValue;
+    }
+
+    T &first() { Q_ASSERT(m_size > 0); return m_data[0]; }
+    const T &first() const { Q_ASSERT(m_size > 0); return m_data[0]; }
+    T &last() { Q_ASSERT(m_size > 0); return m_data[m_size - 1]; }
+    const T &last() const { Q_ASSERT(m_size > 0); return m_data[m_size - 1]; }
+    T &front() { return first(); }
+    const T &front() const { return first(); }
+    T &back() { return last(); }
+    const T &back() const { return last(); }
+
+    iterator begin() { return m_data; }
+    const_iterator begin() const { return m_data; }
+    const_iterator constBegin() const { return m_data; }
+    iterator end() { return m_data + m_size; }
+    const_iterator end() const { return m_data + m_size; }
+    const_iterator constEnd() const { return m_data + m_size; }
+
+    /**
+     * Appends \a t to the list.
+     */
+    void append(const T &t)
+    {
+        if (m_size == m_capacity) {
+            T copy(t); // t can be an element of this list
+            relocate(m_capacity*2);
+            new (m_data + m_size) T(copy);
+        } else {
+            new (m_data + m_size) T(t);
+        }
+        ++m_size;
+    }
+
+    /**
+     * Appends the elements of \a other to the list.
+     */
+    void append(const InlineList &other)
+    {
+        if (this == &other) {
+            InlineList copy(other);
+            append(copy.m_data, copy.m_size);
+        } else {
+            append(other.m_data, other.m_size);
+        }
+    }
+
+    void push_back(const T &t) { append(t); }
+    void prepend(const T &t) { insert(0, t); }
+    void push_front(const T &t) { insert(0, t); }
+
+    /**
+     * Inserts \a t at index position \a i.
+     */
+    void insert(int i, const T &t)
+    {
+        Q_ASSERT_X(i >= 0 && i <= m_size, "InlineList::insert", "index out of range");
+
+        if (i == m_size) {
+            append(t);
+            return;
+        }
+
+        T copy(t);
+
+        if (m_size == m_capacity) {
+            relocate(m_capacity*2);
+        }
+
+        if (QTypeInfo<T>::isStatic) {
+            new (m_data + m_size) T(m_data[m_size - 1]);
+            for (int j = m_size - 1; j > i; --j) {
+                m_data[j] = m_data[j - 1];
+            }
+            m_data[i] = copy;
+        } else {
+            ::memmove(static_cast<void *>(m_data + i + 1), static_cast<void *>(m_data + i),
+                      (m_size - i)*sizeof(T));
+            new (m_data + i) T(copy);
+        }
+        ++m_size;
+    }
+
+    iterator insert(iterator before, const T &t)
+    {
+        int i = before - m_data;
+        insert(i, t);
+        return m_data + i;
+    }
+
+    /**
+     * Removes the elements in the range [\a first, \a last) and returns an iterator to the
+     * element that followed them.
+     */
+    iterator erase(iterator first, iterator last)
+    {
+        Q_ASSERT(first >= m_data && first <= last && last <= m_data + m_size);
+
+        iterator end = m_data + m_size;
+
+        if (QTypeInfo<T>::isStatic) {
+            iterator dst = first;
+            for (iterator src = last; src != end; ++src, ++dst) {
+                *dst = *src;
+            }
+            destroy(dst, end);
+        } else {
+            destroy(first, last);
+            ::memmove(static_cast<void *>(first), static_cast<void *>(last),
+                      (end - last)*sizeof(T));
+        }
+
+        m_size -= last - first;
+        return first;
+    }
+
+    iterator erase(iterator pos) { return erase(pos, pos + 1); }
+
+    void removeAt(int i)
+    {
+        Q_ASSERT_X(i >= 0 && i < m_size, "InlineList::removeAt", "index out of range");
+        erase(m_data + i);
+    }
+
+    void removeFirst() { removeAt(0); }
+    void removeLast() { removeAt(m_size - 1); }
+    void pop_back() { removeLast(); }
+    void pop_front() { removeFirst(); }
+
+    T takeAt(int i)
+    {
+        T t = at(i);
+        removeAt(i);
+        return t;
+    }
+
+    T takeFirst() { return takeAt(0); }
+    T takeLast() { return takeAt(m_size - 1); }
+
+    /**
+     * Moves the element at index position \a from to index position \a to.
+     */
+    void move(int from, int to)
+    {
+        Q_ASSERT_X(from >= 0 && from < m_size && to >= 0 && to < m_size, "InlineList::move",
+                   "index out of range");
+
+        for (; from < to; ++from) {
+            qSwap(m_data[from], m_data[from + 1]);
+        }
+        for (; from > to; --from) {
+            qSwap(m_data[from], m_data[from - 1]);
+        }
+    }
+
+    void swap(int i, int j) { qSwap(m_data[i], m_data[j]); }
+
+    /**
+     * Returns a list with \a length elements starting at \a pos. If \a length is -1, all
+     * elements after \a pos are included.
+     */
+    InlineList mid(int pos, int length = -1) const
+    {
+        InlineList l;
+
+        pos = qBound(0, pos, m_size);
+        length = length < 0 || pos + length > m_size ? m_size - pos : length;
+
+        l.append(m_data + pos, length);
+        return l;
+    }
+
+    int indexOf(const T &t, int from = 0) const
+    {
+        for (int i = qMax(from, 0); i < m_size; ++i) {
+            if (m_data[i] == t) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool contains(const T &t) const { return indexOf(t) != -1; }
+
+    bool operator==(const InlineList &other) const
+    {
+        if (m_size != other.m_size) {
+            return false;
+        }
+        for (int i = 0; i < m_size; ++i) {
+            if (!(m_data[i] == other.m_data[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const InlineList &other) const { return !(*this == other); }
+
+    InlineList &operator+=(const T &t) { append(t); return *this; }
+    InlineList &operator+=(const InlineList &other) { append(other); return *this; }
+    InlineList &operator<<(const T &t) { append(t); return *this; }
+    InlineList &operator<<(const InlineList &other) { append(other); return *this; }
+
+    InlineList operator+(const InlineList &other) const
+    {
+        InlineList l(*this);
+        l.append(other);
+        return l;
+    }
+
+private:
+    T *m_data;
+    int m_size;
+    int m_capacity;
+
+    union
+    {
+        char bytes[sizeof(T)*Prealloc];
+        double align1;
+        qint64 align2;
+        void *align3;
+    } m_inline;
+
+    T *inlineData() { return reinterpret_cast<T *>(m_inline.bytes); }
+    const T *inlineData() const { return reinterpret_cast<const T *>(m_inline.bytes); }
+
+    // Appends n elements of other storage
+    void append(const T *src, int n)
+    {
+        reserve(m_size + n);
+        for (int i = 0; i < n; ++i) {
+            new (m_data + m_size) T(src[i]);
+            ++m_size;
+        }
+    }
+
+    // Moves the elements to a heap block of the given capacity
+    void relocate(int capacity)
+    {
+        capacity = qMax(capacity, m_size);
+
+        T *data = static_cast<T *>(::operator new(capacity*sizeof(T)));
+
+        if (QTypeInfo<T>::isStatic) {
+            for (int i = 0; i < m_size; ++i) {
+                new (data + i) T(m_data[i]);
+                m_data[i].~T();
+            }
+        } else {
+            ::memcpy(static_cast<void *>(data), static_cast<void *>(m_data), m_size*sizeof(T));
+        }
+
+        release();
+
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    void release()
+    {
+        if (!isInline()) {
+            ::operator delete(m_data);
+        }
+    }
+
+    static void destroy(T *first, T *last)
+    {
+        for (; first != last; ++first) {
+            first->~T();
+        }
+    }
+};
+
+/**
+ * \brief This method adds support to print debug information of InlineList objects
+ */
+template <typename T, int Prealloc>
+inline QDebug operator<<(QDebug dbg, const InlineList<T, Prealloc> &l)
+{
+    dbg.nospace() << '(';
+    for (int i = 0; i < l.size(); ++i) {
+        if (i) {
+            dbg << ", ";
+        }
+        dbg << l.at(i);
+    }
+    dbg << ')';
+
+    return dbg.space();
+}
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_INLINELIST_H
@@ -0,0 +1,671 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "nlp-engine/lemmatable.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QVector>
+#include <QtDebug>
+
+#include <cstring>
+
+#define LEMMA_TABLE_MAGIC_NUMBER        (('l'<<0) | ('m'<<8) | ('t'<<16) | ('\0'<<24))
+#define LEMMA_TABLE_FILE_FORMAT_VERSION 2
+#define LEMMA_TABLE_STREAM_VERSION      1   // Version 1 files are read with QDataStream
+#define LEMMA_TABLE_BYTE_ORDER_MARK     0x01020304
+#define AMBIGUOUS_LEMMA                 -1
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+// Version 2 files start with the magic number and the version in big endian, as written by
+// QDataStream, followed by a MappedHeader and the table in native byte order:
+//
+//   quint32 buckets[bucketCount]      index of a form + 1, 0 if the bucket is empty
+//   MappedForm forms[formCount]
+//   MappedLemma lemmas[lemmaCount]
+//   ushort pool[poolSize]             UTF-16 forms and lemmas, referenced by offset
+//
+// All offsets are relative, so the file can be mapped at any address. The mapping is page
+// aligned and every array is aligned to its element size.
+
+namespace
+{
+
+struct MappedHeader
+{
+    quint32 byteOrder;
+    quint32 formCount;
+    quint32 lemmaCount;
+    quint32 bucketCount;    // Power of two
+    quint32 poolSize;
+};
+
+struct MappedForm
+{
+    quint32 offset;
+    quint32 length;
+    qint32 lemmaIdx;
+};
+
+struct MappedLemma
+{
+    quint32 offset;
+    quint32 length;
+};
+
+const qint64 PREFIX_SIZE = 2*sizeof(quint32);
+const qint64 HASH_CHUNK_SIZE = 1024*1024;
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the SHA-1 of the contents of filename in hex, or an empty string if it cannot be read
+QByteArray fileHash(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    while (!file.atEnd()) {
+        QByteArray chunk = file.read(HASH_CHUNK_SIZE);
+        if (chunk.isEmpty()) {
+            return QByteArray();
+        }
+        hash.addData(chunk);
+    }
+
+    return hash.result().toHex();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray readHash(const QString &filename)
+{
+    QFile file(filename);
+
+    return file.open(QFile::ReadOnly) ? file.readAll().trimmed() : QByteArray();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool writeHash(const QString &filename, const QByteArray &hash)
+{
+    QFile file(filename);
+
+    return file.open(QFile::WriteOnly | QFile::Truncate) && file.write(hash) == hash.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// FNV-1a, unlike qHash() it is part of the file format
+inline quint32 formHash(const QChar *str, int size)
+{
+    quint32 h = 2166136261u;
+
+    for (int i = 0; i < size; ++i) {
+        h = (h ^ str[i].unicode()) * 16777619u;
+    }
+
+    return h;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+quint32 bucketCountFor(int forms)
+{
+    quint32 n = 2;
+
+    while (n < 2*(quint32)forms) {
+        n <<= 1;
+    }
+
+    return n;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// LemmaTable::Mapping
+//--------------------------------------------------------------------------------------------------
+
+struct Lvk::Nlp::LemmaTable::Mapping
+{
+    Mapping() : map(0), header(0), buckets(0), forms(0), lemmas(0), pool(0) { }
+
+    ~Mapping()
+    {
+        if (map) {
+            file.unmap(map);
+        }
+    }
+
+    // Returns the string at the given offset of the pool. Returns a null string if the
+    // string is not within the pool.
+    QString string(quint32 offset, quint32 length) const
+    {
+        if (offset > header->poolSize || length > header->poolSize - offset) {
+            return QString();
+        }
+
+        return QString(reinterpret_cast<const QChar *>(pool + offset), length);
+    }
+
+    // Copies the table to formIdxs and lemmaList
+    void copyTo(QHash<QString, qint32> &formIdxs, QStringList &lemmaList) const
+    {
+        lemmaList.clear();
+        for (quint32 i = 0; i < header->lemmaCount; ++i) {
+            lemmaList.append(string(lemmas[i].offset, lemmas[i].length));
+        }
+
+        formIdxs.clear();
+        formIdxs.reserve(header->formCount);
+        for (quint32 i = 0; i < header->formCount; ++i) {
+            qint32 lemmaIdx = forms[i].lemmaIdx;
+            if (lemmaIdx < 0 || lemmaIdx >= lemmaList.size()) {
+                lemmaIdx = AMBIGUOUS_LEMMA;
+            }
+            formIdxs.insert(string(forms[i].offset, forms[i].length), lemmaIdx);
+        }
+    }
+
+    QFile file;
+    uchar *map;
+    QByteArray buffer;      // Used if the file cannot be mapped
+    const MappedHeader *header;
+    const quint32 *buckets;
+    const MappedForm *forms;
+    const MappedLemma *lemmas;
+    const ushort *pool;
+};
+
+//--------------------------------------------------------------------------------------------------
+// LemmaTable
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmaTable::LemmaTable()
+    : m_mapping(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmaTable::~LemmaTable()
+{
+    delete m_mapping;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmaTable::detach()
+{
+    if (!m_mapping) {
+        return;
+    }
+
+    m_mapping->copyTo(m_forms, m_lemmas);
+    m_lemmaIdxs.clear();
+
+    delete m_mapping;
+    m_mapping = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmaTable::add(const QString &form, const QString &lemma)
+{
+    detach();
+
+    // Loaded tables do not keep the lemma indexes
+    if (m_lemmaIdxs.size() != m_lemmas.size()) {
+        m_lemmaIdxs.clear();
+        for (int i = 0; i < m_lemmas.size(); ++i) {
+            m_lemmaIdxs[m_lemmas[i]] = i;
+        }
+    }
+
+    QString lcLemma = lemma.toLower();
+    qint32 lemmaIdx = AMBIGUOUS_LEMMA;
+
+    // Contractions are split by the morphological analysis, e.g. del -> de+el
+    if (!lcLemma.contains('+')) {
+        QHash<QString, qint32>::iterator lit = m_lemmaIdxs.find(lcLemma);
+        if (lit == m_lemmaIdxs.end()) {
+            m_lemmas.append(lcLemma);
+            lit = m_lemmaIdxs.insert(lcLemma, m_lemmas.size() - 1);
+        }
+        lemmaIdx = *lit;
+    }
+
+    QHash<QString, qint32>::iterator it = m_forms.find(form.toLower());
+
+    if (it == m_forms.end()) {
+        m_forms.insert(form.toLower(), lemmaIdx);
+    } else if (*it != lemmaIdx) {
+        *it = AMBIGUOUS_LEMMA;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmaTable::Status Lvk::Nlp::LemmaTable::lookup(const QString &form,
+                                                          QString &lemma) const
+{
+    if (!m_mapping) {
+        QHash<QString, qint32>::const_iterator it = m_forms.find(form.toLower());
+
+        if (it == m_forms.constEnd()) {
+            return Unknown;
+        }
+
+        if (*it == AMBIGUOUS_LEMMA) {
+            return Ambiguous;
+        }
+
+        lemma = m_lemmas[*it];
+
+        return Unique;
+    }
+
+    QString lcForm = form.toLower();
+    const MappedHeader *header = m_mapping->header;
+    const quint32 mask = header->bucketCount - 1;
+
+    quint32 i = formHash(lcForm.constData(), lcForm.size()) & mask;
+
+    for (quint32 probes = 0; probes < header->bucketCount; ++probes, i = (i + 1) & mask) {
+        quint32 entry = m_mapping->buckets[i];
+
+        if (entry == 0 || entry > header->formCount) {
+            return Unknown;
+        }
+
+        const MappedForm &f = m_mapping->forms[entry - 1];
+
+        if (f.length != (quint32)lcForm.size() || f.offset > header->poolSize
+                || f.length > header->poolSize - f.offset
+                || memcmp(m_mapping->pool + f.offset, lcForm.utf16(), 2*f.length) != 0) {
+            continue;
+        }
+
+        if (f.lemmaIdx < 0 || (quint32)f.lemmaIdx >= header->lemmaCount) {
+            return Ambiguous;
+        }
+
+        const MappedLemma &l = m_mapping->lemmas[f.lemmaIdx];
+        lemma = m_mapping->string(l.offset, l.length);
+
+        return Unique;
+    }
+
+    return Unknown;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::LemmaTable::size() const
+{
+    return m_mapping ? m_mapping->header->formCount : m_forms.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::LemmaTable::lemmaCount() const
+{
+    return m_mapping ? m_mapping->header->lemmaCount : m_lemmas.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmaTable::clear()
+{
+    delete m_mapping;
+    m_mapping = 0;
+
+    m_forms.clear();
+    m_lemmas.clear();
+    m_lemmaIdxs.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::LemmaTable::importDictionary(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        qCritical() << "LemmaTable: Cannot open dictionary" << filename;
+        return false;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("ISO-8859-1");
+
+    while (!in.atEnd()) {
+        QStringList fields = in.readLine().split(' ', QString::SkipEmptyParts);
+
+        // Skip section markers of newer dictionaries
+        if (fields.size() < 3 || fields[0].startsWith('<')) {
+            continue;
+        }
+
+        for (int i = 1; i + 1 < fields.size(); i += 2) {
+            add(fields[0], fields[i]);
+        }
+    }
+
+    qDebug() << "LemmaTable: Imported" << size() << "forms from" << filename;
+
+    return in.status() == QTextStream::Ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::LemmaTable::load(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        qCritical() << "LemmaTable: Cannot open" << filename;
+        return false;
+    }
+
+    QDataStream istream(&file);
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+
+    istream >> magic >> version;
+
+    bool loaded = false;
+
+    if (magic != LEMMA_TABLE_MAGIC_NUMBER) {
+        qCritical() << "LemmaTable: Invalid format version" << filename;
+    } else if (version == LEMMA_TABLE_FILE_FORMAT_VERSION) {
+        loaded = loadMapped(file);
+    } else if (version == LEMMA_TABLE_STREAM_VERSION) {
+        loaded = loadStream(file);
+    } else {
+        qCritical() << "LemmaTable: Invalid format version" << filename;
+    }
+
+    if (loaded) {
+        qDebug() << "LemmaTable: Loaded" << size() << "forms from" << filename;
+    }
+
+    return loaded;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::LemmaTable::loadStream(QFile &file)
+{
+    QDataStream istream(&file);
+    istream.setVersion(QDataStream::Qt_4_7);
+
+    QStringList lemmas;
+    quint32 size = 0;
+
+    istream >> lemmas >> size;
+
+    QHash<QString, qint32> forms;
+    forms.reserve(size);
+
+    for (quint32 i = 0; i < size && istream.status() == QDataStream::Ok; ++i) {
+        QString form;
+        qint32 lemmaIdx = AMBIGUOUS_LEMMA;
+        istream >> form >> lemmaIdx;
+
+        if (lemmaIdx < AMBIGUOUS_LEMMA || lemmaIdx >= lemmas.size()) {
+            break;
+        }
+
+        forms.insert(form, lemmaIdx);
+    }
+
+    if (istream.status() != QDataStream::Ok || (quint32)forms.size() != size) {
+        qCritical() << "LemmaTable: Cannot read" << file.fileName() << ": Invalid file format";
+        return false;
+    }
+
+    clear();
+
+    m_forms.swap(forms);
+    m_lemmas.swap(lemmas);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::LemmaTable::loadMapped(QFile &file)
+{
+    Mapping *mapping = new Mapping();
+    mapping->file.setFileName(file.fileName());
+
+    const uchar *data = 0;
+    qint64 size = 0;
+
+    if (mapping->file.open(QFile::ReadOnly)) {
+        size = mapping->file.size();
+        mapping->map = mapping->file.map(0, size);
+
+        if (mapping->map) {
+            data = mapping->map;
+        } else {
+            mapping->buffer = mapping->file.readAll();
+            data = reinterpret_cast<const uchar *>(mapping->buffer.constData());
+            size = mapping->buffer.size();
+        }
+    }
+
+    bool valid = false;
+
+    if (data && size >= PREFIX_SIZE + (qint64)sizeof(MappedHeader)) {
+        const MappedHeader *header = reinterpret_cast<const MappedHeader *>(data + PREFIX_SIZE);
+
+        quint64 expected = PREFIX_SIZE + sizeof(MappedHeader)
+                + (quint64)header->bucketCount*sizeof(quint32)
+                + (quint64)header->formCount*sizeof(MappedForm)
+                + (quint64)header->lemmaCount*sizeof(MappedLemma)
+                + (quint64)header->poolSize*sizeof(ushort);
+
+        valid = header->byteOrder == LEMMA_TABLE_BYTE_ORDER_MARK
+                && header->bucketCount > header->formCount
+                && (header->bucketCount & (header->bucketCount - 1)) == 0
+                && expected == (quint64)size;
+
+        if (valid) {
+            const uchar *p = data + PREFIX_SIZE + sizeof(MappedHeader);
+
+            mapping->header = header;
+            mapping->buckets = reinterpret_cast<const quint32 *>(p);
+            p += header->bucketCount*sizeof(quint32);
+            mapping->forms = reinterpret_cast<const MappedForm *>(p);
+            p += header->formCount*sizeof(MappedForm);
+            mapping->lemmas = reinterpret_cast<const MappedLemma *>(p);
+            p += header->lemmaCount*sizeof(MappedLemma);
+            mapping->pool = reinterpret_cast<const ushort *>(p);
+        }
+    }
+
+    if (!valid) {
+        qCritical() << "LemmaTable: Cannot read" << file.fileName() << ": Invalid file format";
+        delete mapping;
+        return false;
+    }
+
+    clear();
+
+    m_mapping = mapping;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::LemmaTable::save(const QString &filename) const
+{
+    QHash<QString, qint32> formIdxs = m_forms;
+    QStringList lemmaList = m_lemmas;
+
+    // Mapped tables are saved from their own contents
+    if (m_mapping) {
+        m_mapping->copyTo(formIdxs, lemmaList);
+    }
+
+    QVector<QString> formList;
+    QVector<qint32> lemmaIdxList;
+    formList.reserve(formIdxs.size());
+    lemmaIdxList.reserve(formIdxs.size());
+
+    for (QHash<QString, qint32>::const_iterator it = formIdxs.constBegin();
+         it != formIdxs.constEnd(); ++it) {
+        formList.append(it.key());
+        lemmaIdxList.append(it.value());
+    }
+
+    MappedHeader header;
+    header.byteOrder = LEMMA_TABLE_BYTE_ORDER_MARK;
+    header.formCount = formList.size();
+    header.lemmaCount = lemmaList.size();
+    header.bucketCount = bucketCountFor(formList.size());
+    header.poolSize = 0;
+
+    QVector<quint32> buckets(header.bucketCount, 0);
+    QVector<MappedForm> forms(header.formCount);
+    QVector<MappedLemma> lemmas(header.lemmaCount);
+    QString pool;
+
+    for (int i = 0; i < lemmaList.size(); ++i) {
+        lemmas[i].offset = pool.size();
+        lemmas[i].length = lemmaList[i].size();
+        pool += lemmaList[i];
+    }
+
+    const quint32 mask = header.bucketCount - 1;
+
+    for (int i = 0; i < formList.size(); ++i) {
+        forms[i].offset = pool.size();
+        forms[i].length = formList[i].size();
+        forms[i].lemmaIdx = lemmaIdxList[i];
+        pool += formList[i];
+
+        quint32 b = formHash(formList[i].constData(), formList[i].size()) & mask;
+        while (buckets[b] != 0) {
+            b = (b + 1) & mask;
+        }
+        buckets[b] = i + 1;
+    }
+
+    header.poolSize = pool.size();
+
+    QFile file(filename);
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCritical() << "LemmaTable: Cannot write" << filename;
+        return false;
+    }
+
+    QDataStream ostream(&file);
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    ostream << (quint32)LEMMA_TABLE_MAGIC_NUMBER;
+    ostream << (quint32)LEMMA_TABLE_FILE_FORMAT_VERSION;
+
+    if (ostream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    qint64 expected = sizeof(header) + buckets.size()*sizeof(quint32)
+            + forms.size()*sizeof(MappedForm) + lemmas.size()*sizeof(MappedLemma)
+            + pool.size()*sizeof(ushort);
+
+    qint64 written = file.write(reinterpret_cast<const char *>(&header), sizeof(header))
+            + file.write(reinterpret_cast<const char *>(buckets.constData()),
+                         buckets.size()*sizeof(quint32))
+            + file.write(reinterpret_cast<const char *>(forms.constData()),
+                         forms.size()*sizeof(MappedForm))
+            + file.write(reinterpret_cast<const char *>(lemmas.constData()),
+                         lemmas.size()*sizeof(MappedLemma))
+            + file.write(reinterpret_cast<const char *>(pool.utf16()),
+                         pool.size()*sizeof(ushort));
+
+    return written == expected;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::LemmaTable::loadCached(const QString &dictFilename, const QString &cacheFilename)
+{
+    QString hashFilename = cacheFilename + ".sha1";
+    QByteArray hash = fileHash(dictFilename);
+
+    if (hash.isEmpty()) {
+        qCritical() << "LemmaTable: Cannot read dictionary" << dictFilename;
+        return false;
+    }
+
+    if (QFile::exists(cacheFilename) && readHash(hashFilename) == hash && load(cacheFilename)) {
+        return true;
+    }
+
+    LemmaTable imported;
+
+    if (!imported.importDictionary(dictFilename)) {
+        return false;
+    }
+
+    // The table is saved aside and then renamed, so other processes never map a partial
+    // file. The hash is written last, an interrupted update is imported again next time.
+    QString tmpFilename = cacheFilename + ".tmp";
+
+    QFile::remove(hashFilename);
+    QFile::remove(cacheFilename);
+
+    if (imported.save(tmpFilename) && QFile::rename(tmpFilename, cacheFilename)
+            && writeHash(hashFilename, hash) && load(cacheFilename)) {
+        qDebug() << "LemmaTable: Cached" << dictFilename << "in" << cacheFilename;
+        return true;
+    }
+
+    qWarning() << "LemmaTable: Cannot cache" << dictFilename << "in" << cacheFilename;
+
+    QFile::remove(tmpFilename);
+
+    clear();
+    m_forms = imported.m_forms;
+    m_lemmas = imported.m_lemmas;
+    m_lemmaIdxs = imported.m_lemmaIdxs;
+
+    return true;
+}
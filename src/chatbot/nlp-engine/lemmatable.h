@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_LEMMATABLE_H
+#define LVK_NLP_LEMMATABLE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+class QFile;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The LemmaTable class provides a precomputed table of word forms and their lemmas
+ *
+ * The table is imported once from a Freeling dictionary, the file dicc.src of a language, and
+ * saved in a binary file laid out as a hash table with offsets instead of pointers. Loading
+ * the file maps it in memory and lookups read it in place, so loading is almost instant and
+ * processes that load the same file share its pages through the page cache instead of
+ * holding private copies. Forms with a single lemma are
+ * unique. Forms with several lemmas or contractions, such as "del" -> "de+el", are ambiguous:
+ * only a full morphological analysis can tell the right lemma.
+ *
+ * Forms are stored in lower case. Lookups are case-insensitive.
+ *
+ * Lookups do not modify the table, so a loaded table can be shared by several threads.
+ */
+class LemmaTable
+{
+public:
+
+    /**
+     * Result of a lookup
+     */
+    enum Status
+    {
+        Unknown,        ///< The form is not in the table
+        Unique,         ///< The form has a single lemma
+        Ambiguous       ///< The form has several lemmas
+    };
+
+    /**
+     * Constructs an empty table
+     */
+    LemmaTable();
+
+    /**
+     * Destroys the table and unmaps the loaded file, if any.
+     */
+    ~LemmaTable();
+
+    /**
+     * Adds \a form with \a lemma. If \a form was already added with a different lemma, it
+     * becomes ambiguous.
+     */
+    void add(const QString &form, const QString &lemma);
+
+    /**
+     * Looks up \a form. If the form is unique, sets \a lemma with its lemma.
+     */
+    Status lookup(const QString &form, QString &lemma) const;
+
+    /**
+     * Returns the amount of forms in the table
+     */
+    int size() const;
+
+    /**
+     * Returns the amount of distinct lemmas in the table
+     */
+    int lemmaCount() const;
+
+    /**
+     * Removes all forms from the table
+     */
+    void clear();
+
+    /**
+     * Adds all forms of the Freeling dictionary \a filename. Each line of the dictionary
+     * has the form "form lemma1 tag1 lemma2 tag2 ...". Freeling 2 dictionaries are Latin-1
+     * encoded. Returns true on success. Otherwise; returns false.
+     */
+    bool importDictionary(const QString &filename);
+
+    /**
+     * Replaces the table with the one saved in \a filename. Returns true on success.
+     * Otherwise; returns false and the table is not modified.
+     *
+     * Files saved by save() are mapped in memory and must not be modified while the table
+     * exists. Adding forms to a mapped table copies it to memory.
+     */
+    bool load(const QString &filename);
+
+    /**
+     * Saves the table in \a filename. Returns true on success. Otherwise; returns false.
+     */
+    bool save(const QString &filename) const;
+
+    /**
+     * Replaces the table with the one saved in \a cacheFilename if it was imported from the
+     * current contents of the Freeling dictionary \a dictFilename. Otherwise, imports
+     * \a dictFilename and saves the table in \a cacheFilename for the next call. The SHA-1 of
+     * the dictionary is kept in \a cacheFilename plus ".sha1". Returns true if the table was
+     * loaded or imported, even if the cache could not be saved. Otherwise; returns false.
+     */
+    bool loadCached(const QString &dictFilename, const QString &cacheFilename);
+
+private:
+    LemmaTable(const LemmaTable&);
+    LemmaTable & operator=(const LemmaTable&);
+
+    struct Mapping;
+
+    QHash<QString, qint32> m_forms;     // form -> index in m_lemmas, -1 if ambiguous
+    QStringList m_lemmas;
+    QHash<QString, qint32> m_lemmaIdxs; // lemma -> index in m_lemmas, built by add()
+    Mapping *m_mapping;                 // Loaded file, if set the members above are empty
+
+    bool loadStream(QFile &file);
+    bool loadMapped(QFile &file);
+    void detach();
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_LEMMATABLE_H
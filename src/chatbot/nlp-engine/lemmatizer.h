@@ -40,6 +40,36 @@ public:
      * Lemmatizes \a input.
      */
     virtual void lemmatize(const QString &input, WordList &l) = 0;
+
+    /**
+     * Lemmatizes each string in \a inputs. After the call, \a l contains one list of words for
+     * each input in the same order.
+     *
+     * The default implementation invokes lemmatize() for each input. Lemmatizers that can
+     * analyze several sentences at once should reimplement this method.
+     */
+    virtual void lemmatizeBatch(const QStringList &inputs, QList<WordList> &l)
+    {
+        l.clear();
+
+        foreach (const QString &input, inputs) {
+            WordList words;
+            lemmatize(input, words);
+            l.append(words);
+        }
+    }
+
+    /**
+     * Returns true if the lemmatizer can be used from several threads at the same time.
+     * Otherwise; returns false. Calls to lemmatizers that are not thread-safe must be
+     * serialized.
+     *
+     * The default implementation returns false.
+     */
+    virtual bool isThreadSafe() const
+    {
+        return false;
+    }
 };
 
 /// @}
@@ -20,22 +20,181 @@
  */
 
 #include "lemmatizerfactory.h"
+#include "nlp-engine/lemmatable.h"
+#include "nlp-engine/tablelemmatizer.h"
+#include "nlp-engine/toolchain.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "common/version.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWeakPointer>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QtDebug>
 
 #ifdef FREELING_SUPPORT
 # include "nlp-engine/freelinglemmatizer.h"
+# include "nlp-engine/freelingresources.h"
+# include "nlp-engine/cachedlemmatizer.h"
+# include "nlp-engine/lemmatizerpool.h"
 #else
 # include "nlp-engine/nulllemmatizer.h"
 #endif
 
+#define LEMMA_TABLE_AUTO    "auto"
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+#ifdef FREELING_SUPPORT
+
+Lvk::Nlp::Lemmatizer *createFreelingLemmatizer(const QString &lang,
+                                               const Lvk::Nlp::AnalysisProfile &profile)
+{
+    return new Lvk::Nlp::FreelingLemmatizer(lang, profile);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Restores the results cached by previous runs of the lemmatizer of language lang, if enabled
+// in the application settings. Results are only valid for the same language, version of the
+// application, which ships the dictionaries, lemma table and analysis profile.
+Lvk::Nlp::Lemmatizer *persistentCache(Lvk::Nlp::CachedLemmatizer *lemmatizer, QString lang,
+                                      const Lvk::Nlp::AnalysisProfile &profile)
+{
+    Lvk::Cmn::SettingsSnapshot settings = Lvk::Cmn::SettingsSnapshot::current();
+
+    if (!settings.value(SETTING_NLP_LEMMA_CACHE_PERSIST).toBool()) {
+        return lemmatizer;
+    }
+
+    if (lang.isEmpty()) {
+        lang = Lvk::Nlp::Toolchain::defaultLanguage();
+    }
+
+    // Each profile has its own file, so switching profiles does not discard the other caches
+    QString suffix = profile.isFull() ? QString() : "_" + QString::number(profile.modules());
+    QString filename = settings.stringValue(SETTING_DATA_PATH) + "/lemmacache_" + lang + suffix
+            + ".dat";
+
+    QFileInfo table(settings.stringValue(SETTING_NLP_LEMMA_TABLE));
+
+    QString key = QString("%1|%2|%3|%4|%5").arg(lang, APP_VERSION_STR)
+            .arg(table.fileName())
+            .arg(table.exists() ? table.lastModified().toTime_t() : 0)
+            .arg(profile.toString());
+
+    lemmatizer->setPersistentFile(filename, key);
+
+    return lemmatizer;
+}
+
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+// Lemma tables in use, so lemmatizers created with the same file share one table
+typedef QHash<QString, QWeakPointer<const Lvk::Nlp::LemmaTable> > LemmaTableRegistry;
+
+QMutex s_tablesMutex;
+LemmaTableRegistry s_tables;
+
+//--------------------------------------------------------------------------------------------------
+
+// Loads the lemma table set in the application settings, if any. Returns a null pointer if
+// the setting is empty or the table cannot be loaded. A table file is built for the default
+// language, so it is never used for other languages. If the setting is LEMMA_TABLE_AUTO, the
+// table of each language is imported from its Freeling dictionary and cached next to it.
+QSharedPointer<const Lvk::Nlp::LemmaTable> loadLemmaTable(QString lang)
+{
+    Lvk::Cmn::SettingsSnapshot settings = Lvk::Cmn::SettingsSnapshot::current();
+
+    QString filename = settings.stringValue(SETTING_NLP_LEMMA_TABLE);
+    QString dictFilename;
+
+    if (filename == LEMMA_TABLE_AUTO) {
+        if (lang.isEmpty()) {
+            lang = Lvk::Nlp::Toolchain::defaultLanguage();
+        }
+        QString flDataPath = settings.stringValue(SETTING_DATA_PATH) + "/freeling/" + lang + "/";
+        dictFilename = flDataPath + "dicc.src";
+        filename = flDataPath + "dicc.lmt";
+    } else if (filename.isEmpty()
+            || (!lang.isEmpty() && lang != Lvk::Nlp::Toolchain::defaultLanguage())) {
+        return QSharedPointer<const Lvk::Nlp::LemmaTable>();
+    }
+
+    QMutexLocker locker(&s_tablesMutex);
+
+    QSharedPointer<const Lvk::Nlp::LemmaTable> cached = s_tables.value(filename).toStrongRef();
+
+    if (cached) {
+        return cached;
+    }
+
+    QSharedPointer<Lvk::Nlp::LemmaTable> table(new Lvk::Nlp::LemmaTable());
+
+    bool loaded = dictFilename.isEmpty() ? table->load(filename)
+                                         : table->loadCached(dictFilename, filename);
+    if (!loaded) {
+        qWarning() << "LemmatizerFactory: Cannot load lemma table" << filename;
+        return QSharedPointer<const Lvk::Nlp::LemmaTable>();
+    }
+
+    s_tables[filename] = table;
+
+    return table;
+}
+
+} // namespace
+
+
 //--------------------------------------------------------------------------------------------------
 // LemmatizerFactory
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::Lemmatizer *Lvk::Nlp::LemmatizerFactory::createLemmatizer()
+Lvk::Nlp::Lemmatizer *Lvk::Nlp::LemmatizerFactory::createLemmatizer(const QString &lang)
 {
+    return createLemmatizer(lang, AnalysisProfile::fromSettings());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Lemmatizer *Lvk::Nlp::LemmatizerFactory::createLemmatizer(const QString &lang,
+                                                                    const AnalysisProfile &profile)
+{
+    QSharedPointer<const LemmaTable> table = loadLemmaTable(lang);
+
 #ifdef FREELING_SUPPORT
-    return new FreelingLemmatizer();
+    Lemmatizer *freeling = new LemmatizerPool(createFreelingLemmatizer, lang, profile);
+
+    if (table) {
+        return persistentCache(new CachedLemmatizer(new TableLemmatizer(table, freeling)), lang,
+                               profile);
+    }
+    return persistentCache(new CachedLemmatizer(freeling), lang, profile);
 #else
+    Q_UNUSED(profile);
+
+    if (table) {
+        return new TableLemmatizer(table);
+    }
     return new NullLemmatizer();
 #endif
 }
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerFactory::preloadLemmatizer()
+{
+#ifdef FREELING_SUPPORT
+    FreelingResources::preload();
+#endif
+}
@@ -23,6 +23,7 @@
 #define LVK_NLP_LEMMATIZERFACTORY_H
 
 #include "nlp-engine/lemmatizer.h"
+#include "nlp-engine/analysisprofile.h"
 
 namespace Lvk
 {
@@ -45,9 +46,25 @@ class LemmatizerFactory
 {
 public:
     /**
-     * Creates a default lemmatizer.
+     * Creates a default lemmatizer for language \a lang. If \a lang is empty, the language in
+     * the application settings is used. The lemma table in the application settings is only
+     * used for that language. If the setting is "auto", each language uses a table imported
+     * from its Freeling dictionary on first use and cached next to it, see
+     * LemmaTable::loadCached(). The analysis profile is read from the application settings.
      */
-    Lemmatizer *createLemmatizer();
+    Lemmatizer *createLemmatizer(const QString &lang = QString());
+
+    /**
+     * Creates a default lemmatizer for language \a lang that runs the analysis modules of
+     * \a profile. Lemmatizers without morphological analysis ignore \a profile.
+     */
+    Lemmatizer *createLemmatizer(const QString &lang, const AnalysisProfile &profile);
+
+    /**
+     * Starts loading in background the data required by the default lemmatizer, so that
+     * the first call to createLemmatizer() does not have to wait for it.
+     */
+    void preloadLemmatizer();
 };
 
 /// @}
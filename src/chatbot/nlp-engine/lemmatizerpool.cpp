@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/lemmatizerpool.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThread>
+
+//--------------------------------------------------------------------------------------------------
+// LemmatizerPool::Lease
+//--------------------------------------------------------------------------------------------------
+
+// Checks out a lemmatizer from the pool during its lifetime
+class Lvk::Nlp::LemmatizerPool::Lease
+{
+public:
+    Lease(LemmatizerPool *pool) : m_pool(pool), m_lemmatizer(pool->checkout()) { }
+
+    ~Lease() { m_pool->checkin(m_lemmatizer); }
+
+    Lemmatizer *operator->() { return m_lemmatizer; }
+
+private:
+    LemmatizerPool *m_pool;
+    Lemmatizer *m_lemmatizer;
+};
+
+//--------------------------------------------------------------------------------------------------
+// LemmatizerPool
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmatizerPool::LemmatizerPool(Creator creator, int maxSize)
+    : m_creator(creator),
+      m_langCreator(0),
+      m_profileCreator(0),
+      m_maxSize(maxSize),
+      m_creating(0),
+      m_mutex(new QMutex()),
+      m_createMutex(new QMutex()),
+      m_available(new QWaitCondition())
+{
+    init();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmatizerPool::LemmatizerPool(LangCreator creator, const QString &lang, int maxSize)
+    : m_creator(0),
+      m_langCreator(creator),
+      m_profileCreator(0),
+      m_lang(lang),
+      m_maxSize(maxSize),
+      m_creating(0),
+      m_mutex(new QMutex()),
+      m_createMutex(new QMutex()),
+      m_available(new QWaitCondition())
+{
+    init();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmatizerPool::LemmatizerPool(ProfileCreator creator, const QString &lang,
+                                         const AnalysisProfile &profile, int maxSize)
+    : m_creator(0),
+      m_langCreator(0),
+      m_profileCreator(creator),
+      m_lang(lang),
+      m_profile(profile),
+      m_maxSize(maxSize),
+      m_creating(0),
+      m_mutex(new QMutex()),
+      m_createMutex(new QMutex()),
+      m_available(new QWaitCondition())
+{
+    init();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerPool::init()
+{
+    if (m_maxSize < 0) {
+        m_maxSize = Cmn::SettingsSnapshot::current().value(SETTING_NLP_LEMMA_POOL_SIZE).toInt();
+    }
+    if (m_maxSize <= 0) {
+        m_maxSize = QThread::idealThreadCount();
+    }
+    if (m_maxSize <= 0) {
+        m_maxSize = 1;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmatizerPool::~LemmatizerPool()
+{
+    qDeleteAll(m_all);
+
+    delete m_available;
+    delete m_createMutex;
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerPool::tokenize(const QString &input, QStringList &l)
+{
+    Lease(this)->tokenize(input, l);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerPool::lemmatize(const QString &input, Nlp::WordList &l)
+{
+    Lease(this)->lemmatize(input, l);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerPool::lemmatizeBatch(const QStringList &inputs, QList<Nlp::WordList> &l)
+{
+    Lease(this)->lemmatizeBatch(inputs, l);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::LemmatizerPool::isThreadSafe() const
+{
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::LemmatizerPool::size() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_all.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::LemmatizerPool::maxSize() const
+{
+    return m_maxSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Lemmatizer * Lvk::Nlp::LemmatizerPool::checkout()
+{
+    QMutexLocker locker(m_mutex);
+
+    while (m_free.isEmpty() && m_all.size() + m_creating >= m_maxSize) {
+        m_available->wait(m_mutex);
+    }
+
+    // Last checked in first, so the most recently used lemmatizer is reused
+    if (!m_free.isEmpty()) {
+        return m_free.takeLast();
+    }
+
+    // Lemmatizers can be expensive to create, so other threads are not blocked meanwhile.
+    // Creation itself is serialized since lemmatizers may not support concurrent construction.
+    ++m_creating;
+    locker.unlock();
+
+    Lemmatizer *lemmatizer = 0;
+
+    {
+        QMutexLocker createLocker(m_createMutex);
+        if (m_profileCreator) {
+            lemmatizer = m_profileCreator(m_lang, m_profile);
+        } else {
+            lemmatizer = m_langCreator ? m_langCreator(m_lang) : m_creator();
+        }
+    }
+
+    locker.relock();
+    --m_creating;
+    m_all.append(lemmatizer);
+
+    return lemmatizer;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerPool::checkin(Lemmatizer *lemmatizer)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_free.append(lemmatizer);
+    m_available->wakeOne();
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_LEMMATIZERPOOL_H
+#define LVK_NLP_LEMMATIZERPOOL_H
+
+#include "nlp-engine/lemmatizer.h"
+#include "nlp-engine/analysisprofile.h"
+
+#include <QList>
+#include <QString>
+
+class QMutex;
+class QWaitCondition;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The LemmatizerPool class provides a thread-safe Lemmatizer on top of a pool of
+ *        non-reentrant lemmatizers
+ *
+ * Lemmatizers such as FreelingLemmatizer are not reentrant, so a single instance serializes
+ * all threads. LemmatizerPool lazily creates up to maxSize() lemmatizers and each call checks
+ * out one of them for its exclusive use. If all lemmatizers are busy and the pool is full,
+ * the call waits until one is checked in.
+ *
+ * Lemmatizers are only created when there is contention, so with a single thread the pool
+ * holds just one lemmatizer.
+ */
+class LemmatizerPool : public Lemmatizer
+{
+public:
+
+    /**
+     * Function used to create lemmatizers
+     */
+    typedef Lemmatizer *(*Creator)();
+
+    /**
+     * Constructs a LemmatizerPool that creates up to \a maxSize lemmatizers with \a creator.
+     * If \a maxSize is negative, the size is read from the application settings. If the
+     * setting is not set, the ideal thread count is used.
+     */
+    LemmatizerPool(Creator creator, int maxSize = -1);
+
+    /**
+     * Function used to create lemmatizers of a given language
+     */
+    typedef Lemmatizer *(*LangCreator)(const QString &lang);
+
+    /**
+     * Constructs a LemmatizerPool that creates up to \a maxSize lemmatizers of language
+     * \a lang with \a creator. \a maxSize is handled as in the constructor above.
+     */
+    LemmatizerPool(LangCreator creator, const QString &lang, int maxSize = -1);
+
+    /**
+     * Function used to create lemmatizers of a given language and analysis profile
+     */
+    typedef Lemmatizer *(*ProfileCreator)(const QString &lang, const AnalysisProfile &profile);
+
+    /**
+     * Constructs a LemmatizerPool that creates up to \a maxSize lemmatizers of language
+     * \a lang and analysis profile \a profile with \a creator. \a maxSize is handled as in
+     * the first constructor.
+     */
+    LemmatizerPool(ProfileCreator creator, const QString &lang, const AnalysisProfile &profile,
+                   int maxSize = -1);
+
+    /**
+     * Destroys the object and all lemmatizers in the pool.
+     */
+    ~LemmatizerPool();
+
+    /**
+     * \copydoc Lemmatizer::tokenize(const QString &input, QStringList &l)
+     */
+    virtual void tokenize(const QString &input, QStringList &l);
+
+    /**
+     * \copydoc Lemmatizer::lemmatize(const QString &input, WordList &l)
+     */
+    virtual void lemmatize(const QString &input, WordList &l);
+
+    /**
+     * \copydoc Lemmatizer::lemmatizeBatch(const QStringList &, QList<WordList> &)
+     *
+     * The whole batch is analyzed by a single lemmatizer of the pool.
+     */
+    virtual void lemmatizeBatch(const QStringList &inputs, QList<WordList> &l);
+
+    /**
+     * Returns true.
+     */
+    virtual bool isThreadSafe() const;
+
+    /**
+     * Returns the amount of lemmatizers created so far
+     */
+    int size() const;
+
+    /**
+     * Returns the maximum amount of lemmatizers in the pool
+     */
+    int maxSize() const;
+
+private:
+    LemmatizerPool(const LemmatizerPool&);
+    LemmatizerPool & operator=(const LemmatizerPool&);
+
+    class Lease;
+    friend class Lease;
+
+    void init();
+    Lemmatizer *checkout();
+    void checkin(Lemmatizer *lemmatizer);
+
+    Creator m_creator;
+    LangCreator m_langCreator;
+    ProfileCreator m_profileCreator;
+    QString m_lang;
+    AnalysisProfile m_profile;
+    int m_maxSize;
+    int m_creating;
+    QList<Lemmatizer *> m_all;
+    QList<Lemmatizer *> m_free;
+    QMutex *m_mutex;
+    QMutex *m_createMutex;
+    QWaitCondition *m_available;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_LEMMATIZERPOOL_H
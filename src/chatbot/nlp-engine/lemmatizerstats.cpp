@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/lemmatizerstats.h"
+
+#include <QStringList>
+
+//--------------------------------------------------------------------------------------------------
+// LemmatizerStats
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::LemmatizerStats::LemmatizerStats()
+{
+    for (int i = 0; i < StageCount; ++i) {
+        m_totals[i] = 0;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerStats::record(Stage stage, qint64 nsecs)
+{
+    m_histograms[stage].record(nsecs / 1000);
+
+    QMutexLocker locker(&m_totalsMutex);
+    m_totals[stage] += nsecs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::LemmatizerStats::totalNsecs(Stage stage) const
+{
+    QMutexLocker locker(&m_totalsMutex);
+
+    return m_totals[stage];
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Nlp::LemmatizerStats::toVariantMap() const
+{
+    QVariantMap map;
+
+    for (int i = 0; i < StageCount; ++i) {
+        Stage s = static_cast<Stage>(i);
+        const LatencyHistogram &h = m_histograms[i];
+
+        QVariantMap stage;
+        stage["count"] = h.count();
+        stage["total"] = totalNsecs(s) / 1000;
+        stage["p50"] = h.percentile(50);
+        stage["p90"] = h.percentile(90);
+        stage["p99"] = h.percentile(99);
+        stage["max"] = h.max();
+
+        map[stageName(s)] = stage;
+    }
+
+    return map;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::LemmatizerStats::toString() const
+{
+    QStringList l;
+
+    for (int i = 0; i < StageCount; ++i) {
+        Stage s = static_cast<Stage>(i);
+        const LatencyHistogram &h = m_histograms[i];
+
+        l.append(QString("%1: count=%2 total=%3us p50=%4us p90=%5us p99=%6us max=%7us")
+                 .arg(stageName(s))
+                 .arg(h.count())
+                 .arg(totalNsecs(s) / 1000)
+                 .arg(h.percentile(50))
+                 .arg(h.percentile(90))
+                 .arg(h.percentile(99))
+                 .arg(h.max()));
+    }
+
+    return l.join("; ");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::LemmatizerStats::clear()
+{
+    QMutexLocker locker(&m_totalsMutex);
+
+    for (int i = 0; i < StageCount; ++i) {
+        m_histograms[i].clear();
+        m_totals[i] = 0;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::LemmatizerStats::stageName(Stage stage)
+{
+    switch (stage) {
+    case TotalStage:
+        return "total";
+    case PreSanitizeStage:
+        return "pre-sanitize";
+    case TokenizeStage:
+        return "tokenize";
+    case SplitStage:
+        return "split";
+    case AnalyzeStage:
+        return "analyze";
+    case ConvertStage:
+        return "convert";
+    case PostSanitizeStage:
+        return "post-sanitize";
+    default:
+        return "";
+    }
+}
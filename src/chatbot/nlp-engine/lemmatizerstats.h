@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_LEMMATIZERSTATS_H
+#define LVK_NLP_LEMMATIZERSTATS_H
+
+#include "nlp-engine/enginestats.h"
+
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The LemmatizerStats class provides latency histograms and accumulated time for each
+ *        stage of the FreelingLemmatizer
+ *
+ * This class is thread-safe.
+ */
+class LemmatizerStats
+{
+public:
+
+    /**
+     * Stages of a lemmatization
+     */
+    enum Stage
+    {
+        TotalStage,         ///< Whole call to tokenize, lemmatize or lemmatizeBatch
+        PreSanitizeStage,   ///< Pre-sanitization of the input
+        TokenizeStage,      ///< Freeling tokenizer
+        SplitStage,         ///< Freeling sentence splitter
+        AnalyzeStage,       ///< Freeling morphological analyzer
+        ConvertStage,       ///< Conversions between QString and std::string
+        PostSanitizeStage,  ///< Post-sanitization of the words
+        StageCount
+    };
+
+    /**
+     * Constructs an empty object
+     */
+    LemmatizerStats();
+
+    /**
+     * Records a duration of \a nsecs nanoseconds for \a stage. Histograms have microsecond
+     * resolution but the accumulated time keeps nanoseconds, so short stages still add up.
+     */
+    void record(Stage stage, qint64 nsecs);
+
+    /**
+     * Returns the histogram of \a stage
+     */
+    const LatencyHistogram & histogram(Stage stage) const
+    {
+        return m_histograms[stage];
+    }
+
+    /**
+     * Returns the accumulated duration of \a stage in nanoseconds
+     */
+    qint64 totalNsecs(Stage stage) const;
+
+    /**
+     * Returns a map with the name of each stage and a map with its count, total, p50, p90,
+     * p99 and max durations in microseconds
+     */
+    QVariantMap toVariantMap() const;
+
+    /**
+     * Returns the string representation of the object
+     */
+    QString toString() const;
+
+    /**
+     * Removes all durations
+     */
+    void clear();
+
+    /**
+     * Returns the name of \a stage
+     */
+    static QString stageName(Stage stage);
+
+private:
+    LemmatizerStats(const LemmatizerStats&);
+    LemmatizerStats & operator=(const LemmatizerStats&);
+
+    LatencyHistogram m_histograms[StageCount];
+    qint64 m_totals[StageCount];
+    mutable QMutex m_totalsMutex;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_LEMMATIZERSTATS_H
@@ -27,23 +27,30 @@
 // MatchPolicy
 //--------------------------------------------------------------------------------------------------
 
-float Lvk::Nlp::MatchPolicy::operator()(const Nlp::Node *node, const Nlp::Word &word)
+float Lvk::Nlp::MatchPolicy::operator()(const Nlp::Node *node, const Nlp::Word &word) const
 {
-    float weight = 0.0;
+    switch (node->type()) {
+    case Nlp::Node::WildcardType:
+        return WILDCARD_MATCH_WEIGHT;
 
-    if (node->is<Nlp::WildcardNode>()) {
-        weight = 0.001;
-    } else if (node->is<Nlp::VariableNode>()) {
-        weight = 0.001;
-    } else if (const Nlp::WordNode *wNode = node->to<Nlp::WordNode>()) {
-        if (wNode->word.origWord == word.origWord) {
-            weight = 1.0;
-        } else if (wNode->word.lemma.size() > 0) {
-            if (wNode->word.lemma == word.lemma) {
-                weight = 0.5;
-            }
+    case Nlp::Node::VariableType:
+        return VARIABLE_MATCH_WEIGHT;
+
+    case Nlp::Node::WordType: {
+        // Words are compared by their symbols. See Word::intern()
+        const Nlp::Word &nodeWord = node->to<Nlp::WordNode>()->word;
+
+        if (nodeWord.origWordId != Nlp::NullSymbol && nodeWord.origWordId == word.origWordId) {
+            return EXACT_MATCH_WEIGHT;
         }
+        if (matchLemmas() && nodeWord.lemmaId != Nlp::NullSymbol &&
+                nodeWord.lemmaId == word.lemmaId) {
+            return LEMMA_MATCH_WEIGHT;
+        }
+        return 0.0;
     }
 
-    return weight;
+    default:
+        return 0.0;
+    }
 }
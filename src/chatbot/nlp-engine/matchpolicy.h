@@ -26,6 +26,12 @@
 
 #include "nlp-engine/word.h"
 
+#define EXACT_MATCH_WEIGHT      1.0f
+#define LEMMA_MATCH_WEIGHT      0.5f
+#define FUZZY_MATCH_WEIGHT      0.25f
+#define WILDCARD_MATCH_WEIGHT   0.001f
+#define VARIABLE_MATCH_WEIGHT   0.001f
+
 namespace Lvk
 {
 
@@ -46,16 +52,80 @@ struct Node;
  * \brief The MatchPolicy class defines the matching policy to do a search on a Tree
  *
  * Given a Node \a n and a Word \a w, returns "how well" \a w mathes \a n
+ *
+ * The policy is selected when the tree is constructed. If lemmas are not compared, trees do not
+ * visit childs that only match by lemma. Likewise, trees only look for misspelled words if the
+ * mode is FuzzyMatch. See FuzzyIndex.
  */
 class MatchPolicy
 {
 public:
 
+    /**
+     * Matching modes
+     */
+    enum Mode
+    {
+        ExactMatch,     ///< Words only match the original word
+        LemmaMatch,     ///< Words match the original word or, with less weight, the lemma
+        FuzzyMatch      ///< Like LemmaMatch and, with even less weight, words within a small
+                        ///  edit distance
+    };
+
+    /**
+     * Constructs a match policy with \a mode
+     */
+    MatchPolicy(Mode mode = LemmaMatch)
+        : m_mode(mode) { }
+
+    /**
+     * Returns the matching mode
+     */
+    Mode mode() const
+    {
+        return m_mode;
+    }
+
+    /**
+     * Returns true if words can match by lemma. Otherwise; returns false.
+     */
+    bool matchLemmas() const
+    {
+        return m_mode != ExactMatch;
+    }
+
+    /**
+     * Returns true if words can match misspelled words. Otherwise; returns false.
+     */
+    bool matchFuzzy() const
+    {
+        return m_mode == FuzzyMatch;
+    }
+
+    /**
+     * Returns the weight of a word that matches a node word with edit \a distance greater than 0
+     */
+    float fuzzyWeight(int distance) const
+    {
+        return FUZZY_MATCH_WEIGHT / distance;
+    }
+
     /**
      * Returns the weight of the node \a n given the word \a w. The weight ranges from 0.0 to 1.0.
      * A zero weight means no match.
      */
-    float operator()(const Node *n, const Word &w);
+    float operator()(const Node *n, const Word &w) const;
+
+    /**
+     * Returns the maximum weight that operator() can return
+     */
+    float maxWeight() const
+    {
+        return EXACT_MATCH_WEIGHT;
+    }
+
+private:
+    Mode m_mode;
 };
 
 /// @}
@@ -10,6 +10,14 @@ HEADERS += \
     $$PROJECT_PATH/nlp-engine/nullsanitizer.h \
     $$PROJECT_PATH/nlp-engine/lemmatizer.h \
     $$PROJECT_PATH/nlp-engine/nulllemmatizer.h \
+    $$PROJECT_PATH/nlp-engine/cachedlemmatizer.h \
+    $$PROJECT_PATH/nlp-engine/responsecache.h \
+    $$PROJECT_PATH/nlp-engine/sessionstore.h \
+    $$PROJECT_PATH/nlp-engine/rulehits.h \
+    $$PROJECT_PATH/nlp-engine/lemmatizerpool.h \
+    $$PROJECT_PATH/nlp-engine/analysisprofile.h \
+    $$PROJECT_PATH/nlp-engine/lemmatable.h \
+    $$PROJECT_PATH/nlp-engine/tablelemmatizer.h \
     $$PROJECT_PATH/nlp-engine/rule.h \
     $$PROJECT_PATH/nlp-engine/engine.h \
     $$PROJECT_PATH/nlp-engine/lemmatizerfactory.h \
@@ -17,13 +25,22 @@ HEADERS += \
     $$PROJECT_PATH/nlp-engine/enginefactory.h \
     $$PROJECT_PATH/nlp-engine/nlpproperties.h \
     $$PROJECT_PATH/nlp-engine/cb2engine.h \
+    $$PROJECT_PATH/nlp-engine/shadowengine.h \
     $$PROJECT_PATH/nlp-engine/tree.h \
     $$PROJECT_PATH/nlp-engine/globaltools.h \
+    $$PROJECT_PATH/nlp-engine/toolchain.h \
     $$PROJECT_PATH/nlp-engine/scoringalgorithm.h \
     $$PROJECT_PATH/nlp-engine/matchpolicy.h \
+    $$PROJECT_PATH/nlp-engine/fuzzyindex.h \
+    $$PROJECT_PATH/nlp-engine/vectorindex.h \
     $$PROJECT_PATH/nlp-engine/word.h \
+    $$PROJECT_PATH/nlp-engine/inlinelist.h \
     $$PROJECT_PATH/nlp-engine/node.h \
+    $$PROJECT_PATH/nlp-engine/flattree.h \
     $$PROJECT_PATH/nlp-engine/result.h \
+    $$PROJECT_PATH/nlp-engine/ruleissue.h \
+    $$PROJECT_PATH/nlp-engine/rulecost.h \
+    $$PROJECT_PATH/nlp-engine/searchexplain.h \
     $$PROJECT_PATH/nlp-engine/condoutput.h \
     $$PROJECT_PATH/nlp-engine/varstack.h \
     $$PROJECT_PATH/nlp-engine/predicate.h \
@@ -33,31 +50,56 @@ HEADERS += \
     $$PROJECT_PATH/nlp-engine/syntax.h \
     $$PROJECT_PATH/nlp-engine/parser.h \
     $$PROJECT_PATH/nlp-engine/comparison.h \
-    $$PROJECT_PATH/nlp-engine/searchcontext.h
+    $$PROJECT_PATH/nlp-engine/searchcontext.h \
+    $$PROJECT_PATH/nlp-engine/symboltable.h \
+    $$PROJECT_PATH/nlp-engine/symbolsequence.h \
+    $$PROJECT_PATH/nlp-engine/outputtemplate.h \
+    $$PROJECT_PATH/nlp-engine/enginestats.h \
+    $$PROJECT_PATH/nlp-engine/lemmatizerstats.h
 
 SOURCES += \
     $$PROJECT_PATH/nlp-engine/defaultsanitizer.cpp \
     $$PROJECT_PATH/nlp-engine/lemmatizerfactory.cpp \
+    $$PROJECT_PATH/nlp-engine/cachedlemmatizer.cpp \
+    $$PROJECT_PATH/nlp-engine/responsecache.cpp \
+    $$PROJECT_PATH/nlp-engine/sessionstore.cpp \
+    $$PROJECT_PATH/nlp-engine/rulehits.cpp \
+    $$PROJECT_PATH/nlp-engine/lemmatizerpool.cpp \
+    $$PROJECT_PATH/nlp-engine/analysisprofile.cpp \
+    $$PROJECT_PATH/nlp-engine/lemmatable.cpp \
+    $$PROJECT_PATH/nlp-engine/tablelemmatizer.cpp \
     $$PROJECT_PATH/nlp-engine/sanitizerfactory.cpp \
     $$PROJECT_PATH/nlp-engine/enginefactory.cpp \
     $$PROJECT_PATH/nlp-engine/cb2engine.cpp \
+    $$PROJECT_PATH/nlp-engine/shadowengine.cpp \
     $$PROJECT_PATH/nlp-engine/tree.cpp \
+    $$PROJECT_PATH/nlp-engine/flattree.cpp \
     $$PROJECT_PATH/nlp-engine/globaltools.cpp \
+    $$PROJECT_PATH/nlp-engine/toolchain.cpp \
     $$PROJECT_PATH/nlp-engine/scoringalgorithm.cpp \
     $$PROJECT_PATH/nlp-engine/matchpolicy.cpp \
+    $$PROJECT_PATH/nlp-engine/fuzzyindex.cpp \
+    $$PROJECT_PATH/nlp-engine/vectorindex.cpp \
     $$PROJECT_PATH/nlp-engine/condoutput.cpp \
     $$PROJECT_PATH/nlp-engine/condoutputlist.cpp \
     $$PROJECT_PATH/nlp-engine/variable.cpp \
     $$PROJECT_PATH/nlp-engine/varstack.cpp \
-    $$PROJECT_PATH/nlp-engine/parser.cpp
+    $$PROJECT_PATH/nlp-engine/parser.cpp \
+    $$PROJECT_PATH/nlp-engine/symboltable.cpp \
+    $$PROJECT_PATH/nlp-engine/outputtemplate.cpp \
+    $$PROJECT_PATH/nlp-engine/enginestats.cpp \
+    $$PROJECT_PATH/nlp-engine/searchexplain.cpp \
+    $$PROJECT_PATH/nlp-engine/lemmatizerstats.cpp
 
 
 freeling {
     HEADERS += \
-        $$PROJECT_PATH/nlp-engine/freelinglemmatizer.h
+        $$PROJECT_PATH/nlp-engine/freelinglemmatizer.h \
+        $$PROJECT_PATH/nlp-engine/freelingresources.h
 
     SOURCES += \
-        $$PROJECT_PATH/nlp-engine/freelinglemmatizer.cpp
+        $$PROJECT_PATH/nlp-engine/freelinglemmatizer.cpp \
+        $$PROJECT_PATH/nlp-engine/freelingresources.cpp
 }
 
 
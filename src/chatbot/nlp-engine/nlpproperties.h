@@ -25,5 +25,25 @@
 
 #define NLP_PROP_EXACT_MATCH        "ExactMatch"    // Enable exact match support
 #define NLP_PROP_PREFER_CUR_TOPIC   "PrefCurTopic"  // Prefer rules on current topic
+#define NLP_PROP_LEMMA_MATCH        "LemmaMatch"    // Match words by lemma
+#define NLP_PROP_FUZZY_MATCH        "FuzzyMatch"    // Match misspelled words
+#define NLP_PROP_STATS              "Stats"         // Latency stats (read) or reset them (write)
+#define NLP_PROP_MAX_RECURSION      "MaxRecursion"  // Max nested searches depth, -1 no limit
+#define NLP_PROP_MAX_RECURSION_TIME "MaxRecursionTime" // Max msecs for nested searches, 0 no limit
+#define NLP_PROP_MAX_SEARCH_STEPS   "MaxSearchSteps" // Max nodes visited by a search, 0 no limit
+#define NLP_PROP_MIN_SIMILARITY     "MinSimilarity" // Min similarity of the fallback, 0 disabled
+#define NLP_PROP_BEST_EFFORT        "BestEffort"    // Keep results of searches past the deadline
+#define NLP_PROP_MINIMIZE_TREE      "MinimizeTree"  // Share equal subtrees of the compiled rules
+#define NLP_PROP_MEMORY             "Memory"        // Memory report of compiled rules (read only)
+#define NLP_PROP_ASYNC_RELOAD       "AsyncReload"   // Rebuild rules in background
+#define NLP_PROP_RULES_VERSION      "RulesVersion"  // Version of the rules in use (read only)
+#define NLP_PROP_LANGUAGE           "Language"      // Language of the NLP tools (read only)
+#define NLP_PROP_RESPONSE_CACHE_SIZE "ResponseCacheSize" // Max cached responses, 0 disabled
+#define NLP_PROP_SPLIT_SENTENCES    "SplitSentences" // Match each sentence of the input apart
+#define NLP_PROP_RULE_HITS          "RuleHits"      // Hits of each rule (read), a map restores
+                                                    // them, any other value resets them (write)
+#define NLP_PROP_SHADOW_STATS       "ShadowStats"   // Comparisons with the shadow engine (read)
+                                                    // or reset them (write)
+#define NLP_PROP_WARM_UP            "WarmUp"        // Parse inputs in background (write only)
 
 #endif // _NLPPROPERTIES_H
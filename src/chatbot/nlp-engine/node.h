@@ -30,6 +30,8 @@
 #include <QString>
 #include <QDebug>
 #include <QHash>
+#include <QMultiHash>
+#include <QtAlgorithms>
 
 namespace Lvk
 {
@@ -49,6 +51,27 @@ namespace Nlp
  */
 typedef QHash<quint64, CondOutputList> OutputMap;
 
+/**
+ * \brief Parsed outputs of each rule. Output maps of the nodes of a rule hold copies that share
+ *        the same data.
+ */
+typedef QHash<RuleId, CondOutputList> RuleOutputsMap;
+
+/**
+ * Returns the bits of symbol \a id in a token filter. Returns 0 if \a id is NullSymbol.
+ * \see Node::tokenFilter
+ */
+inline quint64 tokenFilterBits(SymbolId id)
+{
+    if (id == NullSymbol) {
+        return 0;
+    }
+
+    quint32 h = id * 0x9e3779b1u; // Fibonacci hashing, two bits per symbol
+
+    return (Q_UINT64_C(1) << (h >> 26)) | (Q_UINT64_C(1) << ((h >> 20) & 63));
+}
+
 /**
  * \brief The Node class provides a node of a Tree
  *
@@ -60,15 +83,42 @@ class Node
 {
 public:
 
+    /**
+     * Node types. Each subclass of Node has its own type.
+     */
+    enum Type
+    {
+        GenericType,    ///< Node
+        WordType,       ///< WordNode
+        WildcardType,   ///< WildcardNode
+        VariableType    ///< VariableNode
+    };
+
+    static const Type StaticType = GenericType; ///< The type of the class
+
     /**
      * Constructs a Node object with \a parent
      */
     Node(Node *parent = 0)
-        : parent(parent), m_useCount(0) { }
+        : parent(parent), tokenFilter(~Q_UINT64_C(0)), requiresToken(false),
+          m_type(GenericType), m_useCount(0) { }
 
     Node *parent;           ///< The node's parent
     OutputMap omap;         ///< The node's output map
 
+    /**
+     * Bloom filter of the original word and lemma symbols of the word nodes of the subtree,
+     * including this node. Built by Tree before searching. \see tokenFilterBits()
+     */
+    quint64 tokenFilter;
+
+    /**
+     * True if every output of the subtree is reached through at least one word node, so the
+     * subtree can only match inputs with some word in tokenFilter. Built by Tree before
+     * searching.
+     */
+    bool requiresToken;
+
     /**
      * Returns a reference to the list of childs.
      * Warning: Do not append childs to that list. To append new childs use appendChild()
@@ -89,10 +139,32 @@ public:
     /**
      * Appends a child \a node
      */
-    void appendChild(Node *node)
+    void appendChild(Node *node);
+
+    /**
+     * Replaces the list of childs with \a childs. Previous childs not being used anymore are
+     * destroyed.
+     */
+    void setChilds(const QList<Node *> &childs);
+
+    /**
+     * Returns the indexes in childs() of the childs that can match \a word sorted in ascending
+     * order. WordNode childs can match only if they have the same original word or, if
+     * \a matchLemmas is true, the same lemma than \a word. Childs of any other type can always
+     * match.
+     *
+     * Word childs are indexed by original word and lemma symbols, so this method does not need
+     * to visit all childs. Words must be interned or looked up before. \see Word::intern()
+     */
+    QList<int> matchingChilds(const Word &word, bool matchLemmas = true) const;
+
+    /**
+     * Returns the indexes in childs() of the WordNode childs with original word symbol
+     * \a origWordId
+     */
+    QList<int> wordChilds(SymbolId origWordId) const
     {
-        m_childs.append(node);
-        ++node->m_useCount;
+        return m_origWordIndex.values(origWordId);
     }
 
     /**
@@ -103,13 +175,24 @@ public:
         return "Node()";
     }
 
+    /**
+     * Returns the node type
+     */
+    Type type() const
+    {
+        return m_type;
+    }
+
     /**
      * Returns true if \a this is of type T
+     *
+     * This method is called for each edge visited in a search, so it checks the node type
+     * instead of using RTTI.
      */
     template<class T>
     bool is() const
     {
-        return dynamic_cast<const T *>(this) != 0;
+        return T::StaticType == GenericType || m_type == T::StaticType;
     }
 
     /**
@@ -118,7 +201,7 @@ public:
     template<class T>
     T * to()
     {
-        return dynamic_cast<T *>(this);
+        return is<T>() ? static_cast<T *>(this) : 0;
     }
 
     /**
@@ -127,7 +210,7 @@ public:
     template<class T>
     const T * to() const
     {
-        return dynamic_cast<const T *>(this);
+        return is<T>() ? static_cast<const T *>(this) : 0;
     }
 
     /**
@@ -136,19 +219,33 @@ public:
     virtual ~Node()
     {
         foreach (Node *child, m_childs) {
-            --child->m_useCount;
-            if (child->m_useCount == 0 && child != this) {
-                delete child;
-            }
+            releaseChild(child);
         }
     }
 
+protected:
+
+    /**
+     * Constructs a Node object of type \a type with \a parent
+     */
+    Node(Type type, Node *parent)
+        : parent(parent), tokenFilter(~Q_UINT64_C(0)), requiresToken(false),
+          m_type(type), m_useCount(0) { }
+
 private:
     Node(const Node&);
     Node& operator=(const Node&);
 
+    typedef QMultiHash<SymbolId, int> ChildIndex;
+
+    Type m_type;
     int m_useCount;
     QList<Node *> m_childs;
+    ChildIndex m_origWordIndex;  // original word -> child index
+    ChildIndex m_lemmaIndex;     // lemma -> child index
+    QList<int> m_nonWordChilds;  // indexes of childs that are not word nodes
+
+    void releaseChild(Node *child);
 };
 
 /**
@@ -162,7 +259,9 @@ public:
      * Constructs a WordNode object with word \a w and \a parent
      */
     WordNode(const Word &w = Word(), Node *parent = 0)
-        : Node(parent), word(w) { }
+        : Node(WordType, parent), word(w) { }
+
+    static const Type StaticType = WordType; ///< The type of the class
 
     Word word; ///< The word information
 
@@ -186,14 +285,14 @@ public:
      * Constructs a WildcarNode object with range [min,max] \a parent
      */
     WildcardNode(int min = 0, int max = 0, Node *parent = 0)
-        : Node(parent), min(min), max(max) { }
+        : Node(WildcardType, parent), min(min), max(max) { }
 
     /**
      * Constructs a WildcarNode from string \a wc with \a parent. \wc must be the string
      * representation of a wildcard operator such as STAR_OP or PLUS_OP
      */
     WildcardNode(const QString &wc, Node *parent = 0)
-        : Node(parent), min(0), max(0)
+        : Node(WildcardType, parent), min(0), max(0)
     {
         if (wc == STAR_OP) {
             min = 0;
@@ -204,6 +303,8 @@ public:
         }
     }
 
+    static const Type StaticType = WildcardType; ///< The type of the class
+
     int min; ///< The minimun amount of ocurrences
     int max; ///< The maximun amount of ocurrences. -1 means infinite.
 
@@ -228,7 +329,9 @@ public:
      * Constructs a VariableNode object with variable name \a varName and \a parent
      */
     VariableNode(const QString &varName = QString(), Node *parent = 0)
-        : Node(parent), varName(varName) { }
+        : Node(VariableType, parent), varName(varName) { }
+
+    static const Type StaticType = VariableType; ///< The type of the class
 
     QString varName; ///< The variable name
 
@@ -242,6 +345,90 @@ public:
 };
 
 
+//--------------------------------------------------------------------------------------------------
+
+inline void Node::appendChild(Node *node)
+{
+    int i = m_childs.size();
+
+    m_childs.append(node);
+    ++node->m_useCount;
+
+    if (const WordNode *wNode = node->to<WordNode>()) {
+        if (wNode->word.origWordId != NullSymbol) {
+            m_origWordIndex.insert(wNode->word.origWordId, i);
+        }
+        if (wNode->word.lemmaId != NullSymbol) {
+            m_lemmaIndex.insert(wNode->word.lemmaId, i);
+        }
+    } else {
+        m_nonWordChilds.append(i);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void Node::setChilds(const QList<Node *> &childs)
+{
+    QList<Node *> prevChilds = m_childs;
+
+    m_childs.clear();
+    m_origWordIndex.clear();
+    m_lemmaIndex.clear();
+    m_nonWordChilds.clear();
+
+    foreach (Node *child, childs) {
+        appendChild(child);
+    }
+
+    foreach (Node *child, prevChilds) {
+        releaseChild(child);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Drops one use of child. Wildcard and variable nodes use themselves because of their loop,
+// so a child is destroyed if it is only used by its own loop.
+inline void Node::releaseChild(Node *child)
+{
+    --child->m_useCount;
+
+    if (child != this && child->m_useCount == (child->m_childs.contains(child) ? 1 : 0)) {
+        delete child;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QList<int> Node::matchingChilds(const Word &word, bool matchLemmas /*= true*/) const
+{
+    QList<int> l = m_nonWordChilds;
+
+    if (word.origWordId != NullSymbol) {
+        l.append(m_origWordIndex.values(word.origWordId));
+    }
+
+    if (matchLemmas && word.lemmaId != NullSymbol) {
+        l.append(m_lemmaIndex.values(word.lemmaId));
+    }
+
+    if (l.size() > 1) {
+        qSort(l);
+
+        // Remove childs with the same original word and lemma
+        for (int i = l.size() - 1; i > 0; --i) {
+            if (l[i] == l[i - 1]) {
+                l.removeAt(i);
+            }
+        }
+    }
+
+    return l;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 /**
  * \brief This method adds support to print debug information of Node objects
  */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/outputtemplate.h"
+#include "nlp-engine/parser.h"
+
+//--------------------------------------------------------------------------------------------------
+// OutputTemplate
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::OutputTemplate::OutputTemplate(const QString &output)
+    : m_raw(output), m_hasVariables(false)
+{
+    Nlp::Parser &parser = Nlp::Parser::threadParser();
+
+    QString varName;
+    int offset = 0;
+    int i = 0;
+    bool recursive = false;
+
+    while (true) {
+        i = parser.parseVariable(output, &varName, &recursive, offset);
+        if (i != -1) {
+            if (recursive) {
+                i--;  // Skip the 'r'
+            }
+
+            m_segments.append(Segment(output.mid(offset, i - offset), varName, recursive));
+            m_hasVariables = true;
+
+            offset =  i + varName.size() + (recursive ? 3 : 2);
+        } else {
+            m_segments.append(Segment(output.mid(offset)));
+            break;
+        }
+    }
+}
+
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_OUTPUTTEMPLATE_H
+#define LVK_NLP_OUTPUTTEMPLATE_H
+
+#include <QString>
+#include <QList>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The OutputTemplate class provides a rule output already split in literal text and
+ *        variables
+ *
+ * Outputs are compiled once when rules are loaded, thus expanding variables at match time does
+ * not require to parse the output again. For instance, the output "Hi [name], r[greeting]" is
+ * split in: literal "Hi " and variable "name", literal ", " and recursive variable "greeting".
+ */
+class OutputTemplate
+{
+public:
+
+    /**
+     * The Segment class provides a piece of literal text optionally followed by a variable
+     */
+    class Segment
+    {
+    public:
+        Segment(const QString &text = QString(), const QString &varName = QString(),
+                bool recursive = false)
+            : text(text), varName(varName), recursive(recursive) { }
+
+        QString text;       ///< Literal text
+        QString varName;    ///< Variable name. Empty if there is no variable
+        bool recursive;     ///< True if the variable is recursive, i.e. r[varName]
+    };
+
+    /**
+     * Constructs an OutputTemplate object from string \a output
+     */
+    OutputTemplate(const QString &output = QString());
+
+    /**
+     * Returns the output string used to construct the object
+     */
+    const QString &rawString() const
+    {
+        return m_raw;
+    }
+
+    /**
+     * Returns true if the output contains variables. Otherwise; returns false.
+     */
+    bool hasVariables() const
+    {
+        return m_hasVariables;
+    }
+
+    /**
+     * Returns the list of segments
+     */
+    const QList<Segment> &segments() const
+    {
+        return m_segments;
+    }
+
+private:
+    QString m_raw;
+    QList<Segment> m_segments;
+    bool m_hasVariables;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_OUTPUTTEMPLATE_H
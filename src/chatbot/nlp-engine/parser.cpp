@@ -21,9 +21,11 @@
 
 #include "nlp-engine/parser.h"
 #include "nlp-engine/syntax.h"
+#include "common/trace.h"
 
 #include <QObject>
 #include <QDebug>
+#include <QThreadStorage>
 
 //--------------------------------------------------------------------------------------------------
 // Helpers
@@ -38,6 +40,10 @@ Lvk::Nlp::Comparison<T1, T2> * make_comp(const T1 &t1, const T2 &t2, Lvk::Nlp::C
     return new Lvk::Nlp::Comparison<T1, T2>(t1, t2, op);
 }
 
+//--------------------------------------------------------------------------------------------------
+
+QThreadStorage<Lvk::Nlp::Parser *> threadParsers;
+
 } // namespace
 
 
@@ -52,6 +58,17 @@ Lvk::Nlp::Parser::Parser()
 
 //--------------------------------------------------------------------------------------------------
 
+Lvk::Nlp::Parser & Lvk::Nlp::Parser::threadParser()
+{
+    if (!threadParsers.hasLocalData()) {
+        threadParsers.setLocalData(new Nlp::Parser());
+    }
+
+    return *threadParsers.localData();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void Lvk::Nlp::Parser::initRegexps()
 {
     m_varRegex = QRegExp(VAR_DECL_REGEX);
@@ -73,7 +90,7 @@ int Lvk::Nlp::Parser::parseVariable(const QString &s, QString *varName, bool *re
     int i = m_varRegex.indexIn(s, offset);
 
     if (i != -1) {
-        qDebug() << "Parsed var" << m_ifRegex.cap(1);
+        LVK_TRACE(Parser) << "Parsed var" << m_varRegex.cap(1);
 
         if (varName) {
             *varName = m_varRegex.cap(1).trimmed();
@@ -93,8 +110,8 @@ int Lvk::Nlp::Parser::parseIf(const QString &s, Nlp::Predicate **pred, QString *
     int i = m_ifRegex.indexIn(s, offset);
 
     if (i != -1) {
-        qDebug() << "Parsed if" << m_ifRegex.cap(1)  << m_ifRegex.cap(2)
-                 << m_ifRegex.cap(3) << m_ifRegex.cap(4);
+        LVK_TRACE(Parser) << "Parsed if" << m_ifRegex.cap(1)  << m_ifRegex.cap(2)
+                          << m_ifRegex.cap(3) << m_ifRegex.cap(4);
 
         if (pred) {
             *pred = parsePredicate(m_ifRegex.cap(1).trimmed(),
@@ -117,7 +134,7 @@ int Lvk::Nlp::Parser::parseElse(const QString &s, QString *body, int offset)
     int i = m_elseRegex.indexIn(s, offset);
 
     if (i != -1) {
-        qDebug() << "Parsed else" << m_ifRegex.cap(1);
+        LVK_TRACE(Parser) << "Parsed else" << m_ifRegex.cap(1);
 
         if (body) {
             *body = m_elseRegex.cap(1).trimmed();
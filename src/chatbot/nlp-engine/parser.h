@@ -52,6 +52,13 @@ public:
      */
     Parser();
 
+    /**
+     * Returns the parser of the calling thread. Constructing a parser is expensive since it
+     * compiles several regexps, and parsers are not reentrant. Hence each thread should reuse
+     * its own parser.
+     */
+    static Parser &threadParser();
+
     /**
      * Parses string \a s starting from position \a offset searching for a variable declaration.
      * If the declaration is found, it returns the index position of the  declaration
@@ -23,6 +23,7 @@
 
 #include <functional>
 #include <QString>
+#include <QStringList>
 
 #include "nlp-engine/varstack.h"
 
@@ -39,6 +40,86 @@ namespace Nlp
 /// \addtogroup Nlp
 /// @{
 
+/**
+ * Comparison types
+ */
+// TODO consider using functors
+enum CompType
+{
+    Equal,
+    Less,
+    Greater,
+    LessOrEqual,
+    GreaterOrEqual,
+    NotEqual
+};
+
+/**
+ * Returns true if the result \a cmp of a three-way comparison, i.e. negative, zero or positive,
+ * satisfies \a type. Otherwise; returns false.
+ */
+inline bool compResult(CompType type, int cmp)
+{
+    switch (type) {
+    case Equal:
+        return cmp == 0;
+    case Less:
+        return cmp < 0;
+    case Greater:
+        return cmp > 0;
+    case LessOrEqual:
+        return cmp <= 0;
+    case GreaterOrEqual:
+        return cmp >= 0;
+    case NotEqual:
+        return cmp != 0;
+    default:
+        return false;
+    }
+}
+
+/**
+ * \brief The PredicateOperand struct provides an operand of a compiled predicate
+ *
+ * Literals are parsed when the predicate is compiled. Variables are referenced by slot, an
+ * index in the list of variable names of the compiled code.
+ */
+struct PredicateOperand
+{
+    PredicateOperand() : slot(-1), num(0), isNum(false) { }
+
+    int slot;       ///< The variable slot or -1 if the operand is a literal
+    QString str;    ///< The case folded literal
+    int num;        ///< The literal as integer, only valid if isNum is true
+    bool isNum;     ///< True if the literal is an integer
+};
+
+/**
+ * \brief The CompiledPredicate struct provides a predicate compiled to a flat instruction
+ *
+ * \see CondOutput
+ */
+struct CompiledPredicate
+{
+    /**
+     * Instruction opcodes
+     */
+    enum Opcode
+    {
+        AlwaysTrue,     ///< The predicate is always satisfied
+        AlwaysFalse,    ///< The predicate is never satisfied
+        Compare,        ///< Compares op1 with op2 using comp
+        Call            ///< The predicate cannot be compiled, Predicate::eval() is called
+    };
+
+    CompiledPredicate() : opcode(Call), comp(Equal) { }
+
+    Opcode opcode;          ///< The instruction opcode
+    CompType comp;          ///< The comparison type if opcode is Compare
+    PredicateOperand op1;   ///< The first operand if opcode is Compare
+    PredicateOperand op2;   ///< The second operand if opcode is Compare
+};
+
 /**
  * \brief The Predicate class provides the interface for all predicates
  */
@@ -55,6 +136,16 @@ public:
      * Returns \a true if the predicate is satisfied; \a false otherwise.
      */
     virtual bool eval(const Nlp::VarStack &varStack) const = 0;
+
+    /**
+     * Compiles the predicate into \a code. Variables are given the slot of their name in
+     * \a varNames, names not found are appended. Returns false if the predicate cannot be
+     * compiled. By default returns false.
+     */
+    virtual bool compile(Nlp::CompiledPredicate &/*code*/, QStringList &/*varNames*/) const
+    {
+        return false;
+    }
 };
 
 
@@ -72,6 +163,15 @@ public:
     {
         return true;
     }
+
+    /**
+     * \copydoc Predicate::compile()
+     */
+    virtual bool compile(Nlp::CompiledPredicate &code, QStringList &/*varNames*/) const
+    {
+        code.opcode = Nlp::CompiledPredicate::AlwaysTrue;
+        return true;
+    }
 };
 
 
@@ -89,6 +189,15 @@ public:
     {
         return false;
     }
+
+    /**
+     * \copydoc Predicate::compile()
+     */
+    virtual bool compile(Nlp::CompiledPredicate &code, QStringList &/*varNames*/) const
+    {
+        code.opcode = Nlp::CompiledPredicate::AlwaysFalse;
+        return true;
+    }
 };
 
 /// @}
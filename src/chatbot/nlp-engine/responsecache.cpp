@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "nlp-engine/responsecache.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#define RESPONSE_CACHE_ENTRY_BYTES  160     // Estimated size of an entry with a short key
+
+//--------------------------------------------------------------------------------------------------
+// ResponseCache
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::ResponseCache::ResponseCache(int maxSize)
+    : m_version(0),
+      m_mutex(new QMutex())
+{
+    if (maxSize < 0) {
+        maxSize = Cmn::SettingsSnapshot::current().value(SETTING_NLP_RESPONSE_CACHE_SIZE).toInt();
+    }
+
+    m_cache.setMaxCost(qMax(0, maxSize));
+
+    Cmn::MemoryManager::manager()->add(this, "responseCache", Cmn::MemoryManager::CachePriority);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::ResponseCache::~ResponseCache()
+{
+    Cmn::MemoryManager::manager()->remove(this);
+
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::ResponseCache::key(const QString &input, const QString &target, int topic)
+{
+    // Fields are separated by a control char that users cannot type
+    return input.simplified() + QChar(0x1f) + target + QChar(0x1f) + QString::number(topic);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void Lvk::Nlp::ResponseCache::checkVersion(quint32 version)
+{
+    if (version != m_version) {
+        m_cache.clear();
+        m_version = version;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::ResponseCache::find(const QString &key, quint32 version, Entry &entry)
+{
+    QMutexLocker locker(m_mutex);
+
+    checkVersion(version);
+
+    if (const Entry *cached = m_cache.object(key)) {
+        entry = *cached;
+        return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ResponseCache::insert(const QString &key, quint32 version, const Entry &entry)
+{
+    QMutexLocker locker(m_mutex);
+
+    checkVersion(version);
+
+    if (m_cache.maxCost() > 0) {
+        m_cache.insert(key, new Entry(entry));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::ResponseCache::size() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_cache.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::ResponseCache::maxSize() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_cache.maxCost();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ResponseCache::setMaxSize(int maxSize)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_cache.setMaxCost(qMax(0, maxSize));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ResponseCache::clear()
+{
+    QMutexLocker locker(m_mutex);
+
+    m_cache.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::ResponseCache::memoryUsage() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return (qint64)m_cache.size()*RESPONSE_CACHE_ENTRY_BYTES;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::ResponseCache::releaseMemory(qint64 bytes)
+{
+    QMutexLocker locker(m_mutex);
+
+    int size = m_cache.size();
+    int maxSize = m_cache.maxCost();
+    int evict = (int)qMin((qint64)size,
+                          (bytes + RESPONSE_CACHE_ENTRY_BYTES - 1)/RESPONSE_CACHE_ENTRY_BYTES);
+
+    // Lowering the max cost evicts the least recently used entries
+    m_cache.setMaxCost(size - evict);
+    m_cache.setMaxCost(maxSize);
+
+    return (qint64)(size - m_cache.size())*RESPONSE_CACHE_ENTRY_BYTES;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_RESPONSECACHE_H
+#define LVK_NLP_RESPONSECACHE_H
+
+#include "nlp-engine/rule.h"
+#include "common/memorymanager.h"
+
+#include <QCache>
+#include <QString>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The ResponseCache class provides a LRU cache of the winning rule of searches
+ *
+ * Chat traffic is very repetitive, greetings and one-word replies are sent again and again.
+ * If the winning rule of a search has constant outputs, the same input always gets the same
+ * rule, so the search can be skipped. Entries keep the winning rule and input, not the output
+ * text, so sequential and random outputs keep rotating.
+ *
+ * Entries are keyed by input, target and current topic, and are valid for one version of the
+ * rules only. Looking up or inserting with a different version discards all entries.
+ *
+ * The cache is a consumer of the MemoryManager, which evicts the least recently used entries
+ * under memory pressure.
+ *
+ * This class is thread-safe.
+ *
+ * \see Tree::hasConstantOutput(), Tree::getRuleResponse()
+ */
+class ResponseCache : public Cmn::MemoryConsumer
+{
+public:
+
+    /**
+     * \brief The Entry struct provides the winning rule input of a search
+     */
+    struct Entry
+    {
+        Entry(RuleId ruleId = 0, int inputIdx = 0, float score = 0)
+            : ruleId(ruleId), inputIdx(inputIdx), score(score) { }
+
+        RuleId ruleId;
+        int inputIdx;
+        float score;
+    };
+
+    /**
+     * Constructs a ResponseCache that holds up to \a maxSize entries. If \a maxSize is
+     * negative, the size is read from the application settings. 0 disables the cache.
+     */
+    ResponseCache(int maxSize = -1);
+
+    /**
+     * Destroys the object.
+     */
+    ~ResponseCache();
+
+    /**
+     * Returns the key for \a input, \a target and \a topic. Inputs that only differ in
+     * whitespace get the same key.
+     */
+    static QString key(const QString &input, const QString &target, int topic);
+
+    /**
+     * Finds the entry with \a key for rules \a version. Returns true if found. Otherwise;
+     * returns false.
+     */
+    bool find(const QString &key, quint32 version, Entry &entry);
+
+    /**
+     * Inserts \a entry with \a key for rules \a version.
+     */
+    void insert(const QString &key, quint32 version, const Entry &entry);
+
+    /**
+     * Returns the amount of entries in the cache
+     */
+    int size() const;
+
+    /**
+     * Returns the maximum amount of entries in the cache
+     */
+    int maxSize() const;
+
+    /**
+     * Sets the maximum amount of entries in the cache. 0 disables the cache.
+     */
+    void setMaxSize(int maxSize);
+
+    /**
+     * Removes all entries.
+     */
+    void clear();
+
+    /**
+     * \copydoc Cmn::MemoryConsumer::memoryUsage()
+     */
+    virtual qint64 memoryUsage() const;
+
+    /**
+     * \copydoc Cmn::MemoryConsumer::releaseMemory()
+     *
+     * The least recently used entries are evicted first.
+     */
+    virtual qint64 releaseMemory(qint64 bytes);
+
+private:
+    ResponseCache(const ResponseCache&);
+    ResponseCache & operator=(const ResponseCache&);
+
+    QCache<QString, Entry> m_cache;
+    quint32 m_version;
+    QMutex *m_mutex;
+
+    void checkVersion(quint32 version);
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_RESPONSECACHE_H
@@ -23,6 +23,7 @@
 #define LVK_NLP_RESULT_H
 
 #include "nlp-engine/rule.h"
+#include "nlp-engine/inlinelist.h"
 
 #include <QString>
 #include <QList>
@@ -51,12 +52,14 @@ public:
      * and \a score
      */
     Result(const QString &output = "", RuleId ruleId = 0, int inputIdx = 0, float score = 0)
-        : output(output), ruleId(ruleId), inputIdx(inputIdx), score(score) { }
+        : output(output), ruleId(ruleId), inputIdx(inputIdx), score(score), rulesVersion(0) { }
 
     QString output; ///< The output string without expanding variables
     RuleId ruleId;  ///< The original rule ID
     int inputIdx;   ///< The input index of the rule
     float score;    ///< The matching score
+    QString topic;  ///< The topic of the rule. Only set by engines
+    quint32 rulesVersion; ///< The version of the rules that were searched. Only set by engines
 
     /**
      * Returns true if the score of \a this is less than the score of \a other.
@@ -70,7 +73,7 @@ public:
     /**
      * Returns true if the result is null. Otherwise; returns false.
      */
-    bool isNull()
+    bool isNull() const
     {
         return output.isEmpty() && !ruleId && !inputIdx && !score;
     }
@@ -78,7 +81,7 @@ public:
     /**
      * Returns true if the result is *not* null. Otherwise; returns false.
      */
-    bool isValid()
+    bool isValid() const
     {
         return !isNull();
     }
@@ -92,6 +95,8 @@ public:
         ruleId = 0;
         inputIdx = 0;
         score = 0;
+        topic.clear();
+        rulesVersion = 0;
     }
 };
 
@@ -108,9 +113,9 @@ inline QDebug& operator<<(QDebug& dbg, const Result &r)
 
 
 /**
- * The ResultList class provides a list of Result's
+ * The ResultList class provides a list of Result's. Up to 8 results are stored inline.
  */
-typedef QList<Result> ResultList;
+typedef InlineList<Result, 8> ResultList;
 
 /// @}
 
@@ -120,6 +125,8 @@ typedef QList<Result> ResultList;
 
 } // namespace Lvk
 
+Q_DECLARE_TYPEINFO(Lvk::Nlp::Result, Q_MOVABLE_TYPE);
+
 
 #endif // LVK_NLP_RESULT_H
 
@@ -76,6 +76,21 @@ public:
     Rule(RuleId id, const QStringList &input, const QStringList &output, const QStringList &target)
         : m_id(id), m_input(input), m_output(output), m_target(target), m_random(false) {}
 
+    /**
+     * Returns true if \a other has the same ID and attributes. Otherwise; returns false.
+     */
+    bool operator==(const Rule &other) const
+    {
+        return m_id == other.m_id && m_input == other.m_input && m_output == other.m_output
+                && m_target == other.m_target && m_topic == other.m_topic
+                && m_nextTopic == other.m_nextTopic && m_random == other.m_random;
+    }
+
+    /**
+     * Returns true if \a other is different to this rule. Otherwise; returns false.
+     */
+    bool operator!=(const Rule &other) const { return !operator==(other); }
+
     /**
      * Returns the rule ID, by default 0.
      */
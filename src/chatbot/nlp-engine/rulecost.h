@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_RULECOST_H
+#define LVK_NLP_RULECOST_H
+
+#include "nlp-engine/rule.h"
+
+#include <QList>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The RuleCost class provides the compile cost of a rule found by Engine::profileRules()
+ *
+ * Nodes and edges are only counted if the rule created them. Rules that share a prefix with
+ * rules added before reuse their nodes, so the first rule of the prefix pays for them.
+ */
+class RuleCost
+{
+public:
+
+    /**
+     * Constructs a RuleCost object for the rule \a ruleId with all costs set to zero
+     */
+    RuleCost(RuleId ruleId = 0)
+        : ruleId(ruleId), inputs(0), words(0), lemmatizeUsecs(0), buildUsecs(0), nodes(0),
+          omapEntries(0), wildcardEdges(0) { }
+
+    RuleId ruleId;          ///< The rule ID
+    int inputs;             ///< The amount of rule inputs added to the tree
+    int words;              ///< The amount of words of all inputs once parsed
+    qint64 lemmatizeUsecs;  ///< The time spent lemmatizing the rule inputs
+    qint64 buildUsecs;      ///< The time spent adding the rule to the tree
+    int nodes;              ///< The amount of nodes created
+    int omapEntries;        ///< The amount of output map entries added
+    int wildcardEdges;      ///< The amount of loop edges of wildcards and variables plus the
+                            ///< edges that skip a star
+
+    /**
+     * Returns the amount of nodes and edges created by the rule
+     */
+    int size() const { return nodes + wildcardEdges + omapEntries; }
+
+    /**
+     * Returns the total time spent compiling the rule
+     */
+    qint64 usecs() const { return lemmatizeUsecs + buildUsecs; }
+
+    /**
+     * Returns true if \a this instance is equal to \a other
+     */
+    bool operator==(const RuleCost &other) const
+    {
+        return ruleId == other.ruleId && inputs == other.inputs && words == other.words
+                && lemmatizeUsecs == other.lemmatizeUsecs && buildUsecs == other.buildUsecs
+                && nodes == other.nodes && omapEntries == other.omapEntries
+                && wildcardEdges == other.wildcardEdges;
+    }
+
+    /**
+     * Returns true if \a this instance is *not* equal to \a other
+     */
+    bool operator!=(const RuleCost &other) const
+    {
+        return !operator==(other);
+    }
+};
+
+
+/**
+ * The RuleCostList class provides a list of RuleCost's
+ */
+typedef QList<RuleCost> RuleCostList;
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_RULECOST_H
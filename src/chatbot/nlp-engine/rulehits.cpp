@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "nlp-engine/rulehits.h"
+
+//--------------------------------------------------------------------------------------------------
+// RuleHits
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::RuleHits::RuleHits()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::RuleHits::setRules(const RuleList &rules)
+{
+    QHash<RuleId, QAtomicInt> counters;
+    counters.reserve(rules.size());
+
+    foreach (const Rule &rule, rules) {
+        counters.insert(rule.id(), QAtomicInt(hits(rule.id())));
+    }
+
+    m_hits.swap(counters);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::RuleHits::addRule(RuleId ruleId)
+{
+    if (!m_hits.contains(ruleId)) {
+        m_hits.insert(ruleId, QAtomicInt(0));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::RuleHits::removeRule(RuleId ruleId)
+{
+    m_hits.remove(ruleId);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::RuleHits::record(RuleId ruleId) const
+{
+    // constFind() never detaches the hash, so this is safe while other threads read it
+    QHash<RuleId, QAtomicInt>::const_iterator it = m_hits.constFind(ruleId);
+
+    if (it != m_hits.constEnd()) {
+        const_cast<QAtomicInt &>(*it).fetchAndAddRelaxed(1);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::RuleHits::hits(RuleId ruleId) const
+{
+    QHash<RuleId, QAtomicInt>::const_iterator it = m_hits.constFind(ruleId);
+
+    return it != m_hits.constEnd() ? (int)*it : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Nlp::RuleHits::toVariantMap() const
+{
+    QVariantMap map;
+
+    for (QHash<RuleId, QAtomicInt>::const_iterator it = m_hits.constBegin();
+         it != m_hits.constEnd(); ++it) {
+        map.insert(QString::number(it.key()), (int)*it);
+    }
+
+    return map;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::RuleHits::setHits(const QVariantMap &map)
+{
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+        QHash<RuleId, QAtomicInt>::iterator hit = m_hits.find(it.key().toULongLong());
+
+        if (hit != m_hits.end()) {
+            *hit = it.value().toInt();
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::RuleHits::reset()
+{
+    for (QHash<RuleId, QAtomicInt>::iterator it = m_hits.begin(); it != m_hits.end(); ++it) {
+        *it = 0;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::RuleHits::clear()
+{
+    m_hits.clear();
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_RULEHITS_H
+#define LVK_NLP_RULEHITS_H
+
+#include "nlp-engine/rule.h"
+
+#include <QHash>
+#include <QAtomicInt>
+#include <QVariantMap>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The RuleHits class counts how many times each rule answered
+ *
+ * Counters are created when rules are set or added, so counting a hit is a lookup and a
+ * relaxed atomic increment. Rules that were never hit have a zero counter, which makes dead
+ * rules visible.
+ *
+ * record() and toVariantMap() can be called from several threads simultaneously. Methods that
+ * change the set of rules cannot run at the same time as any other method, the engine calls
+ * them while holding its write lock.
+ */
+class RuleHits
+{
+public:
+
+    /**
+     * Constructs an object without rules
+     */
+    RuleHits();
+
+    /**
+     * Sets the counted rules to \a rules. Rules that were already counted keep their hits.
+     */
+    void setRules(const RuleList &rules);
+
+    /**
+     * Adds a counter for the rule with ID \a ruleId, if it does not have one
+     */
+    void addRule(RuleId ruleId);
+
+    /**
+     * Removes the counter of the rule with ID \a ruleId
+     */
+    void removeRule(RuleId ruleId);
+
+    /**
+     * Counts a hit of the rule with ID \a ruleId. Rules without counter are ignored.
+     */
+    void record(RuleId ruleId) const;
+
+    /**
+     * Returns the hits of the rule with ID \a ruleId
+     */
+    int hits(RuleId ruleId) const;
+
+    /**
+     * Returns a map with the hits of every rule. Keys are rule IDs as strings.
+     */
+    QVariantMap toVariantMap() const;
+
+    /**
+     * Sets the hits of the rules in \a map, usually saved with toVariantMap(). Rules not in
+     * \a map keep their hits.
+     */
+    void setHits(const QVariantMap &map);
+
+    /**
+     * Sets the hits of every rule to zero
+     */
+    void reset();
+
+    /**
+     * Removes all counters
+     */
+    void clear();
+
+private:
+    RuleHits(const RuleHits&);
+    RuleHits & operator=(const RuleHits&);
+
+    QHash<RuleId, QAtomicInt> m_hits;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_RULEHITS_H
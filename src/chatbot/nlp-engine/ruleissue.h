@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_RULEISSUE_H
+#define LVK_NLP_RULEISSUE_H
+
+#include "nlp-engine/rule.h"
+
+#include <QList>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The RuleIssue class provides a problem found in a rule input by Engine::lintRules()
+ */
+class RuleIssue
+{
+public:
+
+    /**
+     * Rule issue types
+     */
+    enum Type
+    {
+        EmptyInput,         ///< The input is empty once parsed, so it never matches
+        DuplicatedInput,    ///< Another input matches the same sentences and takes precedence
+        ShadowedByWildcard  ///< A wildcard input matches the same sentences and takes precedence
+    };
+
+    /**
+     * Constructs a RuleIssue object of \a type for the input \a inputIdx of the rule
+     * \a ruleId. If the issue involves another rule, \a otherRuleId and \a otherInputIdx are
+     * the rule and input that take precedence.
+     */
+    RuleIssue(Type type = EmptyInput, RuleId ruleId = 0, int inputIdx = 0,
+              RuleId otherRuleId = 0, int otherInputIdx = 0)
+        : type(type), ruleId(ruleId), inputIdx(inputIdx), otherRuleId(otherRuleId),
+          otherInputIdx(otherInputIdx) { }
+
+    Type type;          ///< The issue type
+    RuleId ruleId;      ///< The rule ID
+    int inputIdx;       ///< The input index of the rule
+    RuleId otherRuleId; ///< The rule ID that takes precedence. 0 if there is no such rule.
+    int otherInputIdx;  ///< The input index of the rule that takes precedence
+
+    /**
+     * Returns true if \a this instance is equal to \a other
+     */
+    bool operator==(const RuleIssue &other) const
+    {
+        return type == other.type && ruleId == other.ruleId && inputIdx == other.inputIdx
+                && otherRuleId == other.otherRuleId && otherInputIdx == other.otherInputIdx;
+    }
+
+    /**
+     * Returns true if \a this instance is *not* equal to \a other
+     */
+    bool operator!=(const RuleIssue &other) const
+    {
+        return !operator==(other);
+    }
+};
+
+
+/**
+ * The RuleIssueList class provides a list of RuleIssue's
+ */
+typedef QList<RuleIssue> RuleIssueList;
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_RULEISSUE_H
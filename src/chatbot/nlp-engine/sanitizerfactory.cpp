@@ -21,23 +21,26 @@
 
 #include "sanitizerfactory.h"
 #include "defaultsanitizer.h"
+#include "toolchain.h"
 
 //--------------------------------------------------------------------------------------------------
 // SanitizerFactory
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::Sanitizer * Lvk::Nlp::SanitizerFactory::createPreSanitizer()
+Lvk::Nlp::Sanitizer * Lvk::Nlp::SanitizerFactory::createPreSanitizer(const QString &lang)
 {
     return new DefaultSanitizer(DefaultSanitizer::RemoveDupChars /*|
                                 DefaultSanitizer::RemoveBraces |
-                                DefaultSanitizer::RemoveDoubleQuotes */);
+                                DefaultSanitizer::RemoveDoubleQuotes */,
+                                lang.isEmpty() ? Toolchain::defaultLanguage() : lang);
 }
 
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::Sanitizer * Lvk::Nlp::SanitizerFactory::createPostSanitizer()
+Lvk::Nlp::Sanitizer * Lvk::Nlp::SanitizerFactory::createPostSanitizer(const QString &lang)
 {
     return new DefaultSanitizer(DefaultSanitizer::RemoveDiacritic |
                                 DefaultSanitizer::LowerCase /*|
-                                DefaultSanitizer::RemovePunctuation*/);
+                                DefaultSanitizer::RemovePunctuation*/,
+                                lang.isEmpty() ? Toolchain::defaultLanguage() : lang);
 }
@@ -45,14 +45,16 @@ class SanitizerFactory
 public:
 
     /**
-     * Creates a sanitizer used to sanitize strings before lemmatization
+     * Creates a sanitizer used to sanitize strings of language \a lang before lemmatization.
+     * If \a lang is empty, the default language is assumed.
      */
-    Sanitizer *createPreSanitizer();
+    Sanitizer *createPreSanitizer(const QString &lang = QString());
 
     /**
-     * Creates a sanitizer used to sanitize strings after lemmatization
+     * Creates a sanitizer used to sanitize strings of language \a lang after lemmatization.
+     * If \a lang is empty, the default language is assumed.
      */
-    Sanitizer *createPostSanitizer();
+    Sanitizer *createPostSanitizer(const QString &lang = QString());
 };
 
 /// @}
@@ -33,27 +33,11 @@ Lvk::Nlp::ScoringAlgorithm::ScoringAlgorithm()
 
 void Lvk::Nlp::ScoringAlgorithm::updateScore(int tokenIndex, float weight)
 {
-    for (int i = m_weights.size(); i <= tokenIndex; ++i) {
-        m_weights.append(0);
+    // Tokens without weight do not change the sum
+    while (m_sums.size() < tokenIndex) {
+        m_sums.append(currentScore());
     }
 
-    m_weights[tokenIndex] = weight;
-
-    for (int i = tokenIndex + 1; i < m_weights.size(); ++i) {
-        m_weights[i] = 0;
-    }
+    m_sums.resize(tokenIndex + 1);
+    m_sums[tokenIndex] = (tokenIndex > 0 ? m_sums[tokenIndex - 1] : 0) + weight;
 }
-
-//--------------------------------------------------------------------------------------------------
-
-float Lvk::Nlp::ScoringAlgorithm::currentScore()
-{
-    float score = 0;
-
-    foreach (float w, m_weights) {
-        score += w;
-    }
-
-    return score;
-}
-
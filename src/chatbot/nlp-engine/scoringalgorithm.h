@@ -22,7 +22,7 @@
 #ifndef LVK_NLP_SCORINGALGORITHM_H
 #define LVK_NLP_SCORINGALGORITHM_H
 
-#include <QList>
+#include <QVarLengthArray>
 
 namespace Lvk
 {
@@ -39,18 +39,32 @@ namespace Nlp
 
 /**
  * \brief The ScoringAlgorithm class provides the algorithm to calculate the score a sentence match
+ *
+ * The score is the sum of the weights of all matched tokens. Since this class is updated for
+ * each edge visited in a search, it keeps the running sums in a buffer indexed by token that
+ * does not allocate memory unless the input is very long.
  */
 class ScoringAlgorithm
 {
 public:
     ScoringAlgorithm();
 
+    /**
+     * Sets the weight of the token \a tokenIndex to \a weight. The weights of the following
+     * tokens are discarded.
+     */
     void updateScore(int tokenIndex, float weight);
 
-    float currentScore();
+    /**
+     * Returns the current score
+     */
+    float currentScore() const
+    {
+        return m_sums.isEmpty() ? 0 : m_sums[m_sums.size() - 1];
+    }
 
 private:
-    QList<float> m_weights;
+    QVarLengthArray<float, 32> m_sums; // m_sums[i] is the sum of the weights 0..i
 };
 
 /// @}
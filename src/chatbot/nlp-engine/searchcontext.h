@@ -24,8 +24,20 @@
 
 #include "nlp-engine/scoringalgorithm.h"
 #include "nlp-engine/varstack.h"
+#include "nlp-engine/enginestats.h"
+#include "nlp-engine/result.h"
+#include "nlp-engine/fuzzyindex.h"
 
 #include <QList>
+#include <QVector>
+#include <QSet>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QElapsedTimer>
+#include <QFutureInterface>
+
+#define REQUEST_POLL_MASK   0xff    // Requests are polled once every REQUEST_POLL_MASK + 1 steps
 
 namespace Lvk
 {
@@ -36,6 +48,10 @@ namespace Lvk
 namespace Nlp
 {
 
+class Node;
+class Tree;
+class SearchExplain;
+
 /// \ingroup Lvk
 /// \addtogroup Nlp
 /// @{
@@ -46,20 +62,81 @@ namespace Nlp
  * The SearchContext class is used internally by the Tree class. Before starting a DFS search
  * it pushes a context, when the search finishes pops it. During recursive searches several
  * context are pushed and poped.
+ *
+ * A SearchContext holds all the mutable state of a search, hence it must not be shared between
+ * threads. Each thread searching a Tree must provide its own SearchContext.
  */
 class SearchContext
 {
 public:
-    void push()
+    /**
+     * Constructs a search context. If \a stats is not null, searches record the duration of
+     * each stage in it.
+     */
+    SearchContext(Nlp::EngineStats *stats = 0)
+        : m_stats(stats), m_target(Nlp::NullSymbol), m_maxDepth(-1), m_maxMsecs(0),
+          m_maxSteps(0), m_steps(0), m_abortReason(NotAborted), m_bestEffort(false),
+          m_request(0), m_requestClock(0), m_deadline(0), m_nestedSearches(0), m_memoHits(0),
+          m_minSimilarity(0), m_explain(0), m_tokenFilter(true) { }
+
+    /**
+     * Reasons to abort a search. \see abortReason()
+     */
+    enum AbortReason
+    {
+        NotAborted,             ///< The search was not aborted
+        StepBudgetExceeded,     ///< The search exceeded the step budget
+        RequestCanceled,        ///< The request of the search was canceled
+        DeadlineExceeded        ///< The request of the search missed its deadline
+    };
+
+
+    /**
+     * LoopDetector provides a set of pairs (node, offset) currently being visited
+     */
+    typedef QSet< QPair<const Nlp::Node*, int> > LoopDetector;
+
+    /**
+     * VisitedStates provides, for each pair (node, offset) visited in a bounded context, the
+     * variable stacks the pair was reached with and the best score reached with each of them
+     */
+    typedef QHash< QPair<const Nlp::Node*, int>, QList< QPair<Nlp::VarStack, float> > >
+        VisitedStates;
+
+    /**
+     * ExpansionMemo provides, for each pair (tree, input) searched by a recursive variable, the
+     * result found
+     */
+    typedef QHash< QPair<const Nlp::Tree*, QString>, Nlp::Result > ExpansionMemo;
+
+    /**
+     * Pushes a new context. If \a bounded is true, the search only looks for the best result
+     * and prunes branches that cannot beat the best score found so far.
+     */
+    void push(bool bounded = false)
     {
+        if (m_scores.isEmpty()) {
+            m_timer.start();
+            m_steps = 0;
+            m_abortReason = NotAborted;
+        }
+
         m_scores.append(Nlp::ScoringAlgorithm());
         m_stacks.append(Nlp::VarStack());
+        m_bestScores.append(bounded ? 0 : -1);
+        m_visited.append(VisitedStates());
+        m_fuzzyCandidates.append(QList<FuzzyCandidateList>());
+        m_tokenMasks.append(QVector<quint64>());
     }
 
     void pop()
     {
         m_scores.removeLast();
         m_stacks.removeLast();
+        m_bestScores.removeLast();
+        m_visited.removeLast();
+        m_fuzzyCandidates.removeLast();
+        m_tokenMasks.removeLast();
     }
 
     Nlp::ScoringAlgorithm & score()
@@ -77,9 +154,368 @@ public:
         return m_scores.isEmpty();
     }
 
+    /**
+     * Returns the amount of contexts pushed
+     */
+    int depth() const
+    {
+        return m_scores.size();
+    }
+
+    /**
+     * Returns the stats where durations are recorded or null if there are none
+     */
+    Nlp::EngineStats * stats() const
+    {
+        return m_stats;
+    }
+
+    /**
+     * Returns true if the current context is bounded. \see push()
+     */
+    bool isBounded() const
+    {
+        return m_bestScores.last() >= 0;
+    }
+
+    /**
+     * Returns the best score found so far in a bounded context
+     */
+    float bestScore() const
+    {
+        return m_bestScores.last();
+    }
+
+    /**
+     * Sets the best score found so far in a bounded context
+     */
+    void setBestScore(float score)
+    {
+        m_bestScores.last() = score;
+    }
+
+    /**
+     * Records that the current bounded context reached \a node at \a offset with \a score and
+     * the current variable stack. Returns false if the same state was already reached with a
+     * score greater or equal than \a score. In that case, the subtree search from that state
+     * cannot beat the results already found and it can be safely skipped.
+     */
+    bool visit(const Nlp::Node *node, int offset, float score)
+    {
+        QList< QPair<Nlp::VarStack, float> > &states = m_visited.last()[qMakePair(node, offset)];
+
+        for (int i = 0; i < states.size(); ++i) {
+            if (states[i].first == m_stacks.last()) {
+                if (states[i].second >= score) {
+                    return false;
+                }
+                states[i].second = score;
+                return true;
+            }
+        }
+
+        states.append(qMakePair(m_stacks.last(), score));
+        return true;
+    }
+
+    /**
+     * Sets the misspelled word candidates of each word of the input of the current context.
+     * \see FuzzyIndex
+     */
+    void setFuzzyCandidates(const QList<FuzzyCandidateList> &candidates)
+    {
+        m_fuzzyCandidates.last() = candidates;
+    }
+
+    /**
+     * Returns the misspelled word candidates of the input word at \a offset of the current
+     * context. Returns an empty list if there are none.
+     */
+    const FuzzyCandidateList & fuzzyCandidates(int offset) const
+    {
+        static const FuzzyCandidateList empty;
+
+        const QList<FuzzyCandidateList> &candidates = m_fuzzyCandidates.last();
+
+        return offset >= 0 && offset < candidates.size() ? candidates[offset] : empty;
+    }
+
+    /**
+     * Sets the token filter \a masks of the input of the current context. The mask at each
+     * offset contains the symbols of the words and misspelled word candidates from that offset
+     * to the end of the input. \see Node::tokenFilter
+     */
+    void setTokenMasks(const QVector<quint64> &masks)
+    {
+        m_tokenMasks.last() = masks;
+    }
+
+    /**
+     * Returns the token filter mask of the input of the current context from \a offset to the
+     * end. If there are no masks, returns a mask with all bits set.
+     */
+    quint64 tokenMask(int offset) const
+    {
+        const QVector<quint64> &masks = m_tokenMasks.last();
+
+        return offset >= 0 && offset < masks.size() ? masks[offset] : ~Q_UINT64_C(0);
+    }
+
+    /**
+     * Sets whether searches skip the subtrees that need words not found in the input. By
+     * default is true. Disabling it does not change the results, only the nodes visited.
+     */
+    void setTokenFilter(bool enabled)
+    {
+        m_tokenFilter = enabled;
+    }
+
+    /**
+     * Returns true if searches skip the subtrees that need words not found in the input.
+     * Otherwise; returns false. \see setTokenFilter()
+     */
+    bool hasTokenFilter() const
+    {
+        return m_tokenFilter;
+    }
+
+    /**
+     * Sets the \a target of the search. Searches only get outputs of rules with \a target.
+     * NullSymbol, the default, only gets outputs of rules without targets.
+     */
+    void setTarget(Nlp::SymbolId target)
+    {
+        m_target = target;
+    }
+
+    /**
+     * Returns the target of the search. \see setTarget()
+     */
+    Nlp::SymbolId target() const
+    {
+        return m_target;
+    }
+
+    LoopDetector & loopDetector()
+    {
+        return m_loopDetector;
+    }
+
+    /**
+     * Returns the results of recursive variables found so far
+     */
+    ExpansionMemo & memo()
+    {
+        return m_memo;
+    }
+
+    /**
+     * Sets the budget for recursive variables. Nested searches are not started if \a maxDepth
+     * contexts are already pushed or if the outermost search started more than \a maxMsecs
+     * milliseconds ago. A negative \a maxDepth or a \a maxMsecs equal to zero means no limit.
+     */
+    void setBudget(int maxDepth, qint64 maxMsecs)
+    {
+        m_maxDepth = maxDepth;
+        m_maxMsecs = maxMsecs;
+    }
+
+    /**
+     * Returns true if a new nested search exceeds the budget. Otherwise; returns false.
+     * \see setBudget()
+     */
+    bool isOverBudget() const
+    {
+        return m_abortReason != NotAborted
+                || (m_maxDepth >= 0 && depth() >= m_maxDepth)
+                || (m_maxMsecs > 0 && m_timer.isValid() && m_timer.elapsed() > m_maxMsecs);
+    }
+
+    /**
+     * Sets the maximum amount of nodes the outermost search and all its nested searches can
+     * visit. Once exceeded, the search is aborted. A \a maxSteps equal to zero means no limit.
+     */
+    void setStepBudget(int maxSteps)
+    {
+        m_maxSteps = maxSteps;
+    }
+
+    /**
+     * Sets the minimum cosine similarity, between 0 and 1, a rule input must have with the user
+     * input to be used when the search finds nothing. A \a minSimilarity equal to zero disables
+     * the fallback. \see VectorIndex
+     */
+    void setMinSimilarity(float minSimilarity)
+    {
+        m_minSimilarity = minSimilarity;
+    }
+
+    /**
+     * Returns the minimum similarity of the fallback. \see setMinSimilarity()
+     */
+    float minSimilarity() const
+    {
+        return m_minSimilarity;
+    }
+
+    /**
+     * Sets the asynchronous request that started the search. The search is aborted once
+     * \a request is canceled or, if \a deadline is greater than zero, once \a clock exceeds
+     * \a deadline milliseconds. \a request and \a clock must outlive the search.
+     */
+    void setRequest(const QFutureInterfaceBase *request, const QElapsedTimer *clock,
+                    qint64 deadline)
+    {
+        m_request = request;
+        m_requestClock = clock;
+        m_deadline = deadline;
+    }
+
+    /**
+     * Counts a visited node. Returns false if the search exceeded the step budget, or its
+     * request was canceled or missed the deadline, and must stop. Otherwise; returns true.
+     * \see setStepBudget(), setRequest()
+     */
+    bool step()
+    {
+        ++m_steps;
+
+        if (m_abortReason != NotAborted) {
+            return false;
+        }
+
+        if (m_maxSteps > 0 && m_steps > m_maxSteps) {
+            m_abortReason = StepBudgetExceeded;
+        } else if (m_requestClock && (m_steps & REQUEST_POLL_MASK) == 0) {
+            if (m_request && m_request->isCanceled()) {
+                m_abortReason = RequestCanceled;
+            } else if (m_deadline > 0 && m_requestClock->elapsed() > m_deadline) {
+                m_abortReason = DeadlineExceeded;
+            }
+        }
+
+        return m_abortReason == NotAborted;
+    }
+
+    /**
+     * Returns the amount of nodes visited by the outermost search so far
+     */
+    int steps() const
+    {
+        return m_steps;
+    }
+
+    /**
+     * Returns true if the outermost search exceeded the step budget, or its request was
+     * canceled or missed the deadline. Results found by an aborted search are incomplete and
+     * must be discarded, unless the search missed the deadline and isBestEffort() is true.
+     */
+    bool isAborted() const
+    {
+        return m_abortReason != NotAborted;
+    }
+
+    /**
+     * Returns why the outermost search was aborted or NotAborted if it was not
+     */
+    AbortReason abortReason() const
+    {
+        return m_abortReason;
+    }
+
+    /**
+     * Sets whether a search that misses the deadline of its request keeps the results found
+     * so far. By default is false and the results are discarded. \see setRequest()
+     */
+    void setBestEffort(bool bestEffort)
+    {
+        m_bestEffort = bestEffort;
+    }
+
+    /**
+     * Returns true if a search that misses its deadline keeps the results found so far.
+     * Otherwise; returns false. \see setBestEffort()
+     */
+    bool isBestEffort() const
+    {
+        return m_bestEffort;
+    }
+
+    /**
+     * Counts a nested search started by a recursive variable
+     */
+    void countNestedSearch()
+    {
+        ++m_nestedSearches;
+    }
+
+    /**
+     * Returns the amount of nested searches started by recursive variables
+     */
+    int nestedSearches() const
+    {
+        return m_nestedSearches;
+    }
+
+    /**
+     * Counts a recursive variable resolved with the memo
+     */
+    void countMemoHit()
+    {
+        ++m_memoHits;
+    }
+
+    /**
+     * Returns the amount of recursive variables resolved with the memo
+     */
+    int memoHits() const
+    {
+        return m_memoHits;
+    }
+
+    /**
+     * Sets \a explain as the object where searches count what they do. Null, the default,
+     * disables counting. \a explain must outlive the search.
+     */
+    void setExplain(Nlp::SearchExplain *explain)
+    {
+        m_explain = explain;
+    }
+
+    /**
+     * Returns the object where searches count what they do or null if there is none
+     */
+    Nlp::SearchExplain * explain() const
+    {
+        return m_explain;
+    }
+
 private:
     QList<Nlp::ScoringAlgorithm> m_scores;
     QList<Nlp::VarStack> m_stacks;
+    QList<float> m_bestScores;  // -1 if not bounded
+    QList<VisitedStates> m_visited;
+    QList< QList<FuzzyCandidateList> > m_fuzzyCandidates;
+    QList< QVector<quint64> > m_tokenMasks;
+    LoopDetector m_loopDetector;
+    ExpansionMemo m_memo;
+    Nlp::EngineStats *m_stats;
+    Nlp::SymbolId m_target;
+    QElapsedTimer m_timer;
+    int m_maxDepth;
+    qint64 m_maxMsecs;
+    int m_maxSteps;
+    int m_steps;
+    AbortReason m_abortReason;
+    bool m_bestEffort;
+    const QFutureInterfaceBase *m_request;
+    const QElapsedTimer *m_requestClock;
+    qint64 m_deadline;
+    int m_nestedSearches;
+    int m_memoHits;
+    float m_minSimilarity;
+    Nlp::SearchExplain *m_explain;
+    bool m_tokenFilter;
 };
 
 /// @}
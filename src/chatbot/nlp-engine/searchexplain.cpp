@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "nlp-engine/searchexplain.h"
+#include "nlp-engine/node.h"
+
+#include <QVariantList>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+QVariantMap resultMap(const Lvk::Nlp::Result &result)
+{
+    QVariantMap map;
+    map["ruleId"] = result.ruleId;
+    map["inputIdx"] = result.inputIdx;
+    map["score"] = result.score;
+    map["output"] = result.output;
+
+    return map;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// SearchExplain
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SearchExplain::SearchExplain()
+    : searches(0), steps(0), wordEdges(0), wildcardEdges(0), variableEdges(0), filteredEdges(0),
+      terminalNodes(0), outputsEvaluated(0), nestedSearches(0), memoHits(0), literalHits(0),
+      aborted(false)
+{
+    for (int i = 0; i < EngineStats::StageCount; ++i) {
+        stageUsecs[i] = 0;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::SearchExplain::countEdge(const Nlp::Node *node)
+{
+    if (node->is<Nlp::WildcardNode>()) {
+        ++wildcardEdges;
+    } else if (node->is<Nlp::VariableNode>()) {
+        ++variableEdges;
+    } else {
+        ++wordEdges;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Nlp::SearchExplain::toVariantMap() const
+{
+    QVariantMap usecs;
+
+    for (int i = 0; i < EngineStats::StageCount; ++i) {
+        usecs[EngineStats::stageName(static_cast<EngineStats::Stage>(i))] = stageUsecs[i];
+    }
+
+    QVariantList candidateList;
+
+    for (int i = 0; i < candidates.size(); ++i) {
+        candidateList.append(resultMap(candidates[i]));
+    }
+
+    QVariantMap map;
+    map["searches"] = searches;
+    map["steps"] = steps;
+    map["wordEdges"] = wordEdges;
+    map["wildcardEdges"] = wildcardEdges;
+    map["variableEdges"] = variableEdges;
+    map["filteredEdges"] = filteredEdges;
+    map["terminalNodes"] = terminalNodes;
+    map["outputsEvaluated"] = outputsEvaluated;
+    map["nestedSearches"] = nestedSearches;
+    map["memoHits"] = memoHits;
+    map["literalHits"] = literalHits;
+    map["aborted"] = aborted;
+    map["usecs"] = usecs;
+    map["result"] = resultMap(result);
+    map["candidates"] = candidateList;
+
+    return map;
+}
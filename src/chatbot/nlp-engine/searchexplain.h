@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_SEARCHEXPLAIN_H
+#define LVK_NLP_SEARCHEXPLAIN_H
+
+#include "nlp-engine/enginestats.h"
+#include "nlp-engine/result.h"
+
+#include <QVariantMap>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+class Node;
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The SearchExplain class provides what a search did to find the response of a single
+ *        input, as returned by Engine::explainResponse()
+ *
+ * Searches only fill it if it is set in their SearchContext, otherwise the counters cost a
+ * null check. Counters include nested searches started by recursive variables. Times only
+ * include the outermost searches.
+ */
+class SearchExplain
+{
+public:
+
+    /**
+     * Constructs a SearchExplain object with all counters set to zero
+     */
+    SearchExplain();
+
+    int searches;           ///< The amount of outermost searches, one per tree and target
+    int steps;              ///< The amount of nodes visited
+    int wordEdges;          ///< The amount of edges to word nodes followed
+    int wildcardEdges;      ///< The amount of edges to wildcard nodes followed
+    int variableEdges;      ///< The amount of edges to variable nodes followed
+    int filteredEdges;      ///< The amount of edges skipped by token filters
+    int terminalNodes;      ///< The amount of nodes reached with the last word of the input
+    int outputsEvaluated;   ///< The amount of outputs expanded
+    int nestedSearches;     ///< The amount of nested searches of recursive variables
+    int memoHits;           ///< The amount of recursive variables resolved with the memo
+    int literalHits;        ///< The amount of searches answered by the literal index
+    bool aborted;           ///< True if a search exceeded its budget
+    qint64 stageUsecs[EngineStats::StageCount];  ///< The time spent in each stage
+    Nlp::Result result;     ///< The best result
+    Nlp::ResultList candidates; ///< The results with the highest scores, sorted by score
+
+    /**
+     * Counts an edge followed to \a node
+     */
+    void countEdge(const Nlp::Node *node);
+
+    /**
+     * Adds \a usecs microseconds to \a stage
+     */
+    void recordStage(EngineStats::Stage stage, qint64 usecs)
+    {
+        stageUsecs[stage] += usecs;
+    }
+
+    /**
+     * Returns a map with the counters, key "usecs" with a map with the time of each stage,
+     * key "result" with the best result and key "candidates" with the list of candidates.
+     * Results are maps with keys "ruleId", "inputIdx", "score" and "output".
+     */
+    QVariantMap toVariantMap() const;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_SEARCHEXPLAIN_H
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "nlp-engine/sessionstore.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+//--------------------------------------------------------------------------------------------------
+// SessionStore
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SessionStore::SessionStore(int ttl)
+    : m_lastSweep(0),
+      m_mutex(new QMutex())
+{
+    if (ttl < 0) {
+        ttl = Cmn::SettingsSnapshot::current().intValue(SETTING_NLP_SESSION_TTL);
+    }
+
+    m_ttl = qMax(0, ttl);
+    m_clock.start();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SessionStore::~SessionStore()
+{
+    delete m_mutex;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline quint32 Lvk::Nlp::SessionStore::now() const
+{
+    return static_cast<quint32>(m_clock.elapsed() / 1000);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::SessionStore::sweepIfDue(quint32 now)
+{
+    if (m_ttl == 0 || now - m_lastSweep < static_cast<quint32>(qMax(1, m_ttl / 4))) {
+        return;
+    }
+
+    m_lastSweep = now;
+
+    for (int id = 0; id < m_sessions.size(); ++id) {
+        if (!m_contacts[id].isNull() && now - m_sessions[id].lastAccess > (quint32)m_ttl) {
+            m_ids.remove(m_contacts[id]);
+            m_contacts[id] = QString();
+            m_sessions[id] = Session();
+            m_freeIds.append(id);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::SessionStore::topic(const QString &contact)
+{
+    QMutexLocker locker(m_mutex);
+
+    quint32 t = now();
+
+    sweepIfDue(t);
+
+    // Unknown contacts are not added, so lookups alone do not grow the store
+    QHash<QString, int>::const_iterator it = m_ids.find(contact);
+    if (it == m_ids.constEnd()) {
+        return 0;
+    }
+
+    Session &session = m_sessions[*it];
+    session.lastAccess = t;
+
+    return session.topic;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::SessionStore::setTopic(const QString &contact, int topic)
+{
+    QMutexLocker locker(m_mutex);
+
+    quint32 t = now();
+
+    sweepIfDue(t);
+
+    int id = m_ids.value(contact, -1);
+
+    if (id == -1) {
+        if (topic == 0) {
+            return;
+        }
+
+        if (!m_freeIds.isEmpty()) {
+            id = m_freeIds.last();
+            m_freeIds.pop_back();
+        } else {
+            id = m_sessions.size();
+            m_sessions.append(Session());
+            m_contacts.append(QString());
+        }
+
+        m_ids.insert(contact, id);
+        m_contacts[id] = contact;
+    }
+
+    Session &session = m_sessions[id];
+    session.topic = topic;
+    session.lastAccess = t;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::SessionStore::size() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_ids.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::SessionStore::ttl() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_ttl;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::SessionStore::setTtl(int ttl)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_ttl = qMax(0, ttl);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::SessionStore::clear()
+{
+    QMutexLocker locker(m_mutex);
+
+    m_ids.clear();
+    m_sessions.clear();
+    m_contacts.clear();
+    m_freeIds.clear();
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_SESSIONSTORE_H
+#define LVK_NLP_SESSIONSTORE_H
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QElapsedTimer>
+
+class QMutex;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The SessionStore class provides the conversation state of each contact
+ *
+ * Contacts are interned as small integer ids that index a vector of compact records, so the
+ * state of a contact is a single record. Contacts idle for longer than the time to live are
+ * evicted and their ids are reused, so the store does not grow with every contact ever seen.
+ * An evicted contact starts again with the default state.
+ *
+ * Expired contacts are swept while the store is accessed, at most once every quarter of the
+ * time to live.
+ *
+ * This class is thread-safe.
+ */
+class SessionStore
+{
+public:
+
+    /**
+     * Constructs a SessionStore that evicts contacts idle for \a ttl seconds. If \a ttl is
+     * negative, it is read from the application settings. 0 disables eviction.
+     */
+    SessionStore(int ttl = -1);
+
+    /**
+     * Destroys the object.
+     */
+    ~SessionStore();
+
+    /**
+     * Returns the current topic of \a contact. Returns 0 if the contact has no topic.
+     */
+    int topic(const QString &contact);
+
+    /**
+     * Sets the current \a topic of \a contact. Topic 0 means no topic.
+     */
+    void setTopic(const QString &contact, int topic);
+
+    /**
+     * Returns the amount of contacts in the store
+     */
+    int size() const;
+
+    /**
+     * Returns the time to live in seconds
+     */
+    int ttl() const;
+
+    /**
+     * Sets the time to live in seconds. 0 disables eviction.
+     */
+    void setTtl(int ttl);
+
+    /**
+     * Removes all contacts.
+     */
+    void clear();
+
+private:
+    SessionStore(const SessionStore&);
+    SessionStore & operator=(const SessionStore&);
+
+    struct Session
+    {
+        Session() : topic(0), lastAccess(0) { }
+
+        int topic;          // Current topic, 0 means no topic
+        quint32 lastAccess; // Seconds since the store clock started
+    };
+
+    QHash<QString, int> m_ids;      // contact -> index in m_sessions
+    QVector<Session> m_sessions;
+    QVector<QString> m_contacts;    // index -> contact, null if the index is free
+    QVector<int> m_freeIds;
+    QElapsedTimer m_clock;
+    quint32 m_lastSweep;
+    int m_ttl;
+    QMutex *m_mutex;
+
+    quint32 now() const;
+    void sweepIfDue(quint32 now);
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_SESSIONSTORE_H
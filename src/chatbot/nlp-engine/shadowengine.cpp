@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/shadowengine.h"
+#include "nlp-engine/nlpproperties.h"
+#include "common/taskscheduler.h"
+
+#include <QRunnable>
+#include <QReadWriteLock>
+#include <QElapsedTimer>
+#include <QtDebug>
+
+#define SHADOW_MAX_PENDING      64  // Sampled messages are dropped beyond this many pending
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+inline QVariantMap histogramMap(const Lvk::Nlp::LatencyHistogram &h)
+{
+    QVariantMap map;
+    map["count"] = h.count();
+    map["p50"] = h.percentile(50);
+    map["p90"] = h.percentile(90);
+    map["p99"] = h.percentile(99);
+    map["max"] = h.max();
+
+    return map;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::ShadowStats::Outcome compare(const Lvk::Nlp::Result &primary,
+                                       const Lvk::Nlp::Result &shadow)
+{
+    if (primary.isValid() != shadow.isValid()
+            || primary.ruleId != shadow.ruleId
+            || primary.inputIdx != shadow.inputIdx) {
+        return Lvk::Nlp::ShadowStats::RuleMismatch;
+    }
+
+    if (primary.output != shadow.output) {
+        return Lvk::Nlp::ShadowStats::OutputMismatch;
+    }
+
+    return Lvk::Nlp::ShadowStats::Match;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// ShadowStats
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::ShadowStats::ShadowStats()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowStats::record(Outcome outcome, qint64 primaryUsecs, qint64 shadowUsecs)
+{
+    m_outcomes[outcome].fetchAndAddRelaxed(1);
+    m_primary.record(primaryUsecs);
+    m_shadow.record(shadowUsecs);
+
+    if (shadowUsecs > primaryUsecs) {
+        m_slower.fetchAndAddRelaxed(1);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Nlp::ShadowStats::toVariantMap() const
+{
+    QVariantMap map;
+
+    for (int i = 0; i < OutcomeCount; ++i) {
+        map[outcomeName(static_cast<Outcome>(i))] = count(static_cast<Outcome>(i));
+    }
+
+    map["dropped"] = (int)m_dropped;
+    map["shadow_slower"] = (int)m_slower;
+    map["primary"] = histogramMap(m_primary);
+    map["shadow"] = histogramMap(m_shadow);
+
+    return map;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowStats::clear()
+{
+    for (int i = 0; i < OutcomeCount; ++i) {
+        m_outcomes[i].fetchAndStoreRelaxed(0);
+    }
+
+    m_dropped.fetchAndStoreRelaxed(0);
+    m_slower.fetchAndStoreRelaxed(0);
+    m_primary.clear();
+    m_shadow.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::ShadowStats::outcomeName(Outcome outcome)
+{
+    switch (outcome) {
+    case Match:
+        return "match";
+    case RuleMismatch:
+        return "rule_mismatch";
+    case OutputMismatch:
+        return "output_mismatch";
+    default:
+        return "";
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// ShadowEngine::Shared
+//--------------------------------------------------------------------------------------------------
+
+// State shared by an engine and its sessions
+struct Lvk::Nlp::ShadowEngine::Shared
+{
+    Shared(double sampleRate) : sampleRate(sampleRate) { }
+
+    double sampleRate;
+    QAtomicInt messages;        // calls that could be sampled so far
+    ShadowStats stats;
+    QReadWriteLock toolsLock;   // write locked while the shared NLP tools change
+};
+
+//--------------------------------------------------------------------------------------------------
+// ShadowEngine::CompareTask
+//--------------------------------------------------------------------------------------------------
+
+// Replays a sampled message on the shadow engine and compares its result
+class Lvk::Nlp::ShadowEngine::CompareTask : public QRunnable
+{
+public:
+    CompareTask(ShadowEngine *engine, const QString &input, const QString &target,
+                const Nlp::Result &primary, qint64 primaryUsecs)
+        : m_engine(engine), m_input(input), m_target(target), m_primary(primary),
+          m_primaryUsecs(primaryUsecs) { }
+
+    virtual void run()
+    {
+        Nlp::Result shadow;
+        qint64 shadowUsecs = 0;
+
+        {
+            QReadLocker locker(&m_engine->m_shared->toolsLock);
+
+            QElapsedTimer timer;
+            timer.start();
+
+            m_engine->m_shadow->getResponse(m_input, m_target, shadow);
+
+            shadowUsecs = timer.nsecsElapsed()/1000;
+        }
+
+        ShadowStats::Outcome outcome = compare(m_primary, shadow);
+
+        m_engine->m_shared->stats.record(outcome, m_primaryUsecs, shadowUsecs);
+
+        if (outcome != ShadowStats::Match) {
+            qWarning() << "ShadowEngine:" << ShadowStats::outcomeName(outcome) << "for input"
+                       << m_input << "Primary:" << m_primary << "Shadow:" << shadow;
+        }
+
+        m_engine->m_pending.deref();
+    }
+
+private:
+    ShadowEngine *m_engine;
+    QString m_input;
+    QString m_target;
+    Nlp::Result m_primary;
+    qint64 m_primaryUsecs;
+};
+
+//--------------------------------------------------------------------------------------------------
+// ShadowEngine
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::ShadowEngine::ShadowEngine(Engine *primary, Engine *shadow, double sampleRate,
+                                     const QVariantMap &overrides /*= QVariantMap()*/)
+    : m_primary(primary),
+      m_shadow(shadow),
+      m_overrides(overrides),
+      m_shared(new Shared(qBound(0.0, sampleRate, 1.0)))
+{
+    for (QVariantMap::const_iterator it = overrides.constBegin(); it != overrides.constEnd();
+         ++it) {
+        m_shadow->setProperty(it.key(), it.value());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::ShadowEngine::ShadowEngine(Engine *primary, Engine *shadow,
+                                     const QVariantMap &overrides, QSharedPointer<Shared> shared)
+    : m_primary(primary),
+      m_shadow(shadow),
+      m_overrides(overrides),
+      m_shared(shared)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::ShadowEngine::~ShadowEngine()
+{
+    Cmn::TaskScheduler::scheduler()->waitForDone(this);
+
+    delete m_shadow;
+    delete m_primary;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::ShadowEngine::mustSample()
+{
+    double rate = m_shared->sampleRate;
+
+    if (rate <= 0) {
+        return false;
+    }
+
+    // Samples exactly one of every 1/rate calls, no matter how many threads reply
+    quint32 n = (quint32)m_shared->messages.fetchAndAddRelaxed(1);
+
+    return (quint64)((n + 1.0) * rate) != (quint64)(n * rate);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::recompileShadow()
+{
+    // The shadow engine shares the NLP tools but does not know they changed
+    m_shadow->setRules(m_shadow->rules());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::RuleList Lvk::Nlp::ShadowEngine::rules() const
+{
+    return m_primary->rules();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::setRules(const RuleList &rules)
+{
+    m_primary->setRules(rules);
+    m_shadow->setRules(rules);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::addRule(const Rule &rule)
+{
+    m_primary->addRule(rule);
+    m_shadow->addRule(rule);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::removeRule(RuleId ruleId)
+{
+    m_primary->removeRule(ruleId);
+    m_shadow->removeRule(ruleId);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::updateRule(const Rule &rule)
+{
+    m_primary->updateRule(rule);
+    m_shadow->updateRule(rule);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::ShadowEngine::getResponse(const QString &input, MatchList &matches)
+{
+    return m_primary->getResponse(input, matches);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::ShadowEngine::getResponse(const QString &input, const QString &target,
+                                            MatchList &matches)
+{
+    return m_primary->getResponse(input, target, matches);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QStringList Lvk::Nlp::ShadowEngine::getAllResponses(const QString &input, MatchList &matches)
+{
+    return m_primary->getAllResponses(input, matches);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QStringList Lvk::Nlp::ShadowEngine::getAllResponses(const QString &input, const QString &target,
+                                                    MatchList &matches)
+{
+    return m_primary->getAllResponses(input, target, matches);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::getResponse(const QString &input, const QString &target,
+                                         Nlp::Result &result)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_primary->getResponse(input, target, result);
+
+    qint64 usecs = timer.nsecsElapsed()/1000;
+
+    if (!mustSample()) {
+        return;
+    }
+
+    if (m_pending >= SHADOW_MAX_PENDING) {
+        m_shared->stats.recordDropped();
+        return;
+    }
+
+    m_pending.ref();
+
+    // Background class, so comparisons never take the workers of replies
+    Cmn::TaskScheduler::scheduler()->start(new CompareTask(this, input, target, result, usecs),
+                                           Cmn::TaskScheduler::Background, this);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QFuture<Lvk::Nlp::Result> Lvk::Nlp::ShadowEngine::getResponseAsync(const QString &input,
+                                                                  const QString &target,
+                                                                  int deadline /*= 0*/)
+{
+    return m_primary->getResponseAsync(input, target, deadline);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::explainResponse(const QString &input, const QString &target,
+                                             SearchExplain &explain, int topCount /*= 10*/)
+{
+    m_primary->explainResponse(input, target, explain, topCount);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::getAllResponses(const QString &input, const QString &target,
+                                             ResultList &results)
+{
+    m_primary->getAllResponses(input, target, results);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::getResponses(const QStringList &inputs, const QString &target,
+                                          QList<ResultList> &results)
+{
+    m_primary->getResponses(inputs, target, results);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::setEvasives(const QStringList &evasives, const QString &target)
+{
+    m_primary->setEvasives(evasives, target);
+    m_shadow->setEvasives(evasives, target);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::ShadowEngine::getEvasive(const QString &target) const
+{
+    return m_primary->getEvasive(target);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::ShadowEngine::getCurrentTopic(const QString &target) const
+{
+    return m_primary->getCurrentTopic(target);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::setPreSanitizer(Sanitizer *sanitizer)
+{
+    QWriteLocker locker(&m_shared->toolsLock);
+
+    m_primary->setPreSanitizer(sanitizer);
+    recompileShadow();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::setLemmatizer(Lemmatizer *lemmatizer)
+{
+    QWriteLocker locker(&m_shared->toolsLock);
+
+    m_primary->setLemmatizer(lemmatizer);
+    recompileShadow();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::setPostSanitizer(Sanitizer *sanitizer)
+{
+    QWriteLocker locker(&m_shared->toolsLock);
+
+    m_primary->setPostSanitizer(sanitizer);
+    recompileShadow();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariant Lvk::Nlp::ShadowEngine::property(const QString &name)
+{
+    if (name == NLP_PROP_SHADOW_STATS) {
+        return QVariant(m_shared->stats.toVariantMap());
+    }
+
+    return m_primary->property(name);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::setProperty(const QString &name, const QVariant &value)
+{
+    if (name == NLP_PROP_SHADOW_STATS) {
+        m_shared->stats.clear();
+        return;
+    }
+
+    m_primary->setProperty(name, value);
+
+    if (!m_overrides.contains(name)) {
+        m_shadow->setProperty(name, value);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::build()
+{
+    m_primary->build();
+    m_shadow->build();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::ShadowEngine::saveSnapshot(const QString &filename, const QString &config)
+{
+    return m_primary->saveSnapshot(filename, config);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::ShadowEngine::loadSnapshot(const QString &filename, const QString &config)
+{
+    return m_primary->loadSnapshot(filename, config);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::clear()
+{
+    Cmn::TaskScheduler::scheduler()->waitForDone(this);
+
+    m_primary->clear();
+    m_shadow->clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Engine * Lvk::Nlp::ShadowEngine::createSession()
+{
+    return new ShadowEngine(m_primary->createSession(), m_shadow->createSession(), m_overrides,
+                            m_shared);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::lintRules(RuleIssueList &issues)
+{
+    m_primary->lintRules(issues);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::ShadowEngine::profileRules(RuleCostList &costs)
+{
+    m_primary->profileRules(costs);
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_SHADOWENGINE_H
+#define LVK_NLP_SHADOWENGINE_H
+
+#include "nlp-engine/engine.h"
+#include "nlp-engine/enginestats.h"
+
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QVariantMap>
+
+class QReadWriteLock;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The ShadowStats class provides the outcome of the comparisons of a ShadowEngine
+ *
+ * This class is thread-safe.
+ */
+class ShadowStats
+{
+public:
+
+    /**
+     * Outcome of a comparison
+     */
+    enum Outcome
+    {
+        Match,              ///< Same rule, input and output
+        RuleMismatch,       ///< Different rule or input, or only one engine matched
+        OutputMismatch,     ///< Same rule and input but different output
+        OutcomeCount
+    };
+
+    /**
+     * Constructs an empty object
+     */
+    ShadowStats();
+
+    /**
+     * Records a comparison with \a outcome where the primary engine took \a primaryUsecs and
+     * the shadow engine took \a shadowUsecs microseconds
+     */
+    void record(Outcome outcome, qint64 primaryUsecs, qint64 shadowUsecs);
+
+    /**
+     * Records a sampled message dropped because too many comparisons were pending
+     */
+    void recordDropped()
+    {
+        m_dropped.fetchAndAddRelaxed(1);
+    }
+
+    /**
+     * Returns the amount of comparisons with \a outcome
+     */
+    int count(Outcome outcome) const
+    {
+        return m_outcomes[outcome];
+    }
+
+    /**
+     * Returns a map with the amount of comparisons of each outcome, the sampled messages
+     * dropped, the comparisons where the shadow engine was slower and, for keys "primary"
+     * and "shadow", a map with the count, p50, p90, p99 and max latencies in microseconds of
+     * each engine on the compared messages.
+     */
+    QVariantMap toVariantMap() const;
+
+    /**
+     * Removes all comparisons
+     */
+    void clear();
+
+    /**
+     * Returns the name of \a outcome
+     */
+    static QString outcomeName(Outcome outcome);
+
+private:
+    ShadowStats(const ShadowStats&);
+    ShadowStats & operator=(const ShadowStats&);
+
+    QAtomicInt m_outcomes[OutcomeCount];
+    QAtomicInt m_dropped;
+    QAtomicInt m_slower;
+    LatencyHistogram m_primary;
+    LatencyHistogram m_shadow;
+};
+
+/**
+ * \brief The ShadowEngine class provides an engine that replies with a primary engine and
+ *        compares its replies with the ones of a shadow engine
+ *
+ * A fraction of the calls to getResponse(const QString &, const QString &, Result &), the one
+ * chat adapters use, is replayed on the shadow engine in a background thread after replying,
+ * so the shadow never delays replies. Both results are compared by rule ID, input index and
+ * output, and the outcome and latencies are recorded in ShadowStats. Mismatches are logged
+ * with both results. This allows to enable new engine modes in production and check they
+ * reply the same before switching to them.
+ *
+ * Rules, evasives and properties are set on both engines, except the properties overridden
+ * for the shadow engine. Everything else, including the replies, comes from the primary
+ * engine. Both engines must share their NLP tools, so sanitizers and lemmatizers are only set
+ * on the primary engine.
+ *
+ * The shadow engine only sees the sampled messages, so rules that depend on the current topic
+ * can mismatch. Outputs of random rules can mismatch too.
+ */
+class ShadowEngine : public Engine
+{
+public:
+
+    /**
+     * Constructs an engine that replies with \a primary and compares \a sampleRate of the
+     * replies, between 0 and 1, with \a shadow. \a overrides are the properties set on
+     * \a shadow that setProperty() does not change. \a primary and \a shadow must share their
+     * NLP tools. After construction, the object owns the given pointers.
+     */
+    ShadowEngine(Engine *primary, Engine *shadow, double sampleRate,
+                 const QVariantMap &overrides = QVariantMap());
+
+    /**
+     * Destroys the object. Waits for pending comparisons.
+     */
+    ~ShadowEngine();
+
+    /**
+     * \copydoc Engine::rules() const
+     */
+    virtual RuleList rules() const;
+
+    /**
+     * \copydoc Engine::setRules()
+     */
+    virtual void setRules(const RuleList &rules);
+
+    /**
+     * \copydoc Engine::addRule()
+     */
+    virtual void addRule(const Rule &rule);
+
+    /**
+     * \copydoc Engine::removeRule()
+     */
+    virtual void removeRule(RuleId ruleId);
+
+    /**
+     * \copydoc Engine::updateRule()
+     */
+    virtual void updateRule(const Rule &rule);
+
+    /**
+     * \copydoc Engine::getResponse(const QString &, MatchList &)
+     */
+    virtual QString getResponse(const QString &input, MatchList &matches);
+
+    /**
+     * \copydoc Engine::getResponse(const QString &, const QString &, MatchList &)
+     */
+    virtual QString getResponse(const QString &input, const QString &target,
+                                MatchList &matches);
+
+    /**
+     * \copydoc Engine::getAllResponses(const QString &, MatchList &)
+     */
+    virtual QStringList getAllResponses(const QString &input, MatchList &matches);
+
+    /**
+     * \copydoc Engine::getAllResponses(const QString &, const QString &, MatchList &)
+     */
+    virtual QStringList getAllResponses(const QString &input, const QString &target,
+                                        MatchList &matches);
+
+    /**
+     * \copydoc Engine::getResponse(const QString &, const QString &, Result &)
+     *
+     * The call is sampled for comparison with the shadow engine.
+     */
+    virtual void getResponse(const QString &input, const QString &target, Result &result);
+
+    /**
+     * \copydoc Engine::getResponseAsync()
+     */
+    virtual QFuture<Result> getResponseAsync(const QString &input, const QString &target,
+                                             int deadline = 0);
+
+    /**
+     * \copydoc Engine::explainResponse()
+     */
+    virtual void explainResponse(const QString &input, const QString &target,
+                                 SearchExplain &explain, int topCount = 10);
+
+    /**
+     * \copydoc Engine::getAllResponses(const QString &, const QString &, ResultList &)
+     */
+    virtual void getAllResponses(const QString &input, const QString &target,
+                                 ResultList &results);
+
+    /**
+     * \copydoc Engine::getResponses()
+     */
+    virtual void getResponses(const QStringList &inputs, const QString &target,
+                              QList<ResultList> &results);
+
+    /**
+     * \copydoc Engine::setEvasives()
+     */
+    virtual void setEvasives(const QStringList &evasives, const QString &target);
+
+    /**
+     * \copydoc Engine::getEvasive()
+     */
+    virtual QString getEvasive(const QString &target) const;
+
+    /**
+     * \copydoc Engine::getCurrentTopic()
+     */
+    virtual QString getCurrentTopic(const QString &target) const;
+
+    /**
+     * \copydoc Engine::setPreSanitizer()
+     */
+    virtual void setPreSanitizer(Sanitizer *sanitizer);
+
+    /**
+     * \copydoc Engine::setLemmatizer()
+     */
+    virtual void setLemmatizer(Lemmatizer *lemmatizer);
+
+    /**
+     * \copydoc Engine::setPostSanitizer()
+     */
+    virtual void setPostSanitizer(Sanitizer *sanitizer);
+
+    /**
+     * \copydoc Engine::property()
+     *
+     * NLP_PROP_SHADOW_STATS returns the ShadowStats shared by the engine and its sessions.
+     * \see ShadowStats::toVariantMap(). Other properties are read from the primary engine.
+     */
+    virtual QVariant property(const QString &name);
+
+    /**
+     * \copydoc Engine::setProperty()
+     *
+     * NLP_PROP_SHADOW_STATS with any value resets the ShadowStats.
+     */
+    virtual void setProperty(const QString &name, const QVariant &value);
+
+    /**
+     * \copydoc Engine::build()
+     */
+    virtual void build();
+
+    /**
+     * \copydoc Engine::saveSnapshot()
+     *
+     * Only the primary engine is saved.
+     */
+    virtual bool saveSnapshot(const QString &filename, const QString &config);
+
+    /**
+     * \copydoc Engine::loadSnapshot()
+     *
+     * Only the primary engine is loaded, the shadow engine compiles its rules.
+     */
+    virtual bool loadSnapshot(const QString &filename, const QString &config);
+
+    /**
+     * \copydoc Engine::clear()
+     */
+    virtual void clear();
+
+    /**
+     * \copydoc Engine::createSession()
+     *
+     * The new session samples with the same rate, keeps comparing with a session of the
+     * shadow engine and records in the same ShadowStats.
+     */
+    virtual Engine *createSession();
+
+    /**
+     * \copydoc Engine::lintRules()
+     */
+    virtual void lintRules(RuleIssueList &issues);
+
+    /**
+     * \copydoc Engine::profileRules()
+     */
+    virtual void profileRules(RuleCostList &costs);
+
+private:
+    ShadowEngine(const ShadowEngine&);
+    ShadowEngine & operator=(const ShadowEngine&);
+
+    struct Shared;
+    class CompareTask;
+
+    Engine *m_primary;
+    Engine *m_shadow;
+    QVariantMap m_overrides;
+    QSharedPointer<Shared> m_shared;    // shared with sessions
+    QAtomicInt m_pending;               // comparisons queued or running
+
+    ShadowEngine(Engine *primary, Engine *shadow, const QVariantMap &overrides,
+                 QSharedPointer<Shared> shared);
+
+    bool mustSample();
+    void recompileShadow();
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_SHADOWENGINE_H
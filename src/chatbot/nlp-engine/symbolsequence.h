@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_SYMBOLSEQUENCE_H
+#define LVK_NLP_SYMBOLSEQUENCE_H
+
+#include "nlp-engine/symboltable.h"
+
+#include <QVector>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The SymbolSequence class provides a sequence of interned symbols with a rolling hash
+ *
+ * The hash is updated with a 64-bit multiply-shift step each time a symbol is appended, so
+ * hashing a sequence costs one multiplication per symbol instead of hashing the characters of
+ * the concatenated words. A prefix can be copied and extended without hashing it again.
+ *
+ * SymbolSequence can be used as QHash key.
+ */
+class SymbolSequence
+{
+public:
+
+    /**
+     * Constructs an empty sequence.
+     */
+    SymbolSequence() : m_hash(SEED) { }
+
+    /**
+     * Reserves space for \a size symbols.
+     */
+    void reserve(int size)
+    {
+        m_ids.reserve(size);
+    }
+
+    /**
+     * Appends the symbol \a id and updates the hash.
+     */
+    void append(Nlp::SymbolId id)
+    {
+        m_ids.append(id);
+        m_hash = (m_hash ^ id) * MULTIPLIER;
+    }
+
+    /**
+     * Returns the amount of symbols in the sequence.
+     */
+    int size() const
+    {
+        return m_ids.size();
+    }
+
+    /**
+     * Returns the 64-bit hash of the sequence.
+     */
+    quint64 hash() const
+    {
+        return m_hash;
+    }
+
+    bool operator==(const SymbolSequence &other) const
+    {
+        return m_hash == other.m_hash && m_ids == other.m_ids;
+    }
+
+    bool operator!=(const SymbolSequence &other) const
+    {
+        return !operator==(other);
+    }
+
+private:
+    static const quint64 SEED = Q_UINT64_C(0xcbf29ce484222325);
+    static const quint64 MULTIPLIER = Q_UINT64_C(0x9e3779b97f4a7c15);  // Odd, 2^64 / golden ratio
+
+    QVector<Nlp::SymbolId> m_ids;
+    quint64 m_hash;
+};
+
+/**
+ * Returns the hash of \a seq. The upper bits of the multiply-shift hash are the best mixed.
+ */
+inline uint qHash(const SymbolSequence &seq)
+{
+    return static_cast<uint>(seq.hash() >> 32);
+}
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_SYMBOLSEQUENCE_H
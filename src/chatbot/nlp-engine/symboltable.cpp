@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/symboltable.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+//--------------------------------------------------------------------------------------------------
+// SymbolTable
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SymbolTable * Lvk::Nlp::SymbolTable::m_instance = 0;
+QMutex * Lvk::Nlp::SymbolTable::m_mutex = new QMutex();
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SymbolTable::SymbolTable()
+    : m_rwLock(new QReadWriteLock())
+{
+    m_strings.append(QString()); // NullSymbol
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SymbolTable * Lvk::Nlp::SymbolTable::instance()
+{
+    if (!m_instance) {
+        QMutexLocker locker(m_mutex);
+        if (!m_instance) {
+            m_instance = new SymbolTable();
+        }
+    }
+
+    return m_instance;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SymbolId Lvk::Nlp::SymbolTable::intern(QString &str)
+{
+    if (str.isEmpty()) {
+        return NullSymbol;
+    }
+
+    {
+        QReadLocker locker(m_rwLock);
+
+        QHash<QString, SymbolId>::const_iterator it = m_ids.find(str);
+        if (it != m_ids.constEnd()) {
+            str = it.key();
+            return *it;
+        }
+    }
+
+    QWriteLocker locker(m_rwLock);
+
+    // Another thread could have added the string meanwhile
+    QHash<QString, SymbolId>::iterator it = m_ids.find(str);
+    if (it == m_ids.end()) {
+        it = m_ids.insert(str, m_strings.size());
+        m_strings.append(str);
+    }
+
+    str = it.key();
+
+    return *it;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::SymbolId Lvk::Nlp::SymbolTable::lookup(const QString &str) const
+{
+    if (str.isEmpty()) {
+        return NullSymbol;
+    }
+
+    QReadLocker locker(m_rwLock);
+
+    return m_ids.value(str, NullSymbol);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::SymbolTable::string(Nlp::SymbolId id) const
+{
+    QReadLocker locker(m_rwLock);
+
+    return (int)id < m_strings.size() ? m_strings[id] : QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::SymbolTable::size() const
+{
+    QReadLocker locker(m_rwLock);
+
+    return m_strings.size() - 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 Lvk::Nlp::SymbolTable::bytes() const
+{
+    QReadLocker locker(m_rwLock);
+
+    qint64 n = 0;
+
+    foreach (const QString &str, m_strings) {
+        n += str.size() * sizeof(QChar);
+    }
+
+    return n;
+}
+
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_SYMBOLTABLE_H
+#define LVK_NLP_SYMBOLTABLE_H
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+
+class QMutex;
+class QReadWriteLock;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief Symbol identifier. NullSymbol is reserved for empty or unknown strings
+ */
+typedef quint32 SymbolId;
+
+const SymbolId NullSymbol = 0;
+
+/**
+ * \brief The SymbolTable class provides a global table of interned strings
+ *
+ * Words, lemmas and PoS tags are interned when rules are compiled, so the tree can compare
+ * small integer IDs instead of strings. Interned strings are implicitly shared, thus equal
+ * words in different rules use the same string data.
+ *
+ * This class is thread-safe.
+ */
+class SymbolTable
+{
+public:
+
+    /**
+     * Returns the global symbol table
+     */
+    static SymbolTable *instance();
+
+    /**
+     * Returns the ID of \a str. If \a str is not in the table, it's added. After the call,
+     * \a str shares its data with the string in the table. Empty strings are not added and
+     * NullSymbol is returned.
+     */
+    SymbolId intern(QString &str);
+
+    /**
+     * Returns the ID of \a str if \a str is in the table. Otherwise; returns NullSymbol.
+     * This method never adds new strings, so it can be used with user input.
+     */
+    SymbolId lookup(const QString &str) const;
+
+    /**
+     * Returns the string with the given \a id. If there is no such string returns an empty
+     * string.
+     */
+    QString string(SymbolId id) const;
+
+    /**
+     * Returns the amount of strings in the table
+     */
+    int size() const;
+
+    /**
+     * Returns the amount of bytes used by the characters of the strings in the table
+     */
+    qint64 bytes() const;
+
+private:
+    SymbolTable();
+    SymbolTable(SymbolTable&);
+    SymbolTable& operator=(SymbolTable&);
+
+    static SymbolTable *m_instance;
+    static QMutex *m_mutex;
+
+    QReadWriteLock *m_rwLock;
+    QHash<QString, SymbolId> m_ids;
+    QVector<QString> m_strings;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_SYMBOLTABLE_H
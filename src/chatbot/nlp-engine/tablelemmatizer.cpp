@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "nlp-engine/tablelemmatizer.h"
+#include "nlp-engine/lemmatable.h"
+#include "nlp-engine/sanitizer.h"
+#include "nlp-engine/sanitizerfactory.h"
+#include "common/trace.h"
+#include "common/profiler.h"
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Same chars than \w in QRegExp
+inline bool isWordChar(const QChar &c)
+{
+    return c.isLetterOrNumber() || c.isMark() || c == '_';
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Finds the next token of input from pos. Sets start and pos to the first position of the token
+// and the position after it. Returns false if there are no more tokens.
+inline bool nextToken(const QString &input, int &start, int &pos)
+{
+    const int size = input.size();
+
+    while (pos < size && input[pos].isSpace()) {
+        ++pos;
+    }
+
+    if (pos == size) {
+        return false;
+    }
+
+    start = pos;
+
+    if (isWordChar(input[pos])) {
+        while (pos < size && isWordChar(input[pos])) {
+            ++pos;
+        }
+    } else if (input[pos] == '[') {
+        // Variable declarations, see VAR_DECL_REGEX
+        int end = pos + 1;
+        while (end < size && isWordChar(input[end])) {
+            ++end;
+        }
+        pos = end > start + 1 && end < size && input[end] == ']' ? end + 1 : start + 1;
+    } else {
+        ++pos;
+    }
+
+    return true;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// TableLemmatizer
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::TableLemmatizer::TableLemmatizer(QSharedPointer<const LemmaTable> table,
+                                           Lemmatizer *fallback /*= 0*/)
+    : m_table(table),
+      m_fallback(fallback),
+      m_preSanitizer(Nlp::SanitizerFactory().createPreSanitizer()),
+      m_postSanitizer(Nlp::SanitizerFactory().createPostSanitizer()),
+      m_fallbacks(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::TableLemmatizer::~TableLemmatizer()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::TableLemmatizer::tokenize(const QString &input, QStringList &l)
+{
+    l.clear();
+
+    int start = 0;
+    int pos = 0;
+
+    while (nextToken(input, start, pos)) {
+        l.append(input.mid(start, pos - start));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::TableLemmatizer::lemmatize(const QString &input, Nlp::WordList &l)
+{
+    LVK_PROFILE("TableLemmatizer::lemmatize");
+
+    if (!lookup(input, l)) {
+        m_fallbacks.ref();
+        m_fallback->lemmatize(input, l);
+    }
+
+    LVK_TRACE(Lemmatizer) << "Lemmatized:" << input << "->" << l;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::TableLemmatizer::lemmatizeBatch(const QStringList &inputs,
+                                               QList<Nlp::WordList> &l)
+{
+    LVK_PROFILE("TableLemmatizer::lemmatizeBatch");
+
+    l.clear();
+
+    QStringList ambiguous;
+    QList<int> ambiguousIdxs;
+
+    for (int i = 0; i < inputs.size(); ++i) {
+        Nlp::WordList words;
+        if (!lookup(inputs[i], words)) {
+            ambiguous.append(inputs[i]);
+            ambiguousIdxs.append(i);
+        }
+        l.append(words);
+    }
+
+    if (ambiguous.isEmpty()) {
+        return;
+    }
+
+    m_fallbacks.fetchAndAddOrdered(ambiguous.size());
+
+    QList<Nlp::WordList> fallbackWords;
+    m_fallback->lemmatizeBatch(ambiguous, fallbackWords);
+
+    for (int i = 0; i < ambiguousIdxs.size(); ++i) {
+        l[ambiguousIdxs[i]] = fallbackWords.value(i);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::TableLemmatizer::lookup(const QString &input, Nlp::WordList &l)
+{
+    l.clear();
+
+    // Tokens are looked up as soon as they are found, without an intermediate token list
+    const QString szInput = m_preSanitizer->sanitize(input);
+
+    int start = 0;
+    int pos = 0;
+
+    while (nextToken(szInput, start, pos)) {
+        const QString token = szInput.mid(start, pos - start);
+        QString lemma;
+        Nlp::LemmaTable::Status status = m_table ? m_table->lookup(token, lemma)
+                                                 : Nlp::LemmaTable::Unknown;
+
+        if (status != Nlp::LemmaTable::Unique) {
+            if (status == Nlp::LemmaTable::Ambiguous && m_fallback.get()) {
+                l.clear();
+                return false;
+            }
+            lemma = token.toLower();
+        }
+
+        l.append(Nlp::Word(token, m_postSanitizer->sanitize(token), lemma));
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::TableLemmatizer::isThreadSafe() const
+{
+    return !m_fallback.get() || m_fallback->isThreadSafe();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::TableLemmatizer::fallbacks() const
+{
+    return m_fallbacks;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_TABLELEMMATIZER_H
+#define LVK_NLP_TABLELEMMATIZER_H
+
+#include "nlp-engine/lemmatizer.h"
+
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <memory>
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+class LemmaTable;
+class Sanitizer;
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The TableLemmatizer class provides a fast Lemmatizer that looks up lemmas in a
+ *        LemmaTable
+ *
+ * Inputs are split with a native tokenizer: runs of letters, digits and underscores are words,
+ * variable declarations such as [name] are kept as a single token, and any other char that is
+ * not a space is a token by itself. Each word is looked up in the table. Unknown words are
+ * their own lemma, in lower case.
+ *
+ * Only the morphological analysis can tell the lemma of ambiguous words, so inputs with
+ * ambiguous words are lemmatized with the fallback lemmatizer, usually a FreelingLemmatizer.
+ * Without fallback, ambiguous words are their own lemma too.
+ *
+ * Inputs are sanitized as FreelingLemmatizer does, so both lemmatizers return the same words
+ * for the common case except for PoS tags, which are not set.
+ *
+ * This class is thread-safe if the fallback lemmatizer is thread-safe.
+ */
+class TableLemmatizer : public Lemmatizer
+{
+public:
+
+    /**
+     * Constructs a TableLemmatizer that looks up lemmas in \a table and uses \a fallback for
+     * inputs with ambiguous words. \a fallback can be null. After construction, the object
+     * owns \a fallback.
+     */
+    TableLemmatizer(QSharedPointer<const LemmaTable> table, Lemmatizer *fallback = 0);
+
+    /**
+     * \copydoc Lemmatizer::~Lemmatizer()
+     */
+    ~TableLemmatizer();
+
+    /**
+     * \copydoc Lemmatizer::tokenize(const QString &input, QStringList &l)
+     */
+    virtual void tokenize(const QString &input, QStringList &l);
+
+    /**
+     * \copydoc Lemmatizer::lemmatize(const QString &input, WordList &l)
+     */
+    virtual void lemmatize(const QString &input, WordList &l);
+
+    /**
+     * \copydoc Lemmatizer::lemmatizeBatch(const QStringList &, QList<WordList> &)
+     *
+     * Inputs with ambiguous words are sent to the fallback lemmatizer in one batch.
+     */
+    virtual void lemmatizeBatch(const QStringList &inputs, QList<WordList> &l);
+
+    /**
+     * Returns true if there is no fallback lemmatizer or if it is thread-safe. Otherwise;
+     * returns false.
+     */
+    virtual bool isThreadSafe() const;
+
+    /**
+     * Returns the amount of inputs lemmatized with the fallback lemmatizer
+     */
+    int fallbacks() const;
+
+private:
+    TableLemmatizer(const TableLemmatizer&);
+    TableLemmatizer & operator=(const TableLemmatizer&);
+
+    QSharedPointer<const LemmaTable> m_table;
+    std::auto_ptr<Lemmatizer> m_fallback;
+    std::auto_ptr<Sanitizer> m_preSanitizer;
+    std::auto_ptr<Sanitizer> m_postSanitizer;
+    QAtomicInt m_fallbacks;
+
+    bool lookup(const QString &input, WordList &l);
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_NLP_TABLELEMMATIZER_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "nlp-engine/toolchain.h"
+#include "nlp-engine/nullsanitizer.h"
+#include "nlp-engine/nulllemmatizer.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <QStringList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+
+//--------------------------------------------------------------------------------------------------
+// Toolchain
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Toolchain::Toolchain(const QString &lang /*= QString()*/)
+    : m_lang(lang),
+      m_lemmaLock(new QReadWriteLock()),
+      m_lemmaMutex(new QMutex()),
+      m_preSanitizer(new NullSanitizer()),
+      m_lemmatizer(new NullLemmatizer()),
+      m_postSanitizer(new NullSanitizer())
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Toolchain::~Toolchain()
+{
+    // Tools must be destroyed before the locks
+    m_lemmatizer.reset();
+
+    delete m_lemmaMutex;
+    delete m_lemmaLock;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Nlp::Toolchain::defaultLanguage()
+{
+    Cmn::SettingsSnapshot settings = Cmn::SettingsSnapshot::current();
+    QString lang = settings.value(SETTING_NLP_LANGUAGE).toString();
+
+    if (lang.isEmpty()) {
+        lang = settings.value(SETTING_APP_LANGUAGE).toString().split("_").at(0);
+    }
+
+    return lang;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const QString & Lvk::Nlp::Toolchain::lang() const
+{
+    return m_lang;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Sanitizer * Lvk::Nlp::Toolchain::preSanitizer()
+{
+    return m_preSanitizer.get();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Toolchain::setPreSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
+{
+    m_preSanitizer.reset(sanitizer ? sanitizer : new NullSanitizer());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Lemmatizer * Lvk::Nlp::Toolchain::lemmatizer()
+{
+    return m_lemmatizer.get();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Toolchain::setLemmatizer(Lvk::Nlp::Lemmatizer *lemmatizer)
+{
+    QWriteLocker locker(m_lemmaLock);
+
+    m_lemmatizer.reset(lemmatizer ? lemmatizer : new NullLemmatizer());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Toolchain::lemmatize(const QString &input, Nlp::WordList &words)
+{
+    QReadLocker locker(m_lemmaLock);
+    QMutexLocker serialLocker(m_lemmatizer->isThreadSafe() ? 0 : m_lemmaMutex);
+
+    m_lemmatizer->lemmatize(input, words);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Toolchain::lemmatizeBatch(const QStringList &inputs, QList<Nlp::WordList> &words)
+{
+    QReadLocker locker(m_lemmaLock);
+    QMutexLocker serialLocker(m_lemmatizer->isThreadSafe() ? 0 : m_lemmaMutex);
+
+    m_lemmatizer->lemmatizeBatch(inputs, words);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Sanitizer * Lvk::Nlp::Toolchain::postSanitizer()
+{
+    return m_postSanitizer.get();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Toolchain::setPostSanitizer(Lvk::Nlp::Sanitizer *sanitizer)
+{
+    m_postSanitizer.reset(sanitizer ? sanitizer : new NullSanitizer());
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LVK_NLP_TOOLCHAIN_H
+#define LVK_NLP_TOOLCHAIN_H
+
+#include "nlp-engine/sanitizer.h"
+#include "nlp-engine/lemmatizer.h"
+
+#include <QString>
+#include <memory>
+
+class QMutex;
+class QReadWriteLock;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The Toolchain class provides the NLP tools used to parse rules and user inputs of
+ *        one language: a pre-sanitizer, a lemmatizer and a post-sanitizer.
+ *
+ * Each engine can have its own toolchain, so engines of different languages can run in the
+ * same process. Heavy resources such as Freeling dictionaries are shared by all lemmatizers of
+ * the same language. Engines without a toolchain use GlobalTools.
+ *
+ * By default, sanitizers are NullSanitizer's and the lemmatizer is a NullLemmatizer.
+ *
+ * \see EngineFactory::createEngine(const QString &), GlobalTools
+ */
+class Toolchain
+{
+public:
+
+    /**
+     * Constructs a Toolchain object for language \a lang with null tools.
+     */
+    Toolchain(const QString &lang = QString());
+
+    /**
+     * Destroys the object and all its tools.
+     */
+    virtual ~Toolchain();
+
+    /**
+     * Returns the NLP language in the application settings. If not set, returns the language
+     * of the application.
+     */
+    static QString defaultLanguage();
+
+    /**
+     * Returns the language of the toolchain. Empty means the default language.
+     */
+    const QString &lang() const;
+
+    Sanitizer * preSanitizer();
+
+    /**
+     * Sets the pre-sanitizer and takes ownership of it. Null resets it to a NullSanitizer.
+     */
+    void setPreSanitizer(Sanitizer *sanitizer);
+
+    Lemmatizer * lemmatizer();
+
+    /**
+     * Sets the lemmatizer and takes ownership of it. Null resets it to a NullLemmatizer.
+     */
+    void setLemmatizer(Lemmatizer *lemmatizer);
+
+    /**
+     * Lemmatizes \a input with the current lemmatizer. Calls to this method are serialized
+     * unless the current lemmatizer is thread-safe.
+     *
+     * \see Lemmatizer::isThreadSafe()
+     */
+    void lemmatize(const QString &input, WordList &words);
+
+    /**
+     * Lemmatizes all \a inputs at once with the current lemmatizer.
+     * \see lemmatize(), Lemmatizer::lemmatizeBatch()
+     */
+    void lemmatizeBatch(const QStringList &inputs, QList<WordList> &words);
+
+    Sanitizer * postSanitizer();
+
+    /**
+     * Sets the post-sanitizer and takes ownership of it. Null resets it to a NullSanitizer.
+     */
+    void setPostSanitizer(Sanitizer *sanitizer);
+
+private:
+    Toolchain(Toolchain&);
+    Toolchain& operator=(Toolchain&);
+
+    QString m_lang;
+
+    QReadWriteLock *m_lemmaLock;
+    QMutex *m_lemmaMutex;
+
+    std::auto_ptr<Sanitizer>  m_preSanitizer;
+    std::auto_ptr<Lemmatizer> m_lemmatizer;
+    std::auto_ptr<Sanitizer>  m_postSanitizer;
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_TOOLCHAIN_H
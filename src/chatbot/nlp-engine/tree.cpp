@@ -25,8 +25,17 @@
 #include "nlp-engine/globaltools.h"
 #include "nlp-engine/matchpolicy.h"
 #include "nlp-engine/scoringalgorithm.h"
+#include "nlp-engine/flattree.h"
+#include "nlp-engine/symboltable.h"
+#include "nlp-engine/searchexplain.h"
+#include "common/trace.h"
+#include "common/profiler.h"
 
 #include <QtAlgorithms>
+#include <QDataStream>
+#include <QVector>
+#include <QMutexLocker>
+#include <QElapsedTimer>
 
 #define MAX_INPUT_IDX_SIZE  10   // in bits
 #define INPUT_IDX_MASK      ((1 << MAX_INPUT_IDX_SIZE) - 1)
@@ -70,207 +79,1988 @@ inline int getInputIndex(quint64 id)
     return id & INPUT_IDX_MASK;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+// Records the time elapsed since timer was started if the search is not a nested search
+inline void recordStage(const Lvk::Nlp::SearchContext &ctx, Lvk::Nlp::EngineStats::Stage stage,
+                        const QElapsedTimer &timer, bool nested)
+{
+    if (nested) {
+        return;
+    }
+    if (ctx.stats()) {
+        ctx.stats()->record(stage, timer.nsecsElapsed() / 1000);
+    }
+    if (ctx.explain()) {
+        ctx.explain()->recordStage(stage, timer.nsecsElapsed() / 1000);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Interns the target names and returns them sorted and without duplicates
+QVector<Lvk::Nlp::SymbolId> internTargets(const QStringList &names)
+{
+    QVector<Lvk::Nlp::SymbolId> targets;
+
+    foreach (QString name, names) {
+        Lvk::Nlp::SymbolId id = Lvk::Nlp::SymbolTable::instance()->intern(name);
+        if (!targets.contains(id)) {
+            targets.append(id);
+        }
+    }
+
+    qSort(targets);
+
+    return targets;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Node types used to write and read trees
+
+enum NodeType
+{
+    BaseNodeType,
+    WordNodeType,
+    WildcardNodeType,
+    VariableNodeType
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void writeNode(QDataStream &stream, const Lvk::Nlp::Node *node)
+{
+    if (const Lvk::Nlp::WordNode *wNode = node->to<Lvk::Nlp::WordNode>()) {
+        stream << (quint8)WordNodeType << wNode->word;
+    } else if (const Lvk::Nlp::WildcardNode *wcNode = node->to<Lvk::Nlp::WildcardNode>()) {
+        stream << (quint8)WildcardNodeType << (qint32)wcNode->min << (qint32)wcNode->max;
+    } else if (const Lvk::Nlp::VariableNode *varNode = node->to<Lvk::Nlp::VariableNode>()) {
+        stream << (quint8)VariableNodeType << varNode->varName;
+    } else {
+        stream << (quint8)BaseNodeType;
+    }
+
+    stream << (quint32)node->omap.size();
+
+    // Outputs are written once per rule, see writeOutputs()
+    stream << node->omap.keys();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Node * readNode(QDataStream &stream, const Lvk::Nlp::RuleOutputsMap &outputs)
+{
+    Lvk::Nlp::Node *node = 0;
+
+    quint8 type = 0;
+    stream >> type;
+
+    switch (type) {
+    case BaseNodeType:
+        node = new Lvk::Nlp::Node();
+        break;
+    case WordNodeType: {
+        Lvk::Nlp::WordNode *wNode = new Lvk::Nlp::WordNode();
+        stream >> wNode->word;
+        node = wNode;
+        break;
+    }
+    case WildcardNodeType: {
+        qint32 min = 0;
+        qint32 max = 0;
+        stream >> min >> max;
+        node = new Lvk::Nlp::WildcardNode(min, max);
+        break;
+    }
+    case VariableNodeType: {
+        Lvk::Nlp::VariableNode *varNode = new Lvk::Nlp::VariableNode();
+        stream >> varNode->varName;
+        node = varNode;
+        break;
+    }
+    default:
+        return 0;
+    }
+
+    QList<quint64> omapIds;
+    stream >> omapIds;
+
+    foreach (quint64 id, omapIds) {
+        Lvk::Nlp::RuleOutputsMap::const_iterator it = outputs.constFind(getRuleId(id));
+        if (it == outputs.constEnd()) {
+            delete node;
+            return 0;
+        }
+        node->omap[id] = *it;
+    }
+
+    return node;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Writes root and all the nodes reachable from it. Nodes are indexed in BFS order. Since
+// wildcards and variables add extra edges, the same node can be reached several times but it
+// is written only once.
+void writeNodes(QDataStream &stream, const Lvk::Nlp::Node *root)
+{
+    QList<const Lvk::Nlp::Node *> nodes;
+    QHash<const Lvk::Nlp::Node *, qint32> indexes;
+
+    nodes.append(root);
+    indexes[root] = 0;
+
+    for (int i = 0; i < nodes.size(); ++i) {
+        foreach (const Lvk::Nlp::Node *child, nodes[i]->childs()) {
+            if (!indexes.contains(child)) {
+                indexes[child] = nodes.size();
+                nodes.append(child);
+            }
+        }
+    }
+
+    stream << (quint32)nodes.size();
+
+    foreach (const Lvk::Nlp::Node *node, nodes) {
+        writeNode(stream, node);
+
+        stream << indexes.value(node->parent, -1);
+        stream << (quint32)node->childs().size();
+
+        foreach (const Lvk::Nlp::Node *child, node->childs()) {
+            stream << indexes[child];
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Reads the nodes written by writeNodes() and links them. Output maps share the given outputs
+// of each rule. On success, nodes[0] is the root and owns the other nodes. Otherwise; returns
+// false and nodes is empty.
+bool readNodes(QDataStream &stream, QVector<Lvk::Nlp::Node *> &nodes,
+               const Lvk::Nlp::RuleOutputsMap &outputs)
+{
+    quint32 size = 0;
+    stream >> size;
+
+    if (stream.status() != QDataStream::Ok || size == 0) {
+        return false;
+    }
+
+    QVector<qint32> parents;
+    QVector< QVector<qint32> > childs;
+
+    nodes.reserve(size);
+    parents.reserve(size);
+    childs.reserve(size);
+
+    bool ok = true;
+
+    for (quint32 i = 0; i < size && ok; ++i) {
+        Lvk::Nlp::Node *node = readNode(stream, outputs);
+
+        qint32 parent = -1;
+        quint32 childCount = 0;
+        stream >> parent >> childCount;
+
+        QVector<qint32> nodeChilds;
+        for (quint32 j = 0; j < childCount && stream.status() == QDataStream::Ok; ++j) {
+            qint32 child = -1;
+            stream >> child;
+            nodeChilds.append(child);
+        }
+
+        // Child and parent indexes must be valid
+        ok = node && stream.status() == QDataStream::Ok && parent < (qint32)size;
+        foreach (qint32 child, nodeChilds) {
+            ok = ok && child >= 0 && child < (qint32)size;
+        }
+
+        if (node) {
+            nodes.append(node);
+        }
+        parents.append(parent);
+        childs.append(nodeChilds);
+    }
+
+    if (!ok) {
+        // Nodes are not linked yet, so they must be deleted one by one
+        qDeleteAll(nodes);
+        nodes.clear();
+        return false;
+    }
+
+    for (int i = 0; i < nodes.size(); ++i) {
+        Lvk::Nlp::Node *node = nodes[i];
+
+        node->parent = parents[i] >= 0 ? nodes[parents[i]] : 0;
+
+        foreach (qint32 child, childs[i]) {
+            node->appendChild(nodes[child]);
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns root and all the nodes reachable from it
+QSet<const Lvk::Nlp::Node *> reachableNodes(const Lvk::Nlp::Node *root)
+{
+    QSet<const Lvk::Nlp::Node *> visited;
+    QList<const Lvk::Nlp::Node *> pending;
+
+    visited.insert(root);
+    pending.append(root);
+
+    while (!pending.isEmpty()) {
+        const Lvk::Nlp::Node *node = pending.takeLast();
+
+        foreach (const Lvk::Nlp::Node *child, node->childs()) {
+            if (!visited.contains(child)) {
+                visited.insert(child);
+                pending.append(child);
+            }
+        }
+    }
+
+    return visited;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns true if some node is a child of a node other than its parent or, if its parent is a
+// *, the parent of its parent. Tree::add() never creates such edges, so the nodes were
+// minimized. See Tree::minimize()
+bool hasSharedNodes(const QVector<Lvk::Nlp::Node *> &nodes)
+{
+    foreach (const Lvk::Nlp::Node *node, nodes) {
+        foreach (const Lvk::Nlp::Node *child, node->childs()) {
+            const Lvk::Nlp::Node *parent = child->parent;
+
+            if (child == node || parent == node) {
+                continue;
+            }
+
+            const Lvk::Nlp::WildcardNode *wcParent = parent
+                    ? parent->to<Lvk::Nlp::WildcardNode>() : 0;
+
+            if (!wcParent || wcParent->min != 0 || wcParent->parent != node) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns a key that is the same for two nodes only if they have the same type and word,
+// wildcard range or variable name, the same output map entries and the same childs. Loops are
+// written as a null child, so two nodes with a loop can have the same key.
+QByteArray nodeKey(const Lvk::Nlp::Node *node)
+{
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+
+    stream << (quint8)node->type();
+
+    if (const Lvk::Nlp::WordNode *wNode = node->to<Lvk::Nlp::WordNode>()) {
+        stream << wNode->word;
+    } else if (const Lvk::Nlp::WildcardNode *wcNode = node->to<Lvk::Nlp::WildcardNode>()) {
+        stream << (qint32)wcNode->min << (qint32)wcNode->max;
+    } else if (const Lvk::Nlp::VariableNode *varNode = node->to<Lvk::Nlp::VariableNode>()) {
+        stream << varNode->varName;
+    }
+
+    QList<quint64> omapIds = node->omap.keys();
+    qSort(omapIds);
+
+    stream << omapIds;
+
+    foreach (const Lvk::Nlp::Node *child, node->childs()) {
+        stream << (quint64)(child != node ? (quintptr)child : 0);
+    }
+
+    return key;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns true if words is a rule input with the form "* phrase *" where the phrase only has
+// words, i.e. an input that matches any user input that contains the phrase
+bool isPhraseInput(const Lvk::Nlp::WordList &words)
+{
+    if (words.size() < 3 || !words.first().isStar() || !words.last().isStar()) {
+        return false;
+    }
+
+    for (int i = 1; i < words.size() - 1; ++i) {
+        if (!words[i].isWord()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Removes apostrophes in a single pass. Inputs without apostrophes are returned as is, so they
+// are not copied.
+inline QString removeApostrophes(const QString &input)
+{
+    int i = input.indexOf('\'');
+
+    if (i == -1) {
+        return input;
+    }
+
+    QString szInput = input.left(i);
+    szInput.reserve(input.size() - 1);
+
+    for (++i; i < input.size(); ++i) {
+        if (input[i] != '\'') {
+            szInput.append(input[i]);
+        }
+    }
+
+    return szInput;
+}
+
+// Returns the lemmas of a parsed rule input for the vector index. Wildcards, variables and
+// symbols are NullSymbol's, so they split phrases.
+QVector<Lvk::Nlp::SymbolId> inputLemmas(const Lvk::Nlp::WordList &words)
+{
+    QVector<Lvk::Nlp::SymbolId> lemmas;
+    lemmas.reserve(words.size());
+
+    for (int i = 0; i < words.size(); ++i) {
+        lemmas.append(words[i].isWord() ? words[i].lemmaId : Lvk::Nlp::NullSymbol);
+    }
+
+    return lemmas;
+}
+
+// Returns the lemmas of a parsed user input for the vector index. Wildcards are skipped and
+// words unknown to the symbol table are NullSymbol's.
+QVector<Lvk::Nlp::SymbolId> userLemmas(const Lvk::Nlp::WordList &words)
+{
+    QVector<Lvk::Nlp::SymbolId> lemmas;
+    lemmas.reserve(words.size());
+
+    for (int i = 0; i < words.size(); ++i) {
+        if (!words[i].isWildcard()) {
+            lemmas.append(words[i].lemmaId);
+        }
+    }
+
+    return lemmas;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// A node expanded by Tree::scoredDFS(): its childs paired with their match weights and the
+// index of the next one to visit
+struct DfsFrame
+{
+    QVector< QPair<const Lvk::Nlp::Node *, float> > childs;
+    int next;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Rules that created more nodes and edges first, then the slowest ones
+bool costlier(const Lvk::Nlp::RuleCost &c1, const Lvk::Nlp::RuleCost &c2)
+{
+    return c1.size() != c2.size() ? c1.size() > c2.size() : c1.usecs() > c2.usecs();
+}
+
 } // namespace
 
 //--------------------------------------------------------------------------------------------------
 // Tree
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::Tree::Tree()
-    : m_root(new Nlp::Node()),
-      m_matchPolicy(new Nlp::MatchPolicy())
-{
+Lvk::Nlp::Tree::Tree(Nlp::MatchPolicy::Mode matchMode /*= Nlp::MatchPolicy::LemmaMatch*/,
+                     QSharedPointer<Nlp::Toolchain> tools /*= QSharedPointer<Nlp::Toolchain>()*/)
+    : m_root(new Nlp::Node()),
+      m_phraseRoot(new Nlp::Node()),
+      m_matchPolicy(new Nlp::MatchPolicy(matchMode)),
+      m_tools(tools),
+      m_profiling(false),
+      m_curCost(0),
+      m_minimized(false),
+      m_minimizedNodes(0),
+      m_outputSource(0),
+      m_literalDirty(1),
+      m_filterDirty(1),
+      m_fuzzyDirty(1),
+      m_vectorDirty(1)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Tree::~Tree()
+{
+    delete m_matchPolicy;
+    delete m_root;
+    delete m_phraseRoot;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline Lvk::Nlp::Toolchain * Lvk::Nlp::Tree::tools() const
+{
+    return m_tools ? m_tools.data() : Nlp::GlobalTools::instance();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::add(const Nlp::Rule &rule)
+{
+    add(Nlp::RuleList() << rule);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::add(const Nlp::RuleList &rules)
+{
+    if (m_profiling) {
+        // Lemmatize each rule apart to know its time
+        foreach (const Nlp::Rule &rule, rules) {
+            QElapsedTimer timer;
+            timer.start();
+
+            QList<Nlp::WordList> lemmatized;
+            tools()->lemmatizeBatch(rule.input(), lemmatized);
+
+            qint64 usecs = timer.nsecsElapsed() / 1000;
+
+            add(rule, lemmatized);
+
+            m_ruleCosts[rule.id()].lemmatizeUsecs = usecs;
+        }
+        return;
+    }
+
+    // Lemmatize the inputs of all rules at once
+
+    QStringList inputs;
+
+    foreach (const Nlp::Rule &rule, rules) {
+        inputs.append(rule.input());
+    }
+
+    QList<Nlp::WordList> lemmatized;
+
+    tools()->lemmatizeBatch(inputs, lemmatized);
+
+    // Add each rule
+
+    for (int i = 0, j = 0; i < rules.size(); ++i) {
+        const Nlp::Rule &rule = rules[i];
+        int inputCount = rule.input().size();
+
+        add(rule, lemmatized.mid(j, inputCount));
+
+        j += inputCount;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::add(const Nlp::Rule &rule, const QList<Nlp::WordList> &lemmatized)
+{
+    // Nodes of a minimized tree can be shared by several paths, adding nodes would change all
+    if (m_minimized) {
+        qCritical() << "Nlp::Tree: Cannot add rule id" << rule.id() << "to a minimized tree";
+        return;
+    }
+
+    QSet<PairedNode> onodes;    // Set of nodes with output
+
+    QElapsedTimer timer;
+    Nlp::RuleCost cost(rule.id());
+
+    if (m_profiling) {
+        timer.start();
+        m_curCost = &cost;
+    }
+
+    // A rule added again replaces its inputs
+    m_vectorIndex.remove(rule.id());
+
+    // Parse each rule input and add nodes in the tree
+
+    for (int i = 0; i < rule.input().size() && i < lemmatized.size(); ++i) {
+
+        qDebug() << "Nlp::Tree: Parsing rule id" << rule.id() << "input #" << i;
+
+        Nlp::WordList words = lemmatized[i];
+        parseRuleInput(words);
+
+        if (words.isEmpty()) {
+            continue;
+        }
+
+        m_vectorIndex.add(rule.id(), i, inputLemmas(words));
+
+        ++cost.inputs;
+        cost.words += words.size();
+
+        // Inputs with the form "* phrase *" are added to the phrase trie instead. The tree
+        // would try the phrase at every offset of every user input.
+        if (isPhraseInput(words)) {
+            Nlp::Node *curNode = m_phraseRoot;
+
+            for (int j = 1; j < words.size() - 1; ++j) {
+                curNode = addNode(words[j], curNode);
+            }
+
+            onodes.insert(PairedNode(i, curNode));
+            continue;
+        }
+
+        Nlp::Node *curNode = m_root;
+
+        for (int j = 0; j < words.size(); ++j) {
+            curNode = addNode(words[j], curNode);
+        }
+
+        onodes.insert(PairedNode(i, curNode));
+
+        if (words.last().isStar() && curNode->parent != m_root) {
+            onodes.insert(PairedNode(i, curNode->parent));
+        }
+    }
+
+    // Add rule output to each node in onodes
+
+    addNodeOutput(rule, onodes);
+
+    if (m_profiling) {
+        cost.omapEntries = onodes.size();
+        cost.buildUsecs = timer.nsecsElapsed() / 1000;
+        m_ruleCosts[rule.id()] = cost;
+        m_curCost = 0;
+    }
+
+    m_literalDirty = 1;
+    m_filterDirty = 1;
+    m_fuzzyDirty = 1;
+    m_vectorDirty = 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::addNodeOutput(const Lvk::Nlp::Rule &rule, const QSet<PairedNode> &onodes)
+{
+    if (onodes.isEmpty()) {
+        return;
+    }
+
+    setRuleTargets(rule.id(), internTargets(rule.target()));
+
+    // Build list of outputs with their condition
+
+    Nlp::CondOutputList l = parseOutputs(rule);
+
+    // Add the output list to all nodes in onodes.
+    // Because CondOutputList inherits the "Implicit Shared Model" from QList, all These
+    // copies don't waste a lot of memory
+
+    QList<Nlp::Node *> &ruleNodes = m_ruleNodes[rule.id()];
+
+    foreach (const PairedNode &onode, onodes) {
+        onode.second->omap[getOmapId(rule.id(), onode.first)] = l;
+
+        if (!ruleNodes.contains(onode.second)) {
+            ruleNodes.append(onode.second);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the parsed outputs of the rule, shared with the output source if it has the same ones
+Lvk::Nlp::CondOutputList Lvk::Nlp::Tree::parseOutputs(const Lvk::Nlp::Rule &rule)
+{
+    if (m_outputSource) {
+        RuleOutputsMap::const_iterator it = m_outputSource->m_ruleOutputs.constFind(rule.id());
+
+        if (it != m_outputSource->m_ruleOutputs.constEnd() && it->rawOutputs() == rule.output()
+                && it->randomOutput() == rule.randomOutput()) {
+            m_ruleOutputs[rule.id()] = *it;
+            return *it;
+        }
+    }
+
+    Nlp::CondOutputList l(rule.output(), rule.randomOutput());
+
+    m_ruleOutputs[rule.id()] = l;
+
+    return l;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::setOutputSource(const Nlp::Tree *tree)
+{
+    m_outputSource = tree;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::setProfiling(bool enabled)
+{
+    m_profiling = enabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::RuleCostList Lvk::Nlp::Tree::ruleCosts() const
+{
+    Nlp::RuleCostList costs = m_ruleCosts.values();
+
+    qSort(costs.begin(), costs.end(), costlier);
+
+    return costs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::remove(Nlp::RuleId ruleId)
+{
+    m_vectorIndex.remove(ruleId);
+    m_vectorDirty = 1;
+
+    m_ruleOutputs.remove(ruleId);
+    m_ruleCosts.remove(ruleId);
+
+    RuleNodesMap::iterator rit = m_ruleNodes.find(ruleId);
+
+    if (rit == m_ruleNodes.end()) {
+        return;
+    }
+
+    qDebug() << "Nlp::Tree: Removing rule id" << ruleId;
+
+    foreach (Nlp::Node *node, *rit) {
+        Nlp::OutputMap::iterator it = node->omap.begin();
+        while (it != node->omap.end()) {
+            if (getRuleId(it.key()) == ruleId) {
+                it = node->omap.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    m_ruleNodes.erase(rit);
+
+    removeRuleTargets(ruleId);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::Tree::minimize()
+{
+    int nodeCount = reachableNodes(m_root).size() + reachableNodes(m_phraseRoot).size();
+
+    QHash<Nlp::Node *, Nlp::Node *> merged;     // node -> node kept instead, 0 if pruned
+    QHash<QByteArray, Nlp::Node *> uniqueNodes; // nodeKey() -> node kept
+
+    minimizeNode(m_root, merged, uniqueNodes);
+    prunePhraseNode(m_phraseRoot);
+
+    // Merged nodes have the same output map entries than the ones kept instead
+
+    for (RuleNodesMap::iterator it = m_ruleNodes.begin(); it != m_ruleNodes.end(); ++it) {
+        QList<Nlp::Node *> ruleNodes;
+        foreach (Nlp::Node *node, *it) {
+            Nlp::Node *kept = merged.value(node, node);
+            if (kept && !ruleNodes.contains(kept)) {
+                ruleNodes.append(kept);
+            }
+        }
+        *it = ruleNodes;
+    }
+
+    // Nodes kept instead of others may have lost their parent
+
+    QSet<const Nlp::Node *> nodes = reachableNodes(m_root);
+
+    foreach (const Nlp::Node *node, nodes) {
+        foreach (Nlp::Node *child, node->childs()) {
+            if (child != node && !nodes.contains(child->parent)) {
+                child->parent = const_cast<Nlp::Node *>(node);
+            }
+        }
+    }
+
+    int nodesLeft = nodes.size() + reachableNodes(m_phraseRoot).size();
+    int removed = nodeCount - nodesLeft;
+
+    qDebug() << "Nlp::Tree: Minimized tree from" << nodeCount << "to" << nodesLeft << "nodes";
+
+    m_minimized = true;
+    m_minimizedNodes += removed;
+    m_literalDirty = 1;
+    m_filterDirty = 1;
+    m_fuzzyDirty = 1;
+
+    return removed;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Minimizes the subtree of node bottom-up. Returns the node to use instead of node, which is
+// node itself, an equal node visited before, or 0 if the subtree has no outputs.
+Lvk::Nlp::Node * Lvk::Nlp::Tree::minimizeNode(Nlp::Node *node,
+                                              QHash<Nlp::Node *, Nlp::Node *> &merged,
+                                              QHash<QByteArray, Nlp::Node *> &uniqueNodes)
+{
+    // Nodes after a * have two parents, the * and its parent, so they are reached twice
+    QHash<Nlp::Node *, Nlp::Node *>::const_iterator it = merged.constFind(node);
+    if (it != merged.constEnd()) {
+        return *it;
+    }
+
+    QList<Nlp::Node *> childs;
+
+    foreach (Nlp::Node *child, node->childs()) {
+        Nlp::Node *kept = child != node ? minimizeNode(child, merged, uniqueNodes) : node;
+        if (kept && !childs.contains(kept)) {
+            childs.append(kept);
+        }
+    }
+
+    if (childs != node->childs()) {
+        node->setChilds(childs);
+    }
+
+    bool leaf = childs.isEmpty() || (childs.size() == 1 && childs.first() == node);
+
+    if (node != m_root && leaf && node->omap.isEmpty()) {
+        merged[node] = 0;
+        return 0;
+    }
+
+    Nlp::Node *&kept = uniqueNodes[nodeKey(node)];
+    if (!kept) {
+        kept = node;
+    }
+
+    merged[node] = kept;
+
+    return kept;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Prunes the subtrees of node without outputs. Unlike minimizeNode(), equal nodes are not
+// merged, every phrase node keeps a single parent. Returns true if node is still needed.
+bool Lvk::Nlp::Tree::prunePhraseNode(Nlp::Node *node)
+{
+    QList<Nlp::Node *> childs;
+
+    foreach (Nlp::Node *child, node->childs()) {
+        if (prunePhraseNode(child)) {
+            childs.append(child);
+        }
+    }
+
+    if (childs.size() != node->childs().size()) {
+        node->setChilds(childs);
+    }
+
+    return !childs.isEmpty() || !node->omap.isEmpty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::isMinimized() const
+{
+    return m_minimized;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::setRuleTargets(Nlp::RuleId ruleId, const TargetSet &targets)
+{
+    // A rule added again replaces its targets
+    if (m_ruleNodes.contains(ruleId)) {
+        removeRuleTargets(ruleId);
+    }
+
+    if (targets.isEmpty()) {
+        ++m_targetRules[Nlp::NullSymbol];
+        return;
+    }
+
+    m_ruleTargets[ruleId] = targets;
+
+    foreach (Nlp::SymbolId target, targets) {
+        ++m_targetRules[target];
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::removeRuleTargets(Nlp::RuleId ruleId)
+{
+    TargetSet targets = m_ruleTargets.take(ruleId);
+
+    if (targets.isEmpty()) {
+        targets.append(Nlp::NullSymbol);
+    }
+
+    foreach (Nlp::SymbolId target, targets) {
+        if (--m_targetRules[target] <= 0) {
+            m_targetRules.remove(target);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::matchesTarget(Nlp::RuleId ruleId, Nlp::SymbolId target) const
+{
+    RuleTargetsMap::const_iterator it = m_ruleTargets.find(ruleId);
+
+    if (it == m_ruleTargets.constEnd()) {
+        return target == Nlp::NullSymbol;
+    }
+
+    return qBinaryFind(it->constBegin(), it->constEnd(), target) != it->constEnd();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::shareTarget(Nlp::RuleId ruleId1, Nlp::RuleId ruleId2) const
+{
+    TargetSet targets1 = m_ruleTargets.value(ruleId1, TargetSet() << Nlp::NullSymbol);
+    TargetSet targets2 = m_ruleTargets.value(ruleId2, TargetSet() << Nlp::NullSymbol);
+
+    // Both sets are sorted
+    for (int i = 0, j = 0; i < targets1.size() && j < targets2.size(); ) {
+        if (targets1[i] == targets2[j]) {
+            return true;
+        } else if (targets1[i] < targets2[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::isEmpty() const
+{
+    return m_ruleNodes.isEmpty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::flatten(Nlp::FlatTree &flat) const
+{
+    flat.build(m_root, m_phraseRoot);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Nlp::Node * Lvk::Nlp::Tree::root() const
+{
+    return m_root;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Nlp::Node * Lvk::Nlp::Tree::phraseRoot() const
+{
+    return m_phraseRoot;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::hasTarget(Nlp::SymbolId target) const
+{
+    return m_targetRules.contains(target);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::save(QDataStream &stream) const
+{
+    stream << (quint32)m_ruleOutputs.size();
+
+    for (RuleOutputsMap::const_iterator it = m_ruleOutputs.constBegin();
+         it != m_ruleOutputs.constEnd(); ++it) {
+        stream << (quint64)it.key() << it->rawOutputs() << it->randomOutput();
+    }
+
+    writeNodes(stream, m_root);
+    writeNodes(stream, m_phraseRoot);
+
+    Nlp::SymbolTable *symbols = Nlp::SymbolTable::instance();
+
+    stream << (quint32)m_ruleTargets.size();
+
+    for (RuleTargetsMap::const_iterator it = m_ruleTargets.constBegin();
+         it != m_ruleTargets.constEnd(); ++it) {
+        QStringList names;
+        foreach (Nlp::SymbolId target, *it) {
+            names.append(symbols->string(target));
+        }
+        stream << (quint64)it.key() << names;
+    }
+
+    m_vectorIndex.save(stream);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::load(QDataStream &stream)
+{
+    // Outputs are parsed once per rule and shared by all its nodes
+
+    quint32 outputsSize = 0;
+    stream >> outputsSize;
+
+    RuleOutputsMap ruleOutputs;
+
+    for (quint32 i = 0; i < outputsSize && stream.status() == QDataStream::Ok; ++i) {
+        quint64 ruleId = 0;
+        QStringList outputs;
+        bool random = false;
+        stream >> ruleId >> outputs >> random;
+        ruleOutputs[ruleId] = Nlp::CondOutputList(outputs, random);
+    }
+
+    QVector<Nlp::Node *> nodes;
+    QVector<Nlp::Node *> phraseNodes;
+
+    bool ok = stream.status() == QDataStream::Ok
+            && readNodes(stream, nodes, ruleOutputs)
+            && readNodes(stream, phraseNodes, ruleOutputs);
+
+    // Rule targets
+
+    quint32 targetsSize = 0;
+    if (ok) {
+        stream >> targetsSize;
+    }
+
+    RuleTargetsMap ruleTargets;
+
+    for (quint32 i = 0; i < targetsSize && stream.status() == QDataStream::Ok; ++i) {
+        quint64 ruleId = 0;
+        QStringList names;
+        stream >> ruleId >> names;
+        ruleTargets[ruleId] = internTargets(names);
+    }
+
+    Nlp::VectorIndex vectorIndex;
+
+    ok = ok && stream.status() == QDataStream::Ok && vectorIndex.load(stream);
+
+    if (!ok) {
+        qCritical() << "Nlp::Tree: Cannot load tree: Invalid format";
+        delete nodes.value(0);
+        delete phraseNodes.value(0);
+        return false;
+    }
+
+    RuleNodesMap ruleNodes;
+
+    foreach (Nlp::Node *node, nodes + phraseNodes) {
+        foreach (quint64 id, node->omap.keys()) {
+            QList<Nlp::Node *> &l = ruleNodes[getRuleId(id)];
+            if (!l.contains(node)) {
+                l.append(node);
+            }
+        }
+    }
+
+    QHash<Nlp::SymbolId, int> targetRules;
+
+    foreach (Nlp::RuleId ruleId, ruleNodes.keys()) {
+        TargetSet targets = ruleTargets.value(ruleId, TargetSet() << Nlp::NullSymbol);
+        foreach (Nlp::SymbolId target, targets) {
+            ++targetRules[target];
+        }
+    }
+
+    bool minimized = hasSharedNodes(nodes);
+
+    delete m_root;
+    delete m_phraseRoot;
+    m_root = nodes[0];
+    m_phraseRoot = phraseNodes[0];
+    m_ruleNodes = ruleNodes;
+    m_ruleOutputs = ruleOutputs;
+    m_ruleTargets = ruleTargets;
+    m_targetRules = targetRules;
+    m_vectorIndex = vectorIndex;
+    m_ruleCosts.clear();
+    m_minimized = minimized;
+    m_minimizedNodes = 0;
+    m_literalDirty = 1;
+    m_filterDirty = 1;
+    m_fuzzyDirty = 1;
+    m_vectorDirty = 1;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::lint(Nlp::RuleIssueList &issues, QSet<RuleInput> &inputs) const
+{
+    // Wildcards and variables add extra edges, so the same node can be reached several times
+
+    QSet<const Nlp::Node *> visited;
+    QList<const Nlp::Node *> pending;
+
+    visited.insert(m_root);
+    visited.insert(m_phraseRoot);
+    pending.append(m_root);
+    pending.append(m_phraseRoot);
+
+    while (!pending.isEmpty()) {
+        const Nlp::Node *node = pending.takeLast();
+
+        foreach (const Nlp::Node *child, node->childs()) {
+            if (!visited.contains(child)) {
+                visited.insert(child);
+                pending.append(child);
+            }
+        }
+
+        lintNode(node, issues, inputs);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QVariantMap Lvk::Nlp::Tree::memoryReport() const
+{
+    int wordNodes = 0;
+    int wildcardNodes = 0;
+    int variableNodes = 0;
+    int omapEntries = 0;
+    int outputs = 0;
+
+    QSet<const Nlp::Node *> visited;
+    QList<const Nlp::Node *> pending;
+
+    visited.insert(m_root);
+    visited.insert(m_phraseRoot);
+    pending.append(m_root);
+    pending.append(m_phraseRoot);
+
+    while (!pending.isEmpty()) {
+        const Nlp::Node *node = pending.takeLast();
+
+        foreach (const Nlp::Node *child, node->childs()) {
+            if (!visited.contains(child)) {
+                visited.insert(child);
+                pending.append(child);
+            }
+        }
+
+        switch (node->type()) {
+        case Nlp::Node::WordType:
+            ++wordNodes;
+            break;
+        case Nlp::Node::WildcardType:
+            ++wildcardNodes;
+            break;
+        case Nlp::Node::VariableType:
+            ++variableNodes;
+            break;
+        default:
+            break;
+        }
+
+        omapEntries += node->omap.size();
+
+        foreach (const Nlp::CondOutputList &outputList, node->omap) {
+            outputs += outputList.size();
+        }
+    }
+
+    int literalIndexEntries = 0;
+    {
+        QMutexLocker locker(&m_literalMutex);
+        literalIndexEntries = m_literalIndex.size();
+    }
+
+    int fuzzyIndexWords = 0;
+    {
+        QMutexLocker locker(&m_fuzzyMutex);
+        fuzzyIndexWords = m_fuzzyIndex.size();
+    }
+
+    int vectorIndexInputs = 0;
+    {
+        QMutexLocker locker(&m_vectorMutex);
+        vectorIndexInputs = m_vectorIndex.size();
+    }
+
+    int targets = m_targetRules.size() - (m_targetRules.contains(Nlp::NullSymbol) ? 1 : 0);
+
+    QVariantMap report;
+    report["nodes"] = visited.size();
+    report["wordNodes"] = wordNodes;
+    report["wildcardNodes"] = wildcardNodes;
+    report["variableNodes"] = variableNodes;
+    report["omapEntries"] = omapEntries;
+    report["outputs"] = outputs;
+    report["literalIndexEntries"] = literalIndexEntries;
+    report["fuzzyIndexWords"] = fuzzyIndexWords;
+    report["vectorIndexInputs"] = vectorIndexInputs;
+    report["targets"] = targets;
+    report["minimizedNodes"] = m_minimizedNodes;
+
+    return report;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::lintNode(const Nlp::Node *node, Nlp::RuleIssueList &issues,
+                              QSet<RuleInput> &inputs) const
+{
+    if (node->omap.isEmpty()) {
+        return;
+    }
+
+    // Outputs are tried in the omap order, the first one of a rule with the search target
+    // wins. See getResultsForNode()
+
+    QList<quint64> previous;
+
+    for (Nlp::OutputMap::const_iterator it = node->omap.constBegin();
+         it != node->omap.constEnd(); ++it) {
+        Nlp::RuleId ruleId = getRuleId(it.key());
+        int inputIdx = getInputIndex(it.key());
+
+        inputs.insert(RuleInput(ruleId, inputIdx));
+
+        // Only inputs of rules with a common target can shadow this one
+        int winner = 0;
+        while (winner < previous.size() && !shareTarget(getRuleId(previous[winner]), ruleId)) {
+            ++winner;
+        }
+
+        previous.append(it.key());
+
+        // Inputs ending with * also end in the wildcard node, so they still match there
+        if (winner == previous.size() - 1 || hasWildcardOutput(node, it.key())) {
+            continue;
+        }
+
+        quint64 winnerId = previous[winner];
+
+        Nlp::RuleIssue::Type type = hasWildcardOutput(node, winnerId)
+                ? Nlp::RuleIssue::ShadowedByWildcard : Nlp::RuleIssue::DuplicatedInput;
+
+        issues.append(Nlp::RuleIssue(type, ruleId, inputIdx, getRuleId(winnerId),
+                                     getInputIndex(winnerId)));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::hasWildcardOutput(const Nlp::Node *node, quint64 omapId) const
+{
+    // True if the input also ends in a * child, i.e. the input ends with a * operator
+    foreach (const Nlp::Node *child, node->childs()) {
+        if (child != node && child->is<Nlp::WildcardNode>() && child->omap.contains(omapId)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Node * Lvk::Nlp::Tree::addNode(const Nlp::Word &word, Nlp::Node *parent)
+{
+    // If node already exists for the given word, return that node
+
+    if (word.isWord()) {
+        foreach (int i, parent->matchingChilds(word)) {
+            Nlp::Node *node = parent->childs()[i];
+            if (Nlp::WordNode* wNode = node->to<Nlp::WordNode>()) {
+                if (wNode->word == word) {
+                    return node;
+                }
+            }
+        }
+    }
+
+    if (word.isWildcard()) {
+        foreach (Nlp::Node *node, parent->childs()) {
+            if (Nlp::WildcardNode* wcNode = node->to<Nlp::WildcardNode>()) {
+                // Currently we only support two wildcards: * and +
+                // We must handle the case where new node is a * node and we already have
+                // a + node
+                if (word.isStar() && wcNode->min == 1) {
+                    wcNode->min = 0;
+                }
+                return node;
+            }
+        }
+    }
+
+    if (word.isVariable()) {
+        // TODO check
+    }
+
+    // Otherwise, add new node
+
+    Nlp::Node *newNode = 0;
+
+    if (word.isWildcard()) {
+        newNode = new Nlp::WildcardNode(word.origWord, parent);
+        newNode->appendChild(newNode); // Loop node (see engine documentation)
+    } else if (word.isVariable()) {
+        QString varName = word.origWord.mid(1, word.origWord.size() - 2); // Remove square braces
+        newNode = new Nlp::VariableNode(varName, parent);
+        newNode->appendChild(newNode); // Loop node (see engine documentation)
+    } else {
+        newNode = new Nlp::WordNode(word, parent);
+    }
+
+    parent->appendChild(newNode);
+
+    // If parent is *, we need to add a new edge from parent->parent to newNode.
+    // Rule inputs never have two or more adjacent *, checkSyntax() merges them
+    bool skipsStar = parent->is<Nlp::WildcardNode>() && parent->to<Nlp::WildcardNode>()->min == 0;
+
+    if (skipsStar) {
+        parent->parent->appendChild(newNode);
+    }
+
+    if (m_curCost) {
+        ++m_curCost->nodes;
+        m_curCost->wildcardEdges += (word.isWildcard() || word.isVariable() ? 1 : 0)
+                + (skipsStar ? 1 : 0);
+    }
+
+    qDebug() << "Nlp::Tree: Added new node" << *newNode << "with parent" << *parent;
+
+    return newNode;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::getResponse(const QString &input, Nlp::Result &result) const
+{
+    Nlp::SearchContext ctx;
+
+    getResponse(input, result, ctx);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::getResponse(const QString &input, Nlp::Result &result,
+                                 Nlp::SearchContext &ctx) const
+{
+    bool nested = !ctx.isEmpty();
+    QElapsedTimer timer;
+    timer.start();
+
+    Nlp::WordList words;
+    parseUserInput(input, words);
+
+    recordStage(ctx, Nlp::EngineStats::LemmatizeStage, timer, nested);
+
+    getResponse(words, result, ctx);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::getResponse(const Nlp::WordList &words, Nlp::Result &result,
+                                 Nlp::SearchContext &ctx) const
+{
+    LVK_PROFILE("Tree::getResponse");
+
+    result.clear();
+
+    bool nested = !ctx.isEmpty();
+    QElapsedTimer timer;
+    timer.start();
+
+    ctx.push(true);
+    ctx.stack().setWords(&words);
+
+    // Results are only appended if they beat the best score so far, so the last one is the best
+    Nlp::ResultList results;
+    if (!getLiteralResults(results, words, ctx)) {
+        lookupFuzzyCandidates(words, ctx);
+        getPhraseResults(results, words, ctx);
+        setTokenMasks(words, ctx);
+        scoredDFS(results, m_root, words, ctx);
+    }
+
+    recordStage(ctx, Nlp::EngineStats::SearchStage, timer, nested);
+
+    if (ctx.isAborted()) {
+        discardAbortedResults(results, words, ctx);
+    }
+
+    if (!results.isEmpty()) {
+        result = results.last();
+    } else if (!nested && !ctx.isAborted() && ctx.minSimilarity() > 0) {
+        getSimilarResult(words, result, ctx);
+    }
+
+    ctx.pop();
+
+    if (ctx.isEmpty()) {
+        ctx.loopDetector().clear();
+        ctx.memo().clear();
+    }
+
+    LVK_TRACE(Nlp) << "Nlp::Tree: Best result: " << result;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+const Lvk::Nlp::CondOutputList * Lvk::Nlp::Tree::constantOutputs(Nlp::RuleId ruleId,
+                                                                  int inputIdx) const
+{
+    quint64 omapId = getOmapId(ruleId, inputIdx);
+    const Nlp::CondOutputList *outputs = 0;
+
+    foreach (const Nlp::Node *node, m_ruleNodes.value(ruleId)) {
+        Nlp::OutputMap::const_iterator it = node->omap.find(omapId);
+
+        if (it != node->omap.constEnd()) {
+            // Inputs ending with a wildcard have one output list per node. A search could
+            // use any of them, so they are not constant
+            if (outputs) {
+                return 0;
+            }
+            outputs = &it.value();
+        }
+    }
+
+    return outputs && outputs->isConstant() ? outputs : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::hasConstantOutput(Nlp::RuleId ruleId, int inputIdx) const
+{
+    return constantOutputs(ruleId, inputIdx) != 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::Tree::getRuleResponse(Nlp::RuleId ruleId, int inputIdx, float score,
+                                     Nlp::Result &result) const
+{
+    result.clear();
+
+    const Nlp::CondOutputList *outputs = constantOutputs(ruleId, inputIdx);
+
+    if (!outputs) {
+        return false;
+    }
+
+    // Constant outputs do not read variables, any stack works
+    const Nlp::OutputTemplate *output = outputs->nextValidOutput(Nlp::VarStack());
+
+    if (!output) {
+        return false;
+    }
+
+    result = Nlp::Result(output->rawString(), ruleId, inputIdx, score);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::getResponses(const QString &input, Nlp::ResultList &results) const
+{
+    Nlp::SearchContext ctx;
+
+    getResponses(input, results, ctx);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::getResponses(const QString &input, Nlp::ResultList &results,
+                                  Nlp::SearchContext &ctx) const
+{
+    bool nested = !ctx.isEmpty();
+    QElapsedTimer timer;
+    timer.start();
+
+    Nlp::WordList words;
+    parseUserInput(input, words);
+
+    recordStage(ctx, Nlp::EngineStats::LemmatizeStage, timer, nested);
+
+    getResponses(words, results, ctx);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::getResponses(const Nlp::WordList &words, Nlp::ResultList &results,
+                                  Nlp::SearchContext &ctx) const
+{
+    LVK_PROFILE("Tree::getResponses");
+
+    bool nested = !ctx.isEmpty();
+    QElapsedTimer timer;
+    timer.start();
+
+    ctx.push();
+    ctx.stack().setWords(&words);
+
+    lookupFuzzyCandidates(words, ctx);
+    getPhraseResults(results, words, ctx);
+    setTokenMasks(words, ctx);
+    scoredDFS(results, m_root, words, ctx);
+
+    if (ctx.isAborted()) {
+        discardAbortedResults(results, words, ctx);
+    }
+
+    qStableSort(results.begin(), results.end(), highScoreFirst);
+
+    recordStage(ctx, Nlp::EngineStats::SearchStage, timer, nested);
+
+    ctx.pop();
+
+    if (ctx.isEmpty()) {
+        ctx.loopDetector().clear();
+        ctx.memo().clear();
+    }
+
+    LVK_TRACE(Nlp) << "Nlp::Tree: Results: " << results;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::scoredDFS(Nlp::ResultList &results, const Nlp::Node *root,
+                               const Nlp::WordList &words, Nlp::SearchContext &ctx) const
+{
+    if (words.isEmpty()) {
+        return;
+    }
+
+    // Explicit stack instead of recursion, so adversarial inputs cannot exhaust the thread
+    // stack and the search can stop at any step. The frame at each offset holds the childs
+    // of the node being expanded, in the order the recursive search visited them, and the
+    // next one to visit.
+
+    QVector<DfsFrame> frames(words.size());
+    int offset = 0;
+
+    frames[0].next = 0;
+    expandNode(frames[0].childs, root, words, ctx, 0);
+
+    while (offset >= 0) {
+        DfsFrame &frame = frames[offset];
+
+        if (frame.next == frame.childs.size()) {
+            --offset;
+            continue;
+        }
+
+        const Nlp::Node *child = frame.childs[frame.next].first;
+        float weight = frame.childs[frame.next].second;
+        ++frame.next;
+
+        if (!ctx.step()) {
+            return;
+        }
+
+        if (ctx.explain()) {
+            ctx.explain()->countEdge(child);
+        }
+
+        if (visitChild(results, child, weight, words, ctx, offset)) {
+            ++offset;
+            frames[offset].next = 0;
+            expandNode(frames[offset].childs, child, words, ctx, offset);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::expandNode(ScoredChildList &scoredChilds, const Nlp::Node *node,
+                                const Nlp::WordList &words, const Nlp::SearchContext &ctx,
+                                int offset) const
+{
+    scoredChilds.clear();
+
+    // Only visit childs that can match the current word
+
+    const QList<Nlp::Node *> &childs = node->childs();
+    QList<int> matching = node->matchingChilds(words[offset], m_matchPolicy->matchLemmas());
+
+    // Subtrees that need some word not found in the rest of the input are skipped
+    quint64 mask = ctx.tokenMask(offset);
+
+    foreach (int i, matching) {
+        if (childs[i]->requiresToken && !(childs[i]->tokenFilter & mask)) {
+            if (ctx.explain()) {
+                ++ctx.explain()->filteredEdges;
+            }
+            continue;
+        }
+
+        scoredChilds.append(qMakePair((const Nlp::Node *)childs[i],
+                                      (*m_matchPolicy)(childs[i], words[offset])));
+    }
+
+    // Then, the word childs that match a misspelled word candidate. Childs already visited
+    // are skipped since they matched with a higher weight.
+
+    if (m_matchPolicy->matchFuzzy()) {
+        foreach (const Nlp::FuzzyCandidate &c, ctx.fuzzyCandidates(offset)) {
+            foreach (int i, node->wordChilds(c.symbol)) {
+                if (qBinaryFind(matching.constBegin(), matching.constEnd(), i)
+                        != matching.constEnd()) {
+                    continue;
+                }
+
+                if (childs[i]->requiresToken && !(childs[i]->tokenFilter & mask)) {
+                    continue;
+                }
+
+                scoredChilds.append(qMakePair((const Nlp::Node *)childs[i],
+                                              m_matchPolicy->fuzzyWeight(c.distance)));
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Updates the search state with the child \a node matched at \a offset. Returns true if the
+// search must go on with the childs of \a node at the next offset.
+bool Lvk::Nlp::Tree::visitChild(Nlp::ResultList &results, const Nlp::Node *node,
+                                float matchWeight, const Nlp::WordList &words,
+                                Nlp::SearchContext &ctx, int offset) const
+{
+    TRACE(offset) << "Current node" << *node;
+
+    QString varName;
+    if (const Nlp::VariableNode *varNode = node->to<Nlp::VariableNode>()) {
+        varName = varNode->varName;
+    }
+    ctx.stack().update(varName, offset);
+
+    if (matchWeight <= 0) {
+        return false;
+    }
+
+    TRACE(offset) << words[offset] << "matched with weight" << matchWeight;
+
+    ctx.score().updateScore(offset, matchWeight);
+
+    // In bounded searches, prune if this branch cannot beat the best score so far
+    if (ctx.isBounded()) {
+        float maxScore = ctx.score().currentScore()
+                + (words.size() - offset - 1) * m_matchPolicy->maxWeight();
+        if (maxScore <= ctx.bestScore()) {
+            TRACE(offset) << "Pruned with max score" << maxScore;
+            return false;
+        }
+
+        // Wildcard and variable self-loops reach the same (node, offset) state through
+        // many paths. The rest of the search only depends on the state and the captured
+        // variables, so explore it again only if we reach it with a better score
+        if (!ctx.visit(node, offset, ctx.score().currentScore())) {
+            TRACE(offset) << "Pruned already visited state";
+            return false;
+        }
+    }
+
+    if (offset + 1 < words.size()) {
+        return true;
+    }
+
+    handleEndWord(results, node, offset, ctx);
+
+    return false;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::Tree::~Tree()
+void Lvk::Nlp::Tree::discardAbortedResults(Nlp::ResultList &results, const Nlp::WordList &words,
+                                           const Nlp::SearchContext &ctx) const
 {
-    delete m_matchPolicy;
-    delete m_root;
+    // Only warn once, in the outermost search. Results of nested searches are always
+    // discarded, so outputs are never expanded with partial results.
+    if (ctx.depth() != 1) {
+        results.clear();
+        return;
+    }
+
+    if (ctx.abortReason() == Nlp::SearchContext::DeadlineExceeded && ctx.isBestEffort()) {
+        qWarning() << "Nlp::Tree: Search missed the deadline after" << ctx.steps()
+                   << "steps with input" << words << "keeping" << results.size() << "results";
+        return;
+    }
+
+    qWarning() << "Nlp::Tree: Search aborted after" << ctx.steps() << "steps with input"
+               << words;
+
+    results.clear();
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::add(const Nlp::Rule &rule)
+bool Lvk::Nlp::Tree::getLiteralResults(Nlp::ResultList &results, const Nlp::WordList &words,
+                                       Nlp::SearchContext &ctx) const
 {
-    Nlp::WordList words;
+    if (words.isEmpty()) {
+        return false;
+    }
 
-    QSet<PairedNode> onodes;    // Set of nodes with output
+    if (m_literalDirty) {
+        QMutexLocker locker(&m_literalMutex);
+        if (m_literalDirty) {
+            m_literalIndex.clear();
+            buildLiteralIndex(m_root, Nlp::SymbolSequence());
+            m_literalDirty.fetchAndStoreOrdered(0);
+        }
+    }
 
-    // Parse each rule input and add nodes in the tree
+    // Hashed once per search, the lookup is a single probe
+    Nlp::SymbolSequence key;
+    key.reserve(words.size());
 
-    for (int i = 0; i < rule.input().size(); ++i) {
+    for (int i = 0; i < words.size(); ++i) {
+        if (words[i].origWordId == Nlp::NullSymbol) {
+            return false;
+        }
+        key.append(words[i].origWordId);
+    }
 
-        qDebug() << "Nlp::Tree: Parsing rule id" << rule.id() << "input #" << i;
-        parseRuleInput(rule.input().at(i), words);
+    LiteralIndex::const_iterator it = m_literalIndex.find(key);
 
-        if (words.isEmpty()) {
-            continue;
-        }
+    if (it == m_literalIndex.constEnd()) {
+        return false;
+    }
 
-        Nlp::Node *curNode = m_root;
+    // All words match exactly, so no other path can get a higher score. Nodes are indexed in
+    // the same order scoredDFS() visits them, hence the first valid result is the same.
 
-        foreach (Nlp::Word w, words) {
-            curNode = addNode(w, curNode);
-        }
+    for (int i = 0; i < words.size(); ++i) {
+        ctx.score().updateScore(i, m_matchPolicy->maxWeight());
+    }
 
-        onodes.insert(PairedNode(i, curNode));
+    foreach (const Nlp::Node *node, *it) {
+        handleEndWord(results, node, words.size() - 1, ctx);
 
-        if (words.last().isStar() && curNode->parent != m_root) {
-            onodes.insert(PairedNode(i, curNode->parent));
+        if (!results.isEmpty()) {
+            if (ctx.explain()) {
+                ++ctx.explain()->literalHits;
+            }
+            return true;
         }
     }
 
-    // Add rule output to each node in onodes
+    // No valid output, for instance conditional outputs. Fallback to a full search
+    ctx.score() = Nlp::ScoringAlgorithm();
 
-    addNodeOutput(rule, onodes);
+    return false;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::addNodeOutput(const Lvk::Nlp::Rule &rule, const QSet<PairedNode> &onodes)
+void Lvk::Nlp::Tree::getPhraseResults(Nlp::ResultList &results, const Nlp::WordList &words,
+                                      Nlp::SearchContext &ctx) const
 {
-    // Build list of outputs with their condition
+    if (m_phraseRoot->childs().isEmpty()) {
+        return;
+    }
 
-    Nlp::CondOutputList l(rule.output(), rule.randomOutput());
+    LVK_PROFILE("Tree::getPhraseResults");
 
-    // Add the output list to all nodes in onodes.
-    // Because CondOutputList inherits the "Implicit Shared Model" from QList, all These
-    // copies don't waste a lot of memory
+    // The input is scanned once. A trie state is started at each offset and the active states
+    // advance with the next word. A word can match a phrase word by its original word, by its
+    // lemma or as a misspelled word, so states have no failure links as in Aho-Corasick, but
+    // phrases are short and few states are active at once.
 
-    foreach (const PairedNode &onode, onodes) {
-        onode.second->omap[getOmapId(rule.id(), onode.first)] = l;
-    }
-}
+    QList<PhraseState> active;
+    QList<const Nlp::Node *> hits;              // nodes with outputs in the order found
+    QHash<const Nlp::Node *, PhraseState> best; // best hit of each node
 
-//--------------------------------------------------------------------------------------------------
+    for (int offset = 0; offset < words.size(); ++offset) {
+        active.append(PhraseState(m_phraseRoot, offset, 0));
 
-Lvk::Nlp::Node * Lvk::Nlp::Tree::addNode(const Nlp::Word &word, Nlp::Node *parent)
-{
-    // If node already exists for the given word, return that node
+        QList<PhraseState> next;
 
-    if (word.isWord()) {
-        foreach (Nlp::Node *node, parent->childs()) {
-            if (Nlp::WordNode* wNode = node->to<Nlp::WordNode>()) {
-                if (wNode->word == word) {
-                    return node;
+        foreach (const PhraseState &state, active) {
+            const QList<Nlp::Node *> &childs = state.node->childs();
+            QList<int> matching = state.node->matchingChilds(words[offset],
+                                                             m_matchPolicy->matchLemmas());
+            QList<float> weights;
+
+            foreach (int i, matching) {
+                weights.append((*m_matchPolicy)(childs[i], words[offset]));
+            }
+
+            if (m_matchPolicy->matchFuzzy()) {
+                foreach (const Nlp::FuzzyCandidate &c, ctx.fuzzyCandidates(offset)) {
+                    foreach (int i, state.node->wordChilds(c.symbol)) {
+                        if (!matching.contains(i)) {
+                            matching.append(i);
+                            weights.append(m_matchPolicy->fuzzyWeight(c.distance));
+                        }
+                    }
                 }
             }
-        }
-    }
 
-    if (word.isWildcard()) {
-        foreach (Nlp::Node *node, parent->childs()) {
-            if (Nlp::WildcardNode* wcNode = node->to<Nlp::WildcardNode>()) {
-                // Currently we only support two wildcards: * and +
-                // We must handle the case where new node is a * node and we already have
-                // a + node
-                if (word.isStar() && wcNode->min == 1) {
-                    wcNode->min = 0;
+            for (int j = 0; j < matching.size(); ++j) {
+                if (!ctx.step()) {
+                    return;
+                }
+
+                PhraseState hit(childs[matching[j]], state.first, state.weight + weights[j]);
+
+                next.append(hit);
+
+                if (hit.node->omap.isEmpty()) {
+                    continue;
+                }
+
+                // Hits of the same node have the same length, so only the phrase words make
+                // a difference
+                QHash<const Nlp::Node *, PhraseState>::iterator it = best.find(hit.node);
+
+                if (it == best.end()) {
+                    hits.append(hit.node);
+                    best.insert(hit.node, hit);
+                } else if (hit.weight > it->weight) {
+                    *it = hit;
                 }
-                return node;
             }
         }
+
+        active = next;
     }
 
-    if (word.isVariable()) {
-        // TODO check
+    // Outputs are evaluated with the score the tree gets for "* phrase *"
+
+    foreach (const Nlp::Node *node, hits) {
+        ctx.score() = phraseScore(node, best[node].first, words, ctx);
+        handleEndWord(results, node, words.size() - 1, ctx);
     }
 
-    // Otherwise, add new node
+    ctx.score() = Nlp::ScoringAlgorithm();
+}
 
-    Nlp::Node *newNode = 0;
+//--------------------------------------------------------------------------------------------------
 
-    if (word.isWildcard()) {
-        newNode = new Nlp::WildcardNode(word.origWord, parent);
-        newNode->appendChild(newNode); // Loop node (see engine documentation)
-    } else if (word.isVariable()) {
-        QString varName = word.origWord.mid(1, word.origWord.size() - 2); // Remove square braces
-        newNode = new Nlp::VariableNode(varName, parent);
-        newNode->appendChild(newNode); // Loop node (see engine documentation)
-    } else {
-        newNode = new Nlp::WordNode(word, parent);
+Lvk::Nlp::ScoringAlgorithm Lvk::Nlp::Tree::phraseScore(const Nlp::Node *node, int first,
+                                                       const Nlp::WordList &words,
+                                                       const Nlp::SearchContext &ctx) const
+{
+    // Phrase words from the last one to the first one
+    QList<const Nlp::Node *> phrase;
+    for (const Nlp::Node *n = node; n && n != m_phraseRoot; n = n->parent) {
+        phrase.prepend(n);
     }
 
-    parent->appendChild(newNode);
+    // Words are scored in order as the tree does for the input "* phrase *", so scores are
+    // exactly the same. Words before and after the phrase match the wildcards.
+    Nlp::ScoringAlgorithm scoring;
 
-    // If parent is *, we need to add a new edge from parent->parent to newNode
-    // TODO handle case where there are two or more * adjacent
-    if (parent->is<Nlp::WildcardNode>() && parent->to<Nlp::WildcardNode>()->min == 0) {
-        parent->parent->appendChild(newNode);
-    }
+    for (int i = 0; i < words.size(); ++i) {
+        float weight = WILDCARD_MATCH_WEIGHT;
 
-    qDebug() << "Nlp::Tree: Added new node" << *newNode << "with parent" << *parent;
+        if (i >= first && i < first + phrase.size()) {
+            const Nlp::Node *n = phrase[i - first];
+            weight = (*m_matchPolicy)(n, words[i]);
 
-    return newNode;
+            if (weight <= 0) {
+                Nlp::SymbolId symbol = n->to<Nlp::WordNode>()->word.origWordId;
+
+                foreach (const Nlp::FuzzyCandidate &c, ctx.fuzzyCandidates(i)) {
+                    if (c.symbol == symbol) {
+                        weight = m_matchPolicy->fuzzyWeight(c.distance);
+                        break;
+                    }
+                }
+            }
+        }
+
+        scoring.updateScore(i, weight);
+    }
+
+    return scoring;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::getResponse(const QString &input, Nlp::Result &result)
+void Lvk::Nlp::Tree::lookupFuzzyCandidates(const Nlp::WordList &words,
+                                           Nlp::SearchContext &ctx) const
 {
-    result.clear();
+    if (!m_matchPolicy->matchFuzzy()) {
+        return;
+    }
 
-    Nlp::ResultList results;
-    getResponses(input, results);
+    if (m_fuzzyDirty) {
+        QMutexLocker locker(&m_fuzzyMutex);
+        if (m_fuzzyDirty) {
+            m_fuzzyIndex.clear();
+            buildFuzzyIndex();
+            m_fuzzyDirty.fetchAndStoreOrdered(0);
+        }
+    }
 
-    if (!results.isEmpty()) {
-        result = results.first();
+    // Candidates are looked up once per word instead of once per visited node
+
+    QList<Nlp::FuzzyCandidateList> candidates;
+    bool found = false;
+
+    for (int i = 0; i < words.size(); ++i) {
+        candidates.append(Nlp::FuzzyCandidateList());
+
+        // Words in the tree are not misspelled
+        if (!m_fuzzyIndex.contains(words[i].origWordId)) {
+            m_fuzzyIndex.lookup(words[i].origWord, candidates.last());
+            found = found || !candidates.last().isEmpty();
+        }
+    }
+
+    if (found) {
+        LVK_TRACE(Nlp) << "Nlp::Tree: Fuzzy candidates found for" << words;
+        ctx.setFuzzyCandidates(candidates);
     }
 }
+
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::getResponses(const QString &input, Nlp::ResultList &results)
+bool Lvk::Nlp::Tree::getSimilarResult(const Nlp::WordList &words, Nlp::Result &result,
+                                      const Nlp::SearchContext &ctx) const
 {
-    Nlp::WordList words;
-    parseUserInput(input, words);
-
-    m_searchCtx.push();
-
-    scoredDFS(results, m_root, words);
-
-    qSort(results.begin(), results.end(), highScoreFirst);
+    if (m_vectorDirty) {
+        QMutexLocker locker(&m_vectorMutex);
+        if (m_vectorDirty) {
+            m_vectorIndex.build();
+            m_vectorDirty.fetchAndStoreOrdered(0);
+        }
+    }
 
-    m_searchCtx.pop();
+    Nlp::SimilarInputList similar;
+    m_vectorIndex.lookup(userLemmas(words), ctx.minSimilarity(), similar);
 
-    if (m_searchCtx.isEmpty()) {
-        m_loopDetector.clear();
+    // Outputs that read variables or conditions cannot be evaluated without a match
+    foreach (const Nlp::SimilarInput &s, similar) {
+        if (matchesTarget(s.ruleId, ctx.target())
+                && getRuleResponse(s.ruleId, s.inputIdx, s.similarity, result)) {
+            LVK_TRACE(Nlp) << "Nlp::Tree: Similar input found with similarity" << s.similarity;
+            return true;
+        }
     }
 
-    qDebug() << "Nlp::Tree: Results: " << results;
+    return false;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::scoredDFS(Nlp::ResultList &results, const Nlp::Node *root,
-                               const Nlp::WordList &words, int offset /*= 0*/)
+void Lvk::Nlp::Tree::setTokenMasks(const Nlp::WordList &words, Nlp::SearchContext &ctx) const
 {
-    if (offset >= words.size()) {
+    // Without masks every subtree is explored
+    if (!ctx.hasTokenFilter()) {
         return;
     }
 
-    foreach (const Nlp::Node *node, root->childs()) {
-        TRACE(offset) << "Current node" << *node;
+    if (m_filterDirty) {
+        QMutexLocker locker(&m_filterMutex);
+        if (m_filterDirty) {
+            QHash<const Nlp::Node *, bool> built;
+            buildTokenFilter(m_root, built);
+            m_filterDirty.fetchAndStoreOrdered(0);
+        }
+    }
+
+    // Mask of each suffix of the input. Misspelled word candidates match word nodes too.
 
-        float matchWeight = (*m_matchPolicy)(node, words[offset]);
+    QVector<quint64> masks(words.size());
+    quint64 mask = 0;
 
-        QString varName;
-        if (const Nlp::VariableNode *varNode = node->to<Nlp::VariableNode>()) {
-            varName = varNode->varName;
+    for (int i = words.size() - 1; i >= 0; --i) {
+        mask |= Nlp::tokenFilterBits(words[i].origWordId) | Nlp::tokenFilterBits(words[i].lemmaId);
+
+        foreach (const Nlp::FuzzyCandidate &c, ctx.fuzzyCandidates(i)) {
+            mask |= Nlp::tokenFilterBits(c.symbol);
         }
-        m_searchCtx.stack().update(varName, offset);
 
-        if (matchWeight > 0) {
-            TRACE(offset) << words[offset] << "matched with weight" << matchWeight;
+        masks[i] = mask;
+    }
+
+    ctx.setTokenMasks(masks);
+}
 
-            m_searchCtx.stack().capture(words[offset].origWord, offset);
-            m_searchCtx.score().updateScore(offset, matchWeight);
+void Lvk::Nlp::Tree::buildLiteralIndex(const Nlp::Node *node,
+                                       const Nlp::SymbolSequence &key) const
+{
+    foreach (const Nlp::Node *child, node->childs()) {
+        const Nlp::WordNode *wNode = child->to<Nlp::WordNode>();
 
-            if (offset + 1 < words.size()) {
-                scoredDFS(results, node, words, offset + 1);
-            } else {
-                handleEndWord(results, node, offset);
+        if (!wNode || wNode->word.origWordId == Nlp::NullSymbol) {
+            continue;
+        }
+
+        // The hash of the prefix is extended, not computed again
+        Nlp::SymbolSequence childKey = key;
+        childKey.append(wNode->word.origWordId);
+
+        if (!child->omap.isEmpty()) {
+            m_literalIndex[childKey].append(child);
+        }
+
+        buildLiteralIndex(child, childKey);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::buildFuzzyIndex() const
+{
+    // Wildcards and variables add self-loops, so nodes are visited once
+    QSet<const Nlp::Node *> visited;
+    QList<const Nlp::Node *> pending;
+
+    visited.insert(m_root);
+    visited.insert(m_phraseRoot);
+    pending.append(m_root);
+    pending.append(m_phraseRoot);
+
+    while (!pending.isEmpty()) {
+        const Nlp::Node *node = pending.takeLast();
+
+        if (const Nlp::WordNode *wNode = node->to<Nlp::WordNode>()) {
+            m_fuzzyIndex.add(wNode->word.origWordId, wNode->word.origWord);
+        }
+
+        foreach (const Nlp::Node *child, node->childs()) {
+            if (!visited.contains(child)) {
+                visited.insert(child);
+                pending.append(child);
             }
         }
     }
@@ -278,21 +2068,75 @@ void Lvk::Nlp::Tree::scoredDFS(Nlp::ResultList &results, const Nlp::Node *root,
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::handleEndWord(Nlp::ResultList &results, const Nlp::Node *node, int offset)
+// Builds the token filter of node and its subtree in post-order. Nodes may be reached through
+// several edges, so built contains the nodes visited: false while visiting their subtree and
+// true once their filter is built.
+void Lvk::Nlp::Tree::buildTokenFilter(Nlp::Node *node,
+                                      QHash<const Nlp::Node *, bool> &built) const
+{
+    built.insert(node, false);
+
+    quint64 filter = 0;
+    bool childsRequire = true;
+    bool isWord = false;
+
+    if (const Nlp::WordNode *wNode = node->to<Nlp::WordNode>()) {
+        filter = Nlp::tokenFilterBits(wNode->word.origWordId)
+                | Nlp::tokenFilterBits(wNode->word.lemmaId);
+        isWord = true;
+    }
+
+    foreach (Nlp::Node *child, node->childs()) {
+        // Wildcard and variable self-loops
+        if (child == node) {
+            continue;
+        }
+
+        QHash<const Nlp::Node *, bool>::const_iterator it = built.find(child);
+
+        if (it == built.constEnd()) {
+            buildTokenFilter(child, built);
+        } else if (!it.value()) {
+            // Any other cycle, the subtree cannot be pruned
+            filter = ~Q_UINT64_C(0);
+            childsRequire = false;
+            continue;
+        }
+
+        filter |= child->tokenFilter;
+        childsRequire = childsRequire && child->requiresToken;
+    }
+
+    // The word of a word node is matched by the input, so its subtree requires a word even
+    // if the node has outputs
+    node->tokenFilter = filter;
+    node->requiresToken = isWord || (node->omap.isEmpty() && childsRequire);
+
+    built[node] = true;
+}
+
+void Lvk::Nlp::Tree::handleEndWord(Nlp::ResultList &results, const Nlp::Node *node, int offset,
+                                   Nlp::SearchContext &ctx) const
 {
+    Nlp::SearchContext::LoopDetector &loopDetector = ctx.loopDetector();
     QPair<const Nlp::Node*, int> p(node, offset);
 
-    if (!m_loopDetector.contains(p)) {
-        m_loopDetector.insert(p);
+    if (ctx.explain()) {
+        ++ctx.explain()->terminalNodes;
+    }
+
+    if (!loopDetector.contains(p)) {
+        loopDetector.insert(p);
 
-        Nlp::ResultList r = getResultsForNode(node);
-        if (!r.isEmpty()) {
-            results.append(r);
+        if (getResultsForNode(results, node, ctx)) {
+            if (ctx.isBounded()) {
+                ctx.setBestScore(results.last().score);
+            }
         } else {
            TRACE(offset) << "No valid outputs found!";
         }
 
-        m_loopDetector.remove(p);
+        loopDetector.remove(p);
     } else {
         TRACE(offset) << "Infinite loop detected!";
     }
@@ -300,83 +2144,111 @@ void Lvk::Nlp::Tree::handleEndWord(Nlp::ResultList &results, const Nlp::Node *no
 
 //--------------------------------------------------------------------------------------------------
 
-Lvk::Nlp::ResultList Lvk::Nlp::Tree::getResultsForNode(const Nlp::Node *node)
+bool Lvk::Nlp::Tree::getResultsForNode(Nlp::ResultList &results, const Nlp::Node *node,
+                                       Nlp::SearchContext &ctx) const
 {
-    Nlp::ResultList results;
-    QSet<Nlp::RuleId> ruleIds;
+    // Results are appended straight to the caller's list. This runs on every terminal node the
+    // search reaches, so a temporary list per node is an allocation we can spare
+    int prevSize = results.size();
     Nlp::OutputMap::const_iterator it;
-    float score = m_searchCtx.score().currentScore();
+    float score = ctx.score().currentScore();
+
+    // In bounded searches, a node with the same score than the best one cannot win
+    if (ctx.isBounded() && score <= ctx.bestScore()) {
+        return false;
+    }
 
     // For each rule definition, try to find a valid output
     for (it = node->omap.constBegin(); it != node->omap.constEnd(); ++it) {
         Nlp::RuleId ruleId = getRuleId(it.key());
         int inputIdx = getInputIndex(it.key());
 
-        if (ruleIds.contains(ruleId)) {
+        if (!matchesTarget(ruleId, ctx.target())) {
             continue;
         }
 
         const Nlp::CondOutputList &l = it.value();
-        QString output = l.nextValidOutput(m_searchCtx.stack());
+        const Nlp::OutputTemplate *output = l.nextValidOutput(ctx.stack());
 
-        if (output.isNull()) {
+        if (!output) {
             continue;
         }
 
+        if (ctx.explain()) {
+            ++ctx.explain()->outputsEvaluated;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
         bool ok;
-        QString expOutput = expandVars(output, &ok);
+        QString expOutput = expandVars(*output, &ok, ctx);
+
+        recordStage(ctx, Nlp::EngineStats::ExpandStage, timer, ctx.depth() > 1);
         if (ok) {
             results.append(Nlp::Result(expOutput, ruleId, inputIdx, score));
+
+            // In bounded searches only the first valid output is needed
+            if (ctx.isBounded()) {
+                break;
+            }
         } else {
-            qDebug() << "Failed to expand output" << output << ". Trying with next output";
+            LVK_TRACE(Nlp) << "Failed to expand output" << output->rawString()
+                           << ". Trying with next output";
         }
 
     }
 
-    return results;
+    return results.size() > prevSize;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-QString Lvk::Nlp::Tree::expandVars(const QString &output, bool *ok)
+QString Lvk::Nlp::Tree::expandVars(const Nlp::OutputTemplate &output, bool *ok,
+                                   Nlp::SearchContext &ctx) const
 {
-    // TODO a possible optimization is to have all outputs already splitted
+    *ok = true;
 
-    QString newOutput;
-    QString varName;
-    QString varValue;
-    int offset = 0;
-    int i = 0;
-    bool recursive = false;
+    if (!output.hasVariables()) {
+        return output.rawString();
+    }
+
+    const QList<Nlp::OutputTemplate::Segment> &segments = output.segments();
+
+    // Get all values first to allocate the new output only once
 
-    while (true) {
-        i = m_parser.parseVariable(output, &varName, &recursive, offset);
-        if (i != -1) {
-            varValue = m_searchCtx.stack().value(varName);
+    QStringList values;
+    int size = 0;
+
+    foreach (const Nlp::OutputTemplate::Segment &seg, segments) {
+        QString varValue;
+
+        if (!seg.varName.isEmpty()) {
+            varValue = ctx.stack().value(seg.varName);
 
             // if recursive variable
-            if (recursive) {
+            if (seg.recursive) {
                 Nlp::Result result;
-                getResponse(varValue, result);
 
-                if (result.isValid()) {
-                    varValue = result.output;
-                } else {
-                    newOutput.clear();
+                if (!getNestedResponse(varValue, result, ctx)) {
                     *ok = false;
-                    break;
+                    return QString();
                 }
 
-                i--;
+                varValue = result.output;
             }
-
-            newOutput += output.mid(offset, i - offset) + varValue;
-            offset =  i + varName.size() + (recursive ? 3 : 2);
-        } else {
-            newOutput += output.mid(offset);
-            *ok = true;
-            break;
         }
+
+        size += seg.text.size() + varValue.size();
+        values.append(varValue);
+    }
+
+    QString newOutput;
+    newOutput.reserve(size);
+
+    for (int i = 0; i < segments.size(); ++i) {
+        newOutput += segments[i].text;
+        newOutput += values[i];
     }
 
     return newOutput;
@@ -384,74 +2256,146 @@ QString Lvk::Nlp::Tree::expandVars(const QString &output, bool *ok)
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::parseRuleInput(const QString &input, Nlp::WordList &words)
+bool Lvk::Nlp::Tree::getNestedResponse(const QString &input, Nlp::Result &result,
+                                       Nlp::SearchContext &ctx) const
 {
-    qDebug() << "Nlp::Tree: Parsing rule input" << input;
+    // Only valid results are memoized. Failed searches may depend on the loop detector state
+    QPair<const Nlp::Tree*, QString> key(this, input);
+    Nlp::SearchContext::ExpansionMemo::const_iterator it = ctx.memo().find(key);
+
+    if (it != ctx.memo().constEnd()) {
+        ctx.countMemoHit();
+        result = *it;
+        return true;
+    }
 
-    words.clear();
+    if (ctx.isOverBudget()) {
+        LVK_TRACE(Nlp) << "Nlp::Tree: Recursion budget exceeded with input" << input;
+        return false;
+    }
+
+    ctx.countNestedSearch();
+
+    getResponse(input, result, ctx);
+
+    if (!result.isValid()) {
+        return false;
+    }
+
+    ctx.memo().insert(key, result);
+
+    return true;
+}
 
-    Nlp::GlobalTools::instance()->lemmatizer()->lemmatize(input, words);
+//--------------------------------------------------------------------------------------------------
 
+void Lvk::Nlp::Tree::parseRuleInput(Nlp::WordList &words) const
+{
     parseExactMatch(words);
     filterSymbols(words);
     checkSyntax(words);
 
+    for (int i = 0; i < words.size(); ++i) {
+        words[i].intern();
+    }
+
     qDebug() << "Nlp::Tree: Parsed rule input" << words;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::parseUserInput(const QString &input, Nlp::WordList &words)
+void Lvk::Nlp::Tree::parseUserInput(const QString &input, Nlp::WordList &words) const
+{
+    LVK_PROFILE("Tree::parseUserInput");
+
+    LVK_TRACE(Nlp) << "Nlp::Tree: Parsing user input" << input;
+
+    words.clear();
+
+    tools()->lemmatize(removeApostrophes(input), words);
+
+    lookupUserWords(words);
+
+    LVK_TRACE(Nlp) << "Nlp::Tree: Parsed user input" << words;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::Tree::parseUserInputs(const QStringList &inputs, QList<Nlp::WordList> &words) const
 {
-    qDebug() << "Nlp::Tree: Parsing user input" << input;
+    LVK_PROFILE("Tree::parseUserInputs");
+
+    LVK_TRACE(Nlp) << "Nlp::Tree: Parsing" << inputs.size() << "user inputs";
 
     words.clear();
 
-    QString szInput = input;
-    szInput.remove('\'');
-    Nlp::GlobalTools::instance()->lemmatizer()->lemmatize(szInput, words);
+    QStringList szInputs;
+    foreach (const QString &input, inputs) {
+        szInputs.append(removeApostrophes(input));
+    }
+
+    tools()->lemmatizeBatch(szInputs, words);
+
+    for (int i = 0; i < words.size(); ++i) {
+        lookupUserWords(words[i]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
 
+void Lvk::Nlp::Tree::lookupUserWords(Nlp::WordList &words) const
+{
     filterSymbols(words);
 
-    qDebug() << "Nlp::Tree: Parsed user input" << words;
+    // User input is not interned. Otherwise the symbol table would grow with every new word
+    for (int i = 0; i < words.size(); ++i) {
+        words[i].lookup();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::filterSymbols(Nlp::WordList &words)
+void Lvk::Nlp::Tree::filterSymbols(Nlp::WordList &words) const
 {
-    for (int i = 0; i < words.size();) {
-        if (words[i].isSymbol()) {
-            words.removeAt(i);
-        } else {
-            ++i;
+    // Compacts the list in place instead of shifting it on every removed symbol
+    int size = 0;
+
+    for (int i = 0; i < words.size(); ++i) {
+        if (!words[i].isSymbol()) {
+            if (size != i) {
+                words[size] = words[i];
+            }
+            ++size;
         }
     }
+
+    words.erase(words.begin() + size, words.end());
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::checkSyntax(Nlp::WordList &/*words*/)
+void Lvk::Nlp::Tree::checkSyntax(Nlp::WordList &words) const
 {
-    // So far this method only checks for two or more consecutive star operators and only
-    // keeps one
-    //    bool isStar = false;
-    //    bool prevIsStar = false;
-    //
-    //    for (int i = 0; i < words.size();) {
-    //        isStar = words[i].isStar();
-    //        if (isStar && prevIsStar) {
-    //            words.removeAt(i);
-    //        } else {
-    //            ++i;
-    //        }
-    //        prevIsStar = isStar;
-    //    }
+    // Adjacent wildcards with a star match the same inputs than a single wildcard, but each
+    // extra wildcard multiplies the ways an input can be split among them. So far this method
+    // only merges them: "* *" becomes "*" and "* +" or "+ *" becomes "+"
+    for (int i = 1; i < words.size();) {
+        if (words[i - 1].isWildcard() && words[i].isWildcard()
+                && (words[i - 1].isStar() || words[i].isStar())) {
+            if (words[i - 1].isStar()) {
+                words.removeAt(i - 1);
+            } else {
+                words.removeAt(i);
+            }
+        } else {
+            ++i;
+        }
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::Tree::parseExactMatch(Nlp::WordList &words)
+void Lvk::Nlp::Tree::parseExactMatch(Nlp::WordList &words) const
 {
     for (int i = 0; i < words.size(); ++i) {
         QString &w = words[i].origWord;
@@ -27,12 +27,27 @@
 #include <QPair>
 #include <QList>
 #include <QSet>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QVariantMap>
+#include <QSharedPointer>
 
 #include "nlp-engine/engine.h"
 #include "nlp-engine/word.h"
 #include "nlp-engine/result.h"
-#include "nlp-engine/parser.h"
+#include "nlp-engine/ruleissue.h"
+#include "nlp-engine/rulecost.h"
 #include "nlp-engine/searchcontext.h"
+#include "nlp-engine/matchpolicy.h"
+#include "nlp-engine/fuzzyindex.h"
+#include "nlp-engine/vectorindex.h"
+#include "nlp-engine/symbolsequence.h"
+#include "nlp-engine/node.h"
+
+class QDataStream;
 
 namespace Lvk
 {
@@ -43,10 +58,10 @@ namespace Lvk
 namespace Nlp
 {
 
-class Rule;
-class Node;
-class MatchPolicy;
 class ScoringAlgorithm;
+class FlatTree;
+class OutputTemplate;
+class Toolchain;
 
 /// \ingroup Lvk
 /// \addtogroup Nlp
@@ -54,15 +69,25 @@ class ScoringAlgorithm;
 
 /**
  * \brief The Tree class provides tree to perform NLP searches
+ *
+ * Rules of every target share the same tree. Each rule keeps the set of its targets and
+ * searches only get outputs of the rules of the target of the search context.
+ * \see SearchContext::setTarget()
+ *
+ * Rule inputs with the form "* phrase *", where the phrase only has words, are kept apart in
+ * a trie of phrases. Searches scan the user input once to find the phrases it contains instead
+ * of trying each phrase at every offset. Their results get the same score as in the tree.
  */
 class Tree
 {
 public:
 
     /**
-     * Constructs an empty tree
+     * Constructs an empty tree that matches words with \a matchMode and parses rules and user
+     * inputs with the NLP tools of \a tools. If \a tools is null, GlobalTools is used.
      */
-    Tree();
+    Tree(Nlp::MatchPolicy::Mode matchMode = Nlp::MatchPolicy::LemmaMatch,
+         QSharedPointer<Nlp::Toolchain> tools = QSharedPointer<Nlp::Toolchain>());
 
     /**
      * Destroys the object
@@ -75,39 +100,305 @@ public:
     void add(const Nlp::Rule &rule);
 
     /**
-     * Gets the list of results for \a input
+     * Adds all NLP \a rules to the tree. This is faster than adding rules one by one since
+     * all rule inputs are lemmatized at once, unless profiling is enabled, in which case
+     * each rule is lemmatized apart to time it. \see setProfiling()
+     */
+    void add(const Nlp::RuleList &rules);
+
+    /**
+     * Adds NLP \a rule to the tree with its inputs already lemmatized. \a lemmatized must
+     * contain one list of words for each rule input. \see Lemmatizer::lemmatizeBatch()
+     *
+     * This method does not use the global lemmatizer, so different trees can be built
+     * simultaneously in different threads.
+     *
+     * Rules cannot be added to a minimized tree. \see minimize()
+     */
+    void add(const Nlp::Rule &rule, const QList<Nlp::WordList> &lemmatized);
+
+    /**
+     * Removes from the tree all outputs of the rule with ID \a ruleId. Nodes are not pruned,
+     * they are reused if the rule is added again. \see minimize()
+     */
+    void remove(Nlp::RuleId ruleId);
+
+    /**
+     * Minimizes the tree. Subtrees with the same nodes, outputs and edges are merged into a
+     * single one shared by all their parents, so the tree becomes a DAG, and subtrees without
+     * outputs, such as the ones left by remove(), are pruned. Since merged subtrees have the
+     * same output map entries, searches get the same results. Phrase scores are computed from
+     * the parents of phrase nodes, so the trie of phrases is pruned but not merged. Returns the
+     * amount of nodes removed.
+     *
+     * Afterwards, rules can be removed but not added. \see isMinimized()
+     */
+    int minimize();
+
+    /**
+     * Returns true if the tree was minimized or loaded from a minimized tree. Otherwise;
+     * returns false.
+     */
+    bool isMinimized() const;
+
+    /**
+     * Sets \a tree as the source of parsed outputs of the rules added afterwards. If \a tree
+     * has a rule with the same ID and outputs, its parsed outputs are shared instead of parsed
+     * again, for instance, to build a tree with a subset of the rules of another one. \a tree
+     * must outlive the calls to add(). Null unsets the source. By default there is no source.
+     */
+    void setOutputSource(const Nlp::Tree *tree);
+
+    /**
+     * Enables or disables profiling of the rules added afterwards. If \a enabled is true, the
+     * time and the nodes, output map entries and wildcard edges created by each rule are
+     * recorded. By default profiling is disabled. \see ruleCosts()
+     */
+    void setProfiling(bool enabled);
+
+    /**
+     * Returns the costs of the rules added while profiling was enabled, the ones that created
+     * more nodes and edges first. Rules with the same size are sorted by time.
+     */
+    Nlp::RuleCostList ruleCosts() const;
+
+    /**
+     * Returns true if the tree does not contain any rule. Otherwise; returns false.
+     */
+    bool isEmpty() const;
+
+    /**
+     * Returns true if the tree contains at least one rule with \a target. NullSymbol stands
+     * for rules without targets. Otherwise; returns false.
+     */
+    bool hasTarget(Nlp::SymbolId target) const;
+
+    /**
+     * Writes the tree to \a stream. Nodes are written with their words already lemmatized, so
+     * loading the tree does not require to parse rules again. Rule targets and the lemmas of
+     * the vector index are written as strings since symbol IDs are only valid in the current
+     * process. Outputs are written once per rule, not once per node.
+     */
+    void save(QDataStream &stream) const;
+
+    /**
+     * Replaces the tree with the one read from \a stream. Returns true on success. Otherwise;
+     * returns false and the tree is not modified.
+     */
+    bool load(QDataStream &stream);
+
+    /**
+     * Gets the list of results for \a input sorted by score. Results with the same score keep
+     * the order in which they were found.
+     */
+    void getResponses(const QString &input, Nlp::ResultList &results) const;
+
+    /**
+     * Gets the list of results for \a input using the caller-owned search context \a ctx.
+     * Several threads can search the same tree simultaneously as long as each one uses its
+     * own context and the tree is not modified meanwhile.
+     *
+     * The search checks the budget and the request of \a ctx at every node, so it stops
+     * promptly once they are exceeded. Results of an aborted search are discarded, unless it
+     * missed the deadline of its request and \a ctx is best effort, in which case the results
+     * found so far are kept. \see SearchContext::setBestEffort()
+     */
+    void getResponses(const QString &input, Nlp::ResultList &results,
+                      Nlp::SearchContext &ctx) const;
+
+    /**
+     * Gets the list of results for \a words already parsed with parseUserInput() or
+     * parseUserInputs(). \see getResponses(const QString &, Nlp::ResultList &,
+     * Nlp::SearchContext &)
+     */
+    void getResponses(const Nlp::WordList &words, Nlp::ResultList &results,
+                      Nlp::SearchContext &ctx) const;
+
+    /**
+     * Gets the result with the highest score for \a input. If several results have the highest
+     * score, the first one found is returned.
+     *
+     * This is faster than getResponses() since branches that cannot beat the best score found
+     * so far are pruned, and outputs of losing candidates are not evaluated. Besides, if every
+     * word of \a input matches exactly a rule input without wildcards nor variables, the
+     * result is found with a single hash lookup.
+     *
+     * If nothing matches and the search context has a minimum similarity, the result is the
+     * constant output of the rule input most similar to \a input, with the similarity as
+     * score. \see SearchContext::setMinSimilarity()
+     */
+    void getResponse(const QString &input, Nlp::Result &result) const;
+
+    /**
+     * Gets the result with the highest score for \a input using the caller-owned search
+     * context \a ctx. \see getResponse(const QString &, Nlp::Result &)
+     */
+    void getResponse(const QString &input, Nlp::Result &result, Nlp::SearchContext &ctx) const;
+
+    /**
+     * Gets the result with the highest score for \a words already parsed with
+     * parseUserInput(). This allows to search several trees with the same input lemmatizing it
+     * only once. \see getResponse(const QString &, Nlp::Result &, Nlp::SearchContext &)
+     */
+    void getResponse(const Nlp::WordList &words, Nlp::Result &result,
+                     Nlp::SearchContext &ctx) const;
+
+    /**
+     * Returns true if input \a inputIdx of rule \a ruleId ends in a single node and its outputs
+     * have no conditions nor variables, so they do not depend on the words matched.
+     * Otherwise; returns false.
+     */
+    bool hasConstantOutput(Nlp::RuleId ruleId, int inputIdx) const;
+
+    /**
+     * Gets the next output of input \a inputIdx of rule \a ruleId without searching, as if the
+     * input had matched with \a score. Sequential and random outputs advance as in searches.
+     * Returns false if hasConstantOutput() is false. Otherwise; returns true.
+     */
+    bool getRuleResponse(Nlp::RuleId ruleId, int inputIdx, float score,
+                         Nlp::Result &result) const;
+
+    /**
+     * Sanitizes and lemmatizes the user \a input as searches do and stores the result in
+     * \a words. Parsing does not depend on the rules, only on the NLP tools of the tree.
+     */
+    void parseUserInput(const QString &input, Nlp::WordList &words) const;
+
+    /**
+     * Parses all user \a inputs as parseUserInput() does, but lemmatizes them at once.
+     * \a words contains one list of words for each input. \see Lemmatizer::lemmatizeBatch()
      */
-    void getResponses(const QString &input, Nlp::ResultList &results);
+    void parseUserInputs(const QStringList &inputs, QList<Nlp::WordList> &words) const;
 
     /**
-     * Gets the results with the highest score for \a input
+     * Pair (rule ID, input index)
      */
-    void getResponse(const QString &input, Nlp::Result &result);
+    typedef QPair<Nlp::RuleId, int> RuleInput;
+
+    /**
+     * Appends to \a issues the rule inputs shadowed by other inputs of rules with a common
+     * target that end in the same node, and inserts in \a inputs every rule input that is
+     * present in the tree. Each node is visited once.
+     */
+    void lint(Nlp::RuleIssueList &issues, QSet<RuleInput> &inputs) const;
+
+    /**
+     * Returns a map with the amount of nodes of each kind, output map entries, outputs, literal
+     * index entries, fuzzy index words, vector index inputs and targets of the tree, and the
+     * nodes removed by minimize(). Nodes reachable through several edges are counted once.
+     * Indexes not built yet count zero.
+     */
+    QVariantMap memoryReport() const;
+
+    /**
+     * Replaces \a flat with a copy of the tree and its trie of phrases. \see FlatTree
+     */
+    void flatten(Nlp::FlatTree &flat) const;
+
+    /**
+     * Returns the root node of the tree. Nodes must not be modified.
+     */
+    const Nlp::Node *root() const;
+
+    /**
+     * Returns the root node of the trie of "* phrase *" inputs. Nodes must not be modified.
+     */
+    const Nlp::Node *phraseRoot() const;
 
 private:
     Tree(Tree&);
     Tree& operator=(Tree&);
 
     typedef QPair<int, Nlp::Node *> PairedNode; // pair (input idx, node)
+    typedef QHash<Nlp::RuleId, QList<Nlp::Node *> > RuleNodesMap;
+    typedef QHash<Nlp::SymbolSequence, QList<const Nlp::Node *> > LiteralIndex; // symbols -> nodes
+    typedef QVector<Nlp::SymbolId> TargetSet;   // sorted target symbols
+    typedef QHash<Nlp::RuleId, TargetSet> RuleTargetsMap;
+    typedef QVector< QPair<const Nlp::Node *, float> > ScoredChildList; // pair (child, weight)
 
     Node *m_root;
+    Node *m_phraseRoot;         // trie of the phrases of "* phrase *" inputs
+    RuleNodesMap m_ruleNodes;   // nodes with output for each rule
+    RuleOutputsMap m_ruleOutputs;           // parsed outputs of each rule, shared by its nodes
+    const Tree *m_outputSource;             // tree to share parsed outputs with, if any
+    RuleTargetsMap m_ruleTargets;           // targets of each rule, only rules with targets
+    QHash<Nlp::SymbolId, int> m_targetRules;    // amount of rules of each target
     MatchPolicy *m_matchPolicy;
-    Nlp::Parser m_parser;
-    Nlp::SearchContext m_searchCtx;
-    QSet< QPair<const Nlp::Node*, int> > m_loopDetector;
+    QSharedPointer<Nlp::Toolchain> m_tools;
+    bool m_profiling;
+    QHash<Nlp::RuleId, Nlp::RuleCost> m_ruleCosts;  // only if m_profiling
+    Nlp::RuleCost *m_curCost;               // cost of the rule being added, if profiling
+    bool m_minimized;
+    int m_minimizedNodes;                   // nodes removed by minimize()
+
+    mutable LiteralIndex m_literalIndex;    // nodes reachable only through word nodes
+    mutable QAtomicInt m_literalDirty;      // 1 if m_literalIndex must be rebuilt
+    mutable QMutex m_literalMutex;
+
+    mutable QAtomicInt m_filterDirty;       // 1 if token filters of nodes must be rebuilt
+    mutable QMutex m_filterMutex;
 
+    mutable FuzzyIndex m_fuzzyIndex;        // words of all word nodes, only if matchFuzzy()
+    mutable QAtomicInt m_fuzzyDirty;        // 1 if m_fuzzyIndex must be rebuilt
+    mutable QMutex m_fuzzyMutex;
+
+    mutable VectorIndex m_vectorIndex;      // lemmas of all rule inputs
+    mutable QAtomicInt m_vectorDirty;       // 1 if m_vectorIndex must be rebuilt
+    mutable QMutex m_vectorMutex;
+
+    Nlp::Toolchain * tools() const;
+    const Nlp::CondOutputList * constantOutputs(Nlp::RuleId ruleId, int inputIdx) const;
     Nlp::Node * addNode(const Nlp::Word &word, Nlp::Node *parent);
+    Nlp::Node * minimizeNode(Nlp::Node *node, QHash<Nlp::Node *, Nlp::Node *> &merged,
+                             QHash<QByteArray, Nlp::Node *> &uniqueNodes);
+    bool prunePhraseNode(Nlp::Node *node);
     void addNodeOutput(const Rule &rule, const QSet<PairedNode> &onodes);
+    Nlp::CondOutputList parseOutputs(const Rule &rule);
+    void setRuleTargets(Nlp::RuleId ruleId, const TargetSet &targets);
+    void removeRuleTargets(Nlp::RuleId ruleId);
+    bool matchesTarget(Nlp::RuleId ruleId, Nlp::SymbolId target) const;
+    bool shareTarget(Nlp::RuleId ruleId1, Nlp::RuleId ruleId2) const;
     void scoredDFS(ResultList &r, const Nlp::Node *root, const Nlp::WordList &words,
-                   int offset = 0);
-    void handleEndWord(Nlp::ResultList &results, const Nlp::Node *node, int offset);
-    Nlp::ResultList getResultsForNode(const Nlp::Node *node);
-    QString expandVars(const QString &output, bool *ok);
-    void parseRuleInput(const QString &input, Nlp::WordList &words);
-    void parseUserInput(const QString &input, Nlp::WordList &words);
-    void checkSyntax(Nlp::WordList &words);
-    void filterSymbols(Nlp::WordList &words);
-    void parseExactMatch(Nlp::WordList &words);
+                   Nlp::SearchContext &ctx) const;
+    void expandNode(ScoredChildList &childs, const Nlp::Node *node, const Nlp::WordList &words,
+                    const Nlp::SearchContext &ctx, int offset) const;
+    bool visitChild(ResultList &r, const Nlp::Node *node, float matchWeight,
+                    const Nlp::WordList &words, Nlp::SearchContext &ctx, int offset) const;
+    bool getLiteralResults(Nlp::ResultList &results, const Nlp::WordList &words,
+                           Nlp::SearchContext &ctx) const;
+    void discardAbortedResults(Nlp::ResultList &results, const Nlp::WordList &words,
+                               const Nlp::SearchContext &ctx) const;
+
+    void getPhraseResults(Nlp::ResultList &results, const Nlp::WordList &words,
+                          Nlp::SearchContext &ctx) const;
+    Nlp::ScoringAlgorithm phraseScore(const Nlp::Node *node, int first,
+                                      const Nlp::WordList &words,
+                                      const Nlp::SearchContext &ctx) const;
+    void lookupFuzzyCandidates(const Nlp::WordList &words, Nlp::SearchContext &ctx) const;
+    bool getSimilarResult(const Nlp::WordList &words, Nlp::Result &result,
+                          const Nlp::SearchContext &ctx) const;
+    void setTokenMasks(const Nlp::WordList &words, Nlp::SearchContext &ctx) const;
+
+    void buildLiteralIndex(const Nlp::Node *node, const Nlp::SymbolSequence &key) const;
+    void buildFuzzyIndex() const;
+    void buildTokenFilter(Nlp::Node *node, QHash<const Nlp::Node *, bool> &built) const;
+
+    void lintNode(const Nlp::Node *node, Nlp::RuleIssueList &issues,
+                  QSet<RuleInput> &inputs) const;
+    bool hasWildcardOutput(const Nlp::Node *node, quint64 omapId) const;
+    void handleEndWord(Nlp::ResultList &results, const Nlp::Node *node, int offset,
+                       Nlp::SearchContext &ctx) const;
+    bool getResultsForNode(Nlp::ResultList &results, const Nlp::Node *node,
+                           Nlp::SearchContext &ctx) const;
+    QString expandVars(const Nlp::OutputTemplate &output, bool *ok,
+                       Nlp::SearchContext &ctx) const;
+    bool getNestedResponse(const QString &input, Nlp::Result &result,
+                           Nlp::SearchContext &ctx) const;
+    void parseRuleInput(Nlp::WordList &words) const;
+    void checkSyntax(Nlp::WordList &words) const;
+    void filterSymbols(Nlp::WordList &words) const;
+    void lookupUserWords(Nlp::WordList &words) const;
+    void parseExactMatch(Nlp::WordList &words) const;
 };
 
 /// @}
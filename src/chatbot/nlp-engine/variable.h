@@ -76,6 +76,14 @@ public:
         scope.clear();
         value.clear();
     }
+
+    /**
+     * Returns true if the variable is equal to \a other. Otherwise; returns false.
+     */
+    bool operator==(const Variable &other) const
+    {
+        return name == other.name && value == other.value && scope == other.scope;
+    }
 };
 
 
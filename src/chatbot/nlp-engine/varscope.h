@@ -79,6 +79,14 @@ public:
     {
         return start <= i && i <= end;
     }
+
+    /**
+     * Returns true if the scope is equal to \a other. Otherwise; returns false.
+     */
+    bool operator==(const VarScope &other) const
+    {
+        return start == other.start && end == other.end;
+    }
 };
 
 
@@ -23,23 +23,6 @@
 
 #define CAPTURE_SEP         " "
 
-//--------------------------------------------------------------------------------------------------
-// Helpers
-//--------------------------------------------------------------------------------------------------
-
-namespace
-{
-
-inline void removeLastWord(QString &s)
-{
-    int n = s.lastIndexOf(CAPTURE_SEP);
-
-    s = (n == -1) ? QString() : s.mid(0, n);
-}
-
-} // namespace
-
-
 //--------------------------------------------------------------------------------------------------
 // VarStack
 //--------------------------------------------------------------------------------------------------
@@ -47,53 +30,78 @@ inline void removeLastWord(QString &s)
 void Lvk::Nlp::VarStack::update(const QString &varName, int offset)
 {
     // If current variable out of scope
-    while (m_stack.size() > 0 && m_stack.last().scope.start >= offset) {
+    while (m_stack.size() > 0 && m_stack[m_stack.size() - 1].scope.start >= offset) {
         m_stack.removeLast();
     }
 
     // Rewind
-    while (m_stack.size() > 0 && m_stack.last().scope.end >= offset) {
-        m_stack.last().scope.end -= 1;
-        removeLastWord(m_stack.last().value); // Ugly! TODO move this out and optimize!
+    if (m_stack.size() > 0 && m_stack[m_stack.size() - 1].scope.end >= offset) {
+        m_stack[m_stack.size() - 1].scope.end = offset - 1;
     }
 
     if (!varName.isEmpty()) {
-        if (m_stack.isEmpty()) {
-            m_stack.append(Nlp::Variable(varName, Nlp::VarScope(offset, offset)));
+        // Extend the current variable only if the new word is next to the captured ones.
+        // Otherwise, a new range is pushed and value() joins both.
+        if (m_stack.size() > 0 && m_stack[m_stack.size() - 1].name == varName
+                && m_stack[m_stack.size() - 1].scope.end == offset - 1) {
+            m_stack[m_stack.size() - 1].scope.end = offset;
         } else {
-            if (m_stack.last().name != varName) {
-                m_stack.append(Nlp::Variable(varName, Nlp::VarScope(offset, offset)));
-            } else {
-                m_stack.last().scope.end = offset;
-            }
+            m_stack.append(Nlp::Variable(varName, Nlp::VarScope(offset, offset)));
         }
     }
-
-    //qDebug() << "VarStack:" << m_stack;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Nlp::VarStack::capture(const QString &word, int offset)
+QString Lvk::Nlp::VarStack::value(const QString &varName) const
 {
-    // If there is a variable in scope
-    if (!m_stack.isEmpty() && m_stack.last().scope.contains(offset)) {
-        QString &value = m_stack.last().value;
-        if (value.size() > 0) {
-            value.append(CAPTURE_SEP);
+    int last = m_stack.size() - 1;
+
+    while (last >= 0 && m_stack[last].name != varName) {
+        --last;
+    }
+
+    if (last < 0 || !m_words) {
+        return QString();
+    }
+
+    // Consecutive ranges of the same variable
+    int first = last;
+
+    while (first > 0 && m_stack[first - 1].name == varName) {
+        --first;
+    }
+
+    QString value;
+
+    for (int i = first; i <= last; ++i) {
+        int start = qMax(m_stack[i].scope.start, 0);
+        int end = qMin(m_stack[i].scope.end, m_words->size() - 1);
+
+        for (int j = start; j <= end; ++j) {
+            if (!value.isEmpty()) {
+                value.append(CAPTURE_SEP);
+            }
+            value.append(m_words->at(j).origWord);
         }
-        value.append(word);
     }
+
+    return value;
 }
 
 //--------------------------------------------------------------------------------------------------
 
-QString Lvk::Nlp::VarStack::value(const QString &varName) const
+bool Lvk::Nlp::VarStack::operator==(const VarStack &other) const
 {
-    for (int i = m_stack.size() - 1; i >= 0; --i) {
-        if (m_stack[i].name == varName) {
-            return m_stack[i].value;
+    if (m_stack.size() != other.m_stack.size() || m_words != other.m_words) {
+        return false;
+    }
+
+    for (int i = 0; i < m_stack.size(); ++i) {
+        if (!(m_stack[i] == other.m_stack[i])) {
+            return false;
         }
     }
-    return QString();
+
+    return true;
 }
@@ -23,9 +23,10 @@
 #define LVK_NLP_VARSTACK_H
 
 #include <QString>
-#include <QList>
+#include <QVarLengthArray>
 
 #include "nlp-engine/variable.h"
+#include "nlp-engine/word.h"
 
 namespace Lvk
 {
@@ -44,19 +45,48 @@ namespace Nlp
  * \brief The VarStack class provides a stack of variables.
  *
  * This class is used internally by the Cb2Engine class to keep track of the variables being used.
+ *
+ * Variables only keep the range of words they capture. Variable values are built from the
+ * words set with setWords() when they are requested, usually only when an output uses them.
  */
 class VarStack
 {
 public:
 
+    /**
+     * Constructs an empty stack of variables that capture words from \a words
+     */
+    VarStack(const Nlp::WordList *words = 0)
+        : m_words(words) { }
+
+    /**
+     * Sets the list of words the variables capture from
+     */
+    void setWords(const Nlp::WordList *words)
+    {
+        m_words = words;
+    }
+
+    /**
+     * Updates the stack after matching the word at \a offset with the variable \a varName. If
+     * the word was not matched with a variable, \a varName must be empty.
+     */
     void update(const QString &varName, int offset);
 
-    void capture(const QString &word, int offset);
-
+    /**
+     * Returns the words captured by the variable \a varName separated by spaces
+     */
     QString value(const QString &varName) const;
 
+    /**
+     * Returns true if both stacks hold the same variables with the same scopes. Otherwise;
+     * returns false.
+     */
+    bool operator==(const VarStack &other) const;
+
 private:
-    QList<Variable> m_stack;
+    QVarLengthArray<Nlp::Variable, 8> m_stack;
+    const Nlp::WordList *m_words;
 };
 
 /// @}
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nlp-engine/vectorindex.h"
+
+#include <QDataStream>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Appends to features the sorted lemmas and pairs of consecutive lemmas. Lemmas fit in the
+// lower 32 bits and pairs never do, so both share the same key space. NullSymbol's and the
+// pairs they are part of are not appended, returns how many they are.
+int extractFeatures(const QVector<Lvk::Nlp::SymbolId> &lemmas, QVector<quint64> &features)
+{
+    int nulls = 0;
+
+    for (int i = 0; i < lemmas.size(); ++i) {
+        if (lemmas[i] == Lvk::Nlp::NullSymbol) {
+            nulls += i > 0 ? 2 : 1;
+            continue;
+        }
+
+        features.append(lemmas[i]);
+
+        if (i > 0) {
+            if (lemmas[i - 1] != Lvk::Nlp::NullSymbol) {
+                features.append(((quint64)lemmas[i - 1] << 32) | lemmas[i]);
+            } else {
+                ++nulls;
+            }
+        }
+    }
+
+    qSort(features);
+
+    return nulls;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Sublinear term frequency
+inline float tfWeight(int tf)
+{
+    return 1.0f + std::log((float)tf);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool moreSimilar(const Lvk::Nlp::SimilarInput &i1, const Lvk::Nlp::SimilarInput &i2)
+{
+    return i1.similarity > i2.similarity;
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// VectorIndex
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::VectorIndex::VectorIndex()
+    : m_maxIdf(1)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::VectorIndex::add(RuleId ruleId, int inputIdx, const QVector<SymbolId> &lemmas)
+{
+    Row row;
+    row.inputIdx = inputIdx;
+    row.lemmas = lemmas;
+
+    m_rows[ruleId].append(row);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::VectorIndex::remove(RuleId ruleId)
+{
+    m_rows.remove(ruleId);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::VectorIndex::clear()
+{
+    m_rows.clear();
+    build();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::VectorIndex::build()
+{
+    m_features.clear();
+    m_idf.clear();
+    m_colStart.clear();
+    m_postRow.clear();
+    m_postWeight.clear();
+    m_rowRule.clear();
+    m_rowInput.clear();
+
+    // Rules are sorted by ID, so rows with the same similarity are always found in the
+    // same order
+
+    QList<RuleId> ruleIds = m_rows.keys();
+    qSort(ruleIds);
+
+    QVector< QVector<quint64> > rowFeatures;
+    QVector<int> df;
+
+    foreach (RuleId ruleId, ruleIds) {
+        foreach (const Row &row, m_rows[ruleId]) {
+            QVector<quint64> features;
+            extractFeatures(row.lemmas, features);
+
+            if (features.isEmpty()) {
+                continue;
+            }
+
+            for (int i = 0; i < features.size(); ++i) {
+                if (i > 0 && features[i] == features[i - 1]) {
+                    continue;
+                }
+
+                QHash<quint64, int>::iterator it = m_features.find(features[i]);
+                if (it == m_features.end()) {
+                    it = m_features.insert(features[i], df.size());
+                    df.append(0);
+                }
+                ++df[*it];
+            }
+
+            rowFeatures.append(features);
+            m_rowRule.append(ruleId);
+            m_rowInput.append(row.inputIdx);
+        }
+    }
+
+    int rows = rowFeatures.size();
+    int cols = df.size();
+
+    // Smoothed IDF, as if an extra row had every feature
+
+    m_maxIdf = std::log((float)(1 + rows)) + 1.0f;
+    m_idf.resize(cols);
+    m_colStart.resize(cols + 1);
+    m_colStart[0] = 0;
+
+    for (int c = 0; c < cols; ++c) {
+        m_idf[c] = std::log((float)(1 + rows) / (float)(1 + df[c])) + 1.0f;
+        m_colStart[c + 1] = m_colStart[c] + df[c];
+    }
+
+    // Fill postings column by column
+
+    m_postRow.resize(m_colStart[cols]);
+    m_postWeight.resize(m_colStart[cols]);
+
+    QVector<int> next = m_colStart;
+    QVector<int> rowCols;
+    QVector<float> rowWeights;
+
+    for (int r = 0; r < rows; ++r) {
+        const QVector<quint64> &features = rowFeatures[r];
+        float norm2 = 0;
+
+        rowCols.clear();
+        rowWeights.clear();
+
+        for (int i = 0; i < features.size(); ) {
+            int j = i + 1;
+            while (j < features.size() && features[j] == features[i]) {
+                ++j;
+            }
+
+            int c = m_features.value(features[i]);
+            float w = tfWeight(j - i) * m_idf[c];
+
+            rowCols.append(c);
+            rowWeights.append(w);
+            norm2 += w * w;
+
+            i = j;
+        }
+
+        float norm = std::sqrt(norm2);
+
+        for (int i = 0; i < rowCols.size(); ++i) {
+            int p = next[rowCols[i]]++;
+            m_postRow[p] = r;
+            m_postWeight[p] = rowWeights[i] / norm;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::VectorIndex::size() const
+{
+    return m_rowRule.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Nlp::VectorIndex::featureCount() const
+{
+    return m_idf.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::VectorIndex::lookup(const QVector<SymbolId> &lemmas, float minSimilarity,
+                                   SimilarInputList &inputs) const
+{
+    if (m_rowRule.isEmpty()) {
+        return;
+    }
+
+    QVector<quint64> features;
+    int nulls = extractFeatures(lemmas, features);
+
+    // Unknown words still count in the norm of the user input, otherwise any input would be
+    // as similar as the part of it the rules know. Rule inputs never have them, so they only
+    // count in the norm.
+    float norm2 = nulls * m_maxIdf * m_maxIdf;
+
+    QVector<float> dots(m_rowRule.size(), 0);
+    QVector<int> touched;
+
+    for (int i = 0; i < features.size(); ) {
+        int j = i + 1;
+        while (j < features.size() && features[j] == features[i]) {
+            ++j;
+        }
+
+        QHash<quint64, int>::const_iterator it = m_features.constFind(features[i]);
+        float idf = it != m_features.constEnd() ? m_idf[*it] : m_maxIdf;
+        float w = tfWeight(j - i) * idf;
+
+        norm2 += w * w;
+
+        if (it != m_features.constEnd()) {
+            const int *row = m_postRow.constData();
+            const float *weight = m_postWeight.constData();
+
+            for (int p = m_colStart[*it], end = m_colStart[*it + 1]; p < end; ++p) {
+                if (dots[row[p]] == 0) {
+                    touched.append(row[p]);
+                }
+                dots[row[p]] += w * weight[p];
+            }
+        }
+
+        i = j;
+    }
+
+    if (touched.isEmpty()) {
+        return;
+    }
+
+    float norm = std::sqrt(norm2);
+
+    qSort(touched);
+
+    SimilarInputList similar;
+
+    foreach (int r, touched) {
+        float similarity = qMin(1.0f, dots[r] / norm);
+        if (similarity >= minSimilarity) {
+            similar.append(SimilarInput(m_rowRule[r], m_rowInput[r], similarity));
+        }
+    }
+
+    qStableSort(similar.begin(), similar.end(), moreSimilar);
+
+    inputs.append(similar);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Nlp::VectorIndex::save(QDataStream &stream) const
+{
+    Nlp::SymbolTable *symbols = Nlp::SymbolTable::instance();
+
+    stream << (quint32)m_rows.size();
+
+    for (RowsMap::const_iterator it = m_rows.constBegin(); it != m_rows.constEnd(); ++it) {
+        stream << (quint64)it.key() << (quint32)it->size();
+
+        foreach (const Row &row, *it) {
+            QStringList lemmas;
+            foreach (SymbolId lemma, row.lemmas) {
+                lemmas.append(symbols->string(lemma));
+            }
+            stream << (qint32)row.inputIdx << lemmas;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Nlp::VectorIndex::load(QDataStream &stream)
+{
+    Nlp::SymbolTable *symbols = Nlp::SymbolTable::instance();
+
+    RowsMap rows;
+    quint32 ruleCount = 0;
+
+    stream >> ruleCount;
+
+    for (quint32 i = 0; i < ruleCount && stream.status() == QDataStream::Ok; ++i) {
+        quint64 ruleId = 0;
+        quint32 rowCount = 0;
+        stream >> ruleId >> rowCount;
+
+        QList<Row> &ruleRows = rows[ruleId];
+
+        for (quint32 j = 0; j < rowCount && stream.status() == QDataStream::Ok; ++j) {
+            qint32 inputIdx = 0;
+            QStringList lemmas;
+            stream >> inputIdx >> lemmas;
+
+            Row row;
+            row.inputIdx = inputIdx;
+            for (int k = 0; k < lemmas.size(); ++k) {
+                row.lemmas.append(symbols->intern(lemmas[k]));
+            }
+            ruleRows.append(row);
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    m_rows = rows;
+
+    return true;
+}
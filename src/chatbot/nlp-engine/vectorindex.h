@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_NLP_VECTORINDEX_H
+#define LVK_NLP_VECTORINDEX_H
+
+#include <QList>
+#include <QHash>
+#include <QVector>
+
+#include "nlp-engine/rule.h"
+#include "nlp-engine/symboltable.h"
+
+class QDataStream;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Nlp
+{
+
+/// \ingroup Lvk
+/// \addtogroup Nlp
+/// @{
+
+/**
+ * \brief The SimilarInput struct provides a rule input similar to a user input
+ */
+struct SimilarInput
+{
+    SimilarInput(RuleId ruleId = 0, int inputIdx = 0, float similarity = 0)
+        : ruleId(ruleId), inputIdx(inputIdx), similarity(similarity) { }
+
+    RuleId ruleId;      ///< ID of the rule
+    int inputIdx;       ///< Index of the rule input
+    float similarity;   ///< Cosine similarity with the user input, between 0 and 1
+};
+
+/**
+ * \brief List of similar inputs
+ */
+typedef QList<SimilarInput> SimilarInputList;
+
+/**
+ * \brief The VectorIndex class provides TF-IDF vectors of rule inputs to find the ones most
+ *        similar to a user input
+ *
+ * Each rule input is a sequence of lemmas. Its features are the lemmas and the pairs of
+ * consecutive lemmas, weighted by TF-IDF and normalized, so similarities are cosines.
+ *
+ * Vectors are sparse, so they are stored as an inverted index: for each feature, the rows
+ * that have it and their weights, in contiguous arrays. A lookup only visits the rows that
+ * share at least one feature with the user input.
+ *
+ * Adding or removing rows does not update the index, build() must be called before lookups.
+ */
+class VectorIndex
+{
+public:
+
+    /**
+     * Constructs an empty index
+     */
+    VectorIndex();
+
+    /**
+     * Adds input \a inputIdx of rule \a ruleId with \a lemmas. NullSymbol separates phrases,
+     * for instance, where the input has a wildcard.
+     */
+    void add(RuleId ruleId, int inputIdx, const QVector<SymbolId> &lemmas);
+
+    /**
+     * Removes all inputs of rule \a ruleId
+     */
+    void remove(RuleId ruleId);
+
+    /**
+     * Removes all inputs
+     */
+    void clear();
+
+    /**
+     * Builds the inverted index of the inputs added so far
+     */
+    void build();
+
+    /**
+     * Returns the amount of inputs in the index, as of the last build()
+     */
+    int size() const;
+
+    /**
+     * Returns the amount of distinct features in the index, as of the last build()
+     */
+    int featureCount() const;
+
+    /**
+     * Appends to \a inputs the rule inputs with similarity \a minSimilarity or higher with a
+     * user input with \a lemmas, sorted by similarity. NullSymbol stands for a word unknown
+     * to the symbol table. It weighs as a feature no rule input has.
+     */
+    void lookup(const QVector<SymbolId> &lemmas, float minSimilarity,
+                SimilarInputList &inputs) const;
+
+    /**
+     * Writes the inputs to \a stream. Lemmas are written as strings since symbol IDs are only
+     * valid in the current process.
+     */
+    void save(QDataStream &stream) const;
+
+    /**
+     * Replaces the inputs with the ones read from \a stream. Returns true on success.
+     * Otherwise; returns false and the index is not modified. build() must be called before
+     * lookups.
+     */
+    bool load(QDataStream &stream);
+
+private:
+    struct Row
+    {
+        int inputIdx;
+        QVector<SymbolId> lemmas;
+    };
+
+    typedef QHash<RuleId, QList<Row> > RowsMap;
+
+    RowsMap m_rows;                     // inputs of each rule
+
+    QHash<quint64, int> m_features;     // feature -> column
+    QVector<float> m_idf;               // IDF of each column
+    QVector<int> m_colStart;            // first posting of each column, plus the end
+    QVector<int> m_postRow;             // row of each posting
+    QVector<float> m_postWeight;        // normalized weight of each posting
+    QVector<RuleId> m_rowRule;          // rule of each row
+    QVector<int> m_rowInput;            // input index of each row
+    float m_maxIdf;                     // IDF of features not in the index
+};
+
+/// @}
+
+} // namespace Nlp
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_NLP_VECTORINDEX_H
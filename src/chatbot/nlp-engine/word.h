@@ -31,6 +31,8 @@
 #include <QMetaType>
 
 #include "nlp-engine/syntax.h"
+#include "nlp-engine/symboltable.h"
+#include "nlp-engine/inlinelist.h"
 
 namespace Lvk
 {
@@ -60,7 +62,8 @@ public:
      * lemma \a lemma
      */
     Word(const QString origWord = "", const QString normWord = "", const QString lemma = "")
-        : origWord(origWord), normWord(normWord), lemma(lemma) { }
+        : origWord(origWord), normWord(normWord), lemma(lemma), origWordId(NullSymbol),
+          lemmaId(NullSymbol), posTagId(NullSymbol) { }
 
     QString origWord; ///< The original word
     QString normWord; ///< The normalized form of the original word
@@ -68,6 +71,34 @@ public:
     QString posTag;   ///< Word PoS tag
     QStringList altSpells; ///< Alternative spellings for the original word
 
+    SymbolId origWordId;   ///< Symbol of the original word. \see intern(), lookup()
+    SymbolId lemmaId;      ///< Symbol of the lemma
+    SymbolId posTagId;     ///< Symbol of the PoS tag
+
+    /**
+     * Interns the original word, the lemma and the PoS tag in the global SymbolTable and sets
+     * their symbols.
+     */
+    void intern()
+    {
+        SymbolTable *table = SymbolTable::instance();
+        origWordId = table->intern(origWord);
+        lemmaId = table->intern(lemma);
+        posTagId = table->intern(posTag);
+    }
+
+    /**
+     * Sets the symbols of the original word, the lemma and the PoS tag without adding new
+     * strings to the global SymbolTable. Strings not found get NullSymbol.
+     */
+    void lookup()
+    {
+        const SymbolTable *table = SymbolTable::instance();
+        origWordId = table->lookup(origWord);
+        lemmaId = table->lookup(lemma);
+        posTagId = table->lookup(posTag);
+    }
+
     /**
      * Returns true if \a this is equal to \a other. Otherwise; returns false.
      */
@@ -150,9 +181,33 @@ inline QDebug& operator<<(QDebug& dbg, const Word &w)
 
 
 /**
- * The WordList class provides a list of Word's
+ * Writes the given \a word to the stream \a stream
+ */
+inline QDataStream &operator<<(QDataStream &stream, const Word &word)
+{
+    stream << word.origWord << word.normWord << word.lemma << word.posTag << word.altSpells;
+
+    return stream;
+}
+
+/**
+ * Reads the given \a word from the stream \a stream
+ */
+inline QDataStream &operator>>(QDataStream &stream, Word &word)
+{
+    stream >> word.origWord >> word.normWord >> word.lemma >> word.posTag >> word.altSpells;
+
+    // Symbols are only valid within the current process
+    word.intern();
+
+    return stream;
+}
+
+
+/**
+ * The WordList class provides a list of Word's. Inputs of up to 16 words are stored inline.
  */
-typedef QList<Word> WordList;
+typedef InlineList<Word, 16> WordList;
 
 /// @}
 
@@ -162,5 +217,7 @@ typedef QList<Word> WordList;
 
 } // namespace Lvk
 
+Q_DECLARE_TYPEINFO(Lvk::Nlp::Word, Q_MOVABLE_TYPE);
+
 #endif // LVK_NLP_WORD_H
 
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "server/chatbotserver.h"
+#include "back-end/appfacade.h"
+#include "common/profiler.h"
+#include "common/memorymanager.h"
+#include "common/maintenancescheduler.h"
+#include "common/taskscheduler.h"
+#include "common/settings.h"
+#include "common/trace.h"
+
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+#include <QVariantMap>
+#include <QtDebug>
+
+#define RECONNECT_DELAY     30000   // Milliseconds before reconnecting after an error
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Appends one line per metric with the form <prefix><key> <value>. Nested maps are appended
+// with the form <prefix><key>_<nested key>
+void appendMetrics(QByteArray &out, const QString &prefix, const QVariantMap &map)
+{
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+        if (it.value().type() == QVariant::Map) {
+            appendMetrics(out, prefix + it.key() + "_", it.value().toMap());
+        } else {
+            out += (prefix + it.key() + " " + it.value().toString() + "\n").toUtf8();
+        }
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// ChatbotServer
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Srv::ChatbotServer::ChatbotServer(QObject *parent /*= 0*/)
+    : QObject(parent),
+      m_appFacade(new BE::AppFacade(this)),
+      m_localServer(new QLocalServer(this)),
+      m_reconnectTimer(new QTimer(this)),
+      m_connected(false),
+      m_lastError(-1),
+      m_reconnections(0),
+      m_entries(0),
+      m_matchedEntries(0)
+{
+    m_uptime.start();
+
+    m_reconnectTimer->setSingleShot(true);
+    m_reconnectTimer->setInterval(RECONNECT_DELAY);
+
+    connect(m_appFacade, SIGNAL(connected()),          SLOT(onConnected()));
+    connect(m_appFacade, SIGNAL(disconnected()),       SLOT(onDisconnected()));
+    connect(m_appFacade, SIGNAL(connectionError(int)), SLOT(onConnectionError(int)));
+    connect(m_appFacade, SIGNAL(newConversationEntry(Cmn::Conversation::Entry)),
+            SLOT(onNewConversationEntry(Cmn::Conversation::Entry)));
+
+    connect(m_reconnectTimer, SIGNAL(timeout()),       SLOT(onReconnectTimeout()));
+    connect(m_localServer,    SIGNAL(newConnection()), SLOT(onNewLocalConnection()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Srv::ChatbotServer::~ChatbotServer()
+{
+    // AppFacade disconnects and closes the file when destroyed
+    m_reconnectTimer->stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Srv::ChatbotServer::start(const QString &filename, const QString &password,
+                                    const QString &socketName)
+{
+    if (!m_appFacade->load(filename)) {
+        m_errorString = tr("Cannot load chatbot file %1").arg(filename);
+        return false;
+    }
+
+    if (m_appFacade->chatUsername().isEmpty()) {
+        m_errorString = tr("Chatbot file %1 has no chat account").arg(filename);
+        return false;
+    }
+
+    // A socket left by a server that crashed prevents listening
+    QLocalServer::removeServer(socketName);
+
+    if (!m_localServer->listen(socketName)) {
+        m_errorString = tr("Cannot listen on local socket %1: %2")
+                .arg(socketName, m_localServer->errorString());
+        return false;
+    }
+
+    m_password = password;
+
+    qDebug() << "ChatbotServer: Connecting" << m_appFacade->chatUsername();
+
+    m_appFacade->connectToChat(m_appFacade->chatType(), m_appFacade->chatUsername(), m_password);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Srv::ChatbotServer::errorString() const
+{
+    return m_errorString;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Srv::ChatbotServer::onConnected()
+{
+    qDebug() << "ChatbotServer: Connected";
+
+    m_connected = true;
+    m_lastError = -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Srv::ChatbotServer::onDisconnected()
+{
+    qWarning() << "ChatbotServer: Disconnected";
+
+    m_connected = false;
+    m_reconnectTimer->start();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Srv::ChatbotServer::onConnectionError(int err)
+{
+    qWarning() << "ChatbotServer: Connection error" << err;
+
+    m_connected = false;
+    m_lastError = err;
+    m_reconnectTimer->start();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Srv::ChatbotServer::onNewConversationEntry(const Cmn::Conversation::Entry &entry)
+{
+    ++m_entries;
+
+    if (entry.match) {
+        ++m_matchedEntries;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Srv::ChatbotServer::onReconnectTimeout()
+{
+    qDebug() << "ChatbotServer: Reconnecting" << m_appFacade->chatUsername();
+
+    ++m_reconnections;
+
+    m_appFacade->disconnectFromChat();
+    m_appFacade->connectToChat(m_appFacade->chatType(), m_appFacade->chatUsername(), m_password);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Srv::ChatbotServer::onNewLocalConnection()
+{
+    while (QLocalSocket *socket = m_localServer->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()),    SLOT(onLocalReadyRead()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Srv::ChatbotServer::onLocalReadyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+
+    if (!socket) {
+        return;
+    }
+
+    while (socket->canReadLine()) {
+        QByteArray cmd = socket->readLine().trimmed();
+
+        if (cmd == "health") {
+            socket->write(health());
+        } else if (cmd == "metrics") {
+            socket->write(metrics());
+        } else if (cmd.startsWith("trace ")) {
+            QString filename = QString::fromUtf8(cmd.mid(6).trimmed());
+            if (Cmn::Profiler::exportChromeTrace(filename)) {
+                socket->write("ok\n");
+            } else {
+                socket->write("error cannot write trace\n");
+            }
+        } else if (cmd == "release" || cmd.startsWith("release ")) {
+            Cmn::MemoryManager *mgr = Cmn::MemoryManager::manager();
+            qint64 bytes = cmd.size() > 8 ? cmd.mid(8).trimmed().toLongLong()*1024*1024
+                                          : mgr->usage();
+            QVariantMap released = mgr->release(bytes);
+            qint64 total = 0;
+            foreach (const QVariant &value, released) {
+                total += value.toLongLong();
+            }
+            socket->write("ok " + QByteArray::number(total) + "\n");
+        } else if (cmd == "maintenance") {
+            int tasks = Cmn::MaintenanceScheduler::scheduler()->runAll();
+            socket->write("ok " + QByteArray::number(tasks) + "\n");
+        } else if (cmd == "reload") {
+            Cmn::SettingsSnapshot::reload();
+            Cmn::Profiler::init();
+            Cmn::Trace::init();
+            Cmn::MemoryManager::init();
+            Cmn::MaintenanceScheduler::init();
+            Cmn::TaskScheduler::init();
+            socket->write("ok\n");
+        } else if (cmd == "quit") {
+            socket->write("ok\n");
+            socket->flush();
+            QCoreApplication::quit();
+        } else {
+            socket->write("error unknown command\n");
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::Srv::ChatbotServer::health() const
+{
+    if (m_connected) {
+        return "ok\n";
+    } else if (!m_appFacade->isNlpEngineReady()) {
+        return "error loading\n";
+    } else if (m_lastError != -1) {
+        return "error connection " + QByteArray::number(m_lastError) + "\n";
+    } else {
+        return "error disconnected\n";
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QByteArray Lvk::Srv::ChatbotServer::metrics() const
+{
+    QByteArray out;
+
+    out += "uptime_secs " + QByteArray::number(m_uptime.elapsed() / 1000) + "\n";
+    out += "connected " + QByteArray::number(m_connected ? 1 : 0) + "\n";
+    out += "reconnections " + QByteArray::number(m_reconnections) + "\n";
+    out += "entries " + QByteArray::number(m_entries) + "\n";
+    out += "matched_entries " + QByteArray::number(m_matchedEntries) + "\n";
+    out += "nlp_ready " + QByteArray::number(m_appFacade->isNlpEngineReady() ? 1 : 0) + "\n";
+
+    appendMetrics(out, "nlp_", m_appFacade->nlpStats());
+    appendMetrics(out, "admission_", m_appFacade->admissionStats());
+
+    if (m_appFacade->isNlpEngineReady()) {
+        appendMetrics(out, "nlp_mem_", m_appFacade->nlpMemoryReport());
+    }
+
+    appendMetrics(out, "memory_", Cmn::MemoryManager::manager()->report());
+    appendMetrics(out, "maintenance_", Cmn::MaintenanceScheduler::scheduler()->report());
+    appendMetrics(out, "scheduler_", Cmn::TaskScheduler::scheduler()->stats());
+
+    return out;
+}
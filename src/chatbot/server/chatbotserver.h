@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_SRV_CHATBOTSERVER_H
+#define LVK_SRV_CHATBOTSERVER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include "common/conversation.h"
+
+class QLocalServer;
+class QTimer;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace BE
+{
+class AppFacade;
+}
+
+namespace Srv
+{
+
+/// \ingroup Lvk
+/// \addtogroup Srv
+/// @{
+
+/**
+ * \brief The ChatbotServer class runs a chatbot without user interface.
+ *
+ * The ChatbotServer class loads a chatbot file, connects it to the chat server with the chat
+ * type and username stored in the file, and reconnects it whenever the connection is lost.
+ *
+ * Health and metrics are served through a local socket. Clients send one command per line
+ * and get a text response:
+ * - \c health returns "ok" if the chatbot is connected. Otherwise; returns "error" and the
+ *   reason.
+ * - \c metrics returns one "key value" pair per line with the uptime, connection state,
+ *   received messages, decisions of the flood protection, NLP engine latencies, NLP memory
+ *   report, the memory budget, the background maintenance and the shared worker threads.
+ *   See CA::AdmissionControl::Stats, Cmn::MemoryManager::report(),
+ *   Cmn::MaintenanceScheduler::report() and Cmn::TaskScheduler::stats().
+ * - \c trace \e filename writes the profiler events to \e filename in the Chrome trace event
+ *   format. See Cmn::Profiler.
+ * - \c release [\e megabytes] releases \e megabytes, or as much as possible if not given, from
+ *   caches and stores of the Cmn::MemoryManager. Meant for external memory pressure monitors.
+ * - \c maintenance runs now all pending tasks of the Cmn::MaintenanceScheduler, regardless of
+ *   the load. Returns the amount of tasks run.
+ * - \c reload reads the settings file again. Settings read only on startup are not changed.
+ * - \c quit disconnects the chatbot and exits the event loop.
+ */
+class ChatbotServer : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Constructs a ChatbotServer with \a parent
+     */
+    ChatbotServer(QObject *parent = 0);
+
+    /**
+     * Destroys the object and disconnects the chatbot
+     */
+    ~ChatbotServer();
+
+    /**
+     * Loads the chatbot \a filename, connects it with \a password and listens for health and
+     * metrics requests on the local socket \a socketName. Returns true on success. Otherwise;
+     * returns false and errorString() describes the error.
+     */
+    bool start(const QString &filename, const QString &password, const QString &socketName);
+
+    /**
+     * Returns a description of the last error
+     */
+    QString errorString() const;
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onConnectionError(int err);
+    void onNewConversationEntry(const Cmn::Conversation::Entry &entry);
+    void onReconnectTimeout();
+    void onNewLocalConnection();
+    void onLocalReadyRead();
+
+private:
+    ChatbotServer(const ChatbotServer&);
+    ChatbotServer & operator=(const ChatbotServer&);
+
+    BE::AppFacade *m_appFacade;
+    QLocalServer *m_localServer;
+    QTimer *m_reconnectTimer;
+    QString m_password;
+    QString m_errorString;
+    QElapsedTimer m_uptime;
+    bool m_connected;
+    int m_lastError;
+    int m_reconnections;
+    int m_entries;
+    int m_matchedEntries;
+
+    QByteArray health() const;
+    QByteArray metrics() const;
+};
+
+/// @}
+
+} // namespace Srv
+
+/// @}
+
+} // namespace Lvk
+
+#endif // LVK_SRV_CHATBOTSERVER_H
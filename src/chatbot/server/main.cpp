@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+#include <iostream>
+#include <cstdlib>
+
+#include "server/chatbotserver.h"
+#include "common/version.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "common/logger.h"
+#include "common/crashhandler.h"
+#include "common/memorymanager.h"
+#include "common/maintenancescheduler.h"
+#include "common/taskscheduler.h"
+#include "common/startuptimeline.h"
+#include "nlp-engine/lemmatizerfactory.h"
+
+#define DEFAULT_SOCKET_NAME     "lvk-chatbot"
+#define PASSWORD_ENV_VAR        "LVK_CHAT_PASSWORD"
+
+struct CmdLineOptions
+{
+    bool valid;
+    QtMsgType verboseLevel;
+    QString chatbotFilename;
+    QString socketName;
+    QString passwordFilename;
+};
+
+void getCmdLineOptions(CmdLineOptions &opt);
+bool readPassword(const CmdLineOptions &opt, QString &password);
+void makeDirStructure();
+void showSyntax();
+void makeDir(const QString &name);
+
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication::setOrganizationName(ORGANIZATION_NAME);
+    QCoreApplication::setOrganizationDomain(ORGANIZATION_DOMAIN);
+    QCoreApplication::setApplicationName(APP_NAME);
+
+    Lvk::Cmn::StartupTimeline::start();
+
+    QCoreApplication app(argc, argv);
+
+    CmdLineOptions opt;
+    getCmdLineOptions(opt);
+
+    if (!opt.valid) {
+        showSyntax();
+        return 1;
+    }
+
+    QString password;
+
+    if (!readPassword(opt, password)) {
+        std::cerr << "Error: Cannot read password" << std::endl;
+        return 1;
+    }
+
+    QDir::setCurrent(QCoreApplication::applicationDirPath());
+
+    makeDirStructure();
+
+    Lvk::Cmn::Logger::setVerboseLevel(opt.verboseLevel);
+    Lvk::Cmn::Logger::init();
+    Lvk::Cmn::MemoryManager::init();
+    Lvk::Cmn::MaintenanceScheduler::init();
+    Lvk::Cmn::TaskScheduler::init();
+    Lvk::Cmn::CrashHandler::init();
+    Lvk::Nlp::LemmatizerFactory().preloadLemmatizer();
+
+    Lvk::Srv::ChatbotServer server;
+
+    if (!server.start(opt.chatbotFilename, password, opt.socketName)) {
+        std::cerr << "Error: " << server.errorString().toUtf8().data() << std::endl;
+        return 1;
+    }
+
+    qDebug() << "Server started" << Lvk::Cmn::StartupTimeline::elapsed() << "ms after launch";
+
+    return app.exec();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+void getCmdLineOptions(CmdLineOptions & opt)
+{
+    opt.valid = true;
+    opt.verboseLevel = QtWarningMsg;
+    opt.socketName = DEFAULT_SOCKET_NAME;
+
+    QStringList args = QCoreApplication::arguments();
+
+    for (int i = 1; i < args.size() && opt.valid; ++i) {
+        QString arg = args[i];
+        if (arg.startsWith("--verbose=")) {
+            QStringList tokens = arg.split("=");
+            opt.verboseLevel = static_cast<QtMsgType>(QtFatalMsg - tokens[1].toInt(&opt.valid));
+        } else if (arg == "--socket") {
+            ++i;
+            if (i < args.size()) {
+                opt.socketName = args[i];
+            } else {
+                opt.valid = false;
+            }
+        } else if (arg == "--password-file") {
+            ++i;
+            if (i < args.size()) {
+                opt.passwordFilename = args[i];
+            } else {
+                opt.valid = false;
+            }
+        } else if (!arg.startsWith("-")) {
+            opt.chatbotFilename = arg;
+        } else {
+            qWarning() << "Warning: Unknown option" << arg;
+        }
+    }
+
+    opt.valid = opt.valid && !opt.chatbotFilename.isEmpty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// The password is never passed as an argument, so it is not visible in the process list
+bool readPassword(const CmdLineOptions &opt, QString &password)
+{
+    if (opt.passwordFilename.isEmpty()) {
+        password = QString::fromLocal8Bit(qgetenv(PASSWORD_ENV_VAR));
+        return true;
+    }
+
+    QFile file(opt.passwordFilename);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    password = QString::fromUtf8(file.readLine()).trimmed();
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void showSyntax()
+{
+    QString appname = QCoreApplication::arguments().first();
+
+    std::cerr << "Error: Invalid command line arguments." << std::endl;
+    std::cout << "Syntax: " << std::endl;
+    std::cout << QString("   %1 <chatbot_file> [--socket NAME] [--password-file FILE] "
+                         "[--verbose=N]").arg(appname).toUtf8().data() << std::endl;
+    std::cout << "   If --password-file is not set, the password is read from "
+                 PASSWORD_ENV_VAR << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void makeDirStructure()
+{
+    LVK_STARTUP_PHASE("make_dirs");
+
+    Lvk::Cmn::Settings settings;
+
+    makeDir(settings.value(SETTING_LOGS_PATH).toString());
+    makeDir(settings.value(SETTING_DATA_PATH).toString());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void makeDir(const QString &name)
+{
+    QDir qdir;
+
+    if (!qdir.exists(name)) {
+        if (!qdir.mkpath(name)) {
+            qCritical() << "Critical: Cannot create path " << name;
+            exit(1);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#-------------------------------------------------
+#
+# Headless chatbot server
+#
+# Runs a chatbot without the front-end module. Health and metrics are served through a local
+# socket, see server/chatbotserver.h
+#
+#-------------------------------------------------
+
+QT       += network
+TARGET = chatbot-server
+CONFIG   += console freeling
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+PROJECT_PATH = ..
+
+INCLUDEPATH += \
+    $$PROJECT_PATH
+
+HEADERS += \
+    $$PROJECT_PATH/server/chatbotserver.h
+
+SOURCES += \
+    $$PROJECT_PATH/server/chatbotserver.cpp \
+    $$PROJECT_PATH/server/main.cpp
+
+include($$PROJECT_PATH/back-end/back-end.pri)
+include($$PROJECT_PATH/nlp-engine/nlp-engine.pri)
+include($$PROJECT_PATH/chat-adapter/chat-adapter.pri)
+include($$PROJECT_PATH/da-server/da-server.pri)
+include($$PROJECT_PATH/stats/stats.pri)
+include($$PROJECT_PATH/crypto/crypto.pri)
+include($$PROJECT_PATH/common/common.pri)
+include($$PROJECT_PATH/3rd-party.pri)
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "stats/distinctcounter.h"
+
+#include <QDataStream>
+
+//--------------------------------------------------------------------------------------------------
+// DistinctCounter
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::DistinctCounter::insert(const QString &s)
+{
+    switch (m_mode) {
+    case ExactMode:
+        if (m_strings.contains(s)) {
+            return false;
+        }
+        m_strings.insert(s);
+        return true;
+
+    case HashedMode: {
+        quint64 h = hash(s);
+        if (m_hashes.contains(h)) {
+            return false;
+        }
+        m_hashes.insert(h);
+        return true;
+    }
+
+    case ApproximateMode:
+        m_hll.add(hash(s));
+        return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::DistinctCounter::contains(const QString &s) const
+{
+    switch (m_mode) {
+    case ExactMode:
+        return m_strings.contains(s);
+    case HashedMode:
+        return m_hashes.contains(hash(s));
+    case ApproximateMode:
+        return false;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+unsigned Lvk::Stats::DistinctCounter::size() const
+{
+    switch (m_mode) {
+    case ExactMode:
+        return m_strings.size();
+    case HashedMode:
+        return m_hashes.size();
+    case ApproximateMode:
+        return m_hll.count();
+    }
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::DistinctCounter::clear()
+{
+    m_strings.clear();
+    m_hashes.clear();
+    m_hll.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::DistinctCounter::write(QDataStream &stream) const
+{
+    stream << static_cast<quint8>(m_mode);
+
+    switch (m_mode) {
+    case ExactMode:
+        stream << m_strings;
+        break;
+    case HashedMode:
+        stream << m_hashes;
+        break;
+    case ApproximateMode:
+        m_hll.write(stream);
+        break;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::DistinctCounter::read(QDataStream &stream)
+{
+    quint8 mode = 0;
+    stream >> mode;
+
+    if (mode > ApproximateMode) {
+        return false;
+    }
+
+    setMode(static_cast<Mode>(mode));
+
+    switch (m_mode) {
+    case ExactMode:
+        stream >> m_strings;
+        break;
+    case HashedMode:
+        stream >> m_hashes;
+        break;
+    case ApproximateMode:
+        if (!m_hll.read(stream)) {
+            return false;
+        }
+        break;
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+quint64 Lvk::Stats::DistinctCounter::hash(const QString &s)
+{
+    // FNV-1a over UTF-16 code units
+    quint64 h = Q_UINT64_C(14695981039346656037);
+
+    const ushort *c = s.utf16();
+    for (int i = 0; i < s.size(); ++i) {
+        h ^= c[i];
+        h *= Q_UINT64_C(1099511628211);
+    }
+
+    // Final avalanche (MurmurHash3 fmix64) so all bits are usable by HyperLogLog
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+
+    return h;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_STATS_DISTINCTCOUNTER_H
+#define LVK_STATS_DISTINCTCOUNTER_H
+
+#include "stats/hyperloglog.h"
+
+#include <QSet>
+#include <QString>
+
+class QDataStream;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Stats
+{
+
+/// \ingroup Lvk
+/// \addtogroup Stats
+/// @{
+
+/**
+ * \brief The DistinctCounter class counts distinct strings.
+ *
+ * Depending on the mode, strings are stored as they are, as 64-bit hashes or in a HyperLogLog
+ * sketch. Hashed counters use a fraction of the memory with a negligible chance of collision.
+ * Approximate counters use a fixed amount of memory but cannot answer contains().
+ */
+class DistinctCounter
+{
+public:
+
+    /**
+     * Counting modes
+     */
+    enum Mode
+    {
+        ExactMode,          ///< Stores strings
+        HashedMode,         ///< Stores 64-bit hashes of strings
+        ApproximateMode     ///< Uses a HyperLogLog sketch
+    };
+
+    /**
+     * Constructs an empty DistinctCounter with the given \a mode.
+     */
+    DistinctCounter(Mode mode = ExactMode)
+        : m_mode(mode)
+    {
+    }
+
+    /**
+     * Returns the counting mode.
+     */
+    Mode mode() const
+    {
+        return m_mode;
+    }
+
+    /**
+     * Sets the counting \a mode. Current elements are removed.
+     */
+    void setMode(Mode mode)
+    {
+        clear();
+        m_mode = mode;
+    }
+
+    /**
+     * Inserts the string \a s. Returns true if \a s was not in the counter. In ApproximateMode
+     * always returns true.
+     */
+    bool insert(const QString &s);
+
+    /**
+     * Returns true if the counter contains the string \a s. In ApproximateMode always returns
+     * false.
+     */
+    bool contains(const QString &s) const;
+
+    /**
+     * Returns the amount of distinct strings inserted. In ApproximateMode it is an estimation.
+     */
+    unsigned size() const;
+
+    /**
+     * Removes all strings.
+     */
+    void clear();
+
+    /**
+     * Writes the mode and the elements to \a stream.
+     */
+    void write(QDataStream &stream) const;
+
+    /**
+     * Reads the mode and the elements from \a stream. Returns true on success. Otherwise;
+     * returns false.
+     */
+    bool read(QDataStream &stream);
+
+    /**
+     * Returns the 64-bit hash of string \a s.
+     */
+    static quint64 hash(const QString &s);
+
+private:
+    Mode m_mode;
+    QSet<QString> m_strings;
+    QSet<quint64> m_hashes;
+    HyperLogLog m_hll;
+};
+
+/// @}
+
+} // namespace Stats
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_STATS_DISTINCTCOUNTER_H
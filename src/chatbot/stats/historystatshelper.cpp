@@ -30,6 +30,7 @@
 
 static const unsigned MAX_INACTIVITY = 60*15; // Max period of inactivity allowed. In seconds.
 static const unsigned MIN_CONV_LEN = 20;      // Minimum conversation entries to score a contact
+static const quint32 FORMAT_VERSION = 1;      // Format of write()
 
 // Tracks chatbot conversations. If the conversation has at least MIN_CONV_LEN entries and
 // it was not interfered by the user, adds username to the score contacts set
@@ -45,18 +46,20 @@ void Lvk::Stats::HistoryStatsHelper::trackConversation(const Lvk::Cmn::Conversat
     }
 
     ConversationInfo &info = m_convTracker[user];
+    DistinctCounter &diffLines = convDiffLines(user);
 
     // If inactivity period surpassed. i.e. new conversation
     if (entry.dateTime.toTime_t() - info.last.toTime_t() >= MAX_INACTIVITY) {
         info.entries = interfered ? 0 : 1;
         info.interfered = interfered;
 
-        m_deadConvDiffLinesCount += m_convDiffLines[user].size();
-        m_convDiffLines[user].clear();
+        m_deadConvDiffLinesCount += diffLines.size();
+        m_liveConvDiffLinesCount -= diffLines.size();
+        diffLines.clear();
     } else {
         if (interfered) {
             info.entries = 0;
-        } else if (!m_convDiffLines[user].contains(entry.response)) {
+        } else if (!diffLines.contains(entry.response)) {
             info.entries = info.entries + 1;
         }
         info.interfered |= interfered;
@@ -71,23 +74,125 @@ void Lvk::Stats::HistoryStatsHelper::trackConversation(const Lvk::Cmn::Conversat
         }
 
         m_cbDiffLines.insert(entry.response);
-        m_convDiffLines[user].insert(entry.response);
-        updateLexicon(splitSentence(entry.response), m_cbLexicon);
+        if (diffLines.insert(entry.response)) {
+            ++m_liveConvDiffLinesCount;
+        }
+        foreach (const QString &w, splitSentence(entry.response)) {
+            QString szw = sanitizeWord(w);
+            if (!szw.isEmpty()) {
+                m_cbLexicon.insert(szw);
+            }
+        }
         ++m_cbLinesCount;
     }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-unsigned Lvk::Stats::HistoryStatsHelper::liveConvDiffLinesCount() const
+// Returns the conversation diff lines of the given user. Since they need exact membership,
+// ApproximateMode falls back to HashedMode
+Lvk::Stats::DistinctCounter &
+Lvk::Stats::HistoryStatsHelper::convDiffLines(const QString &user)
 {
-    unsigned count = 0;
+    ConversationDiffLines::iterator it = m_convDiffLines.find(user);
+
+    if (it == m_convDiffLines.end()) {
+        DistinctCounter::Mode mode = countMode() == DistinctCounter::ExactMode ?
+                    DistinctCounter::ExactMode : DistinctCounter::HashedMode;
 
-    ConversationDiffLines::const_iterator it;
-    for (it = m_convDiffLines.begin(); it != m_convDiffLines.end(); ++it) {
-        count += it.value().size();
+        it = m_convDiffLines.insert(user, DistinctCounter(mode));
     }
 
-    return count;
+    return *it;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::HistoryStatsHelper::write(QDataStream &stream) const
+{
+    stream << FORMAT_VERSION;
+
+    StatsHelper::write(stream);
+
+    stream << static_cast<qint32>(m_convTracker.size());
+
+    ConversationTracker::const_iterator it;
+    for (it = m_convTracker.constBegin(); it != m_convTracker.constEnd(); ++it) {
+        stream << it.key() << it->last << it->entries << it->interfered;
+    }
+
+    stream << static_cast<qint32>(m_convDiffLines.size());
+
+    ConversationDiffLines::const_iterator jt;
+    for (jt = m_convDiffLines.constBegin(); jt != m_convDiffLines.constEnd(); ++jt) {
+        stream << jt.key();
+        jt->write(stream);
+    }
+
+    stream << m_scoreContacts;
+
+    m_cbDiffLines.write(stream);
+    m_cbLexicon.write(stream);
+
+    stream << m_cbLinesCount << m_deadConvDiffLinesCount << m_liveConvDiffLinesCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::HistoryStatsHelper::read(QDataStream &stream)
+{
+    DistinctCounter::Mode mode = countMode();
+
+    clear();
+
+    if (!readState(stream) || m_cbDiffLines.mode() != mode || m_cbLexicon.mode() != mode) {
+        setCountMode(mode);
+        return false;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::HistoryStatsHelper::readState(QDataStream &stream)
+{
+    quint32 version = 0;
+    stream >> version;
+
+    if (version != FORMAT_VERSION || !StatsHelper::read(stream)) {
+        return false;
+    }
+
+    qint32 n = 0;
+    stream >> n;
+
+    for (qint32 i = 0; i < n && stream.status() == QDataStream::Ok; ++i) {
+        QString user;
+        ConversationInfo info;
+        stream >> user >> info.last >> info.entries >> info.interfered;
+        m_convTracker.insert(user, info);
+    }
+
+    stream >> n;
+
+    for (qint32 i = 0; i < n && stream.status() == QDataStream::Ok; ++i) {
+        QString user;
+        DistinctCounter diffLines;
+        stream >> user;
+        if (!diffLines.read(stream)) {
+            return false;
+        }
+        m_convDiffLines.insert(user, diffLines);
+    }
+
+    stream >> m_scoreContacts;
+
+    if (!m_cbDiffLines.read(stream) || !m_cbLexicon.read(stream)) {
+        return false;
+    }
+
+    stream >> m_cbLinesCount >> m_deadConvDiffLinesCount >> m_liveConvDiffLinesCount;
+
+    return stream.status() == QDataStream::Ok;
+}
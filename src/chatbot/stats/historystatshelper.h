@@ -23,6 +23,7 @@
 #define LVK_STATS_HISTORYSTATSHELPER_H
 
 #include "stats/statshelper.h"
+#include "stats/distinctcounter.h"
 #include "common/conversation.h"
 #include "common/globalstrings.h"
 
@@ -46,6 +47,11 @@ namespace Stats
 /**
  * \brief The HistoryStatsHelper class provides chat history statistics such as total words,
  *        total lines and lexicon size.
+ *
+ * By default distinct lines and words are counted exactly. For long histories setCountMode()
+ * allows to store 64-bit hashes instead of strings, or to estimate the chatbot lexicon and
+ * different lines with HyperLogLog sketches. Per-contact conversation lines are never
+ * estimated since they decide whether a contact scores.
  */
 class HistoryStatsHelper : public StatsHelper
 {
@@ -55,7 +61,8 @@ public:
      * Constructs a emtpy HistoryStatsHelper
      */
     HistoryStatsHelper()
-        : m_cbLinesCount(0), m_deadConvDiffLinesCount(0)
+        : m_cbLinesCount(0), m_deadConvDiffLinesCount(0),
+          m_liveConvDiffLinesCount(0)
     {
     }
 
@@ -64,11 +71,31 @@ public:
      * \a conv.
      */
     HistoryStatsHelper(const Lvk::Cmn::Conversation &conv)
-        : m_cbLinesCount(0), m_deadConvDiffLinesCount(0)
+        : m_cbLinesCount(0), m_deadConvDiffLinesCount(0),
+          m_liveConvDiffLinesCount(0)
     {
         count(conv);
     }
 
+    /**
+     * Returns the mode used to count distinct lines and words. Default mode is
+     * DistinctCounter::ExactMode.
+     */
+    DistinctCounter::Mode countMode() const
+    {
+        return m_cbLexicon.mode();
+    }
+
+    /**
+     * Sets the \a mode used to count distinct lines and words. All stats are set to zero.
+     */
+    void setCountMode(DistinctCounter::Mode mode)
+    {
+        clear();
+        m_cbDiffLines.setMode(mode);
+        m_cbLexicon.setMode(mode);
+    }
+
     /**
      * Returns the total amount of lines in history produced by the chatbot
      */
@@ -83,7 +110,7 @@ public:
      */
     unsigned chatbotDiffConvLines() const
     {
-        return m_deadConvDiffLinesCount + liveConvDiffLinesCount();
+        return m_deadConvDiffLinesCount + m_liveConvDiffLinesCount;
     }
 
 
@@ -141,8 +168,22 @@ public:
         m_cbLexicon.clear();
         m_cbLinesCount = 0;
         m_deadConvDiffLinesCount = 0;
+        m_liveConvDiffLinesCount = 0;
     }
 
+    /**
+     * Writes the stats to \a stream, so they can be restored later with read() instead of
+     * counting the whole history again.
+     */
+    void write(QDataStream &stream) const;
+
+    /**
+     * Reads the stats written by write() from \a stream. Returns true on success. Otherwise;
+     * returns false and all stats are set to zero. Stats written with a different count mode
+     * are not read.
+     */
+    bool read(QDataStream &stream);
+
 protected:
 
     /**
@@ -183,20 +224,22 @@ private:
     // username -> ConversationInfo
     typedef QHash<QString, ConversationInfo> ConversationTracker;
     // username -> Conversation diff lines
-    typedef QHash<QString, QSet<QString> > ConversationDiffLines;
+    typedef QHash<QString, DistinctCounter> ConversationDiffLines;
 
     ConversationTracker m_convTracker;
     ConversationDiffLines m_convDiffLines;
     QSet<QString> m_scoreContacts;
 
     // chatbot stats
-    QSet<QString> m_cbDiffLines;
-    QSet<QString> m_cbLexicon;
+    DistinctCounter m_cbDiffLines;
+    DistinctCounter m_cbLexicon;
     unsigned m_cbLinesCount;
     unsigned m_deadConvDiffLinesCount;
+    unsigned m_liveConvDiffLinesCount;
 
     void trackConversation(const Cmn::Conversation::Entry &entry);
-    unsigned liveConvDiffLinesCount() const;
+    DistinctCounter &convDiffLines(const QString &user);
+    bool readState(QDataStream &stream);
 };
 
 
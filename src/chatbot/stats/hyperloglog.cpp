@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "stats/hyperloglog.h"
+
+#include <QDataStream>
+
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Position of the leftmost 1-bit in the first bits of w, starting from 1. Returns bits + 1
+// if those bits are zero.
+inline quint8 rank(quint64 w, int bits)
+{
+    quint8 r = 1;
+    while (r <= bits && !(w & Q_UINT64_C(0x8000000000000000))) {
+        w <<= 1;
+        ++r;
+    }
+    return r;
+}
+
+// Bias correction constant
+inline double alpha(int m)
+{
+    switch (m) {
+    case 16:
+        return 0.673;
+    case 32:
+        return 0.697;
+    case 64:
+        return 0.709;
+    default:
+        return 0.7213/(1.0 + 1.079/m);
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// HyperLogLog
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Stats::HyperLogLog::HyperLogLog(int p)
+    : m_p(qBound(4, p, 16))
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::HyperLogLog::add(quint64 hash)
+{
+    if (m_registers.isEmpty()) {
+        m_registers.fill(0, 1 << m_p);
+    }
+
+    int i = hash >> (64 - m_p);
+    quint8 r = rank(hash << m_p, 64 - m_p);
+
+    if (r > m_registers[i]) {
+        m_registers[i] = r;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+unsigned Lvk::Stats::HyperLogLog::count() const
+{
+    if (m_registers.isEmpty()) {
+        return 0;
+    }
+
+    const int m = m_registers.size();
+
+    double sum = 0.0;
+    int zeros = 0;
+
+    for (int i = 0; i < m; ++i) {
+        sum += std::ldexp(1.0, -m_registers[i]);
+        if (m_registers[i] == 0) {
+            ++zeros;
+        }
+    }
+
+    double e = alpha(m)*m*m/sum;
+
+    // Small range correction. With 64-bit hashes no large range correction is needed
+    if (e <= 2.5*m && zeros > 0) {
+        e = m*std::log(static_cast<double>(m)/zeros);
+    }
+
+    return static_cast<unsigned>(e + 0.5);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::HyperLogLog::clear()
+{
+    m_registers.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::HyperLogLog::write(QDataStream &stream) const
+{
+    stream << static_cast<qint32>(m_p) << m_registers;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::HyperLogLog::read(QDataStream &stream)
+{
+    qint32 p = 0;
+    QVector<quint8> registers;
+
+    stream >> p >> registers;
+
+    if (stream.status() != QDataStream::Ok || p != m_p
+            || (!registers.isEmpty() && registers.size() != (1 << m_p))) {
+        return false;
+    }
+
+    m_registers = registers;
+
+    return true;
+}
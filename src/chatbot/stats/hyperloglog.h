@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_STATS_HYPERLOGLOG_H
+#define LVK_STATS_HYPERLOGLOG_H
+
+#include <QVector>
+#include <QtGlobal>
+
+class QDataStream;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Stats
+{
+
+/// \ingroup Lvk
+/// \addtogroup Stats
+/// @{
+
+/**
+ * \brief The HyperLogLog class provides an approximate count of distinct elements using a
+ *        fixed amount of memory.
+ *
+ * Elements are added by their 64-bit hash. With precision \a p the sketch uses 2^p bytes and
+ * the standard error of count() is about 1.04/sqrt(2^p). I.e. 1.6% for the default precision.
+ */
+class HyperLogLog
+{
+public:
+
+    /**
+     * Constructs an empty HyperLogLog with precision \a p. Valid range is [4, 16].
+     */
+    HyperLogLog(int p = 12);
+
+    /**
+     * Returns the precision of the sketch.
+     */
+    int precision() const
+    {
+        return m_p;
+    }
+
+    /**
+     * Adds the element with the given 64-bit \a hash.
+     */
+    void add(quint64 hash);
+
+    /**
+     * Returns the estimated amount of distinct elements added.
+     */
+    unsigned count() const;
+
+    /**
+     * Removes all elements.
+     */
+    void clear();
+
+    /**
+     * Writes the sketch to \a stream.
+     */
+    void write(QDataStream &stream) const;
+
+    /**
+     * Reads the sketch from \a stream. Returns true on success. Otherwise; returns false.
+     */
+    bool read(QDataStream &stream);
+
+private:
+    int m_p;
+    QVector<quint8> m_registers; // Allocated on first add()
+};
+
+/// @}
+
+} // namespace Stats
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_STATS_HYPERLOGLOG_H
@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "stats/metricseries.h"
+
+#include <QDataStream>
+#include <QByteArray>
+
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+inline void writeVarint(QByteArray &data, quint64 v)
+{
+    while (v >= 0x80) {
+        data.append(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    data.append(static_cast<char>(v));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool readVarint(const QByteArray &data, int &pos, quint64 &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        quint8 b = static_cast<quint8>(data[pos++]);
+        v |= static_cast<quint64>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline quint64 zigzag(qint64 v)
+{
+    return (static_cast<quint64>(v) << 1) ^ static_cast<quint64>(v >> 63);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline qint64 unzigzag(quint64 v)
+{
+    return static_cast<qint64>(v >> 1) ^ -static_cast<qint64>(v & 1);
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// MetricSeries
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Stats::MetricSeries::MetricSeries(int columns)
+    : m_columns(columns), m_cumulative(columns), m_retention(0), m_bucketSize(1),
+      m_values(columns)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::setCumulative(int col, bool cumulative)
+{
+    if (col >= 0 && col < m_columns) {
+        m_cumulative.setBit(col, cumulative);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::MetricSeries::isCumulative(int col) const
+{
+    return col >= 0 && col < m_columns && m_cumulative.testBit(col);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::setRollup(unsigned retention, unsigned bucketSize)
+{
+    m_retention = retention;
+    m_bucketSize = qMax(1u, bucketSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+unsigned Lvk::Stats::MetricSeries::set(TimeInterval interv, int col, unsigned value, bool add)
+{
+    if (col < 0 || col >= m_columns) {
+        return 0;
+    }
+
+    int i = find(interv);
+    if (i == -1) {
+        i = insertRow(interv);
+    }
+
+    unsigned &v = m_values[col][i];
+    v = add ? v + value : value;
+
+    return v;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+unsigned Lvk::Stats::MetricSeries::value(TimeInterval interv, int col) const
+{
+    if (col < 0 || col >= m_columns) {
+        return 0;
+    }
+
+    int i = find(interv);
+
+    return i != -1 ? m_values[col][i] : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::MetricSeries::contains(TimeInterval interv) const
+{
+    return find(interv) != -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::history(int col, History &h) const
+{
+    h.clear();
+
+    if (!isEmpty()) {
+        history(col, m_intervals.first(), m_intervals.last(), h);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::history(int col, TimeInterval from, TimeInterval to,
+                                       History &h) const
+{
+    h.clear();
+
+    if (col < 0 || col >= m_columns) {
+        return;
+    }
+
+    const QVector<unsigned> &values = m_values[col];
+
+    for (int i = lowerBound(from); i < m_intervals.size() && m_intervals[i] <= to; ++i) {
+        h.append(m_intervals[i], values[i]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::rollup(TimeInterval current)
+{
+    if (m_retention == 0 || m_bucketSize < 2 || current <= m_retention) {
+        return;
+    }
+
+    const int end = lowerBound(current - m_retention + 1);
+
+    int out = -1;
+    unsigned outBucket = 0;
+
+    for (int i = 0; i < end; ++i) {
+        unsigned bucket = (m_intervals[i] - 1)/m_bucketSize;
+
+        if (out != -1 && bucket == outBucket) {
+            for (int col = 0; col < m_columns; ++col) {
+                QVector<unsigned> &values = m_values[col];
+                values[out] = m_cumulative.testBit(col) ? values[out] + values[i] : values[i];
+            }
+        } else {
+            ++out;
+            outBucket = bucket;
+            if (out != i) {
+                for (int col = 0; col < m_columns; ++col) {
+                    m_values[col][out] = m_values[col][i];
+                }
+            }
+        }
+
+        m_intervals[out] = m_intervals[i];
+    }
+
+    removeRows(out + 1, end - out - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::clear()
+{
+    m_intervals.clear();
+
+    for (int col = 0; col < m_columns; ++col) {
+        m_values[col].clear();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::write(QDataStream &stream) const
+{
+    QByteArray data;
+
+    writeVarint(data, m_intervals.size());
+
+    TimeInterval prev = 0;
+    foreach (TimeInterval interv, m_intervals) {
+        writeVarint(data, interv - prev);
+        prev = interv;
+    }
+
+    // Only columns with some value
+    QVector<int> cols;
+    for (int col = 0; col < m_columns; ++col) {
+        const QVector<unsigned> &values = m_values[col];
+        if (std::count(values.begin(), values.end(), 0u) != static_cast<int>(values.size())) {
+            cols.append(col);
+        }
+    }
+
+    writeVarint(data, cols.size());
+
+    foreach (int col, cols) {
+        writeVarint(data, col);
+
+        qint64 prevValue = 0;
+        foreach (unsigned v, m_values[col]) {
+            writeVarint(data, zigzag(static_cast<qint64>(v) - prevValue));
+            prevValue = v;
+        }
+    }
+
+    stream << data;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::MetricSeries::read(QDataStream &stream)
+{
+    clear();
+
+    QByteArray data;
+    stream >> data;
+
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    int pos = 0;
+    quint64 n = 0;
+
+    if (!readVarint(data, pos, n) || n > static_cast<quint64>(data.size())) {
+        return false;
+    }
+
+    QVector<TimeInterval> intervals(static_cast<int>(n));
+
+    TimeInterval prev = 0;
+    for (quint64 i = 0; i < n; ++i) {
+        quint64 delta = 0;
+        if (!readVarint(data, pos, delta) || (i > 0 && delta == 0)) {
+            return false;
+        }
+        intervals[i] = prev + delta;
+        prev = intervals[i];
+    }
+
+    QVector< QVector<unsigned> > values(m_columns, QVector<unsigned>(static_cast<int>(n), 0));
+
+    quint64 ncols = 0;
+    if (!readVarint(data, pos, ncols)) {
+        return false;
+    }
+
+    for (quint64 c = 0; c < ncols; ++c) {
+        quint64 col = 0;
+        if (!readVarint(data, pos, col) || col >= static_cast<quint64>(m_columns)) {
+            return false;
+        }
+
+        qint64 prevValue = 0;
+        for (quint64 i = 0; i < n; ++i) {
+            quint64 v = 0;
+            if (!readVarint(data, pos, v)) {
+                return false;
+            }
+            prevValue += unzigzag(v);
+            values[col][i] = static_cast<unsigned>(prevValue);
+        }
+    }
+
+    m_intervals = intervals;
+    m_values = values;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Stats::MetricSeries::find(TimeInterval interv) const
+{
+    // Fast path, most lookups are for the current interval
+    if (!m_intervals.isEmpty() && m_intervals.last() == interv) {
+        return m_intervals.size() - 1;
+    }
+
+    int i = lowerBound(interv);
+
+    return i < m_intervals.size() && m_intervals[i] == interv ? i : -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Stats::MetricSeries::lowerBound(TimeInterval interv) const
+{
+    return std::lower_bound(m_intervals.begin(), m_intervals.end(), interv) - m_intervals.begin();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Stats::MetricSeries::insertRow(TimeInterval interv)
+{
+    int i = lowerBound(interv);
+
+    m_intervals.insert(i, interv);
+
+    for (int col = 0; col < m_columns; ++col) {
+        m_values[col].insert(i, 0u);
+    }
+
+    return i;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::MetricSeries::removeRows(int i, int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    m_intervals.remove(i, count);
+
+    for (int col = 0; col < m_columns; ++col) {
+        m_values[col].remove(i, count);
+    }
+}
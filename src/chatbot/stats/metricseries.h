@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Chatbot.
+ *
+ * LVK Chatbot is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Chatbot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Chatbot.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LVK_STATS_METRICSERIES_H
+#define LVK_STATS_METRICSERIES_H
+
+#include "stats/timeinterval.h"
+#include "stats/history.h"
+
+#include <QVector>
+#include <QBitArray>
+
+class QDataStream;
+
+namespace Lvk
+{
+
+/// \addtogroup Lvk
+/// @{
+
+namespace Stats
+{
+
+/// \ingroup Lvk
+/// \addtogroup Stats
+/// @{
+
+/**
+ * \brief The MetricSeries class provides a columnar time-series store of metric values.
+ *
+ * Values are stored in one fixed-width array per column, all sharing a sorted array of time
+ * intervals. Lookups and range queries are O(log n), and setting a value in the last interval
+ * is O(1).
+ *
+ * Optionally intervals older than a retention window are rolled up in buckets of consecutive
+ * intervals. Cumulative columns are summed and the others keep the last value in the bucket.
+ * A rolled up row is keyed by the last interval in the bucket.
+ */
+class MetricSeries
+{
+public:
+
+    /**
+     * Constructs an empty MetricSeries with \a columns columns.
+     */
+    MetricSeries(int columns);
+
+    /**
+     * Returns the amount of columns.
+     */
+    int columns() const
+    {
+        return m_columns;
+    }
+
+    /**
+     * Sets column \a col as cumulative. By default columns are not cumulative.
+     */
+    void setCumulative(int col, bool cumulative = true);
+
+    /**
+     * Returns true if column \a col is cumulative. Otherwise; returns false.
+     */
+    bool isCumulative(int col) const;
+
+    /**
+     * Sets the rollup policy. Intervals older than \a retention intervals are rolled up in
+     * buckets of \a bucketSize intervals. Zero \a retention disables rollups (default).
+     */
+    void setRollup(unsigned retention, unsigned bucketSize);
+
+    /**
+     * Sets \a value to column \a col for interval \a interv. If \a add is true, \a value is
+     * added to the current value. Returns the new value.
+     */
+    unsigned set(TimeInterval interv, int col, unsigned value, bool add = false);
+
+    /**
+     * Returns the value of column \a col for interval \a interv or 0 if there is no value.
+     */
+    unsigned value(TimeInterval interv, int col) const;
+
+    /**
+     * Returns true if the series has values for interval \a interv. Otherwise; returns false.
+     */
+    bool contains(TimeInterval interv) const;
+
+    /**
+     * Returns the history of values of column \a col in \a h
+     */
+    void history(int col, History &h) const;
+
+    /**
+     * Returns the history of values of column \a col in \a h within intervals [\a from, \a to]
+     */
+    void history(int col, TimeInterval from, TimeInterval to, History &h) const;
+
+    /**
+     * Rolls up intervals older than the retention window ending at \a current.
+     */
+    void rollup(TimeInterval current);
+
+    /**
+     * Returns the amount of rows, i.e. intervals and rolled up buckets, in the series.
+     */
+    int size() const
+    {
+        return m_intervals.size();
+    }
+
+    /**
+     * Returns true if the series has no values. Otherwise; returns false.
+     */
+    bool isEmpty() const
+    {
+        return m_intervals.isEmpty();
+    }
+
+    /**
+     * Removes all values.
+     */
+    void clear();
+
+    /**
+     * Writes the series with delta and varint encoding to \a stream.
+     */
+    void write(QDataStream &stream) const;
+
+    /**
+     * Reads the series from \a stream. Returns true on success. Otherwise; returns false.
+     */
+    bool read(QDataStream &stream);
+
+private:
+    int m_columns;
+    QBitArray m_cumulative;
+    unsigned m_retention;
+    unsigned m_bucketSize;
+    QVector<TimeInterval> m_intervals;      // sorted
+    QVector< QVector<unsigned> > m_values;  // column -> values, parallel to m_intervals
+
+    int find(TimeInterval interv) const;
+    int lowerBound(TimeInterval interv) const;
+    int insertRow(TimeInterval interv);
+    void removeRows(int i, int count);
+};
+
+/// @}
+
+} // namespace Stats
+
+/// @}
+
+} // namespace Lvk
+
+
+#endif // LVK_STATS_METRICSERIES_H
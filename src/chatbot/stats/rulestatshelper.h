@@ -28,6 +28,7 @@
 #include "nlp-engine/syntax.h"
 
 #include <QSet>
+#include <QHash>
 #include <QPair>
 #include <memory>
 
@@ -47,6 +48,10 @@ namespace Stats
 /**
  * \brief The RuleStatsHelper class provides rule statistics such as total words,
  *        total rules, lexicon size and rule points.
+ *
+ * Statistics are kept as running counters. Each call to update() only re-scores the rules
+ * that were added, changed or removed since the previous call. Rules are identified by address
+ * and compared by input and output, hence unchanged rules are never parsed twice.
  */
 class RuleStatsHelper : public StatsHelper
 {
@@ -56,7 +61,7 @@ public:
      * Constructs an emtpy RuleStatsHelper
      */
     RuleStatsHelper()
-        : m_rules(0), m_points(0), m_regexRules(0), m_varRules(0), m_condRules(0)
+        : m_points(0), m_regexRules(0), m_varRules(0), m_condRules(0), m_words(0), m_lines(0)
     {
     }
 
@@ -64,11 +69,9 @@ public:
      * Constructs a RuleStatsHelper and provides statistics for the given \a root rule.
      */
     RuleStatsHelper(const Lvk::BE::Rule *root)
-        : m_rules(0), m_points(0), m_regexRules(0), m_varRules(0), m_condRules(0)
+        : m_points(0), m_regexRules(0), m_varRules(0), m_condRules(0), m_words(0), m_lines(0)
     {
-        if (root) {
-            rcount(root);
-        }
+        update(root);
     }
 
     /**
@@ -76,7 +79,7 @@ public:
      */
     unsigned rulesCount() const
     {
-        return m_rules;
+        return m_ruleInfo.size();
     }
 
     /**
@@ -120,86 +123,106 @@ public:
     }
 
     /**
-     * Resets stats with the given new \a root
+     * Returns the total amount of rule inputs and outputs
      */
-    void reset(const Lvk::BE::Rule *root)
+    unsigned lines() const
     {
-        clear();
-        if (root) {
-            rcount(root);
-        }
+        return m_lines;
     }
 
     /**
-     * Sets all stats to zero.
+     * Returns the total amount of words in rule inputs and outputs
      */
-    void clear()
+    unsigned words() const
     {
-        StatsHelper::clear();
-        m_ioPairs.clear();
-        m_rules = 0;
-        m_points = 0;
-        m_regexRules = 0;
-        m_varRules = 0;
-        m_condRules = 0;
+        return m_words;
     }
 
-protected:
+    /**
+     * Returns the lexicon size of rule inputs and outputs
+     */
+    unsigned lexiconSize() const
+    {
+        return m_lexicon.size();
+    }
 
     /**
-     * Counts all words in the given rule \a rule and gets statistics. If the rule has children
-     * it counts recursively.
+     * Updates stats with the given \a root. Only rules that have changed since the last
+     * update are re-scored. Returns true if stats have changed. Otherwise; returns false.
      */
-    void rcount(const Lvk::BE::Rule *rule)
+    bool update(const Lvk::BE::Rule *root)
     {
-        Lvk::BE::Rule::const_iterator it;
-        for (it = rule->begin(); it != rule->end(); ++it) {
-            const Lvk::BE::Rule *rule = *it;
-            if (rule->isComplete() && rule->type() != Lvk::BE::Rule::ContainerRule) {
-                count(rule);
-                m_rules++;
-                m_points += points(rule);
+        bool changed = false;
+        QSet<const Lvk::BE::Rule *> visited;
+
+        if (root) {
+            Lvk::BE::Rule::const_iterator it;
+            for (it = root->begin(); it != root->end(); ++it) {
+                const Lvk::BE::Rule *rule = *it;
+                if (!rule->isComplete() || rule->type() == Lvk::BE::Rule::ContainerRule) {
+                    continue;
+                }
+
+                visited.insert(rule);
+
+                RuleInfoHash::iterator info = m_ruleInfo.find(rule);
+                if (info == m_ruleInfo.end()) {
+                    add(rule);
+                    changed = true;
+                } else if (info->input != rule->input() || info->output != rule->output()) {
+                    remove(*info);
+                    m_ruleInfo.erase(info);
+                    add(rule);
+                    changed = true;
+                }
             }
         }
+
+        // Remove rules that are no longer in the tree
+        if (visited.size() != m_ruleInfo.size()) {
+            RuleInfoHash::iterator info = m_ruleInfo.begin();
+            while (info != m_ruleInfo.end()) {
+                if (!visited.contains(info.key())) {
+                    remove(*info);
+                    info = m_ruleInfo.erase(info);
+                } else {
+                    ++info;
+                }
+            }
+            changed = true;
+        }
+
+        return changed;
     }
 
     /**
-     * Counts all words in the given rule \a rule and gets statistics
+     * Resets stats with the given new \a root
      */
-    void count(const Lvk::BE::Rule *rule)
+    void reset(const Lvk::BE::Rule *root)
     {
-       StatsHelper::count(rule->input());
-       StatsHelper::count(rule->output());
+        clear();
+        update(root);
     }
 
     /**
-     * Returns the points of the given \a rule
+     * Sets all stats to zero.
      */
-    unsigned points(const Lvk::BE::Rule *rule)
+    void clear()
     {
-        unsigned p = 0;
-
-        // To calculate points Only using first non-empty output
-
-        QString output;
-        foreach (const QString &o, rule->output()) {
-            if (o.trimmed().size() > 0) {
-                output = o;
-                break;
-            }
-        }
-        foreach (const QString &input, rule->input()) {
-            // Count only unique pairs (input, output)
-            IOPair pair(input, output);
-            if (!m_ioPairs.contains(pair)) {
-                m_ioPairs.insert(pair);
-                p += points(input, output);
-            }
-        }
-
-        return p;
+        StatsHelper::clear();
+        m_ruleInfo.clear();
+        m_ioPairs.clear();
+        m_lexicon.clear();
+        m_points = 0;
+        m_regexRules = 0;
+        m_varRules = 0;
+        m_condRules = 0;
+        m_words = 0;
+        m_lines = 0;
     }
 
+protected:
+
     /**
      * Returns the points of the pair \a (input, output).
      * <ul>
@@ -215,16 +238,13 @@ protected:
             return 0;
         } else if (m_parser.parseVariable(input) != -1) {
             if (m_parser.parseIf(output) != -1) {
-                ++m_condRules;
                 return 4;
             } else if (m_parser.parseVariable(output) != -1) {
-                ++m_varRules;
                 return 3;
             } else {
                 return 1;
             }
         } else if (input.contains(STAR_OP) || input.contains(PLUS_OP)) {
-            ++m_regexRules;
             return 2;
         } else {
             return 1;
@@ -236,14 +256,123 @@ private:
     RuleStatsHelper& operator=(RuleStatsHelper&);
 
     typedef QPair<QString, QString> IOPair;
-    QSet<IOPair> m_ioPairs;
 
-    unsigned m_rules;
+    struct RuleInfo
+    {
+        RuleInfo() : words(0), lines(0) { }
+
+        QStringList input;
+        QStringList output;
+        QSet<IOPair> ioPairs;   // unique pairs (input, output) of the rule
+        QSet<QString> lexicon;  // sanitized words of the rule
+        unsigned words;
+        unsigned lines;
+    };
+
+    struct IOPairInfo
+    {
+        IOPairInfo() : refs(0), points(0) { }
+
+        unsigned refs;          // #rules with the pair
+        unsigned points;
+    };
+
+    typedef QHash<const Lvk::BE::Rule *, RuleInfo> RuleInfoHash;
+
+    RuleInfoHash m_ruleInfo;
+    QHash<IOPair, IOPairInfo> m_ioPairs;
+    QHash<QString, unsigned> m_lexicon; // word -> #rules with the word
+
     unsigned m_points;
     unsigned m_regexRules;
     unsigned m_varRules;
     unsigned m_condRules;
+    unsigned m_words;
+    unsigned m_lines;
     Nlp::Parser m_parser;
+
+    // Adds the stats of the given rule
+    void add(const Lvk::BE::Rule *rule)
+    {
+        RuleInfo &info = m_ruleInfo[rule];
+        info.input = rule->input();
+        info.output = rule->output();
+
+        foreach (const QString &s, info.input + info.output) {
+            QStringList words = splitSentence(s);
+            info.lines += 1;
+            info.words += words.size();
+            updateLexicon(words, info.lexicon);
+        }
+
+        // To calculate points Only using first non-empty output
+        QString output;
+        foreach (const QString &o, info.output) {
+            if (o.trimmed().size() > 0) {
+                output = o;
+                break;
+            }
+        }
+        foreach (const QString &input, info.input) {
+            info.ioPairs.insert(IOPair(input, output));
+        }
+
+        m_lines += info.lines;
+        m_words += info.words;
+
+        foreach (const QString &w, info.lexicon) {
+            ++m_lexicon[w];
+        }
+
+        // Count only unique pairs (input, output)
+        foreach (const IOPair &pair, info.ioPairs) {
+            IOPairInfo &pairInfo = m_ioPairs[pair];
+            if (pairInfo.refs++ == 0) {
+                pairInfo.points = points(pair.first, pair.second);
+                updatePoints(pairInfo.points, 1);
+            }
+        }
+    }
+
+    // Removes the stats of the given rule info
+    void remove(const RuleInfo &info)
+    {
+        m_lines -= info.lines;
+        m_words -= info.words;
+
+        foreach (const QString &w, info.lexicon) {
+            QHash<QString, unsigned>::iterator it = m_lexicon.find(w);
+            if (--(*it) == 0) {
+                m_lexicon.erase(it);
+            }
+        }
+
+        foreach (const IOPair &pair, info.ioPairs) {
+            QHash<IOPair, IOPairInfo>::iterator it = m_ioPairs.find(pair);
+            if (--it->refs == 0) {
+                updatePoints(it->points, -1);
+                m_ioPairs.erase(it);
+            }
+        }
+    }
+
+    // Adds (sign = 1) or subtracts (sign = -1) the given pair points and rule type counters
+    void updatePoints(unsigned p, int sign)
+    {
+        m_points += sign*p;
+
+        switch (p) {
+        case 2:
+            m_regexRules += sign;
+            break;
+        case 3:
+            m_varRules += sign;
+            break;
+        case 4:
+            m_condRules += sign;
+            break;
+        }
+    }
 };
 
 /// @}
@@ -256,4 +385,3 @@ private:
 
 
 #endif // LVK_STATS_RULESTATSHELPER_H
-
@@ -22,7 +22,8 @@
 #include "stats/metric.h"
 #include "stats/securestatsfile.h"
 #include "crypto/cipher.h"
-#include "crypto/keymanagerfactory.h"
+#include "crypto/keycache.h"
+#include "common/profiler.h"
 
 #include <QFile>
 #include <QMutex>
@@ -30,12 +31,18 @@
 #include <QtDebug>
 #include <QDataStream>
 #include <QCryptographicHash>
+#include <QtEndian>
 
-#include <memory>
 #include <cassert>
 
 #define STAT_MAGIC_NUMBER            (('s'<<0) | ('t'<<8) | ('a'<<16) | ('t'<<24))
-#define STAT_FILE_FORMAT_VERSION     1
+#define STAT_FILE_FORMAT_VERSION     4
+
+#define JOURNAL_FILE_EXT             ".jrnl"
+#define JOURNAL_COMPACT_MIN_SIZE     (64*1024)  // Journals smaller than this are never compacted
+
+#define METRICS_RETENTION            144        // Intervals kept as they are, ~30 days
+#define METRICS_ROLLUP_SIZE          5          // Intervals per rolled up bucket, ~1 day
 
 
 enum
@@ -44,6 +51,19 @@ enum
     TotalColumns = 50    // Reserving lot of columns for future usage
 };
 
+// Journal operations
+enum
+{
+    NewIntervalOp = 1,
+    SetMetricOp,
+    CurrentScoreOp,
+    BestScoreOp,
+    ElapsedTimeOp,
+    AddContactOp,
+    ChatEntryOp,
+    HistoryCheckpointOp
+};
+
 //--------------------------------------------------------------------------------------------------
 // Helpers
 //--------------------------------------------------------------------------------------------------
@@ -56,6 +76,44 @@ inline bool validMetric(Lvk::Stats::Metric m)
     return m != Lvk::Stats::NullStat && static_cast<int>(m) < TotalColumns;
 }
 
+//--------------------------------------------------------------------------------------------------
+
+const int SHA1_DIGEST_LEN = 160/8;
+
+QByteArray hmacSha1(const QByteArray &key_, const QByteArray &data)
+{
+    const int BLOCK_SIZE = 64;
+
+    QByteArray key = key_.size() > BLOCK_SIZE ?
+                QCryptographicHash::hash(key_, QCryptographicHash::Sha1) : key_;
+    key.append(QByteArray(BLOCK_SIZE - key.size(), 0));
+
+    QByteArray ipad = key;
+    QByteArray opad = key;
+
+    for (int i = 0; i < BLOCK_SIZE; ++i) {
+        ipad[i] = ipad[i] ^ 0x36;
+        opad[i] = opad[i] ^ 0x5c;
+    }
+
+    QByteArray inner = QCryptographicHash::hash(ipad + data, QCryptographicHash::Sha1);
+
+    return QCryptographicHash::hash(opad + inner, QCryptographicHash::Sha1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Appends journal operations to a buffer
+class OpStream : public QDataStream
+{
+public:
+    OpStream(QByteArray *data)
+        : QDataStream(data, QIODevice::WriteOnly | QIODevice::Append)
+    {
+        setVersion(QDataStream::Qt_4_7);
+    }
+};
+
 } // namespace
 
 
@@ -64,15 +122,25 @@ inline bool validMetric(Lvk::Stats::Metric m)
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Stats::SecureStatsFile::SecureStatsFile()
-    : m_mutex(new QMutex(QMutex::Recursive)), m_curInterv(1), m_elapsedTime(0)
+    : m_mutex(new QMutex(QMutex::Recursive)), m_metrics(TotalColumns),
+      m_current(new QAtomicInt[TotalColumns]), m_curInterv(1),
+      m_elapsedTime(0), m_histCheckpointEntries(0), m_generation(0), m_seq(0),
+      m_replaying(false), m_snapshotSize(0),
+      m_journalSize(0)
 {
+    setupMetrics();
 }
 
 //--------------------------------------------------------------------------------------------------
 
 Lvk::Stats::SecureStatsFile::SecureStatsFile(const QString &filename)
-    : m_mutex(new QMutex(QMutex::Recursive)), m_curInterv(1), m_elapsedTime(0)
+    : m_mutex(new QMutex(QMutex::Recursive)), m_metrics(TotalColumns),
+      m_current(new QAtomicInt[TotalColumns]), m_curInterv(1),
+      m_elapsedTime(0), m_histCheckpointEntries(0), m_generation(0), m_seq(0),
+      m_replaying(false), m_snapshotSize(0),
+      m_journalSize(0)
 {
+    setupMetrics();
     load(filename);
 }
 
@@ -80,6 +148,7 @@ Lvk::Stats::SecureStatsFile::SecureStatsFile(const QString &filename)
 
 Lvk::Stats::SecureStatsFile::~SecureStatsFile()
 {
+    delete[] m_current;
     delete m_mutex;
 }
 
@@ -90,9 +159,18 @@ void Lvk::Stats::SecureStatsFile::newInterval()
     QMutexLocker locker(m_mutex);
 
     ++m_curInterv;
+    m_metrics.rollup(m_curInterv);
+    refreshCurrent();
     m_history.clear();
+    m_histCheckpoint.clear();
+    m_histCheckpointEntries = 0;
     m_scoreStart = QDateTime::currentDateTime();
     m_elapsedTime = 0;
+
+    if (!m_replaying) {
+        OpStream ostream(&m_pending);
+        ostream << (quint8)NewIntervalOp << m_scoreStart;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -124,30 +202,35 @@ void Lvk::Stats::SecureStatsFile::metric(Stats::Metric m, QVariant &value)
 {
     value.clear();
 
+    if (validMetric(m) && m_currentValid) {
+        value = static_cast<unsigned>(static_cast<int>(m_current[m]));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::metricHistory(Stats::Metric m, Stats::History &h)
+{
+    h.clear();
+
     if (validMetric(m)) {
         QMutexLocker locker(m_mutex);
 
-        IntervalStats::const_iterator it = m_stats.find(m_curInterv);
-        if (it != m_stats.end()) {
-            value = (*it)[m];
-        }
+        m_metrics.history(m, h);
     }
 }
 
 //--------------------------------------------------------------------------------------------------
 
-void Lvk::Stats::SecureStatsFile::metricHistory(Stats::Metric m, Stats::History &h)
+void Lvk::Stats::SecureStatsFile::metricHistory(Stats::Metric m, TimeInterval from,
+                                                TimeInterval to, Stats::History &h)
 {
     h.clear();
 
     if (validMetric(m)) {
         QMutexLocker locker(m_mutex);
 
-        IntervalStats::const_iterator it;
-        for (it = m_stats.begin(); it != m_stats.end(); ++it) {
-            QVariant value = (*it)[m];
-            h.append(it.key(), value);
-        }
+        m_metrics.history(m, from, to, h);
     }
 }
 
@@ -163,25 +246,36 @@ void Lvk::Stats::SecureStatsFile::load(const QString &filename)
 
     QMutexLocker locker(m_mutex);
 
-    m_stats.clear();
+    m_metrics.clear();
     m_curInterv = 1;
+    refreshCurrent();
     m_filename = filename;
+    m_generation = 0;
+    resetJournal();
 
     QFile file(filename);
 
     if (file.open(QFile::ReadOnly)) {
-        std::auto_ptr<Crypto::KeyManager> keyMgr(Crypto::KeyManagerFactory().create());
+        Crypto::KeyCache *keys = Crypto::KeyCache::cache();
 
-        QByteArray iv = keyMgr->getIV(Crypto::KeyManager::LocalStatsRole);
-        QByteArray key = keyMgr->getKey(Crypto::KeyManager::LocalStatsRole);
+        QByteArray key = keys->getKey(Crypto::KeyManager::LocalStatsRole);
         QByteArray data = file.readAll();
 
-        Crypto::Cipher(iv, key).decrypt(data);
+        // The snapshot and the journal records share the cipher context
+        Crypto::Cipher &cipher = keys->threadCipher(Crypto::KeyManager::LocalStatsRole);
+
+        bool authentic = cipher.decrypt(data);
+
+        // Files saved with BlowfishCbcSuite carry their own hash
+        if (authentic && cipher.decryptedSuite() == Crypto::Cipher::BlowfishCbcSuite) {
+            QByteArray hash;
+            stripHash(data, hash);
+            authentic = verifyHash(data, hash);
+        }
 
-        QByteArray hash;
-        stripHash(data, hash);
+        m_snapshotSize = file.size();
 
-        if (!verifyHash(data, hash) || !deserialize(data)) {
+        if (!authentic || !deserialize(data) || !replayJournal(cipher, key)) {
             qCritical() << "SecureStatsFile: Clearing tampered file" << filename;
             clear();
         }
@@ -194,35 +288,297 @@ void Lvk::Stats::SecureStatsFile::load(const QString &filename)
 
 void Lvk::Stats::SecureStatsFile::save()
 {
+    LVK_PROFILE("SecureStatsFile::save");
+
     QMutexLocker locker(m_mutex);
 
     if (m_filename.isEmpty()) {
         return;
     }
 
+    if (!QFile::exists(m_filename)
+            || m_journalSize > qMax<qint64>(JOURNAL_COMPACT_MIN_SIZE, m_snapshotSize)) {
+        saveSnapshot();
+    } else if (!m_pending.isEmpty()) {
+        appendJournal();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::saveSnapshot()
+{
     qDebug() << "SecureStatsFile: Saving stats to" << m_filename;
 
     QFile file(m_filename);
 
     if (file.open(QFile::WriteOnly)) {
-        std::auto_ptr<Crypto::KeyManager> keyMgr(Crypto::KeyManagerFactory().create());
+        Crypto::Cipher &cipher =
+                Crypto::KeyCache::cache()->threadCipher(Crypto::KeyManager::LocalStatsRole);
 
-        QByteArray iv = keyMgr->getIV(Crypto::KeyManager::LocalStatsRole);
-        QByteArray key = keyMgr->getKey(Crypto::KeyManager::LocalStatsRole);
         QByteArray data;
 
+        // Records of the previous generation are ignored if the journal cannot be removed
+        ++m_generation;
+
         serialize(data);
-        appendHash(data);
 
-        Crypto::Cipher(iv, key).encrypt(data);
+        if (cipher.suite() == Crypto::Cipher::BlowfishCbcSuite) {
+            appendHash(data);
+        }
+
+        cipher.encrypt(data);
 
         file.write(data);
         file.flush();
+
+        m_snapshotSize = data.size();
+
+        QFile::remove(journalFilename());
+        resetJournal();
     } else {
         qCritical() << "SecureStatsFile: Could not open" << m_filename;
     }
 }
 
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::appendJournal()
+{
+    qDebug() << "SecureStatsFile: Appending journal record to" << journalFilename();
+
+    QFile file(journalFilename());
+
+    if (file.open(QFile::Append)) {
+        Crypto::KeyCache *keys = Crypto::KeyCache::cache();
+
+        QByteArray key = keys->getKey(Crypto::KeyManager::LocalStatsRole);
+        QByteArray data;
+
+        QDataStream ostream(&data, QIODevice::WriteOnly);
+        ostream.setVersion(QDataStream::Qt_4_7);
+        ostream << m_generation << m_seq;
+
+        Crypto::Cipher &cipher = keys->threadCipher(Crypto::KeyManager::LocalStatsRole);
+
+        data.append(m_pending);
+
+        if (cipher.suite() == Crypto::Cipher::BlowfishCbcSuite) {
+            data.append(hmacSha1(key, data));
+        }
+
+        cipher.encrypt(data);
+
+        uchar size[4];
+        qToBigEndian<quint32>(data.size(), size);
+
+        file.write(reinterpret_cast<const char *>(size), sizeof(size));
+        file.write(data);
+        file.flush();
+
+        m_journalSize = file.size();
+        m_pending.clear();
+        ++m_seq;
+    } else {
+        qCritical() << "SecureStatsFile: Could not open" << journalFilename();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::SecureStatsFile::replayJournal(Crypto::Cipher &cipher, const QByteArray &key)
+{
+    QFile file(journalFilename());
+
+    if (!file.open(QFile::ReadOnly)) {
+        return true;
+    }
+
+    QByteArray journal = file.readAll();
+    file.close();
+
+    int pos = 0;
+
+    while (pos + 4 <= journal.size()) {
+        int len = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(journal.constData() + pos));
+
+        if (len < 0 || pos + 4 + len > journal.size()) {
+            break; // Incomplete record
+        }
+
+        QByteArray data = journal.mid(pos + 4, len);
+
+        if (!cipher.decrypt(data)) {
+            qCritical("SecureStatsFile: Invalid journal record");
+            return false;
+        }
+
+        // Records encrypted with BlowfishCbcSuite carry their own MAC
+        if (cipher.decryptedSuite() == Crypto::Cipher::BlowfishCbcSuite) {
+            if (data.size() < SHA1_DIGEST_LEN) {
+                return false;
+            }
+
+            QByteArray mac = data.right(SHA1_DIGEST_LEN);
+            data.chop(SHA1_DIGEST_LEN);
+
+            if (hmacSha1(key, data) != mac) {
+                qCritical("SecureStatsFile: Invalid journal record MAC");
+                return false;
+            }
+        }
+
+        QDataStream istream(data);
+        istream.setVersion(QDataStream::Qt_4_7);
+
+        quint32 generation = 0;
+        quint32 seq = 0;
+        istream >> generation >> seq;
+
+        if (generation != m_generation) {
+            // Stale journal of a previous snapshot
+            QFile::remove(journalFilename());
+            resetJournal();
+            return true;
+        }
+
+        if (seq != m_seq || !replayOps(istream)) {
+            qCritical("SecureStatsFile: Invalid journal record");
+            return false;
+        }
+
+        ++m_seq;
+        pos += 4 + len;
+    }
+
+    if (pos < journal.size()) {
+        qWarning() << "SecureStatsFile: Discarding incomplete journal record";
+        QFile::resize(journalFilename(), pos);
+    }
+
+    m_journalSize = pos;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::SecureStatsFile::replayOps(QDataStream &istream)
+{
+    m_replaying = true;
+
+    while (!istream.atEnd() && istream.status() == QDataStream::Ok) {
+        quint8 op = 0;
+        istream >> op;
+
+        switch (op) {
+        case NewIntervalOp: {
+            QDateTime scoreStart;
+            istream >> scoreStart;
+            newInterval();
+            m_scoreStart = scoreStart;
+            break;
+        }
+        case SetMetricOp: {
+            qint32 col = 0;
+            quint32 value = 0;
+            istream >> col >> value;
+            if (col <= TimeIntervalCol || col >= TotalColumns) {
+                m_replaying = false;
+                return false;
+            }
+            setMetric(col, value, false);
+            break;
+        }
+        case CurrentScoreOp: {
+            Score s;
+            istream >> s;
+            setCurrentScore(s);
+            break;
+        }
+        case BestScoreOp: {
+            Score s;
+            istream >> s;
+            setBestScore(s);
+            break;
+        }
+        case ElapsedTimeOp: {
+            qint32 secs = 0;
+            istream >> secs;
+            setScoreElapsedTime(secs);
+            break;
+        }
+        case AddContactOp: {
+            QString username;
+            istream >> username;
+            addContact(username);
+            break;
+        }
+        case ChatEntryOp: {
+            Cmn::Conversation::Entry entry;
+            istream >> entry;
+            appendChatEntry(entry);
+            break;
+        }
+        case HistoryCheckpointOp: {
+            QByteArray state;
+            qint32 entries = 0;
+            istream >> state >> entries;
+            setHistoryCheckpoint(state, entries);
+            break;
+        }
+        default:
+            m_replaying = false;
+            return false;
+        }
+    }
+
+    m_replaying = false;
+
+    return istream.status() == QDataStream::Ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString Lvk::Stats::SecureStatsFile::journalFilename() const
+{
+    return m_filename + JOURNAL_FILE_EXT;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::resetJournal()
+{
+    m_seq = 0;
+    m_pending.clear();
+    m_journalSize = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::setupMetrics()
+{
+    m_metrics.setCumulative(ConnectionTime);
+    m_metrics.setRollup(METRICS_RETENTION, METRICS_ROLLUP_SIZE);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Must be called with the lock held whenever the current interval or its values are replaced.
+// Readers that see the cache invalid while it is refreshed return no value.
+void Lvk::Stats::SecureStatsFile::refreshCurrent()
+{
+    m_currentValid.fetchAndStoreOrdered(0);
+
+    bool valid = m_metrics.contains(m_curInterv);
+
+    for (int col = 0; col < TotalColumns; ++col) {
+        unsigned value = valid && col != TimeIntervalCol ? m_metrics.value(m_curInterv, col) : 0;
+        m_current[col].fetchAndStoreOrdered(static_cast<int>(value));
+    }
+
+    m_currentValid.fetchAndStoreOrdered(valid ? 1 : 0);
+}
 
 //--------------------------------------------------------------------------------------------------
 
@@ -231,14 +587,20 @@ void Lvk::Stats::SecureStatsFile::close()
     QMutexLocker locker(m_mutex);
 
     m_filename.clear();
-    m_stats.clear();
+    m_metrics.clear();
     m_curInterv = 1;
+    refreshCurrent();
     m_bestScore = Score();
     m_curScore = Score();
     m_scoreStart = QDateTime();
     m_elapsedTime = 0;
     m_contacts.clear();
     m_history.clear();
+    m_histCheckpoint.clear();
+    m_histCheckpointEntries = 0;
+    m_generation = 0;
+    m_snapshotSize = 0;
+    resetJournal();
 }
 
 
@@ -257,17 +619,24 @@ void Lvk::Stats::SecureStatsFile::clear()
 {
     QMutexLocker locker(m_mutex);
 
-    m_stats.clear();
+    m_metrics.clear();
     m_curInterv = 1;
+    refreshCurrent();
     m_bestScore = Score();
     m_curScore = Score();
     m_scoreStart = QDateTime();
     m_elapsedTime = 0;
     m_contacts.clear();
     m_history.clear();
+    m_histCheckpoint.clear();
+    m_histCheckpointEntries = 0;
+    m_generation = 0;
+    m_snapshotSize = 0;
+    resetJournal();
 
     if (m_filename.size() > 0) {
         QFile::remove(m_filename);
+        QFile::remove(journalFilename());
     }
 }
 
@@ -277,7 +646,7 @@ bool Lvk::Stats::SecureStatsFile::isEmpty() const
 {
     QMutexLocker locker(m_mutex);
 
-    return m_stats.isEmpty() &&
+    return m_metrics.isEmpty() &&
             m_curInterv == 1 &&
             m_contacts.isEmpty() &&
             m_history.isEmpty() &&
@@ -296,13 +665,16 @@ inline void Lvk::Stats::SecureStatsFile::serialize(QByteArray &data)
     ostream << (quint32)STAT_MAGIC_NUMBER;
     ostream << (quint32)STAT_FILE_FORMAT_VERSION;
     ostream << m_curInterv;
-    ostream << m_stats;
+    m_metrics.write(ostream);
     ostream << m_bestScore;
     ostream << m_curScore;
     ostream << m_scoreStart;
     ostream << m_elapsedTime;
     ostream << m_contacts;
     ostream << m_history;
+    ostream << m_generation;
+    ostream << m_histCheckpoint;
+    ostream << m_histCheckpointEntries;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -328,7 +700,27 @@ inline bool Lvk::Stats::SecureStatsFile::deserialize(const QByteArray &data)
     }
 
     istream >> m_curInterv;
-    istream >> m_stats;
+
+    if (version >= 3) {
+        if (!m_metrics.read(istream)) {
+            qCritical("SecureStatsFile: Cannot read stat file: Invalid metrics");
+            return false;
+        }
+    } else {
+        // Formats 1 and 2 store a row of TotalColumns values per interval
+        QHash<TimeInterval, QVector<unsigned> > rows;
+        istream >> rows;
+
+        QHash<TimeInterval, QVector<unsigned> >::const_iterator it;
+        for (it = rows.begin(); it != rows.end(); ++it) {
+            for (int col = TimeIntervalCol + 1; col < TotalColumns && col < it->size(); ++col) {
+                m_metrics.set(it.key(), col, (*it)[col]);
+            }
+        }
+    }
+
+    m_metrics.rollup(m_curInterv);
+
     istream >> m_bestScore;
     istream >> m_curScore;
     istream >> m_scoreStart;
@@ -336,11 +728,25 @@ inline bool Lvk::Stats::SecureStatsFile::deserialize(const QByteArray &data)
     istream >> m_contacts;
     istream >> m_history;
 
+    if (version >= 2) {
+        istream >> m_generation;
+    }
+
+    if (version >= 4) {
+        istream >> m_histCheckpoint;
+        istream >> m_histCheckpointEntries;
+    } else {
+        m_histCheckpoint.clear();
+        m_histCheckpointEntries = 0;
+    }
+
     if (istream.status() != QDataStream::Ok) {
         qCritical("SecureStatsFile: Cannot read stat file: Invalid file format");
         return false;
     }
 
+    refreshCurrent();
+
     return true;
 }
 
@@ -385,19 +791,24 @@ inline void Lvk::Stats::SecureStatsFile::setMetric(int col, unsigned value, bool
 
     //qDebug() << "SecureStatsFile: Setting col #" << col << ":" << value;
 
+    // Setting the current value again changes nothing, so it needs neither the lock nor a
+    // journal operation. Metrics are often set in loops with the same values.
+    if (m_currentValid && (cumulative ? value == 0
+                           : static_cast<int>(m_current[col]) == static_cast<int>(value))) {
+        return;
+    }
+
     QMutexLocker locker(m_mutex);
 
-    IntervalStats::iterator it = m_stats.find(m_curInterv);
-    unsigned oldValue = 0;
+    unsigned newValue = m_metrics.set(m_curInterv, col, value, cumulative);
 
-    if (it != m_stats.end()) {
-        oldValue = (*it)[col];
-    } else {
-        it = m_stats.insert(m_curInterv, QVector<unsigned>(TotalColumns, 0));
-        (*it)[TimeIntervalCol] = m_curInterv;
-    }
+    m_current[col].fetchAndStoreOrdered(static_cast<int>(newValue));
+    m_currentValid.fetchAndStoreOrdered(1);
 
-    (*it)[col] = cumulative ? oldValue + value : value;
+    if (!m_replaying) {
+        OpStream ostream(&m_pending);
+        ostream << (quint8)SetMetricOp << (qint32)col << (quint32)newValue;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -411,7 +822,14 @@ int Lvk::Stats::SecureStatsFile::scoreElapsedTime() const
 
 void Lvk::Stats::SecureStatsFile::setScoreElapsedTime(int secs)
 {
+    QMutexLocker locker(m_mutex);
+
     m_elapsedTime = secs;
+
+    if (!m_replaying) {
+        OpStream ostream(&m_pending);
+        ostream << (quint8)ElapsedTimeOp << (qint32)secs;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -439,6 +857,11 @@ void Lvk::Stats::SecureStatsFile::setCurrentScore(const Score &s)
     QMutexLocker locker(m_mutex);
 
     m_curScore = s;
+
+    if (!m_replaying) {
+        OpStream ostream(&m_pending);
+        ostream << (quint8)CurrentScoreOp << s;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -457,6 +880,11 @@ void Lvk::Stats::SecureStatsFile::setBestScore(const Score &s)
     QMutexLocker locker(m_mutex);
 
     m_bestScore = s;
+
+    if (!m_replaying) {
+        OpStream ostream(&m_pending);
+        ostream << (quint8)BestScoreOp << s;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -474,7 +902,14 @@ void Lvk::Stats::SecureStatsFile::addContact(const QString &username)
 {
     QMutexLocker locker(m_mutex);
 
-    m_contacts.insert(username);
+    if (!m_contacts.contains(username)) {
+        m_contacts.insert(username);
+
+        if (!m_replaying) {
+            OpStream ostream(&m_pending);
+            ostream << (quint8)AddContactOp << username;
+        }
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -493,4 +928,58 @@ void Lvk::Stats::SecureStatsFile::appendChatEntry(const Cmn::Conversation::Entry
     QMutexLocker locker(m_mutex);
 
     m_history.append(entry);
+
+    if (!m_replaying) {
+        OpStream ostream(&m_pending);
+        ostream << (quint8)ChatEntryOp << entry;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::chatHistory(Cmn::Conversation &h, int from) const
+{
+    QMutexLocker locker(m_mutex);
+
+    h.clear();
+
+    const QList<Cmn::Conversation::Entry> &entries = m_history.entries();
+
+    for (int i = qMax(0, from); i < entries.size(); ++i) {
+        h.append(entries[i]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Lvk::Stats::SecureStatsFile::chatHistorySize() const
+{
+    QMutexLocker locker(m_mutex);
+
+    return m_history.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::setHistoryCheckpoint(const QByteArray &state, int entries)
+{
+    QMutexLocker locker(m_mutex);
+
+    m_histCheckpoint = state;
+    m_histCheckpointEntries = entries;
+
+    if (!m_replaying) {
+        OpStream ostream(&m_pending);
+        ostream << (quint8)HistoryCheckpointOp << state << (qint32)entries;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::SecureStatsFile::historyCheckpoint(QByteArray &state, int &entries) const
+{
+    QMutexLocker locker(m_mutex);
+
+    state = m_histCheckpoint;
+    entries = m_histCheckpointEntries;
 }
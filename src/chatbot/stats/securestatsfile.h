@@ -25,12 +25,16 @@
 #include "stats/metric.h"
 #include "stats/statsfile.h"
 #include "stats/timeinterval.h"
+#include "stats/metricseries.h"
 
 #include <QString>
 #include <QHash>
 #include <QVector>
+#include <QByteArray>
+#include <QAtomicInt>
 
 class QMutex;
+class QDataStream;
 
 namespace Lvk
 {
@@ -38,6 +42,11 @@ namespace Lvk
 /// \addtogroup Lvk
 /// @{
 
+namespace Crypto
+{
+    class Cipher;
+}
+
 namespace Stats
 {
 
@@ -48,6 +57,17 @@ namespace Stats
 /**
  * \brief The SecureStatsFile class provides an implementation of the StatsFile interface that
  *        loads/saves statistics from/to encrypted files.
+ *
+ * The stats file is an encrypted snapshot plus an append-only encrypted journal with extension
+ * ".jrnl". Each save() appends a single record to the journal with the changes since the last
+ * save. Each record has its own MAC. When the journal grows bigger than the snapshot, it is
+ * compacted into a new snapshot.
+ *
+ * With Aes128GcmSuite the cipher authenticates the snapshot and each journal record, otherwise
+ * a hash and a MAC are appended.
+ *
+ * Values of the current interval are mirrored in atomics, so metric() does not lock and
+ * setMetric() only locks if the value changes.
  */
 class SecureStatsFile : public StatsFile
 {
@@ -94,6 +114,12 @@ public:
      */
     virtual void metricHistory(Stats::Metric m, Stats::History &h);
 
+    /**
+     * \copydoc StatsFile::metricHistory(Metric, TimeInterval, TimeInterval, History &)
+     */
+    virtual void metricHistory(Stats::Metric m, TimeInterval from, TimeInterval to,
+                               Stats::History &h);
+
     /**
      * \copydoc StatsFile::scoreElapsedTime()
      */
@@ -149,6 +175,26 @@ public:
      */
     virtual void appendChatEntry(const Cmn::Conversation::Entry &entry);
 
+    /**
+     * \copydoc StatsFile::chatHistory(Cmn::Conversation &, int)
+     */
+    virtual void chatHistory(Cmn::Conversation &h, int from) const;
+
+    /**
+     * \copydoc StatsFile::chatHistorySize()
+     */
+    virtual int chatHistorySize() const;
+
+    /**
+     * \copydoc StatsFile::setHistoryCheckpoint()
+     */
+    virtual void setHistoryCheckpoint(const QByteArray &state, int entries);
+
+    /**
+     * \copydoc StatsFile::historyCheckpoint()
+     */
+    virtual void historyCheckpoint(QByteArray &state, int &entries) const;
+
     /**
      * \copydoc StatsFile::load()
      */
@@ -183,11 +229,11 @@ private:
     SecureStatsFile(SecureStatsFile&);
     SecureStatsFile& operator=(const SecureStatsFile&);
 
-    typedef QHash<TimeInterval, QVector<unsigned> > IntervalStats;
-
     QMutex *m_mutex;
     QString m_filename;
-    IntervalStats m_stats;
+    MetricSeries m_metrics;
+    QAtomicInt *m_current;          // Values of the current interval, indexed by column
+    QAtomicInt m_currentValid;      // Zero if the current interval has no values
     TimeInterval m_curInterv;
     Score m_bestScore;
     Score m_curScore;
@@ -195,6 +241,23 @@ private:
     int m_elapsedTime;
     QSet<QString> m_contacts;
     Cmn::Conversation m_history;
+    QByteArray m_histCheckpoint;
+    qint32 m_histCheckpointEntries;
+    quint32 m_generation;
+    quint32 m_seq;
+    QByteArray m_pending;
+    bool m_replaying;
+    qint64 m_snapshotSize;
+    qint64 m_journalSize;
+
+    QString journalFilename() const;
+    void saveSnapshot();
+    void appendJournal();
+    bool replayJournal(Crypto::Cipher &cipher, const QByteArray &key);
+    bool replayOps(QDataStream &istream);
+    void resetJournal();
+    void setupMetrics();
+    void refreshCurrent();
 
     inline void serialize(QByteArray &data);
     inline bool deserialize(const QByteArray &data);
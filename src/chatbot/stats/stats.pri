@@ -10,14 +10,20 @@ HEADERS += \
     $$PROJECT_PATH/stats/history.h \
     $$PROJECT_PATH/stats/timeinterval.h \
     $$PROJECT_PATH/stats/securestatsfile.h \
+    $$PROJECT_PATH/stats/metricseries.h \
     $$PROJECT_PATH/stats/score.h \
     $$PROJECT_PATH/stats/metric.h \
     $$PROJECT_PATH/stats/rulestatshelper.h \
     $$PROJECT_PATH/stats/historystatshelper.h \
     $$PROJECT_PATH/stats/statshelper.h \
+    $$PROJECT_PATH/stats/hyperloglog.h \
+    $$PROJECT_PATH/stats/distinctcounter.h \
 
 SOURCES += \
     $$PROJECT_PATH/stats/statsmanager.cpp \
     $$PROJECT_PATH/stats/history.cpp \
     $$PROJECT_PATH/stats/securestatsfile.cpp \
+    $$PROJECT_PATH/stats/metricseries.cpp \
     $$PROJECT_PATH/stats/historystatshelper.cpp \
+    $$PROJECT_PATH/stats/hyperloglog.cpp \
+    $$PROJECT_PATH/stats/distinctcounter.cpp \
@@ -29,6 +29,7 @@
 
 #include <QSet>
 #include <QString>
+#include <QByteArray>
 #include <QDateTime>
 
 namespace Lvk
@@ -82,6 +83,12 @@ public:
      */
     virtual void metricHistory(Metric m, History &h) = 0;
 
+    /**
+     * Returns the history of values of the given metric \a m within the intervals
+     * [\a from, \a to]
+     */
+    virtual void metricHistory(Metric m, TimeInterval from, TimeInterval to, History &h) = 0;
+
     /**
      * Returns the amount of seconds that have elapsed for the current interval
      */
@@ -141,6 +148,31 @@ public:
      */
     virtual void appendChatEntry(const Cmn::Conversation::Entry &entry) = 0;
 
+    /**
+     * Returns in \a h the entries of the chat history for the current interval starting at
+     * entry \a from.
+     */
+    virtual void chatHistory(Cmn::Conversation &h, int from) const = 0;
+
+    /**
+     * Returns the amount of entries of the chat history for the current interval.
+     */
+    virtual int chatHistorySize() const = 0;
+
+    /**
+     * Sets the history checkpoint. \a state is an opaque snapshot of the statistics computed
+     * from the first \a entries entries of the chat history. It lets restoring them without
+     * processing the whole history again.
+     * This information is cleared on new intervals.
+     */
+    virtual void setHistoryCheckpoint(const QByteArray &state, int entries) = 0;
+
+    /**
+     * Returns the history checkpoint in \a state and \a entries. If there is no checkpoint
+     * \a state is empty. \see setHistoryCheckpoint()
+     */
+    virtual void historyCheckpoint(QByteArray &state, int &entries) const = 0;
+
     /**
      * Loads statistics from \a filename
      */
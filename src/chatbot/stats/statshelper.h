@@ -26,6 +26,7 @@
 
 #include <QSet>
 #include <QStringList>
+#include <QDataStream>
 
 namespace Lvk
 {
@@ -130,6 +131,25 @@ public:
         m_lexicon.clear();
     }
 
+    /**
+     * Writes the statistics to \a stream.
+     */
+    void write(QDataStream &stream) const
+    {
+        stream << m_lexicon << m_words << m_lines;
+    }
+
+    /**
+     * Reads the statistics from \a stream. Returns true on success. Otherwise; returns false.
+     */
+    bool read(QDataStream &stream)
+    {
+        clear();
+        stream >> m_lexicon >> m_words >> m_lines;
+
+        return stream.status() == QDataStream::Ok;
+    }
+
 protected:
 
     /**
@@ -169,13 +189,21 @@ protected:
     void updateLexicon(const QStringList &words, QSet<QString> &lexicon) const
     {
         foreach (const QString &w, words) {
-            QString szw = m_sanitizer.sanitize(w).toLower();
+            QString szw = sanitizeWord(w);
             if (!szw.isEmpty()) {
                 lexicon.insert(szw);
             }
         }
     }
 
+    /**
+     * Returns the word \a w sanitized and in lower case as inserted in lexicons.
+     */
+    QString sanitizeWord(const QString &w) const
+    {
+        return m_sanitizer.sanitize(w).toLower();
+    }
+
 private:
     QSet<QString> m_lexicon;
     unsigned m_words;
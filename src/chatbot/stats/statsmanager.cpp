@@ -20,17 +20,22 @@
  */
 
 #include "stats/statsmanager.h"
+#include "common/startuptimeline.h"
 #include "stats/securestatsfile.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
 
 #include <QMutex>
 #include <QMutexLocker>
 #include <QMetaType>
+#include <QDataStream>
 #include <QtDebug>
 
 #define STATS_FILE_PREFIX ""
 #define STATS_FILE_EXT    ".stat"
 
 #define SCORE_INTERVAL_DUR                (5*3600) // In seconds
+#define SAVE_INTERVAL                     60       // In seconds
 
 //--------------------------------------------------------------------------------------------------
 // StatsManager
@@ -43,13 +48,30 @@ QMutex *                   Lvk::Stats::StatsManager::m_mgrMutex = new QMutex();
 
 Lvk::Stats::StatsManager::StatsManager()
     : m_scoreMutex(new QMutex(QMutex::Recursive)),
+      m_checkpointEntries(-1),
       m_statsFile(new SecureStatsFile()),
-      m_elapsedTime(0)
+      m_elapsedTime(0),
+      m_contactsCount(0)
 {
     connect(&m_scoreTimer, SIGNAL(timeout()), SLOT(onScoreTick()));
 
+    Cmn::Settings settings;
+    int mode = settings.value(SETTING_STATS_COUNT_MODE).toInt();
+    if (mode >= DistinctCounter::ExactMode && mode <= DistinctCounter::ApproximateMode) {
+        m_histStats.setCountMode(static_cast<DistinctCounter::Mode>(mode));
+    }
+
     qRegisterMetaType<Lvk::Stats::Score>("Lvk::Stats::Score");
     qRegisterMetaTypeStreamOperators<Lvk::Stats::Score>("Lvk::Stats::Score");
+
+    Cmn::MaintenanceScheduler::scheduler()->add(this, "stats", SAVE_INTERVAL);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Stats::StatsManager::~StatsManager()
+{
+    Cmn::MaintenanceScheduler::scheduler()->remove(this);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -71,30 +93,40 @@ Lvk::Stats::StatsManager * Lvk::Stats::StatsManager::manager()
 
 void Lvk::Stats::StatsManager::setFilename(const QString &filename)
 {
+    LVK_STARTUP_PHASE("stats_load");
+
     QMutexLocker locker(m_scoreMutex);
 
     m_scoreTimer.stop();
 
     if (!m_statsFile->filename().isEmpty()) {
         if (!m_statsFile->isEmpty()) {
+            saveHistoryCheckpoint();
             m_statsFile->save();
         }
         m_statsFile->close();
         m_elapsedTime = 0;
+        m_contactsCount = 0;
+        m_score = Score();
         m_histStats.clear();
+        m_checkpointEntries = -1;
         m_ruleStats.clear();
     }
 
     if (!filename.isEmpty()) {
         m_statsFile->load(filename);
         m_elapsedTime = m_statsFile->scoreElapsedTime();
+        m_contactsCount = m_statsFile->contacts().size();
 
-        Cmn::Conversation h;
-        m_statsFile->chatHistory(h);
+        restoreHistoryStats();
 
-        m_histStats = Stats::HistoryStatsHelper(h);
         m_ruleStats.clear(); // FIXME init
+        m_score = m_statsFile->currentScore();
+
+        updateScore();
     }
+
+    notifyScoreChanged();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -119,8 +151,13 @@ void Lvk::Stats::StatsManager::clear()
 
     m_statsFile->clear();
     m_elapsedTime = 0;
+    m_contactsCount = 0;
+    m_score = Score();
     m_histStats.clear();
+    m_checkpointEntries = -1;
     m_ruleStats.clear();
+
+    notifyScoreChanged();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -129,32 +166,7 @@ Lvk::Stats::Score Lvk::Stats::StatsManager::currentScore()
 {
     QMutexLocker locker(m_scoreMutex);
 
-    unsigned hic  = m_statsFile->contacts().size();
-    unsigned trp  = m_ruleStats.points();
-    unsigned hcls = m_histStats.chatbotLexiconSize();
-    unsigned hdcl = m_histStats.chatbotDiffConvLines();
-
-    const unsigned SCORE_CONTACTS_POINTS = 1000;
-
-    Stats::Score score;
-    score.conversations = hcls + hdcl;
-    score.contacts      = hic*SCORE_CONTACTS_POINTS;
-    score.rules         = trp;
-    score.total         = score.conversations + score.contacts + score.rules;
-
-    m_statsFile->setCurrentScore(score);
-
-    // The best score does not remember the best rule score. Best score rule must be always equal
-    // to the current rule score
-    Stats::Score best = m_statsFile->bestScore();
-    best.rules = score.rules;
-    best.total = best.conversations + best.contacts +  best.rules;
-
-    m_statsFile->setBestScore(best);
-
-    setRuleMetrics();
-
-    return score;
+    return m_score;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -163,8 +175,7 @@ Lvk::Stats::Score Lvk::Stats::StatsManager::bestScore()
 {
     QMutexLocker locker(m_scoreMutex);
 
-    updateBestScore();
-
+    // Kept up to date by updateScore()
     return m_statsFile->bestScore();
 }
 
@@ -186,7 +197,7 @@ unsigned Lvk::Stats::StatsManager::intervals()
 
 void Lvk::Stats::StatsManager::updateBestScore()
 {
-    Score current = currentScore();
+    Score current = m_score;
     Score best = m_statsFile->bestScore();
 
     if (current.total > best.total) {
@@ -237,18 +248,33 @@ void Lvk::Stats::StatsManager::onScoreTick()
         updateBestScore();
         m_statsFile->newInterval();
         m_histStats.clear();
+        m_checkpointEntries = -1;
 
-        Score s = m_statsFile->currentScore();
-        s.conversations = 0; // reset conversation points
-        m_statsFile->setCurrentScore(s);
+        // reset conversation points
+        updateScore(true);
+        setRuleMetrics();
     }
 
-    // Save every minute
-    if (m_elapsedTime % 60 == 0) {
+    emit scoreRemainingTime(scoreRemainingTime());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool Lvk::Stats::StatsManager::needsMaintenance() const
+{
+    return !m_statsFile->filename().isEmpty();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::StatsManager::runMaintenance()
+{
+    QMutexLocker locker(m_scoreMutex);
+
+    if (!m_statsFile->filename().isEmpty()) {
+        saveHistoryCheckpoint();
         m_statsFile->save();
     }
-
-    emit scoreRemainingTime(scoreRemainingTime());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -264,27 +290,91 @@ void Lvk::Stats::StatsManager::updateScoreWith(const BE::Rule *root)
 {
     QMutexLocker locker(m_scoreMutex);
 
-    m_ruleStats.reset(root);
+    if (m_ruleStats.update(root)) {
+        updateScore();
+        setRuleMetrics();
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 
 void Lvk::Stats::StatsManager::updateScoreWith(const Cmn::Conversation::Entry &entry)
 {
+    updateScoreWith(QList<Cmn::Conversation::Entry>() << entry);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::StatsManager::updateScoreWith(const QList<Cmn::Conversation::Entry> &entries)
+{
+    if (entries.isEmpty()) {
+        return;
+    }
+
     QMutexLocker locker(m_scoreMutex);
 
     int size = m_histStats.scoreContacts().size();
 
-    m_histStats.update(entry);
-    m_statsFile->appendChatEntry(entry);
+    foreach (const Cmn::Conversation::Entry &entry, entries) {
+        m_histStats.update(entry);
+        m_statsFile->appendChatEntry(entry);
+    }
 
     // If there is a new contact
     if (size < m_histStats.scoreContacts().size()) {
         foreach (const QString &contact, m_histStats.scoreContacts()) {
             m_statsFile->addContact(contact);
         }
+        m_contactsCount = m_statsFile->contacts().size();
     }
 
+    updateScore();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::StatsManager::updateScore(bool force)
+{
+    const unsigned SCORE_CONTACTS_POINTS = 1000;
+
+    Stats::Score score;
+    score.conversations = m_histStats.chatbotLexiconSize() + m_histStats.chatbotDiffConvLines();
+    score.contacts      = m_contactsCount*SCORE_CONTACTS_POINTS;
+    score.rules         = m_ruleStats.points();
+    score.total         = score.conversations + score.contacts + score.rules;
+
+    if (score == m_score && !force) {
+        return;
+    }
+
+    m_score = score;
+
+    m_statsFile->setCurrentScore(score);
+
+    // The best score does not remember the best rule score. Best score rule must be always equal
+    // to the current rule score
+    Stats::Score best = m_statsFile->bestScore();
+    best.rules = score.rules;
+    best.total = best.conversations + best.contacts +  best.rules;
+
+    m_statsFile->setBestScore(best);
+
+    updateBestScore();
+    notifyScoreChanged();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::StatsManager::notifyScoreChanged()
+{
+    Score best = m_statsFile->bestScore();
+
+    if (m_score != m_notifiedScore || best != m_notifiedBestScore) {
+        m_notifiedScore = m_score;
+        m_notifiedBestScore = best;
+
+        emit scoreChanged(m_score, best);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -302,3 +392,53 @@ void Lvk::Stats::StatsManager::setRuleMetrics()
     m_statsFile->setMetric(Stats::CondRuleCount,    m_ruleStats.conditionalRules());
 }
 
+//--------------------------------------------------------------------------------------------------
+
+// Restores the history stats from the checkpoint in the stats file and counts only the entries
+// newer than it. Without a valid checkpoint the whole history is counted.
+void Lvk::Stats::StatsManager::restoreHistoryStats()
+{
+    QByteArray state;
+    int entries = 0;
+
+    m_statsFile->historyCheckpoint(state, entries);
+
+    m_histStats.clear();
+    m_checkpointEntries = -1;
+
+    if (!state.isEmpty() && entries >= 0 && entries <= m_statsFile->chatHistorySize()) {
+        QDataStream istream(state);
+        istream.setVersion(QDataStream::Qt_4_7);
+
+        if (m_histStats.read(istream)) {
+            m_checkpointEntries = entries;
+        } else {
+            qWarning() << "StatsManager: Invalid history checkpoint, counting whole history";
+        }
+    }
+
+    Cmn::Conversation h;
+    m_statsFile->chatHistory(h, qMax(m_checkpointEntries, 0));
+
+    m_histStats.update(h);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void Lvk::Stats::StatsManager::saveHistoryCheckpoint()
+{
+    int entries = m_statsFile->chatHistorySize();
+
+    if (entries == m_checkpointEntries) {
+        return;
+    }
+
+    QByteArray state;
+    QDataStream ostream(&state, QIODevice::WriteOnly);
+    ostream.setVersion(QDataStream::Qt_4_7);
+
+    m_histStats.write(ostream);
+
+    m_statsFile->setHistoryCheckpoint(state, entries);
+    m_checkpointEntries = entries;
+}
@@ -28,6 +28,7 @@
 #include "stats/historystatshelper.h"
 #include "stats/rulestatshelper.h"
 #include "common/conversation.h"
+#include "common/maintenancescheduler.h"
 
 #include <QObject>
 #include <QString>
@@ -62,9 +63,9 @@ class StatsFile;
  *        for the current chatbot
  *
  * The StatsManager class provides the current and best scores for the current chatbot as well
- * as the score timer.
+ * as the score timer. Stats and the history checkpoint are saved by the MaintenanceScheduler.
  */
-class StatsManager : public QObject
+class StatsManager : public QObject, public Cmn::MaintenanceTask
 {
     Q_OBJECT
 
@@ -134,6 +135,17 @@ public:
      */
     unsigned intervals();
 
+    /**
+     * Returns true if there is a stats file. Otherwise; returns false.
+     */
+    virtual bool needsMaintenance() const;
+
+    /**
+     * Saves the history checkpoint and the stats file. Pending changes are appended to the
+     * journal, which is compacted into a new snapshot once it is big enough.
+     */
+    virtual void runMaintenance();
+
 public slots:
 
     /**
@@ -151,6 +163,12 @@ public slots:
      */
     void updateScoreWith(const Cmn::Conversation::Entry &entry);
 
+    /**
+     * Updates the current score with new conversation \a entries. The score is computed once
+     * for all the entries.
+     */
+    void updateScoreWith(const QList<Cmn::Conversation::Entry> &entries);
+
     /**
      * Updates the current score with a new \a root rule
      */
@@ -164,8 +182,15 @@ signals:
      */
     void scoreRemainingTime(int secs);
 
+    /**
+     * This signal is emitted whenever the \a current or the \a best score changes.
+     * Consecutive updates that leave both scores unchanged are not notified.
+     */
+    void scoreChanged(const Lvk::Stats::Score &current, const Lvk::Stats::Score &best);
+
 private:
     StatsManager();
+    ~StatsManager();
     StatsManager(StatsManager&);
     StatsManager& operator=(StatsManager&);
 
@@ -176,13 +201,22 @@ private:
     QMutex *m_scoreMutex;
     RuleStatsHelper m_ruleStats;
     HistoryStatsHelper m_histStats;
+    int m_checkpointEntries;    // Entries of the history checkpoint in the file, -1 if none
 
     StatsFile *m_statsFile;
     QTimer m_scoreTimer;
     int m_elapsedTime;
+    unsigned m_contactsCount;
+    Score m_score;
+    Score m_notifiedScore;
+    Score m_notifiedBestScore;
 
     void updateBestScore();
+    void updateScore(bool force = false);
+    void notifyScoreChanged();
     void setRuleMetrics();
+    void restoreHistoryStats();
+    void saveHistoryCheckpoint();
 
 private slots:
     void onScoreTick();
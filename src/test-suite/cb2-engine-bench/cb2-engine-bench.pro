@@ -0,0 +1,42 @@
+#-------------------------------------------------
+#
+# Cb2Engine benchmark
+#
+#-------------------------------------------------
+
+QT       -= gui
+TARGET = cb2EngineBench
+CONFIG   += console freeling
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot \
+    ../cb2-engine-unit-test
+
+HEADERS += \
+    ../cb2-engine-unit-test/mocklemmatizer.h
+
+SOURCES += \
+    cb2enginebench.cpp \
+    ../cb2-engine-unit-test/mocklemmatizer.cpp
+
+PROJECT_PATH = ../../chatbot
+
+include($$PROJECT_PATH/nlp-engine/nlp-engine.pri)
+include($$PROJECT_PATH/common/common.pri)
+include($$PROJECT_PATH/3rd-party.pri)
+
+FL_DATA_PATH += \
+    ../../../third-party/Freeling/data/es/
+
+win32 {
+    warning(Benchmarks with Freeling need manual setup)
+    warning(Copy freeling data in the directory where the benchmark is executed)
+} else {
+    copyfiles.commands = mkdir -p ./data/freeling/; cp -Rf $$FL_DATA_PATH ./data/freeling/
+}
+
+QMAKE_EXTRA_TARGETS += copyfiles
+POST_TARGETDEPS += copyfiles
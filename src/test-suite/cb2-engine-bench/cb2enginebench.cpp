@@ -0,0 +1,889 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Botmaster.
+ *
+ * LVK Botmaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Botmaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Botmaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Cb2Engine benchmark. Builds rule sets of a given size and shape, replays synthetic or
+// recorded chat inputs and writes one CSV row per rule set with the build time, the memory
+// per rule, the throughput and the response latencies.
+//
+// Usage: cb2EngineBench [options]
+//
+//   --rules N            Rules in each rule set. Default: 1000
+//   --inputs N           Synthetic inputs replayed in each rule set. Default: 10000
+//   --shape NAME         literal, wildcard, variable, conditional, targets or all. Default: all
+//   --lemmatizer NAME    mock or freeling. Default: mock
+//   --match NAME         exact, lemma or fuzzy. Default: lemma
+//   --typos N            Percentage of synthetic inputs with a misspelled word. Default: 0
+//   --conversation FILE  Replays the messages of a recorded chat history instead of synthetic
+//                        inputs
+//   --seed N             Seed of the synthetic rules and inputs. Default: 1
+//   --output FILE        Appends the results to FILE instead of writing them to stdout
+//   --mode NAME          engine, hash, similarity or threads. hash compares the symbol sequence
+//                        hash of the literal index against qHash() of the concatenated words.
+//                        similarity times lookups of random inputs in a vector index of
+//                        random rule inputs, as the similarity fallback does on misses.
+//                        threads replays the inputs from 1, 2, 4... threads against one
+//                        engine and against one session per thread. Default: engine
+//   --threads N          Max threads in threads mode. Default: ideal thread count
+//   --lemma-cache NAME   on or off. Caches lemmatized inputs in threads mode. Default: on
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+#include <QHash>
+#include <QFile>
+#include <QThread>
+#include <QSemaphore>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+#include "nlp-engine/cb2engine.h"
+#include "nlp-engine/rule.h"
+#include "nlp-engine/lemmatizerfactory.h"
+#include "nlp-engine/cachedlemmatizer.h"
+#include "nlp-engine/nlpproperties.h"
+#include "nlp-engine/symbolsequence.h"
+#include "nlp-engine/symboltable.h"
+#include "nlp-engine/vectorindex.h"
+#include "common/conversation.h"
+#include "common/conversationreader.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "mocklemmatizer.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+
+#define VOCABULARY_SIZE     5000
+#define TARGET_COUNT        50
+#define HIT_RATIO           0.7     // Synthetic inputs built from rule inputs
+#define HASH_ROUNDS         20      // Times each input is hashed in hash mode
+#define MIN_SIMILARITY      0.5     // Minimum similarity in similarity mode
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const char *SHAPES[] = { "literal", "wildcard", "variable", "conditional", "targets" };
+const int SHAPE_COUNT = sizeof(SHAPES)/sizeof(SHAPES[0]);
+
+const char *SYLLABLES[] = { "ba", "ce", "di", "fo", "gu", "la", "me", "ni", "po", "ru", "sa",
+                            "te", "vi", "zo", "che", "que" };
+const int SYLLABLE_COUNT = sizeof(SYLLABLES)/sizeof(SYLLABLES[0]);
+
+//--------------------------------------------------------------------------------------------------
+
+struct Options
+{
+    Options()
+        : rules(1000), inputs(10000), shape("all"), lemmatizer("mock"), match("lemma"),
+          typos(0), seed(1), mode("engine"), threads(QThread::idealThreadCount()),
+          lemmaCache(true) { }
+
+    int rules;
+    int inputs;
+    QString shape;
+    QString lemmatizer;
+    QString match;
+    int typos;
+    QString conversation;
+    uint seed;
+    QString output;
+    QString mode;
+    int threads;
+    bool lemmaCache;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// A benchmark input and the target that sends it
+struct Input
+{
+    Input(const QString &text = "", const QString &target = "") : text(text), target(target) { }
+
+    QString text;
+    QString target;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+struct Result
+{
+    Result() : buildMs(0), memPerRule(-1), throughput(0), p50Us(0), p99Us(0), hitRatio(0) { }
+
+    qint64 buildMs;
+    qint64 memPerRule;
+    double throughput;
+    double p50Us;
+    double p99Us;
+    double hitRatio;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// MockLemmatizer logs every call
+void quietMsgHandler(QtMsgType type, const char *msg)
+{
+    if (type != QtDebugMsg) {
+        fprintf(stderr, "%s\n", msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline int randomInt(int n)
+{
+    return qrand() % n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Deterministic word made of syllables
+QString word(int i)
+{
+    QString w;
+
+    do {
+        w += SYLLABLES[i % SYLLABLE_COUNT];
+        i /= SYLLABLE_COUNT;
+    } while (i > 0);
+
+    return w;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString randomWords(int n)
+{
+    QStringList words;
+
+    for (int i = 0; i < n; ++i) {
+        words.append(word(randomInt(VOCABULARY_SIZE)));
+    }
+
+    return words.join(" ");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString targetName(int i)
+{
+    return QString("user%1@bench.lvk").arg(i);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Nlp::Rule makeRule(const QString &shape, int id)
+{
+    QStringList input;
+    QStringList output;
+    QStringList targets;
+
+    if (shape == "literal" || shape == "targets") {
+        input << randomWords(3 + randomInt(3)) << randomWords(2 + randomInt(3));
+        output << QString("Output %1").arg(id);
+
+        if (shape == "targets") {
+            for (int i = 1 + randomInt(3); i > 0; --i) {
+                targets.append(targetName(randomInt(TARGET_COUNT)));
+            }
+        }
+    } else if (shape == "wildcard") {
+        input << QString("* %1 *").arg(randomWords(2))
+              << QString("%1 * %2").arg(randomWords(1), randomWords(2))
+              << QString("%1 *").arg(randomWords(2));
+        output << QString("Output %1").arg(id);
+    } else if (shape == "variable") {
+        input << QString("%1 [var]").arg(randomWords(2))
+              << QString("[var] %1").arg(randomWords(3));
+        output << QString("Output %1 [var]").arg(id);
+    } else if (shape == "conditional") {
+        input << QString("%1 [var]").arg(randomWords(2));
+        output << QString("{if [var] == %1} Output %2 {else} Output %2 [var]")
+                  .arg(word(randomInt(VOCABULARY_SIZE))).arg(id);
+    }
+
+    return Nlp::Rule(id, input, output, targets);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Nlp::RuleList makeRules(const QString &shape, int n)
+{
+    Nlp::RuleList rules;
+
+    for (int i = 1; i <= n; ++i) {
+        rules.append(makeRule(shape, i));
+    }
+
+    return rules;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Input that matches the given rule input, with wildcards and variables replaced by words
+QString fill(QString ruleInput)
+{
+    ruleInput.replace("[var]", word(randomInt(VOCABULARY_SIZE)));
+
+    while (ruleInput.contains("*")) {
+        ruleInput.replace(ruleInput.indexOf("*"), 1, randomWords(1 + randomInt(2)));
+    }
+
+    return ruleInput;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Swaps two adjacent letters of a random word long enough to be corrected
+QString misspell(const QString &input)
+{
+    QStringList words = input.split(" ");
+    int i = randomInt(words.size());
+
+    if (words[i].size() >= 5) {
+        int j = randomInt(words[i].size() - 1);
+        QChar c = words[i][j];
+        words[i][j] = words[i][j + 1];
+        words[i][j + 1] = c;
+    }
+
+    return words.join(" ");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QList<Input> makeInputs(const Nlp::RuleList &rules, int n, int typos)
+{
+    QList<Input> inputs;
+
+    for (int i = 0; i < n; ++i) {
+        const Nlp::Rule &rule = rules[randomInt(rules.size())];
+
+        QString target = rule.target().isEmpty() ? QString()
+                                                 : rule.target()[randomInt(rule.target().size())];
+
+        if (randomInt(1000) < HIT_RATIO*1000) {
+            QString text = fill(rule.input()[randomInt(rule.input().size())]);
+
+            if (typos > 0 && randomInt(100) < typos) {
+                text = misspell(text);
+            }
+
+            inputs.append(Input(text, target));
+        } else {
+            inputs.append(Input(randomWords(2 + randomInt(6)), target));
+        }
+    }
+
+    return inputs;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool readInputs(const QString &filename, QList<Input> &inputs)
+{
+    Cmn::Conversation conv;
+
+    if (!Cmn::ConversationReader(filename).read(&conv)) {
+        return false;
+    }
+
+    foreach (const Cmn::Conversation::Entry &entry, conv.entries()) {
+        inputs.append(Input(entry.msg, entry.from));
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Resident memory in bytes. Returns -1 if not supported.
+qint64 residentMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/statm");
+
+    if (file.open(QFile::ReadOnly)) {
+        QStringList fields = QString(file.readAll()).split(" ");
+        if (fields.size() > 1) {
+            return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Freeling lemmatizers are always cached, the cache size setting turns it off. Mock lemmatizers
+// are only cached if \a cacheMock is true.
+Nlp::Lemmatizer *createLemmatizer(const QString &name, bool cacheMock = false)
+{
+    if (name == "freeling") {
+        return Nlp::LemmatizerFactory().createLemmatizer();
+    } else if (cacheMock) {
+        return new Nlp::CachedLemmatizer(new MockLemmatizer());
+    } else {
+        return new MockLemmatizer();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+double percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    return sorted[qMin(sorted.size() - 1, (int)(p*sorted.size()))];
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Result run(const Options &opt, const QString &shape, const QList<Input> &recorded)
+{
+    Result r;
+
+    Nlp::RuleList rules = makeRules(shape, opt.rules);
+    QList<Input> inputs = opt.conversation.isEmpty() ? makeInputs(rules, opt.inputs, opt.typos)
+                                                     : recorded;
+
+    Nlp::Cb2Engine *engine = new Nlp::Cb2Engine();
+    engine->setLemmatizer(createLemmatizer(opt.lemmatizer));
+    engine->setProperty(NLP_PROP_LEMMA_MATCH, opt.match != "exact");
+    engine->setProperty(NLP_PROP_FUZZY_MATCH, opt.match == "fuzzy");
+
+    qint64 memBefore = residentMemory();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    engine->setRules(rules);
+    engine->build();
+
+    r.buildMs = timer.elapsed();
+
+    qint64 memAfter = residentMemory();
+
+    if (memBefore != -1 && memAfter != -1 && !rules.isEmpty()) {
+        r.memPerRule = (memAfter - memBefore)/rules.size();
+    }
+
+    QVector<qint64> latencies;
+    latencies.reserve(inputs.size());
+    int hits = 0;
+    qint64 totalNs = 0;
+
+    foreach (const Input &input, inputs) {
+        Nlp::Engine::MatchList matches;
+
+        timer.restart();
+        engine->getResponse(input.text, input.target, matches);
+        qint64 ns = timer.nsecsElapsed();
+
+        latencies.append(ns);
+        totalNs += ns;
+
+        if (!matches.isEmpty()) {
+            ++hits;
+        }
+    }
+
+    delete engine;
+
+    qSort(latencies);
+
+    if (!inputs.isEmpty()) {
+        r.throughput = totalNs > 0 ? inputs.size()/(totalNs/1e9) : 0;
+        r.p50Us = percentile(latencies, 0.50)/1e3;
+        r.p99Us = percentile(latencies, 0.99)/1e3;
+        r.hitRatio = (double)hits/inputs.size();
+    }
+
+    return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Nanoseconds per input of hashing the words of each input HASH_ROUNDS times, either joined as
+// a QString or as a sequence of interned symbols. Symbols are interned beforehand, as the
+// engine does when it parses the input.
+void runHash(const Options &opt, QTextStream &out, bool header)
+{
+    QList<QStringList> inputs;
+    QList<QVector<Nlp::SymbolId> > ids;
+    QHash<QString, Nlp::SymbolId> symbols;
+
+    for (int i = 0; i < opt.inputs; ++i) {
+        QStringList words = randomWords(2 + randomInt(6)).split(" ");
+        QVector<Nlp::SymbolId> wordIds;
+
+        foreach (const QString &w, words) {
+            if (!symbols.contains(w)) {
+                symbols.insert(w, symbols.size() + 1);
+            }
+            wordIds.append(symbols[w]);
+        }
+
+        inputs.append(words);
+        ids.append(wordIds);
+    }
+
+    uint sink = 0;
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int r = 0; r < HASH_ROUNDS; ++r) {
+        foreach (const QStringList &words, inputs) {
+            sink ^= qHash(words.join(" "));
+        }
+    }
+    qint64 stringNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int r = 0; r < HASH_ROUNDS; ++r) {
+        foreach (const QVector<Nlp::SymbolId> &wordIds, ids) {
+            Nlp::SymbolSequence seq;
+            seq.reserve(wordIds.size());
+            foreach (Nlp::SymbolId id, wordIds) {
+                seq.append(id);
+            }
+            sink ^= qHash(seq);
+        }
+    }
+    qint64 symbolNs = timer.nsecsElapsed();
+
+    if (header) {
+        out << "method,inputs,rounds,ns_per_input,sink\n";
+    }
+
+    double n = qMax(1, opt.inputs * HASH_ROUNDS);
+
+    out << "qhash_string," << opt.inputs << "," << HASH_ROUNDS << ","
+        << QString::number(stringNs/n, 'f', 1) << "," << sink << "\n";
+    out << "symbol_sequence," << opt.inputs << "," << HASH_ROUNDS << ","
+        << QString::number(symbolNs/n, 'f', 1) << "," << sink << "\n";
+    out.flush();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Latency of looking up random inputs in a vector index with one row per rule. Rows and inputs
+// have 2 to 8 random words, so most inputs share some words with many rows but few reach
+// MIN_SIMILARITY.
+void runSimilarity(const Options &opt, QTextStream &out, bool header)
+{
+    Nlp::SymbolTable *symbols = Nlp::SymbolTable::instance();
+    Nlp::VectorIndex index;
+
+    for (int i = 0; i < opt.rules; ++i) {
+        QVector<Nlp::SymbolId> lemmas;
+        foreach (QString w, randomWords(2 + randomInt(7)).split(" ")) {
+            lemmas.append(symbols->intern(w));
+        }
+        index.add(i + 1, 0, lemmas);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    index.build();
+    qint64 buildMs = timer.elapsed();
+
+    QList<QVector<Nlp::SymbolId> > inputs;
+
+    for (int i = 0; i < opt.inputs; ++i) {
+        QVector<Nlp::SymbolId> lemmas;
+        foreach (const QString &w, randomWords(2 + randomInt(7)).split(" ")) {
+            lemmas.append(symbols->lookup(w));
+        }
+        inputs.append(lemmas);
+    }
+
+    QVector<qint64> latencies;
+    latencies.reserve(inputs.size());
+    qint64 found = 0;
+
+    foreach (const QVector<Nlp::SymbolId> &lemmas, inputs) {
+        Nlp::SimilarInputList similar;
+
+        timer.restart();
+        index.lookup(lemmas, MIN_SIMILARITY, similar);
+        latencies.append(timer.nsecsElapsed());
+
+        found += similar.size();
+    }
+
+    qSort(latencies);
+
+    if (header) {
+        out << "rows,features,inputs,min_similarity,build_ms,p50_us,p99_us,found_per_input\n";
+    }
+
+    double n = qMax(1, inputs.size());
+
+    out << index.size() << "," << index.featureCount() << "," << inputs.size() << ","
+        << MIN_SIMILARITY << "," << buildMs << ","
+        << QString::number(percentile(latencies, 0.50)/1e3, 'f', 1) << ","
+        << QString::number(percentile(latencies, 0.99)/1e3, 'f', 1) << ","
+        << QString::number(found/n, 'f', 3) << "\n";
+    out.flush();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Replays inputs in its own thread. Every thread chats with its own contact, unless the input
+// has a target, so topics of different threads do not mix.
+class ReplayThread : public QThread
+{
+public:
+    ReplayThread(Nlp::Engine *engine, const QList<Input> &inputs, int id, int offset,
+                 QSemaphore *go)
+        : m_engine(engine), m_inputs(inputs), m_id(id), m_offset(offset), m_go(go)
+    {
+        m_latencies.reserve(inputs.size());
+    }
+
+    const QVector<qint64> &latencies() const
+    {
+        return m_latencies;
+    }
+
+protected:
+    virtual void run()
+    {
+        QString contact = QString("thread%1@bench.lvk").arg(m_id);
+        QElapsedTimer timer;
+
+        m_go->acquire();
+
+        // Threads start at different offsets, so they do not lemmatize the same input at once
+        for (int i = 0; i < m_inputs.size(); ++i) {
+            const Input &input = m_inputs[(i + m_offset) % m_inputs.size()];
+            Nlp::Engine::MatchList matches;
+
+            timer.start();
+            m_engine->getResponse(input.text, input.target.isEmpty() ? contact : input.target,
+                                  matches);
+            m_latencies.append(timer.nsecsElapsed());
+        }
+    }
+
+private:
+    Nlp::Engine *m_engine;
+    QList<Input> m_inputs;
+    int m_id;
+    int m_offset;
+    QSemaphore *m_go;
+    QVector<qint64> m_latencies;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Replays the inputs from \a n threads at once. If \a sessions is true, each thread uses its
+// own session of \a engine. Otherwise; all threads use \a engine. Returns the throughput and
+// latencies of all threads together.
+Result runConcurrent(Nlp::Cb2Engine *engine, bool sessions, int n, const QList<Input> &inputs)
+{
+    Result r;
+    QSemaphore go;
+    QList<Nlp::Engine *> ownEngines;
+    QList<ReplayThread *> threads;
+
+    for (int i = 0; i < n; ++i) {
+        Nlp::Engine *e = engine;
+        if (sessions) {
+            e = engine->createSession();
+            e->setProperty(NLP_PROP_RESPONSE_CACHE_SIZE, 0);
+            ownEngines.append(e);
+        }
+        threads.append(new ReplayThread(e, inputs, i, i*inputs.size()/n, &go));
+        threads.last()->start();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    go.release(n);
+
+    foreach (ReplayThread *t, threads) {
+        t->wait();
+    }
+
+    qint64 wallNs = timer.nsecsElapsed();
+
+    QVector<qint64> latencies;
+    latencies.reserve(n*inputs.size());
+
+    foreach (ReplayThread *t, threads) {
+        latencies += t->latencies();
+    }
+
+    qDeleteAll(threads);
+    qDeleteAll(ownEngines);
+
+    qSort(latencies);
+
+    r.throughput = wallNs > 0 ? latencies.size()/(wallNs/1e9) : 0;
+    r.p50Us = percentile(latencies, 0.50)/1e3;
+    r.p99Us = percentile(latencies, 0.99)/1e3;
+
+    return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Throughput and latency from 1, 2, 4... up to opt.threads threads, with all threads sharing
+// one engine and with one session per thread. Sessions share the compiled rules but not the
+// topics. Efficiency is the throughput relative to n times the throughput of one thread.
+// The response cache is disabled, so every lookup lemmatizes and searches.
+void runThreads(const Options &opt, const QString &shape, QTextStream &out, bool header)
+{
+    Nlp::RuleList rules = makeRules(shape, opt.rules);
+    QList<Input> inputs = makeInputs(rules, opt.inputs, opt.typos);
+
+    Nlp::Cb2Engine *engine = new Nlp::Cb2Engine();
+    engine->setLemmatizer(createLemmatizer(opt.lemmatizer, opt.lemmaCache));
+    engine->setProperty(NLP_PROP_LEMMA_MATCH, opt.match != "exact");
+    engine->setProperty(NLP_PROP_FUZZY_MATCH, opt.match == "fuzzy");
+    engine->setProperty(NLP_PROP_RESPONSE_CACHE_SIZE, 0);
+    engine->setRules(rules);
+    engine->build();
+
+    // Warm up, so the first thread count does not pay for the cold lemma cache alone
+    runConcurrent(engine, false, 1, inputs);
+
+    QList<int> counts;
+    for (int n = 1; n < opt.threads; n *= 2) {
+        counts.append(n);
+    }
+    counts.append(opt.threads);
+
+    if (header) {
+        out << "shape,lemmatizer,match,lemma_cache,engine,threads,requests,throughput_per_sec,"
+               "p50_us,p99_us,efficiency\n";
+    }
+
+    for (int s = 0; s < 2; ++s) {
+        bool sessions = s == 1;
+        double baseThroughput = 0;
+
+        foreach (int n, counts) {
+            Result r = runConcurrent(engine, sessions, n, inputs);
+
+            if (n == 1) {
+                baseThroughput = r.throughput;
+            }
+
+            double efficiency = baseThroughput > 0 ? r.throughput/(n*baseThroughput) : 0;
+
+            out << shape << "," << opt.lemmatizer << "," << opt.match << ","
+                << (opt.lemmaCache ? "on" : "off") << "," << (sessions ? "session" : "shared")
+                << "," << n << "," << n*inputs.size() << ","
+                << QString::number(r.throughput, 'f', 1) << ","
+                << QString::number(r.p50Us, 'f', 1) << ","
+                << QString::number(r.p99Us, 'f', 1) << ","
+                << QString::number(efficiency, 'f', 3) << "\n";
+            out.flush();
+        }
+    }
+
+    delete engine;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool parseOptions(const QStringList &args, Options &opt)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+
+        const QString &value = args[++i];
+        bool ok = true;
+
+        if (arg == "--rules") {
+            opt.rules = value.toInt(&ok);
+        } else if (arg == "--inputs") {
+            opt.inputs = value.toInt(&ok);
+        } else if (arg == "--shape") {
+            opt.shape = value;
+        } else if (arg == "--lemmatizer") {
+            opt.lemmatizer = value;
+            ok = value == "mock" || value == "freeling";
+        } else if (arg == "--match") {
+            opt.match = value;
+            ok = value == "exact" || value == "lemma" || value == "fuzzy";
+        } else if (arg == "--typos") {
+            opt.typos = value.toInt(&ok);
+        } else if (arg == "--conversation") {
+            opt.conversation = value;
+        } else if (arg == "--seed") {
+            opt.seed = value.toUInt(&ok);
+        } else if (arg == "--output") {
+            opt.output = value;
+        } else if (arg == "--mode") {
+            opt.mode = value;
+            ok = value == "engine" || value == "hash" || value == "similarity"
+                    || value == "threads";
+        } else if (arg == "--threads") {
+            opt.threads = value.toInt(&ok);
+            ok = ok && opt.threads >= 1;
+        } else if (arg == "--lemma-cache") {
+            opt.lemmaCache = value == "on";
+            ok = value == "on" || value == "off";
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInstallMsgHandler(quietMsgHandler);
+
+    Options opt;
+
+    if (!parseOptions(app.arguments(), opt)) {
+        fprintf(stderr, "Usage: cb2EngineBench [--rules N] [--inputs N] [--shape NAME] "
+                        "[--lemmatizer mock|freeling] [--match exact|lemma|fuzzy] "
+                        "[--typos N] [--conversation FILE] [--seed N] [--output FILE] "
+                        "[--mode engine|hash|similarity|threads] [--threads N] "
+                        "[--lemma-cache on|off]\n");
+        return 1;
+    }
+
+    Cmn::Settings().setValue(SETTING_APP_LANGUAGE, "es_AR");
+
+    if (!opt.lemmaCache) {
+        Cmn::Settings().setValue(SETTING_NLP_LEMMA_CACHE_SIZE, 0);
+    }
+
+    QList<Input> recorded;
+
+    if (!opt.conversation.isEmpty() && !readInputs(opt.conversation, recorded)) {
+        fprintf(stderr, "Cannot read conversation %s\n", qPrintable(opt.conversation));
+        return 1;
+    }
+
+    QStringList shapes;
+
+    for (int i = 0; i < SHAPE_COUNT; ++i) {
+        if (opt.shape == "all" || opt.shape == SHAPES[i]) {
+            shapes.append(SHAPES[i]);
+        }
+    }
+
+    if (shapes.isEmpty()) {
+        fprintf(stderr, "Unknown shape %s\n", qPrintable(opt.shape));
+        return 1;
+    }
+
+    QFile file;
+    bool header = true;
+
+    if (opt.output.isEmpty()) {
+        file.open(stdout, QFile::WriteOnly);
+    } else {
+        file.setFileName(opt.output);
+        header = !file.exists() || file.size() == 0;
+
+        if (!file.open(QFile::WriteOnly | QFile::Append)) {
+            fprintf(stderr, "Cannot open %s\n", qPrintable(opt.output));
+            return 1;
+        }
+    }
+
+    QTextStream out(&file);
+
+    if (opt.mode == "hash") {
+        qsrand(opt.seed);
+        runHash(opt, out, header);
+        return 0;
+    }
+
+    if (opt.mode == "similarity") {
+        qsrand(opt.seed);
+        runSimilarity(opt, out, header);
+        return 0;
+    }
+
+    if (opt.mode == "threads") {
+        foreach (const QString &shape, shapes) {
+            qsrand(opt.seed);
+            runThreads(opt, shape, out, header);
+            header = false;
+        }
+        return 0;
+    }
+
+    if (header) {
+        out << "shape,lemmatizer,match,typos,workload,rules,inputs,build_ms,mem_per_rule_bytes,"
+               "throughput_per_sec,p50_us,p99_us,hit_ratio\n";
+    }
+
+    QString workload = opt.conversation.isEmpty() ? QString("synthetic") : QString("recorded");
+    int inputCount = opt.conversation.isEmpty() ? opt.inputs : recorded.size();
+
+    foreach (const QString &shape, shapes) {
+        qsrand(opt.seed);
+
+        Result r = run(opt, shape, recorded);
+
+        out << shape << "," << opt.lemmatizer << "," << opt.match << "," << opt.typos << ","
+            << workload << "," << opt.rules << "," << inputCount << "," << r.buildMs << "," << r.memPerRule << ","
+            << QString::number(r.throughput, 'f', 1) << ","
+            << QString::number(r.p50Us, 'f', 1) << ","
+            << QString::number(r.p99Us, 'f', 1) << ","
+            << QString::number(r.hitRatio, 'f', 3) << "\n";
+        out.flush();
+    }
+
+    return 0;
+}
@@ -24,6 +24,11 @@
 #include <QHash>
 #include <QRegExp>
 #include <QIODevice>
+#include <QFuture>
+#include <QtConcurrentRun>
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
 
 #include <iostream>
 
@@ -33,7 +38,21 @@
 #include "nlp-engine/defaultsanitizer.h"
 #include "nlp-engine/nullsanitizer.h"
 #include "nlp-engine/nulllemmatizer.h"
+#include "nlp-engine/cachedlemmatizer.h"
+#include "nlp-engine/lemmatizerpool.h"
+#include "nlp-engine/lemmatable.h"
+#include "nlp-engine/tablelemmatizer.h"
+#include "nlp-engine/enginestats.h"
 #include "nlp-engine/sanitizerfactory.h"
+#include "nlp-engine/globaltools.h"
+#include "nlp-engine/tree.h"
+#include "nlp-engine/flattree.h"
+#include "nlp-engine/toolchain.h"
+#include "nlp-engine/shadowengine.h"
+#include "nlp-engine/responsecache.h"
+#include "nlp-engine/analysisprofile.h"
+#include "common/memorymanager.h"
+#include "common/taskscheduler.h"
 
 #include "ruledef.h"
 #include "mocklemmatizer.h"
@@ -46,7 +65,49 @@
 #define EnableTestMatchWithSecuentialOutput
 #define EnableTestMatchWithTopic
 #define EnableTestMatchWithNextTopic
+#define EnableTestTopicUpdates
+#define EnableTestResultApi
 #define EnableTestInfiniteLoopDetection
+#define EnableTestIncrementalRuleUpdates
+#define EnableTestConcurrentLookups
+#define EnableTestSnapshot
+#define EnableTestLookupBenchmark
+#define EnableTestFlatTree
+#define EnableTestLemmatizerCache
+#define EnableTestLemmatizerPool
+#define EnableTestBoundedSearch
+#define EnableTestWildcardBenchmark
+#define EnableTestLiteralLookup
+#define EnableTestLemmaMatchProperty
+#define EnableTestEngineStats
+#define EnableTestRecursionBudget
+#define EnableTestSessions
+#define EnableTestEvasives
+#define EnableTestLintRules
+#define EnableTestMemoryReport
+#define EnableTestBatchResponses
+#define EnableTestPathologicalRules
+#define EnableTestTokenFilter
+#define EnableTestSearchStepBudget
+#define EnableTestFuzzyMatch
+#define EnableTestSimilarityFallback
+#define EnableTestShadowEngine
+#define EnableTestConditionalOutputs
+#define EnableTestTopicTrees
+#define EnableTestTableLemmatizer
+#define EnableTestLemmaTableCache
+#define EnableTestAsyncReload
+#define EnableTestToolchains
+#define EnableTestResponseCache
+#define EnableTestMemoryManager
+#define EnableTestAnalysisProfile
+#define EnableTestSearchDeadline
+#define EnableTestResponseAsync
+#define EnableTestSplitSentences
+#define EnableTestProfileRules
+#define EnableTestExplainResponse
+#define EnableTestMinimizeTree
+#define EnableTestPhraseRules
 
 #define USER_INPUT_1a                       "Hello"
 #define USER_INPUT_1b                       "hello"
@@ -95,6 +156,89 @@
 #define USER_INPUT_24b                       "w1 w2 w3 w4"
 
 
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Returns the number of lookups that did not match the expected output
+
+int lookupLoop(Lvk::Nlp::Engine *engine, QString input, QString expectedOutput, int n)
+{
+    int errors = 0;
+
+    for (int i = 0; i < n; ++i) {
+        Lvk::Nlp::Engine::MatchList matches;
+        if (engine->getResponse(input, matches) != expectedOutput) {
+            ++errors;
+        }
+    }
+
+    return errors;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::Lemmatizer *createMockLemmatizer()
+{
+    return new MockLemmatizer();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Returns the number of lemmatizations that did not match the expected words
+
+int lemmatizeLoop(Lvk::Nlp::Lemmatizer *lemmatizer, QString input,
+                  Lvk::Nlp::WordList expectedWords, int n)
+{
+    int errors = 0;
+
+    for (int i = 0; i < n; ++i) {
+        Lvk::Nlp::WordList words;
+        lemmatizer->lemmatize(input, words);
+        if (!(words == expectedWords)) {
+            ++errors;
+        }
+    }
+
+    return errors;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Keeps a worker of the task scheduler busy for some milliseconds
+
+class BusyTask : public QRunnable
+{
+public:
+    BusyTask(int msecs) : m_msecs(msecs) { }
+
+    virtual void run()
+    {
+        QTest::qSleep(m_msecs);
+    }
+
+private:
+    int m_msecs;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Keeps all the workers of the task scheduler busy, so the next reply tasks are queued
+
+void busyAllWorkers(int msecs)
+{
+    Cmn::TaskScheduler *scheduler = Cmn::TaskScheduler::scheduler();
+
+    for (int i = 0; i < scheduler->threadCount(); ++i) {
+        scheduler->start(new BusyTask(msecs), Cmn::TaskScheduler::Reply);
+    }
+}
+
+} // namespace
+
 //--------------------------------------------------------------------------------------------------
 // TestCb2Engine declaration
 //--------------------------------------------------------------------------------------------------
@@ -129,10 +273,85 @@ private Q_SLOTS:
 
     void testMatchWithTopic();
     void testMatchWithNextTopic();
+    void testTopicUpdates();
+    void testResultApi();
 
     void testInfiniteLoopDetection();
     void testInfiniteLoopDetection_data();
 
+    void testIncrementalRuleUpdates();
+
+    void testConcurrentLookups();
+
+    void testSnapshot();
+
+    void testLookupBenchmark();
+
+    void testFlatTree();
+    void testLemmatizerCache();
+
+    void testLemmatizerPool();
+
+    void testBoundedSearch_data();
+    void testBoundedSearch();
+
+    void testWildcardBenchmark();
+
+    void testLiteralLookup();
+
+    void testLemmaMatchProperty();
+
+    void testEngineStats();
+
+    void testRecursionBudget();
+
+    void testSessions();
+
+    void testEvasives();
+
+    void testLintRules();
+
+    void testMemoryReport();
+
+    void testBatchResponses();
+
+    void testPathologicalRules_data();
+    void testPathologicalRules();
+
+    void testTokenFilter();
+
+    void testSearchStepBudget();
+
+    void testFuzzyMatch();
+
+    void testSimilarityFallback();
+
+    void testShadowEngine();
+
+    void testConditionalOutputs_data();
+    void testConditionalOutputs();
+
+    void testRandomConditionalOutputs();
+
+    void testTopicTrees();
+
+    void testTableLemmatizer();
+
+    void testLemmaTableCache();
+
+    void testAsyncReload();
+    void testToolchains();
+    void testResponseCache();
+    void testMemoryManager();
+    void testAnalysisProfile();
+    void testSearchDeadline();
+    void testResponseAsync();
+    void testSplitSentences();
+    void testProfileRules();
+    void testExplainResponse();
+    void testMinimizeTree();
+    void testPhraseRules();
+
     void cleanupTestCase();
 
 private:
@@ -587,6 +806,102 @@ void TestCb2Engine::testMatchWithNextTopic()
 
 //--------------------------------------------------------------------------------------------------
 
+void TestCb2Engine::testTopicUpdates()
+{
+#ifndef EnableTestTopicUpdates
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    setRules6(m_engine);
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, true);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(m_engine->getResponse(USER_INPUT_8c, matches), QString(RULE_7_OUTPUT_1));
+    QCOMPARE(m_engine->getCurrentTopic(""), QString("soccer"));
+
+    // Topics must be updated along with incremental rule updates
+
+    Lvk::Nlp::Rule rule;
+    foreach (const Lvk::Nlp::Rule &r, m_engine->rules()) {
+        if (r.id() == RULE_7_ID) {
+            rule = r;
+        }
+    }
+    QCOMPARE(rule.id(), (Lvk::Nlp::RuleId)RULE_7_ID);
+
+    rule.setTopic("football");
+    m_engine->updateRule(rule);
+
+    QCOMPARE(m_engine->getResponse(USER_INPUT_8c, matches), QString(RULE_7_OUTPUT_1));
+    QCOMPARE(m_engine->getCurrentTopic(""), QString("football"));
+
+    rule.setNextTopic("soccer");
+    m_engine->updateRule(rule);
+
+    QCOMPARE(m_engine->getResponse(USER_INPUT_8c, matches), QString(RULE_7_OUTPUT_1));
+    QCOMPARE(m_engine->getCurrentTopic(""), QString("soccer"));
+
+    // Disabling topics clears current topics
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, false);
+    QCOMPARE(m_engine->getCurrentTopic(""), QString());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testResultApi()
+{
+#ifndef EnableTestResultApi
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    setRules6(m_engine);
+
+    for (int i = 0; i < 2; ++i) {
+        m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, i == 1);
+
+        Lvk::Nlp::Result result;
+        m_engine->getResponse(USER_INPUT_8c, "", result);
+
+        QVERIFY(result.isValid());
+        QCOMPARE(result.output, QString(RULE_7_OUTPUT_1));
+        QCOMPARE(result.ruleId, (Lvk::Nlp::RuleId)RULE_7_ID);
+        QCOMPARE(result.inputIdx, 0);
+        QCOMPARE(result.topic, QString("soccer"));
+        QVERIFY(result.score > 0);
+
+        // Must be consistent with the MatchList API
+        Lvk::Nlp::Engine::MatchList matches;
+        QCOMPARE(m_engine->getResponse(USER_INPUT_8c, matches), result.output);
+        QCOMPARE(matches.size(), 1);
+        QCOMPARE(matches[0].first, result.ruleId);
+
+        // Result lists can be reused
+        Lvk::Nlp::ResultList results;
+        m_engine->getAllResponses(USER_INPUT_8c, "", results);
+        m_engine->getAllResponses(USER_INPUT_8c, "", results);
+
+        QStringList responses = m_engine->getAllResponses(USER_INPUT_8c, matches);
+        QCOMPARE(results.size(), responses.size());
+        QCOMPARE(results.first().output, responses.first());
+        QCOMPARE(results.first().topic, QString("soccer"));
+
+        result.clear();
+        m_engine->getResponse("no match at all", "", result);
+        QVERIFY(!result.isValid());
+        QVERIFY(result.topic.isEmpty());
+    }
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void TestCb2Engine::testInfiniteLoopDetection_data()
 {
     QTest::addColumn<QString>("userInput");
@@ -630,6 +945,2330 @@ void TestCb2Engine::testInfiniteLoopDetection()
     }
 }
 
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testIncrementalRuleUpdates()
+{
+#ifndef EnableTestIncrementalRuleUpdates
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    setRules1(m_engine);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    // First query builds all trees
+    QCOMPARE(m_engine->getResponse(USER_INPUT_1a, matches), QString(RULE_1_OUTPUT_1));
+    QCOMPARE(m_engine->getResponse(USER_INPUT_4a, matches), QString(RULE_2_OUTPUT_1));
+
+    // Remove rule
+    m_engine->removeRule(RULE_1_ID);
+
+    QVERIFY(m_engine->getResponse(USER_INPUT_1a, matches).isEmpty());
+    QCOMPARE(matches.size(), 0);
+    QCOMPARE(m_engine->getResponse(USER_INPUT_4a, matches), QString(RULE_2_OUTPUT_1));
+
+    // Update rule
+    m_engine->updateRule(Lvk::Nlp::Rule(RULE_2_ID,
+                                        QStringList() << RULE_1_INPUT_1,
+                                        QStringList() << RULE_2_OUTPUT_1));
+
+    QCOMPARE(m_engine->getResponse(USER_INPUT_1a, matches), QString(RULE_2_OUTPUT_1));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(RULE_2_ID));
+    QVERIFY(m_engine->getResponse(USER_INPUT_4a, matches).isEmpty());
+
+    // Add rule with target
+    m_engine->addRule(Lvk::Nlp::Rule(RULE_1_ID,
+                                     QStringList() << RULE_1_INPUT_2,
+                                     QStringList() << RULE_1_OUTPUT_1,
+                                     QStringList() << TARGET_USER_1));
+
+    QCOMPARE(m_engine->getResponse(USER_INPUT_2a, TARGET_USER_1, matches),
+             QString(RULE_1_OUTPUT_1));
+    QVERIFY(m_engine->getResponse(USER_INPUT_2a, TARGET_USER_2, matches).isEmpty());
+
+    // Remove rule with target
+    int rulesCount = m_engine->rules().size();
+
+    m_engine->removeRule(RULE_1_ID);
+
+    QVERIFY(m_engine->getResponse(USER_INPUT_2a, TARGET_USER_1, matches).isEmpty());
+    QCOMPARE(m_engine->rules().size(), rulesCount - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testConcurrentLookups()
+{
+#ifndef EnableTestConcurrentLookups
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    const int LOOKUPS = 200;
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    setRules1(m_engine);
+
+    QFuture<int> f1 = QtConcurrent::run(lookupLoop, (Lvk::Nlp::Engine *)m_engine,
+                                        QString(USER_INPUT_1a), QString(RULE_1_OUTPUT_1),
+                                        LOOKUPS);
+    QFuture<int> f2 = QtConcurrent::run(lookupLoop, (Lvk::Nlp::Engine *)m_engine,
+                                        QString(USER_INPUT_4a), QString(RULE_2_OUTPUT_1),
+                                        LOOKUPS);
+    QFuture<int> f3 = QtConcurrent::run(lookupLoop, (Lvk::Nlp::Engine *)m_engine,
+                                        QString(USER_INPUT_7b), QString(RULE_3_OUTPUT_1),
+                                        LOOKUPS);
+
+    QCOMPARE(f1.result(), 0);
+    QCOMPARE(f2.result(), 0);
+    QCOMPARE(f3.result(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testSnapshot()
+{
+#ifndef EnableTestSnapshot
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    const QString SNAPSHOT_FILE = QDir::tempPath() + QDir::separator() + "test_cb2engine.snap";
+    const QString CONFIG_1 = "config1";
+    const QString CONFIG_2 = "config2";
+
+    QFile::remove(SNAPSHOT_FILE);
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    setRules1(m_engine);
+
+    QVERIFY(!m_engine->loadSnapshot(SNAPSHOT_FILE, CONFIG_1));
+    QVERIFY(m_engine->saveSnapshot(SNAPSHOT_FILE, CONFIG_1));
+
+    Lvk::Nlp::Cb2Engine engine(new Lvk::Nlp::NullSanitizer());
+
+    setRules1(&engine);
+
+    // Different config or rules must be rejected
+    QVERIFY(!engine.loadSnapshot(SNAPSHOT_FILE, CONFIG_2));
+    QVERIFY(engine.loadSnapshot(SNAPSHOT_FILE, CONFIG_1));
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(engine.getResponse(USER_INPUT_1a, matches), QString(RULE_1_OUTPUT_1));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(RULE_1_ID));
+    QCOMPARE(engine.getResponse(USER_INPUT_4a, matches), QString(RULE_2_OUTPUT_1));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(RULE_2_ID));
+
+    // Same rules and config, same snapshot id
+    QCOMPARE(engine.snapshotId(CONFIG_1), m_engine->snapshotId(CONFIG_1));
+    QVERIFY(engine.snapshotId(CONFIG_1) != engine.snapshotId(CONFIG_2));
+
+    // Both engines share the tree, changing the rules of one must not change the other
+    m_engine->removeRule(RULE_1_ID);
+    QVERIFY(m_engine->getResponse(USER_INPUT_1a, matches).isEmpty());
+    QCOMPARE(engine.getResponse(USER_INPUT_1a, matches), QString(RULE_1_OUTPUT_1));
+    setRules1(m_engine);
+
+    // Loaded trees must support incremental updates
+    engine.removeRule(RULE_1_ID);
+    QVERIFY(engine.getResponse(USER_INPUT_1a, matches).isEmpty());
+
+    engine.removeRule(RULE_2_ID);
+    QVERIFY(!engine.loadSnapshot(SNAPSHOT_FILE, CONFIG_1));
+
+    // Rule targets must be restored
+    setRules4(m_engine);
+    QVERIFY(m_engine->saveSnapshot(SNAPSHOT_FILE, CONFIG_1));
+
+    setRules4(&engine);
+    QVERIFY(engine.loadSnapshot(SNAPSHOT_FILE, CONFIG_1));
+
+    QCOMPARE(engine.getResponse(USER_INPUT_1a, TARGET_USER_2, matches), QString(RULE_1_OUTPUT_1));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(RULE_2_ID));
+    QVERIFY(engine.getResponse(USER_INPUT_1a, TARGET_USER_3, matches).isEmpty());
+
+    QFile::remove(SNAPSHOT_FILE);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testLookupBenchmark()
+{
+#ifndef EnableTestLookupBenchmark
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    const int RULES = 500;
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    // Root with many children, wildcards and variables
+
+    Lvk::Nlp::RuleList rules;
+
+    for (int i = 1; i <= RULES; ++i) {
+        QString w = QString("word%1").arg(i);
+        rules << Lvk::Nlp::Rule(i,
+                                QStringList() << (w + " *") << ("* " + w + " [varName] *"),
+                                QStringList() << ("Output " + w));
+    }
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(m_engine->getResponse("word250 foo bar", matches), QString("Output word250"));
+
+    QBENCHMARK {
+        m_engine->getResponse("foo word250 bar baz", matches);
+    }
+
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(250));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testFlatTree()
+{
+#ifndef EnableTestFlatTree
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    Lvk::Nlp::GlobalTools::instance()->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::Tree tree;
+    tree.add(Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Hola"));
+    tree.add(Lvk::Nlp::Rule(2, QStringList() << "me gusta [x]", QStringList() << "[x]"));
+    tree.add(Lvk::Nlp::Rule(3, QStringList() << "buen dia *", QStringList() << "Dia"));
+    tree.add(Lvk::Nlp::Rule(4, QStringList() << "jugar futbol", QStringList() << "Futbol"));
+    tree.add(Lvk::Nlp::Rule(5, QStringList() << "* gol *", QStringList() << "Gol"));
+
+    Lvk::Nlp::FlatTree flat;
+    tree.flatten(flat);
+
+    // Every node is copied once, the trie of phrases goes after the tree
+    QCOMPARE(flat.size(), 12);
+    QCOMPARE((int)flat.node(0).type, (int)Lvk::Nlp::Node::GenericType);
+    QCOMPARE(flat.phraseRoot(), 10);
+    QVERIFY(flat.memoryUsage() > 0);
+    QVERIFY(flat.memoryUsage() < Lvk::Nlp::FlatTree::nodeMemoryUsage(tree.root())
+            + Lvk::Nlp::FlatTree::nodeMemoryUsage(tree.phraseRoot()));
+
+    QVector<quint32> childs;
+
+    // Word childs are looked up by original word
+    flat.matchingChilds(0, flat.stringIndex("buen"), -1, childs);
+    QCOMPARE(childs.size(), 1);
+    quint32 buen = childs[0];
+    QCOMPARE((int)flat.node(buen).type, (int)Lvk::Nlp::Node::WordType);
+    QCOMPARE(flat.string(flat.node(buen).arg1), QString("buen"));
+
+    childs.clear();
+    flat.matchingChilds(buen, flat.stringIndex("dia"), -1, childs);
+    QCOMPARE(childs.size(), 1);
+    quint32 dia = childs[0];
+
+    // Wildcards match any word and keep their loop
+    childs.clear();
+    flat.matchingChilds(dia, -1, -1, childs);
+    QCOMPARE(childs.size(), 1);
+    quint32 star = childs[0];
+    QCOMPARE((int)flat.node(star).type, (int)Lvk::Nlp::Node::WildcardType);
+    QCOMPARE(flat.node(star).arg1, 0);
+    QCOMPARE(flat.node(star).arg2, -1);
+    QCOMPARE(flat.node(star).outputCount, 1u);
+
+    childs.clear();
+    flat.matchingChilds(star, -1, -1, childs);
+    QVERIFY(childs.contains(star));
+
+    // Outputs are in the side table
+    const Lvk::Nlp::FlatTree::OutputEntry &entry = flat.outputs()[flat.node(star).firstOutput];
+    QCOMPARE(flat.outputs(star, entry.key), &entry.outputs);
+    QVERIFY(!flat.outputs(star, entry.key + 1));
+
+    // Lemmas are looked up in their own range
+    childs.clear();
+    flat.matchingChilds(0, flat.stringIndex("jugaba"), flat.stringIndex("jugar"), childs);
+    QCOMPARE(childs.size(), 1);
+    QCOMPARE(flat.string(flat.node(childs[0]).arg1), QString("jugar"));
+
+    // Variables keep their names
+    childs.clear();
+    flat.matchingChilds(0, flat.stringIndex("me"), -1, childs);
+    QCOMPARE(childs.size(), 1);
+    quint32 me = childs[0];
+    childs.clear();
+    flat.matchingChilds(me, flat.stringIndex("gusta"), -1, childs);
+    QCOMPARE(childs.size(), 1);
+    quint32 gusta = childs[0];
+    childs.clear();
+    flat.matchingChilds(gusta, -1, -1, childs);
+    QCOMPARE(childs.size(), 1);
+    QCOMPARE((int)flat.node(childs[0]).type, (int)Lvk::Nlp::Node::VariableType);
+    QCOMPARE(flat.varName(childs[0]), QString("x"));
+
+    // Unknown words only match nodes that are not words
+    childs.clear();
+    flat.matchingChilds(0, -1, -1, childs);
+    QCOMPARE(childs.size(), 0);
+
+    // Phrases keep their outputs
+    childs.clear();
+    flat.matchingChilds(flat.phraseRoot(), flat.stringIndex("gol"), -1, childs);
+    QCOMPARE(childs.size(), 1);
+    QCOMPARE(flat.node(childs[0]).outputCount, 1u);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testLemmatizerCache()
+{
+#ifndef EnableTestLemmatizerCache
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    Lvk::Nlp::CachedLemmatizer lemmatizer(new MockLemmatizer(), 2);
+    Lvk::Nlp::WordList words1;
+    Lvk::Nlp::WordList words2;
+
+    QCOMPARE(lemmatizer.maxSize(), 2);
+
+    lemmatizer.lemmatize(USER_INPUT_5, words1);
+    lemmatizer.lemmatize(USER_INPUT_5, words2);
+
+    QCOMPARE(lemmatizer.misses(), 1);
+    QCOMPARE(lemmatizer.hits(), 1);
+    QVERIFY(words1 == words2);
+    QVERIFY(!words1.isEmpty());
+
+    // Least recently used must be evicted
+    lemmatizer.lemmatize(USER_INPUT_6, words2);
+    lemmatizer.lemmatize(USER_INPUT_7b, words2);
+    QCOMPARE(lemmatizer.size(), 2);
+
+    lemmatizer.lemmatize(USER_INPUT_5, words2);
+    QCOMPARE(lemmatizer.misses(), 4);
+    QVERIFY(words1 == words2);
+
+    lemmatizer.clear();
+    QCOMPARE(lemmatizer.size(), 0);
+    QCOMPARE(lemmatizer.hits(), 0);
+    QCOMPARE(lemmatizer.misses(), 0);
+
+    // Batch lemmatization must return the same words than lemmatize()
+    QList<Lvk::Nlp::WordList> batch;
+    lemmatizer.lemmatize(USER_INPUT_6, words2);
+    lemmatizer.lemmatizeBatch(QStringList() << USER_INPUT_5 << USER_INPUT_6, batch);
+
+    QCOMPARE(batch.size(), 2);
+    QVERIFY(batch[0] == words1);
+    QVERIFY(batch[1] == words2);
+    QCOMPARE(lemmatizer.hits(), 1);
+    QCOMPARE(lemmatizer.misses(), 2);
+
+    // Results must persist across instances with the same key
+    const QString CACHE_FILE = QDir::tempPath() + QDir::separator() + "test_lemmacache.dat";
+
+    QFile::remove(CACHE_FILE);
+
+    {
+        Lvk::Nlp::CachedLemmatizer persistent(new MockLemmatizer(), 2);
+        QVERIFY(!persistent.setPersistentFile(CACHE_FILE, "key1"));
+        persistent.lemmatize(USER_INPUT_5, words2);
+    }
+
+    Lvk::Nlp::CachedLemmatizer restored(new MockLemmatizer(), 2);
+    QVERIFY(!restored.load(CACHE_FILE, "key2"));
+    QCOMPARE(restored.size(), 0);
+    QVERIFY(restored.load(CACHE_FILE, "key1"));
+    QCOMPARE(restored.size(), 1);
+
+    restored.lemmatize(USER_INPUT_5, words2);
+    QCOMPARE(restored.hits(), 1);
+    QCOMPARE(restored.misses(), 0);
+    QVERIFY(words1 == words2);
+
+    QFile::remove(CACHE_FILE);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testLemmatizerPool()
+{
+#ifndef EnableTestLemmatizerPool
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    Lvk::Nlp::LemmatizerPool pool(createMockLemmatizer, 2);
+
+    QVERIFY(pool.isThreadSafe());
+    QCOMPARE(pool.maxSize(), 2);
+    QCOMPARE(pool.size(), 0);
+
+    // Lemmatizers are created lazily
+    Lvk::Nlp::WordList words;
+    pool.lemmatize(USER_INPUT_21a, words);
+    QCOMPARE(pool.size(), 1);
+    QVERIFY(!words.isEmpty());
+
+    const int THREADS = 8;
+    const int N = 200;
+
+    QList< QFuture<int> > futures;
+
+    for (int i = 0; i < THREADS; ++i) {
+        futures.append(QtConcurrent::run(lemmatizeLoop, &pool, QString(USER_INPUT_21a), words, N));
+    }
+
+    foreach (QFuture<int> f, futures) {
+        QCOMPARE(f.result(), 0);
+    }
+
+    QVERIFY(pool.size() >= 1);
+    QVERIFY(pool.size() <= 2);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testBoundedSearch_data()
+{
+    QTest::addColumn<QString>("targetUser");
+    QTest::addColumn<QString>("userInput");
+
+    QTest::newRow("bs 1") << QString() << USER_INPUT_1a;
+    QTest::newRow("bs 2") << QString() << USER_INPUT_5;
+    QTest::newRow("bs 3") << QString() << USER_INPUT_7b;
+    QTest::newRow("bs 4") << QString() << USER_INPUT_7d;
+    QTest::newRow("bs 5") << TARGET_USER_1 << USER_INPUT_8a;
+    QTest::newRow("bs 6") << TARGET_USER_1 << USER_INPUT_8c;
+    QTest::newRow("bs 7") << TARGET_USER_2 << USER_INPUT_8a;
+    QTest::newRow("bs 8") << TARGET_USER_2 << USER_INPUT_8c;
+    QTest::newRow("bs 9") << QString() << USER_INPUT_3;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testBoundedSearch()
+{
+#ifndef EnableTestBoundedSearch
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    QFETCH(QString, targetUser);
+    QFETCH(QString, userInput);
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    // The bounded search used by getResponse() must return the first of all responses
+
+    typedef void (*SetRulesFunc)(Lvk::Nlp::Engine *);
+
+    QList<SetRulesFunc> setRulesFuncs;
+    setRulesFuncs << setRules1 << setRules5;
+
+    foreach (SetRulesFunc setRulesFunc, setRulesFuncs) {
+        setRulesFunc(m_engine);
+
+        Lvk::Nlp::Engine::MatchList matches;
+        Lvk::Nlp::Engine::MatchList allMatches;
+
+        QString response = m_engine->getResponse(userInput, targetUser, matches);
+        QStringList responses = m_engine->getAllResponses(userInput, targetUser, allMatches);
+
+        if (responses.isEmpty()) {
+            QVERIFY(response.isEmpty());
+            QCOMPARE(matches.size(), 0);
+        } else {
+            QCOMPARE(response, responses.first());
+            QCOMPARE(matches.size(), 1);
+            QCOMPARE(matches.first(), allMatches.first());
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testWildcardBenchmark()
+{
+#ifndef EnableTestWildcardBenchmark
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    // Many wildcards and variables matching the same word lead to a combinatorial explosion of
+    // paths if (node, offset) states are not memoized
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "* a * a * a * a * a * b",
+                            QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "[x] a * a [y] c",
+                            QStringList() << "Output 2 [x] [y]");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+    Lvk::Nlp::Engine::MatchList allMatches;
+
+    // Short inputs: the memoized search must return the same than the exhaustive one
+
+    QStringList shortInputs;
+    shortInputs << "a a a a a a b" << "a a a a a a c" << "d a a e a c" << "a a a a a a d";
+
+    foreach (const QString &input, shortInputs) {
+        QString response = m_engine->getResponse(input, matches);
+        QStringList responses = m_engine->getAllResponses(input, QString(), allMatches);
+
+        if (responses.isEmpty()) {
+            QVERIFY(response.isEmpty());
+        } else {
+            QCOMPARE(response, responses.first());
+            QCOMPARE(matches.first(), allMatches.first());
+        }
+    }
+
+    QVERIFY(m_engine->getResponse("d a a e a c", matches).startsWith("Output 2 d"));
+
+    // Pathological input without match
+
+    QString input = QString("a ").repeated(40) + "d";
+
+    QBENCHMARK {
+        m_engine->getResponse(input, matches);
+    }
+
+    QCOMPARE(matches.size(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testLiteralLookup()
+{
+#ifndef EnableTestLiteralLookup
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola *", QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "hola amigo", QStringList() << "Output 2");
+    rules << Lvk::Nlp::Rule(3, QStringList() << "* amigo" << "chau amigo",
+                            QStringList() << "Output 3");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(m_engine->getResponse("hola amigo", matches), QString("Output 2"));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(2));
+
+    QCOMPARE(m_engine->getResponse("chau amigo", matches), QString("Output 3"));
+    QCOMPARE(matches[0].second, 1);
+
+    // Inputs without an exact literal match must fallback to the full search
+    QCOMPARE(m_engine->getResponse("hola amiga", matches), QString("Output 1"));
+    QCOMPARE(m_engine->getResponse("amigo", matches), QString("Output 3"));
+    QCOMPARE(matches[0].second, 0);
+
+    // Removed rules must not be found by the literal lookup
+    m_engine->removeRule(2);
+    QCOMPARE(m_engine->getResponse("hola amigo", matches), QString("Output 1"));
+
+    // Rules added later must be found by the literal lookup
+    m_engine->addRule(Lvk::Nlp::Rule(4, QStringList() << "hola amigo",
+                                     QStringList() << "Output 4"));
+    QCOMPARE(m_engine->getResponse("hola amigo", matches), QString("Output 4"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testLemmaMatchProperty()
+{
+#ifndef EnableTestLemmaMatchProperty
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "juego", QStringList() << "Output 1");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(m_engine->property(NLP_PROP_LEMMA_MATCH).toBool(), true);
+    QCOMPARE(m_engine->getResponse("jugaba", matches), QString("Output 1"));
+
+    m_engine->setProperty(NLP_PROP_LEMMA_MATCH, false);
+
+    QCOMPARE(m_engine->property(NLP_PROP_LEMMA_MATCH).toBool(), false);
+    QCOMPARE(m_engine->getResponse("juego", matches), QString("Output 1"));
+    QVERIFY(m_engine->getResponse("jugaba", matches).isEmpty());
+    QCOMPARE(m_engine->getAllResponses("jugaba", matches).size(), 0);
+
+    m_engine->setProperty(NLP_PROP_LEMMA_MATCH, true);
+
+    QCOMPARE(m_engine->getResponse("jugaba", matches), QString("Output 1"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testEngineStats()
+{
+#ifndef EnableTestEngineStats
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    // Histogram percentiles must have a relative error lower than 1/8
+
+    Lvk::Nlp::LatencyHistogram h;
+
+    QCOMPARE(h.percentile(50), static_cast<qint64>(0));
+
+    for (int i = 1; i <= 1000; ++i) {
+        h.record(i);
+    }
+
+    QCOMPARE(h.count(), 1000);
+    QCOMPARE(h.max(), static_cast<qint64>(1000));
+    QVERIFY(h.percentile(50) >= 500 && h.percentile(50) < 500 * 9 / 8);
+    QVERIFY(h.percentile(99) >= 990 && h.percentile(99) <= 1000);
+    QCOMPARE(h.percentile(100), static_cast<qint64>(1000));
+
+    h.record(3);
+    QCOMPARE(h.percentile(0), static_cast<qint64>(1));
+
+    h.clear();
+    QCOMPARE(h.count(), 0);
+
+    // Engine stats
+
+    setRules1(m_engine);
+    m_engine->setProperty(NLP_PROP_STATS, QVariant());
+    m_engine->setProperty(NLP_PROP_RULE_HITS, QVariant());
+
+    Lvk::Nlp::Engine::MatchList matches;
+    m_engine->getResponse(USER_INPUT_1a, matches);
+    m_engine->getAllResponses(USER_INPUT_1a, matches);
+
+    QVariantMap stats = m_engine->property(NLP_PROP_STATS).toMap();
+
+    QCOMPARE(stats["total"].toMap()["count"].toInt(), 2);
+    QCOMPARE(stats["lemmatize"].toMap()["count"].toInt(), 2);
+    QCOMPARE(stats["search"].toMap()["count"].toInt(), 2);
+
+    m_engine->setProperty(NLP_PROP_STATS, QVariant());
+
+    stats = m_engine->property(NLP_PROP_STATS).toMap();
+    QCOMPARE(stats["total"].toMap()["count"].toInt(), 0);
+
+    // Rule hits only count the best responses
+
+    QVariantMap hits = m_engine->property(NLP_PROP_RULE_HITS).toMap();
+    QCOMPARE(hits[QString::number(RULE_1_ID)].toInt(), 1);
+    QCOMPARE(hits[QString::number(RULE_2_ID)].toInt(), 0);
+
+    m_engine->getResponse(USER_INPUT_4a, matches);
+    hits = m_engine->property(NLP_PROP_RULE_HITS).toMap();
+    QCOMPARE(hits[QString::number(RULE_2_ID)].toInt(), 1);
+
+    m_engine->setProperty(NLP_PROP_RULE_HITS, QVariant());
+    QCOMPARE(m_engine->property(NLP_PROP_RULE_HITS).toMap()[QString::number(RULE_1_ID)].toInt(),
+             0);
+
+    hits[QString::number(RULE_1_ID)] = 7;
+    m_engine->setProperty(NLP_PROP_RULE_HITS, hits);
+    m_engine->setRules(m_engine->rules());
+    QCOMPARE(m_engine->property(NLP_PROP_RULE_HITS).toMap()[QString::number(RULE_1_ID)].toInt(),
+             7);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testRecursionBudget()
+{
+#ifndef EnableTestRecursionBudget
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Hola!");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "x [a] y [b]", QStringList() << "r[a] r[b]");
+    rules << Lvk::Nlp::Rule(3, QStringList() << "d1 [v]", QStringList() << "r[v]");
+
+    // Repeated sub-expansions must be resolved with the memo
+
+    Lvk::Nlp::Tree tree;
+    tree.add(rules);
+
+    Lvk::Nlp::Result result;
+    Lvk::Nlp::SearchContext ctx;
+    tree.getResponse("x hola y hola", result, ctx);
+
+    QCOMPARE(result.output, QString("Hola! Hola!"));
+    QCOMPARE(ctx.nestedSearches(), 1);
+    QCOMPARE(ctx.memoHits(), 1);
+    QVERIFY(ctx.memo().isEmpty());
+
+    // Nested searches must fail fast if the depth budget is exceeded
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+    QString input = "d1 d1 d1 d1 hola";
+
+    QCOMPARE(m_engine->property(NLP_PROP_MAX_RECURSION).toInt(), 16);
+    QCOMPARE(m_engine->getResponse(input, matches), QString("Hola!"));
+
+    m_engine->setProperty(NLP_PROP_MAX_RECURSION, 3);
+    QCOMPARE(m_engine->getResponse(input, matches), QString());
+    QCOMPARE(matches.size(), 0);
+
+    m_engine->setProperty(NLP_PROP_MAX_RECURSION, -1);
+    QCOMPARE(m_engine->getResponse(input, matches), QString("Hola!"));
+
+    m_engine->setProperty(NLP_PROP_MAX_RECURSION, QVariant());
+    QCOMPARE(m_engine->property(NLP_PROP_MAX_RECURSION).toInt(), 16);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testSessions()
+{
+#ifndef EnableTestSessions
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    setRules6(m_engine);
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, true);
+
+    std::auto_ptr<Lvk::Nlp::Engine> session(m_engine->createSession());
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    // Sessions share rules and properties but not topics
+
+    QCOMPARE(session->rules().size(), m_engine->rules().size());
+    QCOMPARE(session->property(NLP_PROP_PREFER_CUR_TOPIC).toBool(), true);
+
+    QCOMPARE(session->getResponse(USER_INPUT_8c, matches), QString(RULE_7_OUTPUT_1));
+    QCOMPARE(session->getCurrentTopic(""), QString("soccer"));
+    QCOMPARE(m_engine->getCurrentTopic(""), QString());
+
+    // Rule changes are not shared
+
+    Lvk::Nlp::Rule rule(999, QStringList() << "session only", QStringList() << "Session!");
+    session->addRule(rule);
+
+    QCOMPARE(session->getResponse("session only", matches), QString("Session!"));
+    QCOMPARE(m_engine->getResponse("session only", matches), QString());
+    QCOMPARE(m_engine->getResponse(USER_INPUT_8c, matches), QString(RULE_7_OUTPUT_1));
+
+    m_engine->removeRule(RULE_7_ID);
+
+    QCOMPARE(m_engine->getResponse(USER_INPUT_8c, matches), QString());
+    QCOMPARE(session->getResponse(USER_INPUT_8c, matches), QString(RULE_7_OUTPUT_1));
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testEvasives()
+{
+#ifndef EnableTestEvasives
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    QCOMPARE(m_engine->getEvasive("user1"), QString());
+
+    m_engine->setEvasives(QStringList() << "Evasive 1" << "Evasive 2", "");
+    m_engine->setEvasives(QStringList() << "Evasive for user2", "user2");
+
+    // Users without evasives get the evasives of any user
+    for (int i = 0; i < 10; ++i) {
+        QString evasive = m_engine->getEvasive("user1");
+        QVERIFY(evasive == "Evasive 1" || evasive == "Evasive 2");
+        QCOMPARE(m_engine->getEvasive("user2"), QString("Evasive for user2"));
+    }
+
+    // Sessions share evasives
+    std::auto_ptr<Lvk::Nlp::Engine> session(m_engine->createSession());
+    QCOMPARE(session->getEvasive("user2"), QString("Evasive for user2"));
+
+    m_engine->setEvasives(QStringList(), "user2");
+    m_engine->setEvasives(QStringList(), "");
+
+    QCOMPARE(m_engine->getEvasive("user2"), QString());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testLintRules()
+{
+#ifndef EnableTestLintRules
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    using Lvk::Nlp::RuleIssue;
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules.append(Lvk::Nlp::Rule(1, QStringList() << "Hola", QStringList() << "Hola 1"));
+    rules.append(Lvk::Nlp::Rule(2, QStringList() << "Hola", QStringList() << "Hola 2"));
+    rules.append(Lvk::Nlp::Rule(3, QStringList() << "Buen dia *", QStringList() << "Dia 3"));
+    rules.append(Lvk::Nlp::Rule(4, QStringList() << "Buen dia", QStringList() << "Dia 4"));
+    rules.append(Lvk::Nlp::Rule(5, QStringList() << "" << "Chau", QStringList() << "Chau 5"));
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::RuleIssueList issues;
+    m_engine->lintRules(issues);
+
+    // Only one of rules 1 and 2 can match "Hola", the one that takes precedence is reported
+    // as the other rule
+    Lvk::Nlp::Engine::MatchList matches;
+    m_engine->getResponse("Hola", matches);
+    QCOMPARE(matches.size(), 1);
+    Lvk::Nlp::RuleId holaWinner = matches[0].first;
+    Lvk::Nlp::RuleId holaLoser = holaWinner == 1 ? 2 : 1;
+
+    QVERIFY(issues.contains(RuleIssue(RuleIssue::DuplicatedInput, holaLoser, 0, holaWinner, 0)));
+
+    // Rule 4 is shadowed only if rule 3 takes precedence. Rule 3 still matches longer inputs
+    m_engine->getResponse("Buen dia", matches);
+    QCOMPARE(matches.size(), 1);
+    bool shadowed = matches[0].first == 3;
+
+    QCOMPARE(issues.contains(RuleIssue(RuleIssue::ShadowedByWildcard, 4, 0, 3, 0)), shadowed);
+
+    QVERIFY(issues.contains(RuleIssue(RuleIssue::EmptyInput, 5, 0)));
+
+    QCOMPARE(issues.size(), shadowed ? 3 : 2);
+
+    m_engine->setRules(Lvk::Nlp::RuleList());
+    m_engine->lintRules(issues);
+
+    QVERIFY(issues.isEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testMemoryReport()
+{
+#ifndef EnableTestMemoryReport
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules.append(Lvk::Nlp::Rule(1, QStringList() << "Hola", QStringList() << "Hola"));
+    rules.append(Lvk::Nlp::Rule(2, QStringList() << "Me gusta [x]",
+                                QStringList() << "A mi tambien me gusta [x]"));
+    rules.append(Lvk::Nlp::Rule(3, QStringList() << "Buen dia *", QStringList() << "Dia",
+                                QStringList() << "user@lvk.com"));
+
+    m_engine->setRules(rules);
+    m_engine->build();
+
+    QVariantMap report = m_engine->property(NLP_PROP_MEMORY).toMap();
+
+    QCOMPARE(report.value("rules").toInt(), 3);
+    QVERIFY(report.value("symbols").toInt() > 0);
+    QVERIFY(report.value("symbolBytes").toLongLong() > 0);
+
+    // Rules of every target share the same tree
+    QCOMPARE(report.value("treeCount").toInt(), 1);
+    QCOMPARE(report.value("targets").toInt(), 1);
+    QCOMPARE(report.value("variableNodes").toInt(), 1);
+    QCOMPARE(report.value("wildcardNodes").toInt(), 1);
+    QVERIFY(report.value("wordNodes").toInt() >= 5);
+
+    // Inputs ending with * also have output in the parent node
+    QCOMPARE(report.value("omapEntries").toInt(), 4);
+    QCOMPARE(report.value("outputs").toInt(), 4);
+
+    m_engine->setRules(Lvk::Nlp::RuleList());
+    m_engine->build();
+
+    report = m_engine->property(NLP_PROP_MEMORY).toMap();
+
+    QCOMPARE(report.value("rules").toInt(), 0);
+    QCOMPARE(report.value("outputs").toInt(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testBatchResponses()
+{
+#ifndef EnableTestBatchResponses
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    setRules6(m_engine);
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, true);
+
+    QStringList inputs;
+    QList<Lvk::Nlp::RuleId> expected;
+
+    // Responses of USER_INPUT_20 and USER_INPUT_19 depend on the topic left by previous inputs.
+    // Large enough to be searched concurrently.
+    for (int i = 0; i < 20; ++i) {
+        inputs << USER_INPUT_8c << USER_INPUT_18 << USER_INPUT_20 << USER_INPUT_19;
+        expected << RULE_7_ID << RULE_18_ID << RULE_20_ID << RULE_19_ID;
+    }
+
+    for (int size = 4; size <= inputs.size(); size += inputs.size() - 4) {
+        std::auto_ptr<Lvk::Nlp::Engine> session(m_engine->createSession());
+
+        QList<Lvk::Nlp::ResultList> results;
+        session->getResponses(inputs.mid(0, size), "", results);
+
+        QCOMPARE(results.size(), size);
+
+        for (int i = 0; i < size; ++i) {
+            QVERIFY(!results[i].isEmpty());
+            QCOMPARE(results[i].first().ruleId, expected[i]);
+        }
+
+        // The topic left is the same as one input at a time
+        std::auto_ptr<Lvk::Nlp::Engine> single(m_engine->createSession());
+        foreach (const QString &input, inputs.mid(0, size)) {
+            Lvk::Nlp::ResultList singleResults;
+            single->getAllResponses(input, "", singleResults);
+        }
+
+        QCOMPARE(session->getCurrentTopic(""), single->getCurrentTopic(""));
+    }
+
+    // Same results as one input at a time
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, false);
+
+    QList<Lvk::Nlp::ResultList> results;
+    m_engine->getResponses(inputs << "no match at all", "", results);
+
+    QCOMPARE(results.size(), inputs.size());
+
+    for (int i = 0; i < inputs.size(); ++i) {
+        Lvk::Nlp::ResultList single;
+        m_engine->getAllResponses(inputs[i], "", single);
+
+        QCOMPARE(results[i].size(), single.size());
+        for (int j = 0; j < single.size(); ++j) {
+            QCOMPARE(results[i][j].ruleId, single[j].ruleId);
+            QCOMPARE(results[i][j].output, single[j].output);
+        }
+    }
+
+    QVERIFY(results.last().isEmpty());
+
+    m_engine->getResponses(QStringList(), "", results);
+    QVERIFY(results.isEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testPathologicalRules_data()
+{
+    // Adversarial rule inputs and user inputs that used to take seconds. Each case must be
+    // answered within maxMsecs with the default engine properties
+
+    QTest::addColumn<QString>("ruleInput");
+    QTest::addColumn<QString>("userInput");
+    QTest::addColumn<QString>("expectedOutput");
+    QTest::addColumn<int>("maxMsecs");
+
+    QString as = QString("a ").repeated(40);
+
+    QTest::newRow("adjacent stars")
+            << "* * * * * * * * b" << as + "c" << QString() << 200;
+    QTest::newRow("adjacent stars match")
+            << "hola * * *" << "hola" << "Output" << 200;
+    QTest::newRow("star plus")
+            << "* + * + * + b" << as + "c" << QString() << 200;
+    QTest::newRow("plus heavy")
+            << "+ a + a + a + a + a + b" << as + as + "c" << QString() << 500;
+    QTest::newRow("var star var")
+            << "[x] * [y] b" << as + "c" << QString() << 500;
+    QTest::newRow("var star var match")
+            << "[x] * [y] b" << as + "b" << "Output" << 500;
+    QTest::newRow("vars and wildcards")
+            << "[x] a * a [y] a + a [z] b" << as + "c" << QString() << 500;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testPathologicalRules()
+{
+#ifndef EnableTestPathologicalRules
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    QFETCH(QString, ruleInput);
+    QFETCH(QString, userInput);
+    QFETCH(QString, expectedOutput);
+    QFETCH(int, maxMsecs);
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << ruleInput, QStringList() << "Output");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+    Lvk::Nlp::Engine::MatchList allMatches;
+
+    // Compile rules before timing
+    m_engine->getResponse("", matches);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString response = m_engine->getResponse(userInput, matches);
+    m_engine->getAllResponses(userInput, allMatches);
+
+    qint64 elapsed = timer.elapsed();
+
+    if (elapsed > maxMsecs) {
+        QFAIL(qPrintable(QString("Took %1 ms, over the limit of %2 ms")
+                         .arg(elapsed).arg(maxMsecs)));
+    }
+
+    if (expectedOutput.isNull()) {
+        QVERIFY(response.isEmpty());
+        QCOMPARE(allMatches.size(), 0);
+    } else {
+        QCOMPARE(response, expectedOutput);
+        QVERIFY(allMatches.size() > 0);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testTokenFilter()
+{
+#ifndef EnableTestTokenFilter
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    Lvk::Nlp::GlobalTools::instance()->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::Tree tree(Lvk::Nlp::MatchPolicy::FuzzyMatch);
+    tree.add(Lvk::Nlp::Rule(1, QStringList() << "* jugar futbol", QStringList() << "Futbol"));
+    tree.add(Lvk::Nlp::Rule(2, QStringList() << "* tenis", QStringList() << "Tenis"));
+    tree.add(Lvk::Nlp::Rule(3, QStringList() << "hola *", QStringList() << "Hola"));
+    tree.add(Lvk::Nlp::Rule(4, QStringList() << "me gusta [x]", QStringList() << "[x]"));
+    tree.add(Lvk::Nlp::Rule(5, QStringList() << "* quiero * comer *", QStringList() << "Comer"));
+
+    // Rule 1 matched by original word, by lemma and misspelled, other rules and no rule
+    QStringList rule1Inputs;
+    rule1Inputs << "yo juego futbol" << "yo jugaba futbol" << "yo juego fubtol";
+
+    QStringList inputs;
+    inputs << "hola me gusta el tenis" << "yo quiero ir a comer algo" << "me gusta hola";
+
+    QStringList noMatchInputs;
+    noMatchInputs << "nada que ver" << "otra cosa" << "buen dia" << "chau" << "que tal"
+                  << "donde queda el parque";
+
+    // Skipped subtrees do not change results, only the nodes visited
+
+    int steps = 0;
+    int unfilteredSteps = 0;
+
+    for (int pass = 0; pass < 2; ++pass) {
+        foreach (const QString &input, rule1Inputs + inputs + noMatchInputs) {
+            Lvk::Nlp::SearchContext ctx;
+            Lvk::Nlp::ResultList results;
+            tree.getResponses(input, results, ctx);
+
+            Lvk::Nlp::SearchContext unfilteredCtx;
+            unfilteredCtx.setTokenFilter(false);
+            Lvk::Nlp::ResultList unfilteredResults;
+            tree.getResponses(input, unfilteredResults, unfilteredCtx);
+
+            QCOMPARE(results.size(), unfilteredResults.size());
+            for (int i = 0; i < results.size(); ++i) {
+                QCOMPARE(results[i].ruleId, unfilteredResults[i].ruleId);
+                QCOMPARE(results[i].output, unfilteredResults[i].output);
+                QCOMPARE(results[i].score, unfilteredResults[i].score);
+            }
+
+            bool removed = pass == 1 && rule1Inputs.contains(input);
+            QCOMPARE(results.isEmpty(), noMatchInputs.contains(input) || removed);
+            QVERIFY(ctx.steps() <= unfilteredCtx.steps());
+
+            steps += ctx.steps();
+            unfilteredSteps += unfilteredCtx.steps();
+        }
+
+        // Filters of removed rules are left conservative
+        tree.remove(1);
+    }
+
+    QVERIFY(steps < unfilteredSteps);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testSearchStepBudget()
+{
+#ifndef EnableTestSearchStepBudget
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "* b", QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "hola", QStringList() << "Output 2");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+    QString input = QString("a ").repeated(20) + "b";
+
+    int defaultSteps = m_engine->property(NLP_PROP_MAX_SEARCH_STEPS).toInt();
+
+    QVERIFY(defaultSteps > 0);
+    QCOMPARE(m_engine->getResponse(input, matches), QString("Output 1"));
+
+    // Searches over the budget are aborted and find nothing, so the chatbot uses evasives
+
+    m_engine->setProperty(NLP_PROP_MAX_SEARCH_STEPS, 10);
+    QCOMPARE(m_engine->property(NLP_PROP_MAX_SEARCH_STEPS).toInt(), 10);
+
+    QCOMPARE(m_engine->getResponse(input, matches), QString());
+    QCOMPARE(matches.size(), 0);
+    QCOMPARE(m_engine->getAllResponses(input, matches).size(), 0);
+
+    QList<Lvk::Nlp::ResultList> results;
+    m_engine->getResponses(QStringList() << input << "hola", "", results);
+    QVERIFY(results[0].isEmpty());
+    QCOMPARE(results[1].size(), 1);
+
+    // Short searches are within the budget
+    QCOMPARE(m_engine->getResponse("hola", matches), QString("Output 2"));
+
+    // The budget is per search, not per engine
+    QCOMPARE(m_engine->getResponse("a b", matches), QString("Output 1"));
+    QCOMPARE(m_engine->getResponse("a b", matches), QString("Output 1"));
+
+    m_engine->setProperty(NLP_PROP_MAX_SEARCH_STEPS, 0);
+    QCOMPARE(m_engine->getResponse(input, matches), QString("Output 1"));
+
+    m_engine->setProperty(NLP_PROP_MAX_SEARCH_STEPS, QVariant());
+    QCOMPARE(m_engine->property(NLP_PROP_MAX_SEARCH_STEPS).toInt(), defaultSteps);
+}
+
+void TestCb2Engine::testFuzzyMatch()
+{
+#ifndef EnableTestFuzzyMatch
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "quiero *", QStringList() << "Output 2");
+    rules << Lvk::Nlp::Rule(3, QStringList() << "hola amigo", QStringList() << "Output 3");
+    rules << Lvk::Nlp::Rule(4, QStringList() << "hola amiga", QStringList() << "Output 4");
+    rules << Lvk::Nlp::Rule(5, QStringList() << "no", QStringList() << "Output 5");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(m_engine->property(NLP_PROP_FUZZY_MATCH).toBool(), false);
+    QVERIFY(m_engine->getResponse("ola", matches).isEmpty());
+    QVERIFY(m_engine->getResponse("kiero jugar", matches).isEmpty());
+
+    m_engine->setProperty(NLP_PROP_FUZZY_MATCH, true);
+
+    QCOMPARE(m_engine->property(NLP_PROP_FUZZY_MATCH).toBool(), true);
+    QCOMPARE(m_engine->property(NLP_PROP_LEMMA_MATCH).toBool(), true);
+
+    // Insertions, deletions, substitutions and transpositions
+    QCOMPARE(m_engine->getResponse("ola", matches), QString("Output 1"));
+    QCOMPARE(m_engine->getResponse("hoal", matches), QString("Output 1"));
+    QCOMPARE(m_engine->getResponse("holaa", matches), QString("Output 1"));
+    QCOMPARE(m_engine->getResponse("kiero jugar", matches), QString("Output 2"));
+
+    // Exact matches have higher weight than misspelled ones
+    QCOMPARE(m_engine->getResponse("hola amigo", matches), QString("Output 3"));
+    QCOMPARE(m_engine->getResponse("hola amiga", matches), QString("Output 4"));
+    QCOMPARE(m_engine->getResponse("hola amigoo", matches), QString("Output 3"));
+
+    // Short words and words too far are never corrected
+    QVERIFY(m_engine->getResponse("ni", matches).isEmpty());
+    QVERIFY(m_engine->getResponse("hielo", matches).isEmpty());
+
+    QVERIFY(m_engine->property(NLP_PROP_MEMORY).toMap().value("fuzzyIndexWords").toInt() > 0);
+
+    // Disabling fuzzy match keeps lemma match
+    m_engine->setProperty(NLP_PROP_FUZZY_MATCH, false);
+
+    QCOMPARE(m_engine->property(NLP_PROP_FUZZY_MATCH).toBool(), false);
+    QCOMPARE(m_engine->property(NLP_PROP_LEMMA_MATCH).toBool(), true);
+    QVERIFY(m_engine->getResponse("ola", matches).isEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testSimilarityFallback()
+{
+#ifndef EnableTestSimilarityFallback
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "como cambio mi clave",
+                            QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "quiero cancelar mi cuenta",
+                            QStringList() << "Output 2");
+    rules << Lvk::Nlp::Rule(3, QStringList() << "me llamo [nombre]",
+                            QStringList() << "Hola [nombre]");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(m_engine->property(NLP_PROP_MIN_SIMILARITY).toFloat(), 0.0f);
+    QVERIFY(m_engine->getResponse("como cambio la clave", matches).isEmpty());
+
+    m_engine->setProperty(NLP_PROP_MIN_SIMILARITY, 0.4);
+
+    QCOMPARE(m_engine->getResponse("como cambio la clave", matches), QString("Output 1"));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(1));
+    QCOMPARE(m_engine->getResponse("quiero cancelar la cuenta", matches), QString("Output 2"));
+
+    // Matches still win and inputs too far keep failing
+    QCOMPARE(m_engine->getResponse("como cambio mi clave", matches), QString("Output 1"));
+    QVERIFY(m_engine->getResponse("el clima de hoy", matches).isEmpty());
+
+    // Outputs with variables need a match
+    QVERIFY(m_engine->getResponse("me llamo", matches).isEmpty());
+
+    m_engine->setProperty(NLP_PROP_MIN_SIMILARITY, 0.9);
+
+    QVERIFY(m_engine->getResponse("como cambio la clave", matches).isEmpty());
+
+    QCOMPARE(m_engine->property(NLP_PROP_MEMORY).toMap().value("vectorIndexInputs").toInt(), 3);
+
+    m_engine->setProperty(NLP_PROP_MIN_SIMILARITY, QVariant());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testShadowEngine()
+{
+#ifndef EnableTestShadowEngine
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    QVariantMap overrides;
+    overrides[NLP_PROP_FUZZY_MATCH] = true;
+
+    Lvk::Nlp::ShadowEngine engine(new Lvk::Nlp::Cb2Engine(), new Lvk::Nlp::Cb2Engine(), 0.5,
+                                  overrides);
+    engine.setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "quiero *", QStringList() << "Output 2");
+
+    engine.setRules(rules);
+
+    // Overridden properties are not changed on the shadow engine
+    engine.setProperty(NLP_PROP_FUZZY_MATCH, false);
+    QCOMPARE(engine.property(NLP_PROP_FUZZY_MATCH).toBool(), false);
+
+    // Sessions record in the same stats. Deleting them waits for their comparisons.
+    Lvk::Nlp::Engine *session = engine.createSession();
+    Lvk::Nlp::Result result;
+
+    // One of every two replies is sampled, that is, the second "hola" and the second "ola"
+    for (int i = 0; i < 2; ++i) {
+        session->getResponse("hola", "", result);
+        QCOMPARE(result.output, QString("Output 1"));
+    }
+    for (int i = 0; i < 2; ++i) {
+        session->getResponse("ola", "", result);
+        QVERIFY(result.output.isEmpty());
+    }
+
+    delete session;
+
+    // Only the shadow corrects "ola"
+    QVariantMap stats = engine.property(NLP_PROP_SHADOW_STATS).toMap();
+
+    QCOMPARE(stats["match"].toInt(), 1);
+    QCOMPARE(stats["rule_mismatch"].toInt(), 1);
+    QCOMPARE(stats["output_mismatch"].toInt(), 0);
+    QCOMPARE(stats["primary"].toMap()["count"].toInt(), 2);
+    QCOMPARE(stats["shadow"].toMap()["count"].toInt(), 2);
+
+    engine.setProperty(NLP_PROP_SHADOW_STATS, QVariant());
+    QCOMPARE(engine.property(NLP_PROP_SHADOW_STATS).toMap()["match"].toInt(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testConditionalOutputs_data()
+{
+    QTest::addColumn<QString>("output");
+    QTest::addColumn<QString>("userInput");
+    QTest::addColumn<QString>("expectedOutput");
+
+    QString ages = "{if [a] == 18} igual {if [a] < 18} menor {if [a] >= 100} centenario "
+                   "{if [a] > [b]} mayor que [b] {else} otro";
+
+    QTest::newRow("int eq")       << ages << "18 20" << "igual";
+    QTest::newRow("int less")     << ages << "9 20"  << "menor";
+    QTest::newRow("int numeric")  << ages << "100 5" << "centenario";
+    QTest::newRow("var var")      << ages << "30 20" << "mayor que 20";
+    QTest::newRow("else")         << ages << "20 30" << "otro";
+
+    QString sports = "{if [a] == Futbol} a mi tambien {if voley == [a]} a mi no "
+                     "{if [a] != [b]} distintos {else} iguales";
+
+    QTest::newRow("case insens.") << sports << "FUTBOL tenis" << "a mi tambien";
+    QTest::newRow("literal left") << sports << "Voley tenis"  << "a mi no";
+    QTest::newRow("var ne")       << sports << "golf tenis"   << "distintos";
+    QTest::newRow("var eq")       << sports << "Golf gOLF"    << "iguales";
+    QTest::newRow("str less")     << "{if [a] < m} antes {else} despues" << "Casa x" << "antes";
+    QTest::newRow("str greater")  << "{if [a] < m} antes {else} despues" << "Zorro x"
+                                  << "despues";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testConditionalOutputs()
+{
+#ifndef EnableTestConditionalOutputs
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    QFETCH(QString, output);
+    QFETCH(QString, userInput);
+    QFETCH(QString, expectedOutput);
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "[a] [b]", QStringList() << output);
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(m_engine->getResponse(userInput, matches), expectedOutput);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testRandomConditionalOutputs()
+{
+#ifndef EnableTestConditionalOutputs
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::Rule rule(1, QStringList() << "hola [a]", QStringList()
+                        << "{if [a] == x} Output 1"
+                        << "Output 2"
+                        << "{if [a] != x} Output 3"
+                        << "Output 4");
+    rule.setRandomOutput(true);
+
+    m_engine->setRules(Lvk::Nlp::RuleList() << rule);
+
+    Lvk::Nlp::Engine::MatchList matches;
+    QHash<QString, int> counts;
+
+    for (int i = 0; i < 300; ++i) {
+        ++counts[m_engine->getResponse("hola x", matches)];
+    }
+
+    // Only valid outputs are chosen and each of them is chosen
+    QCOMPARE(counts.size(), 3);
+    QVERIFY(counts.value("Output 1") > 0);
+    QVERIFY(counts.value("Output 2") > 0);
+    QVERIFY(counts.value("Output 4") > 0);
+    QVERIFY(!counts.contains("Output 3"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testTopicTrees()
+{
+#ifndef EnableTestTopicTrees
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "*", QStringList() << "Output 2");
+    rules << Lvk::Nlp::Rule(3, QStringList() << "como estas", QStringList() << "Output 3");
+    rules << Lvk::Nlp::Rule(4, QStringList() << "como *", QStringList() << "Output 4");
+    rules << Lvk::Nlp::Rule(5, QStringList() << "chau", QStringList() << "Output 5");
+    rules << Lvk::Nlp::Rule(6, QStringList() << "como te *", QStringList() << "Output 6");
+    rules << Lvk::Nlp::Rule(7, QStringList() << "hola", QStringList() << "Output 7",
+                            QStringList() << "user@lvk.com");
+
+    rules[0].setNextTopic("A");
+    rules[1].setTopic("A");
+    rules[3].setTopic("A");
+    rules[4].setTopic("A");
+    rules[4].setNextTopic("B");
+    rules[5].setTopic("B");
+
+    m_engine->setRules(rules);
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, true);
+
+    // getResponse() searches topic trees first but must choose the same response than the
+    // first one of getAllResponses(). Sessions do not share topics, so both see the same ones.
+
+    std::auto_ptr<Lvk::Nlp::Engine> best(m_engine->createSession());
+    std::auto_ptr<Lvk::Nlp::Engine> all(m_engine->createSession());
+
+    QStringList inputs;
+    inputs << "como estas" << "hola" << "como estas" << "algo" << "chau" << "como estas"
+           << "como te va" << "hola" << "chau" << "nada";
+
+    QStringList expected;
+    expected << "Output 3" << "Output 1" << "Output 4" << "Output 2" << "Output 5"
+             << "Output 3" << "Output 6" << "Output 1" << "Output 5" << "Output 2";
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    for (int i = 0; i < inputs.size(); ++i) {
+        QString response = best->getResponse(inputs[i], matches);
+        QStringList responses = all->getAllResponses(inputs[i], matches);
+
+        QCOMPARE(response, expected[i]);
+        QCOMPARE(response, responses.isEmpty() ? QString() : responses.first());
+        QCOMPARE(best->getCurrentTopic(""), all->getCurrentTopic(""));
+    }
+
+    // Targets fallback to rules with any user only if their own rules do not match
+
+    QCOMPARE(best->getResponse("hola", "user@lvk.com", matches), QString("Output 7"));
+    QCOMPARE(best->getResponse("chau", "user@lvk.com", matches), QString("Output 5"));
+
+    QVERIFY(best->property(NLP_PROP_MEMORY).toMap().value("topicTreeCount").toInt() > 0);
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testTableLemmatizer()
+{
+#ifndef EnableTestTableLemmatizer
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    const QString TABLE_FILE = QDir::tempPath() + QDir::separator() + "test_cb2engine.lemmas";
+
+    Lvk::Nlp::LemmaTable table;
+    table.add("casas", "casa");
+    table.add("casa", "casa");
+    table.add("fui", "ir");
+    table.add("fui", "ser");
+    table.add("del", "de+el");
+
+    QCOMPARE(table.size(), 4);
+    QCOMPARE(table.lemmaCount(), 3);
+
+    QString lemma;
+    QCOMPARE(table.lookup("Casas", lemma), Lvk::Nlp::LemmaTable::Unique);
+    QCOMPARE(lemma, QString("casa"));
+    QCOMPARE(table.lookup("fui", lemma), Lvk::Nlp::LemmaTable::Ambiguous);
+    QCOMPARE(table.lookup("del", lemma), Lvk::Nlp::LemmaTable::Ambiguous);
+    QCOMPARE(table.lookup("perro", lemma), Lvk::Nlp::LemmaTable::Unknown);
+
+    QVERIFY(table.save(TABLE_FILE));
+
+    QSharedPointer<Lvk::Nlp::LemmaTable> loaded(new Lvk::Nlp::LemmaTable());
+    QVERIFY(loaded->load(TABLE_FILE));
+    QCOMPARE(loaded->size(), table.size());
+    QCOMPARE(loaded->lookup("casas", lemma), Lvk::Nlp::LemmaTable::Unique);
+    QCOMPARE(lemma, QString("casa"));
+    QCOMPARE(loaded->lookup("fui", lemma), Lvk::Nlp::LemmaTable::Ambiguous);
+    QCOMPARE(loaded->lookup("perro", lemma), Lvk::Nlp::LemmaTable::Unknown);
+
+    // Adding forms to a loaded table copies it to memory
+    Lvk::Nlp::LemmaTable edited;
+    QVERIFY(edited.load(TABLE_FILE));
+    edited.add("perros", "perro");
+    QCOMPARE(edited.size(), table.size() + 1);
+    QCOMPARE(edited.lookup("casas", lemma), Lvk::Nlp::LemmaTable::Unique);
+    QCOMPARE(lemma, QString("casa"));
+    QCOMPARE(edited.lookup("perros", lemma), Lvk::Nlp::LemmaTable::Unique);
+    QCOMPARE(lemma, QString("perro"));
+
+    QFile::remove(TABLE_FILE);
+
+    Lvk::Nlp::TableLemmatizer lemmatizer(loaded, new MockLemmatizer());
+
+    QStringList tokens;
+    lemmatizer.tokenize("Hola, [nombre]! [a b]", tokens);
+    QCOMPARE(tokens, QStringList() << "Hola" << "," << "[nombre]" << "!" << "[" << "a" << "b"
+                                   << "]");
+
+    // Unique and unknown words do not use the fallback
+
+    Lvk::Nlp::WordList words;
+    lemmatizer.lemmatize("Casas perro", words);
+    QCOMPARE(words.size(), 2);
+    QCOMPARE(words[0].origWord, QString("Casas"));
+    QCOMPARE(words[0].lemma, QString("casa"));
+    QCOMPARE(words[1].lemma, QString("perro"));
+    QCOMPARE(lemmatizer.fallbacks(), 0);
+
+    // Inputs with ambiguous words use the fallback, batches keep the order of inputs
+
+    lemmatizer.lemmatize("fui a casa", words);
+    QVERIFY(!words.isEmpty());
+    QCOMPARE(lemmatizer.fallbacks(), 1);
+
+    QList<Lvk::Nlp::WordList> batch;
+    lemmatizer.lemmatizeBatch(QStringList() << "casas" << "fui" << "casa", batch);
+    QCOMPARE(batch.size(), 3);
+    QCOMPARE(batch[0].size(), 1);
+    QCOMPARE(batch[0][0].lemma, QString("casa"));
+    QVERIFY(!batch[1].isEmpty());
+    QCOMPARE(batch[2][0].lemma, QString("casa"));
+    QCOMPARE(lemmatizer.fallbacks(), 2);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testLemmaTableCache()
+{
+#ifndef EnableTestLemmaTableCache
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    const QString DICT_FILE = QDir::tempPath() + QDir::separator() + "test_cb2engine_dicc.src";
+    const QString CACHE_FILE = QDir::tempPath() + QDir::separator() + "test_cb2engine_dicc.lmt";
+
+    QFile::remove(CACHE_FILE);
+    QFile::remove(CACHE_FILE + ".sha1");
+
+    QFile dict(DICT_FILE);
+    QVERIFY(dict.open(QFile::WriteOnly | QFile::Truncate));
+    dict.write("casas casa NCFP000\ncasa casa NCFS000\nfui ir VMIS1S0 ser VSIS1S0\n");
+    dict.close();
+
+    QString lemma;
+
+    // First load imports the dictionary and caches it. Next loads map the cache.
+    // Tables are scoped, so the cache is not mapped when it is replaced.
+    {
+        Lvk::Nlp::LemmaTable imported;
+        QVERIFY(imported.loadCached(DICT_FILE, CACHE_FILE));
+        QVERIFY(QFile::exists(CACHE_FILE));
+        QVERIFY(QFile::exists(CACHE_FILE + ".sha1"));
+        QCOMPARE(imported.size(), 3);
+        QCOMPARE(imported.lookup("casas", lemma), Lvk::Nlp::LemmaTable::Unique);
+        QCOMPARE(lemma, QString("casa"));
+
+        Lvk::Nlp::LemmaTable cached;
+        QVERIFY(cached.loadCached(DICT_FILE, CACHE_FILE));
+        QCOMPARE(cached.size(), 3);
+        QCOMPARE(cached.lookup("fui", lemma), Lvk::Nlp::LemmaTable::Ambiguous);
+    }
+
+    QFile hash(CACHE_FILE + ".sha1");
+    QVERIFY(hash.open(QFile::ReadOnly));
+    QByteArray sha1 = hash.readAll();
+    hash.close();
+
+    // Changes of the dictionary are imported again
+    QVERIFY(dict.open(QFile::Append));
+    dict.write("perros perro NCMP000\n");
+    dict.close();
+
+    Lvk::Nlp::LemmaTable updated;
+    QVERIFY(updated.loadCached(DICT_FILE, CACHE_FILE));
+    QCOMPARE(updated.size(), 4);
+    QCOMPARE(updated.lookup("perros", lemma), Lvk::Nlp::LemmaTable::Unique);
+    QCOMPARE(lemma, QString("perro"));
+
+    QVERIFY(hash.open(QFile::ReadOnly));
+    QVERIFY(hash.readAll() != sha1);
+    hash.close();
+
+    Lvk::Nlp::LemmaTable missing;
+    QVERIFY(!missing.loadCached(DICT_FILE + ".missing", CACHE_FILE));
+
+    QFile::remove(DICT_FILE);
+    QFile::remove(CACHE_FILE);
+    QFile::remove(CACHE_FILE + ".sha1");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testAsyncReload()
+{
+#ifndef EnableTestAsyncReload
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::Cb2Engine engine(new Lvk::Nlp::NullSanitizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Output 1");
+
+    engine.setRules(rules);
+
+    Lvk::Nlp::Result result;
+    engine.getResponse("hola", "", result);
+    QCOMPARE(result.output, QString("Output 1"));
+
+    quint32 version = result.rulesVersion;
+    QVERIFY(version > 0);
+    QCOMPARE(engine.property(NLP_PROP_RULES_VERSION).toUInt(), version);
+
+    engine.setProperty(NLP_PROP_ASYNC_RELOAD, true);
+
+    rules[0] = Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Output 2");
+    engine.setRules(rules);
+
+    // Lookups do not wait for the new rules, they get responses from the old or the new ones
+    engine.getResponse("hola", "", result);
+    QVERIFY(result.output == "Output 1" || result.output == "Output 2");
+
+    // build() waits
+    engine.build();
+    engine.getResponse("hola", "", result);
+    QCOMPARE(result.output, QString("Output 2"));
+    QVERIFY(result.rulesVersion > version);
+    QCOMPARE(engine.property(NLP_PROP_RULES_VERSION).toUInt(), result.rulesVersion);
+
+    // Incremental updates are used right away
+    version = result.rulesVersion;
+    engine.addRule(Lvk::Nlp::Rule(2, QStringList() << "chau", QStringList() << "Output 3"));
+    engine.getResponse("chau", "", result);
+    QCOMPARE(result.output, QString("Output 3"));
+    QVERIFY(result.rulesVersion > version);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testToolchains()
+{
+#ifndef EnableTestToolchains
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    // Repeated letters depend on the language
+    QCOMPARE(Lvk::Nlp::DefaultSanitizer(Lvk::Nlp::DefaultSanitizer::RemoveDupChars, "es")
+             .sanitize("coffee"), QString("cofe"));
+    QCOMPARE(Lvk::Nlp::DefaultSanitizer(Lvk::Nlp::DefaultSanitizer::RemoveDupChars, "en")
+             .sanitize("coffee"), QString("coffee"));
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    QSharedPointer<Lvk::Nlp::Toolchain> esTools(new Lvk::Nlp::Toolchain("es"));
+    QSharedPointer<Lvk::Nlp::Toolchain> enTools(new Lvk::Nlp::Toolchain("en"));
+    esTools->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::Cb2Engine esEngine(esTools);
+    Lvk::Nlp::Cb2Engine enEngine(enTools);
+
+    QCOMPARE(esEngine.property(NLP_PROP_LANGUAGE).toString(), QString("es"));
+    QCOMPARE(enEngine.property(NLP_PROP_LANGUAGE).toString(), QString("en"));
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "juego", QStringList() << "Output 1");
+
+    esEngine.setRules(rules);
+    enEngine.setRules(rules);
+    m_engine->setRules(rules);
+
+    // Only the engine with the mock lemmatizer matches other forms of the verb
+    Lvk::Nlp::Engine::MatchList matches;
+    QCOMPARE(esEngine.getResponse("jugaba", matches), QString("Output 1"));
+    QVERIFY(enEngine.getResponse("jugaba", matches).isEmpty());
+    QVERIFY(m_engine->getResponse("jugaba", matches).isEmpty());
+
+    // Changing the tools of one engine does not change the others
+    enEngine.setLemmatizer(new MockLemmatizer());
+    QCOMPARE(enEngine.getResponse("jugaba", matches), QString("Output 1"));
+    QVERIFY(m_engine->getResponse("jugaba", matches).isEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testResponseCache()
+{
+#ifndef EnableTestResponseCache
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Hola!");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "me llamo [n]", QStringList() << "Hola [n]");
+
+    m_engine->setRules(rules);
+    m_engine->setProperty(NLP_PROP_STATS, QVariant());
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    // Rules with constant outputs are cached. Inputs that only differ in whitespace share entries
+    QCOMPARE(m_engine->getResponse("hola", matches), QString("Hola!"));
+    QCOMPARE(m_engine->getResponse("hola", matches), QString("Hola!"));
+    QCOMPARE(m_engine->getResponse("  hola ", matches), QString("Hola!"));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, static_cast<Lvk::Nlp::RuleId>(1));
+
+    QVariantMap cache = m_engine->property(NLP_PROP_STATS).toMap()["cache"].toMap();
+    QCOMPARE(cache["hits"].toInt(), 2);
+    QCOMPARE(cache["misses"].toInt(), 1);
+
+    // Rules with variables are not cached
+    QCOMPARE(m_engine->getResponse("me llamo Juan", matches), QString("Hola Juan"));
+    QCOMPARE(m_engine->getResponse("me llamo Juan", matches), QString("Hola Juan"));
+
+    cache = m_engine->property(NLP_PROP_STATS).toMap()["cache"].toMap();
+    QCOMPARE(cache["hits"].toInt(), 2);
+    QCOMPARE(cache["misses"].toInt(), 3);
+
+    // Changing the rules invalidates the entries
+    rules[0] = Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Buenas!");
+    m_engine->setRules(rules);
+    QCOMPARE(m_engine->getResponse("hola", matches), QString("Buenas!"));
+
+    // Size 0 disables the cache
+    m_engine->setProperty(NLP_PROP_RESPONSE_CACHE_SIZE, 0);
+    m_engine->setProperty(NLP_PROP_STATS, QVariant());
+
+    m_engine->getResponse("hola", matches);
+    m_engine->getResponse("hola", matches);
+
+    cache = m_engine->property(NLP_PROP_STATS).toMap()["cache"].toMap();
+    QCOMPARE(cache["hits"].toInt(), 0);
+
+    m_engine->setProperty(NLP_PROP_RESPONSE_CACHE_SIZE, QVariant());
+    QVERIFY(m_engine->property(NLP_PROP_RESPONSE_CACHE_SIZE).toInt() > 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testMemoryManager()
+{
+#ifndef EnableTestMemoryManager
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    // Caches release the least recently used entries first
+
+    Lvk::Nlp::ResponseCache cache(10);
+    Lvk::Nlp::ResponseCache::Entry entry;
+
+    cache.insert("a", 1, Lvk::Nlp::ResponseCache::Entry(1));
+    cache.insert("b", 1, Lvk::Nlp::ResponseCache::Entry(2));
+    cache.insert("c", 1, Lvk::Nlp::ResponseCache::Entry(3));
+    cache.insert("d", 1, Lvk::Nlp::ResponseCache::Entry(4));
+    QVERIFY(cache.find("a", 1, entry));
+
+    qint64 bytes = cache.memoryUsage();
+    QVERIFY(bytes > 0);
+    QCOMPARE(cache.releaseMemory(bytes/2), bytes/2);
+    QCOMPARE(cache.size(), 2);
+    QCOMPARE(cache.maxSize(), 10);
+    QVERIFY(cache.find("a", 1, entry));
+    QVERIFY(!cache.find("b", 1, entry));
+
+    // Engines release their topic trees, which are rebuilt on the next lookup
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "como *", QStringList() << "Output 2");
+    rules[0].setNextTopic("A");
+    rules[1].setTopic("A");
+
+    Lvk::Nlp::Cb2Engine engine;
+    engine.setRules(rules);
+    engine.setProperty(NLP_PROP_PREFER_CUR_TOPIC, true);
+    engine.setProperty(NLP_PROP_RESPONSE_CACHE_SIZE, 0);   // Cached lookups skip topic trees
+
+    Lvk::Nlp::Engine::MatchList matches;
+
+    QCOMPARE(engine.getResponse("hola", matches), QString("Output 1"));
+    QCOMPARE(engine.getResponse("como te va", matches), QString("Output 2"));
+
+    bytes = engine.memoryUsage();
+    QVERIFY(bytes > 0);
+
+    QVariantMap consumers =
+            Lvk::Cmn::MemoryManager::manager()->report()["consumers"].toMap();
+    QVERIFY(consumers["topicTrees"].toLongLong() >= bytes);
+    QVERIFY(consumers.contains("responseCache"));
+
+    QCOMPARE(engine.releaseMemory(bytes), bytes);
+    QCOMPARE(engine.memoryUsage(), 0LL);
+
+    QCOMPARE(engine.getResponse("hola", matches), QString("Output 1"));
+    QCOMPARE(engine.getResponse("como te va", matches), QString("Output 2"));
+    QCOMPARE(engine.memoryUsage(), bytes);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testAnalysisProfile()
+{
+#ifndef EnableTestAnalysisProfile
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    typedef Lvk::Nlp::AnalysisProfile Profile;
+
+    bool ok;
+
+    QVERIFY(Profile().isFull());
+    QCOMPARE(Profile::fromString("full", &ok), Profile::full());
+    QVERIFY(ok);
+    QCOMPARE(Profile::fromString("Minimal", &ok), Profile::minimal());
+    QVERIFY(ok);
+    QCOMPARE(Profile::fromString("affixes, numbers", &ok).modules(),
+             unsigned(Profile::Affixes | Profile::Numbers));
+    QVERIFY(ok);
+    QCOMPARE(Profile::fromString("affixes,dates", &ok), Profile::full());
+    QVERIFY(!ok);
+
+    Profile profile(Profile::Probabilities | Profile::Multiwords);
+    QCOMPARE(profile.toString(), QString("probabilities,multiwords"));
+    QCOMPARE(Profile::fromString(profile.toString()), profile);
+    QCOMPARE(Profile::full().toString(), QString("full"));
+    QVERIFY(Profile::full().contains(profile));
+    QVERIFY(!profile.contains(Profile::full()));
+
+    // Without locutions file, multiword detection cannot be ruled out. Numbers are only
+    // detected if rules contain digits, variable names do not count.
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola [nombre1]", QStringList() << "Output 1");
+
+    profile = Profile::fromRules(rules, "no_such_lang");
+    QVERIFY(profile.has(Profile::Multiwords));
+    QVERIFY(profile.has(Profile::Affixes));
+    QVERIFY(!profile.has(Profile::Numbers));
+    QVERIFY(!profile.has(Profile::Quantities));
+
+    rules << Lvk::Nlp::Rule(2, QStringList() << "tengo 20 anios", QStringList() << "Output 2");
+
+    QVERIFY(Profile::fromRules(rules, "no_such_lang").isFull());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testSearchDeadline()
+{
+#ifndef EnableTestSearchDeadline
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    // "hola *" is found in the first steps, "* hola * chau" takes quadratic steps to fail
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola *", QStringList() << "Output 1");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "* hola * chau", QStringList() << "Output 2");
+
+    Lvk::Nlp::Tree tree;
+    tree.add(rules);
+
+    QString input = QString("hola ").repeated(100).trimmed();
+
+    // Long inputs are searched without deep recursion
+
+    Lvk::Nlp::ResultList results;
+    Lvk::Nlp::SearchContext ctx;
+    tree.getResponses(input, results, ctx);
+
+    QVERIFY(!ctx.isAborted());
+    QCOMPARE(results.size(), 1);
+    QCOMPARE(results[0].output, QString("Output 1"));
+
+    // The deadline has already expired, so the search stops at the first poll
+
+    QElapsedTimer clock;
+    clock.start();
+    QTest::qSleep(10);
+
+    Lvk::Nlp::SearchContext ctx2;
+    ctx2.setRequest(0, &clock, 1);
+    tree.getResponses(input, results, ctx2);
+
+    QCOMPARE(ctx2.abortReason(), Lvk::Nlp::SearchContext::DeadlineExceeded);
+    QVERIFY(ctx2.steps() < 1000);
+    QCOMPARE(results.size(), 0);
+
+    // Best effort searches keep the results found before the deadline
+
+    Lvk::Nlp::SearchContext ctx3;
+    ctx3.setRequest(0, &clock, 1);
+    ctx3.setBestEffort(true);
+    tree.getResponses(input, results, ctx3);
+
+    QCOMPARE(ctx3.abortReason(), Lvk::Nlp::SearchContext::DeadlineExceeded);
+    QCOMPARE(results.size(), 1);
+    QCOMPARE(results[0].output, QString("Output 1"));
+
+    // But not if the step budget is exceeded
+
+    Lvk::Nlp::SearchContext ctx4;
+    ctx4.setStepBudget(200);
+    ctx4.setBestEffort(true);
+    tree.getResponses(input, results, ctx4);
+
+    QCOMPARE(ctx4.abortReason(), Lvk::Nlp::SearchContext::StepBudgetExceeded);
+    QCOMPARE(results.size(), 0);
+
+    // The engine property
+
+    QCOMPARE(m_engine->property(NLP_PROP_BEST_EFFORT).toBool(), false);
+    m_engine->setProperty(NLP_PROP_BEST_EFFORT, true);
+    QCOMPARE(m_engine->property(NLP_PROP_BEST_EFFORT).toBool(), true);
+    m_engine->setProperty(NLP_PROP_BEST_EFFORT, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testResponseAsync()
+{
+#ifndef EnableTestResponseAsync
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Hola!");
+
+    m_engine->setRules(rules);
+
+    // Requests get the best result
+
+    QFuture<Lvk::Nlp::Result> future = m_engine->getResponseAsync("hola", "");
+    future.waitForFinished();
+
+    QCOMPARE(future.result().output, QString("Hola!"));
+    QCOMPARE(future.result().ruleId, (Lvk::Nlp::RuleId)1);
+
+    // Requests canceled while queued are not searched and have no result
+
+    busyAllWorkers(100);
+
+    future = m_engine->getResponseAsync("hola", "");
+    future.cancel();
+    future.waitForFinished();
+
+    QVERIFY(future.isCanceled());
+    QCOMPARE(future.resultCount(), 0);
+
+    // Requests that miss their deadline while queued have a cleared result
+
+    busyAllWorkers(100);
+
+    future = m_engine->getResponseAsync("hola", "", 10);
+    future.waitForFinished();
+
+    QVERIFY(!future.isCanceled());
+    QCOMPARE(future.resultCount(), 1);
+    QVERIFY(future.result().output.isEmpty());
+    QCOMPARE(future.result().ruleId, (Lvk::Nlp::RuleId)0);
+
+    // Engines wait for their queued requests when they are destroyed
+
+    Lvk::Nlp::Cb2Engine *engine = new Lvk::Nlp::Cb2Engine(new Lvk::Nlp::NullSanitizer());
+    engine->setLemmatizer(new Lvk::Nlp::NullLemmatizer());
+    engine->setRules(rules);
+
+    busyAllWorkers(50);
+
+    future = engine->getResponseAsync("hola", "");
+    delete engine;
+
+    QVERIFY(future.isFinished());
+    QCOMPARE(future.result().output, QString("Hola!"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testSplitSentences()
+{
+#ifndef EnableTestSplitSentences
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules << Lvk::Nlp::Rule(1, QStringList() << "hola", QStringList() << "Hola!");
+    rules << Lvk::Nlp::Rule(2, QStringList() << "cuesta * pesos", QStringList() << "Precio");
+    rules << Lvk::Nlp::Rule(3, QStringList() << "visita * y chau", QStringList() << "Web");
+    rules << Lvk::Nlp::Rule(4, QStringList() << "chau", QStringList() << "Chau!");
+    rules << Lvk::Nlp::Rule(5, QStringList() << "como estas", QStringList() << "Bien");
+    rules << Lvk::Nlp::Rule(6, QStringList() << "que haces", QStringList() << "Nada");
+    rules << Lvk::Nlp::Rule(7, QStringList() << "que haces", QStringList() << "Me voy");
+
+    rules[3].setNextTopic("despedida");
+    rules[4].setTopic("saludo");
+    rules[4].setNextTopic("charla");
+    rules[5].setTopic("charla");
+    rules[6].setTopic("despedida");
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+    QString input = "hola\ncuesta 2 pesos";
+
+    QCOMPARE(m_engine->property(NLP_PROP_SPLIT_SENTENCES).toBool(), false);
+    QVERIFY(m_engine->getResponse(input, matches).isEmpty());
+
+    m_engine->setProperty(NLP_PROP_SPLIT_SENTENCES, true);
+
+    QCOMPARE(m_engine->property(NLP_PROP_SPLIT_SENTENCES).toBool(), true);
+
+    // Outputs of the sentences that match are joined, line breaks end sentences
+    QCOMPARE(m_engine->getResponse(input, matches), QString("Hola! Precio"));
+    QCOMPARE(m_engine->getResponse("hola! nada que ver? chau", matches),
+             QString("Hola! Chau!"));
+
+    // Decimals and URLs do not end sentences, three sentences or more are matched in parallel
+    QCOMPARE(m_engine->getResponse("hola. cuesta 1.5 pesos. chau", matches),
+             QString("Hola! Precio Chau!"));
+    QCOMPARE(m_engine->getResponse("hola! visita www.lvk.com.ar y chau", matches),
+             QString("Hola! Web"));
+
+    // Rule, topic and next topic are the ones of the last sentence that matched
+    Lvk::Nlp::Result result;
+    m_engine->getResponse("hola! como estas? no se", "", result);
+
+    QCOMPARE(result.output, QString("Hola! Bien"));
+    QCOMPARE(result.ruleId, (Lvk::Nlp::RuleId)5);
+    QCOMPARE(result.topic, QString("saludo"));
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, true);
+
+    QCOMPARE(m_engine->getResponse("hola! como estas?", matches), QString("Hola! Bien"));
+    QCOMPARE(m_engine->getResponse("que haces", matches), QString("Nada"));
+    QCOMPARE(m_engine->getResponse("como estas? chau", matches), QString("Bien Chau!"));
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches[0].first, (Lvk::Nlp::RuleId)4);
+    QCOMPARE(m_engine->getResponse("que haces", matches), QString("Me voy"));
+
+    m_engine->setProperty(NLP_PROP_PREFER_CUR_TOPIC, false);
+    m_engine->setProperty(NLP_PROP_SPLIT_SENTENCES, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testProfileRules()
+{
+#ifndef EnableTestProfileRules
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules.append(Lvk::Nlp::Rule(1, QStringList() << "Hola", QStringList() << "Hola"));
+    rules.append(Lvk::Nlp::Rule(2, QStringList() << "Hola *", QStringList() << "Hola *"));
+    rules.append(Lvk::Nlp::Rule(3, QStringList() << "* chau", QStringList() << "Chau"));
+
+    m_engine->setRules(rules);
+    m_engine->build();
+
+    QVariantMap report = m_engine->property(NLP_PROP_MEMORY).toMap();
+
+    Lvk::Nlp::RuleCostList costs;
+    m_engine->profileRules(costs);
+
+    QCOMPARE(costs.size(), 3);
+
+    // The costliest rule first
+    QCOMPARE(costs[0].ruleId, Lvk::Nlp::RuleId(3));
+    QCOMPARE(costs[1].ruleId, Lvk::Nlp::RuleId(2));
+    QCOMPARE(costs[2].ruleId, Lvk::Nlp::RuleId(1));
+
+    // "* chau" adds the star with its loop and an edge from the root that skips the star
+    QCOMPARE(costs[0].nodes, 2);
+    QCOMPARE(costs[0].wildcardEdges, 2);
+    QCOMPARE(costs[0].omapEntries, 1);
+
+    // "Hola *" reuses the node of "Hola" and also has output in it
+    QCOMPARE(costs[1].nodes, 1);
+    QCOMPARE(costs[1].wildcardEdges, 1);
+    QCOMPARE(costs[1].omapEntries, 2);
+
+    QCOMPARE(costs[2].inputs, 1);
+    QCOMPARE(costs[2].words, 1);
+    QCOMPARE(costs[2].nodes, 1);
+    QCOMPARE(costs[2].wildcardEdges, 0);
+    QCOMPARE(costs[2].omapEntries, 1);
+
+    // The compiled rules in use are not replaced
+    QCOMPARE(m_engine->property(NLP_PROP_MEMORY).toMap().value("nodes"), report.value("nodes"));
+
+    m_engine->setRules(Lvk::Nlp::RuleList());
+    m_engine->profileRules(costs);
+
+    QVERIFY(costs.isEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testExplainResponse()
+{
+#ifndef EnableTestExplainResponse
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules.append(Lvk::Nlp::Rule(1, QStringList() << "Hola *", QStringList() << "Hola 1"));
+    rules.append(Lvk::Nlp::Rule(2, QStringList() << "Hola [x]", QStringList() << "Hola [x]"));
+    rules.append(Lvk::Nlp::Rule(3, QStringList() << "Chau", QStringList() << "Chau 3"));
+
+    m_engine->setRules(rules);
+    m_engine->build();
+
+    Lvk::Nlp::Result result;
+    m_engine->getResponse("Hola amigo", "", result);
+
+    QVariantMap stats = m_engine->property(NLP_PROP_STATS).toMap();
+
+    Lvk::Nlp::SearchExplain explain;
+    m_engine->explainResponse("Hola amigo", "", explain, 1);
+
+    // Same result than getResponse() and the best candidates
+    QVERIFY(explain.result.isValid());
+    QCOMPARE(explain.result.ruleId, result.ruleId);
+    QCOMPARE(explain.candidates.size(), 1);
+    QCOMPARE(explain.candidates[0].score, result.score);
+
+    QCOMPARE(explain.searches, 1);
+    QVERIFY(explain.steps > 0);
+    QVERIFY(explain.wordEdges > 0);
+    QVERIFY(explain.wildcardEdges + explain.variableEdges > 0);
+    QVERIFY(explain.terminalNodes > 0);
+    QVERIFY(explain.outputsEvaluated > 0);
+    QCOMPARE(explain.nestedSearches, 0);
+    QVERIFY(!explain.aborted);
+
+    m_engine->explainResponse("Hola amigo", "", explain);
+
+    QCOMPARE(explain.candidates.size(), 2);
+
+    // Exact matches are answered by the literal index
+    m_engine->explainResponse("Chau", "", explain);
+
+    QCOMPARE(explain.result.ruleId, Lvk::Nlp::RuleId(3));
+    QCOMPARE(explain.literalHits, 1);
+
+    m_engine->explainResponse("Nada que ver", "", explain);
+
+    QVERIFY(!explain.result.isValid());
+    QVERIFY(explain.candidates.isEmpty());
+
+    // The stats are not changed
+    QCOMPARE(m_engine->property(NLP_PROP_STATS).toMap(), stats);
+
+    QVariantMap map = explain.toVariantMap();
+    QVERIFY(map.contains("steps"));
+    QVERIFY(map.value("usecs").toMap().contains("search"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TestCb2Engine::testMinimizeTree()
+{
+#ifndef EnableTestMinimizeTree
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules.append(Lvk::Nlp::Rule(1, QStringList() << "Hola", QStringList() << "Hola"));
+    rules.append(Lvk::Nlp::Rule(2, QStringList() << "Me gusta [x]",
+                                QStringList() << "A mi tambien me gusta [x]"));
+    rules.append(Lvk::Nlp::Rule(3, QStringList() << "Buen dia *", QStringList() << "Dia"));
+
+    m_engine->setRules(rules);
+    m_engine->build();
+
+    QStringList inputs;
+    inputs << "Hola" << "Me gusta el futbol" << "Buen dia" << "Buen dia a todos" << "Chau";
+
+    Lvk::Nlp::Engine::MatchList matches;
+    QStringList responses;
+    foreach (const QString &input, inputs) {
+        responses.append(m_engine->getResponse(input, matches));
+    }
+
+    int nodes = m_engine->property(NLP_PROP_MEMORY).toMap().value("nodes").toInt();
+
+    m_engine->setProperty(NLP_PROP_MINIMIZE_TREE, true);
+    m_engine->build();
+
+    QCOMPARE(m_engine->property(NLP_PROP_MINIMIZE_TREE).toBool(), true);
+
+    // Results do not change
+    for (int i = 0; i < inputs.size(); ++i) {
+        QCOMPARE(m_engine->getResponse(inputs[i], matches), responses[i]);
+    }
+
+    QVariantMap report = m_engine->property(NLP_PROP_MEMORY).toMap();
+    QVERIFY(report.value("nodes").toInt() <= nodes);
+    QCOMPARE(report.value("nodes").toInt() + report.value("minimizedNodes").toInt(), nodes);
+
+    // Removed rules do not leave nodes behind
+    m_engine->removeRule(2);
+
+    report = m_engine->property(NLP_PROP_MEMORY).toMap();
+    QCOMPARE(report.value("nodes").toInt() + report.value("minimizedNodes").toInt(), nodes);
+    QCOMPARE(report.value("nodes").toInt(), nodes - 3);
+    QCOMPARE(m_engine->getResponse("Hola", matches), responses[0]);
+    QCOMPARE(m_engine->getResponse("Buen dia a todos", matches), responses[3]);
+
+    // Added rules compile the tree again
+    m_engine->addRule(rules[1]);
+
+    QCOMPARE(m_engine->getResponse("Me gusta el futbol", matches), responses[1]);
+    QCOMPARE(m_engine->property(NLP_PROP_MEMORY).toMap().value("nodes").toInt(), nodes);
+
+    m_engine->setProperty(NLP_PROP_MINIMIZE_TREE, false);
+}
+
+void TestCb2Engine::testPhraseRules()
+{
+#ifndef EnableTestPhraseRules
+    QSKIP("Skip macro on", SkipAll);
+#endif
+
+    Lvk::Nlp::GlobalTools::instance()->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::Result result;
+    Lvk::Nlp::ResultList results;
+
+    // "yo * futbol" and "* juego futbol *" get the same score, phrase rules win ties
+
+    Lvk::Nlp::Tree tree(Lvk::Nlp::MatchPolicy::FuzzyMatch);
+    tree.add(Lvk::Nlp::Rule(1, QStringList() << "yo * futbol", QStringList() << "Tree"));
+    tree.add(Lvk::Nlp::Rule(2, QStringList() << "* juego futbol *", QStringList() << "Phrase"));
+
+    tree.getResponses("yo juego futbol", results);
+
+    QCOMPARE(results.size(), 2);
+    QCOMPARE(results[0].score, results[1].score);
+    QCOMPARE(results[0].ruleId, (Lvk::Nlp::RuleId)2);
+
+    tree.getResponse("yo juego futbol", result);
+
+    QCOMPARE(result.output, QString("Phrase"));
+
+    // A phrase found at several offsets is a single result
+
+    results.clear();
+    tree.getResponses("juego futbol y juego futbol", results);
+
+    QCOMPARE(results.size(), 1);
+    QCOMPARE(results[0].ruleId, (Lvk::Nlp::RuleId)2);
+
+    // Phrases score as in the tree, where the trailing * matches nothing. Words can match
+    // by lemma or misspelled.
+
+    Lvk::Nlp::Tree treeRules(Lvk::Nlp::MatchPolicy::FuzzyMatch);
+    treeRules.add(Lvk::Nlp::Rule(1, QStringList() << "* juego futbol", QStringList() << "A"));
+
+    Lvk::Nlp::Tree phraseRules(Lvk::Nlp::MatchPolicy::FuzzyMatch);
+    phraseRules.add(Lvk::Nlp::Rule(1, QStringList() << "* juego futbol *", QStringList() << "A"));
+
+    QStringList inputs;
+    inputs << "yo juego futbol" << "yo jugaba futbol" << "yo juego fubtol";
+
+    foreach (const QString &input, inputs) {
+        Lvk::Nlp::Result expected;
+        treeRules.getResponse(input, expected);
+        phraseRules.getResponse(input, result);
+
+        QCOMPARE(result.output, QString("A"));
+        QCOMPARE(result.score, expected.score);
+    }
+
+    // Pruned phrases are removed from the trie, the other ones still match
+
+    phraseRules.add(Lvk::Nlp::Rule(3, QStringList() << "* juego tenis *", QStringList() << "B"));
+    phraseRules.remove(3);
+
+    QCOMPARE(phraseRules.minimize(), 1);
+
+    phraseRules.getResponse("yo juego futbol", result);
+
+    QCOMPARE(result.output, QString("A"));
+
+    phraseRules.getResponse("yo juego tenis", result);
+
+    QVERIFY(result.output.isEmpty());
+
+    // Phrase rules with targets
+
+    m_engine->setLemmatizer(new MockLemmatizer());
+
+    Lvk::Nlp::RuleList rules;
+    rules.append(Lvk::Nlp::Rule(1, QStringList() << "* juego futbol *", QStringList() << "Phrase",
+                                QStringList() << TARGET_USER_2));
+
+    m_engine->setRules(rules);
+
+    Lvk::Nlp::Engine::MatchList matches;
+    QCOMPARE(m_engine->getResponse("yo juego futbol", TARGET_USER_2, matches),
+             QString("Phrase"));
+    QVERIFY(m_engine->getResponse("yo juego futbol", TARGET_USER_3, matches).isEmpty());
+}
+
 //--------------------------------------------------------------------------------------------------
 // Test entry point
 //--------------------------------------------------------------------------------------------------
@@ -25,6 +25,7 @@ SOURCES += \
     cipherunittest.cpp \
     ../../chatbot/crypto/cipher.cpp \
     ../../chatbot/crypto/keymanagerfactory.cpp \
+    ../../chatbot/crypto/keycache.cpp \
 
 
 DEFINES += SRCDIR=\\\"$$PWD/\\\"
@@ -1,5 +1,6 @@
 #include <QtCore/QByteArray>
 #include <QtTest/QtTest>
+#include <QBuffer>
 
 #include "crypto/cipher.h"
 
@@ -21,6 +22,12 @@ private Q_SLOTS:
 #ifdef OPENSSL_SUPPORT
     void testCipherSimmetry();
     void testCipherSimmetry_data();
+    void testStreamingCipher();
+    void testStreamingCipher_data();
+    void testReuseCipher();
+    void testGcmCipher();
+    void testGcmCipher_data();
+    void testGcmStreamingCipher();
 #endif
 };
 
@@ -71,6 +78,218 @@ void CipherUnitTest::testCipherSimmetry_data()
 
 //--------------------------------------------------------------------------------------------------
 
+void CipherUnitTest::testStreamingCipher()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray key("1234567890123456");
+    QByteArray iv(8, 0x0c);
+
+    QByteArray expected = data;
+    QVERIFY(Crypto::Cipher(iv, key).encrypt(expected));
+
+    Crypto::Cipher cipher(iv, key);
+
+    // Devices
+    QBuffer plain(&data);
+    QByteArray cdata;
+    QBuffer encrypted(&cdata);
+    QVERIFY(plain.open(QIODevice::ReadOnly));
+    QVERIFY(encrypted.open(QIODevice::WriteOnly));
+    QVERIFY(cipher.encrypt(&plain, &encrypted));
+    QVERIFY(cdata == expected);
+
+    QByteArray ddata;
+    QBuffer decrypted(&ddata);
+    encrypted.close();
+    QVERIFY(encrypted.open(QIODevice::ReadOnly));
+    QVERIFY(decrypted.open(QIODevice::WriteOnly));
+    QVERIFY(cipher.decrypt(&encrypted, &decrypted));
+    QVERIFY(ddata == data);
+
+    // Chunks of odd size
+    QByteArray chunked;
+    QByteArray out;
+    QVERIFY(cipher.beginEncrypt());
+    for (int i = 0; i < data.size(); i += 1001) {
+        QVERIFY(cipher.update(data.constData() + i, qMin(1001, data.size() - i), out));
+        chunked.append(out);
+    }
+    QVERIFY(cipher.final(out));
+    chunked.append(out);
+    QVERIFY(chunked == expected);
+
+    // Not started
+    QVERIFY(!cipher.update(data.constData(), data.size(), out));
+    QVERIFY(!cipher.final(out));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void CipherUnitTest::testStreamingCipher_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("0") << QByteArray();
+    QTest::newRow("1") << QByteArray("mydata");
+    QTest::newRow("2") << QByteArray(8, 'a');
+    QTest::newRow("3") << QByteArray(3*1024*1024 + 5, 'c');
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void CipherUnitTest::testReuseCipher()
+{
+    QByteArray key("asdfaalj23243raf");
+    QByteArray iv(8, 0x0c);
+
+    Crypto::Cipher cipher(iv, key);
+
+    // The same context must produce the same output every time
+    QByteArray d1("first data");
+    QByteArray d2("first data");
+    QVERIFY(cipher.encrypt(d1));
+    QVERIFY(cipher.encrypt(d2));
+    QVERIFY(d1 == d2);
+
+    // Invalid data is left unchanged
+    QByteArray invalid(16, 'x');
+    QByteArray copy = invalid;
+    QVERIFY(!cipher.decrypt(invalid));
+    QVERIFY(invalid == copy);
+
+    QByteArray odd(7, 'x');
+    QVERIFY(!cipher.decrypt(odd));
+    QVERIFY(odd == QByteArray(7, 'x'));
+
+    QVERIFY(cipher.decrypt(d1));
+    QVERIFY(d1 == "first data");
+
+    // Invalid key
+    Crypto::Cipher invalidCipher(iv, "short");
+    QByteArray d3("data");
+    QVERIFY(!invalidCipher.encrypt(d3));
+    QVERIFY(d3 == "data");
+    QVERIFY(!invalidCipher.beginEncrypt());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void CipherUnitTest::testGcmCipher()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray key("1234567890123456");
+    QByteArray iv(8, 0x0c);
+
+    Crypto::Cipher cipher(iv, key, Crypto::Cipher::Aes128GcmSuite);
+
+    QByteArray d1 = data;
+    QByteArray d2 = data;
+    QVERIFY(cipher.encrypt(d1));
+    QVERIFY(cipher.encrypt(d2));
+    QCOMPARE(d1.size(), data.size() + 1 + 12 + 16);
+    QCOMPARE((int)d1[0], (int)Crypto::Cipher::Aes128GcmSuite);
+    QVERIFY(d1 != d2); // random nonce
+
+    QVERIFY(cipher.decrypt(d1));
+    QVERIFY(d1 == data);
+    QCOMPARE(cipher.decryptedSuite(), Crypto::Cipher::Aes128GcmSuite);
+
+    // Tampered data, nonce, tag or suite id is rejected and left unchanged
+    const int pos[] = { 0, 5, 13, d2.size() - 1 };
+    for (unsigned i = 0; i < sizeof(pos)/sizeof(pos[0]); ++i) {
+        QByteArray tampered = d2;
+        tampered[pos[i]] = tampered[pos[i]] ^ 0x01;
+        QByteArray copy = tampered;
+        QVERIFY(!cipher.decrypt(tampered));
+        QVERIFY(tampered == copy);
+    }
+
+    QVERIFY(!Crypto::Cipher(iv, "6543210987654321", Crypto::Cipher::Aes128GcmSuite).decrypt(d2));
+    QVERIFY(cipher.decrypt(d2));
+    QVERIFY(d2 == data);
+
+    // Legacy data
+    QByteArray legacy = data;
+    QVERIFY(Crypto::Cipher(iv, key).encrypt(legacy));
+    QVERIFY(cipher.decrypt(legacy));
+    QVERIFY(legacy == data);
+    QCOMPARE(cipher.decryptedSuite(), Crypto::Cipher::BlowfishCbcSuite);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void CipherUnitTest::testGcmCipher_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("0") << QByteArray();
+    QTest::newRow("1") << QByteArray("mydata");
+    QTest::newRow("2") << QByteArray(1024*1024 + 3, 'c');
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void CipherUnitTest::testGcmStreamingCipher()
+{
+    QByteArray key("1234567890123456");
+    QByteArray iv(8, 0x0c);
+    QByteArray data(3*1024*1024 + 5, 'c');
+
+    Crypto::Cipher cipher(iv, key, Crypto::Cipher::Aes128GcmSuite);
+
+    // Devices
+    QBuffer plain(&data);
+    QByteArray cdata;
+    QBuffer encrypted(&cdata);
+    QVERIFY(plain.open(QIODevice::ReadOnly));
+    QVERIFY(encrypted.open(QIODevice::WriteOnly));
+    QVERIFY(cipher.encrypt(&plain, &encrypted));
+
+    // Streaming and byte array formats are the same
+    QByteArray copy = cdata;
+    QVERIFY(cipher.decrypt(copy));
+    QVERIFY(copy == data);
+
+    // Chunks of odd size, smaller than the header and the tag
+    const int chunkSizes[] = { 1, 7, 1001 };
+    for (unsigned i = 0; i < sizeof(chunkSizes)/sizeof(chunkSizes[0]); ++i) {
+        int chunk = chunkSizes[i];
+        QByteArray pdata = data.left(chunk == 1 ? 4096 : data.size());
+        QByteArray edata = pdata;
+        QVERIFY(cipher.encrypt(edata));
+
+        QByteArray chunked;
+        QByteArray out;
+        QVERIFY(cipher.beginDecrypt());
+        for (int j = 0; j < edata.size(); j += chunk) {
+            QVERIFY(cipher.update(edata.constData() + j, qMin(chunk, edata.size() - j), out));
+            chunked.append(out);
+        }
+        QVERIFY(cipher.final(out));
+        chunked.append(out);
+        QVERIFY(chunked == pdata);
+    }
+
+    // Tampered stream
+    cdata[cdata.size()/2] = cdata[cdata.size()/2] ^ 0x01;
+    QByteArray ddata;
+    QBuffer decrypted(&ddata);
+    encrypted.close();
+    QVERIFY(encrypted.open(QIODevice::ReadOnly));
+    QVERIFY(decrypted.open(QIODevice::WriteOnly));
+    QVERIFY(!cipher.decrypt(&encrypted, &decrypted));
+
+    // Truncated stream
+    QByteArray out;
+    QVERIFY(cipher.beginDecrypt());
+    QVERIFY(cipher.update(cdata.constData(), 20, out));
+    QVERIFY(!cipher.final(out));
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(CipherUnitTest)
 
 #include "cipherunittest.moc"
@@ -0,0 +1,50 @@
+#-------------------------------------------------
+#
+# Clue analysis benchmark
+#
+#-------------------------------------------------
+
+QT       += network xml
+TARGET = clueEngineBench
+CONFIG   += console freeling
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += DA_CONTEST
+
+INCLUDEPATH += \
+    ../../chatbot \
+    ../cb2-engine-unit-test
+
+HEADERS += \
+    ../cb2-engine-unit-test/mocklemmatizer.h
+
+SOURCES += \
+    clueenginebench.cpp \
+    ../cb2-engine-unit-test/mocklemmatizer.cpp
+
+PROJECT_PATH = ../../chatbot
+
+include($$PROJECT_PATH/back-end/back-end.pri)
+include($$PROJECT_PATH/da-clue/da-clue.pri)
+include($$PROJECT_PATH/nlp-engine/nlp-engine.pri)
+include($$PROJECT_PATH/chat-adapter/chat-adapter.pri)
+include($$PROJECT_PATH/da-server/da-server.pri)
+include($$PROJECT_PATH/stats/stats.pri)
+include($$PROJECT_PATH/crypto/crypto.pri)
+include($$PROJECT_PATH/common/common.pri)
+include($$PROJECT_PATH/3rd-party.pri)
+
+FL_DATA_PATH += \
+    ../../../third-party/Freeling/data/es/
+
+win32 {
+    warning(Benchmarks with Freeling need manual setup)
+    warning(Copy freeling data in the directory where the benchmark is executed)
+} else {
+    copyfiles.commands = mkdir -p ./data/freeling/; cp -Rf $$FL_DATA_PATH ./data/freeling/
+}
+
+QMAKE_EXTRA_TARGETS += copyfiles
+POST_TARGETDEPS += copyfiles
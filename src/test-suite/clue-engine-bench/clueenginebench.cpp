@@ -0,0 +1,735 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Botmaster.
+ *
+ * LVK Botmaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Botmaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Botmaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Clue analysis benchmark. Generates characters, scripts in plain and obfuscated format,
+// rules and chatbot files with the given sizes, and writes one CSV row per stage with the
+// items processed, the total time and the time per item. Stages:
+//
+//   load_plain_cold, load_plain_cached            ScriptManager loading plain scripts
+//   load_obfuscated_cold, load_obfuscated_cached  ScriptManager loading obfuscated scripts
+//   analyze_first                                 First ClueEngine analysis, builds the rules
+//   analyze_lines                                 ClueEngine analysis of every script line
+//   match_compile                                 Clue::RegExp checks with empty pattern cache
+//   match_expected, match_forbidden               Clue::RegExp checks of the answers found
+//   batch_jobs_N                                  BatchAnalyzer run over all chatbot files
+//
+// Usage: clueEngineBench [options]
+//
+//   --characters N       Suspects, each with its own scripts. Default: 4
+//   --scripts N          Scripts per character. Default: 10
+//   --lines N            Questions per script. Default: 20
+//   --rules N            Rules of each chatbot. Default: 300
+//   --submissions N      Chatbot files analyzed in batch. Default: 8. 0 skips the batch stage
+//   --jobs N             Batch worker processes. Batch runs with 1 and N jobs. Default: 1
+//   --rounds N           Repetitions of every stage but batch. Default: 5
+//   --lemmatizer NAME    mock or freeling. Batch workers always use the app lemmatizer.
+//                        Default: mock
+//   --dir DIR            Directory where files are generated. Default: ./clue-bench
+//   --seed N             Seed of the generated files. Default: 1
+//   --output FILE        Appends the results to FILE instead of writing them to stdout
+//
+// Files are generated on every run. Batch workers are new processes of this benchmark, so the
+// settings file in the current directory is changed to point to the generated scripts.
+// BatchAnalyzer prints its progress to stdout, so use --output to keep the CSV apart.
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QFile>
+#include <QDir>
+#include <QtDebug>
+
+#include "back-end/appfacade.h"
+#include "back-end/rule.h"
+#include "common/globalstrings.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "crypto/keycache.h"
+#include "crypto/cipher.h"
+#include "da-clue/batchanalyzer.h"
+#include "da-clue/clueengine.h"
+#include "da-clue/regexp.h"
+#include "da-clue/scriptmanager.h"
+#include "da-clue/scriptparser.h"
+#include "nlp-engine/globaltools.h"
+#include "nlp-engine/lemmatizerfactory.h"
+#include "nlp-engine/rule.h"
+#include "mocklemmatizer.h"
+
+#include <stdio.h>
+
+#define VOCABULARY_SIZE     2000
+#define HIT_RATIO           0.7     // Questions built from rule inputs
+#define FORBIDDEN_RATIO     0.3     // Questions with a forbidden answer
+#define CRITICAL_RATIO      0.2     // Critical questions
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const char *SYLLABLES[] = { "ba", "ce", "di", "fo", "gu", "la", "me", "ni", "po", "ru", "sa",
+                            "te", "vi", "zo", "che", "que" };
+const int SYLLABLE_COUNT = sizeof(SYLLABLES)/sizeof(SYLLABLES[0]);
+
+//--------------------------------------------------------------------------------------------------
+
+struct Options
+{
+    Options()
+        : characters(4), scripts(10), lines(20), rules(300), submissions(8), jobs(1), rounds(5),
+          lemmatizer("mock"), dir("./clue-bench"), seed(1) { }
+
+    int characters;
+    int scripts;
+    int lines;
+    int rules;
+    int submissions;
+    int jobs;
+    int rounds;
+    QString lemmatizer;
+    QString dir;
+    uint seed;
+    QString output;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Time of a stage
+struct Stage
+{
+    Stage(const QString &name = "", qint64 items = 0, qint64 ns = 0)
+        : name(name), items(items), ns(ns) { }
+
+    QString name;
+    qint64 items;
+    qint64 ns;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// ScriptManager, ClueEngine and MockLemmatizer log every call
+void quietMsgHandler(QtMsgType type, const char *msg)
+{
+    if (type != QtDebugMsg) {
+        fprintf(stderr, "%s\n", msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline int randomInt(int n)
+{
+    return qrand() % n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline bool randomBool(double ratio)
+{
+    return randomInt(1000) < ratio*1000;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Deterministic word made of syllables
+QString word(int i)
+{
+    QString w;
+
+    do {
+        w += SYLLABLES[i % SYLLABLE_COUNT];
+        i /= SYLLABLE_COUNT;
+    } while (i > 0);
+
+    return w;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString randomWord()
+{
+    return word(randomInt(VOCABULARY_SIZE));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString randomWords(int n)
+{
+    QStringList words;
+
+    for (int i = 0; i < n; ++i) {
+        words.append(randomWord());
+    }
+
+    return words.join(" ");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString characterName(int i)
+{
+    return QString("Suspect%1").arg(i);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Half of the rules end with a wildcard, as detectives rarely ask exactly the same
+Nlp::RuleList makeRules(int n)
+{
+    Nlp::RuleList rules;
+
+    for (int i = 1; i <= n; ++i) {
+        QStringList input;
+        input << randomWords(2 + randomInt(3)) << randomWords(2 + randomInt(3));
+
+        if (randomBool(0.5)) {
+            input[0].append(" *");
+        }
+
+        QStringList output;
+        output << randomWords(4 + randomInt(5)) << randomWords(4 + randomInt(5));
+
+        rules.append(Nlp::Rule(i, input, output));
+    }
+
+    return rules;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Expected answers usually name a word of the rule output, so most answers found match them
+Clue::Script makeScript(const Nlp::RuleList &rules, const QString &character, int number,
+                        int lines)
+{
+    Clue::Script script(QString("%1_%2.%3").arg(character).arg(number).arg(SCRIPT_FILE_EXT),
+                        character, number);
+
+    for (int i = 0; i < lines; ++i) {
+        const Nlp::Rule &rule = rules[randomInt(rules.size())];
+        QString question;
+
+        if (randomBool(HIT_RATIO)) {
+            question = rule.input()[randomInt(rule.input().size())];
+            question.replace("*", randomWords(1 + randomInt(3)));
+        } else {
+            question = randomWords(3 + randomInt(5));
+        }
+
+        QStringList outputWords = rule.output()[randomInt(rule.output().size())].split(" ");
+
+        QString expAnswer = QString("*%1* | *%2*")
+                .arg(outputWords[randomInt(outputWords.size())], randomWord());
+
+        QString forbidAnswer;
+        if (randomBool(FORBIDDEN_RATIO)) {
+            forbidAnswer = QString("*%1*").arg(randomWord());
+        }
+
+        Clue::ScriptLine::Importance importance = randomBool(CRITICAL_RATIO)
+                ? Clue::ScriptLine::Critical : Clue::ScriptLine::Standard;
+
+        script.append(Clue::ScriptLine(question, expAnswer, forbidAnswer,
+                                       QString("Hint %1").arg(i),
+                                       forbidAnswer.isEmpty() ? QString() : QString("Never!"),
+                                       importance));
+    }
+
+    return script;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Scripts are written by hand, so they usually have comments
+QByteArray toXml(const Clue::Script &script)
+{
+    QString xml;
+    QTextStream out(&xml);
+
+    out << "<!-- Script " << script.number << " -- written by the contest team -->\n"
+        << "<SCRIPT>\n"
+        << " <HEADER>\n"
+        << "  <CHARACTER>" << script.character << "</CHARACTER>\n"
+        << "  <SCRIPTNUMBER>" << script.number << "</SCRIPTNUMBER>\n"
+        << " </HEADER>\n"
+        << " <BODY>\n";
+
+    foreach (const Clue::ScriptLine &line, script) {
+        out << "  <QUESTION>\n"
+            << "   <PHRASE>" << line.question << "</PHRASE>\n"
+            << "   <EXPECTEDANSWERS>" << line.expAnswer << "</EXPECTEDANSWERS>\n"
+            << "   <FORBIDDENANSWERS>" << line.forbidAnswer << "</FORBIDDENANSWERS>\n"
+            << "   <IMPORTANCE>"
+            << (line.importance == Clue::ScriptLine::Critical ? "CRITICAL" : "STANDARD")
+            << "</IMPORTANCE>\n"
+            << "   <EXPECTEDHINT>" << line.expHint << "</EXPECTEDHINT>\n"
+            << "   <FORBIDDENHINT>" << line.forbidHint << "</FORBIDDENHINT>\n"
+            << "  </QUESTION>\n";
+    }
+
+    out << " </BODY>\n"
+        << "</SCRIPT>\n";
+    out.flush();
+
+    return xml.toUtf8();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool writeFile(const QString &filename, const QByteArray &data)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(data) != data.size()) {
+        fprintf(stderr, "Cannot write %s\n", qPrintable(filename));
+        return false;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Writes the characters file and all scripts in plain format in dir/plain and obfuscated in
+// dir/obfuscated
+bool writeScripts(const Options &opt, const QList<Clue::ScriptList> &scripts)
+{
+    QString charsFilename = Cmn::SettingsSnapshot::current().stringValue(SETTING_CLUE_CHARS_FILE);
+    QByteArray chars;
+
+    for (int i = 0; i < opt.characters; ++i) {
+        chars += characterName(i).toUtf8() + "\n";
+    }
+    chars += "Detective*\n";
+
+    Crypto::Cipher &cipher = Crypto::KeyCache::cache()
+            ->threadCipher(Crypto::KeyManager::ClueScriptsRole);
+
+    QStringList formats;
+    formats << "plain" << "obfuscated";
+
+    foreach (const QString &format, formats) {
+        QString path = opt.dir + "/" + format + "/";
+
+        if (!QDir().mkpath(path) || !writeFile(path + charsFilename, chars)) {
+            return false;
+        }
+
+        foreach (const Clue::ScriptList &charScripts, scripts) {
+            foreach (const Clue::Script &script, charScripts) {
+                QByteArray data = toXml(script);
+
+                if (format == "obfuscated" && !cipher.encrypt(data)) {
+                    fprintf(stderr, "Cannot obfuscate %s\n", qPrintable(script.filename));
+                    return false;
+                }
+                if (!writeFile(path + script.filename, data)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Chatbot files with new rules each, in dir/submissions
+bool writeSubmissions(const Options &opt)
+{
+    QString path = opt.dir + "/submissions/";
+
+    if (!QDir().mkpath(path)) {
+        fprintf(stderr, "Cannot create %s\n", qPrintable(path));
+        return false;
+    }
+
+    for (int i = 0; i < opt.submissions; ++i) {
+        QString filename = path + QString("submission%1.cbf").arg(i);
+        BE::AppFacade appFacade;
+
+        QFile::remove(filename);
+
+        if (!appFacade.newFile(filename)) {
+            fprintf(stderr, "Cannot create %s\n", qPrintable(filename));
+            return false;
+        }
+
+        BE::Rule *container = new BE::Rule("Bench", BE::Rule::ContainerRule);
+        container->setId(appFacade.nextRuleId());
+
+        foreach (const Nlp::Rule &r, makeRules(opt.rules)) {
+            BE::Rule *rule = new BE::Rule(QString("Rule %1").arg(r.id()), r.input(), r.output());
+            rule->setId(appFacade.nextRuleId());
+            container->appendChild(rule);
+        }
+
+        appFacade.rootRule()->appendChild(container);
+        appFacade.setUsername(QString("user%1").arg(i));
+        appFacade.setCurrentCharacter(characterName(i % opt.characters));
+
+        if (!appFacade.save()) {
+            fprintf(stderr, "Cannot save %s\n", qPrintable(filename));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Loads the scripts of every character from dir/format. Cold rounds clear all script caches
+// first.
+Stage runLoad(const Options &opt, const QString &format, bool cold)
+{
+    Cmn::Settings().setValue(SETTING_CLUE_PATH, opt.dir + "/" + format);
+
+    Clue::ScriptManager mgr;
+    mgr.setScriptFormat(format == "plain" ? Clue::XmlPlain : Clue::XmlObfuscated);
+
+    Stage stage(QString("load_%1_%2").arg(format, cold ? "cold" : "cached"));
+    QElapsedTimer timer;
+
+    if (!cold) {
+        for (int i = 0; i < opt.characters; ++i) {
+            mgr.loadScriptsForCharacter(characterName(i));
+        }
+    }
+
+    for (int r = 0; r < opt.rounds; ++r) {
+        if (cold) {
+            Clue::ScriptParser::clearCache();
+            Clue::ScriptManager::clearCache();
+        }
+
+        for (int i = 0; i < opt.characters; ++i) {
+            timer.start();
+            bool loaded = mgr.loadScriptsForCharacter(characterName(i));
+            stage.ns += timer.nsecsElapsed();
+
+            if (!loaded) {
+                QString errMsg;
+                mgr.error(&errMsg);
+                fprintf(stderr, "Cannot load scripts: %s\n", qPrintable(errMsg));
+                return Stage();
+            }
+
+            stage.items += mgr.scripts().size();
+        }
+    }
+
+    return stage;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Analyzes all scripts. The first analysis builds the rules and is timed apart. \a found gets
+// the analyzed scripts of the last round.
+QList<Stage> runAnalyze(const Options &opt, const Nlp::RuleList &rules,
+                        const QList<Clue::ScriptList> &scripts, Clue::AnalyzedList &found)
+{
+    QList<Stage> stages;
+    Clue::ClueEngine engine;
+    QElapsedTimer timer;
+
+    engine.setRules(rules);
+
+    Stage first("analyze_first");
+    Stage lines("analyze_lines");
+
+    for (int r = 0; r <= opt.rounds; ++r) {
+        Stage &stage = r == 0 ? first : lines;
+
+        found.clear();
+
+        foreach (const Clue::ScriptList &charScripts, scripts) {
+            Clue::AnalyzedList ascripts;
+
+            timer.start();
+            engine.analyze(charScripts, ascripts);
+            stage.ns += timer.nsecsElapsed();
+
+            foreach (const Clue::AnalyzedScript &ascript, ascripts) {
+                stage.items += ascript.size();
+            }
+
+            found += ascripts;
+        }
+    }
+
+    stages << first << lines;
+
+    return stages;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Checks the answers found against the expected and forbidden patterns of each line, as the
+// ClueEngine does. The first pass compiles every pattern.
+QList<Stage> runMatch(const Options &opt, const Clue::AnalyzedList &found)
+{
+    Stage compile("match_compile");
+    Stage expected("match_expected");
+    Stage forbidden("match_forbidden");
+    Clue::RegExp regexp;
+    QElapsedTimer timer;
+    int sink = 0;
+
+    for (int r = 0; r <= opt.rounds; ++r) {
+        foreach (const Clue::AnalyzedScript &ascript, found) {
+            foreach (const Clue::AnalyzedLine &line, ascript) {
+                if (line.answer.isEmpty()) {
+                    continue;
+                }
+
+                Stage &expStage = r == 0 ? compile : expected;
+
+                timer.start();
+                sink += regexp.exactMatch(line.expAnswer, line.answer);
+                expStage.ns += timer.nsecsElapsed();
+                ++expStage.items;
+
+                if (line.forbidAnswer.isEmpty()) {
+                    continue;
+                }
+
+                Stage &forbidStage = r == 0 ? compile : forbidden;
+
+                timer.start();
+                sink += regexp.exactMatch(line.forbidAnswer, line.answer);
+                forbidStage.ns += timer.nsecsElapsed();
+                ++forbidStage.items;
+            }
+        }
+    }
+
+    qDebug() << "Matches:" << sink;
+
+    return QList<Stage>() << compile << expected << forbidden;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Analyzes dir/submissions with the obfuscated scripts. Results are never cached.
+Stage runBatch(const Options &opt, int jobs)
+{
+    Cmn::Settings().setValue(SETTING_CLUE_PATH, opt.dir + "/obfuscated");
+
+    Stage stage(QString("batch_jobs_%1").arg(jobs), opt.submissions);
+
+    Clue::BatchAnalyzer ba;
+    ba.setJobs(jobs);
+    ba.setCacheEnabled(false);
+    ba.setReportFile(opt.dir + QString("/report_jobs_%1.jsonl").arg(jobs));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int exitCode = ba.exec(opt.dir + "/submissions");
+
+    stage.ns = timer.nsecsElapsed();
+
+    if (exitCode != 0) {
+        fprintf(stderr, "Batch analysis with %d jobs failed with code %d\n", jobs, exitCode);
+        return Stage();
+    }
+
+    return stage;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void writeStage(QTextStream &out, const Options &opt, const Stage &stage)
+{
+    if (stage.name.isEmpty()) {
+        return;
+    }
+
+    out << stage.name << "," << opt.lemmatizer << "," << opt.characters << "," << opt.scripts
+        << "," << opt.lines << "," << opt.rules << "," << stage.items << ","
+        << QString::number(stage.ns/1e6, 'f', 1) << ","
+        << QString::number(stage.items > 0 ? stage.ns/1e3/stage.items : 0, 'f', 2) << "\n";
+    out.flush();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool parseOptions(const QStringList &args, Options &opt)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+
+        const QString &value = args[++i];
+        bool ok = true;
+
+        if (arg == "--characters") {
+            opt.characters = value.toInt(&ok);
+            ok = ok && opt.characters >= 1;
+        } else if (arg == "--scripts") {
+            opt.scripts = value.toInt(&ok);
+        } else if (arg == "--lines") {
+            opt.lines = value.toInt(&ok);
+        } else if (arg == "--rules") {
+            opt.rules = value.toInt(&ok);
+            ok = ok && opt.rules >= 1;
+        } else if (arg == "--submissions") {
+            opt.submissions = value.toInt(&ok);
+        } else if (arg == "--jobs") {
+            opt.jobs = value.toInt(&ok);
+            ok = ok && opt.jobs >= 1;
+        } else if (arg == "--rounds") {
+            opt.rounds = value.toInt(&ok);
+        } else if (arg == "--lemmatizer") {
+            opt.lemmatizer = value;
+            ok = value == "mock" || value == "freeling";
+        } else if (arg == "--dir") {
+            opt.dir = value;
+        } else if (arg == "--seed") {
+            opt.seed = value.toUInt(&ok);
+        } else if (arg == "--output") {
+            opt.output = value;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInstallMsgHandler(quietMsgHandler);
+
+    QStringList args = app.arguments();
+
+    // BatchAnalyzer starts its workers as new processes of this benchmark
+    if (args.size() == 4 && args[1] == BATCH_WORKER_OPTION) {
+        return Clue::BatchAnalyzer().execWorker(args[2], args[3]);
+    }
+
+    Options opt;
+
+    if (!parseOptions(args, opt)) {
+        fprintf(stderr, "Usage: clueEngineBench [--characters N] [--scripts N] [--lines N] "
+                        "[--rules N] [--submissions N] [--jobs N] [--rounds N] "
+                        "[--lemmatizer mock|freeling] [--dir DIR] [--seed N] "
+                        "[--output FILE]\n");
+        return 1;
+    }
+
+    Cmn::Settings().setValue(SETTING_APP_LANGUAGE, "es_AR");
+
+    if (opt.lemmatizer == "freeling") {
+        Nlp::GlobalTools::instance()->setLemmatizer(Nlp::LemmatizerFactory().createLemmatizer());
+    } else {
+        Nlp::GlobalTools::instance()->setLemmatizer(new MockLemmatizer());
+    }
+
+    qsrand(opt.seed);
+
+    Nlp::RuleList rules = makeRules(opt.rules);
+    QList<Clue::ScriptList> scripts;
+
+    for (int i = 0; i < opt.characters; ++i) {
+        Clue::ScriptList charScripts;
+        for (int j = 1; j <= opt.scripts; ++j) {
+            charScripts.append(makeScript(rules, characterName(i), j, opt.lines));
+        }
+        scripts.append(charScripts);
+    }
+
+    if (!writeScripts(opt, scripts)) {
+        return 1;
+    }
+
+    QFile file;
+    bool header = true;
+
+    if (opt.output.isEmpty()) {
+        file.open(stdout, QFile::WriteOnly);
+    } else {
+        file.setFileName(opt.output);
+        header = !file.exists() || file.size() == 0;
+
+        if (!file.open(QFile::WriteOnly | QFile::Append)) {
+            fprintf(stderr, "Cannot open %s\n", qPrintable(opt.output));
+            return 1;
+        }
+    }
+
+    QTextStream out(&file);
+
+    if (header) {
+        out << "stage,lemmatizer,characters,scripts,lines,rules,items,total_ms,us_per_item\n";
+    }
+
+    writeStage(out, opt, runLoad(opt, "plain", true));
+    writeStage(out, opt, runLoad(opt, "plain", false));
+    writeStage(out, opt, runLoad(opt, "obfuscated", true));
+    writeStage(out, opt, runLoad(opt, "obfuscated", false));
+
+    Clue::AnalyzedList found;
+
+    foreach (const Stage &stage, runAnalyze(opt, rules, scripts, found)) {
+        writeStage(out, opt, stage);
+    }
+
+    foreach (const Stage &stage, runMatch(opt, found)) {
+        writeStage(out, opt, stage);
+    }
+
+    if (opt.submissions > 0) {
+        if (!writeSubmissions(opt)) {
+            return 1;
+        }
+
+        writeStage(out, opt, runBatch(opt, 1));
+
+        if (opt.jobs > 1) {
+            writeStage(out, opt, runBatch(opt, opt.jobs));
+        }
+    }
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <QtCore/QString>
 #include <QtTest/QtTest>
+#include <memory>
 
 #include "common/globalstrings.h"
 #include "common/settings.h"
@@ -7,6 +8,7 @@
 #include "nlp-engine/rule.h"
 #include "nlp-engine/globaltools.h"
 #include "nlp-engine/lemmatizerfactory.h"
+#include "nlp-engine/enginefactory.h"
 #include "da-clue/clueengine.h"
 #include "da-clue/script.h"
 #include "da-clue/analyzedscript.h"
@@ -96,6 +98,12 @@ private Q_SLOTS:
     void cleanupTestCase();
     void testCase1();
     void testCase1_data();
+    void testReanalyze();
+    void testReanalyze_data();
+    void testSharedEngine();
+    void testSharedEngine_data();
+    void testRegExp();
+    void testRegExp_data();
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -247,6 +255,141 @@ void ClueEngineTest::testCase1_data()
 
 //--------------------------------------------------------------------------------------------------
 
+void ClueEngineTest::testReanalyze()
+{
+    QFETCH(Nlp::RuleList, rules);
+    QFETCH(Clue::Script, script);
+    QFETCH(Clue::AnalyzedScript, expAscript);
+
+    // Start from a previous analysis with rules that have nothing in common
+    Nlp::RuleList initialRules;
+    initialRules.append(Nlp::Rule(1, QStringList() << "Hola *", QStringList() << "Hola!"));
+    initialRules.append(Nlp::Rule(9, QStringList() << "Chau *", QStringList() << "Chau!"));
+
+    Clue::ClueEngine engine;
+    Clue::AnalyzedList ascripts;
+
+    engine.setRules(initialRules);
+    engine.analyze(Clue::ScriptList() << script, ascripts);
+
+    Clue::LineIndexList changed;
+    engine.reanalyze(rules, ascripts, &changed);
+
+    QCOMPARE(ascripts.size(), 1);
+    QCOMPARE(ascripts[0], expAscript);
+
+    // Only changed lines are reported
+    Clue::AnalyzedList full;
+    Clue::ClueEngine engine2;
+    engine2.setRules(initialRules);
+    engine2.analyze(Clue::ScriptList() << script, full);
+
+    for (int j = 0; j < full[0].size(); ++j) {
+        QCOMPARE(changed.contains(qMakePair(0, j)), full[0][j] != expAscript[j]);
+    }
+
+    // Nothing changes if rules do not change
+    changed.clear();
+    engine.reanalyze(rules, ascripts, &changed);
+
+    QVERIFY(changed.isEmpty());
+    QCOMPARE(ascripts[0], expAscript);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ClueEngineTest::testReanalyze_data()
+{
+    testCase1_data();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ClueEngineTest::testSharedEngine()
+{
+    QFETCH(Nlp::RuleList, rules);
+    QFETCH(Clue::Script, script);
+    QFETCH(Clue::AnalyzedScript, expAscript);
+
+    std::auto_ptr<Nlp::Engine> nlpEngine(Nlp::EngineFactory().createEngine());
+    nlpEngine->setRules(rules);
+
+    Clue::ClueEngine engine;
+    Clue::AnalyzedList ascripts;
+
+    // Rules set on the ClueEngine are ignored, the ones of the NLP engine are analyzed
+    engine.setEngine(nlpEngine.get());
+    engine.setRules(Nlp::RuleList());
+    engine.analyze(Clue::ScriptList() << script, ascripts);
+
+    QCOMPARE(ascripts.size(), 1);
+    QCOMPARE(ascripts[0], expAscript);
+
+    // Changes in the NLP engine are seen by the next analysis and give the same result than
+    // analyzing with an engine of its own
+    Nlp::RuleList newRules;
+    newRules.append(Nlp::Rule(1, QStringList() << "Hola *", QStringList() << "Hola!"));
+    newRules.append(Nlp::Rule(9, QStringList() << "Chau *", QStringList() << "Chau!"));
+
+    nlpEngine->setRules(newRules);
+    engine.reanalyze(nlpEngine->rules(), ascripts);
+
+    Clue::ClueEngine engine2;
+    Clue::AnalyzedList expAscripts;
+    engine2.setRules(newRules);
+    engine2.analyze(Clue::ScriptList() << script, expAscripts);
+
+    QCOMPARE(ascripts, expAscripts);
+
+    engine.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ClueEngineTest::testSharedEngine_data()
+{
+    testCase1_data();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ClueEngineTest::testRegExp()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, str);
+    QFETCH(bool, match);
+
+    Clue::RegExp regexp;
+
+    // Patterns are compiled and cached the first time. Results must not change afterwards
+    for (int i = 0; i < 2; ++i) {
+        QCOMPARE(regexp.exactMatch(pattern, str), match);
+        QCOMPARE(regexp.exactMatch("*", str), !str.isEmpty());
+        QCOMPARE(regexp.exactMatch(pattern, str), match);
+    }
+
+    regexp.clear();
+    QCOMPARE(regexp.exactMatch(pattern, str), match);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ClueEngineTest::testRegExp_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("str");
+    QTest::addColumn<bool>("match");
+
+    QTest::newRow("0") << "*durmiendo* | *descanzando*" << "Estaba durmiendo!"  << true;
+    QTest::newRow("1") << "*durmiendo* | *descanzando*" << "Estaba descanzando" << true;
+    QTest::newRow("2") << "*durmiendo* | *descanzando*" << "no se"              << false;
+    QTest::newRow("3") << "* sarasa *"                  << "Odiaba sarasa hoy"  << true;
+    QTest::newRow("4") << "sarasa"                      << "Odiaba sarasa"      << false;
+    QTest::newRow("5") << ""                            << "sarasa"             << false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(ClueEngineTest);
 
 #include "clueenginetest.moc"
@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2012-09-11T17:10:07
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = contactSchedulerUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../chatbot/
+
+SOURCES += \
+    contactschedulertest.cpp \
+    ../../chatbot/chat-adapter/contactscheduler.cpp \
+    ../../chatbot/chat-adapter/contactring.cpp \
+    ../../chatbot/chat-adapter/admissioncontrol.cpp \
+    ../../chatbot/common/taskscheduler.cpp \
+    ../../chatbot/common/settings.cpp \
+
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
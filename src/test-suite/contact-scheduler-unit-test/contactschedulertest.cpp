@@ -0,0 +1,494 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QHash>
+
+#include "chat-adapter/contactscheduler.h"
+#include "chat-adapter/contactring.h"
+#include "chat-adapter/admissioncontrol.h"
+#include "common/taskscheduler.h"
+
+using namespace Lvk;
+
+#define TIMEOUT     10000
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Checks that jobs of the same contact run in order and never at the same time
+
+struct SeqState
+{
+    SeqState() : errors(0) { }
+
+    QMutex mutex;
+    QHash<QString, int> next;
+    QSet<QString> running;
+    int errors;
+};
+
+class SeqJob : public CA::ContactScheduler::Job
+{
+public:
+    SeqJob(SeqState *state, const QString &contact, int seq)
+        : m_state(state), m_contact(contact), m_seq(seq) { }
+
+    void run()
+    {
+        {
+            QMutexLocker locker(&m_state->mutex);
+
+            if (m_state->running.contains(m_contact) || m_state->next[m_contact] != m_seq) {
+                ++m_state->errors;
+            }
+            m_state->running.insert(m_contact);
+            m_state->next[m_contact] = m_seq + 1;
+        }
+
+        // Some work while the contact is running
+        volatile int n = 0;
+        for (int i = 0; i < 1000; ++i) {
+            n += i;
+        }
+
+        QMutexLocker locker(&m_state->mutex);
+        m_state->running.remove(m_contact);
+    }
+
+private:
+    SeqState *m_state;
+    QString m_contact;
+    int m_seq;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Waits for the gate (if any), then releases done (if any). Counts runs and deletions
+
+class GateJob : public CA::ContactScheduler::Job
+{
+public:
+    GateJob(QSemaphore *gate, QSemaphore *done, QAtomicInt *runs = 0, QAtomicInt *dels = 0)
+        : m_gate(gate), m_done(done), m_runs(runs), m_dels(dels) { }
+
+    ~GateJob()
+    {
+        if (m_dels) {
+            m_dels->ref();
+        }
+    }
+
+    void run()
+    {
+        if (m_gate) {
+            m_gate->acquire();
+        }
+        if (m_runs) {
+            m_runs->ref();
+        }
+        if (m_done) {
+            m_done->release();
+        }
+    }
+
+private:
+    QSemaphore *m_gate;
+    QSemaphore *m_done;
+    QAtomicInt *m_runs;
+    QAtomicInt *m_dels;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Waits for the gate (if any), then appends its name to the log
+
+struct TaskLog
+{
+    QMutex mutex;
+    QStringList names;
+};
+
+class LogTask : public QRunnable
+{
+public:
+    LogTask(TaskLog *log, const QString &name, QSemaphore *gate = 0)
+        : m_log(log), m_name(name), m_gate(gate) { }
+
+    void run()
+    {
+        if (m_gate) {
+            m_gate->acquire();
+        }
+
+        QMutexLocker locker(&m_log->mutex);
+        m_log->names.append(m_name);
+    }
+
+private:
+    TaskLog *m_log;
+    QString m_name;
+    QSemaphore *m_gate;
+};
+
+int square(int n)
+{
+    return n*n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline QString contactName(int i)
+{
+    return QString("user%1@chat.example.com").arg(i);
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// ContactSchedulerTest
+//--------------------------------------------------------------------------------------------------
+
+class ContactSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    ContactSchedulerTest() { }
+
+private Q_SLOTS:
+    void testOrderPerContact_data();
+    void testOrderPerContact();
+    void testWorkStealing();
+    void testBackpressure();
+    void testStopDiscardsPending();
+    void testSchedulingBenchmark();
+    void testContactRing();
+    void testAdmissionControl();
+    void testTaskScheduler();
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testOrderPerContact_data()
+{
+    QTest::addColumn<int>("workers");
+    QTest::addColumn<int>("contacts");
+    QTest::addColumn<int>("jobs");
+
+    QTest::newRow("1 worker")   << 1 << 10  << 50;
+    QTest::newRow("4 workers")  << 4 << 300 << 20;
+    QTest::newRow("8 workers")  << 8 << 3   << 500;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testOrderPerContact()
+{
+    QFETCH(int, workers);
+    QFETCH(int, contacts);
+    QFETCH(int, jobs);
+
+    SeqState state;
+    CA::ContactScheduler scheduler(workers);
+
+    QCOMPARE(scheduler.workerCount(), workers);
+
+    // Interleave contacts as messages arrive from a busy roster
+    for (int j = 0; j < jobs; ++j) {
+        for (int c = 0; c < contacts; ++c) {
+            QVERIFY(scheduler.schedule(contactName(c), new SeqJob(&state, contactName(c), j)));
+        }
+    }
+
+    scheduler.waitForDone();
+
+    QCOMPARE(scheduler.pending(), 0);
+    QCOMPARE(state.errors, 0);
+    QCOMPARE(state.next.size(), contacts);
+
+    foreach (int next, state.next) {
+        QCOMPARE(next, jobs);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testWorkStealing()
+{
+    const int CONTACTS = 50;
+
+    QSemaphore gate;
+    QSemaphore done;
+    CA::ContactScheduler scheduler(2);
+
+    // Block one worker. Contacts in its deque must be stolen by the other worker
+    QVERIFY(scheduler.schedule(contactName(0), new GateJob(&gate, &done)));
+
+    for (int c = 1; c < CONTACTS; ++c) {
+        QVERIFY(scheduler.schedule(contactName(c), new GateJob(0, &done)));
+    }
+
+    QVERIFY(done.tryAcquire(CONTACTS - 1, TIMEOUT));
+    QCOMPARE(scheduler.pending(), 1);
+
+    gate.release();
+
+    QVERIFY(done.tryAcquire(1, TIMEOUT));
+    scheduler.waitForDone();
+    QCOMPARE(scheduler.pending(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testBackpressure()
+{
+    const int MAX_PENDING = 5;
+
+    QSemaphore gate;
+    QAtomicInt dels(0);
+    CA::ContactScheduler scheduler(1, MAX_PENDING);
+
+    QVERIFY(scheduler.schedule(contactName(0), new GateJob(&gate, 0, 0, &dels)));
+
+    for (int i = 1; i < MAX_PENDING; ++i) {
+        QVERIFY(scheduler.schedule(contactName(i % 2), new GateJob(0, 0, 0, &dels)));
+    }
+
+    QCOMPARE(scheduler.pending(), MAX_PENDING);
+
+    // Rejected jobs are deleted
+    QVERIFY(!scheduler.schedule(contactName(0), new GateJob(0, 0, 0, &dels)));
+    QVERIFY(!scheduler.schedule(contactName(9), new GateJob(0, 0, 0, &dels)));
+    QCOMPARE((int)dels, 2);
+    QCOMPARE(scheduler.pending(), MAX_PENDING);
+
+    gate.release();
+    scheduler.waitForDone();
+
+    QCOMPARE(scheduler.pending(), 0);
+    QCOMPARE((int)dels, MAX_PENDING + 2);
+    QVERIFY(scheduler.schedule(contactName(0), new GateJob(0, 0, 0, &dels)));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testStopDiscardsPending()
+{
+    const int JOBS = 10;
+
+    QSemaphore gate;
+    QSemaphore started;
+    QAtomicInt runs(0);
+    QAtomicInt dels(0);
+    CA::ContactScheduler scheduler(1);
+
+    QVERIFY(scheduler.schedule(contactName(0), new GateJob(0, &started)));
+    QVERIFY(scheduler.schedule(contactName(0), new GateJob(&gate, 0)));
+
+    for (int i = 0; i < JOBS; ++i) {
+        QVERIFY(scheduler.schedule(contactName(i % 3), new GateJob(0, 0, &runs, &dels)));
+    }
+
+    QVERIFY(started.tryAcquire(1, TIMEOUT));
+
+    gate.release();
+    scheduler.stop();
+
+    // Every job either ran or was discarded, and all of them were deleted
+    QCOMPARE(scheduler.pending(), 0);
+    QCOMPARE((int)dels, JOBS);
+    QVERIFY((int)runs <= JOBS);
+    QVERIFY(!scheduler.schedule(contactName(0), new GateJob(0, 0)));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testSchedulingBenchmark()
+{
+    const int CONTACTS = 500;
+    const int JOBS = 10;
+
+    QStringList contacts;
+    for (int c = 0; c < CONTACTS; ++c) {
+        contacts.append(contactName(c));
+    }
+
+    CA::ContactScheduler scheduler;
+
+    QBENCHMARK {
+        SeqState state;
+
+        for (int j = 0; j < JOBS; ++j) {
+            foreach (const QString &contact, contacts) {
+                scheduler.schedule(contact, new SeqJob(&state, contact, j));
+            }
+        }
+
+        scheduler.waitForDone();
+
+        QCOMPARE(state.errors, 0);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testContactRing()
+{
+    const int CONTACTS = 10000;
+    const int SHARDS = 4;
+
+    CA::ContactRing single;
+    CA::ContactRing ring(SHARDS);
+    CA::ContactRing grown(SHARDS + 1);
+
+    QCOMPARE(single.shardCount(), 1);
+    QCOMPARE(ring.shardCount(), SHARDS);
+
+    QVector<int> load(SHARDS, 0);
+    int moved = 0;
+
+    for (int i = 0; i < CONTACTS; ++i) {
+        QString contact = contactName(i);
+        int shard = ring.shard(contact);
+
+        QCOMPARE(single.shard(contact), 0);
+        QVERIFY(shard >= 0 && shard < SHARDS);
+        QCOMPARE(ring.shard(contact.toUpper()), shard);
+        QCOMPARE(CA::ContactRing(SHARDS).shard(contact), shard);
+
+        ++load[shard];
+
+        // Contacts only move to the new shard
+        int newShard = grown.shard(contact);
+        if (newShard != shard) {
+            QCOMPARE(newShard, SHARDS);
+            ++moved;
+        }
+    }
+
+    foreach (int n, load) {
+        QVERIFY(n > CONTACTS/SHARDS/2 && n < 2*CONTACTS/SHARDS);
+    }
+
+    QVERIFY(moved > 0 && moved < 2*CONTACTS/(SHARDS + 1));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testAdmissionControl()
+{
+    CA::AdmissionControl ac;
+    ac.setRate(1.0, 3);
+    ac.setDuplicateWindow(1000);
+    ac.setMaxLength(10);
+    ac.setShedThreshold(5);
+
+    // Burst, then one message per second
+    QCOMPARE(ac.admit("a", "m1", 0, 0), CA::AdmissionControl::Accept);
+    QCOMPARE(ac.admit("a", "m2", 0, 0), CA::AdmissionControl::Accept);
+    QCOMPARE(ac.admit("a", "m3", 0, 0), CA::AdmissionControl::Accept);
+    QCOMPARE(ac.admit("a", "m4", 0, 0), CA::AdmissionControl::Drop);
+    QCOMPARE(ac.admit("b", "m1", 0, 0), CA::AdmissionControl::Accept);
+    QCOMPARE(ac.admit("a", "m5", 0, 500), CA::AdmissionControl::Drop);
+    QCOMPARE(ac.admit("a", "m6", 0, 1000), CA::AdmissionControl::Accept);
+
+    // Duplicates within the window, floods keep it open
+    QCOMPARE(ac.admit("c", "hi", 0, 0), CA::AdmissionControl::Accept);
+    QCOMPARE(ac.admit("c", "hi", 0, 900), CA::AdmissionControl::Drop);
+    QCOMPARE(ac.admit("c", "hi", 0, 1800), CA::AdmissionControl::Drop);
+    QCOMPARE(ac.admit("c", "hi", 0, 2800), CA::AdmissionControl::Accept);
+    QCOMPARE(ac.admit("c", "bye", 0, 2900), CA::AdmissionControl::Accept);
+
+    // Oversized and overload
+    QCOMPARE(ac.admit("d", "0123456789a", 0, 0), CA::AdmissionControl::Degrade);
+    QCOMPARE(ac.admit("d", "short", 4, 0), CA::AdmissionControl::Accept);
+    QCOMPARE(ac.admit("d", "other", 5, 0), CA::AdmissionControl::Degrade);
+
+    QCOMPARE(ac.contactCount(), 4);
+
+    CA::AdmissionControl::Stats stats = ac.stats();
+    QCOMPARE(stats.accepted, 9u);
+    QCOMPARE(stats.rateLimited, 2u);
+    QCOMPARE(stats.duplicates, 2u);
+    QCOMPARE(stats.oversized, 1u);
+    QCOMPARE(stats.shed, 1u);
+
+    ac.resetStats();
+    QCOMPARE(ac.stats().accepted, 0u);
+
+    // No limits
+    CA::AdmissionControl open;
+    open.setRate(0, 0);
+    open.setDuplicateWindow(0);
+    open.setMaxLength(0);
+    open.setShedThreshold(0);
+
+    for (int i = 0; i < 100; ++i) {
+        QCOMPARE(open.admit("a", QString(1000, 'x'), 1000, 0), CA::AdmissionControl::Accept);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ContactSchedulerTest::testTaskScheduler()
+{
+    typedef Cmn::TaskScheduler TS;
+
+    TaskLog log;
+    QSemaphore gate;
+    int owner = 0;
+
+    // Two workers, one reserved for replies
+    TS sched(2, 1);
+    QCOMPARE(sched.threadCount(), 2);
+
+    QTime timer;
+    timer.start();
+
+    sched.start(new LogTask(&log, "bg1", &gate), TS::Background, &owner);
+    while (sched.stats()["background_running"].toInt() == 0 && timer.elapsed() < TIMEOUT) {
+        QTest::qSleep(1);
+    }
+
+    sched.start(new LogTask(&log, "bg2"), TS::Background, &owner);
+    sched.start(new LogTask(&log, "build"), TS::Build);
+    sched.start(new LogTask(&log, "reply"), TS::Reply);
+
+    // The reply does not wait for the blocked background task
+    while (sched.pending(TS::Reply) > 0 && timer.elapsed() < TIMEOUT) {
+        QTest::qSleep(1);
+    }
+    QCOMPARE(sched.pending(TS::Reply), 0);
+    QCOMPARE(sched.pending(TS::Build), 1);
+    QCOMPARE(sched.pending(TS::Background), 2);
+
+    // Then the build goes before the queued background task
+    gate.release();
+    sched.waitForDone(&owner);
+
+    QCOMPARE(log.names, QStringList() << "reply" << "bg1" << "build" << "bg2");
+
+    QFuture<int> future = sched.run(TS::Preview, square, 7);
+    QCOMPARE(future.result(), 49);
+
+    sched.waitForDone();
+
+    QVariantMap stats = sched.stats();
+    QCOMPARE(stats["reply_finished"].toInt(), 1);
+    QCOMPARE(stats["preview_finished"].toInt(), 1);
+    QCOMPARE(stats["build_finished"].toInt(), 1);
+    QCOMPARE(stats["background_finished"].toInt(), 2);
+    QCOMPARE(stats["background_queued"].toInt(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_APPLESS_MAIN(ContactSchedulerTest)
+
+#include "contactschedulertest.moc"
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Botmaster.
+ *
+ * LVK Botmaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Botmaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Botmaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Conversation replay. Loads a chatbot file, replays the messages of one or more recorded chat
+// histories with their original senders and writes one CSV row with the build time and the
+// response latencies. Every entry whose matched rule differs from the recorded one, or whose
+// response differs while matching the same rule, is reported as a diff. Evasive responses are
+// not compared.
+//
+// Usage: conversationReplay [options] CHATBOT_FILE HISTORY_FILE...
+//
+//   --diffs FILE         Writes the diffs to FILE as CSV. Default: stderr
+//   --output FILE        Appends the results to FILE instead of writing them to stdout
+//
+// Returns 0 if there are no diffs, 2 if there are diffs and 1 on errors.
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QVector>
+#include <QFile>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+#include "back-end/appfacade.h"
+#include "common/conversation.h"
+#include "common/conversationreader.h"
+#include "common/globalstrings.h"
+#include "common/csvrow.h"
+
+#include <stdio.h>
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Options
+{
+    QString chatbotFile;
+    QStringList historyFiles;
+    QString diffs;
+    QString output;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+struct Result
+{
+    Result() : buildMs(0), entries(0), throughput(0), p50Us(0), p90Us(0), p99Us(0), maxUs(0),
+        ruleDiffs(0), responseDiffs(0) { }
+
+    qint64 buildMs;
+    int entries;
+    double throughput;
+    double p50Us;
+    double p90Us;
+    double p99Us;
+    double maxUs;
+    int ruleDiffs;
+    int responseDiffs;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// The engine logs every response
+void quietMsgHandler(QtMsgType type, const char *msg)
+{
+    if (type != QtDebugMsg) {
+        fprintf(stderr, "%s\n", msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// History entries store "Full Name <username>" if the contact has a full name
+QString username(const QString &from)
+{
+    if (from.contains(USERNAME_START_TOKEN)) {
+        QString username = from.split(USERNAME_START_TOKEN).at(1).trimmed();
+        username.remove(USERNAME_END_TOKEN);
+        return username;
+    }
+
+    return from;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+double percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    return sorted[qMin(sorted.size() - 1, (int)(p*sorted.size()))];
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Loads the chatbot file and waits until its NLP engine is built
+bool load(BE::AppFacade &facade, const QString &filename)
+{
+    if (!facade.load(filename)) {
+        return false;
+    }
+
+    if (!facade.isNlpEngineReady()) {
+        QEventLoop loop;
+        QObject::connect(&facade, SIGNAL(nlpEngineReady()), &loop, SLOT(quit()));
+        loop.exec();
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool replay(BE::AppFacade &facade, const QString &filename, QVector<qint64> &latencies,
+            Result &r, QTextStream &diffs)
+{
+    Cmn::Conversation conv;
+
+    if (!Cmn::ConversationReader(filename).read(&conv)) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    int line = 0;
+
+    foreach (const Cmn::Conversation::Entry &entry, conv.entries()) {
+        ++line;
+
+        BE::AppFacade::MatchList matches;
+
+        timer.start();
+        QString response = facade.getResponse(entry.msg, username(entry.from), matches);
+        latencies.append(timer.nsecsElapsed());
+
+        quint64 ruleId = !matches.isEmpty() ? matches.first().first : 0;
+        bool matched = !matches.isEmpty() && !response.isEmpty();
+
+        QString kind;
+
+        if (matched != entry.match || (matched && ruleId != entry.ruleId)) {
+            kind = "rule";
+            ++r.ruleDiffs;
+        } else if (matched && response != entry.response) {
+            kind = "response";
+            ++r.responseDiffs;
+        } else {
+            continue;
+        }
+
+        Cmn::CsvRow row;
+        row.append(filename);
+        row.append(QString::number(line));
+        row.append(kind);
+        row.append(entry.from);
+        row.append(entry.msg);
+        row.append(entry.match ? QString::number(entry.ruleId) : QString());
+        row.append(matched ? QString::number(ruleId) : QString());
+        row.append(entry.response);
+        row.append(response);
+
+        diffs << row.toString() << "\n";
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool parseOptions(const QStringList &args, Options &opt)
+{
+    QStringList files;
+
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+
+        if (!arg.startsWith("--")) {
+            files.append(arg);
+            continue;
+        }
+
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+
+        const QString &value = args[++i];
+
+        if (arg == "--diffs") {
+            opt.diffs = value;
+        } else if (arg == "--output") {
+            opt.output = value;
+        } else {
+            return false;
+        }
+    }
+
+    if (files.size() < 2) {
+        return false;
+    }
+
+    opt.chatbotFile = files.takeFirst();
+    opt.historyFiles = files;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool openFile(QFile &file, const QString &filename, FILE *defaultFile, bool append)
+{
+    if (filename.isEmpty()) {
+        return file.open(defaultFile, QFile::WriteOnly);
+    }
+
+    file.setFileName(filename);
+
+    return file.open(append ? QFile::WriteOnly | QFile::Append : QFile::WriteOnly);
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInstallMsgHandler(quietMsgHandler);
+
+    Options opt;
+
+    if (!parseOptions(app.arguments(), opt)) {
+        fprintf(stderr, "Usage: conversationReplay [--diffs FILE] [--output FILE] "
+                        "CHATBOT_FILE HISTORY_FILE...\n");
+        return 1;
+    }
+
+    QFile outFile;
+    bool header = opt.output.isEmpty() || !QFile::exists(opt.output)
+            || QFile(opt.output).size() == 0;
+
+    if (!openFile(outFile, opt.output, stdout, true)) {
+        fprintf(stderr, "Cannot open %s\n", qPrintable(opt.output));
+        return 1;
+    }
+
+    QFile diffsFile;
+
+    if (!openFile(diffsFile, opt.diffs, stderr, false)) {
+        fprintf(stderr, "Cannot open %s\n", qPrintable(opt.diffs));
+        return 1;
+    }
+
+    QTextStream out(&outFile);
+    QTextStream diffs(&diffsFile);
+
+    diffs << "history,line,diff,from,message,recorded_rule,replayed_rule,recorded_response,"
+             "replayed_response\n";
+
+    BE::AppFacade facade;
+    Result r;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!load(facade, opt.chatbotFile)) {
+        fprintf(stderr, "Cannot load chatbot %s\n", qPrintable(opt.chatbotFile));
+        return 1;
+    }
+
+    r.buildMs = timer.elapsed();
+
+    QVector<qint64> latencies;
+
+    foreach (const QString &filename, opt.historyFiles) {
+        if (!replay(facade, filename, latencies, r, diffs)) {
+            fprintf(stderr, "Cannot read conversation %s\n", qPrintable(filename));
+            return 1;
+        }
+    }
+
+    diffs.flush();
+
+    qint64 totalNs = 0;
+    foreach (qint64 ns, latencies) {
+        totalNs += ns;
+    }
+
+    qSort(latencies);
+
+    r.entries = latencies.size();
+
+    if (!latencies.isEmpty()) {
+        r.throughput = totalNs > 0 ? latencies.size()/(totalNs/1e9) : 0;
+        r.p50Us = percentile(latencies, 0.50)/1e3;
+        r.p90Us = percentile(latencies, 0.90)/1e3;
+        r.p99Us = percentile(latencies, 0.99)/1e3;
+        r.maxUs = latencies.last()/1e3;
+    }
+
+    if (header) {
+        out << "chatbot,histories,entries,build_ms,throughput_per_sec,p50_us,p90_us,p99_us,"
+               "max_us,rule_diffs,response_diffs\n";
+    }
+
+    out << opt.chatbotFile << "," << opt.historyFiles.size() << "," << r.entries << ","
+        << r.buildMs << "," << QString::number(r.throughput, 'f', 1) << ","
+        << QString::number(r.p50Us, 'f', 1) << ","
+        << QString::number(r.p90Us, 'f', 1) << ","
+        << QString::number(r.p99Us, 'f', 1) << ","
+        << QString::number(r.maxUs, 'f', 1) << ","
+        << r.ruleDiffs << "," << r.responseDiffs << "\n";
+    out.flush();
+
+    facade.close();
+
+    return r.ruleDiffs + r.responseDiffs > 0 ? 2 : 0;
+}
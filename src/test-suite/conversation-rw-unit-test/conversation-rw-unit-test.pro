@@ -21,7 +21,11 @@ HEADERS += \
     ../../chatbot/common/conversation.h \
     ../../chatbot/common/conversationreader.h \
     ../../chatbot/common/conversationwriter.h \
+    ../../chatbot/common/conversationlog.h \
+    ../../chatbot/common/journal.h \
+    ../../chatbot/common/settings.h \
     ../../chatbot/common/csvrow.h \
+    ../../chatbot/common/csvparser.h \
     ../../chatbot/common/csvdocument.h
 
 
@@ -30,10 +34,20 @@ SOURCES += \
     ../../chatbot/common/conversation.cpp \
     ../../chatbot/common/conversationreader.cpp \
     ../../chatbot/common/conversationwriter.cpp \
+    ../../chatbot/common/conversationlog.cpp \
+    ../../chatbot/common/journal.cpp \
+    ../../chatbot/common/settings.cpp \
     ../../chatbot/common/csvrow.cpp \
+    ../../chatbot/common/csvparser.cpp \
     ../../chatbot/common/csvdocument.cpp
 
 
+include(../../chatbot/common/parquet.pri)
+
+# The Parquet writer compresses pages with zlib
+INCLUDEPATH += ../../third-party/zlib/include
+LIBS += -lz
+
 DEFINES += SRCDIR=\\\"$$PWD/\\\"
 
 
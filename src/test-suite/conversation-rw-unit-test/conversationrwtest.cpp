@@ -2,15 +2,52 @@
 #include <QtTest/QtTest>
 
 #include <QFile>
+#include <QFileInfo>
 #include <QString>
 #include <QList>
 
 #include "common/conversation.h"
 #include "common/conversationreader.h"
 #include "common/conversationwriter.h"
+#include "common/conversationlog.h"
+#include "common/conversationparquetwriter.h"
+#include "common/journal.h"
 
 typedef QList<Lvk::Cmn::Conversation::Entry> EntryList;
 
+#define BENCHMARK_ENTRIES   20000
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Makes a conversation with \a n entries, 4 contacts and 100 entries per day
+Lvk::Cmn::Conversation makeConversation(int n)
+{
+    QDateTime start(QDate(2012, 10, 1), QTime(10, 0, 0));
+
+    Lvk::Cmn::Conversation conv;
+
+    for (int i = 0; i < n; ++i) {
+        Lvk::Cmn::Conversation::Entry entry;
+        entry.dateTime = start.addDays(i / 100).addSecs(i % 100);
+        entry.from     = QString("user %1").arg(i % 4);
+        entry.to       = "chatbot";
+        entry.msg      = QString("Message number %1, how are you?").arg(i);
+        entry.response = QString("Response number %1").arg(i);
+        entry.match    = i % 3 != 0;
+        entry.ruleId   = i % 3 != 0 ? i : 0;
+        conv.append(entry);
+    }
+
+    return conv;
+}
+
+} // namespace
+
 Q_DECLARE_METATYPE(Lvk::Cmn::Conversation)
 Q_DECLARE_METATYPE(Lvk::Cmn::Conversation::Entry)
 Q_DECLARE_METATYPE(EntryList)
@@ -31,6 +68,14 @@ private Q_SLOTS:
     void testReadWriteConversation();
     void testReadWriteConversationEntry_data();
     void testReadWriteConversationEntry();
+    void testReadConversationWindow();
+    void testReadLongEntry();
+    void testJournal();
+    void testConversationLog();
+    void testConversationLogImportCsv();
+    void testParquetWriter();
+    void testBenchmarkCsvLoad();
+    void testBenchmarkLogLoad();
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -223,6 +268,375 @@ void ConversationRwTest::testReadWriteConversationEntry()
 
 //--------------------------------------------------------------------------------------------------
 
+void ConversationRwTest::testReadConversationWindow()
+{
+    const QString CONV_FILENAME = "chat_conv_test3.txt";
+
+    QFile::remove(CONV_FILENAME);
+
+    QDateTime start(QDate(2012, 10, 1), QTime(10, 0, 0));
+
+    Lvk::Cmn::Conversation conv;
+
+    for (int i = 0; i < 10; ++i) {
+        Lvk::Cmn::Conversation::Entry entry;
+        entry.dateTime = start.addDays(i);
+        entry.from     = "user A";
+        entry.to       = "user B";
+        entry.msg      = QString("Message %1").arg(i);
+        entry.response = QString("Response %1").arg(i);
+        entry.match    = true;
+        conv.append(entry);
+    }
+
+    Lvk::Cmn::ConversationWriter *writer = new Lvk::Cmn::ConversationWriter(CONV_FILENAME);
+    QVERIFY(writer->write(conv));
+    delete writer;
+
+    Lvk::Cmn::Conversation convRead;
+
+    // Bounded window
+    Lvk::Cmn::ConversationReader reader1(CONV_FILENAME);
+    QVERIFY(reader1.read(&convRead, start.addDays(3), start.addDays(6)));
+    QCOMPARE(convRead.entries(), conv.entries().mid(3, 3));
+
+    // Only lower bound
+    Lvk::Cmn::ConversationReader reader2(CONV_FILENAME);
+    QVERIFY(reader2.read(&convRead, start.addDays(7), QDateTime()));
+    QCOMPARE(convRead.entries(), conv.entries().mid(7));
+    QVERIFY(reader2.atEnd());
+
+    // Only upper bound
+    Lvk::Cmn::ConversationReader reader3(CONV_FILENAME);
+    QVERIFY(reader3.read(&convRead, QDateTime(), start.addDays(2)));
+    QCOMPARE(convRead.entries(), conv.entries().mid(0, 2));
+
+    // Empty window
+    Lvk::Cmn::ConversationReader reader4(CONV_FILENAME);
+    QVERIFY(reader4.read(&convRead, start.addDays(20), QDateTime()));
+    QCOMPARE(convRead.entries().size(), 0);
+
+    QFile::remove(CONV_FILENAME);
+
+    // In-memory ranges must match the ranges read from file
+    QCOMPARE(conv.range(start.addDays(3), start.addDays(6)).entries(), conv.entries().mid(3, 3));
+    QCOMPARE(conv.range(start.addDays(7), QDateTime()).entries(), conv.entries().mid(7));
+    QCOMPARE(conv.range(QDateTime(), start.addDays(2)).entries(), conv.entries().mid(0, 2));
+    QCOMPARE(conv.range(start.addDays(20), QDateTime()).size(), 0);
+    QVERIFY(conv.lowerBound(start.addDays(20)) == conv.end());
+    QVERIFY(conv.lowerBound(start.addSecs(1)) == conv.begin() + 1);
+
+    conv.removeFirst(4);
+    QCOMPARE(conv.size(), 6);
+    QCOMPARE(conv.entries().first().dateTime, start.addDays(4));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ConversationRwTest::testReadLongEntry()
+{
+    const QString CONV_FILENAME = "chat_conv_test4.txt";
+
+    QFile::remove(CONV_FILENAME);
+
+    // Entries longer than the reader chunk size must not be truncated
+    Lvk::Cmn::Conversation::Entry entry1;
+    entry1.dateTime = QDateTime(QDate(2012, 10, 1), QTime(10, 0, 0));
+    entry1.from     = "user A";
+    entry1.to       = "user B";
+    entry1.msg      = QString(100*1024, QChar('a'));
+    entry1.response = QString(200*1024, QChar('b'));
+    entry1.match    = true;
+
+    Lvk::Cmn::Conversation::Entry entry2 = entry1;
+    entry2.msg      = "Short";
+
+    Lvk::Cmn::ConversationWriter *writer = new Lvk::Cmn::ConversationWriter(CONV_FILENAME);
+    QVERIFY(writer->write(entry1));
+    QVERIFY(writer->write(entry2));
+    delete writer;
+
+    Lvk::Cmn::Conversation::Entry entryRead;
+    Lvk::Cmn::ConversationReader reader(CONV_FILENAME);
+
+    QVERIFY(reader.read(&entryRead));
+    QCOMPARE(entryRead, entry1);
+    QVERIFY(reader.read(&entryRead));
+    QCOMPARE(entryRead, entry2);
+    QVERIFY(reader.atEnd());
+    QVERIFY(!reader.read(&entryRead));
+
+    QFile::remove(CONV_FILENAME);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ConversationRwTest::testJournal()
+{
+    const QString FILENAME = "journal_test1.txt";
+
+    QFile::remove(FILENAME);
+
+    Lvk::Cmn::Journal *journal = Lvk::Cmn::Journal::journal();
+    journal->setMaxDelay(60*1000);
+    journal->setMaxEntries(3);
+
+    QFile file(FILENAME);
+    QVERIFY(file.open(QFile::Append));
+
+    // Entries are written in batches
+    journal->write(&file, "one\n");
+    journal->write(&file, "two\n");
+    QCOMPARE(QFileInfo(FILENAME).size(), (qint64)0);
+
+    journal->write(&file, "three\n");
+    QCOMPARE(QFileInfo(FILENAME).size(), (qint64)14);
+
+    // Pending entries are written by flush() and drain()
+    journal->write(&file, "four\n");
+    QVERIFY(journal->flush(&file));
+    QCOMPARE(QFileInfo(FILENAME).size(), (qint64)19);
+
+    journal->write(&file, "five\n");
+    QVERIFY(journal->drain());
+    QCOMPARE(QFileInfo(FILENAME).size(), (qint64)24);
+
+    // Every entry is written if sync policy is EveryEntrySync
+    journal->setSyncPolicy(Lvk::Cmn::Journal::EveryEntrySync);
+    journal->write(&file, "six\n");
+    QCOMPARE(QFileInfo(FILENAME).size(), (qint64)28);
+
+    journal->setSyncPolicy(Lvk::Cmn::Journal::NoSync);
+    journal->setMaxDelay(0);
+
+    file.close();
+
+    QFile::remove(FILENAME);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ConversationRwTest::testConversationLog()
+{
+    const QString LOG_FILENAME = "chat_conv_test5.log";
+
+    QFile::remove(LOG_FILENAME);
+    QFile::remove(LOG_FILENAME + ".idx");
+
+    Lvk::Cmn::Conversation conv = makeConversation(300);
+
+    Lvk::Cmn::Conversation day1;
+    const QDate date1 = conv.entries()[100].dateTime.date();
+
+    foreach (const Lvk::Cmn::Conversation::Entry &entry, conv.entries()) {
+        if (entry.dateTime.date() == date1 && entry.from == "user 1") {
+            day1.append(entry);
+        }
+    }
+
+    // Write the first half, then reopen and write the second half
+    {
+        Lvk::Cmn::ConversationLog log(LOG_FILENAME);
+        QVERIFY(log.isOpen());
+        for (int i = 0; i < 150; ++i) {
+            QVERIFY(log.append(conv.entries()[i]));
+        }
+    }
+
+    // Keep an outdated index file, it must be updated on open
+    QFile::remove(LOG_FILENAME + ".idx.old");
+    QVERIFY(QFile::copy(LOG_FILENAME + ".idx", LOG_FILENAME + ".idx.old"));
+
+    {
+        Lvk::Cmn::ConversationLog log(LOG_FILENAME);
+        QVERIFY(log.isOpen());
+        for (int i = 150; i < conv.size(); ++i) {
+            QVERIFY(log.append(conv.entries()[i]));
+        }
+    }
+
+    Lvk::Cmn::Conversation convRead;
+
+    for (int i = 0; i < 3; ++i) {
+        if (i == 1) {
+            QFile::remove(LOG_FILENAME + ".idx");             // Missing index
+        } else if (i == 2) {
+            QFile::remove(LOG_FILENAME + ".idx");             // Outdated index
+            QFile::rename(LOG_FILENAME + ".idx.old", LOG_FILENAME + ".idx");
+        }
+
+        Lvk::Cmn::ConversationLog log(LOG_FILENAME);
+        QVERIFY(log.isOpen());
+
+        QVERIFY(log.read(&convRead));
+        QCOMPARE(convRead, conv);
+
+        QVERIFY(log.read(&convRead, date1, "user 1"));
+        QCOMPARE(convRead, day1);
+
+        QVERIFY(log.read(&convRead, date1, "nobody"));
+        QVERIFY(convRead.isEmpty());
+
+        QCOMPARE(log.dateContacts().size(), 3*4);
+        QCOMPARE(log.dateContacts().first(),
+                 Lvk::Cmn::ConversationLog::DateContact(conv.entries()[0].dateTime.date(),
+                                                         "user 0"));
+    }
+
+    QFile::remove(LOG_FILENAME + ".idx.old");
+
+    // Incomplete records are discarded
+    {
+        QFile f(LOG_FILENAME);
+        QVERIFY(f.open(QFile::Append));
+        f.write("\0\0\1\0abc");
+    }
+    {
+        Lvk::Cmn::ConversationLog log(LOG_FILENAME);
+        QVERIFY(log.read(&convRead));
+        QCOMPARE(convRead, conv);
+    }
+
+    QFile::remove(LOG_FILENAME);
+    QFile::remove(LOG_FILENAME + ".idx");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ConversationRwTest::testConversationLogImportCsv()
+{
+    const QString CONV_FILENAME = "chat_conv_test6.txt";
+    const QString LOG_FILENAME = "chat_conv_test6.log";
+
+    QFile::remove(CONV_FILENAME);
+    QFile::remove(LOG_FILENAME);
+    QFile::remove(LOG_FILENAME + ".idx");
+
+    Lvk::Cmn::Conversation conv = makeConversation(250);
+
+    Lvk::Cmn::ConversationWriter *writer = new Lvk::Cmn::ConversationWriter(CONV_FILENAME);
+    QVERIFY(writer->write(conv));
+    delete writer;
+
+    QVERIFY(Lvk::Cmn::ConversationLog::importCsv(CONV_FILENAME, LOG_FILENAME));
+    QVERIFY(!Lvk::Cmn::ConversationLog::importCsv("missing_file.txt", LOG_FILENAME));
+
+    Lvk::Cmn::Conversation csvConv;
+    Lvk::Cmn::ConversationReader reader(CONV_FILENAME);
+    QVERIFY(reader.read(&csvConv));
+
+    Lvk::Cmn::Conversation convRead;
+    Lvk::Cmn::ConversationLog log(LOG_FILENAME);
+    QVERIFY(log.read(&convRead));
+    QCOMPARE(convRead, csvConv);
+
+    QFile::remove(CONV_FILENAME);
+    QFile::remove(LOG_FILENAME);
+    QFile::remove(LOG_FILENAME + ".idx");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ConversationRwTest::testParquetWriter()
+{
+    const QString FILENAME = "chat_conv_test7.parquet";
+
+    QFile::remove(FILENAME);
+
+    Lvk::Cmn::Conversation conv = makeConversation(1000);
+
+    {
+        Lvk::Cmn::ConversationParquetWriter writer(FILENAME);
+        writer.setRowGroupSize(300);
+        QVERIFY(writer.write(conv));
+        QVERIFY(writer.write(Lvk::Cmn::Conversation::Entry())); // Null entries are skipped
+        QVERIFY(writer.close());
+        QCOMPARE(writer.entryCount(), (qint64)1000);
+
+        // Entries cannot be written once the footer is written
+        QVERIFY(!writer.write(conv.entries().first()));
+    }
+
+    QFile file(FILENAME);
+    QVERIFY(file.open(QFile::ReadOnly));
+    QByteArray data = file.readAll();
+    file.close();
+
+    QVERIFY(data.startsWith("PAR1"));
+    QVERIFY(data.endsWith("PAR1"));
+
+    // Footer: metadata, metadata length (little endian) and magic number
+    const uchar *len = reinterpret_cast<const uchar *>(data.constData() + data.size() - 8);
+    int metaSize = len[0] | (len[1] << 8) | (len[2] << 16) | (len[3] << 24);
+    QVERIFY(metaSize > 0 && metaSize < data.size() - 12);
+
+    QByteArray meta = data.mid(data.size() - 8 - metaSize, metaSize);
+    QVERIFY(meta.contains("date_time"));
+    QVERIFY(meta.contains("rule_id"));
+
+    // Dictionary encoding and compression make it much smaller than the CSV
+    QVERIFY(data.size() < 1000*30);
+
+    QFile::remove(FILENAME);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ConversationRwTest::testBenchmarkCsvLoad()
+{
+    const QString CONV_FILENAME = "chat_conv_bench.txt";
+
+    QFile::remove(CONV_FILENAME);
+
+    Lvk::Cmn::ConversationWriter *writer = new Lvk::Cmn::ConversationWriter(CONV_FILENAME);
+    QVERIFY(writer->write(makeConversation(BENCHMARK_ENTRIES)));
+    delete writer;
+
+    Lvk::Cmn::Conversation convRead;
+
+    QBENCHMARK {
+        Lvk::Cmn::ConversationReader reader(CONV_FILENAME);
+        reader.read(&convRead);
+    }
+
+    QCOMPARE(convRead.size(), BENCHMARK_ENTRIES);
+
+    QFile::remove(CONV_FILENAME);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ConversationRwTest::testBenchmarkLogLoad()
+{
+    const QString LOG_FILENAME = "chat_conv_bench.log";
+
+    QFile::remove(LOG_FILENAME);
+    QFile::remove(LOG_FILENAME + ".idx");
+
+    Lvk::Cmn::Conversation conv = makeConversation(BENCHMARK_ENTRIES);
+
+    {
+        Lvk::Cmn::ConversationLog log(LOG_FILENAME);
+        foreach (const Lvk::Cmn::Conversation::Entry &entry, conv.entries()) {
+            QVERIFY(log.append(entry));
+        }
+    }
+
+    Lvk::Cmn::Conversation convRead;
+
+    QBENCHMARK {
+        Lvk::Cmn::ConversationLog log(LOG_FILENAME);
+        log.read(&convRead);
+    }
+
+    QCOMPARE(convRead.size(), BENCHMARK_ENTRIES);
+
+    QFile::remove(LOG_FILENAME);
+    QFile::remove(LOG_FILENAME + ".idx");
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(ConversationRwTest)
 
 #include "conversationrwtest.moc"
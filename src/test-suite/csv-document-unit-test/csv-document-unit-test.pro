@@ -21,12 +21,14 @@ INCLUDEPATH += \
 
 HEADERS += \
     ../../chatbot/common/csvrow.h \
+    ../../chatbot/common/csvparser.h \
     ../../chatbot/common/csvdocument.h \
 
 
 SOURCES += \
     csvdocumenttest.cpp\
     ../../chatbot/common/csvrow.cpp \
+    ../../chatbot/common/csvparser.cpp \
     ../../chatbot/common/csvdocument.cpp \
 
 
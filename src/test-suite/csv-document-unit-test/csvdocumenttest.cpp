@@ -3,6 +3,7 @@
 
 #include "common/csvrow.h"
 #include "common/csvdocument.h"
+#include "common/csvparser.h"
 
 Q_DECLARE_METATYPE(Lvk::Cmn::CsvRow)
 Q_DECLARE_METATYPE(Lvk::Cmn::CsvDocument)
@@ -22,6 +23,10 @@ private Q_SLOTS:
 
     void testToFromStrings_data();
     void testToFromStrings();
+    void testParseRow_data();
+    void testParseRow();
+    void testParserHandler();
+    void testBenchmarkParse();
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -113,6 +118,113 @@ void CsvDocumentTest::testToFromStrings()
 
 //--------------------------------------------------------------------------------------------------
 
+void CsvDocumentTest::testParseRow_data()
+{
+    QTest::addColumn<QString>("rowString");
+    QTest::addColumn<QStringList>("expectedCells");
+
+    QTest::newRow("empty")          << ""          << QStringList();
+    QTest::newRow("spaces")         << "   "       << QStringList();
+    QTest::newRow("one cell")       << CELL_1      << (QStringList() << CELL_1);
+    QTest::newRow("empty cells")    << ",,"        << (QStringList() << "" << "" << "");
+    QTest::newRow("trailing comma") << "a,"        << (QStringList() << "a" << "");
+    QTest::newRow("quoted")         << CELL_7      << (QStringList() << CELL_7u);
+    QTest::newRow("escaped quotes") << CELL_9      << (QStringList() << CELL_9u);
+    QTest::newRow("quoted empty")   << "\"\",a"    << (QStringList() << "" << "a");
+    QTest::newRow("quote inside")   << "a\"b,c"    << (QStringList() << "a\"b" << "c");
+    QTest::newRow("embedded comma") << "a,\"b,c\",d" << (QStringList() << "a" << "b,c" << "d");
+
+    // Malformed quoted cells
+    QTest::newRow("no end quote")   << "\"a,b"     << (QStringList() << "\"a,b");
+    QTest::newRow("single quote")   << "\",a"      << (QStringList() << "\"" << "a");
+    QTest::newRow("text after end") << "\"a\"b,c"  << (QStringList() << "\"a\"b,c");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void CsvDocumentTest::testParseRow()
+{
+    QFETCH(QString, rowString);
+    QFETCH(QStringList, expectedCells);
+
+    QVector<QStringRef> cells;
+    QString scratch;
+
+    Lvk::Cmn::CsvParser::parseRow(rowString, 0, rowString.size(), cells, scratch);
+
+    QStringList cellStrings;
+    foreach (const QStringRef &cell, cells) {
+        cellStrings.append(cell.toString());
+    }
+
+    QCOMPARE(cellStrings, expectedCells);
+    QCOMPARE(QStringList(Lvk::Cmn::CsvRow(rowString).cells()), expectedCells);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+class CountHandler : public Lvk::Cmn::CsvParser::Handler
+{
+public:
+    CountHandler(int maxRows) : rows(0), cells(0), maxRows(maxRows) { }
+
+    virtual bool row(const QVector<QStringRef> &c)
+    {
+        ++rows;
+        cells += c.size();
+        return rows < maxRows;
+    }
+
+    int rows;
+    int cells;
+    int maxRows;
+};
+
+} // namespace
+
+void CsvDocumentTest::testParserHandler()
+{
+    QString csvString = CELL_1 COMMA CELL_2 EOL EOL CELL_7 COMMA CELL_9 EOL CELL_3 EOL;
+
+    CountHandler handler1(100);
+    Lvk::Cmn::CsvParser::parse(csvString, handler1);
+    QCOMPARE(handler1.rows, 3);
+    QCOMPARE(handler1.cells, 5);
+
+    // Handler stops parsing
+    CountHandler handler2(2);
+    Lvk::Cmn::CsvParser::parse(csvString, handler2);
+    QCOMPARE(handler2.rows, 2);
+    QCOMPARE(handler2.cells, 4);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void CsvDocumentTest::testBenchmarkParse()
+{
+    QString csvString;
+
+    for (int i = 0; i < 10000; ++i) {
+        csvString += CELL_1 COMMA CELL_4 COMMA CELL_7 COMMA CELL_9 COMMA;
+        csvString += QString::number(i);
+        csvString += EOL;
+    }
+
+    Lvk::Cmn::CsvDocument csvDoc;
+
+    QBENCHMARK {
+        csvDoc = Lvk::Cmn::CsvDocument(csvString);
+    }
+
+    QCOMPARE(csvDoc.rows().size(), 10000);
+    QCOMPARE(csvDoc[9999][3], QString(CELL_9u));
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(CsvDocumentTest)
 
 #include "csvdocumenttest.moc"
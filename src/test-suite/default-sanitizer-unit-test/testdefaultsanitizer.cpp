@@ -47,6 +47,9 @@ private Q_SLOTS:
     void testRemoveDupChars();
     void testAllFlags_data();
     void testAllFlags();
+    void testNonLatin1_data();
+    void testNonLatin1();
+    void testBenchmark();
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -157,6 +160,65 @@ void testDefaultSanitizer::testAllFlags()
 
 //--------------------------------------------------------------------------------------------------
 
+void testDefaultSanitizer::testNonLatin1_data()
+{
+    QTest::addColumn<QString>("input");
+    QTest::addColumn<QString>("expectedOutput");
+
+    QTest::newRow("greek") << QString::fromUtf8("\xce\x91\xce\xb1\xce\xb1\xce\xb2!")
+                           << QString::fromUtf8("\xce\xb1\xce\xb2");
+    QTest::newRow("cyrillic") << QString::fromUtf8("\xd0\x94\xd0\xb0, \xd0\xb4\xd0\xb0")
+                              << QString::fromUtf8("\xd0\xb4\xd0\xb0 \xd0\xb4\xd0\xb0");
+    QTest::newRow("unchanged") << "hola que tal" << "hola que tal";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void testDefaultSanitizer::testNonLatin1()
+{
+    QFETCH(QString, input);
+    QFETCH(QString, expectedOutput);
+
+    unsigned options =
+        Lvk::Nlp::DefaultSanitizer::RemoveDupChars |
+        Lvk::Nlp::DefaultSanitizer::RemoveDiacritic |
+        Lvk::Nlp::DefaultSanitizer::RemovePunctuation |
+        Lvk::Nlp::DefaultSanitizer::LowerCase;
+
+    QString output = Lvk::Nlp::DefaultSanitizer(options).sanitize(input);
+
+    QCOMPARE(output, expectedOutput);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void testDefaultSanitizer::testBenchmark()
+{
+    QFile dataFile(TEST_DATA_FILE);
+
+    if (!dataFile.open(QFile::ReadOnly)) {
+        QFAIL("Cannot open test data file " TEST_DATA_FILE);
+    }
+
+    QStringList inputList = QString::fromUtf8(dataFile.readAll())
+            .split(IO_SPLIT_TOKEN, QString::SkipEmptyParts)[0]
+            .split("\n", QString::SkipEmptyParts);
+
+    Lvk::Nlp::DefaultSanitizer sanitizer(0xff);
+
+    int chars = 0;
+
+    QBENCHMARK {
+        foreach (const QString &input, inputList) {
+            chars += sanitizer.sanitize(input).size();
+        }
+    }
+
+    QVERIFY(chars > 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(testDefaultSanitizer)
 
 #include "testdefaultsanitizer.moc"
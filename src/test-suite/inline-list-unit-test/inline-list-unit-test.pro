@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2012-09-11T17:10:07
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = inlineListUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot \
+
+HEADERS += \
+    ../../chatbot/nlp-engine/inlinelist.h \
+
+SOURCES += \
+    inlinelisttest.cpp \
+    ../../chatbot/nlp-engine/symboltable.cpp \
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
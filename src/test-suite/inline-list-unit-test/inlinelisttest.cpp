@@ -0,0 +1,243 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+
+#include "nlp-engine/inlinelist.h"
+#include "nlp-engine/word.h"
+#include "nlp-engine/result.h"
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Counts live objects to check that every element is destroyed
+struct Counted
+{
+    static int live;
+
+    Counted(int v = 0) : v(v) { ++live; }
+    Counted(const Counted &other) : v(other.v) { ++live; }
+    ~Counted() { --live; }
+
+    bool operator==(const Counted &other) const { return v == other.v; }
+
+    int v;
+};
+
+int Counted::live = 0;
+
+typedef Nlp::InlineList<Counted, 4> CountedList;
+typedef Nlp::InlineList<QString, 4> StringList;
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// InlineListTest
+//--------------------------------------------------------------------------------------------------
+
+class InlineListTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    InlineListTest() { }
+
+private Q_SLOTS:
+    void testInlineCapacity();
+    void testInsertRemove();
+    void testCopy();
+    void testAppendSelf();
+    void testMoveAndTake();
+    void testDestruction();
+    void testWordList();
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void InlineListTest::testInlineCapacity()
+{
+    StringList l;
+
+    for (int i = 0; i < 4; ++i) {
+        l.append(QString::number(i));
+    }
+
+    QVERIFY(l.isInline());
+    QCOMPARE(l.capacity(), 4);
+
+    l << "4";
+
+    QVERIFY(!l.isInline());
+    QCOMPARE(l.size(), 5);
+    QCOMPARE(l.last(), QString("4"));
+
+    l.clear();
+    QVERIFY(l.isEmpty());
+    QVERIFY(l.capacity() >= 5);
+
+    l.reserve(100);
+    QVERIFY(l.capacity() >= 100);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void InlineListTest::testInsertRemove()
+{
+    StringList l;
+
+    for (int i = 0; i < 10; ++i) {
+        l.append(QString::number(i));
+    }
+
+    l.removeAt(3);
+    QCOMPARE(l[3], QString("4"));
+
+    l.insert(0, "a");
+    QCOMPARE(l.first(), QString("a"));
+    QCOMPARE(l[1], QString("0"));
+
+    // The inserted value is an element of the list
+    l.insert(5, l[1]);
+    QCOMPARE(l[5], QString("0"));
+
+    l.erase(l.begin() + 4, l.end());
+    QCOMPARE(l.size(), 4);
+    QCOMPARE(l.toList(), QList<QString>() << "a" << "0" << "1" << "2");
+
+    l.prepend("b");
+    QCOMPARE(l.indexOf("b"), 0);
+    QVERIFY(l.contains("2"));
+    QVERIFY(!l.contains("9"));
+
+    StringList m = l.mid(1, 2);
+    QCOMPARE(m.size(), 2);
+    QCOMPARE(m[0], QString("a"));
+    QCOMPARE(m[1], QString("0"));
+    QCOMPARE(l.mid(3).size(), 2);
+    QCOMPARE(l.value(10, "x"), QString("x"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void InlineListTest::testCopy()
+{
+    StringList l;
+
+    for (int i = 0; i < 10; ++i) {
+        l.append(QString::number(i));
+    }
+
+    StringList c(l);
+    QVERIFY(c == l);
+
+    c[0] = "x";
+    QVERIFY(c != l);
+    QCOMPARE(l[0], QString("0"));
+
+    c = l.mid(0, 2);
+    QVERIFY(c.isInline());
+    QCOMPARE(c.size(), 2);
+
+    QCOMPARE(StringList::fromList(l.toList()), l);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void InlineListTest::testAppendSelf()
+{
+    StringList l;
+    l << "a" << "b" << "c";
+
+    l.append(l);
+    QCOMPARE(l.size(), 6);
+    QCOMPARE(l[3], QString("a"));
+
+    // Appending an element of the list when it must grow
+    for (int i = 0; i < 100; ++i) {
+        l.append(l.first());
+    }
+    QCOMPARE(l.size(), 106);
+    QCOMPARE(l.last(), QString("a"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void InlineListTest::testMoveAndTake()
+{
+    StringList l;
+    l << "a" << "b" << "c" << "d";
+
+    l.move(0, 2);
+    QCOMPARE(l.toList(), QList<QString>() << "b" << "c" << "a" << "d");
+
+    l.move(3, 0);
+    QCOMPARE(l.toList(), QList<QString>() << "d" << "b" << "c" << "a");
+
+    QCOMPARE(l.takeFirst(), QString("d"));
+    QCOMPARE(l.takeLast(), QString("a"));
+    QCOMPARE(l.takeAt(1), QString("c"));
+    QCOMPARE(l.size(), 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void InlineListTest::testDestruction()
+{
+    {
+        CountedList l;
+
+        for (int i = 0; i < 20; ++i) {
+            l.append(Counted(i));
+        }
+        QCOMPARE(Counted::live, 20);
+
+        l.removeAt(0);
+        l.erase(l.begin(), l.begin() + 5);
+        QCOMPARE(Counted::live, 14);
+
+        l.insert(3, Counted(100));
+        QCOMPARE(Counted::live, 15);
+        QCOMPARE(l[3].v, 100);
+
+        CountedList c = l;
+        QCOMPARE(Counted::live, 30);
+    }
+
+    QCOMPARE(Counted::live, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void InlineListTest::testWordList()
+{
+    // Word and Result are relocated with memcpy()
+    Nlp::WordList words;
+
+    for (int i = 0; i < 40; ++i) {
+        words.append(Nlp::Word(QString::number(i), QString::number(i), "lemma"));
+    }
+
+    words.removeAt(0);
+    words.insert(1, words.last());
+
+    QCOMPARE(words.size(), 40);
+    QCOMPARE(words[0].origWord, QString("1"));
+    QCOMPARE(words[1].origWord, QString("39"));
+    QCOMPARE(words[2].lemma, QString("lemma"));
+
+    Nlp::ResultList results;
+    results.append(Nlp::Result("Output", 1, 0, 0.5));
+    QVERIFY(results.isInline());
+    QCOMPARE(results.value(0).output, QString("Output"));
+    QVERIFY(results.value(1).isNull());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_APPLESS_MAIN(InlineListTest)
+
+#include "inlinelisttest.moc"
@@ -19,6 +19,12 @@ public:
 private Q_SLOTS:
     void testParser();
     void testParser_data();
+    void testParseList();
+    void testEscape();
+    void testNestedValues();
+    void testReader();
+    void testReaderErrors();
+    void testWriter();
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -75,6 +81,171 @@ void JsonUnitTest::testParser()
 
 //--------------------------------------------------------------------------------------------------
 
+void JsonUnitTest::testParseList()
+{
+    Json jparser;
+    QList<Json::Object> objs;
+
+    QVERIFY(jparser.parseList("[]", objs));
+    QCOMPARE(objs.size(), 0);
+
+    QVERIFY(jparser.parseList("[ {\"input\": \"a {b}\", \"target\": \"x\"},{\"input\": \"c\"} ]",
+                              objs));
+    QCOMPARE(objs.size(), 2);
+    QCOMPARE(objs[0].value("input").toString(), QString("a {b}"));
+    QCOMPARE(objs[0].value("target").toString(), QString("x"));
+    QCOMPARE(objs[1].value("input").toString(), QString("c"));
+
+    objs.clear();
+    QVERIFY(!jparser.parseList("[{\"input\": \"a\"},]", objs));
+    QVERIFY(!jparser.parseList("[{\"input\": \"a\"} {\"input\": \"b\"}]", objs));
+    QVERIFY(!jparser.parseList("{\"input\": \"a\"}", objs));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void JsonUnitTest::testEscape()
+{
+    QString str = "Dijo \"hola\"\ten C:\\\n";
+
+    QCOMPARE(Json::escape(str), QString("Dijo \\\"hola\\\"\\ten C:\\\\\\n"));
+    QCOMPARE(Json::unescape(Json::escape(str)), str);
+
+    Json jparser;
+    Json::Object obj;
+
+    QVERIFY(jparser.parse("{\"path\": \"" + Json::escape("C:\\") + "\"}", obj));
+    QCOMPARE(Json::unescape(obj.value("path").toString()), QString("C:\\"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void JsonUnitTest::testNestedValues()
+{
+    Json jparser(Json::UnescapedStrings);
+    Json::Object obj;
+
+    QVERIFY(jparser.parse("{\"a\": {\"b\": [1, \"x\\ty\", true, null]}, \"c\": false}", obj));
+    QCOMPARE(obj.value("c"), QVariant(false));
+
+    Json::Object a = obj.value("a").value<Json::Object>();
+    QVariantList b = a.value("b").toList();
+
+    QCOMPARE(b.size(), 4);
+    QCOMPARE(b[0], QVariant(double(1)));
+    QCOMPARE(b[1], QVariant(QString("x\ty")));
+    QCOMPARE(b[2], QVariant(true));
+    QVERIFY(!b[3].isValid());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void JsonUnitTest::testReader()
+{
+    JsonReader reader("{\"k\\u00e9y\": [-12, 0.5e1, \"a\\\"b\\u00e1\\ud83d\\ude00\"], \"s\": {}}");
+
+    QCOMPARE(reader.readNext(), JsonReader::BeginObject);
+    QCOMPARE(reader.readNext(), JsonReader::Key);
+    QCOMPARE(reader.stringValue(), QString::fromUtf8("k\xc3\xa9y"));
+    QCOMPARE(reader.readNext(), JsonReader::BeginArray);
+    QCOMPARE(reader.readNext(), JsonReader::Number);
+    QCOMPARE(reader.numberValue(), -12.0);
+    QCOMPARE(reader.text(), QByteArray("-12"));
+    QCOMPARE(reader.readNext(), JsonReader::Number);
+    QCOMPARE(reader.numberValue(), 5.0);
+    QCOMPARE(reader.readNext(), JsonReader::String);
+    QCOMPARE(reader.text(), QByteArray("a\\\"b\\u00e1\\ud83d\\ude00"));
+    QCOMPARE(reader.stringValue(), QString::fromUtf8("a\"b\xc3\xa1\xf0\x9f\x98\x80"));
+    QCOMPARE(reader.readNext(), JsonReader::EndArray);
+    QCOMPARE(reader.readNext(), JsonReader::Key);
+    QCOMPARE(reader.readNext(), JsonReader::BeginObject);
+    QVERIFY(reader.skipValue());
+    QCOMPARE(reader.tokenType(), JsonReader::EndObject);
+    QCOMPARE(reader.readNext(), JsonReader::EndObject);
+    QCOMPARE(reader.readNext(), JsonReader::EndDocument);
+    QVERIFY(!reader.hasError());
+    QCOMPARE(reader.errorOffset(), -1);
+
+    JsonReader literals(" [true, false, null] ");
+
+    QCOMPARE(literals.readNext(), JsonReader::BeginArray);
+    QCOMPARE(literals.readNext(), JsonReader::Bool);
+    QVERIFY(literals.boolValue());
+    QCOMPARE(literals.readNext(), JsonReader::Bool);
+    QVERIFY(!literals.boolValue());
+    QCOMPARE(literals.readNext(), JsonReader::Null);
+    QCOMPARE(literals.readNext(), JsonReader::EndArray);
+    QCOMPARE(literals.readNext(), JsonReader::EndDocument);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void JsonUnitTest::testReaderErrors()
+{
+    const char *invalid[] = { "", "{", "[1,]", "{\"a\" 1}", "{\"a\": 01}", "[1.]", "[-]",
+                              "[\"a\\x\"]", "[\"a\tb\"]", "[\"\\u12g4\"]", "[tru]", "[1] 2",
+                              "{\"a\": 1]", "[1 2]", 0 };
+
+    for (int i = 0; invalid[i]; ++i) {
+        JsonReader reader(invalid[i]);
+
+        while (reader.readNext() != JsonReader::EndDocument && !reader.hasError()) { }
+
+        QVERIFY2(reader.hasError(), invalid[i]);
+        QVERIFY(reader.errorOffset() >= 0);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void JsonUnitTest::testWriter()
+{
+    JsonWriter writer;
+
+    writer.beginObject();
+    writer.writeKey("s");
+    writer.writeString(QString::fromUtf8("a\"b\\\n\x01\xc3\xa1\xf0\x9f\x98\x80"));
+    writer.writeKey("n");
+    writer.beginArray();
+    writer.writeNumber(qint64(-42));
+    writer.writeNumber(2.0);
+    writer.writeNumber(0.25);
+    writer.writeNumber(1.5, 3);
+    writer.writeNumber(qQNaN());
+    writer.endArray();
+    writer.writeKey(QString("b"));
+    writer.writeBool(true);
+    writer.writeKey("o");
+    writer.beginObject();
+    writer.endObject();
+    writer.writeKey("z");
+    writer.writeNull();
+    writer.endObject();
+
+    QByteArray expected = "{\"s\":\"a\\\"b\\\\\\n\\u0001\xc3\xa1\xf0\x9f\x98\x80\","
+                          "\"n\":[-42,2,0.25,1.500,null],\"b\":true,\"o\":{},\"z\":null}";
+
+    QCOMPARE(writer.toByteArray(), expected);
+    QCOMPARE(writer.size(), expected.size());
+
+    // Written JSON is read back
+    Json::Object obj;
+    QVERIFY(Json(Json::UnescapedStrings).parse(writer.toByteArray(), obj));
+    QCOMPARE(obj.value("s").toString(),
+             QString::fromUtf8("a\"b\\\n\x01\xc3\xa1\xf0\x9f\x98\x80"));
+
+    writer.clear();
+    QCOMPARE(writer.size(), 0);
+
+    QVariantList list;
+    list << 1 << "x" << QVariant();
+    writer.writeVariant(list);
+
+    QCOMPARE(writer.toByteArray(), QByteArray("[1,\"x\",null]"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(JsonUnitTest)
 
 #include "tst_jsonunittest.moc"
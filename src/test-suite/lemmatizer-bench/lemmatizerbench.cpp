@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Botmaster.
+ *
+ * LVK Botmaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Botmaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Botmaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// FreelingLemmatizer benchmark. Runs a corpus through tokenize(), lemmatize() or
+// lemmatizeBatch() with profiling enabled and writes one CSV row per stage of the lemmatizer
+// with its call count, accumulated time, share of the total time and latencies.
+//
+// Usage: lemmatizerBench [options]
+//
+//   --corpus FILE        Plain text file with one input per line
+//   --conversation FILE  Uses the messages of a recorded chat history as corpus
+//   --mode NAME          tokenize, lemmatize or batch. Default: lemmatize
+//   --batch-size N       Inputs per call in batch mode. Default: 100
+//   --iterations N       Passes over the corpus. Default: 1
+//   --output FILE        Appends the results to FILE instead of writing them to stdout
+//   --table FILE         Also runs the corpus through a TableLemmatizer with the lemma table
+//                        FILE and Freeling as fallback, and prints both wall times to stderr
+//   --export-table FILE  Imports the Freeling dictionary dicc.src, saves it as the lemma table
+//                        FILE and exits
+//
+// Without --corpus or --conversation a small built-in corpus is used.
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QtDebug>
+
+#include "nlp-engine/freelinglemmatizer.h"
+#include "nlp-engine/lemmatizerstats.h"
+#include "nlp-engine/lemmatable.h"
+#include "nlp-engine/tablelemmatizer.h"
+#include "nlp-engine/word.h"
+#include "common/conversation.h"
+#include "common/conversationreader.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+
+#include <stdio.h>
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const char *DEFAULT_CORPUS[] = {
+    "Hola, como estas?",
+    "Buenos dias! Queria saber a que hora abren el local",
+    "Cuanto cuesta el envio a Cordoba?",
+    "Me gustaria hablar con alguien de ventas",
+    "No entiendo lo que me decis",
+    "Tenes fotos de los productos nuevos?",
+    "Gracias por la ayuda, fuiste muy amable",
+    "Cual es tu nombre?",
+    "Los pedidos llegan en menos de una semana?",
+    "Jajaja que buenooo",
+    "Estoy buscando zapatillas para correr",
+    "Chau, nos vemos mañana"
+};
+const int DEFAULT_CORPUS_SIZE = sizeof(DEFAULT_CORPUS)/sizeof(DEFAULT_CORPUS[0]);
+
+//--------------------------------------------------------------------------------------------------
+
+struct Options
+{
+    Options() : mode("lemmatize"), batchSize(100), iterations(1) { }
+
+    QString corpus;
+    QString conversation;
+    QString mode;
+    int batchSize;
+    int iterations;
+    QString output;
+    QString table;
+    QString exportTable;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+bool readCorpus(const QString &filename, QStringList &inputs)
+{
+    QFile file(filename);
+
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        return false;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (!line.isEmpty()) {
+            inputs.append(line);
+        }
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool readConversation(const QString &filename, QStringList &inputs)
+{
+    Cmn::Conversation conv;
+
+    if (!Cmn::ConversationReader(filename).read(&conv)) {
+        return false;
+    }
+
+    foreach (const Cmn::Conversation::Entry &entry, conv.entries()) {
+        inputs.append(entry.msg);
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void run(const Options &opt, const QStringList &inputs, Nlp::Lemmatizer &lemmatizer)
+{
+    for (int i = 0; i < opt.iterations; ++i) {
+        if (opt.mode == "tokenize") {
+            foreach (const QString &input, inputs) {
+                QStringList tokens;
+                lemmatizer.tokenize(input, tokens);
+            }
+        } else if (opt.mode == "lemmatize") {
+            foreach (const QString &input, inputs) {
+                Nlp::WordList words;
+                lemmatizer.lemmatize(input, words);
+            }
+        } else {
+            for (int j = 0; j < inputs.size(); j += opt.batchSize) {
+                QList<Nlp::WordList> words;
+                lemmatizer.lemmatizeBatch(inputs.mid(j, opt.batchSize), words);
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool exportTable(const QString &filename)
+{
+    QString dicc = Cmn::Settings().value(SETTING_DATA_PATH).toString() + "/freeling/es/dicc.src";
+
+    Nlp::LemmaTable table;
+
+    if (!table.importDictionary(dicc)) {
+        fprintf(stderr, "Cannot import dictionary %s\n", qPrintable(dicc));
+        return false;
+    }
+
+    if (!table.save(filename)) {
+        fprintf(stderr, "Cannot save lemma table %s\n", qPrintable(filename));
+        return false;
+    }
+
+    fprintf(stderr, "Exported %d forms and %d lemmas to %s\n", table.size(), table.lemmaCount(),
+            qPrintable(filename));
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Runs the corpus through Freeling and through the lemma table and prints the wall times
+bool compareTable(const Options &opt, const QStringList &inputs)
+{
+    QSharedPointer<Nlp::LemmaTable> table(new Nlp::LemmaTable());
+
+    if (!table->load(opt.table)) {
+        fprintf(stderr, "Cannot load lemma table %s\n", qPrintable(opt.table));
+        return false;
+    }
+
+    Nlp::FreelingLemmatizer freeling;
+    Nlp::TableLemmatizer tableLemmatizer(table, new Nlp::FreelingLemmatizer());
+
+    QElapsedTimer timer;
+
+    timer.start();
+    run(opt, inputs, freeling);
+    qint64 freelingMs = timer.elapsed();
+
+    timer.restart();
+    run(opt, inputs, tableLemmatizer);
+    qint64 tableMs = timer.elapsed();
+
+    fprintf(stderr, "Freeling: %lld ms, table: %lld ms, fallbacks: %d of %d inputs\n",
+            freelingMs, tableMs, tableLemmatizer.fallbacks(), inputs.size() * opt.iterations);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool parseOptions(const QStringList &args, Options &opt)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+
+        const QString &value = args[++i];
+        bool ok = true;
+
+        if (arg == "--corpus") {
+            opt.corpus = value;
+        } else if (arg == "--conversation") {
+            opt.conversation = value;
+        } else if (arg == "--mode") {
+            opt.mode = value;
+            ok = value == "tokenize" || value == "lemmatize" || value == "batch";
+        } else if (arg == "--batch-size") {
+            opt.batchSize = value.toInt(&ok);
+            ok = ok && opt.batchSize > 0;
+        } else if (arg == "--iterations") {
+            opt.iterations = value.toInt(&ok);
+        } else if (arg == "--output") {
+            opt.output = value;
+        } else if (arg == "--table") {
+            opt.table = value;
+        } else if (arg == "--export-table") {
+            opt.exportTable = value;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    Options opt;
+
+    if (!parseOptions(app.arguments(), opt)) {
+        fprintf(stderr, "Usage: lemmatizerBench [--corpus FILE] [--conversation FILE] "
+                        "[--mode tokenize|lemmatize|batch] [--batch-size N] [--iterations N] "
+                        "[--output FILE] [--table FILE] [--export-table FILE]\n");
+        return 1;
+    }
+
+    Cmn::Settings().setValue(SETTING_APP_LANGUAGE, "es_AR");
+
+    if (!opt.exportTable.isEmpty()) {
+        return exportTable(opt.exportTable) ? 0 : 1;
+    }
+
+    QStringList inputs;
+
+    if (!opt.corpus.isEmpty() && !readCorpus(opt.corpus, inputs)) {
+        fprintf(stderr, "Cannot read corpus %s\n", qPrintable(opt.corpus));
+        return 1;
+    }
+
+    if (!opt.conversation.isEmpty() && !readConversation(opt.conversation, inputs)) {
+        fprintf(stderr, "Cannot read conversation %s\n", qPrintable(opt.conversation));
+        return 1;
+    }
+
+    if (opt.corpus.isEmpty() && opt.conversation.isEmpty()) {
+        for (int i = 0; i < DEFAULT_CORPUS_SIZE; ++i) {
+            inputs.append(QString::fromUtf8(DEFAULT_CORPUS[i]));
+        }
+    }
+
+    Nlp::FreelingLemmatizer lemmatizer;
+
+    // Warm up so loading Freeling data is not profiled
+    Nlp::WordList words;
+    lemmatizer.lemmatize(inputs.value(0), words);
+
+    lemmatizer.setProfiling(true);
+
+    run(opt, inputs, lemmatizer);
+
+    QFile file;
+    bool header = true;
+
+    if (opt.output.isEmpty()) {
+        file.open(stdout, QFile::WriteOnly);
+    } else {
+        file.setFileName(opt.output);
+        header = !file.exists() || file.size() == 0;
+
+        if (!file.open(QFile::WriteOnly | QFile::Append)) {
+            fprintf(stderr, "Cannot open %s\n", qPrintable(opt.output));
+            return 1;
+        }
+    }
+
+    QTextStream out(&file);
+
+    if (header) {
+        out << "mode,inputs,iterations,stage,count,total_ms,share,p50_us,p90_us,p99_us,max_us\n";
+    }
+
+    const Nlp::LemmatizerStats &stats = lemmatizer.stats();
+    qint64 totalNs = stats.totalNsecs(Nlp::LemmatizerStats::TotalStage);
+
+    for (int i = 0; i < Nlp::LemmatizerStats::StageCount; ++i) {
+        Nlp::LemmatizerStats::Stage stage = static_cast<Nlp::LemmatizerStats::Stage>(i);
+        const Nlp::LatencyHistogram &h = stats.histogram(stage);
+        qint64 ns = stats.totalNsecs(stage);
+
+        out << opt.mode << "," << inputs.size() << "," << opt.iterations << ","
+            << Nlp::LemmatizerStats::stageName(stage) << "," << h.count() << ","
+            << QString::number(ns/1e6, 'f', 3) << ","
+            << QString::number(totalNs > 0 ? (double)ns/totalNs : 0, 'f', 3) << ","
+            << h.percentile(50) << "," << h.percentile(90) << "," << h.percentile(99) << ","
+            << h.max() << "\n";
+    }
+
+    out.flush();
+
+    if (!opt.table.isEmpty() && !compareTable(opt, inputs)) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2012-09-11T17:10:07
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = maintenanceSchedulerUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot \
+
+SOURCES += \
+    maintenanceschedulertest.cpp \
+    ../../chatbot/common/maintenancescheduler.cpp \
+    ../../chatbot/common/settings.cpp \
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
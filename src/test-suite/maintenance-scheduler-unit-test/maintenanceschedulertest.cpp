@@ -0,0 +1,101 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+
+#include "common/maintenancescheduler.h"
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Counts its runs
+class CountingTask : public Cmn::MaintenanceTask
+{
+public:
+    CountingTask() : runs(0), pending(true) { }
+
+    virtual bool needsMaintenance() const { return pending; }
+
+    virtual void runMaintenance() { ++runs; }
+
+    int runs;
+    bool pending;
+};
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// MaintenanceSchedulerTest
+//--------------------------------------------------------------------------------------------------
+
+class MaintenanceSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    MaintenanceSchedulerTest() { }
+
+private Q_SLOTS:
+    void testScheduler();
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void MaintenanceSchedulerTest::testScheduler()
+{
+    Cmn::MaintenanceScheduler *sched = Cmn::MaintenanceScheduler::scheduler();
+    sched->setIdleDelay(0);
+    sched->setMaxDeferral(0);
+    sched->setBudget(1000);
+
+    CountingTask task;
+    sched->add(&task, "counting", 0);
+
+    // Tasks run when idle, unless they have nothing to do
+
+    sched->check();
+    QCOMPARE(task.runs, 1);
+
+    task.pending = false;
+    sched->check();
+    QCOMPARE(task.runs, 1);
+    task.pending = true;
+
+    // Tasks are deferred while there are replies in progress
+
+    {
+        Cmn::MaintenanceScheduler::Activity activity;
+        QVERIFY(!sched->isIdle());
+        sched->check();
+        QCOMPARE(task.runs, 1);
+    }
+
+    QVERIFY(sched->isIdle());
+    sched->check();
+    QCOMPARE(task.runs, 2);
+
+    QVariantMap tasks = sched->report()["tasks"].toMap();
+    QCOMPARE(tasks["counting"].toMap()["runs"].toInt(), 2);
+    QCOMPARE(tasks["counting"].toMap()["deferrals"].toInt(), 1);
+
+    // runAll() ignores the load
+
+    sched->beginActivity();
+    QCOMPARE(sched->runAll() >= 1, true);
+    QCOMPARE(task.runs, 3);
+    sched->endActivity();
+
+    sched->remove(&task);
+    sched->check();
+    QCOMPARE(task.runs, 3);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_MAIN(MaintenanceSchedulerTest)
+
+#include "maintenanceschedulertest.moc"
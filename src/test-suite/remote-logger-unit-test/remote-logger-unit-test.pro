@@ -0,0 +1,32 @@
+#-------------------------------------------------
+#
+# Aggregation and sampling of remote log messages
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = remoteLoggerUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot \
+
+HEADERS += \
+    ../../chatbot/da-server/remotelogger.h \
+    ../../chatbot/da-server/aggregatingremotelogger.h \
+
+SOURCES += \
+    remoteloggertest.cpp \
+    ../../chatbot/da-server/aggregatingremotelogger.cpp \
+
+PROJECT_PATH = ../../chatbot
+
+include($$PROJECT_PATH/common/common.pri)
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
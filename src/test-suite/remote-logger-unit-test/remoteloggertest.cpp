@@ -0,0 +1,171 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+
+#include "da-server/aggregatingremotelogger.h"
+#include "da-server/remoteloggerkeys.h"
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Remote logger that keeps logged messages in memory
+class MockRemoteLogger : public DAS::RemoteLogger
+{
+public:
+    MockRemoteLogger(QList<QPair<QString, FieldList> > &logged) : m_logged(logged) { }
+
+    virtual int log(const QString &msg) { return log(msg, FieldList()); }
+
+    virtual int log(const QString &msg, const FieldList &fields)
+    {
+        m_logged.append(qMakePair(msg, fields));
+        return 0;
+    }
+
+private:
+    QList<QPair<QString, FieldList> > &m_logged;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+QString fieldValue(const DAS::RemoteLogger::FieldList &fields, const QString &key)
+{
+    foreach (const DAS::RemoteLogger::Field &field, fields) {
+        if (field.first == key) {
+            return field.second;
+        }
+    }
+
+    return QString();
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// RemoteLoggerTest
+//--------------------------------------------------------------------------------------------------
+
+class RemoteLoggerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    RemoteLoggerTest();
+
+private Q_SLOTS:
+    void init();
+    void testRaw();
+    void testAggregated();
+    void testSampled();
+
+private:
+    QList<QPair<QString, DAS::RemoteLogger::FieldList> > m_logged;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+RemoteLoggerTest::RemoteLoggerTest()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RemoteLoggerTest::init()
+{
+    m_logged.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RemoteLoggerTest::testRaw()
+{
+    DAS::AggregatingRemoteLogger logger(new MockRemoteLogger(m_logged), 0);
+    logger.setAggregated("Chatbot connected");
+
+    DAS::RemoteLogger::FieldList fields;
+    fields.append(RLOG_KEY_USER_ID, "user1");
+
+    QCOMPARE(logger.log("Error", fields), 0);
+    QCOMPARE(logger.log("Error", fields), 0);
+
+    QCOMPARE(m_logged.size(), 2);
+    QCOMPARE(m_logged[0].first, QString("Error"));
+    QCOMPARE(fieldValue(m_logged[0].second, RLOG_KEY_USER_ID), QString("user1"));
+
+    // Nothing to flush
+    QCOMPARE(logger.flush(), 0);
+    QCOMPARE(m_logged.size(), 2);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RemoteLoggerTest::testAggregated()
+{
+    {
+        DAS::AggregatingRemoteLogger logger(new MockRemoteLogger(m_logged), 0);
+        logger.setAggregated("Chatbot connected");
+        logger.setAggregated("Chatbot disconnected", QStringList() << RLOG_KEY_CONNECTION_DUR);
+
+        for (int i = 1; i <= 3; ++i) {
+            DAS::RemoteLogger::FieldList fields;
+            fields.append(RLOG_KEY_USER_ID, "user1");
+            logger.log("Chatbot connected", fields);
+            fields.append(RLOG_KEY_CONNECTION_DUR, QString::number(i*10));
+            logger.log("Chatbot disconnected", fields);
+        }
+
+        QVERIFY(logger.needsMaintenance());
+        QVERIFY(m_logged.isEmpty());
+
+        QCOMPARE(logger.flush(), 0);
+        QVERIFY(!logger.needsMaintenance());
+        QCOMPARE(m_logged.size(), 1);
+
+        const DAS::RemoteLogger::FieldList &fields = m_logged[0].second;
+        QCOMPARE(fieldValue(fields, RLOG_KEY_USER_ID), QString("user1"));
+        QCOMPARE(fieldValue(fields, "agg_chatbot_connected_count"), QString("3"));
+        QCOMPARE(fieldValue(fields, "agg_chatbot_disconnected_count"), QString("3"));
+        QCOMPARE(fieldValue(fields, "agg_chatbot_disconnected_connection_duration_min"),
+                 QString("10"));
+        QCOMPARE(fieldValue(fields, "agg_chatbot_disconnected_connection_duration_max"),
+                 QString("30"));
+        QCOMPARE(fieldValue(fields, "agg_chatbot_disconnected_connection_duration_sum"),
+                 QString("60"));
+        QVERIFY(!fieldValue(fields, RLOG_KEY_AGGREGATE_PERIOD).isEmpty());
+
+        // Pending aggregates are flushed on destruction
+        logger.log("Chatbot connected");
+    }
+
+    QCOMPARE(m_logged.size(), 2);
+    QCOMPARE(fieldValue(m_logged[1].second, "agg_chatbot_connected_count"), QString("1"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RemoteLoggerTest::testSampled()
+{
+    DAS::AggregatingRemoteLogger logger(new MockRemoteLogger(m_logged), 0);
+    logger.setSampled("General Metrics", 0.25);
+    logger.setSampled("NLP Memory", 0);
+
+    for (int i = 0; i < 100; ++i) {
+        QCOMPARE(logger.log("General Metrics"), 0);
+        QCOMPARE(logger.log("NLP Memory"), 0);
+    }
+
+    QCOMPARE(m_logged.size(), 25);
+    QCOMPARE(m_logged[0].first, QString("General Metrics"));
+    QCOMPARE(fieldValue(m_logged[0].second, RLOG_KEY_SAMPLE_RATE), QString("0.25"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_APPLESS_MAIN(RemoteLoggerTest)
+
+#include "remoteloggertest.moc"
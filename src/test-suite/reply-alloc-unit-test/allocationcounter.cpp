@@ -0,0 +1,163 @@
+#include "allocationcounter.h"
+
+#include <new>
+#include <cstdlib>
+
+#if defined(Q_CC_MSVC)
+#  define LVK_THREAD_LOCAL __declspec(thread)
+#else
+#  define LVK_THREAD_LOCAL __thread
+#endif
+
+#if __cplusplus >= 201103L
+#  define LVK_THROW_BAD_ALLOC
+#  define LVK_NO_THROW          noexcept
+#else
+#  define LVK_THROW_BAD_ALLOC   throw(std::bad_alloc)
+#  define LVK_NO_THROW          throw()
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+LVK_THREAD_LOCAL bool t_counting = false;
+LVK_THREAD_LOCAL quint64 t_allocations = 0;
+LVK_THREAD_LOCAL quint64 t_bytes = 0;
+
+inline void count(size_t size)
+{
+    if (t_counting) {
+        ++t_allocations;
+        t_bytes += size;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline void *allocate(size_t size)
+{
+    void *p = std::malloc(size ? size : 1);
+
+    if (!p) {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// malloc interposition
+//--------------------------------------------------------------------------------------------------
+
+// Calls to malloc() from Qt and other shared libraries resolve to these definitions
+#if defined(__GLIBC__)
+
+#define LVK_COUNTS_MALLOC
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    count(n*size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+} // extern "C"
+
+#endif // __GLIBC__
+
+//--------------------------------------------------------------------------------------------------
+// operator new replacement
+//--------------------------------------------------------------------------------------------------
+
+// If malloc() is replaced, allocate() already counts
+void *operator new(size_t size) LVK_THROW_BAD_ALLOC
+{
+#ifndef LVK_COUNTS_MALLOC
+    count(size);
+#endif
+    return allocate(size);
+}
+
+void *operator new[](size_t size) LVK_THROW_BAD_ALLOC
+{
+#ifndef LVK_COUNTS_MALLOC
+    count(size);
+#endif
+    return allocate(size);
+}
+
+void operator delete(void *p) LVK_NO_THROW
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) LVK_NO_THROW
+{
+    std::free(p);
+}
+
+//--------------------------------------------------------------------------------------------------
+// AllocationCounter
+//--------------------------------------------------------------------------------------------------
+
+void AllocationCounter::start()
+{
+    t_allocations = 0;
+    t_bytes = 0;
+    t_counting = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void AllocationCounter::stop()
+{
+    t_counting = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+quint64 AllocationCounter::allocations()
+{
+    return t_allocations;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+quint64 AllocationCounter::bytes()
+{
+    return t_bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool AllocationCounter::countsMalloc()
+{
+#ifdef LVK_COUNTS_MALLOC
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * \brief The AllocationCounter class counts the heap allocations made by the current thread
+ *
+ * The test binary replaces the global operator new and, with glibc, malloc(), calloc() and
+ * realloc(), so allocations made by Qt and by the chatbot libraries are counted too.
+ * Allocations are only counted between start() and stop(), and only in the thread that
+ * invoked start().
+ */
+class AllocationCounter
+{
+public:
+
+    /**
+     * Resets the counters of the current thread and starts counting
+     */
+    static void start();
+
+    /**
+     * Stops counting in the current thread
+     */
+    static void stop();
+
+    /**
+     * Returns the allocations counted in the current thread
+     */
+    static quint64 allocations();
+
+    /**
+     * Returns the bytes requested by the allocations counted in the current thread
+     */
+    static quint64 bytes();
+
+    /**
+     * Returns true if malloc() is replaced, hence allocations of C code and Qt are counted.
+     * Otherwise; only operator new is counted.
+     */
+    static bool countsMalloc();
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,40 @@
+#-------------------------------------------------
+#
+# Allocations of the reply path
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = replyAllocUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot \
+    ../cb2-engine-unit-test
+
+HEADERS += \
+    ../cb2-engine-unit-test/mocklemmatizer.h \
+    allocationcounter.h \
+    ../../chatbot/back-end/aiadapter.h
+
+SOURCES += \
+    replyalloctest.cpp \
+    allocationcounter.cpp \
+    ../cb2-engine-unit-test/mocklemmatizer.cpp \
+    ../../chatbot/back-end/aiadapter.cpp
+
+PROJECT_PATH = ../../chatbot
+
+include($$PROJECT_PATH/nlp-engine/nlp-engine.pri)
+include($$PROJECT_PATH/common/common.pri)
+
+# Debug output of the engine and of MockLemmatizer would be counted as allocations
+DEFINES += QT_NO_DEBUG_OUTPUT
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
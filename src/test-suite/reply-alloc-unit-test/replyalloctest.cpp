@@ -0,0 +1,293 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QHash>
+
+#include "nlp-engine/cb2engine.h"
+#include "nlp-engine/rule.h"
+#include "nlp-engine/nullsanitizer.h"
+#include "nlp-engine/nlpproperties.h"
+#include "back-end/aiadapter.h"
+#include "chat-adapter/contactinfo.h"
+#include "mocklemmatizer.h"
+#include "allocationcounter.h"
+
+#define WARM_UP_ROUNDS      2       // Rounds not measured, so one-time initializations are ignored
+#define MEASURE_ROUNDS      10
+#define BASELINE_TOLERANCE  1.1     // Allocations allowed over the baseline
+#define BASELINE_FILE       SRCDIR "allocbaseline.txt"
+#define UPDATE_BASELINE_ENV "LVK_UPDATE_ALLOC_BASELINE"
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+// Allocations per message
+struct Usage
+{
+    Usage(double allocations = 0, double bytes = 0) : allocations(allocations), bytes(bytes) { }
+
+    double allocations;
+    double bytes;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+Lvk::Nlp::RuleList makeRules()
+{
+    Lvk::Nlp::RuleList rules;
+
+    rules.append(Lvk::Nlp::Rule(1, QStringList() << "Hola" << "Buenas tardes",
+                                QStringList() << "Hola! Como estas?"));
+    rules.append(Lvk::Nlp::Rule(2, QStringList() << "Me llamo [name]" << "Mi nombre es [name]",
+                                QStringList() << "Mucho gusto [name]"));
+    rules.append(Lvk::Nlp::Rule(3, QStringList() << "* perro *" << "* gato *",
+                                QStringList() << "Me encantan los animales"));
+    rules.append(Lvk::Nlp::Rule(4, QStringList() << "Que hora es" << "Sabes la hora",
+                                QStringList() << "No tengo reloj"));
+    rules.append(Lvk::Nlp::Rule(5, QStringList() << "Chau" << "Hasta luego",
+                                QStringList() << "Nos vemos!"));
+
+    return rules;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Inputs that match each kind of rule and inputs that do not match
+QStringList makeInputs()
+{
+    return QStringList()
+            << "Hola"
+            << "buenas tardes"
+            << "Me llamo Andres"
+            << "Mi nombre es Gabriel"
+            << "Tengo un perro negro"
+            << "mi gato duerme mucho"
+            << "Que hora es"
+            << "Hasta luego"
+            << "Esto no coincide con ninguna regla"
+            << "asdf qwerty";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QHash<QString, Usage> readBaseline()
+{
+    QHash<QString, Usage> baseline;
+
+    QFile file(BASELINE_FILE);
+
+    if (file.open(QFile::ReadOnly | QFile::Text)) {
+        QTextStream stream(&file);
+
+        while (!stream.atEnd()) {
+            QStringList fields = stream.readLine().simplified().split(" ");
+
+            if (fields.size() == 3 && !fields[0].startsWith("#")) {
+                baseline[fields[0]] = Usage(fields[1].toDouble(), fields[2].toDouble());
+            }
+        }
+    }
+
+    return baseline;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Replaces the values of each scenario in the baseline file and keeps the comments
+bool writeBaseline(const QHash<QString, Usage> &usages)
+{
+    QFile file(BASELINE_FILE);
+
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        return false;
+    }
+
+    QStringList lines = QString::fromUtf8(file.readAll()).split("\n");
+    file.close();
+
+    QHash<QString, Usage> pending = usages;
+
+    for (int i = 0; i < lines.size(); ++i) {
+        QString scenario = lines[i].section(' ', 0, 0);
+
+        if (!lines[i].startsWith("#") && pending.contains(scenario)) {
+            Usage u = pending.take(scenario);
+            lines[i] = QString("%1 %2 %3").arg(scenario).arg(qRound(u.allocations))
+                    .arg(qRound(u.bytes));
+        }
+    }
+
+    while (!lines.isEmpty() && lines.last().isEmpty()) {
+        lines.removeLast();
+    }
+
+    foreach (const QString &scenario, pending.keys()) {
+        Usage u = pending[scenario];
+        lines.append(QString("%1 %2 %3").arg(scenario).arg(qRound(u.allocations))
+                     .arg(qRound(u.bytes)));
+    }
+
+    return file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)
+            && file.write((lines.join("\n") + "\n").toUtf8()) != -1;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// ReplyAllocTest
+//--------------------------------------------------------------------------------------------------
+
+class ReplyAllocTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    ReplyAllocTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void testEngineAllocations();
+    void testAIAdapterAllocations();
+
+private:
+    Lvk::Nlp::Cb2Engine *m_engine;
+    QStringList m_inputs;
+    QHash<QString, Usage> m_baseline;
+    QHash<QString, Usage> m_measured;
+    bool m_updateBaseline;
+
+    void checkBudget(const QString &scenario, const Usage &usage);
+};
+
+ReplyAllocTest::ReplyAllocTest()
+    : m_engine(0), m_updateBaseline(false)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ReplyAllocTest::initTestCase()
+{
+    m_engine = new Lvk::Nlp::Cb2Engine(new Lvk::Nlp::NullSanitizer());
+    m_engine->setLemmatizer(new MockLemmatizer());
+    m_engine->setRules(makeRules());
+
+    // Cached responses would skip most of the reply path
+    m_engine->setProperty(NLP_PROP_RESPONSE_CACHE_SIZE, 0);
+
+    m_inputs = makeInputs();
+    m_baseline = readBaseline();
+    m_updateBaseline = !qgetenv(UPDATE_BASELINE_ENV).isEmpty();
+
+    if (!AllocationCounter::countsMalloc()) {
+        qWarning("malloc() is not replaced on this platform. Only operator new is counted.");
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ReplyAllocTest::cleanupTestCase()
+{
+    if (m_updateBaseline) {
+        QVERIFY2(writeBaseline(m_measured), "Cannot write " BASELINE_FILE);
+    }
+
+    delete m_engine;
+    m_engine = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ReplyAllocTest::checkBudget(const QString &scenario, const Usage &usage)
+{
+    qWarning("%s: %.1f allocations and %.0f bytes per message", qPrintable(scenario),
+             usage.allocations, usage.bytes);
+
+    m_measured[scenario] = usage;
+
+    Usage budget = m_baseline.value(scenario);
+
+    if (m_updateBaseline) {
+        return;
+    }
+
+    // Without a recorded baseline the budget cannot fail, so it is not reported as passed
+    if (budget.allocations <= 0) {
+        QSKIP("No baseline recorded yet, run with " UPDATE_BASELINE_ENV "=1", SkipSingle);
+    }
+
+    QString msg = QString("%1 allocations per message, baseline is %2")
+            .arg(usage.allocations).arg(budget.allocations);
+
+    QVERIFY2(usage.allocations <= budget.allocations*BASELINE_TOLERANCE, qPrintable(msg));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ReplyAllocTest::testEngineAllocations()
+{
+    const QString TARGET = "user@lvk.com";
+
+    quint64 allocations = 0;
+    quint64 bytes = 0;
+
+    for (int round = 0; round < WARM_UP_ROUNDS + MEASURE_ROUNDS; ++round) {
+        foreach (const QString &input, m_inputs) {
+            Lvk::Nlp::Engine::MatchList matches;
+
+            AllocationCounter::start();
+            m_engine->getResponse(input, TARGET, matches);
+            AllocationCounter::stop();
+
+            if (round >= WARM_UP_ROUNDS) {
+                allocations += AllocationCounter::allocations();
+                bytes += AllocationCounter::bytes();
+            }
+        }
+    }
+
+    double messages = MEASURE_ROUNDS*m_inputs.size();
+
+    checkBudget("engine", Usage(allocations/messages, bytes/messages));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void ReplyAllocTest::testAIAdapterAllocations()
+{
+    Lvk::BE::AIAdapter adapter("chatbot@lvk.com", m_engine);
+    Lvk::CA::ContactInfo contact("user@lvk.com", "User Name");
+
+    quint64 allocations = 0;
+    quint64 bytes = 0;
+
+    for (int round = 0; round < WARM_UP_ROUNDS + MEASURE_ROUNDS; ++round) {
+        foreach (const QString &input, m_inputs) {
+            AllocationCounter::start();
+            Lvk::Cmn::Conversation::Entry entry = adapter.getEntry(input, contact);
+            AllocationCounter::stop();
+
+            if (round >= WARM_UP_ROUNDS) {
+                allocations += AllocationCounter::allocations();
+                bytes += AllocationCounter::bytes();
+            }
+        }
+    }
+
+    double messages = MEASURE_ROUNDS*m_inputs.size();
+
+    checkBudget("aiadapter", Usage(allocations/messages, bytes/messages));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_APPLESS_MAIN(ReplyAllocTest)
+
+#include "replyalloctest.moc"
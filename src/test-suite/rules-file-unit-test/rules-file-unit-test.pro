@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2012-09-11T17:10:07
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+TARGET = rulesFileUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../chatbot/
+
+SOURCES += \
+    rulesfiletest.cpp \
+    ../../chatbot/back-end/rule.cpp \
+    ../../chatbot/back-end/mappedfile.cpp \
+    ../../chatbot/back-end/chatbotrulesfile.cpp \
+
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
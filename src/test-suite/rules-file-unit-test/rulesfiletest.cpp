@@ -0,0 +1,373 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+
+#include "back-end/chatbotrulesfile.h"
+#include "back-end/rule.h"
+
+using namespace Lvk;
+
+#define RULES_FILENAME          "rulesfiletest.cbf"
+#define LEGACY_RULES_FILENAME   "rulesfiletest_v2.cbf"
+
+#define CRF_MAGIC_NUMBER        (('c'<<0) | ('r'<<8) | ('f'<<16) | ('\0'<<24))
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+void makeRules(BE::Rule *root, int containers, int rulesPerContainer)
+{
+    quint64 id = 1;
+
+    for (int i = 0; i < containers; ++i) {
+        BE::Rule *container = new BE::Rule(QString("Container %1").arg(i), BE::Rule::ContainerRule);
+        container->setId(id++);
+        root->appendChild(container);
+
+        for (int j = 0; j < rulesPerContainer; ++j) {
+            QStringList input;
+            input << QString("Hello %1 %2").arg(i).arg(j) << QString("Hi %1 %2").arg(i).arg(j);
+
+            QStringList output;
+            output << QString("Hey there! %1").arg(j);
+
+            BE::Rule *rule = new BE::Rule(QString("Rule %1").arg(j), input, output);
+            rule->setId(id++);
+            rule->setNextCategory(j % 3);
+            container->appendChild(rule);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void compareRules(const BE::Rule *r1, const BE::Rule *r2)
+{
+    QVERIFY(*r1 == *r2);
+    QCOMPARE(r1->childCount(), r2->childCount());
+
+    for (int i = 0; i < r1->childCount(); ++i) {
+        compareRules(r1->child(i), r2->child(i));
+    }
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// RulesFileTest
+//--------------------------------------------------------------------------------------------------
+
+class RulesFileTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    RulesFileTest() { }
+
+private Q_SLOTS:
+    void init();
+    void testSaveAndLoad();
+    void testLazyStrings();
+    void testReadLegacyFormat();
+    void testIncrementalSave();
+    void testMergeRules();
+    void testCopyWithMetadata();
+    void testFindRuleById();
+    void testBenchmarkLoad();
+    void cleanup();
+
+private:
+    QString m_filename;
+    QString m_legacyFilename;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::init()
+{
+    m_filename = QDir::tempPath() + QDir::separator() + RULES_FILENAME;
+    m_legacyFilename = QDir::tempPath() + QDir::separator() + LEGACY_RULES_FILENAME;
+    QFile::remove(m_filename);
+    QFile::remove(m_legacyFilename);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::cleanup()
+{
+    QFile::remove(m_filename);
+    QFile::remove(m_legacyFilename);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testSaveAndLoad()
+{
+    BE::ChatbotRulesFile rules;
+    makeRules(rules.rootRule(), 5, 20);
+    rules.setMetadata("key", QString("value"));
+    QVERIFY(rules.saveAs(m_filename));
+
+    BE::ChatbotRulesFile rules2;
+    QVERIFY(rules2.load(m_filename));
+    QCOMPARE(rules2.metadata("key").toString(), QString("value"));
+    QVERIFY(!rules2.hasUnsavedChanges());
+    compareRules(rules.rootRule(), rules2.rootRule());
+
+    // Saving over the mapped file must keep all strings
+    rules2.rootRule()->child(0)->setName("Renamed");
+    QVERIFY(rules2.save());
+
+    BE::ChatbotRulesFile rules3;
+    QVERIFY(rules3.load(m_filename));
+    compareRules(rules2.rootRule(), rules3.rootRule());
+    QCOMPARE(rules3.rootRule()->child(0)->name(), QString("Renamed"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testLazyStrings()
+{
+    BE::ChatbotRulesFile rules;
+    makeRules(rules.rootRule(), 1, 3);
+    QVERIFY(rules.saveAs(m_filename));
+
+    BE::ChatbotRulesFile rules2;
+    QVERIFY(rules2.load(m_filename));
+
+    const BE::Rule *rule = rules2.rootRule()->child(0)->child(1);
+    QCOMPARE(rule->id(), rules.rootRule()->child(0)->child(1)->id());
+    QCOMPARE(rule->type(), BE::Rule::OrdinaryRule);
+    QCOMPARE(rule->name(), QString("Rule 1"));
+    QCOMPARE(rule->input().size(), 2);
+    QCOMPARE(rule->input()[0], QString("Hello 0 1"));
+    QCOMPARE(rule->output()[0], QString("Hey there! 1"));
+
+    // Setting a string before decoding it must not be overwritten later
+    BE::Rule *rule2 = rules2.rootRule()->child(0)->child(2);
+    rule2->setInput(QStringList() << "new input");
+    QCOMPARE(rule2->input(), QStringList() << "new input");
+    QCOMPARE(rule2->output()[0], QString("Hey there! 2"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testReadLegacyFormat()
+{
+    BE::Rule root;
+    makeRules(&root, 3, 10);
+
+    QFile file(m_legacyFilename);
+    QVERIFY(file.open(QFile::WriteOnly));
+
+    QDataStream ostream(&file);
+    ostream.setVersion(QDataStream::Qt_4_7);
+    ostream << (quint32)CRF_MAGIC_NUMBER;
+    ostream << (quint32)2;
+    ostream << QString("00000000-0000-0000-0000-000000000001");
+    ostream << root;
+    ostream << QHash<QString, QVariant>();
+    ostream << (quint64)100;
+    file.close();
+
+    BE::ChatbotRulesFile rules;
+    QVERIFY(rules.load(m_legacyFilename));
+    QCOMPARE(rules.chatbotId(), QString("00000000-0000-0000-0000-000000000001"));
+    compareRules(&root, rules.rootRule());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testIncrementalSave()
+{
+    BE::ChatbotRulesFile rules;
+    makeRules(rules.rootRule(), 5, 20);
+    QVERIFY(rules.saveAs(m_filename));
+    QVERIFY(!rules.hasUnsavedChanges());
+
+    qint64 baseSize = QFileInfo(m_filename).size();
+
+    // Edit, remove, move and add rules
+    BE::Rule *container0 = rules.rootRule()->child(0);
+    BE::Rule *container1 = rules.rootRule()->child(1);
+    container0->child(0)->setName("Renamed");
+    QVERIFY(rules.hasUnsavedChanges());
+    container0->removeChildren(1, 1);
+    container0->moveChildren(0, 1, container1);
+
+    BE::Rule *newRule = new BE::Rule("New", QStringList() << "in", QStringList() << "out");
+    newRule->setId(10000);
+    rules.rootRule()->child(2)->appendChild(newRule);
+
+    QVERIFY(rules.save());
+    QVERIFY(!rules.hasUnsavedChanges());
+
+    rules.rootRule()->child(3)->setName("Renamed again");
+    rules.setMetadata("key", QString("value"));
+    QVERIFY(rules.save());
+
+    // Changes are appended to the file
+    qint64 size = QFileInfo(m_filename).size();
+    QVERIFY(size > baseSize);
+    QVERIFY(size < baseSize + baseSize/4);
+
+    BE::ChatbotRulesFile rules2;
+    QVERIFY(rules2.load(m_filename));
+    QVERIFY(!rules2.hasUnsavedChanges());
+    QCOMPARE(rules2.metadata("key").toString(), QString("value"));
+    compareRules(rules.rootRule(), rules2.rootRule());
+    QCOMPARE(rules2.rootRule()->child(1)->childCount(), 21);
+    QCOMPARE(rules2.rootRule()->child(1)->child(20)->name(), QString("Renamed"));
+
+    // An incomplete change at the end of the file is ignored
+    rules2.rootRule()->child(4)->setName("Lost");
+    QVERIFY(rules2.save());
+
+    QFile file(m_filename);
+    QVERIFY(file.open(QFile::ReadWrite));
+    QVERIFY(file.resize(file.size() - 4));
+    file.close();
+
+    BE::ChatbotRulesFile rules3;
+    QVERIFY(rules3.load(m_filename));
+    compareRules(rules.rootRule(), rules3.rootRule());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testMergeRules()
+{
+    BE::ChatbotRulesFile rules;
+    makeRules(rules.rootRule(), 2, 5);
+    rules.reserveRuleIds(12);
+
+    BE::Rule container;
+    makeRules(&container, 3, 4);
+
+    const BE::Rule *merged = container.child(1)->child(2);
+
+    QVERIFY(rules.mergeRules(&container));
+
+    // Rules are moved, not copied
+    QCOMPARE(container.childCount(), 0);
+    QCOMPARE(rules.rootRule()->childCount(), 5);
+    QVERIFY(rules.rootRule()->child(3)->child(2) == merged);
+    QCOMPARE(merged->name(), QString("Rule 2"));
+
+    // Merged rules get new IDs
+    QSet<quint64> ids;
+    for (BE::Rule::const_iterator it = rules.rootRule()->begin(); it != rules.rootRule()->end();
+         ++it) {
+        if (*it != rules.rootRule()) {
+            QVERIFY(!ids.contains((*it)->id()));
+            ids.insert((*it)->id());
+        }
+    }
+    QCOMPARE(ids.size(), 2*6 + 3*5);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testCopyWithMetadata()
+{
+    BE::ChatbotRulesFile rules;
+    makeRules(rules.rootRule(), 3, 10);
+    rules.setMetadata("key", QString("value"));
+    rules.setMetadata("other", QString("other value"));
+    QVERIFY(rules.saveAs(m_filename));
+
+    // Copy also the change log
+    rules.rootRule()->child(0)->setName("Renamed");
+    QVERIFY(rules.save());
+
+    QString copyFilename = m_legacyFilename;
+
+    QHash<QString, QVariant> metadata;
+    metadata["key"] = QString("a much longer value than the original one");
+
+    QFile copy(copyFilename);
+    QVERIFY(copy.open(QFile::WriteOnly));
+    QVERIFY(BE::ChatbotRulesFile::copyWithMetadata(m_filename, copy, metadata));
+    copy.close();
+
+    BE::ChatbotRulesFile rules2;
+    QVERIFY(rules2.load(copyFilename));
+    QCOMPARE(rules2.chatbotId(), rules.chatbotId());
+    QCOMPARE(rules2.metadata("key").toString(), metadata["key"].toString());
+    QCOMPARE(rules2.metadata("other").toString(), QString("other value"));
+    compareRules(rules.rootRule(), rules2.rootRule());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testFindRuleById()
+{
+    BE::ChatbotRulesFile rules;
+    makeRules(rules.rootRule(), 3, 10);
+    QVERIFY(rules.saveAs(m_filename));
+
+    BE::ChatbotRulesFile rules2;
+    QVERIFY(rules2.load(m_filename));
+
+    const BE::RuleChangeTracker *tracker = rules2.rootRule()->tracker();
+    QVERIFY(tracker);
+
+    BE::Rule *container1 = rules2.rootRule()->child(1);
+    BE::Rule *rule = container1->child(4);
+    QVERIFY(tracker->rule(rule->id()) == rule);
+    QVERIFY(tracker->rule(0) == 0);
+    QCOMPARE(rule->row(), 4);
+
+    // IDs and rows are kept up to date
+    quint64 oldId = rule->id();
+    rule->setId(5000);
+    QVERIFY(tracker->rule(oldId) == 0);
+    QVERIFY(tracker->rule(5000) == rule);
+
+    container1->removeChildren(0, 2);
+    QCOMPARE(rule->row(), 2);
+    QVERIFY(rule->nextSibling() == container1->child(3));
+
+    BE::Rule *removed = container1->child(0);
+    container1->children().removeOne(removed);
+    delete removed;
+    QCOMPARE(rule->row(), 1);
+
+    BE::Rule *newRule = new BE::Rule("New", QStringList() << "in", QStringList() << "out");
+    newRule->setId(6000);
+    container1->appendChild(newRule);
+    QVERIFY(tracker->rule(6000) == newRule);
+    QCOMPARE(newRule->row(), container1->childCount() - 1);
+
+    // Deleted rules are no longer indexed
+    quint64 deletedId = rules2.rootRule()->child(2)->child(0)->id();
+    rules2.rootRule()->child(2)->removeChildren(0, 1);
+    QVERIFY(tracker->rule(deletedId) == 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void RulesFileTest::testBenchmarkLoad()
+{
+    BE::ChatbotRulesFile rules;
+    makeRules(rules.rootRule(), 100, 100);
+    QVERIFY(rules.saveAs(m_filename));
+
+    QBENCHMARK {
+        BE::ChatbotRulesFile rules2;
+        QVERIFY(rules2.load(m_filename));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_APPLESS_MAIN(RulesFileTest)
+
+#include "rulesfiletest.moc"
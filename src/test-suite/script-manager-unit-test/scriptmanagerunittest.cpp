@@ -72,6 +72,8 @@ private Q_SLOTS:
     void testImportScript();
     void testImportScript_data();
 
+    void testReloadModifiedScript();
+
 private:
     QString m_clueDir;
 
@@ -377,6 +379,42 @@ void ScriptManagerUnitTest::testImportScript_data()
 
 //--------------------------------------------------------------------------------------------------
 
+void ScriptManagerUnitTest::testReloadModifiedScript()
+{
+    QString filename = "reload_test." SCRIPT_FILE_EXT;
+
+    rmAllScripts();
+
+    Clue::ScriptManager mgr;
+    mgr.setCurrentCharacter("pedro");
+
+    mkFile(m_clueDir + "/" + filename,
+           XML_SCRIPT.arg(XML_HEADER.arg("pedro", "1"),
+                          XML_QUESTION.arg("q1", "a1", "", XML_STANDARD, "", "")));
+
+    QVERIFY(mgr.loadScripts());
+    QCOMPARE(mgr.scripts().size(), 1);
+    QCOMPARE(mgr.scripts()[0].size(), 1);
+
+    // Unchanged scripts are cached, modified scripts must be parsed again
+    QVERIFY(mgr.loadScripts());
+    QCOMPARE(mgr.scripts()[0].size(), 1);
+
+    mkFile(m_clueDir + "/" + filename,
+           XML_SCRIPT.arg(XML_HEADER.arg("pedro", "1"),
+                          XML_QUESTION.arg("q1", "a1", "", XML_STANDARD, "", "") +
+                          XML_QUESTION.arg("q2", "a2", "", XML_CRITICAL, "", "")));
+
+    QVERIFY(mgr.loadScripts());
+    QCOMPARE(mgr.scripts().size(), 1);
+    QCOMPARE(mgr.scripts()[0].size(), 2);
+    QCOMPARE(mgr.scripts()[0][1].importance, Clue::ScriptLine::Critical);
+
+    mgr.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 void ScriptManagerUnitTest::mkFile(const QString &filename, const QString &content)
 {
     qDebug() << "ScripManagerUnitTest: Creating file" << filename;
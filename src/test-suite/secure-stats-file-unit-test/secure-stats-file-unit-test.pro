@@ -18,8 +18,10 @@ INCLUDEPATH += ../../chatbot/
 
 SOURCES += \
     ../../chatbot/stats/securestatsfile.cpp \
+    ../../chatbot/stats/metricseries.cpp \
     ../../chatbot/crypto/cipher.cpp \
     ../../chatbot/crypto/keymanagerfactory.cpp \
+    ../../chatbot/crypto/keycache.cpp \
     ../../chatbot/common/conversation.cpp \
     securestatsfiletest.cpp
 
@@ -1,13 +1,16 @@
 #include <QtCore/QString>
 #include <QtTest/QtTest>
 #include <QFile>
+#include <QFileInfo>
 #include <QVariant>
 
 #include "stats/securestatsfile.h"
 #include "stats/metric.h"
 #include "stats/score.h"
+#include "stats/metricseries.h"
 
 #define FILENAME_1 "teststatfile1.stat"
+#define JOURNAL_1  FILENAME_1 ".jrnl"
 
 
 using namespace Lvk;
@@ -32,6 +35,9 @@ private Q_SLOTS:
     void testSaveAndLoadScore();
     void testSaveAndLoadMetrics();
     void testNewIntervalAndHistory();
+    void testJournal();
+    void testMetricSeries();
+    void testMetricRollups();
 
 private:
 
@@ -63,6 +69,9 @@ void SecureStatsFileTest::init()
     if (QFile::exists(FILENAME_1)) {
         QVERIFY(QFile::remove(FILENAME_1));
     }
+    if (QFile::exists(JOURNAL_1)) {
+        QVERIFY(QFile::remove(JOURNAL_1));
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -72,6 +81,9 @@ void SecureStatsFileTest::cleanupTestCase()
     if (QFile::exists(FILENAME_1)) {
         QVERIFY(QFile::remove(FILENAME_1));
     }
+    if (QFile::exists(JOURNAL_1)) {
+        QVERIFY(QFile::remove(JOURNAL_1));
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -398,6 +410,234 @@ void SecureStatsFileTest::testNewIntervalAndHistory()
 
 //--------------------------------------------------------------------------------------------------
 
+void SecureStatsFileTest::testJournal()
+{
+    const Stats::Metric m1 = Stats::RuleLexiconSize;
+    const Stats::Metric m4 = Stats::ConnectionTime; // cumulative
+
+    Stats::Score cs(10, 20, 30);
+    Cmn::Conversation::Entry e1(QDateTime::currentDateTime(), "John", "Jane", "Hi", "Hi!", true, 2);
+
+    QVariant v;
+    qint64 snapshotSize = 0;
+    qint64 journalSize = 0;
+
+    {
+        Stats::SecureStatsFile file(FILENAME_1);
+
+        // First save writes the snapshot
+        file.setMetric(m1, QVariant(10));
+        file.save();
+        QVERIFY(QFile::exists(FILENAME_1));
+        QVERIFY(!QFile::exists(JOURNAL_1));
+        snapshotSize = QFileInfo(FILENAME_1).size();
+
+        // Next saves only append the changes to the journal
+        file.setMetric(m4, QVariant(60));
+        file.setMetric(m4, QVariant(70));
+        file.setCurrentScore(cs);
+        file.addContact("John");
+        file.appendChatEntry(e1);
+        file.save();
+        QVERIFY(QFile::exists(JOURNAL_1));
+        QCOMPARE(QFileInfo(FILENAME_1).size(), snapshotSize);
+        journalSize = QFileInfo(JOURNAL_1).size();
+
+        file.newInterval();
+        file.setMetric(m1, QVariant(20));
+        file.save();
+        QVERIFY(QFileInfo(JOURNAL_1).size() > journalSize);
+        journalSize = QFileInfo(JOURNAL_1).size();
+
+        // Nothing changed
+        file.save();
+        QCOMPARE(QFileInfo(JOURNAL_1).size(), journalSize);
+    }
+
+    {
+        Stats::SecureStatsFile file(FILENAME_1);
+
+        QVERIFY(file.currentScore() == cs);
+        QVERIFY(file.contacts().size() == 1);
+        QVERIFY(file.intervals() == 2);
+
+        file.metric(m1, v);
+        QVERIFY(v.toUInt() == 20);
+
+        Stats::History h;
+        file.metricHistory(m4, h);
+        QVERIFY(h.size() == 2);
+        for (int i = 0; i < h.size(); ++i) {
+            QVERIFY(h[i].second.toUInt() == (h[i].first == 1 ? 130 : 0));
+        }
+
+        Cmn::Conversation conv;
+        file.chatHistory(conv);
+        QVERIFY(conv.isEmpty()); // cleared by newInterval()
+    }
+
+    // Incomplete records are discarded
+    {
+        QFile f(JOURNAL_1);
+        QVERIFY(f.open(QFile::Append));
+        f.write("\0\0\0");
+    }
+    {
+        Stats::SecureStatsFile file(FILENAME_1);
+
+        file.metric(m1, v);
+        QVERIFY(v.toUInt() == 20);
+        QCOMPARE(QFileInfo(JOURNAL_1).size(), journalSize);
+    }
+
+    // Tampered records clear the stats
+    {
+        QFile f(JOURNAL_1);
+        QVERIFY(f.open(QFile::ReadWrite));
+        QByteArray data = f.readAll();
+        data[data.size() - 1] = data[data.size() - 1] ^ 0x01;
+        f.seek(0);
+        f.write(data);
+    }
+    {
+        Stats::SecureStatsFile file(FILENAME_1);
+
+        verifyAllEmpty(file);
+        QVERIFY(!QFile::exists(FILENAME_1));
+        QVERIFY(!QFile::exists(JOURNAL_1));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void SecureStatsFileTest::testMetricSeries()
+{
+    Stats::MetricSeries series(10);
+    series.setCumulative(2);
+    series.setRollup(4, 3);
+
+    for (unsigned i = 1; i <= 10; ++i) {
+        series.set(i, 1, i*10);
+        series.set(i, 2, 1, true);
+    }
+
+    QCOMPARE(series.size(), 10);
+    QCOMPARE(series.value(5, 1), 50u);
+    QCOMPARE(series.value(11, 1), 0u);
+    QVERIFY(!series.contains(11));
+
+    // Intervals 1-3 and 4-6 are rolled up
+    series.rollup(10);
+
+    QCOMPARE(series.size(), 6);
+    QVERIFY(!series.contains(1));
+    QCOMPARE(series.value(3, 1), 30u);
+    QCOMPARE(series.value(3, 2), 3u);
+    QCOMPARE(series.value(6, 1), 60u);
+    QCOMPARE(series.value(7, 2), 1u);
+
+    // Intervals 7-8 are rolled up, bucket 7-9 is still incomplete
+    series.rollup(12);
+
+    QCOMPARE(series.size(), 5);
+    QCOMPARE(series.value(8, 2), 2u);
+
+    Stats::History h;
+    series.history(1, 5, 9, h);
+    QCOMPARE(h.size(), 3);
+    QCOMPARE(h[0].first, 6u);
+    QCOMPARE(h[1].first, 8u);
+    QCOMPARE(h[2].first, 9u);
+    QCOMPARE(h[2].second.toUInt(), 90u);
+
+    // Encoding round trip
+    QByteArray data;
+    {
+        QDataStream ostream(&data, QIODevice::WriteOnly);
+        series.write(ostream);
+    }
+
+    Stats::MetricSeries series2(10);
+    {
+        QDataStream istream(data);
+        QVERIFY(series2.read(istream));
+    }
+
+    Stats::History h2;
+    for (int col = 0; col < 10; ++col) {
+        series.history(col, h);
+        series2.history(col, h2);
+        QVERIFY(h == h2);
+    }
+
+    // Corrupted data
+    QByteArray truncated = data.left(data.size() - 1);
+    {
+        QDataStream istream(truncated);
+        QVERIFY(!series2.read(istream));
+    }
+    QVERIFY(series2.isEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void SecureStatsFileTest::testMetricRollups()
+{
+    const Stats::Metric m1 = Stats::RuleDefCount;
+    const Stats::Metric m4 = Stats::ConnectionTime; // cumulative
+    const unsigned INTERVALS = 200;
+
+    Stats::History h;
+
+    {
+        Stats::SecureStatsFile file(FILENAME_1);
+
+        for (unsigned i = 1; i <= INTERVALS; ++i) {
+            if (i > 1) {
+                file.newInterval();
+            }
+            file.setMetric(m1, QVariant(i));
+            file.setMetric(m4, QVariant(1));
+        }
+
+        file.metricHistory(m1, h);
+
+        // 144 intervals kept as they are, older intervals rolled up in buckets of 5
+        QCOMPARE(h.size(), 144 + 11 + 1);
+        QCOMPARE(h[10].first, 55u);
+        QCOMPARE(h[10].second.toUInt(), 55u);
+        QCOMPARE(h.last().first, INTERVALS);
+
+        file.metricHistory(m4, h);
+
+        unsigned total = 0;
+        for (int i = 0; i < h.size(); ++i) {
+            total += h[i].second.toUInt();
+        }
+        QCOMPARE(total, INTERVALS);
+
+        file.metricHistory(m1, 100, 109, h);
+        QCOMPARE(h.size(), 10);
+        QCOMPARE(h[0].second.toUInt(), 100u);
+
+        file.save();
+    }
+
+    {
+        Stats::SecureStatsFile file(FILENAME_1);
+
+        file.metricHistory(m1, h);
+        QCOMPARE(h.size(), 144 + 11 + 1);
+        QCOMPARE(h[10].second.toUInt(), 55u);
+
+        QVariant v;
+        file.metric(m1, v);
+        QCOMPARE(v.toUInt(), INTERVALS);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(SecureStatsFileTest)
 
 #include "securestatsfiletest.moc"
@@ -18,28 +18,39 @@ INCLUDEPATH += ../../chatbot/ ../../third-party
 
 HEADERS += \
     ../../chatbot/common/settings.h \
+    ../../chatbot/common/maintenancescheduler.h \
     ../../chatbot/stats/statsmanager.h \
     ../../chatbot/stats/statshelper.h \
     ../../chatbot/stats/historystatshelper.h \
     ../../chatbot/stats/rulestatshelper.h \
+    ../../chatbot/stats/hyperloglog.h \
+    ../../chatbot/stats/distinctcounter.h \
 
 SOURCES += \
     ../../chatbot/stats/statsmanager.cpp \
     ../../chatbot/stats/securestatsfile.cpp \
+    ../../chatbot/stats/metricseries.cpp \
     ../../chatbot/stats/historystatshelper.cpp \
+    ../../chatbot/stats/hyperloglog.cpp \
+    ../../chatbot/stats/distinctcounter.cpp \
     ../../chatbot/crypto/cipher.cpp \
     ../../chatbot/crypto/keymanagerfactory.cpp \
+    ../../chatbot/crypto/keycache.cpp \
     ../../chatbot/common/settings.cpp \
     ../../chatbot/common/conversation.cpp \
     ../../chatbot/common/conversationreader.cpp \
     ../../chatbot/common/logger.cpp \
     ../../chatbot/common/csvrow.cpp \
+    ../../chatbot/common/csvparser.cpp \
     ../../chatbot/common/csvdocument.cpp \
     ../../chatbot/common/random.cpp \
+    ../../chatbot/common/maintenancescheduler.cpp \
+    ../../chatbot/common/textsearch.cpp \
     ../../chatbot/nlp-engine/defaultsanitizer.cpp \
     ../../chatbot/nlp-engine/parser.cpp \
     ../../chatbot/nlp-engine/varstack.cpp \
     ../../chatbot/nlp-engine/globaltools.cpp \
+    ../../chatbot/nlp-engine/toolchain.cpp \
     ../../chatbot/back-end/rule.cpp \
     statsmanagertest.cpp
 
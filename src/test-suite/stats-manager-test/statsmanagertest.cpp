@@ -7,6 +7,8 @@
 #include "stats/statsmanager.h"
 #include "stats/metric.h"
 #include "stats/securestatsfile.h"
+#include "stats/historystatshelper.h"
+#include "stats/distinctcounter.h"
 #include "common/conversationreader.h"
 
 Q_DECLARE_METATYPE(Lvk::BE::Rule *)
@@ -162,6 +164,12 @@ private Q_SLOTS:
     void testScoreAlgorithm_data();
     void testScoreAlgorithm();
     void testBestScoreAndIntervals();
+    void testIncrementalRuleScore();
+    void testScoreChangedSignal();
+    void testDistinctCounter_data();
+    void testDistinctCounter();
+    void testHistoryStatsCountModes();
+    void testHistoryCheckpoint();
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -619,6 +627,219 @@ void StatsManagerTest::testBestScoreAndIntervals()
 
 //--------------------------------------------------------------------------------------------------
 
+void StatsManagerTest::testIncrementalRuleScore()
+{
+    manager()->setFilename(STAT_FILENAME_1);
+    manager()->clear();
+
+    BE::Rule *root = newRuleTree2();
+
+    manager()->updateScoreWith(root);
+
+    QCOMPARE(manager()->currentScore().rules, (double)ruleTree2Score());
+    QCOMPARE(manager()->metric(Stats::RuleDefCount).toUInt(), 4u);
+    QCOMPARE(manager()->metric(Stats::CondRuleCount).toUInt(), 1u);
+
+    // Unchanged tree
+    QVERIFY(!manager()->m_ruleStats.update(root));
+
+    // Edit rule
+    root->child(3)->setOutput(QStringList() << "Maybe");
+    manager()->updateScoreWith(root);
+
+    QCOMPARE(manager()->currentScore().rules, (double)(REGEX_P + KWOP_P + VAR_P + SIMPL_P));
+    QCOMPARE(manager()->metric(Stats::CondRuleCount).toUInt(), 0u);
+
+    // Duplicated input/output pairs score only once
+    newOrdinaryRule(QStringList() << "Hi *", QStringList() << "Hello", root);
+    manager()->updateScoreWith(root);
+
+    QCOMPARE(manager()->currentScore().rules, (double)(REGEX_P + KWOP_P + VAR_P + SIMPL_P));
+    QCOMPARE(manager()->metric(Stats::RuleDefCount).toUInt(), 5u);
+
+    // Remove rules
+    root->removeChildren(4, 1);
+    root->removeChildren(0, 1);
+    manager()->updateScoreWith(root);
+
+    QCOMPARE(manager()->currentScore().rules, (double)(KWOP_P + VAR_P + SIMPL_P));
+    QCOMPARE(manager()->metric(Stats::RuleDefCount).toUInt(), 3u);
+    QCOMPARE(manager()->metric(Stats::RegexRuleCount).toUInt(), 1u);
+
+    // Same result as a full rebuild
+    Stats::RuleStatsHelper full(root);
+
+    QCOMPARE(manager()->m_ruleStats.points(), full.points());
+    QCOMPARE(manager()->m_ruleStats.words(), full.words());
+    QCOMPARE(manager()->m_ruleStats.lexiconSize(), full.lexiconSize());
+
+    delete root;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void StatsManagerTest::testScoreChangedSignal()
+{
+    manager()->setFilename(STAT_FILENAME_1);
+    manager()->clear();
+
+    QSignalSpy spy(manager(), SIGNAL(scoreChanged(Lvk::Stats::Score,Lvk::Stats::Score)));
+
+    BE::Rule *root = newRuleTree1();
+
+    manager()->updateScoreWith(root);
+
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(spy[0][0].value<Stats::Score>() == manager()->currentScore());
+    QVERIFY(spy[0][1].value<Stats::Score>() == manager()->bestScore());
+    QCOMPARE(spy[0][0].value<Stats::Score>().rules, (double)ruleTree1Score());
+
+    // Unchanged scores are not notified
+    manager()->updateScoreWith(root);
+
+    QCOMPARE(spy.count(), 1);
+
+    // Neither are seconds ticks
+    manager()->onScoreTick();
+
+    QCOMPARE(spy.count(), 1);
+
+    manager()->clear();
+
+    QCOMPARE(spy.count(), 2);
+    QVERIFY(spy[1][0].value<Stats::Score>().isNull());
+
+    delete root;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void StatsManagerTest::testDistinctCounter_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<int>("n");
+
+    QTest::newRow("exact 0")        << (int)Stats::DistinctCounter::ExactMode       << 0;
+    QTest::newRow("exact 1000")     << (int)Stats::DistinctCounter::ExactMode       << 1000;
+    QTest::newRow("hashed 0")       << (int)Stats::DistinctCounter::HashedMode      << 0;
+    QTest::newRow("hashed 1000")    << (int)Stats::DistinctCounter::HashedMode      << 1000;
+    QTest::newRow("approx 0")       << (int)Stats::DistinctCounter::ApproximateMode << 0;
+    QTest::newRow("approx 50")      << (int)Stats::DistinctCounter::ApproximateMode << 50;
+    QTest::newRow("approx 1000")    << (int)Stats::DistinctCounter::ApproximateMode << 1000;
+    QTest::newRow("approx 100000")  << (int)Stats::DistinctCounter::ApproximateMode << 100000;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void StatsManagerTest::testDistinctCounter()
+{
+    QFETCH(int, mode);
+    QFETCH(int, n);
+
+    Stats::DistinctCounter counter(static_cast<Stats::DistinctCounter::Mode>(mode));
+
+    // Insert each string twice
+    for (int k = 0; k < 2; ++k) {
+        for (int i = 0; i < n; ++i) {
+            counter.insert("line " + QString::number(i));
+        }
+    }
+
+    if (mode == Stats::DistinctCounter::ApproximateMode) {
+        QVERIFY(qAbs((int)counter.size() - n) <= n*0.05);
+        QVERIFY(!counter.contains("line 0"));
+    } else {
+        QCOMPARE(counter.size(), (unsigned)n);
+        QCOMPARE(counter.contains("line 0"), n > 0);
+        QVERIFY(!counter.contains("line " + QString::number(n)));
+        QVERIFY(!counter.insert("line 0") || n == 0);
+    }
+
+    counter.clear();
+
+    QCOMPARE(counter.size(), 0u);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void StatsManagerTest::testHistoryStatsCountModes()
+{
+    Cmn::Conversation conv = readConversation(CONV_LONG_FILENAME);
+    QVERIFY(!conv.isEmpty());
+
+    Stats::HistoryStatsHelper exact(conv);
+
+    Stats::HistoryStatsHelper hashed;
+    hashed.setCountMode(Stats::DistinctCounter::HashedMode);
+    hashed.update(conv);
+
+    Stats::HistoryStatsHelper approx;
+    approx.setCountMode(Stats::DistinctCounter::ApproximateMode);
+    approx.update(conv);
+
+    QCOMPARE(hashed.chatbotLexiconSize(), exact.chatbotLexiconSize());
+    QCOMPARE(hashed.chatbotDiffLines(), exact.chatbotDiffLines());
+    QCOMPARE(hashed.chatbotDiffConvLines(), exact.chatbotDiffConvLines());
+    QCOMPARE(hashed.scoreContacts(), exact.scoreContacts());
+
+    // Per-contact lines are never estimated
+    QCOMPARE(approx.chatbotDiffConvLines(), exact.chatbotDiffConvLines());
+    QCOMPARE(approx.scoreContacts(), exact.scoreContacts());
+    QVERIFY(qAbs((int)approx.chatbotLexiconSize() - (int)exact.chatbotLexiconSize()) <= 2);
+    QVERIFY(qAbs((int)approx.chatbotDiffLines() - (int)exact.chatbotDiffLines()) <= 2);
+
+    QCOMPARE(exact.chatbotLexiconSize() + exact.chatbotDiffConvLines(),
+             (unsigned)CONV_LONG_CONV_SCORE);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void StatsManagerTest::testHistoryCheckpoint()
+{
+    Cmn::Conversation conv = readConversation(CONV_LONG_FILENAME);
+    QVERIFY(conv.size() > 1);
+
+    int half = conv.size()/2;
+
+    manager()->setFilename(STAT_FILENAME_1);
+
+    for (int i = 0; i < half; ++i) {
+        manager()->updateScoreWith(conv.entries()[i]);
+    }
+
+    // Closing the file stores the checkpoint
+    manager()->setFilename(STAT_FILENAME_2);
+    manager()->setFilename(STAT_FILENAME_1);
+
+    QCOMPARE(manager()->m_checkpointEntries, half);
+
+    for (int i = half; i < conv.size(); ++i) {
+        manager()->updateScoreWith(conv.entries()[i]);
+    }
+
+    // Saved without closing, so the entries newer than the checkpoint must be counted again
+    manager()->m_statsFile->save();
+    delete Stats::StatsManager::m_manager;
+    Stats::StatsManager::m_manager = new Stats::StatsManager();
+
+    manager()->setFilename(STAT_FILENAME_1);
+
+    QCOMPARE(manager()->m_checkpointEntries, half);
+
+    Stats::HistoryStatsHelper expected(conv);
+    const Stats::HistoryStatsHelper &restored = manager()->m_histStats;
+
+    QCOMPARE(restored.chatbotLexiconSize(), expected.chatbotLexiconSize());
+    QCOMPARE(restored.chatbotDiffConvLines(), expected.chatbotDiffConvLines());
+    QCOMPARE(restored.chatbotDiffLines(), expected.chatbotDiffLines());
+    QCOMPARE(restored.chatbotLines(), expected.chatbotLines());
+    QCOMPARE(restored.scoreContacts(), expected.scoreContacts());
+    QCOMPARE(restored.words(), expected.words());
+    QCOMPARE(restored.lexiconSize(), expected.lexiconSize());
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_APPLESS_MAIN(StatsManagerTest)
 
 #include "statsmanagertest.moc"
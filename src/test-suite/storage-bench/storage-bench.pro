@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Storage benchmark
+#
+#-------------------------------------------------
+
+QT       -= gui
+TARGET = storageBench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot
+
+SOURCES += \
+    storagebench.cpp \
+    ../../chatbot/back-end/rule.cpp \
+    ../../chatbot/back-end/mappedfile.cpp \
+    ../../chatbot/back-end/chatbotrulesfile.cpp \
+    ../../chatbot/chat-adapter/historyhelper.cpp \
+    ../../chatbot/stats/securestatsfile.cpp \
+    ../../chatbot/stats/metricseries.cpp
+
+PROJECT_PATH = ../../chatbot
+
+include($$PROJECT_PATH/common/common.pri)
+include($$PROJECT_PATH/crypto/crypto.pri)
+include($$PROJECT_PATH/3rd-party.pri)
@@ -0,0 +1,723 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Botmaster.
+ *
+ * LVK Botmaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Botmaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Botmaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Storage benchmark. Generates chat histories, stats files, rule files and CSV documents of the
+// given sizes and writes one CSV row per operation with the items processed, the bytes read or
+// written, the throughput, the peak resident memory of the operation and, for operations
+// timed one item at a time, the latency percentiles. Operations:
+//
+//   history  conv_write, conv_append, conv_read       ConversationWriter and ConversationReader
+//            history_load, history_append             HistoryHelper
+//   stats    stats_save, stats_load, stats_journal    SecureStatsFile, encrypted and hashed
+//   rules    rules_write, rules_load, rules_walk      ChatbotRulesFile, walk reads all strings
+//            rules_save                               ChatbotRulesFile incremental saves
+//   csv      csv_write, csv_parse                     CsvDocument
+//
+// Usage: storageBench [options]
+//
+//   --mode NAME          history, stats, rules, csv or all. Default: all
+//   --entries N          Chat history entries and CSV rows. Default: 100000
+//   --rules N            Rules of the rules file. Default: 5000
+//   --appends N          Items appended one by one to time each append. Rules files save at
+//                        most 1000 times. Default: 10000
+//   --dir DIR            Directory where files are generated. Default: ./storage-bench
+//   --seed N             Seed of the generated data. Default: 1
+//   --output FILE        Appends the results to FILE instead of writing them to stdout
+//
+// Peak memory is only available on Linux. Otherwise, it is -1.
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+#include "back-end/chatbotrulesfile.h"
+#include "back-end/rule.h"
+#include "chat-adapter/historyhelper.h"
+#include "common/conversation.h"
+#include "common/conversationreader.h"
+#include "common/conversationwriter.h"
+#include "common/csvdocument.h"
+#include "common/csvrow.h"
+#include "stats/securestatsfile.h"
+
+#include <stdio.h>
+
+#define VOCABULARY_SIZE     5000
+#define CONTACT_COUNT       200
+#define RULES_PER_CONTAINER 50
+#define MAX_RULES_SAVES     1000
+#define ENTRY_INTERVAL      30      // Seconds between history entries
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const char *SYLLABLES[] = { "ba", "ce", "di", "fo", "gu", "la", "me", "ni", "po", "ru", "sa",
+                            "te", "vi", "zo", "che", "que" };
+const int SYLLABLE_COUNT = sizeof(SYLLABLES)/sizeof(SYLLABLES[0]);
+
+const char *MODES[] = { "history", "stats", "rules", "csv" };
+const int MODE_COUNT = sizeof(MODES)/sizeof(MODES[0]);
+
+//--------------------------------------------------------------------------------------------------
+
+struct Options
+{
+    Options()
+        : mode("all"), entries(100000), rules(5000), appends(10000), dir("./storage-bench"),
+          seed(1) { }
+
+    QString mode;
+    int entries;
+    int rules;
+    int appends;
+    QString dir;
+    uint seed;
+    QString output;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// Result of an operation. Latencies are only set if items were timed one by one.
+struct Result
+{
+    Result(const QString &op = "")
+        : op(op), items(0), bytes(0), ns(0), peakRssKb(-1) { }
+
+    QString op;
+    qint64 items;
+    qint64 bytes;
+    qint64 ns;
+    qint64 peakRssKb;
+    QVector<qint64> latencies;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// HistoryHelper and SecureStatsFile log every load and save
+void quietMsgHandler(QtMsgType type, const char *msg)
+{
+    if (type != QtDebugMsg) {
+        fprintf(stderr, "%s\n", msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline int randomInt(int n)
+{
+    return qrand() % n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Deterministic word made of syllables
+QString word(int i)
+{
+    QString w;
+
+    do {
+        w += SYLLABLES[i % SYLLABLE_COUNT];
+        i /= SYLLABLE_COUNT;
+    } while (i > 0);
+
+    return w;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString randomWords(int n)
+{
+    QStringList words;
+
+    for (int i = 0; i < n; ++i) {
+        words.append(word(randomInt(VOCABULARY_SIZE)));
+    }
+
+    return words.join(" ");
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString contactName(int i)
+{
+    return QString("user%1@storage.lvk").arg(i);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Entry \a i of a history that starts on 2013-01-01 with one entry every ENTRY_INTERVAL secs
+Cmn::Conversation::Entry makeEntry(int i)
+{
+    static const QDateTime start(QDate(2013, 1, 1), QTime(0, 0));
+
+    bool match = randomInt(10) < 7;
+
+    return Cmn::Conversation::Entry(start.addSecs(i*ENTRY_INTERVAL),
+                                    contactName(randomInt(CONTACT_COUNT)), "chatbot",
+                                    randomWords(2 + randomInt(10)),
+                                    match ? randomWords(3 + randomInt(12)) : QString(), match,
+                                    match ? 1 + randomInt(5000) : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Cmn::Conversation makeConversation(int n)
+{
+    Cmn::Conversation conv;
+
+    for (int i = 0; i < n; ++i) {
+        conv.append(makeEntry(i));
+    }
+
+    return conv;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void makeRules(BE::Rule *root, int n)
+{
+    quint64 id = 1;
+    BE::Rule *container = 0;
+
+    for (int i = 0; i < n; ++i) {
+        if (i % RULES_PER_CONTAINER == 0) {
+            container = new BE::Rule(QString("Container %1").arg(i/RULES_PER_CONTAINER),
+                                     BE::Rule::ContainerRule);
+            container->setId(id++);
+            root->appendChild(container);
+        }
+
+        QStringList input;
+        input << randomWords(2 + randomInt(4)) << randomWords(2 + randomInt(4)) + " *";
+
+        QStringList output;
+        output << randomWords(4 + randomInt(8));
+
+        BE::Rule *rule = new BE::Rule(QString("Rule %1").arg(i), input, output);
+        rule->setId(id++);
+        container->appendChild(rule);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+qint64 fileSize(const QString &filename)
+{
+    return QFileInfo(filename).size();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Resets the peak resident memory, so the next peakRss() only reports the next operation.
+// Requires Linux 4.0 or later. Otherwise, peakRss() is the peak of the whole process.
+void resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/clear_refs");
+
+    if (file.open(QFile::WriteOnly)) {
+        file.write("5");
+    }
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Peak resident memory in KB. Returns -1 if not supported.
+qint64 peakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/status");
+
+    if (file.open(QFile::ReadOnly | QFile::Text)) {
+        foreach (const QString &line, QString(file.readAll()).split("\n")) {
+            if (line.startsWith("VmHWM:")) {
+                return line.mid(6).trimmed().split(" ").first().toLongLong();
+            }
+        }
+    }
+#endif
+
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Adds the time and the peak memory since construction to the given result
+class OpTimer
+{
+public:
+    OpTimer(Result &r) : m_r(r)
+    {
+        resetPeakRss();
+        m_timer.start();
+    }
+
+    ~OpTimer()
+    {
+        m_r.ns += m_timer.nsecsElapsed();
+        m_r.peakRssKb = peakRss();
+    }
+
+private:
+    Result &m_r;
+    QElapsedTimer m_timer;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+double percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    return sorted[qMin(sorted.size() - 1, (int)(p*sorted.size()))];
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QList<Result> runHistory(const Options &opt)
+{
+    QList<Result> results;
+    QString filename = opt.dir + "/history.dat";
+    QString appendFilename = opt.dir + "/history_append.dat";
+
+    Cmn::Conversation conv = makeConversation(opt.entries);
+
+    QFile::remove(filename);
+
+    Result write("conv_write");
+    {
+        OpTimer t(write);
+        Cmn::ConversationWriter(filename).write(conv);
+    }
+    write.items = conv.size();
+    write.bytes = fileSize(filename);
+    results.append(write);
+
+    QFile::remove(appendFilename);
+
+    Result append("conv_append");
+    {
+        OpTimer t(append);
+        Cmn::ConversationWriter writer(appendFilename);
+        QElapsedTimer timer;
+
+        for (int i = 0; i < opt.appends && i < conv.size(); ++i) {
+            timer.start();
+            writer.write(conv.entries()[i]);
+            append.latencies.append(timer.nsecsElapsed());
+        }
+    }
+    append.items = append.latencies.size();
+    append.bytes = fileSize(appendFilename);
+    results.append(append);
+
+    conv.clear();
+
+    Result read("conv_read");
+    {
+        OpTimer t(read);
+        Cmn::ConversationReader(filename).read(&conv);
+    }
+    read.items = conv.size();
+    read.bytes = fileSize(filename);
+    results.append(read);
+
+    conv.clear();
+
+    Result load("history_load");
+    {
+        OpTimer t(load);
+        CA::HistoryHelper helper(filename);
+        load.items = helper.history().size();
+    }
+    load.bytes = fileSize(filename);
+    results.append(load);
+
+    QFile::remove(appendFilename);
+
+    Result helperAppend("history_append");
+    {
+        OpTimer t(helperAppend);
+        CA::HistoryHelper helper(appendFilename);
+        QElapsedTimer timer;
+
+        for (int i = 0; i < opt.appends; ++i) {
+            Cmn::Conversation::Entry entry = makeEntry(i);
+
+            timer.start();
+            helper.append(entry);
+            helperAppend.latencies.append(timer.nsecsElapsed());
+        }
+    }
+    helperAppend.items = helperAppend.latencies.size();
+    helperAppend.bytes = fileSize(appendFilename);
+    results.append(helperAppend);
+
+    return results;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Stats files keep the chat history of the current interval besides the metrics
+QList<Result> runStats(const Options &opt)
+{
+    QList<Result> results;
+    QString filename = opt.dir + "/stats.dat";
+
+    QFile::remove(filename);
+
+    Stats::SecureStatsFile stats;
+    stats.load(filename);
+
+    for (int i = 0; i < CONTACT_COUNT; ++i) {
+        stats.addContact(contactName(i));
+    }
+    for (int i = 0; i < opt.entries; ++i) {
+        stats.appendChatEntry(makeEntry(i));
+    }
+    stats.setMetric(Stats::RuleDefCount, opt.rules);
+    stats.setMetric(Stats::RosterSize, CONTACT_COUNT);
+
+    Result save("stats_save");
+    {
+        OpTimer t(save);
+        stats.save();
+    }
+    save.items = opt.entries;
+    save.bytes = fileSize(filename);
+    results.append(save);
+
+    Stats::SecureStatsFile loaded;
+
+    Result load("stats_load");
+    {
+        OpTimer t(load);
+        loaded.load(filename);
+    }
+    load.items = loaded.chatHistorySize();
+    load.bytes = fileSize(filename);
+    results.append(load);
+
+    // Each save appends the new entry to the journal, until the journal is compacted
+    Result journal("stats_journal");
+    {
+        OpTimer t(journal);
+        QElapsedTimer timer;
+
+        for (int i = 0; i < opt.appends; ++i) {
+            Cmn::Conversation::Entry entry = makeEntry(opt.entries + i);
+
+            timer.start();
+            loaded.appendChatEntry(entry);
+            loaded.save();
+            journal.latencies.append(timer.nsecsElapsed());
+        }
+    }
+    journal.items = journal.latencies.size();
+    journal.bytes = fileSize(filename) - load.bytes;
+    results.append(journal);
+
+    return results;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QList<Result> runRules(const Options &opt)
+{
+    QList<Result> results;
+    QString filename = opt.dir + "/rules.cbf";
+
+    QFile::remove(filename);
+
+    {
+        BE::ChatbotRulesFile rules;
+        makeRules(rules.rootRule(), opt.rules);
+
+        Result write("rules_write");
+        {
+            OpTimer t(write);
+            rules.saveAs(filename);
+        }
+        write.items = opt.rules;
+        write.bytes = fileSize(filename);
+        results.append(write);
+    }
+
+    BE::ChatbotRulesFile rules;
+
+    Result load("rules_load");
+    {
+        OpTimer t(load);
+        rules.load(filename);
+    }
+    load.items = opt.rules;
+    load.bytes = fileSize(filename);
+    results.append(load);
+
+    // Strings of mapped files are read on demand
+    Result walk("rules_walk");
+    {
+        OpTimer t(walk);
+        qint64 chars = 0;
+
+        for (BE::Rule::iterator it = rules.rootRule()->begin(); it != rules.rootRule()->end();
+             ++it) {
+            chars += (*it)->name().size();
+            chars += (*it)->input().join("").size();
+            chars += (*it)->output().join("").size();
+            ++walk.items;
+        }
+
+        walk.bytes = chars*sizeof(QChar);
+    }
+    results.append(walk);
+
+    // Renames one rule and saves, as the editor does after each change
+    Result save("rules_save");
+    {
+        OpTimer t(save);
+        QElapsedTimer timer;
+        BE::Rule *container = rules.rootRule()->child(0);
+        int saves = qMin(opt.appends, MAX_RULES_SAVES);
+
+        for (int i = 0; i < saves; ++i) {
+            BE::Rule *rule = container->child(i % container->childCount());
+
+            timer.start();
+            rule->setName(QString("Renamed %1").arg(i));
+            rules.save();
+            save.latencies.append(timer.nsecsElapsed());
+        }
+    }
+    save.items = save.latencies.size();
+    save.bytes = fileSize(filename) - load.bytes;
+    results.append(save);
+
+    return results;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Rows are chat entries exported as CSV, with quoted cells with commas and quotes
+QList<Result> runCsv(const Options &opt)
+{
+    QList<Result> results;
+    Cmn::CsvDocument doc;
+
+    for (int i = 0; i < opt.entries; ++i) {
+        Cmn::Conversation::Entry e = makeEntry(i);
+        QStringList cells;
+        cells << e.dateTime.toString(Qt::ISODate) << e.from << e.to << e.msg
+              << QString("\"%1\", %2").arg(e.response).arg(i) << QString::number(e.match)
+              << QString::number(e.ruleId);
+        doc.append(Cmn::CsvRow(cells));
+    }
+
+    QString csv;
+
+    Result write("csv_write");
+    {
+        OpTimer t(write);
+        csv = doc.toString();
+    }
+    write.items = doc.rows().size();
+    write.bytes = csv.toUtf8().size();
+    results.append(write);
+
+    doc.clear();
+
+    Result parse("csv_parse");
+    {
+        OpTimer t(parse);
+        doc = Cmn::CsvDocument(csv);
+    }
+    parse.items = doc.rows().size();
+    parse.bytes = write.bytes;
+    results.append(parse);
+
+    return results;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void writeResult(QTextStream &out, const Options &opt, Result &r)
+{
+    double secs = r.ns/1e9;
+
+    out << r.op << "," << opt.entries << "," << opt.rules << "," << r.items << "," << r.bytes
+        << "," << QString::number(r.ns/1e6, 'f', 1) << ","
+        << QString::number(secs > 0 ? r.bytes/1e6/secs : 0, 'f', 2) << ","
+        << QString::number(secs > 0 ? r.items/secs : 0, 'f', 1) << "," << r.peakRssKb << ",";
+
+    if (!r.latencies.isEmpty()) {
+        qSort(r.latencies);
+        out << QString::number(percentile(r.latencies, 0.50)/1e3, 'f', 1) << ","
+            << QString::number(percentile(r.latencies, 0.99)/1e3, 'f', 1) << ","
+            << QString::number(r.latencies.last()/1e3, 'f', 1);
+    } else {
+        out << ",,";
+    }
+
+    out << "\n";
+    out.flush();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool parseOptions(const QStringList &args, Options &opt)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+
+        const QString &value = args[++i];
+        bool ok = true;
+
+        if (arg == "--mode") {
+            opt.mode = value;
+        } else if (arg == "--entries") {
+            opt.entries = value.toInt(&ok);
+            ok = ok && opt.entries >= 1;
+        } else if (arg == "--rules") {
+            opt.rules = value.toInt(&ok);
+            ok = ok && opt.rules >= 1;
+        } else if (arg == "--appends") {
+            opt.appends = value.toInt(&ok);
+        } else if (arg == "--dir") {
+            opt.dir = value;
+        } else if (arg == "--seed") {
+            opt.seed = value.toUInt(&ok);
+        } else if (arg == "--output") {
+            opt.output = value;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInstallMsgHandler(quietMsgHandler);
+
+    Options opt;
+
+    if (!parseOptions(app.arguments(), opt)) {
+        fprintf(stderr, "Usage: storageBench [--mode history|stats|rules|csv|all] "
+                        "[--entries N] [--rules N] [--appends N] [--dir DIR] [--seed N] "
+                        "[--output FILE]\n");
+        return 1;
+    }
+
+    QStringList modes;
+
+    for (int i = 0; i < MODE_COUNT; ++i) {
+        if (opt.mode == "all" || opt.mode == MODES[i]) {
+            modes.append(MODES[i]);
+        }
+    }
+
+    if (modes.isEmpty()) {
+        fprintf(stderr, "Unknown mode %s\n", qPrintable(opt.mode));
+        return 1;
+    }
+
+    if (!QDir().mkpath(opt.dir)) {
+        fprintf(stderr, "Cannot create %s\n", qPrintable(opt.dir));
+        return 1;
+    }
+
+    QFile file;
+    bool header = true;
+
+    if (opt.output.isEmpty()) {
+        file.open(stdout, QFile::WriteOnly);
+    } else {
+        file.setFileName(opt.output);
+        header = !file.exists() || file.size() == 0;
+
+        if (!file.open(QFile::WriteOnly | QFile::Append)) {
+            fprintf(stderr, "Cannot open %s\n", qPrintable(opt.output));
+            return 1;
+        }
+    }
+
+    QTextStream out(&file);
+
+    if (header) {
+        out << "op,entries,rules,items,bytes,total_ms,mb_per_sec,items_per_sec,peak_rss_kb,"
+               "p50_us,p99_us,max_us\n";
+    }
+
+    foreach (const QString &mode, modes) {
+        qsrand(opt.seed);
+
+        QList<Result> results;
+
+        if (mode == "history") {
+            results = runHistory(opt);
+        } else if (mode == "stats") {
+            results = runStats(opt);
+        } else if (mode == "rules") {
+            results = runRules(opt);
+        } else {
+            results = runCsv(opt);
+        }
+
+        for (int i = 0; i < results.size(); ++i) {
+            writeResult(out, opt, results[i]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2012-09-11T17:10:07
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = textSearchUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot \
+
+SOURCES += \
+    textsearchtest.cpp \
+    ../../chatbot/common/textsearch.cpp \
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
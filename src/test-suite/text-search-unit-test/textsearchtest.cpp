@@ -0,0 +1,148 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+
+#include "common/textsearch.h"
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// TextSearchTest
+//--------------------------------------------------------------------------------------------------
+
+class TextSearchTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    TextSearchTest() { }
+
+private Q_SLOTS:
+    void testIndexIn_data();
+    void testIndexIn();
+    void testCompare();
+    void testFold();
+    void testSearchBenchmark_data();
+    void testSearchBenchmark();
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void TextSearchTest::testIndexIn_data()
+{
+    QTest::addColumn<QString>("haystack");
+    QTest::addColumn<QString>("needle");
+    QTest::addColumn<int>("from");
+    QTest::addColumn<int>("expected");
+
+    QString camion = QString::fromUtf8("El cami\xc3\xb3n lleg\xc3\xb3");
+    QString nfd = QString::fromUtf8("El camio\xcc\x81n");
+
+    QTest::newRow("empty needle")   << "abc" << "" << 1 << 1;
+    QTest::newRow("empty both")     << "" << "" << 0 << 0;
+    QTest::newRow("empty text")     << "" << "a" << 0 << -1;
+    QTest::newRow("ascii")          << "Hello world" << "WORLD" << 0 << 6;
+    QTest::newRow("ascii from")     << "abcabc" << "abc" << 1 << 3;
+    QTest::newRow("not found")      << "Hello world" << "worlds" << 0 << -1;
+    QTest::newRow("diacritics")     << camion << "CAMION" << 0 << 3;
+    QTest::newRow("needle diac")    << "El CAMION" << QString::fromUtf8("cami\xc3\xb3n") << 0 << 3;
+    QTest::newRow("combining mark") << nfd << "camion" << 0 << 3;
+    QTest::newRow("non-ascii first") << camion << QString::fromUtf8("\xc3\x93N") << 0 << 7;
+    QTest::newRow("long ascii")     << QString(100, 'x') + "Needle" << "needle" << 0 << 100;
+    QTest::newRow("block boundary") << QString(7, 'x') + "ab" + QString(20, 'y') << "AB" << 0 << 7;
+    QTest::newRow("at the end")     << QString(30, 'x') + "a" << "a" << 0 << 30;
+    QTest::newRow("partial at end") << QString(30, 'x') + "ab" << "abc" << 0 << -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TextSearchTest::testIndexIn()
+{
+    QFETCH(QString, haystack);
+    QFETCH(QString, needle);
+    QFETCH(int, from);
+    QFETCH(int, expected);
+
+    Cmn::TextSearch search(needle);
+
+    QCOMPARE(search.indexIn(haystack, from), expected);
+    QCOMPARE(search.needle(), needle);
+
+    if (from == 0) {
+        QCOMPARE(Cmn::TextSearch::contains(haystack, needle), expected != -1);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TextSearchTest::testCompare()
+{
+    QString angel = QString::fromUtf8("\xc3\x81ngel");
+
+    QCOMPARE(Cmn::TextSearch::compare("", ""), 0);
+    QCOMPARE(Cmn::TextSearch::compare("Hola", "hOLA"), 0);
+    QCOMPARE(Cmn::TextSearch::compare(angel, "ANGEL"), 0);
+    QVERIFY(Cmn::TextSearch::compare("abc", "abd") < 0);
+    QVERIFY(Cmn::TextSearch::compare("abd", "ABC") > 0);
+    QVERIFY(Cmn::TextSearch::compare("ab", "abc") < 0);
+    QVERIFY(Cmn::TextSearch::compare("abc", "ab") > 0);
+    QVERIFY(Cmn::TextSearch::compare("", "a") < 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TextSearchTest::testFold()
+{
+    QString text = QString::fromUtf8("\xc3\x91and\xc3\xba Ca\xc3\xb1\xc3\xb3n");
+    QString nfd = QString::fromUtf8("Na\xcc\x83");
+
+    QCOMPARE(Cmn::TextSearch::fold(text), QString("nandu canon"));
+    QCOMPARE(Cmn::TextSearch::fold(nfd), QString("na"));
+    QCOMPARE(Cmn::TextSearch::fold("ABC xyz 123"), QString("abc xyz 123"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void TextSearchTest::testSearchBenchmark_data()
+{
+    QTest::addColumn<bool>("folded");
+
+    QTest::newRow("QString::contains") << false;
+    QTest::newRow("TextSearch") << true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Filters a list of contacts like the roster filter
+void TextSearchTest::testSearchBenchmark()
+{
+    QFETCH(bool, folded);
+
+    const int CONTACTS = 5000;
+
+    QStringList items;
+    for (int i = 0; i < CONTACTS; ++i) {
+        items.append(QString("Contact Name %1 <user%1@chat.example.com>").arg(i));
+    }
+
+    QString filter = "USER4999@";
+    Cmn::TextSearch search(filter);
+
+    int hits = 0;
+
+    QBENCHMARK {
+        hits = 0;
+        foreach (const QString &item, items) {
+            if (folded ? search.isFoundIn(item) : item.contains(filter, Qt::CaseInsensitive)) {
+                ++hits;
+            }
+        }
+    }
+
+    QCOMPARE(hits, 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_APPLESS_MAIN(TextSearchTest)
+
+#include "textsearchtest.moc"
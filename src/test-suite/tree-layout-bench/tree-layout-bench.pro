@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Tree layout benchmark
+#
+#-------------------------------------------------
+
+QT       -= gui
+TARGET = treeLayoutBench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot
+
+SOURCES += \
+    treelayoutbench.cpp
+
+PROJECT_PATH = ../../chatbot
+
+include($$PROJECT_PATH/nlp-engine/nlp-engine.pri)
+include($$PROJECT_PATH/common/common.pri)
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Botmaster.
+ *
+ * LVK Botmaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Botmaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Botmaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Tree layout benchmark. Builds rule sets of a given size and shape and compares the tree of
+// Node objects against its FlatTree copy. Writes one CSV row per rule set with the bytes per
+// rule and the time of a full traversal of each layout, and the time per input of the search,
+// which runs on the Node tree. Node bytes are an estimate of the node allocations and flat
+// bytes are the allocations of its arrays. Outputs are shared by both, so they are not counted.
+//
+// Usage: treeLayoutBench [rules]
+//
+//   rules                Rules in each rule set. Default: 10000
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+#include "nlp-engine/tree.h"
+#include "nlp-engine/node.h"
+#include "nlp-engine/flattree.h"
+#include "nlp-engine/rule.h"
+#include "nlp-engine/result.h"
+#include "nlp-engine/globaltools.h"
+#include "nlp-engine/nulllemmatizer.h"
+
+#include <stdio.h>
+
+#define ROUNDS          10      // Times each traversal is repeated
+#define SEARCHES        1000    // Inputs searched in each rule set
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+const char *SHAPES[] = { "literal", "deep", "wildcard", "variable" };
+const int SHAPE_COUNT = sizeof(SHAPES)/sizeof(SHAPES[0]);
+
+//--------------------------------------------------------------------------------------------------
+
+// Debug output of the tree would dominate the times
+void quietMsgHandler(QtMsgType type, const char *msg)
+{
+    if (type != QtDebugMsg) {
+        fprintf(stderr, "%s\n", msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString ruleInput(const QString &shape, int i)
+{
+    QString w = QString("word%1").arg(i);
+
+    if (shape == "deep") {
+        return QString("hola como estas %1 %2").arg(w).arg(i % 10);
+    } else if (shape == "wildcard") {
+        return "* " + w + " *";
+    } else if (shape == "variable") {
+        return w + " [x]";
+    } else {
+        return w;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString userInput(const QString &shape, int i)
+{
+    QString w = QString("word%1").arg(i);
+
+    if (shape == "deep") {
+        return QString("hola como estas %1 %2").arg(w).arg(i % 10);
+    } else if (shape == "wildcard") {
+        return "foo " + w + " bar";
+    } else if (shape == "variable") {
+        return w + " foo";
+    } else {
+        return w;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Visits every path from the root, skipping the loops of wildcard and variable nodes. Returns
+// the amount of nodes visited.
+int traverse(const Nlp::Node *root)
+{
+    int visited = 0;
+    QVector<const Nlp::Node *> pending;
+
+    pending.append(root);
+
+    while (!pending.isEmpty()) {
+        const Nlp::Node *node = pending.last();
+        pending.resize(pending.size() - 1);
+        ++visited;
+
+        const QList<Nlp::Node *> &childs = node->childs();
+
+        for (int i = 0; i < childs.size(); ++i) {
+            if (childs[i] != node) {
+                pending.append(childs[i]);
+            }
+        }
+    }
+
+    return visited;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int traverse(const Nlp::FlatTree &flat, quint32 root)
+{
+    int visited = 0;
+    QVector<quint32> pending;
+    const Nlp::FlatTree::Edge *edges = flat.edges().constData();
+
+    pending.append(root);
+
+    while (!pending.isEmpty()) {
+        quint32 i = pending.last();
+        pending.resize(pending.size() - 1);
+        ++visited;
+
+        const Nlp::FlatTree::FlatNode &node = flat.node(i);
+        const Nlp::FlatTree::Edge *end = edges + node.firstChild + node.nonWordCount
+                + node.wordCount;
+
+        for (const Nlp::FlatTree::Edge *e = edges + node.firstChild; e != end; ++e) {
+            if (e->node != i) {
+                pending.append(e->node);
+            }
+        }
+    }
+
+    return visited;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void run(const QString &shape, int ruleCount, QTextStream &out)
+{
+    Nlp::Tree tree;
+
+    for (int i = 0; i < ruleCount; ++i) {
+        tree.add(Nlp::Rule(i + 1, QStringList() << ruleInput(shape, i),
+                           QStringList() << QString("Output %1").arg(i)));
+    }
+
+    Nlp::FlatTree flat;
+    tree.flatten(flat);
+
+    // "* phrase *" inputs live in the trie of phrases, so both roots are counted
+
+    qint64 nodeBytes = Nlp::FlatTree::nodeMemoryUsage(tree.root())
+            + Nlp::FlatTree::nodeMemoryUsage(tree.phraseRoot());
+    qint64 flatBytes = flat.memoryUsage();
+
+    QElapsedTimer timer;
+    int nodeVisits = 0;
+    int flatVisits = 0;
+
+    timer.start();
+    for (int r = 0; r < ROUNDS; ++r) {
+        nodeVisits += traverse(tree.root()) + traverse(tree.phraseRoot());
+    }
+    qint64 nodeTraverseNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int r = 0; r < ROUNDS; ++r) {
+        flatVisits += traverse(flat, 0) + traverse(flat, flat.phraseRoot());
+    }
+    qint64 flatTraverseNs = timer.nsecsElapsed();
+
+    if (nodeVisits != flatVisits) {
+        fprintf(stderr, "Node and flat trees differ: %d/%d visits\n", nodeVisits, flatVisits);
+    }
+
+    // The search itself, as the engine runs it
+
+    Nlp::Result result;
+    int hits = 0;
+
+    timer.restart();
+    for (int i = 0; i < SEARCHES; ++i) {
+        tree.getResponse(userInput(shape, (i*7919) % ruleCount), result);
+        hits += !result.isNull() ? 1 : 0;
+    }
+    qint64 searchNs = timer.nsecsElapsed();
+
+    int n = qMax(1, ruleCount);
+
+    out << shape << "," << ruleCount << "," << flat.size() << "," << nodeBytes/n << ","
+        << flatBytes/n << ","
+        << QString::number(nodeTraverseNs/1e3/ROUNDS, 'f', 1) << ","
+        << QString::number(flatTraverseNs/1e3/ROUNDS, 'f', 1) << ","
+        << QString::number(searchNs/1e3/SEARCHES, 'f', 2) << ","
+        << QString::number((double)hits/SEARCHES, 'f', 3) << "\n";
+    out.flush();
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int ruleCount = 10000;
+
+    if (app.arguments().size() > 1) {
+        bool ok = false;
+        ruleCount = app.arguments()[1].toInt(&ok);
+
+        if (!ok || ruleCount < 1) {
+            fprintf(stderr, "Usage: treeLayoutBench [rules]\n");
+            return 1;
+        }
+    }
+
+    qInstallMsgHandler(quietMsgHandler);
+
+    Nlp::GlobalTools::instance()->setLemmatizer(new Nlp::NullLemmatizer());
+
+    QTextStream out(stdout);
+
+    out << "shape,rules,flat_nodes,node_bytes_per_rule,flat_bytes_per_rule,node_traverse_us,"
+           "flat_traverse_us,search_us,search_hit_ratio\n";
+
+    for (int i = 0; i < SHAPE_COUNT; ++i) {
+        run(SHAPES[i], ruleCount, out);
+    }
+
+    return 0;
+}
@@ -20,12 +20,14 @@ PROJECT_PATH = $$PWD
 
 HEADERS += \
     ../../chatbot/da-server/updater.h \
+    ../../chatbot/da-server/updatedownloader.h \
     ../../chatbot/da-server/rest.h \
     restmock.h
 
 SOURCES += \
     updaterunittest.cpp \
     ../../chatbot/da-server/updater.cpp \
+    ../../chatbot/da-server/updatedownloader.cpp \
     ../../chatbot/da-server/rest.cpp \
     restmock.cpp
 
@@ -31,6 +31,8 @@ private Q_SLOTS:
     void testCase1();
     void testCase1_data();
 
+    void testDeltaAndDataFiles();
+
 
     void onNoUpdate()
     {
@@ -141,6 +143,11 @@ void UpdaterUnitTest::testCase1()
 
     updater->checkForUpdate();
 
+    // Responses are parsed in a worker thread
+    for (int i = 0; i < 500 && !m_update && !m_noUpdate; ++i) {
+        QTest::qWait(10);
+    }
+
     // wrong or invalid xml files must produce a noUpdate signal
     if (!newer || filename.contains("wrong")) {
         QVERIFY(m_noUpdate);
@@ -161,6 +168,57 @@ void UpdaterUnitTest::testCase1()
 
 //--------------------------------------------------------------------------------------------------
 
+void UpdaterUnitTest::testDeltaAndDataFiles()
+{
+    const QString RESPONSE =
+            "<update>"
+            "  <version>1.3</version>"
+            "  <date>28/10/2012</date>"
+            "  <lastcritical>1.0</lastcritical>"
+            "  <url>http://lvklabs.com/builds/chatbot-1.3.zip</url>"
+            "  <hash>ce286df1e54f176ca76a8020a1ae3b464223fc0f</hash>"
+            "  <delta from=\"1.1\" hash=\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\">"
+            "    http://lvklabs.com/builds/1.1-1.3.delta"
+            "  </delta>"
+            "  <delta from=\"1.2\" hash=\"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\">"
+            "    http://lvklabs.com/builds/1.2-1.3.delta"
+            "  </delta>"
+            "  <data path=\"data/freeling/es/dicc.src\""
+            "        hash=\"cccccccccccccccccccccccccccccccccccccccc\">"
+            "    http://lvklabs.com/cccc"
+            "  </data>"
+            "  <data path=\"../../etc/passwd\" hash=\"dddddddddddddddddddddddddddddddddddddddd\">"
+            "    http://lvklabs.com/dddd"
+            "  </data>"
+            "  <data path=\"data/freeling/es/locucions.dat\" hash=\"../../../etc/passwd\">"
+            "    http://lvklabs.com/eeee"
+            "  </data>"
+            "</update>";
+
+    DAS::Updater updater(new RestMock());
+
+    DAS::UpdateInfo info;
+    updater.m_curVersion = DAS::UpdateVersion("1.2");
+    QVERIFY(updater.parseResponse(info, RESPONSE));
+    QCOMPARE(info.deltaUrl(), QString("http://lvklabs.com/builds/1.2-1.3.delta"));
+    QCOMPARE(info.deltaHash(), QString("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"));
+
+    // Paths outside the application directory and invalid hashes are ignored
+    QCOMPARE(info.dataFiles().size(), 1);
+    QCOMPARE(info.dataFiles()[0].path, QString("data/freeling/es/dicc.src"));
+    QCOMPARE(info.dataFiles()[0].url, QString("http://lvklabs.com/cccc"));
+    QCOMPARE(info.dataFiles()[0].hash, QString("cccccccccccccccccccccccccccccccccccccccc"));
+
+    // No delta from this version
+    info.clear();
+    updater.m_curVersion = DAS::UpdateVersion("1.0");
+    QVERIFY(updater.parseResponse(info, RESPONSE));
+    QVERIFY(info.deltaUrl().isEmpty());
+    QVERIFY(info.deltaHash().isEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+
 QTEST_MAIN(UpdaterUnitTest)
 
 #include "updaterunittest.moc"
@@ -20,13 +20,16 @@ INCLUDEPATH += \
 HEADERS += \
     ../../chatbot/da-server/rest.h \
     ../../chatbot/da-server/userauth.h \
+    ../../chatbot/common/settings.h \
 
 SOURCES += \
     userauthtest.cpp \
     ../../chatbot/common/json.cpp \
+    ../../chatbot/common/settings.cpp \
     ../../chatbot/da-server/userauth.cpp \
     ../../chatbot/da-server/rest.cpp \
     ../../chatbot/crypto/keymanagerfactory.cpp \
+    ../../chatbot/crypto/keycache.cpp \
 
 DEFINES += SRCDIR=\\\"$$PWD/\\\"
 
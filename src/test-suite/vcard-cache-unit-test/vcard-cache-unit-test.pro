@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2012-09-11T17:10:07
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = vCardCacheUnitTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../chatbot/
+
+SOURCES += \
+    vcardcachetest.cpp \
+    ../../chatbot/chat-adapter/vcardcache.cpp \
+
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
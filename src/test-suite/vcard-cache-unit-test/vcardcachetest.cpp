@@ -0,0 +1,150 @@
+#include <QtCore/QString>
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFile>
+#include <QCryptographicHash>
+
+#include "chat-adapter/vcardcache.h"
+
+using namespace Lvk;
+
+#define CACHE_FILENAME      "vcardcachetest.cache"
+
+#define JID_1               "user1@chat.example.com"
+#define JID_2               "user2@chat.example.com"
+#define JID_3               "user3@chat.example.com"
+
+//--------------------------------------------------------------------------------------------------
+// VCardCacheTest
+//--------------------------------------------------------------------------------------------------
+
+class VCardCacheTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    VCardCacheTest() { }
+
+private Q_SLOTS:
+    void init();
+    void testInsertAndValidate();
+    void testPersistence();
+    void testInvalidFile();
+    void cleanup();
+
+private:
+    QString m_filename;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void VCardCacheTest::init()
+{
+    m_filename = QDir::tempPath() + QDir::separator() + CACHE_FILENAME;
+    QFile::remove(m_filename);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void VCardCacheTest::cleanup()
+{
+    QFile::remove(m_filename);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void VCardCacheTest::testInsertAndValidate()
+{
+    QByteArray photo(4096, 'p');
+    QByteArray photoHash = QCryptographicHash::hash(photo, QCryptographicHash::Sha1);
+
+    CA::VCardCache cache;
+    QVERIFY(cache.setFilename(m_filename));
+    QCOMPARE(cache.size(), 0);
+    QVERIFY(cache.entry(JID_1).isNull());
+
+    cache.insert(JID_1, "User One", "one", photo);
+    cache.insert(JID_2, "User Two", "two");
+
+    QCOMPARE(cache.size(), 2);
+    QCOMPARE(cache.entry(JID_1).fullName, QString("User One"));
+    QCOMPARE(cache.entry(JID_1).nickName, QString("one"));
+    QCOMPARE(cache.entry(JID_1).photoHash, photoHash);
+    QVERIFY(!cache.entry(JID_1).isNull());
+
+    // Photos are not kept in memory
+    QString photoFilename = cache.photoFilename(JID_1);
+    QVERIFY(!photoFilename.isEmpty());
+    QFile file(photoFilename);
+    QVERIFY(file.open(QFile::ReadOnly));
+    QCOMPARE(file.readAll(), photo);
+    QVERIFY(cache.photoFilename(JID_2).isEmpty());
+
+    // Validation with the photo hash advertised by the contact
+    QVERIFY(cache.isValid(JID_1, photoHash));
+    QVERIFY(!cache.isValid(JID_1, QByteArray(20, 'x')));
+    QVERIFY(cache.isValid(JID_2, QByteArray()));
+    QVERIFY(!cache.isValid(JID_3, QByteArray()));
+
+    QStringList jids = QStringList() << JID_1 << JID_2 << JID_3;
+    QCOMPARE(cache.missing(jids), QStringList() << JID_3);
+
+    cache.remove(JID_2);
+    QCOMPARE(cache.missing(jids), QStringList() << JID_2 << JID_3);
+
+    QFile::remove(photoFilename);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void VCardCacheTest::testPersistence()
+{
+    {
+        CA::VCardCache cache;
+        QVERIFY(cache.setFilename(m_filename));
+        cache.insert(JID_1, "User One", "one");
+        cache.insert(JID_2, QString::fromUtf8("Usuario Dos \xc3\xb1"), "");
+        QVERIFY(cache.save());
+        cache.insert(JID_3, "User Three", "three");
+        // Destructor saves the last entry
+    }
+
+    CA::VCardCache cache;
+    QVERIFY(cache.setFilename(m_filename));
+    QCOMPARE(cache.size(), 3);
+    QCOMPARE(cache.entry(JID_2).fullName, QString::fromUtf8("Usuario Dos \xc3\xb1"));
+    QCOMPARE(cache.entry(JID_3).nickName, QString("three"));
+    QVERIFY(cache.entry(JID_3).fetched > 0);
+
+    // Changing the filename saves and clears the current cache
+    QVERIFY(cache.setFilename(""));
+    QCOMPARE(cache.size(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void VCardCacheTest::testInvalidFile()
+{
+    QFile file(m_filename);
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("garbage garbage garbage");
+    file.close();
+
+    CA::VCardCache cache;
+    QVERIFY(!cache.setFilename(m_filename));
+    QCOMPARE(cache.size(), 0);
+
+    // An invalid cache is replaced on the next save
+    cache.insert(JID_1, "User One", "one");
+    QVERIFY(cache.save());
+
+    CA::VCardCache cache2;
+    QVERIFY(cache2.setFilename(m_filename));
+    QCOMPARE(cache2.size(), 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QTEST_APPLESS_MAIN(VCardCacheTest)
+
+#include "vcardcachetest.moc"
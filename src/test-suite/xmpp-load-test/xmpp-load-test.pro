@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# XMPP load test
+#
+#-------------------------------------------------
+
+QT       -= gui
+TARGET = xmppLoadTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += \
+    ../../chatbot \
+    ../cb2-engine-unit-test
+
+HEADERS += \
+    ../cb2-engine-unit-test/mocklemmatizer.h
+
+SOURCES += \
+    xmpploadtest.cpp \
+    ../cb2-engine-unit-test/mocklemmatizer.cpp
+
+PROJECT_PATH = ../../chatbot
+
+include($$PROJECT_PATH/back-end/back-end.pri)
+include($$PROJECT_PATH/nlp-engine/nlp-engine.pri)
+include($$PROJECT_PATH/chat-adapter/chat-adapter.pri)
+include($$PROJECT_PATH/da-server/da-server.pri)
+include($$PROJECT_PATH/da-clue/da-clue.pri)
+include($$PROJECT_PATH/stats/stats.pri)
+include($$PROJECT_PATH/crypto/crypto.pri)
+include($$PROJECT_PATH/common/common.pri)
+include($$PROJECT_PATH/3rd-party.pri)
@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) 2012 Andres Pagliano, Gabriel Miretti, Gonzalo Buteler,
+ * Nestor Bustamante, Pablo Perez de Angelis
+ *
+ * This file is part of LVK Botmaster.
+ *
+ * LVK Botmaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LVK Botmaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LVK Botmaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// XMPP load test. Starts an embedded XMPP server on localhost, connects a chatbot to it and
+// floods the chatbot with messages from simulated contacts. Each message carries a sequence
+// number and the chatbot echoes it back, so the test can tell replies that are late, out of
+// order or missing. Prints the throughput, the reply latencies and the CPU and memory used.
+//
+// The simulated contacts live inside the server, hence thousands of contacts cost no
+// connections. The server is the XMPP domain localhost on port 5222, the address the chatbot
+// resolves by itself. The chatbot requires TLS, so the server needs a certificate and a key:
+//
+//   openssl req -x509 -newkey rsa:2048 -nodes -days 365 -subj "/CN=localhost" \
+//       -keyout load.key -out load.crt
+//
+// Usage: xmppLoadTest --cert FILE --key FILE [options]
+//
+//   --cert FILE          PEM certificate of the server
+//   --key FILE           PEM private key of the server
+//   --contacts N         Simulated contacts. Default: 1000
+//   --rate N             Messages per second sent to the chatbot. Default: 500
+//   --burst N            Messages sent at once. Default: 10
+//   --duration N         Seconds sending messages. Default: 30
+//   --drain N            Seconds waiting for replies after the last message. Default: 10
+//   --deadline N         Milliseconds after which a reply is late. Default: 1000
+//   --send-rate N        Overrides the stanzas per second the chatbot sends. Default: the
+//                        application setting
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <QHash>
+#include <QFile>
+#include <QHostAddress>
+#include <QDomElement>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+#include "QXmppServer.h"
+#include "QXmppServerExtension.h"
+#include "QXmppIncomingClient.h"
+#include "QXmppMessage.h"
+#include "QXmppUtils.h"
+
+#include "chat-adapter/gtalkchatbot.h"
+#include "back-end/aiadapter.h"
+#include "nlp-engine/cb2engine.h"
+#include "nlp-engine/rule.h"
+#include "nlp-engine/nullsanitizer.h"
+#include "common/settings.h"
+#include "common/settingskeys.h"
+#include "mocklemmatizer.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#include <stdio.h>
+
+#define DOMAIN              "localhost"
+#define BOT_USER            "chatbot"
+#define CONNECT_TIMEOUT     10000   // Milliseconds waiting for the chatbot to connect
+
+using namespace Lvk;
+
+//--------------------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Options
+{
+    Options()
+        : contacts(1000), rate(500), burst(10), duration(30), drain(10), deadline(1000),
+          sendRate(-1) { }
+
+    QString cert;
+    QString key;
+    int contacts;
+    int rate;
+    int burst;
+    int duration;
+    int drain;
+    int deadline;
+    double sendRate;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// MockLemmatizer and the chatbot log every message
+void quietMsgHandler(QtMsgType type, const char *msg)
+{
+    if (type != QtDebugMsg && type != QtWarningMsg) {
+        fprintf(stderr, "%s\n", msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString readFile(const QString &filename)
+{
+    QFile file(filename);
+
+    return file.open(QFile::ReadOnly) ? QString(file.readAll()) : QString();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+QString contactJid(int i)
+{
+    return QString("contact%1@" DOMAIN).arg(i);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Index of the simulated contact with the given JID or -1
+int contactIndex(const QString &jid)
+{
+    QString user = jidToUser(jid);
+
+    if (!user.startsWith("contact") || jidToDomain(jid) != DOMAIN) {
+        return -1;
+    }
+
+    bool ok = false;
+    int i = user.mid(7).toInt(&ok);
+
+    return ok ? i : -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Max resident memory in bytes. Returns -1 if not supported.
+qint64 maxResidentMemory()
+{
+#ifdef Q_OS_LINUX
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return (qint64)usage.ru_maxrss * 1024;
+    }
+#endif
+
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// User and system CPU seconds. Returns -1 if not supported.
+double cpuTime()
+{
+#ifdef Q_OS_LINUX
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1e6
+                + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1e6;
+    }
+#endif
+
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+double percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    return sorted[qMin(sorted.size() - 1, (int)(p*sorted.size()))];
+}
+
+//--------------------------------------------------------------------------------------------------
+
+// Every contact can log in with any password
+class PasswordChecker : public QXmppPasswordChecker
+{
+public:
+    virtual Error checkPassword(const QString &, const QString &)
+    {
+        return NoError;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+bool parseOptions(const QStringList &args, Options &opt)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+
+        const QString &value = args[++i];
+        bool ok = true;
+
+        if (arg == "--cert") {
+            opt.cert = value;
+        } else if (arg == "--key") {
+            opt.key = value;
+        } else if (arg == "--contacts") {
+            opt.contacts = value.toInt(&ok);
+            ok = ok && opt.contacts > 0;
+        } else if (arg == "--rate") {
+            opt.rate = value.toInt(&ok);
+            ok = ok && opt.rate > 0;
+        } else if (arg == "--burst") {
+            opt.burst = value.toInt(&ok);
+            ok = ok && opt.burst > 0;
+        } else if (arg == "--duration") {
+            opt.duration = value.toInt(&ok);
+        } else if (arg == "--drain") {
+            opt.drain = value.toInt(&ok);
+        } else if (arg == "--deadline") {
+            opt.deadline = value.toInt(&ok);
+        } else if (arg == "--send-rate") {
+            opt.sendRate = value.toDouble(&ok);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return !opt.cert.isEmpty() && !opt.key.isEmpty();
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// LoadGenerator
+//--------------------------------------------------------------------------------------------------
+
+/*
+ * Server extension that sends messages of the simulated contacts to the chatbot and
+ * intercepts the replies. Messages are "ping <seq>" and the chatbot replies "pong <seq>".
+ */
+class LoadGenerator : public QXmppServerExtension
+{
+    Q_OBJECT
+
+public:
+    LoadGenerator(const Options &opt)
+        : m_opt(opt), m_botJid(BOT_USER "@" DOMAIN), m_nextSeq(0), m_replied(0), m_late(0),
+          m_outOfOrder(0), m_unknown(0), m_sendMs(0), m_lastSeq(opt.contacts, -1)
+    {
+        connect(&m_sendTimer, SIGNAL(timeout()), SLOT(sendBurst()));
+    }
+
+    virtual bool handleStanza(QXmppStream *, const QDomElement &stanza)
+    {
+        if (stanza.tagName() != "message") {
+            return false;
+        }
+
+        int contact = contactIndex(stanza.attribute("to"));
+
+        if (contact < 0 || contact >= m_opt.contacts) {
+            return false;
+        }
+
+        QString body = stanza.firstChildElement("body").text();
+        bool ok = false;
+        int seq = body.section(' ', -1).toInt(&ok);
+
+        QHash<int, qint64>::iterator it = ok ? m_inflight.find(seq) : m_inflight.end();
+
+        if (it == m_inflight.end()) {
+            ++m_unknown;
+            return true;
+        }
+
+        qint64 latency = m_clock.elapsed() - *it;
+        m_inflight.erase(it);
+        m_latencies.append(latency);
+        ++m_replied;
+
+        if (latency > m_opt.deadline) {
+            ++m_late;
+        }
+
+        // Sequence numbers of a contact grow, so a smaller one means a reply was overtaken
+        if (seq < m_lastSeq[contact]) {
+            ++m_outOfOrder;
+        } else {
+            m_lastSeq[contact] = seq;
+        }
+
+        return true;
+    }
+
+    void report(CA::XmppChatbot &bot)
+    {
+        qSort(m_latencies);
+
+        double sendSecs = m_sendMs/1000.0;
+        CA::OutboundQueue::Stats stats = bot.sendStats();
+
+        printf("sent           %d\n", m_nextSeq);
+        printf("replied        %d\n", m_replied);
+        printf("missing        %d\n", m_inflight.size());
+        printf("late           %d (> %d ms)\n", m_late, m_opt.deadline);
+        printf("out of order   %d\n", m_outOfOrder);
+        printf("unexpected     %d\n", m_unknown);
+        printf("send rate      %.1f msg/s\n", sendSecs > 0 ? m_nextSeq/sendSecs : 0.0);
+        printf("throughput     %.1f replies/s\n", sendSecs > 0 ? m_replied/sendSecs : 0.0);
+        printf("latency p50    %.0f ms\n", percentile(m_latencies, 0.50));
+        printf("latency p90    %.0f ms\n", percentile(m_latencies, 0.90));
+        printf("latency p99    %.0f ms\n", percentile(m_latencies, 0.99));
+        printf("latency max    %.0f ms\n", m_latencies.isEmpty() ? 0.0 : m_latencies.last());
+        printf("queue sent     %u\n", stats.sent);
+        printf("queue dropped  %u\n", stats.dropped);
+        printf("queue avg wait %lld ms\n", stats.avgLatency());
+        printf("queue max wait %lld ms\n", stats.maxLatency);
+        printf("cpu            %.2f s\n", cpuTime());
+        printf("max rss        %lld KB\n", maxResidentMemory()/1024);
+        fflush(stdout);
+    }
+
+signals:
+    void finished();
+
+public slots:
+    void startLoad()
+    {
+        if (m_sendTimer.isActive()) {
+            return;
+        }
+
+        m_clock.start();
+        m_sendTimer.start(qMax(1, 1000*m_opt.burst/m_opt.rate));
+    }
+
+    void onBotError(int err)
+    {
+        fprintf(stderr, "Chatbot error %d\n", err);
+        emit finished();
+    }
+
+private slots:
+    void sendBurst()
+    {
+        if (m_clock.elapsed() >= m_opt.duration*1000) {
+            m_sendTimer.stop();
+            m_sendMs = m_clock.elapsed();
+            QTimer::singleShot(m_opt.drain*1000, this, SIGNAL(finished()));
+            return;
+        }
+
+        // Messages that the timer could not send on time are sent now
+        int due = qMin((int)(m_clock.elapsed()*m_opt.rate/1000) + m_opt.burst,
+                       m_opt.duration*m_opt.rate);
+
+        while (m_nextSeq < due) {
+            int seq = m_nextSeq++;
+            QXmppMessage msg(contactJid(seq % m_opt.contacts), m_botJid,
+                             QString("ping %1").arg(seq));
+            msg.setType(QXmppMessage::Chat);
+
+            m_inflight.insert(seq, m_clock.elapsed());
+            server()->sendPacket(msg);
+        }
+    }
+
+private:
+    Options m_opt;
+    QString m_botJid;
+    QTimer m_sendTimer;
+    QElapsedTimer m_clock;
+    int m_nextSeq;
+    int m_replied;
+    int m_late;
+    int m_outOfOrder;
+    int m_unknown;
+    qint64 m_sendMs;
+    QHash<int, qint64> m_inflight;  // seq -> milliseconds when it was sent
+    QVector<int> m_lastSeq;         // contact -> last seq replied
+    QVector<qint64> m_latencies;
+};
+
+//--------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInstallMsgHandler(quietMsgHandler);
+
+    Options opt;
+
+    if (!parseOptions(app.arguments(), opt)) {
+        fprintf(stderr, "Usage: xmppLoadTest --cert FILE --key FILE [--contacts N] "
+                        "[--rate N] [--burst N] [--duration N] [--drain N] [--deadline N] "
+                        "[--send-rate N]\n");
+        return 1;
+    }
+
+    QString cert = readFile(opt.cert);
+    QString key = readFile(opt.key);
+
+    if (cert.isEmpty() || key.isEmpty()) {
+        fprintf(stderr, "Cannot read certificate or key\n");
+        return 1;
+    }
+
+    Cmn::Settings().setValue(SETTING_APP_LANGUAGE, "es_AR");
+
+    if (opt.sendRate > 0) {
+        Cmn::Settings().setValue(SETTING_XMPP_SEND_RATE, opt.sendRate);
+    }
+
+    PasswordChecker checker;
+    LoadGenerator generator(opt);
+
+    QXmppServer server;
+    server.setDomain(DOMAIN);
+    server.setPasswordChecker(&checker);
+    server.setLocalCertificate(cert);
+    server.setPrivateKey(key);
+    server.addExtension(&generator);
+
+    if (!server.listenForClients(QHostAddress::LocalHost)) {
+        fprintf(stderr, "Cannot listen on port 5222\n");
+        return 1;
+    }
+
+    Nlp::Cb2Engine engine(new Nlp::NullSanitizer());
+    engine.setLemmatizer(new MockLemmatizer());
+    engine.setRules(Nlp::RuleList() << Nlp::Rule(1, QStringList() << "Ping [n]",
+                                                 QStringList() << "Pong [n]"));
+
+    BE::AIAdapter ai(BOT_USER "@" DOMAIN, &engine);
+
+    CA::GTalkChatbot bot("load-test");
+    bot.setAI(&ai);
+
+    QObject::connect(&bot, SIGNAL(connected()), &generator, SLOT(startLoad()));
+    QObject::connect(&bot, SIGNAL(error(int)), &generator, SLOT(onBotError(int)));
+    QObject::connect(&generator, SIGNAL(finished()), &app, SLOT(quit()));
+
+    bot.connectToServer(BOT_USER, "passwd", DOMAIN);
+
+    QElapsedTimer connectClock;
+    connectClock.start();
+
+    while (!bot.isConnected() && connectClock.elapsed() < CONNECT_TIMEOUT) {
+        app.processEvents(QEventLoop::WaitForMoreEvents, 100);
+    }
+
+    if (!bot.isConnected()) {
+        fprintf(stderr, "Chatbot did not connect\n");
+        return 1;
+    }
+
+    app.exec();
+
+    generator.report(bot);
+
+    bot.disconnectFromServer();
+    server.close();
+
+    return 0;
+}
+
+#include "xmpploadtest.moc"